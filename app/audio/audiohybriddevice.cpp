@@ -26,12 +26,40 @@
 AudioHybridDevice::AudioHybridDevice(QObject *parent) :
   QIODevice(parent),
   device_(nullptr),
+  feeder_(this),
+  frame_size_(1),
+  channel_count_(0),
+  samples_are_float_(false),
+  target_latency_bytes_(0),
+  target_latency_ms_(1),
   sample_index_(0),
-  enable_sending_samples_(false)
+  enable_metering_(false)
 {
 
 }
 
+AudioHybridDevice::~AudioHybridDevice()
+{
+  Stop();
+}
+
+void AudioHybridDevice::SetTargetLatency(const AudioRenderingParams &params, int milliseconds)
+{
+  Stop();
+
+  frame_size_ = qMax(1, params.samples_to_bytes(1));
+  channel_count_ = params.channel_count();
+  samples_are_float_ = (params.format() == SAMPLE_FMT_FLT);
+  target_latency_ms_ = qMax(1, milliseconds);
+  target_latency_bytes_ = static_cast<qint64>(qMax(1, params.time_to_samples(rational(target_latency_ms_, 1000))))
+      * frame_size_;
+
+  // Twice the latency, so there's always room to top the buffer back up
+  if (ring_.capacity() < target_latency_bytes_ * 2) {
+    ring_.SetCapacity(target_latency_bytes_ * 2);
+  }
+}
+
 void AudioHybridDevice::Push(const QByteArray& samples)
 {
   Stop();
@@ -50,8 +78,11 @@ void AudioHybridDevice::Stop()
   pushed_samples_.clear();
 
   if (device_ != nullptr) {
-    device_->close();
+    StopFeeder();
+
     device_ = nullptr;
+
+    ring_.Clear();
   }
 }
 
@@ -63,40 +94,48 @@ void AudioHybridDevice::ConnectDevice(QIODevice *device)
   device_ = device;
 
   if (device_ != nullptr) {
+    feeder_stop_.storeRelease(0);
+    feeder_finished_.storeRelease(0);
+
+    // Buffer whatever's ready now, so the output doesn't start with an underrun
+    QByteArray chunk(static_cast<int>(target_latency_bytes_), 0);
+
+    if (FillRingBuffer(&chunk, false)) {
+      feeder_.start(QThread::TimeCriticalPriority);
+    } else {
+      device_->close();
+      feeder_finished_.storeRelease(1);
+    }
+
     emit HasSamples();
   }
 }
 
 bool AudioHybridDevice::IsIdle()
 {
-  return device_ == nullptr && pushed_samples_.isEmpty();
+  bool device_done = (device_ == nullptr || (feeder_finished_.loadAcquire() && ring_.ReadAvailable() == 0));
+
+  return device_done && pushed_samples_.isEmpty();
 }
 
-void AudioHybridDevice::SetEnableSendingSamples(bool e)
+void AudioHybridDevice::SetEnableMetering(bool e)
 {
-  enable_sending_samples_ = e;
+  enable_metering_ = e;
+}
+
+AudioMeterTap *AudioHybridDevice::meter_tap()
+{
+  return &meter_tap_;
 }
 
 qint64 AudioHybridDevice::readData(char *data, qint64 maxSize)
 {
   qint64 read_size = read_internal(data, maxSize);
 
-  if (enable_sending_samples_ && read_size > 0) {
-    // FIXME: Assumes float and stereo
-    float* samples = reinterpret_cast<float*>(data);
-    int sample_count = static_cast<int>(read_size / static_cast<int>(sizeof(float)));
-    int channels = 2;
-
-    // Create array of samples to send
-    QVector<double> averages(channels);
-    averages.fill(0);
-
-    // Add all samples together
-    for (int i=0;i<sample_count;i++) {
-      averages[i%channels] = qMax(averages[i%channels], static_cast<double>(qAbs(samples[i])));
-    }
-
-    emit SentSamples(averages);
+  if (enable_metering_ && samples_are_float_ && read_size > 0) {
+    meter_tap_.Measure(reinterpret_cast<const float*>(data),
+                       static_cast<int>(read_size / frame_size_),
+                       channel_count_);
   }
 
   return read_size;
@@ -114,17 +153,16 @@ qint64 AudioHybridDevice::writeData(const char *data, qint64 maxSize)
 
 qint64 AudioHybridDevice::read_internal(char *data, qint64 maxSize)
 {
-  // If a device is connected, passthrough to it
+  // If a device is connected, send what the feeder has buffered from it
   if (device_ != nullptr) {
-    qint64 read_count = device_->read(data, maxSize);
+    // Only read whole frames, so an underrun can't shift the channels out of place
+    qint64 read_count = ring_.Read(data, qMin(maxSize, ring_.ReadAvailable()) / frame_size_ * frame_size_);
 
-    // Stop reading this device
-    if (device_->atEnd()) {
-      device_->close();
-      device_ = nullptr;
+    if (read_count < maxSize) {
+      memset(data + read_count, 0, static_cast<size_t>(maxSize - read_count));
     }
 
-    return read_count;
+    return maxSize;
   }
 
   // If there are samples to push, push those
@@ -149,3 +187,93 @@ qint64 AudioHybridDevice::read_internal(char *data, qint64 maxSize)
   memset(data, 0, static_cast<size_t>(maxSize));
   return maxSize;
 }
+
+bool AudioHybridDevice::FillRingBuffer(QByteArray *chunk, bool must_read)
+{
+  while (true) {
+    if (device_->atEnd()) {
+      return false;
+    }
+
+    qint64 wanted = qMin(target_latency_bytes_ - ring_.ReadAvailable(), ring_.WriteAvailable());
+    wanted = qMin(wanted, static_cast<qint64>(chunk->size())) / frame_size_ * frame_size_;
+
+    if (wanted <= 0) {
+      return true;
+    }
+
+    qint64 available = device_->bytesAvailable() / frame_size_ * frame_size_;
+
+    if (available > 0) {
+      wanted = qMin(wanted, available);
+    } else if (must_read) {
+      // Only read past what's ready once, in case it's ready by the next time around
+      must_read = false;
+    } else {
+      return true;
+    }
+
+    qint64 read_count = device_->read(chunk->data(), wanted);
+
+    if (read_count <= 0) {
+      return false;
+    }
+
+    ring_.Write(chunk->constData(), read_count);
+  }
+}
+
+void AudioHybridDevice::FeedRingBuffer()
+{
+  QByteArray chunk(static_cast<int>(qMax(static_cast<qint64>(frame_size_),
+                                         target_latency_bytes_ / 4 / frame_size_ * frame_size_)), 0);
+
+  // Check back several times per latency period so the buffer is topped up well before it runs dry
+  unsigned long wait_ms = static_cast<unsigned long>(qMax(1, target_latency_ms_ / 8));
+
+  while (!feeder_stop_.loadAcquire()) {
+    // If the output is about to run dry, read anyway. The device will fill in silence, but playback stays in time.
+    bool must_read = (ring_.ReadAvailable() < target_latency_bytes_ / 4);
+
+    if (!FillRingBuffer(&chunk, must_read)) {
+      break;
+    }
+
+    feeder_lock_.lock();
+
+    if (!feeder_stop_.loadAcquire()) {
+      feeder_wake_.wait(&feeder_lock_, wait_ms);
+    }
+
+    feeder_lock_.unlock();
+  }
+
+  device_->close();
+
+  feeder_finished_.storeRelease(1);
+}
+
+void AudioHybridDevice::StopFeeder()
+{
+  feeder_lock_.lock();
+  feeder_stop_.storeRelease(1);
+  feeder_wake_.wakeAll();
+  feeder_lock_.unlock();
+
+  feeder_.wait();
+
+  // The feeder closes the device itself, unless it never got started
+  if (device_->isOpen()) {
+    device_->close();
+  }
+}
+
+AudioHybridDevice::FeederThread::FeederThread(AudioHybridDevice *device) :
+  device_(device)
+{
+}
+
+void AudioHybridDevice::FeederThread::run()
+{
+  device_->FeedRingBuffer();
+}
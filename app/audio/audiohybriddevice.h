@@ -22,6 +22,13 @@
 #define AUDIOHYBRIDDEVICE_H
 
 #include <QIODevice>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "audiometertap.h"
+#include "audioringbuffer.h"
+#include "render/audioparams.h"
 
 /**
  * @brief A device that can be connected to QAudioOutput and provides both "push" and "pull" functionality
@@ -35,6 +42,9 @@
  * can be connected and pulled from (good for continuous audio playback), and any amount of samples can also be pushed
  * (good for short bursts of sound, e.g. audio scrubbing).
  *
+ * A connected device is never read from the audio output's thread. A feeder thread keeps a lock-free ring buffer
+ * filled to the target latency ahead of the output, and the output only ever reads from that buffer.
+ *
  * This does not support any "queuing", running ConnectDevice() or Push() will immediately discard anything that's
  * currently being sent to the device and replace it.
  */
@@ -44,6 +54,15 @@ class AudioHybridDevice : public QIODevice
 public:
   AudioHybridDevice(QObject* parent = nullptr);
 
+  virtual ~AudioHybridDevice() override;
+
+  /**
+   * @brief Set the format of samples being sent and how far ahead of the output a connected device is read
+   *
+   * Stops any output currently happening.
+   */
+  void SetTargetLatency(const AudioRenderingParams& params, int milliseconds);
+
   void Push(const QByteArray &samples);
 
   /**
@@ -65,6 +84,10 @@ public:
    *
    * This will clear any pushed samples or QIODevices currently being read and will start reading from this next time
    * the audio output requests data.
+   *
+   * From here until Stop() the device belongs to the feeder thread, which closes it once it reaches the end. While the
+   * device's bytesAvailable() is 0 but it isn't at the end (e.g. audio that's still rendering), the feeder waits for it
+   * rather than reading, for as long as what's already buffered lasts.
    */
   void ConnectDevice(QIODevice* device);
 
@@ -82,25 +105,22 @@ public:
   bool IsIdle();
 
   /**
-   * @brief If enabled, this will emit the SentSamples() signal whenever samples are sent to the output device
+   * @brief If enabled, samples sent to the output device are measured into meter_tap()
+   *
+   * Only float samples are metered.
    */
-  void SetEnableSendingSamples(bool e);
+  void SetEnableMetering(bool e);
 
-signals:
   /**
-   * @brief Signal emitted when this leaves "idle" state and has valid audio data that is ready to be sent
+   * @brief Levels of the samples sent to the output device, for AudioMonitor to collect
    */
-  void HasSamples();
+  AudioMeterTap* meter_tap();
 
+signals:
   /**
-   * @brief Signal emitted when samples are sent to the output device
-   *
-   * This sends an array of values corresponding to the channel count. Each value is an average of all the samples just
-   * sent to that channel. Useful for connecting to AudioMonitor.
-   *
-   * Can be disabled with SetEnableSendingSamples() to save CPU usage.
+   * @brief Signal emitted when this leaves "idle" state and has valid audio data that is ready to be sent
    */
-  void SentSamples(QVector<double> averages);
+  void HasSamples();
 
 protected:
   /**
@@ -130,14 +150,60 @@ protected:
   virtual qint64 writeData(const char *data, qint64 maxSize) override;
 
 private:
+  class FeederThread : public QThread
+  {
+  public:
+    FeederThread(AudioHybridDevice* device);
+
+  protected:
+    virtual void run() override;
+
+  private:
+    AudioHybridDevice* device_;
+  };
+
   qint64 read_internal(char *data, qint64 maxSize);
 
+  /**
+   * @brief Read whatever the connected device has ready into the ring buffer, up to the target latency
+   *
+   * If `must_read` is TRUE, this reads even if the device says nothing is ready yet.
+   *
+   * @return
+   *
+   * FALSE if the device has reached the end.
+   */
+  bool FillRingBuffer(QByteArray* chunk, bool must_read);
+
+  /**
+   * @brief Main loop of the feeder thread, runs until Stop() is called or the device reaches the end
+   */
+  void FeedRingBuffer();
+
+  void StopFeeder();
+
   QIODevice* device_;
 
+  AudioRingBuffer ring_;
+
+  FeederThread feeder_;
+  QMutex feeder_lock_;
+  QWaitCondition feeder_wake_;
+  QAtomicInt feeder_stop_;
+  QAtomicInt feeder_finished_;
+
+  int frame_size_;
+  int channel_count_;
+  bool samples_are_float_;
+  qint64 target_latency_bytes_;
+  int target_latency_ms_;
+
   QByteArray pushed_samples_;
   qint64 sample_index_;
 
-  bool enable_sending_samples_;
+  bool enable_metering_;
+
+  AudioMeterTap meter_tap_;
 
 };
 
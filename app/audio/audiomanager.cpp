@@ -63,20 +63,39 @@ bool AudioManager::IsRefreshing()
 
 void AudioManager::PushToOutput(const QByteArray &samples)
 {
+#ifdef OLIVE_PORTAUDIO
+  if (low_latency_output_ != nullptr) {
+    low_latency_output_->Stop();
+  }
+#endif
+
   output_manager_.Push(samples);
 }
 
 void AudioManager::StartOutput(QIODevice *device)
 {
+#ifdef OLIVE_PORTAUDIO
+  if (low_latency_output_ != nullptr) {
+    low_latency_output_->Stop();
+  } else
+#endif
   if (output_ == nullptr) {
     return;
   }
 
+  output_manager_.SetTargetLatency(output_params_, Config::Current()["AudioOutputLatency"].toInt());
   output_manager_.ConnectDevice(device);
 }
 
 void AudioManager::StopOutput()
 {
+#ifdef OLIVE_PORTAUDIO
+  if (low_latency_output_ != nullptr) {
+    low_latency_idle_timer_.stop();
+    low_latency_output_->Stop();
+  }
+#endif
+
   output_manager_.Stop();
 
   if (output_ != nullptr) {
@@ -84,6 +103,28 @@ void AudioManager::StopOutput()
   }
 }
 
+qint64 AudioManager::GetOutputPlayedUSecs()
+{
+#ifdef OLIVE_PORTAUDIO
+  if (low_latency_output_ != nullptr) {
+    if (!low_latency_output_->IsActive() || output_manager_.IsIdle()) {
+      return -1;
+    }
+
+    return low_latency_output_->GetPlayedUSecs();
+  }
+#endif
+
+  if (output_ == nullptr || output_->state() != QAudio::ActiveState || output_manager_.IsIdle()) {
+    return -1;
+  }
+
+  // processedUSecs() includes whatever is still sitting in the device's buffer, which hasn't been heard yet
+  qint64 buffered = output_->format().durationForBytes(output_->bufferSize() - output_->bytesFree());
+
+  return qMax(static_cast<qint64>(0), output_->processedUSecs() - buffered);
+}
+
 void AudioManager::SetOutputDevice(const QAudioDeviceInfo &info)
 {
   qInfo() << "Setting output audio device to" << info.deviceName();
@@ -92,6 +133,22 @@ void AudioManager::SetOutputDevice(const QAudioDeviceInfo &info)
 
   output_device_info_ = info;
 
+#ifdef OLIVE_PORTAUDIO
+  low_latency_output_ = nullptr;
+
+  if (output_params_.is_valid() && Config::Current()["LowLatencyAudio"].toBool()) {
+    low_latency_output_ = std::unique_ptr<PortAudioOutput>(new PortAudioOutput(&output_manager_, this));
+
+    if (low_latency_output_->Open(info.deviceName(), output_params_, Config::Current()["AudioBufferSize"].toInt())) {
+      output_ = nullptr;
+      return;
+    }
+
+    qWarning() << "Falling back to the standard audio output:" << low_latency_output_->GetError();
+    low_latency_output_ = nullptr;
+  }
+#endif
+
   if (output_params_.is_valid()) {
     QAudioFormat format;
     format.setSampleRate(output_params_.sample_rate());
@@ -142,11 +199,18 @@ void AudioManager::SetOutputParams(const AudioRenderingParams &params)
   if (output_params_ != params) {
     output_params_ = params;
 
+    output_manager_.SetTargetLatency(output_params_, Config::Current()["AudioOutputLatency"].toInt());
+
     // Refresh output device
     SetOutputDevice(output_device_info_);
   }
 }
 
+AudioMeterTap *AudioManager::meter_tap()
+{
+  return output_manager_.meter_tap();
+}
+
 void AudioManager::SetInputDevice(const QAudioDeviceInfo &info)
 {
   input_ = std::unique_ptr<QAudioInput>(new QAudioInput(info, QAudioFormat(), this));
@@ -169,14 +233,17 @@ AudioManager::AudioManager() :
   input_file_(nullptr),
   refreshing_devices_(false)
 {
+#ifdef OLIVE_PORTAUDIO
+  low_latency_idle_timer_.setInterval(100);
+  connect(&low_latency_idle_timer_, SIGNAL(timeout()), this, SLOT(OutputNotified()));
+#endif
+
   connect(&refresh_thread_, SIGNAL(ListsReady()), this, SLOT(RefreshThreadDone()));
 
   RefreshDevices();
 
   connect(&output_manager_, SIGNAL(HasSamples()), this, SLOT(OutputManagerHasSamples()));
-  connect(&output_manager_, SIGNAL(SentSamples(QVector<double>)), this, SIGNAL(SentSamples(QVector<double>)));
-
-  output_manager_.SetEnableSendingSamples(true);
+  output_manager_.SetEnableMetering(true);
   output_manager_.open(AudioHybridDevice::ReadOnly);
 }
 
@@ -189,7 +256,11 @@ void AudioManager::RefreshThreadDone()
 
   QString preferred_audio_output = Config::Current()["PreferredAudioOutput"].toString();
 
-  if (output_ == nullptr
+  if ((output_ == nullptr
+#ifdef OLIVE_PORTAUDIO
+       && low_latency_output_ == nullptr
+#endif
+       )
       || (!preferred_audio_output.isEmpty() && output_device_info_.deviceName() != preferred_audio_output)) {
     if (preferred_audio_output.isEmpty()) {
       SetOutputDevice(QAudioDeviceInfo::defaultOutputDevice());
@@ -224,6 +295,14 @@ void AudioManager::RefreshThreadDone()
 
 void AudioManager::OutputManagerHasSamples()
 {
+#ifdef OLIVE_PORTAUDIO
+  if (low_latency_output_ != nullptr) {
+    low_latency_output_->Start();
+    low_latency_idle_timer_.start();
+    return;
+  }
+#endif
+
   if (output_ != nullptr && output_->state() != QAudio::ActiveState) {
     output_->start(&output_manager_);
   }
@@ -236,8 +315,20 @@ void AudioManager::OutputStateChanged(QAudio::State state)
 
 void AudioManager::OutputNotified()
 {
-  if (output_manager_.IsIdle()) {
-    static_cast<QAudioOutput*>(sender())->stop();
+  if (!output_manager_.IsIdle()) {
+    return;
+  }
+
+#ifdef OLIVE_PORTAUDIO
+  if (low_latency_output_ != nullptr) {
+    low_latency_idle_timer_.stop();
+    low_latency_output_->Stop();
+    return;
+  }
+#endif
+
+  if (output_ != nullptr) {
+    output_->stop();
   }
 }
 
@@ -25,10 +25,15 @@
 #include <QAudioInput>
 #include <QAudioOutput>
 #include <QThread>
+#include <QTimer>
 
 #include "audiohybriddevice.h"
 #include "render/audioparams.h"
 
+#ifdef OLIVE_PORTAUDIO
+#include "portaudiooutput.h"
+#endif
+
 /**
  * @brief A thread for refreshing the total list of devices on the system
  *
@@ -57,6 +62,9 @@ private:
  *
  * Wraps around a QAudioOutput and AudioHybridDevice, connecting them together and exposing audio functionality to
  * the rest of the system.
+ *
+ * If "LowLatencyAudio" is set and PortAudio was built in, a PortAudioOutput with a buffer of "AudioBufferSize" frames
+ * is used instead of the QAudioOutput, falling back to the latter if it can't be opened.
  */
 class AudioManager : public QObject
 {
@@ -85,10 +93,23 @@ public:
    */
   void StopOutput();
 
+  /**
+   * @brief Returns how much audio the output has actually played since it started, in microseconds
+   *
+   * Audio still in the device's buffer (or, for the low-latency output, the device's reported latency) is not counted.
+   * This is intended to be used as a playback clock. Returns -1 if nothing is currently being output.
+   */
+  qint64 GetOutputPlayedUSecs();
+
   void SetOutputDevice(const QAudioDeviceInfo& info);
 
   void SetOutputParams(const AudioRenderingParams& params);
 
+  /**
+   * @brief Levels of the audio being output, see AudioMeterTap
+   */
+  AudioMeterTap* meter_tap();
+
   void SetInputDevice(const QAudioDeviceInfo& info);
 
   const QList<QAudioDeviceInfo>& ListInputDevices();
@@ -97,8 +118,6 @@ public:
 signals:
   void DeviceListReady();
 
-  void SentSamples(QVector<double> averages);
-
 private:
   AudioManager();
 
@@ -112,6 +131,19 @@ private:
 
   std::unique_ptr<QAudioOutput> output_;
   QAudioDeviceInfo output_device_info_;
+
+#ifdef OLIVE_PORTAUDIO
+  /**
+   * @brief Stopped before output_manager_ changes what it's outputting, since it reads from PortAudio's thread
+   */
+  std::unique_ptr<PortAudioOutput> low_latency_output_;
+
+  /**
+   * @brief There's no notify() for the low-latency output, so this checks whether it's gone idle instead
+   */
+  QTimer low_latency_idle_timer_;
+#endif
+
   AudioRenderingParams output_params_;
 
   std::unique_ptr<QAudioInput> input_;
@@ -0,0 +1,117 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#include "audiometertap.h"
+
+#include <cstring>
+#include <QtMath>
+
+#include "render/audiokernels.h"
+
+AudioMeterTap::AudioMeterTap() :
+  channel_count_(0),
+  frame_count_(0)
+{
+  for (int i=0;i<kMaxChannels;i++) {
+    peaks_[i].storeRelease(0);
+    sum_squares_[i].storeRelease(0);
+  }
+}
+
+void AudioMeterTap::Measure(const float *samples, int frame_count, int channel_count)
+{
+  if (frame_count <= 0 || channel_count <= 0) {
+    return;
+  }
+
+  // Measure with the full stride, but only keep what fits
+  float peaks[kMaxChannels];
+  float sum_squares[kMaxChannels];
+  int kept_channels = qMin(channel_count, kMaxChannels);
+
+  if (channel_count > kMaxChannels) {
+    // Rare enough that measuring one channel at a time is fine, and still needs no allocation
+    for (int c=0;c<kept_channels;c++) {
+      peaks[c] = 0;
+      sum_squares[c] = 0;
+
+      for (int i=0;i<frame_count;i++) {
+        float s = samples[i * channel_count + c];
+
+        peaks[c] = qMax(peaks[c], qAbs(s));
+        sum_squares[c] += s * s;
+      }
+    }
+  } else {
+    memset(peaks, 0, sizeof(peaks));
+    memset(sum_squares, 0, sizeof(sum_squares));
+
+    olive::kernels::MeasureInterleaved(samples, frame_count, channel_count, peaks, sum_squares);
+  }
+
+  // Only the GUI ever resets these, so a failed exchange just means it took the old values in the meantime
+  for (int c=0;c<kept_channels;c++) {
+    quint32 old_bits;
+
+    do {
+      old_bits = peaks_[c].loadAcquire();
+    } while (BitsToFloat(old_bits) < peaks[c] && !peaks_[c].testAndSetRelease(old_bits, FloatToBits(peaks[c])));
+
+    do {
+      old_bits = sum_squares_[c].loadAcquire();
+    } while (!sum_squares_[c].testAndSetRelease(old_bits, FloatToBits(BitsToFloat(old_bits) + sum_squares[c])));
+  }
+
+  channel_count_.storeRelease(kept_channels);
+  frame_count_.fetchAndAddRelease(frame_count);
+}
+
+int AudioMeterTap::Take(float *peaks, float *rms)
+{
+  int frame_count = frame_count_.fetchAndStoreAcquire(0);
+
+  if (frame_count == 0) {
+    return 0;
+  }
+
+  int channel_count = channel_count_.loadAcquire();
+
+  for (int c=0;c<channel_count;c++) {
+    peaks[c] = BitsToFloat(peaks_[c].fetchAndStoreAcquire(0));
+    rms[c] = qSqrt(BitsToFloat(sum_squares_[c].fetchAndStoreAcquire(0)) / static_cast<float>(frame_count));
+  }
+
+  return channel_count;
+}
+
+quint32 AudioMeterTap::FloatToBits(float f)
+{
+  quint32 i;
+  memcpy(&i, &f, sizeof(i));
+  return i;
+}
+
+float AudioMeterTap::BitsToFloat(quint32 i)
+{
+  float f;
+  memcpy(&f, &i, sizeof(f));
+  return f;
+}
@@ -0,0 +1,82 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#ifndef AUDIOMETERTAP_H
+#define AUDIOMETERTAP_H
+
+#include <QAtomicInteger>
+
+#include "common/constructors.h"
+
+/**
+ * @brief Lock-free collection point for audio meter levels
+ *
+ * The audio output's thread calls Measure() on every buffer it sends, which never blocks or allocates. The GUI calls
+ * Take() on a timer to collect the peak and RMS level of each channel since the last time it looked.
+ */
+class AudioMeterTap
+{
+public:
+  /**
+   * @brief Most channels that can be metered
+   */
+  static const int kMaxChannels = 32;
+
+  AudioMeterTap();
+
+  DISABLE_COPY_MOVE(AudioMeterTap)
+
+  /**
+   * @brief Add `frame_count` frames of interleaved float samples to the levels
+   *
+   * Channels past kMaxChannels are ignored.
+   */
+  void Measure(const float* samples, int frame_count, int channel_count);
+
+  /**
+   * @brief Collect the levels measured since the last call and reset them
+   *
+   * `peaks` and `rms` must hold kMaxChannels values.
+   *
+   * @return
+   *
+   * Number of channels measured, or 0 if nothing has been measured since the last call.
+   */
+  int Take(float* peaks, float* rms);
+
+private:
+  static quint32 FloatToBits(float f);
+
+  static float BitsToFloat(quint32 i);
+
+  QAtomicInt channel_count_;
+
+  QAtomicInt frame_count_;
+
+  /**
+   * @brief Per-channel peak and sum of squares, stored as the bits of a float
+   */
+  QAtomicInteger<quint32> peaks_[kMaxChannels];
+  QAtomicInteger<quint32> sum_squares_[kMaxChannels];
+
+};
+
+#endif // AUDIOMETERTAP_H
@@ -0,0 +1,109 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#include "audioringbuffer.h"
+
+#include <cstring>
+
+AudioRingBuffer::AudioRingBuffer() :
+  mask_(-1),
+  read_pos_(0),
+  write_pos_(0)
+{
+}
+
+void AudioRingBuffer::SetCapacity(qint64 bytes)
+{
+  qint64 capacity = 1;
+
+  while (capacity < bytes) {
+    capacity <<= 1;
+  }
+
+  buffer_.resize(static_cast<int>(capacity));
+  mask_ = capacity - 1;
+
+  Clear();
+}
+
+qint64 AudioRingBuffer::capacity() const
+{
+  return buffer_.size();
+}
+
+qint64 AudioRingBuffer::Write(const char *data, qint64 length)
+{
+  qint64 write_pos = write_pos_.loadAcquire();
+  qint64 count = qMin(length, capacity() - (write_pos - read_pos_.loadAcquire()));
+
+  if (count <= 0) {
+    return 0;
+  }
+
+  // Copy in up to two parts, wrapping around the end of the buffer
+  qint64 start = write_pos & mask_;
+  qint64 first_part = qMin(count, capacity() - start);
+
+  memcpy(buffer_.data() + start, data, static_cast<size_t>(first_part));
+  memcpy(buffer_.data(), data + first_part, static_cast<size_t>(count - first_part));
+
+  // Publish the data only once it's all been copied
+  write_pos_.storeRelease(write_pos + count);
+
+  return count;
+}
+
+qint64 AudioRingBuffer::WriteAvailable() const
+{
+  return capacity() - ReadAvailable();
+}
+
+qint64 AudioRingBuffer::Read(char *data, qint64 length)
+{
+  qint64 read_pos = read_pos_.loadAcquire();
+  qint64 count = qMin(length, write_pos_.loadAcquire() - read_pos);
+
+  if (count <= 0) {
+    return 0;
+  }
+
+  qint64 start = read_pos & mask_;
+  qint64 first_part = qMin(count, capacity() - start);
+
+  memcpy(data, buffer_.constData() + start, static_cast<size_t>(first_part));
+  memcpy(data + first_part, buffer_.constData(), static_cast<size_t>(count - first_part));
+
+  // Hand the space back to the producer only once we're done reading it
+  read_pos_.storeRelease(read_pos + count);
+
+  return count;
+}
+
+qint64 AudioRingBuffer::ReadAvailable() const
+{
+  return write_pos_.loadAcquire() - read_pos_.loadAcquire();
+}
+
+void AudioRingBuffer::Clear()
+{
+  read_pos_.storeRelease(0);
+  write_pos_.storeRelease(0);
+}
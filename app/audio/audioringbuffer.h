@@ -0,0 +1,85 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#ifndef AUDIORINGBUFFER_H
+#define AUDIORINGBUFFER_H
+
+#include <QAtomicInteger>
+#include <QByteArray>
+
+#include "common/constructors.h"
+
+/**
+ * @brief Single-producer/single-consumer lock-free ring buffer of bytes
+ *
+ * One thread may call Write() and WriteAvailable() while another calls Read() and ReadAvailable() at the same time
+ * without either ever blocking. SetCapacity() and Clear() are only safe while neither side is running.
+ */
+class AudioRingBuffer
+{
+public:
+  AudioRingBuffer();
+
+  DISABLE_COPY_MOVE(AudioRingBuffer)
+
+  /**
+   * @brief Set the size of the buffer, rounded up to a power of two, discarding anything in it
+   */
+  void SetCapacity(qint64 bytes);
+
+  qint64 capacity() const;
+
+  /**
+   * @brief Copy up to `length` bytes into the buffer, returning how many bytes fit
+   */
+  qint64 Write(const char* data, qint64 length);
+
+  /**
+   * @brief Number of bytes Write() can currently accept
+   */
+  qint64 WriteAvailable() const;
+
+  /**
+   * @brief Copy up to `length` bytes out of the buffer, returning how many bytes there were
+   */
+  qint64 Read(char* data, qint64 length);
+
+  /**
+   * @brief Number of bytes Read() can currently return
+   */
+  qint64 ReadAvailable() const;
+
+  void Clear();
+
+private:
+  QByteArray buffer_;
+
+  qint64 mask_;
+
+  /**
+   * @brief Total bytes ever read and written, only ever advanced by the consumer and producer respectively
+   */
+  QAtomicInteger<qint64> read_pos_;
+  QAtomicInteger<qint64> write_pos_;
+
+};
+
+#endif // AUDIORINGBUFFER_H
@@ -0,0 +1,231 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "portaudiooutput.h"
+
+#include <cstring>
+#include <portaudio.h>
+#include <QDebug>
+
+int PortAudioOutput::instance_count_ = 0;
+
+PortAudioOutput::PortAudioOutput(QIODevice *source, QObject *parent) :
+  QObject(parent),
+  source_(source),
+  stream_(nullptr),
+  frame_size_(1),
+  sample_rate_(0),
+  latency_usecs_(0),
+  frames_played_(0)
+{
+}
+
+PortAudioOutput::~PortAudioOutput()
+{
+  Close();
+}
+
+bool PortAudioOutput::Open(const QString &device_name, const AudioRenderingParams &params, int buffer_frames)
+{
+  Close();
+
+  PaSampleFormat format;
+
+  switch (params.format()) {
+  case SAMPLE_FMT_U8:
+    format = paUInt8;
+    break;
+  case SAMPLE_FMT_S16:
+    format = paInt16;
+    break;
+  case SAMPLE_FMT_S32:
+    format = paInt32;
+    break;
+  case SAMPLE_FMT_FLT:
+    format = paFloat32;
+    break;
+  default:
+    error_ = tr("PortAudio can't output this sample format");
+    return false;
+  }
+
+  if (instance_count_ == 0) {
+    PaError err = Pa_Initialize();
+
+    if (err != paNoError) {
+      error_ = tr("Failed to initialize PortAudio: %1").arg(Pa_GetErrorText(err));
+      return false;
+    }
+  }
+
+  instance_count_++;
+
+  // Device names aren't the same as Qt's on every platform, so anything that doesn't match uses the default
+  PaDeviceIndex device = Pa_GetDefaultOutputDevice();
+
+  for (PaDeviceIndex i=0;i<Pa_GetDeviceCount();i++) {
+    const PaDeviceInfo* info = Pa_GetDeviceInfo(i);
+
+    if (info->maxOutputChannels > 0 && device_name == QString::fromUtf8(info->name)) {
+      device = i;
+      break;
+    }
+  }
+
+  if (device == paNoDevice) {
+    error_ = tr("There's no audio output device");
+    Close();
+    return false;
+  }
+
+  PaStreamParameters output_params;
+  output_params.device = device;
+  output_params.channelCount = params.channel_count();
+  output_params.sampleFormat = format;
+  output_params.suggestedLatency = Pa_GetDeviceInfo(device)->defaultLowOutputLatency;
+  output_params.hostApiSpecificStreamInfo = nullptr;
+
+  PaError err = Pa_OpenStream(&stream_,
+                              nullptr,
+                              &output_params,
+                              params.sample_rate(),
+                              (buffer_frames > 0) ? static_cast<unsigned long>(buffer_frames)
+                                                  : paFramesPerBufferUnspecified,
+                              paNoFlag,
+                              StreamCallback,
+                              this);
+
+  if (err != paNoError) {
+    error_ = tr("Failed to open audio output: %1").arg(Pa_GetErrorText(err));
+    stream_ = nullptr;
+    Close();
+    return false;
+  }
+
+  frame_size_ = qMax(1, params.samples_to_bytes(1));
+  sample_rate_ = params.sample_rate();
+
+  // Includes the buffer we're asked to fill as well as whatever's after it
+  latency_usecs_ = static_cast<qint64>(Pa_GetStreamInfo(stream_)->outputLatency * 1000000.0);
+
+  qInfo() << "Opened PortAudio output on" << Pa_GetDeviceInfo(device)->name << "with" << latency_usecs_ / 1000
+          << "ms latency";
+
+  return true;
+}
+
+void PortAudioOutput::Close()
+{
+  if (stream_ != nullptr) {
+    Pa_CloseStream(stream_);
+    stream_ = nullptr;
+  }
+
+  if (instance_count_ > 0 && (--instance_count_) == 0) {
+    Pa_Terminate();
+  }
+}
+
+bool PortAudioOutput::IsOpen() const
+{
+  return stream_ != nullptr;
+}
+
+void PortAudioOutput::Start()
+{
+  if (stream_ == nullptr || IsActive()) {
+    return;
+  }
+
+  // A stream that finished by itself still has to be stopped before it can start again
+  if (!Pa_IsStreamStopped(stream_)) {
+    Pa_StopStream(stream_);
+  }
+
+  frames_played_.storeRelease(0);
+
+  PaError err = Pa_StartStream(stream_);
+
+  if (err != paNoError) {
+    qWarning() << "Failed to start audio output:" << Pa_GetErrorText(err);
+  }
+}
+
+void PortAudioOutput::Stop()
+{
+  if (stream_ != nullptr && !Pa_IsStreamStopped(stream_)) {
+    Pa_AbortStream(stream_);
+  }
+}
+
+bool PortAudioOutput::IsActive() const
+{
+  return stream_ != nullptr && Pa_IsStreamActive(stream_) == 1;
+}
+
+qint64 PortAudioOutput::GetLatencyUSecs() const
+{
+  return latency_usecs_;
+}
+
+qint64 PortAudioOutput::GetPlayedUSecs() const
+{
+  if (sample_rate_ == 0) {
+    return 0;
+  }
+
+  qint64 handed_over = frames_played_.loadAcquire() * 1000000 / sample_rate_;
+
+  return qMax(static_cast<qint64>(0), handed_over - latency_usecs_);
+}
+
+const QString &PortAudioOutput::GetError() const
+{
+  return error_;
+}
+
+int PortAudioOutput::StreamCallback(const void *input,
+                                    void *output,
+                                    unsigned long frame_count,
+                                    const PaStreamCallbackTimeInfo *time_info,
+                                    unsigned long status_flags,
+                                    void *user_data)
+{
+  Q_UNUSED(input)
+  Q_UNUSED(time_info)
+  Q_UNUSED(status_flags)
+
+  PortAudioOutput* out = static_cast<PortAudioOutput*>(user_data);
+
+  qint64 wanted = static_cast<qint64>(frame_count) * out->frame_size_;
+
+  // The source always fills the whole buffer, with silence if it has to (see AudioHybridDevice::readData())
+  qint64 read_count = out->source_->read(static_cast<char*>(output), wanted);
+
+  if (read_count < wanted) {
+    memset(static_cast<char*>(output) + qMax(static_cast<qint64>(0), read_count),
+           0,
+           static_cast<size_t>(wanted - qMax(static_cast<qint64>(0), read_count)));
+  }
+
+  out->frames_played_.fetchAndAddRelease(static_cast<qint64>(frame_count));
+
+  return paContinue;
+}
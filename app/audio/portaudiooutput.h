@@ -0,0 +1,126 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PORTAUDIOOUTPUT_H
+#define PORTAUDIOOUTPUT_H
+
+#include <QAtomicInteger>
+#include <QIODevice>
+#include <QObject>
+
+#include "render/audioparams.h"
+
+struct PaStreamCallbackTimeInfo;
+
+/**
+ * @brief Low-latency audio output through PortAudio's callback API
+ *
+ * An alternative to QAudioOutput, whose buffer size (and so latency) is up to Qt and the platform. PortAudio calls
+ * back from its own real-time thread for exactly the number of frames asked for with Open(), which is read from the
+ * source device (an AudioHybridDevice, which never blocks). PortAudio picks the platform's lowest latency API it was
+ * built with (e.g. WASAPI, CoreAudio, JACK or ALSA).
+ *
+ * Only built if PortAudio was found (OLIVE_PORTAUDIO is defined).
+ */
+class PortAudioOutput : public QObject
+{
+  Q_OBJECT
+public:
+  PortAudioOutput(QIODevice* source, QObject* parent = nullptr);
+
+  virtual ~PortAudioOutput() override;
+
+  /**
+   * @brief Open a stream on the output device called `device_name`, or the default one if there isn't one
+   *
+   * @param buffer_frames
+   *
+   * Frames per callback, fewer means less latency but more chance of dropouts. 0 lets PortAudio decide.
+   *
+   * @return
+   *
+   * FALSE if there's no device or it can't output in these parameters, see GetError().
+   */
+  bool Open(const QString& device_name, const AudioRenderingParams& params, int buffer_frames);
+
+  void Close();
+
+  bool IsOpen() const;
+
+  /**
+   * @brief Start calling back for samples, if it isn't already
+   */
+  void Start();
+
+  /**
+   * @brief Stop straight away, dropping whatever the device has buffered
+   */
+  void Stop();
+
+  bool IsActive() const;
+
+  /**
+   * @brief How long after a frame is handed over it's heard, as reported by the device
+   */
+  qint64 GetLatencyUSecs() const;
+
+  /**
+   * @brief How much audio has been heard since Start(), i.e. what's been handed over minus the latency
+   */
+  qint64 GetPlayedUSecs() const;
+
+  const QString& GetError() const;
+
+private:
+  static int StreamCallback(const void* input,
+                            void* output,
+                            unsigned long frame_count,
+                            const PaStreamCallbackTimeInfo* time_info,
+                            unsigned long status_flags,
+                            void* user_data);
+
+  QIODevice* source_;
+
+  /**
+   * @brief The PaStream, kept as void so portaudio.h is only needed in the .cpp
+   */
+  void* stream_;
+
+  int frame_size_;
+
+  int sample_rate_;
+
+  qint64 latency_usecs_;
+
+  /**
+   * @brief Frames handed to the device since Start(), written by the callback thread
+   */
+  QAtomicInteger<qint64> frames_played_;
+
+  QString error_;
+
+  /**
+   * @brief Number of open streams, PortAudio is initialized while there's at least one
+   */
+  static int instance_count_;
+
+};
+
+#endif // PORTAUDIOOUTPUT_H
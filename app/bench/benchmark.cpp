@@ -0,0 +1,481 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "benchmark.h"
+
+#include <QColor>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QEventLoop>
+#include <QFileInfo>
+#include <QThread>
+#include <QTimer>
+
+#include "common/channellayout.h"
+#include "common/timecodefunctions.h"
+#include "decoder/decoder.h"
+#include "node/block/clip/clip.h"
+#include "node/distort/transform/transform.h"
+#include "node/generator/solid/solid.h"
+#include "node/input/media/audio/audio.h"
+#include "node/input/media/video/video.h"
+#include "node/output/timeline/timeline.h"
+#include "node/output/track/track.h"
+#include "project/item/footage/videostream.h"
+#include "render/renderbudget.h"
+
+BenchmarkVideoBackend::BenchmarkVideoBackend(QObject *parent) :
+  OpenGLBackend(parent),
+  frames_(0),
+  rendered_(0),
+  to_write_(0),
+  written_(0),
+  render_usecs_(0),
+  write_usecs_(0)
+{
+}
+
+int BenchmarkVideoBackend::RenderAll(qint64 *render_usecs, qint64 *write_usecs)
+{
+  if (!Init()) {
+    return -1;
+  }
+
+  connect(frame_writer(), SIGNAL(FrameWritten(NodeDependency, QByteArray)), this, SLOT(WriterWroteFrame()), Qt::UniqueConnection);
+
+  // Playing means frames are rendered straight away in order, rather than waiting for edits to settle
+  SetPlaybackSpeed(1);
+
+  timer_.start();
+
+  InvalidateCache(0, SequenceLength());
+
+  // Nothing is dispatched until control returns to the event loop, so this is every frame that will be rendered
+  frames_ = static_cast<int>(GetStatistics().queued_frames);
+  rendered_ = 0;
+  to_write_ = frames_;
+  written_ = 0;
+
+  QEventLoop loop;
+  connect(this, SIGNAL(Finished()), &loop, SLOT(quit()));
+  QTimer::singleShot(Benchmark::kTimeout, &loop, SLOT(quit()));
+  loop.exec();
+
+  SetPlaybackSpeed(0);
+
+  if (written_ < to_write_) {
+    return -1;
+  }
+
+  *render_usecs = render_usecs_;
+  *write_usecs = write_usecs_;
+
+  return frames_;
+}
+
+void BenchmarkVideoBackend::JobFinishedEvent(const RenderResult &result)
+{
+  OpenGLBackend::JobFinishedEvent(result);
+
+  switch (result.type) {
+  case RenderResult::kCompletedFrame:
+    // Frames with nothing in them (e.g. past the end of the clip) aren't written
+    FrameRendered(ValueHasTexture(result.value.Get(NodeParam::kTexture)));
+    break;
+  case RenderResult::kCompletedTiles:
+    FrameRendered(true);
+    break;
+  case RenderResult::kHashAlreadyExists:
+    // Identical to a frame that was already rendered, so it isn't written again
+    FrameRendered(false);
+    break;
+  case RenderResult::kCompletedCache:
+  case RenderResult::kHashAlreadyBeingCached:
+  case RenderResult::kCancelled:
+    break;
+  }
+}
+
+bool BenchmarkVideoBackend::CancelsStaleJobs() const
+{
+  return false;
+}
+
+void BenchmarkVideoBackend::FrameRendered(bool will_be_written)
+{
+  if (!will_be_written) {
+    to_write_--;
+  }
+
+  rendered_++;
+
+  if (rendered_ == frames_) {
+    render_usecs_ = timer_.nsecsElapsed() / 1000;
+  }
+
+  CheckFinished();
+}
+
+void BenchmarkVideoBackend::CheckFinished()
+{
+  if (rendered_ == frames_ && written_ >= to_write_) {
+    write_usecs_ = timer_.nsecsElapsed() / 1000;
+
+    emit Finished();
+  }
+}
+
+void BenchmarkVideoBackend::WriterWroteFrame()
+{
+  written_++;
+
+  CheckFinished();
+}
+
+BenchmarkAudioBackend::BenchmarkAudioBackend(QObject *parent) :
+  AudioBackend(parent),
+  jobs_(0),
+  completed_(0)
+{
+}
+
+qint64 BenchmarkAudioBackend::CacheAll()
+{
+  if (!Init()) {
+    return -1;
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+
+  InvalidateCache(0, SequenceLength());
+
+  // Nothing is dispatched until control returns to the event loop, so this is every job that will be run
+  jobs_ = cache_queue_.size();
+  completed_ = 0;
+
+  if (jobs_ > 0) {
+    QEventLoop loop;
+    connect(this, SIGNAL(Finished()), &loop, SLOT(quit()));
+    QTimer::singleShot(Benchmark::kTimeout, &loop, SLOT(quit()));
+    loop.exec();
+  }
+
+  if (completed_ < jobs_) {
+    return -1;
+  }
+
+  return timer.nsecsElapsed() / 1000;
+}
+
+void BenchmarkAudioBackend::JobFinishedEvent(const RenderResult &result)
+{
+  AudioBackend::JobFinishedEvent(result);
+
+  completed_++;
+
+  if (completed_ == jobs_) {
+    emit Finished();
+  }
+}
+
+Benchmark::Benchmark(QObject *parent) :
+  QObject(parent),
+  frames_(300),
+  synthetic_width_(1920),
+  synthetic_height_(1080),
+  viewer_(nullptr),
+  out_(stdout),
+  run_count_(0)
+{
+  worker_counts_.append(QThread::idealThreadCount());
+  dividers_.append(1);
+}
+
+void Benchmark::SetFrameCount(int frames)
+{
+  frames_ = frames;
+}
+
+void Benchmark::SetWorkerCounts(const QList<int> &counts)
+{
+  worker_counts_ = counts;
+}
+
+void Benchmark::SetDividers(const QList<int> &dividers)
+{
+  dividers_ = dividers;
+}
+
+void Benchmark::SetSyntheticSize(int width, int height)
+{
+  synthetic_width_ = width;
+  synthetic_height_ = height;
+}
+
+bool Benchmark::AddMedia(const QString &filename)
+{
+  FootagePtr footage = std::make_shared<Footage>();
+  footage->set_filename(filename);
+  footage->set_name(QFileInfo(filename).fileName());
+
+  if (!Decoder::ProbeMedia(footage.get())) {
+    qWarning() << "Failed to probe" << filename;
+    return false;
+  }
+
+  foreach (StreamPtr stream, footage->streams()) {
+    if (stream->type() == Stream::kVideo) {
+      media_.append(footage);
+      return true;
+    }
+  }
+
+  qWarning() << filename << "has no video";
+  return false;
+}
+
+void Benchmark::Run()
+{
+  out_ << QString("%1 %2 %3 %4 %5 %6")
+          .arg("media", -24)
+          .arg("test", -14)
+          .arg("divider", 8)
+          .arg("workers", 8)
+          .arg("frames", 8)
+          .arg("fps", 10)
+       << endl;
+
+  if (media_.isEmpty()) {
+    RunRender(nullptr, nullptr, tr("synthetic %1x%2").arg(QString::number(synthetic_width_),
+                                                          QString::number(synthetic_height_)));
+    return;
+  }
+
+  foreach (FootagePtr footage, media_) {
+    StreamPtr video;
+    StreamPtr audio;
+
+    foreach (StreamPtr stream, footage->streams()) {
+      if (!video && stream->type() == Stream::kVideo) {
+        video = stream;
+      } else if (!audio && stream->type() == Stream::kAudio) {
+        audio = stream;
+      }
+    }
+
+    RunDecode(video);
+
+    RunRender(video, audio, footage->name());
+  }
+}
+
+void Benchmark::BuildGraph(StreamPtr video, StreamPtr audio, int seed)
+{
+  graph_.Clear();
+
+  VideoParams video_params;
+  rational length;
+
+  if (video) {
+    VideoStreamPtr video_stream = std::static_pointer_cast<VideoStream>(video);
+
+    video_params = VideoParams(video_stream->width(), video_stream->height(), video_stream->frame_rate().flipped());
+    length = qMin(olive::timestamp_to_time(video->duration(), video->timebase()),
+                  rational(frames_) * video_params.time_base());
+  } else {
+    video_params = VideoParams(synthetic_width_, synthetic_height_, rational(1, 30));
+    length = rational(frames_) * video_params.time_base();
+  }
+
+  // Set up the same nodes a Sequence has
+  viewer_ = new ViewerOutput();
+  viewer_->set_video_params(video_params);
+  viewer_->set_audio_params(AudioParams(48000, AV_CH_LAYOUT_STEREO));
+  graph_.AddNode(viewer_);
+
+  TimelineOutput* timeline = new TimelineOutput();
+  timeline->SetTimebase(video_params.time_base());
+  graph_.AddNode(timeline);
+
+  TrackOutput* video_track = new TrackOutput();
+  graph_.AddNode(video_track);
+
+  TrackOutput* audio_track = new TrackOutput();
+  graph_.AddNode(audio_track);
+
+  NodeParam::ConnectEdge(video_track->output(), viewer_->texture_input());
+  NodeParam::ConnectEdge(audio_track->output(), viewer_->samples_input());
+  NodeParam::ConnectEdge(timeline->output(), viewer_->length_input());
+  NodeParam::ConnectEdge(video_track->output(), timeline->track_input(kTrackTypeVideo));
+  NodeParam::ConnectEdge(audio_track->output(), timeline->track_input(kTrackTypeAudio));
+
+  ClipBlock* video_clip = new ClipBlock();
+  video_clip->set_length(length);
+  graph_.AddNode(video_clip);
+  video_track->AppendBlock(video_clip);
+
+  if (video) {
+    VideoInput* video_input = new VideoInput();
+    video_input->SetFootage(video);
+    graph_.AddNode(video_input);
+    NodeParam::ConnectEdge(video_input->output(), video_clip->texture_input());
+
+    TransformDistort* transform = new TransformDistort();
+    graph_.AddNode(transform);
+    NodeParam::ConnectEdge(transform->output(), video_input->matrix_input());
+  } else {
+    // A different color on every frame so no two frames hash the same, and a different set of colors every time so
+    // nothing is found in the disk cache from an earlier run
+    SolidGenerator* solid = new SolidGenerator();
+    graph_.AddNode(solid);
+    NodeParam::ConnectEdge(solid->output(), video_clip->texture_input());
+
+    QVector<NodeKeyframe> keys;
+    keys.reserve(frames_);
+
+    for (int i=0;i<frames_;i++) {
+      int value = seed * frames_ + i;
+
+      keys.append(NodeKeyframe(rational(i) * video_params.time_base(),
+                               QColor::fromRgb(value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF),
+                               NodeKeyframe::kHold));
+    }
+
+    solid->color_input()->set_is_keyframing(true);
+    solid->color_input()->set_keyframes(keys);
+  }
+
+  if (audio) {
+    ClipBlock* audio_clip = new ClipBlock();
+    audio_clip->set_length(length);
+    graph_.AddNode(audio_clip);
+    audio_track->AppendBlock(audio_clip);
+
+    AudioInput* audio_input = new AudioInput();
+    audio_input->SetFootage(audio);
+    graph_.AddNode(audio_input);
+    NodeParam::ConnectEdge(audio_input->output(), audio_clip->texture_input());
+  }
+}
+
+void Benchmark::RunDecode(StreamPtr stream)
+{
+  rational timebase = std::static_pointer_cast<VideoStream>(stream)->frame_rate().flipped();
+
+  int frames = qMin(frames_, static_cast<int>(olive::time_to_timestamp(olive::timestamp_to_time(stream->duration(),
+                                                                                                stream->timebase()),
+                                                                       timebase)));
+
+  foreach (int divider, dividers_) {
+    DecoderPtr decoder = Decoder::CreateFromID(stream->footage()->decoder());
+    decoder->set_stream(stream);
+
+    // Opening and indexing aren't part of the time per frame
+    if (!decoder->Open()) {
+      qWarning() << "Failed to open" << stream->footage()->filename();
+      return;
+    }
+
+    decoder->Index();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for (int i=0;i<frames;i++) {
+      decoder->RetrieveVideo(olive::timestamp_to_time(i, timebase), divider);
+    }
+
+    PrintResult(stream->footage()->name(), tr("decode"), QString::number(divider), "-", frames, timer.nsecsElapsed() / 1000);
+
+    decoder->Close();
+  }
+}
+
+void Benchmark::RunRender(StreamPtr video, StreamPtr audio, const QString &name)
+{
+  foreach (int workers, worker_counts_) {
+    // Otherwise the budget would cap how many of the workers can run at once
+    RenderBudget::SetThreadCount(workers);
+    RenderBudget::SetGPUContextCount(workers);
+
+    foreach (int divider, dividers_) {
+      BuildGraph(video, audio, run_count_);
+
+      BenchmarkVideoBackend backend;
+      backend.SetThreadCount(workers);
+      backend.SetCacheName(QStringLiteral("olive-bench-%1-%2").arg(QCoreApplication::applicationPid()).arg(run_count_));
+      backend.SetViewerNode(viewer_);
+
+      // The viewer sets its own divider, replace it with ours
+      backend.SetParameters(VideoRenderingParams(viewer_->video_params(), olive::PIX_FMT_RGBA16F, olive::kOffline, divider));
+
+      run_count_++;
+
+      qint64 render_usecs, write_usecs;
+      int frames = backend.RenderAll(&render_usecs, &write_usecs);
+
+      if (frames < 0) {
+        qWarning() << "Rendering" << name << "didn't finish in time";
+        continue;
+      }
+
+      PrintResult(name, tr("render"), QString::number(divider), QString::number(workers), frames, render_usecs);
+      PrintResult(name, tr("render+write"), QString::number(divider), QString::number(workers), frames, write_usecs);
+
+      backend.SetViewerNode(nullptr);
+    }
+
+    if (audio) {
+      BenchmarkAudioBackend backend;
+      backend.SetThreadCount(workers);
+      backend.SetCacheName(QStringLiteral("olive-bench-%1-%2").arg(QCoreApplication::applicationPid()).arg(run_count_));
+      backend.SetViewerNode(viewer_);
+
+      run_count_++;
+
+      qint64 usecs = backend.CacheAll();
+
+      if (usecs < 0) {
+        qWarning() << "Caching audio for" << name << "didn't finish in time";
+      } else {
+        int frames = static_cast<int>(olive::time_to_timestamp(viewer_->Length(), viewer_->video_params().time_base()));
+
+        PrintResult(name, tr("audio"), "-", QString::number(workers), frames, usecs);
+      }
+
+      backend.SetViewerNode(nullptr);
+    }
+  }
+}
+
+void Benchmark::PrintResult(const QString &name, const QString &test, const QString &divider, const QString &workers, int frames, qint64 usecs)
+{
+  double fps = (usecs > 0) ? frames * 1000000.0 / usecs : 0;
+
+  out_ << QString("%1 %2 %3 %4 %5 %6")
+          .arg(name.left(24), -24)
+          .arg(test, -14)
+          .arg(divider, 8)
+          .arg(workers, 8)
+          .arg(frames, 8)
+          .arg(fps, 10, 'f', 1)
+       << endl;
+}
@@ -0,0 +1,215 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QElapsedTimer>
+#include <QTextStream>
+
+#include "node/graph.h"
+#include "node/output/viewer/viewer.h"
+#include "project/item/footage/footage.h"
+#include "render/backend/audio/audiobackend.h"
+#include "render/backend/opengl/openglbackend.h"
+
+/**
+ * @brief An OpenGLBackend that can be told to render a whole sequence and wait until it's done
+ */
+class BenchmarkVideoBackend : public OpenGLBackend
+{
+  Q_OBJECT
+public:
+  BenchmarkVideoBackend(QObject* parent = nullptr);
+
+  /**
+   * @brief Render every frame of the connected viewer and wait for them to be written to the disk cache
+   *
+   * Frames are rendered in order from the start, as if the sequence was being played.
+   *
+   * @param render_usecs
+   *
+   * Time until the last frame was rendered. Since frames are downloaded and written as they're rendered, this
+   * includes any time the workers were held up by the writers.
+   *
+   * @param write_usecs
+   *
+   * Time until the last frame was written to the disk cache.
+   *
+   * @return
+   *
+   * The number of frames rendered, or -1 if rendering didn't finish in time.
+   */
+  int RenderAll(qint64* render_usecs, qint64* write_usecs);
+
+protected:
+  virtual void JobFinishedEvent(const RenderResult& result) override;
+
+  /**
+   * @brief Every frame is counted once it's rendered, so jobs are never abandoned
+   */
+  virtual bool CancelsStaleJobs() const override;
+
+signals:
+  void Finished();
+
+private:
+  /**
+   * @brief Count a frame that a worker has finished with
+   */
+  void FrameRendered(bool will_be_written);
+
+  void CheckFinished();
+
+  QElapsedTimer timer_;
+
+  int frames_;
+
+  int rendered_;
+
+  int to_write_;
+
+  int written_;
+
+  qint64 render_usecs_;
+
+  qint64 write_usecs_;
+
+private slots:
+  void WriterWroteFrame();
+
+};
+
+/**
+ * @brief An AudioBackend that can be told to cache a whole sequence and wait until it's done
+ */
+class BenchmarkAudioBackend : public AudioBackend
+{
+  Q_OBJECT
+public:
+  BenchmarkAudioBackend(QObject* parent = nullptr);
+
+  /**
+   * @brief Cache the connected viewer's audio and wait until it's done
+   *
+   * @return
+   *
+   * Time taken in microseconds, or -1 if caching didn't finish in time.
+   */
+  qint64 CacheAll();
+
+protected:
+  virtual void JobFinishedEvent(const RenderResult& result) override;
+
+signals:
+  void Finished();
+
+private:
+  int jobs_;
+
+  int completed_;
+
+};
+
+/**
+ * @brief Measures decoding and rendering throughput without any of the UI
+ *
+ * Each piece of media (or a synthetic solid color with a different value on every frame if none is given) is put in
+ * a sequence of its own and timed:
+ *
+ * * Decode only: the Decoder is asked for every frame directly, at each divider
+ * * Render, and render + cache write: an OpenGLBackend renders the whole sequence, at each divider and worker count
+ * * Audio: an AudioBackend caches the whole sequence, at each worker count (only for media with audio)
+ *
+ * Every render uses a new cache name so nothing rendered by an earlier run is reused.
+ */
+class Benchmark : public QObject
+{
+  Q_OBJECT
+public:
+  Benchmark(QObject* parent = nullptr);
+
+  void SetFrameCount(int frames);
+
+  void SetWorkerCounts(const QList<int>& counts);
+
+  void SetDividers(const QList<int>& dividers);
+
+  /**
+   * @brief Size of the sequence used for the synthetic media (media on disk uses its own size)
+   */
+  void SetSyntheticSize(int width, int height);
+
+  /**
+   * @brief Probe a file to benchmark
+   *
+   * @return
+   *
+   * FALSE if the file couldn't be probed or has no video.
+   */
+  bool AddMedia(const QString& filename);
+
+  /**
+   * @brief Run every benchmark and print the results to stdout
+   *
+   * Needs an OpenGL context to be current, which the render workers share with.
+   */
+  void Run();
+
+  /**
+   * @brief Time limit for a single render to finish
+   */
+  static const int kTimeout = 600000;
+
+private:
+  /**
+   * @brief Recreate graph_ as a sequence containing just `video` and `audio` (or synthetic media if `video` is null)
+   */
+  void BuildGraph(StreamPtr video, StreamPtr audio, int seed);
+
+  void RunDecode(StreamPtr stream);
+
+  void RunRender(StreamPtr video, StreamPtr audio, const QString& name);
+
+  void PrintResult(const QString& name, const QString& test, const QString& divider, const QString& workers, int frames, qint64 usecs);
+
+  int frames_;
+
+  QList<int> worker_counts_;
+
+  QList<int> dividers_;
+
+  int synthetic_width_;
+
+  int synthetic_height_;
+
+  QList<FootagePtr> media_;
+
+  NodeGraph graph_;
+
+  ViewerOutput* viewer_;
+
+  QTextStream out_;
+
+  int run_count_;
+
+};
+
+#endif // BENCHMARK_H
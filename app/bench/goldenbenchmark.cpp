@@ -0,0 +1,451 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "goldenbenchmark.h"
+
+#include <limits>
+#include <vector>
+#include <OpenImageIO/imageio.h>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTemporaryDir>
+
+#include "config/config.h"
+#include "project/item/sequence/sequence.h"
+#include "project/projectserializer.h"
+#include "render/export/exporter.h"
+
+const double GoldenBenchmark::kDefaultTolerance = 0.004;
+const double GoldenBenchmark::kDefaultThreshold = 10.0;
+
+static Sequence* FirstSequence(Item* item)
+{
+  for (int i=0;i<item->child_count();i++) {
+    Item* child = item->child(i);
+
+    if (child->type() == Item::kSequence) {
+      return static_cast<Sequence*>(child);
+    }
+
+    Sequence* sequence = FirstSequence(child);
+
+    if (sequence != nullptr) {
+      return sequence;
+    }
+  }
+
+  return nullptr;
+}
+
+static QStringList FrameFiles(const QString& folder)
+{
+  return QDir(folder).entryList(QStringList() << "*.exr", QDir::Files, QDir::Name);
+}
+
+static void RemoveFrames(const QString& folder)
+{
+  QDir dir(folder);
+
+  foreach (const QString& frame, FrameFiles(folder)) {
+    dir.remove(frame);
+  }
+}
+
+static QJsonObject ReadJson(const QString& filename)
+{
+  QFile file(filename);
+
+  if (!file.open(QFile::ReadOnly)) {
+    return QJsonObject();
+  }
+
+  return QJsonDocument::fromJson(file.readAll()).object();
+}
+
+GoldenBenchmark::GoldenBenchmark() :
+  update_(false),
+  tolerance_(kDefaultTolerance),
+  threshold_(kDefaultThreshold),
+  runs_(3),
+  out_(stdout),
+  run_count_(0)
+{
+}
+
+void GoldenBenchmark::SetCorpus(const QString &folder)
+{
+  corpus_ = folder;
+}
+
+void GoldenBenchmark::SetUpdate(bool e)
+{
+  update_ = e;
+}
+
+void GoldenBenchmark::SetTolerance(double tolerance)
+{
+  tolerance_ = tolerance;
+}
+
+void GoldenBenchmark::SetThreshold(double percent)
+{
+  threshold_ = percent;
+}
+
+void GoldenBenchmark::SetRuns(int runs)
+{
+  runs_ = runs;
+}
+
+void GoldenBenchmark::SetResultsFile(const QString &filename)
+{
+  results_file_ = filename;
+}
+
+bool GoldenBenchmark::Run()
+{
+  QDir corpus(corpus_);
+
+  QStringList projects = corpus.entryList(QStringList() << "*.ove", QDir::Files, QDir::Name);
+
+  if (projects.isEmpty()) {
+    qWarning() << "No projects found in" << corpus_;
+    return false;
+  }
+
+  QString baselines_filename = corpus.filePath("baselines.json");
+  QJsonObject baselines = ReadJson(baselines_filename);
+
+  // Frames are numbered from 0 so they match up with the golden images however the default changes
+  QVariant start_frame = Config::Current()["ImageSequenceStartFrame"];
+  Config::Current()["ImageSequenceStartFrame"] = 0;
+
+  QTemporaryDir temp;
+
+  QJsonArray results;
+  bool passed = true;
+
+  out_ << QString("%1 %2 %3 %4 %5 %6")
+          .arg("project", -24)
+          .arg("backend", -8)
+          .arg("frames", 8)
+          .arg("fps", 10)
+          .arg("baseline", 10)
+          .arg("result")
+       << endl;
+
+  foreach (const QString& filename, projects) {
+    for (int i=0;i<2;i++) {
+      bool software = (i == 1);
+
+      Result result;
+      result.project = QFileInfo(filename).completeBaseName();
+      result.backend = software ? QStringLiteral("cpu") : QStringLiteral("gpu");
+      result.frames = 0;
+      result.usecs = -1;
+      result.mismatched_frames = 0;
+      result.max_difference = 0;
+
+      QString key = QStringLiteral("%1/%2").arg(result.project, result.backend);
+      QString golden = corpus.filePath(QStringLiteral("golden/%1").arg(key));
+      QString folder = update_ ? golden : QDir(temp.path()).filePath(key);
+
+      QDir().mkpath(folder);
+
+      for (int j=0;j<runs_;j++) {
+        RemoveFrames(folder);
+
+        qint64 usecs = Render(corpus.filePath(filename), software, folder);
+
+        if (usecs < 0) {
+          result.usecs = -1;
+          break;
+        }
+
+        if (result.usecs < 0 || usecs < result.usecs) {
+          result.usecs = usecs;
+        }
+      }
+
+      result.rendered = (result.usecs >= 0);
+      result.baseline_usecs = baselines.contains(key) ? static_cast<qint64>(baselines.value(key).toDouble()) : -1;
+
+      if (result.rendered) {
+        if (update_) {
+          result.frames = FrameFiles(folder).size();
+          baselines.insert(key, static_cast<double>(result.usecs));
+        } else {
+          result.frames = CompareFrames(folder, golden, &result);
+        }
+      }
+
+      if (!result.rendered || result.mismatched_frames > 0 || (!update_ && Regressed(result))) {
+        passed = false;
+      }
+
+      PrintResult(result);
+
+      results.append(ResultToJson(result));
+    }
+  }
+
+  Config::Current()["ImageSequenceStartFrame"] = start_frame;
+  OpenGLBackend::SetSoftwareRendering(false);
+
+  if (update_ && !WriteJson(baselines_filename, baselines)) {
+    passed = false;
+  }
+
+  if (!results_file_.isEmpty()) {
+    QJsonObject root;
+    root.insert("tolerance", tolerance_);
+    root.insert("threshold", threshold_);
+    root.insert("passed", passed);
+    root.insert("results", results);
+
+    if (!WriteJson(results_file_, root)) {
+      passed = false;
+    }
+  }
+
+  return passed;
+}
+
+qint64 GoldenBenchmark::Render(const QString &project, bool software, const QString &folder)
+{
+  ProjectPtr p = ProjectSerializer::Load(project);
+
+  if (p == nullptr) {
+    qWarning() << "Failed to open" << project;
+    return -1;
+  }
+
+  Sequence* sequence = FirstSequence(p->root());
+
+  if (sequence == nullptr) {
+    qWarning() << project << "has no sequences";
+    return -1;
+  }
+
+  sequence->Materialize();
+
+  // Nothing rendered by an earlier run is reused
+  sequence->viewer_output()->set_cache_name(QStringLiteral("olive-golden-%1-%2")
+                                            .arg(QCoreApplication::applicationPid())
+                                            .arg(run_count_));
+  run_count_++;
+
+  OpenGLBackend::SetSoftwareRendering(software);
+
+  Exporter exporter(sequence->viewer_output(), QStringList() << QDir(folder).filePath("#####.exr"));
+
+  QElapsedTimer timer;
+  timer.start();
+
+  bool result = exporter.Run();
+
+  qint64 usecs = timer.nsecsElapsed() / 1000;
+
+  if (!result) {
+    qWarning() << "Failed to render" << project << "-" << exporter.GetError();
+    return -1;
+  }
+
+  return usecs;
+}
+
+int GoldenBenchmark::CompareFrames(const QString &rendered, const QString &golden, GoldenBenchmark::Result *result)
+{
+  QStringList frames = FrameFiles(rendered);
+  QStringList golden_frames = FrameFiles(golden);
+
+  foreach (const QString& frame, golden_frames) {
+    if (!frames.contains(frame)) {
+      qWarning() << result->project << result->backend << "didn't render" << frame;
+      result->mismatched_frames++;
+    }
+  }
+
+  foreach (const QString& frame, frames) {
+    if (!golden_frames.contains(frame)) {
+      qWarning() << result->project << result->backend << "has no golden image for" << frame;
+      result->mismatched_frames++;
+      continue;
+    }
+
+    double difference = ImageDifference(QDir(rendered).filePath(frame), QDir(golden).filePath(frame));
+
+    if (difference < 0) {
+      qWarning() << result->project << result->backend << "couldn't compare" << frame << "to its golden image";
+      result->mismatched_frames++;
+      continue;
+    }
+
+    if (difference > tolerance_) {
+      qWarning() << result->project << result->backend << frame << "differs from its golden image by" << difference;
+      result->mismatched_frames++;
+    }
+
+    result->max_difference = qMax(result->max_difference, difference);
+  }
+
+  return frames.size();
+}
+
+double GoldenBenchmark::ImageDifference(const QString &a, const QString &b)
+{
+  auto in_a = OIIO::ImageInput::open(a.toStdString());
+  auto in_b = OIIO::ImageInput::open(b.toStdString());
+
+  if (!in_a || !in_b) {
+    return -1;
+  }
+
+  const OIIO::ImageSpec& spec = in_a->spec();
+
+  if (spec.width != in_b->spec().width
+      || spec.height != in_b->spec().height
+      || spec.nchannels != in_b->spec().nchannels) {
+    in_a->close();
+    in_b->close();
+    return -1;
+  }
+
+  size_t count = static_cast<size_t>(spec.width) * static_cast<size_t>(spec.height) * static_cast<size_t>(spec.nchannels);
+
+  std::vector<float> pixels_a(count);
+  std::vector<float> pixels_b(count);
+
+  bool read = in_a->read_image(OIIO::TypeDesc::FLOAT, pixels_a.data())
+      && in_b->read_image(OIIO::TypeDesc::FLOAT, pixels_b.data());
+
+  in_a->close();
+  in_b->close();
+
+  if (!read) {
+    return -1;
+  }
+
+  double difference = 0;
+
+  for (size_t i=0;i<count;i++) {
+    float pa = pixels_a[i];
+    float pb = pixels_b[i];
+
+    // Also covers matching infinities, whose difference would be NaN
+    if (pa == pb || (qIsNaN(pa) && qIsNaN(pb))) {
+      continue;
+    }
+
+    double d = qAbs(static_cast<double>(pa) - static_cast<double>(pb));
+
+    if (qIsNaN(d)) {
+      // NaN in only one of them
+      return std::numeric_limits<double>::max();
+    }
+
+    difference = qMax(difference, d);
+  }
+
+  return difference;
+}
+
+bool GoldenBenchmark::Regressed(const GoldenBenchmark::Result &result) const
+{
+  return result.rendered
+      && result.baseline_usecs > 0
+      && static_cast<double>(result.usecs) > static_cast<double>(result.baseline_usecs) * (1.0 + threshold_ / 100.0);
+}
+
+QJsonObject GoldenBenchmark::ResultToJson(const GoldenBenchmark::Result &result)
+{
+  QJsonObject object;
+
+  object.insert("project", result.project);
+  object.insert("backend", result.backend);
+  object.insert("rendered", result.rendered);
+  object.insert("frames", result.frames);
+  object.insert("usecs", static_cast<double>(result.usecs));
+  object.insert("baseline_usecs", static_cast<double>(result.baseline_usecs));
+  object.insert("mismatched_frames", result.mismatched_frames);
+  object.insert("max_difference", result.max_difference);
+
+  return object;
+}
+
+void GoldenBenchmark::PrintResult(const GoldenBenchmark::Result &result)
+{
+  double fps = (result.usecs > 0) ? result.frames * 1000000.0 / static_cast<double>(result.usecs) : 0;
+
+  QString change = "-";
+
+  if (result.rendered && result.baseline_usecs > 0) {
+    double percent = static_cast<double>(result.usecs - result.baseline_usecs) * 100.0
+        / static_cast<double>(result.baseline_usecs);
+
+    change = QStringLiteral("%1%2%").arg(percent >= 0 ? "+" : "").arg(percent, 0, 'f', 1);
+  }
+
+  QString status;
+
+  if (!result.rendered) {
+    status = "FAILED";
+  } else if (update_) {
+    status = "updated";
+  } else if (result.mismatched_frames > 0) {
+    status = QStringLiteral("MISMATCH (%1 frames, max difference %2)")
+        .arg(QString::number(result.mismatched_frames), QString::number(result.max_difference));
+  } else if (Regressed(result)) {
+    status = "REGRESSED";
+  } else {
+    status = "ok";
+  }
+
+  out_ << QString("%1 %2 %3 %4 %5 %6")
+          .arg(result.project.left(24), -24)
+          .arg(result.backend, -8)
+          .arg(result.frames, 8)
+          .arg(fps, 10, 'f', 1)
+          .arg(change, 10)
+          .arg(status)
+       << endl;
+}
+
+bool GoldenBenchmark::WriteJson(const QString &filename, const QJsonObject &object)
+{
+  QFile file(filename);
+
+  if (!file.open(QFile::WriteOnly)) {
+    qWarning() << "Failed to write" << filename;
+    return false;
+  }
+
+  file.write(QJsonDocument(object).toJson());
+
+  file.close();
+
+  return true;
+}
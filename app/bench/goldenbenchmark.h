@@ -0,0 +1,150 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef GOLDENBENCHMARK_H
+#define GOLDENBENCHMARK_H
+
+#include <QJsonObject>
+#include <QStringList>
+#include <QTextStream>
+
+/**
+ * @brief Renders a corpus of projects, checking the frames against golden images and the time against baselines
+ *
+ * A corpus is a folder of projects. The first sequence of each is exported as an OpenEXR sequence on the GPU and on
+ * the CPU (see OpenGLBackend::SetSoftwareRendering()), and the frames are compared to the ones in
+ * golden/<project>/<backend>/ within the tolerance. The export is timed too (fastest of however many runs) and
+ * compared to the time in baselines.json, anything slower by more than the threshold is a regression.
+ *
+ * Run with SetUpdate() to render the golden images and baselines instead, e.g. after a change that's meant to alter
+ * the output.
+ */
+class GoldenBenchmark
+{
+public:
+  GoldenBenchmark();
+
+  void SetCorpus(const QString& folder);
+
+  /**
+   * @brief Write the golden images and baselines from this run rather than comparing against them (FALSE by default)
+   */
+  void SetUpdate(bool e);
+
+  /**
+   * @brief Largest difference allowed in any channel of any pixel (default kDefaultTolerance)
+   */
+  void SetTolerance(double tolerance);
+
+  /**
+   * @brief Percentage slower than the baseline a render can be before it's a regression (default kDefaultThreshold)
+   */
+  void SetThreshold(double percent);
+
+  /**
+   * @brief Number of times each project is rendered on each backend, the fastest is kept (default 3)
+   */
+  void SetRuns(int runs);
+
+  /**
+   * @brief Also write every result (and whether it regressed) to this file as JSON
+   */
+  void SetResultsFile(const QString& filename);
+
+  /**
+   * @brief Render every project in the corpus and print the results to stdout
+   *
+   * Needs an OpenGL context to be current, which the render workers share with.
+   *
+   * @return
+   *
+   * FALSE if any project failed to render, didn't match its golden images or regressed.
+   */
+  bool Run();
+
+  static const double kDefaultTolerance;
+
+  static const double kDefaultThreshold;
+
+private:
+  struct Result {
+    QString project;
+    QString backend;
+    int frames;
+    qint64 usecs;
+
+    /// -1 if there's no baseline for this project and backend yet
+    qint64 baseline_usecs;
+
+    int mismatched_frames;
+    double max_difference;
+    bool rendered;
+  };
+
+  /**
+   * @brief Export the first sequence of `project` as an OpenEXR sequence into `folder`
+   *
+   * @return
+   *
+   * Time taken in microseconds, or -1 if it failed.
+   */
+  qint64 Render(const QString& project, bool software, const QString& folder);
+
+  /**
+   * @brief Compare every frame in `rendered` to the one of the same name in `golden`
+   *
+   * @return
+   *
+   * Number of frames rendered.
+   */
+  int CompareFrames(const QString& rendered, const QString& golden, Result* result);
+
+  /**
+   * @brief Largest difference between any channel of any pixel of two images, or -1 if they can't be compared
+   */
+  static double ImageDifference(const QString& a, const QString& b);
+
+  bool Regressed(const Result& result) const;
+
+  static QJsonObject ResultToJson(const Result& result);
+
+  void PrintResult(const Result& result);
+
+  static bool WriteJson(const QString& filename, const QJsonObject& object);
+
+  QString corpus_;
+
+  bool update_;
+
+  double tolerance_;
+
+  double threshold_;
+
+  int runs_;
+
+  QString results_file_;
+
+  QTextStream out_;
+
+  int run_count_;
+
+};
+
+#endif // GOLDENBENCHMARK_H
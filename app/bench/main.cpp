@@ -0,0 +1,300 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavfilter/avfilter.h>
+}
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QRegularExpression>
+#include <QSurfaceFormat>
+
+#include "benchmark.h"
+#include "config/config.h"
+#include "decoder/frame.h"
+#include "goldenbenchmark.h"
+#include "microbenchmark.h"
+#include "render/backend/rendersiblingjob.h"
+#include "render/backend/software/softwaretexture.h"
+#include "render/colormanager.h"
+#include "render/diskcachemanager.h"
+
+/**
+ * @brief Parse a comma-separated list of positive integers, returning an empty list if any of them are invalid
+ */
+QList<int> ParseIntList(const QString& s)
+{
+  QList<int> list;
+
+  foreach (const QString& item, s.split(',', QString::SkipEmptyParts)) {
+    bool ok;
+    int value = item.toInt(&ok);
+
+    if (!ok || value <= 0) {
+      return QList<int>();
+    }
+
+    list.append(value);
+  }
+
+  return list;
+}
+
+int main(int argc, char *argv[]) {
+  QApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
+
+  // Same OpenGL profile as the editor
+  QSurfaceFormat format;
+  format.setVersion(3, 2);
+  format.setDepthBufferSize(24);
+  format.setProfile(QSurfaceFormat::CoreProfile);
+  QSurfaceFormat::setDefaultFormat(format);
+
+  // A QApplication is needed for the QObjects the render pipeline uses, but no window is ever shown (use
+  // -platform offscreen on machines without a display)
+  QApplication a(argc, argv);
+
+  QCoreApplication::setOrganizationName("olivevideoeditor.org");
+  QCoreApplication::setOrganizationDomain("olivevideoeditor.org");
+  QCoreApplication::setApplicationName("Olive");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Measures Olive's decode and render throughput, or checks renders against golden "
+                                   "images and timing baselines.");
+  parser.addHelpOption();
+  parser.addPositionalArgument("[media...]", "Files to benchmark (a synthetic solid color is used if none are given)");
+
+  QCommandLineOption frames_option("frames", "Number of frames to decode and render (default 300)", "count", "300");
+  parser.addOption(frames_option);
+
+  QCommandLineOption workers_option("workers", "Comma-separated render worker counts (default one per CPU core)", "counts");
+  parser.addOption(workers_option);
+
+  QCommandLineOption dividers_option("dividers", "Comma-separated resolution dividers (default 1)", "dividers", "1");
+  parser.addOption(dividers_option);
+
+  QCommandLineOption size_option("size", "Size of the synthetic media (default 1920x1080)", "WxH", "1920x1080");
+  parser.addOption(size_option);
+
+  QCommandLineOption micro_option("micro", "Run the data structure micro-benchmarks instead");
+  parser.addOption(micro_option);
+
+  QCommandLineOption filter_option("filter", "Only run micro-benchmarks whose name matches this pattern", "regex");
+  parser.addOption(filter_option);
+
+  QCommandLineOption min_time_option("min-time", "Minimum time per micro-benchmark in milliseconds (default 500)",
+                                     "msecs", "500");
+  parser.addOption(min_time_option);
+
+  QCommandLineOption golden_option("golden", "Render every project in this folder on the GPU and CPU, comparing the "
+                                            "frames to its golden images and the times to its baselines", "folder");
+  parser.addOption(golden_option);
+
+  QCommandLineOption update_golden_option("update-golden", "Write the golden images and baselines with --golden "
+                                                           "rather than comparing against them");
+  parser.addOption(update_golden_option);
+
+  QCommandLineOption tolerance_option("tolerance", QStringLiteral("Largest difference allowed per channel with "
+                                                                  "--golden (default %1)")
+                                      .arg(GoldenBenchmark::kDefaultTolerance), "difference");
+  parser.addOption(tolerance_option);
+
+  QCommandLineOption threshold_option("threshold", QStringLiteral("Percentage slower than the baseline that's a "
+                                                                  "regression with --golden (default %1)")
+                                      .arg(GoldenBenchmark::kDefaultThreshold), "percent");
+  parser.addOption(threshold_option);
+
+  QCommandLineOption runs_option("runs", "Times to render each project with --golden, the fastest is kept (default 3)",
+                                 "count", "3");
+  parser.addOption(runs_option);
+
+  QCommandLineOption results_option("results", "Write the --golden results to this file as JSON", "file");
+  parser.addOption(results_option);
+
+  parser.process(a);
+
+  if (parser.isSet(micro_option)) {
+    MicroBenchmark micro;
+
+    int min_time = parser.value(min_time_option).toInt();
+
+    if (min_time <= 0) {
+      qCritical() << "Invalid minimum time";
+      return 1;
+    }
+
+    if (!QRegularExpression(parser.value(filter_option)).isValid()) {
+      qCritical() << "Invalid filter";
+      return 1;
+    }
+
+    micro.SetMinTime(min_time);
+    micro.SetFilter(parser.value(filter_option));
+    micro.Run();
+
+    return 0;
+  }
+
+  Benchmark benchmark;
+
+  int frames = parser.value(frames_option).toInt();
+
+  if (frames <= 0) {
+    qCritical() << "Invalid frame count";
+    return 1;
+  }
+
+  benchmark.SetFrameCount(frames);
+
+  if (parser.isSet(workers_option)) {
+    QList<int> workers = ParseIntList(parser.value(workers_option));
+
+    if (workers.isEmpty()) {
+      qCritical() << "Invalid worker counts";
+      return 1;
+    }
+
+    benchmark.SetWorkerCounts(workers);
+  }
+
+  QList<int> dividers = ParseIntList(parser.value(dividers_option));
+
+  if (dividers.isEmpty()) {
+    qCritical() << "Invalid dividers";
+    return 1;
+  }
+
+  benchmark.SetDividers(dividers);
+
+  QStringList size = parser.value(size_option).split('x');
+
+  if (size.size() != 2 || size.at(0).toInt() <= 0 || size.at(1).toInt() <= 0) {
+    qCritical() << "Invalid size";
+    return 1;
+  }
+
+  benchmark.SetSyntheticSize(size.at(0).toInt(), size.at(1).toInt());
+
+  GoldenBenchmark golden;
+
+  if (parser.isSet(golden_option)) {
+    golden.SetCorpus(parser.value(golden_option));
+    golden.SetUpdate(parser.isSet(update_golden_option));
+    golden.SetResultsFile(parser.value(results_option));
+
+    if (parser.isSet(tolerance_option)) {
+      bool ok;
+      double tolerance = parser.value(tolerance_option).toDouble(&ok);
+
+      if (!ok || tolerance < 0) {
+        qCritical() << "Invalid tolerance";
+        return 1;
+      }
+
+      golden.SetTolerance(tolerance);
+    }
+
+    if (parser.isSet(threshold_option)) {
+      bool ok;
+      double threshold = parser.value(threshold_option).toDouble(&ok);
+
+      if (!ok || threshold < 0) {
+        qCritical() << "Invalid threshold";
+        return 1;
+      }
+
+      golden.SetThreshold(threshold);
+    }
+
+    int runs = parser.value(runs_option).toInt();
+
+    if (runs <= 0) {
+      qCritical() << "Invalid run count";
+      return 1;
+    }
+
+    golden.SetRuns(runs);
+  }
+
+  // Register FFmpeg codecs and filters (deprecated in 4.0+)
+#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 9, 100)
+  av_register_all();
+#endif
+#if LIBAVFILTER_VERSION_INT < AV_VERSION_INT(7, 14, 100)
+  avfilter_register_all();
+#endif
+
+  // Types sent between the backends and their workers
+  qRegisterMetaType<NodeDependency>();
+  qRegisterMetaType<rational>();
+  qRegisterMetaType<FramePtr>();
+  qRegisterMetaType<OpenGLTexturePtr>();
+  qRegisterMetaType<SoftwareTexturePtr>();
+  qRegisterMetaType<NodeValueTable>();
+  qRegisterMetaType<RenderSiblingJobPtr>();
+
+  DiskCacheManager::CreateInstance();
+  DiskCacheManager::instance()->SetQuota(Config::Current()["DiskCacheSize"].toLongLong() * 1024 * 1024);
+  DiskCacheManager::instance()->SetConformQuota(Config::Current()["ConformCacheSize"].toLongLong() * 1024 * 1024);
+
+  ColorManager::CreateInstance();
+
+  int exit_code = 0;
+
+  foreach (const QString& filename, parser.positionalArguments()) {
+    if (!benchmark.AddMedia(filename)) {
+      exit_code = 1;
+    }
+  }
+
+  // The render workers share with whichever context is current when they start
+  QOffscreenSurface surface;
+  surface.create();
+
+  QOpenGLContext context;
+
+  if (exit_code == 0 && (!context.create() || !context.makeCurrent(&surface))) {
+    qCritical() << "Failed to create an OpenGL context";
+    exit_code = 1;
+  }
+
+  if (exit_code == 0) {
+    if (parser.isSet(golden_option)) {
+      if (!golden.Run()) {
+        exit_code = 1;
+      }
+    } else {
+      benchmark.Run();
+    }
+
+    context.doneCurrent();
+  }
+
+  ColorManager::DestroyInstance();
+
+  DiskCacheManager::DestroyInstance();
+
+  return exit_code;
+}
@@ -0,0 +1,527 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "microbenchmark.h"
+
+#include <QThreadPool>
+
+#include "common/timerange.h"
+#include "node/block/gap/gap.h"
+#include "node/graph.h"
+#include "node/input.h"
+#include "node/output/track/track.h"
+#include "node/value.h"
+#include "render/backend/videorenderframecache.h"
+
+/**
+ * @brief Number of precomputed operands benchmarks cycle through
+ *
+ * Large enough that branches don't become perfectly predictable, small enough to stay in the CPU cache.
+ */
+static const int kOperandCount = 1024;
+
+/**
+ * @brief Index of the `i`th operand out of `count`, visited in a scattered but repeatable order
+ */
+static int ScatteredIndex(qint64 i, int count)
+{
+  return static_cast<int>((i * 7919) % count);
+}
+
+static QVector<rational> MakeRationals()
+{
+  QVector<rational> list(kOperandCount);
+
+  for (int i=0;i<kOperandCount;i++) {
+    // Mix of common timebases so normalizing actually has work to do
+    static const int denominators[] = {24, 25, 30, 48000, 1001};
+
+    list[i] = rational(i * 37 + 1, denominators[i % 5]);
+  }
+
+  return list;
+}
+
+static void BenchRationalAdd(MicroState& state)
+{
+  QVector<rational> operands = MakeRationals();
+
+  state.StartTiming();
+
+  for (qint64 i=0;i<state.iterations();i++) {
+    rational r = operands.at(i % kOperandCount) + operands.at(ScatteredIndex(i, kOperandCount));
+    MicroState::Consume(&r);
+  }
+
+  state.StopTiming();
+}
+
+static void BenchRationalMultiply(MicroState& state)
+{
+  QVector<rational> operands = MakeRationals();
+
+  state.StartTiming();
+
+  for (qint64 i=0;i<state.iterations();i++) {
+    rational r = operands.at(i % kOperandCount) * operands.at(ScatteredIndex(i, kOperandCount));
+    MicroState::Consume(&r);
+  }
+
+  state.StopTiming();
+}
+
+static void BenchRationalCompare(MicroState& state)
+{
+  QVector<rational> operands = MakeRationals();
+
+  state.StartTiming();
+
+  for (qint64 i=0;i<state.iterations();i++) {
+    bool r = operands.at(i % kOperandCount) < operands.at(ScatteredIndex(i, kOperandCount));
+    MicroState::Consume(&r);
+  }
+
+  state.StopTiming();
+}
+
+static void BenchRationalEquals(MicroState& state)
+{
+  QVector<rational> operands = MakeRationals();
+
+  state.StartTiming();
+
+  for (qint64 i=0;i<state.iterations();i++) {
+    bool r = operands.at(i % kOperandCount) == operands.at(ScatteredIndex(i, kOperandCount));
+    MicroState::Consume(&r);
+  }
+
+  state.StopTiming();
+}
+
+static void BenchRationalToDouble(MicroState& state)
+{
+  QVector<rational> operands = MakeRationals();
+
+  state.StartTiming();
+
+  for (qint64 i=0;i<state.iterations();i++) {
+    double r = operands.at(ScatteredIndex(i, kOperandCount)).toDouble();
+    MicroState::Consume(&r);
+  }
+
+  state.StopTiming();
+}
+
+static QVector<TimeRange> MakeTimeRanges()
+{
+  QVector<TimeRange> list(kOperandCount);
+
+  for (int i=0;i<kOperandCount;i++) {
+    rational in(i * 13, 30);
+    list[i] = TimeRange(in, in + rational(i % 50 + 1, 30));
+  }
+
+  return list;
+}
+
+static void BenchTimeRangeOverlaps(MicroState& state)
+{
+  QVector<TimeRange> operands = MakeTimeRanges();
+
+  state.StartTiming();
+
+  for (qint64 i=0;i<state.iterations();i++) {
+    bool r = operands.at(i % kOperandCount).OverlapsWith(operands.at(ScatteredIndex(i, kOperandCount)));
+    MicroState::Consume(&r);
+  }
+
+  state.StopTiming();
+}
+
+static void BenchTimeRangeCombine(MicroState& state)
+{
+  QVector<TimeRange> operands = MakeTimeRanges();
+
+  state.StartTiming();
+
+  for (qint64 i=0;i<state.iterations();i++) {
+    TimeRange r = TimeRange::Combine(operands.at(i % kOperandCount), operands.at(ScatteredIndex(i, kOperandCount)));
+    MicroState::Consume(&r);
+  }
+
+  state.StopTiming();
+}
+
+/**
+ * @brief A table of `count` values of alternating types, with a single kFloat at the bottom
+ */
+static NodeValueTable MakeTable(int count)
+{
+  NodeValueTable table;
+
+  table.Push(NodeParam::kFloat, 1.0f);
+
+  for (int i=1;i<count;i++) {
+    table.Push((i % 2) ? NodeParam::kTexture : NodeParam::kSamples, i);
+  }
+
+  return table;
+}
+
+static void BenchValueTablePush(MicroState& state)
+{
+  state.StartTiming();
+
+  for (qint64 i=0;i<state.iterations();i++) {
+    NodeValueTable table;
+
+    for (int j=0;j<state.arg();j++) {
+      table.Push(NodeParam::kFloat, j);
+    }
+
+    MicroState::Consume(&table);
+  }
+
+  state.StopTiming();
+}
+
+static void BenchValueTableGet(MicroState& state)
+{
+  NodeValueTable table = MakeTable(state.arg());
+
+  state.StartTiming();
+
+  for (qint64 i=0;i<state.iterations();i++) {
+    // Worst case, the only match is the one pushed first
+    QVariant r = table.Get(NodeParam::kFloat);
+    MicroState::Consume(&r);
+  }
+
+  state.StopTiming();
+}
+
+static void BenchValueTableMerge(MicroState& state)
+{
+  QList<NodeValueTable> tables;
+
+  for (int i=0;i<state.arg();i++) {
+    tables.append(MakeTable(4));
+  }
+
+  state.StartTiming();
+
+  for (qint64 i=0;i<state.iterations();i++) {
+    NodeValueTable r = NodeValueTable::Merge(tables);
+    MicroState::Consume(&r);
+  }
+
+  state.StopTiming();
+}
+
+static void RunKeyframeValueAtTime(MicroState& state, NodeKeyframe::Type type)
+{
+  NodeInput input("bench");
+  input.set_data_type(NodeParam::kFloat);
+  input.set_is_keyframing(true);
+
+  QVector<NodeKeyframe> keys(state.arg());
+
+  for (int i=0;i<state.arg();i++) {
+    keys[i] = NodeKeyframe(rational(i), static_cast<float>(i % 7), type);
+
+    // Ease in and out of every keyframe
+    keys[i].set_bezier_control_in(QPointF(-0.4, 0.0));
+    keys[i].set_bezier_control_out(QPointF(0.4, 0.0));
+  }
+
+  input.set_keyframes(keys);
+
+  // Times between keyframes so every lookup has to interpolate
+  QVector<rational> times(kOperandCount);
+
+  for (int i=0;i<kOperandCount;i++) {
+    times[i] = rational(ScatteredIndex(i, state.arg() - 1) * 2 + 1, 2);
+  }
+
+  state.StartTiming();
+
+  for (qint64 i=0;i<state.iterations();i++) {
+    QVariant r = input.get_value_at_time(times.at(i % kOperandCount));
+    MicroState::Consume(&r);
+  }
+
+  state.StopTiming();
+}
+
+static void BenchKeyframeValueAtTime(MicroState& state)
+{
+  RunKeyframeValueAtTime(state, NodeKeyframe::kLinear);
+}
+
+static void BenchKeyframeBezierValueAtTime(MicroState& state)
+{
+  RunKeyframeValueAtTime(state, NodeKeyframe::kBezier);
+}
+
+static void BenchTrackBlockAtTime(MicroState& state)
+{
+  NodeGraph graph;
+
+  TrackOutput* track = new TrackOutput();
+  graph.AddNode(track);
+
+  // Not connected to anything, but no need to work out what to invalidate for each block either
+  track->BlockInvalidateCache();
+
+  for (int i=0;i<state.arg();i++) {
+    GapBlock* gap = new GapBlock();
+    gap->set_length(rational(1 + i % 3));
+    track->AppendBlock(gap);
+  }
+
+  track->UnblockInvalidateCache();
+
+  QVector<rational> times(kOperandCount);
+
+  for (int i=0;i<kOperandCount;i++) {
+    times[i] = track->track_length() * rational(ScatteredIndex(i, kOperandCount), kOperandCount);
+  }
+
+  state.StartTiming();
+
+  for (qint64 i=0;i<state.iterations();i++) {
+    Block* r = track->BlockAtTime(times.at(i % kOperandCount));
+    MicroState::Consume(r);
+  }
+
+  state.StopTiming();
+}
+
+/**
+ * @brief Reserves and releases frames like a render worker does, as fast as it can
+ */
+class TryCacheTask : public QRunnable
+{
+public:
+  TryCacheTask(VideoRenderFrameCache* cache, int thread, qint64 iterations) :
+    cache_(cache),
+    iterations_(iterations)
+  {
+    hashes_.resize(kOperandCount);
+
+    for (int i=0;i<kOperandCount;i++) {
+      hashes_[i] = QByteArray::number(thread * kOperandCount + i).rightJustified(16, '0');
+    }
+
+    frame_offset_ = thread * kOperandCount;
+  }
+
+  virtual void run() override
+  {
+    for (qint64 i=0;i<iterations_;i++) {
+      int index = static_cast<int>(i % kOperandCount);
+
+      if (cache_->TryCache(hashes_.at(index))) {
+        cache_->SetHash(frame_offset_ + index, hashes_.at(index));
+      }
+    }
+  }
+
+private:
+  VideoRenderFrameCache* cache_;
+
+  qint64 iterations_;
+
+  QVector<QByteArray> hashes_;
+
+  int frame_offset_;
+
+};
+
+/**
+ * @brief Total throughput of `arg` threads reserving frames at once (iterations are split between them)
+ */
+static void BenchFrameCacheTryCache(MicroState& state)
+{
+  VideoRenderFrameCache cache;
+
+  QThreadPool pool;
+  pool.setMaxThreadCount(state.arg());
+
+  QList<TryCacheTask*> tasks;
+
+  for (int i=0;i<state.arg();i++) {
+    TryCacheTask* task = new TryCacheTask(&cache, i, state.iterations() / state.arg());
+    task->setAutoDelete(false);
+    tasks.append(task);
+  }
+
+  state.StartTiming();
+
+  foreach (TryCacheTask* task, tasks) {
+    pool.start(task);
+  }
+
+  pool.waitForDone();
+
+  state.StopTiming();
+
+  qDeleteAll(tasks);
+}
+
+static volatile const void* consumed_result = nullptr;
+
+MicroState::MicroState(qint64 iterations, int arg) :
+  iterations_(iterations),
+  arg_(arg),
+  elapsed_nsecs_(0)
+{
+}
+
+qint64 MicroState::iterations() const
+{
+  return iterations_;
+}
+
+int MicroState::arg() const
+{
+  return arg_;
+}
+
+void MicroState::StartTiming()
+{
+  timer_.start();
+}
+
+void MicroState::StopTiming()
+{
+  elapsed_nsecs_ = timer_.nsecsElapsed();
+}
+
+qint64 MicroState::elapsed_nsecs() const
+{
+  return elapsed_nsecs_;
+}
+
+void MicroState::Consume(const void *result)
+{
+  // Writing the address somewhere the compiler can't see through forces the result to actually be computed
+  consumed_result = result;
+}
+
+MicroBenchmark::MicroBenchmark() :
+  min_nsecs_(500000000),
+  out_(stdout)
+{
+  AddCase("rational/add", BenchRationalAdd);
+  AddCase("rational/multiply", BenchRationalMultiply);
+  AddCase("rational/less_than", BenchRationalCompare);
+  AddCase("rational/equals", BenchRationalEquals);
+  AddCase("rational/to_double", BenchRationalToDouble);
+
+  AddCase("timerange/overlaps", BenchTimeRangeOverlaps);
+  AddCase("timerange/combine", BenchTimeRangeCombine);
+
+  AddCase("valuetable/push", BenchValueTablePush, {1, 8, 64});
+  AddCase("valuetable/get", BenchValueTableGet, {1, 8, 64});
+  AddCase("valuetable/merge", BenchValueTableMerge, {2, 8, 32});
+
+  AddCase("input/value_at_time", BenchKeyframeValueAtTime, {2, 16, 256, 4096});
+  AddCase("input/bezier_value_at_time", BenchKeyframeBezierValueAtTime, {2, 16, 256, 4096});
+
+  AddCase("track/block_at_time", BenchTrackBlockAtTime, {16, 256, 4096});
+
+  AddCase("framecache/try_cache", BenchFrameCacheTryCache, {1, 2, 4, 8});
+}
+
+void MicroBenchmark::SetFilter(const QString &pattern)
+{
+  filter_.setPattern(pattern);
+}
+
+void MicroBenchmark::SetMinTime(int msecs)
+{
+  min_nsecs_ = static_cast<qint64>(msecs) * 1000000;
+}
+
+void MicroBenchmark::Run()
+{
+  out_ << QString("%1 %2 %3")
+          .arg("benchmark", -32)
+          .arg("iterations", 12)
+          .arg("ns/op", 12)
+       << endl;
+
+  foreach (const Case& c, cases_) {
+    if (c.args.isEmpty()) {
+      RunCase(c.name, c.function, 0);
+    } else {
+      foreach (int arg, c.args) {
+        RunCase(QStringLiteral("%1/%2").arg(c.name, QString::number(arg)), c.function, arg);
+      }
+    }
+  }
+}
+
+void MicroBenchmark::AddCase(const QString &name, MicroBenchmark::BenchmarkFunction function, const QList<int> &args)
+{
+  Case c;
+
+  c.name = name;
+  c.function = function;
+  c.args = args;
+
+  cases_.append(c);
+}
+
+void MicroBenchmark::RunCase(const QString &name, MicroBenchmark::BenchmarkFunction function, int arg)
+{
+  if (!filter_.pattern().isEmpty() && !filter_.match(name).hasMatch()) {
+    return;
+  }
+
+  // Keep multiplying the iteration count until a run is long enough to be measured reliably, the last run is the
+  // result (earlier ones double as a warm-up)
+  qint64 iterations = qMax(1, arg);
+  qint64 elapsed = 0;
+
+  forever {
+    MicroState state(iterations, arg);
+
+    function(state);
+
+    elapsed = state.elapsed_nsecs();
+
+    if (elapsed >= min_nsecs_ || iterations >= kMaxIterations) {
+      break;
+    }
+
+    // Aim a bit past the minimum so the next run is usually the last
+    qint64 next = (elapsed > 0) ? static_cast<qint64>(iterations * 1.4 * min_nsecs_ / elapsed) : iterations * 100;
+
+    iterations = qBound(iterations * 2, next, iterations * 100);
+  }
+
+  out_ << QString("%1 %2 %3")
+          .arg(name, -32)
+          .arg(iterations, 12)
+          .arg(static_cast<double>(elapsed) / iterations, 12, 'f', 1)
+       << endl;
+}
@@ -0,0 +1,123 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef MICROBENCHMARK_H
+#define MICROBENCHMARK_H
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QRegularExpression>
+#include <QTextStream>
+
+/**
+ * @brief Passed to every micro-benchmark, telling it how many times to run and timing the part that matters
+ *
+ * A benchmark does any setup first, then calls StartTiming(), runs its operation iterations() times and calls
+ * StopTiming().
+ */
+class MicroState
+{
+public:
+  MicroState(qint64 iterations, int arg);
+
+  qint64 iterations() const;
+
+  /**
+   * @brief Size parameter of this run (e.g. the number of keyframes), 0 for benchmarks that don't take one
+   */
+  int arg() const;
+
+  void StartTiming();
+
+  void StopTiming();
+
+  qint64 elapsed_nsecs() const;
+
+  /**
+   * @brief Keep the compiler from optimizing away a result the benchmark doesn't otherwise use
+   */
+  static void Consume(const void* result);
+
+private:
+  qint64 iterations_;
+
+  int arg_;
+
+  QElapsedTimer timer_;
+
+  qint64 elapsed_nsecs_;
+
+};
+
+/**
+ * @brief Times small, hot operations on the core data structures in isolation
+ *
+ * Each benchmark is run with an increasing number of iterations until a run takes at least the minimum time, and the
+ * average time per iteration of that run is printed. Benchmarks that take a size parameter are run once per size.
+ */
+class MicroBenchmark
+{
+public:
+  MicroBenchmark();
+
+  /**
+   * @brief Only run benchmarks whose name (e.g. "rational/add" or "track/block_at_time/256") matches this pattern
+   */
+  void SetFilter(const QString& pattern);
+
+  /**
+   * @brief Minimum time in milliseconds each measured run has to take (default 500)
+   */
+  void SetMinTime(int msecs);
+
+  /**
+   * @brief Run every benchmark matching the filter and print the results to stdout
+   */
+  void Run();
+
+private:
+  typedef void (*BenchmarkFunction)(MicroState& state);
+
+  struct Case {
+    QString name;
+    BenchmarkFunction function;
+    QList<int> args;
+  };
+
+  void AddCase(const QString& name, BenchmarkFunction function, const QList<int>& args = QList<int>());
+
+  void RunCase(const QString& name, BenchmarkFunction function, int arg);
+
+  QList<Case> cases_;
+
+  QRegularExpression filter_;
+
+  qint64 min_nsecs_;
+
+  QTextStream out_;
+
+  /**
+   * @brief Stop increasing the iteration count past this even if a run is still faster than the minimum time
+   */
+  static const qint64 kMaxIterations = 1000000000;
+
+};
+
+#endif // MICROBENCHMARK_H
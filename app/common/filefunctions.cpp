@@ -24,8 +24,11 @@
 #include <QCryptographicHash>
 #include <QDateTime>
 #include <QDir>
+#include <QFile>
 #include <QFileInfo>
 #include <QStandardPaths>
+#include <QSysInfo>
+#include <QThread>
 
 QString GetUniqueFileIdentifier(const QString &filename)
 {
@@ -41,11 +44,21 @@ QString GetUniqueFileIdentifier(const QString &filename)
 
   hash.addData(info.lastModified().toString().toUtf8());
 
+  hash.addData(QByteArray::number(info.size()));
+
   QByteArray result = hash.result();
 
   return QString(result.toHex());
 }
 
+QString GetStableFileIdentifier(const QString &filename)
+{
+  QByteArray result = QCryptographicHash::hash(QFileInfo(filename).absoluteFilePath().toUtf8(),
+                                               QCryptographicHash::Sha1);
+
+  return QString(result.toHex());
+}
+
 QString GetMediaIndexLocation()
 {
   QDir local_appdata_dir(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation));
@@ -60,7 +73,22 @@ QString GetMediaIndexLocation()
 
 QString GetMediaIndexFilename(const QString &filename)
 {
-  return QDir(GetMediaIndexLocation()).filePath(filename);
+  return GetShardedFilename(GetMediaIndexLocation(), filename);
+}
+
+bool CreateParentFolder(const QString &filename)
+{
+  return QFileInfo(filename).dir().mkpath(QStringLiteral("."));
+}
+
+QString GetConformedAudioFilename(const QString &index_filename, int sample_rate)
+{
+  return QStringLiteral("%1.%2.conformed").arg(index_filename, QString::number(sample_rate));
+}
+
+bool IsConformedAudioFilename(const QString &filename)
+{
+  return filename.endsWith(QStringLiteral(".conformed"));
 }
 
 QString GetMediaCacheLocation()
@@ -75,6 +103,66 @@ QString GetMediaCacheLocation()
   return media_cache_dir.absolutePath();
 }
 
+QString GetShardedFilename(const QString &dir, const QString &name)
+{
+  return QDir(QDir(dir).filePath(name.left(2))).filePath(name);
+}
+
+namespace {
+
+QString PartialFilename(const QString& destination)
+{
+  return QStringLiteral("%1.%2-%3-%4.part").arg(destination,
+                                                QSysInfo::machineHostName(),
+                                                QString::number(QCoreApplication::applicationPid()),
+                                                QString::number(reinterpret_cast<quintptr>(QThread::currentThreadId())));
+}
+
+}
+
+bool CopyFileAtomically(const QString &source, const QString &destination)
+{
+  if (QFileInfo::exists(destination)) {
+    return true;
+  }
+
+  QFileInfo(destination).dir().mkpath(".");
+
+  QString partial = PartialFilename(destination);
+
+  QFile::remove(partial);
+
+  bool copied = QFile::copy(source, partial) && QFile::rename(partial, destination);
+
+  QFile::remove(partial);
+
+  // If the rename failed, someone else may have got there first
+  return copied || QFileInfo::exists(destination);
+}
+
+bool WriteFileAtomically(const QString &destination, const QByteArray &data)
+{
+  if (QFileInfo::exists(destination)) {
+    return true;
+  }
+
+  QFileInfo(destination).dir().mkpath(".");
+
+  QString partial = PartialFilename(destination);
+
+  QFile file(partial);
+
+  bool written = file.open(QFile::WriteOnly) && file.write(data) == data.size();
+
+  file.close();
+
+  written = written && QFile::rename(partial, destination);
+
+  QFile::remove(partial);
+
+  return written || QFileInfo::exists(destination);
+}
+
 QString GetConfigurationLocation()
 {
   if (IsPortable()) {
@@ -27,12 +27,76 @@ bool IsPortable();
 
 QString GetUniqueFileIdentifier(const QString& filename);
 
+/**
+ * @brief Returns an identifier for a file that stays the same when the file is modified
+ *
+ * Unlike GetUniqueFileIdentifier(), this only depends on where the file is, so it can be used to find what was stored
+ * about an earlier version of a file (e.g. one that's still being written).
+ */
+QString GetStableFileIdentifier(const QString& filename);
+
 QString GetMediaIndexLocation();
 
+/**
+ * @brief Returns where a file named `filename` is stored in the media index folder
+ *
+ * Files are sharded (see GetShardedFilename()). The subfolder isn't created, code writing the file should call
+ * CreateParentFolder() first.
+ */
 QString GetMediaIndexFilename(const QString& filename);
 
+/**
+ * @brief Create the folder `filename` goes in (e.g. its shard, see GetShardedFilename()) if it doesn't exist yet
+ *
+ * @return
+ *
+ * TRUE if the folder exists afterwards.
+ */
+bool CreateParentFolder(const QString& filename);
+
 QString GetMediaCacheLocation();
 
+/**
+ * @brief Returns where audio conformed from the index `index_filename` to `sample_rate` is stored
+ *
+ * Conformed audio is named after its index, so footage that's the same file (see GetUniqueFileIdentifier()) shares
+ * its conforms between projects.
+ */
+QString GetConformedAudioFilename(const QString& index_filename, int sample_rate);
+
+/**
+ * @brief Returns whether `filename` is conformed audio (see GetConformedAudioFilename())
+ */
+bool IsConformedAudioFilename(const QString& filename);
+
+/**
+ * @brief Returns where `name` is stored in `dir`, in a subfolder named after the first two characters of `name`
+ *
+ * Caches hold far too many files to keep in one folder. `name` should start with hex digits (e.g. a hash) so files
+ * spread evenly over at most 256 subfolders. The subfolder isn't created.
+ */
+QString GetShardedFilename(const QString& dir, const QString& name);
+
+/**
+ * @brief Copy `source` to `destination` so that `destination` only ever appears complete
+ *
+ * The file is copied under a temporary name only this thread of this process on this machine uses, then renamed, so
+ * it's safe for any number of processes (e.g. on different workstations sharing a folder) to copy the same file at
+ * once. The destination's folder is created if necessary. An existing destination is left alone.
+ *
+ * @return
+ *
+ * TRUE if `destination` exists afterwards.
+ */
+bool CopyFileAtomically(const QString& source, const QString& destination);
+
+/**
+ * @brief Write `data` to `destination` so that `destination` only ever appears complete
+ *
+ * The same as CopyFileAtomically(), except the data comes from memory.
+ */
+bool WriteFileAtomically(const QString& destination, const QByteArray& data);
+
 QString GetConfigurationLocation();
 
 QString GetApplicationPath();
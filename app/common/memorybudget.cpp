@@ -0,0 +1,217 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "memorybudget.h"
+
+#include <QRunnable>
+#include <QThreadPool>
+
+#ifdef Q_OS_WINDOWS
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+class ReliefTask : public QRunnable
+{
+public:
+  virtual void run() override
+  {
+    MemoryBudget::Relieve();
+  }
+};
+
+/**
+ * @brief Share of the machine's memory an automatic limit takes
+ */
+const int kAutomaticPercent = 50;
+
+}
+
+MemoryBudget::State::State() :
+  limit(0),
+  relieving(0)
+{
+}
+
+void MemoryBudget::AddReclaimer(MemoryBudget::Category category, MemoryBudget::Reclaimer *reclaimer)
+{
+  State& s = state();
+
+  Entry entry;
+  entry.category = category;
+  entry.reclaimer = reclaimer;
+
+  s.reclaimers_lock.lock();
+
+  // Kept sorted by category so relief asks them in order
+  int index = 0;
+
+  while (index < s.reclaimers.size() && s.reclaimers.at(index).category <= category) {
+    index++;
+  }
+
+  s.reclaimers.insert(index, entry);
+
+  s.reclaimers_lock.unlock();
+}
+
+void MemoryBudget::RemoveReclaimer(MemoryBudget::Reclaimer *reclaimer)
+{
+  State& s = state();
+
+  s.reclaimers_lock.lock();
+
+  for (int i=0;i<s.reclaimers.size();i++) {
+    if (s.reclaimers.at(i).reclaimer == reclaimer) {
+      s.reclaimers.removeAt(i);
+      break;
+    }
+  }
+
+  s.reclaimers_lock.unlock();
+}
+
+void MemoryBudget::Add(MemoryBudget::Category category, qint64 bytes)
+{
+  State& s = state();
+
+  s.used[category].fetchAndAddRelaxed(bytes);
+
+  if (bytes > 0 && UnderPressure() && s.relieving.testAndSetAcquire(0, 1)) {
+    static QThreadPool relief_pool;
+
+    relief_pool.setMaxThreadCount(1);
+    relief_pool.start(new ReliefTask());
+  }
+}
+
+qint64 MemoryBudget::Used(MemoryBudget::Category category)
+{
+  return state().used[category].load();
+}
+
+qint64 MemoryBudget::TotalUsed()
+{
+  State& s = state();
+
+  qint64 total = 0;
+
+  for (int i=0;i<kCategoryCount;i++) {
+    total += s.used[i].load();
+  }
+
+  return total;
+}
+
+QString MemoryBudget::CategoryName(MemoryBudget::Category category)
+{
+  switch (category) {
+  case kFrames:
+    return tr("frames");
+  case kFileBuffers:
+    return tr("file buffers");
+  case kReverseFrames:
+    return tr("reverse playback");
+  case kFrameCache:
+    return tr("frame cache");
+  case kUndo:
+    return tr("undo");
+  case kCategoryCount:
+    break;
+  }
+
+  return QString();
+}
+
+void MemoryBudget::SetLimit(qint64 bytes)
+{
+  state().limit.store(qMax(Q_INT64_C(0), bytes));
+}
+
+qint64 MemoryBudget::Limit()
+{
+  qint64 limit = state().limit.load();
+
+  if (limit > 0) {
+    return limit;
+  }
+
+  static qint64 automatic_limit = PhysicalMemory() / 100 * kAutomaticPercent;
+
+  return automatic_limit;
+}
+
+bool MemoryBudget::UnderPressure()
+{
+  qint64 limit = Limit();
+
+  return (limit > 0 && TotalUsed() > limit / 100 * kPressurePercent);
+}
+
+void MemoryBudget::Relieve()
+{
+  State& s = state();
+
+  s.reclaimers_lock.lock();
+
+  qint64 target = Limit() / 100 * kReliefPercent;
+  qint64 wanted = TotalUsed() - target;
+
+  for (int i=0;i<s.reclaimers.size() && wanted > 0;i++) {
+    wanted -= s.reclaimers.at(i).reclaimer->Reclaim(wanted);
+  }
+
+  s.reclaimers_lock.unlock();
+
+  // Allocations from now on can start relief again
+  s.relieving.storeRelease(0);
+}
+
+MemoryBudget::State &MemoryBudget::state()
+{
+  static State* s = new State();
+  return *s;
+}
+
+qint64 MemoryBudget::PhysicalMemory()
+{
+#ifdef Q_OS_WINDOWS
+  MEMORYSTATUSEX status;
+  status.dwLength = sizeof(status);
+
+  if (GlobalMemoryStatusEx(&status)) {
+    return static_cast<qint64>(status.ullTotalPhys);
+  }
+
+  return 0;
+#else
+  long pages = sysconf(_SC_PHYS_PAGES);
+  long page_size = sysconf(_SC_PAGE_SIZE);
+
+  if (pages <= 0 || page_size <= 0) {
+    return 0;
+  }
+
+  return static_cast<qint64>(pages) * page_size;
+#endif
+}
@@ -0,0 +1,165 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef MEMORYBUDGET_H
+#define MEMORYBUDGET_H
+
+#include <QAtomicInteger>
+#include <QCoreApplication>
+#include <QMutex>
+#include <QVector>
+
+/**
+ * @brief Process-wide accounting of the memory held by frames, caches and the undo history
+ *
+ * Decoders, caches and pools each keep within limits of their own, but nothing adds them up, so a long session with a
+ * few viewers open can hold more than the machine has and start swapping. Each reports what it allocates and frees
+ * here under a Category, which is cheap enough to do on every allocation from any thread.
+ *
+ * Once the total goes over kPressurePercent of Limit(), every Reclaimer is asked to free memory in Category order
+ * (cheapest to get back first) until the total is down to kReliefPercent. This happens on a thread of its own, so
+ * reporting an allocation never waits on a reclaimer and reclaimers can take whatever locks they need.
+ */
+class MemoryBudget
+{
+  Q_DECLARE_TR_FUNCTIONS(MemoryBudget)
+public:
+  /**
+   * @brief What memory is held for, also the order reclaimers are asked in
+   */
+  enum Category {
+    /// Frame buffers from FramePool, held by frames (including decoded stills) or free in the pool
+    kFrames,
+
+    /// Blocks of footage read by FFmpegFileBuffer
+    kFileBuffers,
+
+    /// Frames FFmpegDecoder has decoded ahead while playing backwards (moved here from kFrames while they're held)
+    kReverseFrames,
+
+    /// Rendered frames kept in VideoRenderFrameCache's memory cache
+    kFrameCache,
+
+    /// Commands kept by the undo stack (estimated, never reclaimed)
+    kUndo,
+
+    kCategoryCount
+  };
+
+  /**
+   * @brief Something that can free memory it's holding when the process is under pressure
+   */
+  class Reclaimer
+  {
+  public:
+    virtual ~Reclaimer() {}
+
+    /**
+     * @brief Free up to `bytes` (more is fine), returning how much was freed
+     *
+     * Called from the relief thread, so must be thread-safe.
+     */
+    virtual qint64 Reclaim(qint64 bytes) = 0;
+  };
+
+  /**
+   * @brief Ask `reclaimer` to free memory held under `category` when under pressure
+   *
+   * Should be called once the reclaimer is fully constructed, and RemoveReclaimer() before it's destroyed.
+   */
+  static void AddReclaimer(Category category, Reclaimer* reclaimer);
+
+  /**
+   * @brief Stop asking `reclaimer` to free memory, waiting for it to finish if it's being asked right now
+   */
+  static void RemoveReclaimer(Reclaimer* reclaimer);
+
+  /**
+   * @brief Report `bytes` allocated (or freed if negative) under `category`
+   */
+  static void Add(Category category, qint64 bytes);
+
+  static qint64 Used(Category category);
+
+  static qint64 TotalUsed();
+
+  static QString CategoryName(Category category);
+
+  /**
+   * @brief Set the most memory the process should hold in bytes (0 means half of the machine's memory)
+   */
+  static void SetLimit(qint64 bytes);
+
+  /**
+   * @brief The limit in bytes, or 0 if it's automatic and the machine's memory is unknown (no limit)
+   */
+  static qint64 Limit();
+
+  /**
+   * @brief Returns whether the total is over kPressurePercent of the limit
+   *
+   * Pools should free buffers rather than keep them for reuse while this is TRUE.
+   */
+  static bool UnderPressure();
+
+  /**
+   * @brief Free memory until the total is down to kReliefPercent of the limit (relief thread only)
+   */
+  static void Relieve();
+
+private:
+  struct Entry {
+    Category category;
+    Reclaimer* reclaimer;
+  };
+
+  struct State {
+    State();
+
+    QAtomicInteger<qint64> used[kCategoryCount];
+
+    QAtomicInteger<qint64> limit;
+
+    /// Whether relief has been started and hasn't finished yet
+    QAtomicInt relieving;
+
+    /// Held while reclaimers are asked, so they can't be removed while they're running
+    QMutex reclaimers_lock;
+
+    QVector<Entry> reclaimers;
+  };
+
+  /**
+   * @brief Created on first use and never destroyed, since frames may be allocated before main() and freed after it
+   */
+  static State& state();
+
+  /**
+   * @brief Size of the machine's physical memory in bytes, or 0 if it can't be found
+   */
+  static qint64 PhysicalMemory();
+
+  static const int kPressurePercent = 90;
+
+  static const int kReliefPercent = 75;
+
+};
+
+#endif // MEMORYBUDGET_H
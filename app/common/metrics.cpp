@@ -0,0 +1,44 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "metrics.h"
+
+QAtomicInteger<quint64> Metrics::counters_[kCounterCount];
+QAtomicInteger<qint64> Metrics::gauges_[kGaugeCount];
+
+void Metrics::Increment(Metrics::Counter counter)
+{
+  counters_[counter].fetchAndAddRelaxed(1);
+}
+
+void Metrics::Add(Metrics::Gauge gauge, qint64 delta)
+{
+  gauges_[gauge].fetchAndAddRelaxed(delta);
+}
+
+quint64 Metrics::Value(Metrics::Counter counter)
+{
+  return counters_[counter].load();
+}
+
+qint64 Metrics::Value(Metrics::Gauge gauge)
+{
+  return gauges_[gauge].load();
+}
@@ -0,0 +1,77 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QAtomicInteger>
+
+/**
+ * @brief Process-wide counters and gauges for monitoring render nodes (see MetricsServer)
+ *
+ * Updating one is a single atomic operation, so they're always kept, from any thread, whether or not anything reads
+ * them. Rates (e.g. frames rendered per second) are left to whatever scrapes the counters.
+ */
+class Metrics
+{
+public:
+  enum Counter {
+    /// Frames the video workers rendered rather than found already cached
+    kFramesRendered,
+
+    /// Frame cache lookups, by the tier the frame was found in (see VideoRenderFrameCache)
+    kFrameCacheMemoryHits,
+    kFrameCacheMemoryMisses,
+    kFrameCacheDiskHits,
+    kFrameCacheSharedHits,
+
+    /// Frames that weren't on the local disk or in the shared cache either
+    kFrameCacheMisses,
+
+    /// Decoders taken from DecoderCache, or that had to be created because none was free
+    kDecoderCacheHits,
+    kDecoderCacheMisses,
+
+    kCounterCount
+  };
+
+  enum Gauge {
+    /// Frames waiting for a VideoRenderFrameWriter to encode them
+    kFrameWritesQueued,
+
+    kGaugeCount
+  };
+
+  static void Increment(Counter counter);
+
+  static void Add(Gauge gauge, qint64 delta);
+
+  static quint64 Value(Counter counter);
+
+  static qint64 Value(Gauge gauge);
+
+private:
+  static QAtomicInteger<quint64> counters_[kCounterCount];
+
+  static QAtomicInteger<qint64> gauges_[kGaugeCount];
+
+};
+
+#endif // METRICS_H
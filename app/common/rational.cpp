@@ -61,14 +61,17 @@ void rational::reduce()
 
 intType rational::gcd(intType &x, intType &y)
 {
-  if(y == 0)
-    return x;
-  else
-    {
-      intType tmp = x % y;
+  // Iterative Euclidean, this runs on every arithmetic operation
+  intType a = x;
+  intType b = y;
+
+  while (b != 0) {
+    intType tmp = a % b;
+    a = b;
+    b = tmp;
+  }
 
-      return gcd(y, tmp);
-    }
+  return a;
 }
 
 //Function: convert to double
@@ -125,6 +128,19 @@ const rational& rational::operator=(const rational &rhs)
 
 const rational& rational::operator+=(const rational &rhs)
 {
+  // Fast path for the common case of two times in the same timebase
+  if (denom > 0 && denom == rhs.denom) {
+    numer += rhs.numer;
+
+    if (numer == 0) {
+      denom = 0;
+    } else {
+      reduce();
+    }
+
+    return *this;
+  }
+
   if(numer * denom == intType(0) && rhs.numer * rhs.denom == intType(0))
     {
       numer = intType(0);
@@ -153,6 +169,19 @@ const rational& rational::operator+=(const rational &rhs)
 
 const rational& rational::operator-=(const rational &rhs)
 {
+  // Fast path for the common case of two times in the same timebase
+  if (denom > 0 && denom == rhs.denom) {
+    numer -= rhs.numer;
+
+    if (numer == 0) {
+      denom = 0;
+    } else {
+      reduce();
+    }
+
+    return *this;
+  }
+
   if(numer * denom == intType(0) && rhs.numer * rhs.denom == intType(0))
     {
       numer = intType(0);
@@ -231,6 +260,10 @@ rational rational::operator*(const rational &rhs) const
 
 bool rational::operator<(const rational &rhs) const
 {
+  // Same timebase, so no cross-multiplication needed
+  if (denom > 0 && denom == rhs.denom)
+    return numer < rhs.numer;
+
   if(numer * denom == intType(0) && rhs.numer * rhs.denom == intType(0))
     return false;
   else
@@ -255,6 +288,10 @@ bool rational::operator<(const rational &rhs) const
 
 bool rational::operator<=(const rational &rhs) const
 {
+  // Same timebase, so no cross-multiplication needed
+  if (denom > 0 && denom == rhs.denom)
+    return numer <= rhs.numer;
+
   if(numer * denom == intType(0) && rhs.numer * rhs.denom == intType(0))
     return true;
   else
@@ -279,6 +316,10 @@ bool rational::operator<=(const rational &rhs) const
 
 bool rational::operator>(const rational &rhs) const
 {
+  // Same timebase, so no cross-multiplication needed
+  if (denom > 0 && denom == rhs.denom)
+    return numer > rhs.numer;
+
   if(numer * denom == intType(0) && rhs.numer * rhs.denom == intType(0))
     return false;
   else
@@ -303,6 +344,10 @@ bool rational::operator>(const rational &rhs) const
 
 bool rational::operator>=(const rational &rhs) const
 {
+  // Same timebase, so no cross-multiplication needed
+  if (denom > 0 && denom == rhs.denom)
+    return numer >= rhs.numer;
+
   if(numer * denom == intType(0) && rhs.numer * rhs.denom == intType(0))
     return true;
   else
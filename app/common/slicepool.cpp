@@ -18,22 +18,13 @@
 
 ***/
 
-#include "taskthread.h"
 
-#include "task/task.h"
+#include "slicepool.h"
 
-TaskThread::TaskThread(Task *parent) :
-  parent_(parent),
-  result_(false)
+QThreadPool *SlicePool::instance()
 {
-}
+  // Never deleted, so slices still running when statics are destroyed at exit can finish
+  static QThreadPool* pool = new QThreadPool();
 
-void TaskThread::run()
-{
-  result_ = parent_->Action();
-}
-
-bool TaskThread::result()
-{
-  return result_;
+  return pool;
 }
@@ -0,0 +1,45 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#ifndef SLICEPOOL_H
+#define SLICEPOOL_H
+
+#include <QThreadPool>
+
+/**
+ * @brief Threads for the slices a job is split into and waited on, e.g. the bands of a frame being converted
+ *
+ * Whoever splits a job blocks until its slices are done, and is often a thread of QThreadPool::globalInstance()
+ * itself (e.g. a prefetch or a previewer decode). Were the slices queued on that pool too, every one of its threads
+ * could end up waiting on slices that no thread is free to run. Slices must never wait on anything themselves, so this
+ * pool always gets through them whoever's waiting.
+ */
+class SlicePool
+{
+public:
+  /**
+   * @brief The pool, created the first time it's needed and kept until the process exits
+   */
+  static QThreadPool* instance();
+
+};
+
+#endif // SLICEPOOL_H
@@ -1,5 +1,6 @@
 #include "timerange.h"
 
+#include <algorithm>
 #include <utility>
 
 TimeRange::TimeRange(const rational &in, const rational &out) :
@@ -85,3 +86,65 @@ uint qHash(const TimeRange &r, uint seed)
 {
   return qHash(r.in(), seed) ^ qHash(r.out(), seed);
 }
+
+/**
+ * @brief Used to binary search a TimeRangeList for the first range that doesn't end before a time
+ */
+static bool RangeEndsBefore(const TimeRange& range, const rational& time)
+{
+  return range.out() < time;
+}
+
+/**
+ * @brief Used to binary search a TimeRangeList for the first range that starts after a time
+ */
+static bool TimeIsBeforeRange(const rational& time, const TimeRange& range)
+{
+  return time < range.in();
+}
+
+void TimeRangeList::InsertTimeRange(const TimeRange &range)
+{
+  // First range that overlaps or comes after this one
+  int index = static_cast<int>(std::lower_bound(ranges_.constBegin(), ranges_.constEnd(), range.in(), RangeEndsBefore)
+                               - ranges_.constBegin());
+
+  TimeRange merged = range;
+
+  // Absorb every range this one overlaps
+  while (index < ranges_.size() && ranges_.at(index).in() <= merged.out()) {
+    merged = TimeRange::Combine(merged, ranges_.takeAt(index));
+  }
+
+  ranges_.insert(index, merged);
+}
+
+bool TimeRangeList::ContainsTimeRange(const TimeRange &range) const
+{
+  // The range starting latest at or before this one is the only one that could contain it
+  QList<TimeRange>::const_iterator after = std::upper_bound(ranges_.constBegin(),
+                                                            ranges_.constEnd(),
+                                                            range.in(),
+                                                            TimeIsBeforeRange);
+
+  if (after == ranges_.constBegin()) {
+    return false;
+  }
+
+  return (after - 1)->out() >= range.out();
+}
+
+bool TimeRangeList::isEmpty() const
+{
+  return ranges_.isEmpty();
+}
+
+void TimeRangeList::clear()
+{
+  ranges_.clear();
+}
+
+const QList<TimeRange> &TimeRangeList::ranges() const
+{
+  return ranges_;
+}
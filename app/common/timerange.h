@@ -1,6 +1,8 @@
 #ifndef TIMERANGE_H
 #define TIMERANGE_H
 
+#include <QList>
+
 #include "rational.h"
 
 class TimeRange {
@@ -34,4 +36,35 @@ private:
 
 uint qHash(const TimeRange& r, uint seed);
 
+/**
+ * @brief A set of times stored as sorted, non-overlapping TimeRanges
+ *
+ * Inserting a range merges it with any ranges it overlaps or touches, so inserting the same times repeatedly doesn't
+ * make the list any longer.
+ */
+class TimeRangeList {
+public:
+  TimeRangeList() = default;
+
+  void InsertTimeRange(const TimeRange& range);
+
+  /**
+   * @brief Returns whether every time in `range` is already in the list
+   */
+  bool ContainsTimeRange(const TimeRange& range) const;
+
+  bool isEmpty() const;
+
+  void clear();
+
+  /**
+   * @brief The ranges in the list, sorted by in point
+   */
+  const QList<TimeRange>& ranges() const;
+
+private:
+  QList<TimeRange> ranges_;
+
+};
+
 #endif // TIMERANGE_H
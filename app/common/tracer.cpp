@@ -0,0 +1,349 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "tracer.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QPair>
+#include <QThread>
+
+QAtomicInt Tracer::enabled_(0);
+QAtomicInt Tracer::histograms_enabled_(0);
+
+const qint64 Tracer::kHistogramBounds[Tracer::kHistogramBucketCount] = {
+  100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000
+};
+
+/**
+ * @brief One thread's ring buffer
+ *
+ * Only its own thread writes to it, the mutex is only ever contended while exporting or clearing.
+ */
+class Tracer::Buffer
+{
+public:
+  Buffer(int thread_id, const QString& thread_name) :
+    thread_id_(thread_id),
+    thread_name_(thread_name),
+    next_(0),
+    count_(0)
+  {
+    events_.resize(kBufferSize);
+  }
+
+  void Append(const char* category, const char* name, const QString& dynamic_name, qint64 start, qint64 duration)
+  {
+    lock_.lock();
+
+    Event& e = events_[next_];
+    e.category = category;
+    e.name = name;
+    e.dynamic_name = dynamic_name;
+    e.start = start;
+    e.duration = duration;
+
+    next_ = (next_ + 1) % kBufferSize;
+    count_ = qMin(count_ + 1, kBufferSize);
+
+    lock_.unlock();
+  }
+
+  void AddToHistogram(const char* category, const char* name, qint64 duration)
+  {
+    lock_.lock();
+
+    Stage& s = stages_[qMakePair(category, name)];
+
+    if (s.counts.isEmpty()) {
+      s.counts.fill(0, kHistogramBucketCount + 1);
+    }
+
+    int bucket = 0;
+
+    while (bucket < kHistogramBucketCount && duration > kHistogramBounds[bucket]) {
+      bucket++;
+    }
+
+    s.counts[bucket]++;
+    s.count++;
+    s.total += duration;
+
+    lock_.unlock();
+  }
+
+  /**
+   * @brief Add this thread's histograms to those of the threads before it, merged by name
+   */
+  void AppendHistograms(QMap<QPair<QString, QString>, Histogram>* histograms)
+  {
+    lock_.lock();
+
+    for (QHash<QPair<const char*, const char*>, Stage>::const_iterator i=stages_.constBegin();i!=stages_.constEnd();i++) {
+      QString category = QString::fromLatin1(i.key().first);
+      QString name = i.key().second ? QString::fromLatin1(i.key().second) : QString();
+
+      Histogram& h = (*histograms)[qMakePair(category, name)];
+
+      if (h.counts.isEmpty()) {
+        h.category = category;
+        h.name = name;
+        h.counts.fill(0, kHistogramBucketCount + 1);
+      }
+
+      for (int j=0;j<h.counts.size();j++) {
+        h.counts[j] += i.value().counts.at(j);
+      }
+
+      h.count += i.value().count;
+      h.total += i.value().total;
+    }
+
+    lock_.unlock();
+  }
+
+  void Clear()
+  {
+    lock_.lock();
+
+    next_ = 0;
+    count_ = 0;
+
+    lock_.unlock();
+  }
+
+  void AppendToJson(QJsonArray* array)
+  {
+    QJsonObject metadata;
+    metadata.insert("name", "thread_name");
+    metadata.insert("ph", "M");
+    metadata.insert("pid", 1);
+    metadata.insert("tid", thread_id_);
+    QJsonObject metadata_args;
+    metadata_args.insert("name", thread_name_);
+    metadata.insert("args", metadata_args);
+    array->append(metadata);
+
+    lock_.lock();
+
+    // Oldest first
+    int first = (next_ - count_ + kBufferSize) % kBufferSize;
+
+    for (int i=0;i<count_;i++) {
+      const Event& e = events_.at((first + i) % kBufferSize);
+
+      QJsonObject obj;
+      obj.insert("name", e.name ? QString::fromLatin1(e.name) : e.dynamic_name);
+      obj.insert("cat", QString::fromLatin1(e.category));
+      obj.insert("ph", "X");
+      obj.insert("ts", static_cast<double>(e.start));
+      obj.insert("dur", static_cast<double>(e.duration));
+      obj.insert("pid", 1);
+      obj.insert("tid", thread_id_);
+      array->append(obj);
+    }
+
+    lock_.unlock();
+  }
+
+private:
+  struct Stage {
+    QVector<quint64> counts;
+    quint64 count;
+    qint64 total;
+  };
+
+  int thread_id_;
+
+  QString thread_name_;
+
+  QVector<Event> events_;
+
+  int next_;
+
+  int count_;
+
+  /**
+   * @brief Histograms by category and name, the name is nullptr for dynamic names
+   */
+  QHash<QPair<const char*, const char*>, Stage> stages_;
+
+  QMutex lock_;
+
+};
+
+QMutex Tracer::buffers_lock_;
+QList<Tracer::Buffer*> Tracer::buffers_;
+thread_local Tracer::Buffer* Tracer::thread_buffer_ = nullptr;
+
+Tracer::Scope::Scope(const char *category, const char *name) :
+  category_(category),
+  name_(name),
+  start_(-1)
+{
+  if (IsEnabled() || HistogramsEnabled()) {
+    start_ = Now();
+  }
+}
+
+Tracer::Scope::Scope(const char *category, const QString &name) :
+  category_(category),
+  name_(nullptr),
+  start_(-1)
+{
+  if (IsEnabled()) {
+    dynamic_name_ = name;
+  }
+
+  if (IsEnabled() || HistogramsEnabled()) {
+    start_ = Now();
+  }
+}
+
+Tracer::Scope::~Scope()
+{
+  // Still check whether this was started, recording may have been enabled while it was running
+  if (start_ >= 0) {
+    Record(category_, name_, dynamic_name_, start_);
+  }
+}
+
+void Tracer::SetEnabled(bool e)
+{
+  enabled_.store(e ? 1 : 0);
+}
+
+bool Tracer::IsEnabled()
+{
+  return enabled_.load();
+}
+
+void Tracer::SetHistogramsEnabled(bool e)
+{
+  histograms_enabled_.store(e ? 1 : 0);
+}
+
+bool Tracer::HistogramsEnabled()
+{
+  return histograms_enabled_.load();
+}
+
+QList<Tracer::Histogram> Tracer::Histograms()
+{
+  QMap<QPair<QString, QString>, Histogram> histograms;
+
+  buffers_lock_.lock();
+
+  foreach (Buffer* b, buffers_) {
+    b->AppendHistograms(&histograms);
+  }
+
+  buffers_lock_.unlock();
+
+  return histograms.values();
+}
+
+void Tracer::Clear()
+{
+  buffers_lock_.lock();
+
+  foreach (Buffer* b, buffers_) {
+    b->Clear();
+  }
+
+  buffers_lock_.unlock();
+}
+
+bool Tracer::ExportChromeTrace(const QString &filename)
+{
+  QJsonArray events;
+
+  buffers_lock_.lock();
+
+  foreach (Buffer* b, buffers_) {
+    b->AppendToJson(&events);
+  }
+
+  buffers_lock_.unlock();
+
+  QJsonObject root;
+  root.insert("traceEvents", events);
+  root.insert("displayTimeUnit", "ms");
+
+  QFile file(filename);
+
+  if (!file.open(QFile::WriteOnly)) {
+    qWarning() << "Failed to write render trace to" << filename;
+    return false;
+  }
+
+  file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+
+  file.close();
+
+  return true;
+}
+
+QElapsedTimer Tracer::StartedTimer()
+{
+  QElapsedTimer timer;
+  timer.start();
+  return timer;
+}
+
+qint64 Tracer::Now()
+{
+  // Started the first time this is called (C++11 guarantees only one thread initializes it)
+  static const QElapsedTimer timer = StartedTimer();
+
+  return timer.nsecsElapsed() / 1000;
+}
+
+void Tracer::Record(const char *category, const char *name, const QString &dynamic_name, qint64 start)
+{
+  if (thread_buffer_ == nullptr) {
+    QString thread_name = QThread::currentThread()->objectName();
+
+    buffers_lock_.lock();
+
+    if (thread_name.isEmpty()) {
+      thread_name = QStringLiteral("Thread %1").arg(buffers_.size());
+    }
+
+    thread_buffer_ = new Buffer(buffers_.size(), thread_name);
+    buffers_.append(thread_buffer_);
+
+    buffers_lock_.unlock();
+  }
+
+  qint64 duration = Now() - start;
+
+  if (IsEnabled()) {
+    thread_buffer_->Append(category, name, dynamic_name, start, duration);
+  }
+
+  if (HistogramsEnabled()) {
+    thread_buffer_->AddToHistogram(category, name, duration);
+  }
+}
@@ -0,0 +1,178 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief Records how long each stage of rendering takes so it can be viewed as a timeline
+ *
+ * Stages are timed with a Tracer::Scope on the stack. Each thread records into its own ring buffer, so recording never
+ * waits on another thread and only the most recent events are kept (see kBufferSize). While recording is disabled
+ * (the default), a Scope costs a single atomic load.
+ *
+ * The recording can be exported as Chrome trace JSON and opened in chrome://tracing or Perfetto.
+ *
+ * Separately, each stage's durations can be counted into histograms (see SetHistogramsEnabled()). Unlike the
+ * recording, these are kept for the whole session, so they're suited to monitoring a render node that runs for days.
+ *
+ * Note that OpenGL calls return before the GPU has done the work, so draws and uploads are only timed as they're
+ * submitted. Waiting for the GPU shows up in whatever reads back from it next.
+ */
+class Tracer
+{
+public:
+  /**
+   * @brief Times the lifetime of this object
+   *
+   * `category` and `name` must be string literals (or otherwise outlive the recording), they aren't copied.
+   */
+  class Scope
+  {
+  public:
+    Scope(const char* category, const char* name);
+
+    /**
+     * @brief Time something with a name that changes (e.g. a node's ID)
+     */
+    Scope(const char* category, const QString& name);
+
+    ~Scope();
+
+  private:
+    const char* category_;
+
+    const char* name_;
+
+    QString dynamic_name_;
+
+    qint64 start_;
+  };
+
+  /**
+   * @brief Start or stop recording
+   */
+  static void SetEnabled(bool e);
+
+  static bool IsEnabled();
+
+  /**
+   * @brief Discard everything recorded so far
+   */
+  static void Clear();
+
+  /**
+   * @brief Write everything recorded so far to `filename` as Chrome trace JSON
+   *
+   * @return
+   *
+   * FALSE if the file couldn't be written.
+   */
+  static bool ExportChromeTrace(const QString& filename);
+
+  /**
+   * @brief Number of events kept per thread
+   */
+  static const int kBufferSize = 32768;
+
+  /**
+   * @brief How long one stage took each time it ran, from every thread
+   */
+  struct Histogram {
+    QString category;
+
+    /// Empty for stages timed with a name that changes (see Scope), which are counted together per category
+    QString name;
+
+    /// How many times it took up to each of kHistogramBounds (but longer than the one before), then longer than all
+    QVector<quint64> counts;
+
+    quint64 count;
+
+    /// In microseconds
+    qint64 total;
+  };
+
+  /**
+   * @brief Start or stop counting durations into histograms (off by default)
+   *
+   * Independent of SetEnabled(), and Clear() doesn't reset them.
+   */
+  static void SetHistogramsEnabled(bool e);
+
+  static bool HistogramsEnabled();
+
+  /**
+   * @brief Every stage that's been counted so far, sorted by category and name
+   */
+  static QList<Histogram> Histograms();
+
+  static const int kHistogramBucketCount = 14;
+
+  /**
+   * @brief Upper bound of each histogram bucket in microseconds, from 100us to 2.5s
+   */
+  static const qint64 kHistogramBounds[kHistogramBucketCount];
+
+private:
+  struct Event {
+    const char* category;
+    const char* name;
+    QString dynamic_name;
+    qint64 start;
+    qint64 duration;
+  };
+
+  class Buffer;
+
+  /**
+   * @brief Microseconds since the first time a Tracer function was used
+   */
+  static qint64 Now();
+
+  static QElapsedTimer StartedTimer();
+
+  static void Record(const char* category, const char* name, const QString& dynamic_name, qint64 start);
+
+  static QAtomicInt enabled_;
+
+  static QAtomicInt histograms_enabled_;
+
+  /**
+   * @brief Every thread's buffer
+   *
+   * Buffers are never freed, a thread that has exited may still have events worth exporting.
+   */
+  static QList<Buffer*> buffers_;
+
+  static QMutex buffers_lock_;
+
+  static thread_local Buffer* thread_buffer_;
+
+};
+
+#endif // TRACER_H
@@ -28,6 +28,8 @@
 
 #include "core.h"
 #include "common/filefunctions.h"
+#include "render/backend/videorenderframecache.h"
+#include "render/pixelformat.h"
 
 Config Config::current_config_;
 
@@ -51,9 +53,36 @@ void Config::SetDefaults()
   config_map_.clear();
   config_map_["TimecodeDisplay"] = olive::kTimecodeNonDropFrame;
   config_map_["DefaultStillLength"] = QVariant::fromValue(rational(2));
+  config_map_["DefaultSequenceFrameRate"] = QVariant::fromValue(rational(24));
   config_map_["HoverFocus"] = false;
   config_map_["AudioScrubbing"] = true;
-  config_map_["AutorecoveryInterval"] = 1;
+  config_map_["AdaptivePlayback"] = true;
+  config_map_["AudioOutputLatency"] = 100;
+  config_map_["LowLatencyAudio"] = false;
+  config_map_["AudioBufferSize"] = 256;
+  config_map_["AutorecoveryInterval"] = 30;
+  config_map_["HardwareDecoding"] = QString();
+  config_map_["MemoryCacheSize"] = 512;
+  config_map_["CompressedMemoryCache"] = false;
+  config_map_["MemoryLimit"] = 0;
+  config_map_["DiskCacheSize"] = 20480;
+  config_map_["ConformCacheSize"] = 4096;
+  config_map_["UndoMemoryLimit"] = 512;
+  config_map_["CacheCodec"] = VideoRenderFrameCache::kCodecDWAA;
+  config_map_["OfflineCacheFormat"] = olive::PIX_FMT_RGBA16F;
+  config_map_["OnlineCacheFormat"] = olive::PIX_FMT_RGBA16F;
+  config_map_["SharedCachePath"] = QString();
+  config_map_["RenderThreadCount"] = 0;
+  config_map_["RenderGPUContextCount"] = 0;
+  config_map_["RenderGPUScreens"] = QString();
+  config_map_["GPUMemoryBudget"] = 0;
+  config_map_["RenderTileSize"] = 0;
+  config_map_["InteractiveRenderPercent"] = 25;
+  config_map_["PauseRenderOnBattery"] = false;
+  config_map_["ThumbnailResolution"] = 128;
+  config_map_["TimelineOpenGL"] = false;
+  config_map_["ImageSequenceStartFrame"] = 1001;
+  config_map_["ImportImageSequences"] = false;
 }
 
 void Config::Load()
@@ -23,24 +23,47 @@
 #include <QApplication>
 #include <QCommandLineParser>
 #include <QDebug>
+#include <QEventLoop>
 #include <QFileDialog>
 #include <QFileInfo>
 #include <QHBoxLayout>
+#include <QHostAddress>
 #include <QMessageBox>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
 #include <QStyleFactory>
 
 #include "audio/audiomanager.h"
+#include "common/memorybudget.h"
+#include "common/tracer.h"
 #include "config/config.h"
+#include "decoder/frame.h"
 #include "dialog/about/about.h"
 #include "dialog/sequence/sequence.h"
 #include "dialog/preferences/preferences.h"
 #include "dialog/projectproperties/projectproperties.h"
 #include "panel/panelmanager.h"
 #include "panel/project/project.h"
+#include "panel/renderqueue/renderqueue.h"
+#include "project/autorecovery.h"
 #include "project/item/footage/footage.h"
+#include "project/item/footage/footagewatcher.h"
 #include "project/item/sequence/sequence.h"
+#include "project/projectserializer.h"
+#include "render/backend/opengl/openglmemorybudget.h"
+#include "render/backend/rendersiblingjob.h"
 #include "render/colormanager.h"
+#include "render/diskcachemanager.h"
+#include "render/export/exporter.h"
+#include "render/farm/farmprocesspool.h"
+#include "render/farm/farmworker.h"
+#include "render/farm/metricsserver.h"
+#include "render/interactivitymonitor.h"
+#include "render/renderbudget.h"
+#include "render/thumbnailservice.h"
+#include "task/export/export.h"
 #include "task/import/import.h"
+#include "task/index/index.h"
 #include "task/taskmanager.h"
 #include "ui/style/style.h"
 #include "undo/undostack.h"
@@ -51,9 +74,10 @@ Core olive::core;
 
 Core::Core() :
   main_window_(nullptr),
+  render_chunk_length_(0),
+  render_processes_(0),
   tool_(olive::tool::kPointer),
-  snapping_(true),
-  queue_autorecovery_(false)
+  snapping_(true)
 {
 }
 
@@ -78,9 +102,68 @@ void Core::Start()
   QCommandLineOption fullscreen_option({"f", "fullscreen"}, tr("Start in full screen mode"));
   parser.addOption(fullscreen_option);
 
+  // Headless render options
+  QCommandLineOption render_option("render", tr("Render a sequence of this project to a file without starting the GUI"),
+                                   "project");
+  parser.addOption(render_option);
+
+  QCommandLineOption sequence_option("sequence", tr("Name of the sequence to render (defaults to the first one)"),
+                                     "name");
+  parser.addOption(sequence_option);
+
+  QCommandLineOption output_option("out", tr("File to render to, the format is picked from its extension (can be given "
+                                             "more than once). .exr and .dpx files are written as image sequences, "
+                                             "numbered in place of the last run of #s."), "file");
+  parser.addOption(output_option);
+
+  // Render farm options
+  QCommandLineOption distribute_option("distribute", tr("Split a sequence of this project into chunks for --worker "
+                                                        "processes to render into the shared cache, and wait for them"),
+                                       "project");
+  parser.addOption(distribute_option);
+
+  QCommandLineOption chunk_option("chunk", tr("Length of each chunk --distribute splits the sequence into (defaults "
+                                              "to 10)"), "seconds");
+  parser.addOption(chunk_option);
+
+  QCommandLineOption processes_option("processes", tr("Start this many --worker processes on this machine to render "
+                                                      "what --distribute queues, so a crash in one doesn't stop the "
+                                                      "render"), "count");
+  parser.addOption(processes_option);
+
+  QCommandLineOption worker_option("worker", tr("Render chunks queued with --distribute into the shared cache without "
+                                                "starting the GUI"));
+  parser.addOption(worker_option);
+
+  QCommandLineOption jobs_option("jobs", tr("Take --worker jobs from this folder rather than the shared cache's"),
+                                 "folder");
+  parser.addOption(jobs_option);
+
+  QCommandLineOption metrics_option("metrics", tr("Serve render metrics over HTTP on this port with --render, "
+                                                 "--distribute or --worker (/metrics for Prometheus, /metrics.json)"),
+                                    "port");
+  parser.addOption(metrics_option);
+
+  QCommandLineOption metrics_bind_option("metrics-bind", tr("Address to serve --metrics on (defaults to 127.0.0.1, "
+                                                            "use 0.0.0.0 to accept requests from other machines)"),
+                                         "address");
+  parser.addOption(metrics_bind_option);
+
+  QCommandLineOption software_option("software", tr("Render on the CPU rather than the GPU with --render or --worker"));
+  parser.addOption(software_option);
+
+  QCommandLineOption trace_startup_option("trace-startup", tr("Save a trace of how long each step of startup took "
+                                                              "(Chrome trace JSON)"), "file");
+  parser.addOption(trace_startup_option);
+
   // Parse options
   parser.process(*app);
 
+  if (parser.isSet(trace_startup_option)) {
+    startup_trace_ = parser.value(trace_startup_option);
+    Tracer::SetEnabled(true);
+  }
+
   QStringList args = parser.positionalArguments();
 
   // Detect project to load on startup
@@ -92,21 +175,113 @@ void Core::Start()
   DeclareTypesForQt();
 
   // Load application config
-  Config::Load();
+  {
+    Tracer::Scope trace("startup", "Config::Load");
+    Config::Load();
+  }
 
-  // Set up color manager
+  // Keep the media cache and index within their quota, everything below may write to them
+  {
+    Tracer::Scope trace("startup", "DiskCacheManager");
+    DiskCacheManager::CreateInstance();
+    DiskCacheManager::instance()->SetQuota(Config::Current()["DiskCacheSize"].toLongLong() * 1024 * 1024);
+    DiskCacheManager::instance()->SetConformQuota(Config::Current()["ConformCacheSize"].toLongLong() * 1024 * 1024);
+  }
+
+  // Oldest undo commands are dropped once the history keeps more than this alive
+  olive::undo_stack.SetMemoryLimit(Config::Current()["UndoMemoryLimit"].toLongLong() * 1024 * 1024);
+
+  // Past this, caches and pools are asked to give memory back before the system starts swapping
+  MemoryBudget::SetLimit(Config::Current()["MemoryLimit"].toLongLong() * 1024 * 1024);
+
+  // Every render backend and CPU-bound Task shares the same thread budget
+  RenderBudget::SetThreadCount(Config::Current()["RenderThreadCount"].toInt());
+  RenderBudget::SetGPUContextCount(Config::Current()["RenderGPUContextCount"].toInt());
+  olive::task_manager.SetMaximumTaskCount(Task::kCPUBound, RenderBudget::ThreadCount());
+  OpenGLMemoryBudget::SetBudget(Config::Current()["GPUMemoryBudget"].toLongLong() * 1024 * 1024);
+
+  // Set up color manager (the OCIO config is parsed in the background from here)
   ColorManager::CreateInstance();
 
+  // Set up thumbnail generation for the project and timeline views
+  ThumbnailService::CreateInstance();
+
+  // Keep autorecovery copies of open projects
+  AutoRecovery::CreateInstance();
+
+  // Keep footage that's still being recorded up to date as it's edited
+  FootageWatcher::CreateInstance();
+  connect(FootageWatcher::instance(), SIGNAL(FileGrown(Footage*)), this, SLOT(FootageFileGrown(Footage*)));
+
 
   //
-  // Start GUI (FIXME CLI mode)
+  // Start GUI, or render without it
   //
 
+  OpenGLBackend::SetSoftwareRendering(parser.isSet(software_option));
+
+  // Let monitoring keep an eye on headless render nodes
+  if (parser.isSet(metrics_option)
+      && (parser.isSet(render_option) || parser.isSet(distribute_option) || parser.isSet(worker_option))) {
+    MetricsServer::CreateInstance();
+
+    // Metrics aren't authenticated so only serve them to other machines when asked to
+    QHostAddress metrics_address(QHostAddress::LocalHost);
+
+    if (parser.isSet(metrics_bind_option) && !metrics_address.setAddress(parser.value(metrics_bind_option))) {
+      qWarning() << "Invalid metrics address" << parser.value(metrics_bind_option) << "- serving on localhost";
+      metrics_address = QHostAddress(QHostAddress::LocalHost);
+    }
+
+    if (!MetricsServer::instance()->Listen(metrics_address,
+                                           static_cast<quint16>(parser.value(metrics_option).toUInt()))) {
+      qWarning() << "Failed to serve metrics on" << metrics_address.toString() << "port"
+                 << parser.value(metrics_option) << ":" << MetricsServer::instance()->GetError();
+    }
+  }
+
+  if (parser.isSet(render_option)) {
+    render_project_ = parser.value(render_option);
+    render_sequence_ = parser.value(sequence_option);
+    render_outputs_ = parser.values(output_option);
+
+    QMetaObject::invokeMethod(this, "RunHeadlessRender", Qt::QueuedConnection);
+    return;
+  }
+
+  if (parser.isSet(distribute_option)) {
+    render_project_ = parser.value(distribute_option);
+    render_sequence_ = parser.value(sequence_option);
+    render_chunk_length_ = parser.isSet(chunk_option) ? parser.value(chunk_option).toDouble() : 10.0;
+    render_processes_ = parser.value(processes_option).toInt();
+
+    QMetaObject::invokeMethod(this, "RunDistributedRender", Qt::QueuedConnection);
+    return;
+  }
+
+  if (parser.isSet(worker_option)) {
+    RenderFarm::SetJobFolder(parser.value(jobs_option));
+
+    QMetaObject::invokeMethod(this, "RunFarmWorker", Qt::QueuedConnection);
+    return;
+  }
+
   StartGUI(parser.isSet(fullscreen_option));
 
-  // Create new project on startup
-  // FIXME: Load project from startup_project_ instead if not empty
-  AddOpenProject(std::make_shared<Project>());
+  // Viewers cache in the background, which holds back while the user is working
+  InteractivityMonitor::CreateInstance();
+  InteractivityMonitor::instance()->UpdateFromConfig();
+
+  // Load the project from the command line, or create a new one
+  {
+    Tracer::Scope trace("startup", "OpenProject");
+
+    if (startup_project_.isEmpty() || !OpenProject(startup_project_)) {
+      AddOpenProject(std::make_shared<Project>());
+    }
+  }
+
+  QMetaObject::invokeMethod(this, "StartupFinished", Qt::QueuedConnection);
 }
 
 void Core::Stop()
@@ -116,9 +291,23 @@ void Core::Stop()
 
   AudioManager::DestroyInstance();
 
+  MetricsServer::DestroyInstance();
+
+  InteractivityMonitor::DestroyInstance();
+
+  FootageWatcher::DestroyInstance();
+
+  ThumbnailService::DestroyInstance();
+
   ColorManager::DestroyInstance();
 
   delete main_window_;
+
+  // Waits for any autorecovery still being written
+  AutoRecovery::DestroyInstance();
+
+  // Renderers may still write to the cache while they're closed with the main window
+  DiskCacheManager::DestroyInstance();
 }
 
 olive::MainWindow *Core::main_window()
@@ -180,6 +369,17 @@ void Core::SetSnapping(const bool &b)
   emit SnappingChanged(snapping_);
 }
 
+void Core::SetTimelineOpenGL(const bool &b)
+{
+  if (Config::Current()["TimelineOpenGL"].toBool() == b) {
+    return;
+  }
+
+  Config::Current()["TimelineOpenGL"] = b;
+
+  emit TimelineOpenGLChanged(b);
+}
+
 void Core::DialogAboutShow()
 {
   AboutDialog a(main_window_);
@@ -212,6 +412,106 @@ void Core::DialogImportShow()
   }
 }
 
+void Core::DialogExportShow()
+{
+  ProjectPanel* active_project_panel = olive::panel_manager->MostRecentlyFocused<ProjectPanel>();
+  Project* active_project;
+
+  if (active_project_panel == nullptr // Check that we found a Project panel
+      || (active_project = active_project_panel->project()) == nullptr) { // and that we could find an active Project
+    QMessageBox::critical(main_window_, tr("Failed to export"), tr("Failed to find active Project panel"));
+    return;
+  }
+
+  QList<Sequence*> sequences;
+
+  foreach (Item* item, active_project_panel->SelectedItems()) {
+    if (item->type() == Item::kSequence) {
+      sequences.append(static_cast<Sequence*>(item));
+    }
+  }
+
+  if (sequences.isEmpty()) {
+    QMessageBox::critical(main_window_, tr("Failed to export"), tr("Select the sequences to export in the project "
+                                                                   "first"));
+    return;
+  }
+
+  RenderQueuePanel* render_queue_panel = olive::panel_manager->MostRecentlyFocused<RenderQueuePanel>();
+
+  foreach (Sequence* sequence, sequences) {
+    QString filename = QFileDialog::getSaveFileName(main_window_,
+                                                    tr("Export \"%1\"").arg(sequence->name()));
+
+    if (filename.isEmpty()) {
+      continue;
+    }
+
+    // Deliverables of a sequence that's already queued are added to the same export so it's only rendered once
+    ExportTask* task = ExportTask::QueueDeliverable(active_project, sequence, filename);
+
+    if (task != nullptr && render_queue_panel != nullptr) {
+      render_queue_panel->AddTask(task);
+    }
+  }
+
+  if (render_queue_panel != nullptr) {
+    render_queue_panel->show();
+    render_queue_panel->raise();
+  }
+}
+
+void Core::DialogOpenProjectShow()
+{
+  QString filename = QFileDialog::getOpenFileName(main_window_,
+                                                  tr("Open Project"),
+                                                  QString(),
+                                                  tr("Olive Project (*.ove)"));
+
+  if (!filename.isEmpty()) {
+    OpenProject(filename);
+  }
+}
+
+void Core::SaveActiveProject()
+{
+  Project* active_project = GetActiveProject();
+
+  if (active_project == nullptr) {
+    return;
+  }
+
+  if (active_project->filename().isEmpty()) {
+    SaveActiveProjectAs();
+  } else {
+    SaveProject(active_project, active_project->filename());
+  }
+}
+
+void Core::SaveActiveProjectAs()
+{
+  Project* active_project = GetActiveProject();
+
+  if (active_project == nullptr) {
+    return;
+  }
+
+  QString filename = QFileDialog::getSaveFileName(main_window_,
+                                                  tr("Save Project As"),
+                                                  active_project->filename(),
+                                                  tr("Olive Project (*.ove)"));
+
+  if (filename.isEmpty()) {
+    return;
+  }
+
+  if (!filename.endsWith(".ove", Qt::CaseInsensitive)) {
+    filename.append(".ove");
+  }
+
+  SaveProject(active_project, filename);
+}
+
 void Core::DialogPreferencesShow()
 {
   PreferencesDialog pd(main_window_, main_window_->menuBar());
@@ -313,17 +613,238 @@ void Core::AddOpenProject(ProjectPtr p)
   emit ProjectOpened(p.get());
 }
 
+bool Core::OpenProject(const QString &filename)
+{
+  ProjectPtr p = ProjectSerializer::Load(filename);
+
+  if (p == nullptr) {
+    QMessageBox::critical(main_window_, tr("Failed to open project"), tr("Failed to open \"%1\"").arg(filename));
+    return false;
+  }
+
+  AddOpenProject(p);
+
+  return true;
+}
+
+bool Core::SaveProject(Project *project, const QString &filename)
+{
+  if (!ProjectSerializer::Save(project, filename)) {
+    QMessageBox::critical(main_window_, tr("Failed to save project"), tr("Failed to save \"%1\"").arg(filename));
+    return false;
+  }
+
+  main_window_->setWindowModified(false);
+
+  // The project file is now at least as recent as its autorecovery
+  AutoRecovery::instance()->Discard(project);
+
+  return true;
+}
+
+/**
+ * @brief Find the sequence called `name` (or the first one if `name` is empty) under `item`
+ */
+static Sequence* FindSequence(Item* item, const QString& name)
+{
+  for (int i=0;i<item->child_count();i++) {
+    Item* child = item->child(i);
+
+    if (child->type() == Item::kSequence && (name.isEmpty() || child->name() == name)) {
+      return static_cast<Sequence*>(child);
+    }
+
+    Sequence* sequence = FindSequence(child, name);
+
+    if (sequence != nullptr) {
+      return sequence;
+    }
+  }
+
+  return nullptr;
+}
+
+/**
+ * @brief Make an offscreen context current for render workers to share with when there's no window to get one from
+ *
+ * If there's no GPU to create one on, rendering falls back to the CPU (as it does straight away with --software).
+ */
+static void MakeOffscreenContextCurrent(QOffscreenSurface* surface, QOpenGLContext* context)
+{
+  if (OpenGLBackend::SoftwareRendering()) {
+    return;
+  }
+
+  surface->create();
+
+  if (!context->create() || !context->makeCurrent(surface)) {
+    qWarning() << "Failed to create an OpenGL context, rendering on the CPU instead";
+    OpenGLBackend::SetSoftwareRendering(true);
+  }
+}
+
+bool Core::HeadlessRender()
+{
+  if (render_outputs_.isEmpty()) {
+    qCritical() << "No file to render to was given (use --out)";
+    return false;
+  }
+
+  ProjectPtr project = ProjectSerializer::Load(render_project_);
+
+  if (project == nullptr) {
+    qCritical() << "Failed to open" << render_project_;
+    return false;
+  }
+
+  Sequence* sequence = FindSequence(project->root(), render_sequence_);
+
+  if (sequence == nullptr) {
+    if (render_sequence_.isEmpty()) {
+      qCritical() << render_project_ << "has no sequences";
+    } else {
+      qCritical() << render_project_ << "has no sequence called" << render_sequence_;
+    }
+
+    return false;
+  }
+
+  sequence->Materialize();
+
+  // The render workers share with whichever context is current when they start
+  QOffscreenSurface surface;
+  QOpenGLContext context;
+
+  MakeOffscreenContextCurrent(&surface, &context);
+
+  qInfo() << "Rendering" << sequence->name() << "to" << render_outputs_.join(", ");
+
+  Exporter exporter(sequence->viewer_output(), render_outputs_);
+  connect(&exporter, SIGNAL(ProgressChanged(int)), this, SLOT(HeadlessRenderProgress(int)));
+
+  bool result = exporter.Run();
+
+  context.doneCurrent();
+
+  if (!result) {
+    qCritical() << "Failed to render" << sequence->name() << "-" << exporter.GetError();
+  }
+
+  return result;
+}
+
+bool Core::DistributedRender()
+{
+  if (render_chunk_length_ <= 0) {
+    qCritical() << "Chunks must be longer than 0 seconds";
+    return false;
+  }
+
+  ProjectPtr project = ProjectSerializer::Load(render_project_);
+
+  if (project == nullptr) {
+    qCritical() << "Failed to open" << render_project_;
+    return false;
+  }
+
+  Sequence* sequence = FindSequence(project->root(), render_sequence_);
+
+  if (sequence == nullptr) {
+    if (render_sequence_.isEmpty()) {
+      qCritical() << render_project_ << "has no sequences";
+    } else {
+      qCritical() << render_project_ << "has no sequence called" << render_sequence_;
+    }
+
+    return false;
+  }
+
+  // Frames that are already in the shared cache are skipped by the workers, so the whole sequence is queued
+  TimeRangeList ranges;
+  ranges.InsertTimeRange(TimeRange(0, sequence->length()));
+
+  QList<TimeRange> chunks = RenderFarm::SplitIntoChunks(ranges,
+                                                        rational(qRound64(render_chunk_length_ * 1000), 1000),
+                                                        sequence->video_params().time_base());
+
+  // Local worker processes can render into the local cache when there's no shared one
+  if (render_processes_ > 0 && RenderFarm::JobFolder().isEmpty()) {
+    RenderFarm::SetJobFolder(RenderFarm::LocalJobFolder());
+  }
+
+  QStringList jobs;
+  QString error;
+
+  if (!RenderFarm::QueueJobs(render_project_, sequence, chunks, &jobs, &error)) {
+    qCritical() << error;
+    return false;
+  }
+
+  qInfo() << "Queued" << jobs.size() << "chunks of" << sequence->name() << "in" << RenderFarm::JobFolder();
+
+  FarmProcessPool processes;
+
+  if (render_processes_ > 0) {
+    processes.Start(render_processes_, OpenGLBackend::SoftwareRendering());
+  }
+
+  int remaining = jobs.size();
+
+  while (remaining > 0) {
+    QEventLoop loop;
+    QTimer::singleShot(FarmWorker::kPollInterval, &loop, SLOT(quit()));
+    loop.exec();
+
+    if (render_processes_ > 0 && !processes.IsRunning()) {
+      qCritical() << "Every render worker process has stopped," << RenderFarm::JobsRemaining(jobs)
+                  << "chunks are left in the queue";
+      return false;
+    }
+
+    RenderFarm::ReclaimStaleJobs(jobs);
+
+    int now_remaining = RenderFarm::JobsRemaining(jobs);
+
+    if (now_remaining != remaining) {
+      remaining = now_remaining;
+      qInfo() << "Rendered" << (jobs.size() - remaining) << "of" << jobs.size() << "chunks";
+    }
+  }
+
+  return true;
+}
+
+bool Core::FarmWorkerRender()
+{
+  QOffscreenSurface surface;
+  QOpenGLContext context;
+
+  MakeOffscreenContextCurrent(&surface, &context);
+
+  FarmWorker worker;
+
+  return worker.Run();
+}
+
 void Core::DeclareTypesForQt()
 {
   qRegisterMetaType<Task::Status>("Task::Status");
   qRegisterMetaType<NodeDependency>();
   qRegisterMetaType<rational>();
+  qRegisterMetaType<FramePtr>();
   qRegisterMetaType<OpenGLTexturePtr>();
+  qRegisterMetaType<SoftwareTexturePtr>();
   qRegisterMetaType<NodeValueTable>();
+  qRegisterMetaType<RenderSiblingJobPtr>();
 }
 
 void Core::StartGUI(bool full_screen)
 {
+  Tracer::Scope trace("startup", "StartGUI");
+
+  // Initialize audio service first, it lists the devices on a thread of its own while the rest of the GUI starts
+  AudioManager::CreateInstance();
+
   // Set UI style
   qApp->setStyle(QStyleFactory::create("Fusion"));
   StyleManager::SetStyle(StyleManager::DefaultStyle());
@@ -351,20 +872,29 @@ void Core::StartGUI(bool full_screen)
   // When a new project is opened, update the mainwindow
   connect(this, SIGNAL(ProjectOpened(Project*)), main_window_, SLOT(ProjectOpen(Project*)));
 
-  // Initialize audio service
-  AudioManager::CreateInstance();
-
   // Start autorecovery timer using the config value as its interval
+  connect(&autorecovery_timer_, SIGNAL(timeout()), this, SLOT(SaveAutorecovery()));
   SetAutorecoveryInterval(Config::Current()["AutorecoveryInterval"].toInt());
   autorecovery_timer_.start();
 }
 
-void Core::SaveAutorecovery()
+void Core::StartupFinished()
 {
-  if (queue_autorecovery_) {
-    // FIXME: Save autorecovery of projects open
+  if (!startup_trace_.isEmpty()) {
+    if (!Tracer::ExportChromeTrace(startup_trace_)) {
+      qWarning() << "Failed to save startup trace to" << startup_trace_;
+    }
 
-    queue_autorecovery_ = false;
+    Tracer::SetEnabled(false);
+    startup_trace_.clear();
+  }
+}
+
+void Core::SaveAutorecovery()
+{
+  // Only what's changed since the last autorecovery is written, so this is cheap when nothing has
+  foreach (ProjectPtr p, open_projects_) {
+    AutoRecovery::instance()->Save(p.get());
   }
 }
 
@@ -385,11 +915,41 @@ Project *Core::GetActiveProject()
 void Core::SetProjectModified()
 {
   main_window()->setWindowModified(true);
-  queue_autorecovery_ = true;
 }
 
-void Core::SetAutorecoveryInterval(int minutes)
+void Core::SetAutorecoveryInterval(int seconds)
+{
+  // Convert seconds to milliseconds
+  autorecovery_timer_.setInterval(seconds * 1000);
+}
+
+void Core::RunHeadlessRender()
 {
-  // Convert minutes to milliseconds
-  autorecovery_timer_.setInterval(minutes * 60000);
+  QCoreApplication::exit(HeadlessRender() ? 0 : 1);
+}
+
+void Core::RunDistributedRender()
+{
+  QCoreApplication::exit(DistributedRender() ? 0 : 1);
+}
+
+void Core::RunFarmWorker()
+{
+  QCoreApplication::exit(FarmWorkerRender() ? 0 : 1);
+}
+
+void Core::HeadlessRenderProgress(int percent)
+{
+  qInfo() << "Rendered" << percent << "%";
+}
+
+void Core::FootageFileGrown(Footage *footage)
+{
+  // One IndexTask indexes every stream of the file
+  foreach (StreamPtr stream, footage->streams()) {
+    if (stream->type() == Stream::kVideo || stream->type() == Stream::kAudio) {
+      IndexTask::IndexInBackground(stream);
+      break;
+    }
+  }
 }
@@ -24,6 +24,7 @@
 #include <QList>
 #include <QTimer>
 
+#include "project/item/footage/footage.h"
 #include "project/project.h"
 #include "project/projectviewmodel.h"
 #include "window/mainwindow/mainwindow.h"
@@ -123,9 +124,11 @@ public:
   void SetProjectModified();
 
   /**
-   * @brief Set how frequently an autorecovery should be saved (if the project has changed, see SetProjectModified())
+   * @brief Set how frequently (in seconds) the autorecovery copies of open projects are brought up to date
+   *
+   * See AutoRecovery, a save only writes what's changed since the last one.
    */
-  void SetAutorecoveryInterval(int minutes);
+  void SetAutorecoveryInterval(int seconds);
 
 public slots:
   /**
@@ -140,6 +143,11 @@ public slots:
    */
   void SetSnapping(const bool& b);
 
+  /**
+   * @brief Set whether timelines draw through OpenGL, open timelines switch over straight away
+   */
+  void SetTimelineOpenGL(const bool& b);
+
   /**
    * @brief Show an About dialog
    */
@@ -150,6 +158,11 @@ public slots:
    */
   void DialogImportShow();
 
+  /**
+   * @brief Ask where to export each sequence selected in the active project panel and queue them in the render queue
+   */
+  void DialogExportShow();
+
   /**
    * @brief Show Preferences dialog
    */
@@ -160,6 +173,21 @@ public slots:
    */
   void DialogProjectPropertiesShow();
 
+  /**
+   * @brief Show an open dialog and open the project selected
+   */
+  void DialogOpenProjectShow();
+
+  /**
+   * @brief Save the currently active project, asking for a filename if it doesn't have one yet
+   */
+  void SaveActiveProject();
+
+  /**
+   * @brief Ask for a filename and save the currently active project to it
+   */
+  void SaveActiveProjectAs();
+
   /**
    * @brief Create a new folder in the currently active project
    */
@@ -190,12 +218,27 @@ signals:
    */
   void SnappingChanged(const bool& b);
 
+  /**
+   * @brief Signal emitted when the timeline OpenGL setting is changed
+   */
+  void TimelineOpenGLChanged(const bool& b);
+
 private:
   /**
    * @brief Creates an empty project and adds it to the "open projects"
    */
   void AddOpenProject(ProjectPtr p);
 
+  /**
+   * @brief Load a project file and add it to the "open projects", shows an error if it couldn't be loaded
+   */
+  bool OpenProject(const QString& filename);
+
+  /**
+   * @brief Save `project` to `filename`, shows an error if it couldn't be saved
+   */
+  bool SaveProject(Project* project, const QString& filename);
+
   /**
    * @brief Declare custom types/classes for Qt's signal/slot system
    *
@@ -212,6 +255,25 @@ private:
    */
   void StartGUI(bool full_screen);
 
+  /**
+   * @brief Render render_sequence_ of render_project_ to render_outputs_ without any UI
+   *
+   * Errors are printed rather than shown in a dialog.
+   */
+  bool HeadlessRender();
+
+  /**
+   * @brief Queue render_sequence_ of render_project_ for render farm workers and wait until they've rendered it
+   *
+   * See RenderFarm.
+   */
+  bool DistributedRender();
+
+  /**
+   * @brief Render jobs queued by DistributedRender() on any machine until Olive is closed
+   */
+  bool FarmWorkerRender();
+
   /**
    * @brief Internal main window object
    */
@@ -225,6 +287,30 @@ private:
    */
   QString startup_project_;
 
+  /**
+   * @brief Project, sequence name and output file given on the command line to render without the GUI
+   *
+   * render_project_ is empty unless Olive was started in this mode. An empty render_sequence_ means the first
+   * sequence in the project.
+   */
+  QString render_project_;
+  QString render_sequence_;
+
+  /**
+   * @brief Every file to render to, the sequence is only rendered once however many there are
+   */
+  QStringList render_outputs_;
+
+  /**
+   * @brief Seconds of the sequence in each job queued by DistributedRender()
+   */
+  double render_chunk_length_;
+
+  /**
+   * @brief Number of worker processes DistributedRender() starts on this machine (see FarmProcessPool)
+   */
+  int render_processes_;
+
   /**
    * @brief List of currently open projects
    */
@@ -241,21 +327,42 @@ private:
   bool snapping_;
 
   /**
-   * @brief Internal value for whether to make an autorecovery next interval
-   *
-   * True if the project has changed since the last autorecovery and we should save next time. False if the project has
-   * not changed and saving another autorecovery would be a waste.
+   * @brief Internal timer for saving autorecovery files
    */
-  bool queue_autorecovery_;
+  QTimer autorecovery_timer_;
 
   /**
-   * @brief Internal timer for saving autorecovery files
+   * @brief File to save a trace of startup to (see Tracer), empty if startup isn't being traced
    */
-  QTimer autorecovery_timer_;
+  QString startup_trace_;
 
 private slots:
   void SaveAutorecovery();
 
+  /**
+   * @brief Runs once the event loop has started after the main window was shown, logs how long startup took
+   */
+  void StartupFinished();
+
+  /**
+   * @brief Runs HeadlessRender() once the event loop has started and quits with its result
+   */
+  void RunHeadlessRender();
+
+  /**
+   * @brief Run DistributedRender() and FarmWorkerRender() once the event loop has started and quit with their result
+   */
+  void RunDistributedRender();
+  void RunFarmWorker();
+
+  void HeadlessRenderProgress(int percent);
+
+  /**
+   * @brief Index what's been added to a footage file that's still being written, so the footage can be used up to
+   * its new end
+   */
+  void FootageFileGrown(Footage* footage);
+
 };
 
 namespace olive {
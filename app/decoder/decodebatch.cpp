@@ -0,0 +1,127 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "decodebatch.h"
+
+DecodeBatch::DecodeBatch(const QVector<rational> &times, int divider) :
+  times_(times),
+  divider_(divider),
+  frames_(times.size()),
+  ready_(times.size(), false),
+  remaining_(times.size()),
+  cancelled_(false)
+{
+}
+
+const QVector<rational> &DecodeBatch::times() const
+{
+  return times_;
+}
+
+int DecodeBatch::divider() const
+{
+  return divider_;
+}
+
+int DecodeBatch::IndexOf(const rational &time) const
+{
+  return times_.indexOf(time);
+}
+
+FramePtr DecodeBatch::Wait(int index)
+{
+  lock_.lock();
+
+  while (!ready_.at(index)) {
+    ready_cond_.wait(&lock_);
+  }
+
+  FramePtr frame = frames_.at(index);
+
+  lock_.unlock();
+
+  return frame;
+}
+
+void DecodeBatch::WaitForAll()
+{
+  lock_.lock();
+
+  while (remaining_ > 0) {
+    ready_cond_.wait(&lock_);
+  }
+
+  lock_.unlock();
+}
+
+bool DecodeBatch::IsFinished()
+{
+  lock_.lock();
+  bool finished = (remaining_ == 0);
+  lock_.unlock();
+
+  return finished;
+}
+
+void DecodeBatch::Cancel()
+{
+  lock_.lock();
+  cancelled_ = true;
+  lock_.unlock();
+}
+
+bool DecodeBatch::IsCancelled()
+{
+  lock_.lock();
+  bool cancelled = cancelled_;
+  lock_.unlock();
+
+  return cancelled;
+}
+
+void DecodeBatch::SetFrame(int index, FramePtr frame)
+{
+  lock_.lock();
+
+  if (!ready_.at(index)) {
+    frames_[index] = frame;
+    ready_[index] = true;
+    remaining_--;
+  }
+
+  ready_cond_.wakeAll();
+
+  lock_.unlock();
+}
+
+void DecodeBatch::Finish()
+{
+  lock_.lock();
+
+  for (int i=0;i<ready_.size();i++) {
+    ready_[i] = true;
+  }
+
+  remaining_ = 0;
+
+  ready_cond_.wakeAll();
+
+  lock_.unlock();
+}
@@ -0,0 +1,105 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef DECODEBATCH_H
+#define DECODEBATCH_H
+
+#include <memory>
+#include <QMutex>
+#include <QVector>
+#include <QWaitCondition>
+
+#include "common/rational.h"
+#include "frame.h"
+
+/**
+ * @brief A set of video frames being decoded in the background, like a future for each one
+ *
+ * Whoever decodes the batch (see Decoder::RetrieveVideoBatch()) hands each frame over with SetFrame() as soon as it's
+ * decoded, so the first frames can be used while the rest are still being decoded.
+ */
+class DecodeBatch
+{
+public:
+  DecodeBatch(const QVector<rational>& times, int divider);
+
+  const QVector<rational>& times() const;
+
+  int divider() const;
+
+  /**
+   * @brief Index of this time in times() or -1 if it isn't in the batch
+   */
+  int IndexOf(const rational& time) const;
+
+  /**
+   * @brief Block until the frame at this index has been decoded and return it
+   *
+   * Returns nullptr if it couldn't be decoded or the batch was cancelled before it was.
+   */
+  FramePtr Wait(int index);
+
+  /**
+   * @brief Block until every frame has been handed over (or given up on)
+   */
+  void WaitForAll();
+
+  /**
+   * @brief Returns whether every frame has been handed over (or given up on)
+   */
+  bool IsFinished();
+
+  /**
+   * @brief Don't decode any frames that haven't been decoded yet
+   */
+  void Cancel();
+
+  bool IsCancelled();
+
+  /**
+   * @brief Hand over the frame at this index and wake up anything waiting for it
+   */
+  void SetFrame(int index, FramePtr frame);
+
+  /**
+   * @brief Give up on every frame that hasn't been handed over, must be called once the decoder is done with the batch
+   */
+  void Finish();
+
+private:
+  QVector<rational> times_;
+
+  int divider_;
+
+  QMutex lock_;
+  QWaitCondition ready_cond_;
+
+  QVector<FramePtr> frames_;
+  QVector<bool> ready_;
+
+  int remaining_;
+
+  bool cancelled_;
+
+};
+
+using DecodeBatchPtr = std::shared_ptr<DecodeBatch>;
+
+#endif // DECODEBATCH_H
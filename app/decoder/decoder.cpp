@@ -20,22 +20,36 @@
 
 #include "decoder.h"
 
+#include <algorithm>
 #include <QCoreApplication>
 #include <QDebug>
+#include <QFile>
 #include <QFileInfo>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
 
 #include "decoder/ffmpeg/ffmpegdecoder.h"
 #include "decoder/oiio/oiiodecoder.h"
+#include "decoder/probecache.h"
 
 Decoder::Decoder() :
   open_(false),
-  stream_(nullptr)
+  stream_(nullptr),
+  planar_yuv_output_(false),
+  render_mode_(olive::kOffline),
+  profile_(kProfileThroughput),
+  thread_count_(0)
 {
 }
 
 Decoder::Decoder(Stream *fs) :
   open_(false),
-  stream_(fs)
+  stream_(fs),
+  planar_yuv_output_(false),
+  render_mode_(olive::kOffline),
+  profile_(kProfileThroughput),
+  thread_count_(0)
 {
 }
 
@@ -55,11 +69,83 @@ void Decoder::set_stream(StreamPtr fs)
   stream_ = fs;
 }
 
-FramePtr Decoder::RetrieveVideo(const rational &/*timecode*/)
+bool Decoder::planar_yuv_output() const
+{
+  return planar_yuv_output_;
+}
+
+void Decoder::set_planar_yuv_output(bool e)
+{
+  planar_yuv_output_ = e;
+}
+
+olive::RenderMode Decoder::render_mode() const
+{
+  return render_mode_;
+}
+
+void Decoder::set_render_mode(olive::RenderMode mode)
+{
+  render_mode_ = mode;
+}
+
+void Decoder::set_profile(Decoder::Profile profile, int thread_count)
+{
+  profile_ = profile;
+  thread_count_ = thread_count;
+}
+
+Decoder::Profile Decoder::profile() const
+{
+  return profile_;
+}
+
+int Decoder::thread_count() const
+{
+  return thread_count_;
+}
+
+QMutex *Decoder::lock()
+{
+  return &lock_;
+}
+
+FramePtr Decoder::RetrieveVideo(const rational &/*timecode*/, const int &/*divider*/)
 {
   return nullptr;
 }
 
+FramePtr Decoder::RetrieveThumbnail(const rational &timecode, const int &divider)
+{
+  return RetrieveVideo(timecode, divider);
+}
+
+void Decoder::RetrieveVideoBatch(DecodeBatch *batch)
+{
+  // Sorted by time, identical times are only decoded once
+  QMap<rational, QVector<int> > order;
+
+  for (int i=0;i<batch->times().size();i++) {
+    order[batch->times().at(i)].append(i);
+  }
+
+  QMap<rational, QVector<int> >::const_iterator i;
+
+  for (i=order.constBegin();i!=order.constEnd();i++) {
+    if (batch->IsCancelled()) {
+      break;
+    }
+
+    FramePtr frame = RetrieveVideo(i.key(), batch->divider());
+
+    foreach (int index, i.value()) {
+      batch->SetFrame(index, frame);
+    }
+  }
+
+  batch->Finish();
+}
+
 FramePtr Decoder::RetrieveAudio(const rational &/*timecode*/, const rational &/*length*/, const AudioRenderingParams &/*params*/)
 {
   return nullptr;
@@ -70,15 +156,63 @@ bool Decoder::SupportsVideo()
   return false;
 }
 
+bool Decoder::IsStill()
+{
+  return false;
+}
+
+Decoder::DecodePath Decoder::ActiveDecodePath()
+{
+  return kDecodePathSoftware;
+}
+
 bool Decoder::SupportsAudio()
 {
   return false;
 }
 
+Decoder::ProbeHint Decoder::GetProbeHint(const QString &filename, const QByteArray &header)
+{
+  Q_UNUSED(filename)
+  Q_UNUSED(header)
+
+  return kProbeHintUnknown;
+}
+
 /*
  * DECODER STATIC PUBLIC MEMBERS
  */
 
+namespace {
+
+/**
+ * @brief Bytes read from the start of a file for GetProbeHint()
+ */
+const qint64 kProbeHeaderSize = 4096;
+
+/**
+ * @brief ID of the decoder that last probed a file with each extension
+ */
+QHash<QString, QString> probe_verdicts;
+QMutex probe_verdict_lock;
+
+struct ProbeCandidate {
+  DecoderPtr decoder;
+  Decoder::ProbeHint hint;
+  bool previous_verdict;
+};
+
+bool ProbeCandidateFirst(const ProbeCandidate& a, const ProbeCandidate& b)
+{
+  if (a.hint != b.hint) {
+    return a.hint > b.hint;
+  }
+
+  return a.previous_verdict && !b.previous_verdict;
+}
+
+}
+
 QVector<DecoderPtr> ReceiveListOfAllDecoders() {
   QVector<DecoderPtr> decoders;
 
@@ -108,13 +242,51 @@ bool Decoder::ProbeMedia(Footage *f)
   // Reset Footage state for probing
   f->Clear();
 
-  // Create list to iterate through
+  // If this exact file has been probed before, restore its metadata without opening any decoders
+  if (ProbeCache::Load(f)) {
+    f->set_status(Footage::kReady);
+
+    return true;
+  }
+
+  // Opening a file is the slow part of probing, so find out which decoder it's most likely for first and open it with
+  // that one
+  QByteArray header;
+
+  QFile file(f->filename());
+
+  if (file.open(QFile::ReadOnly)) {
+    header = file.read(kProbeHeaderSize);
+    file.close();
+  }
+
+  QString extension = QFileInfo(f->filename()).suffix().toLower();
+
+  probe_verdict_lock.lock();
+  QString previous_verdict = probe_verdicts.value(extension);
+  probe_verdict_lock.unlock();
+
   QVector<DecoderPtr> decoder_list = ReceiveListOfAllDecoders();
+  QVector<ProbeCandidate> candidates;
+
+  foreach (DecoderPtr decoder, decoder_list) {
+    ProbeCandidate candidate;
+    candidate.decoder = decoder;
+    candidate.hint = decoder->GetProbeHint(f->filename(), header);
+    candidate.previous_verdict = (decoder->id() == previous_verdict);
+
+    if (candidate.hint != kProbeHintNone) {
+      candidates.append(candidate);
+    }
+  }
+
+  // Stable so decoders that are otherwise equal stay in priority order
+  std::stable_sort(candidates.begin(), candidates.end(), ProbeCandidateFirst);
 
   // Pass Footage through each Decoder's probe function
-  for (int i=0;i<decoder_list.size();i++) {
+  for (int i=0;i<candidates.size();i++) {
 
-    DecoderPtr decoder = decoder_list.at(i);
+    DecoderPtr decoder = candidates.at(i).decoder;
 
     if (decoder->Probe(f)) {
 
@@ -124,7 +296,12 @@ bool Decoder::ProbeMedia(Footage *f)
       // Attach the successful Decoder to this Footage object
       f->set_decoder(decoder->id());
 
-      // FIXME: Cache the results so we don't have to probe if this media is added a second time
+      probe_verdict_lock.lock();
+      probe_verdicts.insert(extension, decoder->id());
+      probe_verdict_lock.unlock();
+
+      // Cache the results so we don't have to probe if this media is added a second time
+      ProbeCache::Save(f);
 
       return true;
     }
@@ -161,3 +338,13 @@ void Decoder::Conform(const AudioRenderingParams &params)
   qCritical() << "Conform called on an audio decoder that does not have a handler for it:" << id();
   abort();
 }
+
+void Decoder::Index(const QAtomicInt *cancelled)
+{
+  Q_UNUSED(cancelled)
+}
+
+int64_t Decoder::IndexedDuration()
+{
+  return -1;
+}
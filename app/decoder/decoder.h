@@ -21,13 +21,17 @@
 #ifndef DECODER_H
 #define DECODER_H
 
+#include <QAtomicInt>
+#include <QMutex>
 #include <QObject>
 #include <stdint.h>
 
 #include "common/constructors.h"
 #include "common/rational.h"
 #include "project/item/footage/footage.h"
+#include "decoder/decodebatch.h"
 #include "decoder/frame.h"
+#include "render/rendermodes.h"
 
 class Decoder;
 using DecoderPtr = std::shared_ptr<Decoder>;
@@ -66,6 +70,49 @@ public:
   StreamPtr stream();
   void set_stream(StreamPtr fs);
 
+  /**
+   * @brief Allow RetrieveVideo() to return planar YUV frames instead of packed RGBA
+   *
+   * Only set this if the consumer of the frames can convert YUV itself (see Frame::is_yuv()). Decoders are free to
+   * ignore this and return RGBA regardless. Defaults to FALSE.
+   */
+  bool planar_yuv_output() const;
+  void set_planar_yuv_output(bool e);
+
+  /**
+   * @brief Set what the frames retrieved are for, so decoders can trade conversion quality for speed
+   *
+   * olive::kOffline (the default) favours speed, olive::kOnline accuracy. Takes effect from the next frame retrieved.
+   */
+  olive::RenderMode render_mode() const;
+  void set_render_mode(olive::RenderMode mode);
+
+  enum Profile {
+    /// Decoding runs of frames in the background as fast as possible overall
+    kProfileThroughput,
+
+    /// Decoding single frames the user is waiting on (e.g. while scrubbing) as soon as possible
+    kProfileInteractive
+  };
+
+  /**
+   * @brief Set what this decoder is tuned for and how many threads it decodes with (0 lets the decoder decide)
+   *
+   * Takes effect the next time the decoder is opened. Defaults to kProfileThroughput with 0 threads.
+   */
+  void set_profile(Profile profile, int thread_count = 0);
+
+  Profile profile() const;
+
+  int thread_count() const;
+
+  /**
+   * @brief Mutex to serialize access to this decoder when it's shared between several render threads
+   *
+   * Decoders themselves are not thread-safe, anything calling into a shared decoder should hold this lock.
+   */
+  QMutex* lock();
+
   /**
    * @brief Probe a footage file and dump metadata about it
    *
@@ -93,6 +140,32 @@ public:
    */
   virtual bool Probe(Footage* f) = 0;
 
+  enum ProbeHint {
+    /// This decoder can't open files like this, Probe() won't be called
+    kProbeHintNone,
+
+    /// Nothing known either way
+    kProbeHintUnknown,
+
+    /// The file's extension is one this decoder handles
+    kProbeHintExtension,
+
+    /// The start of the file is a format this decoder handles
+    kProbeHintMagic
+  };
+
+  /**
+   * @brief Say how likely Probe() is to succeed on this file without opening it
+   *
+   * ProbeMedia() calls Probe() on decoders with stronger hints first, so usually only the decoder that ends up being
+   * used opens the file at all. This must be cheap and thread-safe. The default is kProbeHintUnknown.
+   *
+   * @param header
+   *
+   * The first bytes of the file (fewer if the file is shorter).
+   */
+  virtual ProbeHint GetProbeHint(const QString& filename, const QByteArray& header);
+
   /**
    * @brief Open media/allocate memory
    *
@@ -122,12 +195,41 @@ public:
    * The timecode (a rational in seconds) to retrieve the frame at. If there is not a frame at this precise location
    * this should be corrected internally to the closest fit for the timecode.
    *
+   * @param divider
+   *
+   * The resolution divider the frame will be rendered at (see VideoRenderingParams::divider()). Decoders may use this
+   * to decode and convert at a reduced resolution. Returning a larger frame than requested is acceptable.
+   *
    * @return
    *
    * A FramePtr of valid data at this timecode or nullptr if there was nothing to retrieve at the provided timecode or
    * the media could not be opened.
    */
-  virtual FramePtr RetrieveVideo(const rational& timecode);
+  virtual FramePtr RetrieveVideo(const rational& timecode, const int& divider);
+
+  /**
+   * @brief Retrieve a quick preview frame for thumbnails
+   *
+   * Unlike RetrieveVideo(), this doesn't need to be frame-accurate. Decoders should return whichever frame near
+   * `timecode` is cheapest to produce (e.g. the closest keyframe) and should avoid indexing the file to find it, since
+   * thumbnails are requested for many files at once. The result is always packed RGBA.
+   *
+   * The default implementation falls back to RetrieveVideo().
+   */
+  virtual FramePtr RetrieveThumbnail(const rational& timecode, const int& divider);
+
+  /**
+   * @brief Retrieve every video frame in a batch, handing each one over as soon as it's decoded
+   *
+   * Blocks until the whole batch has been decoded or it's cancelled, so it's meant to be called from another thread
+   * than the one waiting on the batch's frames. The caller must hold lock() for the duration, and the batch is
+   * finished (see DecodeBatch::Finish()) when this returns.
+   *
+   * The default implementation calls RetrieveVideo() for each frame in time order, whatever order the batch is in,
+   * so a decoder that can keep decoding forward doesn't seek between them. Decoders that can do better with the
+   * whole batch in front of them (e.g. reading ahead for it) may override this.
+   */
+  virtual void RetrieveVideoBatch(DecodeBatch* batch);
 
   /**
    * @brief Retrieve video frame
@@ -158,6 +260,33 @@ public:
   virtual bool SupportsVideo();
   virtual bool SupportsAudio();
 
+  /**
+   * @brief Returns whether every time gives the same frame (e.g. a still image), FALSE by default
+   */
+  virtual bool IsStill();
+
+  /**
+   * @brief How video frames were decoded, as flags so several decoders' paths can be combined
+   */
+  enum DecodePath {
+    /// Nothing has been decoded yet
+    kDecodePathNone = 0x0,
+
+    /// Decoded on the CPU
+    kDecodePathSoftware = 0x1,
+
+    /// Decoded on a hardware device and transferred to system memory
+    kDecodePathHardwareTransfer = 0x2
+  };
+
+  /**
+   * @brief Returns how the last video frame was decoded, kDecodePathSoftware by default
+   *
+   * Hardware decoding falls back to software when the device can't decode a stream, so this is what actually happened
+   * rather than what the preferences asked for. Safe to call from any thread.
+   */
+  virtual DecodePath ActiveDecodePath();
+
   /**
    * @brief Close media/deallocate memory
    *
@@ -184,6 +313,9 @@ public:
    * functions until one indicates that it can decode this file. That Decoder will then dump information about the file
    * into the Footage object for use throughout the program.
    *
+   * Decoders are tried in order of their GetProbeHint(), then whichever decoder last probed a file with the same
+   * extension, then priority.
+   *
    * Probing may be a lengthy process and it's recommended to run this in a separate thread.
    *
    * @param f
@@ -219,11 +351,43 @@ public:
    */
   virtual void Conform(const AudioRenderingParams& params);
 
+  /**
+   * @brief Create an index for this media ahead of time
+   *
+   * Decoders that need an index create one on demand the first time they're asked for data, which blocks whatever
+   * asked. Calling this from a background task beforehand avoids that. Index() must be called while the Decoder is
+   * open. If `cancelled` is provided, indexing stops as soon as possible once it becomes non-zero and no partial index
+   * is left behind.
+   *
+   * The default implementation does nothing, for decoders that don't use an index.
+   */
+  virtual void Index(const QAtomicInt* cancelled = nullptr);
+
+  /**
+   * @brief Get how long the stream is according to its index, in the stream's timebase
+   *
+   * Unlike the duration probed on import, this keeps up with a file that's still being written, once it's been
+   * indexed again with Index(). Must be called while the Decoder is open.
+   *
+   * The default implementation returns -1, meaning the duration isn't known without probing the file.
+   */
+  virtual int64_t IndexedDuration();
+
 protected:
   bool open_;
 
 private:
   StreamPtr stream_;
+
+  bool planar_yuv_output_;
+
+  olive::RenderMode render_mode_;
+
+  Profile profile_;
+
+  int thread_count_;
+
+  QMutex lock_;
 };
 
 #endif // DECODER_H
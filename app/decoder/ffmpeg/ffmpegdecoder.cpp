@@ -23,30 +23,286 @@
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
+#include <libavutil/hwcontext.h>
+#include <libavutil/imgutils.h>
 #include <libavutil/pixdesc.h>
 }
 
+#include <algorithm>
+#include <QCryptographicHash>
+#include <QDataStream>
 #include <QDebug>
 #include <QFile>
 #include <QFileInfo>
+#include <QMutex>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QSemaphore>
+#include <QSet>
 #include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QWaitCondition>
 #include <QtMath>
 
 #include "common/filefunctions.h"
+#include "common/slicepool.h"
 #include "common/timecodefunctions.h"
+#include "common/tracer.h"
+#include "config/config.h"
+#include "decoder/waveformsummary.h"
 #include "decoder/waveinput.h"
+#include "render/diskcachemanager.h"
 #include "render/pixelservice.h"
 
+namespace {
+
+/**
+ * @brief Number of output samples ResampleWindow() starts ahead of a window to prime the resampler's filter
+ */
+const int64_t kWindowPrimingSamples = 256;
+
+/**
+ * @brief Most bytes of frames RetrieveVideo() keeps decoded ahead while playing backwards
+ */
+const int kReverseBufferSize = 256 * 1024 * 1024;
+
+/**
+ * @brief Requests in a row that have to go backwards before RetrieveVideo() takes it as playing backwards
+ *
+ * A single step back is usually a seek or scrub, which shouldn't cost a whole GOP of buffered frames.
+ */
+const int kReverseRequestCount = 2;
+
+/**
+ * @brief Most threads to decode with, more than this are slower for most codecs (and some refuse to open)
+ */
+const int kMaximumThreads = 16;
+
+/**
+ * @brief Frames with fewer pixels than this (a little under 2K) are converted in one pass on the calling thread
+ */
+const int kMinimumSlicedPixels = 2000 * 1000;
+
+/**
+ * @brief Slices shorter than this aren't worth the overhead of handing to another thread
+ */
+const int kMinimumSliceHeight = 128;
+
+/**
+ * @brief Converts a band of rows of a frame with sws_scale()
+ *
+ * Each slice has its own SwsContext, so any number of these can run at once.
+ */
+class ScaleSliceTask : public QRunnable
+{
+public:
+  ScaleSliceTask(SwsContext* ctx, const uint8_t* const* src_data, const int* src_linesize, int height,
+                 uint8_t* dst_data, int dst_linesize, QSemaphore* finished) :
+    ctx_(ctx),
+    src_linesize_(src_linesize),
+    height_(height),
+    dst_data_(dst_data),
+    dst_linesize_(dst_linesize),
+    finished_(finished)
+  {
+    for (int i=0;i<AV_NUM_DATA_POINTERS;i++) {
+      src_data_[i] = src_data[i];
+    }
+  }
+
+  virtual void run() override
+  {
+    sws_scale(ctx_, src_data_, src_linesize_, 0, height_, &dst_data_, &dst_linesize_);
+
+    if (finished_ != nullptr) {
+      finished_->release();
+    }
+  }
+
+private:
+  SwsContext* ctx_;
+
+  const uint8_t* src_data_[AV_NUM_DATA_POINTERS];
+
+  const int* src_linesize_;
+
+  int height_;
+
+  uint8_t* dst_data_;
+
+  int dst_linesize_;
+
+  QSemaphore* finished_;
+
+};
+
+/**
+ * @brief Identifies a record of where indexing a video stream got to (see FFmpegDecoder::SaveResumePoint())
+ */
+const char kResumeMagic[4] = {'O', 'I', 'R', 'P'};
+const quint32 kResumeVersion = 1;
+
+/**
+ * @brief Bytes at the start of a file that must be the same for indexing to carry on from where it got to
+ *
+ * A file that's still being written is only ever added to, so a different header means it was replaced.
+ */
+const int kResumeHeaderSize = 64 * 1024;
+
+QByteArray HashFileHeader(const QString& filename)
+{
+  QFile file(filename);
+
+  if (!file.open(QFile::ReadOnly)) {
+    return QByteArray();
+  }
+
+  QByteArray hash = QCryptographicHash::hash(file.read(kResumeHeaderSize), QCryptographicHash::Sha1);
+
+  file.close();
+
+  return hash;
+}
+
+/**
+ * @brief Conformed filenames queued as a BackgroundConformTask, so each is only queued once
+ */
+QSet<QString> background_conforms;
+
+/**
+ * @brief Conformed filenames a BackgroundConformTask failed to write, so RetrieveAudio() doesn't queue them again
+ */
+QSet<QString> failed_conforms;
+
+/**
+ * @brief Conformed filenames currently being written by FFmpegDecoder::Conform(), by any decoder
+ */
+QSet<QString> conforms_in_progress;
+QMutex conform_lock;
+QWaitCondition conform_done;
+
+/**
+ * @brief Let anyone waiting on this conform know it's over, whether or not it succeeded
+ */
+void FinishConform(const QString& conformed_fn)
+{
+  conform_lock.lock();
+  conforms_in_progress.remove(conformed_fn);
+  conform_done.wakeAll();
+  conform_lock.unlock();
+}
+
+/**
+ * @brief Index filenames currently being written by an FFmpegIndexer
+ */
+QSet<QString> indexes_in_progress;
+QMutex indexing_lock;
+QWaitCondition indexing_done;
+
+/**
+ * @brief Threads that run BackgroundConformTasks
+ *
+ * A conform reads and resamples the whole stream, so running them on QThreadPool::globalInstance() could tie up the
+ * threads rendering and prefetching frames for minutes. One at a time is plenty since RetrieveAudio() resamples what
+ * it needs on the fly in the meantime.
+ */
+QThreadPool* CreateConformPool()
+{
+  QThreadPool* pool = new QThreadPool();
+
+  pool->setMaxThreadCount(1);
+
+  return pool;
+}
+
+QThreadPool* ConformPool()
+{
+  // Never deleted, so conforms still in flight when statics are destroyed at exit can finish
+  static QThreadPool* pool = CreateConformPool();
+
+  return pool;
+}
+
+/**
+ * @brief Conforms a stream with its own decoder so the decoder that requested it stays free for playback
+ */
+class BackgroundConformTask : public QRunnable
+{
+public:
+  BackgroundConformTask(StreamPtr stream, const AudioRenderingParams& params, const QString& conformed_fn) :
+    stream_(stream),
+    params_(params),
+    conformed_fn_(conformed_fn)
+  {
+  }
+
+  virtual void run() override
+  {
+    FFmpegDecoder decoder;
+    decoder.set_stream(stream_);
+
+    if (decoder.Open()) {
+      decoder.Conform(params_);
+      decoder.Close();
+    }
+
+    conform_lock.lock();
+    background_conforms.remove(conformed_fn_);
+    if (!QFileInfo::exists(conformed_fn_)) {
+      // Whatever went wrong will most likely go wrong again, Conform() has already warned about it
+      failed_conforms.insert(conformed_fn_);
+    }
+    conform_lock.unlock();
+  }
+
+private:
+  StreamPtr stream_;
+
+  AudioRenderingParams params_;
+
+  QString conformed_fn_;
+
+};
+
+}
+
 FFmpegDecoder::FFmpegDecoder() :
   fmt_ctx_(nullptr),
+  io_ctx_(nullptr),
   codec_ctx_(nullptr),
   opts_(nullptr),
-  scale_ctx_(nullptr)
+  ideal_pix_fmt_(AV_PIX_FMT_NONE),
+  pkt_(nullptr),
+  frame_(nullptr),
+  hw_device_ctx_(nullptr),
+  hw_pix_fmt_(AV_PIX_FMT_NONE),
+  sw_frame_(nullptr),
+  decode_path_(kDecodePathNone),
+  lowres_(0),
+  last_frame_ts_(AV_NOPTS_VALUE),
+  cached_divider_(0),
+  last_request_ts_(AV_NOPTS_VALUE),
+  backward_requests_(0),
+  reverse_divider_(0),
+  reverse_size_(0),
+  frame_index_(nullptr),
+  frame_index_count_(0),
+  indexed_file_size_(0),
+  replay_index_(0),
+  resume_ts_(AV_NOPTS_VALUE),
+  window_resampler_(nullptr),
+  window_in_pos_(0),
+  window_out_pos_(0),
+  convert_ctx_(nullptr)
 {
+  MemoryBudget::AddReclaimer(MemoryBudget::kReverseFrames, this);
 }
 
 FFmpegDecoder::~FFmpegDecoder()
 {
+  MemoryBudget::RemoveReclaimer(this);
+
   Close();
 }
 
@@ -62,11 +318,27 @@ bool FFmpegDecoder::Open()
   QByteArray ba = stream()->footage()->filename().toUtf8();
   const char* filename = ba.constData();
 
+  // Read the file through a buffer shared with every other decoder of it. Reads on network storage are slow to come
+  // back, so they're made in large blocks and ahead of where decoding has got to. If the file can't be opened
+  // directly (e.g. it's a URL), FFmpeg opens it as usual.
+  file_buffer_ = FFmpegFileBuffer::Get(stream()->footage()->filename());
+
+  if (file_buffer_ != nullptr) {
+    io_ctx_ = file_buffer_->CreateIOContext();
+  }
+
+  if (io_ctx_ != nullptr) {
+    fmt_ctx_ = avformat_alloc_context();
+    fmt_ctx_->pb = io_ctx_;
+  }
+
   // Open file in a format context
   error_code = avformat_open_input(&fmt_ctx_, filename, nullptr, nullptr);
 
   // Handle format context error
   if (error_code != 0) {
+    // The format context has already been freed, but not our IO context
+    FFmpegFileBuffer::FreeIOContext(&io_ctx_);
     FFmpegError(error_code);
     return false;
   }
@@ -86,6 +358,10 @@ bool FFmpegDecoder::Open()
   // Get reference to correct AVStream
   avstream_ = fmt_ctx_->streams[stream()->index()];
 
+  packet_cache_key_ = FFmpegPacketCache::StreamKey(stream()->footage()->filename(),
+                                                   stream()->index(),
+                                                   stream()->footage()->timestamp().toMSecsSinceEpoch());
+
   // Find decoder
   AVCodec* codec = avcodec_find_decoder(avstream_->codecpar->codec_id);
 
@@ -112,8 +388,30 @@ bool FFmpegDecoder::Open()
     return false;
   }
 
+  // Try to decode on the GPU if the user has enabled it (falls back to software decoding if it fails)
+  if (codec_ctx_->codec_type == AVMEDIA_TYPE_VIDEO) {
+    SetUpHardwareDecoding(codec);
+
+    // Hardware decoders don't support lowres decoding
+    if (hw_device_ctx_ == nullptr) {
+      codec_ctx_->lowres = qMin(lowres_, static_cast<int>(codec->max_lowres));
+    }
+  }
+
+  // Frame threading decodes several frames at once, which is faster overall but holds each frame back by a frame per
+  // thread. Interactive decoders only want the one frame as soon as possible, so they split frames into slices instead.
+  if (profile() == kProfileInteractive) {
+    codec_ctx_->thread_type = FF_THREAD_SLICE;
+  } else {
+    codec_ctx_->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+  }
+
   // enable multithreading on decoding
-  error_code = av_dict_set(&opts_, "threads", "auto", 0);
+  if (thread_count() > 0) {
+    error_code = av_dict_set_int(&opts_, "threads", qMin(thread_count(), kMaximumThreads), 0);
+  } else {
+    error_code = av_dict_set(&opts_, "threads", "auto", 0);
+  }
 
   // Handle failure to set multithreaded decoding
   if (error_code < 0) {
@@ -134,11 +432,11 @@ bool FFmpegDecoder::Open()
     AVPixelFormat pix_fmt = static_cast<AVPixelFormat>(avstream_->codecpar->format);
 
     // Get an Olive compatible AVPixelFormat
-    AVPixelFormat ideal_pix_fmt = GetCompatiblePixelFormat(pix_fmt);
+    ideal_pix_fmt_ = GetCompatiblePixelFormat(pix_fmt);
 
     // Determine which Olive native pixel format we retrieved
     // Note that FFmpeg doesn't support float formats
-    switch (ideal_pix_fmt) {
+    switch (ideal_pix_fmt_) {
     case AV_PIX_FMT_RGBA:
       output_fmt_ = olive::PIX_FMT_RGBA8;
       break;
@@ -150,29 +448,34 @@ bool FFmpegDecoder::Open()
       return false;
     }
 
-    scale_ctx_ = sws_getContext(avstream_->codecpar->width,
-                                avstream_->codecpar->height,
-                                pix_fmt,
-                                avstream_->codecpar->width,
-                                avstream_->codecpar->height,
-                                ideal_pix_fmt,
-                                0,
-                                nullptr,
-                                nullptr,
-                                nullptr);
-
+    // NOTE: The scaling context is created in RetrieveVideo() since hardware decoded frames may arrive in a different
+    //       format to the one reported by the stream
   } else if (codec_ctx_->codec_type == AVMEDIA_TYPE_AUDIO) {
     // FIXME: Fill this in
   }
 
+  // Allocate a packet and frame that persist for the lifetime of this decode session
+  pkt_ = av_packet_alloc();
+  frame_ = av_frame_alloc();
+
+  if (pkt_ == nullptr || frame_ == nullptr) {
+    Error(QStringLiteral("Failed to allocate resources for decoding"));
+    return false;
+  }
+
+  // No frames have been decoded yet
+  last_frame_ts_ = AV_NOPTS_VALUE;
+
   // All allocation succeeded so we set the state to open
   open_ = true;
 
   return true;
 }
 
-FramePtr FFmpegDecoder::RetrieveVideo(const rational &timecode)
+FramePtr FFmpegDecoder::RetrieveVideo(const rational &timecode, const int &divider)
 {
+  Tracer::Scope trace("decode", "RetrieveVideo");
+
   if (!open_ && !Open()) {
     return nullptr;
   }
@@ -181,6 +484,19 @@ FramePtr FFmpegDecoder::RetrieveVideo(const rational &timecode)
     return nullptr;
   }
 
+  // If the codec can decode closer to the requested resolution than it currently does, reopen it at that resolution
+  int lowres = GetLowResForDivider(codec_ctx_->codec, divider);
+
+  if (lowres != codec_ctx_->lowres && hw_device_ctx_ == nullptr) {
+    Close();
+
+    lowres_ = lowres;
+
+    if (!Open()) {
+      return nullptr;
+    }
+  }
+
   // Convert timecode to AVStream timebase
   int64_t target_ts = GetTimestampFromTime(timecode);
 
@@ -189,63 +505,239 @@ FramePtr FFmpegDecoder::RetrieveVideo(const rational &timecode)
     return nullptr;
   }
 
-  QFile compressed_frame(GetIndexFilename().append(QString::number(target_ts)));
-  if (compressed_frame.open(QFile::ReadOnly)) {
-    QByteArray frame_loader = qUncompress(compressed_frame.readAll());
-    AVFrame* frame = av_frame_alloc();
+  // If we've already decoded this exact frame, there's nothing more to do
+  if (cached_frame_ != nullptr && last_frame_ts_ == target_ts && cached_divider_ == divider) {
+    SetLastRequest(target_ts);
+    return cached_frame_;
+  }
 
-    if (frame == nullptr) {
-      qWarning() << "Failed to create AVFrame for swscale";
-      return nullptr;
+  // Playing backwards, frames before the last one requested may have been decoded along with it
+  if (reverse_divider_ == divider) {
+    reverse_lock_.lock();
+    FramePtr buffered = reverse_frames_.value(target_ts);
+    reverse_lock_.unlock();
+
+    if (buffered != nullptr) {
+      SetLastRequest(target_ts);
+      return buffered;
     }
+  }
+
+  // Find the closest keyframe at or before this timestamp so we can decode forward from it
+  int64_t keyframe_ts = GetClosestKeyframeInIndex(target_ts);
+
+  if (keyframe_ts == AV_NOPTS_VALUE) {
+    Error(QStringLiteral("Index failed to produce a valid keyframe"));
+    return nullptr;
+  }
 
-    frame->width = avstream_->codecpar->width;
-    frame->height = avstream_->codecpar->height;
+  // Stepping back within the GOP of the last frame requested or into the one before, once the requests before have
+  // been going backwards too, is taken as playing backwards. Decoding forward from the keyframe for every frame would
+  // decode the whole GOP again each time, so instead every frame up to this one is kept this time round for the
+  // requests that follow.
+  bool reversing = false;
 
-    QDataStream ds(&frame_loader, QIODevice::ReadOnly);
-    ds >> frame->format;
+  if (last_request_ts_ != AV_NOPTS_VALUE && target_ts < last_request_ts_) {
+    int64_t last_keyframe_ts = GetClosestKeyframeInIndex(last_request_ts_);
 
-    if (av_frame_get_buffer(frame, 0) != 0) {
-      qWarning() << "Failed to get AVFrame buffer";
-      av_frame_free(&frame);
-      return nullptr;
+    reversing = (keyframe_ts >= GetClosestKeyframeInIndex(last_keyframe_ts - 1));
+  }
+
+  SetLastRequest(target_ts);
+
+  reversing = (reversing && backward_requests_ >= kReverseRequestCount);
+
+  // During playback, the requested frame is almost always just after the last one we decoded. In that case, we can
+  // keep decoding from the current position rather than seeking. We only seek if the target is behind us or if there's
+  // a keyframe between our current position and the target (since decoding from that keyframe will be faster). Playing
+  // backwards always starts from the keyframe so every frame before this one can be kept.
+  if (reversing
+      || last_frame_ts_ == AV_NOPTS_VALUE
+      || target_ts < last_frame_ts_
+      || keyframe_ts > last_frame_ts_) {
+    Seek(keyframe_ts, true);
+  }
+
+  if (reversing) {
+    ClearReverseBuffer();
+    reverse_divider_ = divider;
+  }
+
+  int ret;
+
+  // Decode forward until we reach the requested frame
+  while ((ret = GetFrame(pkt_, frame_)) >= 0) {
+    last_frame_ts_ = GetFrameTimestamp(frame_);
+
+    if (last_frame_ts_ >= target_ts) {
+      break;
     }
 
-    // Read data
-    size_t pos = sizeof(int);
-    for (int i=0;i<AV_NUM_DATA_POINTERS;i++) {
-      size_t plane_size = static_cast<size_t>(frame->linesize[i] * CalculatePlaneHeight(frame->height, static_cast<AVPixelFormat>(frame->format), i));
-      memcpy(frame->data[i], frame_loader.data() + pos, plane_size);
-      pos += plane_size;
+    if (reversing) {
+      BufferReverseFrame(divider);
     }
+  }
 
-    // Frame was valid, now we convert it to a native Olive frame
-    FramePtr frame_container = Frame::Create();
-    frame_container->set_width(frame->width);
-    frame_container->set_height(frame->height);
-    frame_container->set_format(static_cast<olive::PixelFormat>(output_fmt_));
-    frame_container->set_timestamp(olive::timestamp_to_time(frame->pts, avstream_->time_base));
-    frame_container->allocate();
+  if (ret < 0) {
+    // The decoder is likely at the end of the stream now, so make sure we seek next time
+    last_frame_ts_ = AV_NOPTS_VALUE;
 
-    // Convert pixel format/linesize if necessary
-    uint8_t* dst_data = reinterpret_cast<uint8_t*>(frame_container->data());
-    int dst_linesize = frame_container->width() * PixelService::BytesPerPixel(static_cast<olive::PixelFormat>(output_fmt_));
+    qWarning() << "Failed to decode frame at timestamp" << target_ts;
 
-    // Perform pixel conversion
-    sws_scale(scale_ctx_,
-              frame->data,
-              frame->linesize,
-              0,
-              frame->height,
-              &dst_data,
-              &dst_linesize);
+    return nullptr;
+  }
 
-    av_frame_free(&frame);
+  cached_frame_ = ConvertFrame(frame_, divider, planar_yuv_output());
+  cached_divider_ = divider;
 
-    return frame_container;
+  if (reversing) {
+    PrefetchPreviousGop(keyframe_ts);
   }
 
-  return nullptr;
+  return cached_frame_;
+}
+
+void FFmpegDecoder::BufferReverseFrame(int divider)
+{
+  FramePtr frame = ConvertFrame(frame_, divider, planar_yuv_output());
+
+  if (frame == nullptr) {
+    return;
+  }
+
+  reverse_lock_.lock();
+
+  qint64 old_size = reverse_size_;
+
+  FramePtr replaced = reverse_frames_.value(last_frame_ts_);
+
+  if (replaced != nullptr) {
+    reverse_size_ -= replaced->allocated_size();
+  }
+
+  reverse_frames_.insert(last_frame_ts_, frame);
+  reverse_size_ += frame->allocated_size();
+
+  // The earliest frames are the last to be shown, so they're the ones to let go of (they'll be decoded again when
+  // they're needed)
+  while (reverse_size_ > kReverseBufferSize && reverse_frames_.size() > 1) {
+    reverse_size_ -= reverse_frames_.first()->allocated_size();
+    reverse_frames_.erase(reverse_frames_.begin());
+  }
+
+  qint64 added = reverse_size_ - old_size;
+
+  reverse_lock_.unlock();
+
+  ReportReverseMemory(added);
+}
+
+qint64 FFmpegDecoder::ClearReverseBuffer()
+{
+  reverse_lock_.lock();
+
+  qint64 freed = reverse_size_;
+
+  reverse_frames_.clear();
+  reverse_size_ = 0;
+
+  reverse_lock_.unlock();
+
+  ReportReverseMemory(-freed);
+
+  return freed;
+}
+
+void FFmpegDecoder::ReportReverseMemory(qint64 bytes)
+{
+  // FramePool already counts these frames' buffers under kFrames, so they're moved rather than counted twice
+  MemoryBudget::Add(MemoryBudget::kFrames, -bytes);
+  MemoryBudget::Add(MemoryBudget::kReverseFrames, bytes);
+}
+
+void FFmpegDecoder::SetLastRequest(int64_t timestamp)
+{
+  if (last_request_ts_ != AV_NOPTS_VALUE) {
+    if (timestamp < last_request_ts_) {
+      backward_requests_++;
+    } else if (timestamp > last_request_ts_) {
+      backward_requests_ = 0;
+    }
+  }
+
+  last_request_ts_ = timestamp;
+}
+
+qint64 FFmpegDecoder::Reclaim(qint64)
+{
+  return ClearReverseBuffer();
+}
+
+void FFmpegDecoder::PrefetchPreviousGop(int64_t keyframe_ts)
+{
+  if (file_buffer_ == nullptr) {
+    return;
+  }
+
+  QVector<int64_t>::const_iterator it = std::lower_bound(keyframe_index_.constBegin(),
+                                                         keyframe_index_.constEnd(),
+                                                         keyframe_ts);
+
+  if (it == keyframe_index_.constBegin() || it == keyframe_index_.constEnd()) {
+    return;
+  }
+
+  int index = static_cast<int>(it - keyframe_index_.constBegin());
+
+  int64_t start = keyframe_pos_.at(index - 1);
+  int64_t end = keyframe_pos_.at(index);
+
+  // Packets with no known position in the file can't be read ahead
+  if (start >= 0 && end > start) {
+    file_buffer_->Prefetch(start, end - start);
+  }
+}
+
+FramePtr FFmpegDecoder::RetrieveThumbnail(const rational &timecode, const int &divider)
+{
+  if (!open_ && !Open()) {
+    return nullptr;
+  }
+
+  if (avstream_->codecpar->codec_type != AVMEDIA_TYPE_VIDEO) {
+    return nullptr;
+  }
+
+  int lowres = GetLowResForDivider(codec_ctx_->codec, divider);
+
+  if (lowres != codec_ctx_->lowres && hw_device_ctx_ == nullptr) {
+    Close();
+
+    lowres_ = lowres;
+
+    if (!Open()) {
+      return nullptr;
+    }
+  }
+
+  // Seek straight to the keyframe before this time without consulting (or creating) the index
+  Seek(olive::time_to_timestamp(timecode, avstream_->time_base));
+
+  // Only keyframes need decoding, and the first one we get is the one we sought to
+  codec_ctx_->skip_frame = AVDISCARD_NONKEY;
+
+  int ret = GetFrame(pkt_, frame_);
+
+  codec_ctx_->skip_frame = AVDISCARD_DEFAULT;
+
+  // RetrieveVideo() can't continue from here since we skipped frames, this makes sure it seeks (and flushes) first
+  last_frame_ts_ = AV_NOPTS_VALUE;
+
+  if (ret < 0) {
+    return nullptr;
+  }
+
+  return ConvertFrame(frame_, divider, false);
 }
 
 FramePtr FFmpegDecoder::RetrieveAudio(const rational &timecode, const rational &length, const AudioRenderingParams &params)
@@ -262,21 +754,52 @@ FramePtr FFmpegDecoder::RetrieveAudio(const rational &timecode, const rational &
     Index();
   }
 
-  Conform(params);
+  QString conformed_fn = GetConformedFilename(params);
+
+  if (!QFileInfo::exists(conformed_fn)) {
+    // Resample just what was asked for now, and conform the whole file in the background for next time
+    StartBackgroundConform(params);
+
+    return ResampleWindow(params, params.time_to_samples(timecode), params.time_to_samples(length));
+  }
+
+  FreeWindowResampler();
+
+  DiskCacheManager::instance()->FileAccessed(conformed_fn);
 
-  WaveInput input(GetConformedFilename(params));
+  WaveInput input(conformed_fn);
 
   if (input.open()) {
-    const AudioRenderingParams& params = input.params();
+    const AudioRenderingParams& file_params = input.params();
 
     FramePtr audio_frame = Frame::Create();
     audio_frame->set_audio_params(params);
     audio_frame->set_sample_count(params.time_to_samples(length));
-    audio_frame->allocate();
 
-    input.read(params.time_to_bytes(timecode),
-               audio_frame->data(),
-               audio_frame->allocated_size());
+    if (file_params == params) {
+      int offset = params.time_to_bytes(timecode);
+      int size = params.samples_to_bytes(audio_frame->sample_count());
+      const char* view = input.data(offset, size);
+
+      if (view) {
+        // Hand back the mapped samples directly, the frame keeps the mapping alive
+        audio_frame->set_external_data(view, size, input.mapping());
+      } else {
+        // Window runs past the end of the file, copy what there is and pad with silence
+        audio_frame->allocate();
+        input.read(offset, audio_frame->data(), audio_frame->allocated_size());
+      }
+    } else {
+      // Conformed files only match the sample rate, convert the format and channel layout here
+      int offset = file_params.time_to_bytes(timecode);
+      int size = file_params.samples_to_bytes(audio_frame->sample_count());
+      const char* view = input.data(offset, size);
+
+      QByteArray samples = view ? QByteArray::fromRawData(view, size) : input.read(offset, size);
+
+      audio_frame->allocate();
+      ConvertSamples(file_params, samples, audio_frame);
+    }
 
     input.close();
 
@@ -286,14 +809,100 @@ FramePtr FFmpegDecoder::RetrieveAudio(const rational &timecode, const rational &
   return nullptr;
 }
 
+void FFmpegDecoder::ConvertSamples(const AudioRenderingParams &src_params, const QByteArray &samples, FramePtr dst)
+{
+  const AudioRenderingParams& dst_params = dst->audio_params();
+
+  if (convert_ctx_ == nullptr || convert_src_params_ != src_params || convert_dst_params_ != dst_params) {
+    FreeConverter();
+
+    // With matching sample rates, swresample only converts the format and remixes channels, which is all done with
+    // its SIMD routines and keeps no state between calls
+    convert_ctx_ = swr_alloc_set_opts(nullptr,
+                                      static_cast<int64_t>(dst_params.channel_layout()),
+                                      GetFFmpegSampleFormat(dst_params.format()),
+                                      dst_params.sample_rate(),
+                                      static_cast<int64_t>(src_params.channel_layout()),
+                                      GetFFmpegSampleFormat(src_params.format()),
+                                      src_params.sample_rate(),
+                                      0,
+                                      nullptr);
+
+    swr_init(convert_ctx_);
+
+    convert_src_params_ = src_params;
+    convert_dst_params_ = dst_params;
+  }
+
+  int in_count = src_params.bytes_to_samples(samples.size());
+  const char* in_data = samples.constData();
+  char* out_data = dst->data();
+
+  int converted = swr_convert(convert_ctx_,
+                              reinterpret_cast<uint8_t**>(&out_data),
+                              dst->sample_count(),
+                              reinterpret_cast<const uint8_t**>(&in_data),
+                              in_count);
+
+  // Anything past the end of the file is silence
+  int converted_bytes = dst_params.samples_to_bytes(qMax(0, converted));
+  memset(dst->data() + converted_bytes, 0, static_cast<size_t>(dst->allocated_size() - converted_bytes));
+}
+
+void FFmpegDecoder::FreeConverter()
+{
+  if (convert_ctx_ != nullptr) {
+    swr_free(&convert_ctx_);
+    convert_ctx_ = nullptr;
+  }
+}
+
 void FFmpegDecoder::Close()
 {
-  frame_index_.clear();
+  UnmapFrameIndex();
+  packet_index_.clear();
+  keyframe_index_.clear();
+  keyframe_pos_.clear();
+
+  cached_frame_ = nullptr;
+  last_frame_ts_ = AV_NOPTS_VALUE;
+  last_request_ts_ = AV_NOPTS_VALUE;
+  backward_requests_ = 0;
+  ClearReverseBuffer();
+
+  replay_gop_ = nullptr;
+  recording_gop_ = nullptr;
+  resume_ts_ = AV_NOPTS_VALUE;
+
+  FreeWindowResampler();
+  FreeConverter();
+
+  if (pkt_ != nullptr) {
+    av_packet_free(&pkt_);
+    pkt_ = nullptr;
+  }
+
+  if (frame_ != nullptr) {
+    av_frame_free(&frame_);
+    frame_ = nullptr;
+  }
+
+  if (sw_frame_ != nullptr) {
+    av_frame_free(&sw_frame_);
+    sw_frame_ = nullptr;
+  }
+
+  if (hw_device_ctx_ != nullptr) {
+    av_buffer_unref(&hw_device_ctx_);
+    hw_device_ctx_ = nullptr;
+  }
+
+  hw_pix_fmt_ = AV_PIX_FMT_NONE;
 
-  if (scale_ctx_ != nullptr) {
-    sws_freeContext(scale_ctx_);
-    scale_ctx_ = nullptr;
+  foreach (SwsContext* ctx, scale_ctxs_) {
+    sws_freeContext(ctx);
   }
+  scale_ctxs_.clear();
 
   if (opts_ != nullptr) {
     av_dict_free(&opts_);
@@ -310,6 +919,10 @@ void FFmpegDecoder::Close()
     fmt_ctx_ = nullptr;
   }
 
+  // Custom IO contexts aren't freed with the format context
+  FFmpegFileBuffer::FreeIOContext(&io_ctx_);
+  file_buffer_ = nullptr;
+
   open_ = false;
 }
 
@@ -333,6 +946,52 @@ int64_t FFmpegDecoder::GetTimestampFromTime(const rational &time)
   return target_ts;
 }
 
+bool FFmpegDecoder::GetStreamCopyRange(const rational &in, const rational &out, int64_t *start_ts, int64_t *end_ts, int *packet_count)
+{
+  if (!open_ && !Open()) {
+    return false;
+  }
+
+  if (avstream_->codecpar->codec_type != AVMEDIA_TYPE_VIDEO) {
+    return false;
+  }
+
+  // Also indexes the stream if it hasn't been
+  int64_t first_ts = GetClosestTimestampInIndex(olive::time_to_timestamp(in, avstream_->time_base));
+
+  if (first_ts < 0 || GetClosestKeyframeInIndex(first_ts) != first_ts) {
+    return false;
+  }
+
+  int64_t out_ts = olive::time_to_timestamp(out, avstream_->time_base);
+  int64_t last_ts;
+
+  if (out_ts > frame_index_[frame_index_count_ - 1]) {
+    last_ts = INT64_MAX;
+  } else {
+    // The frame `out` lands on is the first one that isn't copied
+    last_ts = GetClosestTimestampInIndex(out_ts);
+
+    if (GetClosestKeyframeInIndex(last_ts) != last_ts) {
+      return false;
+    }
+  }
+
+  int count = 0;
+
+  foreach (const PacketIndexEntry& entry, packet_index_) {
+    if (entry.pts >= first_ts && entry.pts < last_ts) {
+      count++;
+    }
+  }
+
+  *start_ts = first_ts;
+  *end_ts = last_ts;
+  *packet_count = count;
+
+  return true;
+}
+
 void FFmpegDecoder::Conform(const AudioRenderingParams &params)
 {
   if (avstream_->codecpar->codec_type != AVMEDIA_TYPE_AUDIO) {
@@ -348,30 +1007,42 @@ void FFmpegDecoder::Conform(const AudioRenderingParams &params)
   WaveInput input(GetIndexFilename());
 
   if (input.open()) {
-    // If the parameters are equal, nothing to be done
-    // FIXME: Technically we only need to conform if the SAMPLE RATE is not equal. Format and channel layout conversion
-    //        could be done on the fly so we could perhaps conform less often at some point.
-    if (input.params() == params) {
+    // Only the sample rate needs conforming, the format and channel layout are converted on the fly in
+    // RetrieveAudio() so conformed files keep the index's
+    if (input.params().sample_rate() == params.sample_rate()) {
       input.close();
       return;
     }
 
-    // Otherwise, let's start converting the format
+    AudioRenderingParams conform_params(params.sample_rate(), input.params().channel_layout(), input.params().format());
 
     // Generate destination filename for this conversion to see if it exists
     QString conformed_fn = GetConformedFilename(params);
 
-    if (QFileInfo::exists(conformed_fn)) {
-      // We must have already conformed this format
+    conform_lock.lock();
+
+    // Only one decoder conforms each file, anyone else who wants it waits for that one to finish
+    while (conforms_in_progress.contains(conformed_fn)) {
+      conform_done.wait(&conform_lock);
+    }
+
+    if (QFileInfo::exists(conformed_fn)) {
+      // We must have already conformed this format
+      conform_lock.unlock();
       input.close();
+      DiskCacheManager::instance()->FileAccessed(conformed_fn);
       return;
     }
 
+    conforms_in_progress.insert(conformed_fn);
+
+    conform_lock.unlock();
+
     // Set up resampler
     SwrContext* resampler = swr_alloc_set_opts(nullptr,
-                                               static_cast<int64_t>(params.channel_layout()),
-                                               GetFFmpegSampleFormat(params.format()),
-                                               params.sample_rate(),
+                                               static_cast<int64_t>(conform_params.channel_layout()),
+                                               GetFFmpegSampleFormat(conform_params.format()),
+                                               conform_params.sample_rate(),
                                                static_cast<int64_t>(input.params().channel_layout()),
                                                GetFFmpegSampleFormat(input.params().format()),
                                                input.params().sample_rate(),
@@ -380,10 +1051,16 @@ void FFmpegDecoder::Conform(const AudioRenderingParams &params)
 
     swr_init(resampler);
 
-    WaveOutput conformed_output(conformed_fn, params);
+    // Write to a temporary file so a partially conformed file is never mistaken for a finished one
+    QString partial_fn = conformed_fn;
+    partial_fn.append(QStringLiteral(".partial"));
+
+    WaveOutput conformed_output(partial_fn, conform_params);
     if (!conformed_output.open()) {
-      qWarning() << "Failed to open conformed output:" << conformed_fn;
+      qWarning() << "Failed to open conformed output:" << partial_fn;
+      swr_free(&resampler);
       input.close();
+      FinishConform(conformed_fn);
       return;
     }
 
@@ -407,6 +1084,15 @@ void FFmpegDecoder::Conform(const AudioRenderingParams &params)
     swr_free(&resampler);
     conformed_output.close();
     input.close();
+
+    QFile::remove(conformed_fn);
+    if (QFile::rename(partial_fn, conformed_fn)) {
+      DiskCacheManager::instance()->FileWritten(conformed_fn);
+    } else {
+      qWarning() << "Failed to move conformed output into place:" << conformed_fn;
+    }
+
+    FinishConform(conformed_fn);
   } else {
     qWarning() << "Failed to conform file:" << stream()->footage()->filename();
   }
@@ -422,6 +1108,11 @@ bool FFmpegDecoder::SupportsAudio()
   return true;
 }
 
+Decoder::DecodePath FFmpegDecoder::ActiveDecodePath()
+{
+  return static_cast<DecodePath>(decode_path_.loadAcquire());
+}
+
 void FFmpegDecoder::ConformInternal(SwrContext* resampler, WaveOutput* output, const char* in_data, int in_sample_count)
 {
   // Determine how many samples the output will be
@@ -447,6 +1138,177 @@ void FFmpegDecoder::ConformInternal(SwrContext* resampler, WaveOutput* output, c
   output->write(out_samples);
 }
 
+FramePtr FFmpegDecoder::ResampleWindow(const AudioRenderingParams &params, int out_start, int out_count)
+{
+  WaveInput input(GetIndexFilename());
+
+  if (!input.open()) {
+    qWarning() << "Failed to open audio index:" << stream()->footage()->filename();
+    return nullptr;
+  }
+
+  const AudioRenderingParams& in_params = input.params();
+
+  if (window_resampler_ == nullptr || window_params_ != params || window_out_pos_ != out_start) {
+    FreeWindowResampler();
+
+    window_resampler_ = swr_alloc_set_opts(nullptr,
+                                           static_cast<int64_t>(params.channel_layout()),
+                                           GetFFmpegSampleFormat(params.format()),
+                                           params.sample_rate(),
+                                           static_cast<int64_t>(in_params.channel_layout()),
+                                           GetFFmpegSampleFormat(in_params.format()),
+                                           in_params.sample_rate(),
+                                           0,
+                                           nullptr);
+
+    swr_init(window_resampler_);
+    window_params_ = params;
+
+    // Start a little early so the filter has history by the time it reaches the window. The start also has to be a
+    // point where an input sample and an output sample fall at exactly the same time, so the window isn't shifted.
+    int64_t rate_gcd = av_gcd(in_params.sample_rate(), params.sample_rate());
+    int64_t in_step = in_params.sample_rate() / rate_gcd;
+    int64_t out_step = params.sample_rate() / rate_gcd;
+    int64_t steps = qMax(static_cast<int64_t>(0), out_start - kWindowPrimingSamples) / out_step;
+
+    window_in_pos_ = steps * in_step;
+    window_out_pos_ = steps * out_step;
+  }
+
+  FramePtr audio_frame = Frame::Create();
+  audio_frame->set_audio_params(params);
+  audio_frame->set_sample_count(out_count);
+  audio_frame->allocate();
+
+  // Anything past the end of the audio is silence
+  memset(audio_frame->data(), 0, static_cast<size_t>(audio_frame->allocated_size()));
+
+  QByteArray discarded;
+  int64_t out_end = out_start + out_count;
+  bool flushed = false;
+
+  while (window_out_pos_ < out_end) {
+    bool priming = (window_out_pos_ < out_start);
+    int want = static_cast<int>((priming ? out_start : out_end) - window_out_pos_);
+
+    char* out_data;
+
+    if (priming) {
+      discarded.resize(params.samples_to_bytes(want));
+      out_data = discarded.data();
+    } else {
+      out_data = audio_frame->data() + params.samples_to_bytes(static_cast<int>(window_out_pos_ - out_start));
+    }
+
+    // Read roughly as much input as we need for the output we want
+    int in_count = static_cast<int>(static_cast<int64_t>(want) * in_params.sample_rate() / params.sample_rate()) + 1;
+    QByteArray in_samples = input.read(in_params.samples_to_bytes(static_cast<int>(window_in_pos_)),
+                                       in_params.samples_to_bytes(in_count));
+    in_count = in_params.bytes_to_samples(in_samples.size());
+
+    const char* in_data = in_samples.constData();
+
+    if (in_count == 0) {
+      if (flushed) {
+        // Nothing more to come out of the resampler
+        break;
+      }
+
+      // Reached the end of the audio, get whatever the resampler is still holding onto
+      in_data = nullptr;
+      flushed = true;
+    }
+
+    int converted = swr_convert(window_resampler_,
+                                reinterpret_cast<uint8_t**>(&out_data),
+                                want,
+                                reinterpret_cast<const uint8_t**>(&in_data),
+                                in_count);
+
+    if (converted < 0) {
+      qWarning() << "Failed to resample audio:" << stream()->footage()->filename();
+      break;
+    }
+
+    window_in_pos_ += in_count;
+    window_out_pos_ += converted;
+  }
+
+  input.close();
+
+  return audio_frame;
+}
+
+void FFmpegDecoder::StartBackgroundConform(const AudioRenderingParams &params)
+{
+  QString conformed_fn = GetConformedFilename(params);
+
+  conform_lock.lock();
+
+  // A conform started some other way (e.g. by an export) will be finished soon enough too
+  bool already_running = background_conforms.contains(conformed_fn) || conforms_in_progress.contains(conformed_fn);
+
+  // Don't keep retrying a conform that already failed every time audio is retrieved
+  bool start = !already_running && !failed_conforms.contains(conformed_fn);
+
+  if (start) {
+    background_conforms.insert(conformed_fn);
+  }
+
+  conform_lock.unlock();
+
+  if (start) {
+    ConformPool()->start(new BackgroundConformTask(stream(), params, conformed_fn));
+  }
+}
+
+void FFmpegDecoder::FreeWindowResampler()
+{
+  if (window_resampler_ != nullptr) {
+    swr_free(&window_resampler_);
+    window_resampler_ = nullptr;
+  }
+}
+
+Decoder::ProbeHint FFmpegDecoder::GetProbeHint(const QString &filename, const QByteArray &header)
+{
+  QByteArray filename_bytes = filename.toUtf8();
+
+  // FFmpeg's probes may read past the end of the buffer, which has to be zeroed
+  QByteArray padded = header;
+  padded.append(QByteArray(AVPROBE_PADDING_SIZE, 0));
+
+  AVProbeData probe_data;
+  memset(&probe_data, 0, sizeof(probe_data));
+  probe_data.filename = filename_bytes.constData();
+  probe_data.buf = reinterpret_cast<unsigned char*>(padded.data());
+  probe_data.buf_size = header.size();
+
+  int score = 0;
+  const AVInputFormat* format = av_probe_input_format3(&probe_data, 1, &score);
+
+  if (format == nullptr) {
+    return kProbeHintUnknown;
+  }
+
+  QString format_name = QString::fromLatin1(format->name);
+
+  if (format_name == QStringLiteral("image2") || format_name.endsWith(QStringLiteral("_pipe"))) {
+    return kProbeHintUnknown;
+  }
+
+  if (score > AVPROBE_SCORE_EXTENSION) {
+    return kProbeHintMagic;
+  }
+
+  if (score == AVPROBE_SCORE_EXTENSION) {
+    return kProbeHintExtension;
+  }
+
+  return kProbeHintUnknown;
+}
+
 bool FFmpegDecoder::Probe(Footage *f)
 {
   if (open_) {
@@ -467,10 +1329,21 @@ bool FFmpegDecoder::Probe(Footage *f)
   // Open file in a format context
   error_code = avformat_open_input(&fmt_ctx_, filename, nullptr, nullptr);
 
-  bool need_manual_duration = false;
+  // Probing only reads the container's headers (and as many packets as FFmpeg needs to fill in missing codec
+  // parameters), the file is indexed later in the background once it's used (see IndexTask)
+  if (error_code == 0) {
+    error_code = avformat_find_stream_info(fmt_ctx_, nullptr);
+
+    if (error_code < 0) {
+      // FFmpegError() can't be used here since no stream has been set yet
+      char err[1024];
+      av_strerror(error_code, err, 1024);
+      qWarning() << "Failed to find stream information for" << f->filename() << "-" << err;
+    }
+  }
 
   // Handle format context error
-  if (error_code == 0) {
+  if (error_code >= 0) {
 
     // Retrieve metadata about the media
     av_dump_format(fmt_ctx_, 0, filename, 0);
@@ -491,6 +1364,9 @@ bool FFmpegDecoder::Probe(Footage *f)
         video_stream->set_height(avstream_->codecpar->height);
         video_stream->set_frame_rate(av_guess_frame_rate(fmt_ctx_, avstream_, nullptr));
 
+        const AVPixFmtDescriptor* pix_desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(avstream_->codecpar->format));
+        video_stream->set_has_alpha(pix_desc == nullptr || (pix_desc->flags & AV_PIX_FMT_FLAG_ALPHA));
+
         str = video_stream;
 
       } else if (avstream_->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
@@ -533,12 +1409,9 @@ bool FFmpegDecoder::Probe(Footage *f)
 
       str->set_index(avstream_->index);
       str->set_timebase(avstream_->time_base);
-      str->set_duration(avstream_->duration);
-
-      // The container/stream info may not contain a duration, so we'll need to manually retrieve it
-      if (avstream_->duration == AV_NOPTS_VALUE) {
-        need_manual_duration = true;
-      }
+      str->set_duration(GetDurationFromMetadata(avstream_));
+      str->set_start_time(avstream_->start_time == AV_NOPTS_VALUE ? 0 : avstream_->start_time);
+      str->set_codec(avcodec_get_name(avstream_->codecpar->codec_id));
 
       f->add_stream(str);
     }
@@ -550,39 +1423,369 @@ bool FFmpegDecoder::Probe(Footage *f)
   // Free all memory
   Close();
 
-  // If the metadata did not contain a duration, we'll need to loop through the file to retrieve it
-  if (need_manual_duration) {
-    // Index the first stream to retrieve the duration
+  return result;
+}
 
-    set_stream(f->stream(0));
+bool FFmpegDecoder::GetChromaShift(AVPixelFormat pix_fmt, int *h_shift, int *v_shift)
+{
+  int h, v;
 
-    Open();
+  switch (pix_fmt) {
+  case AV_PIX_FMT_YUV420P:
+  case AV_PIX_FMT_YUVJ420P:
+    h = 1;
+    v = 1;
+    break;
+  case AV_PIX_FMT_YUV422P:
+  case AV_PIX_FMT_YUVJ422P:
+    h = 1;
+    v = 0;
+    break;
+  case AV_PIX_FMT_YUV444P:
+  case AV_PIX_FMT_YUVJ444P:
+    h = 0;
+    v = 0;
+    break;
+  default:
+    // Not an 8-bit planar YUV format we can pass through
+    return false;
+  }
+
+  if (h_shift != nullptr) {
+    *h_shift = h;
+  }
+
+  if (v_shift != nullptr) {
+    *v_shift = v;
+  }
+
+  return true;
+}
+
+FramePtr FFmpegDecoder::ConvertFrame(AVFrame *src_frame, int divider, bool planar_yuv)
+{
+  // Hardware transfers don't carry the timestamp over, so get it from the original frame
+  int64_t timestamp = GetFrameTimestamp(src_frame);
+
+  if (hw_pix_fmt_ != AV_PIX_FMT_NONE && src_frame->format == hw_pix_fmt_) {
+    // This frame is in GPU memory, transfer it to system memory so we can convert it
+    av_frame_unref(sw_frame_);
 
-    // Use index to find duration
-    // FIXME: Does nothing for sound
-    if (!LoadIndex()) {
-      Index();
+    int ret = av_hwframe_transfer_data(sw_frame_, src_frame, 0);
+
+    if (ret < 0) {
+      char err[1024];
+      av_strerror(ret, err, 1024);
+      qWarning() << "Failed to transfer hardware frame:" << err;
+      return nullptr;
     }
 
-    // Use last frame index as the duration
-    // FIXME: Does this skip the last frame?
-    int64_t duration = frame_index_.last();
+    src_frame = sw_frame_;
+
+    decode_path_.storeRelease(kDecodePathHardwareTransfer);
+  } else {
+    decode_path_.storeRelease(kDecodePathSoftware);
+  }
+
+  // If the renderer can convert YUV itself, hand the planes over as-is and skip the CPU conversion entirely
+  if (planar_yuv
+      && output_fmt_ == olive::PIX_FMT_RGBA8
+      && GetChromaShift(static_cast<AVPixelFormat>(src_frame->format), nullptr, nullptr)) {
+    // The GPU will scale this to the render size anyway, so this is only reduced if the codec decoded it at lowres
+    return CopyPlanarYUV(src_frame);
+  }
+
+  // Scale down to the render size in the same pass as the pixel format conversion
+  int dst_width = qMax(1, avstream_->codecpar->width / divider);
+  int dst_height = qMax(1, avstream_->codecpar->height / divider);
 
-    f->stream(0)->set_duration(duration);
+  const AVPixelFormat src_fmt = static_cast<AVPixelFormat>(src_frame->format);
+  const AVPixFmtDescriptor* src_desc = av_pix_fmt_desc_get(src_fmt);
 
-    // Assume all durations are the same and set for each
-    for (int i=1;i<f->stream_count();i++) {
-      int64_t new_dur = av_rescale_q(duration,
-                                     f->stream(0)->timebase().toAVRational(),
-                                     f->stream(i)->timebase().toAVRational());
+  int flags;
+  if (render_mode() == olive::kOnline) {
+    flags = SWS_BICUBIC | SWS_ACCURATE_RND | SWS_FULL_CHR_H_INT;
+  } else {
+    flags = SWS_FAST_BILINEAR;
+  }
+
+  // Large frames are split into bands of rows converted at the same time, each with its own context. Bands are only
+  // independent if nothing is filtered vertically: the frame can't be scaled vertically, and outside of fast previews
+  // neither can the chroma, since it'd be interpolated differently either side of each band's edge.
+  int slice_count = 1;
+  int slice_align = 1 << src_desc->log2_chroma_h;
+
+  if (dst_height == src_frame->height
+      && dst_width * dst_height >= kMinimumSlicedPixels
+      && !(src_desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM))
+      && (render_mode() == olive::kOffline || src_desc->log2_chroma_h == 0)) {
+    slice_count = qMax(1, qMin(SlicePool::instance()->maxThreadCount(), dst_height / kMinimumSliceHeight));
+  }
+
+  // Rounded up to whole chroma rows so every band starts on one
+  int slice_height = (dst_height + slice_count - 1) / slice_count;
+  slice_height = (slice_height + slice_align - 1) / slice_align * slice_align;
+  slice_count = (dst_height + slice_height - 1) / slice_height;
+
+  // Contexts left over from frames split into more slices than this one will be needed again for the next
+  while (scale_ctxs_.size() < slice_count) {
+    scale_ctxs_.append(nullptr);
+  }
 
-      f->stream(i)->set_duration(new_dur);
+  for (int i=0;i<slice_count;i++) {
+    int src_height = (slice_count == 1) ? src_frame->height : qMin(slice_height, dst_height - i * slice_height);
+    int this_dst_height = (slice_count == 1) ? dst_height : src_height;
+
+    // Reuses the existing context unless the source format, size or quality has changed
+    scale_ctxs_[i] = sws_getCachedContext(scale_ctxs_.at(i),
+                                          src_frame->width,
+                                          src_height,
+                                          src_fmt,
+                                          dst_width,
+                                          this_dst_height,
+                                          ideal_pix_fmt_,
+                                          flags,
+                                          nullptr,
+                                          nullptr,
+                                          nullptr);
+
+    if (scale_ctxs_.at(i) == nullptr) {
+      qWarning() << "Failed to create pixel format conversion context";
+      return nullptr;
     }
+  }
 
-    Close();
+  // Frame was valid, now we convert it to a native Olive frame
+  FramePtr frame_container = Frame::Create();
+  frame_container->set_width(dst_width);
+  frame_container->set_height(dst_height);
+  frame_container->set_format(static_cast<olive::PixelFormat>(output_fmt_));
+  frame_container->set_timestamp(olive::timestamp_to_time(timestamp, avstream_->time_base));
+  frame_container->allocate();
+
+  // Convert pixel format/linesize if necessary
+  uint8_t* dst_data = reinterpret_cast<uint8_t*>(frame_container->data());
+  int dst_linesize = frame_container->width() * PixelService::BytesPerPixel(static_cast<olive::PixelFormat>(output_fmt_));
+
+  // Perform pixel conversion
+  Tracer::Scope trace("decode", "sws_scale");
+
+  QSemaphore finished;
+  int started = 0;
+
+  // Hand every slice except the first to the slice pool, the calling thread converts the first while it waits
+  for (int i=1;i<slice_count;i++) {
+    int y = i * slice_height;
+
+    const uint8_t* src_data[AV_NUM_DATA_POINTERS];
+    for (int j=0;j<AV_NUM_DATA_POINTERS;j++) {
+      if (src_frame->data[j] == nullptr) {
+        src_data[j] = nullptr;
+      } else {
+        // The second and third planes are chroma (or interleaved chroma in the second)
+        int plane_y = (j == 1 || j == 2) ? (y >> src_desc->log2_chroma_h) : y;
+        src_data[j] = src_frame->data[j] + plane_y * src_frame->linesize[j];
+      }
+    }
+
+    ScaleSliceTask* task = new ScaleSliceTask(scale_ctxs_.at(i),
+                                              src_data,
+                                              src_frame->linesize,
+                                              qMin(slice_height, dst_height - y),
+                                              dst_data + y * dst_linesize,
+                                              dst_linesize,
+                                              &finished);
+
+    SlicePool::instance()->start(task);
+    started++;
   }
 
-  return result;
+  ScaleSliceTask first_slice(scale_ctxs_.first(),
+                             src_frame->data,
+                             src_frame->linesize,
+                             (slice_count == 1) ? src_frame->height : qMin(slice_height, dst_height),
+                             dst_data,
+                             dst_linesize,
+                             nullptr);
+  first_slice.run();
+
+  finished.acquire(started);
+
+  return frame_container;
+}
+
+FramePtr FFmpegDecoder::CopyPlanarYUV(AVFrame *src_frame)
+{
+  AVPixelFormat pix_fmt = static_cast<AVPixelFormat>(src_frame->format);
+
+  int h_shift, v_shift;
+  GetChromaShift(pix_fmt, &h_shift, &v_shift);
+
+  FramePtr frame_container = Frame::Create();
+  frame_container->set_width(src_frame->width);
+  frame_container->set_height(src_frame->height);
+  frame_container->set_chroma_size(-((-src_frame->width) >> h_shift), -((-src_frame->height) >> v_shift));
+  frame_container->set_format(static_cast<olive::PixelFormat>(output_fmt_));
+  frame_container->set_timestamp(olive::timestamp_to_time(last_frame_ts_, avstream_->time_base));
+
+  // Determine which matrix to convert with
+  switch (src_frame->colorspace) {
+  case AVCOL_SPC_BT709:
+    frame_container->set_yuv_colorspace(Frame::kYUVBT709);
+    break;
+  case AVCOL_SPC_BT2020_NCL:
+  case AVCOL_SPC_BT2020_CL:
+    frame_container->set_yuv_colorspace(Frame::kYUVBT2020);
+    break;
+  case AVCOL_SPC_UNSPECIFIED:
+    // Same assumption swscale and most players make: HD material is BT.709, SD material is BT.601
+    frame_container->set_yuv_colorspace((src_frame->height >= 720) ? Frame::kYUVBT709 : Frame::kYUVBT601);
+    break;
+  default:
+    frame_container->set_yuv_colorspace(Frame::kYUVBT601);
+  }
+
+  frame_container->set_yuv_full_range(src_frame->color_range == AVCOL_RANGE_JPEG
+                                      || pix_fmt == AV_PIX_FMT_YUVJ420P
+                                      || pix_fmt == AV_PIX_FMT_YUVJ422P
+                                      || pix_fmt == AV_PIX_FMT_YUVJ444P);
+
+  frame_container->allocate();
+
+  // Copy each plane, stripping FFmpeg's line padding
+  for (int i=0;i<3;i++) {
+    av_image_copy_plane(reinterpret_cast<uint8_t*>(frame_container->plane_data(i)),
+                        frame_container->plane_width(i),
+                        src_frame->data[i],
+                        src_frame->linesize[i],
+                        frame_container->plane_width(i),
+                        frame_container->plane_height(i));
+  }
+
+  return frame_container;
+}
+
+int64_t FFmpegDecoder::GetDurationFromMetadata(AVStream *stream)
+{
+  if (stream->duration != AV_NOPTS_VALUE) {
+    return stream->duration;
+  }
+
+  // Many containers only store a duration for the whole file
+  if (fmt_ctx_->duration != AV_NOPTS_VALUE) {
+    return av_rescale_q(fmt_ctx_->duration, av_get_time_base_q(), stream->time_base);
+  }
+
+  // Some store a frame count instead
+  if (stream->nb_frames > 0 && stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+    AVRational frame_rate = av_guess_frame_rate(fmt_ctx_, stream, nullptr);
+
+    if (frame_rate.num > 0 && frame_rate.den > 0) {
+      return av_rescale_q(stream->nb_frames, av_inv_q(frame_rate), stream->time_base);
+    }
+  }
+
+  // Last resort, estimate from the file size and bitrate
+  int64_t file_size = avio_size(fmt_ctx_->pb);
+
+  if (file_size > 0 && fmt_ctx_->bit_rate > 0) {
+    return av_rescale(file_size * 8, stream->time_base.den, fmt_ctx_->bit_rate * stream->time_base.num);
+  }
+
+  qWarning() << "Couldn't determine the duration of stream" << stream->index << "from its metadata";
+
+  return 0;
+}
+
+int FFmpegDecoder::GetLowResForDivider(const AVCodec *codec, int divider)
+{
+  int lowres = 0;
+
+  // Each lowres step halves the width and height
+  while (lowres < codec->max_lowres && (2 << lowres) <= divider) {
+    lowres++;
+  }
+
+  return lowres;
+}
+
+bool FFmpegDecoder::SetUpHardwareDecoding(AVCodec *codec)
+{
+  QString device_name = Config::Current()["HardwareDecoding"].toString();
+
+  if (device_name.isEmpty()) {
+    // Hardware decoding is disabled
+    return false;
+  }
+
+  AVHWDeviceType device_type = av_hwdevice_find_type_by_name(device_name.toUtf8().constData());
+
+  if (device_type == AV_HWDEVICE_TYPE_NONE) {
+    qWarning() << "Unknown hardware decoding device type:" << device_name;
+    return false;
+  }
+
+  // Find which pixel format the codec will output for this device
+  for (int i=0;;i++) {
+    const AVCodecHWConfig* config = avcodec_get_hw_config(codec, i);
+
+    if (config == nullptr) {
+      // This codec can't be decoded with this device, use software decoding
+      return false;
+    }
+
+    if ((config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX)
+        && config->device_type == device_type) {
+      hw_pix_fmt_ = config->pix_fmt;
+      break;
+    }
+  }
+
+  int error_code = av_hwdevice_ctx_create(&hw_device_ctx_, device_type, nullptr, nullptr, 0);
+
+  if (error_code < 0) {
+    char err[1024];
+    av_strerror(error_code, err, 1024);
+    qWarning() << "Failed to create hardware decoding device" << device_name << "-" << err
+               << "- using software decoding";
+
+    hw_pix_fmt_ = AV_PIX_FMT_NONE;
+    return false;
+  }
+
+  sw_frame_ = av_frame_alloc();
+
+  if (sw_frame_ == nullptr) {
+    av_buffer_unref(&hw_device_ctx_);
+    hw_pix_fmt_ = AV_PIX_FMT_NONE;
+    return false;
+  }
+
+  codec_ctx_->hw_device_ctx = av_buffer_ref(hw_device_ctx_);
+  codec_ctx_->opaque = this;
+  codec_ctx_->get_format = GetHardwarePixelFormat;
+
+  // NOTE: Decoded frames are transferred back to system memory with av_hwframe_transfer_data() since decoders hand
+  //       the renderers Frames in system memory, which is also what the frame cache and every other decoder use
+
+  return true;
+}
+
+AVPixelFormat FFmpegDecoder::GetHardwarePixelFormat(AVCodecContext *ctx, const AVPixelFormat *pix_fmts)
+{
+  FFmpegDecoder* decoder = static_cast<FFmpegDecoder*>(ctx->opaque);
+
+  for (const AVPixelFormat* p = pix_fmts; *p != AV_PIX_FMT_NONE; p++) {
+    if (*p == decoder->hw_pix_fmt_) {
+      return *p;
+    }
+  }
+
+  // The hardware format isn't available for this stream, fall back to software decoding
+  qWarning() << "Hardware pixel format unavailable for" << decoder->stream()->footage()->filename()
+             << "- using software decoding";
+
+  return avcodec_default_get_format(ctx, pix_fmts);
 }
 
 void FFmpegDecoder::FFmpegError(int error_code)
@@ -602,40 +1805,75 @@ void FFmpegDecoder::Error(const QString &s)
   Close();
 }
 
-void FFmpegDecoder::Index()
+void FFmpegDecoder::Index(const QAtomicInt *cancelled)
 {
   if (!open_) {
     qWarning() << "Indexing function tried to run while decoder was closed";
     return;
   }
 
-  // Allocate a packet and frame for decoding
-  AVPacket* pkt = av_packet_alloc();
-  AVFrame* frame = av_frame_alloc();
+  // Reset state
+  Seek(0);
 
-  if (pkt == nullptr || frame == nullptr) {
-    // Handle failure to allocate either
-    Error(QStringLiteral("Failed to allocate resources for indexing"));
-  } else {
-    // Reset state
-    Seek(0);
+  // The session's packet is reused here, Seek() ensures the decoder won't assume any previous position
+  IndexFile(pkt_, cancelled);
 
-    if (avstream_->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
-      IndexVideo(pkt, frame);
-    } else if (avstream_->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
-      IndexAudio(pkt, frame);
+  // Reset state
+  Seek(0);
+
+  // Load the index we just made (or that another decoder made while we waited for it)
+  if (avstream_->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+    LoadIndex();
+  }
+}
+
+int64_t FFmpegDecoder::IndexedDuration()
+{
+  if (!open_) {
+    return -1;
+  }
+
+  switch (avstream_->codecpar->codec_type) {
+  case AVMEDIA_TYPE_VIDEO:
+  {
+    if (frame_index_count_ == 0 && !LoadIndex()) {
+      return -1;
     }
 
-    // Reset state
-    Seek(0);
+    if (frame_index_count_ == 0) {
+      return 0;
+    }
+
+    // The last frame lasts a frame too
+    int64_t frame_length = 0;
+    AVRational frame_rate = av_guess_frame_rate(fmt_ctx_, avstream_, nullptr);
+
+    if (frame_rate.num > 0 && frame_rate.den > 0) {
+      frame_length = av_rescale_q(1, av_inv_q(frame_rate), avstream_->time_base);
+    }
+
+    return frame_index_[frame_index_count_ - 1] - frame_index_[0] + frame_length;
   }
+  case AVMEDIA_TYPE_AUDIO:
+  {
+    WaveInput input(GetIndexFilename());
 
-  // Free resources
-  if (pkt != nullptr)
-    av_packet_free(&pkt);
+    if (!input.open()) {
+      return -1;
+    }
 
-  if (frame != nullptr)
-    av_frame_free(&frame);
+    AVRational sample_time = {1, input.params().sample_rate()};
+    int64_t duration = av_rescale_q(input.sample_count(), sample_time, avstream_->time_base);
+
+    input.close();
+
+    return duration;
+  }
+  default:
+    break;
+  }
+
+  return -1;
 }
 
 QString FFmpegDecoder::GetIndexFilename()
@@ -645,8 +1883,114 @@ QString FFmpegDecoder::GetIndexFilename()
     return QString();
   }
 
+  return GetIndexFilename(avstream_->index);
+}
+
+QString FFmpegDecoder::GetIndexFilename(int stream_index)
+{
   return GetMediaIndexFilename(GetUniqueFileIdentifier(stream()->footage()->filename()))
-      .append(QString::number(avstream_->index));
+      .append(QString::number(stream_index));
+}
+
+QString FFmpegDecoder::GetPacketIndexFilename()
+{
+  return GetIndexFilename().append(QStringLiteral(".packets"));
+}
+
+QString FFmpegDecoder::GetPacketIndexFilename(int stream_index)
+{
+  return GetIndexFilename(stream_index).append(QStringLiteral(".packets"));
+}
+
+QString FFmpegDecoder::GetResumeFilename(int stream_index)
+{
+  return GetMediaIndexFilename(GetStableFileIdentifier(stream()->footage()->filename()))
+      .append(QString::number(stream_index))
+      .append(QStringLiteral(".resume"));
+}
+
+bool FFmpegDecoder::LoadResumePoint(int stream_index, QVector<FFmpegIndexer::PacketIndexEntry> *indexed, int64_t *pos)
+{
+  QFile file(GetResumeFilename(stream_index));
+
+  if (!file.open(QFile::ReadOnly)) {
+    return false;
+  }
+
+  QDataStream ds(&file);
+  ds.setVersion(QDataStream::Qt_5_0);
+
+  char magic[4];
+  quint32 version;
+  qint64 file_size, last_pos;
+  QString packet_index_fn;
+  QByteArray header_hash;
+
+  if (ds.readRawData(magic, sizeof(magic)) != sizeof(magic)
+      || memcmp(magic, kResumeMagic, sizeof(magic)) != 0) {
+    return false;
+  }
+
+  ds >> version;
+
+  if (version != kResumeVersion) {
+    return false;
+  }
+
+  ds >> file_size >> last_pos >> packet_index_fn >> header_hash;
+
+  file.close();
+
+  if (ds.status() != QDataStream::Ok || last_pos < 0) {
+    return false;
+  }
+
+  const QString& filename = stream()->footage()->filename();
+
+  if (QFileInfo(filename).size() <= file_size || HashFileHeader(filename) != header_hash) {
+    return false;
+  }
+
+  // The earlier index may have been evicted from the disk cache since
+  QFile packet_index_file(packet_index_fn);
+
+  if (!ReadPacketIndex(&packet_index_file, indexed)) {
+    return false;
+  }
+
+  *pos = last_pos;
+
+  return true;
+}
+
+void FFmpegDecoder::SaveResumePoint(int stream_index, qint64 file_size, int64_t pos)
+{
+  QString resume_fn = GetResumeFilename(stream_index);
+
+  CreateParentFolder(resume_fn);
+
+  QSaveFile file(resume_fn);
+
+  if (!file.open(QFile::WriteOnly)) {
+    qWarning() << "Failed to open index resume point" << resume_fn << "for writing";
+    return;
+  }
+
+  QDataStream ds(&file);
+  ds.setVersion(QDataStream::Qt_5_0);
+
+  ds.writeRawData(kResumeMagic, sizeof(kResumeMagic));
+  ds << kResumeVersion;
+  ds << static_cast<qint64>(file_size);
+  ds << static_cast<qint64>(pos);
+  ds << GetPacketIndexFilename(stream_index);
+  ds << HashFileHeader(stream()->footage()->filename());
+
+  if (file.commit()) {
+    DiskCacheManager::instance()->FileWritten(resume_fn);
+  } else {
+    qWarning() << "Failed to save index resume point" << resume_fn;
+  }
 }
 
 QString FFmpegDecoder::GetConformedFilename(const AudioRenderingParams &params)
@@ -659,51 +2003,57 @@ QString FFmpegDecoder::GetConformedFilename(const AudioRenderingParams &params)
     AudioRenderingParams index_params = input.params();
     input.close();
 
-    if (index_params == params) {
-      // Source file matches perfectly, no conform required
+    if (index_params.sample_rate() == params.sample_rate()) {
+      // Only the sample rate is conformed, so the index can be used directly
       return index_fn;
     }
   }
 
-  index_fn.append('.');
-  index_fn.append(QString::number(params.sample_rate()));
-  index_fn.append('.');
-  index_fn.append(QString::number(params.format()));
-  index_fn.append('.');
-  index_fn.append(QString::number(params.channel_layout()));
-
-  return index_fn;
+  return GetConformedAudioFilename(index_fn, params.sample_rate());
 }
 
 bool FFmpegDecoder::LoadIndex()
 {
+  // An index that's still being written can't be loaded yet, Index() will wait for it to be finished
+  indexing_lock.lock();
+  bool in_progress = indexes_in_progress.contains(GetIndexFilename());
+  indexing_lock.unlock();
+
+  if (in_progress) {
+    return false;
+  }
+
   switch (avstream_->codecpar->codec_type) {
   case AVMEDIA_TYPE_VIDEO:
   {
     // Load index from file
-    QFile index_file(GetIndexFilename());
+    QFile packet_index_file(GetPacketIndexFilename());
 
-    if (!index_file.exists()) {
+    // Indexes created before the packet index existed are missing it, so those will need re-indexing
+    if (!QFileInfo::exists(GetIndexFilename()) || !packet_index_file.exists()) {
       return false;
     }
 
-    if (index_file.open(QFile::ReadOnly)) {
-      // Resize based on filesize
-      frame_index_.resize(static_cast<int>(static_cast<size_t>(index_file.size()) / sizeof(int64_t)));
+    if (!LoadPacketIndex(&packet_index_file) || !MapFrameIndex()) {
+      return false;
+    }
 
-      // Read frame index into vector
-      index_file.read(reinterpret_cast<char*>(frame_index_.data()),
-                      index_file.size());
+    DiskCacheManager::instance()->FileAccessed(GetIndexFilename());
+    DiskCacheManager::instance()->FileAccessed(GetPacketIndexFilename());
 
-      index_file.close();
+    indexed_file_size_ = QFileInfo(stream()->footage()->filename()).size();
 
-      return true;
-    }
-    break;
+    return true;
   }
   case AVMEDIA_TYPE_AUDIO:
   {
-    return QFileInfo::exists(GetIndexFilename());
+    if (!IsStreamIndexed(avstream_->index)) {
+      return false;
+    }
+
+    DiskCacheManager::instance()->FileAccessed(GetIndexFilename());
+
+    return true;
   }
   default:
     break;
@@ -712,160 +2062,293 @@ bool FFmpegDecoder::LoadIndex()
   return false;
 }
 
-void FFmpegDecoder::SaveIndex()
+bool FFmpegDecoder::LoadPacketIndex(QFile *file)
 {
-  // Save index to file
-  QFile index_file(GetIndexFilename());
-  if (index_file.open(QFile::WriteOnly)) {
-    // Write index in binary
-    index_file.write(reinterpret_cast<const char*>(frame_index_.constData()),
-                     frame_index_.size() * static_cast<int>(sizeof(int64_t)));
-
-    index_file.close();
-  } else {
-    qWarning() << QStringLiteral("Failed to save index for %1").arg(stream()->footage()->filename());
+  if (!ReadPacketIndex(file, &packet_index_)) {
+    return false;
   }
+
+  BuildKeyframeIndex();
+
+  return true;
 }
 
-void FFmpegDecoder::IndexAudio(AVPacket *pkt, AVFrame *frame)
+bool FFmpegDecoder::ReadPacketIndex(QFile *file, QVector<FFmpegIndexer::PacketIndexEntry> *packets)
 {
-  // Iterate through each audio frame and extract the PCM data
+  if (!file->open(QFile::ReadOnly)) {
+    return false;
+  }
 
-  uint64_t channel_layout = avstream_->codecpar->channel_layout;
-  if (!channel_layout) {
-    if (!avstream_->codecpar->channels) {
-      // No channel data - we can't do anything with this
-      return;
+  packets->clear();
+
+  QDataStream ds(file);
+  ds.setByteOrder(QDataStream::LittleEndian);
+
+  while (!ds.atEnd()) {
+    qint64 pts, pos;
+    qint32 flags;
+
+    ds >> pts >> pos >> flags;
+
+    if (ds.status() != QDataStream::Ok) {
+      // File is truncated or corrupt, treat it as missing so it gets regenerated
+      packets->clear();
+      file->close();
+      return false;
     }
 
-    channel_layout = static_cast<uint64_t>(av_get_default_channel_layout(avstream_->codecpar->channels));
+    PacketIndexEntry entry;
+    entry.pts = pts;
+    entry.pos = pos;
+    entry.flags = flags;
+    packets->append(entry);
   }
 
-  SwrContext* resampler = nullptr;
-  AVSampleFormat src_sample_fmt = static_cast<AVSampleFormat>(avstream_->codecpar->format);
-  AVSampleFormat dst_sample_fmt;
+  file->close();
 
-  // We don't use planar types internally, so if this is a planar format convert it now
-  if (av_sample_fmt_is_planar(src_sample_fmt)) {
-    dst_sample_fmt = av_get_packed_sample_fmt(src_sample_fmt);
+  return true;
+}
 
-    resampler = swr_alloc_set_opts(nullptr,
-                                   static_cast<int64_t>(avstream_->codecpar->channel_layout),
-                                   dst_sample_fmt,
-                                   avstream_->codecpar->sample_rate,
-                                   static_cast<int64_t>(avstream_->codecpar->channel_layout),
-                                   src_sample_fmt,
-                                   avstream_->codecpar->sample_rate,
-                                   0,
-                                   nullptr);
-  } else {
-    dst_sample_fmt = src_sample_fmt;
+static bool PacketPresentedBefore(const FFmpegIndexer::PacketIndexEntry& a, const FFmpegIndexer::PacketIndexEntry& b)
+{
+  return a.pts < b.pts;
+}
+
+void FFmpegDecoder::BuildKeyframeIndex()
+{
+  QVector<PacketIndexEntry> keyframes;
+
+  foreach (const PacketIndexEntry& entry, packet_index_) {
+    if (entry.flags & AV_PKT_FLAG_KEY) {
+      keyframes.append(entry);
+    }
   }
 
-  WaveOutput wave_out(GetIndexFilename(),
-                      AudioRenderingParams(avstream_->codecpar->sample_rate,
-                                           channel_layout,
-                                           GetNativeSampleFormat(dst_sample_fmt)));
+  // Packets are in decode order, so sort keyframes into presentation order for binary searching
+  std::sort(keyframes.begin(), keyframes.end(), PacketPresentedBefore);
 
-  int ret;
+  keyframe_index_.resize(keyframes.size());
+  keyframe_pos_.resize(keyframes.size());
 
-  if (wave_out.open()) {
-    while (true) {
-      ret = GetFrame(pkt, frame);
+  for (int i=0;i<keyframes.size();i++) {
+    keyframe_index_[i] = keyframes.at(i).pts;
+    keyframe_pos_[i] = keyframes.at(i).pos;
+  }
+}
 
-      if (ret < 0) {
-        break;
-      } else {
-        AVFrame* data_frame;
-
-        if (resampler != nullptr) {
-          // We must need to resample this (mainly just convert from planar to packed if necessary)
-          data_frame = av_frame_alloc();
-          data_frame->sample_rate = frame->sample_rate;
-          data_frame->channel_layout = frame->channel_layout;
-          data_frame->channels = frame->channels;
-          data_frame->format = dst_sample_fmt;
-          av_frame_make_writable(data_frame);
-
-          int ret = swr_convert_frame(resampler, data_frame, frame);
-
-          if (ret != 0) {
-            char err_str[50];
-            av_strerror(ret, err_str, 50);
-            qWarning() << "libswresample failed with error:" << ret << err_str;
-          }
-        } else {
-          // No resampling required, we can write directly from te frame buffer
-          data_frame = frame;
-        }
+bool FFmpegDecoder::MapFrameIndex()
+{
+  UnmapFrameIndex();
+
+  frame_index_file_.setFileName(GetIndexFilename());
+
+  if (!frame_index_file_.open(QFile::ReadOnly)) {
+    return false;
+  }
 
-        int buffer_sz = av_samples_get_buffer_size(nullptr,
-                                                   avstream_->codecpar->channels,
-                                                   data_frame->nb_samples,
-                                                   dst_sample_fmt,
-                                                   0); // FIXME: Documentation unclear - should this be 0 or 1?
+  frame_index_use_.Acquire(frame_index_file_.fileName());
 
-        // Write packed WAV data to the disk cache
-        wave_out.write(reinterpret_cast<char*>(data_frame->data[0]), buffer_sz);
+  qint64 index_size = frame_index_file_.size();
 
-        // If we allocated an output for the resampler, delete it here
-        if (data_frame != frame) {
-          av_frame_free(&data_frame);
-        }
-      }
+  if (index_size > 0) {
+    // The file must stay open for as long as the mapping is in use, it's closed again in UnmapFrameIndex()
+    uchar* mapped_index = frame_index_file_.map(0, index_size);
+
+    if (mapped_index == nullptr) {
+      qWarning() << "Failed to map frame index for" << stream()->footage()->filename();
+      frame_index_file_.close();
+      return false;
     }
 
-    wave_out.close();
-  } else {
-    qWarning() << "Failed to open WAVE output for indexing";
+    frame_index_ = reinterpret_cast<const int64_t*>(mapped_index);
+    frame_index_count_ = static_cast<int>(static_cast<size_t>(index_size) / sizeof(int64_t));
   }
 
-  if (resampler != nullptr) {
-    swr_free(&resampler);
+  return true;
+}
+
+void FFmpegDecoder::UnmapFrameIndex()
+{
+  if (frame_index_ != nullptr) {
+    frame_index_file_.unmap(reinterpret_cast<uchar*>(const_cast<int64_t*>(frame_index_)));
+    frame_index_ = nullptr;
   }
+
+  frame_index_count_ = 0;
+
+  if (frame_index_file_.isOpen()) {
+    frame_index_file_.close();
+  }
+
+  frame_index_use_.Release();
 }
 
-void FFmpegDecoder::IndexVideo(AVPacket* pkt, AVFrame* frame)
+bool FFmpegDecoder::IsStreamIndexed(int stream_index)
 {
-  // This should be unnecessary, but just in case...
-  frame_index_.clear();
+  switch (fmt_ctx_->streams[stream_index]->codecpar->codec_type) {
+  case AVMEDIA_TYPE_VIDEO:
+    return QFileInfo::exists(GetIndexFilename(stream_index)) && QFileInfo::exists(GetPacketIndexFilename(stream_index));
+  case AVMEDIA_TYPE_AUDIO:
+    // Indexes created before waveform summaries existed are missing one, so those will need re-indexing
+    return QFileInfo::exists(GetIndexFilename(stream_index))
+        && QFileInfo::exists(WaveformSummary::GetFilename(stream()->footage()->stream(stream_index).get()));
+  default:
+    break;
+  }
 
-  // Iterate through every single frame and get each timestamp
-  // NOTE: Expects no frames to have been read so far
+  return true;
+}
 
-  int ret;
+bool FFmpegDecoder::AddStreamToIndexer(FFmpegIndexer *indexer, int stream_index)
+{
+  AVStream* s = fmt_ctx_->streams[stream_index];
+
+  switch (s->codecpar->codec_type) {
+  case AVMEDIA_TYPE_VIDEO:
+    // Video indexes only need the demuxer
+    indexer->AddVideoStream(s, GetIndexFilename(stream_index), GetPacketIndexFilename(stream_index));
+    return true;
+  case AVMEDIA_TYPE_AUDIO:
+    // Our own stream can be decoded with the codec we already have open
+    return indexer->AddAudioStream(s,
+                                   GetIndexFilename(stream_index),
+                                   WaveformSummary::GetFilename(stream()->footage()->stream(stream_index).get()),
+                                   (s == avstream_) ? codec_ctx_ : nullptr);
+  default:
+    break;
+  }
+
+  return false;
+}
+
+void FFmpegDecoder::IndexFile(AVPacket *pkt, const QAtomicInt *cancelled)
+{
+  QString index_fn = GetIndexFilename();
+
+  indexing_lock.lock();
+
+  // Another decoder may already be indexing this stream as part of its own pass, wait for it rather than repeating it
+  while (indexes_in_progress.contains(index_fn)) {
+    indexing_done.wait(&indexing_lock);
+  }
+
+  if (IsStreamIndexed(avstream_->index)) {
+    indexing_lock.unlock();
+    return;
+  }
+
+  FFmpegIndexer indexer(fmt_ctx_);
+  QStringList claimed;
+  QVector<int> claimed_video;
 
-  while (true) {
-    ret = GetFrame(pkt, frame);
+  QVector<PacketIndexEntry> indexed;
+  int64_t resume_pos = -1;
 
-    if (ret >= 0) {
-      // Save frame
-      QByteArray frame_save;
-      QDataStream ds(&frame_save, QIODevice::WriteOnly);
+  if (avstream_->codecpar->codec_type == AVMEDIA_TYPE_VIDEO
+      && LoadResumePoint(avstream_->index, &indexed, &resume_pos)) {
+    indexer.AddVideoStream(avstream_, index_fn, GetPacketIndexFilename(), indexed);
+    claimed.append(index_fn);
+    claimed_video.append(avstream_->index);
 
-      ds << frame->format;
+    // Carrying on from where the last pass got to only helps video streams, so only bring along others that can
+    for (unsigned int i=0;i<fmt_ctx_->nb_streams;i++) {
+      int other = static_cast<int>(i);
+      int64_t other_pos;
 
-      // Save data
-      for (int i=0;i<AV_NUM_DATA_POINTERS;i++) {
-        frame_save.append(reinterpret_cast<const char*>(frame->data[i]),
-                          frame->linesize[i] * CalculatePlaneHeight(frame->height, static_cast<AVPixelFormat>(frame->format), i));
+      if (other == avstream_->index
+          || other >= stream()->footage()->stream_count()
+          || fmt_ctx_->streams[i]->codecpar->codec_type != AVMEDIA_TYPE_VIDEO) {
+        continue;
       }
 
-      QFile compressed_frame(GetIndexFilename().append(QString::number(frame->pts)));
-      if (compressed_frame.open(QFile::WriteOnly)) {
-        compressed_frame.write(qCompress(frame_save));
-        compressed_frame.close();
+      QString other_index_fn = GetIndexFilename(other);
+
+      if (indexes_in_progress.contains(other_index_fn)
+          || IsStreamIndexed(other)
+          || !LoadResumePoint(other, &indexed, &other_pos)) {
+        continue;
       }
 
-      frame_index_.append(frame->pts);
-    } else {
-      // Assume we've reached the end of the file
-      break;
+      indexer.AddVideoStream(fmt_ctx_->streams[i], other_index_fn, GetPacketIndexFilename(other), indexed);
+      claimed.append(other_index_fn);
+      claimed_video.append(other);
+
+      resume_pos = qMin(resume_pos, other_pos);
+    }
+  } else if (AddStreamToIndexer(&indexer, avstream_->index)) {
+    claimed.append(index_fn);
+
+    if (avstream_->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+      claimed_video.append(avstream_->index);
     }
+
+    // The whole file has to be demuxed either way, so index every other stream that needs it in the same pass rather
+    // than reading the file again when each one is opened
+    Footage* footage = stream()->footage();
+
+    for (unsigned int i=0;i<fmt_ctx_->nb_streams;i++) {
+      int other = static_cast<int>(i);
+
+      if (other == avstream_->index || other >= footage->stream_count()) {
+        continue;
+      }
+
+      QString other_index_fn = GetIndexFilename(other);
+
+      if (indexes_in_progress.contains(other_index_fn) || IsStreamIndexed(other)) {
+        continue;
+      }
+
+      if (AddStreamToIndexer(&indexer, other)) {
+        claimed.append(other_index_fn);
+
+        if (fmt_ctx_->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+          claimed_video.append(other);
+        }
+      }
+    }
+  }
+
+  foreach (const QString& fn, claimed) {
+    indexes_in_progress.insert(fn);
+  }
+
+  indexing_lock.unlock();
+
+  if (claimed.isEmpty()) {
+    return;
   }
 
-  // Save index to file
-  SaveIndex();
+  // Make sure we aren't holding a mapping of the file we're about to overwrite
+  UnmapFrameIndex();
+
+  // Anything written after this may still be in the middle of being written
+  qint64 file_size = QFileInfo(stream()->footage()->filename()).size();
+
+  // If the demuxer can't seek by position, the whole file is read and the packets indexed already are skipped
+  if (resume_pos >= 0) {
+    av_seek_frame(fmt_ctx_, -1, resume_pos, AVSEEK_FLAG_BYTE);
+  }
+
+  if (indexer.Run(pkt, cancelled)) {
+    foreach (int video_stream, claimed_video) {
+      int64_t last_pos = indexer.LastPacketPosition(video_stream);
+
+      if (last_pos >= 0) {
+        SaveResumePoint(video_stream, file_size, last_pos);
+      }
+    }
+  }
+
+  indexing_lock.lock();
+
+  foreach (const QString& fn, claimed) {
+    indexes_in_progress.remove(fn);
+  }
+
+  indexing_done.wakeAll();
+
+  indexing_lock.unlock();
 }
 
 int FFmpegDecoder::GetFrame(AVPacket *pkt, AVFrame *frame)
@@ -880,13 +2363,7 @@ int FFmpegDecoder::GetFrame(AVPacket *pkt, AVFrame *frame)
   while ((ret = avcodec_receive_frame(codec_ctx_, frame)) == AVERROR(EAGAIN) && !eof) {
 
     // Find next packet in the correct stream index
-    do {
-      // Free buffer in packet if there is one
-      av_packet_unref(pkt);
-
-      // Read packet from file
-      ret = av_read_frame(fmt_ctx_, pkt);
-    } while (pkt->stream_index != avstream_->index && ret >= 0);
+    ret = ReadPacket(pkt);
 
     if (ret == AVERROR_EOF) {
       // Don't break so that receive gets called again, but don't try to read again
@@ -913,6 +2390,89 @@ int FFmpegDecoder::GetFrame(AVPacket *pkt, AVFrame *frame)
   return ret;
 }
 
+int FFmpegDecoder::ReadPacket(AVPacket *pkt)
+{
+  // Free buffer in packet if there is one
+  av_packet_unref(pkt);
+
+  while (replay_gop_ != nullptr) {
+    if (replay_index_ < replay_gop_->packets.size()) {
+      // Shares the cached packet's data rather than copying it
+      return av_packet_ref(pkt, replay_gop_->packets.at(replay_index_++));
+    }
+
+    int64_t next_keyframe = replay_gop_->next_keyframe;
+
+    if (next_keyframe == AV_NOPTS_VALUE) {
+      // This GOP ends the stream
+      return AVERROR_EOF;
+    }
+
+    // Carry on with the next GOP, from the cache too if it's there
+    replay_gop_ = FFmpegPacketCache::Find(packet_cache_key_, next_keyframe);
+    replay_index_ = 0;
+
+    if (replay_gop_ == nullptr) {
+      // Otherwise pick the file up where the cache leaves off
+      av_seek_frame(fmt_ctx_, avstream_->index, next_keyframe, AVSEEK_FLAG_BACKWARD);
+      resume_ts_ = next_keyframe;
+    }
+  }
+
+  bool record = (avstream_->codecpar->codec_type == AVMEDIA_TYPE_VIDEO);
+  int ret;
+
+  while ((ret = av_read_frame(fmt_ctx_, pkt)) >= 0) {
+    bool keyframe = (pkt->flags & AV_PKT_FLAG_KEY);
+
+    if (pkt->stream_index != avstream_->index
+        || (resume_ts_ != AV_NOPTS_VALUE && (!keyframe || pkt->pts < resume_ts_))) {
+      // Not ours, or already fed from the cache (a backward seek may land on an earlier keyframe)
+      av_packet_unref(pkt);
+      continue;
+    }
+
+    resume_ts_ = AV_NOPTS_VALUE;
+
+    if (record) {
+      if (keyframe && pkt->pts != AV_NOPTS_VALUE) {
+        // Every packet up to this keyframe has been read, so the GOP before it is complete
+        if (recording_gop_ != nullptr) {
+          recording_gop_->next_keyframe = pkt->pts;
+          FFmpegPacketCache::Insert(packet_cache_key_, recording_gop_);
+        }
+
+        // No need to keep another copy of a GOP that's already cached
+        if (FFmpegPacketCache::Contains(packet_cache_key_, pkt->pts)) {
+          recording_gop_ = nullptr;
+        } else {
+          recording_gop_ = std::make_shared<FFmpegPacketCache::Gop>(pkt->pts);
+        }
+      }
+
+      if (recording_gop_ != nullptr) {
+        recording_gop_->packets.append(av_packet_clone(pkt));
+        recording_gop_->size += pkt->size;
+
+        if (recording_gop_->size > FFmpegPacketCache::kMaximumGopSize) {
+          recording_gop_ = nullptr;
+        }
+      }
+    }
+
+    return ret;
+  }
+
+  if (ret == AVERROR_EOF && recording_gop_ != nullptr) {
+    // The last GOP ends with the stream
+    FFmpegPacketCache::Insert(packet_cache_key_, recording_gop_);
+  }
+
+  recording_gop_ = nullptr;
+
+  return ret;
+}
+
 AVPixelFormat FFmpegDecoder::GetCompatiblePixelFormat(const AVPixelFormat &pix_fmt)
 {
   AVPixelFormat possible_pix_fmts[] = {
@@ -979,48 +2539,86 @@ AVSampleFormat FFmpegDecoder::GetFFmpegSampleFormat(const SampleFormat &smp_fmt)
   return AV_SAMPLE_FMT_NONE;
 }
 
-int FFmpegDecoder::CalculatePlaneHeight(int frame_height, const AVPixelFormat &format, int plane)
-{
-  // FIXME: This seems dumb, but I can't find any FFmpeg function that returns this information
-
-  if ((plane == 1 || plane == 2)
-      && format == AV_PIX_FMT_YUV420P) {
-    return frame_height/2;
-  }
-  return frame_height;
-}
-
 int64_t FFmpegDecoder::GetClosestTimestampInIndex(const int64_t &ts)
 {
   // Index now if we haven't already
-  if (frame_index_.isEmpty() && !LoadIndex()) {
+  if (frame_index_count_ == 0 && !LoadIndex()) {
     Index();
   }
 
-  if (frame_index_.isEmpty()) {
+  if (frame_index_count_ == 0) {
     return -1;
   }
 
-  if (ts <= 0) {
-    return frame_index_.first();
-  }
+  // Past the end of the index of a file that's still being written, so index what's been added since
+  if (ts > frame_index_[frame_index_count_ - 1]
+      && QFileInfo(stream()->footage()->filename()).size() > indexed_file_size_) {
+    // Reads through the buffer stop at the size it last saw, so let it see what's been appended
+    if (file_buffer_ != nullptr) {
+      file_buffer_->Refresh();
+    }
 
-  // Use index to find closest frame in file
-  for (int i=1;i<frame_index_.size();i++) {
-    int64_t this_ts = frame_index_.at(i);
+    Index();
 
-    if (this_ts == ts) {
-      return ts;
-    } else if (this_ts > ts) {
-      return frame_index_.at(i - 1);
+    if (frame_index_count_ == 0) {
+      return -1;
     }
   }
 
-  return frame_index_.last();
+  const int64_t* index_begin = frame_index_;
+  const int64_t* index_end = frame_index_ + frame_index_count_;
+
+  // The index is sorted, so find the first frame after this time and step back one to get the frame this time is in
+  const int64_t* after = std::upper_bound(index_begin, index_end, ts);
+
+  if (after == index_begin) {
+    // This time precedes all frames, so we just return the first
+    return *index_begin;
+  }
+
+  return *(after - 1);
 }
 
-void FFmpegDecoder::Seek(int64_t timestamp)
+int64_t FFmpegDecoder::GetClosestKeyframeInIndex(const int64_t &ts)
 {
+  if (keyframe_index_.isEmpty()) {
+    return AV_NOPTS_VALUE;
+  }
+
+  // Find the latest keyframe at or before this timestamp
+  QVector<int64_t>::const_iterator after = std::upper_bound(keyframe_index_.constBegin(),
+                                                            keyframe_index_.constEnd(),
+                                                            ts);
+
+  if (after == keyframe_index_.constBegin()) {
+    // If the timestamp precedes all keyframes, the best we can do is start at the first one
+    return keyframe_index_.first();
+  }
+
+  return *(after - 1);
+}
+
+int64_t FFmpegDecoder::GetFrameTimestamp(AVFrame *frame)
+{
+  return (frame->pts == AV_NOPTS_VALUE) ? frame->best_effort_timestamp : frame->pts;
+}
+
+void FFmpegDecoder::Seek(int64_t timestamp, bool from_packet_cache)
+{
+  // Our position in the stream is about to change, so anything we decoded previously is no longer relevant
+  last_frame_ts_ = AV_NOPTS_VALUE;
+  cached_frame_ = nullptr;
+
+  // The GOP we were reading won't be finished
+  recording_gop_ = nullptr;
+  resume_ts_ = AV_NOPTS_VALUE;
+
+  replay_gop_ = from_packet_cache ? FFmpegPacketCache::Find(packet_cache_key_, timestamp) : nullptr;
+  replay_index_ = 0;
+
   avcodec_flush_buffers(codec_ctx_);
-  av_seek_frame(fmt_ctx_, avstream_->index, timestamp, AVSEEK_FLAG_BACKWARD);
+
+  if (replay_gop_ == nullptr) {
+    av_seek_frame(fmt_ctx_, avstream_->index, timestamp, AVSEEK_FLAG_BACKWARD);
+  }
 }
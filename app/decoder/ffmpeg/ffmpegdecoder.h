@@ -27,16 +27,24 @@ extern "C" {
 #include <libswresample/swresample.h>
 }
 
+#include <QFile>
+#include <QMap>
+#include <QMutex>
 #include <QVector>
 
 #include "audio/sampleformat.h"
+#include "common/memorybudget.h"
 #include "decoder/decoder.h"
+#include "decoder/ffmpeg/ffmpegfilebuffer.h"
+#include "decoder/ffmpeg/ffmpegindexer.h"
+#include "decoder/ffmpeg/ffmpegpacketcache.h"
 #include "decoder/waveoutput.h"
+#include "render/diskcachemanager.h"
 
 /**
  * @brief A Decoder derivative that wraps FFmpeg functions as on Olive decoder
  */
-class FFmpegDecoder : public Decoder
+class FFmpegDecoder : public Decoder, public MemoryBudget::Reclaimer
 {
 public:
   // Constructor
@@ -47,8 +55,16 @@ public:
 
   virtual bool Probe(Footage *f) override;
 
+  /**
+   * @brief Asks FFmpeg which demuxer the file is for
+   *
+   * Still images FFmpeg reads through its image demuxers don't get a hint, since OIIODecoder handles those better.
+   */
+  virtual ProbeHint GetProbeHint(const QString& filename, const QByteArray& header) override;
+
   virtual bool Open() override;
-  virtual FramePtr RetrieveVideo(const rational &timecode) override;
+  virtual FramePtr RetrieveVideo(const rational &timecode, const int &divider) override;
+  virtual FramePtr RetrieveThumbnail(const rational &timecode, const int &divider) override;
   virtual FramePtr RetrieveAudio(const rational &timecode, const rational &length, const AudioRenderingParams& params) override;
   virtual void Close() override;
 
@@ -58,12 +74,89 @@ public:
 
   virtual void Conform(const AudioRenderingParams& params) override;
 
+  /**
+   * @brief Create an index for this media
+   *
+   * Indexes are used to improve speed and reliability of imported media. Calling Retrieve() will automatically check
+   * for an index and create one if it doesn't exist.
+   *
+   * Indexing is slow so it's recommended to do it in a background thread (see IndexTask). Index() must be called while
+   * the Decoder is open, and does not automatically call Open() and Close() the Decoder. The caller must call thse
+   * manually.
+   */
+  virtual void Index(const QAtomicInt* cancelled = nullptr) override;
+
+  /**
+   * @brief Video streams are as long as their frame index, audio streams as long as their index WAV
+   */
+  virtual int64_t IndexedDuration() override;
+
   virtual bool SupportsVideo() override;
   virtual bool SupportsAudio() override;
 
+  virtual DecodePath ActiveDecodePath() override;
+
+  /**
+   * @brief Drop the frames decoded ahead for playing backwards, they'll be decoded again if they're asked for
+   */
+  virtual qint64 Reclaim(qint64 bytes) override;
+
+  /**
+   * @brief Find the packets to copy to pass this video stream from `in` to `out` through without decoding it
+   *
+   * Uses the packet index. Copying has to start on a keyframe and stop on a keyframe (or the end of the stream), since
+   * the packets copied can't reference frames that weren't.
+   *
+   * @param start_ts
+   *
+   * Set to the timestamp of the first frame to copy, in the stream's timebase.
+   *
+   * @param end_ts
+   *
+   * Set to the timestamp of the first frame after that which isn't copied, or INT64_MAX if everything up to the end of
+   * the stream is.
+   *
+   * @param packet_count
+   *
+   * Set to the number of packets in between.
+   *
+   * @return
+   *
+   * FALSE if `in` or `out` doesn't land on a keyframe, or the stream couldn't be indexed.
+   */
+  bool GetStreamCopyRange(const rational& in, const rational& out, int64_t* start_ts, int64_t* end_ts, int* packet_count);
+
+  /**
+   * @brief Returns the Olive sample format equivalent to a packed FFmpeg sample format (SAMPLE_FMT_INVALID if none)
+   */
+  static SampleFormat GetNativeSampleFormat(const AVSampleFormat& smp_fmt);
+
 private:
   void ConformInternal(SwrContext *resampler, WaveOutput *output, const char *in_data, int in_sample_count);
 
+  /**
+   * @brief Resample just the requested window of the indexed audio to `params`
+   *
+   * Used while a stream hasn't been fully conformed yet. The resampler is kept between calls so contiguous requests
+   * (i.e. playback) continue seamlessly from the previous one. Any other request restarts the resampler a little
+   * before the window so the filter is primed, discarding output until the window starts.
+   */
+  FramePtr ResampleWindow(const AudioRenderingParams& params, int out_start, int out_count);
+
+  /**
+   * @brief Conform to `params` in a background thread unless that's already happening or has already failed
+   */
+  void StartBackgroundConform(const AudioRenderingParams& params);
+
+  void FreeWindowResampler();
+
+  /**
+   * @brief Convert the samples of a file conformed to dst's sample rate into dst's format and channel layout
+   */
+  void ConvertSamples(const AudioRenderingParams& src_params, const QByteArray& samples, FramePtr dst);
+
+  void FreeConverter();
+
   /**
    * @brief Handle an error
    *
@@ -83,6 +176,59 @@ private:
    */
   void FFmpegError(int error_code);
 
+  /**
+   * @brief Get the chroma subsampling of an 8-bit planar YUV format
+   *
+   * @return
+   *
+   * TRUE if this format can be passed to the renderer as planar YUV (see Decoder::planar_yuv_output()), FALSE if it
+   * needs converting with swscale. If TRUE, h_shift and v_shift are set to the log2 of the chroma subsampling factor
+   * (either may be nullptr).
+   */
+  static bool GetChromaShift(AVPixelFormat pix_fmt, int* h_shift, int* v_shift);
+
+  /**
+   * @brief Convert a decoded frame into a native Olive frame scaled down by `divider`
+   *
+   * Transfers hardware frames to system memory first. If `planar_yuv` is TRUE and the format allows it, the planes are
+   * copied without conversion (see CopyPlanarYUV()).
+   */
+  FramePtr ConvertFrame(AVFrame* src_frame, int divider, bool planar_yuv);
+
+  /**
+   * @brief Copy the Y, U, and V planes of a decoded frame into a Frame without converting them
+   */
+  FramePtr CopyPlanarYUV(AVFrame* src_frame);
+
+  /**
+   * @brief Get a stream's duration from the container's metadata alone, without reading the file
+   *
+   * Falls back on the container's duration, then the frame count, then an estimate from the bitrate.
+   */
+  int64_t GetDurationFromMetadata(AVStream* stream);
+
+  /**
+   * @brief Get the largest lowres value this codec supports that doesn't reduce resolution beyond `divider`
+   */
+  static int GetLowResForDivider(const AVCodec* codec, int divider);
+
+  /**
+   * @brief Set up hardware accelerated decoding on codec_ctx_ if enabled in the preferences
+   *
+   * Must be called after codec_ctx_ is allocated but before it's opened. If the device named in the preferences can't
+   * be created, or the codec doesn't support it, the decoder silently continues with software decoding.
+   *
+   * @return
+   *
+   * TRUE if hardware decoding was set up.
+   */
+  bool SetUpHardwareDecoding(AVCodec* codec);
+
+  /**
+   * @brief AVCodecContext::get_format callback that selects the hardware pixel format if it's offered
+   */
+  static AVPixelFormat GetHardwarePixelFormat(AVCodecContext* ctx, const AVPixelFormat* pix_fmts);
+
   /**
    * @brief Uses the FFmpeg API to retrieve a packet (stored in pkt_) and decode it (stored in frame_)
    *
@@ -93,17 +239,16 @@ private:
   int GetFrame(AVPacket* pkt, AVFrame* frame);
 
   /**
-   * @brief Create an index for this media
+   * @brief Read the next packet of this stream into `pkt`
    *
-   * Indexes are used to improve speed and reliability of imported media. Calling Retrieve() will automatically check
-   * for an index and create one if it doesn't exist.
+   * Packets come from the GOP being fed from FFmpegPacketCache if there is one, otherwise from the file. Packets read
+   * from a video stream's file are added to the packet cache a GOP at a time.
    *
-   * Indexing is slow so it's recommended to do it in a background thread. Index() must be called while the Decoder is
-   * open, and does not automatically call Open() and Close() the Decoder. The caller must call thse manually.
+   * @return
    *
-   * FIXME: This should perhaps become a common function for the base Decoder class
+   * An FFmpeg error code (e.g. AVERROR_EOF), or >= 0 on success
    */
-  void Index();
+  int ReadPacket(AVPacket* pkt);
 
   /**
    * @brief Returns the filename for the index
@@ -113,12 +258,59 @@ private:
   QString GetIndexFilename();
 
   /**
-   * @brief Get the destination filename of an audio stream conformed to a set of parameters
+   * @brief Returns the filename for the index of another stream in the same file
+   */
+  QString GetIndexFilename(int stream_index);
+
+  /**
+   * @brief Returns the filename for the packet index
+   *
+   * The packet index sits next to the frame index and stores the timestamp, keyframe flag and byte position of every
+   * packet in this stream. Decoder must be open for this to work correctly.
+   */
+  QString GetPacketIndexFilename();
+  QString GetPacketIndexFilename(int stream_index);
+
+  /**
+   * @brief Returns the filename of the record of where indexing a video stream got to
+   *
+   * Unlike the indexes themselves, this is named after where the file is rather than what it contains, so it's
+   * still found once a file that's being written has grown (see IndexFile()).
+   */
+  QString GetResumeFilename(int stream_index);
+
+  /**
+   * @brief Load the packets an earlier pass indexed of a video stream of a file that has grown since
+   *
+   * @param pos
+   *
+   * Set to the position in the file of the last packet that was indexed.
+   *
+   * @return
+   *
+   * FALSE if there's no record of an earlier pass, the file hasn't grown since or it was replaced rather than added to
+   * (e.g. because its header changed).
+   */
+  bool LoadResumePoint(int stream_index, QVector<FFmpegIndexer::PacketIndexEntry>* indexed, int64_t* pos);
+
+  /**
+   * @brief Record where indexing a video stream got to, so indexing can carry on from there once the file has grown
+   *
+   * @param file_size
+   *
+   * Size of the file when indexing started.
+   */
+  void SaveResumePoint(int stream_index, qint64 file_size, int64_t pos);
+
+  /**
+   * @brief Get the destination filename of an audio stream conformed to the sample rate of a set of parameters
+   *
+   * Conformed files keep the format and channel layout of the index, only the sample rate is changed.
    */
   QString GetConformedFilename(const AudioRenderingParams &params);
 
   /**
-   * @brief Used internally to load a frame index into frame_index_
+   * @brief Used internally to load a frame index into frame_index_ (memory-mapped) and the packet index
    *
    * @return
    *
@@ -128,37 +320,263 @@ private:
   bool LoadIndex();
 
   /**
-   * @brief Used in Index() to save the just created frame index to a file that can be loaded later
+   * @brief Memory-map the frame index file into frame_index_
+   *
+   * @return
+   *
+   * TRUE if the frame index file was opened and mapped successfully.
+   */
+  bool MapFrameIndex();
+
+  /**
+   * @brief Release the frame index mapping and close the file (safe to call if nothing is mapped)
+   */
+  void UnmapFrameIndex();
+
+  /**
+   * @brief Fill keyframe_index_ with the sorted timestamps of every keyframe in packet_index_
+   */
+  void BuildKeyframeIndex();
+
+  /**
+   * @brief Used in LoadIndex() to read the packet index into packet_index_
+   *
+   * @return
+   *
+   * TRUE if the packet index was read successfully. FALSE if the file couldn't be opened or was corrupt.
    */
-  void SaveIndex();
+  bool LoadPacketIndex(QFile* file);
 
-  void IndexAudio(AVPacket* pkt, AVFrame* frame);
-  void IndexVideo(AVPacket* pkt, AVFrame* frame);
+  /**
+   * @brief Read a packet index file into `packets`, returns FALSE if it couldn't be opened or was corrupt
+   */
+  static bool ReadPacketIndex(QFile* file, QVector<FFmpegIndexer::PacketIndexEntry>* packets);
+
+  /**
+   * @brief Returns TRUE if every file of a stream's index exists (always TRUE for streams that aren't indexed)
+   */
+  bool IsStreamIndexed(int stream_index);
+
+  /**
+   * @brief Add a stream of this file to `indexer`, returns FALSE if it's not a stream type that gets indexed
+   */
+  bool AddStreamToIndexer(FFmpegIndexer* indexer, int stream_index);
+
+  /**
+   * @brief Index this stream, along with every other stream in the file that hasn't been indexed yet
+   *
+   * The file is only demuxed once for all of them. If another decoder is already indexing this stream, this waits for
+   * it to finish instead.
+   *
+   * If this is a video stream of a file that's grown since it was last indexed (e.g. because it's still being
+   * recorded), indexing carries on from the last packet that was indexed rather than reading the whole file again.
+   * Only other video streams that can also carry on are indexed in the same pass, audio indexes are written from the
+   * start of the file so they're left to a pass of their own.
+   */
+  void IndexFile(AVPacket* pkt, const QAtomicInt* cancelled);
 
   int64_t GetClosestTimestampInIndex(const int64_t& ts);
 
-  void Seek(int64_t timestamp);
+  /**
+   * @brief Returns the timestamp of the latest keyframe at or before `ts`
+   *
+   * If `ts` precedes all keyframes, the earliest keyframe is returned. If the index contains no keyframes,
+   * AV_NOPTS_VALUE is returned.
+   */
+  int64_t GetClosestKeyframeInIndex(const int64_t& ts);
+
+  /**
+   * @brief Returns a decoded frame's presentation timestamp, falling back to FFmpeg's best guess if it has none
+   */
+  static int64_t GetFrameTimestamp(AVFrame* frame);
+
+  /**
+   * @brief Seek to the keyframe at or before `timestamp`
+   *
+   * If `from_packet_cache` is TRUE and `timestamp` is a keyframe whose GOP is in FFmpegPacketCache, its packets are
+   * fed from there and the file isn't touched until they run out.
+   */
+  void Seek(int64_t timestamp, bool from_packet_cache = false);
+
+  /**
+   * @brief Convert the frame just decoded into frame_ and keep it in reverse_frames_
+   */
+  void BufferReverseFrame(int divider);
+
+  /**
+   * @brief Empty reverse_frames_, returning how many bytes of frames it held
+   */
+  qint64 ClearReverseBuffer();
+
+  /**
+   * @brief Move `bytes` of frames taken into (or out of if negative) reverse_frames_ between MemoryBudget categories
+   */
+  static void ReportReverseMemory(qint64 bytes);
+
+  /**
+   * @brief Set last_request_ts_, counting how many requests in a row have gone backwards
+   */
+  void SetLastRequest(int64_t timestamp);
+
+  /**
+   * @brief Read the packets of the GOP before this keyframe ahead, since playing backwards it's decoded next
+   */
+  void PrefetchPreviousGop(int64_t keyframe_ts);
 
   /**
    * @brief Returns an AVPixelFormat that can be used in Olive and causes minimal data loss
    */
   AVPixelFormat GetCompatiblePixelFormat(const AVPixelFormat& pix_fmt);
 
-  SampleFormat GetNativeSampleFormat(const AVSampleFormat& smp_fmt);
-
   AVSampleFormat GetFFmpegSampleFormat(const SampleFormat& smp_fmt);
 
-  int CalculatePlaneHeight(int frame_height, const AVPixelFormat& format, int plane);
-
   AVFormatContext* fmt_ctx_;
+
+  /**
+   * @brief Reads the file through FFmpegFileBuffer, or nullptr if FFmpeg opened it itself
+   */
+  AVIOContext* io_ctx_;
+  std::shared_ptr<FFmpegFileBuffer> file_buffer_;
+
   AVCodecContext* codec_ctx_;
   AVStream* avstream_;
   AVDictionary* opts_;
 
-  SwsContext* scale_ctx_;
+  /**
+   * @brief One conversion context for each slice ConvertFrame() splits frames into, so slices convert at the same time
+   */
+  QVector<SwsContext*> scale_ctxs_;
   int output_fmt_;
+  AVPixelFormat ideal_pix_fmt_;
+
+  /**
+   * @brief Packet and frame reused for every decode in this session
+   */
+  AVPacket* pkt_;
+  AVFrame* frame_;
+
+  /**
+   * @brief Hardware decoding device, pixel format and system memory frame to transfer into (unused if software decoding)
+   */
+  AVBufferRef* hw_device_ctx_;
+  AVPixelFormat hw_pix_fmt_;
+  AVFrame* sw_frame_;
+
+  /**
+   * @brief DecodePath of the last frame converted, read from other threads by ActiveDecodePath()
+   */
+  QAtomicInt decode_path_;
+
+  /**
+   * @brief AVCodecContext::lowres value to open the codec with (log2 of the resolution reduction)
+   *
+   * Set by RetrieveVideo() from the requested divider. Changing it requires the codec to be reopened.
+   */
+  int lowres_;
+
+  /**
+   * @brief Timestamp of the frame most recently decoded into frame_
+   *
+   * Used to determine whether RetrieveVideo() can keep decoding from the current position rather than seeking. Set to
+   * AV_NOPTS_VALUE whenever the decoder's position is unknown (e.g. after a seek or reaching the end of the stream).
+   */
+  int64_t last_frame_ts_;
+
+  /**
+   * @brief The last frame returned by RetrieveVideo() so repeated requests for the same frame don't decode again
+   */
+  FramePtr cached_frame_;
+  int cached_divider_;
+
+  /**
+   * @brief Timestamp of the last frame asked for with RetrieveVideo(), to tell when playback is going backwards
+   */
+  int64_t last_request_ts_;
+
+  /**
+   * @brief Number of requests in a row for a frame earlier than the one before, reset by any request later than it
+   */
+  int backward_requests_;
+
+  /**
+   * @brief Frames decoded on the way to the last one requested while playing backwards, by timestamp
+   *
+   * These are the frames that'll be asked for next, so each GOP is only decoded once rather than once per frame. Holds
+   * no more than kReverseBufferSize bytes of frames at `reverse_divider_`. `reverse_lock_` protects the frames and
+   * their size, since Reclaim() drops them from the relief thread.
+   */
+  QMap<int64_t, FramePtr> reverse_frames_;
+  int reverse_divider_;
+  qint64 reverse_size_;
+  QMutex reverse_lock_;
+
+  /**
+   * @brief Sorted presentation timestamps of every frame, memory-mapped from the index file
+   */
+  QFile frame_index_file_;
+
+  DiskCacheManager::FileUse frame_index_use_;
+  const int64_t* frame_index_;
+  int frame_index_count_;
+
+  /**
+   * @brief Size of the file when the loaded index was made for it, so a file that's grown since can be indexed again
+   */
+  qint64 indexed_file_size_;
+
+  /**
+   * @brief A single entry in the packet index
+   */
+  using PacketIndexEntry = FFmpegIndexer::PacketIndexEntry;
+
+  QVector<PacketIndexEntry> packet_index_;
+
+  QVector<int64_t> keyframe_index_;
+
+  /**
+   * @brief Position in the file of each keyframe in keyframe_index_ (-1 if unknown)
+   */
+  QVector<int64_t> keyframe_pos_;
+
+  /**
+   * @brief Identifies this stream in FFmpegPacketCache
+   */
+  QString packet_cache_key_;
+
+  /**
+   * @brief GOP being fed from the packet cache instead of the file, and the next of its packets to feed
+   */
+  FFmpegPacketCache::GopPtr replay_gop_;
+  int replay_index_;
 
-  QVector<int64_t> frame_index_;
+  /**
+   * @brief GOP being read from the file, added to the packet cache once the next keyframe is read
+   */
+  FFmpegPacketCache::GopPtr recording_gop_;
+
+  /**
+   * @brief Once the file has been sought to carry on from a cached GOP, packets before this keyframe are skipped
+   */
+  int64_t resume_ts_;
+
+  /**
+   * @brief Resampler used by ResampleWindow() and the parameters it converts to
+   */
+  SwrContext* window_resampler_;
+  AudioRenderingParams window_params_;
+
+  /**
+   * @brief Next sample of the index that window_resampler_ will read, and next output sample it will produce
+   */
+  int64_t window_in_pos_;
+  int64_t window_out_pos_;
+
+  /**
+   * @brief Format and channel layout converter used by ConvertSamples() and the parameters it converts between
+   */
+  SwrContext* convert_ctx_;
+  AudioRenderingParams convert_src_params_;
+  AudioRenderingParams convert_dst_params_;
 
 };
 
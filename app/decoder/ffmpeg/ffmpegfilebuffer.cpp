@@ -0,0 +1,413 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#include "ffmpegfilebuffer.h"
+
+extern "C" {
+#include <libavutil/mem.h>
+}
+
+#include <QFileInfo>
+#include <QRunnable>
+
+#include "common/memorybudget.h"
+
+QCache<QString, QByteArray> FFmpegFileBuffer::blocks_(FFmpegFileBuffer::kMaximumBlocks);
+QMutex FFmpegFileBuffer::blocks_lock_;
+QHash<QString, std::weak_ptr<FFmpegFileBuffer> > FFmpegFileBuffer::buffers_;
+QMutex FFmpegFileBuffer::buffers_lock_;
+QThreadPool FFmpegFileBuffer::read_ahead_pool_;
+qint64 FFmpegFileBuffer::reported_bytes_ = 0;
+
+namespace {
+class ReadAheadTask : public QRunnable
+{
+public:
+  ReadAheadTask(std::shared_ptr<FFmpegFileBuffer> buffer, qint64 index) :
+    buffer_(buffer),
+    index_(index)
+  {
+  }
+
+  virtual void run() override
+  {
+    buffer_->Block(index_);
+  }
+
+private:
+  std::shared_ptr<FFmpegFileBuffer> buffer_;
+
+  qint64 index_;
+
+};
+
+class BlockReclaimer : public MemoryBudget::Reclaimer
+{
+public:
+  BlockReclaimer()
+  {
+    MemoryBudget::AddReclaimer(MemoryBudget::kFileBuffers, this);
+  }
+
+  virtual ~BlockReclaimer() override
+  {
+    MemoryBudget::RemoveReclaimer(this);
+  }
+
+  virtual qint64 Reclaim(qint64) override
+  {
+    // Blocks are cheap to read again, so they all go
+    return FFmpegFileBuffer::ReleaseBlocks();
+  }
+};
+
+BlockReclaimer block_reclaimer;
+}
+
+FFmpegFileBuffer::FFmpegFileBuffer(const QString &filename) :
+  filename_(filename),
+  file_(filename),
+  size_(0)
+{
+}
+
+std::shared_ptr<FFmpegFileBuffer> FFmpegFileBuffer::Get(const QString &filename)
+{
+  buffers_lock_.lock();
+
+  std::shared_ptr<FFmpegFileBuffer> buffer = buffers_.value(filename).lock();
+
+  if (buffer != nullptr) {
+    buffer->Refresh();
+  } else {
+    buffer = std::make_shared<FFmpegFileBuffer>(filename);
+
+    if (buffer->Open()) {
+      buffers_.insert(filename, buffer);
+    } else {
+      buffer = nullptr;
+    }
+  }
+
+  buffers_lock_.unlock();
+
+  return buffer;
+}
+
+bool FFmpegFileBuffer::Open()
+{
+  if (!file_.open(QFile::ReadOnly)) {
+    return false;
+  }
+
+  size_ = file_.size();
+  modified_ = QFileInfo(filename_).lastModified();
+  identity_ = MakeIdentity(filename_, size_, modified_);
+
+  // Networked reads can block for a while, so don't let read-ahead hold up the rest of the application
+  if (read_ahead_pool_.maxThreadCount() > 2) {
+    read_ahead_pool_.setMaxThreadCount(2);
+  }
+
+  return true;
+}
+
+AVIOContext *FFmpegFileBuffer::CreateIOContext()
+{
+  unsigned char* io_buffer = static_cast<unsigned char*>(av_malloc(kIOBufferSize));
+
+  if (io_buffer == nullptr) {
+    return nullptr;
+  }
+
+  Reader* reader = new Reader();
+  reader->buffer = shared_from_this();
+  reader->pos = 0;
+  reader->last_block = -1;
+
+  AVIOContext* ctx = avio_alloc_context(io_buffer, kIOBufferSize, 0, reader, ReadIO, nullptr, SeekIO);
+
+  if (ctx == nullptr) {
+    av_free(io_buffer);
+    delete reader;
+  }
+
+  return ctx;
+}
+
+void FFmpegFileBuffer::FreeIOContext(AVIOContext **ctx)
+{
+  if (*ctx == nullptr) {
+    return;
+  }
+
+  delete static_cast<Reader*>((*ctx)->opaque);
+
+  // FFmpeg may have swapped the buffer for another, so this frees whichever it has now
+  av_freep(&(*ctx)->buffer);
+  avio_context_free(ctx);
+}
+
+QByteArray FFmpegFileBuffer::Block(qint64 index)
+{
+  QString identity = Identity();
+  QString key = BlockKey(identity, index);
+
+  blocks_lock_.lock();
+
+  // Already being read (probably ahead), wait for it rather than reading it again
+  while (pending_.contains(index)) {
+    block_ready_.wait(&blocks_lock_);
+  }
+
+  QByteArray* cached = blocks_.object(key);
+
+  if (cached != nullptr) {
+    QByteArray block = *cached;
+    blocks_lock_.unlock();
+    return block;
+  }
+
+  pending_.insert(index);
+
+  blocks_lock_.unlock();
+
+  QByteArray block;
+
+  file_lock_.lock();
+
+  if (index * kBlockSize < size_ && file_.seek(index * kBlockSize)) {
+    block = file_.read(kBlockSize);
+  }
+
+  // If the file was refreshed in the meantime, this is the new file's block and doesn't belong under the old key
+  bool current = (identity_ == identity);
+
+  file_lock_.unlock();
+
+  blocks_lock_.lock();
+
+  if (!block.isEmpty() && current) {
+    blocks_.insert(key, new QByteArray(block));
+    ReportBlockMemory();
+  }
+
+  pending_.remove(index);
+  block_ready_.wakeAll();
+
+  blocks_lock_.unlock();
+
+  return block;
+}
+
+void FFmpegFileBuffer::ReadAhead(qint64 index)
+{
+  if (index < 0 || index * kBlockSize >= size()) {
+    return;
+  }
+
+  QString key = BlockKey(Identity(), index);
+
+  blocks_lock_.lock();
+
+  bool needed = !pending_.contains(index) && !blocks_.contains(key);
+
+  blocks_lock_.unlock();
+
+  if (needed) {
+    read_ahead_pool_.start(new ReadAheadTask(shared_from_this(), index));
+  }
+}
+
+void FFmpegFileBuffer::Prefetch(qint64 pos, qint64 length)
+{
+  qint64 first = pos / kBlockSize;
+  qint64 last = qMin((pos + length - 1) / kBlockSize, first + kMaximumBlocks / 2 - 1);
+
+  for (qint64 i=first;i<=last;i++) {
+    ReadAhead(i);
+  }
+}
+
+qint64 FFmpegFileBuffer::size() const
+{
+  file_lock_.lock();
+
+  qint64 size = size_;
+
+  file_lock_.unlock();
+
+  return size;
+}
+
+void FFmpegFileBuffer::Refresh()
+{
+  QFileInfo info(filename_);
+  QDateTime modified = info.lastModified();
+
+  file_lock_.lock();
+
+  QString old_identity = identity_;
+  bool changed = (info.size() != size_ || modified != modified_);
+
+  if (changed) {
+    // The file may have been replaced rather than appended to, so open whatever is at the path now
+    file_.close();
+    size_ = file_.open(QFile::ReadOnly) ? file_.size() : 0;
+    modified_ = modified;
+    identity_ = MakeIdentity(filename_, size_, modified_);
+  }
+
+  file_lock_.unlock();
+
+  if (changed) {
+    blocks_lock_.lock();
+
+    // Nothing asks for the old keys any more, so free them now rather than waiting for them to be pushed out
+    QString old_prefix = old_identity + QLatin1Char('@');
+
+    foreach (const QString& key, blocks_.keys()) {
+      if (key.startsWith(old_prefix)) {
+        blocks_.remove(key);
+      }
+    }
+
+    ReportBlockMemory();
+
+    blocks_lock_.unlock();
+  }
+}
+
+qint64 FFmpegFileBuffer::ReleaseBlocks()
+{
+  blocks_lock_.lock();
+
+  qint64 freed = reported_bytes_;
+
+  blocks_.clear();
+  ReportBlockMemory();
+
+  blocks_lock_.unlock();
+
+  return freed;
+}
+
+void FFmpegFileBuffer::ReportBlockMemory()
+{
+  qint64 bytes = blocks_.size() * kBlockSize;
+
+  MemoryBudget::Add(MemoryBudget::kFileBuffers, bytes - reported_bytes_);
+
+  reported_bytes_ = bytes;
+}
+
+int FFmpegFileBuffer::ReadIO(void *opaque, uint8_t *buf, int buf_size)
+{
+  Reader* reader = static_cast<Reader*>(opaque);
+  FFmpegFileBuffer* buffer = reader->buffer.get();
+
+  int copied = 0;
+
+  while (copied < buf_size && reader->pos < buffer->size()) {
+    qint64 index = reader->pos / kBlockSize;
+    QByteArray block = buffer->Block(index);
+
+    qint64 offset = reader->pos - index * kBlockSize;
+
+    if (offset >= block.size()) {
+      // Couldn't be read
+      break;
+    }
+
+    int count = static_cast<int>(qMin(static_cast<qint64>(buf_size - copied), block.size() - offset));
+
+    memcpy(buf + copied, block.constData() + offset, static_cast<size_t>(count));
+
+    copied += count;
+    reader->pos += count;
+
+    if (index != reader->last_block) {
+      // Keep the blocks after this one coming, and the one before too if we've just gone back (e.g. playing in
+      // reverse seeks back one keyframe at a time)
+      for (int i=1;i<=kReadAheadBlocks;i++) {
+        buffer->ReadAhead(index + i);
+      }
+
+      if (index < reader->last_block) {
+        buffer->ReadAhead(index - 1);
+      }
+
+      reader->last_block = index;
+    }
+  }
+
+  if (copied == 0) {
+    return (reader->pos >= buffer->size()) ? AVERROR_EOF : AVERROR(EIO);
+  }
+
+  return copied;
+}
+
+int64_t FFmpegFileBuffer::SeekIO(void *opaque, int64_t offset, int whence)
+{
+  Reader* reader = static_cast<Reader*>(opaque);
+
+  switch (whence & ~AVSEEK_FORCE) {
+  case AVSEEK_SIZE:
+    return reader->buffer->size();
+  case SEEK_SET:
+    reader->pos = offset;
+    break;
+  case SEEK_CUR:
+    reader->pos += offset;
+    break;
+  case SEEK_END:
+    reader->pos = reader->buffer->size() + offset;
+    break;
+  default:
+    return AVERROR(EINVAL);
+  }
+
+  return reader->pos;
+}
+
+QString FFmpegFileBuffer::BlockKey(const QString &identity, qint64 index)
+{
+  return QStringLiteral("%1@%2").arg(identity, QString::number(index));
+}
+
+QString FFmpegFileBuffer::Identity() const
+{
+  file_lock_.lock();
+
+  QString identity = identity_;
+
+  file_lock_.unlock();
+
+  return identity;
+}
+
+QString FFmpegFileBuffer::MakeIdentity(const QString &filename, qint64 size, const QDateTime &modified)
+{
+  return QStringLiteral("%1:%2:%3").arg(filename,
+                                        QString::number(size),
+                                        QString::number(modified.toMSecsSinceEpoch()));
+}
@@ -0,0 +1,207 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#ifndef FFMPEGFILEBUFFER_H
+#define FFMPEGFILEBUFFER_H
+
+extern "C" {
+#include <libavformat/avio.h>
+}
+
+#include <memory>
+#include <QCache>
+#include <QDateTime>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+/**
+ * @brief Reads a media file in large aligned blocks on behalf of every FFmpegDecoder that has it open
+ *
+ * FFmpeg's own file protocol makes lots of small reads, each of which is a round trip on network storage (SMB, NFS).
+ * Decoders given an AVIOContext from CreateIOContext() read through here instead: reads are whole kBlockSize
+ * blocks, the blocks after the one being read are read ahead on a background thread, and blocks are kept in memory
+ * for every decoder of the same file (and shared between files up to kMaximumBlocks).
+ *
+ * This class is thread-safe.
+ */
+class FFmpegFileBuffer : public std::enable_shared_from_this<FFmpegFileBuffer>
+{
+public:
+  FFmpegFileBuffer(const QString& filename);
+
+  /**
+   * @brief Get the buffer of this file, shared with any other decoder using it
+   *
+   * A buffer that's already open is refreshed first (see Refresh()) in case the file has changed since.
+   *
+   * @return
+   *
+   * The buffer, or nullptr if the file can't be opened (e.g. it's a URL FFmpeg should open itself).
+   */
+  static std::shared_ptr<FFmpegFileBuffer> Get(const QString& filename);
+
+  /**
+   * @brief Create an AVIOContext that reads this file through this buffer, free it with FreeIOContext()
+   */
+  AVIOContext* CreateIOContext();
+
+  static void FreeIOContext(AVIOContext** ctx);
+
+  /**
+   * @brief Get a block of the file, reading it if it isn't in memory yet
+   *
+   * Waits for the block if it's already being read (e.g. ahead by another thread). The block comes back shorter than
+   * kBlockSize at the end of the file, and empty past it or if it couldn't be read.
+   */
+  QByteArray Block(qint64 index);
+
+  /**
+   * @brief Read this block on a background thread unless it's in memory or already being read
+   */
+  void ReadAhead(qint64 index);
+
+  /**
+   * @brief Read the blocks covering these bytes of the file on a background thread
+   *
+   * No more than half of kMaximumBlocks are read, so what's read first isn't pushed out by the rest.
+   */
+  void Prefetch(qint64 pos, qint64 length);
+
+  qint64 size() const;
+
+  /**
+   * @brief Check the file again and, if its size or modification time has changed, read it from where it is now
+   *
+   * Reads stop at the size the file had when it was last checked, so a file that's still being written needs this
+   * before anything appended to it can be read. Blocks read from it before are dropped, since the last one was read
+   * short and the rest may not be what's in the file now if it was replaced.
+   */
+  void Refresh();
+
+  /**
+   * @brief Drop every block in memory, e.g. because the process is under memory pressure
+   *
+   * Blocks that are still being read are kept by whoever's reading them. Returns roughly how many bytes were freed.
+   */
+  static qint64 ReleaseBlocks();
+
+  /**
+   * @brief Bytes read from the file at a time
+   */
+  static const qint64 kBlockSize = 1024 * 1024;
+
+  /**
+   * @brief Blocks kept in memory across every file
+   */
+  static const int kMaximumBlocks = 64;
+
+  /**
+   * @brief Blocks read ahead of the one being read
+   */
+  static const int kReadAheadBlocks = 4;
+
+private:
+  /**
+   * @brief Bytes FFmpeg reads through the AVIOContext at a time, as it'd read with its own file protocol
+   */
+  static const int kIOBufferSize = 64 * 1024;
+
+  struct Reader {
+    std::shared_ptr<FFmpegFileBuffer> buffer;
+    qint64 pos;
+    qint64 last_block;
+  };
+
+  static int ReadIO(void* opaque, uint8_t* buf, int buf_size);
+
+  static int64_t SeekIO(void* opaque, int64_t offset, int whence);
+
+  /**
+   * @brief Key of a block of this file as it is now in blocks_
+   *
+   * Blocks outlive buffers, so keys include the file's size and modification time as well as its name. A file
+   * replaced on disk under the same name is never served the old one's blocks.
+   */
+  static QString BlockKey(const QString& identity, qint64 index);
+
+  /**
+   * @brief The current identity for BlockKey()
+   */
+  QString Identity() const;
+
+  static QString MakeIdentity(const QString& filename, qint64 size, const QDateTime& modified);
+
+  bool Open();
+
+  QString filename_;
+
+  QFile file_;
+
+  /**
+   * @brief Protects file_, size_, modified_ and identity_
+   */
+  mutable QMutex file_lock_;
+
+  qint64 size_;
+
+  QDateTime modified_;
+
+  QString identity_;
+
+  /**
+   * @brief Blocks of this file being read, so they're only read once
+   */
+  QSet<qint64> pending_;
+
+  QWaitCondition block_ready_;
+
+  static QCache<QString, QByteArray> blocks_;
+
+  /**
+   * @brief Protects blocks_ and every buffer's pending_
+   */
+  static QMutex blocks_lock_;
+
+  /**
+   * @brief Report how much blocks_ holds now to MemoryBudget (blocks_lock_ must be held)
+   *
+   * QCache drops blocks without saying, so this is counted in whole blocks after every change.
+   */
+  static void ReportBlockMemory();
+
+  /**
+   * @brief Bytes of blocks_ last reported to MemoryBudget
+   */
+  static qint64 reported_bytes_;
+
+  static QHash<QString, std::weak_ptr<FFmpegFileBuffer> > buffers_;
+
+  static QMutex buffers_lock_;
+
+  static QThreadPool read_ahead_pool_;
+
+};
+
+#endif // FFMPEGFILEBUFFER_H
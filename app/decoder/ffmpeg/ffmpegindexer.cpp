@@ -0,0 +1,469 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#include "ffmpegindexer.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include <algorithm>
+#include <QDataStream>
+#include <QDebug>
+#include <QFile>
+
+#include "common/filefunctions.h"
+#include "ffmpegdecoder.h"
+#include "render/diskcachemanager.h"
+
+FFmpegIndexer::FFmpegIndexer(AVFormatContext *fmt_ctx) :
+  fmt_ctx_(fmt_ctx)
+{
+  chunks_.resize(kChunkCount);
+
+  for (int i=0;i<chunks_.size();i++) {
+    chunks_[i].stream = -1;
+    chunks_[i].frame = av_frame_alloc();
+    chunks_[i].packed_size = 0;
+
+    free_queue_.Push(&chunks_[i]);
+  }
+}
+
+FFmpegIndexer::~FFmpegIndexer()
+{
+  for (int i=0;i<chunks_.size();i++) {
+    av_frame_free(&chunks_[i].frame);
+  }
+
+  foreach (AudioStreamState* s, audio_streams_) {
+    FreeStream(s);
+  }
+
+  qDeleteAll(video_streams_);
+}
+
+bool FFmpegIndexer::AddAudioStream(AVStream *stream, const QString &index_fn, const QString &waveform_fn,
+                                   AVCodecContext *codec_ctx)
+{
+  uint64_t channel_layout = stream->codecpar->channel_layout;
+  if (!channel_layout) {
+    if (!stream->codecpar->channels) {
+      // No channel data - we can't do anything with this
+      return false;
+    }
+
+    channel_layout = static_cast<uint64_t>(av_get_default_channel_layout(stream->codecpar->channels));
+  }
+
+  bool owns_codec_ctx = false;
+
+  if (codec_ctx == nullptr) {
+    AVCodec* codec = avcodec_find_decoder(stream->codecpar->codec_id);
+
+    if (codec == nullptr) {
+      qWarning() << "Failed to find a decoder to index audio stream" << stream->index;
+      return false;
+    }
+
+    codec_ctx = avcodec_alloc_context3(codec);
+
+    if (codec_ctx == nullptr
+        || avcodec_parameters_to_context(codec_ctx, stream->codecpar) < 0
+        || avcodec_open2(codec_ctx, codec, nullptr) < 0) {
+      qWarning() << "Failed to open a decoder to index audio stream" << stream->index;
+      avcodec_free_context(&codec_ctx);
+      return false;
+    }
+
+    owns_codec_ctx = true;
+  }
+
+  AudioStreamState* s = new AudioStreamState();
+  s->index = stream->index;
+  s->codec_ctx = codec_ctx;
+  s->owns_codec_ctx = owns_codec_ctx;
+  s->resampler = nullptr;
+  s->channel_count = stream->codecpar->channels;
+  s->index_fn = index_fn;
+
+  AVSampleFormat src_sample_fmt = static_cast<AVSampleFormat>(stream->codecpar->format);
+
+  // We don't use planar types internally, so if this is a planar format convert it in the convert stage
+  if (av_sample_fmt_is_planar(src_sample_fmt)) {
+    s->packed_fmt = av_get_packed_sample_fmt(src_sample_fmt);
+
+    s->resampler = swr_alloc_set_opts(nullptr,
+                                      static_cast<int64_t>(channel_layout),
+                                      s->packed_fmt,
+                                      stream->codecpar->sample_rate,
+                                      static_cast<int64_t>(channel_layout),
+                                      src_sample_fmt,
+                                      stream->codecpar->sample_rate,
+                                      0,
+                                      nullptr);
+  } else {
+    s->packed_fmt = src_sample_fmt;
+  }
+
+  AudioRenderingParams index_params(stream->codecpar->sample_rate,
+                                    channel_layout,
+                                    FFmpegDecoder::GetNativeSampleFormat(s->packed_fmt));
+
+  CreateParentFolder(index_fn);
+
+  s->wave_out = std::unique_ptr<WaveOutput>(new WaveOutput(index_fn, index_params));
+  s->waveform_out = std::unique_ptr<WaveformSummaryWriter>(new WaveformSummaryWriter(waveform_fn, index_params));
+
+  if (s->resampler != nullptr && swr_init(s->resampler) < 0) {
+    qWarning() << "Failed to set up planar conversion to index audio stream" << stream->index;
+    FreeStream(s);
+    return false;
+  }
+
+  if (!s->wave_out->open()) {
+    qWarning() << "Failed to open WAVE output for indexing";
+    FreeStream(s);
+    return false;
+  }
+
+  audio_streams_.append(s);
+
+  return true;
+}
+
+void FFmpegIndexer::AddVideoStream(AVStream *stream, const QString &index_fn, const QString &packet_index_fn,
+                                   const QVector<PacketIndexEntry> &indexed)
+{
+  VideoStreamState* s = new VideoStreamState();
+  s->index = stream->index;
+  s->index_fn = index_fn;
+  s->packet_index_fn = packet_index_fn;
+  s->packets = indexed;
+  s->skip_pos = -1;
+
+  s->frame_index.reserve(indexed.size());
+
+  foreach (const PacketIndexEntry& entry, indexed) {
+    s->frame_index.append(entry.pts);
+    s->skip_pos = qMax(s->skip_pos, entry.pos);
+  }
+
+  s->last_pos = s->skip_pos;
+
+  video_streams_.append(s);
+}
+
+int64_t FFmpegIndexer::LastPacketPosition(int stream_index) const
+{
+  foreach (VideoStreamState* s, video_streams_) {
+    if (s->index == stream_index) {
+      return s->last_pos;
+    }
+  }
+
+  return -1;
+}
+
+bool FFmpegIndexer::Run(AVPacket *pkt, const QAtomicInt *cancelled)
+{
+  ConvertThread convert_thread(this);
+  WriteThread write_thread(this);
+
+  convert_thread.start();
+  write_thread.start();
+
+  bool was_cancelled = false;
+
+  // Demux and decode stage, every stream is fed from this one pass over the file
+  while (av_read_frame(fmt_ctx_, pkt) >= 0) {
+    if (cancelled != nullptr && cancelled->loadAcquire()) {
+      av_packet_unref(pkt);
+      was_cancelled = true;
+      break;
+    }
+
+    for (int i=0;i<video_streams_.size();i++) {
+      if (video_streams_.at(i)->index == pkt->stream_index) {
+        IndexVideoPacket(video_streams_.at(i), pkt);
+        break;
+      }
+    }
+
+    for (int i=0;i<audio_streams_.size();i++) {
+      if (audio_streams_.at(i)->index == pkt->stream_index) {
+        if (avcodec_send_packet(audio_streams_.at(i)->codec_ctx, pkt) >= 0) {
+          ReceiveFrames(i);
+        }
+
+        break;
+      }
+    }
+
+    av_packet_unref(pkt);
+  }
+
+  if (!was_cancelled) {
+    foreach (VideoStreamState* s, video_streams_) {
+      SaveVideoIndex(s);
+    }
+  }
+
+  // Flush every decoder, then mark the end of the data for the other stages
+  for (int i=0;i<audio_streams_.size();i++) {
+    avcodec_send_packet(audio_streams_.at(i)->codec_ctx, nullptr);
+    ReceiveFrames(i);
+  }
+
+  convert_queue_.Push(nullptr);
+
+  convert_thread.wait();
+  write_thread.wait();
+
+  foreach (AudioStreamState* s, audio_streams_) {
+    s->wave_out->close();
+
+    if (was_cancelled) {
+      // The summary is only written in close(), so just the WAV needs removing
+      QFile::remove(s->index_fn);
+    } else {
+      s->waveform_out->close();
+
+      DiskCacheManager::instance()->FileWritten(s->index_fn);
+    }
+  }
+
+  return !was_cancelled;
+}
+
+void FFmpegIndexer::IndexVideoPacket(VideoStreamState *s, AVPacket *pkt)
+{
+  // Some containers don't store a presentation timestamp, in which case the decode timestamp is our best guess
+  int64_t pkt_ts = (pkt->pts == AV_NOPTS_VALUE) ? pkt->dts : pkt->pts;
+
+  // Packets an earlier pass indexed are already in the index
+  if (s->skip_pos >= 0 && pkt->pos <= s->skip_pos) {
+    return;
+  }
+
+  if (pkt_ts != AV_NOPTS_VALUE) {
+    PacketIndexEntry entry;
+    entry.pts = pkt_ts;
+    entry.pos = pkt->pos;
+    entry.flags = pkt->flags;
+    s->packets.append(entry);
+
+    s->frame_index.append(pkt_ts);
+
+    s->last_pos = qMax(s->last_pos, pkt->pos);
+  }
+}
+
+void FFmpegIndexer::SaveVideoIndex(VideoStreamState *s)
+{
+  // Packets are stored in decode order, but the frame index must be in presentation order
+  std::sort(s->frame_index.begin(), s->frame_index.end());
+
+  // Save index to file
+  CreateParentFolder(s->index_fn);
+
+  QFile index_file(s->index_fn);
+  if (index_file.open(QFile::WriteOnly)) {
+    // Write index in binary
+    index_file.write(reinterpret_cast<const char*>(s->frame_index.constData()),
+                     s->frame_index.size() * static_cast<int>(sizeof(int64_t)));
+
+    index_file.close();
+
+    DiskCacheManager::instance()->FileWritten(s->index_fn);
+  } else {
+    qWarning() << QStringLiteral("Failed to save index %1").arg(s->index_fn);
+  }
+
+  // Save packet index to file
+  QFile packet_index_file(s->packet_index_fn);
+  if (packet_index_file.open(QFile::WriteOnly)) {
+    QDataStream ds(&packet_index_file);
+    ds.setByteOrder(QDataStream::LittleEndian);
+
+    foreach (const PacketIndexEntry& entry, s->packets) {
+      ds << static_cast<qint64>(entry.pts);
+      ds << static_cast<qint64>(entry.pos);
+      ds << static_cast<qint32>(entry.flags);
+    }
+
+    packet_index_file.close();
+
+    DiskCacheManager::instance()->FileWritten(s->packet_index_fn);
+  } else {
+    qWarning() << QStringLiteral("Failed to save packet index %1").arg(s->packet_index_fn);
+  }
+
+  // Free the index now that it's on disk
+  s->frame_index.clear();
+  s->packets.clear();
+}
+
+void FFmpegIndexer::ReceiveFrames(int stream)
+{
+  AVCodecContext* codec_ctx = audio_streams_.at(stream)->codec_ctx;
+
+  while (true) {
+    // Blocks if the other stages are kChunkCount frames behind
+    Chunk* chunk = free_queue_.Pop();
+
+    if (avcodec_receive_frame(codec_ctx, chunk->frame) < 0) {
+      free_queue_.Push(chunk);
+      break;
+    }
+
+    chunk->stream = stream;
+    convert_queue_.Push(chunk);
+  }
+}
+
+void FFmpegIndexer::ConvertChunks()
+{
+  Chunk* chunk;
+
+  while ((chunk = convert_queue_.Pop()) != nullptr) {
+    AudioStreamState* s = audio_streams_.at(chunk->stream);
+
+    if (s->resampler != nullptr) {
+      int sample_count = chunk->frame->nb_samples;
+      int buffer_size = av_samples_get_buffer_size(nullptr, s->channel_count, sample_count, s->packed_fmt, 1);
+
+      // Chunks keep their buffer, so this only allocates until it's grown to the largest frame
+      if (chunk->packed.size() < buffer_size) {
+        chunk->packed.resize(buffer_size);
+      }
+
+      uint8_t* out = reinterpret_cast<uint8_t*>(chunk->packed.data());
+
+      int converted = swr_convert(s->resampler,
+                                  &out,
+                                  sample_count,
+                                  const_cast<const uint8_t**>(chunk->frame->extended_data),
+                                  sample_count);
+
+      if (converted < 0) {
+        char err_str[50];
+        av_strerror(converted, err_str, 50);
+        qWarning() << "libswresample failed with error:" << converted << err_str;
+        converted = 0;
+      }
+
+      chunk->packed_size = av_samples_get_buffer_size(nullptr, s->channel_count, converted, s->packed_fmt, 1);
+
+      // The decoded frame isn't needed anymore
+      av_frame_unref(chunk->frame);
+    }
+
+    write_queue_.Push(chunk);
+  }
+
+  write_queue_.Push(nullptr);
+}
+
+void FFmpegIndexer::WriteChunks()
+{
+  Chunk* chunk;
+
+  while ((chunk = write_queue_.Pop()) != nullptr) {
+    AudioStreamState* s = audio_streams_.at(chunk->stream);
+
+    const char* data;
+    int size;
+
+    if (s->resampler != nullptr) {
+      data = chunk->packed.constData();
+      size = chunk->packed_size;
+    } else {
+      // Packed audio can be written straight from the decoded frame
+      data = reinterpret_cast<const char*>(chunk->frame->data[0]);
+      size = av_samples_get_buffer_size(nullptr, s->channel_count, chunk->frame->nb_samples, s->packed_fmt, 1);
+    }
+
+    if (size > 0) {
+      s->wave_out->write(data, size);
+      s->waveform_out->write(data, size);
+    }
+
+    av_frame_unref(chunk->frame);
+    free_queue_.Push(chunk);
+  }
+}
+
+void FFmpegIndexer::FreeStream(AudioStreamState *s)
+{
+  if (s->resampler != nullptr) {
+    swr_free(&s->resampler);
+  }
+
+  if (s->owns_codec_ctx) {
+    avcodec_free_context(&s->codec_ctx);
+  }
+
+  delete s;
+}
+
+void FFmpegIndexer::ChunkQueue::Push(Chunk *chunk)
+{
+  lock_.lock();
+  queue_.enqueue(chunk);
+  wait_.wakeOne();
+  lock_.unlock();
+}
+
+FFmpegIndexer::Chunk *FFmpegIndexer::ChunkQueue::Pop()
+{
+  lock_.lock();
+
+  while (queue_.isEmpty()) {
+    wait_.wait(&lock_);
+  }
+
+  Chunk* chunk = queue_.dequeue();
+
+  lock_.unlock();
+
+  return chunk;
+}
+
+FFmpegIndexer::ConvertThread::ConvertThread(FFmpegIndexer *indexer) :
+  indexer_(indexer)
+{
+}
+
+void FFmpegIndexer::ConvertThread::run()
+{
+  indexer_->ConvertChunks();
+}
+
+FFmpegIndexer::WriteThread::WriteThread(FFmpegIndexer *indexer) :
+  indexer_(indexer)
+{
+}
+
+void FFmpegIndexer::WriteThread::run()
+{
+  indexer_->WriteChunks();
+}
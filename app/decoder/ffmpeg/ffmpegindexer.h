@@ -0,0 +1,231 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#ifndef FFMPEGINDEXER_H
+#define FFMPEGINDEXER_H
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libswresample/swresample.h>
+}
+
+#include <memory>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QQueue>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+#include "common/constructors.h"
+#include "decoder/waveformsummary.h"
+#include "decoder/waveoutput.h"
+
+/**
+ * @brief Indexes any number of video and audio streams of a file in a single demuxing pass
+ *
+ * Video streams only need their packets' timestamps, so they're indexed as the packets are demuxed. Audio indexing is
+ * split into three stages that run at the same time: demuxing and decoding on the calling thread, converting planar
+ * audio to packed on a second thread and writing the index WAV and waveform summary on a third. The stages pass a
+ * fixed pool of chunks between each other through blocking queues, so no stage can run more than kChunkCount frames
+ * ahead of the others and no frames are allocated per packet.
+ */
+class FFmpegIndexer
+{
+public:
+  FFmpegIndexer(AVFormatContext* fmt_ctx);
+
+  ~FFmpegIndexer();
+
+  DISABLE_COPY_MOVE(FFmpegIndexer)
+
+  /**
+   * @brief Add an audio stream to be indexed into `index_fn` with its waveform summary in `waveform_fn`
+   *
+   * `codec_ctx` can be an already open decoder for this stream (which remains owned by the caller), otherwise one is
+   * opened just for indexing.
+   *
+   * @return
+   *
+   * FALSE if the stream can't be decoded or its outputs couldn't be opened.
+   */
+  bool AddAudioStream(AVStream* stream, const QString& index_fn, const QString& waveform_fn,
+                      AVCodecContext* codec_ctx = nullptr);
+
+  /**
+   * @brief A single entry in a packet index
+   */
+  struct PacketIndexEntry {
+    int64_t pts;
+    int64_t pos;
+    int flags;
+  };
+
+  /**
+   * @brief Add a video stream to be indexed into a frame index `index_fn` and packet index `packet_index_fn`
+   *
+   * See FFmpegDecoder::LoadIndex() for the format of both.
+   *
+   * `indexed` are the packets an earlier pass already indexed, when carrying on from where it stopped in a file that
+   * has grown since. They go into the new index as they are, and any packet read from the file at or before the
+   * position of the last of them is skipped, so Run() can start from anywhere before that position.
+   */
+  void AddVideoStream(AVStream* stream, const QString& index_fn, const QString& packet_index_fn,
+                      const QVector<PacketIndexEntry>& indexed = QVector<PacketIndexEntry>());
+
+  /**
+   * @brief Position in the file of the last packet indexed for this video stream, or -1 if none had a position
+   */
+  int64_t LastPacketPosition(int stream_index) const;
+
+  /**
+   * @brief Read every packet from the current position to the end of the file and index every added stream
+   *
+   * If `cancelled` becomes non-zero, reading stops and every partially written index is removed.
+   *
+   * @return
+   *
+   * FALSE if indexing was cancelled.
+   */
+  bool Run(AVPacket* pkt, const QAtomicInt* cancelled = nullptr);
+
+private:
+  /**
+   * @brief A decoded frame travelling through the pipeline, along with its packed samples if it needed converting
+   */
+  struct Chunk {
+    int stream;
+    AVFrame* frame;
+    QByteArray packed;
+    int packed_size;
+  };
+
+  /**
+   * @brief Blocking FIFO of chunks, a nullptr chunk marks the end of the data
+   */
+  class ChunkQueue
+  {
+  public:
+    void Push(Chunk* chunk);
+
+    Chunk* Pop();
+
+  private:
+    QMutex lock_;
+    QWaitCondition wait_;
+    QQueue<Chunk*> queue_;
+  };
+
+  class ConvertThread : public QThread
+  {
+  public:
+    ConvertThread(FFmpegIndexer* indexer);
+
+  protected:
+    virtual void run() override;
+
+  private:
+    FFmpegIndexer* indexer_;
+  };
+
+  class WriteThread : public QThread
+  {
+  public:
+    WriteThread(FFmpegIndexer* indexer);
+
+  protected:
+    virtual void run() override;
+
+  private:
+    FFmpegIndexer* indexer_;
+  };
+
+  struct VideoStreamState {
+    int index;
+    QString index_fn;
+    QString packet_index_fn;
+    QVector<int64_t> frame_index;
+    QVector<PacketIndexEntry> packets;
+
+    /// Packets at or before this position were indexed by an earlier pass (-1 if there wasn't one)
+    int64_t skip_pos;
+
+    int64_t last_pos;
+  };
+
+  struct AudioStreamState {
+    int index;
+    AVCodecContext* codec_ctx;
+    bool owns_codec_ctx;
+    SwrContext* resampler;
+    AVSampleFormat packed_fmt;
+    int channel_count;
+    QString index_fn;
+    std::unique_ptr<WaveOutput> wave_out;
+    std::unique_ptr<WaveformSummaryWriter> waveform_out;
+  };
+
+  static void FreeStream(AudioStreamState* s);
+
+  /**
+   * @brief Add a demuxed packet of a video stream to its index
+   */
+  static void IndexVideoPacket(VideoStreamState* s, AVPacket* pkt);
+
+  /**
+   * @brief Sort and write out the indexes of a video stream once every packet has been read
+   */
+  static void SaveVideoIndex(VideoStreamState* s);
+
+  /**
+   * @brief Receive every frame the decoder of `stream` has ready and queue them for conversion
+   */
+  void ReceiveFrames(int stream);
+
+  /**
+   * @brief Main loop of the convert stage
+   */
+  void ConvertChunks();
+
+  /**
+   * @brief Main loop of the write stage
+   */
+  void WriteChunks();
+
+  static const int kChunkCount = 32;
+
+  AVFormatContext* fmt_ctx_;
+
+  QVector<AudioStreamState*> audio_streams_;
+
+  QVector<VideoStreamState*> video_streams_;
+
+  QVector<Chunk> chunks_;
+
+  ChunkQueue free_queue_;
+
+  ChunkQueue convert_queue_;
+
+  ChunkQueue write_queue_;
+
+};
+
+#endif // FFMPEGINDEXER_H
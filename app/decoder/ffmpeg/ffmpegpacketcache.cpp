@@ -0,0 +1,92 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#include "ffmpegpacketcache.h"
+
+QCache<QString, FFmpegPacketCache::GopPtr> FFmpegPacketCache::cache_(FFmpegPacketCache::kCapacity);
+QMutex FFmpegPacketCache::lock_;
+
+FFmpegPacketCache::Gop::Gop(int64_t keyframe) :
+  keyframe(keyframe),
+  next_keyframe(AV_NOPTS_VALUE),
+  size(0)
+{
+}
+
+FFmpegPacketCache::Gop::~Gop()
+{
+  for (int i=0;i<packets.size();i++) {
+    av_packet_free(&packets[i]);
+  }
+}
+
+FFmpegPacketCache::GopPtr FFmpegPacketCache::Find(const QString &stream_key, int64_t keyframe)
+{
+  GopPtr gop;
+
+  lock_.lock();
+
+  // Also makes it the most recently used
+  GopPtr* cached = cache_.object(Key(stream_key, keyframe));
+
+  if (cached != nullptr) {
+    gop = *cached;
+  }
+
+  lock_.unlock();
+
+  return gop;
+}
+
+bool FFmpegPacketCache::Contains(const QString &stream_key, int64_t keyframe)
+{
+  lock_.lock();
+
+  bool contains = cache_.contains(Key(stream_key, keyframe));
+
+  lock_.unlock();
+
+  return contains;
+}
+
+void FFmpegPacketCache::Insert(const QString &stream_key, FFmpegPacketCache::GopPtr gop)
+{
+  if (gop->size > kMaximumGopSize) {
+    return;
+  }
+
+  lock_.lock();
+
+  // Decoders still feeding from a GOP this evicts keep it alive until they're done with it
+  cache_.insert(Key(stream_key, gop->keyframe), new GopPtr(gop), gop->size);
+
+  lock_.unlock();
+}
+
+QString FFmpegPacketCache::StreamKey(const QString &filename, int stream_index, qint64 timestamp)
+{
+  return QStringLiteral("%1:%2:%3").arg(filename, QString::number(stream_index), QString::number(timestamp));
+}
+
+QString FFmpegPacketCache::Key(const QString &stream_key, int64_t keyframe)
+{
+  return QStringLiteral("%1@%2").arg(stream_key, QString::number(keyframe));
+}
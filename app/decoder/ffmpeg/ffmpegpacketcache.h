@@ -0,0 +1,113 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#ifndef FFMPEGPACKETCACHE_H
+#define FFMPEGPACKETCACHE_H
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+#include <memory>
+#include <QCache>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief RAM cache of the compressed packets of recently decoded GOPs, shared by every FFmpegDecoder
+ *
+ * Scrubbing back and forth, or several workers decoding frames near each other, keeps seeking to the same keyframes.
+ * Decoders that find the GOP they're seeking to here feed its packets straight to the codec instead of reading them
+ * from the file again, which matters most on slow or high latency storage.
+ *
+ * GOPs are only added once every packet up to the next keyframe has been read, so a decoder can always carry on with
+ * the demuxer from where a cached GOP ends. The least recently used ones are dropped once kCapacity bytes of packets
+ * are cached. This class is thread-safe.
+ */
+class FFmpegPacketCache
+{
+public:
+  /**
+   * @brief Every packet of one stream from a keyframe up to (not including) the next one
+   */
+  struct Gop {
+    Gop(int64_t keyframe);
+
+    ~Gop();
+
+    int64_t keyframe;
+
+    /// Timestamp of the keyframe after this GOP, or AV_NOPTS_VALUE if it ends the stream
+    int64_t next_keyframe;
+
+    QVector<AVPacket*> packets;
+
+    /// Bytes of packet data
+    int size;
+  };
+
+  using GopPtr = std::shared_ptr<Gop>;
+
+  /**
+   * @brief Get the GOP of this stream that starts at `keyframe`, or nullptr if it isn't cached
+   *
+   * @param stream_key
+   *
+   * Identifies the stream, see StreamKey().
+   */
+  static GopPtr Find(const QString& stream_key, int64_t keyframe);
+
+  /**
+   * @brief Returns whether the GOP of this stream that starts at `keyframe` is cached
+   */
+  static bool Contains(const QString& stream_key, int64_t keyframe);
+
+  /**
+   * @brief Add a complete GOP of this stream
+   */
+  static void Insert(const QString& stream_key, GopPtr gop);
+
+  /**
+   * @brief Identify a stream of a file, as it was last modified at `timestamp` (milliseconds since epoch)
+   */
+  static QString StreamKey(const QString& filename, int stream_index, qint64 timestamp);
+
+  /**
+   * @brief Bytes of packets that are kept at most
+   */
+  static const int kCapacity = 128 * 1024 * 1024;
+
+  /**
+   * @brief GOPs bigger than this (e.g. intra-only streams with no keyframe for a while) aren't cached
+   */
+  static const int kMaximumGopSize = 32 * 1024 * 1024;
+
+private:
+  static QString Key(const QString& stream_key, int64_t keyframe);
+
+  static QCache<QString, GopPtr> cache_;
+
+  static QMutex lock_;
+
+};
+
+#endif // FFMPEGPACKETCACHE_H
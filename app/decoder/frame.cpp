@@ -23,18 +23,31 @@
 #include <QDebug>
 #include <QtGlobal>
 
+#include "framepool.h"
 #include "render/pixelservice.h"
 
 Frame::Frame() :
   width_(0),
   height_(0),
   format_(olive::PIX_FMT_INVALID),
+  yuv_colorspace_(kYUVNone),
+  yuv_full_range_(false),
+  chroma_width_(0),
+  chroma_height_(0),
   sample_count_(0),
+  data_(nullptr),
+  allocated_size_(0),
+  capacity_(0),
   timestamp_(0),
   native_timestamp_(0)
 {
 }
 
+Frame::~Frame()
+{
+  destroy();
+}
+
 FramePtr Frame::Create()
 {
   return std::make_shared<Frame>();
@@ -100,9 +113,62 @@ void Frame::set_format(const olive::PixelFormat &format)
   format_ = format;
 }
 
+const Frame::YUVColorspace &Frame::yuv_colorspace()
+{
+  return yuv_colorspace_;
+}
+
+void Frame::set_yuv_colorspace(const Frame::YUVColorspace &colorspace)
+{
+  yuv_colorspace_ = colorspace;
+}
+
+bool Frame::is_yuv() const
+{
+  return (yuv_colorspace_ != kYUVNone);
+}
+
+bool Frame::yuv_full_range() const
+{
+  return yuv_full_range_;
+}
+
+void Frame::set_yuv_full_range(bool e)
+{
+  yuv_full_range_ = e;
+}
+
+void Frame::set_chroma_size(int width, int height)
+{
+  chroma_width_ = width;
+  chroma_height_ = height;
+}
+
+int Frame::plane_width(int plane) const
+{
+  return (plane == 0) ? width_ : chroma_width_;
+}
+
+int Frame::plane_height(int plane) const
+{
+  return (plane == 0) ? height_ : chroma_height_;
+}
+
+char *Frame::plane_data(int plane)
+{
+  char* ptr = data_;
+
+  // Planes are stored in order, so skip over the ones before this
+  for (int i=0;i<plane;i++) {
+    ptr += plane_width(i) * plane_height(i);
+  }
+
+  return ptr;
+}
+
 QByteArray Frame::ToByteArray()
 {
-  return data_;
+  return QByteArray(data_, allocated_size_);
 }
 
 const int &Frame::sample_count()
@@ -117,30 +183,65 @@ void Frame::set_sample_count(const int &audio_sample_count)
 
 char *Frame::data()
 {
-  return data_.data();
+  return data_;
 }
 
 const char *Frame::const_data()
 {
-  return data_.constData();
+  return data_;
 }
 
 void Frame::allocate()
 {
+  int size = 0;
+
   // Assume this frame is intended to be a video frame
-  if (width_ > 0 && height_ > 0) {
-    data_.resize(PixelService::GetBufferSize(static_cast<olive::PixelFormat>(format_), width_, height_));
+  if (width_ > 0 && height_ > 0 && is_yuv()) {
+    // One byte per sample in each of the three planes
+    size = width_ * height_ + 2 * chroma_width_ * chroma_height_;
+  } else if (width_ > 0 && height_ > 0) {
+    size = PixelService::GetBufferSize(static_cast<olive::PixelFormat>(format_), width_, height_);
   } else if (sample_count_ > 0) {
-    data_.resize(audio_params_.samples_to_bytes(sample_count_));
+    size = audio_params_.samples_to_bytes(sample_count_);
+  } else {
+    return;
+  }
+
+  // Keep our existing buffer if it's big enough
+  if (data_ == nullptr || capacity_ < size) {
+    destroy();
+
+    data_ = FramePool::Allocate(size, &capacity_);
   }
+
+  allocated_size_ = size;
 }
 
 void Frame::destroy()
 {
-  data_.clear();
+  if (data_ != nullptr) {
+    if (external_owner_) {
+      external_owner_ = nullptr;
+    } else {
+      FramePool::Release(data_, capacity_);
+    }
+
+    data_ = nullptr;
+    allocated_size_ = 0;
+    capacity_ = 0;
+  }
 }
 
 int Frame::allocated_size() const
 {
-  return data_.size();
+  return allocated_size_;
+}
+
+void Frame::set_external_data(const char *data, int size, std::shared_ptr<const void> owner)
+{
+  destroy();
+
+  data_ = const_cast<char*>(data);
+  allocated_size_ = size;
+  external_owner_ = owner;
 }
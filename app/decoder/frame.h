@@ -24,6 +24,7 @@
 #include <memory>
 #include <QVector>
 
+#include "common/constructors.h"
 #include "common/rational.h"
 #include "render/audioparams.h"
 #include "render/pixelformat.h"
@@ -41,9 +42,25 @@ using FramePtr = std::shared_ptr<Frame>;
 class Frame
 {
 public:
+  /**
+   * @brief YUV matrix used by planar YUV frames
+   *
+   * kYUVNone means the frame contains packed pixels in format() as usual.
+   */
+  enum YUVColorspace {
+    kYUVNone,
+    kYUVBT601,
+    kYUVBT709,
+    kYUVBT2020
+  };
+
   /// Normal constructor
   Frame();
 
+  ~Frame();
+
+  DISABLE_COPY_MOVE(Frame)
+
   static FramePtr Create();
 
   /**
@@ -85,6 +102,44 @@ public:
   const olive::PixelFormat& format();
   void set_format(const olive::PixelFormat& format);
 
+  /**
+   * @brief Get frame's YUV colorspace
+   *
+   * If this is not kYUVNone, the frame data contains three 8-bit planes (Y, U, V) stored one after the other rather
+   * than packed pixels. format() is then the format the frame should have once converted to RGBA.
+   */
+  const YUVColorspace& yuv_colorspace();
+  void set_yuv_colorspace(const YUVColorspace& colorspace);
+
+  /**
+   * @brief Returns TRUE if this frame contains planar YUV data
+   */
+  bool is_yuv() const;
+
+  /**
+   * @brief Whether YUV data uses the full 0-255 range rather than the broadcast 16-235 range
+   */
+  bool yuv_full_range() const;
+  void set_yuv_full_range(bool e);
+
+  /**
+   * @brief Set the size of the U and V planes of a YUV frame (e.g. half width and height for 4:2:0)
+   */
+  void set_chroma_size(int width, int height);
+
+  /**
+   * @brief Get the dimensions of a plane in a YUV frame (0 = Y, 1 = U, 2 = V)
+   */
+  int plane_width(int plane) const;
+  int plane_height(int plane) const;
+
+  /**
+   * @brief Get the data of a plane in a YUV frame (0 = Y, 1 = U, 2 = V)
+   *
+   * Planes are tightly packed with a line size equal to plane_width().
+   */
+  char* plane_data(int plane);
+
   /**
    * @brief Returns a copy of the data in this frame as a QByteArray
    *
@@ -107,7 +162,8 @@ public:
    *
    * For video frames, the width(), height(), and format() must be set for this function to work.
    *
-   * If a memory buffer has been previously allocated without destroying, this function will destroy it.
+   * If a memory buffer has been previously allocated without destroying, this function will destroy it. Buffers come
+   * from FramePool and are returned to it when destroyed.
    */
   void allocate();
 
@@ -123,6 +179,14 @@ public:
    */
   int allocated_size() const;
 
+  /**
+   * @brief Point this frame at data it doesn't own instead of allocating a buffer
+   *
+   * `owner` is held until the frame is destroyed or reallocated, and should keep `data` alive (e.g. the mapping of a
+   * file). External data is read-only, callers must not write through data() on a frame set up this way.
+   */
+  void set_external_data(const char* data, int size, std::shared_ptr<const void> owner);
+
 private:
   int width_;
 
@@ -130,11 +194,31 @@ private:
 
   olive::PixelFormat format_;
 
+  YUVColorspace yuv_colorspace_;
+
+  bool yuv_full_range_;
+
+  int chroma_width_;
+
+  int chroma_height_;
+
   AudioRenderingParams audio_params_;
 
   int sample_count_;
 
-  QByteArray data_;
+  /**
+   * @brief Buffer from FramePool, which may be larger than allocated_size_
+   */
+  char* data_;
+
+  int allocated_size_;
+
+  int capacity_;
+
+  /**
+   * @brief Keeps external data alive, set if data_ is not from FramePool
+   */
+  std::shared_ptr<const void> external_owner_;
 
   rational timestamp_;
 
@@ -142,4 +226,7 @@ private:
 
 };
 
+#include <QMetaType>
+Q_DECLARE_METATYPE(FramePtr)
+
 #endif // FRAME_H
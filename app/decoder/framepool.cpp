@@ -0,0 +1,238 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#include "framepool.h"
+
+#include <QtGlobal>
+#include <limits.h>
+
+#include "common/memorybudget.h"
+
+namespace {
+
+/**
+ * @brief Free buffers are kept until they add up to this many bytes
+ */
+const qint64 kMaximumFreeBytes = Q_INT64_C(512) * 1024 * 1024;
+
+/**
+ * @brief Buffers smaller than this all share one size class
+ */
+const int kMinimumSizeClass = 4096;
+
+}
+
+FramePool::State::State() :
+  hits(0),
+  misses(0),
+  used_bytes(0),
+  free_bytes(0)
+{
+}
+
+namespace {
+
+class PoolReclaimer : public MemoryBudget::Reclaimer
+{
+public:
+  PoolReclaimer()
+  {
+    MemoryBudget::AddReclaimer(MemoryBudget::kFrames, this);
+  }
+
+  virtual ~PoolReclaimer() override
+  {
+    MemoryBudget::RemoveReclaimer(this);
+  }
+
+  virtual qint64 Reclaim(qint64 bytes) override
+  {
+    return FramePool::Trim(bytes);
+  }
+};
+
+PoolReclaimer pool_reclaimer;
+
+}
+
+char *FramePool::Allocate(int size, int *capacity)
+{
+  State& s = state();
+
+  int size_class = SizeClass(size);
+  char* data = nullptr;
+
+  s.lock.lock();
+
+  QHash<int, QVector<char*> >::iterator buffers = s.free_buffers.find(size_class);
+
+  if (buffers != s.free_buffers.end() && !buffers->isEmpty()) {
+    data = buffers->takeLast();
+    s.free_bytes -= size_class;
+    s.hits++;
+  } else {
+    s.misses++;
+  }
+
+  s.used_bytes += size_class;
+
+  s.lock.unlock();
+
+  if (data == nullptr) {
+    data = new char[size_class];
+    MemoryBudget::Add(MemoryBudget::kFrames, size_class);
+  }
+
+  *capacity = size_class;
+
+  return data;
+}
+
+void FramePool::Release(char *data, int capacity)
+{
+  State& s = state();
+
+  s.lock.lock();
+
+  s.used_bytes -= capacity;
+
+  bool keep = (s.free_bytes + capacity <= kMaximumFreeBytes && !MemoryBudget::UnderPressure());
+
+  if (keep) {
+    s.free_buffers[capacity].append(data);
+    s.free_bytes += capacity;
+  }
+
+  s.lock.unlock();
+
+  if (!keep) {
+    delete [] data;
+    MemoryBudget::Add(MemoryBudget::kFrames, -capacity);
+  }
+}
+
+qint64 FramePool::Trim(qint64 bytes)
+{
+  State& s = state();
+
+  QVector<char*> released;
+  qint64 released_bytes = 0;
+
+  s.lock.lock();
+
+  QHash<int, QVector<char*> >::iterator i = s.free_buffers.begin();
+
+  while (i != s.free_buffers.end() && released_bytes < bytes) {
+    while (!i->isEmpty() && released_bytes < bytes) {
+      released.append(i->takeLast());
+      released_bytes += i.key();
+    }
+
+    if (i->isEmpty()) {
+      i = s.free_buffers.erase(i);
+    } else {
+      ++i;
+    }
+  }
+
+  s.free_bytes -= released_bytes;
+
+  s.lock.unlock();
+
+  // Freed outside the lock, there may be a lot of them
+  foreach (char* data, released) {
+    delete [] data;
+  }
+
+  MemoryBudget::Add(MemoryBudget::kFrames, -released_bytes);
+
+  return released_bytes;
+}
+
+int FramePool::hits()
+{
+  State& s = state();
+
+  s.lock.lock();
+  int h = s.hits;
+  s.lock.unlock();
+
+  return h;
+}
+
+int FramePool::misses()
+{
+  State& s = state();
+
+  s.lock.lock();
+  int m = s.misses;
+  s.lock.unlock();
+
+  return m;
+}
+
+qint64 FramePool::used_bytes()
+{
+  State& s = state();
+
+  s.lock.lock();
+  qint64 b = s.used_bytes;
+  s.lock.unlock();
+
+  return b;
+}
+
+qint64 FramePool::free_bytes()
+{
+  State& s = state();
+
+  s.lock.lock();
+  qint64 b = s.free_bytes;
+  s.lock.unlock();
+
+  return b;
+}
+
+int FramePool::SizeClass(int size)
+{
+  if (size <= kMinimumSizeClass) {
+    return kMinimumSizeClass;
+  }
+
+  // Find the largest power of two below size, then round up to the next quarter step above it
+  int power = kMinimumSizeClass;
+
+  while (power <= size / 2) {
+    power *= 2;
+  }
+
+  qint64 step = power / 4;
+  qint64 rounded = ((size + step - 1) / step) * step;
+
+  // Very large sizes that can't be rounded up in an int get a class of their own
+  return (rounded > INT_MAX) ? size : static_cast<int>(rounded);
+}
+
+FramePool::State &FramePool::state()
+{
+  static State* s = new State();
+  return *s;
+}
@@ -0,0 +1,110 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+
+/**
+ * @brief Process-wide pool of Frame data buffers
+ *
+ * Decoders allocate a full frame buffer for every frame they return, which at high resolutions churns through large
+ * allocations and fragments the heap. Buffers are instead rounded up to a size class (the next of 1, 1.25, 1.5 or 1.75
+ * times a power of two, so at most 25% is wasted) and returned to the pool when their Frame is destroyed, so steady
+ * playback reuses the same few buffers. Free buffers beyond a limit are released back to the system, as are all of
+ * them while the process is under memory pressure (see MemoryBudget).
+ */
+class FramePool
+{
+public:
+  /**
+   * @brief Get a buffer of at least `size` bytes
+   *
+   * @param capacity
+   *
+   * Set to the real size of the buffer, which must be passed back to Release().
+   */
+  static char* Allocate(int size, int* capacity);
+
+  static void Release(char* data, int capacity);
+
+  /**
+   * @brief Release free buffers back to the system until at least `bytes` have been (or there are none left)
+   *
+   * @return
+   *
+   * How many bytes were released.
+   */
+  static qint64 Trim(qint64 bytes);
+
+  /**
+   * @brief Number of times Allocate() reused a buffer from the pool
+   */
+  static int hits();
+
+  /**
+   * @brief Number of times Allocate() had to allocate a new buffer
+   */
+  static int misses();
+
+  /**
+   * @brief Total size of the buffers currently held by Frames
+   */
+  static qint64 used_bytes();
+
+  /**
+   * @brief Total size of the free buffers waiting in the pool
+   */
+  static qint64 free_bytes();
+
+private:
+  static int SizeClass(int size);
+
+  struct State {
+    State();
+
+    QMutex lock;
+
+    QHash<int, QVector<char*> > free_buffers;
+
+    int hits;
+
+    int misses;
+
+    qint64 used_bytes;
+
+    qint64 free_bytes;
+  };
+
+  /**
+   * @brief Created on first use and never destroyed
+   *
+   * Frames held in other statics (e.g. OIIOStillCache) are destroyed at exit in no particular order, and release their
+   * buffers here when they are.
+   */
+  static State& state();
+
+};
+
+#endif // FRAMEPOOL_H
@@ -21,13 +21,243 @@
 #include "oiiodecoder.h"
 
 #include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QMap>
+#include <QMutex>
+#include <QRegularExpression>
+#include <QRunnable>
+#include <QSet>
+#include <QThreadPool>
+#include <QWaitCondition>
 
 #include "common/define.h"
+#include "common/timecodefunctions.h"
+#include "config/config.h"
+#include "oiiostillcache.h"
+
+/**
+ * @brief Frames of a sequence that have been read ahead of playback, shared with the tasks reading them
+ *
+ * Tasks hold a reference so a decoder can be closed while reads are still in flight.
+ */
+class OIIOReadAhead
+{
+public:
+  QMutex lock;
+
+  QWaitCondition frame_ready;
+
+  QMap<int64_t, FramePtr> frames;
+
+  QSet<int64_t> pending;
+
+  /**
+   * @brief Divider that the frames in `frames` were read at
+   */
+  int divider;
+};
+
+namespace {
+
+/**
+ * @brief Signatures at the start of image files OIIO reads
+ */
+struct ImageSignature {
+  const char* bytes;
+  int size;
+};
+
+const ImageSignature kImageSignatures[] = {
+  {"\x89PNG", 4},
+  {"\xFF\xD8\xFF", 3},           // JPEG
+  {"II*\x00", 4},                // TIFF (little endian)
+  {"MM\x00*", 4},                // TIFF (big endian)
+  {"\x76\x2F\x31\x01", 4},       // OpenEXR
+  {"SDPX", 4},                   // DPX (big endian)
+  {"XPDS", 4},                   // DPX (little endian)
+  {"8BPS", 4},                   // Photoshop
+  {"GIF8", 4},
+  {"#?RADIANCE", 10},
+  {"#?RGBE", 6},
+  {"\x80\x2A\x5F\xD7", 4},       // Cineon
+  {"BM", 2}
+};
+
+/**
+ * @brief Extensions of OIIO's image plugins and of its FFmpeg plugin, read from OIIO's extension list once
+ */
+QSet<QString> image_extensions;
+QSet<QString> movie_extensions;
+bool extensions_loaded = false;
+QMutex extension_lock;
+
+void LoadExtensions()
+{
+  // Formatted as "format:ext,ext;format:ext"
+  QString list = QString::fromStdString(OIIO::get_string_attribute("extension_list"));
+
+  foreach (const QString& format, list.split(';', QString::SkipEmptyParts)) {
+    QStringList format_and_extensions = format.split(':');
+
+    if (format_and_extensions.size() != 2) {
+      continue;
+    }
+
+    QSet<QString>& set = (format_and_extensions.first() == QStringLiteral("ffmpeg"))
+        ? movie_extensions : image_extensions;
+
+    foreach (const QString& ext, format_and_extensions.last().split(',', QString::SkipEmptyParts)) {
+      set.insert(ext.toLower());
+    }
+  }
+
+  extensions_loaded = true;
+}
+
+/**
+ * @brief Read an image file into an RGBA frame in its native bit depth
+ *
+ * If the file has MIP levels (e.g. tiled EXR or TX), the smallest level that's still at least 1/`divider` of the full
+ * resolution is read. Only that level's tiles are fetched from disk, so reduced resolution playback of very large
+ * images doesn't touch the full resolution data.
+ */
+FramePtr ReadImageFile(const QString& filename, int divider)
+{
+  std::unique_ptr<OIIO::ImageInput> image = OIIO::ImageInput::open(filename.toStdString());
+
+  if (!image) {
+    qWarning() << "Failed to open" << filename;
+    return nullptr;
+  }
+
+  OIIO::ImageSpec spec = image->spec();
+
+  if (divider > 1) {
+    int target_width = spec.width / divider;
+    int target_height = spec.height / divider;
+
+    OIIO::ImageSpec level_spec;
+    int level = 1;
+
+    while (image->seek_subimage(0, level, level_spec)
+           && level_spec.width >= target_width
+           && level_spec.height >= target_height) {
+      spec = level_spec;
+      level++;
+    }
+
+    // Return to the level we chose (seek_subimage() may have left us at one that was too small)
+    image->seek_subimage(0, level - 1, spec);
+  }
+
+  olive::PixelFormat pix_fmt;
+
+  // Weirdly, switch statement doesn't work correctly here
+  if (spec.format == OIIO::TypeDesc::UINT8) {
+    pix_fmt = olive::PIX_FMT_RGBA8;
+  } else if (spec.format == OIIO::TypeDesc::UINT16) {
+    pix_fmt = olive::PIX_FMT_RGBA16U;
+  } else if (spec.format == OIIO::TypeDesc::HALF) {
+    pix_fmt = olive::PIX_FMT_RGBA16F;
+  } else if (spec.format == OIIO::TypeDesc::FLOAT) {
+    pix_fmt = olive::PIX_FMT_RGBA32F;
+  } else {
+    qWarning() << "Failed to convert OIIO::ImageDesc to native pixel format";
+    return nullptr;
+  }
+
+  // FIXME: Many OIIO pixel formats are not handled here
+
+  FramePtr frame = Frame::Create();
+
+  frame->set_width(spec.width);
+  frame->set_height(spec.height);
+  frame->set_format(pix_fmt);
+  frame->allocate();
+
+  // Use the native format to determine what format OIIO should return. OIIO decodes with its own threads where the
+  // format supports it (e.g. EXR chunks).
+  image->read_image(PixelService::GetPixelFormatInfo(pix_fmt).oiio_desc, frame->data());
+
+  if (spec.nchannels != kRGBAChannels) {
+    PixelService::ConvertRGBtoRGBA(frame);
+  }
+
+  image->close();
+
+  return frame;
+}
+
+/**
+ * @brief Threads that read sequence frames ahead of playback
+ *
+ * Decoders wait on these reads and often run on threads of QThreadPool::globalInstance(), so the reads can't be
+ * queued there without risking every thread waiting on a read that none is free to run.
+ */
+QThreadPool* ReadAheadPool()
+{
+  // Never deleted, so reads still in flight when statics are destroyed at exit can finish
+  static QThreadPool* pool = new QThreadPool();
+
+  return pool;
+}
+
+/**
+ * @brief Reads one frame of a sequence into an OIIOReadAhead
+ */
+class ReadAheadTask : public QRunnable
+{
+public:
+  ReadAheadTask(std::shared_ptr<OIIOReadAhead> read_ahead, const QString& filename, const int64_t& timestamp, int divider) :
+    read_ahead_(read_ahead),
+    filename_(filename),
+    timestamp_(timestamp),
+    divider_(divider)
+  {
+  }
+
+  virtual void run() override
+  {
+    FramePtr frame = ReadImageFile(filename_, divider_);
+
+    read_ahead_->lock.lock();
+
+    read_ahead_->pending.remove(timestamp_);
+
+    // Discard the frame if the resolution changed while we were reading it
+    if (read_ahead_->divider == divider_) {
+      read_ahead_->frames.insert(timestamp_, frame);
+    }
+
+    read_ahead_->frame_ready.wakeAll();
+
+    read_ahead_->lock.unlock();
+  }
+
+private:
+  std::shared_ptr<OIIOReadAhead> read_ahead_;
+
+  QString filename_;
+
+  int64_t timestamp_;
+
+  int divider_;
+
+};
+
+}
 
 OIIODecoder::OIIODecoder() :
-  image_(nullptr),
-  frame_(nullptr)
+  is_sequence_(false),
+  frame_(nullptr),
+  frame_divider_(0)
+{
+}
+
+OIIODecoder::~OIIODecoder()
 {
+  Close();
 }
 
 QString OIIODecoder::id()
@@ -51,11 +281,31 @@ bool OIIODecoder::Probe(Footage *f)
   // Get stats for this image and dump them into the Footage file
   const OIIO::ImageSpec& spec = in->spec();
 
-  ImageStreamPtr image_stream = std::make_shared<ImageStream>();
-  image_stream->set_width(spec.width);
-  image_stream->set_height(spec.height);
+  Sequence sequence;
+
+  // Numbered stills (e.g. photos off a camera) are far more common than sequences, so sequences are opt-in
+  if (Config::Current()["ImportImageSequences"].toBool() && FindSequence(f->filename(), &sequence)) {
+    rational frame_rate = Config::Current()["DefaultSequenceFrameRate"].value<rational>();
+
+    VideoStreamPtr video_stream = std::make_shared<VideoStream>();
+    video_stream->set_width(spec.width);
+    video_stream->set_height(spec.height);
+    video_stream->set_frame_rate(frame_rate);
+    video_stream->set_timebase(frame_rate.flipped());
+    video_stream->set_duration(sequence.last - sequence.first + 1);
+    video_stream->set_codec(in->format_name());
+    video_stream->set_has_alpha(spec.alpha_channel >= 0 || spec.nchannels > 3);
+
+    f->add_stream(video_stream);
+  } else {
+    ImageStreamPtr image_stream = std::make_shared<ImageStream>();
+    image_stream->set_width(spec.width);
+    image_stream->set_height(spec.height);
+    image_stream->set_codec(in->format_name());
+    image_stream->set_has_alpha(spec.alpha_channel >= 0 || spec.nchannels > 3);
 
-  f->add_stream(image_stream);
+    f->add_stream(image_stream);
+  }
 
   // If we're here, we have a successful image open
   in->close();
@@ -63,91 +313,245 @@ bool OIIODecoder::Probe(Footage *f)
   return true;
 }
 
-bool OIIODecoder::Open()
+Decoder::ProbeHint OIIODecoder::GetProbeHint(const QString &filename, const QByteArray &header)
 {
-  image_ = OIIO::ImageInput::open(stream()->footage()->filename().toStdString());
+  for (size_t i=0;i<sizeof(kImageSignatures)/sizeof(kImageSignatures[0]);i++) {
+    const ImageSignature& signature = kImageSignatures[i];
 
-  if (!image_) {
-    return false;
+    if (header.size() >= signature.size && memcmp(header.constData(), signature.bytes, signature.size) == 0) {
+      return kProbeHintMagic;
+    }
   }
 
-  // Check if we can work with this pixel format
-  const OIIO::ImageSpec& spec = image_->spec();
+  QString extension = QFileInfo(filename).suffix().toLower();
 
-  width_ = spec.width;
-  height_ = spec.height;
+  extension_lock.lock();
 
-  // Weirdly, switch statement doesn't work correctly here
-  if (spec.format == OIIO::TypeDesc::UINT8) {
-    pix_fmt_ = olive::PIX_FMT_RGBA8;
-  } else if (spec.format == OIIO::TypeDesc::UINT16) {
-    pix_fmt_ = olive::PIX_FMT_RGBA16U;
-  } else if (spec.format == OIIO::TypeDesc::HALF) {
-    pix_fmt_ = olive::PIX_FMT_RGBA16F;
-  } else if (spec.format == OIIO::TypeDesc::FLOAT) {
-    pix_fmt_ = olive::PIX_FMT_RGBA32F;
-  } else {
-    qWarning() << "Failed to convert OIIO::ImageDesc to native pixel format";
-    return false;
+  if (!extensions_loaded) {
+    LoadExtensions();
   }
 
-  // FIXME: Many OIIO pixel formats are not handled here
+  ProbeHint hint = kProbeHintUnknown;
+
+  if (image_extensions.contains(extension)) {
+    hint = kProbeHintExtension;
+  } else if (movie_extensions.contains(extension)) {
+    hint = kProbeHintNone;
+  }
+
+  extension_lock.unlock();
 
-  is_rgba_ = (spec.nchannels == kRGBAChannels);
+  return hint;
+}
+
+bool OIIODecoder::Open()
+{
+  if (open_) {
+    return true;
+  }
 
-  pix_fmt_info_ = PixelService::GetPixelFormatInfo(static_cast<olive::PixelFormat>(pix_fmt_));
+  is_sequence_ = (stream()->type() == Stream::kVideo && FindSequence(stream()->footage()->filename(), &sequence_));
+
+  if (is_sequence_) {
+    read_ahead_ = std::make_shared<OIIOReadAhead>();
+    read_ahead_->divider = 1;
+  }
+
+  open_ = true;
 
   return true;
 }
 
-FramePtr OIIODecoder::RetrieveVideo(const rational &timecode)
+FramePtr OIIODecoder::RetrieveVideo(const rational &timecode, const int &divider)
 {
   if (!open_ && !Open()) {
     return nullptr;
   }
 
-  Q_UNUSED(timecode)
+  if (!is_sequence_) {
+    // Still images are only read once per divider, and shared with every other decoder using the same file
+    if (frame_ == nullptr || frame_divider_ != divider) {
+      QString filename = stream()->footage()->filename();
 
-  if (frame_ == nullptr) {
-    frame_ = Frame::Create();
+      frame_ = OIIOStillCache::Get(filename, divider);
 
-    frame_->set_width(width_);
-    frame_->set_height(height_);
-    frame_->set_format(pix_fmt_);
-    frame_->allocate();
+      if (frame_ == nullptr) {
+        frame_ = ReadImageFile(filename, divider);
 
-    // Use the native format to determine what format OIIO should return
-    // FIXME: Behavior of RGB images as opposed to RGBA?
-    image_->read_image(pix_fmt_info_.oiio_desc, frame_->data());
+        if (frame_ != nullptr) {
+          OIIOStillCache::Insert(filename, divider, frame_);
+        }
+      }
 
-    if (!is_rgba_) {
-      PixelService::ConvertRGBtoRGBA(frame_);
+      frame_divider_ = divider;
     }
+
+    return frame_;
+  }
+
+  int64_t timestamp = GetTimestampFromTime(timecode);
+  FramePtr frame;
+
+  read_ahead_->lock.lock();
+
+  if (read_ahead_->divider != divider) {
+    // The resolution changed so anything we've read ahead is the wrong size (reads still in flight will be discarded)
+    read_ahead_->frames.clear();
+    read_ahead_->divider = divider;
+  }
+
+  // Wait for this frame if it's already being read
+  while (read_ahead_->pending.contains(timestamp)) {
+    read_ahead_->frame_ready.wait(&read_ahead_->lock);
   }
 
-  return frame_;
+  bool have_frame = read_ahead_->frames.contains(timestamp);
+
+  if (have_frame) {
+    frame = read_ahead_->frames.value(timestamp);
+  }
+
+  read_ahead_->lock.unlock();
+
+  if (!have_frame) {
+    frame = ReadImageFile(FilenameForTimestamp(timestamp), divider);
+
+    read_ahead_->lock.lock();
+    read_ahead_->frames.insert(timestamp, frame);
+    read_ahead_->lock.unlock();
+  }
+
+  UpdateReadAhead(timestamp);
+
+  return frame;
 }
 
 void OIIODecoder::Close()
 {
-  if (image_ != nullptr) {
-    image_->close();
-    image_ = nullptr;
-  }
+  // Any reads still in flight finish into their own reference and are freed with it
+  read_ahead_ = nullptr;
 
   frame_ = nullptr;
+
+  is_sequence_ = false;
+
+  open_ = false;
 }
 
 int64_t OIIODecoder::GetTimestampFromTime(const rational &time)
 {
-  Q_UNUSED(time)
+  if (!open_ && !Open()) {
+    return -1;
+  }
+
+  if (!is_sequence_) {
+    // A still image will always return the same frame
+    return 0;
+  }
 
-  // A still image will always return the same frame
+  int64_t timestamp = olive::time_to_timestamp(time, stream()->timebase());
 
-  return 0;
+  return qBound(static_cast<int64_t>(0), timestamp, sequence_.last - sequence_.first);
 }
 
 bool OIIODecoder::SupportsVideo()
 {
   return true;
 }
+
+bool OIIODecoder::IsStill()
+{
+  if (!open_ && !Open()) {
+    return false;
+  }
+
+  return !is_sequence_;
+}
+
+bool OIIODecoder::FindSequence(const QString &filename, OIIODecoder::Sequence *sequence)
+{
+  QFileInfo info(filename);
+
+  // Split the filename into everything before the last number, the number, and the extension
+  QRegularExpressionMatch match = QRegularExpression(QStringLiteral("^(.*?)(\\d+)(\\.[^.]*)?$")).match(info.fileName());
+
+  if (!match.hasMatch()) {
+    return false;
+  }
+
+  QString digits = match.captured(2);
+
+  sequence->prefix = info.dir().filePath(match.captured(1));
+  sequence->suffix = match.captured(3);
+  sequence->padding = digits.size();
+
+  int64_t number = digits.toLongLong();
+
+  // A number without leading zeros could be padded (1000 after 0999) or not (10 after 9), only the file before it
+  // can tell which
+  if (!digits.startsWith('0') && number > 0) {
+    Sequence unpadded = *sequence;
+    unpadded.padding = 0;
+
+    if (!QFileInfo::exists(SequenceFilename(*sequence, number - 1))
+        && QFileInfo::exists(SequenceFilename(unpadded, number - 1))) {
+      sequence->padding = 0;
+    }
+  }
+
+  sequence->first = number;
+  sequence->last = number;
+
+  // Walk outwards from this file until a number is missing
+  while (sequence->first > 0 && QFileInfo::exists(SequenceFilename(*sequence, sequence->first - 1))) {
+    sequence->first--;
+  }
+
+  while (QFileInfo::exists(SequenceFilename(*sequence, sequence->last + 1))) {
+    sequence->last++;
+  }
+
+  return (sequence->first != sequence->last);
+}
+
+QString OIIODecoder::SequenceFilename(const OIIODecoder::Sequence &sequence, const int64_t &number)
+{
+  return sequence.prefix
+      + QStringLiteral("%1").arg(number, sequence.padding, 10, QChar('0'))
+      + sequence.suffix;
+}
+
+QString OIIODecoder::FilenameForTimestamp(const int64_t &timestamp) const
+{
+  return SequenceFilename(sequence_, sequence_.first + timestamp);
+}
+
+void OIIODecoder::UpdateReadAhead(const int64_t &timestamp)
+{
+  // Read as many frames ahead as there are threads to read them
+  int64_t read_ahead_end = qMin(timestamp + ReadAheadPool()->maxThreadCount(),
+                                sequence_.last - sequence_.first);
+
+  read_ahead_->lock.lock();
+
+  // Forget frames behind the playhead or outside the read-ahead window (we've seeked elsewhere)
+  QMap<int64_t, FramePtr>::iterator i = read_ahead_->frames.begin();
+
+  while (i != read_ahead_->frames.end()) {
+    if (i.key() < timestamp || i.key() > read_ahead_end) {
+      i = read_ahead_->frames.erase(i);
+    } else {
+      i++;
+    }
+  }
+
+  for (int64_t t=timestamp+1;t<=read_ahead_end;t++) {
+    if (!read_ahead_->frames.contains(t) && !read_ahead_->pending.contains(t)) {
+      read_ahead_->pending.insert(t);
+
+      ReadAheadPool()->start(new ReadAheadTask(read_ahead_, FilenameForTimestamp(t), t, read_ahead_->divider));
+    }
+  }
+
+  read_ahead_->lock.unlock();
+}
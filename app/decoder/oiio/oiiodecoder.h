@@ -26,18 +26,37 @@
 #include "decoder/decoder.h"
 #include "render/pixelservice.h"
 
+class OIIOReadAhead;
+
+/**
+ * @brief Decoder for still images and numbered image sequences through OpenImageIO
+ *
+ * A file whose name ends in a number with a neighboring number on disk (e.g. `plate.0100.exr` next to
+ * `plate.0101.exr`) is treated as a sequence and exposed as a VideoStream. While a sequence plays, the next few frames
+ * are read in parallel on the global thread pool so playback is limited by disk bandwidth rather than decoding.
+ */
 class OIIODecoder : public Decoder
 {
 public:
   OIIODecoder();
 
+  virtual ~OIIODecoder() override;
+
   virtual QString id() override;
 
   virtual bool Probe(Footage *f) override;
 
+  /**
+   * @brief Images are recognized by their signature or by any extension OIIO has a plugin for
+   *
+   * Extensions only OIIO's FFmpeg plugin handles are left to FFmpegDecoder, since Probe() would only turn them down
+   * after opening them.
+   */
+  virtual ProbeHint GetProbeHint(const QString& filename, const QByteArray& header) override;
+
   virtual bool Open() override;
 
-  virtual FramePtr RetrieveVideo(const rational &timecode) override;
+  virtual FramePtr RetrieveVideo(const rational &timecode, const int &divider) override;
 
   virtual void Close() override;
 
@@ -45,21 +64,49 @@ public:
 
   virtual bool SupportsVideo() override;
 
+  virtual bool IsStill() override;
+
 private:
-  std::unique_ptr<OIIO::ImageInput> image_;
+  /**
+   * @brief Files that make up a numbered image sequence
+   */
+  struct Sequence {
+    QString prefix;
+    QString suffix;
+
+    /// Minimum number of digits, 0 if numbers aren't padded
+    int padding;
+    int64_t first;
+    int64_t last;
+  };
 
-  int width_;
+  /**
+   * @brief Find the sequence `filename` belongs to, returns FALSE if it's a single image
+   */
+  static bool FindSequence(const QString& filename, Sequence* sequence);
 
-  int height_;
+  /**
+   * @brief Returns the filename of the file numbered `number` in `sequence`
+   */
+  static QString SequenceFilename(const Sequence& sequence, const int64_t& number);
 
-  olive::PixelFormat pix_fmt_;
+  QString FilenameForTimestamp(const int64_t& timestamp) const;
 
-  PixelFormatInfo pix_fmt_info_;
+  /**
+   * @brief Start reading the frames after `timestamp` and forget those we've moved past
+   */
+  void UpdateReadAhead(const int64_t& timestamp);
 
-  bool is_rgba_;
+  bool is_sequence_;
+
+  Sequence sequence_;
 
   FramePtr frame_;
 
+  int frame_divider_;
+
+  std::shared_ptr<OIIOReadAhead> read_ahead_;
+
 };
 
 #endif // OIIODECODER_H
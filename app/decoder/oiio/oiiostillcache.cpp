@@ -0,0 +1,153 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#include "oiiostillcache.h"
+
+#include <QFileInfo>
+
+#include "common/memorybudget.h"
+
+namespace {
+
+/**
+ * @brief Maximum total size of cached frames in bytes
+ */
+const qint64 kMaximumSize = Q_INT64_C(512) * 1024 * 1024;
+
+}
+
+QMutex OIIOStillCache::lock_;
+QHash<QString, OIIOStillCache::Entry> OIIOStillCache::entries_;
+QLinkedList<QString> OIIOStillCache::order_;
+qint64 OIIOStillCache::size_ = 0;
+
+namespace {
+
+class StillReclaimer : public MemoryBudget::Reclaimer
+{
+public:
+  StillReclaimer()
+  {
+    MemoryBudget::AddReclaimer(MemoryBudget::kFrames, this);
+  }
+
+  virtual ~StillReclaimer() override
+  {
+    MemoryBudget::RemoveReclaimer(this);
+  }
+
+  virtual qint64 Reclaim(qint64 bytes) override
+  {
+    return OIIOStillCache::Trim(bytes);
+  }
+};
+
+StillReclaimer still_reclaimer;
+
+}
+
+FramePtr OIIOStillCache::Get(const QString &filename, int divider)
+{
+  QString key = Key(filename, divider);
+  QDateTime modified = QFileInfo(filename).lastModified();
+  FramePtr frame;
+
+  lock_.lock();
+
+  QHash<QString, Entry>::iterator entry = entries_.find(key);
+
+  if (entry != entries_.end()) {
+    if (entry->modified == modified) {
+      frame = entry->frame;
+
+      // Move to the back so it's evicted last
+      order_.erase(entry->order);
+      entry->order = order_.insert(order_.end(), key);
+    } else {
+      Remove(key);
+    }
+  }
+
+  lock_.unlock();
+
+  return frame;
+}
+
+void OIIOStillCache::Insert(const QString &filename, int divider, FramePtr frame)
+{
+  QString key = Key(filename, divider);
+
+  Entry entry;
+  entry.frame = frame;
+  entry.modified = QFileInfo(filename).lastModified();
+
+  lock_.lock();
+
+  // Another decoder may have read the same file in the meantime
+  Remove(key);
+
+  entry.order = order_.insert(order_.end(), key);
+  entries_.insert(key, entry);
+  size_ += frame->allocated_size();
+
+  // Never evict the frame we just added even if it's bigger than the limit on its own
+  while (size_ > kMaximumSize && order_.size() > 1) {
+    Remove(order_.first());
+  }
+
+  lock_.unlock();
+}
+
+qint64 OIIOStillCache::Trim(qint64 bytes)
+{
+  lock_.lock();
+
+  qint64 size_before = size_;
+
+  while (size_before - size_ < bytes && !order_.isEmpty()) {
+    Remove(order_.first());
+  }
+
+  qint64 dropped = size_before - size_;
+
+  lock_.unlock();
+
+  return dropped;
+}
+
+QString OIIOStillCache::Key(const QString &filename, int divider)
+{
+  return QStringLiteral("%1:%2").arg(filename, QString::number(divider));
+}
+
+void OIIOStillCache::Remove(const QString &key)
+{
+  QHash<QString, Entry>::iterator entry = entries_.find(key);
+
+  if (entry != entries_.end()) {
+    size_ -= entry->frame->allocated_size();
+
+    // Erased last since `key` may be the list's own copy
+    QLinkedList<QString>::iterator order = entry->order;
+    entries_.erase(entry);
+    order_.erase(order);
+  }
+}
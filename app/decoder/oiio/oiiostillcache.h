@@ -0,0 +1,85 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#ifndef OIIOSTILLCACHE_H
+#define OIIOSTILLCACHE_H
+
+#include <QDateTime>
+#include <QHash>
+#include <QLinkedList>
+#include <QMutex>
+
+#include "decoder/frame.h"
+
+/**
+ * @brief Process-wide cache of decoded still images
+ *
+ * Every clip (and every backend) gets its own decoder, so without this the same still used many times would be
+ * decoded and held in memory once per decoder. Frames are keyed by filename and divider and invalidated if the file
+ * is modified on disk. The least recently used frames are dropped when the cache grows past its limit, though frames
+ * still referenced by a decoder stay alive until it releases them.
+ */
+class OIIOStillCache
+{
+public:
+  /**
+   * @brief Get a cached frame, or nullptr if there isn't one or the file has changed since it was cached
+   */
+  static FramePtr Get(const QString& filename, int divider);
+
+  static void Insert(const QString& filename, int divider, FramePtr frame);
+
+  /**
+   * @brief Drop the least recently used frames until at least `bytes` have been dropped (or the cache is empty)
+   *
+   * @return
+   *
+   * How many bytes were dropped. Frames decoders are still holding are only freed once they let go of them.
+   */
+  static qint64 Trim(qint64 bytes);
+
+private:
+  struct Entry {
+    FramePtr frame;
+    QDateTime modified;
+
+    /// This entry's key in order_, so using it moves it to the back without searching the list
+    QLinkedList<QString>::iterator order;
+  };
+
+  static QString Key(const QString& filename, int divider);
+
+  static void Remove(const QString& key);
+
+  static QMutex lock_;
+
+  static QHash<QString, Entry> entries_;
+
+  /**
+   * @brief Keys in order of use, most recent last
+   */
+  static QLinkedList<QString> order_;
+
+  static qint64 size_;
+
+};
+
+#endif // OIIOSTILLCACHE_H
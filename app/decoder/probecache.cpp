@@ -0,0 +1,362 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#include "probecache.h"
+
+#include <cstring>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+
+#include "common/filefunctions.h"
+#include "project/item/footage/audiostream.h"
+#include "project/item/footage/videostream.h"
+
+const char ProbeCache::kMagic[4] = {'O', 'P', 'R', 'C'};
+const quint32 ProbeCache::kVersion = 2;
+
+QMutex ProbeCache::lock_;
+bool ProbeCache::loaded_ = false;
+QHash<QString, QByteArray> ProbeCache::entries_;
+
+bool ProbeCache::Load(Footage *f)
+{
+  QString id = GetUniqueFileIdentifier(f->filename());
+
+  if (id.isEmpty()) {
+    return false;
+  }
+
+  lock_.lock();
+
+  if (!loaded_) {
+    LoadDatabase();
+  }
+
+  QByteArray data = entries_.value(id);
+
+  lock_.unlock();
+
+  if (data.isEmpty()) {
+    return false;
+  }
+
+  if (!Deserialize(data, f)) {
+    qWarning() << "Discarding unreadable probe cache entry for" << f->filename();
+
+    // Leave the Footage as we found it so it can be probed normally
+    f->Clear();
+
+    lock_.lock();
+    entries_.remove(id);
+    lock_.unlock();
+
+    return false;
+  }
+
+  return true;
+}
+
+void ProbeCache::Save(Footage *f)
+{
+  QString id = GetUniqueFileIdentifier(f->filename());
+
+  if (id.isEmpty()) {
+    return;
+  }
+
+  QByteArray data = Serialize(f);
+
+  lock_.lock();
+
+  if (!loaded_) {
+    LoadDatabase();
+  }
+
+  // Don't grow the file with records we already have
+  if (entries_.value(id) == data) {
+    lock_.unlock();
+    return;
+  }
+
+  entries_.insert(id, data);
+
+  QFile file(GetFilename());
+
+  if (file.open(QFile::WriteOnly | QFile::Append)) {
+    if ((file.size() > 0 || WriteHeader(&file))
+        && !WriteRecord(&file, id, data)) {
+      qWarning() << "Failed to write probe cache entry for" << f->filename();
+    }
+
+    file.close();
+  } else {
+    qWarning() << "Failed to open probe cache" << file.fileName() << "for writing";
+  }
+
+  lock_.unlock();
+}
+
+QString ProbeCache::GetFilename()
+{
+  return QDir(GetMediaIndexLocation()).filePath(QStringLiteral("probecache"));
+}
+
+void ProbeCache::LoadDatabase()
+{
+  // Only try once, even if the file turns out to be missing or unreadable
+  loaded_ = true;
+
+  QFile file(GetFilename());
+
+  if (!file.open(QFile::ReadOnly)) {
+    return;
+  }
+
+  QDataStream ds(&file);
+  ds.setVersion(QDataStream::Qt_5_0);
+
+  char magic[4];
+  quint32 version;
+
+  bool valid = (ds.readRawData(magic, sizeof(magic)) == sizeof(magic)
+                && !memcmp(magic, kMagic, sizeof(magic)));
+
+  if (valid) {
+    ds >> version;
+    valid = (ds.status() == QDataStream::Ok && version == kVersion);
+  }
+
+  int record_count = 0;
+
+  if (valid) {
+    while (!ds.atEnd()) {
+      QString id;
+      QByteArray data;
+
+      ds >> id >> data;
+
+      if (ds.status() != QDataStream::Ok) {
+        // Most likely a record cut short by a crash, everything before it is still good
+        valid = false;
+        break;
+      }
+
+      entries_.insert(id, data);
+      record_count++;
+    }
+  }
+
+  file.close();
+
+  // Rewrite the file if it's damaged or mostly made up of superseded records
+  if (valid && record_count <= entries_.size() * 2) {
+    return;
+  }
+
+  QSaveFile compacted(GetFilename());
+
+  if (!compacted.open(QFile::WriteOnly)) {
+    return;
+  }
+
+  bool written = WriteHeader(&compacted);
+
+  for (auto it = entries_.constBegin(); written && it != entries_.constEnd(); it++) {
+    written = WriteRecord(&compacted, it.key(), it.value());
+  }
+
+  if (written) {
+    compacted.commit();
+  } else {
+    compacted.cancelWriting();
+  }
+}
+
+bool ProbeCache::WriteHeader(QIODevice *device)
+{
+  QDataStream ds(device);
+  ds.setVersion(QDataStream::Qt_5_0);
+
+  ds.writeRawData(kMagic, sizeof(kMagic));
+  ds << kVersion;
+
+  return (ds.status() == QDataStream::Ok);
+}
+
+bool ProbeCache::WriteRecord(QIODevice *device, const QString &id, const QByteArray &data)
+{
+  QDataStream ds(device);
+  ds.setVersion(QDataStream::Qt_5_0);
+
+  ds << id << data;
+
+  return (ds.status() == QDataStream::Ok);
+}
+
+QByteArray ProbeCache::Serialize(Footage *f)
+{
+  QByteArray data;
+
+  QDataStream ds(&data, QIODevice::WriteOnly);
+  ds.setVersion(QDataStream::Qt_5_0);
+
+  ds << f->decoder() << static_cast<quint32>(f->stream_count());
+
+  foreach (StreamPtr s, f->streams()) {
+    ds << static_cast<qint32>(s->type())
+       << static_cast<qint32>(s->index())
+       << static_cast<qint64>(s->timebase().numerator())
+       << static_cast<qint64>(s->timebase().denominator())
+       << static_cast<qint64>(s->duration())
+       << static_cast<qint64>(s->start_time())
+       << s->codec();
+
+    if (s->type() == Stream::kVideo || s->type() == Stream::kImage) {
+      ImageStreamPtr image_stream = std::static_pointer_cast<ImageStream>(s);
+
+      ds << static_cast<qint32>(image_stream->width())
+         << static_cast<qint32>(image_stream->height());
+
+      if (s->type() == Stream::kVideo) {
+        VideoStreamPtr video_stream = std::static_pointer_cast<VideoStream>(s);
+
+        ds << static_cast<qint64>(video_stream->frame_rate().numerator())
+           << static_cast<qint64>(video_stream->frame_rate().denominator());
+      }
+    } else if (s->type() == Stream::kAudio) {
+      AudioStreamPtr audio_stream = std::static_pointer_cast<AudioStream>(s);
+
+      ds << static_cast<qint32>(audio_stream->channels())
+         << static_cast<quint64>(audio_stream->layout())
+         << static_cast<qint32>(audio_stream->sample_rate());
+    }
+  }
+
+  // Added after the rest so entries written before it existed can still be read (their streams keep the default)
+  foreach (StreamPtr s, f->streams()) {
+    if (s->type() == Stream::kVideo || s->type() == Stream::kImage) {
+      ds << std::static_pointer_cast<ImageStream>(s)->has_alpha();
+    }
+  }
+
+  return data;
+}
+
+bool ProbeCache::Deserialize(const QByteArray &data, Footage *f)
+{
+  QDataStream ds(data);
+  ds.setVersion(QDataStream::Qt_5_0);
+
+  QString decoder;
+  quint32 stream_count;
+
+  ds >> decoder >> stream_count;
+
+  if (ds.status() != QDataStream::Ok || decoder.isEmpty()) {
+    return false;
+  }
+
+  for (quint32 i=0;i<stream_count;i++) {
+    qint32 type, index;
+    qint64 timebase_num, timebase_den, duration, start_time;
+    QString codec;
+
+    ds >> type >> index >> timebase_num >> timebase_den >> duration >> start_time >> codec;
+
+    StreamPtr s;
+
+    if (type == Stream::kVideo || type == Stream::kImage) {
+      ImageStreamPtr image_stream;
+      qint32 width, height;
+
+      if (type == Stream::kVideo) {
+        image_stream = std::make_shared<VideoStream>();
+      } else {
+        image_stream = std::make_shared<ImageStream>();
+      }
+
+      ds >> width >> height;
+
+      image_stream->set_width(width);
+      image_stream->set_height(height);
+
+      if (type == Stream::kVideo) {
+        qint64 frame_rate_num, frame_rate_den;
+
+        ds >> frame_rate_num >> frame_rate_den;
+
+        std::static_pointer_cast<VideoStream>(image_stream)->set_frame_rate(rational(frame_rate_num, frame_rate_den));
+      }
+
+      s = image_stream;
+    } else if (type == Stream::kAudio) {
+      AudioStreamPtr audio_stream = std::make_shared<AudioStream>();
+      qint32 channels, sample_rate;
+      quint64 layout;
+
+      ds >> channels >> layout >> sample_rate;
+
+      audio_stream->set_channels(channels);
+      audio_stream->set_layout(layout);
+      audio_stream->set_sample_rate(sample_rate);
+
+      s = audio_stream;
+    } else {
+      s = std::make_shared<Stream>();
+      s->set_type(static_cast<Stream::Type>(type));
+    }
+
+    if (ds.status() != QDataStream::Ok) {
+      return false;
+    }
+
+    s->set_index(index);
+    s->set_timebase(rational(timebase_num, timebase_den));
+    s->set_duration(duration);
+    s->set_start_time(start_time);
+    s->set_codec(codec);
+
+    f->add_stream(s);
+  }
+
+  if (!ds.atEnd()) {
+    foreach (StreamPtr s, f->streams()) {
+      if (s->type() == Stream::kVideo || s->type() == Stream::kImage) {
+        bool has_alpha;
+
+        ds >> has_alpha;
+
+        std::static_pointer_cast<ImageStream>(s)->set_has_alpha(has_alpha);
+      }
+    }
+
+    if (ds.status() != QDataStream::Ok) {
+      return false;
+    }
+  }
+
+  f->set_decoder(decoder);
+
+  return true;
+}
@@ -0,0 +1,96 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#ifndef PROBECACHE_H
+#define PROBECACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+#include "project/item/footage/footage.h"
+
+/**
+ * @brief A persistent store of Decoder::ProbeMedia() results keyed by file identity
+ *
+ * Probing has to open every file with a decoder, which adds up quickly for projects with thousands of clips. Every
+ * successful probe is recorded here against GetUniqueFileIdentifier() (path, modification time and size), so the
+ * same file's streams can be restored later without opening a decoder at all. A file that has changed since it was
+ * recorded gets a new identifier, so its stale entry is simply never looked up again.
+ *
+ * All entries live in a single append-only file in the media index location. It's read into memory on first use and
+ * each new probe appends one record to it, with later records replacing earlier ones for the same identifier. The
+ * file is compacted on load once superseded records start to make up most of it.
+ *
+ * All functions are thread-safe.
+ */
+class ProbeCache
+{
+public:
+  /**
+   * @brief Restore a Footage's decoder and streams from the cache
+   *
+   * The Footage must already have been cleared.
+   *
+   * @return
+   *
+   * TRUE if the file was found in the cache and the Footage was populated, FALSE if it needs to be probed.
+   */
+  static bool Load(Footage* f);
+
+  /**
+   * @brief Record a successfully probed Footage's decoder and streams in the cache
+   */
+  static void Save(Footage* f);
+
+  /**
+   * @brief Pack a Footage's decoder and streams into a buffer (also used to store footage in project files)
+   */
+  static QByteArray Serialize(Footage* f);
+
+  /**
+   * @brief Restore a Footage's decoder and streams from a buffer made by Serialize()
+   */
+  static bool Deserialize(const QByteArray& data, Footage* f);
+
+private:
+  static QString GetFilename();
+
+  static void LoadDatabase();
+
+  static bool WriteHeader(QIODevice* device);
+
+  static bool WriteRecord(QIODevice* device, const QString& id, const QByteArray& data);
+
+  static const char kMagic[4];
+
+  static const quint32 kVersion;
+
+  static QMutex lock_;
+
+  static bool loaded_;
+
+  static QHash<QString, QByteArray> entries_;
+
+};
+
+#endif // PROBECACHE_H
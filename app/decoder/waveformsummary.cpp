@@ -0,0 +1,488 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#include "waveformsummary.h"
+
+#include <limits>
+#include <QDebug>
+#include <QFileInfo>
+#include <QtMath>
+
+#include "common/filefunctions.h"
+#include "project/item/footage/footage.h"
+#include "render/diskcachemanager.h"
+
+const char WaveformSummary::kMagic[4] = {'O', 'W', 'F', 'S'};
+
+QMutex WaveformSummary::mappings_lock_;
+QHash<QString, WaveformSummary::MappingPtr> WaveformSummary::mappings_;
+QList<QString> WaveformSummary::mapping_order_;
+
+WaveformSummary::WaveformSummary(const QString &filename) :
+  filename_(filename)
+{
+}
+
+WaveformSummary::~WaveformSummary()
+{
+  close();
+}
+
+QString WaveformSummary::GetFilename(Stream *stream)
+{
+  return GetMediaIndexFilename(GetUniqueFileIdentifier(stream->footage()->filename()))
+      .append(QString::number(stream->index()))
+      .append(QStringLiteral(".waveform"));
+}
+
+bool WaveformSummary::open()
+{
+  close();
+
+  QFileInfo info(filename_);
+
+  if (!info.exists()) {
+    return false;
+  }
+
+  mappings_lock_.lock();
+
+  MappingPtr mapping = mappings_.value(filename_);
+
+  // Re-map if the file has been rewritten since we mapped it (e.g. by a new index)
+  if (mapping && (mapping->file_size != info.size() || mapping->modified != info.lastModified())) {
+    mappings_.remove(filename_);
+    mapping_order_.removeOne(filename_);
+    mapping = nullptr;
+  }
+
+  if (!mapping) {
+    mapping = CreateMapping(filename_);
+
+    if (mapping) {
+      mappings_.insert(filename_, mapping);
+      mapping_order_.append(filename_);
+
+      while (mapping_order_.size() > kMaximumMappings) {
+        mappings_.remove(mapping_order_.takeFirst());
+      }
+    }
+  }
+
+  mappings_lock_.unlock();
+
+  if (!mapping) {
+    return false;
+  }
+
+  mapping_ = mapping;
+
+  DiskCacheManager::instance()->FileAccessed(filename_);
+
+  return true;
+}
+
+bool WaveformSummary::is_open() const
+{
+  return mapping_ != nullptr;
+}
+
+void WaveformSummary::close()
+{
+  mapping_ = nullptr;
+}
+
+const QString &WaveformSummary::filename() const
+{
+  return filename_;
+}
+
+int WaveformSummary::sample_rate() const
+{
+  return is_open() ? static_cast<int>(mapping_->header.sample_rate) : 0;
+}
+
+int WaveformSummary::channel_count() const
+{
+  return is_open() ? static_cast<int>(mapping_->header.channel_count) : 0;
+}
+
+qint64 WaveformSummary::sample_count() const
+{
+  return is_open() ? static_cast<qint64>(mapping_->header.sample_count) : 0;
+}
+
+int WaveformSummary::level_count() const
+{
+  return is_open() ? mapping_->levels.size() : 0;
+}
+
+bool WaveformSummary::Summarize(qint64 start, qint64 end, int channel, float *min, float *max, float *rms) const
+{
+  if (!is_open() || mapping_->levels.isEmpty() || channel < 0 || channel >= channel_count()) {
+    return false;
+  }
+
+  start = qMax(start, qint64(0));
+  end = qMin(end, sample_count());
+
+  if (start >= end) {
+    return false;
+  }
+
+  // Find the coarsest level that doesn't have bins longer than the range
+  qint64 length = end - start;
+  qint64 bin_samples = mapping_->header.base_bin_samples;
+  int level = 0;
+
+  while (level + 1 < mapping_->levels.size() && bin_samples * 2 <= length) {
+    bin_samples *= 2;
+    level++;
+  }
+
+  // At that level the range can never span more than three bins
+  const Level& l = mapping_->levels.at(level);
+  const Bin* bins = reinterpret_cast<const Bin*>(mapping_->data + l.offset);
+  int channels = channel_count();
+
+  qint64 first = start / bin_samples;
+  qint64 last = qMin((end - 1) / bin_samples, static_cast<qint64>(l.bin_count) - 1);
+
+  int lowest = std::numeric_limits<qint16>::max();
+  int highest = std::numeric_limits<qint16>::min();
+  float mean_square = 0;
+
+  for (qint64 i=first;i<=last;i++) {
+    const Bin& b = bins[i * channels + channel];
+
+    lowest = qMin(lowest, static_cast<int>(b.min));
+    highest = qMax(highest, static_cast<int>(b.max));
+
+    float bin_rms = static_cast<float>(b.rms) / 32767.0f;
+    mean_square += bin_rms * bin_rms;
+  }
+
+  *min = static_cast<float>(lowest) / 32767.0f;
+  *max = static_cast<float>(highest) / 32767.0f;
+  *rms = qSqrt(mean_square / static_cast<float>(last - first + 1));
+
+  return true;
+}
+
+WaveformSummary::MappingPtr WaveformSummary::CreateMapping(const QString &filename)
+{
+  MappingPtr mapping = std::make_shared<Mapping>();
+  QFile& file = mapping->file;
+
+  file.setFileName(filename);
+
+  if (!file.open(QFile::ReadOnly)) {
+    return nullptr;
+  }
+
+  mapping->use.Acquire(filename);
+
+  qint64 size = file.size();
+
+  if (size < static_cast<qint64>(sizeof(Header))) {
+    qWarning() << "Waveform summary" << filename << "is truncated";
+    return nullptr;
+  }
+
+  mapping->data = file.map(0, size);
+
+  if (!mapping->data) {
+    qWarning() << "Failed to map waveform summary" << filename << file.errorString();
+    return nullptr;
+  }
+
+  Header& header = mapping->header;
+  memcpy(&header, mapping->data, sizeof(Header));
+
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0
+      || header.version != kVersion
+      || header.channel_count == 0
+      || header.base_bin_samples == 0) {
+    qWarning() << "Waveform summary" << filename << "is not a summary we can read";
+    return nullptr;
+  }
+
+  qint64 levels_end = static_cast<qint64>(sizeof(Header) + header.level_count * sizeof(Level));
+
+  if (size < levels_end) {
+    qWarning() << "Waveform summary" << filename << "is truncated";
+    return nullptr;
+  }
+
+  mapping->levels.resize(static_cast<int>(header.level_count));
+  memcpy(mapping->levels.data(), mapping->data + sizeof(Header), header.level_count * sizeof(Level));
+
+  foreach (const Level& l, mapping->levels) {
+    quint64 level_size = l.bin_count * header.channel_count * sizeof(Bin);
+
+    if (l.bin_count == 0 || l.offset < static_cast<quint64>(levels_end) || l.offset + level_size > static_cast<quint64>(size)) {
+      qWarning() << "Waveform summary" << filename << "is truncated";
+      return nullptr;
+    }
+  }
+
+  QFileInfo info(filename);
+  mapping->modified = info.lastModified();
+  mapping->file_size = size;
+
+  return mapping;
+}
+
+WaveformSummaryWriter::WaveformSummaryWriter(const QString &filename, const AudioRenderingParams &params) :
+  filename_(filename),
+  params_(params),
+  current_channel_(0),
+  current_frames_(0),
+  sample_count_(0)
+{
+  current_bin_.resize(params_.channel_count() * 3);
+
+  for (int i=0;i<current_bin_.size();i+=3) {
+    current_bin_[i] = std::numeric_limits<float>::max();
+    current_bin_[i + 1] = std::numeric_limits<float>::lowest();
+    current_bin_[i + 2] = 0;
+  }
+}
+
+void WaveformSummaryWriter::write(const char *bytes, int length)
+{
+  int sample_size = params_.bytes_per_sample_per_channel();
+
+  if (sample_size <= 0 || params_.channel_count() <= 0) {
+    return;
+  }
+
+  QByteArray joined;
+
+  if (!partial_sample_.isEmpty()) {
+    joined = partial_sample_;
+    joined.append(bytes, length);
+    partial_sample_.clear();
+
+    bytes = joined.constData();
+    length = joined.size();
+  }
+
+  int count = length / sample_size;
+
+  if (count * sample_size < length) {
+    partial_sample_ = QByteArray(bytes + count * sample_size, length - count * sample_size);
+  }
+
+  switch (params_.format()) {
+  case SAMPLE_FMT_U8:
+    AddSamples(reinterpret_cast<const quint8*>(bytes), count, 128.0f, 1.0f / 128.0f);
+    break;
+  case SAMPLE_FMT_S16:
+    AddSamples(reinterpret_cast<const qint16*>(bytes), count, 0.0f, 1.0f / 32768.0f);
+    break;
+  case SAMPLE_FMT_S32:
+    AddSamples(reinterpret_cast<const qint32*>(bytes), count, 0.0f, 1.0f / 2147483648.0f);
+    break;
+  case SAMPLE_FMT_S64:
+    AddSamples(reinterpret_cast<const qint64*>(bytes), count, 0.0f, 1.0f / 9223372036854775808.0f);
+    break;
+  case SAMPLE_FMT_FLT:
+    AddSamples(reinterpret_cast<const float*>(bytes), count, 0.0f, 1.0f);
+    break;
+  case SAMPLE_FMT_DBL:
+    AddSamples(reinterpret_cast<const double*>(bytes), count, 0.0f, 1.0f);
+    break;
+  case SAMPLE_FMT_INVALID:
+  case SAMPLE_FMT_COUNT:
+    break;
+  }
+}
+
+bool WaveformSummaryWriter::close()
+{
+  int channels = params_.channel_count();
+
+  if (channels <= 0) {
+    return false;
+  }
+
+  if (current_frames_ > 0) {
+    FlushBin();
+  }
+
+  // Work out the size of every level so the level table can be written up front
+  QVector<WaveformSummary::Level> levels;
+  quint64 bin_count = static_cast<quint64>(bins_.size() / (channels * 3));
+  quint64 offset = 0;
+
+  while (bin_count > 0) {
+    WaveformSummary::Level l;
+    l.offset = offset;
+    l.bin_count = bin_count;
+    levels.append(l);
+
+    offset += bin_count * static_cast<quint64>(channels) * sizeof(WaveformSummary::Bin);
+
+    if (bin_count == 1) {
+      break;
+    }
+
+    bin_count = (bin_count + 1) / 2;
+  }
+
+  quint64 data_start = sizeof(WaveformSummary::Header)
+      + static_cast<quint64>(levels.size()) * sizeof(WaveformSummary::Level);
+
+  for (int i=0;i<levels.size();i++) {
+    levels[i].offset += data_start;
+  }
+
+  WaveformSummary::Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, WaveformSummary::kMagic, sizeof(header.magic));
+  header.version = WaveformSummary::kVersion;
+  header.sample_rate = static_cast<quint32>(params_.sample_rate());
+  header.channel_count = static_cast<quint32>(channels);
+  header.base_bin_samples = WaveformSummary::kBaseBinSamples;
+  header.level_count = static_cast<quint32>(levels.size());
+  header.sample_count = static_cast<quint64>(sample_count_);
+
+  CreateParentFolder(filename_);
+
+  QSaveFile file(filename_);
+
+  if (!file.open(QFile::WriteOnly)) {
+    qWarning() << "Failed to open waveform summary" << filename_ << "for writing" << file.errorString();
+    return false;
+  }
+
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(levels.constData()),
+             static_cast<qint64>(static_cast<size_t>(levels.size()) * sizeof(WaveformSummary::Level)));
+
+  // Each level is derived from the one before it, only two levels are ever held at once
+  QVector<float> level_bins = bins_;
+  qint64 bin_samples = WaveformSummary::kBaseBinSamples;
+
+  for (int i=0;i<levels.size();i++) {
+    WriteLevel(&file, level_bins);
+
+    if (i + 1 == levels.size()) {
+      break;
+    }
+
+    int source_count = level_bins.size() / (channels * 3);
+    QVector<float> next_bins((source_count + 1) / 2 * channels * 3);
+
+    for (int j=0;j<source_count;j+=2) {
+      // The last bin of a level is usually shorter than the rest, so mean squares are weighted by sample count
+      float a_weight = static_cast<float>(qMin(bin_samples, sample_count_ - j * bin_samples));
+      float b_weight = (j + 1 < source_count)
+          ? static_cast<float>(qMin(bin_samples, sample_count_ - (j + 1) * bin_samples))
+          : 0.0f;
+
+      const float* a = level_bins.constData() + j * channels * 3;
+      const float* b = (j + 1 < source_count) ? a + channels * 3 : a;
+      float* dst = next_bins.data() + j / 2 * channels * 3;
+
+      for (int k=0;k<channels*3;k+=3) {
+        dst[k] = qMin(a[k], b[k]);
+        dst[k + 1] = qMax(a[k + 1], b[k + 1]);
+        dst[k + 2] = (a[k + 2] * a_weight + b[k + 2] * b_weight) / (a_weight + b_weight);
+      }
+    }
+
+    level_bins = next_bins;
+    bin_samples *= 2;
+  }
+
+  // Free level 0 now that it's been written
+  bins_.clear();
+
+  if (!file.commit()) {
+    qWarning() << "Failed to write waveform summary" << filename_ << file.errorString();
+    return false;
+  }
+
+  DiskCacheManager::instance()->FileWritten(filename_);
+
+  return true;
+}
+
+template<typename T>
+void WaveformSummaryWriter::AddSamples(const T *samples, int count, float offset, float scale)
+{
+  int channels = params_.channel_count();
+
+  for (int i=0;i<count;i++) {
+    float v = (static_cast<float>(samples[i]) - offset) * scale;
+    float* bin = current_bin_.data() + current_channel_ * 3;
+
+    bin[0] = qMin(bin[0], v);
+    bin[1] = qMax(bin[1], v);
+    bin[2] += v * v;
+
+    current_channel_++;
+
+    if (current_channel_ == channels) {
+      current_channel_ = 0;
+      current_frames_++;
+      sample_count_++;
+
+      if (current_frames_ == WaveformSummary::kBaseBinSamples) {
+        FlushBin();
+      }
+    }
+  }
+}
+
+void WaveformSummaryWriter::FlushBin()
+{
+  for (int i=0;i<current_bin_.size();i+=3) {
+    bins_.append(current_bin_.at(i));
+    bins_.append(current_bin_.at(i + 1));
+    bins_.append(current_bin_.at(i + 2) / static_cast<float>(current_frames_));
+
+    current_bin_[i] = std::numeric_limits<float>::max();
+    current_bin_[i + 1] = std::numeric_limits<float>::lowest();
+    current_bin_[i + 2] = 0;
+  }
+
+  current_frames_ = 0;
+}
+
+void WaveformSummaryWriter::WriteLevel(QSaveFile *file, const QVector<float> &bins)
+{
+  QVector<WaveformSummary::Bin> quantized(bins.size() / 3);
+
+  for (int i=0;i<quantized.size();i++) {
+    const float* src = bins.constData() + i * 3;
+    WaveformSummary::Bin& b = quantized[i];
+
+    b.min = static_cast<qint16>(qRound(qBound(-1.0f, src[0], 1.0f) * 32767.0f));
+    b.max = static_cast<qint16>(qRound(qBound(-1.0f, src[1], 1.0f) * 32767.0f));
+    b.rms = static_cast<qint16>(qRound(qBound(0.0f, qSqrt(src[2]), 1.0f) * 32767.0f));
+  }
+
+  file->write(reinterpret_cast<const char*>(quantized.constData()),
+              static_cast<qint64>(static_cast<size_t>(quantized.size()) * sizeof(WaveformSummary::Bin)));
+}
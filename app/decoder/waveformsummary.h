@@ -0,0 +1,216 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#ifndef WAVEFORMSUMMARY_H
+#define WAVEFORMSUMMARY_H
+
+#include <memory>
+#include <QDateTime>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QSaveFile>
+#include <QVector>
+
+#include "common/constructors.h"
+#include "project/item/footage/stream.h"
+#include "render/audioparams.h"
+#include "render/diskcachemanager.h"
+
+/**
+ * @brief A precomputed min/max/RMS summary of an audio stream for drawing waveforms
+ *
+ * Summaries are mipmapped like a texture: level 0 summarizes every kBaseBinSamples samples and every level after
+ * that summarizes twice as many, down to a single bin for the whole stream. Drawing a waveform at any zoom only needs
+ * the level closest to one bin per pixel, so the raw PCM is never read.
+ *
+ * Summary files are memory-mapped, and the mapping is shared by every WaveformSummary of the same file in the same
+ * way WaveInput shares its mappings.
+ */
+class WaveformSummary
+{
+public:
+  /**
+   * @brief Summary of one channel over one bin, scaled so that -1.0 to 1.0 maps to -32767 to 32767
+   */
+  struct Bin {
+    qint16 min;
+    qint16 max;
+    qint16 rms;
+  };
+
+  /**
+   * @brief Number of samples that each bin of level 0 summarizes
+   */
+  static const int kBaseBinSamples = 256;
+
+  WaveformSummary(const QString& filename);
+
+  ~WaveformSummary();
+
+  DISABLE_COPY_MOVE(WaveformSummary)
+
+  /**
+   * @brief Returns the filename of the summary of an audio stream, which sits next to the stream's index
+   */
+  static QString GetFilename(Stream* stream);
+
+  bool open();
+
+  bool is_open() const;
+
+  void close();
+
+  const QString& filename() const;
+
+  int sample_rate() const;
+
+  int channel_count() const;
+
+  qint64 sample_count() const;
+
+  int level_count() const;
+
+  /**
+   * @brief Summarize one channel from sample `start` up to (but not including) sample `end`
+   *
+   * The coarsest level whose bins still fit in the range is used, so the cost is the same for a range of a few
+   * samples as for one of a few hours. Values are normalized to -1.0 to 1.0.
+   *
+   * @return
+   *
+   * FALSE if the summary isn't open or the range lies outside the stream.
+   */
+  bool Summarize(qint64 start, qint64 end, int channel, float* min, float* max, float* rms) const;
+
+private:
+  friend class WaveformSummaryWriter;
+
+  struct Header {
+    char magic[4];
+    quint32 version;
+    quint32 sample_rate;
+    quint32 channel_count;
+    quint32 base_bin_samples;
+    quint32 level_count;
+    quint64 sample_count;
+  };
+
+  struct Level {
+    quint64 offset;
+    quint64 bin_count;
+  };
+
+  struct Mapping {
+    QFile file;
+    DiskCacheManager::FileUse use;
+    const uchar* data;
+    Header header;
+    QVector<Level> levels;
+    QDateTime modified;
+    qint64 file_size;
+  };
+
+  using MappingPtr = std::shared_ptr<Mapping>;
+
+  static const quint32 kVersion = 1;
+
+  static const char kMagic[4];
+
+  /**
+   * @brief Map and validate a summary file, returns nullptr if it isn't one we can read
+   */
+  static MappingPtr CreateMapping(const QString& filename);
+
+  QString filename_;
+
+  MappingPtr mapping_;
+
+  static QMutex mappings_lock_;
+
+  static QHash<QString, MappingPtr> mappings_;
+
+  static QList<QString> mapping_order_;
+
+  static const int kMaximumMappings = 64;
+
+};
+
+/**
+ * @brief Builds a WaveformSummary file from interleaved samples as they're written
+ *
+ * Only level 0 is accumulated while writing, the coarser levels are derived from it in close(). The file is written
+ * through a QSaveFile so a summary that was interrupted never replaces a complete one.
+ */
+class WaveformSummaryWriter
+{
+public:
+  WaveformSummaryWriter(const QString& filename, const AudioRenderingParams& params);
+
+  DISABLE_COPY_MOVE(WaveformSummaryWriter)
+
+  /**
+   * @brief Add `length` bytes of interleaved samples in the format of the parameters this writer was created with
+   */
+  void write(const char* bytes, int length);
+
+  /**
+   * @brief Build the remaining levels and write the file
+   *
+   * @return
+   *
+   * FALSE if the file couldn't be written.
+   */
+  bool close();
+
+private:
+  template<typename T>
+  void AddSamples(const T* samples, int count, float offset, float scale);
+
+  void FlushBin();
+
+  static void WriteLevel(QSaveFile* file, const QVector<float>& bins);
+
+  QString filename_;
+
+  AudioRenderingParams params_;
+
+  /**
+   * @brief Bytes of a sample split across two calls to write()
+   */
+  QByteArray partial_sample_;
+
+  int current_channel_;
+
+  int current_frames_;
+
+  qint64 sample_count_;
+
+  QVector<float> current_bin_;
+
+  /**
+   * @brief Level 0 so far, as min, max and mean square for every channel of every bin
+   */
+  QVector<float> bins_;
+
+};
+
+#endif // WAVEFORMSUMMARY_H
@@ -5,9 +5,16 @@ extern "C" {
 }
 
 #include <QDataStream>
+#include <QDebug>
+#include <QFileInfo>
+
+QMutex WaveInput::mappings_lock_;
+QHash<QString, WaveInput::MappingPtr> WaveInput::mappings_;
+QList<QString> WaveInput::mapping_order_;
 
 WaveInput::WaveInput(const QString &f) :
-  file_(f)
+  filename_(f),
+  pos_(0)
 {
 }
 
@@ -18,37 +25,168 @@ WaveInput::~WaveInput()
 
 bool WaveInput::open()
 {
-  if (!file_.open(QFile::ReadOnly)) {
+  close();
+
+  QFileInfo info(filename_);
+
+  if (!info.exists()) {
     return false;
   }
 
-  if (file_.read(4) != "RIFF") {
-    close();
-    qDebug() << "No RIFF found";
+  mappings_lock_.lock();
+
+  MappingPtr mapping = mappings_.value(filename_);
+
+  // Re-map if the file has been rewritten since we mapped it (e.g. by a new conform)
+  if (mapping && (mapping->file_size != info.size() || mapping->modified != info.lastModified())) {
+    mappings_.remove(filename_);
+    mapping_order_.removeOne(filename_);
+    mapping = nullptr;
+  }
+
+  if (!mapping) {
+    mapping = CreateMapping(filename_);
+
+    if (mapping) {
+      mappings_.insert(filename_, mapping);
+      mapping_order_.append(filename_);
+
+      // Drop the oldest mappings, any WaveInput still using one keeps it alive through its own reference
+      while (mapping_order_.size() > kMaximumMappings) {
+        mappings_.remove(mapping_order_.takeFirst());
+      }
+    }
+  }
+
+  mappings_lock_.unlock();
+
+  if (!mapping) {
     return false;
   }
 
+  mapping_ = mapping;
+  pos_ = 0;
+
+  return true;
+}
+
+bool WaveInput::is_open() const
+{
+  return mapping_ != nullptr;
+}
+
+QByteArray WaveInput::read(int length)
+{
+  QByteArray b = read(pos_, length);
+
+  pos_ += b.size();
+
+  return b;
+}
+
+QByteArray WaveInput::read(int offset, int length)
+{
+  if (!is_open() || offset < 0 || offset >= mapping_->size) {
+    return QByteArray();
+  }
+
+  return QByteArray(mapping_->data + offset, qMin(length, mapping_->size - offset));
+}
+
+void WaveInput::read(int offset, char *buffer, int length)
+{
+  if (!is_open() || offset < 0) {
+    memset(buffer, 0, static_cast<size_t>(length));
+    return;
+  }
+
+  int copy_length = qMax(0, qMin(length, mapping_->size - offset));
+
+  memcpy(buffer, mapping_->data + offset, static_cast<size_t>(copy_length));
+
+  // Anything past the end of the file is silence
+  memset(buffer + copy_length, 0, static_cast<size_t>(length - copy_length));
+}
+
+const char *WaveInput::data(int offset, int length) const
+{
+  if (!is_open() || offset < 0 || length < 0 || offset + length > mapping_->size) {
+    return nullptr;
+  }
+
+  return mapping_->data + offset;
+}
+
+std::shared_ptr<const void> WaveInput::mapping() const
+{
+  return mapping_;
+}
+
+bool WaveInput::at_end() const
+{
+  return !is_open() || pos_ >= mapping_->size;
+}
+
+const AudioRenderingParams &WaveInput::params() const
+{
+  static const AudioRenderingParams null_params;
+
+  return is_open() ? mapping_->params : null_params;
+}
+
+void WaveInput::close()
+{
+  mapping_ = nullptr;
+  pos_ = 0;
+}
+
+int WaveInput::sample_count() const
+{
+  if (!is_open()) {
+    return 0;
+  }
+
+  return mapping_->params.bytes_to_samples(mapping_->size);
+}
+
+WaveInput::MappingPtr WaveInput::CreateMapping(const QString &filename)
+{
+  MappingPtr mapping = std::make_shared<Mapping>();
+  QFile& file = mapping->file;
+
+  file.setFileName(filename);
+
+  if (!file.open(QFile::ReadOnly)) {
+    return nullptr;
+  }
+
+  // Mappings are shared and kept for a while after they're last used, none can be evicted while they're here
+  mapping->use.Acquire(filename);
+
+  if (file.read(4) != "RIFF") {
+    qDebug() << "No RIFF found";
+    return nullptr;
+  }
+
   // Skip filesize bytes
-  file_.seek(file_.pos() + 4);
+  file.seek(file.pos() + 4);
 
-  if (file_.read(4) != "WAVE") {
-    close();
+  if (file.read(4) != "WAVE") {
     qDebug() << "No WAVE found";
-    return false;
+    return nullptr;
   }
 
   // Find fmt_ section
-  if (!find_str(&file_, "fmt ")) {
-    close();
+  if (!find_str(&file, "fmt ")) {
     qDebug() << "No fmt  found";
-    return false;
+    return nullptr;
   }
 
   // Skip fmt_ section size
-  file_.seek(file_.pos()+4);
+  file.seek(file.pos()+4);
 
   // Create data stream for reading bytes into types
-  QDataStream data_stream(&file_);
+  QDataStream data_stream(&file);
   data_stream.setByteOrder(QDataStream::LittleEndian);
 
   // Read data type
@@ -65,9 +203,8 @@ bool WaveInput::open()
     break;
   default:
     // If it's neither float nor int, we can't work with this file
-    close();
     qDebug() << "Invalid WAV type" << data_type;
-    return false;
+    return nullptr;
   }
 
   // Read number of channels
@@ -80,7 +217,7 @@ bool WaveInput::open()
   data_stream >> sample_rate;
 
   // Skip bytes per second value and bytes per sample value
-  file_.seek(file_.pos() + 6);
+  file.seek(file.pos() + 6);
 
   uint16_t bits_per_sample;
   data_stream >> bits_per_sample;
@@ -110,80 +247,40 @@ bool WaveInput::open()
     break;
   default:
     // We don't know this format...
-    close();
     qDebug() << "Invalid format found" << bits_per_sample;
-    return false;
+    return nullptr;
   }
 
   // We're good to go!
-  params_ = AudioRenderingParams(sample_rate, channel_layout, format);
+  mapping->params = AudioRenderingParams(sample_rate, channel_layout, format);
 
-  if (!find_str(&file_, "data")) {
-    close();
+  if (!find_str(&file, "data")) {
     qDebug() << "No data tag found";
-    return false;
-  }
-
-  data_stream >> data_size_;
-  data_position_ = file_.pos();
-
-  return true;
-}
-
-bool WaveInput::is_open() const
-{
-  return file_.isOpen();
-}
-
-QByteArray WaveInput::read(int length)
-{
-  if (!is_open()) {
-    return QByteArray();
+    return nullptr;
   }
 
-  return file_.read(length);
-}
+  quint32 data_size;
+  data_stream >> data_size;
+  qint64 data_position = file.pos();
 
-QByteArray WaveInput::read(int offset, int length)
-{
-  if (!is_open()) {
-    return QByteArray();
-  }
+  // Trust the file over the header in case it was cut short, and keep whole samples only
+  qint64 available = qMin(static_cast<qint64>(data_size), file.size() - data_position);
+  available = qMin(available, static_cast<qint64>(INT_MAX));
+  available -= available % qMax(1, mapping->params.samples_to_bytes(1));
 
-  file_.seek(offset + data_position_);
-  return file_.read(length);
-}
+  uchar* mapped = file.map(0, file.size());
 
-void WaveInput::read(int offset, char *buffer, int length)
-{
-  if (!is_open()) {
-    return;
+  if (!mapped) {
+    qWarning() << "Failed to map" << filename << file.errorString();
+    return nullptr;
   }
 
-  file_.seek(offset + data_position_);
-  file_.read(buffer, length);
-}
-
-bool WaveInput::at_end() const
-{
-  return file_.atEnd();
-}
-
-const AudioRenderingParams &WaveInput::params() const
-{
-  return params_;
-}
-
-void WaveInput::close()
-{
-  if (file_.isOpen()) {
-    file_.close();
-  }
-}
+  mapping->data = reinterpret_cast<const char*>(mapped) + data_position;
+  mapping->size = static_cast<int>(available);
+  mapping->file_size = file.size();
+  mapping->modified = QFileInfo(filename).lastModified();
 
-int WaveInput::sample_count() const
-{
-  return params_.bytes_to_samples(static_cast<int>(data_size_));
+  return mapping;
 }
 
 bool WaveInput::find_str(QFile *f, const char *str)
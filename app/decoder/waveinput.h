@@ -1,11 +1,22 @@
 #ifndef WAVEINPUT_H
 #define WAVEINPUT_H
 
+#include <memory>
+#include <QDateTime>
 #include <QFile>
+#include <QHash>
+#include <QMutex>
 
 #include "common/constructors.h"
 #include "render/audioparams.h"
-
+#include "render/diskcachemanager.h"
+
+/**
+ * @brief Reads samples from a WAV file
+ *
+ * Files are memory-mapped, and the mapping and parsed header are shared by every WaveInput of the same file, so
+ * reopening a file that's already been read (e.g. for every block of an audio render) doesn't touch the disk again.
+ */
 class WaveInput
 {
 public:
@@ -23,6 +34,16 @@ public:
   QByteArray read(int offset, int length);
   void read(int offset, char *buffer, int length);
 
+  /**
+   * @brief Get a pointer to `length` bytes of sample data starting `offset` bytes in, without copying
+   *
+   * Returns nullptr if the range runs past the end of the data. The data is read-only and stays valid for as long as
+   * a reference to mapping() is held, even after this WaveInput is closed.
+   */
+  const char* data(int offset, int length) const;
+
+  std::shared_ptr<const void> mapping() const;
+
   bool at_end() const;
 
   const AudioRenderingParams& params() const;
@@ -32,15 +53,48 @@ public:
   int sample_count() const;
 
 private:
-  bool find_str(QFile* f, const char* str);
+  struct Mapping {
+    QFile file;
+    DiskCacheManager::FileUse use;
+    const char* data;
+    int size;
+    AudioRenderingParams params;
+    QDateTime modified;
+    qint64 file_size;
+  };
+
+  using MappingPtr = std::shared_ptr<Mapping>;
+
+  /**
+   * @brief Parse and map a WAV file, returns nullptr if it isn't one we can read
+   */
+  static MappingPtr CreateMapping(const QString& filename);
+
+  static bool find_str(QFile* f, const char* str);
+
+  QString filename_;
+
+  MappingPtr mapping_;
+
+  /**
+   * @brief Position of read(int)
+   */
+  int pos_;
+
+  /**
+   * @brief Number of files kept mapped after every WaveInput using them has closed
+   */
+  static const int kMaximumMappings = 64;
 
-  AudioRenderingParams params_;
+  static QMutex mappings_lock_;
 
-  QFile file_;
+  static QHash<QString, MappingPtr> mappings_;
 
-  qint64 data_position_;
+  /**
+   * @brief Filenames in mappings_ in the order they were mapped, oldest first
+   */
+  static QList<QString> mapping_order_;
 
-  quint32 data_size_;
 };
 
 #endif // WAVEINPUT_H
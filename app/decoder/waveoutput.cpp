@@ -21,6 +21,8 @@ bool WaveOutput::open()
   data_length_ = 0;
 
   if (file_.open(QFile::WriteOnly)) {
+    file_use_.Acquire(file_.fileName());
+
     // RIFF header
     file_.write("RIFF");
 
@@ -52,6 +54,7 @@ bool WaveOutput::open()
     case SAMPLE_FMT_COUNT:
       qWarning() << "Invalid sample format for WAVE audio";
       file_.close();
+      file_use_.Release();
       return false;
     }
 
@@ -113,6 +116,8 @@ void WaveOutput::close()
 
     file_.close();
   }
+
+  file_use_.Release();
 }
 
 const AudioRenderingParams &WaveOutput::params() const
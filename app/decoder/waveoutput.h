@@ -7,6 +7,7 @@
 #include "audio/sampleformat.h"
 #include "common/constructors.h"
 #include "render/audioparams.h"
+#include "render/diskcachemanager.h"
 
 class WaveOutput
 {
@@ -35,6 +36,11 @@ private:
 
   QFile file_;
 
+  /**
+   * @brief Keeps the file from being evicted while it's written, if it's a cache file (e.g. an index)
+   */
+  DiskCacheManager::FileUse file_use_;
+
   AudioRenderingParams params_;
 
   int data_length_;
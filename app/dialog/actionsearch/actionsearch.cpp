@@ -20,14 +20,229 @@
 
 #include "actionsearch.h"
 
+#include <algorithm>
+#include <QActionEvent>
 #include <QVBoxLayout>
 #include <QKeyEvent>
 #include <QMenuBar>
 #include <QLabel>
 
+ActionSearchIndex::ActionSearchIndex(QObject *parent) :
+  QObject(parent),
+  menu_bar_(nullptr),
+  rebuild_needed_(false)
+{
+}
+
+void ActionSearchIndex::SetMenuBar(QMenuBar *menu_bar)
+{
+  if (menu_bar_ != nullptr) {
+    menu_bar_->removeEventFilter(this);
+  }
+
+  menu_bar_ = menu_bar;
+
+  if (menu_bar_ != nullptr) {
+    menu_bar_->installEventFilter(this);
+  }
+
+  // Walked the first time it's searched
+  menus_.clear();
+  rebuild_needed_ = true;
+}
+
+bool ActionSearchIndex::eventFilter(QObject *watched, QEvent *event)
+{
+  if (event->type() == QEvent::ActionAdded
+      || event->type() == QEvent::ActionRemoved
+      || event->type() == QEvent::ActionChanged) {
+    QAction* action = static_cast<QActionEvent*>(event)->action();
+
+    if (watched == menu_bar_ || action->menu() != nullptr) {
+      // A menu was added, removed or renamed, which changes the paths of everything in it
+      rebuild_needed_ = true;
+    } else {
+      for (int i=0;i<menus_.size();i++) {
+        if (menus_.at(i).menu == watched) {
+          menus_[i].dirty = true;
+          break;
+        }
+      }
+    }
+  }
+
+  return QObject::eventFilter(watched, event);
+}
+
+QVector<ActionSearchIndex::Result> ActionSearchIndex::Search(const QString &query, int limit)
+{
+  QVector<Result> results;
+
+  if (menu_bar_ == nullptr) {
+    return results;
+  }
+
+  for (int i=0;i<menus_.size() && !rebuild_needed_;i++) {
+    if (menus_.at(i).menu.isNull()) {
+      rebuild_needed_ = true;
+    }
+  }
+
+  if (rebuild_needed_) {
+    Rebuild();
+  }
+
+  QString folded_query = query.toLower();
+
+  for (int i=0;i<menus_.size();i++) {
+    MenuEntries& record = menus_[i];
+
+    if (record.dirty) {
+      ReadMenu(&record);
+    }
+
+    foreach (const Entry& entry, record.entries) {
+      if (entry.action.isNull()) {
+        continue;
+      }
+
+      int score = FuzzyScore(entry.folded, folded_query);
+
+      if (score >= 0) {
+        Result result = {entry.action, entry.text, record.path, score};
+        results.append(result);
+      }
+    }
+  }
+
+  // Stable so equally good matches stay in menu order
+  std::stable_sort(results.begin(), results.end(), ResultIsBetter);
+
+  if (results.size() > limit) {
+    results.resize(limit);
+  }
+
+  return results;
+}
+
+bool ActionSearchIndex::ResultIsBetter(const ActionSearchIndex::Result &a, const ActionSearchIndex::Result &b)
+{
+  return a.score > b.score;
+}
+
+void ActionSearchIndex::Rebuild()
+{
+  // Watch every menu anew, so ones that were removed aren't watched twice if they come back
+  foreach (const MenuEntries& record, menus_) {
+    if (record.menu) {
+      record.menu->removeEventFilter(this);
+    }
+  }
+
+  menus_.clear();
+
+  foreach (QAction* a, menu_bar_->actions()) {
+    if (a->menu() != nullptr) {
+      AddMenu(a->menu(), QString());
+    }
+  }
+
+  rebuild_needed_ = false;
+}
+
+void ActionSearchIndex::AddMenu(QMenu *menu, const QString &parent_path)
+{
+  MenuEntries record;
+
+  record.menu = menu;
+  record.dirty = true;
+
+  // Strip out any &s used in menu names
+  record.path = parent_path;
+  if (!record.path.isEmpty()) {
+    record.path.append(QStringLiteral(" > "));
+  }
+  record.path.append(menu->title().remove('&'));
+
+  menu->installEventFilter(this);
+  menus_.append(record);
+
+  foreach (QAction* a, menu->actions()) {
+    if (a->menu() != nullptr) {
+      AddMenu(a->menu(), record.path);
+    }
+  }
+}
+
+void ActionSearchIndex::ReadMenu(ActionSearchIndex::MenuEntries *record)
+{
+  record->entries.clear();
+  record->dirty = false;
+
+  if (record->menu.isNull()) {
+    return;
+  }
+
+  foreach (QAction* a, record->menu->actions()) {
+    // Ignore separators and submenus, which are indexed on their own
+    if (a->isSeparator() || a->menu() != nullptr) {
+      continue;
+    }
+
+    Entry entry;
+    entry.action = a;
+    entry.text = a->text().remove('&');
+    entry.folded = entry.text.toLower();
+
+    record->entries.append(entry);
+  }
+}
+
+int ActionSearchIndex::FuzzyScore(const QString &folded_text, const QString &folded_query)
+{
+  if (folded_query.isEmpty()) {
+    return 0;
+  }
+
+  int score = 0;
+  int text_index = 0;
+  int last_match = -2;
+
+  foreach (QChar c, folded_query) {
+    text_index = folded_text.indexOf(c, text_index);
+
+    if (text_index < 0) {
+      return -1;
+    }
+
+    score++;
+
+    if (text_index == last_match + 1) {
+      // Runs of the query in one piece are what a user typing part of a name expects to see first
+      score += 4;
+    }
+
+    if (text_index == 0 || !folded_text.at(text_index - 1).isLetterOrNumber()) {
+      score += 3;
+    }
+
+    last_match = text_index;
+    text_index++;
+  }
+
+  // The whole query as it was typed beats the same letters spread out
+  int substring = folded_text.indexOf(folded_query);
+
+  if (substring >= 0) {
+    score += (substring == 0) ? 20 : 10;
+  }
+
+  return score;
+}
+
 ActionSearch::ActionSearch(QWidget *parent) :
   QDialog(parent),
-  menu_bar_(nullptr)
+  index_(nullptr)
 {
   // ActionSearch requires a parent widget
   Q_ASSERT(parent != nullptr);
@@ -82,93 +297,33 @@ ActionSearch::ActionSearch(QWidget *parent) :
   entry_field->setFocus();
 }
 
-void ActionSearch::SetMenuBar(QMenuBar *menu_bar)
+void ActionSearch::SetIndex(ActionSearchIndex *index)
 {
-  menu_bar_ = menu_bar;
+  index_ = index;
 }
 
-void ActionSearch::search_update(const QString &s, const QString &p, QMenu *parent)
+void ActionSearch::search_update(const QString &s)
 {
-  // Do nothing if there's no menu bar to work with
-  if (menu_bar_ == nullptr) {
+  // Do nothing if there's no index to search
+  if (index_ == nullptr) {
     return;
   }
 
-  // This function is recursive, using the `parent` parameter to loop through a menu's items. It functions in two
-  // modes - the parent being NULL, meaning it'll get MainWindow's menubar and loop over its menus, and the parent
-  // referring to a menu at which point it'll loop over its actions (and call itself recursively if it finds any
-  // submenus).
-
-  if (parent == nullptr) {
-
-    // If parent is NULL, we'll pull from the MainWindow's menubar and call this recursively on all of its submenus
-    // (and their submenus).
-
-    // We'll clear all the current items in the list since if we're here, we're just starting.
-    list_widget->clear();
-
-    QList<QAction*> menus = menu_bar_->actions();
-
-    // Loop through all menus from the menubar and run this function on each one.
-    for (int i=0;i<menus.size();i++) {
-      QMenu* menu = menus.at(i)->menu();
-
-      search_update(s, p, menu);
-    }
-
-    // Once we're here, all the recursion/item retrieval is complete. We auto-select the first item for better
-    // keyboard-exclusive functionality.
-    if (list_widget->count() > 0) {
-      list_widget->item(0)->setSelected(true);
-    }
-
-  } else {
-
-    // Parent was not NULL, so we loop over the actions in the menu we were given in `parent`.
+  list_widget->clear();
 
-    // The list shows a '>' delimited hierarchy of the menus in which this action came from. We construct it here by
-    // adding the current menu's text to the existing hierarchy (passed in `p`).
-    QString menu_text;
-    if (!p.isEmpty()) menu_text += p + " > ";
-    menu_text += parent->title().replace("&", ""); // Strip out any &s used in menu action names
+  foreach (const ActionSearchIndex::Result& result, index_->Search(s, kMaximumResults)) {
+    // The list shows the menus the action came from below it
+    QListWidgetItem* item = new QListWidgetItem(QString("%1\n(%2)").arg(result.text, result.path), list_widget);
 
-    // Loop over the menu's actions
-    QList<QAction*> actions = parent->actions();
-    for (int i=0;i<actions.size();i++) {
+    // Add a pointer to the original QAction in the item's data
+    item->setData(Qt::UserRole+1, reinterpret_cast<quintptr>(result.action));
 
-      QAction* a = actions.at(i);
-
-      // Ignore separator actions
-      if (!a->isSeparator()) {
-
-        if (a->menu() != nullptr) {
-
-          // If the action is a menu, run this function recursively on it
-          search_update(s, menu_text, a->menu());
-
-        } else {
-
-          // This is a valid non-separator non-menu action, so check it against the currently entered string.
-
-          // Strip out all &s from the action's name
-          QString comp = a->text().replace("&", "");
-
-          // See if the action's name contains any of the currently entered string
-          if (comp.contains(s, Qt::CaseInsensitive)) {
-
-            // If so, we add it to the list widget.
-            QListWidgetItem* item = new QListWidgetItem(QString("%1\n(%2)").arg(comp, menu_text), list_widget);
-
-            // Add a pointer to the original QAction in the item's data
-            item->setData(Qt::UserRole+1, reinterpret_cast<quintptr>(a));
-
-            list_widget->addItem(item);
-
-          }
+    list_widget->addItem(item);
+  }
 
-        }
-      }
-    }
+  // Auto-select the first item for better keyboard-exclusive functionality
+  if (list_widget->count() > 0) {
+    list_widget->item(0)->setSelected(true);
   }
 }
 
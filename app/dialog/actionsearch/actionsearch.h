@@ -22,13 +22,105 @@
 #define ACTIONSEARCH_H
 
 #include <QDialog>
+#include <QHash>
 #include <QLineEdit>
 #include <QListWidget>
 #include <QMenu>
 #include <QMenuBar>
+#include <QPointer>
 
 class ActionSearchList;
 
+/**
+ * @brief A searchable list of every action in a menu bar, kept up to date as the menus change
+ *
+ * The menus are walked once. After that, only a menu whose actions have been added, removed or changed (e.g. when
+ * they're retranslated) is read again, and only when it's next searched, so searching on every keystroke only
+ * compares strings.
+ */
+class ActionSearchIndex : public QObject
+{
+  Q_OBJECT
+public:
+  ActionSearchIndex(QObject* parent = nullptr);
+
+  /**
+   * @brief Set the menu bar whose actions are indexed
+   */
+  void SetMenuBar(QMenuBar* menu_bar);
+
+  struct Result {
+    QAction* action;
+
+    /// Action text without mnemonics
+    QString text;
+
+    /// '>' delimited hierarchy of the menus the action is in
+    QString path;
+
+    int score;
+  };
+
+  /**
+   * @brief Find the actions that fuzzy match `query`, best match first
+   *
+   * An action matches if every character of the query appears in its text in order. Matches score higher the more of
+   * the query appears in one run and at the start of words. An empty query matches everything in menu order.
+   */
+  QVector<Result> Search(const QString& query, int limit);
+
+protected:
+  /**
+   * @brief Watches the indexed menus for actions being added, removed or changed
+   */
+  virtual bool eventFilter(QObject* watched, QEvent* event) override;
+
+private:
+  struct Entry {
+    QPointer<QAction> action;
+    QString text;
+
+    /// `text` in lowercase, what's matched against
+    QString folded;
+  };
+
+  struct MenuEntries {
+    QPointer<QMenu> menu;
+    QString path;
+    QVector<Entry> entries;
+    bool dirty;
+  };
+
+  /**
+   * @brief Walk the whole menu bar again, called when menus themselves are added, removed or renamed
+   */
+  void Rebuild();
+
+  void AddMenu(QMenu* menu, const QString& parent_path);
+
+  /**
+   * @brief Read a menu's actions (not its submenus, they have entries of their own)
+   */
+  static void ReadMenu(MenuEntries* record);
+
+  /**
+   * @brief Returns how well `folded_query` fuzzy matches `folded_text`, or -1 if it doesn't
+   */
+  static int FuzzyScore(const QString& folded_text, const QString& folded_query);
+
+  static bool ResultIsBetter(const Result& a, const Result& b);
+
+  QMenuBar* menu_bar_;
+
+  /**
+   * @brief Every menu in the menu bar, in the order they appear
+   */
+  QVector<MenuEntries> menus_;
+
+  bool rebuild_needed_;
+
+};
+
 /**
  * @brief The ActionSearch class
  *
@@ -51,34 +143,20 @@ public:
   ActionSearch(QWidget* parent);
 
   /**
-   * @brief Set the menu bar to use in this action search
+   * @brief Set the index of the menu bar to search in (owned by the caller, usually the menu bar)
    */
-  void SetMenuBar(QMenuBar* menu_bar);
+  void SetIndex(ActionSearchIndex* index);
 private slots:
   /**
    * @brief Update the list of actions according to a search query
    *
-   * This function adds/removes actions in the action list according to a given search query entered by the user.
-   *
-   * To loop over the menubar and all of its menus and submenus, this function will call itself recursively. As such
-   * some of its parameters do not need to be set externally, as these will be set by the function itself as it calls
-   * itself.
+   * Shows the best kMaximumResults matches from the index for the search text entered by the user.
    *
    * @param s
    *
-   * The search text. This is the only parameter that should be set externally.
-   *
-   * @param p
-   *
-   * The current parent hierarchy. In most cases, this should be left as nullptr when called externally.
-   * search_update() will fill this automatically as it needs while calling itself recursively.
-   *
-   * @param parent
-   *
-   * The current menu to loop over. In most cases, this should be left as nullptr when called externally.
-   * search_update() will fill this automatically as it needs while calling itself recursively.
+   * The search text.
    */
-  void search_update(const QString& s, const QString &p = nullptr, QMenu *parent = nullptr);
+  void search_update(const QString& s);
 
   /**
    * @brief Perform the currently selected action
@@ -111,9 +189,14 @@ private:
   ActionSearchList* list_widget;
 
   /**
-   * @brief Attached menu bar object
+   * @brief Attached index of the menu bar
    */
-  QMenuBar* menu_bar_;
+  ActionSearchIndex* index_;
+
+  /**
+   * @brief Most matches shown at once, more wouldn't be read and only slow down each keystroke
+   */
+  static const int kMaximumResults = 50;
 };
 
 /**
@@ -5,6 +5,8 @@
 #include <QLabel>
 #include <QPushButton>
 
+#include "core.h"
+
 PreferencesAppearanceTab::PreferencesAppearanceTab()
 {
   QVBoxLayout* layout = new QVBoxLayout(this);
@@ -34,6 +36,12 @@ PreferencesAppearanceTab::PreferencesAppearanceTab()
 
   row++;
 
+  timeline_opengl_ = new QCheckBox(tr("Draw timelines with OpenGL"));
+  timeline_opengl_->setChecked(Config::Current()["TimelineOpenGL"].toBool());
+  appearance_layout->addWidget(timeline_opengl_, row, 0, 1, 3);
+
+  row++;
+
   layout->addStretch();
 }
 
@@ -43,6 +51,8 @@ void PreferencesAppearanceTab::Accept()
   StyleManager::SetStyle(style_path);
   Config::Current()["Style"] = style_path;
 
+  olive::core.SetTimelineOpenGL(timeline_opengl_->isChecked());
+
   if (style_->currentIndex() < style_list_.size()) {
     // This is an internal style, set accordingly
 
@@ -1,6 +1,7 @@
 #ifndef PREFERENCESAPPEARANCETAB_H
 #define PREFERENCESAPPEARANCETAB_H
 
+#include <QCheckBox>
 #include <QComboBox>
 #include <QLineEdit>
 
@@ -31,6 +32,11 @@ private:
    */
   QList<StyleDescriptor> style_list_;
 
+  /**
+   * @brief UI widget for drawing timelines through OpenGL rather than the raster engine
+   */
+  QCheckBox* timeline_opengl_;
+
   QString custom_style_path_;
 };
 
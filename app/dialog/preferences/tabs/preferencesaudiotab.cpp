@@ -60,6 +60,37 @@ PreferencesAudioTab::PreferencesAudioTab() :
 
   row++;
 
+  // Audio -> Low Latency Output
+  low_latency_checkbox_ = new QCheckBox(tr("Use low-latency output"));
+  low_latency_checkbox_->setChecked(Config::Current()["LowLatencyAudio"].toBool());
+  audio_tab_layout->addWidget(low_latency_checkbox_, row, 1);
+
+  row++;
+
+  // Audio -> Buffer Size
+  QLabel* buffer_size_label = new QLabel(tr("Buffer Size:"));
+  audio_tab_layout->addWidget(buffer_size_label, row, 0);
+
+  buffer_size_spinbox_ = new QSpinBox();
+  buffer_size_spinbox_->setMinimum(0);
+  buffer_size_spinbox_->setMaximum(8192);
+  buffer_size_spinbox_->setSingleStep(64);
+  buffer_size_spinbox_->setSuffix(tr(" samples"));
+  buffer_size_spinbox_->setSpecialValueText(tr("Automatic"));
+  buffer_size_spinbox_->setToolTip(tr("Smaller buffers make playback respond sooner, but may crackle if the system "
+                                      "can't keep up"));
+  buffer_size_spinbox_->setValue(Config::Current()["AudioBufferSize"].toInt());
+  audio_tab_layout->addWidget(buffer_size_spinbox_, row, 1);
+
+  row++;
+
+#ifndef OLIVE_PORTAUDIO
+  // This build has no low-latency output to use
+  low_latency_checkbox_->setVisible(false);
+  buffer_size_label->setVisible(false);
+  buffer_size_spinbox_->setVisible(false);
+#endif
+
   QPushButton* refresh_devices = new QPushButton(tr("Refresh Devices"));
   audio_tab_layout->addWidget(refresh_devices, row, 1);
 
@@ -73,6 +104,9 @@ PreferencesAudioTab::PreferencesAudioTab() :
 
 void PreferencesAudioTab::Accept()
 {
+  Config::Current()["LowLatencyAudio"] = low_latency_checkbox_->isChecked();
+  Config::Current()["AudioBufferSize"] = buffer_size_spinbox_->value();
+
   // If we don't have the device list, we can't set it
   if (!has_devices_) {
     return;
@@ -1,7 +1,9 @@
 #ifndef PREFERENCESAUDIOTAB_H
 #define PREFERENCESAUDIOTAB_H
 
+#include <QCheckBox>
 #include <QComboBox>
+#include <QSpinBox>
 
 #include "preferencestab.h"
 
@@ -34,6 +36,16 @@ private:
    */
   QComboBox* recordingComboBox;
 
+  /**
+   * @brief UI widget for using the low-latency output (only shown if it was built in)
+   */
+  QCheckBox* low_latency_checkbox_;
+
+  /**
+   * @brief UI widget for editing the low-latency output's buffer size
+   */
+  QSpinBox* buffer_size_spinbox_;
+
 private slots:
   void RefreshDevices();
 
@@ -6,6 +6,8 @@
 #include <QCheckBox>
 #include <QPushButton>
 
+#include "config/config.h"
+
 PreferencesGeneralTab::PreferencesGeneralTab()
 {
   QVBoxLayout* layout = new QVBoxLayout(this);
@@ -61,6 +63,8 @@ PreferencesGeneralTab::PreferencesGeneralTab()
   thumbnail_res_spinbox = new QSpinBox(this);
   thumbnail_res_spinbox->setMinimum(0);
   thumbnail_res_spinbox->setMaximum(INT_MAX);
+  thumbnail_res_spinbox->setSpecialValueText(tr("Off"));
+  thumbnail_res_spinbox->setValue(Config::Current()["ThumbnailResolution"].toInt());
   general_layout->addWidget(thumbnail_res_spinbox, row, 1);
 
   row++;
@@ -74,6 +78,13 @@ PreferencesGeneralTab::PreferencesGeneralTab()
 
   row++;
 
+  // General -> Image Sequences
+  import_sequences_checkbox = new QCheckBox(tr("Import Numbered Images as Sequences"), this);
+  import_sequences_checkbox->setChecked(Config::Current()["ImportImageSequences"].toBool());
+  general_layout->addWidget(import_sequences_checkbox, row, 0, 1, 2);
+
+  row++;
+
   QPushButton* delete_preview_btn = new QPushButton(tr("Delete Previews"));
   general_layout->addWidget(delete_preview_btn, row, 1);
   //connect(delete_preview_btn, SIGNAL(clicked(bool)), this, SLOT(delete_all_previews()));
@@ -95,7 +106,11 @@ PreferencesGeneralTab::PreferencesGeneralTab()
 
 void PreferencesGeneralTab::Accept()
 {
+  // NOTE: Thumbnails at the old resolution are regenerated as they're next drawn
+  Config::Current()["ThumbnailResolution"] = thumbnail_res_spinbox->value();
 
+  // NOTE: Only affects footage imported from now on
+  Config::Current()["ImportImageSequences"] = import_sequences_checkbox->isChecked();
 }
 
 void PreferencesGeneralTab::edit_default_sequence_settings()
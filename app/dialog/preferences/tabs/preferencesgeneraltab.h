@@ -1,6 +1,7 @@
 #ifndef PREFERENCESGENERALTAB_H
 #define PREFERENCESGENERALTAB_H
 
+#include <QCheckBox>
 #include <QComboBox>
 #include <QSpinBox>
 
@@ -36,6 +37,11 @@ private:
    */
   QSpinBox* waveform_res_spinbox;
 
+  /**
+   * @brief UI widget for whether numbered images are imported as sequences
+   */
+  QCheckBox* import_sequences_checkbox;
+
 };
 
 #endif // PREFERENCESGENERALTAB_H
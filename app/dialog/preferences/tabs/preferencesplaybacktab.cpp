@@ -1,14 +1,342 @@
 #include "preferencesplaybacktab.h"
 
+#include <QGridLayout>
 #include <QGroupBox>
+#include <QGuiApplication>
 #include <QLabel>
+#include <QScreen>
 #include <QVBoxLayout>
 
+extern "C" {
+#include <libavutil/hwcontext.h>
+}
+
+#include "common/memorybudget.h"
+#include "config/config.h"
+#include "render/backend/opengl/openglmemorybudget.h"
+#include "render/backend/videorenderframecache.h"
+#include "render/pixelformat.h"
+#include "render/diskcachemanager.h"
+#include "render/interactivitymonitor.h"
+#include "render/renderbudget.h"
+#include "task/taskmanager.h"
+
 PreferencesPlaybackTab::PreferencesPlaybackTab()
 {
+  QVBoxLayout* layout = new QVBoxLayout(this);
+  layout->setMargin(0);
+
+  QGroupBox* decoding_groupbox = new QGroupBox(tr("Decoding"));
+  layout->addWidget(decoding_groupbox);
+
+  QGridLayout* decoding_layout = new QGridLayout(decoding_groupbox);
+
+  int row = 0;
+
+  // Playback -> Hardware Decoding
+  decoding_layout->addWidget(new QLabel(tr("Hardware Decoding:")), row, 0);
+
+  hardware_decoding_combobox_ = new QComboBox();
+
+  // Index 0 is always software decoding
+  hardware_decoding_combobox_->addItem(tr("None"), QString());
+
+  QString current_device = Config::Current()["HardwareDecoding"].toString();
+
+  // List every device type this build of FFmpeg supports
+  AVHWDeviceType type = AV_HWDEVICE_TYPE_NONE;
+  while ((type = av_hwdevice_iterate_types(type)) != AV_HWDEVICE_TYPE_NONE) {
+    QString device_name = av_hwdevice_get_type_name(type);
+
+    hardware_decoding_combobox_->addItem(device_name, device_name);
+
+    if (device_name == current_device) {
+      hardware_decoding_combobox_->setCurrentIndex(hardware_decoding_combobox_->count() - 1);
+    }
+  }
+
+  decoding_layout->addWidget(hardware_decoding_combobox_, row, 1);
+
+  QGroupBox* cache_groupbox = new QGroupBox(tr("Cache"));
+  layout->addWidget(cache_groupbox);
+
+  QGridLayout* cache_layout = new QGridLayout(cache_groupbox);
+
+  row = 0;
+
+  // Playback -> Memory Cache Size
+  cache_layout->addWidget(new QLabel(tr("Memory Cache Size:")), row, 0);
+
+  memory_cache_spinbox_ = new QSpinBox();
+  memory_cache_spinbox_->setMinimum(0);
+  memory_cache_spinbox_->setMaximum(INT_MAX);
+  memory_cache_spinbox_->setSuffix(tr(" MB"));
+  memory_cache_spinbox_->setValue(Config::Current()["MemoryCacheSize"].toInt());
+  cache_layout->addWidget(memory_cache_spinbox_, row, 1);
+
+  row++;
+
+  // Playback -> Compressed Memory Cache
+  compressed_memory_checkbox_ = new QCheckBox(tr("Compress frames in memory on the GPU"));
+  compressed_memory_checkbox_->setToolTip(tr("Fits 4-8x more frames in the memory cache at a slight loss of quality. "
+                                             "Alpha isn't kept for half-float and float frames."));
+  compressed_memory_checkbox_->setChecked(Config::Current()["CompressedMemoryCache"].toBool());
+  cache_layout->addWidget(compressed_memory_checkbox_, row, 0, 1, 2);
+
+  row++;
+
+  // Playback -> Memory Limit
+  cache_layout->addWidget(new QLabel(tr("Memory Limit:")), row, 0);
+
+  memory_limit_spinbox_ = new QSpinBox();
+  memory_limit_spinbox_->setMinimum(0);
+  memory_limit_spinbox_->setMaximum(INT_MAX);
+  memory_limit_spinbox_->setSingleStep(1024);
+  memory_limit_spinbox_->setSuffix(tr(" MB"));
+  memory_limit_spinbox_->setSpecialValueText(tr("Half of System Memory"));
+  memory_limit_spinbox_->setToolTip(tr("When frames, caches and undo history near this, caches are emptied until "
+                                       "they're comfortably under it"));
+  memory_limit_spinbox_->setValue(Config::Current()["MemoryLimit"].toInt());
+  cache_layout->addWidget(memory_limit_spinbox_, row, 1);
+
+  row++;
+
+  // Playback -> Disk Cache Size
+  cache_layout->addWidget(new QLabel(tr("Disk Cache Size:")), row, 0);
+
+  disk_cache_spinbox_ = new QSpinBox();
+  disk_cache_spinbox_->setMinimum(0);
+  disk_cache_spinbox_->setMaximum(INT_MAX);
+  disk_cache_spinbox_->setSuffix(tr(" MB"));
+  disk_cache_spinbox_->setSpecialValueText(tr("Unlimited"));
+  disk_cache_spinbox_->setValue(Config::Current()["DiskCacheSize"].toInt());
+  cache_layout->addWidget(disk_cache_spinbox_, row, 1);
+
+  row++;
+
+  // Playback -> Conformed Audio Limit
+  cache_layout->addWidget(new QLabel(tr("Conformed Audio Limit:")), row, 0);
+
+  conform_cache_spinbox_ = new QSpinBox();
+  conform_cache_spinbox_->setMinimum(0);
+  conform_cache_spinbox_->setMaximum(INT_MAX);
+  conform_cache_spinbox_->setSuffix(tr(" MB"));
+  conform_cache_spinbox_->setSpecialValueText(tr("Same as disk cache"));
+  conform_cache_spinbox_->setToolTip(tr("How much of the disk cache audio resampled to the sequence's sample rate may "
+                                        "use"));
+  conform_cache_spinbox_->setValue(Config::Current()["ConformCacheSize"].toInt());
+  cache_layout->addWidget(conform_cache_spinbox_, row, 1);
+
+  row++;
+
+  // Playback -> Disk Cache Format
+  cache_layout->addWidget(new QLabel(tr("Disk Cache Format:")), row, 0);
+
+  cache_codec_combobox_ = new QComboBox();
+  cache_codec_combobox_->addItem(tr("EXR (DWAA)"), VideoRenderFrameCache::kCodecDWAA);
+  cache_codec_combobox_->addItem(tr("EXR (PIZ)"), VideoRenderFrameCache::kCodecPIZ);
+  cache_codec_combobox_->addItem(tr("EXR (Uncompressed)"), VideoRenderFrameCache::kCodecUncompressed);
+  cache_codec_combobox_->addItem(tr("Raw"), VideoRenderFrameCache::kCodecRaw);
+  cache_codec_combobox_->setCurrentIndex(cache_codec_combobox_->findData(Config::Current()["CacheCodec"].toInt()));
+  cache_layout->addWidget(cache_codec_combobox_, row, 1);
+
+  row++;
+
+  // Playback -> Preview Cache Precision
+  cache_layout->addWidget(new QLabel(tr("Preview Cache Precision:")), row, 0);
+
+  offline_format_combobox_ = CreateFormatComboBox(QStringLiteral("OfflineCacheFormat"));
+  offline_format_combobox_->setToolTip(tr("8-bit halves the size of the cache but may show banding in gradients. "
+                                          "8-bit and 16-bit integer frames are always stored raw."));
+  cache_layout->addWidget(offline_format_combobox_, row, 1);
+
+  row++;
+
+  // Playback -> Online Cache Precision
+  cache_layout->addWidget(new QLabel(tr("Online Cache Precision:")), row, 0);
+
+  online_format_combobox_ = CreateFormatComboBox(QStringLiteral("OnlineCacheFormat"));
+  cache_layout->addWidget(online_format_combobox_, row, 1);
+
+  row++;
+
+  // Playback -> Shared Cache Folder
+  cache_layout->addWidget(new QLabel(tr("Shared Cache Folder:")), row, 0);
+
+  shared_cache_edit_ = new QLineEdit();
+  shared_cache_edit_->setPlaceholderText(tr("None"));
+  shared_cache_edit_->setText(Config::Current()["SharedCachePath"].toString());
+  cache_layout->addWidget(shared_cache_edit_, row, 1);
+
+  QGroupBox* rendering_groupbox = new QGroupBox(tr("Rendering"));
+  layout->addWidget(rendering_groupbox);
+
+  QGridLayout* rendering_layout = new QGridLayout(rendering_groupbox);
+
+  row = 0;
+
+  // Playback -> Render Threads
+  rendering_layout->addWidget(new QLabel(tr("Render Threads:")), row, 0);
+
+  render_threads_spinbox_ = new QSpinBox();
+  render_threads_spinbox_->setMinimum(0);
+  render_threads_spinbox_->setMaximum(256);
+  render_threads_spinbox_->setSpecialValueText(tr("Automatic"));
+  render_threads_spinbox_->setValue(Config::Current()["RenderThreadCount"].toInt());
+  rendering_layout->addWidget(render_threads_spinbox_, row, 1);
+
+  row++;
+
+  // Playback -> GPU Contexts
+  rendering_layout->addWidget(new QLabel(tr("GPU Contexts:")), row, 0);
+
+  gpu_contexts_spinbox_ = new QSpinBox();
+  gpu_contexts_spinbox_->setMinimum(0);
+  gpu_contexts_spinbox_->setMaximum(256);
+  gpu_contexts_spinbox_->setSpecialValueText(tr("Same as Render Threads"));
+  gpu_contexts_spinbox_->setValue(Config::Current()["RenderGPUContextCount"].toInt());
+  rendering_layout->addWidget(gpu_contexts_spinbox_, row, 1);
+
+  row++;
+
+  // Playback -> GPU Memory Budget
+  rendering_layout->addWidget(new QLabel(tr("GPU Memory Budget:")), row, 0);
+
+  gpu_memory_spinbox_ = new QSpinBox();
+  gpu_memory_spinbox_->setMinimum(0);
+  gpu_memory_spinbox_->setMaximum(262144);
+  gpu_memory_spinbox_->setSingleStep(256);
+  gpu_memory_spinbox_->setSuffix(tr(" MB"));
+  gpu_memory_spinbox_->setSpecialValueText(tr("Automatic"));
+  gpu_memory_spinbox_->setToolTip(tr("Past this, unused textures are freed, fewer workers are started and playback "
+                                     "lowers the preview quality"));
+  gpu_memory_spinbox_->setValue(Config::Current()["GPUMemoryBudget"].toInt());
+  rendering_layout->addWidget(gpu_memory_spinbox_, row, 1);
+
+  row++;
+
+  // Playback -> Extra GPU Screens
+  rendering_layout->addWidget(new QLabel(tr("Also Render On Screens:")), row, 0);
+
+  QStringList screen_names;
+
+  foreach (QScreen* screen, QGuiApplication::screens()) {
+    screen_names.append(screen->name());
+  }
+
+  gpu_screens_edit_ = new QLineEdit();
+  gpu_screens_edit_->setPlaceholderText(tr("None"));
+  gpu_screens_edit_->setToolTip(tr("Comma-separated names of screens driven by other GPUs to render with as well "
+                                   "(available: %1)").arg(screen_names.join(", ")));
+  gpu_screens_edit_->setText(Config::Current()["RenderGPUScreens"].toString());
+  rendering_layout->addWidget(gpu_screens_edit_, row, 1);
+
+  row++;
+
+  // Playback -> Tile Size
+  rendering_layout->addWidget(new QLabel(tr("Tile Size:")), row, 0);
+
+  tile_size_spinbox_ = new QSpinBox();
+  tile_size_spinbox_->setMinimum(0);
+  tile_size_spinbox_->setMaximum(65536);
+  tile_size_spinbox_->setSingleStep(256);
+  tile_size_spinbox_->setSuffix(tr(" px"));
+  tile_size_spinbox_->setSpecialValueText(tr("GPU Limit"));
+  tile_size_spinbox_->setToolTip(tr("Frames larger than this are rendered in tiles, which uses less GPU memory"));
+  tile_size_spinbox_->setValue(Config::Current()["RenderTileSize"].toInt());
+  rendering_layout->addWidget(tile_size_spinbox_, row, 1);
+
+  row++;
+
+  // Playback -> Background Rendering While Working
+  rendering_layout->addWidget(new QLabel(tr("Background Rendering While Working:")), row, 0);
+
+  interactive_render_spinbox_ = new QSpinBox();
+  interactive_render_spinbox_->setMinimum(0);
+  interactive_render_spinbox_->setMaximum(100);
+  interactive_render_spinbox_->setSingleStep(5);
+  interactive_render_spinbox_->setSuffix(tr("%"));
+  interactive_render_spinbox_->setSpecialValueText(tr("Paused"));
+  interactive_render_spinbox_->setToolTip(tr("Share of the render threads that caching for the viewers may use while "
+                                             "you're editing"));
+  interactive_render_spinbox_->setValue(Config::Current()["InteractiveRenderPercent"].toInt());
+  rendering_layout->addWidget(interactive_render_spinbox_, row, 1);
+
+  row++;
+
+  // Playback -> Pause On Battery
+  pause_on_battery_checkbox_ = new QCheckBox(tr("Pause background rendering while running on battery"));
+  pause_on_battery_checkbox_->setChecked(Config::Current()["PauseRenderOnBattery"].toBool());
+  rendering_layout->addWidget(pause_on_battery_checkbox_, row, 0, 1, 2);
+
+  row++;
+
+  // Playback -> Adaptive Playback
+  adaptive_playback_checkbox_ = new QCheckBox(tr("Lower the preview quality while playback can't keep up"));
+  adaptive_playback_checkbox_->setChecked(Config::Current()["AdaptivePlayback"].toBool());
+  rendering_layout->addWidget(adaptive_playback_checkbox_, row, 0, 1, 2);
+
+  layout->addStretch();
 }
 
 void PreferencesPlaybackTab::Accept()
 {
+  // NOTE: Only footage opened after this will use the new setting
+  Config::Current()["HardwareDecoding"] = hardware_decoding_combobox_->currentData().toString();
+
+  // NOTE: Takes effect the next time the renderer starts
+  Config::Current()["MemoryCacheSize"] = memory_cache_spinbox_->value();
+  Config::Current()["CompressedMemoryCache"] = compressed_memory_checkbox_->isChecked();
+  Config::Current()["CacheCodec"] = cache_codec_combobox_->currentData().toInt();
+
+  // NOTE: Only viewers connected after this will use the new setting
+  Config::Current()["OfflineCacheFormat"] = offline_format_combobox_->currentData().toInt();
+  Config::Current()["OnlineCacheFormat"] = online_format_combobox_->currentData().toInt();
+  Config::Current()["SharedCachePath"] = shared_cache_edit_->text().trimmed();
+  Config::Current()["RenderGPUScreens"] = gpu_screens_edit_->text().trimmed();
+  Config::Current()["RenderTileSize"] = tile_size_spinbox_->value();
+
+  // Takes effect the next time playback starts
+  Config::Current()["AdaptivePlayback"] = adaptive_playback_checkbox_->isChecked();
+
+  // Takes effect from the next allocation
+  Config::Current()["MemoryLimit"] = memory_limit_spinbox_->value();
+  MemoryBudget::SetLimit(Config::Current()["MemoryLimit"].toLongLong() * 1024 * 1024);
+
+  // Takes effect immediately, anything over the new quota is evicted straight away
+  Config::Current()["DiskCacheSize"] = disk_cache_spinbox_->value();
+  DiskCacheManager::instance()->SetQuota(Config::Current()["DiskCacheSize"].toLongLong() * 1024 * 1024);
+
+  Config::Current()["ConformCacheSize"] = conform_cache_spinbox_->value();
+  DiskCacheManager::instance()->SetConformQuota(Config::Current()["ConformCacheSize"].toLongLong() * 1024 * 1024);
+
+  // Running jobs are limited straight away, though backends only start fewer workers the next time they start
+  Config::Current()["RenderThreadCount"] = render_threads_spinbox_->value();
+  Config::Current()["RenderGPUContextCount"] = gpu_contexts_spinbox_->value();
+  RenderBudget::SetThreadCount(render_threads_spinbox_->value());
+  RenderBudget::SetGPUContextCount(gpu_contexts_spinbox_->value());
+  olive::task_manager.SetMaximumTaskCount(Task::kCPUBound, RenderBudget::ThreadCount());
+
+  // Takes effect immediately
+  Config::Current()["InteractiveRenderPercent"] = interactive_render_spinbox_->value();
+  Config::Current()["PauseRenderOnBattery"] = pause_on_battery_checkbox_->isChecked();
+  InteractivityMonitor::instance()->UpdateFromConfig();
+
+  // Textures already allocated are checked against the new budget from their next allocation on
+  Config::Current()["GPUMemoryBudget"] = gpu_memory_spinbox_->value();
+  OpenGLMemoryBudget::SetBudget(Config::Current()["GPUMemoryBudget"].toLongLong() * 1024 * 1024);
+}
+
+QComboBox *PreferencesPlaybackTab::CreateFormatComboBox(const QString &config_key)
+{
+  QComboBox* combobox = new QComboBox();
+
+  combobox->addItem(tr("8-bit"), olive::PIX_FMT_RGBA8);
+  combobox->addItem(tr("16-bit Integer"), olive::PIX_FMT_RGBA16U);
+  combobox->addItem(tr("Half-Float (16-bit)"), olive::PIX_FMT_RGBA16F);
+  combobox->addItem(tr("Float (32-bit)"), olive::PIX_FMT_RGBA32F);
+
+  combobox->setCurrentIndex(combobox->findData(Config::Current()[config_key].toInt()));
 
+  return combobox;
 }
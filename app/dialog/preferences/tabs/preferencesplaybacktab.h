@@ -1,8 +1,11 @@
 #ifndef PREFERENCESPLAYBACKTAB_H
 #define PREFERENCESPLAYBACKTAB_H
 
+#include <QCheckBox>
 #include <QComboBox>
 #include <QDoubleSpinBox>
+#include <QLineEdit>
+#include <QSpinBox>
 
 #include "preferencestab.h"
 
@@ -15,6 +18,93 @@ public:
   virtual void Accept() override;
 
 private:
+  /**
+   * @brief UI widget for selecting the hardware device to decode video with (or none for software decoding)
+   */
+  QComboBox* hardware_decoding_combobox_;
+
+  /**
+   * @brief UI widget for selecting how much memory rendered frames may use before falling back to the disk cache
+   */
+  QSpinBox* memory_cache_spinbox_;
+
+  /**
+   * @brief UI widget for keeping frames in the memory cache block-compressed
+   */
+  QCheckBox* compressed_memory_checkbox_;
+
+  /**
+   * @brief UI widget for setting how much memory the process should hold before caches are emptied (0 for half of it)
+   */
+  QSpinBox* memory_limit_spinbox_;
+
+  /**
+   * @brief UI widget for selecting how much disk space cached frames, indexes and thumbnails may use
+   */
+  QSpinBox* disk_cache_spinbox_;
+
+  /**
+   * @brief UI widget for selecting how much of the disk cache conformed audio may use
+   */
+  QSpinBox* conform_cache_spinbox_;
+
+  /**
+   * @brief UI widget for selecting the format rendered frames are stored in on disk
+   */
+  QComboBox* cache_codec_combobox_;
+
+  /**
+   * @brief UI widgets for selecting the precision frames are cached at in each render mode
+   */
+  QComboBox* offline_format_combobox_;
+  QComboBox* online_format_combobox_;
+
+  static QComboBox* CreateFormatComboBox(const QString& config_key);
+
+  /**
+   * @brief UI widget for setting a folder that cached frames are shared with other workstations through
+   */
+  QLineEdit* shared_cache_edit_;
+
+  /**
+   * @brief UI widget for selecting how many render jobs run at once across every viewer (0 for one per CPU core)
+   */
+  QSpinBox* render_threads_spinbox_;
+
+  /**
+   * @brief UI widget for selecting how many GPU contexts render at once (0 for the same as the render threads)
+   */
+  QSpinBox* gpu_contexts_spinbox_;
+
+  /**
+   * @brief UI widget for setting how much GPU memory textures may use in MB (0 for a share of the GPU's memory)
+   */
+  QSpinBox* gpu_memory_spinbox_;
+
+  /**
+   * @brief UI widget for setting which screens' GPUs render as well as the viewer's
+   */
+  QLineEdit* gpu_screens_edit_;
+
+  /**
+   * @brief UI widget for setting the largest tile frames are rendered in (0 for the GPU's texture size limit)
+   */
+  QSpinBox* tile_size_spinbox_;
+
+  /**
+   * @brief UI widget for setting the percentage of render slots viewer caching may use while the user is working
+   */
+  QSpinBox* interactive_render_spinbox_;
+
+  /**
+   * @brief UI widget for setting whether viewer caching pauses while running on battery
+   */
+  QCheckBox* pause_on_battery_checkbox_;
+
+  /**
+   * @brief UI widget for setting whether playback lowers the preview quality when rendering can't keep up
+   */
+  QCheckBox* adaptive_playback_checkbox_;
 };
 
 #endif // PREFERENCESPLAYBACKTAB_H
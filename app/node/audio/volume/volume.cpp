@@ -0,0 +1,112 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "volume.h"
+
+#include "render/audioblock.h"
+#include "render/audiobuffer.h"
+#include "render/audiokernels.h"
+
+VolumeNode::VolumeNode()
+{
+  volume_input_ = new NodeInput("volume_in");
+  volume_input_->set_data_type(NodeParam::kFloat);
+  volume_input_->set_value_at_time(0, 100);
+  volume_input_->set_minimum(0);
+  AddInput(volume_input_);
+
+  samples_input_ = new NodeInput("samples_in");
+  samples_input_->set_data_type(NodeParam::kSamples);
+  AddInput(samples_input_);
+}
+
+Node *VolumeNode::copy() const
+{
+  return new VolumeNode();
+}
+
+QString VolumeNode::Name() const
+{
+  return tr("Volume");
+}
+
+QString VolumeNode::Category() const
+{
+  return tr("Audio");
+}
+
+QString VolumeNode::Description() const
+{
+  return tr("Adjust the volume of audio.");
+}
+
+QString VolumeNode::id() const
+{
+  return "org.olivevideoeditor.Olive.volume";
+}
+
+void VolumeNode::Retranslate()
+{
+  volume_input_->set_name(tr("Volume"));
+  samples_input_->set_name(tr("Samples"));
+}
+
+bool VolumeNode::ProcessesSamples() const
+{
+  return true;
+}
+
+void VolumeNode::ProcessSamples(AudioBlock *block, AudioBuffer *buffer) const
+{
+  float volume;
+
+  if (block->IsConstant(volume_input_, &volume)) {
+    for (int i=0;i<buffer->channel_count();i++) {
+      olive::kernels::ApplyGain(buffer->channel(i), buffer->frame_count(), volume * 0.01f);
+    }
+
+    return;
+  }
+
+  // Keyframed, so follow the curve sample by sample
+  const float* curve = block->Curve(volume_input_);
+
+  for (int i=0;i<buffer->channel_count();i++) {
+    olive::kernels::ApplyGainCurve(buffer->channel(i), buffer->frame_count(), curve);
+    olive::kernels::ApplyGain(buffer->channel(i), buffer->frame_count(), 0.01f);
+  }
+}
+
+NodeInput *VolumeNode::PassthroughInput(const NodeValueDatabase &value) const
+{
+  // At a constant 100% nothing changes
+  if (!volume_input_->IsConnected()
+      && !volume_input_->is_keyframing()
+      && qFuzzyCompare(value[volume_input_].Get(NodeParam::kFloat).toDouble(), 100.0)) {
+    return samples_input_;
+  }
+
+  return nullptr;
+}
+
+NodeInput *VolumeNode::samples_input() const
+{
+  return samples_input_;
+}
@@ -0,0 +1,57 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef VOLUMENODE_H
+#define VOLUMENODE_H
+
+#include "node/node.h"
+
+class VolumeNode : public Node
+{
+  Q_OBJECT
+public:
+  VolumeNode();
+
+  virtual Node* copy() const override;
+
+  virtual QString Name() const override;
+  virtual QString Category() const override;
+  virtual QString Description() const override;
+
+  virtual QString id() const override;
+
+  virtual void Retranslate() override;
+
+  virtual bool ProcessesSamples() const override;
+
+  virtual void ProcessSamples(AudioBlock* block, AudioBuffer* buffer) const override;
+
+  virtual NodeInput* PassthroughInput(const NodeValueDatabase& value) const override;
+
+  NodeInput* samples_input() const;
+
+private:
+  NodeInput* volume_input_;
+
+  NodeInput* samples_input_;
+
+};
+
+#endif // VOLUMENODE_H
@@ -45,6 +45,11 @@ QString AlphaOverBlend::Description() const
   return tr("A blending node that composites one texture over another using its alpha channel.");
 }
 
+Node::Precision AlphaOverBlend::OutputPrecision() const
+{
+  return kPrecisionInputs;
+}
+
 QString AlphaOverBlend::Code() const
 {
   return "#version 110"
@@ -58,6 +63,84 @@ QString AlphaOverBlend::Code() const
          "  vec4 base_col = texture2D(base_in, v_texcoord);\n"
          "  vec4 blend_col = texture2D(blend_in, v_texcoord);\n"
          "  \n"
-         "  gl_FragColor = base_col - blend_col.a + blend_col;\n"
+         "  gl_FragColor = base_col * (1.0 - blend_col.a) + blend_col;\n"
          "}\n";
 }
+
+QString AlphaOverBlend::PointwiseCode() const
+{
+  return "return base_in * (1.0 - blend_in.a) + blend_in;";
+}
+
+NodeInput *AlphaOverBlend::PassthroughInput(const NodeValueDatabase &value) const
+{
+  Q_UNUSED(value)
+
+  // Nothing to composite over the base
+  if (!blend_input()->IsConnected() || value[blend_input()].Get(NodeParam::kTexture).isNull()) {
+    return base_input();
+  }
+
+  // Compositing over nothing (e.g. a base that's hidden, see InputIsHidden()) leaves the blend as it is
+  if (value[base_input()].Get(NodeParam::kTexture).isNull()) {
+    return blend_input();
+  }
+
+  return nullptr;
+}
+
+Node::Coverage AlphaOverBlend::GetCoverage(const rational &time, const QHash<NodeInput *, Node::Coverage> &input_coverage) const
+{
+  Q_UNUSED(time)
+
+  // Unconnected inputs have no texture
+  Coverage base = input_coverage.value(base_input(), kCoverageNone);
+  Coverage blend = input_coverage.value(blend_input(), kCoverageNone);
+
+  if (base == kCoverageFull || blend == kCoverageFull) {
+    return kCoverageFull;
+  }
+
+  if (blend == kCoverageNone) {
+    return base;
+  }
+
+  if (base == kCoverageNone) {
+    return blend;
+  }
+
+  return kCoveragePartial;
+}
+
+QRectF AlphaOverBlend::GetDataWindow(const NodeValueDatabase &value, const QHash<NodeInput *, QRectF> &input_windows) const
+{
+  Q_UNUSED(value)
+
+  QRectF base = input_windows.value(base_input());
+  QRectF blend = input_windows.value(blend_input());
+
+  if (base.isEmpty()) {
+    return blend;
+  }
+
+  if (blend.isEmpty()) {
+    return base;
+  }
+
+  return base.united(blend);
+}
+
+bool AlphaOverBlend::InputIsHidden(NodeInput *input, const rational &time, const QHash<NodeInput *, Node::Coverage> &input_coverage) const
+{
+  Q_UNUSED(time)
+
+  if (input == base_input()) {
+    return input_coverage.value(blend_input(), kCoverageNone) == kCoverageFull;
+  }
+
+  if (input == blend_input()) {
+    return input_coverage.value(blend_input(), kCoverageNone) == kCoverageNone;
+  }
+
+  return false;
+}
@@ -36,6 +36,24 @@ public:
 
   virtual QString Code() const override;
 
+  virtual Precision OutputPrecision() const override;
+
+  virtual QString PointwiseCode() const override;
+
+  virtual NodeInput* PassthroughInput(const NodeValueDatabase& value) const override;
+
+  virtual Coverage GetCoverage(const rational& time, const QHash<NodeInput*, Coverage>& input_coverage) const override;
+
+  /**
+   * @brief The base is hidden behind an opaque blend, and a transparent blend adds nothing to the base
+   */
+  virtual bool InputIsHidden(NodeInput* input, const rational& time, const QHash<NodeInput*, Coverage>& input_coverage) const override;
+
+  /**
+   * @brief Anywhere either the base or the blend is
+   */
+  virtual QRectF GetDataWindow(const NodeValueDatabase& value, const QHash<NodeInput*, QRectF>& input_windows) const override;
+
 protected:
 
 private:
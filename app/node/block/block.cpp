@@ -22,9 +22,13 @@
 
 #include <QDebug>
 
+#include "node/output/track/track.h"
+
 Block::Block() :
   previous_(nullptr),
-  next_(nullptr)
+  next_(nullptr),
+  track_(nullptr),
+  position_version_(0)
 {
 }
 
@@ -33,24 +37,26 @@ QString Block::Category() const
   return tr("Block");
 }
 
-const rational &Block::in() const
+rational Block::in() const
 {
-  return in_point_;
-}
+  if (track_) {
+    rational in;
+    track_->GetBlockPosition(this, &in, nullptr);
+    return in;
+  }
 
-const rational &Block::out() const
-{
-  return out_point_;
+  return in_point_;
 }
 
-void Block::set_in(const rational &in)
+rational Block::out() const
 {
-  in_point_ = in;
-}
+  if (track_) {
+    rational out;
+    track_->GetBlockPosition(this, nullptr, &out);
+    return out;
+  }
 
-void Block::set_out(const rational &out)
-{
-  out_point_ = out;
+  return out_point_;
 }
 
 const rational& Block::length() const
@@ -73,6 +79,7 @@ void Block::set_length(const rational &length)
   UnlockUserInput();
 
   emit LengthChanged(length_);
+  emit Changed();
 }
 
 void Block::set_length_and_media_in(const rational &length)
@@ -123,6 +130,8 @@ void Block::set_media_in(const rational &media_in)
   if (changed) {
     // Signal that this clips contents have changed
     SendInvalidateCache(in(), out());
+
+    emit Changed();
   }
 }
 
@@ -133,7 +142,13 @@ const QString &Block::block_name() const
 
 void Block::set_block_name(const QString &name)
 {
+  if (block_name_ == name) {
+    return;
+  }
+
   block_name_ = name;
+
+  emit Changed();
 }
 
 rational Block::SequenceToMediaTime(const rational &sequence_time) const
@@ -176,6 +191,9 @@ void Block::Link(Block *a, Block *b)
 
   a->linked_clips_.append(b);
   b->linked_clips_.append(a);
+
+  emit a->Changed();
+  emit b->Changed();
 }
 
 void Block::Link(QList<Block *> blocks)
@@ -189,8 +207,12 @@ void Block::Link(QList<Block *> blocks)
 
 void Block::Unlink(Block *a, Block *b)
 {
-  a->linked_clips_.removeOne(b);
-  b->linked_clips_.removeOne(a);
+  if (a->linked_clips_.removeOne(b)) {
+    b->linked_clips_.removeOne(a);
+
+    emit a->Changed();
+    emit b->Changed();
+  }
 }
 
 bool Block::AreLinked(Block *a, Block *b)
@@ -21,8 +21,12 @@
 #ifndef BLOCK_H
 #define BLOCK_H
 
+#include <QAtomicInt>
+
 #include "node/node.h"
 
+class TrackOutput;
+
 /**
  * @brief A Node that represents a block of time, also displayable on a Timeline
  *
@@ -49,10 +53,14 @@ public:
 
   virtual QString Category() const override;
 
-  const rational& in() const;
-  const rational& out() const;
-  void set_in(const rational& in);
-  void set_out(const rational& out);
+  /**
+   * @brief This Block's in point on its track
+   *
+   * Worked out from the track when it's asked for, since the track doesn't move every Block after an edit. Returned
+   * by value since the track may update it from another thread.
+   */
+  rational in() const;
+  rational out() const;
 
   const rational &length() const;
   void set_length(const rational &length);
@@ -101,11 +109,23 @@ protected:
   Block* next_;
 
 private:
+  friend class TrackOutput;
+
   rational length_;
   rational media_in_;
 
-  rational in_point_;
-  rational out_point_;
+  mutable rational in_point_;
+  mutable rational out_point_;
+
+  /**
+   * @brief Track this Block is connected to, which sets in_point_ and out_point_ (see TrackOutput::GetBlockPosition)
+   */
+  TrackOutput* track_;
+
+  /**
+   * @brief The track's positions version when in_point_ and out_point_ were last set
+   */
+  mutable QAtomicInt position_version_;
 
   QString block_name_;
 
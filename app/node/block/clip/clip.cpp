@@ -56,6 +56,14 @@ QString ClipBlock::Description() const
   return tr("A time-based node that represents a media source.");
 }
 
+Node::Coverage ClipBlock::GetCoverage(const rational &time, const QHash<NodeInput *, Node::Coverage> &input_coverage) const
+{
+  Q_UNUSED(time)
+
+  // A clip with nothing connected has no texture
+  return input_coverage.value(texture_input_, kCoverageNone);
+}
+
 NodeInput *ClipBlock::texture_input() const
 {
   return texture_input_;
@@ -72,7 +80,10 @@ void ClipBlock::InvalidateCache(const rational &start_range, const rational &end
     start = qMax(start, in());
     end = qMin(end, out());
 
-    Node::InvalidateCache(start, end, from);
+    // Changes outside of the clip's media range don't affect anything
+    if (start < end) {
+      Node::InvalidateCache(start, end, from);
+    }
   } else {
     // Otherwise, pass signal along normally
     Node::InvalidateCache(start_range, end_range, from);
@@ -48,6 +48,8 @@ public:
 
   virtual NodeValueTable Value(const NodeValueDatabase& value) const override;
 
+  virtual Coverage GetCoverage(const rational& time, const QHash<NodeInput*, Coverage>& input_coverage) const override;
+
 private:
   NodeInput* texture_input_;
 
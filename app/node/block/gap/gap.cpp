@@ -52,3 +52,11 @@ QString GapBlock::Description() const
 {
   return tr("A time-based node that represents an empty space.");
 }
+
+Node::Coverage GapBlock::GetCoverage(const rational &time, const QHash<NodeInput *, Node::Coverage> &input_coverage) const
+{
+  Q_UNUSED(time)
+  Q_UNUSED(input_coverage)
+
+  return kCoverageNone;
+}
@@ -40,6 +40,11 @@ public:
   virtual QString id() const override;
   virtual QString Description() const override;
 
+  /**
+   * @brief Gaps never output anything
+   */
+  virtual Coverage GetCoverage(const rational& time, const QHash<NodeInput*, Coverage>& input_coverage) const override;
+
 private:
 
 };
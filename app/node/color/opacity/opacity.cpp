@@ -65,6 +65,11 @@ void OpacityNode::Retranslate()
   texture_input_->set_name(tr("Texture"));
 }
 
+Node::Precision OpacityNode::OutputPrecision() const
+{
+  return kPrecisionInputs;
+}
+
 QString OpacityNode::Code() const
 {
   return "#version 110"
@@ -79,6 +84,53 @@ QString OpacityNode::Code() const
          "}\n";
 }
 
+QString OpacityNode::PointwiseCode() const
+{
+  return "return tex_in * (opacity_in * 0.01);";
+}
+
+NodeInput *OpacityNode::PassthroughInput(const NodeValueDatabase &value) const
+{
+  // At 100% the shader just copies the texture
+  if (qFuzzyCompare(value[opacity_input_].Get(NodeParam::kFloat).toDouble(), 100.0)) {
+    return texture_input_;
+  }
+
+  return nullptr;
+}
+
+Node::Coverage OpacityNode::GetCoverage(const rational &time, const QHash<NodeInput *, Node::Coverage> &input_coverage) const
+{
+  Coverage texture_coverage = input_coverage.value(texture_input_, kCoveragePartial);
+
+  if (texture_coverage == kCoverageNone) {
+    return kCoverageNone;
+  }
+
+  if (opacity_input_->IsConnected()) {
+    return kCoveragePartial;
+  }
+
+  double opacity = opacity_input_->get_value_at_time(time).toDouble();
+
+  if (opacity <= 0.0) {
+    return kCoverageNone;
+  }
+
+  if (qFuzzyCompare(opacity, 100.0)) {
+    return texture_coverage;
+  }
+
+  return kCoveragePartial;
+}
+
+QRectF OpacityNode::GetDataWindow(const NodeValueDatabase &value, const QHash<NodeInput *, QRectF> &input_windows) const
+{
+  Q_UNUSED(value)
+
+  return input_windows.value(texture_input_);
+}
+
 NodeInput *OpacityNode::texture_input() const
 {
   return texture_input_;
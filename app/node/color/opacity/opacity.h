@@ -41,6 +41,22 @@ public:
 
   virtual QString Code() const override;
 
+  virtual Precision OutputPrecision() const override;
+
+  virtual QString PointwiseCode() const override;
+
+  virtual NodeInput* PassthroughInput(const NodeValueDatabase& value) const override;
+
+  /**
+   * @brief None at 0%, and the texture's own coverage at 100%
+   */
+  virtual Coverage GetCoverage(const rational& time, const QHash<NodeInput*, Coverage>& input_coverage) const override;
+
+  /**
+   * @brief The texture's own data window, since transparent pixels stay transparent
+   */
+  virtual QRectF GetDataWindow(const NodeValueDatabase& value, const QHash<NodeInput*, QRectF>& input_windows) const override;
+
   NodeInput* texture_input() const;
 
 private:
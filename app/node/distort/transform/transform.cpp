@@ -20,9 +20,6 @@
 
 #include "transform.h"
 
-#include <QMatrix4x4>
-#include <QVector2D>
-
 TransformDistort::TransformDistort()
 {
   position_input_ = new NodeInput("pos_in");
@@ -41,6 +38,11 @@ TransformDistort::TransformDistort()
   anchor_input_ = new NodeInput("anchor_in");
   anchor_input_->set_data_type(NodeParam::kVec2);
   AddInput(anchor_input_);
+
+  matrix_input_ = new NodeInput("matrix_in");
+  matrix_input_->set_data_type(NodeParam::kMatrix);
+  matrix_input_->set_value_at_time(0, QMatrix4x4());
+  AddInput(matrix_input_);
 }
 
 Node *TransformDistort::copy() const
@@ -74,27 +76,78 @@ void TransformDistort::Retranslate()
   rotation_input_->set_name(tr("Rotation"));
   scale_input_->set_name(tr("Scale"));
   anchor_input_->set_name(tr("Anchor Point"));
+  matrix_input_->set_name(tr("Parent Transform"));
 }
 
 NodeValueTable TransformDistort::Value(const NodeValueDatabase &value) const
+{
+  QMatrix4x4 mat = TransformMatrix(value[position_input_].Get(NodeParam::kVec2).value<QVector2D>(),
+                                   value[rotation_input_].Get(NodeParam::kFloat).toFloat(),
+                                   value[scale_input_].Get(NodeParam::kVec2).value<QVector2D>(),
+                                   value[anchor_input_].Get(NodeParam::kVec2).value<QVector2D>());
+
+  // Footage is sampled through the matrix as a row vector, so the parent's matrix comes first. An unconnected input is
+  // identity, in which case this doesn't change anything.
+  mat = value[matrix_input_].Get(NodeParam::kMatrix).value<QMatrix4x4>() * mat;
+
+  // Push matrix output
+  NodeValueTable output = value.Merge();
+  output.Push(NodeParam::kMatrix, mat);
+  return output;
+}
+
+NodeInput *TransformDistort::matrix_input() const
+{
+  return matrix_input_;
+}
+
+bool TransformDistort::IsIdentity() const
+{
+  if (!IsStatic(position_input_)
+      || !IsStatic(rotation_input_)
+      || !IsStatic(scale_input_)
+      || !IsStatic(anchor_input_)) {
+    return false;
+  }
+
+  if (matrix_input_->IsConnected()) {
+    TransformDistort* parent = dynamic_cast<TransformDistort*>(matrix_input_->get_connected_node());
+
+    if (parent == nullptr || !parent->IsIdentity()) {
+      return false;
+    }
+  } else if (matrix_input_->is_keyframing() || !matrix_input_->get_value_at_time(0).value<QMatrix4x4>().isIdentity()) {
+    return false;
+  }
+
+  QMatrix4x4 mat = TransformMatrix(position_input_->get_value_at_time(0).value<QVector2D>(),
+                                   rotation_input_->get_value_at_time(0).toFloat(),
+                                   scale_input_->get_value_at_time(0).value<QVector2D>(),
+                                   anchor_input_->get_value_at_time(0).value<QVector2D>());
+
+  return mat.isIdentity();
+}
+
+QMatrix4x4 TransformDistort::TransformMatrix(const QVector2D &pos, float rotation, const QVector2D &scale, const QVector2D &anchor)
 {
   QMatrix4x4 mat;
 
   // Position translate
-  QVector2D pos = value[position_input_].Get(NodeParam::kVec2).value<QVector2D>();
   mat.translate(pos);
 
   // Rotation
-  mat.rotate(value[rotation_input_].Get(NodeParam::kFloat).toFloat(), 0, 0, 1);
+  mat.rotate(rotation, 0, 0, 1);
 
   // Scale
-  mat.scale(value[scale_input_].Get(NodeParam::kVec2).value<QVector2D>()*0.01f);
+  mat.scale(scale*0.01f);
 
   // Anchor Point
-  mat.translate(-value[anchor_input_].Get(NodeParam::kVec2).value<QVector2D>());
+  mat.translate(-anchor);
 
-  // Push matrix output
-  NodeValueTable output = value.Merge();
-  output.Push(NodeParam::kMatrix, mat);
-  return output;
+  return mat;
+}
+
+bool TransformDistort::IsStatic(NodeInput *input)
+{
+  return !input->IsConnected() && !input->is_keyframing();
 }
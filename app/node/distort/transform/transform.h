@@ -21,6 +21,9 @@
 #ifndef TRANSFORMDISTORT_H
 #define TRANSFORMDISTORT_H
 
+#include <QMatrix4x4>
+#include <QVector2D>
+
 #include "node/node.h"
 
 class TransformDistort : public Node
@@ -38,9 +41,35 @@ public:
 
   virtual void Retranslate() override;
 
+  /**
+   * @brief Outputs this transform's matrix combined with the one connected to matrix_input()
+   *
+   * Stacked transforms (e.g. a clip's own and a parent transform) become a single matrix, so the footage is only
+   * resampled once however many there are.
+   */
   virtual NodeValueTable Value(const NodeValueDatabase& value) const override;
 
+  /**
+   * @brief A transform applied on top of this one (e.g. another TransformDistort)
+   */
+  NodeInput* matrix_input() const;
+
+  /**
+   * @brief Returns whether this transform leaves the image as it is at all times
+   *
+   * Only TRUE if none of the inputs are connected or keyframed and their values amount to no transformation, or if the
+   * only one connected is matrix_input() and it's connected to a transform that's identity too.
+   */
+  bool IsIdentity() const;
+
 private:
+  static QMatrix4x4 TransformMatrix(const QVector2D& pos, float rotation, const QVector2D& scale, const QVector2D& anchor);
+
+  /**
+   * @brief Returns whether this input always has the same value
+   */
+  static bool IsStatic(NodeInput* input);
+
   NodeInput* position_input_;
 
   NodeInput* rotation_input_;
@@ -49,6 +78,8 @@ private:
 
   NodeInput* anchor_input_;
 
+  NodeInput* matrix_input_;
+
 };
 
 #endif // TRANSFORMDISTORT_H
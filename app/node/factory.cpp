@@ -0,0 +1,133 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "factory.h"
+
+#include "audio/volume/volume.h"
+#include "blend/alphaover/alphaover.h"
+#include "block/clip/clip.h"
+#include "block/gap/gap.h"
+#include "color/opacity/opacity.h"
+#include "distort/transform/transform.h"
+#include "generator/solid/solid.h"
+#include "input/media/audio/audio.h"
+#include "input/media/video/video.h"
+#include "input/sequence/sequence.h"
+#include "output/timeline/timeline.h"
+#include "output/track/track.h"
+#include "output/viewer/viewer.h"
+
+QHash<QString, NodeFactory::NodeConstructor> NodeFactory::constructors_;
+QList<NodeFactory::Entry> NodeFactory::entries_;
+QList<NodeFactory::NodeConstructor> NodeFactory::entry_constructors_;
+QMutex NodeFactory::lock_;
+
+Node *NodeFactory::CreateFromID(const QString &id)
+{
+  lock_.lock();
+
+  Initialize();
+
+  NodeConstructor constructor = constructors_.value(id);
+
+  lock_.unlock();
+
+  if (constructor == nullptr) {
+    return nullptr;
+  }
+
+  return constructor();
+}
+
+QList<NodeFactory::Entry> NodeFactory::Entries()
+{
+  lock_.lock();
+
+  Initialize();
+
+  QList<Entry> entries = entries_;
+
+  lock_.unlock();
+
+  return entries;
+}
+
+void NodeFactory::Retranslate()
+{
+  lock_.lock();
+
+  Initialize();
+
+  for (int i=0;i<entries_.size();i++) {
+    Node* node = entry_constructors_.at(i)();
+
+    entries_[i].name = node->Name();
+    entries_[i].category = node->Category();
+    entries_[i].description = node->Description();
+
+    delete node;
+  }
+
+  lock_.unlock();
+}
+
+void NodeFactory::Initialize()
+{
+  if (!constructors_.isEmpty()) {
+    return;
+  }
+
+  Register<AlphaOverBlend>();
+  Register<AudioInput>();
+  Register<ClipBlock>();
+  Register<GapBlock>();
+  Register<OpacityNode>();
+  Register<SequenceInput>();
+  Register<SolidGenerator>();
+  Register<TimelineOutput>();
+  Register<TrackOutput>();
+  Register<TransformDistort>();
+  Register<VideoInput>();
+  Register<ViewerOutput>();
+  Register<VolumeNode>();
+}
+
+template<class T>
+Node *NodeFactory::Construct()
+{
+  return new T();
+}
+
+template<class T>
+void NodeFactory::Register()
+{
+  // IDs are only available from an instance, so create one to find out what it is along with everything else
+  T node;
+
+  Entry entry;
+  entry.id = node.id();
+  entry.name = node.Name();
+  entry.category = node.Category();
+  entry.description = node.Description();
+
+  constructors_.insert(entry.id, &NodeFactory::Construct<T>);
+  entries_.append(entry);
+  entry_constructors_.append(&NodeFactory::Construct<T>);
+}
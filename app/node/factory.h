@@ -0,0 +1,102 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef NODEFACTORY_H
+#define NODEFACTORY_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+
+#include "node.h"
+
+/**
+ * @brief Creates Nodes from their ID (see Node::id()) and knows about every Node type there is
+ *
+ * Used when reading saved node graphs back in, where all that's known about a Node is the ID it was saved with, and
+ * for listing Node types (e.g. in menus) without creating one of each every time. Every Node type that can appear in
+ * a graph must be registered in Initialize().
+ *
+ * All functions are thread-safe.
+ */
+class NodeFactory
+{
+public:
+  /**
+   * @brief Create a new Node with this ID
+   *
+   * @return
+   *
+   * A new Node owned by the caller, or nullptr if no Node with this ID is registered.
+   */
+  static Node* CreateFromID(const QString& id);
+
+  /**
+   * @brief What's known about a registered Node type (see Node::Name(), Node::Category() and Node::Description())
+   */
+  struct Entry {
+    QString id;
+    QString name;
+    QString category;
+    QString description;
+  };
+
+  /**
+   * @brief Every registered Node type, in the order they were registered
+   *
+   * Each type is only created once, when the registry is first used, to read these. Names are translated in the
+   * language at that time, call Retranslate() if it changes.
+   */
+  static QList<Entry> Entries();
+
+  /**
+   * @brief Read every entry's name, category and description again in the current language
+   */
+  static void Retranslate();
+
+private:
+  typedef Node* (*NodeConstructor)();
+
+  /**
+   * @brief Register every Node type if they haven't been yet, call with lock_ held
+   */
+  static void Initialize();
+
+  template<class T>
+  static Node* Construct();
+
+  template<class T>
+  static void Register();
+
+  static QHash<QString, NodeConstructor> constructors_;
+
+  /**
+   * @brief Same order as registration, constructors_ is looked up by ID
+   */
+  static QList<Entry> entries_;
+
+  static QList<NodeConstructor> entry_constructors_;
+
+  static QMutex lock_;
+
+};
+
+#endif // NODEFACTORY_H
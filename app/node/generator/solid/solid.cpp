@@ -33,6 +33,11 @@ Node *SolidGenerator::copy() const
   return new SolidGenerator();
 }
 
+NodeInput *SolidGenerator::color_input() const
+{
+  return color_input_;
+}
+
 QString SolidGenerator::Name() const
 {
   return tr("Solid");
@@ -53,15 +58,42 @@ QString SolidGenerator::Description() const
   return tr("Generate a solid color.");
 }
 
-QString SolidGenerator::Code() const
+NodeValueTable SolidGenerator::Value(const NodeValueDatabase &value) const
+{
+  QColor color = value[color_input_].Get(NodeParam::kColor).value<QColor>();
+
+  NodeValueTable table;
+  table.Push(NodeParam::kTexture, NodeValue::ConstantTexture(QVector4D(static_cast<float>(color.redF()),
+                                                                       static_cast<float>(color.greenF()),
+                                                                       static_cast<float>(color.blueF()),
+                                                                       static_cast<float>(color.alphaF()))));
+  return table;
+}
+
+QString SolidGenerator::PointwiseCode() const
 {
-  return "#version 110\n"
-         "\n"
-         "uniform vec4 color_in;\n"
-         "\n"
-         "void main(void) {\n"
-         "  gl_FragColor = color_in;\n"
-         "}\n";
+  return "return color_in;";
+}
+
+Node::Coverage SolidGenerator::GetCoverage(const rational &time, const QHash<NodeInput *, Node::Coverage> &input_coverage) const
+{
+  Q_UNUSED(input_coverage)
+
+  if (color_input_->IsConnected()) {
+    return kCoveragePartial;
+  }
+
+  QColor color = color_input_->get_value_at_time(time).value<QColor>();
+
+  if (color.alphaF() >= 1.0) {
+    return kCoverageFull;
+  }
+
+  if (color.redF() == 0.0 && color.greenF() == 0.0 && color.blueF() == 0.0 && color.alphaF() == 0.0) {
+    return kCoverageNone;
+  }
+
+  return kCoveragePartial;
 }
 
 void SolidGenerator::Retranslate()
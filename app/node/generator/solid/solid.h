@@ -41,10 +41,22 @@ public:
   virtual QString Category() const override;
   virtual QString Description() const override;
 
-  virtual QString Code() const override;
+  /**
+   * @brief Outputs the color as a constant (see NodeValue::ConstantTexture()) so no texture is drawn for it
+   */
+  virtual NodeValueTable Value(const NodeValueDatabase& value) const override;
+
+  virtual QString PointwiseCode() const override;
+
+  /**
+   * @brief Full if the color is opaque, none if it's all zero
+   */
+  virtual Coverage GetCoverage(const rational& time, const QHash<NodeInput*, Coverage>& input_coverage) const override;
 
   virtual void Retranslate() override;
 
+  NodeInput* color_input() const;
+
 private:
   NodeInput* color_input_;
 
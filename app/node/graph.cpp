@@ -20,9 +20,12 @@
 
 #include "graph.h"
 
-NodeGraph::NodeGraph()
-{
+QAtomicInteger<quint64> NodeGraph::version_counter_;
 
+NodeGraph::NodeGraph() :
+  topological_order_dirty_(true)
+{
+  BumpVersion();
 }
 
 void NodeGraph::Clear()
@@ -31,6 +34,10 @@ void NodeGraph::Clear()
     delete node;
   }
   node_children_.clear();
+
+  topological_order_dirty_ = true;
+
+  BumpVersion();
 }
 
 void NodeGraph::AddNode(Node *node)
@@ -43,9 +50,16 @@ void NodeGraph::AddNode(Node *node)
 
   connect(node, SIGNAL(EdgeAdded(NodeEdgePtr)), this, SIGNAL(EdgeAdded(NodeEdgePtr)));
   connect(node, SIGNAL(EdgeRemoved(NodeEdgePtr)), this, SIGNAL(EdgeRemoved(NodeEdgePtr)));
+  connect(node, SIGNAL(EdgeAdded(NodeEdgePtr)), this, SLOT(NodeEdgeChanged()));
+  connect(node, SIGNAL(EdgeRemoved(NodeEdgePtr)), this, SLOT(NodeEdgeChanged()));
+  connect(node, SIGNAL(Changed()), this, SLOT(NodeChanged()));
 
   node_children_.append(node);
 
+  topological_order_dirty_ = true;
+
+  BumpVersion();
+
   emit NodeAdded(node);
 }
 
@@ -57,7 +71,12 @@ void NodeGraph::AddNodeWithDependencies(Node *node)
   // Add all of Block's dependencies
   QList<Node*> node_dependencies = node->GetDependencies();
   foreach (Node* dep, node_dependencies) {
-    AddNode(dep);
+    NodeGraph* dep_graph = qobject_cast<NodeGraph*>(dep->parent());
+
+    // Nodes of another graph (e.g. a nested sequence's) stay where they are
+    if (!dep_graph || dep_graph == this) {
+      AddNode(dep);
+    }
   }
 }
 
@@ -76,11 +95,18 @@ void NodeGraph::TakeNode(Node *node, QObject* new_parent)
 
   disconnect(node, SIGNAL(EdgeAdded(NodeEdgePtr)), this, SIGNAL(EdgeAdded(NodeEdgePtr)));
   disconnect(node, SIGNAL(EdgeRemoved(NodeEdgePtr)), this, SIGNAL(EdgeRemoved(NodeEdgePtr)));
+  disconnect(node, SIGNAL(EdgeAdded(NodeEdgePtr)), this, SLOT(NodeEdgeChanged()));
+  disconnect(node, SIGNAL(EdgeRemoved(NodeEdgePtr)), this, SLOT(NodeEdgeChanged()));
+  disconnect(node, SIGNAL(Changed()), this, SLOT(NodeChanged()));
 
   node->setParent(new_parent);
 
   node_children_.removeAll(node);
 
+  topological_order_dirty_ = true;
+
+  BumpVersion();
+
   emit NodeRemoved(node);
 }
 
@@ -104,6 +130,23 @@ const QList<Node *> &NodeGraph::nodes()
   return node_children_;
 }
 
+const QList<Node *> &NodeGraph::TopologicalOrder()
+{
+  if (topological_order_dirty_) {
+    QSet<Node*> visited;
+
+    topological_order_.clear();
+
+    foreach (Node* n, node_children_) {
+      AppendInTopologicalOrder(n, visited, topological_order_);
+    }
+
+    topological_order_dirty_ = false;
+  }
+
+  return topological_order_;
+}
+
 bool NodeGraph::ContainsNode(Node *n)
 {
   return (n->parent() == this);
@@ -117,3 +160,43 @@ void NodeGraph::Release()
     n->Release();
   }
 }
+
+quint64 NodeGraph::version() const
+{
+  return version_;
+}
+
+void NodeGraph::BumpVersion()
+{
+  version_ = version_counter_.fetchAndAddRelaxed(1) + 1;
+}
+
+void NodeGraph::AppendInTopologicalOrder(Node *node, QSet<Node *> &visited, QList<Node *> &order)
+{
+  if (visited.contains(node)) {
+    return;
+  }
+
+  // Marked before its dependencies so a cycle ends here instead of recursing forever
+  visited.insert(node);
+
+  foreach (Node* dep, node->GetImmediateDependencies()) {
+    if (ContainsNode(dep)) {
+      AppendInTopologicalOrder(dep, visited, order);
+    }
+  }
+
+  order.append(node);
+}
+
+void NodeGraph::NodeChanged()
+{
+  BumpVersion();
+}
+
+void NodeGraph::NodeEdgeChanged()
+{
+  topological_order_dirty_ = true;
+
+  BumpVersion();
+}
@@ -21,7 +21,9 @@
 #ifndef NODEGRAPH_H
 #define NODEGRAPH_H
 
+#include <QAtomicInteger>
 #include <QObject>
+#include <QSet>
 
 #include "node/node.h"
 
@@ -55,6 +57,8 @@ public:
    *
    * Adds the Node to the graph and runs through its inputs adding all of its dependencies (and all of their
    * dependencies and so forth). The graph takes ownershi of all Nodes added through this process.
+   *
+   * Dependencies that already belong to another graph (e.g. the nodes of a nested sequence) are left in that graph.
    */
   void AddNodeWithDependencies(Node* node);
 
@@ -80,6 +84,14 @@ public:
    */
   const QList<Node*>& nodes();
 
+  /**
+   * @brief Every node in this graph, ordered so each one comes after the nodes connected to its inputs
+   *
+   * Cached until a node is added, removed, connected or disconnected, so it's cheap to call repeatedly (e.g. on every
+   * compile). Nodes in a cycle are still all included, in no particular order relative to each other.
+   */
+  const QList<Node*>& TopologicalOrder();
+
   /**
    * @brief Returns whether a certain Node is in the graph or not
    */
@@ -90,6 +102,14 @@ public:
    */
   void Release();
 
+  /**
+   * @brief A value that changes whenever a node is added, removed, connected or changed (see Node::Changed())
+   *
+   * Values are unique across all graphs, so comparing against one seen earlier tells whether this graph has changed
+   * since, even if another graph has been created at the same address in the meantime.
+   */
+  quint64 version() const;
+
 signals:
   /**
    * @brief Signal emitted when a Node is added to the graph
@@ -112,7 +132,31 @@ signals:
   void EdgeRemoved(NodeEdgePtr edge);
 
 private:
+  void BumpVersion();
+
+  /**
+   * @brief Append `node` to `order` after every node in this graph that it depends on, unless it's been visited already
+   */
+  void AppendInTopologicalOrder(Node* node, QSet<Node*>& visited, QList<Node*>& order);
+
   QList<Node*> node_children_;
+
+  quint64 version_;
+
+  static QAtomicInteger<quint64> version_counter_;
+
+  QList<Node*> topological_order_;
+
+  /**
+   * @brief Set when nodes or edges change so topological_order_ is regenerated the next time it's needed
+   */
+  bool topological_order_dirty_;
+
+private slots:
+  void NodeChanged();
+
+  void NodeEdgeChanged();
+
 };
 
 #endif // NODEGRAPH_H
@@ -20,11 +20,115 @@
 
 #include "input.h"
 
+#include <QAtomicInteger>
+#include <QColor>
+#include <QVector2D>
+#include <QVector3D>
+#include <QVector4D>
+#include <QtMath>
+#include <algorithm>
+
 #include "common/lerp.h"
 #include "node.h"
 #include "output.h"
 #include "inputarray.h"
 
+namespace {
+QAtomicInteger<quint64> next_value_version(1);
+
+/**
+ * @brief The keyframe segment a thread last found for an input
+ */
+struct KeyframeCursor {
+  const NodeInput* input;
+  int index;
+};
+
+// Small direct-mapped table so interleaved lookups of different inputs don't evict each other
+const int kKeyframeCursorCount = 64;
+thread_local KeyframeCursor keyframe_cursors[kKeyframeCursorCount] = {};
+
+bool KeyframeTimeLessThan(const rational& time, const NodeKeyframe& key)
+{
+  return time < key.time();
+}
+
+/**
+ * @brief Count how many of the samples `start + timebase * i` (for `i` < `count`) are before `time`
+ *
+ * If `inclusive` is TRUE, samples exactly at `time` are counted too.
+ */
+int CountSamplesBefore(const rational& start, const rational& timebase, const rational& time, int count, bool inclusive)
+{
+  // Estimate in floating point first, then correct it exactly
+  double estimate = qCeil(((time - start) / timebase).toDouble());
+  int n = static_cast<int>(qBound(0.0, estimate, static_cast<double>(count)));
+
+  while (n > 0) {
+    rational t = start + timebase * rational(n - 1);
+
+    if (t < time || (inclusive && t == time)) {
+      break;
+    }
+
+    n--;
+  }
+
+  while (n < count) {
+    rational t = start + timebase * rational(n);
+
+    if (!(t < time || (inclusive && t == time))) {
+      break;
+    }
+
+    n++;
+  }
+
+  return n;
+}
+
+void FillSamples(float* buffer, int from, int to, const QVariant& value)
+{
+  std::fill(buffer + from, buffer + to, value.toFloat());
+}
+
+bool TypeCanBeInterpolated(const NodeParam::DataType& type)
+{
+  return type == NodeParam::kFloat
+      || type == NodeParam::kVec2
+      || type == NodeParam::kVec3
+      || type == NodeParam::kVec4
+      || type == NodeParam::kColor;
+}
+
+/**
+ * @brief Interpolate between two values of a type TypeCanBeInterpolated() accepts
+ */
+QVariant InterpolateValue(const NodeParam::DataType& type, const QVariant& a, const QVariant& b, double t)
+{
+  switch (type) {
+  case NodeParam::kVec2:
+    return QVariant::fromValue(lerp(a.value<QVector2D>(), b.value<QVector2D>(), t));
+  case NodeParam::kVec3:
+    return QVariant::fromValue(lerp(a.value<QVector3D>(), b.value<QVector3D>(), t));
+  case NodeParam::kVec4:
+    return QVariant::fromValue(lerp(a.value<QVector4D>(), b.value<QVector4D>(), t));
+  case NodeParam::kColor:
+  {
+    QColor ca = a.value<QColor>();
+    QColor cb = b.value<QColor>();
+
+    return QVariant::fromValue(QColor::fromRgbF(lerp(ca.redF(), cb.redF(), t),
+                                                lerp(ca.greenF(), cb.greenF(), t),
+                                                lerp(ca.blueF(), cb.blueF(), t),
+                                                lerp(ca.alphaF(), cb.alphaF(), t)));
+  }
+  default:
+    return lerp(a.toDouble(), b.toDouble(), t);
+  }
+}
+}
+
 NodeInput::NodeInput(const QString& id) :
   NodeParam(id),
   keyframing_(false),
@@ -34,6 +138,8 @@ NodeInput::NodeInput(const QString& id) :
 {
   // Have at least one keyframe/value active at any time
   keyframes_.append(NodeKeyframe());
+
+  BumpValueVersion();
 }
 
 bool NodeInput::IsArray()
@@ -87,56 +193,165 @@ Node *NodeInput::get_connected_node()
 
 QVariant NodeInput::get_value_at_time(const rational &time)
 {
-  if (is_keyframing()) {
-    if (keyframes_.first().time() >= time) {
+  // Const so reading it never detaches it from the list that was published
+  bool keyframing;
+  NodeKeyframeCurve curve;
+  const QVector<NodeKeyframe> keyframes = TakeSnapshot(&curve, &keyframing);
+
+  if (keyframing) {
+    if (keyframes.first().time() >= time) {
       // This time precedes any keyframe, so we just return the first value
-      return keyframes_.first().value();
+      return keyframes.first().value();
     }
 
-    if (keyframes_.last().time() <= time) {
+    if (keyframes.last().time() <= time) {
       // This time is after any keyframes so we return the last value
-      return keyframes_.last().value();
+      return keyframes.last().value();
     }
 
     // If we're here, the time must be somewhere in between the keyframes
-    for (int i=0;i<keyframes_.size()-1;i++) {
-      const NodeKeyframe& before = keyframes_.at(i);
-      const NodeKeyframe& after = keyframes_.at(i+1);
-
-      if (before.time() == time
-          || data_type() != kFloat // FIXME: Expand this to other types that can be interpolated
-          || (before.time() < time && before.type() == NodeKeyframe::kHold)) {
-
-        // Time == keyframe time, so value is precise
-        return before.value();
-
-      } else if (before.time() < time && after.time() > time) {
-        // We must interpolate between these keyframes
-
-        if (before.type() == NodeKeyframe::kBezier && after.type() == NodeKeyframe::kBezier) {
-          // FIXME: Perform a cubic bezier interpolation
-        } else if (before.type() == NodeKeyframe::kLinear && after.type() == NodeKeyframe::kBezier) {
-          // FIXME: Perform a quadratic bezier interpolation with anchors from the AFTER keyframe
-        } else if (before.type() == NodeKeyframe::kLinear && after.type() == NodeKeyframe::kBezier) {
-          // FIXME: Perform a quadratic bezier interpolation with anchors from the BEFORE keyframe
-        } else {
-          // To have arrived here, the keyframes must both be linear
-          qreal period_progress = (time.toDouble() - before.time().toDouble()) / (after.time().toDouble() - before.time().toDouble());
-          qreal interpolated_value = lerp(before.value().toDouble(), after.value().toDouble(), period_progress);
-
-          return interpolated_value;
+    int i = FindKeyframeSegment(keyframes, time);
+
+    const NodeKeyframe& before = keyframes.at(i);
+    const NodeKeyframe& after = keyframes.at(i+1);
+
+    if (before.time() == time
+        || !TypeCanBeInterpolated(data_type())
+        || before.type() == NodeKeyframe::kHold) {
+
+      // Time == keyframe time, so value is precise
+      return before.value();
+
+    } else if (curve.IsBezier(i)) {
+      // Follow the curve, other types than numbers only follow its timing
+      double parameter = curve.Parameter(i, time.toDouble());
+
+      if (data_type() == kFloat) {
+        return curve.Value(i, parameter);
+      }
+
+      return InterpolateValue(data_type(), before.value(), after.value(), parameter);
+
+    } else {
+      // To have arrived here, the keyframes must both be linear
+      double before_time = before.time().toDouble();
+      qreal period_progress = (time.toDouble() - before_time) / (after.time().toDouble() - before_time);
+
+      return InterpolateValue(data_type(), before.value(), after.value(), period_progress);
+    }
+  }
+
+  return keyframes.first().value();
+}
+
+void NodeInput::get_values_over_range(const TimeRange &range, const rational &timebase, float *buffer, int count)
+{
+  if (count <= 0) {
+    return;
+  }
+
+  // Const so reading it never detaches it from the list that was published
+  bool keyframing;
+  NodeKeyframeCurve curve;
+  const QVector<NodeKeyframe> keyframes = TakeSnapshot(&curve, &keyframing);
+
+  if (!keyframing) {
+    FillSamples(buffer, 0, count, keyframes.first().value());
+    return;
+  }
+
+  const NodeKeyframe& first_key = keyframes.first();
+  const NodeKeyframe& last_key = keyframes.last();
+
+  // Samples at or before the first keyframe and at or after the last one just get their values
+  int segment_start = CountSamplesBefore(range.in(), timebase, first_key.time(), count, true);
+  int tail_start = qMax(segment_start, CountSamplesBefore(range.in(), timebase, last_key.time(), count, false));
+
+  FillSamples(buffer, 0, segment_start, first_key.value());
+  FillSamples(buffer, tail_start, count, last_key.value());
+
+  if (segment_start == tail_start) {
+    return;
+  }
+
+  // Everything else is in between keyframes, so we walk the segments from the first one we need
+  int k = FindKeyframeSegment(keyframes, range.in() + timebase * rational(segment_start));
+
+  double start = range.in().toDouble();
+  double step = timebase.toDouble();
+
+  while (segment_start < tail_start) {
+    const NodeKeyframe& before = keyframes.at(k);
+    const NodeKeyframe& after = keyframes.at(k+1);
+
+    int segment_end = qMin(tail_start, CountSamplesBefore(range.in(), timebase, after.time(), count, false));
+
+    if (segment_start < segment_end) {
+      if (data_type() != kFloat || before.type() == NodeKeyframe::kHold) {
+        FillSamples(buffer, segment_start, segment_end, before.value());
+      } else if (curve.IsBezier(k)) {
+        // The segment was compiled when the keyframes changed, so each sample is a lookup and a couple of cubics
+        for (int i=segment_start;i<segment_end;i++) {
+          buffer[i] = static_cast<float>(curve.Value(k, curve.Parameter(k, start + step * i)));
+        }
+      } else {
+        // Linear, so every value in this segment is just `offset + slope * i`
+        double before_time = before.time().toDouble();
+        double before_value = before.value().toDouble();
+        double slope = (after.value().toDouble() - before_value) / (after.time().toDouble() - before_time);
+        double offset = before_value + slope * (start - before_time);
+        double slope_per_sample = slope * step;
+
+        for (int i=segment_start;i<segment_end;i++) {
+          buffer[i] = static_cast<float>(offset + slope_per_sample * i);
         }
       }
     }
+
+    segment_start = segment_end;
+    k++;
+  }
+}
+
+TimeRange NodeInput::get_constant_range_at_time(const rational &time)
+{
+  // Const so reading it never detaches it from the list that was published
+  bool keyframing;
+  NodeKeyframeCurve curve;
+  const QVector<NodeKeyframe> keyframes = TakeSnapshot(&curve, &keyframing);
+
+  if (!keyframing) {
+    return TimeRange(RATIONAL_MIN, RATIONAL_MAX);
+  }
+
+  if (time < keyframes.first().time()) {
+    return TimeRange(RATIONAL_MIN, keyframes.first().time());
   }
 
-  return keyframes_.first().value();
+  if (time >= keyframes.last().time()) {
+    return TimeRange(keyframes.last().time(), RATIONAL_MAX);
+  }
+
+  int i = FindKeyframeSegment(keyframes, time);
+
+  const NodeKeyframe& before = keyframes.at(i);
+  const NodeKeyframe& after = keyframes.at(i+1);
+
+  // Holds keep their value until the next keyframe, and so does a straight line between two equal values
+  if (before.type() == NodeKeyframe::kHold
+      || !TypeCanBeInterpolated(data_type())
+      || (!curve.IsBezier(i) && before.value() == after.value())) {
+    return TimeRange(before.time(), after.time());
+  }
+
+  return TimeRange(time, time);
 }
 
 void NodeInput::set_value_at_time(const rational &time, const QVariant &value)
 {
-  if (parentNode() != nullptr)
-    parentNode()->LockUserInput();
+  // Changes are made to a copy of the keyframes that's published once it's done, so render threads reading this
+  // input never see it half-changed or have to wait for it
+  QVector<NodeKeyframe> keyframes = keyframes_;
 
   // We set up these variables in advance (see end of function)
   bool signal_vc = false;
@@ -145,92 +360,119 @@ void NodeInput::set_value_at_time(const rational &time, const QVariant &value)
   if (is_keyframing()) {
     // Insert value into the keyframe list chronologically
 
-    if (keyframes_.first().time() > time) {
+    if (keyframes.first().time() > time) {
 
       // Store this away for the ValueChanged signal we emit later
-      rational existing_first_key = keyframes_.first().time();
+      rational existing_first_key = keyframes.first().time();
 
       // Insert at the beginning
-      keyframes_.prepend(NodeKeyframe(time, value, keyframes_.first().type()));
+      keyframes.prepend(NodeKeyframe(time, value, keyframes.first().type()));
 
       // Value has changed since the earliest point up until the ex-first keyframe (since the frames
       // interpolating between the key we're adding and the key that existed are changing too)
       signal_vc = true;
       signal_vc_range = TimeRange(RATIONAL_MIN, existing_first_key);
 
-    } else if (keyframes_.first().time() == time) {
+    } else if (keyframes.first().time() == time) {
 
       // Replace first value
-      keyframes_.first().set_value(value);
+      keyframes.first().set_value(value);
 
       // Value has changed since the earliest point up until the keyframe we just changed
       signal_vc = true;
       signal_vc_range = TimeRange(RATIONAL_MIN, time);
 
-    } else if (keyframes_.last().time() < time) {
+    } else if (keyframes.last().time() < time) {
 
       // Store this away for the ValueChanged signal we emit later
-      rational existing_last_key = keyframes_.last().time();
+      rational existing_last_key = keyframes.last().time();
 
       // Append at the end
-      keyframes_.append(NodeKeyframe(time, value, keyframes_.last().type()));
+      keyframes.append(NodeKeyframe(time, value, keyframes.last().type()));
 
       // Value has changed since the ex-last point up until the latest possible point (since the frames
       // interpolating between the key we're adding and the key that existed are changing too)
       signal_vc = true;
       signal_vc_range = TimeRange(existing_last_key, RATIONAL_MAX);
 
-    } else if (keyframes_.last().time() == time) {
+    } else if (keyframes.last().time() == time) {
 
       // Replace last value
-      keyframes_.last().set_value(value);
+      keyframes.last().set_value(value);
 
       // Value has changed from this point until the latest possible point
       signal_vc = true;
       signal_vc_range = TimeRange(time, RATIONAL_MAX);
 
     } else {
-      for (int i=0;i<keyframes_.size()-1;i++) {
-        NodeKeyframe& before = keyframes_[i];
-        NodeKeyframe& after = keyframes_[i+1];
-
-        if (before.time() == time) {
-          // Found exact match, replace it
-          before.set_value(value);
-
-          // Values have changed since the last keyframe and the next one
-          signal_vc = true;
-          signal_vc_range = TimeRange(keyframes_.at(i-1).time(), keyframes_.at(i+1).time());
-          break;
-        } else if (before.time() < time && after.time() > time) {
-          // Insert value in between these two keyframes
-          keyframes_.insert(i+1, NodeKeyframe(time, value, before.type()));
-
-          // Values have changed since the last keyframe and the next one
-          signal_vc = true;
-          signal_vc_range = TimeRange(before.time(), after.time());
-          break;
-        }
+      int i = FindKeyframeSegment(keyframes, time);
+
+      NodeKeyframe& before = keyframes[i];
+      rational after_time = keyframes.at(i+1).time();
+
+      if (before.time() == time) {
+        // Found exact match, replace it
+        before.set_value(value);
+
+        // Values have changed since the last keyframe and the next one
+        signal_vc = true;
+        signal_vc_range = TimeRange(keyframes.at(i-1).time(), after_time);
+      } else {
+        // Insert value in between these two keyframes
+        rational before_time = before.time();
+
+        keyframes.insert(i+1, NodeKeyframe(time, value, before.type()));
+
+        // Values have changed since the last keyframe and the next one
+        signal_vc = true;
+        signal_vc_range = TimeRange(before_time, after_time);
       }
     }
 
   } else {
-    keyframes_.first().set_value(value);
+    keyframes.first().set_value(value);
 
     // Values have changed for all times since the value is static
     signal_vc = true;
     signal_vc_range = TimeRange(RATIONAL_MIN, RATIONAL_MAX);
   }
 
-  if (parentNode() != nullptr)
-    parentNode()->UnlockUserInput();
+  PublishValues(keyframes, NodeKeyframeCurve(keyframes), keyframing_);
 
-  // We make sure this signal is emitted AFTER we've unlocked the node in case this leads to a tangent where something
-  // tries to relock this node before it's unlocked here
   if (signal_vc)
     emit ValueChanged(signal_vc_range.in(), signal_vc_range.out());
 }
 
+int NodeInput::FindKeyframeSegment(const QVector<NodeKeyframe> &keyframes, const rational &time) const
+{
+  KeyframeCursor& cursor = keyframe_cursors[(reinterpret_cast<quintptr>(this) / sizeof(NodeInput)) % kKeyframeCursorCount];
+
+  // Sequential playback usually lands in the same segment as last time, or the one after it
+  if (cursor.input == this) {
+    for (int i=cursor.index;i<=cursor.index+1;i++) {
+      if (i+1 < keyframes.size()
+          && keyframes.at(i).time() <= time
+          && keyframes.at(i+1).time() > time) {
+        cursor.index = i;
+        return i;
+      }
+    }
+  }
+
+  // Otherwise find the last keyframe at or before this time
+  QVector<NodeKeyframe>::const_iterator after = std::upper_bound(keyframes.constBegin(),
+                                                                 keyframes.constEnd(),
+                                                                 time,
+                                                                 KeyframeTimeLessThan);
+
+  int index = qMax(0, static_cast<int>(after - keyframes.constBegin()) - 1);
+
+  cursor.input = this;
+  cursor.index = index;
+
+  return index;
+}
+
 bool NodeInput::is_keyframing()
 {
   return keyframing_;
@@ -238,7 +480,23 @@ bool NodeInput::is_keyframing()
 
 void NodeInput::set_is_keyframing(bool k)
 {
-  keyframing_ = k;
+  if (keyframing_ != k) {
+    PublishValues(keyframes_, curve_, k);
+  }
+}
+
+const QVector<NodeKeyframe> &NodeInput::keyframes() const
+{
+  return keyframes_;
+}
+
+void NodeInput::set_keyframes(const QVector<NodeKeyframe> &keys)
+{
+  Q_ASSERT(!keys.isEmpty());
+
+  PublishValues(keys, NodeKeyframeCurve(keys), keyframing_);
+
+  emit ValueChanged(RATIONAL_MIN, RATIONAL_MAX);
 }
 
 bool NodeInput::dependent()
@@ -283,15 +541,56 @@ void NodeInput::set_maximum(const QVariant &max)
   has_maximum_ = true;
 }
 
+const quint64 &NodeInput::value_version() const
+{
+  return value_version_;
+}
+
+void NodeInput::BumpValueVersion()
+{
+  value_version_ = next_value_version.fetchAndAddRelaxed(1);
+}
+
+void NodeInput::PublishValues(const QVector<NodeKeyframe> &keyframes, const NodeKeyframeCurve &curve, bool keyframing)
+{
+  // Assigning the lists only swaps references to their (implicitly shared) data, so the lock is held for next to no
+  // time
+  values_lock_.lock();
+
+  keyframes_ = keyframes;
+  curve_ = curve;
+  keyframing_ = keyframing;
+
+  values_lock_.unlock();
+
+  BumpValueVersion();
+}
+
+QVector<NodeKeyframe> NodeInput::TakeSnapshot(NodeKeyframeCurve *curve, bool *keyframing) const
+{
+  values_lock_.lock();
+
+  QVector<NodeKeyframe> keyframes = keyframes_;
+  *curve = curve_;
+  *keyframing = keyframing_;
+
+  values_lock_.unlock();
+
+  return keyframes;
+}
+
 void NodeInput::CopyValues(NodeInput *source, NodeInput *dest, bool include_connections)
 {
   Q_ASSERT(source->id() == dest->id());
 
-  // Copy values
-  dest->keyframes_ = source->keyframes_;
+  // Only copy values if they've changed since the last copy. The keyframe list is implicitly shared, so this
+  // doesn't copy the keyframes themselves until one of the inputs is modified.
+  if (dest->value_version_ != source->value_version_) {
+    // Copy values and keyframing state
+    dest->PublishValues(source->keyframes_, source->curve_, source->keyframing_);
 
-  // Copy keyframing state
-  dest->set_is_keyframing(source->is_keyframing());
+    dest->value_version_ = source->value_version_;
+  }
 
   // Copy connections
   if (include_connections && source->get_connected_output() != nullptr) {
@@ -21,7 +21,12 @@
 #ifndef NODEINPUT_H
 #define NODEINPUT_H
 
+#include <QMutex>
+#include <QVector>
+
+#include "common/timerange.h"
 #include "keyframe.h"
+#include "keyframecurve.h"
 #include "param.h"
 
 /**
@@ -80,9 +85,29 @@ public:
 
   /**
    * @brief Calculate what the stored value should be at a certain time
+   *
+   * Numbers, vectors and colors are interpolated between keyframes, other types hold each keyframe's value until the
+   * next one.
    */
   QVariant get_value_at_time(const rational& time);
 
+  /**
+   * @brief Calculate the value at `count` evenly spaced times in one go
+   *
+   * Sample `i` is taken at `range.in() + timebase * i`, giving the same result as get_value_at_time() at that time.
+   * This is much faster for dense sampling (e.g. a value per audio sample) since each keyframe segment is only looked
+   * up once and linear segments are filled in a tight loop the compiler can vectorize. Only meaningful for numeric
+   * types.
+   */
+  void get_values_over_range(const TimeRange& range, const rational& timebase, float* buffer, int count);
+
+  /**
+   * @brief Get the times around `time` over which this input keeps the value it has at `time`
+   *
+   * The range's out point is exclusive. If the value is changing at `time`, the range starts and ends at `time`.
+   */
+  TimeRange get_constant_range_at_time(const rational& time);
+
   /**
    * @brief Sets what value should be seen at a specific time
    */
@@ -98,6 +123,21 @@ public:
    */
   void set_is_keyframing(bool k);
 
+  /**
+   * @brief Every keyframe of this input in chronological order (just one if keyframing is disabled)
+   *
+   * Only safe to use in the thread that changes this input. Other threads should get values through
+   * get_value_at_time() and get_values_over_range().
+   */
+  const QVector<NodeKeyframe>& keyframes() const;
+
+  /**
+   * @brief Replace every keyframe of this input at once (e.g. when loading a project)
+   *
+   * `keys` must be in chronological order and can't be empty.
+   */
+  void set_keyframes(const QVector<NodeKeyframe>& keys);
+
   /**
    * @brief Return whether the Node is dependent on this input or not
    *
@@ -118,8 +158,18 @@ public:
   bool has_maximum();
   void set_maximum(const QVariant& max);
 
+  /**
+   * @brief Returns a number that changes whenever this input's values or keyframing state change
+   *
+   * Versions are unique across all inputs, so two inputs with the same version are guaranteed to hold the same values
+   * (one was copied from the other with CopyValues()).
+   */
+  const quint64& value_version() const;
+
   /**
    * @brief Copy all values including keyframe information and connections from another NodeInput
+   *
+   * If `dest` already has the same value version as `source`, the values are known to be the same and aren't copied.
    */
   static void CopyValues(NodeInput* source, NodeInput* dest, bool include_connections = true);
 
@@ -139,8 +189,58 @@ private:
    *
    * All internal/user-defined data is stored in this array. Even if keyframing is not enabled, this array will contain
    * one entry which will be used, and its time value will be ignored.
+   *
+   * Always kept sorted by time.
+   *
+   * Never modified in place. Changes are made to a copy which replaces this one with PublishValues(), so a render
+   * thread that took a snapshot with TakeSnapshot() keeps reading consistent values however the input is changed in
+   * the meantime.
+   */
+  QVector<NodeKeyframe> keyframes_;
+
+  /**
+   * @brief keyframes_ with their bezier segments compiled, published along with them
+   */
+  NodeKeyframeCurve curve_;
+
+  /**
+   * @brief Replace the keyframes (compiled into `curve`) and keyframing state and bump the value version
+   */
+  void PublishValues(const QVector<NodeKeyframe>& keyframes, const NodeKeyframeCurve& curve, bool keyframing);
+
+  /**
+   * @brief Take a reference to the current keyframes (and their curve and keyframing state) that no later change will
+   * affect
+   */
+  QVector<NodeKeyframe> TakeSnapshot(NodeKeyframeCurve* curve, bool* keyframing) const;
+
+  /**
+   * @brief Protects keyframes_ and keyframing_ while they're swapped or referenced
+   *
+   * Only ever held to copy or assign the list's pointer to its shared data, never while keyframes are being changed
+   * or evaluated, so readers and writers don't wait on each other for any meaningful time.
+   */
+  mutable QMutex values_lock_;
+
+  /**
+   * @brief Get the index of the last keyframe at or before `time`
+   *
+   * Checks the segment this thread found for this input last time before falling back to a binary search, so
+   * evaluating sequential times is constant time.
+   */
+  int FindKeyframeSegment(const QVector<NodeKeyframe>& keyframes, const rational& time) const;
+
+  /**
+   * @brief Assign a new unique version to this input's values
+   */
+  void BumpValueVersion();
+
+  /**
+   * @brief Internal value version
+   *
+   * \see value_version()
    */
-  QList<NodeKeyframe> keyframes_;
+  quint64 value_version_;
 
   /**
    * @brief Internal keyframing enabled setting
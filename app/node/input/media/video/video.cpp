@@ -5,7 +5,9 @@
 
 #include "core.h"
 #include "decoder/ffmpeg/ffmpegdecoder.h"
+#include "node/distort/transform/transform.h"
 #include "project/item/footage/footage.h"
+#include "project/item/footage/imagestream.h"
 #include "render/pixelservice.h"
 
 VideoInput::VideoInput()
@@ -50,6 +52,11 @@ NodeInput *VideoInput::matrix_input() const
   return matrix_input_;
 }
 
+Node::Precision VideoInput::OutputPrecision() const
+{
+  return kPrecisionInputs;
+}
+
 QString VideoInput::Code() const
 {
   return "#version 110\n"
@@ -64,6 +71,110 @@ QString VideoInput::Code() const
          "}\n";
 }
 
+bool VideoInput::MatrixIsPixelAligned(const QMatrix4x4 &matrix, int width, int height, QPoint *offset)
+{
+  // The row vector (s, t, 0, 1) is multiplied by the matrix, so these are the only elements that affect sampling
+  if (!qFuzzyCompare(matrix(0, 0), 1.0f)
+      || !qFuzzyIsNull(matrix(1, 0))
+      || !qFuzzyIsNull(matrix(0, 1))
+      || !qFuzzyCompare(matrix(1, 1), 1.0f)) {
+    return false;
+  }
+
+  float x = matrix(3, 0) * width;
+  float y = matrix(3, 1) * height;
+
+  int rounded_x = qRound(x);
+  int rounded_y = qRound(y);
+
+  // Allow for what the matrix multiplications may have lost
+  const float kTolerance = 0.001f;
+
+  if (qAbs(x - rounded_x) > kTolerance || qAbs(y - rounded_y) > kTolerance) {
+    return false;
+  }
+
+  *offset = QPoint(rounded_x, rounded_y);
+
+  return true;
+}
+
+QRectF VideoInput::GetDataWindow(const NodeValueDatabase &value, const QHash<NodeInput *, QRectF> &input_windows) const
+{
+  QRectF footage = input_windows.value(footage_input_);
+
+  if (footage.isEmpty()) {
+    return QRectF();
+  }
+
+  // Filtering blends in a little of what's around the footage's edges
+  const qreal kFilterMargin = 0.01;
+  footage.adjust(-kFilterMargin, -kFilterMargin, kFilterMargin, kFilterMargin);
+
+  // The shader maps each pixel's position p to p * matrix in the footage (as a row vector), so the footage covers
+  // the positions its corners map back to
+  QMatrix4x4 matrix = value[matrix_input_].Get(NodeParam::kMatrix).value<QMatrix4x4>();
+
+  qreal a = matrix(0, 0);
+  qreal b = matrix(1, 0);
+  qreal c = matrix(0, 1);
+  qreal d = matrix(1, 1);
+  qreal determinant = a * d - b * c;
+
+  if (qFuzzyIsNull(determinant)) {
+    // Not something that can be mapped back, assume it could be anywhere
+    return QRectF(0, 0, 1, 1);
+  }
+
+  QPointF corners[] = {footage.topLeft(), footage.topRight(), footage.bottomLeft(), footage.bottomRight()};
+  QRectF window;
+
+  for (int i=0;i<4;i++) {
+    qreal s = corners[i].x() - matrix(3, 0);
+    qreal t = corners[i].y() - matrix(3, 1);
+
+    QPointF position((d * s - b * t) / determinant, (a * t - c * s) / determinant);
+
+    if (i == 0) {
+      window = QRectF(position, position);
+    } else {
+      window.setLeft(qMin(window.left(), position.x()));
+      window.setRight(qMax(window.right(), position.x()));
+      window.setTop(qMin(window.top(), position.y()));
+      window.setBottom(qMax(window.bottom(), position.y()));
+    }
+  }
+
+  return window;
+}
+
+Node::Coverage VideoInput::GetCoverage(const rational &time, const QHash<NodeInput *, Node::Coverage> &input_coverage) const
+{
+  Q_UNUSED(time)
+  Q_UNUSED(input_coverage)
+
+  StreamPtr stream = footage_input_->get_value_at_time(0).value<StreamPtr>();
+
+  if (stream == nullptr
+      || (stream->type() != Stream::kVideo && stream->type() != Stream::kImage)
+      || std::static_pointer_cast<ImageStream>(stream)->has_alpha()) {
+    return kCoveragePartial;
+  }
+
+  // Footage is drawn over the whole frame unless it's been transformed
+  Node* transform_node = matrix_input_->get_connected_node();
+
+  if (transform_node != nullptr) {
+    TransformDistort* transform = dynamic_cast<TransformDistort*>(transform_node);
+
+    if (transform == nullptr || !transform->IsIdentity()) {
+      return kCoveragePartial;
+    }
+  }
+
+  return kCoverageFull;
+}
+
 void VideoInput::Retranslate()
 {
   MediaInput::Retranslate();
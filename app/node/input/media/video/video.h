@@ -1,7 +1,9 @@
 #ifndef VIDEOINPUT_H
 #define VIDEOINPUT_H
 
+#include <QMatrix4x4>
 #include <QOpenGLTexture>
+#include <QPoint>
 
 #include "../media.h"
 #include "render/colormanager.h"
@@ -24,6 +26,27 @@ public:
 
   virtual QString Code() const override;
 
+  virtual Precision OutputPrecision() const override;
+
+  /**
+   * @brief Returns whether sampling footage through this matrix (the way Code() does) only moves it by whole pixels
+   *
+   * Footage that's the same size as the output isn't resampled by such a matrix at all, so renderers can copy it (or
+   * use it as it is if `offset` is zero) rather than interpolating. `offset` is set to what's added to an output pixel's
+   * position to find the footage pixel it shows, for footage that's `width` by `height`.
+   */
+  static bool MatrixIsPixelAligned(const QMatrix4x4& matrix, int width, int height, QPoint* offset);
+
+  /**
+   * @brief Full if the footage has no alpha channel and isn't transformed
+   */
+  virtual Coverage GetCoverage(const rational& time, const QHash<NodeInput*, Coverage>& input_coverage) const override;
+
+  /**
+   * @brief Where the footage lands in the frame once it's been transformed (e.g. a picture-in-picture corner)
+   */
+  virtual QRectF GetDataWindow(const NodeValueDatabase& value, const QHash<NodeInput*, QRectF>& input_windows) const override;
+
   virtual void Retranslate() override;
 
 protected:
@@ -0,0 +1,89 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "sequence.h"
+
+SequenceInput::SequenceInput()
+{
+  sequence_input_ = new NodeInput("sequence_in");
+  sequence_input_->set_data_type(NodeInput::kTexture);
+  AddInput(sequence_input_);
+}
+
+Node *SequenceInput::copy() const
+{
+  return new SequenceInput();
+}
+
+QString SequenceInput::Name() const
+{
+  return tr("Sequence Input");
+}
+
+QString SequenceInput::id() const
+{
+  return "org.olivevideoeditor.Olive.sequenceinput";
+}
+
+QString SequenceInput::Category() const
+{
+  return tr("Input");
+}
+
+QString SequenceInput::Description() const
+{
+  return tr("Show another sequence inside this one.");
+}
+
+NodeInput *SequenceInput::sequence_input() const
+{
+  return sequence_input_;
+}
+
+NodeValueTable SequenceInput::Value(const NodeValueDatabase &value) const
+{
+  return value[sequence_input_];
+}
+
+NodeInput *SequenceInput::PassthroughInput(const NodeValueDatabase &value) const
+{
+  Q_UNUSED(value)
+
+  // The inner sequence's frame is shown as it is
+  return sequence_input_;
+}
+
+NodeInput *SequenceInput::CachedPassthroughInput() const
+{
+  return sequence_input_;
+}
+
+Node::Coverage SequenceInput::GetCoverage(const rational &time, const QHash<NodeInput *, Node::Coverage> &input_coverage) const
+{
+  Q_UNUSED(time)
+
+  // Nothing connected shows nothing
+  return input_coverage.value(sequence_input_, kCoverageNone);
+}
+
+void SequenceInput::Retranslate()
+{
+  sequence_input_->set_name(tr("Sequence"));
+}
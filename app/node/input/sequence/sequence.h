@@ -0,0 +1,64 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef SEQUENCEINPUT_H
+#define SEQUENCEINPUT_H
+
+#include "node/node.h"
+
+/**
+ * @brief A node that shows another sequence, so it can be nested in this one as a clip
+ *
+ * The sequence input is connected to the node the inner sequence's viewer shows. Renderers look the inner frame up in
+ * their cache by its own hash before evaluating anything under it (see CachedPassthroughInput()), so an inner frame
+ * that's already been rendered, either by the inner sequence's viewer or for another frame of this one, isn't
+ * rendered again.
+ */
+class SequenceInput : public Node
+{
+  Q_OBJECT
+public:
+  SequenceInput();
+
+  virtual Node* copy() const override;
+
+  virtual QString Name() const override;
+  virtual QString id() const override;
+  virtual QString Category() const override;
+  virtual QString Description() const override;
+
+  NodeInput* sequence_input() const;
+
+  virtual NodeValueTable Value(const NodeValueDatabase& value) const override;
+
+  virtual NodeInput* PassthroughInput(const NodeValueDatabase& value) const override;
+
+  virtual NodeInput* CachedPassthroughInput() const override;
+
+  virtual Coverage GetCoverage(const rational& time, const QHash<NodeInput*, Coverage>& input_coverage) const override;
+
+  virtual void Retranslate() override;
+
+private:
+  NodeInput* sequence_input_;
+
+};
+
+#endif // SEQUENCEINPUT_H
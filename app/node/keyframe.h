@@ -21,6 +21,7 @@
 #ifndef NODEKEYFRAME_H
 #define NODEKEYFRAME_H
 
+#include <QPointF>
 #include <QVariant>
 
 #include "common/rational.h"
@@ -71,12 +72,31 @@ public:
   const Type& type() const;
   void set_type(const Type& type);
 
+  /**
+   * @brief Bezier handle going into this keyframe, relative to it
+   *
+   * X is in seconds (usually negative) and Y is in the value's units. Only used if this keyframe is kBezier. A handle
+   * that's (0, 0), the default, pulls the curve nowhere, so a segment with no handles is a straight line.
+   */
+  const QPointF& bezier_control_in() const;
+  void set_bezier_control_in(const QPointF& control);
+
+  /**
+   * @brief Bezier handle coming out of this keyframe, relative to it (see bezier_control_in())
+   */
+  const QPointF& bezier_control_out() const;
+  void set_bezier_control_out(const QPointF& control);
+
 private:
   rational time_;
 
   QVariant value_;
 
   Type type_;
+
+  QPointF bezier_control_in_;
+
+  QPointF bezier_control_out_;
 };
 
 #endif // NODEKEYFRAME_H
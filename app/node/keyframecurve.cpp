@@ -0,0 +1,173 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#include "keyframecurve.h"
+
+#include <QtMath>
+
+#include "common/lerp.h"
+
+namespace {
+/**
+ * @brief Evaluate a cubic whose coefficients are highest power first and has no constant term
+ */
+double EvaluateCubic(const double* c, double s)
+{
+  return ((c[0] * s + c[1]) * s + c[2]) * s;
+}
+
+/**
+ * @brief Get the coefficients of a one-dimensional cubic bezier from its control points, highest power first
+ */
+void BezierCoefficients(double p0, double p1, double p2, double p3, double* c)
+{
+  c[0] = -p0 + 3.0 * p1 - 3.0 * p2 + p3;
+  c[1] = 3.0 * p0 - 6.0 * p1 + 3.0 * p2;
+  c[2] = 3.0 * (p1 - p0);
+}
+}
+
+NodeKeyframeCurve::NodeKeyframeCurve()
+{
+}
+
+NodeKeyframeCurve::NodeKeyframeCurve(const QVector<NodeKeyframe> &keyframes)
+{
+  bool has_bezier = false;
+
+  for (int i=0;i+1<keyframes.size();i++) {
+    if (keyframes.at(i).type() != NodeKeyframe::kHold
+        && (keyframes.at(i).type() == NodeKeyframe::kBezier || keyframes.at(i+1).type() == NodeKeyframe::kBezier)) {
+      has_bezier = true;
+      break;
+    }
+  }
+
+  // Linear and hold segments have nothing worth precomputing
+  if (!has_bezier) {
+    return;
+  }
+
+  segments_.resize(keyframes.size() - 1);
+
+  for (int i=0;i<segments_.size();i++) {
+    const NodeKeyframe& before = keyframes.at(i);
+    const NodeKeyframe& after = keyframes.at(i+1);
+    Segment& segment = segments_[i];
+
+    segment.bezier = (before.type() != NodeKeyframe::kHold
+                      && (before.type() == NodeKeyframe::kBezier || after.type() == NodeKeyframe::kBezier));
+
+    if (!segment.bezier) {
+      continue;
+    }
+
+    double start = before.time().toDouble();
+    double length = after.time().toDouble() - start;
+
+    segment.start = start;
+    segment.inverse_length = 1.0 / length;
+
+    // A linear end pulls the curve nowhere, which makes it quadratic towards the other end's handle
+    QPointF out = (before.type() == NodeKeyframe::kBezier) ? before.bezier_control_out() : QPointF();
+    QPointF in = (after.type() == NodeKeyframe::kBezier) ? after.bezier_control_in() : QPointF();
+
+    // Handles can't reach past either end of the segment, so time only ever moves forward along the curve
+    double x1 = qBound(0.0, out.x() * segment.inverse_length, 1.0);
+    double x2 = qBound(0.0, 1.0 + in.x() * segment.inverse_length, 1.0);
+
+    BezierCoefficients(0.0, x1, x2, 1.0, segment.x);
+
+    double before_value = before.value().toDouble();
+    double after_value = after.value().toDouble();
+
+    BezierCoefficients(before_value, before_value + out.y(), after_value + in.y(), after_value, segment.y);
+    segment.y[3] = before_value;
+
+    // Invert time by bisection once here, so evaluating only has to refine a close guess
+    segment.table_offset = table_.size();
+
+    for (int j=0;j<kTableSize;j++) {
+      double target = static_cast<double>(j) / (kTableSize - 1);
+      double low = 0.0;
+      double high = 1.0;
+
+      for (int k=0;k<24;k++) {
+        double mid = (low + high) * 0.5;
+
+        if (EvaluateCubic(segment.x, mid) < target) {
+          low = mid;
+        } else {
+          high = mid;
+        }
+      }
+
+      table_.append(static_cast<float>((low + high) * 0.5));
+    }
+  }
+}
+
+bool NodeKeyframeCurve::IsBezier(int segment) const
+{
+  return segment < segments_.size() && segments_.at(segment).bezier;
+}
+
+double NodeKeyframeCurve::Parameter(int segment, double time) const
+{
+  const Segment& s = segments_.at(segment);
+
+  double u = qBound(0.0, (time - s.start) * s.inverse_length, 1.0);
+
+  // Start from the table, the parameter is somewhere between these two entries...
+  double position = u * (kTableSize - 1);
+  int index = qMin(static_cast<int>(position), kTableSize - 2);
+  const float* table = table_.constData() + s.table_offset;
+
+  double low = table[index];
+  double high = table[index + 1];
+  double parameter = lerp(low, high, position - index);
+
+  // ...and refine it. Newton's method gets there fastest, but overshoots where the curve is nearly flat in time, so
+  // anything outside the entries is replaced with a bisection step.
+  for (int i=0;i<kRefineSteps;i++) {
+    double error = EvaluateCubic(s.x, parameter) - u;
+    double slope = (3.0 * s.x[0] * parameter + 2.0 * s.x[1]) * parameter + s.x[2];
+
+    if (error < 0.0) {
+      low = parameter;
+    } else {
+      high = parameter;
+    }
+
+    double next = (qAbs(slope) > 1e-9) ? parameter - error / slope : -1.0;
+
+    parameter = (next >= low && next <= high) ? next : (low + high) * 0.5;
+  }
+
+  return parameter;
+}
+
+double NodeKeyframeCurve::Value(int segment, double parameter) const
+{
+  const Segment& s = segments_.at(segment);
+
+  return EvaluateCubic(s.y, parameter) + s.y[3];
+}
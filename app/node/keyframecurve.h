@@ -0,0 +1,108 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#ifndef NODEKEYFRAMECURVE_H
+#define NODEKEYFRAMECURVE_H
+
+#include <QVector>
+
+#include "keyframe.h"
+
+/**
+ * @brief The bezier segments of a list of keyframes, compiled so they can be evaluated without solving anything
+ *
+ * Each segment's curve is stored as polynomial coefficients, along with a table mapping evenly spaced times to the
+ * curve parameter at that time. Finding a value is then a table lookup, one Newton step and evaluating a cubic.
+ *
+ * Compiled whenever the keyframes change and shared (implicitly) by every copy made of them afterwards.
+ */
+class NodeKeyframeCurve
+{
+public:
+  NodeKeyframeCurve();
+
+  /**
+   * @brief Compile the segments between `keyframes`, which must be in chronological order
+   */
+  NodeKeyframeCurve(const QVector<NodeKeyframe>& keyframes);
+
+  /**
+   * @brief Returns whether the segment from keyframe `segment` to the next one is a bezier curve
+   *
+   * A segment is a curve if either end of it is kBezier, unless it starts on a kHold keyframe.
+   */
+  bool IsBezier(int segment) const;
+
+  /**
+   * @brief Get the curve parameter (0.0 at the start of the segment, 1.0 at the end) at this time in seconds
+   *
+   * This is how far along the segment the value is, so types that aren't scalar can be interpolated with it. Only
+   * valid for bezier segments.
+   */
+  double Parameter(int segment, double time) const;
+
+  /**
+   * @brief Get the value of a bezier segment at this curve parameter (see Parameter())
+   *
+   * Only meaningful for scalar (kFloat) keyframes, other types only follow the curve's timing.
+   */
+  double Value(int segment, double parameter) const;
+
+private:
+  /**
+   * @brief Number of entries in each segment's time to parameter table
+   */
+  static const int kTableSize = 32;
+
+  /**
+   * @brief Number of steps taken from the table towards the exact parameter
+   */
+  static const int kRefineSteps = 2;
+
+  struct Segment {
+    bool bezier;
+
+    double start;
+    double inverse_length;
+
+    /// Coefficients of the cubic for time (normalized to 0.0 - 1.0 over the segment, so it has no constant term)
+    double x[3];
+
+    /// Coefficients of the cubic for the value, highest power first (the last one being the constant term)
+    double y[4];
+
+    /// Index of this segment's first entry in table_
+    int table_offset;
+  };
+
+  /**
+   * @brief One segment per pair of keyframes, or empty if none of them are bezier curves
+   */
+  QVector<Segment> segments_;
+
+  /**
+   * @brief Curve parameter at kTableSize evenly spaced times for each bezier segment
+   */
+  QVector<float> table_;
+
+};
+
+#endif // NODEKEYFRAMECURVE_H
@@ -20,9 +20,36 @@
 
 #include "menu.h"
 
-#include "blend/alphaover/alphaover.h"
+#include "factory.h"
 
 NodeMenu::NodeMenu(QWidget *parent) :
   QMenu(parent)
 {
+  foreach (const NodeFactory::Entry& entry, NodeFactory::Entries()) {
+    QAction* action = CategoryMenu(entry.category)->addAction(entry.name);
+
+    action->setData(entry.id);
+    action->setToolTip(entry.description);
+    action->setStatusTip(entry.description);
+  }
+}
+
+QMenu *NodeMenu::CategoryMenu(const QString &category)
+{
+  if (category.isEmpty()) {
+    return this;
+  }
+
+  QMenu* menu = category_menus_.value(category);
+
+  if (menu == nullptr) {
+    // Subcategories go in their parent category's menu
+    int separator = category.lastIndexOf('/');
+    QMenu* parent = (separator < 0) ? this : CategoryMenu(category.left(separator));
+
+    menu = parent->addMenu(category.mid(separator + 1));
+    category_menus_.insert(category, menu);
+  }
+
+  return menu;
 }
@@ -21,17 +21,29 @@
 #ifndef NODEMENU_H
 #define NODEMENU_H
 
+#include <QHash>
 #include <QMenu>
 
 #include "node.h"
 
+/**
+ * @brief A menu of every Node type, in submenus by category (see Node::Category())
+ *
+ * Built from NodeFactory::Entries(), so no Nodes are created for it. Each action's data is the ID of its Node type
+ * for NodeFactory::CreateFromID().
+ */
 class NodeMenu : public QMenu
 {
 public:
   NodeMenu(QWidget* parent = nullptr);
 
 private:
+  /**
+   * @brief Find or create the submenu for a "/" separated category
+   */
+  QMenu* CategoryMenu(const QString& category);
 
+  QHash<QString, QMenu*> category_menus_;
 
 };
 
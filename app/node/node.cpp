@@ -22,8 +22,12 @@
 
 #include <QDebug>
 
+int Node::invalidate_depth_ = 0;
+QHash<NodeInput*, TimeRangeList> Node::invalidated_inputs_;
+
 Node::Node() :
-  can_be_deleted_(true)
+  can_be_deleted_(true),
+  bypassed_(0)
 {
   output_ = new NodeOutput("node_out");
   AddParameter(output_);
@@ -99,6 +103,43 @@ NodeValueTable Node::Value(const NodeValueDatabase &value) const
   return NodeValueTable();
 }
 
+NodeInput *Node::PassthroughInput(const NodeValueDatabase &value) const
+{
+  Q_UNUSED(value)
+
+  return nullptr;
+}
+
+NodeInput *Node::CachedPassthroughInput() const
+{
+  return nullptr;
+}
+
+Node::Coverage Node::GetCoverage(const rational &time, const QHash<NodeInput *, Node::Coverage> &input_coverage) const
+{
+  Q_UNUSED(time)
+  Q_UNUSED(input_coverage)
+
+  return kCoveragePartial;
+}
+
+bool Node::InputIsHidden(NodeInput *input, const rational &time, const QHash<NodeInput *, Node::Coverage> &input_coverage) const
+{
+  Q_UNUSED(input)
+  Q_UNUSED(time)
+  Q_UNUSED(input_coverage)
+
+  return false;
+}
+
+QRectF Node::GetDataWindow(const NodeValueDatabase &value, const QHash<NodeInput *, QRectF> &input_windows) const
+{
+  Q_UNUSED(value)
+  Q_UNUSED(input_windows)
+
+  return QRectF(0, 0, 1, 1);
+}
+
 void Node::InvalidateCache(const rational &start_range, const rational &end_range, NodeInput *from)
 {
   Q_UNUSED(from)
@@ -117,6 +158,13 @@ TimeRange Node::InputTimeAdjustment(NodeInput *input, const TimeRange &input_tim
 
 void Node::SendInvalidateCache(const rational &start_range, const rational &end_range)
 {
+  // A node reached along more than one path (e.g. both sides of a blend of the same source) would otherwise be sent
+  // the same range once per path, and every node after it as many times again. Inputs that have already been sent
+  // these times during this propagation are skipped.
+  invalidate_depth_++;
+
+  TimeRange range(start_range, end_range);
+
   // Loop through all parameters (there should be no children that are not NodeParams)
   foreach (NodeParam* param, params_) {
     // If the Node is an output, relay the signal to any Nodes that are connected to it
@@ -128,11 +176,25 @@ void Node::SendInvalidateCache(const rational &start_range, const rational &end_
         NodeInput* connected_input = edge->input();
         Node* connected_node = connected_input->parentNode();
 
+        TimeRangeList& sent = invalidated_inputs_[connected_input];
+
+        if (sent.ContainsTimeRange(range)) {
+          continue;
+        }
+
+        sent.InsertTimeRange(range);
+
         // Send clear cache signal to the Node
         connected_node->InvalidateCache(start_range, end_range, connected_input);
       }
     }
   }
+
+  invalidate_depth_--;
+
+  if (invalidate_depth_ == 0) {
+    invalidated_inputs_.clear();
+  }
 }
 
 void Node::DependentEdgeChanged(NodeInput *from)
@@ -167,12 +229,13 @@ void Node::CopyInputs(Node *source, Node *destination, bool include_connections)
 {
   Q_ASSERT(source->id() == destination->id());
 
-  source->LockUserInput();
-  destination->LockUserInput();
-
+  // Values are published to each input atomically (see NodeInput::CopyValues()), so render threads can keep reading
+  // the destination while it's updated without the whole Node being locked
   const QList<NodeParam*>& src_param = source->params_;
   const QList<NodeParam*>& dst_param = destination->params_;
 
+  destination->bypassed_.store(source->bypassed_.load());
+
   for (int i=0;i<src_param.size();i++) {
     NodeParam* p = src_param.at(i);
 
@@ -186,26 +249,25 @@ void Node::CopyInputs(Node *source, Node *destination, bool include_connections)
       }
     }
   }
-
-  source->UnlockUserInput();
-  destination->UnlockUserInput();
 }
 
-void DuplicateConnectionsBetweenListsInternal(const QList<Node *> &source, const QList<Node *> &destination, NodeInput* source_input, NodeInput* dest_input)
+void DuplicateConnectionsBetweenListsInternal(const QHash<Node *, Node *> &copies, NodeInput* source_input, NodeInput* dest_input)
 {
   if (source_input->IsConnected()) {
     // Get this input's connected outputs
     NodeOutput* source_output = source_input->get_connected_output();
     Node* source_output_node = source_output->parentNode();
 
-    // Find equivalent in destination list
-    Node* dest_output_node = destination.at(source.indexOf(source_output_node));
+    // Find equivalent in destination list, connections to nodes outside the source list aren't duplicated
+    Node* dest_output_node = copies.value(source_output_node);
 
-    Q_ASSERT(dest_output_node->id() == source_output_node->id());
+    if (dest_output_node != nullptr) {
+      Q_ASSERT(dest_output_node->id() == source_output_node->id());
 
-    NodeOutput* dest_output = static_cast<NodeOutput*>(dest_output_node->GetParameterWithID(source_output->id()));
+      NodeOutput* dest_output = static_cast<NodeOutput*>(dest_output_node->GetParameterWithID(source_output->id()));
 
-    NodeParam::ConnectEdge(dest_output, dest_input);
+      NodeParam::ConnectEdge(dest_output, dest_input);
+    }
   }
 
   // If inputs are arrays, duplicate their connections too
@@ -214,7 +276,7 @@ void DuplicateConnectionsBetweenListsInternal(const QList<Node *> &source, const
     NodeInputArray* dest_array = static_cast<NodeInputArray*>(dest_input);
 
     for (int i=0;i<source_array->GetSize();i++) {
-      DuplicateConnectionsBetweenListsInternal(source, destination, source_array->ParamAt(i), dest_array->ParamAt(i));
+      DuplicateConnectionsBetweenListsInternal(copies, source_array->ParamAt(i), dest_array->ParamAt(i));
     }
   }
 }
@@ -223,6 +285,14 @@ void Node::DuplicateConnectionsBetweenLists(const QList<Node *> &source, const Q
 {
   Q_ASSERT(source.size() == destination.size());
 
+  // Looking each connected node up in a hash rather than the list keeps this linear in the number of connections
+  QHash<Node*, Node*> copies;
+  copies.reserve(source.size());
+
+  for (int i=0;i<source.size();i++) {
+    copies.insert(source.at(i), destination.at(i));
+  }
+
   for (int i=0;i<source.size();i++) {
     Node* source_input_node = source.at(i);
     Node* dest_input_node = destination.at(i);
@@ -236,7 +306,7 @@ void Node::DuplicateConnectionsBetweenLists(const QList<Node *> &source, const Q
         NodeInput* source_input = static_cast<NodeInput*>(source_param);
         NodeInput* dest_input = static_cast<NodeInput*>(dest_input_node->params_.at(j));
 
-        DuplicateConnectionsBetweenListsInternal(source, destination, source_input, dest_input);
+        DuplicateConnectionsBetweenListsInternal(copies, source_input, dest_input);
       }
     }
   }
@@ -252,6 +322,44 @@ void Node::SetCanBeDeleted(bool s)
   can_be_deleted_ = s;
 }
 
+bool Node::IsBypassed() const
+{
+  return bypassed_.load() != 0;
+}
+
+void Node::SetBypassed(bool e)
+{
+  if (IsBypassed() == e) {
+    return;
+  }
+
+  bypassed_.store(e ? 1 : 0);
+
+  // Blocks and tracks narrow this down to the time they take up
+  InvalidateCache(RATIONAL_MIN, RATIONAL_MAX);
+
+  emit Changed();
+}
+
+NodeInput *Node::MainInput() const
+{
+  NodeInput* samples = nullptr;
+
+  foreach (NodeParam* param, params_) {
+    if (param->type() == NodeParam::kInput) {
+      NodeInput* input = static_cast<NodeInput*>(param);
+
+      if (input->data_type() == NodeParam::kTexture) {
+        return input;
+      } else if (input->data_type() == NodeParam::kSamples && samples == nullptr) {
+        samples = input;
+      }
+    }
+  }
+
+  return samples;
+}
+
 bool Node::IsBlock() const
 {
   return false;
@@ -272,14 +380,16 @@ int Node::IndexOfParameter(NodeParam *param) const
   return params_.indexOf(param);
 }
 
-void Node::TraverseInputInternal(QList<Node*>& list, NodeInput* input, bool traverse) {
+void Node::TraverseInputInternal(QList<Node*>& list, QSet<Node*>& visited, NodeInput* input, bool traverse) {
   Node* connected = input->get_connected_node();
 
-  if (connected != nullptr && !list.contains(connected)) {
+  // `visited` mirrors `list` so each check is constant time rather than a scan of everything found so far
+  if (connected != nullptr && !visited.contains(connected)) {
+    visited.insert(connected);
     list.append(connected);
 
     if (traverse) {
-      GetDependenciesInternal(connected, list, traverse);
+      GetDependenciesInternal(connected, list, visited, traverse);
     }
   }
 
@@ -287,7 +397,7 @@ void Node::TraverseInputInternal(QList<Node*>& list, NodeInput* input, bool trav
     NodeInputArray* input_array = static_cast<NodeInputArray*>(input);
 
     for (int i=0;i<input_array->GetSize();i++) {
-      TraverseInputInternal(list, input_array->ParamAt(i), traverse);
+      TraverseInputInternal(list, visited, input_array->ParamAt(i), traverse);
     }
   }
 }
@@ -295,17 +405,21 @@ void Node::TraverseInputInternal(QList<Node*>& list, NodeInput* input, bool trav
 /**
  * @brief Recursively collects dependencies of Node `n` and appends them to QList `list`
  *
+ * @param visited
+ *
+ * Every Node in `list`, used to skip Nodes that have already been found.
+ *
  * @param traverse
  *
  * TRUE to recursively traverse each node for a complete dependency graph. FALSE to return only the immediate
  * dependencies.
  */
-void Node::GetDependenciesInternal(const Node* n, QList<Node*>& list, bool traverse) {
+void Node::GetDependenciesInternal(const Node* n, QList<Node*>& list, QSet<Node*>& visited, bool traverse) {
   foreach (NodeParam* p, n->parameters()) {
     if (p->type() == NodeParam::kInput) {
       NodeInput* input = static_cast<NodeInput*>(p);
 
-      TraverseInputInternal(list, input, traverse);
+      TraverseInputInternal(list, visited, input, traverse);
     }
   }
 }
@@ -313,8 +427,9 @@ void Node::GetDependenciesInternal(const Node* n, QList<Node*>& list, bool trave
 QList<Node *> Node::GetDependencies() const
 {
   QList<Node *> node_list;
+  QSet<Node *> visited;
 
-  GetDependenciesInternal(this, node_list, true);
+  GetDependenciesInternal(this, node_list, visited, true);
 
   return node_list;
 }
@@ -323,38 +438,67 @@ QList<Node *> Node::GetExclusiveDependencies() const
 {
   QList<Node*> deps = GetDependencies();
 
-  // Filter out any dependencies that are used elsewhere
-  for (int i=0;i<deps.size();i++) {
-    QList<NodeParam*> params = deps.at(i)->params_;
-
-    // See if any of this Node's outputs are used outside of this dep list
-    for (int j=0;j<params.size();j++) {
-      NodeParam* p = params.at(j);
-
-      if (p->type() == NodeParam::kOutput) {
-        foreach (NodeEdgePtr edge, p->edges()) {
-          // If any edge goes to from an output here to an input of a Node that isn't in this dep list, it's NOT an
-          // exclusive dependency
-          if (deps.contains(edge->input()->parentNode())) {
-            deps.removeAt(i);
-
-            i--;                // -1 since we just removed a Node in this list
-            j = params.size();  // No need to keep looking at this Node's params
-            break;              // Or this param's edges
-          }
+  // Nodes that are only used by this Node or other exclusive dependencies. Starts with every dependency and drops the
+  // ones found to be used elsewhere, which may in turn mean the ones they depend on are used elsewhere too.
+  QSet<const Node*> exclusive;
+  exclusive.insert(this);
+
+  foreach (Node* dep, deps) {
+    exclusive.insert(dep);
+  }
+
+  // Each Node is checked again whenever one of the Nodes it outputs to is dropped, so this is linear in the number of
+  // edges
+  QList<Node*> to_check = deps;
+
+  while (!to_check.isEmpty()) {
+    Node* dep = to_check.takeLast();
+
+    if (!exclusive.contains(dep) || !dep->IsUsedOutside(exclusive)) {
+      continue;
+    }
+
+    exclusive.remove(dep);
+
+    foreach (Node* immediate, dep->GetImmediateDependencies()) {
+      if (immediate != this && exclusive.contains(immediate)) {
+        to_check.append(immediate);
+      }
+    }
+  }
+
+  QList<Node*> exclusive_deps;
+
+  foreach (Node* dep, deps) {
+    if (exclusive.contains(dep)) {
+      exclusive_deps.append(dep);
+    }
+  }
+
+  return exclusive_deps;
+}
+
+bool Node::IsUsedOutside(const QSet<const Node *> &nodes) const
+{
+  foreach (NodeParam* p, params_) {
+    if (p->type() == NodeParam::kOutput) {
+      foreach (NodeEdgePtr edge, p->edges()) {
+        if (!nodes.contains(edge->input()->parentNode())) {
+          return true;
         }
       }
     }
   }
 
-  return deps;
+  return false;
 }
 
 QList<Node *> Node::GetImmediateDependencies() const
 {
   QList<Node *> node_list;
+  QSet<Node *> visited;
 
-  GetDependenciesInternal(this, node_list, false);
+  GetDependenciesInternal(this, node_list, visited, false);
 
   return node_list;
 }
@@ -364,6 +508,42 @@ QString Node::Code() const
   return QString();
 }
 
+QString Node::PointwiseCode() const
+{
+  return QString();
+}
+
+QString Node::ComputeCode() const
+{
+  return QString();
+}
+
+QSize Node::ComputeOutputSize(const QSize &frame_size) const
+{
+  return frame_size;
+}
+
+bool Node::ProcessesSamples() const
+{
+  return false;
+}
+
+void Node::ProcessSamples(AudioBlock *block, AudioBuffer *buffer) const
+{
+  Q_UNUSED(block)
+  Q_UNUSED(buffer)
+}
+
+rational Node::SamplePreRoll() const
+{
+  return rational();
+}
+
+Node::Precision Node::OutputPrecision() const
+{
+  return kPrecisionFrame;
+}
+
 NodeParam *Node::GetParameterWithID(const QString &id) const
 {
   foreach (NodeParam* param, params_) {
@@ -476,6 +656,8 @@ void Node::DisconnectInput(NodeInput *input)
 void Node::InputChanged(rational start, rational end)
 {
   InvalidateCache(start, end, static_cast<NodeInput*>(sender()));
+
+  emit Changed();
 }
 
 void Node::InputConnectionChanged(NodeEdgePtr edge)
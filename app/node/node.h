@@ -22,16 +22,24 @@
 #define NODE_H
 
 #include <QCryptographicHash>
+#include <QHash>
 #include <QMutex>
 #include <QObject>
+#include <QRectF>
+#include <QSet>
+#include <QSize>
 
 #include "common/rational.h"
+#include "common/timerange.h"
 #include "node/dependency.h"
 #include "node/input.h"
 #include "node/inputarray.h"
 #include "node/output.h"
 #include "node/value.h"
 
+class AudioBlock;
+class AudioBuffer;
+
 /**
  * @brief A single processing unit that can be connected with others to create intricate processing systems
  *
@@ -141,6 +149,77 @@ public:
    */
   virtual QString Code() const;
 
+  /**
+   * @brief GLSL body of a function returning this Node's output color for a single pixel
+   *
+   * Only for Nodes whose output at a pixel depends on nothing but their inputs at that same pixel. Each input is an
+   * argument named after its ID (textures are the vec4 color at this pixel). Chains of these Nodes are fused into
+   * one shader pass, in which case their Value() isn't called. The default returns an empty string (not pointwise).
+   */
+  virtual QString PointwiseCode() const;
+
+  /**
+   * @brief GLSL compute shader to run instead of a fragment shader, for work that isn't one output pixel per pixel
+   *
+   * Used when Code() is empty. Inputs are uniforms named after their IDs as with Code(), and the result is written to
+   * `layout(binding = 0) writeonly uniform image2D olive_output`. One invocation is dispatched per output pixel
+   * (rounded up to the shader's work group size), and the output texture is then passed on like any other. The
+   * default returns an empty string (no compute shader).
+   */
+  virtual QString ComputeCode() const;
+
+  /**
+   * @brief Size of the texture ComputeCode() writes to for a frame of `frame_size` (e.g. 256x1 for a histogram)
+   *
+   * Defaults to the frame size.
+   */
+  virtual QSize ComputeOutputSize(const QSize& frame_size) const;
+
+  /**
+   * @brief Returns whether this Node changes the samples of its MainInput() with ProcessSamples() (FALSE by default)
+   */
+  virtual bool ProcessesSamples() const;
+
+  /**
+   * @brief Process one block of MainInput()'s samples in place
+   *
+   * The audio equivalent of Code(). Renderers call this after Value() for each block of the samples in turn (see
+   * AudioBlock) and output the result as this Node's samples. Parameters should be read through `block` so keyframes
+   * are followed sample by sample, and the kernels in render/audiokernels.h used to keep stacks of effects cheap. The
+   * default does nothing.
+   */
+  virtual void ProcessSamples(AudioBlock* block, AudioBuffer* buffer) const;
+
+  /**
+   * @brief How much of MainInput() before each render job this Node processes first (0 by default)
+   *
+   * Jobs are rendered separately and in any order, so AudioBlock::State() starts from zero in each one. Nodes that keep
+   * state (e.g. filters) should return how long their output takes to stop depending on where it started. Renderers
+   * process that much audio before the job and discard it, so the state has settled by the job boundary.
+   */
+  virtual rational SamplePreRoll() const;
+
+  /**
+   * @brief How precise the texture this node's shader draws into needs to be
+   */
+  enum Precision {
+    /// The format frames are being rendered in
+    kPrecisionFrame,
+
+    /// The widest format of the textures it's drawn from (but no wider than the frame's), for nodes that only move,
+    /// scale or mix their inputs and so can't create detail an 8-bit input doesn't have
+    kPrecisionInputs,
+
+    /// 32-bit float whatever the frame's format, for nodes that would lose detail in half-float (e.g. accumulating
+    /// many samples)
+    kPrecisionFull
+  };
+
+  /**
+   * @brief How precise this node's output texture needs to be, the default is kPrecisionFrame
+   */
+  virtual Precision OutputPrecision() const;
+
   /**
    * @brief Returns the parameter with the specified ID (or nullptr if it doesn't exist)
    */
@@ -201,7 +280,9 @@ public:
   virtual TimeRange InputTimeAdjustment(NodeInput* input, const TimeRange& input_time) const;
 
   /**
-   * @brief User input lock prevents any user changes while a graph is being rendered
+   * @brief User input lock prevents changes to this Node's connections and Block timing while they're being read
+   *
+   * Input values don't use this lock, NodeInput publishes them so readers never wait on a change (or vice versa).
    */
   void LockUserInput();
   void UnlockUserInput();
@@ -228,6 +309,27 @@ public:
    */
   void SetCanBeDeleted(bool s);
 
+  /**
+   * @brief Returns whether this Node is bypassed, in which case renderers output MainInput()'s value instead of running it
+   */
+  bool IsBypassed() const;
+
+  /**
+   * @brief Set whether this Node is bypassed (FALSE by default)
+   *
+   * Bypassing is evaluated when rendering, so turning it on or off only invalidates the time this Node affects rather
+   * than changing the graph.
+   */
+  void SetBypassed(bool e);
+
+  /**
+   * @brief The input whose value this Node outputs when it's bypassed
+   *
+   * The default is the first texture input, or the first samples input if there isn't one. A bypassed Node without
+   * either outputs nothing.
+   */
+  virtual NodeInput* MainInput() const;
+
   /**
    * @brief Returns whether this Node is a "Block" type or not
    *
@@ -259,6 +361,76 @@ public:
    */
   virtual NodeValueTable Value(const NodeValueDatabase& value) const;
 
+  /**
+   * @brief If this node wouldn't change anything with these input values, return the input it would pass through
+   *
+   * The renderer uses this to skip nodes that are doing nothing (e.g. an opacity of 100%) rather than running them,
+   * and uses that input's value as this node's output instead. The default returns nullptr (always run the node).
+   */
+  virtual NodeInput* PassthroughInput(const NodeValueDatabase& value) const;
+
+  /**
+   * @brief An input whose value this node always outputs as it is and that renderers may look up in their cache
+   *
+   * Used for nodes that show another sequence. Before evaluating anything connected to this input, renderers check
+   * whether they already have that node's frame cached (under the same hash the other sequence's own viewer caches it
+   * with) and only evaluate it if they don't. The default returns nullptr.
+   */
+  virtual NodeInput* CachedPassthroughInput() const;
+
+  /**
+   * @brief How much of the frame a node's texture covers
+   */
+  enum Coverage {
+    /// Anything else, including when it can't be known without rendering
+    kCoveragePartial,
+
+    /// Every pixel is fully transparent, which is the same as there being no texture at all
+    kCoverageNone,
+
+    /// Every pixel is fully opaque
+    kCoverageFull
+  };
+
+  /**
+   * @brief Work out how much of the frame this node's output covers at `time` without rendering anything
+   *
+   * @param input_coverage
+   *
+   * The coverage of whatever's connected to each of this node's connected inputs (at the time it's needed).
+   *
+   * The renderer doesn't render nodes that are kCoverageNone, or anything they depend on, and they output nothing. It
+   * also uses this to decide what InputIsHidden(), so derivatives must only return kCoverageNone or kCoverageFull when
+   * they're certain. The default returns kCoveragePartial.
+   */
+  virtual Coverage GetCoverage(const rational& time, const QHash<NodeInput*, Coverage>& input_coverage) const;
+
+  /**
+   * @brief Returns whether whatever's connected to `input` can't affect this node's output at `time`
+   *
+   * For example, a layer that's completely covered by an opaque one. The renderer doesn't render it (or decode any
+   * footage it needs), the input's value is left empty instead. The default returns FALSE.
+   */
+  virtual bool InputIsHidden(NodeInput* input, const rational& time, const QHash<NodeInput*, Coverage>& input_coverage) const;
+
+  /**
+   * @brief Work out the part of the frame this node's texture can be non-transparent in (its data window)
+   *
+   * Windows are in texture coordinates, so (0, 0, 1, 1) is the whole frame.
+   *
+   * @param value
+   *
+   * The same input values Value() gets.
+   *
+   * @param input_windows
+   *
+   * The data window of each texture input. Inputs without a texture aren't in it and are fully transparent.
+   *
+   * Renderers only draw a node's texture inside its data window and leave the rest transparent, so a layer that only
+   * covers a corner of the frame only costs that corner. The default returns the whole frame.
+   */
+  virtual QRectF GetDataWindow(const NodeValueDatabase& value, const QHash<NodeInput*, QRectF>& input_windows) const;
+
   /**
    * @brief Return whether a parameter with ID `id` has already been added to this Node
    */
@@ -296,6 +468,13 @@ signals:
    */
   void EdgeRemoved(NodeEdgePtr edge);
 
+  /**
+   * @brief Signal emitted when anything about this node that's saved in a project changes (e.g. an input's value)
+   *
+   * Connections have their own signals (EdgeAdded() and EdgeRemoved()) and don't emit this.
+   */
+  void Changed();
+
 private:
   /**
    * @brief Add a parameter to this node
@@ -312,9 +491,14 @@ private:
 
   void DisconnectInput(NodeInput* input);
 
-  static void TraverseInputInternal(QList<Node*>& list, NodeInput* input, bool traverse);
+  /**
+   * @brief Returns whether any of this Node's outputs are connected to a Node that isn't in `nodes`
+   */
+  bool IsUsedOutside(const QSet<const Node*>& nodes) const;
 
-  static void GetDependenciesInternal(const Node* n, QList<Node*>& list, bool traverse);
+  static void TraverseInputInternal(QList<Node*>& list, QSet<Node*>& visited, NodeInput* input, bool traverse);
+
+  static void GetDependenciesInternal(const Node* n, QList<Node*>& list, QSet<Node*>& visited, bool traverse);
 
   QList<NodeParam *> params_;
 
@@ -328,11 +512,28 @@ private:
    */
   bool can_be_deleted_;
 
+  /**
+   * @brief Internal variable for whether this Node is bypassed, read by render threads from copied graphs
+   */
+  QAtomicInt bypassed_;
+
   /**
    * @brief Primary node output
    */
   NodeOutput* output_;
 
+  /**
+   * @brief How many SendInvalidateCache() calls are in progress, so the outermost one knows when it's finished
+   */
+  static int invalidate_depth_;
+
+  /**
+   * @brief Ranges each input has been sent since the outermost SendInvalidateCache() call started
+   *
+   * Invalidation only ever happens in the main thread, so these aren't locked.
+   */
+  static QHash<NodeInput*, TimeRangeList> invalidated_inputs_;
+
 private slots:
   void InputChanged(rational start, rational end);
 
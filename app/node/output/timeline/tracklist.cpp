@@ -140,7 +140,8 @@ void TrackList::AddTrack()
     NodeParam::ConnectEdge(track->output(), current_last_track->track_input());
 
     // FIXME: Test code only
-    if (current_last_track->output()->IsConnected()) {
+    // Audio tracks don't need this, the audio renderer mixes every track chained to the first one
+    if (type_ == kTrackTypeVideo && current_last_track->output()->IsConnected()) {
       AlphaOverBlend* blend = new AlphaOverBlend();
       GetParentGraph()->AddNode(blend);
 
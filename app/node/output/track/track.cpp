@@ -28,7 +28,8 @@
 TrackOutput::TrackOutput() :
   track_type_(kTrackTypeNone),
   block_invalidate_cache_stack_(0),
-  index_(-1)
+  index_(-1),
+  positions_version_(1)
 {
   block_input_ = new NodeInputArray("block_in");
   AddInput(block_input_);
@@ -39,6 +40,41 @@ TrackOutput::TrackOutput() :
   track_input_ = new NodeInput("track_in");
   track_input_->set_dependent(false);
   AddInput(track_input_);
+
+  volume_input_ = new NodeInput("volume_in");
+  volume_input_->set_data_type(NodeParam::kFloat);
+  volume_input_->set_value_at_time(0, 100);
+  volume_input_->set_minimum(0);
+  AddInput(volume_input_);
+
+  pan_input_ = new NodeInput("pan_in");
+  pan_input_->set_data_type(NodeParam::kFloat);
+  pan_input_->set_value_at_time(0, 0);
+  pan_input_->set_minimum(-100);
+  pan_input_->set_maximum(100);
+  AddInput(pan_input_);
+
+  // Read when rendering rather than changing the graph, so toggling them only invalidates this track's time
+  muted_input_ = new NodeInput("muted_in");
+  muted_input_->set_data_type(NodeParam::kBoolean);
+  muted_input_->set_value_at_time(0, false);
+  AddInput(muted_input_);
+
+  solo_input_ = new NodeInput("solo_in");
+  solo_input_->set_data_type(NodeParam::kBoolean);
+  solo_input_->set_value_at_time(0, false);
+  AddInput(solo_input_);
+}
+
+TrackOutput::~TrackOutput()
+{
+  // Blocks that outlive this track keep the position they had in it
+  foreach (Block* b, block_cache_) {
+    if (b && b->track_ == this) {
+      GetBlockPosition(b, nullptr, nullptr);
+      b->track_ = nullptr;
+    }
+  }
 }
 
 void TrackOutput::set_track_type(const TrackType &track_type)
@@ -103,68 +139,167 @@ NodeInput *TrackOutput::track_input()
   return track_input_;
 }
 
-Block *TrackOutput::BlockContainingTime(const rational &time) const
+NodeInput *TrackOutput::volume_input() const
 {
-  foreach (Block* block, block_cache_) {
-    if (block->in() < time && block->out() > time) {
-      return block;
-    } else if (block->out() == time) {
-      break;
+  return volume_input_;
+}
+
+NodeInput *TrackOutput::pan_input() const
+{
+  return pan_input_;
+}
+
+NodeInput *TrackOutput::muted_input() const
+{
+  return muted_input_;
+}
+
+NodeInput *TrackOutput::solo_input() const
+{
+  return solo_input_;
+}
+
+bool TrackOutput::IsMuted(const rational &time) const
+{
+  return muted_input_->get_value_at_time(time).toBool();
+}
+
+bool TrackOutput::IsSoloed(const rational &time) const
+{
+  return solo_input_->get_value_at_time(time).toBool();
+}
+
+QList<TrackOutput *> TrackOutput::TrackChain()
+{
+  QList<TrackOutput*> tracks;
+
+  for (TrackOutput* t=this; t!=nullptr && !tracks.contains(t); t=t->next_track()) {
+    tracks.append(t);
+  }
+
+  return tracks;
+}
+
+bool TrackOutput::IsSkipped(const QList<TrackOutput *> &tracks, TrackOutput *track, const rational &time)
+{
+  if (track->IsMuted(time)) {
+    return true;
+  }
+
+  if (track->IsSoloed(time)) {
+    return false;
+  }
+
+  foreach (TrackOutput* t, tracks) {
+    if (t->IsSoloed(time)) {
+      return true;
     }
   }
 
-  return nullptr;
+  return false;
+}
+
+Block *TrackOutput::BlockContainingTime(const rational &time) const
+{
+  Block* block = nullptr;
+
+  positions_lock_.lock();
+
+  // First Block whose out point is after this time
+  int index = FirstSlotEndingAfter(time, false);
+
+  if (index < block_cache_.size() && LengthBefore(index) < time) {
+    block = block_cache_.at(index);
+  }
+
+  positions_lock_.unlock();
+
+  return block;
 }
 
 Block *TrackOutput::NearestBlockBefore(const rational &time) const
 {
-  foreach (Block* block, block_cache_) {
-    // Blocks are sorted by time, so the first Block who's out point is at/after this time is the correct Block
-    if (block->out() >= time) {
-      return block;
-    }
+  Block* block = nullptr;
+
+  positions_lock_.lock();
+
+  // Blocks are sorted by time, so the first Block who's out point is at/after this time is the correct Block
+  int index = NextBlockIndex(FirstSlotEndingAfter(time, true));
+
+  if (index < block_cache_.size()) {
+    block = block_cache_.at(index);
   }
 
-  return nullptr;
+  positions_lock_.unlock();
+
+  return block;
 }
 
 Block *TrackOutput::NearestBlockAfter(const rational &time) const
 {
-  foreach (Block* block, block_cache_) {
-    // Blocks are sorted by time, so the first Block after this time is the correct Block
-    if (block->in() >= time) {
-      return block;
-    }
+  Block* block = nullptr;
+
+  positions_lock_.lock();
+
+  // Blocks are sorted by time, so the first Block after this time is the correct Block. If the first Block ending
+  // after this time starts before it, it contains the time and the one after it is the correct Block.
+  int index = FirstSlotEndingAfter(time, false);
+
+  if (index < block_cache_.size() && LengthBefore(index) < time) {
+    index++;
   }
 
-  return nullptr;
+  index = NextBlockIndex(index);
+
+  if (index < block_cache_.size()) {
+    block = block_cache_.at(index);
+  }
+
+  positions_lock_.unlock();
+
+  return block;
 }
 
 Block *TrackOutput::BlockAtTime(const rational &time) const
 {
-  foreach (Block* block, block_cache_) {
-    if (block
-        && block->in() <= time
-        && block->out() > time) {
-      return block;
-    }
+  Block* block = nullptr;
+
+  positions_lock_.lock();
+
+  int index = FirstSlotEndingAfter(time, false);
+
+  if (index < block_cache_.size() && LengthBefore(index) <= time) {
+    block = block_cache_.at(index);
   }
 
-  return nullptr;
+  positions_lock_.unlock();
+
+  return block;
 }
 
 QList<Block *> TrackOutput::BlocksAtTimeRange(const TimeRange &range) const
 {
   QList<Block*> list;
 
-  foreach (Block* block, block_cache_) {
-    if (block
-        && block->out() > range.in()
-        && block->in() < range.out()) {
-      list.append(block);
+  positions_lock_.lock();
+
+  // Start from the first Block that ends after the range starts and stop once they start after it ends
+  int index = FirstSlotEndingAfter(range.in(), false);
+  rational in = LengthBefore(index);
+
+  while (index < block_cache_.size() && in < range.out()) {
+    Block* b = block_cache_.at(index);
+
+    if (b) {
+      list.append(b);
     }
+
+    in += slot_lengths_.at(index);
+    index++;
   }
 
+  positions_lock_.unlock();
+
   return list;
 }
 
@@ -175,22 +310,48 @@ const QVector<Block *> &TrackOutput::Blocks() const
 
 void TrackOutput::InvalidateCache(const rational &start_range, const rational &end_range, NodeInput *from)
 {
-  /*// We intercept IC signals from Blocks since we may be performing several options and they may over-signal
-  if (from == previous_input() && block_invalidate_cache_stack_ == 0) {
-    Node::InvalidateCache(qMax(start_range, rational(0)), qMin(end_range, in()), from);
-  } else {
-  }*/
+  // If a Block's contents changed (rather than the block list itself), it can only affect the time the Block occupies
+  // on this track, so there's no need to invalidate anything outside of it
+  int block_index = block_input_->IndexOfSubParameter(from);
+
+  if (block_index >= 0) {
+    Block* block = block_cache_.at(block_index);
+
+    if (block) {
+      rational start = qMax(start_range, block->in());
+      rational end = qMin(end_range, block->out());
+
+      if (start < end) {
+        Node::InvalidateCache(start, end, from);
+      }
+
+      return;
+    }
+  }
+
+  // Muting only changes the time this track has Blocks in (soloing changes every other track too)
+  if (from == muted_input_) {
+    rational start = qMax(start_range, rational(0));
+    rational end = qMin(end_range, track_length_);
+
+    if (start < end) {
+      Node::InvalidateCache(start, end, from);
+    }
+
+    return;
+  }
+
   Node::InvalidateCache(start_range, end_range, from);
 }
 
 void TrackOutput::InsertBlockBefore(Block* block, Block* after)
 {
-  InsertBlockAtIndex(block, block_cache_.indexOf(after));
+  InsertBlockAtIndex(block, block_indices_.value(after, -1));
 }
 
 void TrackOutput::InsertBlockAfter(Block *block, Block *before)
 {
-  int before_index = block_cache_.indexOf(before);
+  int before_index = block_indices_.value(before, -1);
 
   Q_ASSERT(before_index >= 0);
 
@@ -263,7 +424,7 @@ void TrackOutput::RippleRemoveBlock(Block *block)
 
   rational remove_in = block->in();
 
-  int index_of_block_to_remove = block_cache_.indexOf(block);
+  int index_of_block_to_remove = block_indices_.value(block, -1);
 
   block_input_->RemoveAt(index_of_block_to_remove);
 
@@ -282,7 +443,7 @@ void TrackOutput::ReplaceBlock(Block *old, Block *replace)
 
   AddBlockToGraph(replace);
 
-  int index_of_old_block = block_cache_.indexOf(old);
+  int index_of_old_block = block_indices_.value(old, -1);
 
   NodeParam::DisconnectEdge(old->output(),
                             block_input_->ParamAt(index_of_old_block));
@@ -320,46 +481,153 @@ bool TrackOutput::IsTrack() const
   return true;
 }
 
-void TrackOutput::UpdateInOutFrom(int index)
+void TrackOutput::Retranslate()
+{
+  volume_input_->set_name(tr("Volume"));
+  pan_input_->set_name(tr("Pan"));
+  muted_input_->set_name(tr("Mute"));
+  solo_input_->set_name(tr("Solo"));
+}
+
+void TrackOutput::GetBlockPosition(const Block *block, rational *in, rational *out) const
+{
+  positions_lock_.lock();
+
+  int version = positions_version_.loadAcquire();
+
+  if (block->position_version_.loadAcquire() != version) {
+    int index = block_indices_.value(block, -1);
+
+    if (index >= 0) {
+      block->in_point_ = LengthBefore(index);
+      block->out_point_ = block->in_point_ + slot_lengths_.at(index);
+    }
+
+    block->position_version_.storeRelease(version);
+  }
+
+  // Copied under the lock since another thread may be updating them
+  if (in) {
+    *in = block->in_point_;
+  }
+
+  if (out) {
+    *out = block->out_point_;
+  }
+
+  positions_lock_.unlock();
+}
+
+void TrackOutput::UpdateSlot(int index)
 {
   Q_ASSERT(index >= 0);
   Q_ASSERT(index < block_cache_.size());
 
-  rational new_track_length;
+  Block* b = block_cache_.at(index);
 
-  for (int i=index;i<block_cache_.size();i++) {
-    Block* b = block_cache_.at(i);
+  rational length;
 
-    if (b) {
-      rational prev_out;
-
-      // Find previous block and retrieve its out point (if there isn't one, this in will be set to 0)
-      for (int j=i-1;j>=0;j--) {
-        Block* previous = block_cache_.at(j);
-        if (previous) {
-          prev_out = previous->out();
-          break;
-        }
-      }
+  if (b) {
+    length = b->length();
+  }
 
-      rational new_out = prev_out + b->length();
+  positions_lock_.lock();
 
-      b->set_in(prev_out);
-      b->set_out(new_out);
+  if (slot_lengths_.at(index) != length) {
+    rational diff = length - slot_lengths_.at(index);
 
-      new_track_length = new_out;
+    slot_lengths_.replace(index, length);
 
-      emit b->Refreshed();
+    for (int i=index+1;i<length_tree_.size();i+=(i & -i)) {
+      length_tree_[i] += diff;
     }
   }
 
+  // Every Block's position is worked out again the next time it's asked for
+  positions_version_.fetchAndAddOrdered(1);
+
+  rational slot_in = LengthBefore(index);
+  rational new_length = LengthBefore(block_cache_.size());
+
+  positions_lock_.unlock();
+
+  if (b) {
+    emit b->Refreshed();
+  }
+
+  emit BlocksMoved(slot_in);
+
   // Update track length
-  if (new_track_length != track_length_) {
-    track_length_ = new_track_length;
+  if (new_length != track_length_) {
+    track_length_ = new_length;
     emit TrackLengthChanged();
   }
 }
 
+rational TrackOutput::LengthBefore(int index) const
+{
+  rational length;
+
+  for (int i=index;i>0;i-=(i & -i)) {
+    length += length_tree_.at(i);
+  }
+
+  return length;
+}
+
+int TrackOutput::FirstSlotEndingAfter(const rational &time, bool inclusive) const
+{
+  // Descend the tree, skipping every slot that ends before this time (or at it if not inclusive)
+  int slot_count = block_cache_.size();
+  int step = 1;
+
+  while (step * 2 <= slot_count) {
+    step *= 2;
+  }
+
+  int index = 0;
+  rational remaining = time;
+
+  for (;step>0;step/=2) {
+    int next = index + step;
+
+    if (next <= slot_count
+        && (inclusive ? length_tree_.at(next) < remaining : length_tree_.at(next) <= remaining)) {
+      index = next;
+      remaining -= length_tree_.at(next);
+    }
+  }
+
+  return index;
+}
+
+int TrackOutput::NextBlockIndex(int index) const
+{
+  while (index < block_cache_.size() && !block_cache_.at(index)) {
+    index++;
+  }
+
+  return index;
+}
+
+void TrackOutput::RebuildLengthTree()
+{
+  length_tree_.resize(slot_lengths_.size() + 1);
+  length_tree_[0] = 0;
+
+  for (int i=0;i<slot_lengths_.size();i++) {
+    length_tree_[i+1] = slot_lengths_.at(i);
+  }
+
+  for (int i=1;i<length_tree_.size();i++) {
+    int parent = i + (i & -i);
+
+    if (parent < length_tree_.size()) {
+      length_tree_[parent] += length_tree_.at(i);
+    }
+  }
+}
+
 void TrackOutput::UpdatePreviousAndNextOfIndex(int index)
 {
   Block* ref = block_cache_.at(index);
@@ -413,9 +681,20 @@ void TrackOutput::BlockConnected(NodeEdgePtr edge)
 
   Node* connected_node = edge->output()->parentNode();
   Block* connected_block = connected_node->IsBlock() ? static_cast<Block*>(connected_node) : nullptr;
+
+  positions_lock_.lock();
   block_cache_.replace(block_index, connected_block);
+
+  if (connected_block) {
+    block_indices_.insert(connected_block, block_index);
+    connected_block->track_ = this;
+    connected_block->position_version_.storeRelease(0);
+  }
+
+  positions_lock_.unlock();
+
   UpdatePreviousAndNextOfIndex(block_index);
-  UpdateInOutFrom(block_index);
+  UpdateSlot(block_index);
 
   if (connected_block) {
     connect(connected_block, SIGNAL(LengthChanged(const rational&)), this, SLOT(BlockLengthChanged()));
@@ -430,12 +709,31 @@ void TrackOutput::BlockDisconnected(NodeEdgePtr edge)
 
   Q_ASSERT(block_index >= 0);
 
+  Node* connected_node = edge->output()->parentNode();
+  Block* connected_block = connected_node->IsBlock() ? static_cast<Block*>(connected_node) : nullptr;
+
+  if (connected_block && connected_block->track_ == this) {
+    // The Block keeps the position it had here until it's connected somewhere else
+    GetBlockPosition(connected_block, nullptr, nullptr);
+  }
+
+  positions_lock_.lock();
+
+  if (connected_block && block_indices_.value(connected_block, -1) == block_index) {
+    block_indices_.remove(connected_block);
+
+    if (connected_block->track_ == this) {
+      connected_block->track_ = nullptr;
+    }
+  }
+
   block_cache_.replace(block_index, nullptr);
+
+  positions_lock_.unlock();
+
   UpdatePreviousAndNextOfIndex(block_index);
-  UpdateInOutFrom(block_index);
+  UpdateSlot(block_index);
 
-  Node* connected_node = edge->output()->parentNode();
-  Block* connected_block = connected_node->IsBlock() ? static_cast<Block*>(connected_node) : nullptr;
   if (connected_block) {
     disconnect(connected_block, SIGNAL(LengthChanged(const rational&)), this, SLOT(BlockLengthChanged()));
 
@@ -448,14 +746,29 @@ void TrackOutput::BlockListSizeChanged(int size)
 {
   int old_size = block_cache_.size();
 
+  positions_lock_.lock();
+
+  // Forget any Blocks that were in slots that no longer exist
+  for (int i=size;i<old_size;i++) {
+    if (block_cache_.at(i) && block_indices_.value(block_cache_.at(i), -1) == i) {
+      block_indices_.remove(block_cache_.at(i));
+    }
+  }
+
   block_cache_.resize(size);
+  slot_lengths_.resize(size);
 
   if (size > old_size) {
     // Fill new slots with nullptr
     for (int i=old_size;i<size;i++) {
       block_cache_.replace(i, nullptr);
+      slot_lengths_.replace(i, 0);
     }
   }
+
+  RebuildLengthTree();
+
+  positions_lock_.unlock();
 }
 
 void TrackOutput::BlockLengthChanged()
@@ -463,9 +776,9 @@ void TrackOutput::BlockLengthChanged()
   // Assumes sender is a Block
   Block* b = static_cast<Block*>(sender());
 
-  int index = block_cache_.indexOf(b);
+  int index = block_indices_.value(b, -1);
 
   Q_ASSERT(index >= 0);
 
-  UpdateInOutFrom(index);
+  UpdateSlot(index);
 }
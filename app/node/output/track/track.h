@@ -21,6 +21,9 @@
 #ifndef TRACKOUTPUT_H
 #define TRACKOUTPUT_H
 
+#include <QHash>
+#include <QMutex>
+
 #include "node/block/block.h"
 #include "timeline/tracktypes.h"
 
@@ -33,6 +36,8 @@ class TrackOutput : public Block
 public:
   TrackOutput();
 
+  virtual ~TrackOutput() override;
+
   const TrackType& track_type();
   void set_track_type(const TrackType& track_type);
 
@@ -52,6 +57,42 @@ public:
 
   NodeInput* track_input();
 
+  /**
+   * @brief Percentage this track's audio is scaled by when mixed with the other tracks
+   */
+  NodeInput* volume_input() const;
+
+  /**
+   * @brief Stereo balance of this track's audio from -100 (left only) to 100 (right only)
+   */
+  NodeInput* pan_input() const;
+
+  /**
+   * @brief Whether this track is left out when rendering, without fetching any of its footage
+   */
+  NodeInput* muted_input() const;
+
+  /**
+   * @brief Whether only this track (and any other soloed tracks it's chained to) is rendered
+   */
+  NodeInput* solo_input() const;
+
+  bool IsMuted(const rational& time) const;
+
+  bool IsSoloed(const rational& time) const;
+
+  /**
+   * @brief This track followed by every track chained to it through their track inputs (see next_track())
+   */
+  QList<TrackOutput*> TrackChain();
+
+  /**
+   * @brief Returns whether `track` is left out when rendering `tracks` (which it's one of) at `time`
+   *
+   * A track is left out if it's muted, or if another one of `tracks` is soloed and it isn't.
+   */
+  static bool IsSkipped(const QList<TrackOutput*>& tracks, TrackOutput* track, const rational& time);
+
   Block* BlockContainingTime(const rational& time) const;
 
   Block* NearestBlockBefore(const rational& time) const;
@@ -129,6 +170,8 @@ public:
 
   virtual bool IsTrack() const override;
 
+  virtual void Retranslate() override;
+
 signals:
   /**
    * @brief Signal emitted when a Block is added to this Track
@@ -145,19 +188,100 @@ signals:
    */
   void TrackLengthChanged();
 
+  /**
+   * @brief Signal emitted when Blocks at or after `from` may have moved (e.g. a Block before them changed length)
+   *
+   * Only the Block that changed is sent Refreshed(), the ones after it work out their new position when it's next
+   * asked for. That way a ripple costs the same no matter how many Blocks come after it, and UI widgets can decide
+   * which of the moved Blocks are worth updating.
+   */
+  void BlocksMoved(const rational& from);
+
 protected:
 
 private:
-  void UpdateInOutFrom(int index);
+  friend class Block;
+
+  /**
+   * @brief Get `block`'s in and out points, setting them from the lengths of the slots before it if they've changed
+   *
+   * Called by Block::in() and Block::out(). Blocks in copied graphs are read from render threads, so this is
+   * thread-safe and copies the points out under positions_lock_. `in` and `out` may be nullptr.
+   */
+  void GetBlockPosition(const Block* block, rational* in, rational* out) const;
+
+  /**
+   * @brief Update the length the slot at `index` takes up after its Block was connected, disconnected or resized
+   *
+   * This is O(log n) regardless of how many Blocks come after it.
+   */
+  void UpdateSlot(int index);
+
+  /**
+   * @brief Total length of the slots before `index`, which is also the in point of a Block at `index`
+   */
+  rational LengthBefore(int index) const;
+
+  /**
+   * @brief Index of the first slot ending after `time` (or at it if `inclusive`), or the slot count if none do
+   */
+  int FirstSlotEndingAfter(const rational& time, bool inclusive) const;
+
+  /**
+   * @brief Index of the first slot with a Block at or after `index`, or the slot count if there isn't one
+   */
+  int NextBlockIndex(int index) const;
+
+  /**
+   * @brief Rebuild length_tree_ from slot_lengths_ (after the number of slots changes)
+   */
+  void RebuildLengthTree();
 
   void UpdatePreviousAndNextOfIndex(int index);
 
   QVector<Block*> block_cache_;
 
+  /**
+   * @brief Index of each Block in block_cache_
+   */
+  QHash<const Block*, int> block_indices_;
+
+  /**
+   * @brief Length each slot in block_cache_ takes up (0 for slots without a Block)
+   */
+  QVector<rational> slot_lengths_;
+
+  /**
+   * @brief Fenwick tree (1-based) of slot_lengths_
+   *
+   * Blocks are contiguous, so a Block's in point is the sum of the lengths before it. Keeping those sums in a tree
+   * means a Block changing length is a single O(log n) update rather than moving every Block after it, and lookups by
+   * time can descend the tree in O(log n).
+   */
+  QVector<rational> length_tree_;
+
+  /**
+   * @brief Incremented whenever a slot changes, so Blocks know their cached in/out points are out of date
+   */
+  QAtomicInt positions_version_;
+
+  /**
+   * @brief Protects the slots and tree, which render threads read through copied graphs
+   */
+  mutable QMutex positions_lock_;
+
   NodeInputArray* block_input_;
 
   NodeInput* track_input_;
 
+  NodeInput* volume_input_;
+
+  NodeInput* pan_input_;
+
+  NodeInput* muted_input_;
+
+  NodeInput* solo_input_;
+
   TrackType track_type_;
 
   rational track_length_;
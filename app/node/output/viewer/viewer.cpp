@@ -20,7 +20,8 @@
 
 #include "viewer.h"
 
-ViewerOutput::ViewerOutput()
+ViewerOutput::ViewerOutput() :
+  flush_queued_(false)
 {
   texture_input_ = new NodeInput("tex_in");
   texture_input_->set_data_type(NodeInput::kTexture);
@@ -79,15 +80,23 @@ void ViewerOutput::InvalidateCache(const rational &start_range, const rational &
 {
   Node::InvalidateCache(start_range, end_range, from);
 
+  // Nothing is collected for copies of this node (e.g. in a render backend's graph) that nothing is listening to
   if (from == texture_input()) {
-    emit VideoChangedBetween(start_range, end_range);
+    if (receivers(SIGNAL(VideoChangedBetween(const rational&, const rational&))) > 0) {
+      video_changes_.InsertTimeRange(TimeRange(start_range, end_range));
+    }
   } else if (from == samples_input()) {
-    emit AudioChangedBetween(start_range, end_range);
+    if (receivers(SIGNAL(AudioChangedBetween(const rational&, const rational&))) > 0) {
+      audio_changes_.InsertTimeRange(TimeRange(start_range, end_range));
+    }
   } else if (from == length_input()) {
     emit LengthChanged(Length());
   }
 
-  SendInvalidateCache(start_range, end_range);
+  if (!flush_queued_ && (!video_changes_.isEmpty() || !audio_changes_.isEmpty())) {
+    QMetaObject::invokeMethod(this, "FlushChanges", Qt::QueuedConnection);
+    flush_queued_ = true;
+  }
 }
 
 const VideoParams &ViewerOutput::video_params()
@@ -113,6 +122,16 @@ void ViewerOutput::set_audio_params(const AudioParams &audio)
   audio_params_ = audio;
 }
 
+const QString &ViewerOutput::cache_name() const
+{
+  return cache_name_;
+}
+
+void ViewerOutput::set_cache_name(const QString &name)
+{
+  cache_name_ = name;
+}
+
 rational ViewerOutput::Length()
 {
   // FIXME: This is pretty messy, there's probably a better way...
@@ -135,3 +154,23 @@ void ViewerOutput::DependentEdgeChanged(NodeInput *from)
 
   Node::DependentEdgeChanged(from);
 }
+
+void ViewerOutput::FlushChanges()
+{
+  flush_queued_ = false;
+
+  // Taken first in case a receiver invalidates again
+  QList<TimeRange> video = video_changes_.ranges();
+  QList<TimeRange> audio = audio_changes_.ranges();
+
+  video_changes_.clear();
+  audio_changes_.clear();
+
+  foreach (const TimeRange& range, video) {
+    emit VideoChangedBetween(range.in(), range.out());
+  }
+
+  foreach (const TimeRange& range, audio) {
+    emit AudioChangedBetween(range.in(), range.out());
+  }
+}
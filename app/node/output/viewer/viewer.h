@@ -21,6 +21,7 @@
 #ifndef VIEWER_H
 #define VIEWER_H
 
+#include "common/timerange.h"
 #include "node/node.h"
 #include "render/videoparams.h"
 #include "render/audioparams.h"
@@ -57,6 +58,15 @@ public:
 
   rational Length();
 
+  /**
+   * @brief Name the backends rendering this viewer cache its frames under (empty by default)
+   *
+   * Should be stable across sessions (e.g. a sequence's ID) so the disk cache can be reused after a restart. A
+   * backend that already has a name keeps it if this is empty (see RenderBackend::SetViewerNode()).
+   */
+  const QString& cache_name() const;
+  void set_cache_name(const QString& name);
+
 protected:
   virtual void DependentEdgeChanged(NodeInput* from) override;
 
@@ -88,6 +98,23 @@ private:
 
   AudioParams audio_params_;
 
+  QString cache_name_;
+
+  /**
+   * @brief Video and audio invalidated since the last FlushChanges()
+   *
+   * An edit touching several nodes invalidates the viewer many times over, often with overlapping ranges. Those are
+   * collected here and sent on as one merged set of ranges once control returns to the event loop, so the backends
+   * only rebuild their queues once.
+   */
+  TimeRangeList video_changes_;
+  TimeRangeList audio_changes_;
+
+  bool flush_queued_;
+
+private slots:
+  void FlushChanges();
+
 };
 
 #endif // VIEWER_H
@@ -1,33 +1,54 @@
 #include "value.h"
 
+const NodeValueTable NodeValueDatabase::kEmptyTable;
+
 NodeValueDatabase::NodeValueDatabase()
 {
 
 }
 
-NodeValueTable NodeValueDatabase::operator[](const QString &input_id) const
+const NodeValueTable &NodeValueDatabase::operator[](const QString &input_id) const
 {
-  return tables_.value(input_id);
-}
+  for (int i=0;i<inputs_.size();i++) {
+    if (inputs_.at(i)->id() == input_id) {
+      return tables_.at(i);
+    }
+  }
 
-NodeValueTable NodeValueDatabase::operator[](const NodeInput *input) const
-{
-  return tables_.value(input->id());
+  return kEmptyTable;
 }
 
-void NodeValueDatabase::Insert(const QString &key, const NodeValueTable &value)
+const NodeValueTable &NodeValueDatabase::operator[](const NodeInput *input) const
 {
-  tables_.insert(key, value);
+  int index = inputs_.indexOf(input);
+
+  if (index >= 0) {
+    return tables_.at(index);
+  }
+
+  return kEmptyTable;
 }
 
 void NodeValueDatabase::Insert(const NodeInput *key, const NodeValueTable &value)
 {
-  tables_.insert(key->id(), value);
+  int index = inputs_.indexOf(key);
+
+  if (index >= 0) {
+    tables_.replace(index, value);
+  } else {
+    inputs_.append(key);
+    tables_.append(value);
+  }
 }
 
 NodeValueTable NodeValueDatabase::Merge() const
 {
-  return NodeValueTable::Merge(tables_.values());
+  return NodeValueTable::Merge(tables_.toList());
+}
+
+NodeValue::NodeValue() :
+  type_(NodeParam::kNone)
+{
 }
 
 NodeValue::NodeValue(const NodeParam::DataType &type, const QVariant &data, const QString &tag) :
@@ -52,6 +73,24 @@ const QVariant &NodeValue::data() const
   return data_;
 }
 
+QVariant NodeValue::ConstantTexture(const QVector4D &color)
+{
+  return QVariant::fromValue(color);
+}
+
+bool NodeValue::IsConstantTexture(const QVariant &texture, QVector4D *color)
+{
+  if (texture.userType() != QMetaType::QVector4D) {
+    return false;
+  }
+
+  if (color != nullptr) {
+    *color = texture.value<QVector4D>();
+  }
+
+  return true;
+}
+
 NodeValueTable::NodeValueTable()
 {
 }
@@ -115,10 +154,8 @@ bool NodeValueTable::isEmpty() const
   return values_.isEmpty();
 }
 
-NodeValueTable NodeValueTable::Merge(QList<NodeValueTable> tables)
+NodeValueTable NodeValueTable::Merge(const QList<NodeValueTable>& tables)
 {
-
-
   if (tables.size() == 1) {
     return tables.first();
   }
@@ -2,18 +2,34 @@
 #define VALUE_H
 
 #include <QString>
+#include <QVector>
+#include <QVector4D>
 
 #include "input.h"
 
 class NodeValue
 {
 public:
+  NodeValue();
   NodeValue(const NodeParam::DataType& type, const QVariant& data, const QString& tag = QString());
 
   const NodeParam::DataType& type() const;
   const QVariant& data() const;
   const QString& tag() const;
 
+  /**
+   * @brief Make a texture value that's the same RGBA color at every pixel
+   *
+   * Constants are carried through the renderer as they are, so no texture is allocated or drawn for them. Renderers
+   * fold them into the shaders that use them as a uniform, and only draw them into a texture if they have to.
+   */
+  static QVariant ConstantTexture(const QVector4D& color);
+
+  /**
+   * @brief Returns whether a texture value is a constant made with ConstantTexture(), and if so what its color is
+   */
+  static bool IsConstantTexture(const QVariant& texture, QVector4D* color = nullptr);
+
 private:
   NodeParam::DataType type_;
   QVariant data_;
@@ -37,12 +53,17 @@ public:
 
   bool isEmpty() const;
 
-  static NodeValueTable Merge(QList<NodeValueTable> tables);
+  static NodeValueTable Merge(const QList<NodeValueTable> &tables);
 
 private:
   int GetInternal(const NodeParam::DataType& type, const QString& tag) const;
 
-  QList<NodeValue> values_;
+  /**
+   * @brief Contiguous list of values
+   *
+   * NodeValue is too large for a QList to store inline, so a QVector avoids one heap allocation per value.
+   */
+  QVector<NodeValue> values_;
 
 };
 
@@ -51,16 +72,24 @@ class NodeValueDatabase
 public:
   NodeValueDatabase();
 
-  NodeValueTable operator[](const QString& input_id) const;
-  NodeValueTable operator[](const NodeInput* input) const;
+  const NodeValueTable& operator[](const QString& input_id) const;
+  const NodeValueTable& operator[](const NodeInput* input) const;
 
-  void Insert(const QString& key, const NodeValueTable &value);
   void Insert(const NodeInput* key, const NodeValueTable& value);
 
   NodeValueTable Merge() const;
 
 private:
-  QHash<QString, NodeValueTable> tables_;
+  /**
+   * @brief Tables keyed by the input they belong to
+   *
+   * Nodes only have a handful of inputs, so searching for the input pointer in a flat list is faster than hashing its
+   * ID string for every input of every node on every frame.
+   */
+  QVector<const NodeInput*> inputs_;
+  QVector<NodeValueTable> tables_;
+
+  static const NodeValueTable kEmptyTable;
 
 };
 
@@ -0,0 +1,150 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "footageviewer.h"
+
+#include <QEvent>
+#include <QKeyEvent>
+
+FootageViewerPanel::FootageViewerPanel(QWidget *parent) :
+  PanelWidget(parent)
+{
+  setObjectName("FootageViewerPanel");
+
+  // QObject system handles deleting this
+  viewer_ = new ViewerWidget(this);
+
+  // Set ViewerWidget as the central widget
+  setWidget(viewer_);
+
+  // Set strings
+  Retranslate();
+}
+
+void FootageViewerPanel::ZoomIn()
+{
+  viewer_->SetScale(viewer_->scale() * 2);
+}
+
+void FootageViewerPanel::ZoomOut()
+{
+  viewer_->SetScale(viewer_->scale() * 0.5);
+}
+
+void FootageViewerPanel::GoToStart()
+{
+  viewer_->GoToStart();
+}
+
+void FootageViewerPanel::PrevFrame()
+{
+  viewer_->PrevFrame();
+}
+
+void FootageViewerPanel::PlayPause()
+{
+  viewer_->TogglePlayPause();
+}
+
+void FootageViewerPanel::NextFrame()
+{
+  viewer_->NextFrame();
+}
+
+void FootageViewerPanel::GoToEnd()
+{
+  viewer_->GoToEnd();
+}
+
+void FootageViewerPanel::ShuttleLeft()
+{
+  viewer_->ShuttleLeft();
+}
+
+void FootageViewerPanel::ShuttleStop()
+{
+  viewer_->ShuttleStop();
+}
+
+void FootageViewerPanel::ShuttleRight()
+{
+  viewer_->ShuttleRight();
+}
+
+void FootageViewerPanel::SetFootage(const QList<Footage *> &footage)
+{
+  QList<StreamPtr> angles;
+
+  footage_names_.clear();
+
+  foreach (Footage* f, footage) {
+    if (f->status() != Footage::kReady) {
+      continue;
+    }
+
+    foreach (StreamPtr stream, f->streams()) {
+      if (stream->enabled() && (stream->type() == Stream::kVideo || stream->type() == Stream::kImage)) {
+        angles.append(stream);
+        footage_names_.append(f->name());
+        break;
+      }
+    }
+  }
+
+  viewer_->ConnectFootage(angles);
+
+  Retranslate();
+}
+
+void FootageViewerPanel::changeEvent(QEvent *e)
+{
+  if (e->type() == QEvent::LanguageChange) {
+    Retranslate();
+  }
+  PanelWidget::changeEvent(e);
+}
+
+void FootageViewerPanel::keyPressEvent(QKeyEvent *e)
+{
+  if (viewer_->multicam_angle_count() > 1 && e->key() >= Qt::Key_0 && e->key() <= Qt::Key_9) {
+    viewer_->SetMulticamAngle(e->key() - Qt::Key_1);
+
+    Retranslate();
+    return;
+  }
+
+  PanelWidget::keyPressEvent(e);
+}
+
+void FootageViewerPanel::Retranslate()
+{
+  SetTitle(tr("Footage Viewer"));
+
+  if (footage_names_.isEmpty()) {
+    SetSubtitle(tr("(none)"));
+  } else if (footage_names_.size() == 1) {
+    SetSubtitle(footage_names_.first());
+  } else if (viewer_->multicam_angle() >= 0) {
+    SetSubtitle(tr("Multicam, angle %1: %2").arg(QString::number(viewer_->multicam_angle() + 1),
+                                                  footage_names_.at(viewer_->multicam_angle())));
+  } else {
+    SetSubtitle(tr("Multicam, %1 angles").arg(footage_names_.size()));
+  }
+}
@@ -0,0 +1,80 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FOOTAGE_VIEWER_PANEL_H
+#define FOOTAGE_VIEWER_PANEL_H
+
+#include "project/item/footage/footage.h"
+#include "widget/panel/panel.h"
+#include "widget/viewer/viewer.h"
+
+/**
+ * @brief Dockable viewer for footage from the project, shown straight from its decoder (see
+ * ViewerWidget::ConnectFootage())
+ */
+class FootageViewerPanel : public PanelWidget {
+  Q_OBJECT
+public:
+  FootageViewerPanel(QWidget* parent);
+
+  virtual void ZoomIn() override;
+
+  virtual void ZoomOut() override;
+
+  virtual void GoToStart() override;
+
+  virtual void PrevFrame() override;
+
+  virtual void PlayPause() override;
+
+  virtual void NextFrame() override;
+
+  virtual void GoToEnd() override;
+
+  virtual void ShuttleLeft() override;
+
+  virtual void ShuttleStop() override;
+
+  virtual void ShuttleRight() override;
+
+  /**
+   * @brief Show the first video or image stream of each footage, as the angles of a multicam if there's more than one
+   *
+   * An empty list shows nothing.
+   */
+  void SetFootage(const QList<Footage*>& footage);
+
+protected:
+  virtual void changeEvent(QEvent* e) override;
+
+  /**
+   * @brief Number keys 1 to 9 show that angle of a multicam on its own, 0 goes back to the grid
+   */
+  virtual void keyPressEvent(QKeyEvent* e) override;
+
+private:
+  void Retranslate();
+
+  ViewerWidget* viewer_;
+
+  QStringList footage_names_;
+};
+
+#endif // FOOTAGE_VIEWER_PANEL_H
@@ -24,6 +24,8 @@
 #include <QVBoxLayout>
 
 #include "core.h"
+#include "panel/footageviewer/footageviewer.h"
+#include "panel/panelmanager.h"
 #include "widget/menu/menushared.h"
 #include "widget/projecttoolbar/projecttoolbar.h"
 
@@ -121,9 +123,31 @@ void ProjectPanel::ItemDoubleClickSlot(Item *item)
   if (item == nullptr) {
     // If the user double clicks on empty space, show the import dialog
     olive::core.DialogImportShow();
+  } else if (item->type() == Item::kFootage) {
+    FootageViewerPanel* footage_viewer = olive::panel_manager->MostRecentlyFocused<FootageViewerPanel>();
+
+    if (footage_viewer != nullptr) {
+      QList<Footage*> footage;
+
+      // Double clicking one of several selected footage opens them all as the angles of a multicam
+      QList<Item*> selected = explorer_->SelectedItems();
+
+      if (selected.size() > 1 && selected.contains(item)) {
+        foreach (Item* i, selected) {
+          if (i->type() == Item::kFootage) {
+            footage.append(static_cast<Footage*>(i));
+          }
+        }
+      } else {
+        footage.append(static_cast<Footage*>(item));
+      }
+
+      footage_viewer->SetFootage(footage);
+      footage_viewer->raise();
+    }
   }
 
-  // FIXME: Double click Item should do something
+  // FIXME: Double clicking other items should do something too
 }
 
 void ProjectPanel::ShowNewMenu()
@@ -18,33 +18,33 @@
 
 ***/
 
-#ifndef TASKTHREAD_H
-#define TASKTHREAD_H
+#ifndef RENDERQUEUE_PANEL_H
+#define RENDERQUEUE_PANEL_H
 
-#include <QThread>
-
-class Task;
+#include "widget/taskview/taskview.h"
+#include "widget/panel/panel.h"
 
 /**
- * @brief An internal class only used by Task.
+ * @brief A PanelWidget listing exports (see ExportTask) from when they're queued until they finish
  *
- * TaskThread is a simple QThread subclass designed to create a thread and run the
- * Task's Action() function. It also stores the result of Action() which can be read using result() when the thread
- * signals that it has finished().
+ * Exports also show up in the TaskManagerPanel along with everything else, this only shows them.
  */
-class TaskThread : public QThread
+class RenderQueuePanel : public PanelWidget
 {
+  Q_OBJECT
 public:
-  TaskThread(Task* parent);
+  RenderQueuePanel(QWidget* parent);
 
-  virtual void run() override;
+  void AddTask(Task* t);
 
-  bool result();
+protected:
+  virtual void changeEvent(QEvent* e) override;
 
 private:
-  Task* parent_;
+  void Retranslate();
+
+  TaskView* view_;
 
-  bool result_;
 };
 
-#endif // TASKTHREAD_H
+#endif // RENDERQUEUE_PANEL_H
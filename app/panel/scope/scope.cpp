@@ -0,0 +1,81 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "scope.h"
+
+#include <QVBoxLayout>
+
+ScopePanel::ScopePanel(QWidget *parent) :
+  PanelWidget(parent)
+{
+  // FIXME: This won't work if there's ever more than one of this panel
+  setObjectName("ScopePanel");
+
+  QWidget* central = new QWidget(this);
+  setWidget(central);
+
+  QVBoxLayout* layout = new QVBoxLayout(central);
+  layout->setMargin(0);
+  layout->setSpacing(0);
+
+  type_combobox_ = new QComboBox();
+  layout->addWidget(type_combobox_);
+
+  scope_ = new ScopeGLWidget();
+  layout->addWidget(scope_);
+
+  // Items are added in Retranslate(), in the same order as ScopeGLWidget::Type
+  Retranslate();
+
+  connect(type_combobox_, SIGNAL(currentIndexChanged(int)), scope_, SLOT(SetType(int)));
+}
+
+void ScopePanel::SetTexture(OpenGLTexturePtr texture)
+{
+  scope_->SetTexture(texture);
+}
+
+void ScopePanel::changeEvent(QEvent *e)
+{
+  if (e->type() == QEvent::LanguageChange) {
+    Retranslate();
+  }
+
+  PanelWidget::changeEvent(e);
+}
+
+void ScopePanel::Retranslate()
+{
+  SetTitle(tr("Scopes"));
+
+  int index = type_combobox_->currentIndex();
+
+  type_combobox_->blockSignals(true);
+
+  type_combobox_->clear();
+  type_combobox_->addItem(tr("Waveform"));
+  type_combobox_->addItem(tr("RGB Parade"));
+  type_combobox_->addItem(tr("Vectorscope"));
+  type_combobox_->addItem(tr("Histogram"));
+
+  type_combobox_->setCurrentIndex(qMax(0, index));
+
+  type_combobox_->blockSignals(false);
+}
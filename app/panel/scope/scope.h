@@ -0,0 +1,56 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef SCOPE_PANEL_H
+#define SCOPE_PANEL_H
+
+#include <QComboBox>
+
+#include "widget/panel/panel.h"
+#include "widget/scope/scopeglwidget.h"
+
+/**
+ * @brief Dockable waveform, parade, vectorscope and histogram of what a viewer is showing
+ */
+class ScopePanel : public PanelWidget
+{
+  Q_OBJECT
+public:
+  ScopePanel(QWidget* parent);
+
+public slots:
+  /**
+   * @brief Connect to ViewerPanel::TextureChanged() to measure whatever the viewer shows
+   */
+  void SetTexture(OpenGLTexturePtr texture);
+
+protected:
+  virtual void changeEvent(QEvent* e) override;
+
+private:
+  void Retranslate();
+
+  QComboBox* type_combobox_;
+
+  ScopeGLWidget* scope_;
+
+};
+
+#endif // SCOPE_PANEL_H
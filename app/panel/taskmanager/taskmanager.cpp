@@ -23,19 +23,14 @@
 #include "task/taskmanager.h"
 
 TaskManagerPanel::TaskManagerPanel(QWidget* parent) :
-  PanelWidget(parent)
+  PanelWidget(parent),
+  view_(nullptr)
 {
   // FIXME: This won't work if there's ever more than one of this panel
   setObjectName("TaskManagerPanel");
 
-  // Create task view
-  view_ = new TaskView(this);
-
-  // Set it as the main widget
-  setWidget(view_);
-
-  // Connect task view to the task manager
-  connect(&olive::task_manager, SIGNAL(TaskAdded(Task*)), view_, SLOT(AddTask(Task*)));
+  // Tasks are held onto until the task view is created in showEvent()
+  connect(&olive::task_manager, SIGNAL(TaskAdded(Task*)), this, SLOT(TaskAdded(Task*)));
 
   // Set strings
   Retranslate();
@@ -49,6 +44,36 @@ void TaskManagerPanel::changeEvent(QEvent *e)
   PanelWidget::changeEvent(e);
 }
 
+void TaskManagerPanel::showEvent(QShowEvent *e)
+{
+  if (view_ == nullptr) {
+    // Create task view and set it as the main widget
+    view_ = new TaskView(this);
+    setWidget(view_);
+
+    foreach (QPointer<Task> t, hidden_tasks_) {
+      if (t) {
+        view_->AddTask(t);
+      }
+    }
+
+    hidden_tasks_.clear();
+  }
+
+  PanelWidget::showEvent(e);
+}
+
+void TaskManagerPanel::TaskAdded(Task *t)
+{
+  if (view_ == nullptr) {
+    // Drop the ones that have finished so this only holds tasks that are still running
+    hidden_tasks_.removeAll(QPointer<Task>());
+    hidden_tasks_.append(t);
+  } else {
+    view_->AddTask(t);
+  }
+}
+
 void TaskManagerPanel::Retranslate()
 {
   SetTitle(tr("Task Manager"));
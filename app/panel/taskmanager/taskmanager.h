@@ -21,11 +21,16 @@
 #ifndef TASKMANAGER_PANEL_H
 #define TASKMANAGER_PANEL_H
 
+#include <QPointer>
+
 #include "widget/taskview/taskview.h"
 #include "widget/panel/panel.h"
 
 /**
  * @brief A PanelWidget wrapper around a TaskView widget
+ *
+ * The panel starts hidden, so the TaskView is only created the first time it's
+ * shown. Tasks started before then are kept until it is.
  */
 class TaskManagerPanel : public PanelWidget
 {
@@ -36,10 +41,23 @@ public:
 protected:
   virtual void changeEvent(QEvent* e) override;
 
+  virtual void showEvent(QShowEvent* e) override;
+
 private:
   void Retranslate();
 
   TaskView* view_;
+
+  /**
+   * @brief Tasks started while there's no view yet, emptied into the view when it's created
+   *
+   * Tasks that finish before then are deleted and drop out of the list by themselves.
+   */
+  QList< QPointer<Task> > hidden_tasks_;
+
+private slots:
+  void TaskAdded(Task* t);
+
 };
 
 #endif // TASKMANAGER_H
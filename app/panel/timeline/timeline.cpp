@@ -49,6 +49,11 @@ void TimelinePanel::SetTime(const int64_t &timestamp)
   timeline_widget_->SetTime(timestamp);
 }
 
+void TimelinePanel::SetFrameStatus(const FrameStatusSpans &spans)
+{
+  timeline_widget_->SetFrameStatus(spans);
+}
+
 void TimelinePanel::ConnectTimelineNode(TimelineOutput *node)
 {
   timeline_widget_->ConnectTimelineNode(node);
@@ -64,6 +69,51 @@ void TimelinePanel::SplitAtPlayhead()
   timeline_widget_->SplitAtPlayhead();
 }
 
+void TimelinePanel::CopySelected()
+{
+  timeline_widget_->CopySelected();
+}
+
+void TimelinePanel::Paste()
+{
+  timeline_widget_->Paste();
+}
+
+void TimelinePanel::DuplicateSelected()
+{
+  timeline_widget_->DuplicateSelected();
+}
+
+void TimelinePanel::SetInPoint()
+{
+  timeline_widget_->SetInPoint();
+}
+
+void TimelinePanel::SetOutPoint()
+{
+  timeline_widget_->SetOutPoint();
+}
+
+void TimelinePanel::ResetInPoint()
+{
+  timeline_widget_->ResetInPoint();
+}
+
+void TimelinePanel::ResetOutPoint()
+{
+  timeline_widget_->ResetOutPoint();
+}
+
+void TimelinePanel::ClearInOutPoints()
+{
+  timeline_widget_->ClearInOutPoints();
+}
+
+void TimelinePanel::PreRenderInOut()
+{
+  timeline_widget_->PreRenderInOut();
+}
+
 void TimelinePanel::ZoomIn()
 {
   timeline_widget_->ZoomIn();
@@ -42,6 +42,24 @@ public:
 
   void SplitAtPlayhead();
 
+  void CopySelected();
+
+  void Paste();
+
+  void DuplicateSelected();
+
+  void SetInPoint();
+
+  void SetOutPoint();
+
+  void ResetInPoint();
+
+  void ResetOutPoint();
+
+  void ClearInOutPoints();
+
+  void PreRenderInOut();
+
   virtual void ZoomIn() override;
 
   virtual void ZoomOut() override;
@@ -67,6 +85,8 @@ public slots:
 
   void SetTime(const int64_t& timestamp);
 
+  void SetFrameStatus(const FrameStatusSpans& spans);
+
 protected:
   virtual void changeEvent(QEvent* e) override;
 
@@ -29,6 +29,8 @@ ViewerPanel::ViewerPanel(QWidget *parent) :
   // QObject system handles deleting this
   viewer_ = new ViewerWidget(this);
   connect(viewer_, SIGNAL(TimeChanged(const int64_t&)), this, SIGNAL(TimeChanged(const int64_t&)));
+  connect(viewer_, SIGNAL(TextureChanged(OpenGLTexturePtr)), this, SIGNAL(TextureChanged(OpenGLTexturePtr)));
+  connect(viewer_, SIGNAL(FrameStatusChanged(const FrameStatusSpans&)), this, SIGNAL(FrameStatusChanged(const FrameStatusSpans&)));
 
   // Set ViewerWidget as the central widget
   setWidget(viewer_);
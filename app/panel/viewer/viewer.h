@@ -71,6 +71,16 @@ protected:
 signals:
   void TimeChanged(const int64_t&);
 
+  /**
+   * @brief Forwarded from ViewerWidget::TextureChanged()
+   */
+  void TextureChanged(OpenGLTexturePtr texture);
+
+  /**
+   * @brief Forwarded from ViewerWidget::FrameStatusChanged()
+   */
+  void FrameStatusChanged(const FrameStatusSpans& spans);
+
 private:
   void Retranslate();
 
@@ -0,0 +1,309 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "autorecovery.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QVector>
+
+AutoRecovery* AutoRecovery::instance_ = nullptr;
+
+const qint64 AutoRecovery::kCompactMinimumSize = 4 * 1024 * 1024;
+
+class AutoRecovery::WriteTask : public QRunnable
+{
+public:
+  WriteTask(AutoRecovery* parent,
+            const QString& filename,
+            const QString& graph_filename,
+            bool new_graph_file,
+            const QVector<QByteArray>& records,
+            const QByteArray& project_file,
+            const QString& stale_graph_filename) :
+    parent_(parent),
+    filename_(filename),
+    graph_filename_(graph_filename),
+    new_graph_file_(new_graph_file),
+    records_(records),
+    project_file_(project_file),
+    stale_graph_filename_(stale_graph_filename)
+  {
+  }
+
+  virtual void run() override
+  {
+    if (!WriteGraph()) {
+      qWarning() << "Failed to write autorecovery graph" << graph_filename_;
+      parent_->WriteFailed(filename_);
+      return;
+    }
+
+    QSaveFile project_file(filename_);
+
+    if (!project_file.open(QFile::WriteOnly)
+        || project_file.write(project_file_) != project_file_.size()
+        || !project_file.commit()) {
+      qWarning() << "Failed to write autorecovery" << filename_;
+      parent_->WriteFailed(filename_);
+      return;
+    }
+
+    // Nothing refers to the other graph file anymore
+    if (!stale_graph_filename_.isEmpty()) {
+      QFile::remove(stale_graph_filename_);
+    }
+  }
+
+private:
+  bool WriteGraph()
+  {
+    QFile graph_file(graph_filename_);
+
+    if (!graph_file.open(new_graph_file_ ? (QFile::WriteOnly | QFile::Truncate) : (QFile::WriteOnly | QFile::Append))) {
+      return false;
+    }
+
+    if (new_graph_file_) {
+      QByteArray header = ProjectSerializer::GraphHeader();
+
+      if (graph_file.write(header) != header.size()) {
+        return false;
+      }
+    }
+
+    foreach (const QByteArray& record, records_) {
+      if (graph_file.write(record) != record.size()) {
+        return false;
+      }
+    }
+
+    return graph_file.flush();
+  }
+
+  AutoRecovery* parent_;
+
+  QString filename_;
+
+  QString graph_filename_;
+
+  bool new_graph_file_;
+
+  QVector<QByteArray> records_;
+
+  QByteArray project_file_;
+
+  QString stale_graph_filename_;
+};
+
+class AutoRecovery::RemoveTask : public QRunnable
+{
+public:
+  RemoveTask(const QString& filename) :
+    filename_(filename)
+  {
+  }
+
+  virtual void run() override
+  {
+    QFile::remove(filename_);
+    QFile::remove(GetGraphFilename(filename_, 0));
+    QFile::remove(GetGraphFilename(filename_, 1));
+  }
+
+private:
+  QString filename_;
+};
+
+void AutoRecovery::CreateInstance()
+{
+  if (instance_ == nullptr) {
+    instance_ = new AutoRecovery();
+  }
+}
+
+AutoRecovery *AutoRecovery::instance()
+{
+  return instance_;
+}
+
+void AutoRecovery::DestroyInstance()
+{
+  delete instance_;
+  instance_ = nullptr;
+}
+
+AutoRecovery::AutoRecovery()
+{
+  // One thread, so writes to the same files always happen in the order they were queued
+  pool_.setMaxThreadCount(1);
+}
+
+AutoRecovery::~AutoRecovery()
+{
+  pool_.waitForDone();
+}
+
+void AutoRecovery::Save(Project *project)
+{
+  if (project->filename().isEmpty()) {
+    return;
+  }
+
+  QString filename = GetAutoRecoveryFilename(project->filename());
+
+  State& state = states_[project];
+
+  if (state.filename != filename) {
+    // First save, or the project has been saved somewhere else since
+    state.filename = filename;
+    state.generation = 0;
+    state.graph_size = 0;
+    state.records.clear();
+    state.last_project_file.clear();
+  }
+
+  lock_.lock();
+  bool last_write_failed = failed_.remove(filename);
+  lock_.unlock();
+
+  QList<Sequence*> sequences;
+  ProjectSerializer::CollectSequences(project->root(), &sequences);
+
+  // Only sequences that have changed since the last save are serialized again
+  QHash<Sequence*, Record> records;
+  QList<Sequence*> changed_sequences;
+  qint64 live_size = 0;
+
+  foreach (Sequence* s, sequences) {
+    Record r;
+
+    if (state.records.contains(s) && state.records.value(s).version == s->version()) {
+      r = state.records.value(s);
+    } else {
+      r.version = s->version();
+      r.data = ProjectSerializer::SerializeGraph(s);
+      changed_sequences.append(s);
+    }
+
+    records.insert(s, r);
+    live_size += r.data.size();
+  }
+
+  QString stale_graph_filename;
+  QVector<QByteArray> written_records;
+
+  bool new_graph_file = (state.graph_size == 0
+                         || last_write_failed
+                         || (state.graph_size > kCompactMinimumSize && state.graph_size > live_size * 2));
+
+  if (new_graph_file) {
+    // Write every current record to the other graph file, the current one stays valid until the project file that
+    // refers to the new one replaces it
+    if (state.graph_size > 0) {
+      stale_graph_filename = GetGraphFilename(filename, state.generation);
+      state.generation = 1 - state.generation;
+    }
+
+    qint64 graph_size = ProjectSerializer::GraphHeader().size();
+
+    foreach (Sequence* s, sequences) {
+      Record& r = records[s];
+
+      r.location.offset = graph_size;
+      r.location.size = r.data.size();
+
+      graph_size += r.data.size();
+
+      written_records.append(r.data);
+    }
+
+    state.graph_size = graph_size;
+  } else {
+    foreach (Sequence* s, changed_sequences) {
+      Record& r = records[s];
+
+      r.location.offset = state.graph_size;
+      r.location.size = r.data.size();
+
+      state.graph_size += r.data.size();
+
+      written_records.append(r.data);
+    }
+  }
+
+  QHash<Sequence*, ProjectSerializer::GraphRecord> locations;
+
+  for (QHash<Sequence*, Record>::const_iterator i=records.constBegin();i!=records.constEnd();i++) {
+    locations.insert(i.key(), i.value().location);
+  }
+
+  QString graph_filename = GetGraphFilename(filename, state.generation);
+
+  QByteArray project_file = ProjectSerializer::SerializeProject(project, locations, QFileInfo(graph_filename).fileName());
+
+  state.records = records;
+
+  if (written_records.isEmpty() && !new_graph_file && project_file == state.last_project_file) {
+    // Nothing has changed since the last save
+    return;
+  }
+
+  state.last_project_file = project_file;
+
+  pool_.start(new WriteTask(this,
+                            filename,
+                            graph_filename,
+                            new_graph_file,
+                            written_records,
+                            project_file,
+                            stale_graph_filename));
+}
+
+void AutoRecovery::Discard(Project *project)
+{
+  if (!states_.contains(project)) {
+    return;
+  }
+
+  pool_.start(new RemoveTask(states_.take(project).filename));
+}
+
+QString AutoRecovery::GetAutoRecoveryFilename(const QString &filename)
+{
+  return filename + QStringLiteral(".autorecovery");
+}
+
+QString AutoRecovery::GetGraphFilename(const QString &filename, int generation)
+{
+  return ProjectSerializer::GraphFilename(filename) + QString::number(generation);
+}
+
+void AutoRecovery::WriteFailed(const QString &filename)
+{
+  lock_.lock();
+
+  failed_.insert(filename);
+
+  lock_.unlock();
+}
@@ -0,0 +1,138 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef AUTORECOVERY_H
+#define AUTORECOVERY_H
+
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QThreadPool>
+
+#include "project/project.h"
+#include "project/projectserializer.h"
+
+/**
+ * @brief Keeps an autorecovery copy of every saved project without holding up the UI
+ *
+ * Each project's copy is a project file next to the original (see GetAutoRecoveryFilename()) and a graph file that
+ * records are appended to. Save() only serializes the sequences that have changed since the last one (see
+ * NodeGraph::version()) and appends them, the records of everything else are referred to where they already are.
+ * All writing happens on a background thread, so the UI thread only ever pays for packing what was just edited.
+ *
+ * Once most of a graph file is superseded records, the current records are written to a fresh graph file instead.
+ * There are two graph files that take turns, so the autorecovery project file always refers to one that's complete.
+ */
+class AutoRecovery
+{
+public:
+  static void CreateInstance();
+
+  static AutoRecovery* instance();
+
+  static void DestroyInstance();
+
+  /**
+   * @brief Bring the autorecovery copy of `project` up to date
+   *
+   * Does nothing if the project hasn't been saved yet (there's nowhere to put the copy) or nothing has changed.
+   */
+  void Save(Project* project);
+
+  /**
+   * @brief Delete the autorecovery copy of `project`, e.g. once it's been saved properly
+   */
+  void Discard(Project* project);
+
+  /**
+   * @brief Filename of the autorecovery copy of the project file `filename`
+   */
+  static QString GetAutoRecoveryFilename(const QString& filename);
+
+private:
+  AutoRecovery();
+
+  ~AutoRecovery();
+
+  /**
+   * @brief Writes records and a project file on the pool
+   */
+  class WriteTask;
+
+  /**
+   * @brief Deletes a project's autorecovery files on the pool (after any writes still queued)
+   */
+  class RemoveTask;
+
+  struct Record {
+    quint64 version;
+    QByteArray data;
+    ProjectSerializer::GraphRecord location;
+  };
+
+  struct State {
+    /**
+     * @brief The autorecovery project file these records belong to
+     */
+    QString filename;
+
+    /**
+     * @brief Which of the two graph files is being appended to
+     */
+    int generation;
+
+    /**
+     * @brief Size the graph file will be once every write queued so far has finished
+     */
+    qint64 graph_size;
+
+    QHash<Sequence*, Record> records;
+
+    QByteArray last_project_file;
+  };
+
+  static QString GetGraphFilename(const QString& filename, int generation);
+
+  /**
+   * @brief Called by a WriteTask that failed so the next Save() writes everything again (thread-safe)
+   */
+  void WriteFailed(const QString& filename);
+
+  static AutoRecovery* instance_;
+
+  /**
+   * @brief Graph files smaller than this are never rewritten, however much of them is superseded
+   */
+  static const qint64 kCompactMinimumSize;
+
+  QHash<Project*, State> states_;
+
+  QThreadPool pool_;
+
+  QMutex lock_;
+
+  /**
+   * @brief Autorecovery files a WriteTask failed to write (protected by lock_)
+   */
+  QSet<QString> failed_;
+
+};
+
+#endif // AUTORECOVERY_H
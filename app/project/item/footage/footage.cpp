@@ -21,17 +21,24 @@
 #include "footage.h"
 
 #include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QFileInfo>
+#include <QtEndian>
 
 #include "common/timecodefunctions.h"
+#include "footagewatcher.h"
 #include "ui/icons/icons.h"
 
-Footage::Footage()
+Footage::Footage() :
+  content_id_(0)
 {
   Clear();
 }
 
 Footage::~Footage()
 {
+  FootageWatcher::Unwatch(this);
+
   ClearStreams();
 }
 
@@ -44,6 +51,15 @@ void Footage::set_status(const Footage::Status &status)
 {
   status_ = status;
 
+  // Files that are still being written are added to as they're edited
+  if (status_ == kReady) {
+    UpdateContentID();
+
+    FootageWatcher::Watch(this);
+  } else {
+    FootageWatcher::Unwatch(this);
+  }
+
   UpdateTooltip();
 }
 
@@ -52,6 +68,11 @@ void Footage::Clear()
   // Clear all streams
   ClearStreams();
 
+  // Proxies were made from the streams we just cleared
+  proxy_lock_.lock();
+  proxies_.clear();
+  proxy_lock_.unlock();
+
   // Reset ready state
   set_status(kUnprobed);
 }
@@ -76,6 +97,11 @@ void Footage::set_timestamp(const QDateTime &t)
   timestamp_ = t;
 }
 
+quint64 Footage::content_id() const
+{
+  return content_id_;
+}
+
 void Footage::add_stream(StreamPtr s)
 {
   // Add a copy of this stream to the list
@@ -100,6 +126,31 @@ int Footage::stream_count()
   return streams_.size();
 }
 
+StreamPtr Footage::proxy(int index)
+{
+  StreamPtr proxy_stream;
+
+  proxy_lock_.lock();
+
+  std::shared_ptr<Footage> proxy_footage = proxies_.value(index);
+
+  // A proxy is transcoded from a single stream, so its video is always its first stream
+  if (proxy_footage != nullptr && proxy_footage->stream_count() > 0) {
+    proxy_stream = proxy_footage->stream(0);
+  }
+
+  proxy_lock_.unlock();
+
+  return proxy_stream;
+}
+
+void Footage::set_proxy(int index, std::shared_ptr<Footage> proxy)
+{
+  proxy_lock_.lock();
+  proxies_.insert(index, proxy);
+  proxy_lock_.unlock();
+}
+
 Item::Type Footage::type() const
 {
   return kFootage;
@@ -223,6 +274,18 @@ bool Footage::HasStreamsOfType(const Stream::Type type)
   return false;
 }
 
+void Footage::UpdateContentID()
+{
+  QFileInfo info(filename_);
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(info.absoluteFilePath().toUtf8());
+  hash.addData(QByteArray::number(info.lastModified().toMSecsSinceEpoch()));
+  hash.addData(QByteArray::number(info.size()));
+
+  content_id_ = qFromLittleEndian<quint64>(reinterpret_cast<const uchar*>(hash.result().constData()));
+}
+
 void Footage::UpdateTooltip()
 {
   switch (status_) {
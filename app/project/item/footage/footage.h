@@ -21,8 +21,10 @@
 #ifndef FOOTAGE_H
 #define FOOTAGE_H
 
-#include <QList>
 #include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <QMutex>
 
 #include "common/rational.h"
 #include "project/item/item.h"
@@ -147,6 +149,16 @@ public:
    */
   void set_timestamp(const QDateTime& t);
 
+  /**
+   * @brief Identifies what's in the file, for hashing frames decoded from it
+   *
+   * Derived from the file's path, last modified date and size each time the footage becomes ready, so a file that's
+   * changed on disk gets a new one and only the frames that use it are rendered again. A file that's only grown (see
+   * FootageWatcher) keeps its own, since the frames that were already in it haven't changed. 0 until the footage is
+   * ready.
+   */
+  quint64 content_id() const;
+
   /**
    * @brief Add a stream metadata object to this footage
    *
@@ -184,6 +196,25 @@ public:
    */
   int stream_count();
 
+  /**
+   * @brief Retrieve the proxy of one of this Footage's streams
+   *
+   * Thread-safe, renderers call this to decide what to decode.
+   *
+   * @return
+   *
+   * The proxy's video stream, or nullptr if the stream at `index` doesn't have a proxy (see ProxyTask).
+   */
+  StreamPtr proxy(int index);
+
+  /**
+   * @brief Attach a proxy to one of this Footage's streams, replacing any previous one
+   *
+   * The proxy Footage is kept alive for as long as this Footage's streams are. Proxies are forgotten by Clear() since
+   * they no longer match the file once it's re-probed.
+   */
+  void set_proxy(int index, std::shared_ptr<Footage> proxy);
+
   /**
    * @brief Item::Type() override
    *
@@ -242,6 +273,11 @@ private:
    */
   void UpdateTooltip();
 
+  /**
+   * @brief Set content_id_ from the file as it is on disk now
+   */
+  void UpdateContentID();
+
   /**
    * @brief Internal filename string
    */
@@ -252,6 +288,8 @@ private:
    */
   QDateTime timestamp_;
 
+  quint64 content_id_;
+
   /**
    * @brief Internal streams array
    */
@@ -267,6 +305,16 @@ private:
    */
   QString decoder_;
 
+  /**
+   * @brief Proxies of this Footage's streams, keyed by stream index
+   */
+  QHash<int, std::shared_ptr<Footage> > proxies_;
+
+  /**
+   * @brief Protects proxies_, which is read from render threads
+   */
+  QMutex proxy_lock_;
+
 };
 
 using FootagePtr = std::shared_ptr<Footage>;
@@ -0,0 +1,113 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "footagewatcher.h"
+
+#include <QFileInfo>
+
+#include "footage.h"
+
+FootageWatcher* FootageWatcher::instance_ = nullptr;
+QHash<Footage*, FootageWatcher::WatchedFile> FootageWatcher::watched_;
+QMutex FootageWatcher::lock_;
+
+void FootageWatcher::CreateInstance()
+{
+  if (instance_ == nullptr) {
+    instance_ = new FootageWatcher();
+  }
+}
+
+FootageWatcher *FootageWatcher::instance()
+{
+  return instance_;
+}
+
+void FootageWatcher::DestroyInstance()
+{
+  delete instance_;
+  instance_ = nullptr;
+}
+
+void FootageWatcher::Watch(Footage *footage)
+{
+  QFileInfo info(footage->filename());
+
+  if (!info.exists() || info.lastModified().secsTo(QDateTime::currentDateTime()) > kLiveInterval) {
+    return;
+  }
+
+  WatchedFile file;
+  file.filename = footage->filename();
+  file.size = info.size();
+  file.last_change = info.lastModified();
+
+  lock_.lock();
+  watched_.insert(footage, file);
+  lock_.unlock();
+}
+
+void FootageWatcher::Unwatch(Footage *footage)
+{
+  lock_.lock();
+  watched_.remove(footage);
+  lock_.unlock();
+}
+
+FootageWatcher::FootageWatcher()
+{
+  connect(&poll_timer_, SIGNAL(timeout()), this, SLOT(Poll()));
+  poll_timer_.start(kPollInterval);
+}
+
+void FootageWatcher::Poll()
+{
+  QDateTime now = QDateTime::currentDateTime();
+
+  lock_.lock();
+
+  QHash<Footage*, WatchedFile>::iterator i = watched_.begin();
+
+  while (i != watched_.end()) {
+    WatchedFile& file = i.value();
+    QFileInfo info(file.filename);
+
+    if (!info.exists() || info.size() < file.size) {
+      // Deleted or rewritten from the start, neither of which can be carried on from
+      i = watched_.erase(i);
+      continue;
+    }
+
+    if (info.size() > file.size) {
+      file.size = info.size();
+      file.last_change = now;
+
+      emit FileGrown(i.key());
+    } else if (file.last_change.secsTo(now) > kLiveInterval) {
+      // Finished being written
+      i = watched_.erase(i);
+      continue;
+    }
+
+    i++;
+  }
+
+  lock_.unlock();
+}
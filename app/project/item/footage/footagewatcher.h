@@ -0,0 +1,103 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FOOTAGEWATCHER_H
+#define FOOTAGEWATCHER_H
+
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QTimer>
+
+class Footage;
+
+/**
+ * @brief Notices footage files that are still being written (e.g. while they're being recorded or copied in)
+ *
+ * Footage is watched from when it's ready (see Footage::set_status()) if its file was modified in the last
+ * kLiveInterval, and stops being watched once its file hasn't changed for that long. Watched files are polled for
+ * their size rather than watched with QFileSystemWatcher, since ingest usually writes to network shares which don't
+ * send change notifications, and only files that are being written are polled so this stays cheap however large the
+ * project is.
+ *
+ * Watch() and Unwatch() are thread-safe, polling only happens once the instance has been created.
+ */
+class FootageWatcher : public QObject
+{
+  Q_OBJECT
+public:
+  static void CreateInstance();
+
+  static FootageWatcher* instance();
+
+  static void DestroyInstance();
+
+  /**
+   * @brief Start polling this footage's file if it's being written, does nothing otherwise
+   */
+  static void Watch(Footage* footage);
+
+  /**
+   * @brief Stop polling this footage's file (safe to call if it isn't being watched)
+   */
+  static void Unwatch(Footage* footage);
+
+signals:
+  /**
+   * @brief Emitted in the main thread when a watched footage file has grown
+   *
+   * Emitted with the watch list locked so the footage can't be deleted in the meantime, connected slots mustn't call
+   * Watch() or Unwatch().
+   */
+  void FileGrown(Footage* footage);
+
+private:
+  FootageWatcher();
+
+  struct WatchedFile {
+    QString filename;
+    qint64 size;
+    QDateTime last_change;
+  };
+
+  /**
+   * @brief Milliseconds between polling every watched file
+   */
+  static const int kPollInterval = 2000;
+
+  /**
+   * @brief Seconds since a file last changed for it to be considered as still being written
+   */
+  static const int kLiveInterval = 60;
+
+  static FootageWatcher* instance_;
+
+  static QHash<Footage*, WatchedFile> watched_;
+
+  static QMutex lock_;
+
+  QTimer poll_timer_;
+
+private slots:
+  void Poll();
+
+};
+
+#endif // FOOTAGEWATCHER_H
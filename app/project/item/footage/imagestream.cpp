@@ -23,7 +23,9 @@
 #include "render/colormanager.h"
 
 ImageStream::ImageStream() :
-  premultiplied_alpha_(false)
+  premultiplied_alpha_(false),
+  has_alpha_(true),
+  proxy_divider_(1)
 {
   set_type(kImage);
 
@@ -67,6 +69,16 @@ void ImageStream::set_premultiplied_alpha(bool e)
   premultiplied_alpha_ = e;
 }
 
+bool ImageStream::has_alpha()
+{
+  return has_alpha_;
+}
+
+void ImageStream::set_has_alpha(bool e)
+{
+  has_alpha_ = e;
+}
+
 const QString &ImageStream::colorspace()
 {
   return colorspace_;
@@ -79,6 +91,16 @@ void ImageStream::set_colorspace(const QString &color)
   emit ColorSpaceChanged();
 }
 
+const int &ImageStream::proxy_divider()
+{
+  return proxy_divider_;
+}
+
+void ImageStream::set_proxy_divider(const int &divider)
+{
+  proxy_divider_ = divider;
+}
+
 void ImageStream::ColorConfigChangedSlot()
 {
   // FIXME: Update colorspace correctly
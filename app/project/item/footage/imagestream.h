@@ -43,9 +43,21 @@ public:
   bool premultiplied_alpha();
   void set_premultiplied_alpha(bool e);
 
+  /**
+   * @brief Whether frames from this stream may have transparent pixels (TRUE unless the decoder knows otherwise)
+   */
+  bool has_alpha();
+  void set_has_alpha(bool e);
+
   const QString& colorspace();
   void set_colorspace(const QString& color);
 
+  /**
+   * @brief How many times smaller this stream is than the stream it's a proxy of (1 if it isn't a proxy)
+   */
+  const int& proxy_divider();
+  void set_proxy_divider(const int& divider);
+
 signals:
   void ColorSpaceChanged();
 
@@ -53,7 +65,9 @@ private:
   int width_;
   int height_;
   bool premultiplied_alpha_;
+  bool has_alpha_;
   QString colorspace_;
+  int proxy_divider_;
 
 private slots:
   void ColorConfigChangedSlot();
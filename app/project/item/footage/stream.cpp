@@ -24,6 +24,9 @@
 
 Stream::Stream() :
   footage_(nullptr),
+  duration_(0),
+  start_time_(0),
+  index_(0),
   type_(kUnknown),
   enabled_(true)
 {
@@ -89,6 +92,26 @@ void Stream::set_duration(const int64_t &duration)
   duration_ = duration;
 }
 
+const int64_t &Stream::start_time() const
+{
+  return start_time_;
+}
+
+void Stream::set_start_time(const int64_t &start_time)
+{
+  start_time_ = start_time;
+}
+
+const QString &Stream::codec() const
+{
+  return codec_;
+}
+
+void Stream::set_codec(const QString &codec)
+{
+  codec_ = codec;
+}
+
 bool Stream::enabled()
 {
   return enabled_;
@@ -79,6 +79,18 @@ public:
   const int64_t& duration() const;
   void set_duration(const int64_t& duration);
 
+  /**
+   * @brief Timestamp (in timebase()) of this stream's first frame or sample, which decoders' times are relative to
+   */
+  const int64_t& start_time() const;
+  void set_start_time(const int64_t& start_time);
+
+  /**
+   * @brief Name of the codec this stream is encoded with, purely for metadata
+   */
+  const QString& codec() const;
+  void set_codec(const QString& codec);
+
   bool enabled();
   void set_enabled(bool e);
 
@@ -91,8 +103,12 @@ private:
 
   int64_t duration_;
 
+  int64_t start_time_;
+
   int index_;
 
+  QString codec_;
+
   Type type_;
 
   bool enabled_;
@@ -21,6 +21,7 @@
 #include "sequence.h"
 
 #include <QCoreApplication>
+#include <QDebug>
 
 #include "common/channellayout.h"
 #include "common/timecodefunctions.h"
@@ -28,13 +29,15 @@
 #include "panel/node/node.h"
 #include "panel/timeline/timeline.h"
 #include "panel/viewer/viewer.h"
+#include "project/projectserializer.h"
 #include "ui/icons/icons.h"
 
 Sequence::Sequence() :
   timeline_output_(nullptr),
   viewer_output_(nullptr),
   video_track_output_(nullptr),
-  audio_track_output_(nullptr)
+  audio_track_output_(nullptr),
+  uuid_(QUuid::createUuid())
 {
 }
 
@@ -42,6 +45,8 @@ void Sequence::Open(SequencePtr sequence)
 {
   // FIXME: This is fairly "hardcoded" behavior and doesn't support infinite panels
 
+  sequence->Materialize();
+
   ViewerPanel* viewer_panel = olive::panel_manager->MostRecentlyFocused<ViewerPanel>();
   TimelinePanel* timeline_panel = olive::panel_manager->MostRecentlyFocused<TimelinePanel>();
   NodePanel* node_panel = olive::panel_manager->MostRecentlyFocused<NodePanel>();
@@ -52,6 +57,7 @@ void Sequence::Open(SequencePtr sequence)
 
   connect(timeline_panel, SIGNAL(TimeChanged(const int64_t&)), viewer_panel, SLOT(SetTime(const int64_t&)));
   connect(viewer_panel, SIGNAL(TimeChanged(const int64_t&)), timeline_panel, SLOT(SetTime(const int64_t&)));
+  connect(viewer_panel, SIGNAL(FrameStatusChanged(const FrameStatusSpans&)), timeline_panel, SLOT(SetFrameStatus(const FrameStatusSpans&)));
 }
 
 void Sequence::add_default_nodes()
@@ -86,6 +92,7 @@ void Sequence::add_default_nodes()
   // Update the timebase on these nodes
   set_video_params(video_params_);
   set_audio_params(audio_params_);
+  set_uuid(uuid_);
 }
 
 Item::Type Sequence::type() const
@@ -100,11 +107,11 @@ QIcon Sequence::icon()
 
 QString Sequence::duration()
 {
-  if (timeline_output_ == nullptr) {
+  if (timeline_output_ == nullptr && IsMaterialized()) {
     return QString();
   }
 
-  rational timeline_length = timeline_output_->length();
+  rational timeline_length = length();
 
   int64_t timestamp = olive::time_to_timestamp(timeline_length, video_params_.time_base());
 
@@ -145,9 +152,102 @@ void Sequence::set_audio_params(const AudioParams &params)
     viewer_output_->set_audio_params(audio_params_);
 }
 
+const QUuid &Sequence::uuid() const
+{
+  return uuid_;
+}
+
+void Sequence::set_uuid(const QUuid &uuid)
+{
+  uuid_ = uuid;
+
+  if (viewer_output_ != nullptr)
+    viewer_output_->set_cache_name(uuid_.toString());
+}
+
 void Sequence::set_default_parameters()
 {
   // FIXME: Make these configurable (hardcoded)
   set_video_params(VideoParams(1920, 1080, rational(1001, 30000)));
   set_audio_params(AudioParams(48000, AV_CH_LAYOUT_STEREO));
 }
+
+void Sequence::SetLazyGraph(const QByteArray &data, const rational &length)
+{
+  lazy_graph_ = data;
+  lazy_length_ = length;
+}
+
+bool Sequence::IsMaterialized() const
+{
+  return lazy_graph_.isEmpty();
+}
+
+const QByteArray &Sequence::lazy_graph() const
+{
+  return lazy_graph_;
+}
+
+void Sequence::Materialize()
+{
+  if (IsMaterialized()) {
+    return;
+  }
+
+  QByteArray data = lazy_graph_;
+  lazy_graph_.clear();
+
+  if (ProjectSerializer::DeserializeGraph(data, this)) {
+    FindDefaultNodes();
+  }
+
+  if (timeline_output_ == nullptr || viewer_output_ == nullptr) {
+    qWarning() << "Failed to read the node graph of" << name() << "- using an empty sequence instead";
+
+    Clear();
+
+    timeline_output_ = nullptr;
+    viewer_output_ = nullptr;
+    video_track_output_ = nullptr;
+    audio_track_output_ = nullptr;
+
+    add_default_nodes();
+  }
+}
+
+rational Sequence::length()
+{
+  if (timeline_output_ == nullptr) {
+    return lazy_length_;
+  }
+
+  return timeline_output_->length();
+}
+
+ViewerOutput *Sequence::viewer_output() const
+{
+  return viewer_output_;
+}
+
+void Sequence::FindDefaultNodes()
+{
+  foreach (Node* n, nodes()) {
+    if (timeline_output_ == nullptr) {
+      timeline_output_ = qobject_cast<TimelineOutput*>(n);
+    }
+
+    if (viewer_output_ == nullptr) {
+      viewer_output_ = qobject_cast<ViewerOutput*>(n);
+    }
+  }
+
+  if (viewer_output_ != nullptr) {
+    video_track_output_ = qobject_cast<TrackOutput*>(viewer_output_->texture_input()->get_connected_node());
+    audio_track_output_ = qobject_cast<TrackOutput*>(viewer_output_->samples_input()->get_connected_node());
+  }
+
+  // Update the timebase on these nodes
+  set_video_params(video_params_);
+  set_audio_params(audio_params_);
+  set_uuid(uuid_);
+}
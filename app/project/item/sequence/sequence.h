@@ -21,6 +21,8 @@
 #ifndef SEQUENCE_H
 #define SEQUENCE_H
 
+#include <QUuid>
+
 #include "common/rational.h"
 #include "node/graph.h"
 #include "node/output/timeline/timeline.h"
@@ -61,7 +63,62 @@ public:
 
   void set_default_parameters();
 
+  /**
+   * @brief An ID that stays the same for the lifetime of this sequence, including across saving and loading
+   *
+   * Used as the viewer's cache name (see ViewerOutput::cache_name()) so frames cached in a previous session are
+   * found again. New sequences are given a random one.
+   */
+  const QUuid& uuid() const;
+  void set_uuid(const QUuid& uuid);
+
+  /**
+   * @brief Defer creating this sequence's nodes until it's actually used
+   *
+   * @param data
+   *
+   * The sequence's node graph as saved by ProjectSerializer::SerializeGraph(). It's kept as-is until Materialize()
+   * is called, and written back unchanged if the project is saved before then.
+   *
+   * @param length
+   *
+   * The length of the sequence, shown in place of the timeline's length until the graph exists.
+   */
+  void SetLazyGraph(const QByteArray& data, const rational& length);
+
+  /**
+   * @brief Returns FALSE if this sequence's nodes haven't been created from its lazy graph yet
+   */
+  bool IsMaterialized() const;
+
+  /**
+   * @brief The graph set with SetLazyGraph(), empty once materialized
+   */
+  const QByteArray& lazy_graph() const;
+
+  /**
+   * @brief Create this sequence's nodes from its lazy graph (does nothing if they already exist)
+   *
+   * If the graph can't be read, the sequence is given the default nodes instead so it's still usable.
+   */
+  void Materialize();
+
+  /**
+   * @brief Length of the sequence's timeline
+   */
+  rational length();
+
+  /**
+   * @brief The node the sequence is rendered from (nullptr until the sequence is materialized)
+   */
+  ViewerOutput* viewer_output() const;
+
 private:
+  /**
+   * @brief Find the nodes every sequence has after they've been created by something other than add_default_nodes()
+   */
+  void FindDefaultNodes();
+
   TimelineOutput* timeline_output_;
   ViewerOutput* viewer_output_;
   TrackOutput* video_track_output_;
@@ -70,6 +127,12 @@ private:
   VideoParams video_params_;
 
   AudioParams audio_params_;
+
+  QUuid uuid_;
+
+  QByteArray lazy_graph_;
+
+  rational lazy_length_;
 };
 
 #endif // SEQUENCE_H
@@ -0,0 +1,112 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "itemsearchindex.h"
+
+void ItemSearchIndex::Add(Item *item)
+{
+  QString name = item->name().toCaseFolded();
+
+  names_.insert(item, name);
+
+  foreach (quint64 trigram, Trigrams(name)) {
+    trigrams_[trigram].insert(item);
+  }
+}
+
+void ItemSearchIndex::Remove(Item *item)
+{
+  QHash<Item*, QString>::iterator i = names_.find(item);
+
+  if (i == names_.end()) {
+    return;
+  }
+
+  foreach (quint64 trigram, Trigrams(i.value())) {
+    QHash<quint64, QSet<Item*> >::iterator t = trigrams_.find(trigram);
+
+    t.value().remove(item);
+
+    if (t.value().isEmpty()) {
+      trigrams_.erase(t);
+    }
+  }
+
+  names_.erase(i);
+}
+
+void ItemSearchIndex::Clear()
+{
+  names_.clear();
+  trigrams_.clear();
+}
+
+QSet<Item*> ItemSearchIndex::Find(const QString &query) const
+{
+  QString folded_query = query.toCaseFolded();
+
+  QSet<Item*> matches;
+
+  if (folded_query.size() < 3) {
+    for (QHash<Item*, QString>::const_iterator i=names_.constBegin();i!=names_.constEnd();i++) {
+      if (i.value().contains(folded_query)) {
+        matches.insert(i.key());
+      }
+    }
+
+    return matches;
+  }
+
+  // Only Items with every trigram of the query can match, so checking the Items with the rarest one is enough
+  const QSet<Item*>* candidates = nullptr;
+
+  foreach (quint64 trigram, Trigrams(folded_query)) {
+    QHash<quint64, QSet<Item*> >::const_iterator t = trigrams_.constFind(trigram);
+
+    if (t == trigrams_.constEnd()) {
+      return matches;
+    }
+
+    if (candidates == nullptr || t.value().size() < candidates->size()) {
+      candidates = &t.value();
+    }
+  }
+
+  foreach (Item* item, *candidates) {
+    if (names_.value(item).contains(folded_query)) {
+      matches.insert(item);
+    }
+  }
+
+  return matches;
+}
+
+QSet<quint64> ItemSearchIndex::Trigrams(const QString &name)
+{
+  QSet<quint64> trigrams;
+
+  for (int i=0;i+2<name.size();i++) {
+    trigrams.insert((static_cast<quint64>(name.at(i).unicode()) << 32)
+                    | (static_cast<quint64>(name.at(i+1).unicode()) << 16)
+                    | static_cast<quint64>(name.at(i+2).unicode()));
+  }
+
+  return trigrams;
+}
@@ -0,0 +1,74 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef ITEMSEARCHINDEX_H
+#define ITEMSEARCHINDEX_H
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+
+#include "project/item/item.h"
+
+/**
+ * @brief Finds Items by a part of their name without looking at every Item
+ *
+ * Every name is broken down into its trigrams (each run of three characters). Searching for a string of three or
+ * more characters only has to check the Items sharing the query's rarest trigram, rather than every Item in the
+ * project. Shorter queries are rare enough to type and fast enough to check directly that they just scan the names.
+ *
+ * Searches are case-insensitive.
+ */
+class ItemSearchIndex
+{
+public:
+  /**
+   * @brief Add an Item by its current name, call Remove() first if it's been renamed since it was added
+   */
+  void Add(Item* item);
+
+  void Remove(Item* item);
+
+  void Clear();
+
+  /**
+   * @brief Every Item whose name contains `query`
+   */
+  QSet<Item*> Find(const QString& query) const;
+
+private:
+  /**
+   * @brief Every unique trigram in `name`, each packed into an integer
+   */
+  static QSet<quint64> Trigrams(const QString& name);
+
+  /**
+   * @brief Folded name of every Item as it was added
+   */
+  QHash<Item*, QString> names_;
+
+  /**
+   * @brief Items containing each trigram
+   */
+  QHash<quint64, QSet<Item*> > trigrams_;
+
+};
+
+#endif // ITEMSEARCHINDEX_H
@@ -40,6 +40,16 @@ void Project::set_name(const QString &s)
   name_ = s;
 }
 
+const QString &Project::filename()
+{
+  return filename_;
+}
+
+void Project::set_filename(const QString &s)
+{
+  filename_ = s;
+}
+
 const QString &Project::ocio_config()
 {
   return ocio_config_;
@@ -48,6 +48,12 @@ public:
   const QString& name();
   void set_name(const QString& s);
 
+  /**
+   * @brief The file this project was last saved to or opened from (empty if it's never been saved)
+   */
+  const QString& filename();
+  void set_filename(const QString& s);
+
   const QString& ocio_config();
   void set_ocio_config(const QString& ocio_config);
 
@@ -59,6 +65,8 @@ private:
 
   QString name_;
 
+  QString filename_;
+
   QString ocio_config_;
   QString default_input_colorspace_;
 };
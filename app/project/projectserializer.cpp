@@ -0,0 +1,875 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "projectserializer.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include "decoder/probecache.h"
+#include "node/block/block.h"
+#include "node/factory.h"
+#include "project/item/folder/folder.h"
+
+const char ProjectSerializer::kGraphMagic[4] = {'O', 'G', 'R', 'F'};
+const quint32 ProjectSerializer::kVersion = 1;
+
+bool ProjectSerializer::Save(Project *project, const QString &filename)
+{
+  QSaveFile project_file(filename);
+  QSaveFile graph_file(GraphFilename(filename));
+
+  if (!project_file.open(QFile::WriteOnly) || !graph_file.open(QFile::WriteOnly)) {
+    qWarning() << "Failed to open" << filename << "for writing";
+    return false;
+  }
+
+  bool ok = (graph_file.write(GraphHeader()) >= 0);
+
+  QList<Sequence*> sequences;
+  CollectSequences(project->root(), &sequences);
+
+  QHash<Sequence*, GraphRecord> records;
+
+  foreach (Sequence* s, sequences) {
+    QByteArray graph = SerializeGraph(s);
+
+    GraphRecord record = {graph_file.pos(), graph.size()};
+    records.insert(s, record);
+
+    ok &= (graph_file.write(graph) == graph.size());
+  }
+
+  ok &= (project_file.write(SerializeProject(project, records)) >= 0);
+
+  if (!ok) {
+    qWarning() << "Failed to write" << filename;
+    project_file.cancelWriting();
+    graph_file.cancelWriting();
+    return false;
+  }
+
+  // The graph file goes first so the project file never refers to records that aren't there
+  if (!graph_file.commit() || !project_file.commit()) {
+    qWarning() << "Failed to save" << filename;
+    return false;
+  }
+
+  project->set_filename(filename);
+
+  return true;
+}
+
+ProjectPtr ProjectSerializer::Load(const QString &filename)
+{
+  QFile project_file(filename);
+
+  if (!project_file.open(QFile::ReadOnly)) {
+    qWarning() << "Failed to open" << filename << "for reading";
+    return nullptr;
+  }
+
+  QXmlStreamReader reader(&project_file);
+
+  if (!reader.readNextStartElement() || reader.name() != "project") {
+    qWarning() << filename << "is not a project file";
+    return nullptr;
+  }
+
+  QXmlStreamAttributes attributes = reader.attributes();
+
+  if (attributes.value("version").toUInt() > kVersion) {
+    qWarning() << filename << "was saved by a newer version";
+    return nullptr;
+  }
+
+  QString graph_filename = GraphFilename(filename);
+
+  if (attributes.hasAttribute("graph")) {
+    graph_filename = QFileInfo(filename).dir().filePath(attributes.value("graph").toString());
+  }
+
+  // Graph records are only sliced out of this here, they're not parsed until their sequence is used
+  QByteArray graph_data;
+  QFile graph_file(graph_filename);
+
+  if (graph_file.open(QFile::ReadOnly)) {
+    graph_data = graph_file.readAll();
+    graph_file.close();
+  }
+
+  if (!graph_data.startsWith(GraphHeader())) {
+    qWarning() << "Missing or invalid graph file for" << filename << "- sequences will be empty";
+    graph_data.clear();
+  }
+
+  ProjectPtr project = std::make_shared<Project>();
+
+  project->set_name(attributes.value("name").toString());
+  project->set_ocio_config(attributes.value("ocio").toString());
+  project->set_default_input_colorspace(attributes.value("colorspace").toString());
+
+  if (!ReadItems(&reader, project->root(), graph_data)) {
+    qWarning() << "Failed to read" << filename << ":" << reader.errorString();
+    return nullptr;
+  }
+
+  project->set_filename(filename);
+
+  return project;
+}
+
+QString ProjectSerializer::GraphFilename(const QString &filename)
+{
+  return filename + QStringLiteral(".graph");
+}
+
+QByteArray ProjectSerializer::SerializeProject(Project *project,
+                                               const QHash<Sequence *, GraphRecord> &records,
+                                               const QString &graph_filename)
+{
+  QByteArray data;
+
+  QXmlStreamWriter writer(&data);
+  writer.setAutoFormatting(true);
+
+  writer.writeStartDocument();
+
+  writer.writeStartElement("project");
+  writer.writeAttribute("version", QString::number(kVersion));
+  writer.writeAttribute("name", project->name());
+  writer.writeAttribute("ocio", project->ocio_config());
+  writer.writeAttribute("colorspace", project->default_input_colorspace());
+
+  if (!graph_filename.isEmpty()) {
+    writer.writeAttribute("graph", graph_filename);
+  }
+
+  Folder* root = project->root();
+
+  for (int i=0;i<root->child_count();i++) {
+    WriteItem(&writer, root->child(i), records);
+  }
+
+  writer.writeEndElement(); // project
+
+  writer.writeEndDocument();
+
+  return data;
+}
+
+QByteArray ProjectSerializer::GraphHeader()
+{
+  QByteArray header;
+
+  QDataStream ds(&header, QIODevice::WriteOnly);
+  ds.setVersion(QDataStream::Qt_5_0);
+  ds.writeRawData(kGraphMagic, sizeof(kGraphMagic));
+  ds << kVersion;
+
+  return header;
+}
+
+void ProjectSerializer::CollectSequences(Item *item, QList<Sequence *> *sequences)
+{
+  for (int i=0;i<item->child_count();i++) {
+    Item* child = item->child(i);
+
+    if (child->type() == Item::kSequence) {
+      sequences->append(static_cast<Sequence*>(child));
+    } else if (child->CanHaveChildren()) {
+      CollectSequences(child, sequences);
+    }
+  }
+}
+
+void ProjectSerializer::WriteItem(QXmlStreamWriter *writer, Item *item, const QHash<Sequence *, GraphRecord> &records)
+{
+  switch (item->type()) {
+  case Item::kFolder:
+    writer->writeStartElement("folder");
+    writer->writeAttribute("name", item->name());
+
+    for (int i=0;i<item->child_count();i++) {
+      WriteItem(writer, item->child(i), records);
+    }
+
+    writer->writeEndElement(); // folder
+    break;
+  case Item::kFootage:
+  {
+    Footage* footage = static_cast<Footage*>(item);
+
+    writer->writeStartElement("footage");
+    writer->writeAttribute("name", footage->name());
+    writer->writeAttribute("filename", footage->filename());
+    writer->writeAttribute("timestamp", footage->timestamp().toString(Qt::ISODate));
+
+    // Storing the probe results means opening the project doesn't have to open every file with a decoder
+    if (footage->status() == Footage::kReady) {
+      writer->writeAttribute("streams", QString::fromLatin1(ProbeCache::Serialize(footage).toBase64()));
+    }
+
+    writer->writeEndElement(); // footage
+    break;
+  }
+  case Item::kSequence:
+  {
+    Sequence* sequence = static_cast<Sequence*>(item);
+
+    GraphRecord record = records.value(sequence, {0, 0});
+
+    rational length = sequence->length();
+
+    writer->writeStartElement("sequence");
+    writer->writeAttribute("name", sequence->name());
+    writer->writeAttribute("uuid", sequence->uuid().toString());
+    writer->writeAttribute("width", QString::number(sequence->video_params().width()));
+    writer->writeAttribute("height", QString::number(sequence->video_params().height()));
+    writer->writeAttribute("timebasenum", QString::number(sequence->video_params().time_base().numerator()));
+    writer->writeAttribute("timebaseden", QString::number(sequence->video_params().time_base().denominator()));
+    writer->writeAttribute("samplerate", QString::number(sequence->audio_params().sample_rate()));
+    writer->writeAttribute("channellayout", QString::number(sequence->audio_params().channel_layout()));
+    writer->writeAttribute("lengthnum", QString::number(length.numerator()));
+    writer->writeAttribute("lengthden", QString::number(length.denominator()));
+    writer->writeAttribute("graphoffset", QString::number(record.offset));
+    writer->writeAttribute("graphsize", QString::number(record.size));
+    writer->writeEndElement(); // sequence
+    break;
+  }
+  }
+}
+
+bool ProjectSerializer::ReadItems(QXmlStreamReader *reader, Item *parent, const QByteArray &graph_data)
+{
+  while (reader->readNextStartElement()) {
+    QXmlStreamAttributes attributes = reader->attributes();
+
+    if (reader->name() == "folder") {
+      ItemPtr folder = std::make_shared<Folder>();
+      folder->set_name(attributes.value("name").toString());
+      parent->add_child(folder);
+
+      if (!ReadItems(reader, folder.get(), graph_data)) {
+        return false;
+      }
+
+      continue;
+    }
+
+    if (reader->name() == "footage") {
+      std::shared_ptr<Footage> footage = std::make_shared<Footage>();
+
+      footage->set_name(attributes.value("name").toString());
+      footage->set_filename(attributes.value("filename").toString());
+      footage->set_timestamp(QDateTime::fromString(attributes.value("timestamp").toString(), Qt::ISODate));
+
+      QByteArray streams = QByteArray::fromBase64(attributes.value("streams").toLatin1());
+
+      if (!streams.isEmpty()) {
+        if (ProbeCache::Deserialize(streams, footage.get())) {
+          footage->set_status(Footage::kReady);
+        } else {
+          footage->Clear();
+        }
+      }
+
+      parent->add_child(footage);
+    } else if (reader->name() == "sequence") {
+      SequencePtr sequence = std::make_shared<Sequence>();
+
+      sequence->set_name(attributes.value("name").toString());
+
+      // Projects from before sequences had IDs keep the random one they were just given
+      QUuid uuid(attributes.value("uuid").toString());
+
+      if (!uuid.isNull()) {
+        sequence->set_uuid(uuid);
+      }
+
+      sequence->set_video_params(VideoParams(attributes.value("width").toInt(),
+                                             attributes.value("height").toInt(),
+                                             rational(attributes.value("timebasenum").toLongLong(),
+                                                      attributes.value("timebaseden").toLongLong())));
+      sequence->set_audio_params(AudioParams(attributes.value("samplerate").toInt(),
+                                             attributes.value("channellayout").toULongLong()));
+
+      qint64 graph_offset = attributes.value("graphoffset").toLongLong();
+      qint64 graph_size = attributes.value("graphsize").toLongLong();
+
+      QByteArray graph;
+
+      if (graph_offset > 0 && graph_size > 0 && graph_offset + graph_size <= graph_data.size()) {
+        graph = graph_data.mid(static_cast<int>(graph_offset), static_cast<int>(graph_size));
+      }
+
+      if (graph.isEmpty()) {
+        qWarning() << "No node graph found for" << sequence->name();
+        sequence->add_default_nodes();
+      } else {
+        sequence->SetLazyGraph(graph, rational(attributes.value("lengthnum").toLongLong(),
+                                               qMax(1LL, attributes.value("lengthden").toLongLong())));
+      }
+
+      parent->add_child(sequence);
+    }
+
+    reader->skipCurrentElement();
+  }
+
+  return !reader->hasError();
+}
+
+QByteArray ProjectSerializer::SerializeGraph(Sequence *sequence)
+{
+  // A sequence that was never opened still has the record it was loaded with
+  if (!sequence->IsMaterialized()) {
+    return sequence->lazy_graph();
+  }
+
+  return SerializeNodes(sequence->nodes());
+}
+
+QByteArray ProjectSerializer::SerializeNodes(const QList<Node *> &nodes)
+{
+  QByteArray data;
+
+  QDataStream ds(&data, QIODevice::WriteOnly);
+  ds.setVersion(QDataStream::Qt_5_0);
+
+  QHash<Node*, int> node_indices;
+
+  for (int i=0;i<nodes.size();i++) {
+    node_indices.insert(nodes.at(i), i);
+  }
+
+  ds << static_cast<quint32>(nodes.size());
+
+  foreach (Node* n, nodes) {
+    ds << n->id() << n->CanBeDeleted();
+
+    if (n->IsBlock()) {
+      Block* block = static_cast<Block*>(n);
+
+      ds << static_cast<qint64>(block->length().numerator())
+         << static_cast<qint64>(block->length().denominator())
+         << static_cast<qint64>(block->media_in().numerator())
+         << static_cast<qint64>(block->media_in().denominator())
+         << block->block_name();
+    }
+
+    QList<NodeInput*> inputs;
+
+    foreach (NodeParam* param, n->parameters()) {
+      if (param->type() == NodeParam::kInput) {
+        inputs.append(static_cast<NodeInput*>(param));
+      }
+    }
+
+    ds << static_cast<quint32>(inputs.size());
+
+    foreach (NodeInput* input, inputs) {
+      ds << input->id();
+
+      WriteInput(ds, input);
+    }
+  }
+
+  // Connections are written once every node exists, each as the input it's connected to (and the array index if the
+  // input is part of an array) and the node and output it's connected from
+  QByteArray edge_data;
+  QDataStream edge_ds(&edge_data, QIODevice::WriteOnly);
+  edge_ds.setVersion(QDataStream::Qt_5_0);
+  quint32 edge_count = 0;
+
+  for (int i=0;i<nodes.size();i++) {
+    foreach (NodeParam* param, nodes.at(i)->parameters()) {
+      if (param->type() != NodeParam::kInput) {
+        continue;
+      }
+
+      NodeInput* input = static_cast<NodeInput*>(param);
+
+      QList<NodeInput*> connectable;
+      connectable.append(input);
+
+      if (input->IsArray()) {
+        connectable.append(static_cast<NodeInputArray*>(input)->sub_params().toList());
+      }
+
+      for (int j=0;j<connectable.size();j++) {
+        NodeOutput* output = connectable.at(j)->get_connected_output();
+
+        // Connections to nodes outside the list can't be restored
+        if (output == nullptr || !node_indices.contains(output->parentNode())) {
+          continue;
+        }
+
+        edge_ds << static_cast<quint32>(i)
+                << input->id()
+                << static_cast<qint32>(j - 1)
+                << static_cast<quint32>(node_indices.value(output->parentNode()))
+                << output->id();
+
+        edge_count++;
+      }
+    }
+  }
+
+  ds << edge_count;
+  ds.writeRawData(edge_data.constData(), edge_data.size());
+
+  // Links between blocks, each pair once
+  QVector<quint32> links;
+
+  for (int i=0;i<nodes.size();i++) {
+    if (!nodes.at(i)->IsBlock()) {
+      continue;
+    }
+
+    foreach (Block* linked, static_cast<Block*>(nodes.at(i))->linked_clips()) {
+      int linked_index = node_indices.value(linked, -1);
+
+      if (linked_index > i) {
+        links.append(static_cast<quint32>(i));
+        links.append(static_cast<quint32>(linked_index));
+      }
+    }
+  }
+
+  ds << links;
+
+  // Projects from before nodes could be bypassed end here, so this comes last
+  QVector<quint32> bypassed;
+
+  for (int i=0;i<nodes.size();i++) {
+    if (nodes.at(i)->IsBypassed()) {
+      bypassed.append(static_cast<quint32>(i));
+    }
+  }
+
+  ds << bypassed;
+
+  return data;
+}
+
+bool ProjectSerializer::DeserializeGraph(const QByteArray &data, Sequence *sequence)
+{
+  QVector<Node*> nodes;
+
+  if (!DeserializeNodes(data, sequence->root(), &nodes)) {
+    return false;
+  }
+
+  foreach (Node* n, nodes) {
+    sequence->AddNode(n);
+  }
+
+  return true;
+}
+
+bool ProjectSerializer::DeserializeNodes(const QByteArray &data, const Item* footage_root, QVector<Node *> *created)
+{
+  QHash<QString, Footage*> footage;
+
+  if (footage_root != nullptr) {
+    CollectFootage(footage_root, &footage);
+  }
+
+  QDataStream ds(data);
+  ds.setVersion(QDataStream::Qt_5_0);
+
+  quint32 node_count;
+  ds >> node_count;
+
+  if (ds.status() != QDataStream::Ok) {
+    return false;
+  }
+
+  QVector<Node*> nodes;
+  nodes.reserve(static_cast<int>(node_count));
+
+  bool valid = true;
+
+  for (quint32 i=0;i<node_count && valid;i++) {
+    QString id;
+    bool can_be_deleted;
+
+    ds >> id >> can_be_deleted;
+
+    Node* n = NodeFactory::CreateFromID(id);
+
+    if (n == nullptr) {
+      // We can't skip over the node since we don't know what it contains
+      qWarning() << "Unknown node" << id;
+      valid = false;
+      break;
+    }
+
+    nodes.append(n);
+
+    n->SetCanBeDeleted(can_be_deleted);
+
+    if (n->IsBlock()) {
+      Block* block = static_cast<Block*>(n);
+      qint64 length_num, length_den, media_in_num, media_in_den;
+      QString block_name;
+
+      ds >> length_num >> length_den >> media_in_num >> media_in_den >> block_name;
+
+      if (ds.status() != QDataStream::Ok || length_den == 0 || media_in_den == 0) {
+        valid = false;
+        break;
+      }
+
+      block->set_block_name(block_name);
+      block->set_media_in(rational(media_in_num, media_in_den));
+
+      // Tracks have no length of their own, it's derived from their blocks
+      if (length_num > 0) {
+        block->set_length(rational(length_num, length_den));
+      }
+    }
+
+    quint32 input_count;
+    ds >> input_count;
+
+    for (quint32 j=0;j<input_count && valid;j++) {
+      QString input_id;
+      ds >> input_id;
+
+      NodeParam* param = n->GetParameterWithID(input_id);
+      NodeInput* input = (param != nullptr && param->type() == NodeParam::kInput) ? static_cast<NodeInput*>(param) : nullptr;
+
+      valid = ReadInput(ds, input, footage);
+    }
+  }
+
+  quint32 edge_count = 0;
+
+  if (valid) {
+    ds >> edge_count;
+    valid = (ds.status() == QDataStream::Ok);
+  }
+
+  if (!valid) {
+    qDeleteAll(nodes);
+    return false;
+  }
+
+  // From here on the nodes are valid even if the rest is cut short, so they're handed over whatever happens
+  *created = nodes;
+
+  for (quint32 i=0;i<edge_count;i++) {
+    quint32 input_node, output_node;
+    QString input_id, output_id;
+    qint32 array_index;
+
+    ds >> input_node >> input_id >> array_index >> output_node >> output_id;
+
+    if (ds.status() != QDataStream::Ok) {
+      return false;
+    }
+
+    if (input_node >= node_count || output_node >= node_count) {
+      continue;
+    }
+
+    NodeParam* input_param = nodes.at(static_cast<int>(input_node))->GetParameterWithID(input_id);
+    NodeParam* output_param = nodes.at(static_cast<int>(output_node))->GetParameterWithID(output_id);
+
+    if (input_param == nullptr || input_param->type() != NodeParam::kInput
+        || output_param == nullptr || output_param->type() != NodeParam::kOutput) {
+      continue;
+    }
+
+    NodeInput* input = static_cast<NodeInput*>(input_param);
+
+    if (array_index >= 0) {
+      if (!input->IsArray() || array_index >= static_cast<NodeInputArray*>(input)->GetSize()) {
+        continue;
+      }
+
+      input = static_cast<NodeInputArray*>(input)->ParamAt(array_index);
+    }
+
+    NodeParam::ConnectEdge(static_cast<NodeOutput*>(output_param), input);
+  }
+
+  QVector<quint32> links;
+  ds >> links;
+
+  for (int i=0;i+1<links.size();i+=2) {
+    Node* a = nodes.value(static_cast<int>(links.at(i)));
+    Node* b = nodes.value(static_cast<int>(links.at(i+1)));
+
+    if (a != nullptr && b != nullptr && a->IsBlock() && b->IsBlock()) {
+      Block::Link(static_cast<Block*>(a), static_cast<Block*>(b));
+    }
+  }
+
+  if (!ds.atEnd()) {
+    QVector<quint32> bypassed;
+    ds >> bypassed;
+
+    foreach (quint32 index, bypassed) {
+      Node* n = nodes.value(static_cast<int>(index));
+
+      if (n != nullptr) {
+        n->SetBypassed(true);
+      }
+    }
+  }
+
+  return true;
+}
+
+void ProjectSerializer::WriteInput(QDataStream &ds, NodeInput *input)
+{
+  const QVector<NodeKeyframe>& keys = input->keyframes();
+
+  ds << input->IsArray()
+     << static_cast<qint32>(input->data_type())
+     << input->is_keyframing()
+     << static_cast<quint32>(keys.size());
+
+  // Keyframes are stored as one flat array per property rather than one record per keyframe
+  QVector<qint64> times;
+  QVector<qint32> types;
+
+  times.reserve(keys.size() * 2);
+  types.reserve(keys.size());
+
+  foreach (const NodeKeyframe& key, keys) {
+    times.append(key.time().numerator());
+    times.append(key.time().denominator());
+    types.append(key.type());
+  }
+
+  ds << times << types;
+
+  if (input->data_type() == NodeParam::kFloat) {
+    QVector<double> values;
+    values.reserve(keys.size());
+
+    foreach (const NodeKeyframe& key, keys) {
+      values.append(key.value().toDouble());
+    }
+
+    ds << values;
+  } else {
+    foreach (const NodeKeyframe& key, keys) {
+      WriteValue(ds, input->data_type(), key.value());
+    }
+  }
+
+  if (input->IsArray()) {
+    NodeInputArray* array = static_cast<NodeInputArray*>(input);
+
+    ds << static_cast<quint32>(array->GetSize());
+
+    foreach (NodeInput* sub_input, array->sub_params()) {
+      WriteInput(ds, sub_input);
+    }
+  }
+}
+
+bool ProjectSerializer::ReadInput(QDataStream &ds, NodeInput *input, const QHash<QString, Footage*>& footage)
+{
+  bool is_array, keyframing;
+  qint32 data_type;
+  quint32 key_count;
+  QVector<qint64> times;
+  QVector<qint32> types;
+
+  ds >> is_array >> data_type >> keyframing >> key_count >> times >> types;
+
+  if (ds.status() != QDataStream::Ok
+      || static_cast<quint32>(times.size()) != key_count * 2
+      || static_cast<quint32>(types.size()) != key_count) {
+    return false;
+  }
+
+  QVector<QVariant> values;
+  values.reserve(static_cast<int>(key_count));
+
+  if (data_type == NodeParam::kFloat) {
+    QVector<double> float_values;
+    ds >> float_values;
+
+    if (static_cast<quint32>(float_values.size()) != key_count) {
+      return false;
+    }
+
+    foreach (double v, float_values) {
+      values.append(v);
+    }
+  } else {
+    for (quint32 i=0;i<key_count;i++) {
+      values.append(ReadValue(ds, static_cast<NodeParam::DataType>(data_type), footage));
+    }
+  }
+
+  if (ds.status() != QDataStream::Ok) {
+    return false;
+  }
+
+  if (input != nullptr && key_count > 0) {
+    QVector<NodeKeyframe> keys;
+    keys.reserve(static_cast<int>(key_count));
+
+    for (int i=0;i<values.size();i++) {
+      qint64 den = times.at(i*2+1);
+
+      if (den == 0) {
+        return false;
+      }
+
+      keys.append(NodeKeyframe(rational(times.at(i*2), den),
+                               values.at(i),
+                               static_cast<NodeKeyframe::Type>(types.at(i))));
+    }
+
+    input->set_is_keyframing(keyframing);
+    input->set_keyframes(keys);
+  }
+
+  if (is_array) {
+    quint32 size;
+    ds >> size;
+
+    if (ds.status() != QDataStream::Ok) {
+      return false;
+    }
+
+    NodeInputArray* array = (input != nullptr && input->IsArray()) ? static_cast<NodeInputArray*>(input) : nullptr;
+
+    if (array != nullptr) {
+      array->SetSize(static_cast<int>(size));
+    }
+
+    for (quint32 i=0;i<size;i++) {
+      if (!ReadInput(ds, (array != nullptr) ? array->ParamAt(static_cast<int>(i)) : nullptr, footage)) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+void ProjectSerializer::WriteValue(QDataStream &ds, const NodeParam::DataType &type, const QVariant &value)
+{
+  switch (type) {
+  case NodeParam::kFootage:
+  {
+    // Footage is referred to by filename and stream index, and found again in the project when loading
+    StreamPtr stream = value.value<StreamPtr>();
+
+    if (stream == nullptr || stream->footage() == nullptr) {
+      ds << QString() << static_cast<qint32>(-1);
+    } else {
+      ds << stream->footage()->filename() << static_cast<qint32>(stream->index());
+    }
+    break;
+  }
+  case NodeParam::kRational:
+  {
+    rational r = value.value<rational>();
+
+    ds << static_cast<qint64>(r.numerator()) << static_cast<qint64>(r.denominator());
+    break;
+  }
+  default:
+    // Other values are Qt types that QDataStream already knows how to write, anything else (e.g. references to
+    // resources like textures) isn't a user value and wouldn't mean anything when loaded
+    if (value.userType() < QMetaType::User) {
+      ds << value;
+    } else {
+      ds << QVariant();
+    }
+  }
+}
+
+QVariant ProjectSerializer::ReadValue(QDataStream &ds, const NodeParam::DataType &type, const QHash<QString, Footage*>& footage)
+{
+  switch (type) {
+  case NodeParam::kFootage:
+  {
+    QString filename;
+    qint32 index;
+
+    ds >> filename >> index;
+
+    Footage* f = footage.value(filename);
+
+    StreamPtr stream;
+
+    if (f != nullptr) {
+      foreach (StreamPtr s, f->streams()) {
+        if (s->index() == index) {
+          stream = s;
+          break;
+        }
+      }
+    }
+
+    return QVariant::fromValue(stream);
+  }
+  case NodeParam::kRational:
+  {
+    qint64 num, den;
+
+    ds >> num >> den;
+
+    if (den == 0) {
+      return QVariant();
+    }
+
+    return QVariant::fromValue(rational(num, den));
+  }
+  default:
+  {
+    QVariant value;
+
+    ds >> value;
+
+    return value;
+  }
+  }
+}
+
+void ProjectSerializer::CollectFootage(const Item *item, QHash<QString, Footage *> *footage)
+{
+  for (int i=0;i<item->child_count();i++) {
+    Item* child = item->child(i);
+
+    if (child->type() == Item::kFootage) {
+      Footage* f = static_cast<Footage*>(child);
+
+      footage->insert(f->filename(), f);
+    } else if (child->CanHaveChildren()) {
+      CollectFootage(child, footage);
+    }
+  }
+}
@@ -0,0 +1,166 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PROJECTSERIALIZER_H
+#define PROJECTSERIALIZER_H
+
+#include <QDataStream>
+#include <QHash>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+
+#include "project/item/footage/footage.h"
+#include "project/item/sequence/sequence.h"
+#include "project/project.h"
+
+/**
+ * @brief Reads and writes project files
+ *
+ * A project is saved as two files. The project file itself is a streamed XML document holding the project's settings
+ * and its item hierarchy (folders, footage and sequences). Alongside it, GraphFilename() holds every sequence's node
+ * graph as one binary record each. Keyframes are stored in those records as flat arrays rather than as an element per
+ * value, so even graphs with tens of thousands of clips and keyframes are quick to write and read.
+ *
+ * Loading a project only reads each sequence's record as raw bytes. The nodes are created the first time the
+ * sequence is used (see Sequence::Materialize()), so sequences that aren't opened cost next to nothing, and they're
+ * written back unchanged the next time the project is saved.
+ */
+class ProjectSerializer
+{
+public:
+  /**
+   * @brief Where a sequence's record is in a graph file
+   */
+  struct GraphRecord {
+    qint64 offset;
+    qint64 size;
+  };
+  /**
+   * @brief Save a project to `filename` (and its graph file next to it)
+   *
+   * @return
+   *
+   * FALSE if either file couldn't be written, in which case any existing files are left untouched.
+   */
+  static bool Save(Project* project, const QString& filename);
+
+  /**
+   * @brief Load a project saved with Save()
+   *
+   * @return
+   *
+   * The project, or nullptr if it couldn't be read.
+   */
+  static ProjectPtr Load(const QString& filename);
+
+  /**
+   * @brief Pack a sequence's node graph into a binary record
+   */
+  static QByteArray SerializeGraph(Sequence* sequence);
+
+  /**
+   * @brief Create the nodes of a record made by SerializeGraph() in `sequence`
+   *
+   * Footage is looked up by filename in the project `sequence` belongs to.
+   */
+  static bool DeserializeGraph(const QByteArray& data, Sequence* sequence);
+
+  /**
+   * @brief Pack `nodes` into a binary record in the same format as SerializeGraph()
+   *
+   * Connections to nodes that aren't in `nodes` are left out.
+   */
+  static QByteArray SerializeNodes(const QList<Node*>& nodes);
+
+  /**
+   * @brief Create the nodes of a record made by SerializeNodes() without adding them to a graph
+   *
+   * The nodes are connected to each other as they were, but as they don't belong to a graph yet, none of them has
+   * signalled anything. Footage is looked up by filename under `footage_root` (if it isn't nullptr).
+   *
+   * @param nodes
+   *
+   * Set to the new nodes in the order they were serialized. The caller takes ownership of them.
+   */
+  static bool DeserializeNodes(const QByteArray& data, const Item* footage_root, QVector<Node*>* nodes);
+
+  /**
+   * @brief Filename of the graph file that's saved alongside the project file `filename`
+   */
+  static QString GraphFilename(const QString& filename);
+
+  /**
+   * @brief Write the project file for `project` to a byte array
+   *
+   * @param records
+   *
+   * The location of every sequence's record in the graph file.
+   *
+   * @param graph_filename
+   *
+   * Filename (relative to the project file) of the graph file the records are in if it isn't GraphFilename(), or
+   * empty otherwise.
+   */
+  static QByteArray SerializeProject(Project* project,
+                                     const QHash<Sequence*, GraphRecord>& records,
+                                     const QString& graph_filename = QString());
+
+  /**
+   * @brief The bytes every graph file starts with, records can be written directly after
+   */
+  static QByteArray GraphHeader();
+
+  /**
+   * @brief List every Sequence under `item`
+   */
+  static void CollectSequences(Item* item, QList<Sequence*>* sequences);
+
+private:
+  static void WriteItem(QXmlStreamWriter* writer, Item* item, const QHash<Sequence*, GraphRecord>& records);
+
+  static bool ReadItems(QXmlStreamReader* reader, Item* parent, const QByteArray& graph_data);
+
+  static void WriteInput(QDataStream& ds, NodeInput* input);
+
+  /**
+   * @brief Read an input written with WriteInput()
+   *
+   * @param input
+   *
+   * The input to restore, or nullptr to read past one that no longer exists on the node.
+   */
+  static bool ReadInput(QDataStream& ds, NodeInput* input, const QHash<QString, Footage*>& footage);
+
+  static void WriteValue(QDataStream& ds, const NodeParam::DataType& type, const QVariant& value);
+
+  static QVariant ReadValue(QDataStream& ds, const NodeParam::DataType& type, const QHash<QString, Footage*>& footage);
+
+  /**
+   * @brief Map every Footage under `item` by its filename
+   */
+  static void CollectFootage(const Item* item, QHash<QString, Footage*>* footage);
+
+  static const char kGraphMagic[4];
+
+  static const quint32 kVersion;
+
+};
+
+#endif // PROJECTSERIALIZER_H
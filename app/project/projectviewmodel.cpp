@@ -20,16 +20,27 @@
 
 #include "projectviewmodel.h"
 
+#include <algorithm>
 #include <QDebug>
 #include <QMimeData>
 #include <QUrl>
 
 #include "core.h"
+#include "common/timecodefunctions.h"
+#include "config/config.h"
+#include "project/item/footage/audiostream.h"
+#include "project/item/footage/footage.h"
+#include "project/item/footage/videostream.h"
+#include "project/item/sequence/sequence.h"
+#include "render/thumbnailservice.h"
 #include "undo/undostack.h"
 
 ProjectViewModel::ProjectViewModel(QObject *parent) :
   QAbstractItemModel(parent),
-  project_(nullptr)
+  project_(nullptr),
+  sort_key_(kSortName),
+  sort_order_(Qt::AscendingOrder),
+  refilter_queued_(false)
 {
   // FIXME: make this configurable
   columns_.append(kName);
@@ -48,7 +59,16 @@ void ProjectViewModel::set_project(Project *p)
 
   project_ = p;
 
+  search_index_.Clear();
+
+  if (project_ != nullptr) {
+    IndexForSearch(project_->root());
+  }
+
   endResetModel();
+
+  // Builds the rows for the new project with the current filter
+  Refilter();
 }
 
 QModelIndex ProjectViewModel::index(int row, int column, const QModelIndex &parent) const
@@ -62,7 +82,7 @@ QModelIndex ProjectViewModel::index(int row, int column, const QModelIndex &pare
   Item* item_parent = GetItemObjectFromIndex(parent);
 
   // Return an index to this object
-  return createIndex(row, column, item_parent->child(row));
+  return createIndex(row, column, ShownChildren(item_parent).at(row));
 }
 
 QModelIndex ProjectViewModel::parent(const QModelIndex &child) const
@@ -95,13 +115,12 @@ int ProjectViewModel::rowCount(const QModelIndex &parent) const
     return 0;
   }
 
-  // If the index is the root, return the root child count
-  if (parent == QModelIndex()) {
-    return project_->root()->child_count();
+  // Only the first column has children
+  if (parent.isValid() && parent.column() != 0) {
+    return 0;
   }
 
-  // Otherwise, the index must contain a valid pointer, so we just return its child count
-  return GetItemObjectFromIndex(parent)->child_count();
+  return ShownChildren(GetItemObjectFromIndex(parent)).size();
 }
 
 int ProjectViewModel::columnCount(const QModelIndex &parent) const
@@ -145,6 +164,11 @@ QVariant ProjectViewModel::data(const QModelIndex &index, int role) const
     break;
   case Qt::ToolTipRole:
     return internal_item->tooltip();
+  case kThumbnailRole:
+    if (column_type == kName) {
+      return GetThumbnail(internal_item);
+    }
+    break;
   }
 
   return QVariant();
@@ -374,42 +398,178 @@ bool ProjectViewModel::dropMimeData(const QMimeData *data, Qt::DropAction action
   return false;
 }
 
+void ProjectViewModel::sort(int column, Qt::SortOrder order)
+{
+  if (column < 0 || column >= columns_.size()) {
+    return;
+  }
+
+  switch (columns_.at(column)) {
+  case kName:
+    SetSort(kSortName, order);
+    break;
+  case kDuration:
+    SetSort(kSortDuration, order);
+    break;
+  case kRate:
+    SetSort(kSortRate, order);
+    break;
+  }
+}
+
+void ProjectViewModel::SetSort(SortKey key, Qt::SortOrder order)
+{
+  if (sort_key_ == key && sort_order_ == order) {
+    return;
+  }
+
+  emit layoutAboutToBeChanged();
+
+  QModelIndexList old_persistent = persistentIndexList();
+
+  sort_key_ = key;
+  sort_order_ = order;
+
+  for (QHash<const Item*, QVector<Item*> >::iterator i=rows_.begin();i!=rows_.end();i++) {
+    std::sort(i.value().begin(), i.value().end(), ItemLessThan(this));
+    RenumberRows(i.key(), 0);
+  }
+
+  // Items haven't moved between folders, only within them
+  QModelIndexList new_persistent;
+
+  foreach (const QModelIndex& index, old_persistent) {
+    if (index.isValid()) {
+      new_persistent.append(CreateIndexFromItem(GetItemObjectFromIndex(index), index.column()));
+    } else {
+      new_persistent.append(index);
+    }
+  }
+
+  changePersistentIndexList(old_persistent, new_persistent);
+
+  emit layoutChanged();
+}
+
+void ProjectViewModel::SetFilter(const QString &filter)
+{
+  QString trimmed = filter.trimmed();
+
+  if (filter_ == trimmed) {
+    return;
+  }
+
+  filter_ = trimmed;
+
+  Refilter();
+}
+
 void ProjectViewModel::AddChild(Item *parent, ItemPtr child)
 {
+  parent->add_child(child);
+
+  IndexForSearch(child.get());
+
+  if (!filter_.isEmpty()) {
+    // This may also show folders that weren't shown before
+    QueueRefilter();
+    return;
+  }
+
   QModelIndex parent_index;
 
   if (parent != project_->root()) {
     parent_index = CreateIndexFromItem(parent);
   }
 
-  beginInsertRows(parent_index, parent->child_count(), parent->child_count());
+  QVector<Item*> siblings = ShownChildren(parent);
+  int row = static_cast<int>(std::lower_bound(siblings.begin(), siblings.end(), child.get(), ItemLessThan(this))
+                             - siblings.begin());
 
-  parent->add_child(child);
+  beginInsertRows(parent_index, row, row);
+
+  InsertRow(child.get());
+  BuildRows(child.get());
 
   endInsertRows();
 }
 
 void ProjectViewModel::RemoveChild(Item *parent, Item *child)
 {
-  QModelIndex parent_index;
+  UnindexForSearch(child);
 
-  if (parent != project_->root()) {
-    parent_index = CreateIndexFromItem(parent);
-  }
+  filter_shown_.remove(child);
+
+  if (row_of_.contains(child)) {
+    QModelIndex parent_index;
 
-  int child_row = IndexOfChild(child);
+    if (parent != project_->root()) {
+      parent_index = CreateIndexFromItem(parent);
+    }
+
+    int child_row = IndexOfChild(child);
 
-  beginRemoveRows(parent_index, child_row, child_row);
+    beginRemoveRows(parent_index, child_row, child_row);
 
-  parent->remove_child(child);
+    RemoveRow(child);
+    ForgetRows(child);
 
-  endRemoveRows();
+    parent->remove_child(child);
+
+    endRemoveRows();
+  } else {
+    parent->remove_child(child);
+  }
+
+  if (!filter_.isEmpty()) {
+    // The folders it was in may not have anything else to show
+    QueueRefilter();
+  }
 }
 
 void ProjectViewModel::RenameChild(Item *item, const QString &name)
 {
+  search_index_.Remove(item);
+
   item->set_name(name);
 
+  search_index_.Add(item);
+
+  if (!filter_.isEmpty()) {
+    QueueRefilter();
+  }
+
+  if (!row_of_.contains(item)) {
+    return;
+  }
+
+  // Move the item to where its new name belongs (whatever the sort key is, names are the tiebreaker)
+  Item* parent = item->parent();
+  QModelIndex parent_index;
+
+  if (parent != project_->root()) {
+    parent_index = CreateIndexFromItem(parent);
+  }
+
+  int old_row = IndexOfChild(item);
+
+  QVector<Item*> siblings = ShownChildren(parent);
+  siblings.remove(old_row);
+
+  int new_row = static_cast<int>(std::lower_bound(siblings.begin(), siblings.end(), item, ItemLessThan(this))
+                                 - siblings.begin());
+
+  if (new_row != old_row) {
+    // Qt wants the destination row as it is before the move
+    beginMoveRows(parent_index, old_row, old_row, parent_index, (new_row > old_row) ? new_row + 1 : new_row);
+
+    siblings.insert(new_row, item);
+    rows_.insert(parent, siblings);
+    RenumberRows(parent, qMin(old_row, new_row));
+
+    endMoveRows();
+  }
+
   QModelIndex index = CreateIndexFromItem(item, columns_.indexOf(kName));
 
   emit dataChanged(index, index, {Qt::DisplayRole, Qt::EditRole});
@@ -417,31 +577,20 @@ void ProjectViewModel::RenameChild(Item *item, const QString &name)
 
 int ProjectViewModel::IndexOfChild(Item *item) const
 {
-  // Find parent's index within its own parent
-  // (FIXME: this model should handle sorting, which means it'll have to "know" the indices)
+  // Find item's index within its parent's shown children
 
   if (item == project_->root()) {
     return -1;
   }
 
-  Item* parent = item->parent();
-
-  if (parent != nullptr) {
-    for (int i=0;i<parent->child_count();i++) {
-      if (parent->child(i) == item) {
-        return i;
-      }
-    }
-  }
-
-  return -1;
+  return row_of_.value(item, -1);
 }
 
 int ProjectViewModel::ChildCount(const QModelIndex &index)
 {
   Item* item = GetItemObjectFromIndex(index);
 
-  return item->child_count();
+  return ShownChildren(item).size();
 }
 
 Item *ProjectViewModel::GetItemObjectFromIndex(const QModelIndex &index) const
@@ -469,16 +618,36 @@ bool ProjectViewModel::ItemIsParentOfChild(Item *parent, Item *child) const
 
 void ProjectViewModel::MoveItemInternal(Item *item, Item *destination)
 {
+  ItemPtr item_ptr = item->parent()->shared_ptr_from_raw(item);
+
+  if (!filter_.isEmpty() || !row_of_.contains(item)) {
+    destination->add_child(item_ptr);
+
+    if (!filter_.isEmpty()) {
+      QueueRefilter();
+    }
+
+    return;
+  }
+
   QModelIndex item_index = CreateIndexFromItem(item);
 
   QModelIndex destination_index = CreateIndexFromItem(destination);
 
-  beginMoveRows(item_index.parent(), item_index.row(), item_index.row(), destination_index, destination->child_count());
+  QVector<Item*> destination_children = ShownChildren(destination);
+  int destination_row = static_cast<int>(std::lower_bound(destination_children.begin(),
+                                                          destination_children.end(),
+                                                          item,
+                                                          ItemLessThan(this)) - destination_children.begin());
 
-  ItemPtr item_ptr = item->parent()->shared_ptr_from_raw(item);
+  beginMoveRows(item_index.parent(), item_index.row(), item_index.row(), destination_index, destination_row);
+
+  RemoveRow(item);
 
   destination->add_child(item_ptr);
 
+  InsertRow(item);
+
   endMoveRows();
 }
 
@@ -487,6 +656,298 @@ QModelIndex ProjectViewModel::CreateIndexFromItem(Item *item, int column)
   return createIndex(IndexOfChild(item), column, item);
 }
 
+ProjectViewModel::ItemLessThan::ItemLessThan(const ProjectViewModel *model) :
+  model_(model)
+{
+}
+
+bool ProjectViewModel::ItemLessThan::operator()(Item *a, Item *b) const
+{
+  int result = 0;
+
+  switch (model_->sort_key_) {
+  case kSortName:
+    break;
+  case kSortDuration:
+  {
+    double a_duration = ItemDurationInSeconds(a);
+    double b_duration = ItemDurationInSeconds(b);
+
+    result = (a_duration < b_duration) ? -1 : (a_duration > b_duration) ? 1 : 0;
+    break;
+  }
+  case kSortRate:
+  {
+    double a_rate = ItemRate(a);
+    double b_rate = ItemRate(b);
+
+    result = (a_rate < b_rate) ? -1 : (a_rate > b_rate) ? 1 : 0;
+    break;
+  }
+  case kSortType:
+    result = static_cast<int>(a->type()) - static_cast<int>(b->type());
+    break;
+  case kSortDate:
+  {
+    // Only footage has a date, everything else goes first
+    QDateTime a_date = (a->type() == Item::kFootage) ? static_cast<Footage*>(a)->timestamp() : QDateTime();
+    QDateTime b_date = (b->type() == Item::kFootage) ? static_cast<Footage*>(b)->timestamp() : QDateTime();
+
+    result = (a_date < b_date) ? -1 : (b_date < a_date) ? 1 : 0;
+    break;
+  }
+  }
+
+  if (result == 0) {
+    result = QString::compare(a->name(), b->name(), Qt::CaseInsensitive);
+  }
+
+  if (result == 0) {
+    // Only so no two items are ever equal, which keeps the order stable
+    result = (a < b) ? -1 : (a > b) ? 1 : 0;
+  }
+
+  return (model_->sort_order_ == Qt::AscendingOrder) ? (result < 0) : (result > 0);
+}
+
+const QVector<Item *> &ProjectViewModel::ShownChildren(const Item *item) const
+{
+  static const QVector<Item*> no_children;
+
+  QHash<const Item*, QVector<Item*> >::const_iterator i = rows_.constFind(item);
+
+  if (i == rows_.constEnd()) {
+    return no_children;
+  }
+
+  return i.value();
+}
+
+bool ProjectViewModel::IsShown(Item *item) const
+{
+  return filter_.isEmpty() || filter_shown_.contains(item);
+}
+
+void ProjectViewModel::BuildRows(Item *item)
+{
+  if (item == nullptr || !item->CanHaveChildren()) {
+    return;
+  }
+
+  QVector<Item*> children;
+  children.reserve(item->child_count());
+
+  for (int i=0;i<item->child_count();i++) {
+    Item* child = item->child(i);
+
+    if (IsShown(child)) {
+      children.append(child);
+    }
+  }
+
+  std::sort(children.begin(), children.end(), ItemLessThan(this));
+
+  rows_.insert(item, children);
+  RenumberRows(item, 0);
+
+  foreach (Item* child, children) {
+    BuildRows(child);
+  }
+}
+
+void ProjectViewModel::ForgetRows(Item *item)
+{
+  QHash<const Item*, QVector<Item*> >::iterator i = rows_.find(item);
+
+  if (i == rows_.end()) {
+    return;
+  }
+
+  QVector<Item*> children = i.value();
+
+  rows_.erase(i);
+
+  foreach (Item* child, children) {
+    row_of_.remove(child);
+
+    ForgetRows(child);
+  }
+}
+
+int ProjectViewModel::InsertRow(Item *item)
+{
+  Item* parent = item->parent();
+
+  QVector<Item*>& siblings = rows_[parent];
+
+  int row = static_cast<int>(std::lower_bound(siblings.begin(), siblings.end(), item, ItemLessThan(this))
+                             - siblings.begin());
+
+  siblings.insert(row, item);
+
+  RenumberRows(parent, row);
+
+  return row;
+}
+
+void ProjectViewModel::RemoveRow(Item *item)
+{
+  Item* parent = item->parent();
+
+  int row = row_of_.take(item);
+
+  rows_[parent].remove(row);
+
+  RenumberRows(parent, row);
+}
+
+void ProjectViewModel::RenumberRows(const Item *parent, int from)
+{
+  const QVector<Item*>& children = ShownChildren(parent);
+
+  for (int i=from;i<children.size();i++) {
+    row_of_.insert(children.at(i), i);
+  }
+}
+
+void ProjectViewModel::IndexForSearch(Item *item)
+{
+  // The root isn't shown, so there's no need to find it
+  if (item != project_->root()) {
+    search_index_.Add(item);
+  }
+
+  for (int i=0;i<item->child_count();i++) {
+    IndexForSearch(item->child(i));
+  }
+}
+
+void ProjectViewModel::UnindexForSearch(Item *item)
+{
+  search_index_.Remove(item);
+
+  for (int i=0;i<item->child_count();i++) {
+    UnindexForSearch(item->child(i));
+  }
+}
+
+void ProjectViewModel::QueueRefilter()
+{
+  if (!refilter_queued_) {
+    QMetaObject::invokeMethod(this, "Refilter", Qt::QueuedConnection);
+    refilter_queued_ = true;
+  }
+}
+
+QImage ProjectViewModel::GetThumbnail(Item *item) const
+{
+  if (ThumbnailService::instance() == nullptr || item->type() != Item::kFootage) {
+    return QImage();
+  }
+
+  Footage* footage = static_cast<Footage*>(item);
+
+  foreach (StreamPtr stream, footage->streams()) {
+    if (stream->type() == Stream::kImage) {
+      return ThumbnailService::instance()->Get(stream, 0, Config::Current()["ThumbnailResolution"].toInt(), this);
+    }
+
+    if (stream->type() == Stream::kVideo) {
+      // A frame a little way in is usually more representative than the first one
+      rational time = rational(stream->duration()) * stream->timebase() / rational(10);
+
+      return ThumbnailService::instance()->Get(stream, time, Config::Current()["ThumbnailResolution"].toInt(), this);
+    }
+  }
+
+  return QImage();
+}
+
+double ProjectViewModel::ItemDurationInSeconds(Item *item)
+{
+  switch (item->type()) {
+  case Item::kFootage:
+  {
+    Footage* footage = static_cast<Footage*>(item);
+
+    if (footage->streams().isEmpty()) {
+      return 0;
+    }
+
+    StreamPtr stream = footage->streams().first();
+
+    return olive::timestamp_to_time(stream->duration(), stream->timebase()).toDouble();
+  }
+  case Item::kSequence:
+    return static_cast<Sequence*>(item)->length().toDouble();
+  case Item::kFolder:
+    break;
+  }
+
+  // Folders have no duration so they go first
+  return -1;
+}
+
+double ProjectViewModel::ItemRate(Item *item)
+{
+  switch (item->type()) {
+  case Item::kFootage:
+  {
+    Footage* footage = static_cast<Footage*>(item);
+
+    if (footage->streams().isEmpty()) {
+      return 0;
+    }
+
+    StreamPtr stream = footage->streams().first();
+
+    if (stream->type() == Stream::kVideo) {
+      return std::static_pointer_cast<VideoStream>(stream)->frame_rate().toDouble();
+    } else if (stream->type() == Stream::kAudio) {
+      return std::static_pointer_cast<AudioStream>(stream)->sample_rate();
+    }
+
+    return 0;
+  }
+  case Item::kSequence:
+    return static_cast<Sequence*>(item)->video_params().time_base().flipped().toDouble();
+  case Item::kFolder:
+    break;
+  }
+
+  return -1;
+}
+
+void ProjectViewModel::Refilter()
+{
+  refilter_queued_ = false;
+
+  beginResetModel();
+
+  filter_shown_.clear();
+
+  if (project_ != nullptr && !filter_.isEmpty()) {
+    QSet<Item*> matches = search_index_.Find(filter_);
+
+    // Matches are shown with every folder they're in, so they can be browsed to
+    foreach (Item* match, matches) {
+      Item* i = match;
+
+      while (i != nullptr && i != project_->root() && !filter_shown_.contains(i)) {
+        filter_shown_.insert(i);
+        i = i->parent();
+      }
+    }
+  }
+
+  rows_.clear();
+  row_of_.clear();
+
+  BuildRows(project_ != nullptr ? project_->root() : nullptr);
+
+  endResetModel();
+}
+
 ProjectViewModel::MoveItemCommand::MoveItemCommand(ProjectViewModel *model,
                                                    Item *item,
                                                    Folder *destination,
@@ -547,6 +1008,11 @@ ProjectViewModel::AddItemCommand::~AddItemCommand()
 
 void ProjectViewModel::AddItemCommand::redo()
 {
+  // Commands that were already run before being pushed (e.g. items streamed in by ImportTask) aren't run again
+  if (done_) {
+    return;
+  }
+
   model_->AddChild(parent_, child_);
 
   done_ = true;
@@ -22,9 +22,11 @@
 #define VIEWMODEL_H
 
 #include <QAbstractItemModel>
+#include <QImage>
 #include <QUndoCommand>
 
 #include "project.h"
+#include "project/itemsearchindex.h"
 
 /**
  * @brief An adapter that interprets the data in a Project into a Qt item model for usage in ViewModel Views.
@@ -36,6 +38,7 @@
  */
 class ProjectViewModel : public QAbstractItemModel
 {
+  Q_OBJECT
 public:
   enum ColumnType {
     /// Media name
@@ -48,6 +51,19 @@ public:
     kRate
   };
 
+  enum SortKey {
+    kSortName,
+    kSortDuration,
+    kSortRate,
+    kSortType,
+    kSortDate
+  };
+
+  enum DataRole {
+    /// Thumbnail of footage with a picture (a QImage), null until ThumbnailService has it ready
+    kThumbnailRole = Qt::UserRole + 1
+  };
+
   /**
    * @brief ProjectViewModel Constructor
    *
@@ -95,6 +111,24 @@ public:
   virtual QMimeData * mimeData(const QModelIndexList &indexes) const override;
   virtual bool dropMimeData(const QMimeData *data, Qt::DropAction action, int row, int column, const QModelIndex &parent) override;
 
+  /**
+   * @brief Sort the column's values (views call this, e.g. when a header is clicked)
+   */
+  virtual void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+  /**
+   * @brief Set the order the children of every folder are shown in
+   *
+   * Each folder's order is kept as items are added, removed, moved and renamed, so the whole project is only sorted
+   * when this changes rather than every time it's shown.
+   */
+  void SetSort(SortKey key, Qt::SortOrder order);
+
+  /**
+   * @brief Only show items whose names contain `filter` (and the folders they're in), or every item if it's empty
+   */
+  void SetFilter(const QString& filter);
+
   /** Other model functions */
   void AddChild(Item* parent, ItemPtr child);
   void RemoveChild(Item* parent, Item* child);
@@ -211,9 +245,113 @@ private:
    */
   void MoveItemInternal(Item* item, Item* destination);
 
+  /**
+   * @brief Orders two items by sort_key_ and sort_order_, falling back to their names so every order is complete
+   */
+  class ItemLessThan
+  {
+  public:
+    ItemLessThan(const ProjectViewModel* model);
+
+    bool operator()(Item* a, Item* b) const;
+
+  private:
+    const ProjectViewModel* model_;
+  };
+
+  /**
+   * @brief Children of `item` in the order they're shown (sorted and filtered)
+   */
+  const QVector<Item*>& ShownChildren(const Item* item) const;
+
+  /**
+   * @brief Returns whether `item` passes the current filter
+   */
+  bool IsShown(Item* item) const;
+
+  /**
+   * @brief Rebuild the shown children of `item` and everything under it from scratch
+   */
+  void BuildRows(Item* item);
+
+  /**
+   * @brief Forget the shown children of `item` and everything under it
+   */
+  void ForgetRows(Item* item);
+
+  /**
+   * @brief Insert `item` into its parent's shown children where it belongs in the current order
+   *
+   * @return The row it was inserted at.
+   */
+  int InsertRow(Item* item);
+
+  /**
+   * @brief Remove `item` from its parent's shown children
+   */
+  void RemoveRow(Item* item);
+
+  /**
+   * @brief Update row_of_ for the children of `parent` from row `from` onwards
+   */
+  void RenumberRows(const Item* parent, int from);
+
+  void IndexForSearch(Item* item);
+
+  void UnindexForSearch(Item* item);
+
+  /**
+   * @brief Refilter once control returns to the event loop
+   *
+   * While filtering, adding or removing one item can show or hide the folders above it, so rather than working that
+   * out one change at a time (e.g. for every file of an import), the whole filter is applied again once they're done.
+   */
+  void QueueRefilter();
+
+  /**
+   * @brief Returns the thumbnail for kThumbnailRole, requesting it from ThumbnailService if it isn't ready
+   *
+   * Only called for the rows views are drawing, so only visible items are ever queued. The model is the requester
+   * (see ThumbnailService::CancelRequests()).
+   */
+  QImage GetThumbnail(Item* item) const;
+
+  static double ItemDurationInSeconds(Item* item);
+
+  static double ItemRate(Item* item);
+
   Project* project_;
 
   QVector<ColumnType> columns_;
+
+  SortKey sort_key_;
+
+  Qt::SortOrder sort_order_;
+
+  /**
+   * @brief Shown children of every folder (see ShownChildren())
+   */
+  QHash<const Item*, QVector<Item*> > rows_;
+
+  /**
+   * @brief Row of every shown item in its parent's shown children
+   */
+  QHash<const Item*, int> row_of_;
+
+  ItemSearchIndex search_index_;
+
+  QString filter_;
+
+  /**
+   * @brief Items matching filter_ and every folder they're in
+   */
+  QSet<Item*> filter_shown_;
+
+  bool refilter_queued_;
+
+private slots:
+  void Refilter();
+
 };
 
 #endif // VIEWMODEL_H
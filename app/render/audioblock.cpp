@@ -0,0 +1,112 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "audioblock.h"
+
+AudioBlock::AudioBlock(const AudioRenderingParams &params, const NodeValueDatabase &values) :
+  params_(params),
+  values_(values),
+  frame_count_(0),
+  block_index_(-1)
+{
+}
+
+void AudioBlock::SetRange(const rational &in, int frame_count)
+{
+  range_ = TimeRange(in, in + rational(frame_count, params_.sample_rate()));
+  frame_count_ = frame_count;
+  block_index_++;
+}
+
+const AudioRenderingParams &AudioBlock::params() const
+{
+  return params_;
+}
+
+const TimeRange &AudioBlock::range() const
+{
+  return range_;
+}
+
+int AudioBlock::frame_count() const
+{
+  return frame_count_;
+}
+
+const NodeValueDatabase &AudioBlock::values() const
+{
+  return values_;
+}
+
+const float *AudioBlock::Curve(NodeInput *input)
+{
+  QHash<NodeInput*, SampledCurve>::iterator curve = curves_.find(input);
+
+  if (curve == curves_.end()) {
+    SampledCurve empty;
+    empty.block_index = -1;
+    curve = curves_.insert(input, empty);
+  }
+
+  if (curve->block_index != block_index_) {
+    curve->block_index = block_index_;
+    curve->values.resize(frame_count_);
+
+    if (input->IsConnected()) {
+      curve->values.fill(ConnectedValue(input));
+    } else {
+      input->get_values_over_range(range_,
+                                   rational(1, params_.sample_rate()),
+                                   curve->values.data(),
+                                   frame_count_);
+    }
+  }
+
+  return curve->values.constData();
+}
+
+bool AudioBlock::IsConstant(NodeInput *input, float *constant)
+{
+  if (input->IsConnected()) {
+    *constant = ConnectedValue(input);
+    return true;
+  }
+
+  if (input->is_keyframing()) {
+    return false;
+  }
+
+  *constant = values_[input].Get(input->data_type()).toFloat();
+  return true;
+}
+
+float *AudioBlock::State(int size)
+{
+  if (state_.size() < size) {
+    state_.resize(size);
+  }
+
+  return state_.data();
+}
+
+float AudioBlock::ConnectedValue(NodeInput *input) const
+{
+  return values_[input].Get(input->data_type()).toFloat();
+}
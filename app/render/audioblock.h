@@ -0,0 +1,124 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef AUDIOBLOCK_H
+#define AUDIOBLOCK_H
+
+#include <QHash>
+#include <QVector>
+
+#include "common/timerange.h"
+#include "node/input.h"
+#include "node/value.h"
+#include "render/audioparams.h"
+
+/**
+ * @brief Everything a node needs to process one block of audio besides the samples themselves
+ *
+ * Renderers split a node's samples into blocks of at most kMaximumFrames and call Node::ProcessSamples() for each, in
+ * order, with the same AudioBlock moved along to the next range each time. Parameter curves are sampled per block,
+ * and State() carries over from one block to the next.
+ */
+class AudioBlock
+{
+public:
+  AudioBlock(const AudioRenderingParams& params, const NodeValueDatabase& values);
+
+  /**
+   * @brief Move on to the next block, which starts at `in` and is `frame_count` frames long
+   */
+  void SetRange(const rational& in, int frame_count);
+
+  const AudioRenderingParams& params() const;
+
+  /**
+   * @brief Time this block covers
+   */
+  const TimeRange& range() const;
+
+  int frame_count() const;
+
+  /**
+   * @brief The values the node's inputs have at the start of the render job (the same ones Node::Value() gets)
+   */
+  const NodeValueDatabase& values() const;
+
+  /**
+   * @brief The value of a numeric input at every frame of this block, so keyframes are followed sample by sample
+   *
+   * Inputs that are connected to another node stay at their value in values(). The array holds frame_count() values
+   * and is valid until the next SetRange().
+   */
+  const float* Curve(NodeInput* input);
+
+  /**
+   * @brief Returns whether `input` can't change over the course of the job, in which case its value is `constant`
+   *
+   * Lets nodes use the faster single value kernels (e.g. ApplyGain() rather than ApplyGainCurve()) where they can.
+   */
+  bool IsConstant(NodeInput* input, float* constant);
+
+  /**
+   * @brief Persistent storage (e.g. filter history) that starts zeroed and carries on from one block to the next
+   *
+   * Every call returns the same storage, resized to `size` floats if it was smaller. Each render job starts over from
+   * zero, nodes that keep state should ask for enough pre-roll (see Node::SamplePreRoll()) for it to settle before the
+   * job's first sample.
+   */
+  float* State(int size);
+
+  /**
+   * @brief The most frames in one block
+   *
+   * Small enough that each channel of a block stays in cache while a node works through it.
+   */
+  static const int kMaximumFrames = 256;
+
+private:
+  float ConnectedValue(NodeInput* input) const;
+
+  AudioRenderingParams params_;
+
+  const NodeValueDatabase& values_;
+
+  TimeRange range_;
+
+  int frame_count_;
+
+  /**
+   * @brief Incremented each SetRange(), so curves sampled for an earlier block are sampled again
+   */
+  int block_index_;
+
+  struct SampledCurve {
+    int block_index;
+    QVector<float> values;
+  };
+
+  /**
+   * @brief Kept from one block to the next so each input's array is only allocated once
+   */
+  QHash<NodeInput*, SampledCurve> curves_;
+
+  QVector<float> state_;
+
+};
+
+#endif // AUDIOBLOCK_H
@@ -0,0 +1,91 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "audiobuffer.h"
+
+#include "audiokernels.h"
+
+AudioBuffer::AudioBuffer() :
+  channel_count_(0),
+  frame_count_(0)
+{
+}
+
+void AudioBuffer::Resize(int channel_count, int frame_count)
+{
+  // Start each channel on a multiple of four samples so vectors line up the same way in every channel
+  int stride = (frame_count + 3) / 4 * 4;
+  int needed = channel_count * stride;
+
+  if (data_.size() < needed) {
+    data_.resize(needed);
+  }
+
+  channel_count_ = channel_count;
+  frame_count_ = frame_count;
+
+  channels_.resize(channel_count);
+
+  for (int i=0;i<channel_count;i++) {
+    channels_[i] = data_.data() + i * stride;
+  }
+}
+
+void AudioBuffer::Deinterleave(const float *source, int channel_count, int frame_count)
+{
+  Resize(channel_count, frame_count);
+
+  olive::kernels::Deinterleave(channels_.data(), source, frame_count, channel_count);
+}
+
+void AudioBuffer::Interleave(float *destination) const
+{
+  olive::kernels::Interleave(destination, channels(), frame_count_, channel_count_);
+}
+
+int AudioBuffer::channel_count() const
+{
+  return channel_count_;
+}
+
+int AudioBuffer::frame_count() const
+{
+  return frame_count_;
+}
+
+float *AudioBuffer::channel(int index)
+{
+  return channels_.at(index);
+}
+
+const float *AudioBuffer::channel(int index) const
+{
+  return channels_.at(index);
+}
+
+float * const *AudioBuffer::channels()
+{
+  return channels_.data();
+}
+
+const float * const *AudioBuffer::channels() const
+{
+  return channels_.constData();
+}
@@ -0,0 +1,77 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef AUDIOBUFFER_H
+#define AUDIOBUFFER_H
+
+#include <QVector>
+
+/**
+ * @brief Planar float samples, one contiguous run of samples per channel
+ *
+ * What nodes process audio in (see Node::ProcessSamples()). Each channel can be handed to the kernels in
+ * render/audiokernels.h as it is, unlike the interleaved samples passed between nodes. Resizing never shrinks the
+ * allocation, so a buffer reused for every block is only allocated once.
+ */
+class AudioBuffer
+{
+public:
+  AudioBuffer();
+
+  /**
+   * @brief Make room for `frame_count` samples in each of `channel_count` channels, the contents are undefined
+   */
+  void Resize(int channel_count, int frame_count);
+
+  /**
+   * @brief Resize this buffer to hold `frame_count` interleaved frames from `source` and split them into it
+   */
+  void Deinterleave(const float* source, int channel_count, int frame_count);
+
+  /**
+   * @brief Write every frame in this buffer to `destination` interleaved
+   */
+  void Interleave(float* destination) const;
+
+  int channel_count() const;
+
+  int frame_count() const;
+
+  float* channel(int index);
+  const float* channel(int index) const;
+
+  /**
+   * @brief Every channel's pointer, `channel_count()` of them
+   */
+  float* const* channels();
+  const float* const* channels() const;
+
+private:
+  int channel_count_;
+
+  int frame_count_;
+
+  QVector<float> data_;
+
+  QVector<float*> channels_;
+
+};
+
+#endif // AUDIOBUFFER_H
@@ -0,0 +1,455 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#include "audiokernels.h"
+
+#include <QVector>
+#include <QtMath>
+
+// SSE2 is part of the x86-64 baseline and NEON is part of the AArch64 baseline, so neither needs a runtime check
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OLIVE_KERNELS_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define OLIVE_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace olive {
+namespace kernels {
+
+void MixInterleaved(float *destination, const float *source, int frame_count, int channel_count,
+                    const float *gain_start, const float *gain_end)
+{
+  if (frame_count <= 0 || channel_count <= 0) {
+    return;
+  }
+
+  QVector<float> gain_step(channel_count);
+
+  for (int c=0;c<channel_count;c++) {
+    gain_step[c] = (gain_end[c] - gain_start[c]) / static_cast<float>(frame_count);
+  }
+
+  int frame = 0;
+
+#if defined(OLIVE_KERNELS_SSE2) || defined(OLIVE_KERNELS_NEON)
+  // With 1, 2 or 4 channels, every vector of four samples holds whole frames with the channels in the same lanes
+  if (4 % channel_count == 0) {
+    int frames_per_vector = 4 / channel_count;
+    float lane_gain[4];
+    float lane_step[4];
+
+    for (int i=0;i<4;i++) {
+      int c = i % channel_count;
+
+      lane_gain[i] = gain_start[c] + gain_step[c] * static_cast<float>(i / channel_count);
+      lane_step[i] = gain_step[c] * static_cast<float>(frames_per_vector);
+    }
+
+    int vector_count = frame_count / frames_per_vector;
+
+#if defined(OLIVE_KERNELS_SSE2)
+    __m128 gain = _mm_loadu_ps(lane_gain);
+    __m128 step = _mm_loadu_ps(lane_step);
+
+    for (int i=0;i<vector_count;i++) {
+      __m128 mixed = _mm_add_ps(_mm_loadu_ps(destination), _mm_mul_ps(_mm_loadu_ps(source), gain));
+      _mm_storeu_ps(destination, mixed);
+
+      gain = _mm_add_ps(gain, step);
+      destination += 4;
+      source += 4;
+    }
+#else
+    float32x4_t gain = vld1q_f32(lane_gain);
+    float32x4_t step = vld1q_f32(lane_step);
+
+    for (int i=0;i<vector_count;i++) {
+      vst1q_f32(destination, vmlaq_f32(vld1q_f32(destination), vld1q_f32(source), gain));
+
+      gain = vaddq_f32(gain, step);
+      destination += 4;
+      source += 4;
+    }
+#endif
+
+    frame = vector_count * frames_per_vector;
+  }
+#endif
+
+  for (;frame<frame_count;frame++) {
+    for (int c=0;c<channel_count;c++) {
+      *destination += *source * (gain_start[c] + gain_step[c] * static_cast<float>(frame));
+
+      destination++;
+      source++;
+    }
+  }
+}
+
+void MixInterleavedCurve(float *destination, const float *source, int frame_count, int channel_count,
+                         const float * const *gains)
+{
+  // Only used while a gain is keyframed, so the channel gathering isn't worth vectorizing
+  for (int frame=0;frame<frame_count;frame++) {
+    for (int c=0;c<channel_count;c++) {
+      *destination += *source * gains[c][frame];
+
+      destination++;
+      source++;
+    }
+  }
+}
+
+void MeasureInterleaved(const float *samples, int frame_count, int channel_count,
+                        float *peaks, float *sum_squares)
+{
+  if (frame_count <= 0 || channel_count <= 0) {
+    return;
+  }
+
+  int frame = 0;
+
+#if defined(OLIVE_KERNELS_SSE2) || defined(OLIVE_KERNELS_NEON)
+  // Same as mixing, with 1, 2 or 4 channels every lane always holds the same channel
+  if (4 % channel_count == 0) {
+    int frames_per_vector = 4 / channel_count;
+    int vector_count = frame_count / frames_per_vector;
+    float lane_peaks[4];
+    float lane_sums[4];
+
+#if defined(OLIVE_KERNELS_SSE2)
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 peak = _mm_setzero_ps();
+    __m128 sum = _mm_setzero_ps();
+
+    for (int i=0;i<vector_count;i++) {
+      __m128 s = _mm_loadu_ps(samples);
+
+      peak = _mm_max_ps(peak, _mm_and_ps(s, abs_mask));
+      sum = _mm_add_ps(sum, _mm_mul_ps(s, s));
+
+      samples += 4;
+    }
+
+    _mm_storeu_ps(lane_peaks, peak);
+    _mm_storeu_ps(lane_sums, sum);
+#else
+    float32x4_t peak = vdupq_n_f32(0.0f);
+    float32x4_t sum = vdupq_n_f32(0.0f);
+
+    for (int i=0;i<vector_count;i++) {
+      float32x4_t s = vld1q_f32(samples);
+
+      peak = vmaxq_f32(peak, vabsq_f32(s));
+      sum = vmlaq_f32(sum, s, s);
+
+      samples += 4;
+    }
+
+    vst1q_f32(lane_peaks, peak);
+    vst1q_f32(lane_sums, sum);
+#endif
+
+    for (int i=0;i<4;i++) {
+      int c = i % channel_count;
+
+      peaks[c] = qMax(peaks[c], lane_peaks[i]);
+      sum_squares[c] += lane_sums[i];
+    }
+
+    frame = vector_count * frames_per_vector;
+  }
+#endif
+
+  for (;frame<frame_count;frame++) {
+    for (int c=0;c<channel_count;c++) {
+      float s = *samples;
+
+      peaks[c] = qMax(peaks[c], qAbs(s));
+      sum_squares[c] += s * s;
+
+      samples++;
+    }
+  }
+}
+
+void Deinterleave(float * const *destination, const float *source, int frame_count, int channel_count)
+{
+  int frame = 0;
+
+#if defined(OLIVE_KERNELS_SSE2) || defined(OLIVE_KERNELS_NEON)
+  // Stereo is by far the most common, split four frames at a time
+  if (channel_count == 2) {
+    float* left = destination[0];
+    float* right = destination[1];
+
+    for (;frame+4<=frame_count;frame+=4) {
+#if defined(OLIVE_KERNELS_SSE2)
+      __m128 a = _mm_loadu_ps(source + frame * 2);
+      __m128 b = _mm_loadu_ps(source + frame * 2 + 4);
+
+      _mm_storeu_ps(left + frame, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+      _mm_storeu_ps(right + frame, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+#else
+      float32x4x2_t split = vld2q_f32(source + frame * 2);
+
+      vst1q_f32(left + frame, split.val[0]);
+      vst1q_f32(right + frame, split.val[1]);
+#endif
+    }
+  }
+#endif
+
+  for (int c=0;c<channel_count;c++) {
+    float* channel = destination[c];
+
+    for (int i=frame;i<frame_count;i++) {
+      channel[i] = source[i * channel_count + c];
+    }
+  }
+}
+
+void Interleave(float *destination, const float * const *source, int frame_count, int channel_count)
+{
+  int frame = 0;
+
+#if defined(OLIVE_KERNELS_SSE2) || defined(OLIVE_KERNELS_NEON)
+  if (channel_count == 2) {
+    const float* left = source[0];
+    const float* right = source[1];
+
+    for (;frame+4<=frame_count;frame+=4) {
+#if defined(OLIVE_KERNELS_SSE2)
+      __m128 l = _mm_loadu_ps(left + frame);
+      __m128 r = _mm_loadu_ps(right + frame);
+
+      _mm_storeu_ps(destination + frame * 2, _mm_unpacklo_ps(l, r));
+      _mm_storeu_ps(destination + frame * 2 + 4, _mm_unpackhi_ps(l, r));
+#else
+      float32x4x2_t joined;
+      joined.val[0] = vld1q_f32(left + frame);
+      joined.val[1] = vld1q_f32(right + frame);
+
+      vst2q_f32(destination + frame * 2, joined);
+#endif
+    }
+  }
+#endif
+
+  for (int c=0;c<channel_count;c++) {
+    const float* channel = source[c];
+
+    for (int i=frame;i<frame_count;i++) {
+      destination[i * channel_count + c] = channel[i];
+    }
+  }
+}
+
+void ApplyGain(float *samples, int count, float gain)
+{
+  int i = 0;
+
+#if defined(OLIVE_KERNELS_SSE2)
+  __m128 g = _mm_set1_ps(gain);
+
+  for (;i+4<=count;i+=4) {
+    _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), g));
+  }
+#elif defined(OLIVE_KERNELS_NEON)
+  float32x4_t g = vdupq_n_f32(gain);
+
+  for (;i+4<=count;i+=4) {
+    vst1q_f32(samples + i, vmulq_f32(vld1q_f32(samples + i), g));
+  }
+#endif
+
+  for (;i<count;i++) {
+    samples[i] *= gain;
+  }
+}
+
+void ApplyGainCurve(float *samples, int count, const float *gain)
+{
+  int i = 0;
+
+#if defined(OLIVE_KERNELS_SSE2)
+  for (;i+4<=count;i+=4) {
+    _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), _mm_loadu_ps(gain + i)));
+  }
+#elif defined(OLIVE_KERNELS_NEON)
+  for (;i+4<=count;i+=4) {
+    vst1q_f32(samples + i, vmulq_f32(vld1q_f32(samples + i), vld1q_f32(gain + i)));
+  }
+#endif
+
+  for (;i<count;i++) {
+    samples[i] *= gain[i];
+  }
+}
+
+void MixPlanar(float *destination, const float *source, int count, const float *gain)
+{
+  int i = 0;
+
+  if (gain == nullptr) {
+#if defined(OLIVE_KERNELS_SSE2)
+    for (;i+4<=count;i+=4) {
+      _mm_storeu_ps(destination + i, _mm_add_ps(_mm_loadu_ps(destination + i), _mm_loadu_ps(source + i)));
+    }
+#elif defined(OLIVE_KERNELS_NEON)
+    for (;i+4<=count;i+=4) {
+      vst1q_f32(destination + i, vaddq_f32(vld1q_f32(destination + i), vld1q_f32(source + i)));
+    }
+#endif
+
+    for (;i<count;i++) {
+      destination[i] += source[i];
+    }
+
+    return;
+  }
+
+#if defined(OLIVE_KERNELS_SSE2)
+  for (;i+4<=count;i+=4) {
+    __m128 mixed = _mm_add_ps(_mm_loadu_ps(destination + i),
+                              _mm_mul_ps(_mm_loadu_ps(source + i), _mm_loadu_ps(gain + i)));
+    _mm_storeu_ps(destination + i, mixed);
+  }
+#elif defined(OLIVE_KERNELS_NEON)
+  for (;i+4<=count;i+=4) {
+    vst1q_f32(destination + i, vmlaq_f32(vld1q_f32(destination + i), vld1q_f32(source + i), vld1q_f32(gain + i)));
+  }
+#endif
+
+  for (;i<count;i++) {
+    destination[i] += source[i] * gain[i];
+  }
+}
+
+void PanStereo(float *left, float *right, int count, const float *pan)
+{
+  int i = 0;
+
+#if defined(OLIVE_KERNELS_SSE2)
+  const __m128 one = _mm_set1_ps(1.0f);
+
+  for (;i+4<=count;i+=4) {
+    __m128 p = _mm_loadu_ps(pan + i);
+
+    _mm_storeu_ps(left + i, _mm_mul_ps(_mm_loadu_ps(left + i), _mm_min_ps(one, _mm_sub_ps(one, p))));
+    _mm_storeu_ps(right + i, _mm_mul_ps(_mm_loadu_ps(right + i), _mm_min_ps(one, _mm_add_ps(one, p))));
+  }
+#elif defined(OLIVE_KERNELS_NEON)
+  const float32x4_t one = vdupq_n_f32(1.0f);
+
+  for (;i+4<=count;i+=4) {
+    float32x4_t p = vld1q_f32(pan + i);
+
+    vst1q_f32(left + i, vmulq_f32(vld1q_f32(left + i), vminq_f32(one, vsubq_f32(one, p))));
+    vst1q_f32(right + i, vmulq_f32(vld1q_f32(right + i), vminq_f32(one, vaddq_f32(one, p))));
+  }
+#endif
+
+  for (;i<count;i++) {
+    left[i] *= qMin(1.0f, 1.0f - pan[i]);
+    right[i] *= qMin(1.0f, 1.0f + pan[i]);
+  }
+}
+
+namespace {
+
+// Formulas from Robert Bristow-Johnson's "Audio EQ Cookbook"
+Biquad NormalizeBiquad(double b0, double b1, double b2, double a0, double a1, double a2)
+{
+  Biquad filter;
+
+  filter.b0 = static_cast<float>(b0 / a0);
+  filter.b1 = static_cast<float>(b1 / a0);
+  filter.b2 = static_cast<float>(b2 / a0);
+  filter.a1 = static_cast<float>(a1 / a0);
+  filter.a2 = static_cast<float>(a2 / a0);
+
+  return filter;
+}
+
+double BiquadOmega(double sample_rate, double frequency)
+{
+  // Keep the frequency below Nyquist, where the formulas fall apart
+  return 2.0 * M_PI * qBound(1.0, frequency, sample_rate * 0.49) / sample_rate;
+}
+
+}
+
+Biquad LowPassBiquad(double sample_rate, double frequency, double q)
+{
+  double w0 = BiquadOmega(sample_rate, frequency);
+  double cos_w0 = qCos(w0);
+  double alpha = qSin(w0) / (2.0 * qMax(q, 0.01));
+
+  return NormalizeBiquad((1.0 - cos_w0) * 0.5, 1.0 - cos_w0, (1.0 - cos_w0) * 0.5,
+                         1.0 + alpha, -2.0 * cos_w0, 1.0 - alpha);
+}
+
+Biquad HighPassBiquad(double sample_rate, double frequency, double q)
+{
+  double w0 = BiquadOmega(sample_rate, frequency);
+  double cos_w0 = qCos(w0);
+  double alpha = qSin(w0) / (2.0 * qMax(q, 0.01));
+
+  return NormalizeBiquad((1.0 + cos_w0) * 0.5, -(1.0 + cos_w0), (1.0 + cos_w0) * 0.5,
+                         1.0 + alpha, -2.0 * cos_w0, 1.0 - alpha);
+}
+
+Biquad PeakingBiquad(double sample_rate, double frequency, double q, double gain_db)
+{
+  double a = qPow(10.0, gain_db / 40.0);
+  double w0 = BiquadOmega(sample_rate, frequency);
+  double cos_w0 = qCos(w0);
+  double alpha = qSin(w0) / (2.0 * qMax(q, 0.01));
+
+  return NormalizeBiquad(1.0 + alpha * a, -2.0 * cos_w0, 1.0 - alpha * a,
+                         1.0 + alpha / a, -2.0 * cos_w0, 1.0 - alpha / a);
+}
+
+void FilterBiquad(float *samples, int count, const Biquad &filter, float *state)
+{
+  // Transposed direct form II, which only needs two delay values and behaves well in single precision
+  float z1 = state[0];
+  float z2 = state[1];
+
+  for (int i=0;i<count;i++) {
+    float in = samples[i];
+    float out = filter.b0 * in + z1;
+
+    z1 = filter.b1 * in - filter.a1 * out + z2;
+    z2 = filter.b2 * in - filter.a2 * out;
+
+    samples[i] = out;
+  }
+
+  state[0] = z1;
+  state[1] = z2;
+}
+
+}
+}
@@ -0,0 +1,118 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#ifndef AUDIOKERNELS_H
+#define AUDIOKERNELS_H
+
+namespace olive {
+namespace kernels {
+
+/**
+ * @brief Add `frame_count` frames of interleaved float samples from `source` to `destination`
+ *
+ * Each channel is scaled by a gain that ramps linearly from `gain_start[channel]` on the first frame to
+ * `gain_end[channel]` on the frame after the last (so consecutive calls ramp seamlessly into each other).
+ * `gain_start` and `gain_end` must hold `channel_count` values.
+ */
+void MixInterleaved(float* destination, const float* source, int frame_count, int channel_count,
+                    const float* gain_start, const float* gain_end);
+
+/**
+ * @brief Add `frame_count` frames of interleaved float samples from `source` to `destination`, with a gain per frame
+ *
+ * `gains` must hold `channel_count` pointers, each to `frame_count` gains for that channel (e.g. a parameter curve,
+ * see AudioBlock::Curve()).
+ */
+void MixInterleavedCurve(float* destination, const float* source, int frame_count, int channel_count,
+                         const float* const* gains);
+
+/**
+ * @brief Measure `frame_count` frames of interleaved float samples for metering
+ *
+ * The absolute peak of each channel is folded into `peaks` (keeping whichever is larger) and the sum of its squared
+ * samples is added to `sum_squares`. Both must hold `channel_count` values.
+ */
+void MeasureInterleaved(const float* samples, int frame_count, int channel_count,
+                        float* peaks, float* sum_squares);
+
+/**
+ * @brief Split `frame_count` frames of interleaved float samples into one buffer per channel
+ *
+ * `destination` must hold `channel_count` pointers, each to room for `frame_count` samples.
+ */
+void Deinterleave(float* const* destination, const float* source, int frame_count, int channel_count);
+
+/**
+ * @brief The reverse of Deinterleave()
+ */
+void Interleave(float* destination, const float* const* source, int frame_count, int channel_count);
+
+/**
+ * @brief Multiply `count` samples by a single gain
+ */
+void ApplyGain(float* samples, int count, float gain);
+
+/**
+ * @brief Multiply `count` samples by a gain per sample (e.g. a parameter curve, see AudioBlock::Curve())
+ */
+void ApplyGainCurve(float* samples, int count, const float* gain);
+
+/**
+ * @brief Add `count` samples from `source` to `destination`, each scaled by a gain per sample
+ *
+ * If `gain` is nullptr, `source` is added as it is.
+ */
+void MixPlanar(float* destination, const float* source, int count, const float* gain = nullptr);
+
+/**
+ * @brief Pan a pair of stereo channels as a balance, one pan per sample from -1.0 (left) to 1.0 (right)
+ *
+ * Centered leaves both channels as they are, the same as track panning.
+ */
+void PanStereo(float* left, float* right, int count, const float* pan);
+
+/**
+ * @brief Coefficients of a biquad filter, normalized so a0 is 1.0
+ */
+struct Biquad {
+  float b0;
+  float b1;
+  float b2;
+  float a1;
+  float a2;
+};
+
+Biquad LowPassBiquad(double sample_rate, double frequency, double q);
+Biquad HighPassBiquad(double sample_rate, double frequency, double q);
+Biquad PeakingBiquad(double sample_rate, double frequency, double q, double gain_db);
+
+/**
+ * @brief Run `count` samples of one channel through a biquad filter in place
+ *
+ * `state` holds the filter's two delay values, which should start at zero and be carried from one block of the same
+ * channel to the next. Each sample depends on the last, so unlike the other kernels this can't be vectorized.
+ */
+void FilterBiquad(float* samples, int count, const Biquad& filter, float* state);
+
+}
+}
+
+#endif // AUDIOKERNELS_H
@@ -73,7 +73,21 @@ int AudioRenderingParams::time_to_samples(const rational &time) const
 {
   Q_ASSERT(is_valid());
 
-  return qFloor(time.toDouble() * sample_rate());
+  if (time.denominator() == 0) {
+    return 0;
+  }
+
+  // Integer maths, so a time exactly on a sample boundary can't be rounded down to the sample before it
+  int64_t numerator = time.numerator() * sample_rate();
+  int64_t denominator = time.denominator();
+  int64_t samples = numerator / denominator;
+
+  // Round towards negative infinity like qFloor
+  if (numerator % denominator != 0 && (numerator < 0) != (denominator < 0)) {
+    samples--;
+  }
+
+  return static_cast<int>(samples);
 }
 
 int AudioRenderingParams::samples_to_bytes(const int &samples) const
@@ -3,7 +3,8 @@
 #include "audioworker.h"
 
 AudioBackend::AudioBackend(QObject *parent) :
-  AudioRenderBackend(parent)
+  AudioRenderBackend(parent),
+  pull_device_(audio_cache())
 {
 }
 
@@ -14,7 +15,8 @@ AudioBackend::~AudioBackend()
 
 QIODevice *AudioBackend::GetAudioPullDevice()
 {
-  pull_device_.setFileName(CachePathName());
+  // Playback is about to start somewhere, so the realtime worker may have something to render
+  QueueCacheNext();
 
   return &pull_device_;
 }
@@ -34,10 +36,10 @@ void AudioBackend::InvalidateCache(const rational &start_range, const rational &
 
 bool AudioBackend::InitInternal()
 {
-  // Initiate one thread per CPU core
+  // One worker per thread
   for (int i=0;i<threads().size();i++) {
     // Create one processor object for each thread
-    AudioWorker* processor = new AudioWorker(decoder_cache());
+    AudioWorker* processor = new AudioWorker(decoder_cache(), audio_cache());
     processor->SetParameters(params());
     processors_.append(processor);
   }
@@ -59,44 +61,3 @@ void AudioBackend::DecompileInternal()
 {
   // This backend doesn't compile anything yet
 }
-
-void AudioBackend::ConnectWorkerToThis(RenderWorker *worker)
-{
-  connect(worker, SIGNAL(CompletedCache(NodeDependency, NodeValueTable)), this, SLOT(ThreadCompletedCache(NodeDependency, NodeValueTable)));
-}
-
-void AudioBackend::ThreadCompletedCache(NodeDependency dep, NodeValueTable data)
-{
-  caching_ = false;
-
-  QByteArray cached_samples = data.Get(NodeParam::kSamples).toByteArray();
-
-  int offset = params().time_to_bytes(dep.in());
-  int length = params().time_to_bytes(dep.range().length());
-  int out_point = offset + length;
-
-  QFile f(CachePathName());
-  if (f.open(QFile::WriteOnly | QFile::Append)) {
-
-    if (f.size() < out_point) {
-      f.resize(out_point);
-    }
-
-    f.seek(offset);
-
-    // Replace data with this data
-    int copy_length = qMin(length, cached_samples.size());
-
-    f.write(cached_samples.data(), copy_length);
-
-    if (copy_length < length) {
-      // Fill in remainder with silence
-      QByteArray empty_space(length - copy_length, 0);
-      f.write(empty_space);
-    }
-
-    f.close();
-  }
-
-  CacheNext();
-}
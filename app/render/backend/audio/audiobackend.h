@@ -1,8 +1,6 @@
 #ifndef AUDIOBACKEND_H
 #define AUDIOBACKEND_H
 
-#include <QFile>
-
 #include "../audiorenderbackend.h"
 
 class AudioBackend : public AudioRenderBackend
@@ -27,13 +25,8 @@ protected:
 
   virtual void DecompileInternal() override;
 
-  virtual void ConnectWorkerToThis(RenderWorker* worker) override;
-
-private slots:
-  void ThreadCompletedCache(NodeDependency dep, NodeValueTable data);
-
 private:
-  QFile pull_device_;
+  AudioRenderCacheDevice pull_device_;
 
 };
 
@@ -1,11 +1,13 @@
 #include "audioworker.h"
 
-AudioWorker::AudioWorker(DecoderCache *decoder_cache, QObject *parent) :
-  AudioRenderWorker(decoder_cache, parent)
+AudioWorker::AudioWorker(DecoderCache *decoder_cache, AudioRenderCache *cache, QObject *parent) :
+  AudioRenderWorker(decoder_cache, cache, parent)
 {
 }
 
-void AudioWorker::FrameToValue(FramePtr frame, NodeValueTable *table)
+void AudioWorker::FrameToValue(StreamPtr stream, FramePtr frame, NodeValueTable *table)
 {
+  Q_UNUSED(stream)
+
   table->Push(NodeParam::kSamples, frame->ToByteArray());
 }
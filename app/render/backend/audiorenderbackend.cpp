@@ -16,6 +16,8 @@ void AudioRenderBackend::SetParameters(const AudioRenderingParams &params)
   // Set new parameters
   params_ = params;
 
+  cache_.SetParameters(params_);
+
   // Set params on all processors
   // FIXME: Undefined behavior if the processors are currently working, this may need to be delayed like the
   //        recompile signal
@@ -32,17 +34,45 @@ void AudioRenderBackend::InvalidateCache(const rational &start_range, const rati
   rational start_range_adj = qMax(rational(0), start_range);
   rational end_range_adj = qMin(SequenceLength(), end_range);
 
-  // Add the range to the list
-  cache_queue_.append(TimeRange(start_range_adj, end_range_adj));
+  rational length = SequenceLength();
+
+  cache_.SetLength(length);
+
+  // Only the segments this range touches need rendering again, they're queued SegmentsPerJob() at a time so they're
+  // spread over every worker
+  int first_segment, last_segment;
+  cache_.Invalidate(TimeRange(start_range_adj, end_range_adj), &first_segment, &last_segment);
+
+  int segments_per_job = SegmentsPerJob();
+
+  for (int i=first_segment;i<=last_segment;i++) {
+    if (queued_segments_.contains(i)) {
+      continue;
+    }
+
+    // A run of segments that aren't queued yet
+    int job_end = i;
 
-  // Remove any overlaps so we don't render the same thing twice
-  ValidateRanges();
+    while (job_end < last_segment
+           && job_end - i + 1 < segments_per_job
+           && !queued_segments_.contains(job_end + 1)) {
+      job_end++;
+    }
+
+    for (int j=i;j<=job_end;j++) {
+      queued_segments_.insert(j);
+    }
+
+    cache_queue_.append(TimeRange(cache_.SegmentRange(i).in(), qMin(cache_.SegmentRange(job_end).out(), length)));
+
+    i = job_end;
+  }
 
   // Queue value update
   QueueValueUpdate(TimeRange(start_range, end_range));
 
   // Start caching cycle if it hasn't started already
-  CacheNext();
+  QueueCacheNext();
 }
 
 void AudioRenderBackend::ConnectViewer(ViewerOutput *node)
@@ -79,31 +109,94 @@ const AudioRenderingParams &AudioRenderBackend::params()
   return params_;
 }
 
-NodeInput *AudioRenderBackend::GetDependentInput()
+NodeInput *AudioRenderBackend::GetDependentInput(ViewerOutput *viewer)
 {
-  return viewer_node()->samples_input();
+  return viewer->samples_input();
 }
 
-void AudioRenderBackend::ValidateRanges()
+void AudioRenderBackend::CacheIDChangedEvent(const QString &id)
 {
-  for (int i=0;i<cache_queue_.size();i++) {
-    const TimeRange& range1 = cache_queue_.at(i);
+  cache_.SetFilename(id.isEmpty() ? QString() : CachePathName());
+}
+
+bool AudioRenderBackend::TakeNextJob(TimeRange *range)
+{
+  int requested = cache_.RequestedSegment();
 
-    for (int j=0;j<cache_queue_.size();j++) {
-      const TimeRange& range2 = cache_queue_.at(j);
+  if (requested >= 0) {
+    // Render whatever playback is waiting on (or the nearest segment after it) first
+    int best_index = -1;
+    int best_segment = 0;
 
-      if (TimeRange::Overlap(range1, range2) && i != j) {
-        // Combine with the first range
-        cache_queue_[i] = TimeRange::Combine(range1, range2);
+    for (int i=0;i<cache_queue_.size();i++) {
+      int segment = cache_.SegmentAtTime(cache_queue_.at(i).in());
 
-        // Remove the second range
-        cache_queue_.removeAt(j);
-        j--;
+      if (LastSegmentOf(cache_queue_.at(i)) >= requested && (best_index < 0 || segment < best_segment)) {
+        best_index = i;
+        best_segment = segment;
       }
     }
+
+    if (best_index > 0) {
+      cache_queue_.move(best_index, 0);
+    }
+  }
+
+  forever {
+    if (!RenderBackend::TakeNextJob(range)) {
+      return false;
+    }
+
+    int first_segment = cache_.SegmentAtTime(range->in());
+    int last_segment = LastSegmentOf(*range);
+    bool needs_render = false;
+
+    for (int i=first_segment;i<=last_segment;i++) {
+      queued_segments_.remove(i);
+
+      if (!cache_.IsValid(i)) {
+        needs_render = true;
+      }
+    }
+
+    if (needs_render) {
+      return true;
+    }
   }
 }
 
+int AudioRenderBackend::SegmentsPerJob() const
+{
+  return 1;
+}
+
+int AudioRenderBackend::LastSegmentOf(const TimeRange &range)
+{
+  int first = cache_.SegmentAtTime(range.in());
+  int last = cache_.SegmentAtTime(range.out());
+
+  if (last > first && cache_.SegmentRange(last).in() == range.out()) {
+    last--;
+  }
+
+  return last;
+}
+
+bool AudioRenderBackend::TakeInteractiveJob(TimeRange *range)
+{
+  return cache_.NextUnrenderedBlock(kRealtimeBlockSamples, kRealtimeLookahead, range);
+}
+
+bool AudioRenderBackend::ReservesInteractiveWorker() const
+{
+  return true;
+}
+
+bool AudioRenderBackend::InteractiveWorkerIsRealtime() const
+{
+  return true;
+}
+
 QString AudioRenderBackend::CachePathName()
 {
   QDir this_cache_dir = QDir(GetMediaCacheLocation()).filePath(cache_id());
@@ -111,3 +204,8 @@ QString AudioRenderBackend::CachePathName()
 
   return this_cache_dir.filePath(QStringLiteral("pcm"));
 }
+
+AudioRenderCache *AudioRenderBackend::audio_cache()
+{
+  return &cache_;
+}
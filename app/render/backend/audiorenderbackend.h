@@ -1,6 +1,9 @@
 #ifndef AUDIORENDERBACKEND_H
 #define AUDIORENDERBACKEND_H
 
+#include <QSet>
+
+#include "audiorendercache.h"
 #include "common/timerange.h"
 #include "renderbackend.h"
 
@@ -35,15 +38,67 @@ protected:
    */
   virtual bool GenerateCacheIDInternal(QCryptographicHash& hash) override;
 
-  virtual NodeInput* GetDependentInput() override;
+  virtual NodeInput* GetDependentInput(ViewerOutput* viewer) override;
+
+  virtual void CacheIDChangedEvent(const QString& id) override;
+
+  /**
+   * @brief Segments that have already been rendered (i.e. by the realtime worker) are skipped
+   */
+  virtual bool TakeNextJob(TimeRange* range) override;
+
+  /**
+   * @brief While the cache is being played, renders whatever hasn't rendered just ahead of playback in small blocks
+   *
+   * This way an edit that hasn't been cached yet plays straight away rather than as silence. Blocks are written into
+   * the cache as they render, so a segment the realtime worker finishes doesn't need rendering again.
+   */
+  virtual bool TakeInteractiveJob(TimeRange* range) override;
+
+  virtual bool ReservesInteractiveWorker() const override;
+
+  virtual bool InteractiveWorkerIsRealtime() const override;
+
+  /**
+   * @brief Number of segments rendered by each job (1 by default)
+   *
+   * Each job evaluates the graph once and decodes its footage in one go, so longer jobs have much less overhead per
+   * sample. Jobs don't need to overlap either: nodes that keep state from one sample to the next pre-roll at the start
+   * of every job (see Node::SamplePreRoll()), so a job's first segment renders the same as it would after the one
+   * before it. A job only covers segments that are invalidated together, so edits still only re-render what they
+   * touched.
+   */
+  virtual int SegmentsPerJob() const;
 
   QString CachePathName();
 
+  AudioRenderCache* audio_cache();
+
 private:
-  void ValidateRanges();
+  /**
+   * @brief The last segment `range` covers, its out point belongs to the next segment if it's on a boundary
+   */
+  int LastSegmentOf(const TimeRange& range);
+
+  /**
+   * @brief Samples the realtime worker renders at a time, small enough to stay just ahead of playback
+   */
+  static const int kRealtimeBlockSamples = 1024;
+
+  /**
+   * @brief Segments ahead of playback the realtime worker looks for anything that hasn't rendered
+   */
+  static const int kRealtimeLookahead = 2;
 
   AudioRenderingParams params_;
 
+  AudioRenderCache cache_;
+
+  /**
+   * @brief Segments currently in cache_queue_, each of which is queued as its own job
+   */
+  QSet<int> queued_segments_;
+
 };
 
 #endif // AUDIORENDERBACKEND_H
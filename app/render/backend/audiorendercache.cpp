@@ -0,0 +1,493 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#include "audiorendercache.h"
+
+#include <QDebug>
+#include <cstring>
+
+AudioRenderCache::AudioRenderCache() :
+  mapped_(nullptr),
+  mapped_segments_(0),
+  length_in_bytes_(0),
+  generation_counter_(0),
+  requested_segment_(-1),
+  read_offset_(-1)
+{
+}
+
+AudioRenderCache::~AudioRenderCache()
+{
+  CloseFile();
+}
+
+void AudioRenderCache::SetFilename(const QString &filename)
+{
+  lock_.lock();
+
+  CloseFile();
+
+  // Nothing in an existing file can be trusted, so everything starts off invalid
+  valid_.clear();
+  generation_.clear();
+  rendered_samples_.clear();
+
+  if (!filename.isEmpty()) {
+    file_.setFileName(filename);
+
+    if (file_.open(QFile::ReadWrite)) {
+      file_use_.Acquire(filename);
+    } else {
+      qWarning() << "Failed to open audio cache" << filename << file_.errorString();
+    }
+  }
+
+  lock_.unlock();
+}
+
+void AudioRenderCache::SetParameters(const AudioRenderingParams &params)
+{
+  lock_.lock();
+
+  if (params_ != params) {
+    params_ = params;
+
+    // Segments are a different size now
+    if (mapped_) {
+      file_.unmap(mapped_);
+      mapped_ = nullptr;
+    }
+
+    mapped_segments_ = 0;
+    valid_.clear();
+    generation_.clear();
+    rendered_samples_.clear();
+  }
+
+  lock_.unlock();
+}
+
+void AudioRenderCache::SetLength(const rational &length)
+{
+  lock_.lock();
+
+  length_in_bytes_ = params_.is_valid() ? params_.time_to_bytes(length) : 0;
+
+  lock_.unlock();
+}
+
+qint64 AudioRenderCache::size()
+{
+  lock_.lock();
+
+  qint64 sz = length_in_bytes_;
+
+  lock_.unlock();
+
+  return sz;
+}
+
+int AudioRenderCache::SegmentAtTime(const rational &time)
+{
+  lock_.lock();
+
+  int segment = params_.is_valid() ? params_.time_to_samples(time) / kSegmentSamples : 0;
+
+  lock_.unlock();
+
+  return segment;
+}
+
+TimeRange AudioRenderCache::SegmentRange(int segment)
+{
+  lock_.lock();
+
+  int64_t start = static_cast<int64_t>(segment) * kSegmentSamples;
+  TimeRange range(rational(start, params_.sample_rate()),
+                  rational(start + kSegmentSamples, params_.sample_rate()));
+
+  lock_.unlock();
+
+  return range;
+}
+
+void AudioRenderCache::Invalidate(const TimeRange &range, int *first, int *last)
+{
+  lock_.lock();
+
+  *first = 0;
+  *last = -1;
+
+  if (params_.is_valid() && range.out() > range.in()) {
+    *first = qMax(0, params_.time_to_samples(range.in()) / kSegmentSamples);
+    *last = qMax(0, (params_.time_to_samples(range.out()) - 1) / kSegmentSamples);
+
+    EnsureSegment(*last);
+
+    generation_counter_++;
+
+    for (int i=*first;i<=*last;i++) {
+      valid_.clearBit(i);
+      generation_[i] = generation_counter_;
+      rendered_samples_[i] = 0;
+    }
+  }
+
+  lock_.unlock();
+}
+
+quint64 AudioRenderCache::Generation(int segment)
+{
+  lock_.lock();
+
+  quint64 generation = (segment >= 0 && segment < generation_.size()) ? generation_.at(segment) : 0;
+
+  lock_.unlock();
+
+  return generation;
+}
+
+bool AudioRenderCache::IsValid(int segment)
+{
+  lock_.lock();
+
+  bool valid = (segment >= 0 && segment < valid_.size() && valid_.testBit(segment));
+
+  lock_.unlock();
+
+  return valid;
+}
+
+void AudioRenderCache::Write(int segment, quint64 generation, int offset, const QByteArray &samples)
+{
+  lock_.lock();
+
+  if (segment >= 0
+      && segment < generation_.size()
+      && generation_.at(segment) == generation
+      && !valid_.testBit(segment)
+      && offset >= 0
+      && offset <= rendered_samples_.at(segment)
+      && EnsureSegment(segment)) {
+    int seg_size = segment_size();
+    int start = params_.samples_to_bytes(offset);
+    int sample_count = qMin(kSegmentSamples - offset, params_.bytes_to_samples(samples.size()));
+    uchar* dst = mapped_ + static_cast<qint64>(segment) * seg_size;
+
+    memcpy(dst + start, samples.constData(), static_cast<size_t>(params_.samples_to_bytes(sample_count)));
+
+    int rendered = qMax(rendered_samples_.at(segment), offset + sample_count);
+    int rendered_bytes = params_.samples_to_bytes(rendered);
+
+    // The last segment only needs to reach the end of the cache, the rest of it is silence
+    qint64 needed_bytes = qMin(static_cast<qint64>(seg_size), length_in_bytes_ - static_cast<qint64>(segment) * seg_size);
+
+    if (rendered_bytes >= needed_bytes) {
+      memset(dst + rendered_bytes, 0, static_cast<size_t>(seg_size - rendered_bytes));
+
+      valid_.setBit(segment);
+    }
+
+    rendered_samples_[segment] = rendered;
+  }
+
+  lock_.unlock();
+}
+
+qint64 AudioRenderCache::Read(qint64 offset, char *buffer, qint64 length)
+{
+  lock_.lock();
+
+  qint64 seg_size = segment_size();
+  qint64 end = qMin(offset + length, length_in_bytes_);
+  qint64 pos = qMax(Q_INT64_C(0), offset);
+
+  read_offset_ = pos;
+
+  while (seg_size > 0 && pos < end) {
+    int segment = static_cast<int>(pos / seg_size);
+    qint64 count = qMin(end, (segment + 1) * seg_size) - pos;
+    qint64 rendered_count = qBound(Q_INT64_C(0), RenderedEnd(segment) - pos, count);
+
+    memcpy(buffer, mapped_ + pos, static_cast<size_t>(rendered_count));
+    memset(buffer + rendered_count, 0, static_cast<size_t>(count - rendered_count));
+
+    buffer += count;
+    pos += count;
+  }
+
+  lock_.unlock();
+
+  return qMax(Q_INT64_C(0), pos - offset);
+}
+
+qint64 AudioRenderCache::ValidBytesAt(qint64 offset)
+{
+  lock_.lock();
+
+  qint64 seg_size = segment_size();
+  qint64 pos = qMax(Q_INT64_C(0), offset);
+
+  read_offset_ = pos;
+
+  while (seg_size > 0 && pos < length_in_bytes_) {
+    int segment = static_cast<int>(pos / seg_size);
+    qint64 segment_end = (segment + 1) * seg_size;
+    qint64 rendered_end = RenderedEnd(segment);
+
+    if (rendered_end < segment_end) {
+      // Playback can carry on into what's rendered of this segment so far
+      if (rendered_end <= offset) {
+        requested_segment_ = segment;
+      }
+
+      pos = qMax(pos, rendered_end);
+      break;
+    }
+
+    pos = segment_end;
+  }
+
+  qint64 valid_bytes = qMin(pos, length_in_bytes_) - offset;
+
+  lock_.unlock();
+
+  return qMax(Q_INT64_C(0), valid_bytes);
+}
+
+int AudioRenderCache::RequestedSegment()
+{
+  lock_.lock();
+
+  int segment = requested_segment_;
+
+  lock_.unlock();
+
+  return segment;
+}
+
+qint64 AudioRenderCache::ReadOffset()
+{
+  lock_.lock();
+
+  qint64 offset = read_offset_;
+
+  lock_.unlock();
+
+  return offset;
+}
+
+void AudioRenderCache::StartReading(qint64 offset)
+{
+  lock_.lock();
+
+  read_offset_ = qMax(Q_INT64_C(0), offset);
+
+  lock_.unlock();
+}
+
+void AudioRenderCache::StopReading()
+{
+  lock_.lock();
+
+  read_offset_ = -1;
+
+  lock_.unlock();
+}
+
+bool AudioRenderCache::NextUnrenderedBlock(int block_samples, int lookahead, TimeRange *range)
+{
+  lock_.lock();
+
+  bool found = false;
+  qint64 seg_size = segment_size();
+
+  if (read_offset_ >= 0 && seg_size > 0) {
+    int first_segment = static_cast<int>(read_offset_ / seg_size);
+
+    for (int i=first_segment;i<first_segment+lookahead;i++) {
+      qint64 segment_start = i * seg_size;
+
+      if (segment_start >= length_in_bytes_) {
+        break;
+      }
+
+      qint64 rendered_end = RenderedEnd(i);
+
+      if (rendered_end < segment_start + seg_size) {
+        // Blocks only ever carry on from what's already rendered, so this is the only block of the segment that can go
+        // next
+        int start = params_.bytes_to_samples(static_cast<int>(rendered_end - segment_start));
+        int end = qMin(qMin(start + block_samples, kSegmentSamples),
+                       params_.bytes_to_samples(static_cast<int>(qMin(seg_size, length_in_bytes_ - segment_start))));
+
+        if (end > start) {
+          int64_t first_sample = static_cast<int64_t>(i) * kSegmentSamples;
+
+          *range = TimeRange(rational(first_sample + start, params_.sample_rate()),
+                             rational(first_sample + end, params_.sample_rate()));
+          found = true;
+        }
+
+        break;
+      }
+    }
+  }
+
+  lock_.unlock();
+
+  return found;
+}
+
+qint64 AudioRenderCache::RenderedEnd(int segment) const
+{
+  qint64 seg_size = segment_size();
+  qint64 segment_start = static_cast<qint64>(segment) * seg_size;
+
+  if (segment >= mapped_segments_ || segment >= valid_.size()) {
+    return segment_start;
+  }
+
+  if (valid_.testBit(segment)) {
+    return segment_start + seg_size;
+  }
+
+  return segment_start + params_.samples_to_bytes(rendered_samples_.at(segment));
+}
+
+int AudioRenderCache::segment_size() const
+{
+  return params_.is_valid() ? params_.samples_to_bytes(kSegmentSamples) : 0;
+}
+
+bool AudioRenderCache::EnsureSegment(int segment)
+{
+  if (segment >= valid_.size()) {
+    valid_.resize(segment + 1);
+    generation_.resize(segment + 1);
+    rendered_samples_.resize(segment + 1);
+  }
+
+  if (segment < mapped_segments_) {
+    return true;
+  }
+
+  if (!file_.isOpen() || segment_size() == 0) {
+    return false;
+  }
+
+  // Grow the file and remap it
+  if (mapped_) {
+    file_.unmap(mapped_);
+    mapped_ = nullptr;
+  }
+
+  mapped_segments_ = 0;
+
+  int new_segment_count = (segment / kGrowSegments + 1) * kGrowSegments;
+  qint64 new_size = static_cast<qint64>(new_segment_count) * segment_size();
+
+  if (!file_.resize(new_size) || !(mapped_ = file_.map(0, new_size))) {
+    qWarning() << "Failed to map audio cache" << file_.fileName() << file_.errorString();
+    return false;
+  }
+
+  mapped_segments_ = new_segment_count;
+
+  return true;
+}
+
+void AudioRenderCache::CloseFile()
+{
+  if (mapped_) {
+    file_.unmap(mapped_);
+    mapped_ = nullptr;
+  }
+
+  mapped_segments_ = 0;
+
+  if (file_.isOpen()) {
+    file_.close();
+  }
+
+  file_use_.Release();
+}
+
+AudioRenderCacheDevice::AudioRenderCacheDevice(AudioRenderCache *cache, QObject *parent) :
+  QIODevice(parent),
+  cache_(cache)
+{
+}
+
+bool AudioRenderCacheDevice::open(QIODevice::OpenMode mode)
+{
+  return QIODevice::open(mode | Unbuffered);
+}
+
+void AudioRenderCacheDevice::close()
+{
+  cache_->StopReading();
+
+  QIODevice::close();
+}
+
+bool AudioRenderCacheDevice::seek(qint64 pos)
+{
+  if (!QIODevice::seek(pos)) {
+    return false;
+  }
+
+  cache_->StartReading(pos);
+
+  return true;
+}
+
+bool AudioRenderCacheDevice::isSequential() const
+{
+  return false;
+}
+
+qint64 AudioRenderCacheDevice::bytesAvailable() const
+{
+  // Always unbuffered, so there's nothing of QIODevice's own to add
+  return cache_->ValidBytesAt(pos());
+}
+
+qint64 AudioRenderCacheDevice::size() const
+{
+  return cache_->size();
+}
+
+qint64 AudioRenderCacheDevice::readData(char *data, qint64 maxSize)
+{
+  qint64 read = cache_->Read(pos(), data, maxSize);
+
+  // QIODevice treats 0 as "no data yet" rather than the end
+  return (read > 0) ? read : -1;
+}
+
+qint64 AudioRenderCacheDevice::writeData(const char *data, qint64 maxSize)
+{
+  Q_UNUSED(data)
+  Q_UNUSED(maxSize)
+
+  return -1;
+}
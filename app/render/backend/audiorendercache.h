@@ -0,0 +1,258 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#ifndef AUDIORENDERCACHE_H
+#define AUDIORENDERCACHE_H
+
+#include <QBitArray>
+#include <QFile>
+#include <QIODevice>
+#include <QMutex>
+#include <QVector>
+
+#include "common/constructors.h"
+#include "common/timerange.h"
+#include "render/audioparams.h"
+#include "render/diskcachemanager.h"
+
+/**
+ * @brief Disk cache of rendered audio split into fixed-size segments
+ *
+ * The cache file is kept memory-mapped, so render workers copy the samples of a finished segment straight into it
+ * from their own threads (leaving the OS to write them back to disk) and playback reads from the mapping without
+ * reopening anything. Each segment has a validity bit and a generation that's bumped every time it's invalidated, so
+ * a segment that's edited while it's rendering isn't marked valid with out of date samples.
+ *
+ * A segment can also be filled in a few samples at a time from its start (see Write()), so playback can start on it
+ * before all of it has rendered.
+ *
+ * All functions are thread-safe.
+ */
+class AudioRenderCache
+{
+public:
+  /**
+   * @brief Number of samples in each segment
+   */
+  static const int kSegmentSamples = 8192;
+
+  AudioRenderCache();
+
+  ~AudioRenderCache();
+
+  DISABLE_COPY_MOVE(AudioRenderCache)
+
+  /**
+   * @brief Switch to the cache file at `filename`, every segment starts off invalid
+   *
+   * An empty filename closes the cache.
+   */
+  void SetFilename(const QString& filename);
+
+  void SetParameters(const AudioRenderingParams& params);
+
+  /**
+   * @brief Set the length of the audio this cache holds, reads stop here
+   */
+  void SetLength(const rational& length);
+
+  /**
+   * @brief Size in bytes of the audio this cache holds
+   */
+  qint64 size();
+
+  int SegmentAtTime(const rational& time);
+
+  TimeRange SegmentRange(int segment);
+
+  /**
+   * @brief Mark every segment touching `range` as invalid
+   *
+   * The first and last segments invalidated are returned through `first` and `last`.
+   */
+  void Invalidate(const TimeRange& range, int* first, int* last);
+
+  /**
+   * @brief Get the current generation of a segment, which should be read before starting to render it
+   */
+  quint64 Generation(int segment);
+
+  bool IsValid(int segment);
+
+  /**
+   * @brief Store samples rendered for a segment, starting `offset` samples in
+   *
+   * Blocks must carry on from (or overlap) what's already been rendered of the segment since it was last invalidated,
+   * anything after a gap is discarded. Once the samples reach the end of the segment (or the end of the cache), the
+   * segment is marked valid. Nothing is written if the segment was invalidated again after `generation` was read,
+   * since the samples are already out of date.
+   */
+  void Write(int segment, quint64 generation, int offset, const QByteArray& samples);
+
+  /**
+   * @brief Copy up to `length` bytes starting `offset` bytes in to `buffer`
+   *
+   * Segments that aren't valid read as silence past what's been rendered of them so far.
+   *
+   * @return
+   *
+   * Number of bytes copied, which is only less than `length` at the end of the cache.
+   */
+  qint64 Read(qint64 offset, char* buffer, qint64 length);
+
+  /**
+   * @brief Number of bytes from `offset` up to the first sample that hasn't rendered yet
+   *
+   * If the sample at `offset` hasn't rendered, its segment is remembered as the one playback is waiting on.
+   *
+   * \see RequestedSegment()
+   */
+  qint64 ValidBytesAt(qint64 offset);
+
+  /**
+   * @brief The last segment playback found wasn't valid yet, or -1 if it never has
+   */
+  int RequestedSegment();
+
+  /**
+   * @brief Where playback last read from (in bytes), or -1 if nothing is reading the cache
+   *
+   * Every Read() and ValidBytesAt() moves it along.
+   */
+  qint64 ReadOffset();
+
+  /**
+   * @brief Call when playback is about to start reading at `offset` (in bytes)
+   */
+  void StartReading(qint64 offset);
+
+  /**
+   * @brief Call when playback stops reading the cache, until it next reads
+   */
+  void StopReading();
+
+  /**
+   * @brief Find the next samples that haven't rendered from where playback is reading
+   *
+   * Looks up to `lookahead` segments ahead of ReadOffset() and returns at most `block_samples` samples, which never
+   * cross into the next segment, through `range`.
+   *
+   * @return
+   *
+   * FALSE if nothing is reading the cache or everything in the lookahead has rendered.
+   */
+  bool NextUnrenderedBlock(int block_samples, int lookahead, TimeRange* range);
+
+private:
+  /**
+   * @brief Segments the file grows by at a time, so it isn't remapped for every new segment
+   */
+  static const int kGrowSegments = 64;
+
+  int segment_size() const;
+
+  /**
+   * @brief Byte offset of the first sample in `segment` that hasn't rendered (lock_ must be held)
+   */
+  qint64 RenderedEnd(int segment) const;
+
+  /**
+   * @brief Make sure the bitmap, generations and mapping cover `segment` (lock_ must be held)
+   */
+  bool EnsureSegment(int segment);
+
+  void CloseFile();
+
+  QMutex lock_;
+
+  QFile file_;
+
+  /**
+   * @brief Keeps file_ from being evicted while it's open, it's written to through the mapping
+   */
+  DiskCacheManager::FileUse file_use_;
+
+  uchar* mapped_;
+
+  int mapped_segments_;
+
+  AudioRenderingParams params_;
+
+  qint64 length_in_bytes_;
+
+  QBitArray valid_;
+
+  QVector<quint64> generation_;
+
+  /**
+   * @brief Samples rendered from the start of each segment that isn't valid yet
+   */
+  QVector<int> rendered_samples_;
+
+  /**
+   * @brief Source of generation numbers, never reset so generations from an old file can't match a new one
+   */
+  quint64 generation_counter_;
+
+  int requested_segment_;
+
+  qint64 read_offset_;
+
+};
+
+/**
+ * @brief Read-only QIODevice for playing back an AudioRenderCache
+ */
+class AudioRenderCacheDevice : public QIODevice
+{
+  Q_OBJECT
+public:
+  AudioRenderCacheDevice(AudioRenderCache* cache, QObject* parent = nullptr);
+
+  /**
+   * @brief Always opens unbuffered, so reads never run ahead into segments that haven't rendered yet
+   */
+  virtual bool open(OpenMode mode) override;
+
+  virtual void close() override;
+
+  virtual bool seek(qint64 pos) override;
+
+  virtual bool isSequential() const override;
+
+  /**
+   * @brief Bytes that have already rendered from the current position on
+   */
+  virtual qint64 bytesAvailable() const override;
+
+  virtual qint64 size() const override;
+
+protected:
+  virtual qint64 readData(char *data, qint64 maxSize) override;
+
+  virtual qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+  AudioRenderCache* cache_;
+
+};
+
+#endif // AUDIORENDERCACHE_H
@@ -1,15 +1,22 @@
 #include "audiorenderworker.h"
 
+#include <algorithm>
+
 #include "audio/audiomanager.h"
+#include "render/audioblock.h"
+#include "render/audiokernels.h"
 
-AudioRenderWorker::AudioRenderWorker(DecoderCache *decoder_cache, QObject *parent) :
-  RenderWorker(decoder_cache, parent)
+AudioRenderWorker::AudioRenderWorker(DecoderCache *decoder_cache, AudioRenderCache *cache, QObject *parent) :
+  RenderWorker(decoder_cache, parent),
+  cache_(cache)
 {
 }
 
 void AudioRenderWorker::SetParameters(const AudioRenderingParams &audio_params)
 {
   audio_params_ = audio_params;
+
+  ClearStaticValues();
 }
 
 bool AudioRenderWorker::InitInternal()
@@ -23,6 +30,48 @@ void AudioRenderWorker::CloseInternal()
   // Nothing to init yet
 }
 
+NodeValueTable AudioRenderWorker::RenderInternal(const NodeDependency &path)
+{
+  int first_segment = cache_->SegmentAtTime(path.in());
+  int first_offset = audio_params_.time_to_samples(path.in()) - first_segment * AudioRenderCache::kSegmentSamples;
+  int expected_size = audio_params_.time_to_bytes(path.range().length());
+  int sample_count = audio_params_.bytes_to_samples(expected_size);
+  int last_segment = first_segment + qMax(0, first_offset + sample_count - 1) / AudioRenderCache::kSegmentSamples;
+
+  // Read before rendering, so if a segment is invalidated while we work, our now out of date samples are discarded
+  QVector<quint64> generations;
+
+  for (int i=first_segment;i<=last_segment;i++) {
+    generations.append(cache_->Generation(i));
+  }
+
+  NodeValueTable value = RenderWorker::RenderInternal(path);
+
+  // Anything that didn't render (e.g. nothing is connected) is silence
+  QByteArray samples = value.Get(NodeParam::kSamples).toByteArray();
+
+  if (samples.size() < expected_size) {
+    samples.append(QByteArray(expected_size - samples.size(), 0));
+  }
+
+  // Jobs can cover several segments (see AudioRenderBackend::SegmentsPerJob()), each is written separately
+  int written = 0;
+
+  for (int i=first_segment;i<=last_segment;i++) {
+    int offset = (i == first_segment) ? first_offset : 0;
+    int count = qMin(AudioRenderCache::kSegmentSamples - offset, sample_count - written);
+
+    cache_->Write(i,
+                  generations.at(i - first_segment),
+                  offset,
+                  samples.mid(audio_params_.samples_to_bytes(written), audio_params_.samples_to_bytes(count)));
+
+    written += count;
+  }
+
+  return value;
+}
+
 FramePtr AudioRenderWorker::RetrieveFromDecoder(DecoderPtr decoder, const TimeRange &range)
 {
   return decoder->RetrieveAudio(range.in(), range.out() - range.in(), audio_params_);
@@ -30,44 +79,197 @@ FramePtr AudioRenderWorker::RetrieveFromDecoder(DecoderPtr decoder, const TimeRa
 
 NodeValueTable AudioRenderWorker::RenderBlock(TrackOutput *track, const TimeRange &range)
 {
-  QList<Block*> active_blocks = track->BlocksAtTimeRange(range);
+  // Only the first track is connected to anything we render, the others are chained to it through their track inputs,
+  // so this is where every track gets mixed together
+  QList<TrackOutput*> tracks = track->TrackChain();
+
+  QVector<TrackOutput*> block_tracks;
+  QVector<Block*> blocks;
+  QVector<TimeRange> block_ranges;
 
-  // All these blocks will need to output to a buffer so we create one here
-  QByteArray block_range_buffer(audio_params_.time_to_bytes(range.length()), 0);
+  foreach (TrackOutput* t, tracks) {
+    // Muted tracks are skipped entirely, none of their footage is decoded
+    if (TrackOutput::IsSkipped(tracks, t, range.in())) {
+      continue;
+    }
+
+    foreach (Block* b, t->BlocksAtTimeRange(range)) {
+      block_tracks.append(t);
+      blocks.append(b);
+      block_ranges.append(TimeRange(qMax(b->in(), range.in()),
+                                    qMin(b->out(), range.out())));
+    }
+  }
+
+  // Offer every block but the first to the other workers so they can be rendered in parallel
+  QVector<RenderSiblingJobPtr> forked(blocks.size());
+
+  if (CanForkSiblings()) {
+    for (int i=1;i<blocks.size();i++) {
+      forked[i] = ForkSibling(NodeDependency(blocks.at(i), block_ranges.at(i)));
+    }
+  }
+
+  // Every block is summed into this buffer, anywhere no block covers stays silent. Workers always render float
+  // samples, so it can be mixed into directly.
+  Q_ASSERT(audio_params_.format() == SAMPLE_FMT_FLT);
+
+  int channel_count = audio_params_.channel_count();
+  int bus_sample_count = audio_params_.time_to_samples(range.length());
+  QByteArray bus(audio_params_.samples_to_bytes(bus_sample_count), 0);
+  float* bus_data = reinterpret_cast<float*>(bus.data());
+
+  QVector<float> gains(channel_count);
 
   NodeValueTable merged_table;
 
-  // Loop through active blocks retrieving their audio
-  foreach (Block* b, active_blocks) {
-    TimeRange range_for_block(qMax(b->in(), range.in()),
-                              qMin(b->out(), range.out()));
+  for (int i=0;i<blocks.size();i++) {
+    const TimeRange& range_for_block = block_ranges.at(i);
+
+    NodeValueTable table;
 
-    NodeValueTable table = RenderAsSibling(NodeDependency(b,
-                                                          range_for_block));
+    if (forked.at(i)) {
+      table = JoinSibling(forked.at(i));
+    } else {
+      table = RenderAsSibling(NodeDependency(blocks.at(i), range_for_block));
+    }
 
     QByteArray samples_from_this_block = table.Take(NodeParam::kSamples).toByteArray();
-    int destination_offset = audio_params_.time_to_bytes(range_for_block.in() - range.in());
-    int maximum_copy_size = audio_params_.time_to_bytes(range_for_block.length());
-    int copied_size = 0;
+    int destination_sample = audio_params_.time_to_samples(range_for_block.in() - range.in());
+    int mix_count = qMin(audio_params_.bytes_to_samples(samples_from_this_block.size()),
+                         bus_sample_count - destination_sample);
 
-    if (!samples_from_this_block.isEmpty()) {
-      copied_size = samples_from_this_block.size();
+    if (mix_count > 0) {
+      TrackOutput* block_track = block_tracks.at(i);
+      float* mix_destination = bus_data + destination_sample * channel_count;
+      const float* mix_source = reinterpret_cast<const float*>(samples_from_this_block.constData());
 
-      memcpy(block_range_buffer.data()+destination_offset,
-             samples_from_this_block.data(),
-             static_cast<size_t>(copied_size));
-    }
+      if (block_track->volume_input()->is_keyframing() || block_track->pan_input()->is_keyframing()) {
+        // Follow volume and pan keyframes sample by sample, whatever their interpolation
+        MixWithTrackCurves(block_track, range_for_block.in(), mix_destination, mix_source, mix_count);
+      } else {
+        GetTrackGains(block_track, range_for_block.in(), gains.data());
 
-    if (copied_size < maximum_copy_size) {
-      memset(block_range_buffer.data()+destination_offset+copied_size,
-             0,
-             static_cast<size_t>(maximum_copy_size - copied_size));
+        olive::kernels::MixInterleaved(mix_destination, mix_source, mix_count, channel_count,
+                                       gains.constData(), gains.constData());
+      }
     }
 
-    NodeValueTable::Merge({merged_table, table});
+    merged_table = NodeValueTable::Merge({merged_table, table});
   }
 
-  merged_table.Push(NodeParam::kSamples, block_range_buffer);
+  merged_table.Push(NodeParam::kSamples, bus);
 
   return merged_table;
 }
+
+void AudioRenderWorker::RunNodeSamples(Node *node, const TimeRange &range, const NodeValueDatabase &input_params,
+                                       NodeValueTable *output_params)
+{
+  NodeInput* main_input = node->MainInput();
+
+  if (main_input == nullptr) {
+    return;
+  }
+
+  // Silence stays silent, nothing to process
+  QByteArray samples = input_params[main_input].Get(NodeParam::kSamples).toByteArray();
+
+  if (samples.isEmpty()) {
+    return;
+  }
+
+  Q_ASSERT(audio_params_.format() == SAMPLE_FMT_FLT);
+
+  int channel_count = audio_params_.channel_count();
+  int frame_count = audio_params_.bytes_to_samples(samples.size());
+
+  // The samples start this much before `range` so the node's state has settled by the time it gets there
+  rational pre_roll = node->InputTimeAdjustment(main_input, range).in()
+      - InputTimeWithPreRoll(node, main_input, range).in();
+  int pre_roll_frames = qMin(frame_count, audio_params_.time_to_samples(pre_roll));
+  rational start = range.in() - rational(pre_roll_frames, audio_params_.sample_rate());
+
+  // Only copies if another value still shares it
+  float* data = reinterpret_cast<float*>(samples.data());
+
+  AudioBlock block(audio_params_, input_params);
+
+  for (int offset=0;offset<frame_count;offset+=AudioBlock::kMaximumFrames) {
+    int block_frames = qMin(AudioBlock::kMaximumFrames, frame_count - offset);
+    float* block_data = data + offset * channel_count;
+
+    block.SetRange(start + rational(offset, audio_params_.sample_rate()), block_frames);
+
+    process_buffer_.Deinterleave(block_data, channel_count, block_frames);
+    node->ProcessSamples(&block, &process_buffer_);
+    process_buffer_.Interleave(block_data);
+  }
+
+  if (pre_roll_frames > 0) {
+    samples.remove(0, audio_params_.samples_to_bytes(pre_roll_frames));
+  }
+
+  output_params->Push(NodeParam::kSamples, samples);
+}
+
+void AudioRenderWorker::MixWithTrackCurves(TrackOutput *track, const rational &in, float *destination,
+                                           const float *source, int frame_count) const
+{
+  int channel_count = audio_params_.channel_count();
+  rational timebase(1, audio_params_.sample_rate());
+
+  QVector<float> pan(AudioBlock::kMaximumFrames);
+  QVector< QVector<float> > gains(channel_count, QVector<float>(AudioBlock::kMaximumFrames));
+  QVector<const float*> gain_pointers(channel_count);
+
+  for (int i=0;i<channel_count;i++) {
+    gain_pointers[i] = gains.at(i).constData();
+  }
+
+  // Sampled a block at a time so the curves stay small
+  for (int offset=0;offset<frame_count;offset+=AudioBlock::kMaximumFrames) {
+    int block_frames = qMin(AudioBlock::kMaximumFrames, frame_count - offset);
+    TimeRange block_range(in + rational(offset, audio_params_.sample_rate()),
+                          in + rational(offset + block_frames, audio_params_.sample_rate()));
+
+    float* volume = gains[0].data();
+    track->volume_input()->get_values_over_range(block_range, timebase, volume, block_frames);
+    olive::kernels::ApplyGain(volume, block_frames, 0.01f);
+
+    for (int i=1;i<channel_count;i++) {
+      std::copy(volume, volume + block_frames, gains[i].data());
+    }
+
+    // Pan stereo tracks as a balance, the same as GetTrackGains()
+    if (channel_count == 2) {
+      track->pan_input()->get_values_over_range(block_range, timebase, pan.data(), block_frames);
+      olive::kernels::ApplyGain(pan.data(), block_frames, 0.01f);
+      olive::kernels::PanStereo(gains[0].data(), gains[1].data(), block_frames, pan.constData());
+    }
+
+    olive::kernels::MixInterleavedCurve(destination + offset * channel_count,
+                                        source + offset * channel_count,
+                                        block_frames,
+                                        channel_count,
+                                        gain_pointers.constData());
+  }
+}
+
+void AudioRenderWorker::GetTrackGains(TrackOutput *track, const rational &time, float *gains) const
+{
+  int channel_count = audio_params_.channel_count();
+  float volume = static_cast<float>(track->volume_input()->get_value_at_time(time).toDouble() * 0.01);
+
+  for (int i=0;i<channel_count;i++) {
+    gains[i] = volume;
+  }
+
+  // Pan stereo tracks as a balance, so a centered track plays at full volume on both sides
+  if (channel_count == 2) {
+    float pan = static_cast<float>(track->pan_input()->get_value_at_time(time).toDouble() * 0.01);
+
+    gains[0] *= qMin(1.0f, 1.0f - pan);
+    gains[1] *= qMin(1.0f, 1.0f + pan);
+  }
+}
@@ -1,13 +1,15 @@
 #ifndef AUDIORENDERWORKER_H
 #define AUDIORENDERWORKER_H
 
+#include "audiorendercache.h"
+#include "render/audiobuffer.h"
 #include "renderworker.h"
 
 class AudioRenderWorker : public RenderWorker
 {
   Q_OBJECT
 public:
-  AudioRenderWorker(DecoderCache* decoder_cache, QObject* parent = nullptr);
+  AudioRenderWorker(DecoderCache* decoder_cache, AudioRenderCache* cache, QObject* parent = nullptr);
 
   void SetParameters(const AudioRenderingParams& audio_params);
 
@@ -16,13 +18,47 @@ protected:
 
   virtual void CloseInternal() override;
 
+  /**
+   * @brief Renders one segment of the cache, or a block of one, and writes it straight into the cache
+   */
+  virtual NodeValueTable RenderInternal(const NodeDependency& path) override;
+
   virtual FramePtr RetrieveFromDecoder(DecoderPtr decoder, const TimeRange& range) override;
 
   virtual NodeValueTable RenderBlock(TrackOutput *track, const TimeRange& range) override;
 
+  /**
+   * @brief Splits the node's main input samples into AudioBlocks and has the node process each in turn
+   */
+  virtual void RunNodeSamples(Node* node, const TimeRange& range, const NodeValueDatabase& input_params,
+                              NodeValueTable* output_params) override;
+
 private:
+  /**
+   * @brief Get the gain of each channel of `track` at `time` from its volume and pan
+   *
+   * `gains` must hold audio_params_.channel_count() values.
+   */
+  void GetTrackGains(TrackOutput* track, const rational& time, float* gains) const;
+
+  /**
+   * @brief Mix `frame_count` frames starting at `in` into `destination`, following the track's volume and pan curves
+   *
+   * Used instead of GetTrackGains() while either is keyframed, since ramping linearly between the gains at either end
+   * of a block misses keyframes inside it and eased interpolation.
+   */
+  void MixWithTrackCurves(TrackOutput* track, const rational& in, float* destination, const float* source,
+                          int frame_count) const;
+
   AudioRenderingParams audio_params_;
 
+  AudioRenderCache* cache_;
+
+  /**
+   * @brief Reused for every block every node processes, so it's only allocated once
+   */
+  AudioBuffer process_buffer_;
+
 };
 
 #endif // AUDIORENDERWORKER_H
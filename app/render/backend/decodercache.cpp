@@ -1,5 +1,7 @@
 #include "decodercache.h"
 
+#include "common/metrics.h"
+
 DecoderCache::DecoderCache()
 {
 
@@ -7,15 +9,160 @@ DecoderCache::DecoderCache()
 
 void DecoderCache::Clear()
 {
+  lock_.lock();
   decoders_.clear();
+  reservation_done_.wakeAll();
+  lock_.unlock();
 }
 
-void DecoderCache::AddDecoder(Stream *stream, DecoderPtr shader)
+DecoderPtr DecoderCache::AcquireDecoder(Stream *stream, const rational &time, Decoder::Profile profile)
 {
-  decoders_.insert(stream, shader);
+  lock_.lock();
+
+  int best_index;
+  bool best_idle;
+  int profile_count;
+
+  forever {
+    QVector<PooledDecoder>& pool = decoders_[stream];
+
+    best_index = -1;
+    best_idle = false;
+    profile_count = 0;
+
+    rational best_distance;
+
+    for (int i=0;i<pool.size();i++) {
+      const PooledDecoder& d = pool.at(i);
+
+      if (d.profile != profile) {
+        continue;
+      }
+
+      // Reserved slots count towards the maximum but have no decoder to hand out yet
+      profile_count++;
+
+      if (!d.decoder) {
+        continue;
+      }
+
+      bool idle = (d.users == 0);
+      rational distance = qAbs(d.position - time);
+
+      // Idle decoders always take priority over busy ones
+      if (best_index == -1
+          || (idle && !best_idle)
+          || (idle == best_idle && distance < best_distance)) {
+        best_index = i;
+        best_idle = idle;
+        best_distance = distance;
+      }
+    }
+
+    if (best_index != -1 || profile_count < kMaximumDecodersPerStream) {
+      break;
+    }
+
+    // The pool is full of slots other threads are still opening decoders for, wait for one of them
+    reservation_done_.wait(&lock_);
+  }
+
+  if (best_index == -1 || (!best_idle && profile_count < kMaximumDecodersPerStream)) {
+    // Reserve a slot and let the caller create a new decoder for it
+    PooledDecoder reserved;
+    reserved.profile = profile;
+    reserved.position = time;
+    reserved.users = 1;
+    decoders_[stream].append(reserved);
+
+    lock_.unlock();
+    Metrics::Increment(Metrics::kDecoderCacheMisses);
+    return nullptr;
+  }
+
+  PooledDecoder& d = decoders_[stream][best_index];
+  d.users++;
+  d.position = time;
+
+  DecoderPtr decoder = d.decoder;
+
+  lock_.unlock();
+
+  Metrics::Increment(Metrics::kDecoderCacheHits);
+
+  // If the decoder is busy, this will wait until it's free
+  decoder->lock()->lock();
+
+  return decoder;
 }
 
-DecoderPtr DecoderCache::GetDecoder(Stream *stream)
+void DecoderCache::AddDecoder(Stream *stream, DecoderPtr decoder, const rational &time)
 {
-  return decoders_.value(stream);
+  decoder->lock()->lock();
+
+  lock_.lock();
+
+  QVector<PooledDecoder>& pool = decoders_[stream];
+
+  int reserved_index = -1;
+
+  for (int i=0;i<pool.size();i++) {
+    if (!pool.at(i).decoder && pool.at(i).profile == decoder->profile()) {
+      reserved_index = i;
+      break;
+    }
+  }
+
+  if (reserved_index == -1) {
+    // The reservation was dropped by Clear(), add the decoder anyway since the caller is already using it
+    PooledDecoder d;
+    d.profile = decoder->profile();
+    pool.append(d);
+    reserved_index = pool.size() - 1;
+  }
+
+  PooledDecoder& d = pool[reserved_index];
+  d.decoder = decoder;
+  d.position = time;
+  d.users = 1;
+
+  reservation_done_.wakeAll();
+
+  lock_.unlock();
+}
+
+void DecoderCache::CancelReservation(Stream *stream, Decoder::Profile profile)
+{
+  lock_.lock();
+
+  QVector<PooledDecoder>& pool = decoders_[stream];
+
+  for (int i=0;i<pool.size();i++) {
+    if (!pool.at(i).decoder && pool.at(i).profile == profile) {
+      pool.remove(i);
+      break;
+    }
+  }
+
+  reservation_done_.wakeAll();
+
+  lock_.unlock();
+}
+
+void DecoderCache::ReleaseDecoder(DecoderPtr decoder)
+{
+  lock_.lock();
+
+  QVector<PooledDecoder>& pool = decoders_[decoder->stream().get()];
+
+  for (int i=0;i<pool.size();i++) {
+    if (pool.at(i).decoder == decoder) {
+      pool[i].users--;
+      break;
+    }
+  }
+
+  lock_.unlock();
+
+  decoder->lock()->unlock();
 }
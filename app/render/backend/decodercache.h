@@ -1,11 +1,20 @@
 #ifndef DECODERCACHE_H
 #define DECODERCACHE_H
 
+#include <QMap>
+#include <QMutex>
+#include <QVector>
+#include <QWaitCondition>
+
 #include "decoder/decoder.h"
 #include "project/item/footage/stream.h"
 
 /**
  * @brief Thread-safe cache of decoders
+ *
+ * Decoders aren't thread-safe and seeking is expensive, so rather than every worker sharing one decoder per stream,
+ * the cache keeps a small pool of decoders per stream. Workers acquire the decoder closest to the time they want so
+ * workers decoding different parts of the same footage each keep their own decoder's position.
  */
 class DecoderCache
 {
@@ -14,12 +23,59 @@ public:
 
   void Clear();
 
-  void AddDecoder(Stream* stream, DecoderPtr shader);
+  /**
+   * @brief Acquire a decoder for this stream for exclusive use
+   *
+   * Only decoders with this profile are considered. The idle decoder whose last position is closest to `time` is
+   * preferred. If they're all busy and the pool isn't full, this reserves a slot in the pool and returns nullptr. The
+   * caller should then create a new decoder and add it with AddDecoder(), or give the slot back with
+   * CancelReservation() if it can't or won't. Otherwise, this blocks until the closest busy decoder is free.
+   *
+   * The slot is reserved under the same lock as the check so concurrent misses can't open more than
+   * kMaximumDecodersPerStream decoders between them.
+   *
+   * Every decoder returned must be released with ReleaseDecoder().
+   */
+  DecoderPtr AcquireDecoder(Stream* stream, const rational& time, Decoder::Profile profile);
+
+  /**
+   * @brief Add a new decoder to the stream's pool, acquiring it for the caller as if from AcquireDecoder()
+   */
+  void AddDecoder(Stream* stream, DecoderPtr decoder, const rational& time);
+
+  /**
+   * @brief Give back a slot reserved by AcquireDecoder() returning nullptr without adding a decoder to it
+   */
+  void CancelReservation(Stream* stream, Decoder::Profile profile);
+
+  /**
+   * @brief Release a decoder retrieved from AcquireDecoder() or added with AddDecoder()
+   */
+  void ReleaseDecoder(DecoderPtr decoder);
 
-  DecoderPtr GetDecoder(Stream* stream);
+  /**
+   * @brief Maximum number of decoders to create for any one stream and profile
+   */
+  static const int kMaximumDecodersPerStream = 4;
 
 private:
-  QMap<Stream*, DecoderPtr> decoders_;
+  /**
+   * @brief A decoder in the pool
+   *
+   * A null `decoder` is a slot reserved by AcquireDecoder() that hasn't been filled by AddDecoder() yet.
+   */
+  struct PooledDecoder {
+    DecoderPtr decoder;
+    Decoder::Profile profile;
+    rational position;
+    int users;
+  };
+
+  QMap<Stream*, QVector<PooledDecoder> > decoders_;
+
+  QMutex lock_;
+
+  QWaitCondition reservation_done_;
 
 };
 
@@ -0,0 +1,178 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#include "framehasher.h"
+
+#include <cstring>
+
+namespace {
+const uint64_t kC1 = 0x87c37b91114253d5ULL;
+const uint64_t kC2 = 0x4cf5ad432745937fULL;
+}
+
+FrameHasher::FrameHasher(const uint64_t &seed) :
+  h1_(seed),
+  h2_(seed),
+  tail_length_(0),
+  total_length_(0)
+{
+}
+
+void FrameHasher::AddData(const void *data, const size_t &length)
+{
+  const uchar* bytes = static_cast<const uchar*>(data);
+  size_t remaining = length;
+
+  total_length_ += length;
+
+  // Complete any partial block left over from the last call
+  if (tail_length_ > 0) {
+    size_t fill = qMin(remaining, static_cast<size_t>(kBlockSize) - tail_length_);
+
+    memcpy(tail_ + tail_length_, bytes, fill);
+    tail_length_ += fill;
+    bytes += fill;
+    remaining -= fill;
+
+    if (tail_length_ < static_cast<size_t>(kBlockSize)) {
+      return;
+    }
+
+    ProcessBlock(tail_);
+    tail_length_ = 0;
+  }
+
+  while (remaining >= static_cast<size_t>(kBlockSize)) {
+    ProcessBlock(bytes);
+    bytes += kBlockSize;
+    remaining -= kBlockSize;
+  }
+
+  // Keep the rest until we have a full block or the result is requested
+  memcpy(tail_, bytes, remaining);
+  tail_length_ = remaining;
+}
+
+void FrameHasher::AddData(const QByteArray &data)
+{
+  AddData(data.constData(), static_cast<size_t>(data.size()));
+}
+
+void FrameHasher::AddData(const QString &str)
+{
+  // Hash the length too so that consecutive strings can't run into each other
+  AddValue(str.size());
+  AddData(str.constData(), static_cast<size_t>(str.size()) * sizeof(QChar));
+}
+
+QByteArray FrameHasher::Result() const
+{
+  uint64_t h1 = h1_;
+  uint64_t h2 = h2_;
+
+  uint64_t k1 = 0;
+  uint64_t k2 = 0;
+
+  // Mix in the remaining bytes
+  for (size_t i=tail_length_;i>8;i--) {
+    k2 ^= static_cast<uint64_t>(tail_[i-1]) << ((i - 9) * 8);
+  }
+
+  if (tail_length_ > 8) {
+    k2 *= kC2;
+    k2 = RotateLeft(k2, 33);
+    k2 *= kC1;
+    h2 ^= k2;
+  }
+
+  for (size_t i=qMin(tail_length_, static_cast<size_t>(8));i>0;i--) {
+    k1 ^= static_cast<uint64_t>(tail_[i-1]) << ((i - 1) * 8);
+  }
+
+  if (tail_length_ > 0) {
+    k1 *= kC1;
+    k1 = RotateLeft(k1, 31);
+    k1 *= kC2;
+    h1 ^= k1;
+  }
+
+  // Finalize
+  h1 ^= total_length_;
+  h2 ^= total_length_;
+
+  h1 += h2;
+  h2 += h1;
+
+  h1 = FinalMix(h1);
+  h2 = FinalMix(h2);
+
+  h1 += h2;
+  h2 += h1;
+
+  QByteArray result(kBlockSize, Qt::Uninitialized);
+  memcpy(result.data(), &h1, sizeof(uint64_t));
+  memcpy(result.data() + sizeof(uint64_t), &h2, sizeof(uint64_t));
+
+  return result;
+}
+
+void FrameHasher::ProcessBlock(const uchar *block)
+{
+  uint64_t k1;
+  uint64_t k2;
+
+  memcpy(&k1, block, sizeof(uint64_t));
+  memcpy(&k2, block + sizeof(uint64_t), sizeof(uint64_t));
+
+  k1 *= kC1;
+  k1 = RotateLeft(k1, 31);
+  k1 *= kC2;
+  h1_ ^= k1;
+
+  h1_ = RotateLeft(h1_, 27);
+  h1_ += h2_;
+  h1_ = h1_ * 5 + 0x52dce729;
+
+  k2 *= kC2;
+  k2 = RotateLeft(k2, 33);
+  k2 *= kC1;
+  h2_ ^= k2;
+
+  h2_ = RotateLeft(h2_, 31);
+  h2_ += h1_;
+  h2_ = h2_ * 5 + 0x38495ab5;
+}
+
+uint64_t FrameHasher::RotateLeft(const uint64_t &x, const int &r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+uint64_t FrameHasher::FinalMix(uint64_t k)
+{
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ULL;
+  k ^= k >> 33;
+
+  return k;
+}
@@ -0,0 +1,77 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#ifndef FRAMEHASHER_H
+#define FRAMEHASHER_H
+
+#include <QByteArray>
+#include <QString>
+#include <stdint.h>
+
+/**
+ * @brief A fast, non-cryptographic 128-bit hash used to identify rendered frames
+ *
+ * Frame hashes are calculated for every frame that's cached, so they need to be cheap rather than secure. This is a
+ * streaming implementation of MurmurHash3 (x64, 128-bit). Values should be fed in their binary form with AddValue()
+ * rather than formatted into strings.
+ */
+class FrameHasher
+{
+public:
+  FrameHasher(const uint64_t& seed = 0);
+
+  void AddData(const void* data, const size_t& length);
+
+  void AddData(const QByteArray& data);
+
+  void AddData(const QString& str);
+
+  template<typename T>
+  void AddValue(const T& value)
+  {
+    AddData(&value, sizeof(T));
+  }
+
+  /**
+   * @brief Returns the 16-byte hash of all data added so far
+   */
+  QByteArray Result() const;
+
+private:
+  void ProcessBlock(const uchar* block);
+
+  static uint64_t RotateLeft(const uint64_t& x, const int& r);
+
+  static uint64_t FinalMix(uint64_t k);
+
+  static const int kBlockSize = 16;
+
+  uint64_t h1_;
+  uint64_t h2_;
+
+  uchar tail_[kBlockSize];
+  size_t tail_length_;
+
+  uint64_t total_length_;
+
+};
+
+#endif // FRAMEHASHER_H
@@ -0,0 +1,579 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "framesegmentstore.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QSet>
+#include <QThreadPool>
+#include <QtEndian>
+
+#include "render/diskcachemanager.h"
+
+const qint64 FrameSegmentStore::kSegmentSize = Q_INT64_C(512) * 1024 * 1024;
+const qint64 FrameSegmentStore::kCompactSize = Q_INT64_C(64) * 1024 * 1024;
+
+QMutex FrameSegmentStore::stores_lock_;
+QHash<QString, std::weak_ptr<FrameSegmentStore> > FrameSegmentStore::stores_;
+
+class FrameSegmentStore::CompactTask : public QRunnable
+{
+public:
+  CompactTask(FrameSegmentStorePtr store) :
+    store_(store)
+  {
+  }
+
+  virtual void run() override
+  {
+    store_->Compact();
+  }
+
+private:
+  FrameSegmentStorePtr store_;
+
+};
+
+namespace {
+
+/**
+ * @brief Size of an index entry before its key: the key's size, then the frame's offset and length in the segment
+ */
+const int kIndexEntryHeaderSize = 2 + 8 + 8;
+
+QByteArray IndexEntry(const QByteArray& key, qint64 offset, qint64 length)
+{
+  QByteArray entry(kIndexEntryHeaderSize + key.size(), Qt::Uninitialized);
+  uchar* data = reinterpret_cast<uchar*>(entry.data());
+
+  qToLittleEndian<quint16>(static_cast<quint16>(key.size()), data);
+  qToLittleEndian<qint64>(offset, data + 2);
+  qToLittleEndian<qint64>(length, data + 10);
+  memcpy(data + kIndexEntryHeaderSize, key.constData(), static_cast<size_t>(key.size()));
+
+  return entry;
+}
+
+}
+
+FrameSegmentStorePtr FrameSegmentStore::Open(const QString &dir)
+{
+  stores_lock_.lock();
+
+  FrameSegmentStorePtr store = stores_.value(dir).lock();
+  bool created = false;
+
+  if (store == nullptr) {
+    store = FrameSegmentStorePtr(new FrameSegmentStore(dir));
+    stores_.insert(dir, store);
+    created = true;
+  }
+
+  stores_lock_.unlock();
+
+  if (created) {
+    QThreadPool::globalInstance()->start(new CompactTask(store));
+  }
+
+  return store;
+}
+
+FrameSegmentStore::FrameSegmentStore(const QString &dir) :
+  dir_(dir),
+  current_(-1)
+{
+  QDir().mkpath(dir_);
+
+  lock_.lock();
+  Refresh();
+  lock_.unlock();
+}
+
+FrameSegmentStore::~FrameSegmentStore()
+{
+  write_lock_.lock();
+  FinishSegment();
+  write_lock_.unlock();
+}
+
+const QString &FrameSegmentStore::dir() const
+{
+  return dir_;
+}
+
+bool FrameSegmentStore::Contains(const QByteArray &key)
+{
+  lock_.lock();
+
+  // Another process may have written it since we last looked
+  if (!index_.contains(key) && (!last_refresh_.isValid() || last_refresh_.elapsed() >= kRefreshInterval)) {
+    Refresh();
+  }
+
+  QHash<QByteArray, Location>::const_iterator i = index_.constFind(key);
+  bool found = (i != index_.constEnd());
+  QString segment_fn;
+
+  if (found) {
+    segment_fn = SegmentFilename(segments_.at(i.value().segment).name);
+  }
+
+  lock_.unlock();
+
+  if (found) {
+    // This frame is about to be re-used instead of rendered
+    DiskCacheManager::instance()->FileAccessed(segment_fn);
+  }
+
+  return found;
+}
+
+bool FrameSegmentStore::Append(const QByteArray &key, const QByteArray &data)
+{
+  write_lock_.lock();
+
+  lock_.lock();
+  bool exists = index_.contains(key);
+  lock_.unlock();
+
+  bool result = exists || AppendToSegment(key, data);
+
+  write_lock_.unlock();
+
+  return result;
+}
+
+QByteArray FrameSegmentStore::Read(const QByteArray &key)
+{
+  lock_.lock();
+
+  QHash<QByteArray, Location>::const_iterator i = index_.constFind(key);
+
+  if (i == index_.constEnd()) {
+    lock_.unlock();
+    return QByteArray();
+  }
+
+  Location location = i.value();
+  QString segment_fn = SegmentFilename(segments_.at(location.segment).name);
+  MappingPtr mapping = MapSegment(location.segment, location.offset + location.length);
+
+  if (mapping == nullptr && !QFileInfo::exists(segment_fn)) {
+    // Evicted since, so every other frame in it has gone too
+    RemoveSegment(location.segment);
+  }
+
+  lock_.unlock();
+
+  if (mapping == nullptr) {
+    return QByteArray();
+  }
+
+  DiskCacheManager::instance()->FileAccessed(segment_fn);
+
+  // The mapping stays valid for as long as we hold it, even if it's replaced or the segment is removed meanwhile
+  return QByteArray(mapping->data + location.offset, static_cast<int>(location.length));
+}
+
+QString FrameSegmentStore::SegmentFilenameOf(const QByteArray &key)
+{
+  QString segment_fn;
+
+  lock_.lock();
+
+  QHash<QByteArray, Location>::const_iterator i = index_.constFind(key);
+
+  if (i != index_.constEnd()) {
+    segment_fn = SegmentFilename(segments_.at(i.value().segment).name);
+  }
+
+  lock_.unlock();
+
+  return segment_fn;
+}
+
+void FrameSegmentStore::Compact()
+{
+  QVector<int> candidates;
+
+  lock_.lock();
+
+  Refresh();
+
+  for (int i=0;i<segments_.size();i++) {
+    const Segment& s = segments_.at(i);
+
+    if (!s.own && !s.removed && QFileInfo(SegmentFilename(s.name)).size() < kCompactSize) {
+      candidates.append(i);
+    }
+  }
+
+  lock_.unlock();
+
+  foreach (int segment, candidates) {
+    lock_.lock();
+    QString name = segments_.at(segment).name;
+    lock_.unlock();
+
+    // Still being appended to by the process that created it
+    QLockFile segment_lock(LockFilename(name));
+    segment_lock.setStaleLockTime(0);
+
+    if (!segment_lock.tryLock(0)) {
+      continue;
+    }
+
+    // Nobody can append to it now, so once its index is read again we know every frame in it
+    QVector<QByteArray> keys;
+
+    lock_.lock();
+
+    ReadIndex(segment);
+
+    for (QHash<QByteArray, Location>::const_iterator i=index_.constBegin();i!=index_.constEnd();i++) {
+      if (i.value().segment == segment) {
+        keys.append(i.key());
+      }
+    }
+
+    lock_.unlock();
+
+    bool moved = true;
+
+    foreach (const QByteArray& key, keys) {
+      QByteArray data = Read(key);
+
+      if (data.isEmpty()) {
+        // Evicted meanwhile
+        continue;
+      }
+
+      write_lock_.lock();
+      moved = AppendToSegment(key, data);
+      write_lock_.unlock();
+
+      if (!moved) {
+        break;
+      }
+    }
+
+    if (moved) {
+      lock_.lock();
+      RemoveSegment(segment);
+      lock_.unlock();
+
+      QFile::remove(SegmentFilename(name));
+      QFile::remove(IndexFilename(name));
+    }
+  }
+
+  // Segments whose index has gone can't be read, and indexes whose segment has gone are of no use
+  QDir dir(dir_);
+  QSet<QString> segment_names, index_names;
+
+  foreach (const QString& fn, dir.entryList(QStringList(QStringLiteral("*.seg")), QDir::Files)) {
+    segment_names.insert(QFileInfo(fn).completeBaseName());
+  }
+
+  foreach (const QString& fn, dir.entryList(QStringList(QStringLiteral("*.idx")), QDir::Files)) {
+    index_names.insert(QFileInfo(fn).completeBaseName());
+  }
+
+  QSet<QString> orphans = (segment_names - index_names) + (index_names - segment_names);
+
+  foreach (const QString& name, orphans) {
+    QLockFile segment_lock(LockFilename(name));
+    segment_lock.setStaleLockTime(0);
+
+    if (segment_lock.tryLock(0)) {
+      QFile::remove(SegmentFilename(name));
+      QFile::remove(IndexFilename(name));
+    }
+  }
+}
+
+QString FrameSegmentStore::SegmentFilename(const QString &name) const
+{
+  return QDir(dir_).filePath(name + QStringLiteral(".seg"));
+}
+
+QString FrameSegmentStore::IndexFilename(const QString &name) const
+{
+  return QDir(dir_).filePath(name + QStringLiteral(".idx"));
+}
+
+QString FrameSegmentStore::LockFilename(const QString &name) const
+{
+  return QDir(dir_).filePath(name + QStringLiteral(".lock"));
+}
+
+void FrameSegmentStore::Refresh()
+{
+  QHash<QString, int> known;
+
+  for (int i=0;i<segments_.size();i++) {
+    if (segments_.at(i).removed) {
+      continue;
+    }
+
+    if (!QFileInfo::exists(SegmentFilename(segments_.at(i).name))) {
+      RemoveSegment(i);
+      continue;
+    }
+
+    known.insert(segments_.at(i).name, i);
+
+    ReadIndex(i);
+  }
+
+  QStringList index_files = QDir(dir_).entryList(QStringList(QStringLiteral("*.idx")), QDir::Files);
+
+  foreach (const QString& fn, index_files) {
+    QString name = QFileInfo(fn).completeBaseName();
+
+    if (known.contains(name) || !QFileInfo::exists(SegmentFilename(name))) {
+      continue;
+    }
+
+    Segment s;
+    s.name = name;
+    s.index_read = 0;
+    s.removed = false;
+    s.own = false;
+    segments_.append(s);
+
+    ReadIndex(segments_.size() - 1);
+  }
+
+  last_refresh_.start();
+}
+
+void FrameSegmentStore::ReadIndex(int segment)
+{
+  Segment& s = segments_[segment];
+
+  // We know what's in our own segments already
+  if (s.own || s.removed) {
+    return;
+  }
+
+  QFile file(IndexFilename(s.name));
+
+  if (!file.open(QFile::ReadOnly) || !file.seek(s.index_read)) {
+    return;
+  }
+
+  QByteArray entries = file.readAll();
+
+  file.close();
+
+  const uchar* data = reinterpret_cast<const uchar*>(entries.constData());
+  int pos = 0;
+
+  // The last entry may still be being written, in which case it's read next time
+  while (entries.size() - pos >= kIndexEntryHeaderSize) {
+    int key_size = qFromLittleEndian<quint16>(data + pos);
+
+    if (entries.size() - pos < kIndexEntryHeaderSize + key_size) {
+      break;
+    }
+
+    QByteArray key(entries.constData() + pos + kIndexEntryHeaderSize, key_size);
+
+    Location location;
+    location.segment = segment;
+    location.offset = qFromLittleEndian<qint64>(data + pos + 2);
+    location.length = qFromLittleEndian<qint64>(data + pos + 10);
+
+    // A frame in more than one segment is only read from the first we found it in, Compact() drops the others
+    if (!index_.contains(key)) {
+      index_.insert(key, location);
+    }
+
+    pos += kIndexEntryHeaderSize + key_size;
+  }
+
+  s.index_read += pos;
+}
+
+void FrameSegmentStore::RemoveSegment(int segment)
+{
+  segments_[segment].removed = true;
+  segments_[segment].mapping.reset();
+
+  QHash<QByteArray, Location>::iterator i = index_.begin();
+
+  while (i != index_.end()) {
+    if (i.value().segment == segment) {
+      i = index_.erase(i);
+    } else {
+      i++;
+    }
+  }
+}
+
+FrameSegmentStore::MappingPtr FrameSegmentStore::MapSegment(int segment, qint64 end)
+{
+  Segment& s = segments_[segment];
+
+  if (s.removed) {
+    return nullptr;
+  }
+
+  if (s.mapping != nullptr && s.mapping->size >= end) {
+    return s.mapping;
+  }
+
+  // Segments are appended to, so one mapped before this frame was written doesn't reach it
+  MappingPtr mapping = std::make_shared<Mapping>();
+  QFile& file = mapping->file;
+
+  file.setFileName(SegmentFilename(s.name));
+
+  if (!file.open(QFile::ReadOnly) || file.size() < end) {
+    return nullptr;
+  }
+
+  mapping->use.Acquire(file.fileName());
+
+  mapping->size = file.size();
+  mapping->data = reinterpret_cast<const char*>(file.map(0, mapping->size));
+
+  if (mapping->data == nullptr) {
+    qWarning() << "Failed to map frame cache segment" << file.fileName();
+    return nullptr;
+  }
+
+  s.mapping = mapping;
+
+  return mapping;
+}
+
+bool FrameSegmentStore::StartSegment()
+{
+  qint64 pid = QCoreApplication::applicationPid();
+
+  for (int i=0;i<1000;i++) {
+    QString name = QStringLiteral("%1-%2").arg(QString::number(pid), QString::number(i));
+
+    // Left behind by an earlier process with the same ID
+    if (QFileInfo::exists(SegmentFilename(name)) || QFileInfo::exists(IndexFilename(name))) {
+      continue;
+    }
+
+    std::unique_ptr<QLockFile> segment_lock(new QLockFile(LockFilename(name)));
+    segment_lock->setStaleLockTime(0);
+
+    if (!segment_lock->tryLock(0)) {
+      continue;
+    }
+
+    current_file_.setFileName(SegmentFilename(name));
+    current_index_.setFileName(IndexFilename(name));
+
+    if (!current_file_.open(QFile::WriteOnly) || !current_index_.open(QFile::WriteOnly)) {
+      qWarning() << "Failed to create frame cache segment" << current_file_.fileName();
+      current_file_.close();
+      current_index_.close();
+      return false;
+    }
+
+    current_lock_ = std::move(segment_lock);
+
+    Segment s;
+    s.name = name;
+    s.index_read = 0;
+    s.removed = false;
+    s.own = true;
+
+    lock_.lock();
+    segments_.append(s);
+    current_ = segments_.size() - 1;
+    lock_.unlock();
+
+    return true;
+  }
+
+  qWarning() << "Failed to find a name for a new frame cache segment in" << dir_;
+
+  return false;
+}
+
+void FrameSegmentStore::FinishSegment()
+{
+  if (current_ < 0) {
+    return;
+  }
+
+  current_file_.close();
+  current_index_.close();
+
+  // Let other processes compact it
+  current_lock_.reset();
+
+  current_ = -1;
+}
+
+bool FrameSegmentStore::AppendToSegment(const QByteArray &key, const QByteArray &data)
+{
+  // Start a new segment once this one's big enough, or if it's been evicted from under us
+  if (current_ >= 0
+      && (current_file_.size() + data.size() > kSegmentSize || !QFileInfo::exists(current_file_.fileName()))) {
+    FinishSegment();
+  }
+
+  if (current_ < 0 && !StartSegment()) {
+    return false;
+  }
+
+  qint64 offset = current_file_.size();
+
+  // The frame is written before its index entry, so other processes never find a frame that isn't all there
+  if (current_file_.write(data) != data.size() || !current_file_.flush()) {
+    qWarning() << "Failed to write to frame cache segment" << current_file_.fileName();
+    FinishSegment();
+    return false;
+  }
+
+  QByteArray entry = IndexEntry(key, offset, data.size());
+
+  if (current_index_.write(entry) != entry.size() || !current_index_.flush()) {
+    qWarning() << "Failed to write to frame cache segment index" << current_index_.fileName();
+    FinishSegment();
+    return false;
+  }
+
+  Location location;
+  location.segment = current_;
+  location.offset = offset;
+  location.length = data.size();
+
+  lock_.lock();
+  index_.insert(key, location);
+  lock_.unlock();
+
+  DiskCacheManager::instance()->FileWritten(current_file_.fileName());
+
+  return true;
+}
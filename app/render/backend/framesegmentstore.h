@@ -0,0 +1,226 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FRAMESEGMENTSTORE_H
+#define FRAMESEGMENTSTORE_H
+
+#include <memory>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QLockFile>
+#include <QMutex>
+#include <QVector>
+
+#include "common/constructors.h"
+#include "render/diskcachemanager.h"
+
+class FrameSegmentStore;
+using FrameSegmentStorePtr = std::shared_ptr<FrameSegmentStore>;
+
+/**
+ * @brief Keeps the encoded frames of a frame store many to a file rather than one file per frame
+ *
+ * Hours of cached timeline would otherwise be hundreds of thousands of small files, which are slow to create and look
+ * up on NTFS and network filesystems and cost an open and close per frame. Frames are appended to segment files
+ * (`.seg`) instead, each with an index file (`.idx`) next to it that maps every frame's key to where it is in the
+ * segment. Segments are read through a memory mapping that's shared by every read, so reading a frame is a copy.
+ *
+ * Only the process that created a segment ever appends to it, holding its `.lock` while it does, so any number of
+ * processes (e.g. render farm workers, see FarmProcessPool) can share a folder. Frames other processes write are found
+ * by reading the index files again, at most every kRefreshInterval when a frame is missing.
+ *
+ * Segments are evicted from the disk cache as a whole (see DiskCacheManager). Once they're no longer written to, small
+ * segments are merged into the current one in the background (see Compact()), so a folder doesn't fill up with a
+ * segment per session, and anything left unreadable (e.g. a segment whose index was lost) is removed.
+ *
+ * Every function is thread-safe.
+ */
+class FrameSegmentStore
+{
+public:
+  /**
+   * @brief Get the store for this folder, there's only ever one per folder in a process
+   *
+   * The first time a folder is opened, its small segments are compacted in the background.
+   */
+  static FrameSegmentStorePtr Open(const QString& dir);
+
+  ~FrameSegmentStore();
+
+  DISABLE_COPY_MOVE(FrameSegmentStore)
+
+  const QString& dir() const;
+
+  /**
+   * @brief Returns whether there's a frame with this key, and marks its segment as used if so
+   */
+  bool Contains(const QByteArray& key);
+
+  /**
+   * @brief Append a frame, unless there's already one with this key
+   *
+   * @return
+   *
+   * FALSE if it couldn't be written.
+   */
+  bool Append(const QByteArray& key, const QByteArray& data);
+
+  /**
+   * @brief Read a frame's data, or an empty QByteArray if there's no frame with this key (or it's been evicted)
+   */
+  QByteArray Read(const QByteArray& key);
+
+  /**
+   * @brief Filename of the segment the frame with this key is in, or an empty string if there's no such frame
+   */
+  QString SegmentFilenameOf(const QByteArray& key);
+
+  /**
+   * @brief Merge segments no process is writing to anymore that are smaller than kCompactSize into the current one
+   *
+   * Removes segments that can't be read too. Slow, runs on the global thread pool after Open().
+   */
+  void Compact();
+
+private:
+  FrameSegmentStore(const QString& dir);
+
+  class CompactTask;
+
+  struct Mapping {
+    QFile file;
+    DiskCacheManager::FileUse use;
+    const char* data;
+    qint64 size;
+  };
+
+  using MappingPtr = std::shared_ptr<Mapping>;
+
+  struct Segment {
+    QString name;
+
+    /// Bytes of the index file already read into index_
+    qint64 index_read;
+
+    MappingPtr mapping;
+
+    /// Set once the segment has gone (e.g. evicted), its frames are no longer in index_
+    bool removed;
+
+    /// Created by this process, which knows what's in it without reading its index
+    bool own;
+  };
+
+  struct Location {
+    int segment;
+    qint64 offset;
+    qint64 length;
+  };
+
+  QString SegmentFilename(const QString& name) const;
+  QString IndexFilename(const QString& name) const;
+  QString LockFilename(const QString& name) const;
+
+  /**
+   * @brief Read every index file again for segments and frames this process doesn't know about yet (lock_ held)
+   */
+  void Refresh();
+
+  /**
+   * @brief Read what's been added to a segment's index file since it was last read (lock_ held)
+   */
+  void ReadIndex(int segment);
+
+  /**
+   * @brief Forget a segment and every frame in it (lock_ held)
+   */
+  void RemoveSegment(int segment);
+
+  /**
+   * @brief The segment's mapping, mapped again if it doesn't reach `end` yet (lock_ held)
+   */
+  MappingPtr MapSegment(int segment, qint64 end);
+
+  /**
+   * @brief Start a new segment to append to (write_lock_ held)
+   */
+  bool StartSegment();
+
+  /**
+   * @brief Stop appending to the current segment (write_lock_ held)
+   */
+  void FinishSegment();
+
+  /**
+   * @brief Append a frame to the current segment and point `key` at it (write_lock_ held)
+   */
+  bool AppendToSegment(const QByteArray& key, const QByteArray& data);
+
+  /**
+   * @brief Segments are started afresh once they're bigger than this
+   */
+  static const qint64 kSegmentSize;
+
+  /**
+   * @brief Segments smaller than this are merged into others by Compact()
+   */
+  static const qint64 kCompactSize;
+
+  /**
+   * @brief Milliseconds between reading the index files again for a frame that's missing
+   */
+  static const int kRefreshInterval = 1000;
+
+  static QMutex stores_lock_;
+  static QHash<QString, std::weak_ptr<FrameSegmentStore> > stores_;
+
+  QString dir_;
+
+  /**
+   * @brief Protects segments_, index_ and last_refresh_
+   */
+  QMutex lock_;
+
+  QVector<Segment> segments_;
+
+  QHash<QByteArray, Location> index_;
+
+  QElapsedTimer last_refresh_;
+
+  /**
+   * @brief Serializes appending, and protects everything below
+   */
+  QMutex write_lock_;
+
+  /**
+   * @brief Index in segments_ of the segment this process appends to, or -1 if there isn't one yet
+   */
+  int current_;
+
+  std::unique_ptr<QLockFile> current_lock_;
+
+  QFile current_file_;
+
+  QFile current_index_;
+
+};
+
+#endif // FRAMESEGMENTSTORE_H
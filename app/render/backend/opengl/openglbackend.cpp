@@ -1,13 +1,26 @@
 #include "openglbackend.h"
 
 #include <QEventLoop>
+#include <QGuiApplication>
+#include <QOpenGLFunctions>
+#include <QScreen>
 #include <QThread>
 
+#include "common/metrics.h"
+#include "common/tracer.h"
+#include "config/config.h"
 #include "functions.h"
+#include "openglmemorybudget.h"
+#include "render/pixelservice.h"
+#include "render/renderbudget.h"
+
+bool OpenGLBackend::software_rendering_ = false;
 
 OpenGLBackend::OpenGLBackend(QObject *parent) :
   VideoRenderBackend(parent)
 {
+  link_timer_.setInterval(kLinkPollInterval);
+  connect(&link_timer_, SIGNAL(timeout()), this, SLOT(PollPendingPrograms()));
 }
 
 OpenGLBackend::~OpenGLBackend()
@@ -21,6 +34,18 @@ bool OpenGLBackend::InitInternal()
     return false;
   }
 
+  if (software_rendering_) {
+    // There are no devices, every worker counts as being on the first so siblings and the viewer work the same way
+    for (int i=0;i<threads().size();i++) {
+      SoftwareWorker* processor = new SoftwareWorker(decoder_cache(), frame_cache(), frame_writer());
+      processor->SetParameters(params());
+      processors_.append(processor);
+      worker_devices_.append(0);
+    }
+
+    return true;
+  }
+
   QOpenGLContext* share_ctx = QOpenGLContext::currentContext();
 
   if (share_ctx == nullptr) {
@@ -28,39 +53,229 @@ bool OpenGLBackend::InitInternal()
     return false;
   }
 
-  // Initiate one thread per CPU core
-  for (int i=0;i<threads().size();i++) {
+  Device viewer_device;
+  viewer_device.context = share_ctx;
+  viewer_device.surface = nullptr;
+  viewer_device.shader_cache = new OpenGLShaderCache();
+  devices_.append(viewer_device);
+
+  CreateExtraDevices(share_ctx);
+
+  // Drivers that can compile on threads of their own are told they can use as many as they like
+  foreach (const Device& device, devices_) {
+    QOpenGLContext* previous = MakeDeviceCurrent(device);
+
+    OpenGLShader::EnableParallelCompile();
+
+    RestoreContext(device, previous);
+  }
+
+  // One worker per thread, spread over the devices. The last worker is the one kept for interactive frames (see
+  // ReservesInteractiveWorker()), so it's always on the viewer's device where its frames can be shown straight away.
+  int worker_count = threads().size();
+
+  for (int i=0;i<worker_count;i++) {
+    int device_index = (worker_count - 1 - i) % devices_.size();
+    const Device& device = devices_.at(device_index);
+
     // Create one processor object for each thread
-    OpenGLWorker* processor = new OpenGLWorker(share_ctx, &shader_cache_, decoder_cache(), frame_cache());
+    OpenGLWorker* processor = new OpenGLWorker(device.context, device.shader_cache, decoder_cache(), frame_cache(), frame_writer());
     processor->SetParameters(params());
+    processor->SetTileSize(Config::Current()["RenderTileSize"].toInt());
     processors_.append(processor);
+    worker_devices_.append(device_index);
   }
 
-  // Create master texture (the one sent to the viewer)
+  // Create master texture (the one sent to the viewer). It's double buffered so the next frame can upload while the
+  // viewer is still drawing the last one.
   master_texture_ = std::make_shared<OpenGLTexture>();
-  master_texture_->Create(share_ctx, params().effective_width(), params().effective_height(), params().format());
+  master_texture_->Create(share_ctx,
+                          params().effective_width(),
+                          params().effective_height(),
+                          params().format(),
+                          OpenGLTexture::kDoubleBuffer);
+
+  master_uploads_.Create(share_ctx);
 
   return true;
 }
 
+void OpenGLBackend::SetSoftwareRendering(bool e)
+{
+  software_rendering_ = e;
+}
+
+bool OpenGLBackend::SoftwareRendering()
+{
+  return software_rendering_;
+}
+
+int OpenGLBackend::MaximumWorkerCount() const
+{
+  if (software_rendering_) {
+    return VideoRenderBackend::MaximumWorkerCount();
+  }
+
+  qint64 frame_size = PixelService::GetBufferSize(params().format(), params().effective_width(), params().effective_height());
+
+  return OpenGLMemoryBudget::FitWorkerCount(RenderBudget::GPUContextCount(), frame_size * kTexturesPerWorker);
+}
+
 void OpenGLBackend::CloseInternal()
 {
+  // Workers may be waiting on these, and they need the devices to finish
+  FinishPendingPrograms(true);
+
   Decompile();
 
+  // Shaders outlive a decompile, but not the backend
+  foreach (const Device& device, devices_) {
+    QOpenGLContext* previous = MakeDeviceCurrent(device);
+
+    device.shader_cache->Clear();
+    delete device.shader_cache;
+
+    RestoreContext(device, previous);
+
+    if (device.surface != nullptr) {
+      delete device.context;
+      delete device.surface;
+    }
+  }
+
+  master_uploads_.Destroy();
+
+  devices_.clear();
+  worker_devices_.clear();
+
   master_texture_ = nullptr;
+  compressed_master_texture_ = nullptr;
+}
+
+bool OpenGLBackend::CanRunSibling(RenderWorker *requester, RenderWorker *worker) const
+{
+  return DeviceOf(requester) == DeviceOf(worker);
 }
 
-OpenGLTexturePtr OpenGLBackend::GetCachedFrameAsTexture(const rational &time)
+void OpenGLBackend::CreateExtraDevices(QOpenGLContext *viewer_context)
 {
-  const char* cached_frame = GetCachedFrame(time);
+  QStringList screen_names = Config::Current()["RenderGPUScreens"].toString().split(',', QString::SkipEmptyParts);
+
+  foreach (QString name, screen_names) {
+    name = name.trimmed();
+
+    QScreen* screen = nullptr;
+
+    foreach (QScreen* s, QGuiApplication::screens()) {
+      if (s->name() == name) {
+        screen = s;
+        break;
+      }
+    }
 
-  if (cached_frame != nullptr) {
-    master_texture_->Upload(cached_frame);
+    if (screen == nullptr) {
+      qWarning() << "No screen called" << name << "to render on";
+      continue;
+    }
+
+    if (screen == viewer_context->screen()) {
+      // The viewer's device already renders
+      continue;
+    }
 
-    return master_texture_;
+    Device device;
+
+    device.surface = new QOffscreenSurface(screen);
+    device.surface->create();
+
+    device.context = new QOpenGLContext();
+    device.context->setScreen(screen);
+    device.context->setFormat(viewer_context->format());
+
+    if (!device.context->create()) {
+      qWarning() << "Failed to create an OpenGL context on" << name;
+      delete device.context;
+      delete device.surface;
+      continue;
+    }
+
+    device.shader_cache = new OpenGLShaderCache();
+
+    devices_.append(device);
   }
+}
 
-  return nullptr;
+QOpenGLContext *OpenGLBackend::MakeDeviceCurrent(const OpenGLBackend::Device &device)
+{
+  QOpenGLContext* previous = QOpenGLContext::currentContext();
+
+  if (device.surface != nullptr) {
+    device.context->makeCurrent(device.surface);
+  }
+
+  return previous;
+}
+
+void OpenGLBackend::RestoreContext(const OpenGLBackend::Device &device, QOpenGLContext *previous)
+{
+  if (device.surface == nullptr) {
+    return;
+  }
+
+  if (previous != nullptr) {
+    previous->makeCurrent(previous->surface());
+  } else {
+    device.context->doneCurrent();
+  }
+}
+
+bool OpenGLBackend::ValueHasTexture(const QVariant &value)
+{
+  return value.value<OpenGLTexturePtr>() != nullptr || value.value<SoftwareTexturePtr>() != nullptr;
+}
+
+int OpenGLBackend::DeviceOf(RenderWorker *worker) const
+{
+  int index = processors_.indexOf(worker);
+
+  return (index < 0) ? 0 : worker_devices_.at(index);
+}
+
+void OpenGLBackend::CachedFrameLoadedEvent(const rational &time, const QByteArray &frame, bool compressed)
+{
+  if (frame.isEmpty() || master_texture_ == nullptr) {
+    emit CachedFrameReady(time, QVariant::fromValue(OpenGLTexturePtr()));
+    return;
+  }
+
+  if (compressed) {
+    if (compressed_master_texture_ == nullptr) {
+      compressed_master_texture_ = std::make_shared<OpenGLTexture>();
+      compressed_master_texture_->CreateCompressed(master_texture_->context(),
+                                                   master_texture_->width(),
+                                                   master_texture_->height(),
+                                                   master_texture_->format());
+    }
+
+    compressed_master_texture_->UploadCompressed(frame);
+
+    emit CachedFrameReady(time, QVariant::fromValue(compressed_master_texture_));
+    return;
+  }
+
+  // Only the memcpy into the unpack buffer happens here, the copy to the GPU is asynchronous. It goes into the back
+  // texture, so the frame the viewer is drawing isn't waited on.
+  memcpy(master_uploads_.Map(frame.size()), frame.constData(), static_cast<size_t>(frame.size()));
+  master_uploads_.Unmap();
+
+  master_texture_->SwapFrontAndBack();
+
+  // With an unpack buffer bound, this is an offset into it rather than a pointer
+  master_texture_->Upload(nullptr);
+
+  master_uploads_.Release();
+
+  emit CachedFrameReady(time, QVariant::fromValue(master_texture_));
 }
 
 bool OpenGLBackend::CompileInternal()
@@ -74,119 +289,610 @@ bool OpenGLBackend::CompileInternal()
 
   QList<Node*> nodes = viewer_node()->GetDependencies();
 
+  for (int i=0;i<devices_.size();i++) {
+    QOpenGLContext* previous = MakeDeviceCurrent(devices_.at(i));
+
+    bool compiled = CompileForDevice(i, nodes);
+
+    RestoreContext(devices_.at(i), previous);
+
+    if (!compiled) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool OpenGLBackend::CompileForDevice(int device_index, const QList<Node *> &nodes)
+{
+  OpenGLShaderCache* shader_cache = devices_.at(device_index).shader_cache;
+
   foreach (Node* n, nodes) {
-    // Check if we have a shader or not
-    if (!shader_cache_.HasShader(n))  {
+    QString node_code = n->Code();
+
+    // Nodes without a fragment shader may have a compute shader instead
+    bool is_compute = node_code.isEmpty();
+
+    if (is_compute) {
+      node_code = n->ComputeCode();
+    }
+
+    // Check if we have a shader or not (shaders are kept across recompiles as long as the code is the same)
+    if (!shader_cache->HasShader(n, node_code))  {
       // Since we don't have a shader, compile one now
-      QString node_code = n->Code();
 
       // If the node has no code, it mustn't be GPU accelerated
       if (node_code.isEmpty()) {
         // We enter a null shader so we don't try to compile this again
-        shader_cache_.AddShader(n, nullptr);
+        shader_cache->AddShader(n, nullptr, node_code);
+      } else if (is_compute && !ComputeIsSupported()) {
+        // Nothing we can run this on, the node will just output nothing
+        qWarning() << "Compute shaders need OpenGL 4.3, skipping" << n->id();
+        shader_cache->AddShader(n, nullptr, node_code);
       } else {
-        // Since we have shader code, compile it now
-        OpenGLShaderPtr program;
+        // Since we have shader code, start compiling it now
+        InputNames inputs = CollectInputNames(QList<Node*>() << n, false);
+        OpenGLShaderPtr program = is_compute
+            ? CompileComputeShader(device_index, node_code, inputs)
+            : CompileShader(device_index, node_code, inputs);
 
-        if (!(program = std::make_shared<OpenGLShader>())) {
-          SetError(QStringLiteral("Failed to create OpenGL shader object"));
+        if (!program) {
           return false;
         }
 
-        if (!program->create()) {
-          SetError(QStringLiteral("Failed to create OpenGL shader on device"));
-          return false;
-        }
+        shader_cache->AddShader(n, program, node_code);
 
-        if (!program->addShaderFromSourceCode(QOpenGLShader::Fragment, node_code)) {
-          SetError(QStringLiteral("Failed to add OpenGL fragment shader code"));
-          return false;
-        }
+        //qDebug() << "Compiled" <<  connected_output->parent()->id() << "->" << connected_output->id();
+      }
+    }
+  }
 
-        if (!program->addShaderFromSourceCode(QOpenGLShader::Vertex, OpenGLShader::CodeDefaultVertex())) {
-          SetError(QStringLiteral("Failed to add OpenGL vertex shader code"));
-          return false;
-        }
+  return FuseForDevice(device_index, nodes);
+}
 
-        if (!program->link()) {
-          SetError(QStringLiteral("Failed to compile OpenGL shader: %1").arg(program->log()));
-          return false;
-        }
+bool OpenGLBackend::FuseForDevice(int device_index, const QList<Node *> &nodes)
+{
+  Device& device = devices_[device_index];
+  OpenGLShaderCache* shader_cache = device.shader_cache;
 
-        shader_cache_.AddShader(n, program);
+  // Fuse groups of pointwise nodes into one shader pass each
+  shader_cache->ClearFusedPrograms();
 
-        //qDebug() << "Compiled" <<  connected_output->parent()->id() << "->" << connected_output->id();
+  foreach (Node* n, nodes) {
+    if (!NodeIsPointwise(n) || FusedConsumer(n) != nullptr) {
+      // Either this can't be fused, or it'll be part of the group of the node it outputs to
+      continue;
+    }
+
+    QList<Node*> stages;
+    CollectFusedStages(n, &stages);
+
+    // A pointwise node on its own still gets a generated shader if it takes a texture, since that shader can take a
+    // constant (see NodeValue::ConstantTexture()) as a uniform where the node's own Code() would need a texture
+    if (stages.size() < 2 && !NodeTakesTexture(n)) {
+      continue;
+    }
+
+    QString fused_code = GenerateFusedCode(stages);
+    OpenGLShaderPtr program = device.fused_shaders.value(fused_code);
+
+    if (!program) {
+      // Groups with the same code have the same structure, so the locations are the same too
+      program = CompileShader(device_index, fused_code, CollectInputNames(stages, true));
+
+      if (!program) {
+        return false;
       }
+
+      device.fused_shaders.insert(fused_code, program);
     }
+
+    shader_cache->AddFusedProgram(n, program, stages);
   }
 
   return true;
 }
 
+void OpenGLBackend::BypassChangedEvent()
+{
+  if (viewer_node() == nullptr || !viewer_node()->texture_input()->IsConnected()) {
+    return;
+  }
+
+  QList<Node*> nodes = viewer_node()->GetDependencies();
+
+  for (int i=0;i<devices_.size();i++) {
+    QOpenGLContext* previous = MakeDeviceCurrent(devices_.at(i));
+
+    if (!FuseForDevice(i, nodes)) {
+      // Nodes left out of a group just run their own shader instead
+      qWarning() << "Failed to rebuild fused shaders";
+    }
+
+    RestoreContext(devices_.at(i), previous);
+  }
+}
+
 void OpenGLBackend::DecompileInternal()
 {
-  shader_cache_.Clear();
+  // Shaders are keyed by node type rather than instance, so we keep them for the next compile. Fused groups refer to
+  // the nodes themselves though.
+  foreach (const Device& device, devices_) {
+    device.shader_cache->ClearFusedPrograms();
+  }
 }
 
-bool OpenGLBackend::TimeIsCached(const TimeRange &time)
+OpenGLShaderPtr OpenGLBackend::CompileShader(int device_index, const QString &code, const InputNames &inputs)
 {
-  return cache_queue_.contains(time);
+  OpenGLShaderPtr program = std::make_shared<OpenGLShader>();
+
+  // Programs linked in a previous session (or by another device with the same GPU) are loaded without compiling
+  if (!program->StartLinkCached(QVector<OpenGLShader::ShaderSource>()
+                                << OpenGLShader::ShaderSource(QOpenGLShader::Fragment, code)
+                                << OpenGLShader::ShaderSource(QOpenGLShader::Vertex, OpenGLShader::CodeDefaultVertex()))) {
+    SetError(QStringLiteral("Failed to create OpenGL shader on device"));
+    return nullptr;
+  }
+
+  PendingProgram pending = {device_index, program, inputs, false};
+  pending_programs_.append(pending);
+  link_timer_.start();
+
+  return program;
 }
 
-void OpenGLBackend::ThreadCompletedFrame(NodeDependency path, QByteArray hash, NodeValueTable table)
+OpenGLShaderPtr OpenGLBackend::CompileComputeShader(int device_index, const QString &code, const InputNames &inputs)
 {
-  caching_ = false;
+  OpenGLShaderPtr program = std::make_shared<OpenGLShader>();
 
-  QVariant value = table.Get(NodeParam::kTexture);
-  OpenGLTexturePtr texture = value.value<OpenGLTexturePtr>();
+  if (!program->StartLinkCached(QVector<OpenGLShader::ShaderSource>()
+                                << OpenGLShader::ShaderSource(QOpenGLShader::Compute, code))) {
+    SetError(QStringLiteral("Failed to create OpenGL shader on device"));
+    return nullptr;
+  }
 
-  if (!texture) {
-    // No frame received, we set hash to an empty
-    frame_cache()->RemoveHash(path.in(), hash);
-  } else {
-    // Received a texture, let's download it
-    QString cache_fn = frame_cache()->CachePathName(hash);
-
-    // Find an available worker to download this texture
-    foreach (RenderWorker* worker, processors_) {
-      // Check if one is available, but worst case if none of them are available, just queue it on the last worker since
-      // it's the least likely to get work
-      if (worker->IsAvailable() || worker == processors_.last()) {
-        QMetaObject::invokeMethod(worker,
-                                  "Download",
-                                  Q_ARG(NodeDependency, path),
-                                  Q_ARG(QByteArray, hash),
-                                  Q_ARG(QVariant, QVariant::fromValue(texture)),
-                                  Q_ARG(QString, cache_fn));
+  PendingProgram pending = {device_index, program, inputs, true};
+  pending_programs_.append(pending);
+  link_timer_.start();
+
+  return program;
+}
+
+void OpenGLBackend::FinishPendingPrograms(bool wait)
+{
+  bool parallel = true;
+
+  for (int i=0;i<devices_.size() && !pending_programs_.isEmpty();i++) {
+    QOpenGLContext* previous = MakeDeviceCurrent(devices_.at(i));
+
+    QOpenGLContext* current = QOpenGLContext::currentContext();
+
+    if (current == nullptr || !QOpenGLContext::areSharing(current, devices_.at(i).context)) {
+      // Nothing to finish them with (yet), but nothing may wait on them forever either
+      if (wait) {
+        for (int j=0;j<pending_programs_.size();j++) {
+          if (pending_programs_.at(j).device_index == i) {
+            pending_programs_.at(j).shader->SetReady();
+            pending_programs_.removeAt(j);
+            j--;
+          }
+        }
+      }
+
+      RestoreContext(devices_.at(i), previous);
+      continue;
+    }
+
+    parallel = OpenGLShader::ParallelCompileIsSupported();
+
+    for (int j=0;j<pending_programs_.size();j++) {
+      const PendingProgram& pending = pending_programs_.at(j);
+
+      if (pending.device_index != i
+          || (!wait && !pending.shader->LinkIsFinished())) {
+        continue;
+      }
+
+      FinishProgram(pending);
+      pending_programs_.removeAt(j);
+      j--;
+
+      if (!wait && !parallel) {
+        // FinishProgram() waited for the link, leave the next one for the next call
         break;
       }
     }
+
+    RestoreContext(devices_.at(i), previous);
+
+    if (!wait && !parallel) {
+      break;
+    }
   }
 
-  // Set as push texture
-  if (!TimeIsCached(TimeRange(path.in(), path.in()))) {
-    emit CachedFrameReady(path.in(), value);
+  if (pending_programs_.isEmpty()) {
+    link_timer_.stop();
+  }
+}
+
+void OpenGLBackend::FinishProgram(const PendingProgram &pending)
+{
+  Tracer::Scope trace("compile", "FinishProgram");
+
+  OpenGLShaderPtr program = pending.shader;
+
+  if (program->FinishLink()) {
+    if (pending.is_compute) {
+      // The worker needs the work group size to know how many groups cover the output
+      GLint work_group_size[3];
+      QOpenGLContext::currentContext()->functions()->glGetProgramiv(program->programId(),
+                                                                    GL_COMPUTE_WORK_GROUP_SIZE,
+                                                                    work_group_size);
+
+      program->SetComputeWorkGroupSize(work_group_size[0], work_group_size[1]);
+    }
+
+    ResolveInputLocations(program, pending.inputs);
+  } else {
+    // The node will output nothing, same as a node without a shader
+    qWarning() << "Failed to compile OpenGL shader:" << program->log();
   }
 
-  CacheNext();
+  program->SetReady();
 }
 
-void OpenGLBackend::ThreadCompletedDownload(NodeDependency dep, QByteArray hash)
+void OpenGLBackend::PollPendingPrograms()
+{
+  FinishPendingPrograms(false);
+}
+
+bool OpenGLBackend::ComputeIsSupported()
+{
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+
+  if (ctx == nullptr) {
+    return false;
+  }
+
+  if (ctx->isOpenGLES()) {
+    return ctx->format().version() >= qMakePair(3, 1);
+  }
+
+  return ctx->format().version() >= qMakePair(4, 3);
+}
+
+OpenGLBackend::InputNames OpenGLBackend::CollectInputNames(const QList<Node *> &stages, bool fused)
+{
+  InputNames names;
+
+  names.inputs.resize(stages.size());
+  names.constants.resize(stages.size());
+  names.switches.resize(stages.size());
+
+  for (int i=0;i<stages.size();i++) {
+    const QList<NodeParam*>& params = stages.at(i)->parameters();
+
+    names.inputs[i].resize(params.size());
+    names.constants[i].resize(params.size());
+    names.switches[i].resize(params.size());
+
+    for (int j=0;j<params.size();j++) {
+      NodeParam* param = params.at(j);
+
+      if (param->type() == NodeParam::kInput) {
+        NodeInput* input = static_cast<NodeInput*>(param);
+
+        names.inputs[i][j] = fused ? OpenGLShaderCache::FusedUniformName(i, input) : input->id();
+
+        if (fused && input->data_type() == NodeParam::kTexture) {
+          names.constants[i][j] = OpenGLShaderCache::FusedConstantName(i, input);
+          names.switches[i][j] = OpenGLShaderCache::FusedConstantSwitchName(i, input);
+        }
+      }
+    }
+  }
+
+  return names;
+}
+
+void OpenGLBackend::ResolveInputLocations(OpenGLShaderPtr shader, const InputNames &inputs)
+{
+  int stage_count = inputs.inputs.size();
+
+  QVector< QVector<int> > locations(stage_count);
+  QVector< QVector<int> > constant_locations(stage_count);
+  QVector< QVector<int> > switch_locations(stage_count);
+
+  for (int i=0;i<stage_count;i++) {
+    int param_count = inputs.inputs.at(i).size();
+
+    locations[i].fill(-1, param_count);
+    constant_locations[i].fill(-1, param_count);
+    switch_locations[i].fill(-1, param_count);
+
+    for (int j=0;j<param_count;j++) {
+      if (!inputs.inputs.at(i).at(j).isEmpty()) {
+        locations[i][j] = shader->uniformLocation(inputs.inputs.at(i).at(j));
+      }
+
+      if (!inputs.constants.at(i).at(j).isEmpty()) {
+        constant_locations[i][j] = shader->uniformLocation(inputs.constants.at(i).at(j));
+        switch_locations[i][j] = shader->uniformLocation(inputs.switches.at(i).at(j));
+      }
+    }
+  }
+
+  shader->SetInputLocations(locations);
+  shader->SetConstantLocations(constant_locations, switch_locations);
+}
+
+QString OpenGLBackend::GLSLType(NodeInput *input)
+{
+  switch (input->data_type()) {
+  case NodeParam::kInt:
+    return QStringLiteral("int");
+  case NodeParam::kFloat:
+    return QStringLiteral("float");
+  case NodeParam::kVec2:
+    return QStringLiteral("vec2");
+  case NodeParam::kVec3:
+    return QStringLiteral("vec3");
+  case NodeParam::kVec4:
+  case NodeParam::kColor:
+  case NodeParam::kTexture:
+    return QStringLiteral("vec4");
+  case NodeParam::kMatrix:
+    return QStringLiteral("mat4");
+  case NodeParam::kBoolean:
+    return QStringLiteral("bool");
+  default:
+    // Can't be passed to a shader
+    return QString();
+  }
+}
+
+bool OpenGLBackend::NodeIsPointwise(Node *n)
+{
+  if (n->IsBypassed() || n->PointwiseCode().isEmpty()) {
+    return false;
+  }
+
+  foreach (NodeParam* param, n->parameters()) {
+    if (param->type() == NodeParam::kInput) {
+      NodeInput* input = static_cast<NodeInput*>(param);
+
+      if (input->IsArray() || GLSLType(input).isEmpty()) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+bool OpenGLBackend::NodeTakesTexture(Node *n)
 {
-  frame_cache()->SetHash(dep.in(), hash);
+  foreach (NodeParam* param, n->parameters()) {
+    if (param->type() == NodeParam::kInput && static_cast<NodeInput*>(param)->data_type() == NodeParam::kTexture) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+Node *OpenGLBackend::FusedConsumer(Node *n)
+{
+  if (!NodeIsPointwise(n)) {
+    return nullptr;
+  }
+
+  // The node's output can only be fused if nothing else uses it
+  NodeInput* consumer = nullptr;
+  int edge_count = 0;
+
+  foreach (NodeParam* param, n->parameters()) {
+    if (param->type() == NodeParam::kOutput) {
+      foreach (NodeEdgePtr edge, param->edges()) {
+        consumer = edge->input();
+        edge_count++;
+      }
+    }
+  }
+
+  if (edge_count == 1
+      && consumer->data_type() == NodeParam::kTexture
+      && NodeIsPointwise(consumer->parentNode())) {
+    return consumer->parentNode();
+  }
 
-  emit CachedTimeReady(dep.in());
+  return nullptr;
 }
 
-void OpenGLBackend::ThreadSkippedFrame()
+void OpenGLBackend::CollectFusedStages(Node *n, QList<Node *> *stages)
 {
-  caching_ = false;
-  CacheNext();
+  // Every stage comes after the stages it takes input from
+  foreach (NodeParam* param, n->parameters()) {
+    if (param->type() == NodeParam::kInput) {
+      Node* connected = static_cast<NodeInput*>(param)->get_connected_node();
+
+      if (connected != nullptr && FusedConsumer(connected) == n) {
+        CollectFusedStages(connected, stages);
+      }
+    }
+  }
+
+  stages->append(n);
 }
 
-void OpenGLBackend::ThreadHashAlreadyExists(NodeDependency dep, QByteArray hash)
+QString OpenGLBackend::GenerateFusedCode(const QList<Node *> &stages)
 {
-  ThreadCompletedDownload(dep, hash);
+  QString uniforms;
+  QString functions;
+  QString main_body;
+
+  for (int i=0;i<stages.size();i++) {
+    Node* stage = stages.at(i);
 
-  ThreadSkippedFrame();
+    QStringList arguments;
+    QStringList call_arguments;
+
+    foreach (NodeParam* param, stage->parameters()) {
+      if (param->type() != NodeParam::kInput) {
+        continue;
+      }
+
+      NodeInput* input = static_cast<NodeInput*>(param);
+      QString type = GLSLType(input);
+      Node* connected = input->get_connected_node();
+
+      arguments.append(QStringLiteral("%1 %2").arg(type, input->id()));
+
+      if (connected != nullptr && stages.contains(connected)) {
+        // Output of an earlier stage in this shader
+        call_arguments.append(QStringLiteral("color%1").arg(stages.indexOf(connected)));
+      } else {
+        QString uniform_name = OpenGLShaderCache::FusedUniformName(i, input);
+
+        if (input->data_type() == NodeParam::kTexture) {
+          // Constants are passed in as a color and used instead of the texture
+          QString constant_name = OpenGLShaderCache::FusedConstantName(i, input);
+          QString switch_name = OpenGLShaderCache::FusedConstantSwitchName(i, input);
+
+          uniforms.append(QStringLiteral("uniform sampler2D %1;\n"
+                                         "uniform vec4 %2;\n"
+                                         "uniform bool %3;\n").arg(uniform_name, constant_name, switch_name));
+          call_arguments.append(QStringLiteral("(%3 ? %2 : texture2D(%1, v_texcoord))").arg(uniform_name,
+                                                                                         constant_name,
+                                                                                         switch_name));
+        } else {
+          uniforms.append(QStringLiteral("uniform %1 %2;\n").arg(type, uniform_name));
+          call_arguments.append(uniform_name);
+        }
+      }
+    }
+
+    functions.append(QStringLiteral("vec4 stage%1(%2) {\n"
+                                    "  %3\n"
+                                    "}\n"
+                                    "\n").arg(QString::number(i),
+                                              arguments.join(QStringLiteral(", ")),
+                                              stage->PointwiseCode()));
+
+    main_body.append(QStringLiteral("  vec4 color%1 = stage%1(%2);\n").arg(QString::number(i),
+                                                                         call_arguments.join(QStringLiteral(", "))));
+  }
+
+  return QStringLiteral("#version 110\n"
+                        "\n"
+                        "varying vec2 v_texcoord;\n"
+                        "\n"
+                        "%1"
+                        "\n"
+                        "%2"
+                        "void main(void) {\n"
+                        "%3"
+                        "  gl_FragColor = color%4;\n"
+                        "}\n").arg(uniforms,
+                                    functions,
+                                    main_body,
+                                    QString::number(stages.size() - 1));
+}
+
+bool OpenGLBackend::TimeIsCached(const TimeRange &time)
+{
+  return TimeIsQueued(time.in());
+}
+
+void OpenGLBackend::JobFinishedEvent(const RenderResult &result)
+{
+  switch (result.type) {
+  case RenderResult::kCompletedFrame:
+    if (ResultIsStale(result) && TimeIsQueued(result.dep.in())) {
+      // An edit since this was queued has invalidated the frame again, so it's already out of date. Skip the readback
+      // and let the frame be rendered again.
+      frame_cache()->RemoveHashFromCurrentlyCaching(result.hash);
+      HashAbandoned(result.hash, true);
+    } else {
+      Metrics::Increment(Metrics::kFramesRendered);
+      FrameCompleted(result.worker, result.dep, result.hash, result.value);
+    }
+    break;
+  case RenderResult::kHashAlreadyExists:
+    ThreadCompletedDownload(result.dep, result.hash);
+    break;
+  case RenderResult::kCancelled:
+    RequeueFrame(result.dep.in());
+
+    // Frames that were waiting on the one this worker was rendering have to be rendered again too
+    if (!result.hash.isEmpty()) {
+      HashAbandoned(result.hash, true);
+    }
+    break;
+  case RenderResult::kHashAlreadyBeingCached:
+    // Filled in once the worker rendering this hash has cached it
+    WaitForHash(result.dep.in(), result.hash);
+    break;
+  case RenderResult::kCompletedTiles:
+    // The frame writer signals once it's on disk, the same as a downloaded frame
+    Metrics::Increment(Metrics::kFramesRendered);
+    break;
+  case RenderResult::kCompletedCache:
+    break;
+  }
+}
+
+void OpenGLBackend::FrameCompleted(RenderWorker* worker, const NodeDependency& path, const QByteArray& hash, const NodeValueTable& table)
+{
+  QVariant value = table.Get(NodeParam::kTexture);
+  bool has_texture = ValueHasTexture(value);
+  int device = DeviceOf(worker);
+
+  if (!has_texture) {
+    // No frame received, we set hash to an empty
+    frame_cache()->RemoveHash(TimeToFrame(path.in()), hash);
+    FrameDone(TimeToFrame(path.in()));
+    HashAbandoned(hash, false);
+  } else {
+    // Received a texture, let's download it. Find an available worker on the texture's device to download it, but
+    // worst case if none of them are available, just queue it on the worker that rendered it
+    RenderWorker* downloader = worker;
+
+    foreach (RenderWorker* w, processors_) {
+      if (w->IsAvailable() && DeviceOf(w) == device) {
+        downloader = w;
+        break;
+      }
+    }
+
+    QMetaObject::invokeMethod(downloader,
+                              "Download",
+                              Q_ARG(NodeDependency, path),
+                              Q_ARG(QByteArray, hash),
+                              Q_ARG(QVariant, value));
+  }
+
+  // Set as push texture, unless it's on another device than the viewer's, in which case the viewer gets it from the
+  // cache once it's downloaded
+  if (device == 0 && !TimeIsCached(TimeRange(path.in(), path.in()))) {
+    emit CachedFrameReady(path.in(), value);
+
+    if (has_texture) {
+      SetPushedFrame(path.in(), hash);
+    }
+  }
+}
+
+void OpenGLBackend::ThreadCompletedDownload(NodeDependency dep, QByteArray hash)
+{
+  frame_cache()->SetHash(TimeToFrame(dep.in()), hash);
+  FrameDone(TimeToFrame(dep.in()));
+  HashCached(hash);
+
+  // If the viewer is already showing this frame's texture, reading it back from the cache and uploading it to the
+  // master texture again would just be a round trip through the CPU for the same pixels
+  if (!FrameIsOnScreen(dep.in(), hash)) {
+    emit CachedTimeReady(dep.in());
+  }
 }
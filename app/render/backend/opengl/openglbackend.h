@@ -1,12 +1,17 @@
 #ifndef OPENGLBACKEND_H
 #define OPENGLBACKEND_H
 
+#include <QOffscreenSurface>
+#include <QTimer>
+
 #include "../videorenderbackend.h"
 #include "openglframebuffer.h"
 #include "openglworker.h"
 #include "opengltexture.h"
+#include "opengluploadring.h"
 #include "openglshader.h"
 #include "openglshadercache.h"
+#include "render/backend/software/softwareworker.h"
 
 class OpenGLBackend : public VideoRenderBackend
 {
@@ -16,29 +21,262 @@ public:
 
   virtual ~OpenGLBackend() override;
 
-  OpenGLTexturePtr GetCachedFrameAsTexture(const rational& time);
+  /**
+   * @brief Render on the CPU with SoftwareWorkers instead of on the GPU (FALSE by default)
+   *
+   * For headless renders on machines without a GPU. Applies to every OpenGLBackend initialized afterwards, none of
+   * which need an OpenGL context to be current when they are. Frames are only sent to the viewer as OpenGL textures,
+   * so this is no use with a GUI.
+   */
+  static void SetSoftwareRendering(bool e);
+
+  static bool SoftwareRendering();
 
 protected:
   virtual bool InitInternal() override;
 
   virtual void CloseInternal() override;
 
+  /**
+   * @brief Every worker has a GPU context of its own, so there are only as many as the GPU budget allows
+   *
+   * Fewer still if their textures wouldn't fit in what's left of the GPU memory budget (see OpenGLMemoryBudget).
+   */
+  virtual int MaximumWorkerCount() const override;
+
   virtual bool CompileInternal() override;
 
   virtual void DecompileInternal() override;
 
+  /**
+   * @brief Bypassed nodes are never fused (see NodeIsPointwise()), so the fused groups are rebuilt
+   */
+  virtual void BypassChangedEvent() override;
+
+  /**
+   * @brief Uploads the frame to the master texture and sends it to the viewer with CachedFrameReady()
+   *
+   * Frames are streamed through master_uploads_ into the master texture's back buffer, which then becomes the front,
+   * so a frame's upload never stalls on the one on screen. Compressed frames go to a compressed master texture of
+   * their own, which the viewer samples the same way.
+   */
+  virtual void CachedFrameLoadedEvent(const rational& time, const QByteArray& frame, bool compressed) override;
+
+  virtual void JobFinishedEvent(const RenderResult& result) override;
+
+  /**
+   * @brief Textures can only be handed between workers on the same device
+   */
+  virtual bool CanRunSibling(RenderWorker* requester, RenderWorker* worker) const override;
+
+  /**
+   * @brief Returns whether a rendered value holds a frame, whether it was rendered on the GPU or on the CPU
+   */
+  static bool ValueHasTexture(const QVariant& value);
+
 private:
+  /**
+   * @brief A GPU that workers render on
+   *
+   * The first device is the one the viewer's context is on. Any others come from the "RenderGPUScreens" setting:
+   * each is given a context of its own on that screen, which on systems with a GPU per screen (e.g. one X screen per
+   * GPU) puts it on another GPU. Contexts on different devices can't share, so textures rendered on other devices
+   * never go to the viewer directly. They're downloaded to the cache like any other frame and the viewer reads them
+   * back from there.
+   */
+  struct Device {
+    /// Context every worker on this device shares with
+    QOpenGLContext* context;
+
+    /// Surface to make `context` current on, nullptr for the first device (whose context is already current)
+    QOffscreenSurface* surface;
+
+    /// Shaders compiled for this device
+    OpenGLShaderCache* shader_cache;
+
+    /// Fused shaders by their generated code, so recompiling the same group doesn't compile a new shader
+    QHash<QString, OpenGLShaderPtr> fused_shaders;
+  };
+
+  /**
+   * @brief Uniform names of every stage's inputs, laid out like OpenGLShader::SetInputLocations()
+   *
+   * Names are collected when a program is started so it can be finished after the nodes are gone. Parameters that
+   * aren't passed to the shader have an empty name.
+   */
+  struct InputNames {
+    QVector< QVector<QString> > inputs;
+
+    /// Only set for texture inputs of fused programs (see OpenGLShader::SetConstantLocations())
+    QVector< QVector<QString> > constants;
+    QVector< QVector<QString> > switches;
+  };
+
+  static InputNames CollectInputNames(const QList<Node*>& stages, bool fused);
+
+  /**
+   * @brief Add a device for every screen in the "RenderGPUScreens" setting that isn't the viewer's
+   */
+  void CreateExtraDevices(QOpenGLContext* viewer_context);
+
+  /**
+   * @brief Make `device`'s context current (if it isn't the viewer's) to compile shaders or free them
+   *
+   * @return
+   *
+   * The context that was current before, to give back to RestoreContext().
+   */
+  static QOpenGLContext* MakeDeviceCurrent(const Device& device);
+
+  static void RestoreContext(const Device& device, QOpenGLContext* previous);
+
+  /**
+   * @brief Compile the shaders of every node the viewer depends on into `device`'s shader cache
+   */
+  bool CompileForDevice(int device_index, const QList<Node*>& nodes);
+
+  /**
+   * @brief Replace `device`'s fused groups with new ones for these nodes (see CollectFusedStages())
+   *
+   * Groups that have the same code as one that was compiled before reuse its program.
+   */
+  bool FuseForDevice(int device_index, const QList<Node*>& nodes);
+
+  /**
+   * @brief Index in devices_ of the device this worker renders on
+   */
+  int DeviceOf(RenderWorker* worker) const;
+
   bool TimeIsCached(const TimeRange &time);
 
+  /**
+   * @brief Download a rendered frame's texture to the disk cache and push it to the viewer
+   */
+  void FrameCompleted(RenderWorker* worker, const NodeDependency& path, const QByteArray& hash, const NodeValueTable& table);
+
+  /**
+   * @brief Start compiling and linking a fragment shader with the default vertex shader in the background
+   *
+   * The program can be handed to workers straight away, they wait for it with OpenGLShader::WaitUntilReady(). It's
+   * finished by FinishPendingPrograms() with the locations of `inputs` (sets an error and returns nullptr if it
+   * couldn't be created).
+   */
+  OpenGLShaderPtr CompileShader(int device_index, const QString& code, const InputNames& inputs);
+
+  /**
+   * @brief Same as CompileShader() for a compute shader, its work group size is stored once it's linked
+   */
+  OpenGLShaderPtr CompileComputeShader(int device_index, const QString& code, const InputNames& inputs);
+
+  /**
+   * @brief Program started by CompileShader() or CompileComputeShader() that hasn't been finished yet
+   */
+  struct PendingProgram {
+    int device_index;
+    OpenGLShaderPtr shader;
+    InputNames inputs;
+    bool is_compute;
+  };
+
+  /**
+   * @brief Finish the pending programs whose links are done (or all of them if `wait` is TRUE)
+   *
+   * Drivers that can't say whether a link is done (see OpenGLShader::LinkIsFinished()) get one program finished per
+   * call, so the event loop still runs between them.
+   */
+  void FinishPendingPrograms(bool wait);
+
+  /**
+   * @brief Look up a linked program's work group size and input locations, then let workers use it
+   */
+  static void FinishProgram(const PendingProgram& pending);
+
+  QList<PendingProgram> pending_programs_;
+
+  /**
+   * @brief Milliseconds between checks on the pending programs
+   */
+  static const int kLinkPollInterval = 5;
+
+  /**
+   * @brief Rough number of frame-sized textures a worker holds while rendering (footage, node outputs and its pool)
+   */
+  static const int kTexturesPerWorker = 8;
+
+  QTimer link_timer_;
+
+  /**
+   * @brief Returns whether the current context can run compute shaders (OpenGL 4.3 or OpenGL ES 3.1)
+   */
+  static bool ComputeIsSupported();
+
+  /**
+   * @brief Look up the uniform locations of every stage's inputs once, so drawing doesn't have to do it by name
+   */
+  static void ResolveInputLocations(OpenGLShaderPtr shader, const InputNames& inputs);
+
+  /**
+   * @brief GLSL type an input is passed to a pointwise function as, or an empty string if it can't be
+   */
+  static QString GLSLType(NodeInput* input);
+
+  /**
+   * @brief Returns whether a node can be part of a fused shader (see Node::PointwiseCode())
+   *
+   * Bypassed nodes can't, since their stage would still run.
+   */
+  static bool NodeIsPointwise(Node* n);
+
+  /**
+   * @brief Returns whether any of a node's inputs is a texture
+   */
+  static bool NodeTakesTexture(Node* n);
+
+  /**
+   * @brief Returns the node that `n` will be fused into, or nullptr if `n` is the last stage of its group (or isn't
+   * fusable)
+   *
+   * A pointwise node is fused into the node it outputs to if that's its only output and that node is pointwise too.
+   */
+  static Node* FusedConsumer(Node* n);
+
+  /**
+   * @brief Collect the stages of the fused group ending at `n` in the order they need to be evaluated
+   */
+  static void CollectFusedStages(Node* n, QList<Node*>* stages);
+
+  /**
+   * @brief Generate one fragment shader that evaluates every stage's Node::PointwiseCode() in order
+   *
+   * Each texture input from outside the group can be given as a constant color instead of a texture (see
+   * OpenGLShaderCache::FusedConstantName()).
+   */
+  static QString GenerateFusedCode(const QList<Node*>& stages);
+
   OpenGLTexturePtr master_texture_;
+  OpenGLTexturePtr compressed_master_texture_;
+
+  /**
+   * @brief Cached frames for the master texture are staged here, in the viewer's context
+   */
+  OpenGLUploadRing master_uploads_;
+
+  QVector<Device> devices_;
 
-  OpenGLShaderCache shader_cache_;
+  /**
+   * @brief Index in devices_ of each worker's device (same indices as processors_)
+   */
+  QVector<int> worker_devices_;
+
+  static bool software_rendering_;
 
 private slots:
-  void ThreadCompletedFrame(NodeDependency path, QByteArray hash, NodeValueTable table);
   void ThreadCompletedDownload(NodeDependency dep, QByteArray hash);
-  void ThreadSkippedFrame();
-  void ThreadHashAlreadyExists(NodeDependency dep, QByteArray hash);
+
+  /**
+   * @brief Called by link_timer_ while there are pending programs
+   */
+  void PollPendingPrograms();
 
 };
 
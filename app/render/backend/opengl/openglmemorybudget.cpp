@@ -0,0 +1,239 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "openglmemorybudget.h"
+
+#include <QDebug>
+#include <QOpenGLFunctions>
+
+#ifndef GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX
+#define GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX 0x9047
+#endif
+
+#ifndef GL_TEXTURE_FREE_MEMORY_ATI
+#define GL_TEXTURE_FREE_MEMORY_ATI 0x87FC
+#endif
+
+OpenGLMemoryBudget::State::State() :
+  budget(0),
+  detected_budget(-1),
+  total(0),
+  pressure_generation(0),
+  warned(false)
+{
+}
+
+void OpenGLMemoryBudget::SetBudget(qint64 bytes)
+{
+  State& s = state();
+
+  s.lock.lock();
+  s.budget = qMax(Q_INT64_C(0), bytes);
+  s.lock.unlock();
+}
+
+qint64 OpenGLMemoryBudget::Budget()
+{
+  State& s = state();
+
+  s.lock.lock();
+  qint64 budget = BudgetInternal(s);
+  s.lock.unlock();
+
+  return budget;
+}
+
+void OpenGLMemoryBudget::Allocate(QOpenGLContext *ctx, qint64 bytes)
+{
+  State& s = state();
+
+  s.lock.lock();
+
+  s.total += bytes;
+  s.per_context[ctx] += bytes;
+
+  qint64 budget = BudgetInternal(s);
+  bool over = (budget > 0 && s.total > budget);
+  bool warn = (over && !s.warned);
+
+  if (over) {
+    s.warned = true;
+  }
+
+  qint64 total = s.total;
+
+  s.lock.unlock();
+
+  if (over) {
+    // Pools free what they're holding the next time they're used
+    s.pressure_generation.fetchAndAddRelaxed(1);
+  }
+
+  if (warn) {
+    qWarning() << "GPU textures are using" << total / 1024 / 1024 << "MB of a" << budget / 1024 / 1024 << "MB budget";
+  }
+}
+
+void OpenGLMemoryBudget::Free(QOpenGLContext *ctx, qint64 bytes)
+{
+  State& s = state();
+
+  s.lock.lock();
+
+  s.total -= bytes;
+
+  QHash<QOpenGLContext*, qint64>::iterator i = s.per_context.find(ctx);
+
+  if (i != s.per_context.end()) {
+    i.value() -= bytes;
+
+    if (i.value() <= 0) {
+      // Contexts come and go with backends, don't keep the ones that are gone
+      s.per_context.erase(i);
+    }
+  }
+
+  qint64 budget = BudgetInternal(s);
+
+  if (budget == 0 || s.total <= budget) {
+    s.warned = false;
+  }
+
+  s.lock.unlock();
+}
+
+bool OpenGLMemoryBudget::WouldExceed(qint64 bytes)
+{
+  State& s = state();
+
+  s.lock.lock();
+  qint64 budget = BudgetInternal(s);
+  bool exceed = (budget > 0 && s.total + bytes > budget);
+  s.lock.unlock();
+
+  return exceed;
+}
+
+bool OpenGLMemoryBudget::UnderPressure()
+{
+  State& s = state();
+
+  s.lock.lock();
+  qint64 budget = BudgetInternal(s);
+  bool pressure = (budget > 0 && s.total > budget / 100 * kPressurePercent);
+  s.lock.unlock();
+
+  return pressure;
+}
+
+int OpenGLMemoryBudget::PressureGeneration()
+{
+  return state().pressure_generation.load();
+}
+
+int OpenGLMemoryBudget::FitWorkerCount(int wanted, qint64 bytes_per_worker)
+{
+  State& s = state();
+
+  s.lock.lock();
+  qint64 budget = BudgetInternal(s);
+  qint64 remaining = budget - s.total;
+  s.lock.unlock();
+
+  if (budget == 0 || bytes_per_worker <= 0) {
+    return wanted;
+  }
+
+  int fit = static_cast<int>(qMax(Q_INT64_C(0), remaining) / bytes_per_worker);
+
+  if (fit < wanted) {
+    qWarning() << "Only starting" << qMax(1, fit) << "of" << wanted << "render workers to stay within the GPU memory budget";
+  }
+
+  return qMax(1, qMin(wanted, fit));
+}
+
+qint64 OpenGLMemoryBudget::TotalAllocatedBytes()
+{
+  State& s = state();
+
+  s.lock.lock();
+  qint64 total = s.total;
+  s.lock.unlock();
+
+  return total;
+}
+
+qint64 OpenGLMemoryBudget::AllocatedBytes(QOpenGLContext *ctx)
+{
+  State& s = state();
+
+  s.lock.lock();
+  qint64 bytes = s.per_context.value(ctx, 0);
+  s.lock.unlock();
+
+  return bytes;
+}
+
+OpenGLMemoryBudget::State &OpenGLMemoryBudget::state()
+{
+  static State s;
+  return s;
+}
+
+qint64 OpenGLMemoryBudget::BudgetInternal(OpenGLMemoryBudget::State &s)
+{
+  if (s.budget > 0) {
+    return s.budget;
+  }
+
+  if (s.detected_budget < 0) {
+    QOpenGLContext* ctx = QOpenGLContext::currentContext();
+
+    if (ctx == nullptr) {
+      // Try again once there's a context to ask
+      return 0;
+    }
+
+    s.detected_budget = QueryDeviceMemory(ctx, s.total) / 100 * kAutomaticPercent;
+  }
+
+  return s.detected_budget;
+}
+
+qint64 OpenGLMemoryBudget::QueryDeviceMemory(QOpenGLContext *ctx, qint64 allocated)
+{
+  QOpenGLFunctions* f = ctx->functions();
+
+  if (ctx->hasExtension("GL_NVX_gpu_memory_info")) {
+    GLint kb = 0;
+    f->glGetIntegerv(GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &kb);
+    return static_cast<qint64>(kb) * 1024;
+  }
+
+  if (ctx->hasExtension("GL_ATI_meminfo")) {
+    // Only free memory is reported, what we've already allocated is added back on top
+    GLint info[4] = {0, 0, 0, 0};
+    f->glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, info);
+    return static_cast<qint64>(info[0]) * 1024 + allocated;
+  }
+
+  return 0;
+}
@@ -0,0 +1,138 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef OPENGLMEMORYBUDGET_H
+#define OPENGLMEMORYBUDGET_H
+
+#include <QHash>
+#include <QMutex>
+#include <QOpenGLContext>
+
+/**
+ * @brief Process-wide accounting of the GPU memory held by OpenGLTextures
+ *
+ * Every worker renders with textures of its own, on top of the master textures, LUTs and texture pools, so with a few
+ * viewers open on a big graph there can be more textures than the GPU has room for. Rather than finding out when an
+ * allocation fails, every texture reports its size here (per context) and is checked against Budget().
+ *
+ * Once an allocation goes over the budget, pressure is raised and texture pools free the textures they're holding for
+ * reuse (see OpenGLTextureCache). Backends start fewer workers when they wouldn't fit (see FitWorkerCount()) and the
+ * viewer lowers the preview quality while UnderPressure().
+ */
+class OpenGLMemoryBudget
+{
+public:
+  /**
+   * @brief Set the most GPU memory textures may use in bytes (0 means a share of what the GPU reports)
+   */
+  static void SetBudget(qint64 bytes);
+
+  /**
+   * @brief The budget in bytes, or 0 if it's automatic and the GPU doesn't report its memory (no limit)
+   *
+   * An automatic budget is looked up the first time this is called with a context current.
+   */
+  static qint64 Budget();
+
+  /**
+   * @brief Called by OpenGLTexture whenever it allocates storage on `ctx`
+   */
+  static void Allocate(QOpenGLContext* ctx, qint64 bytes);
+
+  /**
+   * @brief Called by OpenGLTexture whenever it frees storage it allocated on `ctx`
+   */
+  static void Free(QOpenGLContext* ctx, qint64 bytes);
+
+  /**
+   * @brief Returns whether allocating another `bytes` would go over the budget
+   */
+  static bool WouldExceed(qint64 bytes);
+
+  /**
+   * @brief Returns whether textures use more than kPressurePercent of the budget
+   */
+  static bool UnderPressure();
+
+  /**
+   * @brief Bumped every time an allocation goes over the budget
+   *
+   * Texture pools remember the value they last saw and free their unused textures when it changes.
+   */
+  static int PressureGeneration();
+
+  /**
+   * @brief How many of `wanted` workers fit in what's left of the budget if each holds `bytes_per_worker` (at least 1)
+   */
+  static int FitWorkerCount(int wanted, qint64 bytes_per_worker);
+
+  static qint64 TotalAllocatedBytes();
+
+  static qint64 AllocatedBytes(QOpenGLContext* ctx);
+
+private:
+  struct State {
+    State();
+
+    QMutex lock;
+
+    qint64 budget;
+
+    /// Budget looked up from the GPU, -1 if it hasn't been yet
+    qint64 detected_budget;
+
+    qint64 total;
+
+    QHash<QOpenGLContext*, qint64> per_context;
+
+    QAtomicInt pressure_generation;
+
+    /// Whether going over the budget has been warned about since the last time usage dropped under it
+    bool warned;
+  };
+
+  /**
+   * @brief Created on first use, since textures may be created before main()
+   */
+  static State& state();
+
+  /**
+   * @brief Budget from the GPU's reported memory (lock must be held)
+   */
+  static qint64 BudgetInternal(State& s);
+
+  /**
+   * @brief Ask the current context's driver how much memory the GPU has in bytes, or 0 if it can't say
+   */
+  static qint64 QueryDeviceMemory(QOpenGLContext* ctx, qint64 allocated);
+
+  /**
+   * @brief Share of the GPU's memory an automatic budget takes, leaving the rest for the desktop and other apps
+   */
+  static const int kAutomaticPercent = 75;
+
+  /**
+   * @brief Share of the budget after which UnderPressure() is TRUE
+   */
+  static const int kPressurePercent = 90;
+
+};
+
+#endif // OPENGLMEMORYBUDGET_H
@@ -1,35 +1,411 @@
 #include "openglshader.h"
 
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
 #include <QOpenGLExtraFunctions>
+#include <QSaveFile>
 
-OpenGLShader::OpenGLShader()
+#include "common/filefunctions.h"
+
+// From GL_KHR_parallel_shader_compile, which has the same values as the ARB version
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+
+typedef void (QOPENGLF_APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+
+OpenGLShader::OpenGLShader() :
+  is_compute_(false),
+  work_group_width_(1),
+  work_group_height_(1),
+  ready_(true)
+{
+
+}
+
+void OpenGLShader::SetInputLocations(const QVector<QVector<int> > &locations)
+{
+  input_locations_ = locations;
+}
+
+int OpenGLShader::InputLocation(int stage, int param_index) const
+{
+  if (stage >= input_locations_.size() || param_index >= input_locations_.at(stage).size()) {
+    return -1;
+  }
+
+  return input_locations_.at(stage).at(param_index);
+}
+
+void OpenGLShader::SetConstantLocations(const QVector<QVector<int> > &colors, const QVector<QVector<int> > &switches)
+{
+  constant_locations_ = colors;
+  constant_switch_locations_ = switches;
+}
+
+int OpenGLShader::ConstantLocation(int stage, int param_index, int *switch_location) const
+{
+  if (stage >= constant_locations_.size() || param_index >= constant_locations_.at(stage).size()) {
+    *switch_location = -1;
+    return -1;
+  }
+
+  *switch_location = constant_switch_locations_.at(stage).at(param_index);
+
+  return constant_locations_.at(stage).at(param_index);
+}
+
+void OpenGLShader::SetComputeWorkGroupSize(int width, int height)
+{
+  is_compute_ = true;
+  work_group_width_ = qMax(1, width);
+  work_group_height_ = qMax(1, height);
+}
+
+bool OpenGLShader::IsCompute() const
+{
+  return is_compute_;
+}
+
+int OpenGLShader::work_group_width() const
+{
+  return work_group_width_;
+}
+
+int OpenGLShader::work_group_height() const
+{
+  return work_group_height_;
+}
+
+bool OpenGLShader::LinkCached(const QVector<ShaderSource> &sources)
+{
+  bool linked = StartLinkCached(sources) && FinishLink();
+
+  SetReady();
+
+  return linked;
+}
+
+bool OpenGLShader::StartLinkCached(const QVector<ShaderSource> &sources)
+{
+  if (!create()) {
+    return false;
+  }
+
+  ready_lock_.lock();
+  ready_ = false;
+  ready_lock_.unlock();
+
+  pending_binary_filename_.clear();
+
+  if (ProgramBinariesAreSupported()) {
+    QString filename = ProgramBinaryFilename(sources);
+
+    if (LoadProgramBinary(filename)) {
+      return true;
+    }
+
+    pending_binary_filename_ = filename;
+
+    // Some drivers only keep what's needed to return the binary if asked to before linking
+    QOpenGLContext::currentContext()->extraFunctions()->glProgramParameteri(programId(),
+                                                                           GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                                                                           GL_TRUE);
+  }
+
+  QOpenGLFunctions* f = QOpenGLContext::currentContext()->functions();
+
+  foreach (const ShaderSource& source, sources) {
+    GLenum type;
+
+    switch (source.first) {
+    case QOpenGLShader::Vertex:
+      type = GL_VERTEX_SHADER;
+      break;
+    case QOpenGLShader::Compute:
+      type = GL_COMPUTE_SHADER;
+      break;
+    default:
+      type = GL_FRAGMENT_SHADER;
+    }
+
+    GLuint shader = f->glCreateShader(type);
+    QByteArray code = source.second.toUtf8();
+    const char* code_data = code.constData();
+
+    // The compile status isn't checked here, the link fails if a shader didn't compile
+    f->glShaderSource(shader, 1, &code_data, nullptr);
+    f->glCompileShader(shader);
+    f->glAttachShader(programId(), shader);
+
+    pending_shaders_.append(shader);
+  }
+
+  f->glLinkProgram(programId());
+
+  return true;
+}
+
+bool OpenGLShader::LinkIsFinished()
+{
+  if (pending_shaders_.isEmpty() || !ParallelCompileIsSupported()) {
+    return true;
+  }
+
+  GLint finished = GL_TRUE;
+  QOpenGLContext::currentContext()->functions()->glGetProgramiv(programId(), GL_COMPLETION_STATUS_KHR, &finished);
+
+  return finished == GL_TRUE;
+}
+
+bool OpenGLShader::FinishLink()
+{
+  if (!programId()) {
+    return false;
+  }
+
+  // With no shaders added through Qt, link() only picks up whether the program we linked ourselves succeeded
+  bool linked = link();
+
+  if (!linked) {
+    QOpenGLFunctions* f = QOpenGLContext::currentContext()->functions();
+
+    foreach (GLuint shader, pending_shaders_) {
+      GLint length = 0;
+      f->glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+
+      if (length > 1) {
+        QByteArray shader_log(length, Qt::Uninitialized);
+        f->glGetShaderInfoLog(shader, length, nullptr, shader_log.data());
+        qWarning() << "Shader compile log:" << shader_log.constData();
+      }
+    }
+  }
+
+  DeletePendingShaders();
+
+  if (linked && !pending_binary_filename_.isEmpty()) {
+    SaveProgramBinary(pending_binary_filename_);
+  }
+
+  pending_binary_filename_.clear();
+
+  return linked;
+}
+
+void OpenGLShader::SetReady()
+{
+  ready_lock_.lock();
+
+  ready_ = true;
+  ready_wait_.wakeAll();
+
+  ready_lock_.unlock();
+}
+
+bool OpenGLShader::WaitUntilReady()
+{
+  ready_lock_.lock();
+
+  while (!ready_) {
+    ready_wait_.wait(&ready_lock_);
+  }
+
+  ready_lock_.unlock();
+
+  return isLinked();
+}
+
+bool OpenGLShader::ParallelCompileIsSupported()
+{
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+
+  return ctx != nullptr
+      && (ctx->hasExtension("GL_KHR_parallel_shader_compile") || ctx->hasExtension("GL_ARB_parallel_shader_compile"));
+}
+
+void OpenGLShader::EnableParallelCompile()
+{
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+
+  if (!ParallelCompileIsSupported()) {
+    return;
+  }
+
+  MaxShaderCompilerThreadsProc max_threads = reinterpret_cast<MaxShaderCompilerThreadsProc>(
+        ctx->getProcAddress(ctx->hasExtension("GL_KHR_parallel_shader_compile")
+                            ? "glMaxShaderCompilerThreadsKHR"
+                            : "glMaxShaderCompilerThreadsARB"));
+
+  if (max_threads) {
+    // 0xFFFFFFFF leaves the number of threads up to the driver
+    max_threads(0xFFFFFFFF);
+  }
+}
+
+void OpenGLShader::DeletePendingShaders()
+{
+  QOpenGLFunctions* f = QOpenGLContext::currentContext()->functions();
+
+  foreach (GLuint shader, pending_shaders_) {
+    f->glDetachShader(programId(), shader);
+    f->glDeleteShader(shader);
+  }
+
+  pending_shaders_.clear();
+}
+
+bool OpenGLShader::ProgramBinariesAreSupported()
+{
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+
+  if (ctx == nullptr) {
+    return false;
+  }
+
+  bool supported;
+
+  if (ctx->isOpenGLES()) {
+    supported = (ctx->format().version() >= qMakePair(3, 0));
+  } else {
+    supported = (ctx->format().version() >= qMakePair(4, 1) || ctx->hasExtension("GL_ARB_get_program_binary"));
+  }
+
+  if (!supported) {
+    return false;
+  }
+
+  // A driver can support the functions without supporting any formats to save in
+  GLint format_count = 0;
+  ctx->functions()->glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+
+  return format_count > 0;
+}
+
+QString OpenGLShader::ProgramBinaryFilename(const QVector<ShaderSource> &sources)
 {
+  QOpenGLFunctions* f = QOpenGLContext::currentContext()->functions();
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+
+  hash.addData(reinterpret_cast<const char*>(f->glGetString(GL_VENDOR)));
+  hash.addData(reinterpret_cast<const char*>(f->glGetString(GL_RENDERER)));
+  hash.addData(reinterpret_cast<const char*>(f->glGetString(GL_VERSION)));
 
+  foreach (const ShaderSource& source, sources) {
+    hash.addData(QByteArray::number(static_cast<int>(source.first)));
+    hash.addData(source.second.toUtf8());
+  }
+
+  return GetShardedFilename(QDir(GetMediaCacheLocation()).filePath(QStringLiteral("shaders")),
+                            QString(hash.result().toHex()));
+}
+
+bool OpenGLShader::LoadProgramBinary(const QString &filename)
+{
+  QFile file(filename);
+
+  if (!file.open(QFile::ReadOnly)) {
+    // Not linked on this system yet
+    return false;
+  }
+
+  QDataStream ds(&file);
+
+  quint32 magic, version, format;
+  QByteArray binary;
+  ds >> magic >> version >> format >> binary;
+
+  if (ds.status() != QDataStream::Ok
+      || magic != kProgramBinaryMagic
+      || version != kProgramBinaryVersion
+      || binary.isEmpty()) {
+    qWarning() << "Ignoring unreadable program binary" << filename;
+    return false;
+  }
+
+  QOpenGLExtraFunctions* xf = QOpenGLContext::currentContext()->extraFunctions();
+
+  xf->glProgramBinary(programId(), format, binary.constData(), binary.size());
+
+  // With no shaders attached, link() only checks whether the binary was accepted
+  if (!link()) {
+    // Drivers reject binaries from older versions of themselves, the sources will be compiled again instead
+    file.close();
+    QFile::remove(filename);
+    return false;
+  }
+
+  return true;
+}
+
+void OpenGLShader::SaveProgramBinary(const QString &filename)
+{
+  QOpenGLExtraFunctions* xf = QOpenGLContext::currentContext()->extraFunctions();
+
+  GLint length = 0;
+  xf->glGetProgramiv(programId(), GL_PROGRAM_BINARY_LENGTH, &length);
+
+  if (length <= 0) {
+    return;
+  }
+
+  QByteArray binary(length, Qt::Uninitialized);
+  GLenum format;
+  xf->glGetProgramBinary(programId(), length, &length, &format, binary.data());
+  binary.resize(length);
+
+  QDir().mkpath(QFileInfo(filename).path());
+
+  QSaveFile file(filename);
+
+  if (!file.open(QFile::WriteOnly)) {
+    qWarning() << "Failed to save program binary" << filename;
+    return;
+  }
+
+  QDataStream ds(&file);
+  ds << kProgramBinaryMagic << kProgramBinaryVersion << static_cast<quint32>(format) << binary;
+
+  file.commit();
 }
 
 OpenGLShaderPtr OpenGLShader::CreateDefault(const QString &function_name, const QString &shader_code)
 {
   OpenGLShaderPtr program = std::make_shared<OpenGLShader>();
 
-  // Add shaders to program
-  program->addShaderFromSourceCode(QOpenGLShader::Vertex, CodeDefaultVertex());
-  program->addShaderFromSourceCode(QOpenGLShader::Fragment, CodeDefaultFragment(function_name, shader_code));
-  program->link();
+  program->LinkCached(QVector<ShaderSource>() << ShaderSource(QOpenGLShader::Vertex, CodeDefaultVertex())
+                                              << ShaderSource(QOpenGLShader::Fragment,
+                                                              CodeDefaultFragment(function_name, shader_code)));
 
   return program;
 }
 
-// copied from source code to OCIODisplay
-const int OCIO_LUT3D_EDGE_SIZE = 32;
+OpenGLShaderPtr OpenGLShader::CreateYUVToRGB()
+{
+  OpenGLShaderPtr program = std::make_shared<OpenGLShader>();
+
+  program->LinkCached(QVector<ShaderSource>() << ShaderSource(QOpenGLShader::Vertex, CodeDefaultVertex())
+                                              << ShaderSource(QOpenGLShader::Fragment, CodeYUVToRGBFragment()));
 
-// copied from source code to OCIODisplay, expanded from 3*LUT3D_EDGE_SIZE*LUT3D_EDGE_SIZE*LUT3D_EDGE_SIZE
-const int OCIO_NUM_3D_ENTRIES = 98304;
+  return program;
+}
 
 OpenGLShaderPtr OpenGLShader::CreateOCIO(QOpenGLContext* ctx,
                                          GLuint& lut_texture,
-                                         OCIO::ConstProcessorRcPtr processor,
+                                         ColorProcessorPtr processor,
                                          bool alpha_is_associated)
 {
+  // Baked once per processor, every context gets a texture of its own from the same data
+  const ColorProcessor::GpuData& gpu_data = processor->GetGpuData();
+  const int edge_size = ColorProcessor::kGpuLut3DEdgeSize;
 
   QOpenGLExtraFunctions* xf = ctx->extraFunctions();
 
@@ -46,38 +422,14 @@ OpenGLShaderPtr OpenGLShader::CreateOCIO(QOpenGLContext* ctx,
   xf->glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
   xf->glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
-  // Allocate storage for texture
-  xf->glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB16F_ARB,
-                   OCIO_LUT3D_EDGE_SIZE, OCIO_LUT3D_EDGE_SIZE, OCIO_LUT3D_EDGE_SIZE,
-                   0, GL_RGB,GL_FLOAT, nullptr);
-
-  //
-  // SET UP GLSL SHADER
-  //
-
-  OCIO::GpuShaderDesc shaderDesc;
-  const char* ocio_func_name = "OCIODisplay";
-  shaderDesc.setLanguage(OCIO::GPU_LANGUAGE_GLSL_1_0);
-  shaderDesc.setFunctionName(ocio_func_name);
-  shaderDesc.setLut3DEdgeLen(OCIO_LUT3D_EDGE_SIZE);
-
-  //
-  // COMPUTE 3D LUT
-  //
-
-  GLfloat* ocio_lut_data = new GLfloat[OCIO_NUM_3D_ENTRIES];
-  processor->getGpuLut3D(ocio_lut_data, shaderDesc);
-
   // Upload LUT data to texture
-  xf->glTexSubImage3D(GL_TEXTURE_3D, 0,
-                      0, 0, 0,
-                      OCIO_LUT3D_EDGE_SIZE, OCIO_LUT3D_EDGE_SIZE, OCIO_LUT3D_EDGE_SIZE,
-                      GL_RGB, GL_FLOAT, ocio_lut_data);
-
-  delete [] ocio_lut_data;
+  xf->glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB16F_ARB,
+                   edge_size, edge_size, edge_size,
+                   0, GL_RGB, GL_FLOAT, gpu_data.lut.constData());
 
   // Create OCIO shader code
-  QString shader_text(processor->getGpuShaderText(shaderDesc));
+  QString shader_text = gpu_data.shader_text;
+  const QString& ocio_func_name = gpu_data.function_name;
 
   QString shader_call;
 
@@ -205,6 +557,30 @@ QString OpenGLShader::CodeDefaultVertex()
                         "}\n");
 }
 
+QString OpenGLShader::CodeYUVToRGBFragment()
+{
+  return QStringLiteral("#version 110\n"
+                        "\n"
+                        "#ifdef GL_ES\n"
+                        "precision highp int;\n"
+                        "precision highp float;\n"
+                        "#endif\n"
+                        "\n"
+                        "uniform sampler2D y_plane;\n"
+                        "uniform sampler2D u_plane;\n"
+                        "uniform sampler2D v_plane;\n"
+                        "uniform mat3 yuv_matrix;\n"
+                        "uniform vec3 yuv_offset;\n"
+                        "varying vec2 v_texcoord;\n"
+                        "\n"
+                        "void main() {\n"
+                        "  vec3 yuv = vec3(texture2D(y_plane, v_texcoord).r,\n"
+                        "                  texture2D(u_plane, v_texcoord).r,\n"
+                        "                  texture2D(v_plane, v_texcoord).r);\n"
+                        "  gl_FragColor = vec4(clamp(yuv_matrix * (yuv - yuv_offset), 0.0, 1.0), 1.0);\n"
+                        "}\n");
+}
+
 QString OpenGLShader::CodeAlphaDisassociate(const QString &function_name)
 {
   return QStringLiteral("vec4 %1(vec4 col) {\n"
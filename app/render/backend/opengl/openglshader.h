@@ -2,10 +2,13 @@
 #define OPENGLSHADER_H
 
 #include <memory>
+#include <QMutex>
 #include <QOpenGLShaderProgram>
+#include <QPair>
+#include <QVector>
+#include <QWaitCondition>
 
-#include <OpenColorIO/OpenColorIO.h>
-namespace OCIO = OCIO_NAMESPACE::v1;
+#include "render/colorprocessor.h"
 
 class OpenGLShader;
 using OpenGLShaderPtr = std::shared_ptr<OpenGLShader>;
@@ -20,19 +23,195 @@ public:
   static OpenGLShaderPtr CreateDefault(const QString &function_name = QString(),
                                        const QString &shader_code = QString());
 
+  /**
+   * @brief Create a shader that converts three 8-bit Y, U, and V plane textures into RGBA
+   *
+   * The planes are read from the uniforms `y_plane`, `u_plane`, and `v_plane`. Since the chroma textures are sampled
+   * with normalized coordinates and bilinear filtering, subsampled chroma is upsampled for free. The conversion itself
+   * is `yuv_matrix * (yuv - yuv_offset)`, where `yuv_matrix` (mat3) and `yuv_offset` (vec3) are set by the caller
+   * for the frame's colorspace and range.
+   */
+  static OpenGLShaderPtr CreateYUVToRGB();
+
+  /**
+   * @brief Create a shader that applies `processor`, uploading its LUT to a new 3D texture in `ctx`
+   *
+   * The LUT is baked once per processor and shared (see ColorProcessor::GetGpuData()), the texture belongs to the
+   * caller.
+   */
   static OpenGLShaderPtr CreateOCIO(QOpenGLContext* ctx,
                                     GLuint& lut_texture,
-                                    OCIO::ConstProcessorRcPtr processor,
+                                    ColorProcessorPtr processor,
                                     bool alpha_is_associated);
 
   static QString CodeDefaultFragment(const QString &function_name = QString(),
                                      const QString &shader_code = QString());
   static QString CodeDefaultVertex();
+  static QString CodeYUVToRGBFragment();
   static QString CodeAlphaDisassociate(const QString& function_name);
   static QString CodeAlphaReassociate(const QString& function_name);
   static QString CodeAlphaAssociate(const QString& function_name);
 
+  using ShaderSource = QPair<QOpenGLShader::ShaderType, QString>;
+
+  /**
+   * @brief Compile and link this program from source, or load it from the on-disk program binary cache instead
+   *
+   * Binaries are keyed by the sources and the GL vendor, renderer and version of the current context, so a binary is
+   * never handed to a driver or GPU that didn't produce it. If there's no binary (or the driver rejects it, e.g. after
+   * an update it doesn't report through the version), the sources are compiled as usual and the result is saved for
+   * next time. Contexts that don't support program binaries always compile.
+   *
+   * @return FALSE if the program failed to compile or link, see log().
+   */
+  bool LinkCached(const QVector<ShaderSource>& sources);
+
+  /**
+   * @brief Same as LinkCached(), but only start compiling and linking rather than waiting for the driver to finish
+   *
+   * Poll LinkIsFinished() and call FinishLink() once it's TRUE (with the same context current), or call FinishLink()
+   * straight away to wait for it. A program loaded from a binary is already linked, but still needs FinishLink().
+   *
+   * WaitUntilReady() blocks from now until SetReady() is called, so the program can be handed to workers before it's
+   * linked.
+   *
+   * @return FALSE if the program couldn't be created.
+   */
+  bool StartLinkCached(const QVector<ShaderSource>& sources);
+
+  /**
+   * @brief Returns whether the driver has finished a link started with StartLinkCached()
+   *
+   * Drivers without GL_KHR_parallel_shader_compile (or the ARB version) can't tell, so this is always TRUE and
+   * FinishLink() waits for the link instead.
+   */
+  bool LinkIsFinished();
+
+  /**
+   * @brief Pick up the result of a link started with StartLinkCached() and save its binary
+   *
+   * @return FALSE if the program failed to compile or link, see log().
+   */
+  bool FinishLink();
+
+  /**
+   * @brief Wake anything waiting in WaitUntilReady(), call once the program is linked and its locations are set
+   */
+  void SetReady();
+
+  /**
+   * @brief Block until SetReady() has been called (doesn't block for programs linked with LinkCached())
+   *
+   * Thread-safe.
+   *
+   * @return Whether the program linked.
+   */
+  bool WaitUntilReady();
+
+  /**
+   * @brief Returns whether the current context can compile and link on threads of the driver's own
+   */
+  static bool ParallelCompileIsSupported();
+
+  /**
+   * @brief Let the driver of the current context use as many compile threads as it likes, if it can
+   */
+  static void EnableParallelCompile();
+
+  /**
+   * @brief Store the uniform location of every Node input this shader uses
+   *
+   * `locations[stage][i]` is the location for parameter `i` of that stage's Node (or -1 if unused). Shaders that
+   * aren't fused only have one stage.
+   */
+  void SetInputLocations(const QVector< QVector<int> >& locations);
+
+  /**
+   * @brief Get the location stored by SetInputLocations(), or -1 if there isn't one
+   */
+  int InputLocation(int stage, int param_index) const;
+
+  /**
+   * @brief Store the uniform locations generated shaders take constant texture inputs in (see OpenGLShaderCache)
+   *
+   * Same layout as SetInputLocations(). `colors` are the vec4 holding the constant and `switches` the bool that says
+   * to use it instead of sampling the texture.
+   */
+  void SetConstantLocations(const QVector< QVector<int> >& colors, const QVector< QVector<int> >& switches);
+
+  /**
+   * @brief Get the locations stored by SetConstantLocations(), or -1 if this input can't be a constant in this shader
+   */
+  int ConstantLocation(int stage, int param_index, int* switch_location) const;
+
+  /**
+   * @brief Mark this as a compute shader and store its local work group size
+   */
+  void SetComputeWorkGroupSize(int width, int height);
+
+  /**
+   * @brief Returns whether this is a compute shader (dispatched rather than drawn)
+   */
+  bool IsCompute() const;
+
+  int work_group_width() const;
+  int work_group_height() const;
+
 private:
+  /**
+   * @brief Returns whether the current context can save and load program binaries
+   */
+  static bool ProgramBinariesAreSupported();
+
+  /**
+   * @brief Where the binary of a program linked from these sources is stored
+   */
+  static QString ProgramBinaryFilename(const QVector<ShaderSource>& sources);
+
+  bool LoadProgramBinary(const QString& filename);
+
+  void SaveProgramBinary(const QString& filename);
+
+  /**
+   * @brief Detach and delete the shaders StartLinkCached() compiled, the program keeps what it linked
+   */
+  void DeletePendingShaders();
+
+  /**
+   * @brief First bytes of a program binary file, followed by a version number
+   */
+  static const quint32 kProgramBinaryMagic = 0x4F50424E; // "OPBN"
+  static const quint32 kProgramBinaryVersion = 1;
+
+  QVector< QVector<int> > input_locations_;
+
+  QVector< QVector<int> > constant_locations_;
+
+  QVector< QVector<int> > constant_switch_locations_;
+
+  bool is_compute_;
+
+  int work_group_width_;
+
+  int work_group_height_;
+
+  /**
+   * @brief Shaders compiled by StartLinkCached() that aren't managed by QOpenGLShaderProgram
+   *
+   * Qt's addShaderFromSourceCode() checks the compile status straight after compiling, which waits for the driver.
+   */
+  QVector<GLuint> pending_shaders_;
+
+  /**
+   * @brief Where FinishLink() saves the binary, empty if it was loaded from one or binaries aren't supported
+   */
+  QString pending_binary_filename_;
+
+  bool ready_;
+
+  QMutex ready_lock_;
+
+  QWaitCondition ready_wait_;
 
 };
 
@@ -1,15 +1,23 @@
 #include "openglshadercache.h"
 
 #include "node/node.h"
+#include "render/colormanager.h"
 
 void OpenGLShaderCache::Clear()
 {
   compiled_nodes_.clear();
+  compiled_code_.clear();
+
+  ClearFusedPrograms();
+  ClearColorPrograms();
 }
 
-void OpenGLShaderCache::AddShader(Node *output, OpenGLShaderPtr shader)
+void OpenGLShaderCache::AddShader(Node *output, OpenGLShaderPtr shader, const QString &code)
 {
-  compiled_nodes_.insert(GenerateShaderID(output), shader);
+  QString id = GenerateShaderID(output);
+
+  compiled_nodes_.insert(id, shader);
+  compiled_code_.insert(id, code);
 }
 
 OpenGLShaderPtr OpenGLShaderCache::GetShader(Node *output)
@@ -22,7 +30,141 @@ QString OpenGLShaderCache::GenerateShaderID(Node *output)
   return output->id();
 }
 
-bool OpenGLShaderCache::HasShader(Node *output)
+bool OpenGLShaderCache::HasShader(Node *output, const QString &code)
+{
+  QString id = GenerateShaderID(output);
+
+  return compiled_nodes_.contains(id) && compiled_code_.value(id) == code;
+}
+
+void OpenGLShaderCache::AddFusedProgram(Node *root, OpenGLShaderPtr shader, const QList<Node *> &stages)
 {
-  return compiled_nodes_.contains(GenerateShaderID(output));
+  FusedProgram program;
+  program.shader = shader;
+  program.stages = stages;
+
+  fused_lock_.lock();
+
+  fused_programs_.insert(root, program);
+
+  foreach (Node* stage, stages) {
+    foreach (NodeParam* param, stage->parameters()) {
+      if (param->type() == NodeParam::kInput) {
+        NodeInput* input = static_cast<NodeInput*>(param);
+
+        if (input->IsConnected() && stages.contains(input->get_connected_node())) {
+          fused_inputs_.insert(input);
+        }
+      }
+    }
+  }
+
+  fused_lock_.unlock();
+}
+
+bool OpenGLShaderCache::GetFusedProgram(Node *root, OpenGLShaderPtr *shader, QList<Node *> *stages)
+{
+  fused_lock_.lock();
+
+  QHash<Node*, FusedProgram>::const_iterator program = fused_programs_.constFind(root);
+  bool found = (program != fused_programs_.constEnd());
+
+  if (found) {
+    *shader = program->shader;
+    *stages = program->stages;
+  }
+
+  fused_lock_.unlock();
+
+  return found;
+}
+
+bool OpenGLShaderCache::InputIsFused(NodeInput *input)
+{
+  fused_lock_.lock();
+
+  bool fused = fused_inputs_.contains(input);
+
+  fused_lock_.unlock();
+
+  return fused;
+}
+
+void OpenGLShaderCache::ClearFusedPrograms()
+{
+  fused_lock_.lock();
+
+  fused_programs_.clear();
+  fused_inputs_.clear();
+
+  fused_lock_.unlock();
+}
+
+QString OpenGLShaderCache::FusedUniformName(int stage, NodeInput *input)
+{
+  return QStringLiteral("n%1_%2").arg(QString::number(stage), input->id());
+}
+
+QString OpenGLShaderCache::FusedConstantName(int stage, NodeInput *input)
+{
+  return QStringLiteral("%1_constant").arg(FusedUniformName(stage, input));
+}
+
+QString OpenGLShaderCache::FusedConstantSwitchName(int stage, NodeInput *input)
+{
+  return QStringLiteral("%1_is_constant").arg(FusedUniformName(stage, input));
+}
+
+OpenGLShaderPtr OpenGLShaderCache::GetColorProgram(QOpenGLContext *ctx,
+                                                   const QString &source,
+                                                   const QString &dest,
+                                                   bool alpha_is_associated,
+                                                   GLuint *lut)
+{
+  QString id = QStringLiteral("%1:%2:%3").arg(source, dest, QString::number(alpha_is_associated));
+
+  // Hold the lock while creating so two workers never build the same program
+  color_lock_.lock();
+
+  QHash<QString, ColorProgram>::const_iterator existing = color_programs_.constFind(id);
+
+  if (existing == color_programs_.constEnd()) {
+    ColorProgram program;
+    program.lut = 0;
+
+    try {
+      ColorProcessorPtr processor = ColorManager::GetProcessor(source, dest);
+
+      program.shader = OpenGLShader::CreateOCIO(ctx, program.lut, processor, alpha_is_associated);
+    } catch (OCIO::Exception& e) {
+      qWarning() << "Failed to create color transform from" << source << "to" << dest << "-" << e.what();
+    }
+
+    // Failures are cached too so we don't retry on every frame
+    existing = color_programs_.insert(id, program);
+  }
+
+  OpenGLShaderPtr shader = existing->shader;
+  *lut = existing->lut;
+
+  color_lock_.unlock();
+
+  return shader;
+}
+
+void OpenGLShaderCache::ClearColorPrograms()
+{
+  color_lock_.lock();
+
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+
+  foreach (const ColorProgram& program, color_programs_) {
+    if (program.lut != 0 && ctx != nullptr) {
+      ctx->functions()->glDeleteTextures(1, &program.lut);
+    }
+  }
+
+  color_programs_.clear();
+
+  color_lock_.unlock();
 }
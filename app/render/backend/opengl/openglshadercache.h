@@ -1,7 +1,9 @@
 #ifndef OPENGLSHADERCACHE_H
 #define OPENGLSHADERCACHE_H
 
+#include <QHash>
 #include <QMutex>
+#include <QSet>
 
 #include "node/output.h"
 #include "openglshader.h"
@@ -16,17 +18,101 @@ public:
 
   void Clear();
 
-  void AddShader(Node* output, OpenGLShaderPtr shader);
+  /**
+   * @brief Add a shader compiled from `code` for this type of Node
+   */
+  void AddShader(Node* output, OpenGLShaderPtr shader, const QString& code);
 
   OpenGLShaderPtr GetShader(Node* output);
 
-  bool HasShader(Node* output);
+  /**
+   * @brief Returns whether we already have a shader for this type of Node that was compiled from `code`
+   *
+   * Shaders are kept across recompiles, so this is how stale shaders are detected if a Node's code changes.
+   */
+  bool HasShader(Node* output, const QString& code);
+
+  /**
+   * @brief Use one shader pass for a group of pointwise Nodes (see Node::PointwiseCode())
+   *
+   * `stages` are the Nodes in the order the shader evaluates them, ending with `root` (the only one whose output is
+   * used outside the group). Any input of a stage connected to an earlier stage is marked as fused.
+   */
+  void AddFusedProgram(Node* root, OpenGLShaderPtr shader, const QList<Node*>& stages);
+
+  /**
+   * @brief Get the fused shader and stages for `root` if it's the root of a fused group
+   */
+  bool GetFusedProgram(Node* root, OpenGLShaderPtr* shader, QList<Node*>* stages);
+
+  /**
+   * @brief Returns whether this input's connected Node is evaluated as part of this input's Node's shader
+   */
+  bool InputIsFused(NodeInput* input);
+
+  /**
+   * @brief Forget all fused groups (the graph is being recompiled)
+   */
+  void ClearFusedPrograms();
+
+  /**
+   * @brief Name of the uniform a fused shader uses for `input` of stage `stage`
+   */
+  static QString FusedUniformName(int stage, NodeInput* input);
+
+  /**
+   * @brief Names of the uniforms a fused shader takes a constant texture input in instead of sampling it
+   *
+   * See NodeValue::ConstantTexture(). The bool switch says whether to use the vec4 color.
+   */
+  static QString FusedConstantName(int stage, NodeInput* input);
+  static QString FusedConstantSwitchName(int stage, NodeInput* input);
+
+  /**
+   * @brief Get a shader that converts from colorspace `source` to `dest`, creating it in `ctx` if necessary
+   *
+   * The shader is generated from OCIO's GPU shader API and is used with olive::gl::OCIOBlit() and the 3D LUT returned
+   * in `lut`. Programs are shared by every worker (their contexts all share with each other) so each pair is only
+   * built once. Returns nullptr if OCIO can't convert between the two colorspaces.
+   */
+  OpenGLShaderPtr GetColorProgram(QOpenGLContext* ctx,
+                                  const QString& source,
+                                  const QString& dest,
+                                  bool alpha_is_associated,
+                                  GLuint* lut);
+
+  /**
+   * @brief Free all color programs and their LUTs (requires a context in the same share group to be current)
+   */
+  void ClearColorPrograms();
 
 private:
+  struct FusedProgram {
+    OpenGLShaderPtr shader;
+    QList<Node*> stages;
+  };
+
+  struct ColorProgram {
+    OpenGLShaderPtr shader;
+    GLuint lut;
+  };
+
   QString GenerateShaderID(Node *output);
 
   QMap<QString, OpenGLShaderPtr> compiled_nodes_;
 
+  QMap<QString, QString> compiled_code_;
+
+  QHash<Node*, FusedProgram> fused_programs_;
+
+  QSet<NodeInput*> fused_inputs_;
+
+  QMutex fused_lock_;
+
+  QHash<QString, ColorProgram> color_programs_;
+
+  QMutex color_lock_;
+
 };
 
 #endif // OPENGLSHADERCACHE_H
@@ -23,6 +23,8 @@
 #include <QDateTime>
 #include <QDebug>
 
+#include "common/tracer.h"
+#include "openglmemorybudget.h"
 #include "render/pixelservice.h"
 
 OpenGLTexture::OpenGLTexture() :
@@ -31,7 +33,10 @@ OpenGLTexture::OpenGLTexture() :
   back_texture_(0),
   width_(0),
   height_(0),
-  format_(olive::PIX_FMT_INVALID)
+  format_(olive::PIX_FMT_INVALID),
+  compressed_(false),
+  data_window_(0, 0, 1, 1),
+  allocated_bytes_(0)
 {
 }
 
@@ -63,6 +68,7 @@ void OpenGLTexture::Create(QOpenGLContext *ctx, int width, int height, const oli
   width_ = width;
   height_ = height;
   format_ = format;
+  compressed_ = false;
 
   connect(context_, SIGNAL(aboutToBeDestroyed()), this, SLOT(Destroy()));
 
@@ -96,6 +102,9 @@ void OpenGLTexture::Destroy()
     context_->functions()->glDeleteTextures(1, &back_texture_);
     back_texture_ = 0;
 
+    OpenGLMemoryBudget::Free(context_, allocated_bytes_);
+    allocated_bytes_ = 0;
+
     context_ = nullptr;
   }
 }
@@ -120,6 +129,16 @@ void OpenGLTexture::Release()
   context_->functions()->glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+const QRectF &OpenGLTexture::data_window() const
+{
+  return data_window_;
+}
+
+void OpenGLTexture::set_data_window(const QRectF &window)
+{
+  data_window_ = window;
+}
+
 const int &OpenGLTexture::width() const
 {
   return width_;
@@ -164,6 +183,8 @@ void OpenGLTexture::Upload(const void *data)
     return;
   }
 
+  Tracer::Scope trace("upload", "OpenGLTexture::Upload");
+
   Bind();
 
   PixelFormatInfo info = PixelService::GetPixelFormatInfo(format_);
@@ -181,6 +202,78 @@ void OpenGLTexture::Upload(const void *data)
   Release();
 }
 
+void OpenGLTexture::CreateCompressed(QOpenGLContext *ctx, int width, int height, const olive::PixelFormat &format)
+{
+  if (ctx == nullptr) {
+    qWarning() << "RenderTexture::CreateCompressed was passed an invalid context";
+    return;
+  }
+
+  Destroy();
+
+  context_ = ctx;
+  width_ = width;
+  height_ = height;
+  format_ = format;
+  compressed_ = true;
+
+  connect(context_, SIGNAL(aboutToBeDestroyed()), this, SLOT(Destroy()));
+
+  QOpenGLFunctions* f = context_->functions();
+
+  f->glGenTextures(1, &texture_);
+  f->glBindTexture(GL_TEXTURE_2D, texture_);
+
+  int size = PixelService::GetCompressedBufferSize(width_, height_);
+
+  f->glCompressedTexImage2D(GL_TEXTURE_2D,
+                            0,
+                            PixelService::GetPixelFormatInfo(format_).compressed_format,
+                            width_,
+                            height_,
+                            0,
+                            size,
+                            nullptr);
+
+  allocated_bytes_ += size;
+  OpenGLMemoryBudget::Allocate(context_, size);
+
+  // There are no mipmaps to blend between
+  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+  f->glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void OpenGLTexture::UploadCompressed(const QByteArray &data)
+{
+  if (!IsCreated() || !compressed_) {
+    qWarning() << "RenderTexture::UploadCompressed() called while it wasn't created compressed";
+    return;
+  }
+
+  Tracer::Scope trace("upload", "OpenGLTexture::UploadCompressed");
+
+  Bind();
+
+  context_->functions()->glCompressedTexSubImage2D(GL_TEXTURE_2D,
+                                                   0,
+                                                   0,
+                                                   0,
+                                                   width_,
+                                                   height_,
+                                                   PixelService::GetPixelFormatInfo(format_).compressed_format,
+                                                   data.size(),
+                                                   data.constData());
+
+  Release();
+}
+
+bool OpenGLTexture::IsCompressed() const
+{
+  return compressed_;
+}
+
 uchar *OpenGLTexture::Download() const
 {
   if (!IsCreated()) {
@@ -215,6 +308,8 @@ uchar *OpenGLTexture::Download() const
 
 void OpenGLTexture::CreateInternal(GLuint* tex, void *data)
 {
+  Tracer::Scope trace("upload", "OpenGLTexture::Create");
+
   QOpenGLFunctions* f = context_->functions();
 
   // Create texture
@@ -244,6 +339,10 @@ void OpenGLTexture::CreateInternal(GLuint* tex, void *data)
         data
         );
 
+  qint64 size = PixelService::GetBufferSize(format_, width_, height_);
+  allocated_bytes_ += size;
+  OpenGLMemoryBudget::Allocate(context_, size);
+
   // Set texture filtering to bilinear
   f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
   f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -23,6 +23,7 @@
 
 #include <memory>
 #include <QOpenGLFunctions>
+#include <QRectF>
 
 #include "common/constructors.h"
 #include "decoder/frame.h"
@@ -70,8 +71,30 @@ public:
 
   void Upload(const void *data);
 
+  /**
+   * @brief Create a texture in `format`'s compressed format (see PixelFormatInfo::compressed_format)
+   *
+   * Compressed textures are only uploaded to with UploadCompressed(), they can't be rendered into or downloaded.
+   */
+  void CreateCompressed(QOpenGLContext* ctx, int width, int height, const olive::PixelFormat &format);
+
+  /**
+   * @brief Upload a frame compressed to this texture's compressed format and size
+   */
+  void UploadCompressed(const QByteArray& data);
+
+  bool IsCompressed() const;
+
   uchar *Download() const;
 
+  /**
+   * @brief Part of this texture that can be non-transparent, in texture coordinates (see Node::GetDataWindow())
+   *
+   * The whole texture unless whatever drew it says otherwise.
+   */
+  const QRectF& data_window() const;
+  void set_data_window(const QRectF& window);
+
 public slots:
   void Destroy();
 
@@ -89,6 +112,15 @@ private:
   int height_;
 
   olive::PixelFormat format_;
+
+  bool compressed_;
+
+  QRectF data_window_;
+
+  /**
+   * @brief Size of this texture (both buffers if double buffered), as reported to OpenGLMemoryBudget
+   */
+  qint64 allocated_bytes_;
 };
 
 using OpenGLTexturePtr = std::shared_ptr<OpenGLTexture>;
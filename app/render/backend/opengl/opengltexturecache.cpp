@@ -0,0 +1,206 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "opengltexturecache.h"
+
+#include <QOpenGLContext>
+
+#include "openglmemorybudget.h"
+#include "render/pixelservice.h"
+
+namespace {
+
+/**
+ * @brief Delete a texture without calling glDeleteTextures() on a thread where its context isn't current
+ *
+ * OpenGLTexturePtrs can be dropped from any thread. Pool textures are created on their context's thread, so if the
+ * context isn't current here, deleteLater() queues the delete back to that thread where it is.
+ */
+void DeleteTexture(OpenGLTexture* texture)
+{
+  if (!texture->IsCreated() || QOpenGLContext::currentContext() == texture->context()) {
+    delete texture;
+  } else {
+    texture->deleteLater();
+  }
+}
+
+}
+
+OpenGLTextureCache::OpenGLTextureCache() :
+  hits_(0),
+  misses_(0),
+  resident_bytes_(0),
+  pressure_generation_(OpenGLMemoryBudget::PressureGeneration())
+{
+}
+
+OpenGLTextureCache::~OpenGLTextureCache()
+{
+  Clear();
+}
+
+OpenGLTexturePtr OpenGLTextureCache::Get(QOpenGLContext *ctx, int width, int height, const olive::PixelFormat &format, const void* data)
+{
+  OpenGLTexture* texture = nullptr;
+
+  lock_.lock();
+
+  int pressure_generation = OpenGLMemoryBudget::PressureGeneration();
+
+  if (pressure_generation != pressure_generation_) {
+    // Something went over the GPU memory budget, give back what we're not using
+    FreeAvailable();
+    pressure_generation_ = pressure_generation;
+  }
+
+  // Look for an unused texture that matches
+  for (int i=0;i<available_.size();i++) {
+    OpenGLTexture* t = available_.at(i);
+
+    if (t->context() == ctx
+        && t->width() == width
+        && t->height() == height
+        && t->format() == format) {
+      texture = available_.takeAt(i);
+      break;
+    }
+  }
+
+  if (texture) {
+    hits_++;
+  } else {
+    misses_++;
+
+    qint64 size = PixelService::GetBufferSize(format, width, height);
+
+    if (OpenGLMemoryBudget::WouldExceed(size)) {
+      // Make room with the textures that don't match before allocating another
+      FreeAvailable();
+    }
+
+    resident_bytes_ += size;
+  }
+
+  lock_.unlock();
+
+  if (texture) {
+    // Whatever it was last used for may have only drawn part of it
+    texture->set_data_window(QRectF(0, 0, 1, 1));
+
+    if (data != nullptr) {
+      texture->Upload(data);
+    }
+  } else {
+    texture = new OpenGLTexture();
+    texture->Create(ctx, width, height, format, const_cast<void*>(data));
+  }
+
+  // When the last reference is dropped, return the texture to the pool rather than deleting it. If the pool no longer
+  // exists by then, just delete it.
+  std::weak_ptr<OpenGLTextureCache> weak_this = shared_from_this();
+
+  return OpenGLTexturePtr(texture, [weak_this](OpenGLTexture* t) {
+    OpenGLTextureCachePtr cache = weak_this.lock();
+
+    if (cache) {
+      cache->Return(t);
+    } else {
+      DeleteTexture(t);
+    }
+  });
+}
+
+OpenGLTexturePtr OpenGLTextureCache::Get(QOpenGLContext *ctx, FramePtr frame)
+{
+  return Get(ctx, frame->width(), frame->height(), frame->format(), frame->data());
+}
+
+void OpenGLTextureCache::Clear()
+{
+  lock_.lock();
+
+  FreeAvailable();
+
+  lock_.unlock();
+}
+
+int OpenGLTextureCache::hits() const
+{
+  lock_.lock();
+
+  int hits = hits_;
+
+  lock_.unlock();
+
+  return hits;
+}
+
+int OpenGLTextureCache::misses() const
+{
+  lock_.lock();
+
+  int misses = misses_;
+
+  lock_.unlock();
+
+  return misses;
+}
+
+qint64 OpenGLTextureCache::resident_bytes() const
+{
+  lock_.lock();
+
+  qint64 resident_bytes = resident_bytes_;
+
+  lock_.unlock();
+
+  return resident_bytes;
+}
+
+void OpenGLTextureCache::Return(OpenGLTexture *texture)
+{
+  lock_.lock();
+
+  if (texture->IsCreated() && available_.size() < kMaximumAvailable) {
+    available_.append(texture);
+  } else {
+    // Either the context was destroyed or we're already holding enough textures
+    Free(texture);
+  }
+
+  lock_.unlock();
+}
+
+void OpenGLTextureCache::Free(OpenGLTexture *texture)
+{
+  resident_bytes_ -= PixelService::GetBufferSize(texture->format(), texture->width(), texture->height());
+
+  DeleteTexture(texture);
+}
+
+void OpenGLTextureCache::FreeAvailable()
+{
+  foreach (OpenGLTexture* t, available_) {
+    Free(t);
+  }
+
+  available_.clear();
+}
@@ -0,0 +1,124 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef OPENGLTEXTURECACHE_H
+#define OPENGLTEXTURECACHE_H
+
+#include <QMutex>
+
+#include "opengltexture.h"
+
+/**
+ * @brief A per-context pool of OpenGLTextures that recycles them instead of freeing them
+ *
+ * Rendering a frame creates a texture for every footage frame and every accelerated node output. Rather than
+ * allocating and freeing these every frame, textures retrieved from Get() return themselves to the pool when the last
+ * OpenGLTexturePtr referencing them is dropped, ready to be reused for the next texture with the same width, height,
+ * and format.
+ *
+ * Textures may be dropped from any thread so returning to the pool is thread-safe, but Get() and Clear() must only be
+ * called from the thread where the pool's context is current. Textures freed from any other thread are deleted on
+ * their context's thread instead, so glDeleteTextures() is never called without their context current.
+ *
+ * When textures go over the GPU memory budget (see OpenGLMemoryBudget), every pool frees its unused textures the next
+ * time Get() is called, and a pool that's about to go over frees them before creating a new one.
+ */
+class OpenGLTextureCache : public std::enable_shared_from_this<OpenGLTextureCache>
+{
+public:
+  OpenGLTextureCache();
+
+  ~OpenGLTextureCache();
+
+  DISABLE_COPY_MOVE(OpenGLTextureCache)
+
+  /**
+   * @brief Retrieve a texture from the pool, creating one if none are available
+   *
+   * If `data` is not nullptr, it's uploaded to the texture.
+   */
+  OpenGLTexturePtr Get(QOpenGLContext* ctx, int width, int height, const olive::PixelFormat& format, const void *data = nullptr);
+
+  /**
+   * @brief Retrieve a texture from the pool matching a frame and upload the frame's data to it
+   */
+  OpenGLTexturePtr Get(QOpenGLContext* ctx, FramePtr frame);
+
+  /**
+   * @brief Free all textures that are currently in the pool (textures still in use are freed when they're dropped)
+   */
+  void Clear();
+
+  /**
+   * @brief Number of times Get() reused a texture from the pool
+   */
+  int hits() const;
+
+  /**
+   * @brief Number of times Get() had to create a new texture
+   */
+  int misses() const;
+
+  /**
+   * @brief Total bytes of video memory allocated by this pool (both in use and waiting to be reused)
+   */
+  qint64 resident_bytes() const;
+
+private:
+  /**
+   * @brief Deleter for OpenGLTexturePtrs created by Get(), returns texture to the pool
+   */
+  void Return(OpenGLTexture* texture);
+
+  /**
+   * @brief Free a texture owned by the pool, on its context's thread if that isn't this one (lock_ must be held)
+   */
+  void Free(OpenGLTexture* texture);
+
+  /**
+   * @brief Free every unused texture (lock_ must be held)
+   */
+  void FreeAvailable();
+
+  /**
+   * @brief Maximum number of unused textures to hold before freeing them
+   */
+  static const int kMaximumAvailable = 32;
+
+  mutable QMutex lock_;
+
+  QList<OpenGLTexture*> available_;
+
+  int hits_;
+
+  int misses_;
+
+  qint64 resident_bytes_;
+
+  /**
+   * @brief OpenGLMemoryBudget::PressureGeneration() when unused textures were last freed for it
+   */
+  int pressure_generation_;
+
+};
+
+using OpenGLTextureCachePtr = std::shared_ptr<OpenGLTextureCache>;
+
+#endif // OPENGLTEXTURECACHE_H
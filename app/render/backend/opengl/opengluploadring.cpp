@@ -0,0 +1,169 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "opengluploadring.h"
+
+// Buffer storage is GL 4.4, newer than the headers we build against may define
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+typedef void (QOPENGLF_APIENTRYP BufferStorageFunc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+OpenGLUploadRing::OpenGLUploadRing() :
+  ctx_(nullptr),
+  next_(0),
+  persistent_(false)
+{
+  for (int i=0;i<kBufferCount;i++) {
+    buffers_[i].buffer = 0;
+    buffers_[i].fence = nullptr;
+    buffers_[i].mapped = nullptr;
+    buffers_[i].size = 0;
+  }
+}
+
+void OpenGLUploadRing::Create(QOpenGLContext *ctx)
+{
+  Destroy();
+
+  ctx_ = ctx;
+
+  for (int i=0;i<kBufferCount;i++) {
+    ctx_->functions()->glGenBuffers(1, &buffers_[i].buffer);
+  }
+
+  persistent_ = PersistentMappingIsSupported();
+  next_ = 0;
+}
+
+void OpenGLUploadRing::Destroy()
+{
+  if (ctx_ == nullptr) {
+    return;
+  }
+
+  QOpenGLExtraFunctions* xf = ctx_->extraFunctions();
+
+  for (int i=0;i<kBufferCount;i++) {
+    if (buffers_[i].fence != nullptr) {
+      xf->glDeleteSync(buffers_[i].fence);
+      buffers_[i].fence = nullptr;
+    }
+
+    if (buffers_[i].mapped != nullptr) {
+      xf->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers_[i].buffer);
+      xf->glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+      xf->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      buffers_[i].mapped = nullptr;
+    }
+
+    xf->glDeleteBuffers(1, &buffers_[i].buffer);
+    buffers_[i].buffer = 0;
+    buffers_[i].size = 0;
+  }
+
+  ctx_ = nullptr;
+}
+
+bool OpenGLUploadRing::IsCreated() const
+{
+  return ctx_ != nullptr;
+}
+
+char *OpenGLUploadRing::Map(int size)
+{
+  Buffer& upload = buffers_[next_];
+  QOpenGLExtraFunctions* xf = ctx_->extraFunctions();
+
+  // If the GPU is still reading this buffer from a previous upload, wait for it before overwriting
+  if (upload.fence != nullptr) {
+    xf->glClientWaitSync(upload.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+    xf->glDeleteSync(upload.fence);
+    upload.fence = nullptr;
+  }
+
+  xf->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.buffer);
+
+  if (persistent_) {
+    if (upload.size < size) {
+      // Immutable storage can't be resized, so replace the buffer
+      if (upload.mapped != nullptr) {
+        xf->glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+      }
+
+      xf->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      xf->glDeleteBuffers(1, &upload.buffer);
+      xf->glGenBuffers(1, &upload.buffer);
+      xf->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.buffer);
+
+      GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+      BufferStorageFunc buffer_storage = reinterpret_cast<BufferStorageFunc>(ctx_->getProcAddress("glBufferStorage"));
+      buffer_storage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+
+      upload.mapped = static_cast<char*>(xf->glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags));
+      upload.size = size;
+    }
+
+    return upload.mapped;
+  }
+
+  // Orphan the old storage so the driver doesn't have to synchronize with it
+  xf->glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+  upload.size = size;
+
+  return static_cast<char*>(xf->glMapBufferRange(GL_PIXEL_UNPACK_BUFFER,
+                                                 0,
+                                                 size,
+                                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+}
+
+void OpenGLUploadRing::Unmap()
+{
+  // Persistent buffers stay mapped, coherent mapping makes our writes visible to the GPU without flushing
+  if (!persistent_) {
+    ctx_->extraFunctions()->glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+  }
+}
+
+void OpenGLUploadRing::Release()
+{
+  QOpenGLExtraFunctions* xf = ctx_->extraFunctions();
+
+  buffers_[next_].fence = xf->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  xf->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  next_ = (next_ + 1) % kBufferCount;
+}
+
+bool OpenGLUploadRing::PersistentMappingIsSupported() const
+{
+  if (ctx_->isOpenGLES()) {
+    return false;
+  }
+
+  return ctx_->format().version() >= qMakePair(4, 4) || ctx_->hasExtension("GL_ARB_buffer_storage");
+}
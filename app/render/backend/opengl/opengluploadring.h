@@ -0,0 +1,97 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef OPENGLUPLOADRING_H
+#define OPENGLUPLOADRING_H
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+
+#include "common/constructors.h"
+
+/**
+ * @brief A ring of pixel unpack buffers that data is staged in on its way to textures
+ *
+ * Uploading from a pixel unpack buffer returns straight away and the copy to the GPU happens asynchronously, so the
+ * caller only pays for copying the data into the buffer. Each buffer is fenced once its uploads are issued, and only
+ * reused once the GPU has finished reading it, so a few uploads can be in flight at once.
+ *
+ * Must only be used in a thread where its context is current.
+ */
+class OpenGLUploadRing
+{
+public:
+  OpenGLUploadRing();
+
+  DISABLE_COPY_MOVE(OpenGLUploadRing)
+
+  /**
+   * @brief Create the buffers in `ctx`, which must be current
+   */
+  void Create(QOpenGLContext* ctx);
+
+  /**
+   * @brief Free the buffers, the context they were created in must be current
+   */
+  void Destroy();
+
+  bool IsCreated() const;
+
+  /**
+   * @brief Bind the next buffer to GL_PIXEL_UNPACK_BUFFER and return a pointer to write `size` bytes into
+   *
+   * Once the data is written, call Unmap(), issue the texture uploads (with offsets into the buffer instead of
+   * pointers) and then Release().
+   */
+  char* Map(int size);
+
+  void Unmap();
+
+  void Release();
+
+private:
+  /**
+   * @brief Returns whether buffers can stay mapped for their whole lifetime (GL 4.4 or ARB_buffer_storage)
+   */
+  bool PersistentMappingIsSupported() const;
+
+  struct Buffer {
+    GLuint buffer;
+    GLsync fence;
+    char* mapped;
+    int size;
+  };
+
+  /**
+   * @brief Number of uploads that can be in flight at once
+   */
+  static const int kBufferCount = 3;
+
+  QOpenGLContext* ctx_;
+
+  Buffer buffers_[kBufferCount];
+
+  int next_;
+
+  bool persistent_;
+
+};
+
+#endif // OPENGLUPLOADRING_H
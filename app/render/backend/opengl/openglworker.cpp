@@ -1,17 +1,39 @@
 #include "openglworker.h"
 
+#include <QOpenGLExtraFunctions>
+#include <QTimer>
+#include <QtMath>
+
+#include "common/tracer.h"
 #include "functions.h"
+#include "node/input/media/video/video.h"
 #include "node/node.h"
+#include "project/item/footage/imagestream.h"
 #include "render/pixelservice.h"
 
-OpenGLWorker::OpenGLWorker(QOpenGLContext *share_ctx, OpenGLShaderCache *shader_cache, DecoderCache *decoder_cache, VideoRenderFrameCache *frame_cache, QObject *parent) :
-  VideoRenderWorker(decoder_cache, frame_cache, parent),
+typedef void (QOPENGLF_APIENTRYP GetCompressedTexImageFunc)(GLenum target, GLint level, void* img);
+
+OpenGLWorker::OpenGLWorker(QOpenGLContext *share_ctx, OpenGLShaderCache *shader_cache, DecoderCache *decoder_cache, VideoRenderFrameCache *frame_cache, VideoRenderFrameWriter *frame_writer, QObject *parent) :
+  VideoRenderWorker(decoder_cache, frame_cache, frame_writer, parent),
   share_ctx_(share_ctx),
   ctx_(nullptr),
   functions_(nullptr),
-  shader_cache_(shader_cache)
+  shader_cache_(shader_cache),
+  yuv_planes_{0, 0, 0},
+  nearest_sampler_(0),
+  max_texture_size_(0),
+  texture_cache_(std::make_shared<OpenGLTextureCache>()),
+  next_download_(0),
+  compress_texture_(0),
+  get_compressed_tex_image_(nullptr)
 {
   surface_.create();
+
+  for (int i=0;i<kDownloadBufferCount;i++) {
+    downloads_[i].buffer = 0;
+    downloads_[i].fence = nullptr;
+    downloads_[i].size = 0;
+  }
 }
 
 OpenGLWorker::~OpenGLWorker()
@@ -19,6 +41,16 @@ OpenGLWorker::~OpenGLWorker()
   surface_.destroy();
 }
 
+bool OpenGLWorker::UsesGPU() const
+{
+  return true;
+}
+
+int OpenGLWorker::MaximumTextureSize() const
+{
+  return max_texture_size_;
+}
+
 bool OpenGLWorker::InitInternal()
 {
   if (!VideoRenderWorker::InitInternal()) {
@@ -47,26 +79,80 @@ bool OpenGLWorker::InitInternal()
   return true;
 }
 
-void OpenGLWorker::FrameToValue(FramePtr frame, NodeValueTable *table)
+void OpenGLWorker::FrameToValue(StreamPtr stream, FramePtr frame, NodeValueTable *table)
 {
-  OpenGLTexturePtr footage_tex = std::make_shared<OpenGLTexture>();
-  footage_tex->Create(ctx_, frame);
+  OpenGLTexturePtr footage_tex;
 
-  // OCIO's CPU conversion is more accurate, so for online we render on CPU but offline we render GPU
-  //if (video_params().mode() == olive::kOnline) {
-    // Convert frame to float for
-    //frame = PixelService::ConvertPixelFormat(frame, olive::PIX_FMT_RGBA32F);
-  //}
+  if (frame->is_yuv()) {
+    // The decoder handed us planar YUV, convert it to RGBA here rather than on the CPU
+    footage_tex = texture_cache_->Get(ctx_, frame->width(), frame->height(), frame->format());
+    ConvertYUVFrame(frame, footage_tex);
+  } else {
+    footage_tex = texture_cache_->Get(ctx_, frame->width(), frame->height(), frame->format());
 
-  // FIXME: Alpha association and color management
+    int size = PixelService::GetBufferSize(static_cast<olive::PixelFormat>(frame->format()),
+                                           frame->width(),
+                                           frame->height());
+
+    memcpy(uploads_.Map(size), frame->data(), static_cast<size_t>(size));
+    uploads_.Unmap();
+
+    // With an unpack buffer bound, this is an offset into it rather than a pointer
+    footage_tex->Upload(nullptr);
+
+    uploads_.Release();
+  }
+
+  if (stream && (stream->type() == Stream::kVideo || stream->type() == Stream::kImage)) {
+    ImageStreamPtr image_stream = std::static_pointer_cast<ImageStream>(stream);
+
+    if (!image_stream->colorspace().isEmpty()) {
+      footage_tex = ConvertToReferenceSpace(footage_tex,
+                                            image_stream->colorspace(),
+                                            image_stream->premultiplied_alpha());
+    }
+  }
+
+  // FIXME: Alpha association for footage without a colorspace set
 
   table->Push(NodeParam::kTexture, QVariant::fromValue(footage_tex));
 }
 
 void OpenGLWorker::CloseInternal()
 {
+  if (functions_ != nullptr) {
+    // Save any frames that are still downloading and free the buffers
+    for (int i=0;i<kDownloadBufferCount;i++) {
+      if (downloads_[i].fence != nullptr) {
+        FinishDownload(downloads_[i]);
+      }
+
+      functions_->glDeleteBuffers(1, &downloads_[i].buffer);
+      downloads_[i].buffer = 0;
+    }
+
+    uploads_.Destroy();
+  }
+
   buffer_.Destroy();
 
+  texture_cache_->Clear();
+
+  yuv_shader_ = nullptr;
+
+  if (functions_ != nullptr) {
+    functions_->glDeleteTextures(3, yuv_planes_);
+    functions_->glDeleteTextures(1, &compress_texture_);
+    ctx_->extraFunctions()->glDeleteSamplers(1, &nearest_sampler_);
+  }
+
+  nearest_sampler_ = 0;
+  compress_texture_ = 0;
+
+  for (int i=0;i<3;i++) {
+    yuv_planes_[i] = 0;
+  }
+
   functions_ = nullptr;
   delete ctx_;
 }
@@ -74,118 +160,655 @@ void OpenGLWorker::CloseInternal()
 void OpenGLWorker::ParametersChangedEvent()
 {
   if (functions_ != nullptr && video_params().is_valid()) {
-    functions_->glViewport(0, 0, video_params().effective_width(), video_params().effective_height());
+    functions_->glViewport(0, 0, tile().width(), tile().height());
   }
 }
 
-void OpenGLWorker::RunNodeAccelerated(Node *node, const NodeValueDatabase *input_params, NodeValueTable *output_params)
+void OpenGLWorker::FrameFinishedEvent()
+{
+  // Wait once for the whole frame rather than after every node. This makes the result visible to the other contexts
+  // (the viewer and the other workers) without stalling between nodes.
+  QOpenGLExtraFunctions* xf = ctx_->extraFunctions();
+
+  GLsync fence = xf->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  xf->glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+  xf->glDeleteSync(fence);
+}
+
+bool OpenGLWorker::InputIsFused(NodeInput *input)
+{
+  return shader_cache_->InputIsFused(input);
+}
+
+void OpenGLWorker::SiblingFinishedEvent()
 {
-  OpenGLShaderPtr shader = shader_cache_->GetShader(node);
+  // The worker that forked this branch will read our textures from its own context
+  FrameFinishedEvent();
+}
+
+void OpenGLWorker::Download(NodeDependency dep, QByteArray hash, QVariant texture)
+{
+  OpenGLTexturePtr tex = texture.value<OpenGLTexturePtr>();
+
+  PendingDownload& download = downloads_[next_download_];
+  next_download_ = (next_download_ + 1) % kDownloadBufferCount;
+
+  // If every buffer is still in flight, the oldest has to finish before we can reuse it
+  if (download.fence != nullptr) {
+    FinishDownload(download);
+  }
+
+  // Hold a reference so the texture isn't recycled until the readback is done
+  download.texture = tex;
+  download.dep = dep;
+  download.hash = hash;
+  download.size = PixelService::GetBufferSize(video_params().format(), tex->width(), tex->height());
+  download.width = tex->width();
+  download.height = tex->height();
+
+  PixelFormatInfo format_info = PixelService::GetPixelFormatInfo(video_params().format());
+
+  // Read the texture into the pixel buffer object, this returns immediately
+  functions_->glBindBuffer(GL_PIXEL_PACK_BUFFER, download.buffer);
+  functions_->glBufferData(GL_PIXEL_PACK_BUFFER, download.size, nullptr, GL_STREAM_READ);
+
+  buffer_.Attach(tex);
+  functions_->glBindFramebuffer(GL_READ_FRAMEBUFFER, buffer_.buffer());
+
+  functions_->glReadPixels(0,
+                           0,
+                           tex->width(),
+                           tex->height(),
+                           format_info.pixel_format,
+                           format_info.gl_pixel_type,
+                           nullptr);
+
+  functions_->glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+  buffer_.Detach();
+
+  functions_->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  download.fence = ctx_->extraFunctions()->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  // Make sure the readback actually gets submitted
+  functions_->glFlush();
+
+  QMetaObject::invokeMethod(this, "ProcessPendingDownloads", Qt::QueuedConnection);
+}
+
+void OpenGLWorker::FinishDownload(OpenGLWorker::PendingDownload &download)
+{
+  working_++;
+
+  QOpenGLExtraFunctions* xf = ctx_->extraFunctions();
+
+  xf->glClientWaitSync(download.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+  xf->glDeleteSync(download.fence);
+  download.fence = nullptr;
+  download.texture = nullptr;
+
+  QByteArray compressed;
+
+  if (CompressesMemoryFrames()) {
+    compressed = CompressDownload(download);
+  }
+
+  QByteArray frame(download.size, Qt::Uninitialized);
+
+  xf->glBindBuffer(GL_PIXEL_PACK_BUFFER, download.buffer);
+
+  void* mapped = xf->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, download.size, GL_MAP_READ_BIT);
+
+  if (mapped != nullptr) {
+    memcpy(frame.data(), mapped, static_cast<size_t>(download.size));
+    xf->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+
+  xf->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  if (mapped != nullptr) {
+    SaveFrameToCache(download.dep, download.hash, frame, compressed);
+  } else {
+    qWarning() << "Failed to map pixel buffer for" << download.hash.toHex();
+  }
+
+  working_--;
+}
+
+QByteArray OpenGLWorker::CompressDownload(const OpenGLWorker::PendingDownload &download)
+{
+  Tracer::Scope trace("readback", "CompressDownload");
+
+  PixelFormatInfo format_info = PixelService::GetPixelFormatInfo(video_params().format());
+
+  if (get_compressed_tex_image_ == nullptr || format_info.compressed_format == 0) {
+    return QByteArray();
+  }
+
+  QOpenGLExtraFunctions* xf = ctx_->extraFunctions();
+
+  if (compress_texture_ == 0) {
+    xf->glGenTextures(1, &compress_texture_);
+  }
+
+  xf->glBindTexture(GL_TEXTURE_2D, compress_texture_);
+
+  // The readback is still in the pixel buffer, so the driver can compress it without it going through the CPU first
+  xf->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, download.buffer);
+
+  xf->glTexImage2D(GL_TEXTURE_2D,
+                   0,
+                   static_cast<GLint>(format_info.compressed_format),
+                   download.width,
+                   download.height,
+                   0,
+                   format_info.pixel_format,
+                   format_info.gl_pixel_type,
+                   nullptr);
+
+  xf->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  GLint is_compressed = GL_FALSE;
+  GLint compressed_size = 0;
+
+  xf->glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &is_compressed);
+
+  if (is_compressed == GL_TRUE) {
+    xf->glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &compressed_size);
+  }
+
+  QByteArray compressed;
+
+  // Anything else means the driver stored it some other way, which the viewer wouldn't know how to upload
+  if (compressed_size == PixelService::GetCompressedBufferSize(download.width, download.height)) {
+    compressed.resize(compressed_size);
+    get_compressed_tex_image_(GL_TEXTURE_2D, 0, compressed.data());
+  }
+
+  xf->glBindTexture(GL_TEXTURE_2D, 0);
+
+  return compressed;
+}
+
+void OpenGLWorker::ProcessPendingDownloads()
+{
+  QOpenGLExtraFunctions* xf = ctx_->extraFunctions();
+
+  bool still_pending = false;
+
+  for (int i=0;i<kDownloadBufferCount;i++) {
+    PendingDownload& download = downloads_[i];
+
+    if (download.fence == nullptr) {
+      continue;
+    }
+
+    // Poll the fence without blocking
+    if (xf->glClientWaitSync(download.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+      still_pending = true;
+    } else {
+      FinishDownload(download);
+    }
+  }
+
+  if (still_pending) {
+    QTimer::singleShot(1, this, SLOT(ProcessPendingDownloads()));
+  }
+}
+
+void OpenGLWorker::DecoderCreatedEvent(DecoderPtr decoder)
+{
+  // We can do the YUV to RGB conversion in ConvertYUVFrame()
+  decoder->set_planar_yuv_output(true);
+}
+
+OpenGLTexturePtr OpenGLWorker::ConvertToReferenceSpace(OpenGLTexturePtr footage_tex,
+                                                       const QString &colorspace,
+                                                       bool alpha_is_associated)
+{
+  OCIO::ConstConfigRcPtr config = OCIO::GetCurrentConfig();
+  OCIO::ConstColorSpaceRcPtr reference = config->getColorSpace(OCIO::ROLE_SCENE_LINEAR);
+
+  // Footage that's already in the reference space needs no conversion
+  if (reference == nullptr || colorspace == reference->getName()) {
+    return footage_tex;
+  }
+
+  GLuint lut;
+  OpenGLShaderPtr shader = shader_cache_->GetColorProgram(ctx_, colorspace, OCIO::ROLE_SCENE_LINEAR,
+                                                          alpha_is_associated, &lut);
 
   if (!shader) {
-    return;
+    return footage_tex;
   }
 
-  // Create the output texture
-  OpenGLTexturePtr output = std::make_shared<OpenGLTexture>();
-  output->Create(ctx_, video_params().effective_width(), video_params().effective_height(), video_params().format());
+  // Converted footage is scene-linear so it's stored in the render's format rather than the (possibly 8-bit) source's
+  OpenGLTexturePtr output = texture_cache_->Get(ctx_, footage_tex->width(), footage_tex->height(), video_params().format());
+
+  functions_->glViewport(0, 0, output->width(), output->height());
 
   buffer_.Attach(output);
+  buffer_.Bind();
+
+  footage_tex->Bind();
+
+  olive::gl::OCIOBlit(shader, lut);
+
+  footage_tex->Release();
+
+  buffer_.Release();
+  buffer_.Detach();
+
+  ParametersChangedEvent();
+
+  return output;
+}
+
+void OpenGLWorker::ConvertYUVFrame(FramePtr frame, OpenGLTexturePtr output)
+{
+  // Stage all three planes in one upload buffer
+  int plane_offsets[3];
+  int total_size = 0;
+
+  for (int i=0;i<3;i++) {
+    plane_offsets[i] = total_size;
+    total_size += frame->plane_width(i) * frame->plane_height(i);
+  }
+
+  char* staging = uploads_.Map(total_size);
+
+  for (int i=0;i<3;i++) {
+    memcpy(staging + plane_offsets[i],
+           frame->plane_data(i),
+           static_cast<size_t>(frame->plane_width(i) * frame->plane_height(i)));
+  }
+
+  uploads_.Unmap();
 
+  // Planes are tightly packed so their line sizes may not be a multiple of 4
+  functions_->glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  for (int i=0;i<3;i++) {
+    functions_->glActiveTexture(GL_TEXTURE0 + i);
+    functions_->glBindTexture(GL_TEXTURE_2D, yuv_planes_[i]);
+
+    functions_->glTexImage2D(GL_TEXTURE_2D,
+                             0,
+                             GL_R8,
+                             frame->plane_width(i),
+                             frame->plane_height(i),
+                             0,
+                             GL_RED,
+                             GL_UNSIGNED_BYTE,
+                             reinterpret_cast<const void*>(static_cast<quintptr>(plane_offsets[i])));
+
+    // Bilinear filtering on the chroma planes performs the chroma upsampling
+    functions_->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    functions_->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    functions_->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    functions_->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  }
+
+  functions_->glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  uploads_.Release();
+
+  QVector3D offset;
+  QMatrix3x3 matrix = GetYUVMatrix(frame->yuv_colorspace(), frame->yuv_full_range(), &offset);
+
+  // The footage texture is the frame's size, which may not match the render size
+  functions_->glViewport(0, 0, output->width(), output->height());
+
+  buffer_.Attach(output);
   buffer_.Bind();
 
+  yuv_shader_->bind();
+  yuv_shader_->setUniformValue("y_plane", 0);
+  yuv_shader_->setUniformValue("u_plane", 1);
+  yuv_shader_->setUniformValue("v_plane", 2);
+  yuv_shader_->setUniformValue("yuv_matrix", matrix);
+  yuv_shader_->setUniformValue("yuv_offset", offset);
+
+  olive::gl::Blit(yuv_shader_);
+
+  // Release plane textures
+  for (int i=2;i>=0;i--) {
+    functions_->glActiveTexture(GL_TEXTURE0 + i);
+    functions_->glBindTexture(GL_TEXTURE_2D, 0);
+  }
+
+  yuv_shader_->release();
+
+  buffer_.Release();
+  buffer_.Detach();
+
+  // Restore viewport
+  ParametersChangedEvent();
+}
+
+QMatrix3x3 OpenGLWorker::GetYUVMatrix(Frame::YUVColorspace colorspace, bool full_range, QVector3D *offset)
+{
+  // Luma coefficients
+  float kr, kb;
+
+  switch (colorspace) {
+  case Frame::kYUVBT709:
+    kr = 0.2126f;
+    kb = 0.0722f;
+    break;
+  case Frame::kYUVBT2020:
+    kr = 0.2627f;
+    kb = 0.0593f;
+    break;
+  case Frame::kYUVBT601:
+  case Frame::kYUVNone:
+  default:
+    kr = 0.299f;
+    kb = 0.114f;
+  }
+
+  float kg = 1.0f - kr - kb;
+
+  // Scale broadcast range (16-235 luma, 16-240 chroma) up to full range
+  float y_scale, c_scale;
+
+  if (full_range) {
+    y_scale = 1.0f;
+    c_scale = 1.0f;
+    *offset = QVector3D(0.0f, 128.0f / 255.0f, 128.0f / 255.0f);
+  } else {
+    y_scale = 255.0f / 219.0f;
+    c_scale = 255.0f / 224.0f;
+    *offset = QVector3D(16.0f / 255.0f, 128.0f / 255.0f, 128.0f / 255.0f);
+  }
+
+  // Row-major
+  const float values[] = {
+    y_scale, 0.0f,                                   c_scale * 2.0f * (1.0f - kr),
+    y_scale, c_scale * -2.0f * kb * (1.0f - kb) / kg, c_scale * -2.0f * kr * (1.0f - kr) / kg,
+    y_scale, c_scale * 2.0f * (1.0f - kb),           0.0f
+  };
+
+  return QMatrix3x3(values);
+}
+
+void OpenGLWorker::RunNodeAccelerated(Node *node, const NodeValueDatabase *input_params, NodeValueTable *output_params)
+{
+  Tracer::Scope trace("draw", node->id());
+
+  // If other nodes are fused into this one, their inputs are set too (with a prefix for each stage)
+  OpenGLShaderPtr shader;
+  QList<Node*> stages;
+  bool fused = shader_cache_->GetFusedProgram(node, &shader, &stages);
+
+  if (!fused) {
+    shader = shader_cache_->GetShader(node);
+    stages.append(node);
+  }
+
+  if (!shader) {
+    return;
+  }
+
+  // Programs are linked in the background, a node that failed to link outputs nothing like one without a shader
+  if (!shader->WaitUntilReady()) {
+    return;
+  }
+
+  bool is_compute = shader->IsCompute();
+
+  QSize output_size = tile().size();
+
+  if (is_compute) {
+    // Compute shaders may output something other than a frame (e.g. a histogram)
+    output_size = node->ComputeOutputSize(output_size);
+  }
+
+  // Footage that's only moved by whole pixels doesn't need resampling (see VideoInput::MatrixIsPixelAligned())
+  OpenGLTexturePtr aligned_footage;
+  VideoInput* video_input = dynamic_cast<VideoInput*>(node);
+
+  if (video_input) {
+    OpenGLTexturePtr footage = (*input_params)["footage_in"].Get(NodeParam::kTexture).value<OpenGLTexturePtr>();
+    QMatrix4x4 matrix = (*input_params)["matrix_in"].Get(NodeParam::kMatrix).value<QMatrix4x4>();
+    QPoint offset;
+
+    if (footage
+        && footage->width() == video_params().effective_width()
+        && footage->height() == video_params().effective_height()
+        && VideoInput::MatrixIsPixelAligned(matrix, footage->width(), footage->height(), &offset)) {
+      if (offset.isNull() && tile().width() == footage->width() && tile().height() == footage->height()) {
+        // Drawing it would only copy it
+        output_params->Push(NodeParam::kTexture, QVariant::fromValue(footage));
+        return;
+      }
+
+      // Sampled without interpolation below, so the draw is an exact copy rather than a blur
+      aligned_footage = footage;
+    }
+  }
+
+  // Only the pixels the output can be non-transparent in need drawing (see Node::GetDataWindow())
+  QRect pixel_window(QPoint(0, 0), output_size);
+
+  if (!is_compute) {
+    QRectF tile_window(static_cast<qreal>(tile().x()) / video_params().effective_width(),
+                       static_cast<qreal>(tile().y()) / video_params().effective_height(),
+                       static_cast<qreal>(tile().width()) / video_params().effective_width(),
+                       static_cast<qreal>(tile().height()) / video_params().effective_height());
+
+    QRectF window = GetDataWindow(stages, input_params, tile_window);
+
+    pixel_window &= QRect(QPoint(qFloor(window.left() * output_size.width()),
+                                 qFloor(window.top() * output_size.height())),
+                          QPoint(qCeil(window.right() * output_size.width()) - 1,
+                                 qCeil(window.bottom() * output_size.height()) - 1));
+
+    if (pixel_window.isEmpty()) {
+      // Fully transparent, which is the same as no texture at all
+      return;
+    }
+  }
+
+  bool scissored = (pixel_window.size() != output_size);
+
+  // Constants have to be drawn into a texture for shaders that can't take them as a uniform, and that has to happen
+  // before we start drawing into the output
+  QHash<NodeInput*, OpenGLTexturePtr> constant_textures;
+
+  for (int i=0;i<stages.size();i++) {
+    const QList<NodeParam*>& params = stages.at(i)->parameters();
+
+    for (int j=0;j<params.size();j++) {
+      NodeParam* param = params.at(j);
+      int switch_location;
+      QVector4D constant;
+
+      if (param->type() == NodeParam::kInput
+          && shader->InputLocation(i, j) > -1
+          && shader->ConstantLocation(i, j, &switch_location) == -1) {
+        NodeInput* input = static_cast<NodeInput*>(param);
+
+        if (NodeValue::IsConstantTexture((*input_params)[input].Get(NodeParam::kTexture), &constant)) {
+          constant_textures.insert(input, CreateConstantTexture(constant).value<OpenGLTexturePtr>());
+        }
+      }
+    }
+  }
+
+  // Get an output texture
+  OpenGLTexturePtr output = texture_cache_->Get(ctx_,
+                                                output_size.width(),
+                                                output_size.height(),
+                                                GetOutputFormat(stages, input_params));
+
+  if (!is_compute) {
+    buffer_.Attach(output);
+
+    buffer_.Bind();
+
+    if (scissored) {
+      // Clearing is far cheaper than running the shader over the rest of the frame
+      functions_->glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+      functions_->glClear(GL_COLOR_BUFFER_BIT);
+
+      functions_->glEnable(GL_SCISSOR_TEST);
+      functions_->glScissor(pixel_window.x(), pixel_window.y(), pixel_window.width(), pixel_window.height());
+    }
+
+    output->set_data_window(QRectF(static_cast<qreal>(pixel_window.x()) / output_size.width(),
+                                   static_cast<qreal>(pixel_window.y()) / output_size.height(),
+                                   static_cast<qreal>(pixel_window.width()) / output_size.width(),
+                                   static_cast<qreal>(pixel_window.height()) / output_size.height()));
+  }
+
   shader->bind();
 
   unsigned int input_texture_count = 0;
 
-  foreach (NodeParam* param, node->parameters()) {
-    if (param->type() == NodeParam::kInput) {
-      // See if the shader has takes this parameter as an input
-      int variable_location = shader->uniformLocation(param->id());
+  for (int i=0;i<stages.size();i++) {
+    const QList<NodeParam*>& params = stages.at(i)->parameters();
 
-      if (variable_location > -1) {
-        // This variable is used in the shader, let's set it to our value
+    for (int j=0;j<params.size();j++) {
+      NodeParam* param = params.at(j);
 
+      if (param->type() == NodeParam::kInput) {
         NodeInput* input = static_cast<NodeInput*>(param);
 
-        // Get value from database at this input
-        const NodeValueTable& input_data = (*input_params)[input];
+        // See if the shader has takes this parameter as an input (locations are looked up when compiling). Inputs
+        // from an earlier fused stage are already in the shader, so they don't have one.
+        int variable_location = shader->InputLocation(i, j);
 
-        NodeParam::DataType find_data_type = input->data_type();
+        if (variable_location > -1) {
+          // This variable is used in the shader, let's set it to our value
 
-        // Exception for Footage types (try to get a Texture instead)
-        if (find_data_type == NodeParam::kFootage) {
-          find_data_type = NodeParam::kTexture;
-        }
+          // Get value from database at this input
+          const NodeValueTable& input_data = (*input_params)[input];
 
-        // Try to get a value from it
-        QVariant value = input_data.Get(find_data_type);
-
-        switch (input->data_type()) {
-        case NodeInput::kInt:
-          shader->setUniformValue(variable_location, value.toInt());
-          break;
-        case NodeInput::kFloat:
-          shader->setUniformValue(variable_location, value.toFloat());
-          break;
-        case NodeInput::kVec2:
-          shader->setUniformValue(variable_location, value.value<QVector2D>());
-          break;
-        case NodeInput::kVec3:
-          shader->setUniformValue(variable_location, value.value<QVector3D>());
-          break;
-        case NodeInput::kVec4:
-          shader->setUniformValue(variable_location, value.value<QVector4D>());
-          break;
-        case NodeInput::kMatrix:
-          shader->setUniformValue(variable_location, value.value<QMatrix4x4>());
-          break;
-        case NodeInput::kColor:
-          shader->setUniformValue(variable_location, value.value<QColor>());
-          break;
-        case NodeInput::kBoolean:
-          shader->setUniformValue(variable_location, value.toBool());
-          break;
-        case NodeInput::kFootage:
-        case NodeInput::kTexture:
-        {
-          OpenGLTexturePtr texture = value.value<OpenGLTexturePtr>();
-
-          functions_->glActiveTexture(GL_TEXTURE0 + input_texture_count);
-
-          if (texture) {
-            functions_->glBindTexture(GL_TEXTURE_2D, texture->texture());
-          } else {
-            functions_->glBindTexture(GL_TEXTURE_2D, 0);
+          NodeParam::DataType find_data_type = input->data_type();
+
+          // Exception for Footage types (try to get a Texture instead)
+          if (find_data_type == NodeParam::kFootage) {
+            find_data_type = NodeParam::kTexture;
           }
 
-          // Set value to bound texture
-          shader->setUniformValue(variable_location, input_texture_count);
+          // Try to get a value from it
+          QVariant value = input_data.Get(find_data_type);
 
-          input_texture_count++;
-          break;
-        }
-        case NodeInput::kSamples:
-        case NodeInput::kText:
-        case NodeInput::kRational:
-        case NodeInput::kFont:
-        case NodeInput::kFile:
-        case NodeInput::kDecimal:
-        case NodeInput::kWholeNumber:
-        case NodeInput::kNumber:
-        case NodeInput::kString:
-        case NodeInput::kBuffer:
-        case NodeInput::kVector:
-        case NodeInput::kNone:
-        case NodeInput::kAny:
-          break;
+          switch (input->data_type()) {
+          case NodeInput::kInt:
+            shader->setUniformValue(variable_location, value.toInt());
+            break;
+          case NodeInput::kFloat:
+            shader->setUniformValue(variable_location, value.toFloat());
+            break;
+          case NodeInput::kVec2:
+            shader->setUniformValue(variable_location, value.value<QVector2D>());
+            break;
+          case NodeInput::kVec3:
+            shader->setUniformValue(variable_location, value.value<QVector3D>());
+            break;
+          case NodeInput::kVec4:
+            shader->setUniformValue(variable_location, value.value<QVector4D>());
+            break;
+          case NodeInput::kMatrix:
+            if (video_input && input == video_input->matrix_input()) {
+              // Footage is always the whole frame, even when rendering a tile of it
+              shader->setUniformValue(variable_location, TileToFrameMatrix() * value.value<QMatrix4x4>());
+            } else {
+              shader->setUniformValue(variable_location, value.value<QMatrix4x4>());
+            }
+            break;
+          case NodeInput::kColor:
+            shader->setUniformValue(variable_location, value.value<QColor>());
+            break;
+          case NodeInput::kBoolean:
+            shader->setUniformValue(variable_location, value.toBool());
+            break;
+          case NodeInput::kFootage:
+          case NodeInput::kTexture:
+          {
+            OpenGLTexturePtr texture = value.value<OpenGLTexturePtr>();
+            QVector4D constant;
+            bool is_constant = NodeValue::IsConstantTexture(value, &constant);
+            int switch_location;
+            int constant_location = shader->ConstantLocation(i, j, &switch_location);
+
+            if (constant_location > -1) {
+              // A missing texture is the same as a transparent constant, which saves sampling an unbound texture
+              shader->setUniformValue(constant_location, constant);
+              shader->setUniformValue(switch_location, is_constant || !texture);
+            } else if (is_constant) {
+              texture = constant_textures.value(input);
+            }
+
+            functions_->glActiveTexture(GL_TEXTURE0 + input_texture_count);
+
+            if (texture) {
+              functions_->glBindTexture(GL_TEXTURE_2D, texture->texture());
+
+              // A sampler overrides the texture's own filtering, which olive::gl::Blit() resets
+              if (texture == aligned_footage) {
+                ctx_->extraFunctions()->glBindSampler(input_texture_count, nearest_sampler_);
+              }
+            } else {
+              functions_->glBindTexture(GL_TEXTURE_2D, 0);
+            }
+
+            // Set value to bound texture
+            shader->setUniformValue(variable_location, input_texture_count);
+
+            input_texture_count++;
+            break;
+          }
+          case NodeInput::kSamples:
+          case NodeInput::kText:
+          case NodeInput::kRational:
+          case NodeInput::kFont:
+          case NodeInput::kFile:
+          case NodeInput::kDecimal:
+          case NodeInput::kWholeNumber:
+          case NodeInput::kNumber:
+          case NodeInput::kString:
+          case NodeInput::kBuffer:
+          case NodeInput::kVector:
+          case NodeInput::kNone:
+          case NodeInput::kAny:
+            break;
+          }
         }
       }
     }
   }
 
-  //qDebug() << "    Blitting with shader!";
-  olive::gl::Blit(shader);
+  if (is_compute) {
+    QOpenGLExtraFunctions* xf = ctx_->extraFunctions();
+
+    xf->glBindImageTexture(0,
+                           output->texture(),
+                           0,
+                           GL_FALSE,
+                           0,
+                           GL_WRITE_ONLY,
+                           static_cast<GLenum>(PixelService::GetPixelFormatInfo(output->format()).internal_format));
+
+    // One invocation per output pixel
+    xf->glDispatchCompute(static_cast<GLuint>((output_size.width() + shader->work_group_width() - 1) / shader->work_group_width()),
+                          static_cast<GLuint>((output_size.height() + shader->work_group_height() - 1) / shader->work_group_height()),
+                          1);
+
+    // Make the writes visible to whatever samples this texture next
+    xf->glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+    xf->glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+  } else {
+    //qDebug() << "    Blitting with shader!";
+    olive::gl::Blit(shader);
+
+    if (scissored) {
+      functions_->glDisable(GL_SCISSOR_TEST);
+    }
+  }
 
   // Release any textures we bound before
   while (input_texture_count > 0) {
@@ -194,21 +817,177 @@ void OpenGLWorker::RunNodeAccelerated(Node *node, const NodeValueDatabase *input
     // Release texture here
     functions_->glActiveTexture(GL_TEXTURE0 + input_texture_count);
     functions_->glBindTexture(GL_TEXTURE_2D, 0);
+
+    if (aligned_footage) {
+      ctx_->extraFunctions()->glBindSampler(input_texture_count, 0);
+    }
   }
 
   shader->release();
 
-  buffer_.Release();
-
-  buffer_.Detach();
+  if (!is_compute) {
+    buffer_.Release();
 
-  functions_->glFinish();
+    buffer_.Detach();
+  }
 
   output_params->Push(NodeParam::kTexture, QVariant::fromValue(output));
 }
 
+olive::PixelFormat OpenGLWorker::GetOutputFormat(const QList<Node *> &stages, const NodeValueDatabase *input_params)
+{
+  olive::PixelFormat frame_format = video_params().format();
+  bool from_inputs = true;
+
+  foreach (Node* stage, stages) {
+    Node::Precision precision = stage->OutputPrecision();
+
+    if (precision == Node::kPrecisionFull) {
+      return olive::PIX_FMT_RGBA32F;
+    } else if (precision == Node::kPrecisionFrame) {
+      from_inputs = false;
+    }
+  }
+
+  if (!from_inputs) {
+    return frame_format;
+  }
+
+  // Formats are in order of precision, so the widest is the highest
+  olive::PixelFormat widest = olive::PIX_FMT_INVALID;
+
+  for (int i=0;i<stages.size();i++) {
+    foreach (NodeParam* param, stages.at(i)->parameters()) {
+      if (param->type() != NodeParam::kInput) {
+        continue;
+      }
+
+      NodeInput* input = static_cast<NodeInput*>(param);
+
+      if ((input->data_type() != NodeParam::kTexture && input->data_type() != NodeParam::kFootage)
+          || stages.indexOf(input->get_connected_node()) > -1) {
+        continue;
+      }
+
+      QVariant value = (*input_params)[input].Get(NodeParam::kTexture);
+
+      if (NodeValue::IsConstantTexture(value)) {
+        return frame_format;
+      }
+
+      OpenGLTexturePtr texture = value.value<OpenGLTexturePtr>();
+
+      if (texture) {
+        widest = qMax(widest, texture->format());
+      }
+    }
+  }
+
+  if (widest == olive::PIX_FMT_INVALID) {
+    // Nothing to take the precision from
+    return frame_format;
+  }
+
+  return qMin(widest, frame_format);
+}
+
+QRectF OpenGLWorker::GetDataWindow(const QList<Node *> &stages, const NodeValueDatabase *input_params, const QRectF& tile)
+{
+  const QRectF frame(0, 0, 1, 1);
+  QVector<QRectF> stage_windows(stages.size());
+
+  for (int i=0;i<stages.size();i++) {
+    QHash<NodeInput*, QRectF> input_windows;
+
+    foreach (NodeParam* param, stages.at(i)->parameters()) {
+      if (param->type() != NodeParam::kInput) {
+        continue;
+      }
+
+      NodeInput* input = static_cast<NodeInput*>(param);
+
+      if (input->data_type() != NodeParam::kTexture && input->data_type() != NodeParam::kFootage) {
+        continue;
+      }
+
+      int earlier_stage = stages.indexOf(input->get_connected_node());
+
+      if (input->IsConnected() && earlier_stage >= 0 && earlier_stage < i) {
+        input_windows.insert(input, stage_windows.at(earlier_stage));
+        continue;
+      }
+
+      QVariant value = (*input_params)[input].Get(NodeParam::kTexture);
+      OpenGLTexturePtr texture = value.value<OpenGLTexturePtr>();
+      QVector4D constant;
+
+      if (texture && input->data_type() == NodeParam::kFootage) {
+        // Footage isn't tiled, its window is already in its own coordinates
+        input_windows.insert(input, texture->data_window());
+      } else if (texture) {
+        QRectF window = texture->data_window();
+
+        input_windows.insert(input, QRectF(tile.x() + window.x() * tile.width(),
+                                           tile.y() + window.y() * tile.height(),
+                                           window.width() * tile.width(),
+                                           window.height() * tile.height()));
+      } else if (NodeValue::IsConstantTexture(value, &constant) && !constant.isNull()) {
+        input_windows.insert(input, frame);
+      }
+    }
+
+    stage_windows[i] = stages.at(i)->GetDataWindow(*input_params, input_windows) & frame;
+  }
+
+  const QRectF& window = stage_windows.last();
+
+  if (window.isEmpty()) {
+    return QRectF();
+  }
+
+  return QRectF((window.x() - tile.x()) / tile.width(),
+                (window.y() - tile.y()) / tile.height(),
+                window.width() / tile.width(),
+                window.height() / tile.height()) & frame;
+}
+
+QMatrix4x4 OpenGLWorker::TileToFrameMatrix()
+{
+  float width = video_params().effective_width();
+  float height = video_params().effective_height();
+
+  // Coordinates are row vectors (see VideoInput::Code()), so the offset is in the bottom row
+  return QMatrix4x4(tile().width() / width, 0.0f,                     0.0f, 0.0f,
+                    0.0f,                   tile().height() / height, 0.0f, 0.0f,
+                    0.0f,                   0.0f,                     1.0f, 0.0f,
+                    tile().x() / width,     tile().y() / height,      0.0f, 1.0f);
+}
+
+QVariant OpenGLWorker::CreateConstantTexture(const QVector4D &color)
+{
+  OpenGLTexturePtr texture = texture_cache_->Get(ctx_,
+                                                 tile().width(),
+                                                 tile().height(),
+                                                 video_params().format());
+
+  // Clearing fills the texture without a shader pass
+  buffer_.Attach(texture);
+  buffer_.Bind();
+
+  functions_->glClearColor(color.x(), color.y(), color.z(), color.w());
+  functions_->glClear(GL_COLOR_BUFFER_BIT);
+
+  buffer_.Release();
+  buffer_.Detach();
+
+  return QVariant::fromValue(texture);
+}
+
 void OpenGLWorker::TextureToBuffer(const QVariant &tex_in, QByteArray &buffer)
 {
+  // Also waits for the GPU to finish rendering the texture
+  Tracer::Scope trace("readback", "TextureToBuffer");
+
   OpenGLTexturePtr texture = tex_in.value<OpenGLTexturePtr>();
 
   PixelFormatInfo format_info = PixelService::GetPixelFormatInfo(video_params().format());
@@ -245,4 +1024,33 @@ void OpenGLWorker::FinishInit()
   ParametersChangedEvent();
 
   buffer_.Create(ctx_);
+
+  // Set up YUV to RGB conversion
+  yuv_shader_ = OpenGLShader::CreateYUVToRGB();
+  functions_->glGenTextures(3, yuv_planes_);
+
+  // Set up pixel buffer objects for asynchronous downloads
+  for (int i=0;i<kDownloadBufferCount;i++) {
+    functions_->glGenBuffers(1, &downloads_[i].buffer);
+  }
+
+  // Set up pixel buffer objects for asynchronous uploads
+  uploads_.Create(ctx_);
+
+  // BPTC is core since 4.2
+  if (ctx_->format().version() >= qMakePair(4, 2) || ctx_->hasExtension("GL_ARB_texture_compression_bptc")) {
+    get_compressed_tex_image_ = reinterpret_cast<GetCompressedTexImageFunc>(ctx_->getProcAddress("glGetCompressedTexImage"));
+  }
+
+  // For footage that's copied rather than resampled (see RunNodeAccelerated())
+  QOpenGLExtraFunctions* xf = ctx_->extraFunctions();
+
+  xf->glGenSamplers(1, &nearest_sampler_);
+  xf->glSamplerParameteri(nearest_sampler_, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  xf->glSamplerParameteri(nearest_sampler_, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  xf->glSamplerParameteri(nearest_sampler_, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+  xf->glSamplerParameteri(nearest_sampler_, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+
+  // Frames bigger than this are rendered in tiles
+  functions_->glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size_);
 }
@@ -1,12 +1,16 @@
 #ifndef OPENGLPROCESSOR_H
 #define OPENGLPROCESSOR_H
 
+#include <QGenericMatrix>
 #include <QOffscreenSurface>
 #include <QOpenGLContext>
+#include <QVector3D>
 
 #include "../videorenderworker.h"
 #include "openglframebuffer.h"
 #include "openglshadercache.h"
+#include "opengltexturecache.h"
+#include "opengluploadring.h"
 
 class OpenGLWorker : public VideoRenderWorker {
   Q_OBJECT
@@ -15,11 +19,28 @@ public:
                OpenGLShaderCache* shader_cache,
                DecoderCache* decoder_cache,
                VideoRenderFrameCache* frame_cache,
+               VideoRenderFrameWriter* frame_writer,
                QObject* parent = nullptr);
 
   virtual ~OpenGLWorker() override;
 
+public slots:
+  /**
+   * @brief Start an asynchronous download of a texture into a pixel buffer object
+   *
+   * The readback overlaps with whatever this worker does next. Once the GPU signals the readback is done, the frame is
+   * mapped and saved to the cache by ProcessPendingDownloads().
+   */
+  virtual void Download(NodeDependency dep, QByteArray hash, QVariant texture) override;
+
 protected:
+  virtual bool UsesGPU() const override;
+
+  /**
+   * @brief GL_MAX_TEXTURE_SIZE of this worker's context
+   */
+  virtual int MaximumTextureSize() const override;
+
   /**
    * @brief Initialize OpenGL instance in whatever thread this object is a part of
    *
@@ -45,15 +66,99 @@ protected:
 
   virtual void CloseInternal() override;
 
-  virtual void FrameToValue(FramePtr frame, NodeValueTable* table) override;
+  virtual void FrameToValue(StreamPtr stream, FramePtr frame, NodeValueTable* table) override;
 
   virtual void RunNodeAccelerated(Node *node, const NodeValueDatabase *input_params, NodeValueTable* output_params) override;
 
   virtual void TextureToBuffer(const QVariant& texture, QByteArray& buffer) override;
 
+  virtual QVariant CreateConstantTexture(const QVector4D& color) override;
+
   virtual void ParametersChangedEvent() override;
 
+  virtual void FrameFinishedEvent() override;
+
+  virtual void SiblingFinishedEvent() override;
+
+  virtual bool InputIsFused(NodeInput* input) override;
+
+  virtual void DecoderCreatedEvent(DecoderPtr decoder) override;
+
 private:
+  /**
+   * @brief Upload a planar YUV frame and convert it into `output` (which must be the same size as the frame)
+   */
+  void ConvertYUVFrame(FramePtr frame, OpenGLTexturePtr output);
+
+  /**
+   * @brief Work out the data window of a shader's output from each stage's Node::GetDataWindow(), in order
+   *
+   * Inputs from an earlier stage get that stage's window, others get the window of their texture. Nodes work in the
+   * whole frame while textures' windows only cover `tile` (the part of the frame being rendered, normalized), so
+   * windows are converted on the way in and out.
+   */
+  static QRectF GetDataWindow(const QList<Node*>& stages, const NodeValueDatabase* input_params, const QRectF& tile);
+
+  /**
+   * @brief Choose the format of a shader's output texture from each stage's Node::OutputPrecision()
+   *
+   * The most precise stage decides. Stages that take their inputs' precision look at the textures bound to the shader
+   * (not inputs from an earlier stage), constants count as the frame's format since they're colors from a parameter.
+   * 8-bit passes read and write half as much memory as half-float ones.
+   */
+  olive::PixelFormat GetOutputFormat(const QList<Node*>& stages, const NodeValueDatabase* input_params);
+
+  /**
+   * @brief Matrix that maps texture coordinates in the tile being rendered to texture coordinates in the whole frame
+   *
+   * Footage is uploaded whole, so VideoInput's matrix is multiplied by this to sample the right part of it.
+   */
+  QMatrix4x4 TileToFrameMatrix();
+
+  /**
+   * @brief Convert footage from `colorspace` to the scene-linear reference space on the GPU
+   *
+   * Returns `footage_tex` unchanged if it's already in the reference space or OCIO can't convert it.
+   */
+  OpenGLTexturePtr ConvertToReferenceSpace(OpenGLTexturePtr footage_tex, const QString& colorspace, bool alpha_is_associated);
+
+  /**
+   * @brief Get the matrix and offset that convert normalized YUV to RGB for a given colorspace and range
+   */
+  static QMatrix3x3 GetYUVMatrix(Frame::YUVColorspace colorspace, bool full_range, QVector3D* offset);
+
+  /**
+   * @brief A texture readback into a pixel buffer object that may still be in flight
+   */
+  struct PendingDownload {
+    OpenGLTexturePtr texture;
+    NodeDependency dep;
+    QByteArray hash;
+    GLuint buffer;
+    GLsync fence;
+    int size;
+    int width;
+    int height;
+  };
+
+  /**
+   * @brief Block-compress a finished download straight from its pixel buffer, for the memory cache
+   *
+   * The driver encodes it (on the GPU where it can) and the compressed blocks are read back.
+   *
+   * @return
+   *
+   * The compressed frame, or an empty QByteArray if this format can't be compressed or the driver didn't.
+   */
+  QByteArray CompressDownload(const PendingDownload& download);
+
+  /**
+   * @brief Map a pending download's buffer and save it to the cache
+   *
+   * If the GPU hasn't finished the readback yet, this blocks until it has.
+   */
+  void FinishDownload(PendingDownload& download);
+
   QOpenGLContext* share_ctx_;
 
   QOpenGLContext* ctx_;
@@ -65,9 +170,52 @@ private:
 
   OpenGLShaderCache* shader_cache_;
 
+  OpenGLShaderPtr yuv_shader_;
+
+  GLuint yuv_planes_[3];
+
+  /**
+   * @brief Sampler with nearest filtering, bound to footage that's only moved by whole pixels
+   */
+  GLuint nearest_sampler_;
+
+  int max_texture_size_;
+
+  OpenGLTextureCachePtr texture_cache_;
+
+  /**
+   * @brief Number of downloads that can be in flight at once
+   */
+  static const int kDownloadBufferCount = 3;
+
+  PendingDownload downloads_[kDownloadBufferCount];
+
+  int next_download_;
+
+  /**
+   * @brief Footage frames are staged here on their way to textures
+   */
+  OpenGLUploadRing uploads_;
+
+  /**
+   * @brief Texture downloads are compressed into by CompressDownload()
+   */
+  GLuint compress_texture_;
+
+  /**
+   * @brief glGetCompressedTexImage(), which isn't part of OpenGL ES so Qt doesn't wrap it (nullptr if BPTC isn't
+   * supported)
+   */
+  void (QOPENGLF_APIENTRYP get_compressed_tex_image_)(GLenum target, GLint level, void* img);
+
 private slots:
   void FinishInit();
 
+  /**
+   * @brief Save any downloads that the GPU has finished, and check again later if any are still in flight
+   */
+  void ProcessPendingDownloads();
+
 };
 
 #endif // OPENGLPROCESSOR_H
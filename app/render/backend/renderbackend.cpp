@@ -1,17 +1,25 @@
 #include "renderbackend.h"
 
-#include <QDateTime>
+#include <climits>
 #include <QThread>
 
+#include "node/inputarray.h"
+#include "render/renderbudget.h"
+
 RenderBackend::RenderBackend(QObject *parent) :
   QObject(parent),
   compiled_(false),
-  caching_(false),
+  thread_count_(0),
+  background_(false),
+  jobs_in_flight_(0),
+  generation_(0),
   started_(false),
   viewer_node_(nullptr),
   copied_viewer_node_(nullptr),
   value_update_queued_(false),
-  recompile_queued_(false)
+  recompile_queued_(false),
+  cache_next_queued_(false),
+  result_queue_(this, "ProcessResults")
 {
 }
 
@@ -21,14 +29,18 @@ bool RenderBackend::Init()
     return true;
   }
 
-  threads_.resize(QThread::idealThreadCount());
+  threads_.resize(qMin((thread_count_ > 0) ? thread_count_ : RenderBudget::ThreadCount(), MaximumWorkerCount()));
 
   for (int i=0;i<threads_.size();i++) {
     QThread* thread = new QThread(this);
     threads_.replace(i, thread);
 
-    // We use low priority to keep the app responsive at all times (GUI thread should always prioritize over this one)
-    thread->start(QThread::LowPriority);
+    if (IsRealtimeWorker(i)) {
+      thread->start(QThread::HighestPriority);
+    } else {
+      // We use low priority to keep the app responsive at all times (GUI thread should always prioritize over this one)
+      thread->start(QThread::LowPriority);
+    }
   }
 
   started_ = InitInternal();
@@ -36,6 +48,10 @@ bool RenderBackend::Init()
   // Connects workers and moves them to their respective threads
   InitWorkers();
 
+  worker_jobs_.fill(0, processors_.size());
+  worker_last_job_.fill(TimeRange(), processors_.size());
+  jobs_in_flight_ = 0;
+
   if (!started_) {
     Close();
   }
@@ -65,6 +81,13 @@ void RenderBackend::Close()
     delete processor;
   }
   processors_.clear();
+
+  // Results from workers that no longer exist won't be processed
+  result_queue_.TakeAll();
+
+  worker_jobs_.clear();
+  worker_last_job_.clear();
+  jobs_in_flight_ = 0;
 }
 
 const QString &RenderBackend::GetError() const
@@ -77,12 +100,20 @@ void RenderBackend::SetViewerNode(ViewerOutput *viewer_node)
   if (viewer_node_ != nullptr) {
     DisconnectViewer(viewer_node_);
 
-    Decompile();
+    // Keep the copies in case this viewer's shown again soon
+    StashCopiedGraph();
   }
 
   viewer_node_ = viewer_node;
 
   if (viewer_node_ != nullptr) {
+    TakeWarmGraph(viewer_node_);
+
+    // Set before connecting so the cache ID is only worked out once the parameters are known
+    if (!viewer_node_->cache_name().isEmpty()) {
+      cache_name_ = viewer_node_->cache_name();
+    }
+
     ConnectViewer(viewer_node_);
   }
 }
@@ -90,11 +121,20 @@ void RenderBackend::SetViewerNode(ViewerOutput *viewer_node)
 void RenderBackend::SetCacheName(const QString &s)
 {
   cache_name_ = s;
-  cache_time_ = QDateTime::currentMSecsSinceEpoch();
 
   RegenerateCacheID();
 }
 
+void RenderBackend::SetThreadCount(int count)
+{
+  thread_count_ = count;
+}
+
+void RenderBackend::SetBackground(bool e)
+{
+  background_ = e;
+}
+
 bool RenderBackend::IsInitiated()
 {
   return started_;
@@ -102,32 +142,97 @@ bool RenderBackend::IsInitiated()
 
 bool RenderBackend::Compile()
 {
-  if (recompile_queued_) {
-    Decompile();
-    recompile_queued_ = false;
-  } else if (compiled_) {
+  if (compiled_ && !recompile_queued_) {
     return true;
   }
 
-  // Get dependencies of viewer node
-  source_node_list_.append(viewer_node_);
-  source_node_list_.append(viewer_node_->GetDependencies());
+  recompile_queued_ = false;
 
-  // Copy all dependencies into graph
-  foreach (Node* n, source_node_list_) {
-    Node* copy = n->copy();
+  // Get dependencies of viewer node. Only the input we render and the length are needed, so anything else (e.g. the
+  // audio nodes for a video backend) is never copied.
+  QSet<Node*> needed_nodes;
+
+  QList<NodeInput*> needed_inputs;
+  needed_inputs.append(GetDependentInput(viewer_node_));
+  needed_inputs.append(viewer_node_->length_input());
+
+  foreach (NodeInput* input, needed_inputs) {
+    Node* connected = input->get_connected_node();
+
+    if (connected != nullptr && !needed_nodes.contains(connected)) {
+      needed_nodes.insert(connected);
+
+      foreach (Node* dep, connected->GetDependencies()) {
+        needed_nodes.insert(dep);
+      }
+    }
+  }
+
+  needed_nodes.remove(viewer_node_);
+
+  QList<Node*> new_source_list;
+  new_source_list.append(viewer_node_);
+
+  // Dependencies come before the nodes that use them, using the order the graph keeps between edits
+  NodeGraph* graph = qobject_cast<NodeGraph*>(viewer_node_->parent());
+
+  if (graph != nullptr) {
+    foreach (Node* n, graph->TopologicalOrder()) {
+      if (needed_nodes.remove(n)) {
+        new_source_list.append(n);
+      }
+    }
+  }
+
+  // Anything that isn't in the viewer's graph
+  foreach (Node* n, needed_nodes) {
+    new_source_list.append(n);
+  }
+
+  // Jobs already running are stale from here (see UpdateNodeInputs())
+  generation_.ref();
+
+  // Nodes we already have a copy of keep it, so only nodes that were added to the graph get copied
+  QHash<Node*, Node*> new_copy_map;
+
+  foreach (Node* n, new_source_list) {
+    Node* copy = copy_map_.take(n);
+
+    if (copy == nullptr) {
+      copy = n->copy();
+      copied_graph_.AddNode(copy);
+    }
 
     // Copy values (but not connections yet)
     Node::CopyInputs(n, copy, false);
 
-    copied_graph_.AddNode(copy);
+    new_copy_map.insert(n, copy);
+  }
+
+  // Anything left over was removed from the graph
+  foreach (Node* copy, copy_map_) {
+    DeleteCopy(copy);
   }
 
-  // We know that the first node will be the viewer node since we appended that first in the copy
-  copied_viewer_node_ = static_cast<ViewerOutput*>(copied_graph_.nodes().first());
+  copy_map_ = new_copy_map;
+  source_node_list_ = new_source_list;
+
+  copied_viewer_node_ = static_cast<ViewerOutput*>(copy_map_.value(viewer_node_));
+
+  // Update connections, leaving the ones that haven't changed alone
+  foreach (Node* n, source_node_list_) {
+    Node* copy = copy_map_.value(n);
+
+    for (int i=0;i<n->parameters().size();i++) {
+      NodeParam* param = n->parameters().at(i);
 
-  // Copy connections
-  Node::DuplicateConnectionsBetweenLists(source_node_list_, copied_graph_.nodes());
+      if (param->type() == NodeParam::kInput) {
+        SyncConnections(static_cast<NodeInput*>(param), static_cast<NodeInput*>(copy->parameters().at(i)));
+      }
+    }
+  }
+
+  SignalGraphChanged();
 
   compiled_ = CompileInternal();
 
@@ -146,19 +251,103 @@ void RenderBackend::Decompile()
 
   DecompileInternal();
 
-  copied_graph_.Clear();
+  SignalGraphChanged();
+
+  // Copies kept for other viewers stay
+  foreach (Node* copy, copy_map_) {
+    DeleteCopy(copy);
+  }
+
   copied_viewer_node_ = nullptr;
   source_node_list_.clear();
+  copy_map_.clear();
 
   compiled_ = false;
 }
 
+void RenderBackend::StashCopiedGraph()
+{
+  if (compiled_) {
+    DecompileInternal();
+
+    SignalGraphChanged();
+
+    compiled_ = false;
+  }
+
+  if (!copy_map_.isEmpty()) {
+    WarmGraph warm;
+    warm.viewer = viewer_node_;
+
+    QHash<Node*, Node*>::const_iterator i;
+
+    for (i=copy_map_.constBegin();i!=copy_map_.constEnd();i++) {
+      warm.copies.append(qMakePair(QPointer<Node>(i.key()), i.value()));
+    }
+
+    warm_graphs_.prepend(warm);
+
+    while (warm_graphs_.size() > kWarmGraphCount) {
+      DeleteWarmGraph(warm_graphs_.takeLast());
+    }
+  }
+
+  copied_viewer_node_ = nullptr;
+  source_node_list_.clear();
+  copy_map_.clear();
+}
+
+void RenderBackend::TakeWarmGraph(ViewerOutput *viewer)
+{
+  for (int i=0;i<warm_graphs_.size();i++) {
+    const WarmGraph& warm = warm_graphs_.at(i);
+
+    if (warm.viewer == viewer) {
+      // Compile() only copies what's changed since these were made, and copies anything that's new
+      for (int j=0;j<warm.copies.size();j++) {
+        const QPair<QPointer<Node>, Node*>& copy = warm.copies.at(j);
+
+        if (copy.first.isNull()) {
+          // The node's gone, and another node could have its address by now
+          DeleteCopy(copy.second);
+        } else {
+          copy_map_.insert(copy.first.data(), copy.second);
+        }
+      }
+
+      warm_graphs_.removeAt(i);
+      break;
+    }
+  }
+
+  // Viewers that have been deleted won't be coming back
+  for (int i=warm_graphs_.size()-1;i>=0;i--) {
+    if (warm_graphs_.at(i).viewer.isNull()) {
+      DeleteWarmGraph(warm_graphs_.takeAt(i));
+    }
+  }
+}
+
+void RenderBackend::DeleteWarmGraph(const WarmGraph &warm)
+{
+  for (int i=0;i<warm.copies.size();i++) {
+    DeleteCopy(warm.copies.at(i).second);
+  }
+}
+
+void RenderBackend::DeleteCopy(Node *copy)
+{
+  copy->DisconnectAll();
+  copied_graph_.TakeNode(copy);
+  delete copy;
+}
+
 void RenderBackend::RegenerateCacheID()
 {
   QCryptographicHash hash(QCryptographicHash::Sha1);
 
+  // The ID only depends on the name and parameters, so frames rendered in a previous session are found again
   if (cache_name_.isEmpty()
-      || !cache_time_
       || !GenerateCacheIDInternal(hash)) {
     cache_id_.clear();
     CacheIDChangedEvent(QString());
@@ -166,7 +355,6 @@ void RenderBackend::RegenerateCacheID()
   }
 
   hash.addData(cache_name_.toUtf8());
-  hash.addData(QString::number(cache_time_).toUtf8());
 
   QByteArray bytes = hash.result();
   cache_id_ = bytes.toHex();
@@ -199,39 +387,203 @@ void RenderBackend::DisconnectViewer(ViewerOutput *node)
 
 void RenderBackend::CacheNext()
 {
-  if (!Init() || cache_queue_.isEmpty() || !ViewerIsConnected() || caching_) {
+  if (!Init() || !ViewerIsConnected()) {
+    return;
+  }
+
+  int background_workers = processors_.size();
+  int background_jobs = jobs_in_flight_;
+
+  // With more than one worker, the last one can be reserved for interactive jobs
+  if (processors_.size() > 1 && ReservesInteractiveWorker()) {
+    background_workers--;
+    background_jobs -= worker_jobs_.last();
+
+    TimeRange interactive_frame;
+
+    if (worker_jobs_.last() == 0 && TakeInteractiveJob(&interactive_frame)) {
+      UpdateNodeInputs();
+
+      if (!GenerateData(interactive_frame, -1)) {
+        return;
+      }
+    }
+  }
+
+  // Keep every background worker's batch full so every thread stays busy
+  while (background_jobs < background_workers * kWorkerBatchSize) {
+    TimeRange cache_frame;
+
+    if (!TakeNextJob(&cache_frame)) {
+      break;
+    }
+
+    UpdateNodeInputs();
+
+    //qDebug() << "Caching" << cache_frame.in();
+
+    if (!GenerateData(cache_frame, background_workers)) {
+      break;
+    }
+
+    background_jobs++;
+  }
+}
+
+void RenderBackend::QueueCacheNext()
+{
+  if (cache_next_queued_) {
+    return;
+  }
+
+  cache_next_queued_ = true;
+  QMetaObject::invokeMethod(this, "QueuedCacheNext", Qt::QueuedConnection);
+}
+
+void RenderBackend::QueuedCacheNext()
+{
+  cache_next_queued_ = false;
+
+  CacheNext();
+}
+
+bool RenderBackend::TakeNextJob(TimeRange *range)
+{
+  if (cache_queue_.isEmpty()) {
+    return false;
+  }
+
+  *range = cache_queue_.takeFirst();
+
+  return true;
+}
+
+bool RenderBackend::TakeInteractiveJob(TimeRange *range)
+{
+  Q_UNUSED(range)
+
+  return false;
+}
+
+bool RenderBackend::ReservesInteractiveWorker() const
+{
+  return false;
+}
+
+bool RenderBackend::InteractiveWorkerIsRealtime() const
+{
+  return false;
+}
+
+bool RenderBackend::IsRealtimeWorker(int index) const
+{
+  return threads_.size() > 1 && index == threads_.size() - 1
+      && ReservesInteractiveWorker() && InteractiveWorkerIsRealtime();
+}
+
+int RenderBackend::MaximumWorkerCount() const
+{
+  return INT_MAX;
+}
+
+void RenderBackend::JobFinishedEvent(const RenderResult &result)
+{
+  Q_UNUSED(result)
+}
+
+bool RenderBackend::CancelsStaleJobs() const
+{
+  return false;
+}
+
+bool RenderBackend::ResultIsStale(const RenderResult &result) const
+{
+  return CancelsStaleJobs() && result.generation != generation_.load();
+}
+
+void RenderBackend::ProcessResults()
+{
+  QList<RenderResult> results = result_queue_.TakeAll();
+
+  if (results.isEmpty()) {
     return;
   }
 
-  UpdateNodeInputs();
+  foreach (const RenderResult& result, results) {
+    int index = processors_.indexOf(result.worker);
 
-  TimeRange cache_frame = cache_queue_.takeFirst();
+    // Ignore workers that are no longer ours
+    if (index >= 0 && worker_jobs_.at(index) > 0) {
+      worker_jobs_[index]--;
+      jobs_in_flight_--;
+    }
 
-  //qDebug() << "Caching" << cache_frame.in();
+    JobFinishedEvent(result);
+  }
 
-  caching_ = GenerateData(cache_frame);
+  // Every worker that finished a job in this batch gets its next one in one go
+  CacheNext();
 }
 
-bool RenderBackend::GenerateData(const TimeRange &range)
+bool RenderBackend::GenerateData(const TimeRange &range, int worker_count)
 {
   if (!Compile()) {
     qDebug() << "Graph remains uncompiled, nothing to be done";
     return false;
   }
 
-  NodeDependency dep = NodeDependency(GetDependentInput()->get_connected_node(), range.in(), range.out());
+  if (processors_.isEmpty()) {
+    return false;
+  }
 
-  foreach (RenderWorker* worker, processors_) {
-    if (worker->IsAvailable() || worker == processors_.last()) {
-      QMetaObject::invokeMethod(worker,
-                                "Render",
-                                Qt::QueuedConnection,
-                                Q_ARG(NodeDependency, dep));
-      return true;
+  NodeDependency dep = NodeDependency(GetDependentInput(viewer_node())->get_connected_node(), range.in(), range.out());
+
+  int chosen = -1;
+
+  if (worker_count < 0) {
+    chosen = processors_.size() - 1;
+  } else {
+    // A worker that's still busy with the job before this one is holding the decoders it needs at the right position.
+    // Any other worker would have to create its own and seek them, which for long-GOP footage means decoding from the
+    // previous keyframe. Once that worker goes idle, its decoders are back in the pool for whoever needs them.
+    for (int i=0;i<worker_count;i++) {
+      if (worker_jobs_.at(i) > 0
+          && worker_jobs_.at(i) < kWorkerBatchSize
+          && JobFollows(worker_last_job_.at(i), range)) {
+        chosen = i;
+        break;
+      }
+    }
+
+    if (chosen < 0) {
+      // Give the job to whichever worker has the fewest jobs queued
+      chosen = 0;
+
+      for (int i=1;i<worker_count;i++) {
+        if (worker_jobs_.at(i) < worker_jobs_.at(chosen)) {
+          chosen = i;
+        }
+      }
     }
   }
 
-  return false;
+  processors_.at(chosen)->QueueJob(dep, generation_.load());
+
+  worker_jobs_[chosen]++;
+  worker_last_job_[chosen] = range;
+  jobs_in_flight_++;
+
+  return true;
+}
+
+bool RenderBackend::JobFollows(const TimeRange &previous, const TimeRange &next) const
+{
+  return next.in() == previous.out();
+}
+
+int RenderBackend::JobsInFlight() const
+{
+  return jobs_in_flight_;
 }
 
 ViewerOutput *RenderBackend::viewer_node() const
@@ -263,17 +615,91 @@ void RenderBackend::QueueValueUpdate(const TimeRange &range)
 void RenderBackend::UpdateNodeInputs()
 {
   if (value_update_queued_) {
-    for (int i=0;i<source_node_list_.size();i++) {
-      Node* src = source_node_list_.at(i);
-      Node* dst = copied_graph_.nodes().at(i);
+    // Workers may be reading the copies while we write them, so any job already running has to be considered stale
+    // from here rather than from when we're done (SignalGraphChanged() bumps it again)
+    generation_.ref();
+
+    bool bypass_changed = false;
+
+    // Only inputs whose value version changed since they were last copied are actually copied
+    foreach (Node* src, source_node_list_) {
+      Node* copy = copy_map_.value(src);
+
+      if (copy->IsBypassed() != src->IsBypassed()) {
+        bypass_changed = true;
+      }
+
+      Node::CopyInputs(src, copy, false);
+    }
 
-      Node::CopyInputs(src, dst, false);
+    if (bypass_changed) {
+      BypassChangedEvent();
     }
 
+    SignalGraphChanged();
+
     value_update_queued_ = false;
   }
 }
 
+void RenderBackend::SyncConnections(NodeInput *source, NodeInput *dest)
+{
+  NodeOutput* wanted = nullptr;
+
+  if (source->IsConnected()) {
+    // Find the equivalent output in the copied graph
+    NodeOutput* source_output = source->get_connected_output();
+    Node* dest_output_node = copy_map_.value(source_output->parentNode());
+
+    // Nodes nothing we render depends on aren't copied, leave the copy disconnected from them
+    if (dest_output_node != nullptr) {
+      wanted = static_cast<NodeOutput*>(dest_output_node->GetParameterWithID(source_output->id()));
+    }
+  }
+
+  if (dest->get_connected_output() != wanted) {
+    if (wanted == nullptr) {
+      dest->DisconnectAll();
+    } else {
+      // This replaces any existing connection
+      NodeParam::ConnectEdge(wanted, dest);
+    }
+  }
+
+  // If inputs are arrays, sync their connections too
+  if (source->IsArray()) {
+    NodeInputArray* source_array = static_cast<NodeInputArray*>(source);
+    NodeInputArray* dest_array = static_cast<NodeInputArray*>(dest);
+
+    for (int i=0;i<source_array->GetSize();i++) {
+      SyncConnections(source_array->ParamAt(i), dest_array->ParamAt(i));
+    }
+  }
+}
+
+void RenderBackend::SignalGraphChanged()
+{
+  generation_.ref();
+
+  // This goes through the job queue so it arrives in order with any jobs sent after it
+  foreach (RenderWorker* worker, processors_) {
+    worker->QueueGraphChanged();
+  }
+}
+
+void RenderBackend::ConnectWorkerToThis(RenderWorker *worker)
+{
+  Q_UNUSED(worker)
+}
+
+bool RenderBackend::CanRunSibling(RenderWorker *requester, RenderWorker *worker) const
+{
+  Q_UNUSED(requester)
+  Q_UNUSED(worker)
+
+  return true;
+}
+
 const QVector<QThread *> &RenderBackend::threads()
 {
   return threads_;
@@ -284,6 +710,10 @@ void RenderBackend::CacheIDChangedEvent(const QString &id)
   Q_UNUSED(id)
 }
 
+void RenderBackend::BypassChangedEvent()
+{
+}
+
 void RenderBackend::InitWorkers()
 {
   for (int i=0;i<processors_.size();i++) {
@@ -291,7 +721,22 @@ void RenderBackend::InitWorkers()
     QThread* thread = threads().at(i);
 
     // Connect to it
-    connect(processor, SIGNAL(RequestSibling(NodeDependency)), this, SLOT(ThreadRequestedSibling(NodeDependency)));
+    connect(processor, SIGNAL(RequestSibling(RenderSiblingJobPtr)), this, SLOT(ThreadRequestedSibling(RenderSiblingJobPtr)));
+    processor->SetResultQueue(&result_queue_);
+    processor->SetGeneration(CancelsStaleJobs() ? &generation_ : nullptr);
+
+    bool interactive = (i == processors_.size() - 1 && processors_.size() > 1 && ReservesInteractiveWorker());
+
+    // The worker kept free for interactive jobs wants single frames as soon as possible rather than many frames fast
+    if (interactive) {
+      processor->SetDecodeProfile(Decoder::kProfileInteractive);
+    }
+
+    processor->SetRealtime(IsRealtimeWorker(i));
+
+    // Interactive jobs are what the user is waiting on, so they're never background work
+    processor->SetBackground(background_ && !interactive);
+
     ConnectWorkerToThis(processor);
 
     // Finally, we can move it to its own thread
@@ -302,15 +747,18 @@ void RenderBackend::InitWorkers()
   }
 }
 
-void RenderBackend::ThreadRequestedSibling(NodeDependency dep)
+void RenderBackend::ThreadRequestedSibling(RenderSiblingJobPtr job)
 {
-  // Try to queue another thread to run this dep in advance
+  RenderWorker* requester = static_cast<RenderWorker*>(sender());
+
+  // Try to queue another thread to run this branch in parallel. If none are available, the worker that requested it
+  // will run it itself.
   foreach (RenderWorker* worker, processors_) {
-    if (worker->IsAvailable()) {
+    if (worker->IsAvailable() && !worker->IsRealtime() && CanRunSibling(requester, worker)) {
       QMetaObject::invokeMethod(worker,
-                                "RenderAsSibling",
+                                "RenderSibling",
                                 Qt::QueuedConnection,
-                                Q_ARG(NodeDependency, dep));
+                                Q_ARG(RenderSiblingJobPtr, job));
       return;
     }
   }
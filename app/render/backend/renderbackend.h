@@ -1,7 +1,9 @@
 #ifndef RENDERBACKEND_H
 #define RENDERBACKEND_H
 
+#include <QHash>
 #include <QLinkedList>
+#include <QPointer>
 
 #include "common/constructors.h"
 #include "decodercache.h"
@@ -23,12 +25,37 @@ public:
 
   const QString& GetError() const;
 
+  /**
+   * @brief Set the viewer to render
+   *
+   * If the viewer has a cache name (see ViewerOutput::cache_name()), it replaces the one set with SetCacheName().
+   *
+   * The workers, their contexts and their decoders carry on as they are. The copied graph of the last viewer is kept
+   * for a while too (see kWarmGraphCount), so switching back to it only copies what changed in the meantime.
+   */
   void SetViewerNode(ViewerOutput* viewer_node);
 
   void SetCacheName(const QString& s);
 
   bool IsInitiated();
 
+  /**
+   * @brief Set how many worker threads Init() starts (0, the default, starts RenderBudget::ThreadCount())
+   *
+   * Only takes effect the next time the backend is initialized. However many workers there are, they only run as many
+   * jobs at once as RenderBudget allows across every backend.
+   */
+  void SetThreadCount(int count);
+
+  /**
+   * @brief Set whether this backend's work is in the background, e.g. filling a viewer's cache (FALSE by default)
+   *
+   * Background work yields to everything else and is throttled while the user is working (see InteractivityMonitor).
+   * The interactive worker (see ReservesInteractiveWorker()) never is. Only takes effect the next time the backend is
+   * initialized.
+   */
+  void SetBackground(bool e);
+
 public slots:
   virtual void InvalidateCache(const rational &start_range, const rational &end_range) = 0;
 
@@ -58,6 +85,13 @@ protected:
 
   virtual void CacheIDChangedEvent(const QString& id);
 
+  /**
+   * @brief Called once a node in the copied graph has been bypassed or stopped being bypassed (see Node::SetBypassed())
+   *
+   * Called before the workers are told the graph has changed. The default implementation does nothing.
+   */
+  virtual void BypassChangedEvent();
+
   void SetError(const QString& error);
 
   virtual void ConnectViewer(ViewerOutput* node);
@@ -66,17 +100,139 @@ protected:
   /**
    * @brief Function called when there are frames in the queue to cache
    *
+   * Dispatches queued jobs until every worker has kWorkerBatchSize in flight (or the queue is empty).
+   *
    * This function is NOT thread-safe and should only be called in the main thread.
    */
   void CacheNext();
 
-  bool GenerateData(const TimeRange& range);
+  /**
+   * @brief Call CacheNext() once control returns to the event loop
+   *
+   * Dragging a parameter invalidates the cache on every mouse move. Deferring the dispatch means a burst of
+   * invalidations only copies the node inputs and dispatches jobs once, with the last value.
+   */
+  void QueueCacheNext();
+
+  /**
+   * @brief Take the job that should be rendered next out of the queue
+   *
+   * The default implementation takes jobs in the order they were queued. Derivatives can override this to prioritize
+   * jobs differently.
+   *
+   * @return
+   *
+   * FALSE if there's nothing left to render.
+   */
+  virtual bool TakeNextJob(TimeRange* range);
+
+  /**
+   * @brief Take a job that the user is waiting on right now (e.g. the frame under the playhead)
+   *
+   * When there's more than one worker and ReservesInteractiveWorker() is TRUE, one of them is kept free for these
+   * jobs so they never wait behind background caching. The default implementation has no such jobs.
+   *
+   * @return
+   *
+   * FALSE if there's nothing waiting.
+   */
+  virtual bool TakeInteractiveJob(TimeRange* range);
+
+  /**
+   * @brief Returns whether a worker should be kept free for TakeInteractiveJob() (FALSE by default)
+   */
+  virtual bool ReservesInteractiveWorker() const;
+
+  /**
+   * @brief Returns whether the reserved interactive worker is realtime (FALSE by default)
+   *
+   * If so, its thread runs at high priority rather than low and its jobs don't wait for RenderBudget (see
+   * RenderWorker::SetRealtime()), so interactive jobs must be small.
+   */
+  virtual bool InteractiveWorkerIsRealtime() const;
+
+  /**
+   * @brief The most workers Init() starts, whatever SetThreadCount() asked for (unlimited by default)
+   */
+  virtual int MaximumWorkerCount() const;
+
+  /**
+   * @brief Called in the main thread for each job a worker has finished, in the order they finished
+   *
+   * Results arrive in batches. Once every result in a batch has been handled, CacheNext() dispatches jobs to the
+   * workers that finished, so derivatives don't need to. The default implementation does nothing.
+   */
+  virtual void JobFinishedEvent(const RenderResult& result);
+
+  /**
+   * @brief Returns whether workers should abandon jobs once the copied graph has changed (FALSE by default)
+   *
+   * Abandoned jobs come back as RenderResult::kCancelled and it's up to the derivative to queue them again if they're
+   * still needed.
+   */
+  virtual bool CancelsStaleJobs() const;
+
+  /**
+   * @brief Returns whether the copied graph has changed since this result's job was queued
+   *
+   * Always FALSE if CancelsStaleJobs() is FALSE.
+   */
+  bool ResultIsStale(const RenderResult& result) const;
+
+  /**
+   * @brief Number of jobs dispatched to the workers that haven't finished yet
+   */
+  int JobsInFlight() const;
+
+  /**
+   * @brief Dispatch a job to a worker
+   *
+   * @param worker_count
+   *
+   * The job goes to one of the first `worker_count` workers, or to the last worker if `worker_count` is -1. A job
+   * that follows on from one that's still in flight (see JobFollows()) goes to the same worker so the decoders it
+   * needs carry on from where they are rather than seeking. Others go to whichever worker has the fewest jobs in
+   * flight.
+   */
+  bool GenerateData(const TimeRange& range, int worker_count);
+
+  /**
+   * @brief Returns whether `next` carries on straight from `previous`, so it's best rendered by the same worker
+   *
+   * The default implementation checks whether `next` starts where `previous` ends.
+   */
+  virtual bool JobFollows(const TimeRange& previous, const TimeRange& next) const;
+
+  /**
+   * @brief Number of jobs each worker can have in flight
+   *
+   * More than one lets a run of jobs that follow on from each other queue up on one worker.
+   */
+  static const int kWorkerBatchSize = 4;
 
   void InitWorkers();
 
-  virtual NodeInput* GetDependentInput() = 0;
+  /**
+   * @brief The input of `viewer` this backend renders (e.g. its texture or samples input)
+   *
+   * Only nodes this input depends on are copied when compiling.
+   */
+  virtual NodeInput* GetDependentInput(ViewerOutput* viewer) = 0;
 
-  virtual void ConnectWorkerToThis(RenderWorker* worker) = 0;
+  /**
+   * @brief Called for each worker before it's moved to its thread so derivatives can connect to its signals
+   *
+   * Job results don't need connecting, they arrive through JobFinishedEvent().
+   */
+  virtual void ConnectWorkerToThis(RenderWorker* worker);
+
+  /**
+   * @brief Returns whether `worker` can run a branch that `requester` forked (TRUE by default)
+   *
+   * Derivatives whose workers can't all use each other's results (e.g. because they're on different GPUs) can
+   * override this to keep siblings with workers that can.
+   */
+  virtual bool CanRunSibling(RenderWorker* requester, RenderWorker* worker) const;
 
   ViewerOutput* viewer_node() const;
 
@@ -96,14 +252,89 @@ protected:
 
   bool compiled_;
 
-  bool caching_;
-
 private:
+  /**
+   * @brief Make `dest` (in the copied graph) connected the same way as `source`, only changing what's different
+   */
+  void SyncConnections(NodeInput* source, NodeInput* dest);
+
+  /**
+   * @brief Tell all workers that the copied graph has changed
+   */
+  void SignalGraphChanged();
+
+  /**
+   * @brief Copies of the graph of a viewer that isn't shown any more, still in copied_graph_
+   *
+   * Source nodes are guarded so copies of nodes that were deleted in the meantime aren't mistaken for copies of
+   * whatever's made at the same address next.
+   */
+  struct WarmGraph {
+    QPointer<ViewerOutput> viewer;
+    QList< QPair<QPointer<Node>, Node*> > copies;
+  };
+
+  /**
+   * @brief Decompile, but move the copies to warm_graphs_ rather than deleting them
+   */
+  void StashCopiedGraph();
+
+  /**
+   * @brief Take `viewer`'s copies back out of warm_graphs_ (if they're there) for the next Compile()
+   */
+  void TakeWarmGraph(ViewerOutput* viewer);
+
+  void DeleteWarmGraph(const WarmGraph& warm);
+
+  /**
+   * @brief Remove a copy from copied_graph_ and delete it
+   */
+  void DeleteCopy(Node* copy);
+
+  /**
+   * @brief Number of viewers the copied graphs are kept for after switching away from them
+   */
+  static const int kWarmGraphCount = 3;
+
+  /**
+   * @brief Most recently stashed first
+   */
+  QList<WarmGraph> warm_graphs_;
+
+  /**
+   * @brief Returns whether the worker (and thread) at this index is the realtime interactive worker
+   */
+  bool IsRealtimeWorker(int index) const;
+
   /**
    * @brief Internal list of RenderProcessThreads
    */
   QVector<QThread*> threads_;
 
+  int thread_count_;
+
+  bool background_;
+
+  /**
+   * @brief Number of jobs dispatched to each worker (same indices as processors_) that haven't finished yet
+   */
+  QVector<int> worker_jobs_;
+
+  /**
+   * @brief The last job dispatched to each worker (same indices as processors_)
+   */
+  QVector<TimeRange> worker_last_job_;
+
+  /**
+   * @brief Total number of jobs dispatched that haven't finished yet
+   */
+  int jobs_in_flight_;
+
+  /**
+   * @brief Bumped whenever the copied graph starts or finishes changing, jobs carry the value they were queued under
+   */
+  QAtomicInt generation_;
+
   /**
    * @brief Internal variable that contains whether the Renderer has started or not
    */
@@ -127,19 +358,39 @@ private:
   DecoderCache decoder_cache_;
 
   QString cache_name_;
-  qint64 cache_time_;
   QString cache_id_;
 
   QList<Node*> source_node_list_;
   NodeGraph copied_graph_;
 
+  /**
+   * @brief Map of source nodes to their copies in copied_graph_
+   *
+   * Kept between compiles so only nodes that are new to the graph need to be copied.
+   */
+  QHash<Node*, Node*> copy_map_;
+
   bool value_update_queued_;
   TimeRange value_update_range_;
 
   bool recompile_queued_;
 
+  bool cache_next_queued_;
+
+  /**
+   * @brief Results pushed by every worker, taken by ProcessResults()
+   */
+  RenderResultQueue result_queue_;
+
 private slots:
-  void ThreadRequestedSibling(NodeDependency dep);
+  void ThreadRequestedSibling(RenderSiblingJobPtr job);
+
+  void QueuedCacheNext();
+
+  /**
+   * @brief Handle every result in result_queue_ so far
+   */
+  void ProcessResults();
 
   void QueueRecompile();
 
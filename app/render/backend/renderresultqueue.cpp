@@ -0,0 +1,56 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "renderresultqueue.h"
+
+RenderResultQueue::RenderResultQueue(QObject *receiver, const char *method) :
+  receiver_(receiver),
+  method_(method)
+{
+}
+
+void RenderResultQueue::Push(const RenderResult &result)
+{
+  lock_.lock();
+
+  bool was_empty = results_.isEmpty();
+
+  results_.append(result);
+
+  lock_.unlock();
+
+  // If the queue wasn't empty, the receiver has already been woken and will take this result with the others
+  if (was_empty) {
+    QMetaObject::invokeMethod(receiver_, method_, Qt::QueuedConnection);
+  }
+}
+
+QList<RenderResult> RenderResultQueue::TakeAll()
+{
+  QList<RenderResult> results;
+
+  lock_.lock();
+
+  results.swap(results_);
+
+  lock_.unlock();
+
+  return results;
+}
@@ -0,0 +1,110 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef RENDERRESULTQUEUE_H
+#define RENDERRESULTQUEUE_H
+
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+
+#include "node/dependency.h"
+#include "node/value.h"
+
+class RenderWorker;
+
+/**
+ * @brief What a worker did with a job, sent back to the backend through a RenderResultQueue
+ */
+struct RenderResult {
+  enum Type {
+    /// The job was rendered (`value` is the result)
+    kCompletedCache,
+
+    /// The frame was rendered (`hash` and `value` are set)
+    kCompletedFrame,
+
+    /// The frame was rendered in tiles and queued to be written to the disk cache, so unlike kCompletedFrame there's
+    /// no texture to download (`hash` is set)
+    kCompletedTiles,
+
+    /// A frame with this hash is already cached, so nothing was rendered (`hash` is set)
+    kHashAlreadyExists,
+
+    /// Another worker is already rendering a frame with this hash, so nothing was rendered (`hash` is set)
+    kHashAlreadyBeingCached,
+
+    /// The graph changed before the job finished, so it was abandoned and nothing was rendered (`hash` is set if it
+    /// had been reserved with VideoRenderFrameCache::TryCache())
+    kCancelled
+  };
+
+  Type type;
+
+  RenderWorker* worker;
+
+  NodeDependency dep;
+
+  /// Graph generation the job was queued under (see RenderWorker::QueueJob())
+  int generation;
+
+  QByteArray hash;
+
+  NodeValueTable value;
+};
+
+/**
+ * @brief Results pushed by any number of workers and collected by one receiver in the main thread
+ *
+ * Pushing a result into an empty queue wakes the receiver with one queued call, which then takes everything pushed
+ * since. A burst of finished jobs goes through the event loop once, rather than once per job with its arguments
+ * marshalled for a queued signal each time. The queue itself only holds its lock to append or swap out the list.
+ */
+class RenderResultQueue
+{
+public:
+  /**
+   * @brief Construct a queue that calls the slot `method` on `receiver` when results arrive
+   */
+  RenderResultQueue(QObject* receiver, const char* method);
+
+  /**
+   * @brief Add a result to the queue (thread-safe)
+   */
+  void Push(const RenderResult& result);
+
+  /**
+   * @brief Take every result that's been pushed so far, in the order they were pushed
+   */
+  QList<RenderResult> TakeAll();
+
+private:
+  QObject* receiver_;
+
+  const char* method_;
+
+  QMutex lock_;
+
+  QList<RenderResult> results_;
+
+};
+
+#endif // RENDERRESULTQUEUE_H
@@ -0,0 +1,66 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#include "rendersiblingjob.h"
+
+RenderSiblingJob::RenderSiblingJob(const NodeDependency &dep) :
+  dep_(dep),
+  claimed_(0),
+  finished_(false)
+{
+}
+
+const NodeDependency &RenderSiblingJob::dep() const
+{
+  return dep_;
+}
+
+bool RenderSiblingJob::Claim()
+{
+  return claimed_.testAndSetOrdered(0, 1);
+}
+
+void RenderSiblingJob::Finish(const NodeValueTable &value)
+{
+  lock_.lock();
+
+  value_ = value;
+  finished_ = true;
+
+  finished_cond_.wakeAll();
+
+  lock_.unlock();
+}
+
+NodeValueTable RenderSiblingJob::WaitForResult()
+{
+  lock_.lock();
+
+  while (!finished_) {
+    finished_cond_.wait(&lock_);
+  }
+
+  NodeValueTable value = value_;
+
+  lock_.unlock();
+
+  return value;
+}
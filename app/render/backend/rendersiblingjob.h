@@ -0,0 +1,80 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#ifndef RENDERSIBLINGJOB_H
+#define RENDERSIBLINGJOB_H
+
+#include <memory>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include "node/dependency.h"
+#include "node/value.h"
+
+/**
+ * @brief A branch of a frame that one worker has offered to the others so it can be evaluated in parallel
+ *
+ * A worker forks a branch by creating one of these and carries on with its other branches. Any idle worker may pick it
+ * up in the meantime. When the forking worker needs the result, it either runs the branch itself (if nobody else
+ * claimed it yet) or waits for the worker that did. Since a job is only ever waited on once it's running, this can't
+ * deadlock even if no other workers are free.
+ */
+class RenderSiblingJob
+{
+public:
+  RenderSiblingJob(const NodeDependency& dep);
+
+  const NodeDependency& dep() const;
+
+  /**
+   * @brief Claim this job to run it, returns false if another worker already has
+   */
+  bool Claim();
+
+  /**
+   * @brief Set the result of this job and wake up anything waiting for it
+   */
+  void Finish(const NodeValueTable& value);
+
+  /**
+   * @brief Block until the worker that claimed this job has finished it and return the result
+   */
+  NodeValueTable WaitForResult();
+
+private:
+  NodeDependency dep_;
+
+  QAtomicInt claimed_;
+
+  QMutex lock_;
+  QWaitCondition finished_cond_;
+  bool finished_;
+
+  NodeValueTable value_;
+
+};
+
+using RenderSiblingJobPtr = std::shared_ptr<RenderSiblingJob>;
+
+Q_DECLARE_METATYPE(RenderSiblingJobPtr)
+
+#endif // RENDERSIBLINGJOB_H
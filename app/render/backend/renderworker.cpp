@@ -1,14 +1,70 @@
 #include "renderworker.h"
 
+#include <QRunnable>
 #include <QThread>
+#include <QThreadPool>
 
+#include "common/tracer.h"
 #include "node/block/block.h"
+#include "render/renderbudget.h"
+
+namespace {
+
+/**
+ * @brief Decodes a DecodeBatch with a decoder from the DecoderCache on the global thread pool
+ */
+class PrefetchTask : public QRunnable
+{
+public:
+  PrefetchTask(DecoderCache* cache, StreamPtr stream, Decoder::Profile profile, DecodeBatchPtr batch) :
+    cache_(cache),
+    stream_(stream),
+    profile_(profile),
+    batch_(batch)
+  {
+  }
+
+  virtual void run() override
+  {
+    DecoderPtr decoder = cache_->AcquireDecoder(stream_.get(), batch_->times().first(), profile_);
+
+    if (decoder == nullptr) {
+      // Every decoder is busy, opening another one just to decode ahead isn't worth it
+      cache_->CancelReservation(stream_.get(), profile_);
+      batch_->Finish();
+      return;
+    }
+
+    decoder->RetrieveVideoBatch(batch_.get());
+
+    cache_->ReleaseDecoder(decoder);
+  }
+
+private:
+  DecoderCache* cache_;
+
+  StreamPtr stream_;
+
+  Decoder::Profile profile_;
+
+  DecodeBatchPtr batch_;
+
+};
+
+}
 
 RenderWorker::RenderWorker(DecoderCache *decoder_cache, QObject *parent) :
   QObject(parent),
   working_(0),
+  render_depth_(0),
   started_(false),
-  decoder_cache_(decoder_cache)
+  decoder_cache_(decoder_cache),
+  decode_profile_(Decoder::kProfileThroughput),
+  realtime_(false),
+  background_(false),
+  result_queue_(nullptr),
+  generation_(nullptr),
+  job_generation_(0)
 {
 }
 
@@ -17,6 +73,11 @@ bool RenderWorker::IsAvailable()
   return (working_ == 0);
 }
 
+int RenderWorker::JobsInProgress() const
+{
+  return working_.load();
+}
+
 bool RenderWorker::Init()
 {
   if (started_) {
@@ -32,14 +93,140 @@ bool RenderWorker::Init()
 
 void RenderWorker::Close()
 {
+  CancelPrefetches();
+
   CloseInternal();
 
   started_ = false;
 }
 
-void RenderWorker::Render(NodeDependency path)
+void RenderWorker::SetResultQueue(RenderResultQueue *queue)
+{
+  result_queue_ = queue;
+}
+
+void RenderWorker::SetGeneration(const QAtomicInt *generation)
+{
+  generation_ = generation;
+}
+
+void RenderWorker::SetRealtime(bool e)
+{
+  realtime_ = e;
+}
+
+bool RenderWorker::IsRealtime() const
+{
+  return realtime_;
+}
+
+void RenderWorker::SetBackground(bool e)
 {
-  emit CompletedCache(path, RenderInternal(path));
+  background_ = e;
+}
+
+bool RenderWorker::IsBackground() const
+{
+  return background_;
+}
+
+void RenderWorker::QueueJob(const NodeDependency &path, int generation)
+{
+  QueuedJob job;
+  job.path = path;
+  job.generation = generation;
+  job.graph_changed = false;
+
+  EnqueueJob(job);
+}
+
+void RenderWorker::QueueGraphChanged()
+{
+  QueuedJob job;
+  job.generation = 0;
+  job.graph_changed = true;
+
+  EnqueueJob(job);
+}
+
+void RenderWorker::EnqueueJob(const QueuedJob &job)
+{
+  job_queue_lock_.lock();
+
+  bool was_empty = job_queue_.isEmpty();
+
+  job_queue_.append(job);
+
+  job_queue_lock_.unlock();
+
+  // If the queue wasn't empty, ProcessJobQueue() is already on its way and will pick this job up too
+  if (was_empty) {
+    QMetaObject::invokeMethod(this, "ProcessJobQueue", Qt::QueuedConnection);
+  }
+}
+
+void RenderWorker::ProcessJobQueue()
+{
+  forever {
+    job_queue_lock_.lock();
+
+    if (job_queue_.isEmpty()) {
+      job_queue_lock_.unlock();
+      break;
+    }
+
+    QueuedJob job = job_queue_.takeFirst();
+
+    job_queue_lock_.unlock();
+
+    if (job.graph_changed) {
+      GraphChanged();
+    } else {
+      job_generation_ = job.generation;
+
+      if (realtime_) {
+        RenderJob(job.path);
+      } else {
+        // Waits for its turn if every other backend's workers are busy
+        RenderBudget::Slot slot(UsesGPU(), background_);
+
+        RenderJob(job.path);
+      }
+    }
+  }
+}
+
+void RenderWorker::RenderJob(const NodeDependency &path)
+{
+  PushResult(RenderResult::kCompletedCache, path, QByteArray(), RenderInternal(path));
+}
+
+bool RenderWorker::UsesGPU() const
+{
+  return false;
+}
+
+bool RenderWorker::CanForkSiblings() const
+{
+  return !realtime_;
+}
+
+bool RenderWorker::JobIsStale() const
+{
+  return generation_ != nullptr && generation_->load() != job_generation_;
+}
+
+void RenderWorker::PushResult(RenderResult::Type type, const NodeDependency &path, const QByteArray &hash, const NodeValueTable &value)
+{
+  RenderResult result;
+  result.type = type;
+  result.worker = this;
+  result.dep = path;
+  result.generation = job_generation_;
+  result.hash = hash;
+  result.value = value;
+
+  result_queue_->Push(result);
 }
 
 NodeValueTable RenderWorker::RenderAsSibling(NodeDependency dep)
@@ -52,6 +239,7 @@ NodeValueTable RenderWorker::RenderAsSibling(NodeDependency dep)
 
   // Set working state
   working_++;
+  render_depth_++;
 
   // Firstly we check if this node is a "Block", if it is that means it's part of a linked list of mutually exclusive
   // nodes based on time and we might need to locate which Block to attach to
@@ -64,6 +252,14 @@ NodeValueTable RenderWorker::RenderAsSibling(NodeDependency dep)
 
   // We're done!
 
+  // Values from this frame won't be needed again (and may be holding textures)
+  render_depth_--;
+
+  if (render_depth_ == 0) {
+    frame_values_.clear();
+    frame_coverage_.clear();
+  }
+
   // End this working state
   working_--;
 
@@ -75,6 +271,21 @@ DecoderCache *RenderWorker::decoder_cache()
   return decoder_cache_;
 }
 
+TimeRange RenderWorker::InputTimeWithPreRoll(Node *node, NodeInput *input, const TimeRange &range) const
+{
+  TimeRange input_time = node->InputTimeAdjustment(input, range);
+
+  if (input == node->MainInput() && node->ProcessesSamples()) {
+    rational pre_roll = node->SamplePreRoll();
+
+    if (pre_roll > rational()) {
+      input_time.set_in(qMax(rational(), input_time.in() - pre_roll));
+    }
+  }
+
+  return input_time;
+}
+
 NodeValueTable RenderWorker::RenderInternal(const NodeDependency &path)
 {
   return RenderAsSibling(path);
@@ -93,80 +304,625 @@ void RenderWorker::RunNodeAccelerated(Node *node, const NodeValueDatabase *input
   Q_UNUSED(output_params)
 }
 
+void RenderWorker::RunNodeSamples(Node *node, const TimeRange &range, const NodeValueDatabase &input_params,
+                                  NodeValueTable *output_params)
+{
+  Q_UNUSED(node)
+  Q_UNUSED(range)
+  Q_UNUSED(input_params)
+  Q_UNUSED(output_params)
+}
+
 StreamPtr RenderWorker::ResolveStreamFromInput(NodeInput *input)
 {
   return input->get_value_at_time(0).value<StreamPtr>();
 }
 
-DecoderPtr RenderWorker::ResolveDecoderFromInput(NodeInput *input)
+StreamPtr RenderWorker::ResolveDecodeStream(StreamPtr stream)
+{
+  return stream;
+}
+
+DecoderPtr RenderWorker::AcquireDecoderFromInput(NodeInput *input, const rational &time)
 {
   // Access a map of Node inputs and decoder instances and retrieve a frame!
   StreamPtr stream = ResolveStreamFromInput(input);
-  DecoderPtr decoder = decoder_cache()->GetDecoder(stream.get());
 
-  if (decoder == nullptr && stream != nullptr) {
+  if (stream == nullptr) {
+    return nullptr;
+  }
+
+  stream = ResolveDecodeStream(stream);
+
+  WaitForPrefetch(stream.get());
+
+  DecoderPtr decoder = decoder_cache()->AcquireDecoder(stream.get(), time, decode_profile_);
+
+  if (decoder == nullptr) {
     // Create a new Decoder here
-    DecoderPtr decoder = Decoder::CreateFromID(stream->footage()->decoder());
+    decoder = Decoder::CreateFromID(stream->footage()->decoder());
+
+    if (decoder == nullptr) {
+      decoder_cache()->CancelReservation(stream.get(), decode_profile_);
+      return nullptr;
+    }
+
     decoder->set_stream(stream);
-    decoder_cache()->AddDecoder(stream.get(), decoder);
+    decoder->set_profile(decode_profile_, DecoderThreadCount());
+    DecoderCreatedEvent(decoder);
+    decoder_cache()->AddDecoder(stream.get(), decoder, time);
   }
 
   return decoder;
 }
 
+void RenderWorker::SetDecodeProfile(Decoder::Profile profile)
+{
+  decode_profile_ = profile;
+}
+
+int RenderWorker::DecoderThreadCount() const
+{
+  int cores = QThread::idealThreadCount();
+
+  // There's only one interactive worker and it's the one the user is waiting on, so it can have every core
+  if (decode_profile_ == Decoder::kProfileInteractive) {
+    return cores;
+  }
+
+  // Every job running at once could be decoding, up to the number of decoders a stream can have
+  int concurrent_decoders = RenderBudget::ThreadCount();
+
+  if (concurrent_decoders > DecoderCache::kMaximumDecodersPerStream) {
+    concurrent_decoders = DecoderCache::kMaximumDecodersPerStream;
+  }
+
+  return qMax(1, cores / qMax(1, concurrent_decoders));
+}
+
+void RenderWorker::ReleaseDecoder(DecoderPtr decoder)
+{
+  decoder_cache()->ReleaseDecoder(decoder);
+}
+
+void RenderWorker::DecoderCreatedEvent(DecoderPtr decoder)
+{
+  Q_UNUSED(decoder)
+}
+
+int RenderWorker::PrefetchFrameCount(StreamPtr stream, rational *interval, int *divider)
+{
+  Q_UNUSED(stream)
+  Q_UNUSED(interval)
+  Q_UNUSED(divider)
+
+  return 0;
+}
+
+int RenderWorker::QueuedJobCount()
+{
+  job_queue_lock_.lock();
+  int count = job_queue_.size();
+  job_queue_lock_.unlock();
+
+  return count;
+}
+
+FramePtr RenderWorker::TakePrefetchedFrame(Stream *stream, const rational &time, int divider)
+{
+  QHash<Stream*, QList<DecodeBatchPtr> >::iterator batches = prefetches_.find(stream);
+
+  if (batches == prefetches_.end()) {
+    return nullptr;
+  }
+
+  FramePtr frame;
+  bool found = false;
+
+  for (int i=0;i<batches.value().size();i++) {
+    DecodeBatchPtr batch = batches.value().at(i);
+    int index = batch->IndexOf(time);
+
+    if (index > -1 && batch->divider() == divider) {
+      frame = batch->Wait(index);
+      found = true;
+      break;
+    }
+  }
+
+  // Drop whatever's behind this time, or everything if playback has moved somewhere else
+  for (int i=0;i<batches.value().size();i++) {
+    DecodeBatchPtr batch = batches.value().at(i);
+
+    if (!found || batch->times().last() <= time) {
+      batch->Cancel();
+      batch->WaitForAll();
+      batches.value().removeAt(i);
+      i--;
+    }
+  }
+
+  if (batches.value().isEmpty()) {
+    prefetches_.erase(batches);
+  }
+
+  return frame;
+}
+
+void RenderWorker::StartPrefetch(StreamPtr stream, const rational &time, int count, const rational &interval, int divider)
+{
+  QList<DecodeBatchPtr>& batches = prefetches_[stream.get()];
+
+  QVector<rational> times;
+
+  for (int i=1;i<=count;i++) {
+    rational t = time + interval * rational(i);
+    bool prefetching = false;
+
+    foreach (DecodeBatchPtr batch, batches) {
+      if (batch->IndexOf(t) > -1) {
+        prefetching = true;
+        break;
+      }
+    }
+
+    if (!prefetching) {
+      times.append(t);
+    }
+  }
+
+  if (times.isEmpty()) {
+    return;
+  }
+
+  while (batches.size() >= kMaximumPrefetchBatches) {
+    batches.first()->Cancel();
+    batches.first()->WaitForAll();
+    batches.removeFirst();
+  }
+
+  DecodeBatchPtr batch = std::make_shared<DecodeBatch>(times, divider);
+
+  batches.append(batch);
+
+  QThreadPool::globalInstance()->start(new PrefetchTask(decoder_cache(), stream, decode_profile_, batch));
+}
+
+void RenderWorker::WaitForPrefetch(Stream *stream)
+{
+  QHash<Stream*, QList<DecodeBatchPtr> >::const_iterator batches = prefetches_.constFind(stream);
+
+  if (batches != prefetches_.constEnd()) {
+    foreach (DecodeBatchPtr batch, batches.value()) {
+      batch->WaitForAll();
+    }
+  }
+}
+
+void RenderWorker::CancelPrefetches()
+{
+  QHash<Stream*, QList<DecodeBatchPtr> >::const_iterator i;
+
+  for (i=prefetches_.constBegin();i!=prefetches_.constEnd();i++) {
+    foreach (DecodeBatchPtr batch, i.value()) {
+      batch->Cancel();
+      batch->WaitForAll();
+    }
+  }
+
+  prefetches_.clear();
+}
+
+bool RenderWorker::InputIsFused(NodeInput *input)
+{
+  Q_UNUSED(input)
+
+  return false;
+}
+
+void RenderWorker::GraphChanged()
+{
+  ClearStaticValues();
+
+  // Connections and keyframes may have changed
+  input_layouts_.clear();
+
+  GraphChangedEvent();
+}
+
 bool RenderWorker::IsStarted()
 {
   return started_;
 }
 
+void RenderWorker::InsertInputIntoDatabase(NodeValueDatabase *database, const InputLayout &input, const TimeRange &input_time, NodeValueTable table)
+{
+  // Exception for Footage types where we actually retrieve some Footage data from a decoder
+  if (input.data_type == NodeParam::kFootage) {
+    StreamPtr stream = ResolveStreamFromInput(input.input);
+    StreamPtr decode_stream = stream ? ResolveDecodeStream(stream) : nullptr;
+    rational interval;
+    int divider = 1;
+    int prefetch = decode_stream ? PrefetchFrameCount(decode_stream, &interval, &divider) : 0;
+
+    // Decoded in the background while the last frame was being rendered
+    FramePtr frame = decode_stream ? TakePrefetchedFrame(decode_stream.get(), input_time.in(), divider) : nullptr;
+
+    if (!frame) {
+      DecoderPtr decoder = AcquireDecoderFromInput(input.input, input_time.in());
+
+      if (decoder) {
+        frame = RetrieveFromDecoder(decoder, input_time);
+        ReleaseDecoder(decoder);
+      }
+    }
+
+    if (frame) {
+      FrameToValue(stream, frame, &table);
+
+      if (prefetch > 0) {
+        StartPrefetch(decode_stream, input_time.in(), prefetch, interval, divider);
+      }
+    }
+  }
+
+  database->Insert(input.input, table);
+}
+
+RenderSiblingJobPtr RenderWorker::ForkSibling(const NodeDependency &dep)
+{
+  RenderSiblingJobPtr job = std::make_shared<RenderSiblingJob>(dep);
+
+  emit RequestSibling(job);
+
+  return job;
+}
+
+NodeValueTable RenderWorker::JoinSibling(RenderSiblingJobPtr job)
+{
+  if (job->Claim()) {
+    // Nobody picked this up in the meantime, so just do it ourselves
+    return RenderAsSibling(job->dep());
+  }
+
+  return job->WaitForResult();
+}
+
+void RenderWorker::RenderSibling(RenderSiblingJobPtr job)
+{
+  // The branch runs under the forking worker's slot if there isn't one free, so it can't be held up by the budget
+  if (!RenderBudget::TryAcquire(RenderBudget::kCPU, background_)) {
+    return;
+  }
+
+  if (UsesGPU() && !RenderBudget::TryAcquire(RenderBudget::kGPU, background_)) {
+    RenderBudget::Release(RenderBudget::kCPU);
+    return;
+  }
+
+  // Unless the worker that forked this already got to it
+  if (job->Claim()) {
+    NodeValueTable value = RenderAsSibling(job->dep());
+
+    // Make sure the result is usable from the other worker before handing it over
+    SiblingFinishedEvent();
+
+    job->Finish(value);
+  }
+
+  if (UsesGPU()) {
+    RenderBudget::Release(RenderBudget::kGPU);
+  }
+
+  RenderBudget::Release(RenderBudget::kCPU);
+}
+
 NodeValueTable RenderWorker::ProcessNodeNormally(const NodeDependency& dep)
 {
   Node* node = dep.node();
 
-  // FIXME: Cache certain values here if we've already processed them before
+  // Nothing below here will be used if the graph has changed since the job was queued
+  if (JobIsStale()) {
+    return NodeValueTable();
+  }
+
+  // Includes the time spent on the nodes this one depends on, the trace shows them nested inside it
+  Tracer::Scope trace("node", node->id());
+
+  // If this node feeds more than one input, we may have already processed it for this frame
+  QPair<Node*, TimeRange> key(node, dep.range());
+  QHash<QPair<Node*, TimeRange>, NodeValueTable>::const_iterator existing = frame_values_.constFind(key);
+
+  if (existing != frame_values_.constEnd()) {
+    return existing.value();
+  }
+
+  // A bypassed node outputs its main input as it is, nothing else it depends on is needed
+  if (node->IsBypassed()) {
+    NodeValueTable table;
+    NodeInput* main_input = node->MainInput();
+
+    if (main_input && main_input->IsConnected()) {
+      table = ProcessNodeNormally(NodeDependency(main_input->get_connected_node(),
+                                                 node->InputTimeAdjustment(main_input, dep.range())));
+    }
+
+    frame_values_.insert(key, table);
+
+    return table;
+  }
+
+  // Nodes that give the same value at every time only need evaluating once
+  QHash<Node*, NodeValueTable>::const_iterator folded = static_values_.constFind(node);
+
+  if (folded != static_values_.constEnd()) {
+    return folded.value();
+  }
+
+  // A node that outputs nothing at this time doesn't need anything it depends on, including its footage, evaluated
+  QHash<NodeInput*, Node::Coverage> input_coverage = GetInputCoverage(node, dep.range());
+
+  if (node->GetCoverage(dep.range().in(), input_coverage) == Node::kCoverageNone) {
+    frame_values_.insert(key, NodeValueTable());
+    return NodeValueTable();
+  }
+
+  // A nested sequence's frame may already be cached, in which case nothing inside it needs evaluating
+  NodeInput* cached_input = node->CachedPassthroughInput();
+
+  if (cached_input && cached_input->IsConnected()) {
+    NodeValueTable table = ProcessCachedInput(cached_input->get_connected_node(),
+                                              node->InputTimeAdjustment(cached_input, dep.range()));
+
+    frame_values_.insert(key, table);
+
+    return table;
+  }
+
+  // Inputs connected to nodes that are fused into this one are replaced by those nodes' own inputs
+  QVector<InputLayout> inputs;
+  QVector<TimeRange> input_times;
+  CollectInputs(node, dep.range(), &inputs, &input_times);
+
+  // Inputs that wouldn't show in this node's output (e.g. a layer behind an opaque one) are left empty
+  QVector<bool> hidden(inputs.size());
+
+  for (int i=0;i<inputs.size();i++) {
+    const InputLayout& input = inputs.at(i);
+
+    hidden[i] = (input.connected
+                 && input.input->parentNode() == node
+                 && node->InputIsHidden(input.input, dep.range().in(), input_coverage));
+  }
+
+  // Independent branches (every connected input but the last) are offered to other workers so they can be evaluated
+  // in parallel while we work on the last one ourselves
+  QVector<RenderSiblingJobPtr> forked(inputs.size());
+  int last_connected = -1;
+  bool can_fork = CanForkSiblings();
+
+  for (int i=0;i<inputs.size();i++) {
+    if (inputs.at(i).connected && !hidden.at(i)) {
+      if (last_connected >= 0 && can_fork) {
+        forked[last_connected] = ForkSibling(NodeDependency(inputs.at(last_connected).connected,
+                                                            input_times.at(last_connected)));
+      }
+
+      last_connected = i;
+    }
+  }
 
   NodeValueDatabase database;
 
   // We need to insert tables into the database for each input
+  for (int i=0;i<inputs.size();i++) {
+    NodeValueTable table;
+    const InputLayout& input = inputs.at(i);
+    const TimeRange& input_time = input_times.at(i);
+
+    if (hidden.at(i)) {
+      // Leave the table empty
+    } else if (input.connected) {
+      if (forked.at(i)) {
+        // Fill this in once everything we're doing ourselves is done
+        continue;
+      }
+
+      // Value will equal something from the connected node, follow it
+      table = ProcessNodeNormally(NodeDependency(input.connected,
+                                                 input_time));
+    } else {
+      // Push onto the table the value at this time from the input
+      QVariant input_value = input.input->get_value_at_time(input_time.in());
+      table.Push(input.data_type, input_value);
+    }
+
+    InsertInputIntoDatabase(&database, input, input_time, table);
+  }
+
+  // Collect the branches we forked
+  for (int i=0;i<inputs.size();i++) {
+    if (forked.at(i)) {
+      InsertInputIntoDatabase(&database, inputs.at(i), input_times.at(i), JoinSibling(forked.at(i)));
+    }
+  }
+
+  // By this point, the node should have all the inputs it needs to render correctly
+
+  NodeValueTable table;
+  NodeInput* passthrough = node->PassthroughInput(database);
+
+  // Pre-rolled samples are only trimmed once the node has processed them
+  bool pre_rolled = (node->ProcessesSamples() && node->SamplePreRoll() > rational());
+
+  if (passthrough && !InputIsFused(passthrough) && !pre_rolled) {
+    // This node wouldn't change anything, so skip running it
+    table = database[passthrough];
+  } else {
+    table = node->Value(database);
+
+    // Check if we have a shader for this output
+    RunNodeAccelerated(node, &database, &table);
+
+    if (node->ProcessesSamples()) {
+      RunNodeSamples(node, dep.range(), database, &table);
+    }
+  }
+
+  // A stale job may have skipped nodes this one depends on, so its value can't be kept for other frames
+  if (!JobIsStale() && NodeIsStatic(node, GetInputLayout(node))) {
+    static_values_.insert(node, table);
+  }
+
+  frame_values_.insert(key, table);
+
+  return table;
+}
+
+NodeValueTable RenderWorker::ProcessCachedInput(Node *connected, const TimeRange &range)
+{
+  return ProcessNodeNormally(NodeDependency(connected, range));
+}
+
+QVector<RenderWorker::InputLayout> RenderWorker::GetInputLayout(Node *node)
+{
+  QHash<Node*, QVector<InputLayout> >::const_iterator existing = input_layouts_.constFind(node);
+
+  if (existing != input_layouts_.constEnd()) {
+    return existing.value();
+  }
+
+  QVector<InputLayout> layout;
+
   foreach (NodeParam* param, node->parameters()) {
     if (param->type() == NodeParam::kInput) {
-      NodeValueTable table;
       NodeInput* input = static_cast<NodeInput*>(param);
-      TimeRange input_time = node->InputTimeAdjustment(input, dep.range());
+      InputLayout entry;
 
-      if (input->IsConnected()) {
-        // Value will equal something from the connected node, follow it
-        table = ProcessNodeNormally(NodeDependency(input->get_connected_node(),
-                                                   input_time));
-      } else {
-        // Push onto the table the value at this time from the input
-        QVariant input_value = input->get_value_at_time(input_time.in());
-        table.Push(input->data_type(), input_value);
-      }
+      entry.input = input;
+      entry.connected = input->IsConnected() ? input->get_connected_node() : nullptr;
+      entry.data_type = input->data_type();
+      entry.dependent = input->dependent();
+      entry.is_array = input->IsArray();
+      entry.is_keyframing = input->is_keyframing();
+
+      layout.append(entry);
+    }
+  }
 
-      // Exception for Footage types where we actually retrieve some Footage data from a decoder
-      if (input->data_type() == NodeParam::kFootage) {
-        DecoderPtr decoder = ResolveDecoderFromInput(input);
+  // Most nodes never change their inputs, so don't keep spare capacity around for every one of them
+  layout.squeeze();
 
-        if (decoder) {
-          FramePtr frame = RetrieveFromDecoder(decoder, input_time);
+  input_layouts_.insert(node, layout);
 
-          if (frame) {
-            FrameToValue(frame, &table);
-          }
-        }
-      }
+  return layout;
+}
+
+void RenderWorker::CollectInputs(Node *node, const TimeRange &range, QVector<InputLayout> *inputs, QVector<TimeRange> *input_times)
+{
+  QVector<InputLayout> layout = GetInputLayout(node);
 
-      database.Insert(input, table);
+  for (int i=0;i<layout.size();i++) {
+    const InputLayout& input = layout.at(i);
+    TimeRange input_time = InputTimeWithPreRoll(node, input.input, range);
+
+    if (input.connected && InputIsFused(input.input)) {
+      CollectInputs(input.connected, input_time, inputs, input_times);
+    } else {
+      inputs->append(input);
+      input_times->append(input_time);
     }
   }
+}
 
-  // By this point, the node should have all the inputs it needs to render correctly
+Node::Coverage RenderWorker::GetCoverage(Node *node, const TimeRange &range)
+{
+  if (node->IsTrack()) {
+    TrackOutput* track = static_cast<TrackOutput*>(node);
 
-  NodeValueTable table = node->Value(database);
+    if (TrackOutput::IsSkipped(track->TrackChain(), track, range.in())) {
+      return Node::kCoverageNone;
+    }
 
-  // Check if we have a shader for this output
-  RunNodeAccelerated(node, &database, &table);
+    node = track->BlockAtTime(range.in());
 
-  return table;
+    // Nothing on this track at this time
+    if (!node) {
+      return Node::kCoverageNone;
+    }
+  }
+
+  QPair<Node*, TimeRange> key(node, range);
+  QHash<QPair<Node*, TimeRange>, Node::Coverage>::const_iterator existing = frame_coverage_.constFind(key);
+
+  if (existing != frame_coverage_.constEnd()) {
+    return existing.value();
+  }
+
+  Node::Coverage coverage;
+
+  if (node->IsBypassed()) {
+    // It's whatever its main input is
+    NodeInput* main_input = node->MainInput();
+
+    if (main_input && main_input->IsConnected()) {
+      coverage = GetCoverage(main_input->get_connected_node(), node->InputTimeAdjustment(main_input, range));
+    } else {
+      coverage = Node::kCoverageNone;
+    }
+  } else {
+    coverage = node->GetCoverage(range.in(), GetInputCoverage(node, range));
+  }
+
+  frame_coverage_.insert(key, coverage);
+
+  return coverage;
+}
+
+QHash<NodeInput *, Node::Coverage> RenderWorker::GetInputCoverage(Node *node, const TimeRange &range)
+{
+  QHash<NodeInput*, Node::Coverage> input_coverage;
+  QVector<InputLayout> layout = GetInputLayout(node);
+
+  for (int i=0;i<layout.size();i++) {
+    const InputLayout& input = layout.at(i);
+
+    if (input.connected && input.dependent) {
+      input_coverage.insert(input.input, GetCoverage(input.connected,
+                                                     node->InputTimeAdjustment(input.input, range)));
+    }
+  }
+
+  return input_coverage;
+}
+
+bool RenderWorker::NodeIsStatic(Node *node, const QVector<InputLayout> &layout) const
+{
+  // Blocks (and so tracks) depend on where they are in time
+  if (node->IsBlock()) {
+    return false;
+  }
+
+  for (int i=0;i<layout.size();i++) {
+    const InputLayout& input = layout.at(i);
+
+    if (input.is_array) {
+      return false;
+    }
+
+    if (input.connected) {
+      if (!static_values_.contains(input.connected)) {
+        return false;
+      }
+    } else if (input.is_keyframing || input.data_type == NodeParam::kFootage) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void RenderWorker::ClearStaticValues()
+{
+  static_values_.clear();
 }
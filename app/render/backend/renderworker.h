@@ -1,12 +1,16 @@
 #ifndef RENDERWORKER_H
 #define RENDERWORKER_H
 
+#include <QHash>
+#include <QMutex>
 #include <QObject>
 
 #include "common/constructors.h"
 #include "node/output/track/track.h"
 #include "node/node.h"
 #include "decodercache.h"
+#include "renderresultqueue.h"
+#include "rendersiblingjob.h"
 
 class RenderWorker : public QObject
 {
@@ -22,19 +26,130 @@ public:
 
   bool IsAvailable();
 
+  /**
+   * @brief Number of jobs this worker is in the middle of (safe to call from any thread)
+   */
+  int JobsInProgress() const;
+
+  /**
+   * @brief Set the queue this worker pushes the results of its jobs to
+   *
+   * Must be set before any jobs are queued.
+   */
+  void SetResultQueue(RenderResultQueue* queue);
+
+  /**
+   * @brief Set the counter the backend bumps whenever the copied graph changes
+   *
+   * A job queued under an older generation than the counter's is stale (see JobIsStale()). Without a counter (the
+   * default), jobs are never stale. Must be set before any jobs are queued.
+   */
+  void SetGeneration(const QAtomicInt* generation);
+
+  /**
+   * @brief Set the profile of the decoders this worker uses (kProfileThroughput by default)
+   *
+   * Workers only share decoders with workers of the same profile. Must be set before any jobs are queued.
+   */
+  void SetDecodeProfile(Decoder::Profile profile);
+
+  /**
+   * @brief Run jobs as soon as they're queued, without waiting for a RenderBudget slot (FALSE by default)
+   *
+   * For a worker whose jobs something is waiting on in real time (e.g. audio playback), which must never queue behind
+   * other backends' work. A realtime worker doesn't fork siblings either, and isn't offered siblings forked by other
+   * workers. Must be set before any jobs are queued.
+   */
+  void SetRealtime(bool e);
+
+  bool IsRealtime() const;
+
+  /**
+   * @brief Take background slots from RenderBudget for jobs (see RenderBudget::SetBackgroundFraction(), FALSE by
+   * default)
+   *
+   * Has no effect on a realtime worker, which doesn't take slots at all. Must be set before any jobs are queued.
+   */
+  void SetBackground(bool e);
+
+  bool IsBackground() const;
+
+  /**
+   * @brief Queue a job for this worker (thread-safe)
+   *
+   * Jobs wait in this worker's own queue rather than being sent as queued calls. The worker's thread is only woken when
+   * the queue goes from empty to non-empty and runs every job waiting when it wakes.
+   *
+   * @param generation
+   *
+   * The value of the generation counter when the job was queued.
+   */
+  void QueueJob(const NodeDependency& path, int generation);
+
+  /**
+   * @brief Queue a GraphChanged() call in order with jobs queued with QueueJob() (thread-safe)
+   */
+  void QueueGraphChanged();
+
 public slots:
   void Close();
 
-  void Render(NodeDependency path);
-
   NodeValueTable RenderAsSibling(NodeDependency dep);
 
-signals:
-  void RequestSibling(NodeDependency path);
+  /**
+   * @brief Evaluate a branch another worker forked with ForkSibling(), if it hasn't been claimed already
+   */
+  void RenderSibling(RenderSiblingJobPtr job);
+
+  /**
+   * @brief Signal that the values or connections of the nodes being rendered have changed
+   */
+  void GraphChanged();
 
-  void CompletedCache(NodeDependency dep, NodeValueTable data);
+signals:
+  void RequestSibling(RenderSiblingJobPtr job);
 
 protected:
+  /**
+   * @brief Run one job taken from the queue and push its result
+   *
+   * The default implementation renders the job with RenderInternal() and pushes the value as a
+   * RenderResult::kCompletedCache.
+   */
+  virtual void RenderJob(const NodeDependency& path);
+
+  /**
+   * @brief Returns whether this worker's jobs run on the GPU (FALSE by default)
+   *
+   * If so, each job takes a GPU slot from RenderBudget as well as a CPU one.
+   */
+  virtual bool UsesGPU() const;
+
+  /**
+   * @brief Returns whether independent branches can be offered to other workers with ForkSibling()
+   *
+   * TRUE by default, unless this worker is realtime (see SetRealtime()).
+   *
+   * Derivatives can return FALSE while they're rendering something other workers wouldn't render the same way.
+   */
+  virtual bool CanForkSiblings() const;
+
+  /**
+   * @brief Returns whether the graph has changed since the job being run was queued
+   *
+   * Checked between nodes, so a stale frame stops being evaluated as soon as possible. Whatever it rendered is out of
+   * date and may have read the graph while it was being changed.
+   */
+  bool JobIsStale() const;
+
+  /**
+   * @brief Push the result of a job to the result queue
+   */
+  void PushResult(RenderResult::Type type,
+                  const NodeDependency& path,
+                  const QByteArray& hash = QByteArray(),
+                  const NodeValueTable& value = NodeValueTable());
+
   virtual bool InitInternal() = 0;
 
   virtual void CloseInternal() = 0;
@@ -45,26 +160,280 @@ protected:
 
   virtual void RunNodeAccelerated(Node *node, const NodeValueDatabase *input_params, NodeValueTable* output_params);
 
+  /**
+   * @brief Run a node that processes samples (see Node::ProcessesSamples()) over `range`, after its Value()
+   *
+   * MainInput()'s samples start earlier than `range` by the node's pre-roll (see InputTimeWithPreRoll()), which should
+   * be processed and left out of the output. The default does nothing.
+   */
+  virtual void RunNodeSamples(Node* node, const TimeRange& range, const NodeValueDatabase& input_params,
+                              NodeValueTable* output_params);
+
   StreamPtr ResolveStreamFromInput(NodeInput* input);
-  DecoderPtr ResolveDecoderFromInput(NodeInput* input);
+
+  /**
+   * @brief Choose which stream is actually decoded when `stream` is needed
+   *
+   * Derivatives can override this to decode a stand-in for the stream (e.g. a proxy). The default decodes `stream`
+   * itself.
+   */
+  virtual StreamPtr ResolveDecodeStream(StreamPtr stream);
+
+  /**
+   * @brief Acquire a decoder for this input's stream, positioned as close to `time` as possible
+   *
+   * The decoder is exclusively ours until it's released with ReleaseDecoder().
+   */
+  DecoderPtr AcquireDecoderFromInput(NodeInput* input, const rational& time);
+
+  void ReleaseDecoder(DecoderPtr decoder);
+
+  /**
+   * @brief How many frames of `stream` after one that's just been decoded to start decoding in the background
+   *
+   * Frames are prefetched `interval` apart at `divider` (as passed to Decoder::RetrieveVideo()), so they're ready when
+   * the jobs behind this one need them rather than being decoded while the rest of the graph waits. The default
+   * returns 0 (never prefetch).
+   */
+  virtual int PrefetchFrameCount(StreamPtr stream, rational* interval, int* divider);
+
+  /**
+   * @brief Number of jobs waiting in this worker's queue behind the one being run
+   */
+  int QueuedJobCount();
+
+  /**
+   * @brief Called when AcquireDecoderFromInput() creates a new Decoder so workers can configure it before first use
+   */
+  virtual void DecoderCreatedEvent(DecoderPtr decoder);
+
+  /**
+   * @brief Called by GraphChanged() so workers can clear anything they've derived from the node graph
+   */
+  virtual void GraphChangedEvent(){}
 
   virtual FramePtr RetrieveFromDecoder(DecoderPtr decoder, const TimeRange& range) = 0;
 
-  virtual void FrameToValue(FramePtr frame, NodeValueTable* table) = 0;
+  /**
+   * @brief Convert a decoded frame from `stream` into a value and push it onto `table`
+   *
+   * `stream` is nullptr for frames that are already in the reference space (e.g. cached frames of a nested sequence,
+   * see ProcessCachedInput()), these don't need converting.
+   */
+  virtual void FrameToValue(StreamPtr stream, FramePtr frame, NodeValueTable* table) = 0;
 
   NodeValueTable ProcessNodeNormally(const NodeDependency &dep);
 
+  /**
+   * @brief Get the value of `connected`, which another node passes through with Node::CachedPassthroughInput()
+   *
+   * Derivatives that cache their output can override this to use a cached frame instead of evaluating `connected`.
+   * The default evaluates it as normal.
+   */
+  virtual NodeValueTable ProcessCachedInput(Node* connected, const TimeRange& range);
+
+  /**
+   * @brief Offer a branch of the current frame to other workers so it can be evaluated in parallel
+   *
+   * The result must be collected with JoinSibling().
+   */
+  RenderSiblingJobPtr ForkSibling(const NodeDependency& dep);
+
+  /**
+   * @brief Get the result of a branch from ForkSibling(), evaluating it on this worker if nobody else has started it
+   */
+  NodeValueTable JoinSibling(RenderSiblingJobPtr job);
+
+  /**
+   * @brief Called after evaluating a branch for another worker, before the result is handed over
+   *
+   * Derivatives should make sure anything in the result (e.g. GPU textures) is ready to be used from another thread.
+   */
+  virtual void SiblingFinishedEvent(){}
+
+  /**
+   * @brief Returns whether the node connected to this input is evaluated as part of the input's own node
+   *
+   * When TRUE, the connected node isn't evaluated by itself. Its inputs are evaluated instead and added to the same
+   * database, and RunNodeAccelerated() is expected to produce both nodes' output in one go.
+   */
+  virtual bool InputIsFused(NodeInput* input);
+
   virtual NodeValueTable RenderBlock(TrackOutput *track, const TimeRange& range) = 0;
 
   DecoderCache* decoder_cache();
 
+  /**
+   * @brief The time `input` of `node` is evaluated at for `range`
+   *
+   * The node's InputTimeAdjustment(), started earlier by the node's Node::SamplePreRoll() if `input` is the
+   * MainInput() of a node that processes samples. Never starts before 0.
+   */
+  TimeRange InputTimeWithPreRoll(Node* node, NodeInput* input, const TimeRange& range) const;
+
+  /**
+   * @brief Forget values of static nodes, e.g. because the parameters they were rendered with changed
+   */
+  void ClearStaticValues();
+
   QAtomicInt working_;
 
 private:
+  /**
+   * @brief Everything evaluating a node needs to know about one of its inputs, read once from the graph
+   */
+  struct InputLayout {
+    NodeInput* input;
+
+    /// The node connected to this input or nullptr if it isn't connected
+    Node* connected;
+
+    NodeParam::DataType data_type;
+    bool dependent;
+    bool is_array;
+    bool is_keyframing;
+  };
+
+  /**
+   * @brief Get `node`'s inputs as a flat array, built the first time it's needed after the graph changes
+   *
+   * Evaluating a frame visits every node at least once and the same nodes again on every frame, so this saves walking
+   * each node's child objects and following each edge every time. Returned by value, the array itself is shared.
+   */
+  QVector<InputLayout> GetInputLayout(Node* node);
+
+  /**
+   * @brief Returns whether a node that was just evaluated will give the same value at every time
+   *
+   * True if nothing it depends on is keyframed, footage or a Block. Its inputs must have already been evaluated.
+   */
+  bool NodeIsStatic(Node* node, const QVector<InputLayout>& layout) const;
+
+  /**
+   * @brief Gather the inputs (and the times they're needed at) that have to be evaluated to evaluate `node`
+   */
+  void CollectInputs(Node* node, const TimeRange& range, QVector<InputLayout>* inputs, QVector<TimeRange>* input_times);
+
+  void InsertInputIntoDatabase(NodeValueDatabase* database, const InputLayout& input, const TimeRange& input_time, NodeValueTable table);
+
+  /**
+   * @brief Work out how much of the frame `node` covers at this time (see Node::GetCoverage())
+   *
+   * Tracks resolve to the Block at this time. Nothing is rendered, only the nodes' parameters are checked.
+   */
+  Node::Coverage GetCoverage(Node* node, const TimeRange& range);
+
+  /**
+   * @brief Coverage of the nodes connected to each of `node`'s inputs, as passed to Node::GetCoverage()
+   */
+  QHash<NodeInput*, Node::Coverage> GetInputCoverage(Node* node, const TimeRange& range);
+
+  /**
+   * @brief Values of every node already evaluated for the frame currently being rendered
+   *
+   * A node whose output is used by several inputs is only evaluated once per frame. Cleared when the outermost
+   * RenderAsSibling() call finishes.
+   */
+  QHash<QPair<Node*, TimeRange>, NodeValueTable> frame_values_;
+
+  /**
+   * @brief Results of GetCoverage() for the frame currently being rendered, cleared with frame_values_
+   */
+  QHash<QPair<Node*, TimeRange>, Node::Coverage> frame_coverage_;
+
+  /**
+   * @brief Values of nodes that don't change over time, kept across frames until the graph changes
+   */
+  QHash<Node*, NodeValueTable> static_values_;
+
+  /**
+   * @brief Results of GetInputLayout(), kept until the graph changes
+   */
+  QHash<Node*, QVector<InputLayout> > input_layouts_;
+
+  int render_depth_;
+
   bool started_;
 
   DecoderCache* decoder_cache_;
 
+  Decoder::Profile decode_profile_;
+
+  bool realtime_;
+
+  bool background_;
+
+  /**
+   * @brief Threads each new decoder gets, so decoders and workers between them don't ask for more than there are cores
+   */
+  int DecoderThreadCount() const;
+
+  /**
+   * @brief Take the frame of `stream` at this time from a batch started by StartPrefetch(), waiting for it if it's
+   * still being decoded
+   *
+   * Returns nullptr if it isn't in any batch. Batches that are behind this time are dropped.
+   */
+  FramePtr TakePrefetchedFrame(Stream* stream, const rational& time, int divider);
+
+  /**
+   * @brief Decode `count` frames of `stream` after `time` in the background, skipping any already being prefetched
+   */
+  void StartPrefetch(StreamPtr stream, const rational& time, int count, const rational& interval, int divider);
+
+  /**
+   * @brief Wait until the decoders prefetching `stream` are free again, so acquiring one doesn't open another
+   */
+  void WaitForPrefetch(Stream* stream);
+
+  /**
+   * @brief Cancel every prefetch and wait until their decoders are free
+   */
+  void CancelPrefetches();
+
+  /**
+   * @brief Most batches kept for a stream, older ones are dropped once they've finished
+   */
+  static const int kMaximumPrefetchBatches = 4;
+
+  /**
+   * @brief Batches of frames being decoded ahead of the jobs that need them, oldest first
+   */
+  QHash<Stream*, QList<DecodeBatchPtr> > prefetches_;
+
+  /**
+   * @brief A job waiting in the queue, either a frame to render or a GraphChanged() call
+   */
+  struct QueuedJob {
+    NodeDependency path;
+    int generation;
+    bool graph_changed;
+  };
+
+  /**
+   * @brief Add a job to the queue, waking this worker's thread if the queue was empty
+   */
+  void EnqueueJob(const QueuedJob& job);
+
+  QList<QueuedJob> job_queue_;
+
+  QMutex job_queue_lock_;
+
+  RenderResultQueue* result_queue_;
+
+  const QAtomicInt* generation_;
+
+  /**
+   * @brief Generation of the job currently being run
+   */
+  int job_generation_;
+
+private slots:
+  /**
+   * @brief Run every job in the queue (including any queued while it runs)
+   */
+  void ProcessJobQueue();
+
 };
 
 #endif // RENDERWORKER_H
@@ -0,0 +1,57 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "softwaretexture.h"
+
+SoftwareTexture::SoftwareTexture(int width, int height) :
+  width_(width),
+  height_(height),
+  frame_(Frame::Create())
+{
+  frame_->set_width(width);
+  frame_->set_height(height);
+  frame_->set_format(olive::PIX_FMT_RGBA32F);
+  frame_->allocate();
+}
+
+int SoftwareTexture::width() const
+{
+  return width_;
+}
+
+int SoftwareTexture::height() const
+{
+  return height_;
+}
+
+float *SoftwareTexture::data()
+{
+  return reinterpret_cast<float*>(frame_->data());
+}
+
+const float *SoftwareTexture::const_data() const
+{
+  return reinterpret_cast<const float*>(frame_->const_data());
+}
+
+FramePtr SoftwareTexture::frame() const
+{
+  return frame_;
+}
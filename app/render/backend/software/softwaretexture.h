@@ -0,0 +1,68 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef SOFTWARETEXTURE_H
+#define SOFTWARETEXTURE_H
+
+#include <memory>
+#include <QMetaType>
+
+#include "common/constructors.h"
+#include "decoder/frame.h"
+
+/**
+ * @brief A frame rendered on the CPU by SoftwareWorker, the software equivalent of an OpenGLTexture
+ *
+ * Always 32-bit float RGBA whatever the render's format is, it's only converted when it's downloaded. The pixels are
+ * a Frame so their buffer comes from (and goes back to) FramePool.
+ */
+class SoftwareTexture
+{
+public:
+  SoftwareTexture(int width, int height);
+
+  DISABLE_COPY_MOVE(SoftwareTexture)
+
+  int width() const;
+
+  int height() const;
+
+  float* data();
+
+  const float* const_data() const;
+
+  /**
+   * @brief The frame holding the pixels, for functions that work on frames (e.g. ColorProcessor::ConvertFrame())
+   */
+  FramePtr frame() const;
+
+private:
+  int width_;
+
+  int height_;
+
+  FramePtr frame_;
+
+};
+
+using SoftwareTexturePtr = std::shared_ptr<SoftwareTexture>;
+Q_DECLARE_METATYPE(SoftwareTexturePtr)
+
+#endif // SOFTWARETEXTURE_H
@@ -0,0 +1,677 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "softwareworker.h"
+
+#include <QDebug>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
+#include <QtMath>
+
+#include "common/define.h"
+#include "common/slicepool.h"
+#include "common/tracer.h"
+#include "node/blend/alphaover/alphaover.h"
+#include "node/color/opacity/opacity.h"
+#include "node/input/media/video/video.h"
+#include "project/item/footage/imagestream.h"
+#include "render/colormanager.h"
+#include "render/pixelkernels.h"
+#include "render/pixelservice.h"
+#include "render/renderbudget.h"
+
+namespace {
+
+/**
+ * @brief Bands smaller than this aren't worth the overhead of handing to another thread
+ */
+const int kMinimumBandHeight = 16;
+
+/**
+ * @brief Draws a band of rows of a texture
+ *
+ * Process() may be called from several threads at once for different bands, so it must only write to its own rows.
+ */
+class BandKernel
+{
+public:
+  virtual ~BandKernel(){}
+
+  virtual void Process(int first_row, int row_count) const = 0;
+};
+
+/**
+ * @brief Runs a band of a kernel on the thread pool with a CPU slot taken for it, then gives the slot back
+ */
+class BandTask : public QRunnable
+{
+public:
+  BandTask(const BandKernel* kernel, int first_row, int row_count, QSemaphore* finished) :
+    kernel_(kernel),
+    first_row_(first_row),
+    row_count_(row_count),
+    finished_(finished)
+  {
+  }
+
+  virtual void run() override
+  {
+    kernel_->Process(first_row_, row_count_);
+
+    RenderBudget::Release(RenderBudget::kCPU);
+
+    finished_->release();
+  }
+
+private:
+  const BandKernel* kernel_;
+
+  int first_row_;
+
+  int row_count_;
+
+  QSemaphore* finished_;
+
+};
+
+/**
+ * @brief Run `kernel` over `height` rows, on as many threads as the render budget has CPU slots to spare
+ */
+void RunInBands(const BandKernel& kernel, int height)
+{
+  int band_count = qMax(1, qMin(RenderBudget::ThreadCount(), height / kMinimumBandHeight));
+  int band_height = (height + band_count - 1) / band_count;
+
+  QSemaphore finished;
+  int started = 0;
+
+  // Bands that don't get a slot of their own are run in this thread, which already has one
+  QVector<int> local_bands;
+  local_bands.append(0);
+
+  for (int y=band_height;y<height;y+=band_height) {
+    if (RenderBudget::TryAcquire(RenderBudget::kCPU)) {
+      SlicePool::instance()->start(new BandTask(&kernel, y, qMin(band_height, height - y), &finished));
+      started++;
+    } else {
+      local_bands.append(y);
+    }
+  }
+
+  foreach (int y, local_bands) {
+    kernel.Process(y, qMin(band_height, height - y));
+  }
+
+  finished.acquire(started);
+}
+
+/**
+ * @brief Convert a packed RGBA frame of any format to a float texture of the same size
+ */
+class UploadKernel : public BandKernel
+{
+public:
+  UploadKernel(FramePtr source, SoftwareTexturePtr destination) :
+    source_(source->const_data()),
+    format_(source->format()),
+    destination_(destination->data()),
+    row_channels_(destination->width() * kRGBAChannels)
+  {
+  }
+
+  virtual void Process(int first_row, int row_count) const override
+  {
+    int offset = first_row * row_channels_;
+    int count = row_count * row_channels_;
+
+    switch (format_) {
+    case olive::PIX_FMT_RGBA8:
+      olive::kernels::UInt8ToFloat(reinterpret_cast<const uint8_t*>(source_) + offset, destination_ + offset, count);
+      break;
+    case olive::PIX_FMT_RGBA16U:
+      olive::kernels::UInt16ToFloat(reinterpret_cast<const uint16_t*>(source_) + offset, destination_ + offset, count);
+      break;
+    case olive::PIX_FMT_RGBA16F:
+      olive::kernels::HalfToFloat(reinterpret_cast<const qfloat16*>(source_) + offset, destination_ + offset, count);
+      break;
+    case olive::PIX_FMT_RGBA32F:
+      memcpy(destination_ + offset,
+             reinterpret_cast<const float*>(source_) + offset,
+             static_cast<size_t>(count) * sizeof(float));
+      break;
+    case olive::PIX_FMT_INVALID:
+    case olive::PIX_FMT_COUNT:
+      break;
+    }
+  }
+
+private:
+  const char* source_;
+
+  olive::PixelFormat format_;
+
+  float* destination_;
+
+  int row_channels_;
+
+};
+
+/**
+ * @brief Sample a texture through a matrix like VideoInput's shader, with bilinear filtering
+ *
+ * Output pixels that land outside the source are transparent.
+ */
+class SampleKernel : public BandKernel
+{
+public:
+  SampleKernel(SoftwareTexturePtr source, SoftwareTexturePtr destination, const QMatrix4x4& matrix) :
+    source_(source->const_data()),
+    source_width_(source->width()),
+    source_height_(source->height()),
+    destination_(destination->data()),
+    width_(destination->width()),
+    height_(destination->height())
+  {
+    // The shader multiplies the row vector (s, t, 0, 1) by the matrix, so only these elements matter
+    for (int i=0;i<2;i++) {
+      s_coefficients_[i] = matrix(0, i);
+      t_coefficients_[i] = matrix(1, i);
+      offsets_[i] = matrix(3, i);
+    }
+  }
+
+  virtual void Process(int first_row, int row_count) const override
+  {
+    for (int y=first_row;y<first_row+row_count;y++) {
+      float t = (y + 0.5f) / height_;
+      float* row = destination_ + y * width_ * kRGBAChannels;
+
+      for (int x=0;x<width_;x++) {
+        float s = (x + 0.5f) / width_;
+
+        Sample(s * s_coefficients_[0] + t * t_coefficients_[0] + offsets_[0],
+               s * s_coefficients_[1] + t * t_coefficients_[1] + offsets_[1],
+               row + x * kRGBAChannels);
+      }
+    }
+  }
+
+private:
+  void Sample(float s, float t, float* destination) const
+  {
+    if (s < 0.0f || s > 1.0f || t < 0.0f || t > 1.0f) {
+      for (int i=0;i<kRGBAChannels;i++) {
+        destination[i] = 0.0f;
+      }
+      return;
+    }
+
+    // Texel centers are at half-texel offsets
+    float tx = s * source_width_ - 0.5f;
+    float ty = t * source_height_ - 0.5f;
+
+    int x0 = qFloor(tx);
+    int y0 = qFloor(ty);
+
+    float fx = tx - x0;
+    float fy = ty - y0;
+
+    int x1 = qBound(0, x0 + 1, source_width_ - 1);
+    int y1 = qBound(0, y0 + 1, source_height_ - 1);
+    x0 = qBound(0, x0, source_width_ - 1);
+    y0 = qBound(0, y0, source_height_ - 1);
+
+    const float* p00 = source_ + (y0 * source_width_ + x0) * kRGBAChannels;
+    const float* p10 = source_ + (y0 * source_width_ + x1) * kRGBAChannels;
+    const float* p01 = source_ + (y1 * source_width_ + x0) * kRGBAChannels;
+    const float* p11 = source_ + (y1 * source_width_ + x1) * kRGBAChannels;
+
+    for (int i=0;i<kRGBAChannels;i++) {
+      float top = p00[i] + (p10[i] - p00[i]) * fx;
+      float bottom = p01[i] + (p11[i] - p01[i]) * fx;
+
+      destination[i] = top + (bottom - top) * fy;
+    }
+  }
+
+  const float* source_;
+
+  int source_width_;
+
+  int source_height_;
+
+  float* destination_;
+
+  int width_;
+
+  int height_;
+
+  float s_coefficients_[2];
+
+  float t_coefficients_[2];
+
+  float offsets_[2];
+
+};
+
+/**
+ * @brief Copy a texture of the same size moved by whole pixels (see VideoInput::MatrixIsPixelAligned())
+ *
+ * Destination pixels with nothing to copy are transparent, as they would be when sampling.
+ */
+class CopyKernel : public BandKernel
+{
+public:
+  CopyKernel(SoftwareTexturePtr source, SoftwareTexturePtr destination, const QPoint& offset) :
+    source_(source->const_data()),
+    destination_(destination->data()),
+    width_(destination->width()),
+    height_(destination->height()),
+    offset_(offset)
+  {
+  }
+
+  virtual void Process(int first_row, int row_count) const override
+  {
+    // Columns of the destination that have a source pixel
+    int first_column = qBound(0, -offset_.x(), width_);
+    int last_column = qBound(0, width_ - offset_.x(), width_);
+
+    for (int y=first_row;y<first_row+row_count;y++) {
+      float* row = destination_ + y * width_ * kRGBAChannels;
+      int source_y = y + offset_.y();
+
+      if (source_y < 0 || source_y >= height_ || first_column >= last_column) {
+        memset(row, 0, static_cast<size_t>(width_ * kRGBAChannels) * sizeof(float));
+        continue;
+      }
+
+      memset(row, 0, static_cast<size_t>(first_column * kRGBAChannels) * sizeof(float));
+
+      memcpy(row + first_column * kRGBAChannels,
+             source_ + (source_y * width_ + first_column + offset_.x()) * kRGBAChannels,
+             static_cast<size_t>((last_column - first_column) * kRGBAChannels) * sizeof(float));
+
+      memset(row + last_column * kRGBAChannels,
+             0,
+             static_cast<size_t>((width_ - last_column) * kRGBAChannels) * sizeof(float));
+    }
+  }
+
+private:
+  const float* source_;
+
+  float* destination_;
+
+  int width_;
+
+  int height_;
+
+  QPoint offset_;
+
+};
+
+class FillKernel : public BandKernel
+{
+public:
+  FillKernel(SoftwareTexturePtr destination, const QVector4D& color) :
+    destination_(destination->data()),
+    width_(destination->width())
+  {
+    color_[0] = color.x();
+    color_[1] = color.y();
+    color_[2] = color.z();
+    color_[3] = color.w();
+  }
+
+  virtual void Process(int first_row, int row_count) const override
+  {
+    olive::kernels::FillRGBA(destination_ + first_row * width_ * kRGBAChannels, color_, row_count * width_);
+  }
+
+private:
+  float* destination_;
+
+  int width_;
+
+  float color_[kRGBAChannels];
+
+};
+
+/**
+ * @brief Multiply every channel by a factor (e.g. for OpacityNode), a missing source is transparent
+ */
+class MultiplyKernel : public BandKernel
+{
+public:
+  MultiplyKernel(SoftwareTexturePtr source, SoftwareTexturePtr destination, float factor) :
+    source_(source ? source->const_data() : nullptr),
+    destination_(destination->data()),
+    width_(destination->width()),
+    factor_(factor)
+  {
+  }
+
+  virtual void Process(int first_row, int row_count) const override
+  {
+    int offset = first_row * width_ * kRGBAChannels;
+    int count = row_count * width_ * kRGBAChannels;
+
+    if (source_ == nullptr) {
+      memset(destination_ + offset, 0, static_cast<size_t>(count) * sizeof(float));
+    } else {
+      olive::kernels::Multiply(source_ + offset, destination_ + offset, factor_, count);
+    }
+  }
+
+private:
+  const float* source_;
+
+  float* destination_;
+
+  int width_;
+
+  float factor_;
+
+};
+
+/**
+ * @brief Composite like AlphaOverBlend's shader, missing textures are transparent
+ */
+class AlphaOverKernel : public BandKernel
+{
+public:
+  AlphaOverKernel(SoftwareTexturePtr base, SoftwareTexturePtr blend, SoftwareTexturePtr destination) :
+    base_(base ? base->const_data() : nullptr),
+    blend_(blend ? blend->const_data() : nullptr),
+    destination_(destination->data()),
+    width_(destination->width())
+  {
+  }
+
+  virtual void Process(int first_row, int row_count) const override
+  {
+    int offset = first_row * width_ * kRGBAChannels;
+    int pixels = row_count * width_;
+
+    if (blend_ != nullptr) {
+      olive::kernels::AlphaOver(base_ ? base_ + offset : nullptr, blend_ + offset, destination_ + offset, pixels);
+    } else if (base_ != nullptr) {
+      memcpy(destination_ + offset, base_ + offset, static_cast<size_t>(pixels * kRGBAChannels) * sizeof(float));
+    } else {
+      memset(destination_ + offset, 0, static_cast<size_t>(pixels * kRGBAChannels) * sizeof(float));
+    }
+  }
+
+private:
+  const float* base_;
+
+  const float* blend_;
+
+  float* destination_;
+
+  int width_;
+
+};
+
+}
+
+SoftwareWorker::SoftwareWorker(DecoderCache *decoder_cache, VideoRenderFrameCache *frame_cache, VideoRenderFrameWriter *frame_writer, QObject *parent) :
+  VideoRenderWorker(decoder_cache, frame_cache, frame_writer, parent)
+{
+}
+
+void SoftwareWorker::CloseInternal()
+{
+  color_processors_.clear();
+
+  VideoRenderWorker::CloseInternal();
+}
+
+void SoftwareWorker::FrameToValue(StreamPtr stream, FramePtr frame, NodeValueTable *table)
+{
+  if (frame->is_yuv()) {
+    // Decoders only hand over YUV when asked to (see DecoderCreatedEvent()), which this worker never does
+    qWarning() << "Software rendering can't convert planar YUV frames";
+    return;
+  }
+
+  if (frame->format() == olive::PIX_FMT_INVALID || frame->format() == olive::PIX_FMT_COUNT) {
+    return;
+  }
+
+  SoftwareTexturePtr footage = std::make_shared<SoftwareTexture>(frame->width(), frame->height());
+
+  RunInBands(UploadKernel(frame, footage), footage->height());
+
+  if (stream && (stream->type() == Stream::kVideo || stream->type() == Stream::kImage)) {
+    ImageStreamPtr image_stream = std::static_pointer_cast<ImageStream>(stream);
+
+    if (!image_stream->colorspace().isEmpty()) {
+      ConvertToReferenceSpace(footage, image_stream->colorspace(), image_stream->premultiplied_alpha());
+    }
+  }
+
+  table->Push(NodeParam::kTexture, QVariant::fromValue(footage));
+}
+
+void SoftwareWorker::ConvertToReferenceSpace(SoftwareTexturePtr footage, const QString &colorspace, bool alpha_is_associated)
+{
+  OCIO::ConstConfigRcPtr config = OCIO::GetCurrentConfig();
+  OCIO::ConstColorSpaceRcPtr reference = config->getColorSpace(OCIO::ROLE_SCENE_LINEAR);
+
+  // Footage that's already in the reference space needs no conversion
+  if (reference == nullptr || colorspace == reference->getName()) {
+    return;
+  }
+
+  ColorProcessorPtr processor;
+  QHash<QString, ColorProcessorPtr>::const_iterator existing = color_processors_.constFind(colorspace);
+
+  if (existing == color_processors_.constEnd()) {
+    try {
+      processor = ColorManager::GetProcessor(colorspace, OCIO::ROLE_SCENE_LINEAR);
+    } catch (OCIO::Exception& e) {
+      qWarning() << "Failed to create color transform from" << colorspace << "-" << e.what();
+    }
+
+    // Failures are cached too so we don't retry on every frame
+    color_processors_.insert(colorspace, processor);
+  } else {
+    processor = existing.value();
+  }
+
+  if (!processor) {
+    return;
+  }
+
+  // Same order as the shader OpenGLShader::CreateOCIO() generates
+  if (alpha_is_associated) {
+    ColorManager::DisassociateAlpha(footage->frame());
+    processor->ConvertFrame(footage->frame());
+    ColorManager::ReassociateAlpha(footage->frame());
+  } else {
+    processor->ConvertFrame(footage->frame());
+    ColorManager::AssociateAlpha(footage->frame());
+  }
+}
+
+void SoftwareWorker::RunNodeAccelerated(Node *node, const NodeValueDatabase *input_params, NodeValueTable *output_params)
+{
+  Tracer::Scope trace("draw", node->id());
+
+  // Inputs are looked up by the same IDs the shaders use as uniform names
+  SoftwareTexturePtr output;
+
+  if (dynamic_cast<VideoInput*>(node)) {
+    SoftwareTexturePtr footage = GetTexture((*input_params)["footage_in"]);
+
+    if (footage) {
+      output = DrawFootage(footage, (*input_params)["matrix_in"].Get(NodeParam::kMatrix).value<QMatrix4x4>());
+    } else {
+      output = CreateOutputTexture();
+      RunInBands(MultiplyKernel(nullptr, output, 0.0f), output->height());
+    }
+  } else if (dynamic_cast<OpacityNode*>(node)) {
+    float opacity = (*input_params)["opacity_in"].Get(NodeParam::kFloat).toFloat() * 0.01f;
+    float color[kRGBAChannels];
+
+    if (GetConstantColor((*input_params)["tex_in"], color)) {
+      // Only one pixel to multiply
+      olive::kernels::Multiply(color, color, opacity, kRGBAChannels);
+      output_params->Push(NodeParam::kTexture, NodeValue::ConstantTexture(QVector4D(color[0], color[1], color[2], color[3])));
+      return;
+    }
+
+    output = CreateOutputTexture();
+    RunInBands(MultiplyKernel(GetTexture((*input_params)["tex_in"]), output, opacity), output->height());
+  } else if (dynamic_cast<AlphaOverBlend*>(node)) {
+    float base_color[kRGBAChannels];
+    float blend_color[kRGBAChannels];
+
+    if (GetConstantColor((*input_params)["base_in"], base_color)
+        && GetConstantColor((*input_params)["blend_in"], blend_color)) {
+      olive::kernels::AlphaOver(base_color, blend_color, blend_color, 1);
+      output_params->Push(NodeParam::kTexture, NodeValue::ConstantTexture(QVector4D(blend_color[0],
+                                                                                    blend_color[1],
+                                                                                    blend_color[2],
+                                                                                    blend_color[3])));
+      return;
+    }
+
+    output = CreateOutputTexture();
+    RunInBands(AlphaOverKernel(GetTexture((*input_params)["base_in"]),
+                               GetTexture((*input_params)["blend_in"]),
+                               output),
+               output->height());
+  } else {
+    // No kernel for this node
+    return;
+  }
+
+  output_params->Push(NodeParam::kTexture, QVariant::fromValue(output));
+}
+
+void SoftwareWorker::TextureToBuffer(const QVariant &texture, QByteArray &buffer)
+{
+  Tracer::Scope trace("readback", "TextureToBuffer");
+
+  SoftwareTexturePtr tex = texture.value<SoftwareTexturePtr>();
+
+  int count = tex->width() * tex->height() * kRGBAChannels;
+
+  switch (video_params().format()) {
+  case olive::PIX_FMT_RGBA32F:
+    memcpy(buffer.data(), tex->const_data(), static_cast<size_t>(count) * sizeof(float));
+    break;
+  case olive::PIX_FMT_RGBA16F:
+    olive::kernels::FloatToHalf(tex->const_data(), reinterpret_cast<qfloat16*>(buffer.data()), count);
+    break;
+  case olive::PIX_FMT_RGBA8:
+  case olive::PIX_FMT_RGBA16U:
+  {
+    FramePtr converted = PixelService::ConvertPixelFormat(tex->frame(), video_params().format());
+    memcpy(buffer.data(), converted->const_data(), static_cast<size_t>(converted->allocated_size()));
+    break;
+  }
+  case olive::PIX_FMT_INVALID:
+  case olive::PIX_FMT_COUNT:
+    break;
+  }
+}
+
+QVariant SoftwareWorker::CreateConstantTexture(const QVector4D &color)
+{
+  SoftwareTexturePtr output = CreateOutputTexture();
+
+  RunInBands(FillKernel(output, color), output->height());
+
+  return QVariant::fromValue(output);
+}
+
+SoftwareTexturePtr SoftwareWorker::GetTexture(const NodeValueTable &input)
+{
+  QVariant value = input.Get(NodeParam::kTexture);
+  QVector4D constant;
+
+  if (NodeValue::IsConstantTexture(value, &constant)) {
+    return CreateConstantTexture(constant).value<SoftwareTexturePtr>();
+  }
+
+  SoftwareTexturePtr texture = value.value<SoftwareTexturePtr>();
+
+  if (texture
+      && (texture->width() != video_params().effective_width() || texture->height() != video_params().effective_height())) {
+    // Sampling in the shaders stretches textures of another size over the frame
+    texture = DrawFootage(texture, QMatrix4x4());
+  }
+
+  return texture;
+}
+
+bool SoftwareWorker::GetConstantColor(const NodeValueTable &input, float *color)
+{
+  QVariant value = input.Get(NodeParam::kTexture);
+  QVector4D constant;
+
+  if (NodeValue::IsConstantTexture(value, &constant)) {
+    color[0] = constant.x();
+    color[1] = constant.y();
+    color[2] = constant.z();
+    color[3] = constant.w();
+    return true;
+  }
+
+  if (value.value<SoftwareTexturePtr>() == nullptr) {
+    // No texture is transparent
+    memset(color, 0, kRGBAChannels * sizeof(float));
+    return true;
+  }
+
+  return false;
+}
+
+SoftwareTexturePtr SoftwareWorker::DrawFootage(SoftwareTexturePtr footage, const QMatrix4x4 &matrix)
+{
+  QPoint offset;
+  bool aligned = (footage->width() == video_params().effective_width()
+                  && footage->height() == video_params().effective_height()
+                  && VideoInput::MatrixIsPixelAligned(matrix, footage->width(), footage->height(), &offset));
+
+  if (aligned && offset.isNull()) {
+    return footage;
+  }
+
+  SoftwareTexturePtr output = CreateOutputTexture();
+
+  if (aligned) {
+    RunInBands(CopyKernel(footage, output, offset), output->height());
+  } else {
+    RunInBands(SampleKernel(footage, output, matrix), output->height());
+  }
+
+  return output;
+}
+
+SoftwareTexturePtr SoftwareWorker::CreateOutputTexture()
+{
+  return std::make_shared<SoftwareTexture>(video_params().effective_width(), video_params().effective_height());
+}
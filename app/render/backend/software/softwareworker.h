@@ -0,0 +1,101 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef SOFTWAREWORKER_H
+#define SOFTWAREWORKER_H
+
+#include <QHash>
+#include <QMatrix4x4>
+
+#include "../videorenderworker.h"
+#include "render/colorprocessor.h"
+#include "softwaretexture.h"
+
+/**
+ * @brief A worker that renders on the CPU, for machines without a GPU (see OpenGLBackend::SetSoftwareRendering())
+ *
+ * Nodes are drawn with kernels equivalent to their shaders rather than by running their Code(), so only the built-in
+ * nodes with shaders are supported: VideoInput (including the matrix from TransformDistort), OpacityNode and
+ * AlphaOverBlend. Anything else passes its inputs through untouched. Constants (e.g. from SolidGenerator) stay
+ * constants through OpacityNode and AlphaOverBlend, they're only filled into a texture when something needs one.
+ *
+ * Each kernel is split into bands of rows. This worker already holds a RenderBudget CPU slot for the job, bands only
+ * go to other threads if there are CPU slots to spare, otherwise they're run in this thread one after another.
+ */
+class SoftwareWorker : public VideoRenderWorker {
+  Q_OBJECT
+public:
+  SoftwareWorker(DecoderCache* decoder_cache,
+                 VideoRenderFrameCache* frame_cache,
+                 VideoRenderFrameWriter* frame_writer,
+                 QObject* parent = nullptr);
+
+protected:
+  virtual void CloseInternal() override;
+
+  /**
+   * @brief Convert a decoded frame to float RGBA in the scene-linear reference space
+   */
+  virtual void FrameToValue(StreamPtr stream, FramePtr frame, NodeValueTable* table) override;
+
+  virtual void RunNodeAccelerated(Node *node, const NodeValueDatabase *input_params, NodeValueTable* output_params) override;
+
+  virtual void TextureToBuffer(const QVariant& texture, QByteArray& buffer) override;
+
+  virtual QVariant CreateConstantTexture(const QVector4D& color) override;
+
+private:
+  /**
+   * @brief Returns the texture in an input's values at the render's size, or nullptr if there isn't one
+   */
+  SoftwareTexturePtr GetTexture(const NodeValueTable& input);
+
+  /**
+   * @brief If an input's texture is a constant or missing (transparent), put its RGBA color in `color`
+   *
+   * @return
+   *
+   * FALSE if the input has a real texture.
+   */
+  static bool GetConstantColor(const NodeValueTable& input, float* color);
+
+  /**
+   * @brief Sample `footage` through `matrix` the same way VideoInput's shader does
+   *
+   * Returns `footage` itself if the matrix doesn't move it and it's already the render's size, and copies it if it's only
+   * moved by whole pixels (see VideoInput::MatrixIsPixelAligned()).
+   */
+  SoftwareTexturePtr DrawFootage(SoftwareTexturePtr footage, const QMatrix4x4& matrix);
+
+  /**
+   * @brief Convert footage in place from `colorspace` to the scene-linear reference space, associating its alpha
+   */
+  void ConvertToReferenceSpace(SoftwareTexturePtr footage, const QString& colorspace, bool alpha_is_associated);
+
+  SoftwareTexturePtr CreateOutputTexture();
+
+  /**
+   * @brief OCIO processors from each footage colorspace to the reference space, nullptr if one couldn't be created
+   */
+  QHash<QString, ColorProcessorPtr> color_processors_;
+
+};
+
+#endif // SOFTWAREWORKER_H
@@ -20,19 +20,30 @@
 
 #include "videorenderbackend.h"
 
-#include <OpenImageIO/imageio.h>
 #include <QApplication>
 #include <QCryptographicHash>
 #include <QDebug>
 #include <QDir>
-#include <QtMath>
 
+#include "config/config.h"
 #include "render/pixelservice.h"
+#include "render/renderbudget.h"
 #include "videorenderworker.h"
 
 VideoRenderBackend::VideoRenderBackend(QObject *parent) :
-  RenderBackend(parent)
+  RenderBackend(parent),
+  memory_hits_(0),
+  disk_hits_(0),
+  cache_misses_(0),
+  preview_quality_(0),
+  memory_compression_allowed_(false),
+  playback_speed_(0)
 {
+  // Once the edits stop, render everything that was left dirty while previewing
+  preview_timer_.setInterval(kPreviewSettleInterval);
+  preview_timer_.setSingleShot(true);
+  connect(&preview_timer_, SIGNAL(timeout()), this, SLOT(QueuedCacheNext()));
+
   // FIXME: Cache name should actually be the name of the sequence
   SetCacheName("Test");
 }
@@ -52,68 +63,221 @@ void VideoRenderBackend::InvalidateCache(const rational &start_range, const rati
            << "and"
            << end_range_adj.toDouble();
 
-  // Snap start_range to timebase
-  double start_range_dbl = start_range_adj.toDouble();
-  double start_range_numf = start_range_dbl * static_cast<double>(params_.time_base().denominator());
-  int64_t start_range_numround = qFloor(start_range_numf/static_cast<double>(params_.time_base().numerator())) * params_.time_base().numerator();
-  rational true_start_range(start_range_numround, params_.time_base().denominator());
+  if (end_range_adj >= start_range_adj) {
+    // Frames are prioritized when they're taken from the queue in TakeNextJob(), so we just need to mark them dirty
+    AddDirtyRange(TimeToFrame(start_range_adj), TimeToFrame(end_range_adj));
+  }
 
-  for (rational r=true_start_range;r<=end_range_adj;r+=params_.time_base()) {
-    // Try to order the queue from closest to the playhead to furthest
-    rational last_time = last_time_requested_;
+  // Remove frames after this time code if it's changed
+  rational length = SequenceLength();
+  int64_t first_frame_after_end = TimeToFrame(length);
 
-    rational diff = r - last_time;
+  if (FrameToTime(first_frame_after_end) < length) {
+    first_frame_after_end++;
+  }
 
-    if (diff < 0) {
-      // FIXME: Hardcoded number
-      // If the number is before the playhead, we still prioritize its closeness but not nearly as much (5:1 in this
-      // example)
-      diff = qAbs(diff) * 5;
+  frame_cache_.Truncate(first_frame_after_end);
+
+  EmitFrameStatus(first_frame_after_end, FrameStatusMap::kLastFrame, olive::kFrameEmpty);
+
+  // Queue value update
+  QueueValueUpdate(TimeRange(start_range, end_range));
+
+  // Until the edits settle, only the frame at the playhead is rendered (see TakeNextJob())
+  preview_timer_.start();
+
+  QueueCacheNext();
+}
+
+bool VideoRenderBackend::TakeNextJob(TimeRange *range)
+{
+  if (dirty_ranges_.isEmpty()) {
+    return false;
+  }
+
+  // Take the frame closest to the playhead, prioritizing frames after it since that's where playback will go. This is
+  // checked at dispatch time rather than when the frames are queued so that it follows the playhead as it moves. Since
+  // the dirty ranges are sorted, only the range around the playhead and the one after it need to be checked.
+  int64_t playhead = qMax(static_cast<int64_t>(0), TimeToFrame(last_time_requested_));
+
+  if (playback_speed_ == 0 && preview_timer_.isActive()) {
+    // The graph is still being edited (e.g. a slider is being dragged) so anything but the frame being looked at is
+    // likely to be invalidated again before it's shown. Render just that one and leave the rest until the edits
+    // settle.
+    if (!IsFrameDirty(playhead)) {
+      return false;
     }
 
-    bool added = false;
+    TakeDirtyFrame(playhead);
+
+    rational time = FrameToTime(playhead);
+    *range = TimeRange(time, time);
+
+    return true;
+  }
 
-    TimeRange new_range(r, r);
+  if (playback_speed_ != 0) {
+    // While playing, the frames the playhead is about to land on come first. At speeds other than 1x only every
+    // `playback_speed_` frames will actually be shown, so we read ahead in steps of that size.
+    int64_t best_frame = -1;
 
-    for (int i=0;i<cache_queue_.size();i++) {
-      rational compare = cache_queue_.at(i).in();
-      rational compare_diff = compare - last_time;
+    for (int i=0;i<kPlaybackReadAhead;i++) {
+      int64_t frame = playhead + playback_speed_ * i;
 
-      if (compare_diff > diff) {
-        cache_queue_.insert(i, new_range);
-        added = true;
+      if (frame < 0) {
         break;
       }
 
-      if (compare == r) {
-        added = true;
+      if (IsFrameDirty(frame)) {
+        best_frame = frame;
         break;
       }
     }
 
-    if (!added) {
-      cache_queue_.append(new_range);
+    // Otherwise keep going in the direction of playback. Anything behind the playhead won't be shown until playback
+    // stops, so it's left in the queue until then.
+    if (best_frame < 0) {
+      best_frame = NextDirtyFrame(playhead, (playback_speed_ > 0) ? 1 : -1);
     }
+
+    if (best_frame < 0) {
+      return false;
+    }
+
+    TakeDirtyFrame(best_frame);
+
+    rational time = FrameToTime(best_frame);
+    *range = TimeRange(time, time);
+
+    return true;
   }
 
-  // Remove frames after this time code if it's changed
-  frame_cache_.Truncate(SequenceLength());
+  QMap<int64_t, int64_t>::const_iterator next = dirty_ranges_.upperBound(playhead);
 
-  // Queue value update
-  QueueValueUpdate(TimeRange(start_range, end_range));
+  int64_t best_frame = -1;
+  int64_t best_diff = 0;
 
-  CacheNext();
+  if (next != dirty_ranges_.constBegin()) {
+    QMap<int64_t, int64_t>::const_iterator prev = next - 1;
+
+    if (prev.value() >= playhead) {
+      // The playhead itself is dirty
+      best_frame = playhead;
+      best_diff = 0;
+    } else {
+      // FIXME: Hardcoded number
+      // If the frame is before the playhead, we still prioritize its closeness but not nearly as much (5:1 in this
+      // example)
+      best_frame = prev.value();
+      best_diff = (playhead - prev.value()) * 5;
+    }
+  }
+
+  if (next != dirty_ranges_.constEnd()
+      && (best_frame < 0 || next.key() - playhead < best_diff)) {
+    best_frame = next.key();
+  }
+
+  TakeDirtyFrame(best_frame);
+
+  rational time = FrameToTime(best_frame);
+  *range = TimeRange(time, time);
+
+  return true;
+}
+
+bool VideoRenderBackend::TakeInteractiveJob(TimeRange *range)
+{
+  if (playback_speed_ != 0) {
+    return TakeNextJob(range);
+  }
+
+  int64_t playhead = qMax(static_cast<int64_t>(0), TimeToFrame(last_time_requested_));
+
+  if (!IsFrameDirty(playhead)) {
+    return false;
+  }
+
+  TakeDirtyFrame(playhead);
+
+  rational time = FrameToTime(playhead);
+  *range = TimeRange(time, time);
+
+  return true;
+}
+
+bool VideoRenderBackend::ReservesInteractiveWorker() const
+{
+  return true;
+}
+
+bool VideoRenderBackend::CancelsStaleJobs() const
+{
+  return true;
+}
+
+bool VideoRenderBackend::JobFollows(const TimeRange &previous, const TimeRange &next) const
+{
+  // Playing backwards, the next frame is the one before, and the decoder that rendered this frame has decoded the
+  // frames before it too
+  int step = (playback_speed_ < 0) ? -1 : 1;
+
+  return TimeToFrame(next.in()) == TimeToFrame(previous.in()) + step;
 }
 
 bool VideoRenderBackend::InitInternal()
 {
-  cache_frame_load_buffer_.resize(PixelService::GetBufferSize(params_.format(), params_.effective_width(), params_.effective_height()));
+  memory_hits_ = 0;
+  disk_hits_ = 0;
+  cache_misses_ = 0;
+
+  // Memory cache size is set in megabytes
+  frame_cache_.SetMemoryLimit(Config::Current()["MemoryCacheSize"].toLongLong() * 1024 * 1024);
+
+  ApplyCodec();
+
+  frame_cache_.SetMemoryCompression(memory_compression_allowed_ && Config::Current()["CompressedMemoryCache"].toBool());
+
+  frame_cache_.SetSharedLocation(Config::Current()["SharedCachePath"].toString());
+
+  // Encoding is done on separate threads so the render workers can get back to rendering. We only allow a couple of
+  // frames per writer to queue up so a slow disk can't make us hold an unbounded number of frames in memory.
+  int writer_count = qMax(1, RenderBudget::ThreadCount() / 2);
+  frame_writer_.Start(writer_count, writer_count * 2);
+
+  connect(&frame_writer_, SIGNAL(FrameWritten(NodeDependency, QByteArray)), this, SLOT(ThreadCompletedDownload(NodeDependency, QByteArray)));
+
+  // Cached frames are read back on their own thread so the viewer never waits on the disk
+  frame_loader_.Start();
+
+  connect(&frame_loader_, SIGNAL(FrameLoaded(const rational&, QByteArray, QByteArray)), this, SLOT(FrameLoaderFinished(const rational&, QByteArray, QByteArray)));
+
   return true;
 }
 
 void VideoRenderBackend::CloseInternal()
 {
-  cache_frame_load_buffer_.clear();
+  // Finish writing any frames that are still queued
+  frame_writer_.Stop();
+
+  // So the frames already on disk are found again next time, even if the app is closed before the cache ID changes
+  frame_cache_.SaveTimeMap();
+
+  disconnect(&frame_writer_, SIGNAL(FrameWritten(NodeDependency, QByteArray)), this, SLOT(ThreadCompletedDownload(NodeDependency, QByteArray)));
+
+  frame_loader_.Stop();
+
+  disconnect(&frame_loader_, SIGNAL(FrameLoaded(const rational&, QByteArray, QByteArray)), this, SLOT(FrameLoaderFinished(const rational&, QByteArray, QByteArray)));
+
+  // Nothing's left to cache the frames they were waiting on
+  hash_waiters_.clear();
+
+  // Nor the frames the workers were rendering, their results are dropped
+  QSet<int64_t> rendering = rendering_frames_;
+
+  foreach (const int64_t& frame, rendering) {
+    FrameDone(frame);
+  }
 }
 
 void VideoRenderBackend::ConnectViewer(ViewerOutput *node)
@@ -121,8 +285,8 @@ void VideoRenderBackend::ConnectViewer(ViewerOutput *node)
   connect(node, SIGNAL(VideoChangedBetween(const rational&, const rational&)), this, SLOT(InvalidateCache(const rational&, const rational&)));
   connect(node, SIGNAL(VideoGraphChanged()), this, SLOT(QueueRecompile()));
 
-  // FIXME: Hardcoded format, mode, and divider
-  SetParameters(VideoRenderingParams(node->video_params(), olive::PIX_FMT_RGBA16F, olive::kOffline, 2));
+  // FIXME: Hardcoded mode and divider
+  SetParameters(VideoRenderingParams(node->video_params(), CacheFormat(olive::kOffline), olive::kOffline, 2));
 }
 
 void VideoRenderBackend::DisconnectViewer(ViewerOutput *node)
@@ -138,8 +302,91 @@ const VideoRenderingParams &VideoRenderBackend::params() const
 
 void VideoRenderBackend::SetParameters(const VideoRenderingParams& params)
 {
-  // Set new parameters
-  params_ = params;
+  full_params_ = params;
+
+  ApplyParameters();
+}
+
+void VideoRenderBackend::SetPreviewQuality(int level)
+{
+  level = qBound(0, level, kPreviewQualityLevels - 1);
+
+  if (level == preview_quality_) {
+    return;
+  }
+
+  preview_quality_ = level;
+
+  // Workers can't change parameters while they're rendering, so they're stopped here and started again with the new
+  // ones by the next CacheNext()
+  Close();
+
+  // Jobs whose results were dropped while closing never gave up their reservations
+  frame_cache_.ClearReservations();
+
+  ApplyParameters();
+
+  if (!params_.is_valid()) {
+    return;
+  }
+
+  // The time map at this quality may be missing frames or have ones from before an edit. Frames that are already
+  // cached at it are found by their hash without being rendered again.
+  rational length = SequenceLength();
+
+  if (length > 0) {
+    AddDirtyRange(0, TimeToFrame(length));
+  }
+
+  QueueCacheNext();
+}
+
+int VideoRenderBackend::preview_quality() const
+{
+  return preview_quality_;
+}
+
+int VideoRenderBackend::CachedFramesAhead(const rational &time, int speed, int limit)
+{
+  if (speed == 0) {
+    return 0;
+  }
+
+  int64_t start = TimeToFrame(time);
+  int count = 0;
+
+  for (;count<limit;count++) {
+    int64_t frame = start + speed * count;
+
+    if (frame < 0 || IsFrameDirty(frame) || frame_cache_.TimeToHash(frame).isEmpty()) {
+      break;
+    }
+  }
+
+  return count;
+}
+
+void VideoRenderBackend::ApplyParameters()
+{
+  params_ = full_params_;
+
+  if (preview_quality_ > 0 && full_params_.is_valid()) {
+    // Each level halves the resolution again, the last is 8-bit too
+    olive::PixelFormat format = full_params_.format();
+
+    if (preview_quality_ == kPreviewQualityLevels - 1) {
+      format = olive::PIX_FMT_RGBA8;
+    }
+
+    params_ = VideoRenderingParams(full_params_.width(),
+                                   full_params_.height(),
+                                   full_params_.time_base(),
+                                   format,
+                                   full_params_.mode(),
+                                   full_params_.divider() << preview_quality_);
+  }
+
+  ApplyCodec();
 
   // Set params on all processors
   // FIXME: Undefined behavior if the processors are currently working, this may need to be delayed like the
@@ -152,6 +399,37 @@ void VideoRenderBackend::SetParameters(const VideoRenderingParams& params)
   RegenerateCacheID();
 }
 
+void VideoRenderBackend::SetMemoryCompression(bool e)
+{
+  memory_compression_allowed_ = e;
+}
+
+void VideoRenderBackend::ApplyCodec()
+{
+  VideoRenderFrameCache::Codec codec = static_cast<VideoRenderFrameCache::Codec>(Config::Current()["CacheCodec"].toInt());
+
+  // EXR only stores floats, integer frames would be written at a different precision than they were rendered at. Raw
+  // frames are the same size or smaller than uncompressed half-float EXRs and are read back without decoding.
+  if (params_.format() == olive::PIX_FMT_RGBA8 || params_.format() == olive::PIX_FMT_RGBA16U) {
+    codec = VideoRenderFrameCache::kCodecRaw;
+  }
+
+  frame_cache_.SetCodec(codec);
+}
+
+olive::PixelFormat VideoRenderBackend::CacheFormat(olive::RenderMode mode)
+{
+  QString key = (mode == olive::kOnline) ? QStringLiteral("OnlineCacheFormat") : QStringLiteral("OfflineCacheFormat");
+
+  int format = Config::Current()[key].toInt();
+
+  if (format <= olive::PIX_FMT_INVALID || format >= olive::PIX_FMT_COUNT) {
+    return olive::PIX_FMT_RGBA16F;
+  }
+
+  return static_cast<olive::PixelFormat>(format);
+}
+
 bool VideoRenderBackend::GenerateCacheIDInternal(QCryptographicHash& hash)
 {
   if (!params_.is_valid()) {
@@ -164,20 +442,48 @@ bool VideoRenderBackend::GenerateCacheIDInternal(QCryptographicHash& hash)
   hash.addData(QString::number(params_.format()).toUtf8());
   hash.addData(QString::number(params_.divider()).toUtf8());
 
+  // The time to hash map is stored per cache ID and is in frames of this timebase
+  hash.addData(QString::number(params_.time_base().numerator()).toUtf8());
+  hash.addData(QString::number(params_.time_base().denominator()).toUtf8());
+
   return true;
 }
 
 void VideoRenderBackend::CacheIDChangedEvent(const QString &id)
 {
-  frame_cache_.SetCacheID(id);
+  frame_cache_.SetCacheID(id, id.isEmpty() ? QString() : FrameStoreID());
+
+  // Waiting frames belong to the time map that was just swapped out
+  hash_waiters_.clear();
+
+  // Every frame may be different in the new time map
+  FrameStatusSpans spans;
+
+  FrameStatusSpan reset;
+  reset.in = 0;
+  reset.out = FrameStatusMap::kLastFrame;
+  reset.status = olive::kFrameEmpty;
+  spans.append(reset);
+
+  rational length = SequenceLength();
+
+  if (!id.isEmpty() && length > 0) {
+    spans.append(GetFrameStatus(0, TimeToFrame(length)));
+  }
+
+  emit FrameStatusChanged(spans);
 }
 
-void VideoRenderBackend::ConnectWorkerToThis(RenderWorker *processor)
+QString VideoRenderBackend::FrameStoreID() const
 {
-  connect(processor, SIGNAL(CompletedFrame(NodeDependency, QByteArray, NodeValueTable)), this, SLOT(ThreadCompletedFrame(NodeDependency, QByteArray, NodeValueTable)));
-  connect(processor, SIGNAL(HashAlreadyBeingCached()), this, SLOT(ThreadSkippedFrame()));
-  connect(processor, SIGNAL(CompletedDownload(NodeDependency, QByteArray)), this, SLOT(ThreadCompletedDownload(NodeDependency, QByteArray)));
-  connect(processor, SIGNAL(HashAlreadyExists(NodeDependency, QByteArray)), this, SLOT(ThreadHashAlreadyExists(NodeDependency, QByteArray)));
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+
+  hash.addData(QString::number(params_.width()).toUtf8());
+  hash.addData(QString::number(params_.height()).toUtf8());
+  hash.addData(QString::number(params_.format()).toUtf8());
+  hash.addData(QString::number(params_.divider()).toUtf8());
+
+  return QStringLiteral("frames-%1").arg(QString(hash.result().toHex()));
 }
 
 VideoRenderFrameCache *VideoRenderBackend::frame_cache()
@@ -185,50 +491,412 @@ VideoRenderFrameCache *VideoRenderBackend::frame_cache()
   return &frame_cache_;
 }
 
-const char *VideoRenderBackend::GetCachedFrame(const rational &time)
+VideoRenderFrameWriter *VideoRenderBackend::frame_writer()
+{
+  return &frame_writer_;
+}
+
+void VideoRenderBackend::RequestCachedFrame(const rational &time)
 {
   last_time_requested_ = time;
+  pushed_hash_.clear();
 
   if (viewer_node() == nullptr) {
     // Nothing is connected - nothing to show or render
-    return nullptr;
+    CachedFrameLoadedEvent(time, QByteArray(), false);
+    return;
   }
 
   if (cache_id().isEmpty()) {
     qWarning() << "No cache ID";
-    return nullptr;
+    CachedFrameLoadedEvent(time, QByteArray(), false);
+    return;
   }
 
   if (!params_.is_valid()) {
     qWarning() << "Invalid parameters";
-    return nullptr;
+    CachedFrameLoadedEvent(time, QByteArray(), false);
+    return;
   }
 
   // Find frame in map
-  QByteArray frame_hash = frame_cache_.TimeToHash(time);
+  QByteArray frame_hash = frame_cache_.TimeToHash(TimeToFrame(time));
+
+  if (frame_hash.isEmpty()) {
+    // A frame still waiting to be rendered will be announced with CachedTimeReady() once it has been, otherwise
+    // there's nothing here to show
+    if (TimeIsQueued(time)) {
+      cache_misses_++;
+
+      // Give the frame to the interactive worker if it's free
+      QueueCacheNext();
+    } else {
+      CachedFrameLoadedEvent(time, QByteArray(), false);
+    }
 
-  if (!frame_hash.isEmpty()) {
-    QString fn = frame_cache_.CachePathName(frame_hash);
+    return;
+  }
 
-    if (QFileInfo::exists(fn)) {
-      auto in = OIIO::ImageInput::open(fn.toStdString());
+  // Try the memory cache first, it's fast enough to not need another thread
+  bool compressed;
+  QByteArray memory_frame = frame_cache_.GetFromMemory(frame_hash, &compressed);
 
-      if (in) {
-        in->read_image(PixelService::GetPixelFormatInfo(params_.format()).oiio_desc, cache_frame_load_buffer_.data());
+  if (!memory_frame.isEmpty()) {
+    memory_hits_++;
+    CachedFrameLoadedEvent(time, memory_frame, compressed);
+    return;
+  }
 
-        in->close();
+  frame_loader_.Load(time, frame_hash, &frame_cache_, params_, frame_cache_.codec());
+}
 
-        return cache_frame_load_buffer_.constData();
-      } else {
-        qWarning() << "OIIO Error:" << OIIO::geterror().c_str();
-      }
+VideoRenderBackend::Statistics VideoRenderBackend::GetStatistics()
+{
+  Statistics stats;
+
+  stats.memory_hits = memory_hits_;
+  stats.disk_hits = disk_hits_;
+  stats.misses = cache_misses_;
+
+  stats.queued_frames = 0;
+
+  for (QMap<int64_t, int64_t>::const_iterator i=dirty_ranges_.constBegin();i!=dirty_ranges_.constEnd();i++) {
+    stats.queued_frames += i.value() - i.key() + 1;
+  }
+
+  qint64 decode_usecs = 0;
+  int decode_frames = 0;
+  stats.decode_paths = 0;
+
+  foreach (RenderWorker* worker, processors_) {
+    stats.worker_jobs.append(worker->JobsInProgress());
+
+    qint64 worker_usecs;
+    int worker_frames;
+    int worker_paths;
+    static_cast<VideoRenderWorker*>(worker)->TakeDecodeTime(&worker_usecs, &worker_frames, &worker_paths);
+
+    decode_usecs += worker_usecs;
+    decode_frames += worker_frames;
+    stats.decode_paths |= worker_paths;
+  }
+
+  stats.decode_ms = (decode_frames > 0) ? static_cast<double>(decode_usecs) / decode_frames / 1000.0 : -1;
+
+  return stats;
+}
+
+FrameStatusSpans VideoRenderBackend::GetFrameStatus(int64_t in, int64_t out)
+{
+  FrameStatusSpans spans;
+
+  for (int64_t frame=in;frame<=out;frame++) {
+    olive::FrameStatus status;
+
+    if (IsFrameDirty(frame)) {
+      status = olive::kFrameQueued;
+    } else if (rendering_frames_.contains(frame)) {
+      status = olive::kFrameRendering;
+    } else if (!frame_cache_.TimeToHash(frame).isEmpty()) {
+      status = olive::kFrameCached;
+    } else {
+      status = olive::kFrameEmpty;
+    }
+
+    if (!spans.isEmpty() && spans.last().status == status) {
+      spans.last().out = frame;
+    } else {
+      FrameStatusSpan span;
+      span.in = frame;
+      span.out = frame;
+      span.status = status;
+      spans.append(span);
+    }
+  }
+
+  return spans;
+}
+
+void VideoRenderBackend::FrameLoaderFinished(const rational &time, QByteArray hash, QByteArray frame)
+{
+  // Loaded with parameters that have changed since (the backend is restarted when they change)
+  if (!frame.isEmpty()
+      && frame.size() != PixelService::GetBufferSize(params_.format(), params_.effective_width(), params_.effective_height())) {
+    return;
+  }
+
+  if (frame.isEmpty()) {
+    cache_misses_++;
+
+    // The file has gone (e.g. evicted by DiskCacheManager), so render this frame again. The viewer hears about it
+    // through CachedTimeReady() as usual.
+    int64_t frame_index = TimeToFrame(time);
+
+    if (frame_cache_.TimeToHash(frame_index) == hash) {
+      frame_cache_.RemoveHash(frame_index, hash);
+      AddDirtyRange(frame_index, frame_index);
+      CacheNext();
+    }
+
+    return;
+  }
+
+  disk_hits_++;
+
+  frame_cache_.AddToMemory(hash, frame);
+
+  // The viewer has moved on since this was requested
+  if (time != last_time_requested_) {
+    return;
+  }
+
+  CachedFrameLoadedEvent(time, frame, false);
+}
+
+void VideoRenderBackend::SetPlaybackSpeed(const int &speed)
+{
+  if (playback_speed_ == speed) {
+    return;
+  }
+
+  playback_speed_ = speed;
+
+  // Frames that were held back during playback (or are now in a different direction) may be ready to go
+  CacheNext();
+}
+
+bool VideoRenderBackend::TimeIsQueued(const rational &time) const
+{
+  return IsFrameDirty(TimeToFrame(time));
+}
+
+void VideoRenderBackend::RequeueFrame(const rational &time)
+{
+  int64_t frame = TimeToFrame(time);
+
+  AddDirtyRange(frame, frame);
+}
+
+void VideoRenderBackend::WaitForHash(const rational &time, const QByteArray &hash)
+{
+  int64_t frame = TimeToFrame(time);
+
+  // The other frame may have been cached before this result was handled
+  if (frame_cache_.HasHash(hash)) {
+    frame_cache_.SetHash(frame, hash);
+    FrameDone(frame);
+    emit CachedTimeReady(time);
+    return;
+  }
+
+  hash_waiters_[hash].append(frame);
+}
+
+void VideoRenderBackend::HashCached(const QByteArray &hash)
+{
+  QVector<int64_t> waiters = hash_waiters_.take(hash);
+
+  foreach (const int64_t& frame, waiters) {
+    // Invalidated since and will be hashed again
+    if (IsFrameDirty(frame)) {
+      continue;
+    }
+
+    frame_cache_.SetHash(frame, hash);
+    FrameDone(frame);
+    emit CachedTimeReady(FrameToTime(frame));
+  }
+}
+
+void VideoRenderBackend::HashAbandoned(const QByteArray &hash, bool requeue)
+{
+  QVector<int64_t> waiters = hash_waiters_.take(hash);
+
+  if (waiters.isEmpty()) {
+    return;
+  }
+
+  if (!requeue) {
+    // Left empty like the frame they were waiting on
+    foreach (const int64_t& frame, waiters) {
+      FrameDone(frame);
     }
+
+    return;
   }
 
-  return nullptr;
+  foreach (const int64_t& frame, waiters) {
+    AddDirtyRange(frame, frame);
+  }
+
+  QueueCacheNext();
+}
+
+void VideoRenderBackend::FrameDone(const int64_t &frame)
+{
+  if (rendering_frames_.remove(frame)) {
+    emit FrameStatusChanged(GetFrameStatus(frame, frame));
+  }
+}
+
+void VideoRenderBackend::SetPushedFrame(const rational &time, const QByteArray &hash)
+{
+  if (time == last_time_requested_) {
+    pushed_hash_ = hash;
+  }
+}
+
+bool VideoRenderBackend::FrameIsOnScreen(const rational &time, const QByteArray &hash) const
+{
+  return time == last_time_requested_ && !pushed_hash_.isEmpty() && pushed_hash_ == hash;
+}
+
+bool VideoRenderBackend::IsFrameDirty(const int64_t &frame) const
+{
+  QMap<int64_t, int64_t>::const_iterator i = dirty_ranges_.upperBound(frame);
+
+  if (i == dirty_ranges_.constBegin()) {
+    return false;
+  }
+
+  i--;
+
+  return (i.value() >= frame);
+}
+
+int64_t VideoRenderBackend::TimeToFrame(const rational &time) const
+{
+  const rational& timebase = params_.time_base();
+
+  int64_t num = time.numerator() * timebase.denominator();
+  int64_t den = time.denominator() * timebase.numerator();
+
+  // Integer division truncates towards zero, adjust negative values so this always rounds down
+  int64_t frame = num / den;
+
+  if (num % den != 0 && (num < 0) != (den < 0)) {
+    frame--;
+  }
+
+  return frame;
+}
+
+rational VideoRenderBackend::FrameToTime(const int64_t &frame) const
+{
+  return rational(frame * params_.time_base().numerator(), params_.time_base().denominator());
+}
+
+int64_t VideoRenderBackend::NextDirtyFrame(const int64_t &playhead, const int &direction) const
+{
+  if (IsFrameDirty(playhead)) {
+    return playhead;
+  }
+
+  if (direction > 0) {
+    // The first range starting after the playhead
+    QMap<int64_t, int64_t>::const_iterator next = dirty_ranges_.upperBound(playhead);
+
+    if (next != dirty_ranges_.constEnd()) {
+      return next.key();
+    }
+  } else {
+    // The last range ending before the playhead
+    QMap<int64_t, int64_t>::const_iterator next = dirty_ranges_.lowerBound(playhead);
+
+    if (next != dirty_ranges_.constBegin()) {
+      next--;
+      return next.value();
+    }
+  }
+
+  return -1;
+}
+
+void VideoRenderBackend::AddDirtyRange(int64_t in, int64_t out)
+{
+  EmitFrameStatus(in, out, olive::kFrameQueued);
+
+  // Frames being rendered will be rendered again, whatever the worker comes back with
+  QSet<int64_t>::iterator j = rendering_frames_.begin();
+
+  while (j != rendering_frames_.end()) {
+    if (*j >= in && *j <= out) {
+      j = rendering_frames_.erase(j);
+    } else {
+      j++;
+    }
+  }
+
+  QMap<int64_t, int64_t>::iterator i = dirty_ranges_.lowerBound(in);
+
+  // Check if the range before this one overlaps or touches it
+  if (i != dirty_ranges_.begin()) {
+    QMap<int64_t, int64_t>::iterator prev = i - 1;
+
+    if (prev.value() >= in - 1) {
+      i = prev;
+    }
+  }
+
+  // Absorb all ranges that overlap or touch the new one
+  while (i != dirty_ranges_.end() && i.key() <= out + 1) {
+    in = qMin(in, i.key());
+    out = qMax(out, i.value());
+
+    i = dirty_ranges_.erase(i);
+  }
+
+  dirty_ranges_.insert(in, out);
+}
+
+void VideoRenderBackend::RemoveDirtyFrame(const int64_t &frame)
+{
+  QMap<int64_t, int64_t>::iterator i = dirty_ranges_.upperBound(frame);
+
+  if (i == dirty_ranges_.begin()) {
+    return;
+  }
+
+  i--;
+
+  int64_t in = i.key();
+  int64_t out = i.value();
+
+  if (out < frame) {
+    return;
+  }
+
+  dirty_ranges_.erase(i);
+
+  if (in < frame) {
+    dirty_ranges_.insert(in, frame - 1);
+  }
+
+  if (frame < out) {
+    dirty_ranges_.insert(frame + 1, out);
+  }
+}
+
+void VideoRenderBackend::TakeDirtyFrame(const int64_t &frame)
+{
+  RemoveDirtyFrame(frame);
+
+  rendering_frames_.insert(frame);
+
+  EmitFrameStatus(frame, frame, olive::kFrameRendering);
+}
+
+void VideoRenderBackend::EmitFrameStatus(int64_t in, int64_t out, olive::FrameStatus status)
+{
+  FrameStatusSpan span;
+  span.in = in;
+  span.out = out;
+  span.status = status;
+
+  emit FrameStatusChanged(FrameStatusSpans({span}));
 }
 
-NodeInput *VideoRenderBackend::GetDependentInput()
+NodeInput *VideoRenderBackend::GetDependentInput(ViewerOutput *viewer)
 {
-  return viewer_node()->texture_input();
+  return viewer->texture_input();
 }
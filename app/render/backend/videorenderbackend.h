@@ -21,13 +21,20 @@
 #ifndef VIDEORENDERERBACKEND_H
 #define VIDEORENDERERBACKEND_H
 
+#include <QHash>
 #include <QLinkedList>
+#include <QMap>
+#include <QSet>
+#include <QTimer>
 
 #include "node/output/viewer/viewer.h"
 #include "renderbackend.h"
+#include "render/framestatus.h"
 #include "render/pixelformat.h"
 #include "render/rendermodes.h"
 #include "videorenderframecache.h"
+#include "videorenderframeloader.h"
+#include "videorenderframewriter.h"
 
 /**
  * @brief A multithreaded OpenGL based renderer for node systems
@@ -52,6 +59,98 @@ public:
    */
   void SetParameters(const VideoRenderingParams &params);
 
+  /**
+   * @brief Set the speed the viewer is playing at (0 when paused, negative when playing backwards)
+   *
+   * While playing, frames the playhead will land on soon are rendered first and frames behind it are left until
+   * playback stops.
+   */
+  void SetPlaybackSpeed(const int& speed);
+
+  /**
+   * @brief Render at a lower quality than SetParameters() asked for, e.g. so playback can keep up
+   *
+   * Level 0 is the quality that was asked for. Each level after that halves the resolution again, and the last one
+   * also renders in 8-bit. Every quality has a cache of its own, so going back to a level picks up whatever was
+   * already rendered at it and every frame is checked against it again.
+   *
+   * The workers are restarted to pick up the new parameters, which waits for the frames they're rendering.
+   */
+  void SetPreviewQuality(int level);
+
+  int preview_quality() const;
+
+  static const int kPreviewQualityLevels = 3;
+
+  /**
+   * @brief The format frames rendered in this mode are cached in, as set in the preferences
+   *
+   * 8-bit halves the size of the cache and the bandwidth to read it back compared to half-float, at the cost of banding
+   * in gradients and shadows since frames are quantized before the display transform.
+   */
+  static olive::PixelFormat CacheFormat(olive::RenderMode mode);
+
+  /**
+   * @brief Count how many frames in a row are cached from this time on, stepping `speed` frames at a time
+   *
+   * Stops counting at `limit`. While playing, this is how far the playhead is from catching up with the cache.
+   */
+  int CachedFramesAhead(const rational& time, int speed, int limit);
+
+  /**
+   * @brief Fetch the cached frame at this time without blocking on the disk
+   *
+   * Frames in the memory cache are handed over straight away, others are read on a separate thread. Either way, the
+   * frame arrives through CachedFrameLoadedEvent() (and from there CachedFrameReady()). A request made before the
+   * previous one has arrived supersedes it.
+   *
+   * If the frame hasn't been rendered yet, nothing arrives until it has (see CachedTimeReady()), so the last frame
+   * can keep being shown in the meantime.
+   */
+  void RequestCachedFrame(const rational& time);
+
+  struct Statistics {
+    /// Requested frames that came from the memory cache, the disk cache or had to be rendered first
+    int memory_hits;
+    int disk_hits;
+    int misses;
+
+    /// Jobs each worker is in the middle of
+    QVector<int> worker_jobs;
+
+    /// Frames waiting to be rendered
+    int64_t queued_frames;
+
+    /// Average time to decode a frame since GetStatistics() was last called, or -1 if nothing was decoded
+    double decode_ms;
+
+    /// Decoder::DecodePath flags of the frames decoded since GetStatistics() was last called
+    int decode_paths;
+  };
+
+  /**
+   * @brief Allow frames in the memory cache to be kept block-compressed, if the preferences ask for it
+   *
+   * Only for backends whose frames are only shown in a viewer, since anything else reading the memory cache would need
+   * them uncompressed. Takes effect the next time the backend starts. Off by default.
+   */
+  void SetMemoryCompression(bool e);
+
+  /**
+   * @brief Get a snapshot of how the cache and workers are doing (e.g. for the viewer's statistics overlay)
+   *
+   * Cache counts are since the backend was started.
+   */
+  Statistics GetStatistics();
+
+  /**
+   * @brief Get the status of every frame from `in` to `out` (inclusive)
+   *
+   * Looks up every frame, so this is for ranges that have just changed. FrameStatusChanged() keeps a FrameStatusMap
+   * up to date without it.
+   */
+  FrameStatusSpans GetFrameStatus(int64_t in, int64_t out);
+
 public slots:
   virtual void InvalidateCache(const rational &start_range, const rational &end_range) override;
 
@@ -71,16 +170,118 @@ protected:
     QByteArray hash;
   };
 
+  virtual bool TakeNextJob(TimeRange* range) override;
+
+  /**
+   * @brief While paused, the frame under the playhead goes to the reserved worker so an edit shows up straight away
+   *
+   * The frame is pushed to the viewer with CachedFrameReady() as soon as it's rendered, before it's been downloaded
+   * and written to the disk cache. While playing, the reserved worker helps with the read-ahead instead.
+   */
+  virtual bool TakeInteractiveJob(TimeRange* range) override;
+
+  virtual bool ReservesInteractiveWorker() const override;
+
+  /**
+   * @brief Frames rendered for the viewer are abandoned as soon as an edit makes them out of date
+   *
+   * Derivatives should put cancelled frames back with RequeueFrame().
+   */
+  virtual bool CancelsStaleJobs() const override;
+
+  /**
+   * @brief Jobs are single frames, so a job follows another if it's the next frame in the direction of playback
+   */
+  virtual bool JobFollows(const TimeRange& previous, const TimeRange& next) const override;
+
   virtual void ConnectViewer(ViewerOutput* node) override;
 
   virtual void DisconnectViewer(ViewerOutput* node) override;
 
-  const char *GetCachedFrame(const rational& time);
+  /**
+   * @brief Called in the main thread when a frame requested with RequestCachedFrame() arrives
+   *
+   * @param frame
+   *
+   * The frame's pixel data in params() format and size, or empty if there's no frame at this time (e.g. it's past the
+   * end of the sequence).
+   *
+   * @param compressed
+   *
+   * TRUE if the frame came from the memory cache block-compressed (see SetMemoryCompression()).
+   */
+  virtual void CachedFrameLoadedEvent(const rational& time, const QByteArray& frame, bool compressed) = 0;
+
+  /**
+   * @brief Returns whether a frame at this time is still waiting to be rendered
+   */
+  bool TimeIsQueued(const rational& time) const;
+
+  /**
+   * @brief Queue the frame at this time to be rendered again (e.g. because its job was cancelled)
+   */
+  void RequeueFrame(const rational& time);
+
+  /**
+   * @brief Give the frame at this time the hash of a frame another worker is already rendering, once it's cached
+   *
+   * Frames that come out the same (e.g. duplicated or slowed down footage) are only rendered once, and every other
+   * frame with that hash is filled in when it's cached. If it already has been, this frame gets it straight away.
+   */
+  void WaitForHash(const rational& time, const QByteArray& hash);
+
+  /**
+   * @brief Call when the frame with this hash has been cached, so the frames waiting on it get it too
+   */
+  void HashCached(const QByteArray& hash);
+
+  /**
+   * @brief Call when the reservation on this hash was given up without caching anything
+   *
+   * Frames waiting on it are queued to be rendered again if `requeue` is TRUE (e.g. because the frame was
+   * cancelled), otherwise they're left empty like the frame itself.
+   */
+  void HashAbandoned(const QByteArray& hash, bool requeue);
+
+  /**
+   * @brief Call when a frame taken from the queue has been cached or turned out to be blank
+   *
+   * It no longer shows as rendering in FrameStatusChanged().
+   */
+  void FrameDone(const int64_t& frame);
+
+  /**
+   * @brief Call when a freshly rendered frame was sent straight to the viewer with CachedFrameReady()
+   *
+   * If the viewer asked for this time, it's now showing the GPU texture the frame was rendered into, so there's no
+   * need to read it back from the cache once it's been written (see FrameIsOnScreen()).
+   */
+  void SetPushedFrame(const rational& time, const QByteArray& hash);
 
-  virtual NodeInput* GetDependentInput() override;
+  /**
+   * @brief Returns whether the viewer is still showing the pushed frame with this hash at this time
+   */
+  bool FrameIsOnScreen(const rational& time, const QByteArray& hash) const;
+
+  /**
+   * @brief Convert a time to a frame index in the current timebase (rounded down)
+   *
+   * Frame indices are what the backend works in internally, so stepping and comparing them are single integer
+   * operations. Times are only converted at the edges (requests in, signals out).
+   */
+  int64_t TimeToFrame(const rational& time) const;
+
+  /**
+   * @brief Convert a frame index in the current timebase back to a time
+   */
+  rational FrameToTime(const int64_t& frame) const;
+
+  virtual NodeInput* GetDependentInput(ViewerOutput* viewer) override;
 
   VideoRenderFrameCache* frame_cache();
 
+  VideoRenderFrameWriter* frame_writer();
+
   const VideoRenderingParams& params() const;
 
   /**
@@ -90,23 +291,140 @@ protected:
 
   virtual void CacheIDChangedEvent(const QString& id) override;
 
-  virtual void ConnectWorkerToThis(RenderWorker* processor) override;
+  /**
+   * @brief ID of the frame store for the current parameters (see VideoRenderFrameCache::SetCacheID())
+   *
+   * Unlike the cache ID, this doesn't depend on the cache name or the timebase, only on what changes a frame's pixels
+   * without changing its hash.
+   */
+  QString FrameStoreID() const;
 
 signals:
   void CachedFrameReady(const rational& time, QVariant value);
   void CachedTimeReady(const rational& time);
 
+  /**
+   * @brief Emitted whenever frames are queued, taken by a worker, cached or dropped, in frames of params() timebase
+   *
+   * Applying every emitted span to a FrameStatusMap in order keeps it matching GetFrameStatus(). Switching to another
+   * cache ID (e.g. another viewer, or parameters) sets every frame again.
+   */
+  void FrameStatusChanged(const FrameStatusSpans& spans);
+
 private:
+  /**
+   * @brief Set params_ from full_params_ at the current preview quality and pass them on to the workers
+   */
+  void ApplyParameters();
+
+  /**
+   * @brief Set the frame cache's codec from the preferences, or raw if params_ aren't a format EXR can store
+   */
+  void ApplyCodec();
+
+  /**
+   * @brief Parameters as set with SetParameters(), params_ are these at preview_quality_
+   */
+  VideoRenderingParams full_params_;
+
   VideoRenderingParams params_;
 
-  QByteArray cache_frame_load_buffer_;
+  int preview_quality_;
+
+  bool memory_compression_allowed_;
 
   VideoRenderFrameCache frame_cache_;
 
+  VideoRenderFrameLoader frame_loader_;
+
+  VideoRenderFrameWriter frame_writer_;
+
   rational last_time_requested_;
 
-private slots:
+  /**
+   * @brief Hash of the frame set with SetPushedFrame(), cleared whenever another frame is requested
+   */
+  QByteArray pushed_hash_;
+
+  int memory_hits_;
+
+  int disk_hits_;
+
+  int cache_misses_;
+
+  /**
+   * @brief Returns whether the frame at this index is in dirty_ranges_
+   */
+  bool IsFrameDirty(const int64_t& frame) const;
+
+  /**
+   * @brief Find the next dirty frame from `playhead` in the direction of `direction` (1 or -1)
+   *
+   * @return The frame index or -1 if there are no dirty frames in that direction.
+   */
+  int64_t NextDirtyFrame(const int64_t& playhead, const int& direction) const;
+
+  /**
+   * @brief Mark the frames from `in` to `out` (inclusive) as needing to be rendered
+   */
+  void AddDirtyRange(int64_t in, int64_t out);
+
+  /**
+   * @brief Remove a single frame from the dirty ranges, splitting the range it belongs to if necessary
+   */
+  void RemoveDirtyFrame(const int64_t& frame);
+
+  /**
+   * @brief Remove a frame from the dirty ranges to give it to a worker, it shows as rendering until FrameDone()
+   */
+  void TakeDirtyFrame(const int64_t& frame);
+
+  /**
+   * @brief Emit FrameStatusChanged() for a single span
+   */
+  void EmitFrameStatus(int64_t in, int64_t out, olive::FrameStatus status);
+
+  /**
+   * @brief Frames taken from the dirty ranges that haven't been cached yet (see TakeDirtyFrame())
+   */
+  QSet<int64_t> rendering_frames_;
 
+  /**
+   * @brief Frames waiting to be rendered
+   *
+   * Stored as non-overlapping, non-adjacent ranges of frame indices mapping the first frame to the last (inclusive).
+   * Invalidating a range is a merge into this map rather than queueing every frame individually, so even invalidating
+   * the whole sequence is cheap.
+   */
+  QMap<int64_t, int64_t> dirty_ranges_;
+
+  /**
+   * @brief Frames waiting on the frame with each hash to be cached (see WaitForHash())
+   */
+  QHash<QByteArray, QVector<int64_t> > hash_waiters_;
+
+  /**
+   * @brief Number of upcoming displayed frames to prioritize ahead of the playhead during playback
+   */
+  static const int kPlaybackReadAhead = 48;
+
+  int playback_speed_;
+
+  /**
+   * @brief Milliseconds after the last invalidation before every dirty frame is rendered again
+   */
+  static const int kPreviewSettleInterval = 250;
+
+  /**
+   * @brief Runs while the cache keeps being invalidated, only the playhead frame is rendered in the meantime
+   */
+  QTimer preview_timer_;
+
+private slots:
+  /**
+   * @brief Receives frames read by frame_loader_
+   */
+  void FrameLoaderFinished(const rational& time, QByteArray hash, QByteArray frame);
 
 };
 
@@ -1,98 +1,579 @@
 #include "videorenderframecache.h"
 
+#include <QDataStream>
+#include <QDebug>
 #include <QDir>
 #include <QFileInfo>
+#include <QSaveFile>
+#include <QVector>
 
 #include "common/filefunctions.h"
+#include "common/metrics.h"
 
-VideoRenderFrameCache::VideoRenderFrameCache()
+VideoRenderFrameCache::VideoRenderFrameCache() :
+  codec_(kCodecDWAA),
+  memory_usage_(0),
+  memory_limit_(0),
+  memory_compression_(false)
 {
+  MemoryBudget::AddReclaimer(MemoryBudget::kFrameCache, this);
+}
+
+VideoRenderFrameCache::~VideoRenderFrameCache()
+{
+  MemoryBudget::RemoveReclaimer(this);
 
+  ClearMemory();
 }
 
 bool VideoRenderFrameCache::HasHash(const QByteArray &hash)
 {
-  return QFileInfo::exists(CachePathName(hash)) && !IsCaching(hash);
+  if (IsCaching(hash)) {
+    return false;
+  }
+
+  FrameSegmentStorePtr s = store();
+
+  if (s == nullptr) {
+    return false;
+  }
+
+  if (s->Contains(FrameKey(hash))) {
+    Metrics::Increment(Metrics::kFrameCacheDiskHits);
+    return true;
+  }
+
+  if (FetchFromShared(hash, s)) {
+    Metrics::Increment(Metrics::kFrameCacheSharedHits);
+    return true;
+  }
+
+  Metrics::Increment(Metrics::kFrameCacheMisses);
+
+  return false;
 }
 
 bool VideoRenderFrameCache::IsCaching(const QByteArray &hash)
 {
-  currently_caching_lock_.lock();
+  CachingShard& shard = currently_caching_[ShardOf(hash)];
+
+  shard.lock.lock();
 
-  bool is_caching = currently_caching_list_.contains(hash);
+  bool is_caching = shard.hashes.contains(hash);
 
-  currently_caching_lock_.unlock();
+  shard.lock.unlock();
 
   return is_caching;
 }
 
 bool VideoRenderFrameCache::TryCache(const QByteArray &hash)
 {
-  currently_caching_lock_.lock();
+  CachingShard& shard = currently_caching_[ShardOf(hash)];
 
-  bool is_caching = currently_caching_list_.contains(hash);
+  shard.lock.lock();
+
+  bool is_caching = shard.hashes.contains(hash);
 
   if (!is_caching) {
-    currently_caching_list_.append(hash);
+    shard.hashes.insert(hash);
   }
 
-  currently_caching_lock_.unlock();
+  shard.lock.unlock();
 
   return !is_caching;
 }
 
-void VideoRenderFrameCache::SetCacheID(const QString &id)
+void VideoRenderFrameCache::SetCacheID(const QString &id, const QString &store_id)
+{
+  if (id != cache_id_) {
+    if (!cache_id_.isEmpty()) {
+      SaveTimeMap();
+    }
+
+    cache_id_ = id;
+
+    LoadTimeMap();
+  }
+
+  if (store_id != store_id_) {
+    store_id_ = store_id;
+
+    UpdateCacheDirs();
+
+    // Frames in memory were rendered with the old parameters
+    ClearMemory();
+  }
+}
+
+const VideoRenderFrameCache::Codec &VideoRenderFrameCache::codec() const
 {
-  cache_id_ = id;
+  return codec_;
 }
 
-QByteArray VideoRenderFrameCache::TimeToHash(const rational &time)
+void VideoRenderFrameCache::SetCodec(const VideoRenderFrameCache::Codec &codec)
 {
-  return time_hash_map_.value(time);
+  codec_ = codec;
 }
 
-void VideoRenderFrameCache::SetHash(const rational &time, const QByteArray &hash)
+QByteArray VideoRenderFrameCache::TimeToHash(const int64_t &frame)
+{
+  TimeHashShard& shard = time_hash_map_[ShardOf(frame)];
+
+  shard.lock.lock();
+
+  QByteArray hash = shard.map.value(frame);
+
+  shard.lock.unlock();
+
+  return hash;
+}
+
+void VideoRenderFrameCache::SetHash(const int64_t &frame, const QByteArray &hash)
 {
   // No longer currently caching this frame
   RemoveHashFromCurrentlyCaching(hash);
 
   // Insert frame into map
-  time_hash_map_.insert(time, hash);
+  TimeHashShard& shard = time_hash_map_[ShardOf(frame)];
+
+  shard.lock.lock();
+  shard.map.insert(frame, hash);
+  shard.lock.unlock();
 }
 
-void VideoRenderFrameCache::RemoveHash(const rational &time, const QByteArray &hash)
+void VideoRenderFrameCache::RemoveHash(const int64_t &frame, const QByteArray &hash)
 {
   RemoveHashFromCurrentlyCaching(hash);
 
-  time_hash_map_.remove(time);
+  TimeHashShard& shard = time_hash_map_[ShardOf(frame)];
+
+  shard.lock.lock();
+  shard.map.remove(frame);
+  shard.lock.unlock();
+}
+
+void VideoRenderFrameCache::Truncate(const int64_t &frame)
+{
+  for (int i=0;i<kShardCount;i++) {
+    TimeHashShard& shard = time_hash_map_[i];
+
+    shard.lock.lock();
+
+    QHash<int64_t, QByteArray>::iterator j = shard.map.begin();
+
+    while (j != shard.map.end()) {
+      if (j.key() >= frame) {
+        j = shard.map.erase(j);
+      } else {
+        j++;
+      }
+    }
+
+    shard.lock.unlock();
+  }
+}
+
+QByteArray VideoRenderFrameCache::GetFromMemory(const QByteArray &hash, bool *compressed)
+{
+  memory_lock_.lock();
+
+  QByteArray frame;
+
+  bool is_compressed = false;
+
+  QHash<QByteArray, MemoryFrame>::iterator entry = memory_cache_.find(hash);
+
+  if (entry != memory_cache_.end()) {
+    is_compressed = entry->compressed;
+
+    if (!is_compressed || compressed != nullptr) {
+      frame = entry->data;
+
+      // Move to the front of the LRU list
+      memory_lru_.erase(entry->lru);
+      entry->lru = memory_lru_.insert(memory_lru_.begin(), hash);
+    }
+  }
+
+  if (compressed != nullptr) {
+    *compressed = is_compressed;
+  }
+
+  memory_lock_.unlock();
+
+  Metrics::Increment(frame.isEmpty() ? Metrics::kFrameCacheMemoryMisses : Metrics::kFrameCacheMemoryHits);
+
+  return frame;
+}
+
+void VideoRenderFrameCache::AddToMemory(const QByteArray &hash, const QByteArray &frame, bool compressed)
+{
+  memory_lock_.lock();
+
+  if (frame.size() <= memory_limit_ && !memory_cache_.contains(hash)) {
+    MemoryFrame entry;
+    entry.data = frame;
+    entry.compressed = compressed;
+    entry.lru = memory_lru_.insert(memory_lru_.begin(), hash);
+
+    memory_cache_.insert(hash, entry);
+    memory_usage_ += frame.size();
+    MemoryBudget::Add(MemoryBudget::kFrameCache, frame.size());
+
+    EvictFromMemory();
+  }
+
+  memory_lock_.unlock();
+}
+
+void VideoRenderFrameCache::SetMemoryLimit(const qint64 &bytes)
+{
+  memory_lock_.lock();
+
+  memory_limit_ = bytes;
+
+  EvictFromMemory();
+
+  memory_lock_.unlock();
+}
+
+void VideoRenderFrameCache::ClearMemory()
+{
+  memory_lock_.lock();
+
+  memory_cache_.clear();
+  memory_lru_.clear();
+  MemoryBudget::Add(MemoryBudget::kFrameCache, -memory_usage_);
+  memory_usage_ = 0;
+
+  memory_lock_.unlock();
+}
+
+void VideoRenderFrameCache::EvictFromMemory()
+{
+  EvictMemoryTo(memory_limit_);
+}
+
+qint64 VideoRenderFrameCache::EvictMemoryTo(qint64 usage)
+{
+  qint64 usage_before = memory_usage_;
+
+  while (memory_usage_ > usage && !memory_lru_.isEmpty()) {
+    QByteArray evicted = memory_lru_.takeLast();
+
+    memory_usage_ -= memory_cache_.take(evicted).data.size();
+  }
+
+  qint64 evicted_bytes = usage_before - memory_usage_;
+
+  MemoryBudget::Add(MemoryBudget::kFrameCache, -evicted_bytes);
+
+  return evicted_bytes;
+}
+
+qint64 VideoRenderFrameCache::Reclaim(qint64 bytes)
+{
+  memory_lock_.lock();
+
+  qint64 evicted_bytes = EvictMemoryTo(qMax(Q_INT64_C(0), memory_usage_ - bytes));
+
+  memory_lock_.unlock();
+
+  return evicted_bytes;
+}
+
+void VideoRenderFrameCache::SetMemoryCompression(bool e)
+{
+  memory_compression_ = e;
+}
+
+bool VideoRenderFrameCache::memory_compression() const
+{
+  return memory_compression_;
+}
+
+int VideoRenderFrameCache::ShardOf(const QByteArray &hash)
+{
+  // Frame hashes are already well distributed so we can just use their first byte
+  if (hash.isEmpty()) {
+    return 0;
+  }
+
+  return static_cast<uchar>(hash.at(0)) % kShardCount;
+}
+
+int VideoRenderFrameCache::ShardOf(const int64_t &frame)
+{
+  // Consecutive frames land in consecutive shards
+  int shard = static_cast<int>(frame % kShardCount);
+
+  return (shard < 0) ? shard + kShardCount : shard;
 }
 
-void VideoRenderFrameCache::Truncate(const rational &time)
+void VideoRenderFrameCache::SaveTimeMap()
 {
-  QMap<rational, QByteArray>::iterator i = time_hash_map_.begin();
+  if (cache_id_.isEmpty()) {
+    return;
+  }
+
+  // Every hash is the same size, so it's only stored once and each entry is just the frame and the hash's bytes
+  QVector<QPair<int64_t, QByteArray> > entries;
+  int hash_size = 0;
+
+  for (int i=0;i<kShardCount;i++) {
+    TimeHashShard& shard = time_hash_map_[i];
+
+    shard.lock.lock();
+
+    for (QHash<int64_t, QByteArray>::const_iterator j=shard.map.constBegin();j!=shard.map.constEnd();j++) {
+      if (hash_size == 0) {
+        hash_size = j.value().size();
+      }
 
-  while (i != time_hash_map_.end()) {
-    if (i.key() >= time) {
-      i = time_hash_map_.erase(i);
-    } else {
-      i++;
+      if (j.value().size() == hash_size) {
+        entries.append(qMakePair(j.key(), j.value()));
+      }
     }
+
+    shard.lock.unlock();
+  }
+
+  QString filename = TimeMapFilename();
+
+  if (entries.isEmpty()) {
+    QFile::remove(filename);
+    return;
+  }
+
+  QDir().mkpath(QFileInfo(filename).path());
+
+  QSaveFile file(filename);
+
+  if (!file.open(QFile::WriteOnly)) {
+    qWarning() << "Failed to save frame cache map to" << filename;
+    return;
+  }
+
+  QDataStream ds(&file);
+
+  ds << kTimeMapMagic << kTimeMapVersion << static_cast<quint32>(hash_size) << static_cast<quint32>(entries.size());
+
+  for (int i=0;i<entries.size();i++) {
+    ds << static_cast<qint64>(entries.at(i).first);
+    ds.writeRawData(entries.at(i).second.constData(), hash_size);
+  }
+
+  if (ds.status() != QDataStream::Ok || !file.commit()) {
+    qWarning() << "Failed to save frame cache map to" << filename;
   }
 }
 
+void VideoRenderFrameCache::LoadTimeMap()
+{
+  for (int i=0;i<kShardCount;i++) {
+    time_hash_map_[i].lock.lock();
+    time_hash_map_[i].map.clear();
+    time_hash_map_[i].lock.unlock();
+  }
+
+  if (cache_id_.isEmpty()) {
+    return;
+  }
+
+  QFile file(TimeMapFilename());
+
+  if (!file.open(QFile::ReadOnly)) {
+    // Nothing has been saved for this ID yet
+    return;
+  }
+
+  QDataStream ds(&file);
+
+  quint32 magic, version, hash_size, count;
+  ds >> magic >> version >> hash_size >> count;
+
+  if (ds.status() != QDataStream::Ok
+      || magic != kTimeMapMagic
+      || version != kTimeMapVersion
+      || hash_size == 0
+      || static_cast<qint64>(count) * (sizeof(qint64) + hash_size) > file.size()) {
+    qWarning() << "Ignoring unreadable frame cache map" << file.fileName();
+    return;
+  }
+
+  QByteArray hash(static_cast<int>(hash_size), Qt::Uninitialized);
+
+  for (quint32 i=0;i<count;i++) {
+    qint64 frame;
+    ds >> frame;
+
+    if (ds.readRawData(hash.data(), hash.size()) != hash.size()) {
+      break;
+    }
+
+    TimeHashShard& shard = time_hash_map_[ShardOf(frame)];
+
+    // Copy so each entry gets its own hash rather than sharing the buffer we read into
+    shard.lock.lock();
+    shard.map.insert(frame, QByteArray(hash.constData(), hash.size()));
+    shard.lock.unlock();
+  }
+}
+
+QString VideoRenderFrameCache::TimeMapFilename() const
+{
+  // Kept apart from the frames, since every sequence rendering at the same parameters shares those
+  return QDir(GetMediaCacheLocation()).filePath(QStringLiteral("maps/%1").arg(cache_id_));
+}
+
 void VideoRenderFrameCache::RemoveHashFromCurrentlyCaching(const QByteArray &hash)
 {
-  currently_caching_lock_.lock();
-  currently_caching_list_.removeOne(hash);
-  currently_caching_lock_.unlock();
+  CachingShard& shard = currently_caching_[ShardOf(hash)];
+
+  shard.lock.lock();
+  shard.hashes.remove(hash);
+  shard.lock.unlock();
+}
+
+void VideoRenderFrameCache::ClearReservations()
+{
+  for (int i=0;i<kShardCount;i++) {
+    currently_caching_[i].lock.lock();
+    currently_caching_[i].hashes.clear();
+    currently_caching_[i].lock.unlock();
+  }
+}
+
+QByteArray VideoRenderFrameCache::ReadFrame(const QByteArray &hash)
+{
+  FrameSegmentStorePtr s = store();
+
+  if (s == nullptr) {
+    return QByteArray();
+  }
+
+  return s->Read(FrameKey(hash));
+}
+
+QString VideoRenderFrameCache::LocalFilename(const QByteArray &hash)
+{
+  FrameSegmentStorePtr s = store();
+
+  if (s == nullptr) {
+    return QString();
+  }
+
+  return s->SegmentFilenameOf(FrameKey(hash));
+}
+
+VideoRenderFrameCache::Destination VideoRenderFrameCache::DestinationOf(const QByteArray &hash)
+{
+  Destination destination;
+
+  destination.store = store();
+  destination.key = FrameKey(hash);
+  destination.shared_filename = SharedPathName(hash);
+
+  return destination;
+}
+
+QString VideoRenderFrameCache::SharedPathName(const QByteArray &hash)
+{
+  if (shared_dir_.isEmpty()) {
+    return QString();
+  }
+
+  return GetShardedFilename(shared_dir_, FrameFilename(hash));
 }
 
-QString VideoRenderFrameCache::CachePathName(const QByteArray &hash)
+void VideoRenderFrameCache::SetSharedLocation(const QString &path)
 {
-  QDir this_cache_dir = QDir(GetMediaCacheLocation()).filePath(cache_id_);
-  this_cache_dir.mkpath(".");
+  shared_location_ = path;
+
+  UpdateCacheDirs();
+}
+
+bool VideoRenderFrameCache::ShareFrame(const QByteArray &hash)
+{
+  QString shared_filename = SharedPathName(hash);
+
+  if (shared_filename.isEmpty()) {
+    return true;
+  }
+
+  if (QFileInfo::exists(shared_filename)) {
+    return true;
+  }
 
-  QString filename = QStringLiteral("%1.exr").arg(QString(hash.toHex()));
+  QByteArray data = ReadFrame(hash);
 
-  return this_cache_dir.filePath(filename);
+  return !data.isEmpty() && WriteFileAtomically(shared_filename, data);
+}
+
+QString VideoRenderFrameCache::FrameFilename(const QByteArray &hash) const
+{
+  // Raw frames use a different extension so they're never mistaken for EXRs if the codec changes
+  return QStringLiteral("%1.%2").arg(QString(hash.toHex()),
+                                     (codec_ == kCodecRaw) ? QStringLiteral("raw") : QStringLiteral("exr"));
+}
+
+QByteArray VideoRenderFrameCache::FrameKey(const QByteArray &hash) const
+{
+  // Tagged the same way FrameFilename() uses extensions
+  return hash + ((codec_ == kCodecRaw) ? 'r' : 'e');
+}
+
+FrameSegmentStorePtr VideoRenderFrameCache::store()
+{
+  store_lock_.lock();
+  FrameSegmentStorePtr s = store_;
+  store_lock_.unlock();
+
+  return s;
+}
+
+bool VideoRenderFrameCache::FetchFromShared(const QByteArray &hash, const FrameSegmentStorePtr &store)
+{
+  QString shared_filename = SharedPathName(hash);
+
+  if (shared_filename.isEmpty()) {
+    return false;
+  }
+
+  QFile file(shared_filename);
+
+  if (!file.open(QFile::ReadOnly)) {
+    return false;
+  }
+
+  QByteArray data = file.readAll();
+
+  file.close();
+
+  if (data.isEmpty() || !store->Append(FrameKey(hash), data)) {
+    qWarning() << "Failed to copy" << shared_filename << "from the shared cache";
+    return false;
+  }
+
+  return true;
+}
+
+void VideoRenderFrameCache::UpdateCacheDirs()
+{
+  // Worked out once here rather than on every lookup, since the viewer looks up frames from the main thread
+  FrameSegmentStorePtr s;
+
+  if (!store_id_.isEmpty()) {
+    s = FrameSegmentStore::Open(QDir(GetMediaCacheLocation()).filePath(store_id_));
+  }
+
+  store_lock_.lock();
+  store_ = s;
+  store_lock_.unlock();
+
+  if (shared_location_.isEmpty() || store_id_.isEmpty()) {
+    shared_dir_.clear();
+  } else {
+    shared_dir_ = QDir(shared_location_).filePath(store_id_);
+  }
 }
@@ -1,17 +1,47 @@
 #ifndef VIDEORENDERFRAMECACHE_H
 #define VIDEORENDERFRAMECACHE_H
 
+#include <QHash>
+#include <QLinkedList>
 #include <QMutex>
+#include <QSet>
 
+#include "common/memorybudget.h"
 #include "common/rational.h"
+#include "framesegmentstore.h"
 
-class VideoRenderFrameCache
+class VideoRenderFrameCache : public MemoryBudget::Reclaimer
 {
 public:
+  /**
+   * @brief Format used to store cached frames on disk
+   */
+  enum Codec {
+    /// EXR with lossy DWAA compression (smallest, slowest to encode)
+    kCodecDWAA,
+
+    /// EXR with lossless PIZ compression
+    kCodecPIZ,
+
+    /// Uncompressed EXR
+    kCodecUncompressed,
+
+    /// Raw pixel data that can be memory-mapped straight into a frame buffer (largest, fastest)
+    kCodecRaw
+  };
+
   VideoRenderFrameCache();
 
+  virtual ~VideoRenderFrameCache() override;
+
   /**
    * @brief Return whether a frame with this hash already exists
+   *
+   * If it's not on the local disk but it's in the shared cache (see SetSharedLocation()), it's copied to the local disk
+   * first. This and all other functions that deal with hashes are thread-safe.
+   *
+   * Frames on the local disk are packed into the segments of a FrameSegmentStore rather than having a file each, so
+   * looking one up doesn't touch the filesystem and reading one back is a copy out of a mapped segment.
    */
   bool HasHash(const QByteArray& hash);
 
@@ -26,28 +56,284 @@ public:
   bool TryCache(const QByteArray& hash);
 
   /**
-   * @brief Return the path of the cached image at this time
+   * @brief Give up a reservation made with TryCache() without caching anything
+   */
+  void RemoveHashFromCurrentlyCaching(const QByteArray& hash);
+
+  /**
+   * @brief Give up every reservation made with TryCache()
+   *
+   * Only safe once nothing is rendering or writing frames anymore, e.g. after the backend has closed and its results
+   * were dropped before they could be handled.
+   */
+  void ClearReservations();
+
+  /**
+   * @brief Read a frame's encoded data (i.e. in codec() format) from the local disk cache
+   *
+   * @return
+   *
+   * The data, or an empty QByteArray if the frame isn't there (e.g. it's been evicted).
+   */
+  QByteArray ReadFrame(const QByteArray& hash);
+
+  /**
+   * @brief The file on the local disk a frame is in (e.g. to pin it in DiskCacheManager), or an empty string if it
+   * isn't there
+   */
+  QString LocalFilename(const QByteArray& hash);
+
+  /**
+   * @brief Where a frame goes once it's been encoded
+   */
+  struct Destination {
+    /// The store the frame's written to, nullptr if there's no cache ID yet
+    FrameSegmentStorePtr store;
+
+    /// Key of the frame in `store`
+    QByteArray key;
+
+    /// Where to copy the frame in the shared cache once it's been written, or empty to not share it
+    QString shared_filename;
+  };
+
+  /**
+   * @brief Get where a frame with this hash should be written in the current store
+   */
+  Destination DestinationOf(const QByteArray& hash);
+
+  /**
+   * @brief Return the path of this frame in the shared cache, or an empty string if there's no shared cache
    */
-  QString CachePathName(const QByteArray &hash);
+  QString SharedPathName(const QByteArray &hash);
 
-  void SetCacheID(const QString& id);
+  /**
+   * @brief Set a folder (e.g. on a NAS) that frames are shared through as a second tier after the local disk
+   *
+   * Unlike the local cache, every frame has a file of its own (sharded by hash) that only ever appears complete, so any
+   * number of workstations and render nodes can point at the same folder. Frames missing locally are looked for there by HasHash(), and frames rendered here are copied
+   * there by VideoRenderFrameWriter. An empty path (the default) disables the shared cache.
+   */
+  void SetSharedLocation(const QString& path);
+
+  /**
+   * @brief Copy a frame from the local cache to the shared cache straight away, unless it's already there
+   *
+   * For when the frame has to be in the shared cache before carrying on, rather than whenever VideoRenderFrameWriter
+   * gets to it.
+   *
+   * @return
+   *
+   * FALSE if there's a shared cache and the frame isn't in it.
+   */
+  bool ShareFrame(const QByteArray& hash);
+
+  /**
+   * @brief Switch to another cache ID
+   *
+   * The time to hash map of the current ID is saved with SaveTimeMap() and the map last saved for the new ID is loaded
+   * in its place, so frames rendered in a previous session are found again straight away. Entries aren't checked
+   * when they're loaded. A frame whose file has gone is rendered again when the viewer fails to load it, and
+   * invalidated frames are re-hashed as usual, replacing any entry that no longer matches.
+   *
+   * @param store_id
+   *
+   * Names the folder frames are stored in. Frames are named by their hash, so a store is shared by every sequence and
+   * viewer rendering at the same parameters and any frame that's identical between them is only rendered once.
+   */
+  void SetCacheID(const QString& id, const QString& store_id);
+
+  /**
+   * @brief Write the time to hash map of the current cache ID to the media cache
+   */
+  void SaveTimeMap();
+
+  const Codec& codec() const;
+  void SetCodec(const Codec& codec);
+
+  /**
+   * @brief Get the hash of the frame cached at this frame index (in the sequence's timebase)
+   */
+  QByteArray TimeToHash(const int64_t& frame);
+
+  void SetHash(const int64_t& frame, const QByteArray& hash);
+  void RemoveHash(const int64_t& frame, const QByteArray &hash);
+
+  /**
+   * @brief Forget every frame at or after this frame index
+   */
+  void Truncate(const int64_t& frame);
+
+  /**
+   * @brief Retrieve a frame from the memory cache
+   *
+   * Frames found in memory are moved to the front of the LRU list. This function is thread-safe.
+   *
+   * @param compressed
+   *
+   * Set to whether the frame is block-compressed (see SetMemoryCompression()). If this is nullptr, compressed frames
+   * aren't returned at all.
+   *
+   * @return
+   *
+   * The frame's pixel data or an empty QByteArray if this hash isn't in memory (in which case the disk cache should
+   * be tried).
+   */
+  QByteArray GetFromMemory(const QByteArray& hash, bool* compressed = nullptr);
 
-  QByteArray TimeToHash(const rational& time);
+  /**
+   * @brief Keep a frame in memory, evicting the least recently used frames if over the memory limit
+   *
+   * `compressed` frames are in their format's PixelFormatInfo::compressed_format. This function is thread-safe.
+   */
+  void AddToMemory(const QByteArray& hash, const QByteArray& frame, bool compressed = false);
 
-  void SetHash(const rational& time, const QByteArray& hash);
-  void RemoveHash(const rational& time, const QByteArray &hash);
+  /**
+   * @brief Set whether workers keep frames in memory block-compressed (BC7 or BC6H) rather than uncompressed
+   *
+   * Compressed frames are a quarter to an eighth of the size, so the memory limit holds that many more of them, and
+   * the viewer can sample them without decompressing. BC6H doesn't keep alpha. Off by default.
+   */
+  void SetMemoryCompression(bool e);
 
-  void Truncate(const rational& time);
+  bool memory_compression() const;
+
+  /**
+   * @brief Set the maximum number of bytes the memory cache may use (0 disables it)
+   */
+  void SetMemoryLimit(const qint64& bytes);
+
+  /**
+   * @brief Evict the least recently used frames from memory when the process is under memory pressure
+   *
+   * They're still on disk, so they only cost a read to get back.
+   */
+  virtual qint64 Reclaim(qint64 bytes) override;
 
 private:
-  void RemoveHashFromCurrentlyCaching(const QByteArray& hash);
+  /**
+   * @brief Number of independently locked shards the hash tables are split into
+   *
+   * Workers claiming different frames will almost always land in different shards, so they rarely wait on each other.
+   */
+  static const int kShardCount = 16;
+
+  struct CachingShard {
+    QMutex lock;
+    QSet<QByteArray> hashes;
+  };
+
+  struct TimeHashShard {
+    QMutex lock;
+    QHash<int64_t, QByteArray> map;
+  };
+
+  static int ShardOf(const QByteArray& hash);
+  static int ShardOf(const int64_t& frame);
+
+  /**
+   * @brief Name of a frame's file in the shared cache, without the folder
+   */
+  QString FrameFilename(const QByteArray& hash) const;
+
+  /**
+   * @brief Key of a frame in the store
+   *
+   * Includes the codec so raw frames are never mistaken for EXRs if the codec changes.
+   */
+  QByteArray FrameKey(const QByteArray& hash) const;
+
+  /**
+   * @brief Get the current store, nullptr if there's no cache ID yet
+   */
+  FrameSegmentStorePtr store();
+
+  /**
+   * @brief Copy a frame from the shared cache into the store
+   *
+   * @return
+   *
+   * TRUE if the frame is now in the local cache.
+   */
+  bool FetchFromShared(const QByteArray& hash, const FrameSegmentStorePtr& store);
 
-  QMap<rational, QByteArray> time_hash_map_;
+  /**
+   * @brief Work out the folders frames are in for the current store
+   */
+  void UpdateCacheDirs();
 
-  QMutex currently_caching_lock_;
-  QVector<QByteArray> currently_caching_list_;
+  /**
+   * @brief Replace the time to hash map with the one saved for the current cache ID (or clear it if there isn't one)
+   */
+  void LoadTimeMap();
+
+  /**
+   * @brief Where SaveTimeMap() writes to for the current cache ID
+   */
+  QString TimeMapFilename() const;
+
+  /**
+   * @brief First bytes of a time map file, followed by a version number
+   */
+  static const quint32 kTimeMapMagic = 0x4F54484D; // "OTHM"
+  static const quint32 kTimeMapVersion = 1;
+
+  void ClearMemory();
+
+  /**
+   * @brief Evict frames from the back of the LRU list until we're within the memory limit (memory_lock_ must be held)
+   */
+  void EvictFromMemory();
+
+  /**
+   * @brief Evict frames from the back of the LRU list until we're within `usage` (memory_lock_ must be held)
+   *
+   * @return
+   *
+   * How many bytes were evicted.
+   */
+  qint64 EvictMemoryTo(qint64 usage);
+
+  TimeHashShard time_hash_map_[kShardCount];
+
+  CachingShard currently_caching_[kShardCount];
 
   QString cache_id_;
+
+  QString store_id_;
+
+  /**
+   * @brief Store the frames are in, replaced by UpdateCacheDirs() from the main thread while workers use it
+   */
+  FrameSegmentStorePtr store_;
+  QMutex store_lock_;
+
+  QString shared_location_;
+
+  /**
+   * @brief Folder the store's frames are in in the shared cache, empty if there's no shared cache
+   */
+  QString shared_dir_;
+
+  Codec codec_;
+
+  struct MemoryFrame {
+    QByteArray data;
+
+    /// Whether `data` is block-compressed
+    bool compressed;
+
+    /// This frame's hash in memory_lru_, so a hit moves it to the front without searching the list
+    QLinkedList<QByteArray>::iterator lru;
+  };
+
+  QMutex memory_lock_;
+  QHash<QByteArray, MemoryFrame> memory_cache_;
+
+  bool memory_compression_;
+  QLinkedList<QByteArray> memory_lru_;
+  qint64 memory_usage_;
+  qint64 memory_limit_;
 };
 
 #endif // VIDEORENDERFRAMECACHE_H
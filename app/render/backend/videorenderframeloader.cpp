@@ -0,0 +1,188 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "videorenderframeloader.h"
+
+#include <OpenImageIO/filesystem.h>
+#include <OpenImageIO/imageio.h>
+#include <QDebug>
+
+#include "render/pixelservice.h"
+
+VideoRenderFrameLoader::VideoRenderFrameLoader(QObject *parent) :
+  QObject(parent),
+  thread_(nullptr),
+  has_request_(false),
+  stopping_(false)
+{
+}
+
+VideoRenderFrameLoader::~VideoRenderFrameLoader()
+{
+  Stop();
+}
+
+void VideoRenderFrameLoader::Start()
+{
+  if (thread_ != nullptr) {
+    return;
+  }
+
+  stopping_ = false;
+
+  thread_ = new LoaderThread(this);
+
+  // The GUI is waiting on this, so it runs at a normal priority unlike the render and writer threads
+  thread_->start();
+}
+
+void VideoRenderFrameLoader::Stop()
+{
+  if (thread_ == nullptr) {
+    return;
+  }
+
+  request_lock_.lock();
+  stopping_ = true;
+  has_request_ = false;
+  request_available_.wakeAll();
+  request_lock_.unlock();
+
+  thread_->wait();
+  delete thread_;
+  thread_ = nullptr;
+}
+
+void VideoRenderFrameLoader::Load(const rational &time,
+                                  const QByteArray &hash,
+                                  VideoRenderFrameCache *cache,
+                                  const VideoRenderingParams &params,
+                                  const VideoRenderFrameCache::Codec &codec)
+{
+  Job job;
+  job.time = time;
+  job.hash = hash;
+  job.cache = cache;
+  job.params = params;
+  job.codec = codec;
+
+  if (thread_ == nullptr) {
+    // Not started, just load synchronously
+    emit FrameLoaded(job.time, job.hash, LoadFrame(job.cache, job.hash, job.params, job.codec));
+    return;
+  }
+
+  request_lock_.lock();
+
+  request_ = job;
+  has_request_ = true;
+  request_available_.wakeOne();
+
+  request_lock_.unlock();
+}
+
+void VideoRenderFrameLoader::ProcessRequests()
+{
+  forever {
+    request_lock_.lock();
+
+    while (!has_request_ && !stopping_) {
+      request_available_.wait(&request_lock_);
+    }
+
+    if (stopping_) {
+      request_lock_.unlock();
+      return;
+    }
+
+    Job job = request_;
+    has_request_ = false;
+
+    request_lock_.unlock();
+
+    emit FrameLoaded(job.time, job.hash, LoadFrame(job.cache, job.hash, job.params, job.codec));
+  }
+}
+
+QByteArray VideoRenderFrameLoader::LoadFrame(VideoRenderFrameCache *cache,
+                                             const QByteArray &hash,
+                                             const VideoRenderingParams &params,
+                                             const VideoRenderFrameCache::Codec &codec)
+{
+  QByteArray data = cache->ReadFrame(hash);
+
+  if (data.isEmpty()) {
+    return QByteArray();
+  }
+
+  return DecodeFrame(data, params, codec);
+}
+
+QByteArray VideoRenderFrameLoader::DecodeFrame(const QByteArray &data,
+                                               const VideoRenderingParams &params,
+                                               const VideoRenderFrameCache::Codec &codec)
+{
+  int frame_size = PixelService::GetBufferSize(params.format(), params.effective_width(), params.effective_height());
+
+  if (codec == VideoRenderFrameCache::kCodecRaw) {
+    // Raw frames need no decoding, the data already is the frame
+    if (data.size() != frame_size) {
+      return QByteArray();
+    }
+
+    return data;
+  }
+
+  QByteArray frame(frame_size, Qt::Uninitialized);
+
+  // Decoded straight from memory, the filename only tells OIIO which format it is
+  OIIO::Filesystem::IOMemReader reader(const_cast<char*>(data.constData()), static_cast<size_t>(data.size()));
+  OIIO::Filesystem::IOProxy* proxy = &reader;
+
+  OIIO::ImageSpec config;
+  config.attribute("oiio:ioproxy", OIIO::TypeDesc::PTR, &proxy);
+
+  auto in = OIIO::ImageInput::open("frame.exr", &config);
+
+  if (!in) {
+    qWarning() << "OIIO Error:" << OIIO::geterror().c_str();
+    return QByteArray();
+  }
+
+  bool success = in->read_image(PixelService::GetPixelFormatInfo(params.format()).oiio_desc, frame.data());
+
+  in->close();
+
+  if (!success) {
+    return QByteArray();
+  }
+
+  return frame;
+}
+
+VideoRenderFrameLoader::LoaderThread::LoaderThread(VideoRenderFrameLoader *loader) :
+  loader_(loader)
+{
+}
+
+void VideoRenderFrameLoader::LoaderThread::run()
+{
+  loader_->ProcessRequests();
+}
@@ -0,0 +1,139 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef VIDEORENDERFRAMELOADER_H
+#define VIDEORENDERFRAMELOADER_H
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "common/constructors.h"
+#include "common/rational.h"
+#include "render/videoparams.h"
+#include "videorenderframecache.h"
+
+/**
+ * @brief A thread that reads cached frames back from disk for the viewer
+ *
+ * Opening and decoding a cached frame can take long enough to stutter the GUI, so the viewer's requests are loaded
+ * here and handed back with FrameLoaded(). Only the viewer's latest request matters, so a new request replaces one
+ * that hasn't been started yet rather than queueing behind it.
+ */
+class VideoRenderFrameLoader : public QObject
+{
+  Q_OBJECT
+public:
+  VideoRenderFrameLoader(QObject* parent = nullptr);
+
+  virtual ~VideoRenderFrameLoader() override;
+
+  DISABLE_COPY_MOVE(VideoRenderFrameLoader)
+
+  /**
+   * @brief Start the loader thread
+   */
+  void Start();
+
+  /**
+   * @brief Finish loading the current frame (if any) and stop the loader thread
+   *
+   * A request that hasn't been started yet is dropped.
+   */
+  void Stop();
+
+  /**
+   * @brief Request that the frame with `hash` in `cache` is loaded, replacing any request that hasn't been started yet
+   *
+   * FrameLoaded() is emitted from the loader thread once it's done. This function is thread-safe.
+   */
+  void Load(const rational& time,
+            const QByteArray& hash,
+            VideoRenderFrameCache* cache,
+            const VideoRenderingParams& params,
+            const VideoRenderFrameCache::Codec& codec);
+
+  /**
+   * @brief Read a single frame from the disk cache (blocks until it's been read)
+   *
+   * @return
+   *
+   * The frame's pixel data or an empty QByteArray on failure.
+   */
+  static QByteArray LoadFrame(VideoRenderFrameCache* cache,
+                              const QByteArray& hash,
+                              const VideoRenderingParams& params,
+                              const VideoRenderFrameCache::Codec& codec);
+
+  /**
+   * @brief Decode a frame's data as read with VideoRenderFrameCache::ReadFrame()
+   *
+   * @return
+   *
+   * The frame's pixel data or an empty QByteArray on failure.
+   */
+  static QByteArray DecodeFrame(const QByteArray& data,
+                                const VideoRenderingParams& params,
+                                const VideoRenderFrameCache::Codec& codec);
+
+signals:
+  /**
+   * @brief Emitted from the loader thread when a request has been loaded
+   *
+   * `frame` contains the frame's pixel data, or is empty if the frame couldn't be read.
+   */
+  void FrameLoaded(const rational& time, QByteArray hash, QByteArray frame);
+
+private:
+  struct Job {
+    rational time;
+    QByteArray hash;
+    VideoRenderFrameCache* cache;
+    VideoRenderingParams params;
+    VideoRenderFrameCache::Codec codec;
+  };
+
+  class LoaderThread : public QThread
+  {
+  public:
+    LoaderThread(VideoRenderFrameLoader* loader);
+
+  protected:
+    virtual void run() override;
+
+  private:
+    VideoRenderFrameLoader* loader_;
+  };
+
+  /**
+   * @brief Main loop of the loader thread, runs until Stop() is called
+   */
+  void ProcessRequests();
+
+  LoaderThread* thread_;
+
+  QMutex request_lock_;
+  QWaitCondition request_available_;
+  Job request_;
+  bool has_request_;
+  bool stopping_;
+};
+
+#endif // VIDEORENDERFRAMELOADER_H
@@ -0,0 +1,408 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "videorenderframewriter.h"
+
+#include <OpenImageIO/filesystem.h>
+#include <OpenImageIO/imageio.h>
+#include <QDebug>
+#include <QFileInfo>
+
+#include "common/define.h"
+#include "common/filefunctions.h"
+#include "common/metrics.h"
+#include "common/tracer.h"
+#include "decoder/frame.h"
+#include "render/pixelservice.h"
+#include "videorenderframeloader.h"
+
+VideoRenderFrameWriter::VideoRenderFrameWriter(QObject *parent) :
+  QObject(parent),
+  upload_thread_(nullptr),
+  queue_size_(0),
+  stopping_(false)
+{
+}
+
+VideoRenderFrameWriter::~VideoRenderFrameWriter()
+{
+  Stop();
+}
+
+void VideoRenderFrameWriter::Start(int thread_count, int queue_size)
+{
+  if (!threads_.isEmpty()) {
+    return;
+  }
+
+  queue_size_ = queue_size;
+  stopping_ = false;
+
+  for (int i=0;i<thread_count;i++) {
+    WriterThread* thread = new WriterThread(this);
+    threads_.append(thread);
+
+    // Like the render threads, we use a low priority to keep the GUI responsive
+    thread->start(QThread::LowPriority);
+  }
+
+  upload_thread_ = new UploadThread(this);
+  upload_thread_->start(QThread::LowestPriority);
+}
+
+void VideoRenderFrameWriter::Stop()
+{
+  if (threads_.isEmpty()) {
+    return;
+  }
+
+  queue_lock_.lock();
+  stopping_ = true;
+  queue_not_empty_.wakeAll();
+  queue_lock_.unlock();
+
+  foreach (WriterThread* thread, threads_) {
+    thread->wait();
+    delete thread;
+  }
+
+  threads_.clear();
+
+  // Every frame has been written, so nothing else will be queued for uploading
+  queue_lock_.lock();
+  upload_queue_.clear();
+  upload_not_empty_.wakeAll();
+  queue_lock_.unlock();
+
+  upload_thread_->wait();
+  delete upload_thread_;
+  upload_thread_ = nullptr;
+}
+
+void VideoRenderFrameWriter::Write(const NodeDependency &dep,
+                                   const QByteArray &hash,
+                                   const VideoRenderFrameCache::Destination &destination,
+                                   const QByteArray &buffer,
+                                   const VideoRenderingParams &params,
+                                   const VideoRenderFrameCache::Codec &codec)
+{
+  Job job;
+  job.dep = dep;
+  job.hash = hash;
+  job.destination = destination;
+  job.buffer = buffer;
+  job.params = params;
+  job.codec = codec;
+  job.cache = nullptr;
+
+  if (threads_.isEmpty()) {
+    // Not started, just write synchronously
+    if (WriteJob(job)) {
+      emit FrameWritten(job.dep, job.hash);
+
+      if (!job.destination.shared_filename.isEmpty()) {
+        Upload upload = {job.destination.store, job.destination.key, job.destination.shared_filename};
+        UploadFrame(upload);
+      }
+    }
+    return;
+  }
+
+  Enqueue(job);
+}
+
+void VideoRenderFrameWriter::WriteImage(const QString &filename,
+                                        const QByteArray &buffer,
+                                        const QByteArray &hash,
+                                        VideoRenderFrameCache *cache,
+                                        const VideoRenderingParams &params,
+                                        ColorProcessorPtr color_processor)
+{
+  Job job;
+  job.hash = hash;
+  job.buffer = buffer;
+  job.params = params;
+  job.codec = cache->codec();
+  job.filename = filename;
+  job.cache = cache;
+  job.color_processor = color_processor;
+
+  if (threads_.isEmpty()) {
+    // Not started, just write synchronously
+    emit ImageWritten(job.filename, WriteImageJob(job));
+    return;
+  }
+
+  Enqueue(job);
+}
+
+void VideoRenderFrameWriter::Enqueue(const VideoRenderFrameWriter::Job &job)
+{
+  queue_lock_.lock();
+
+  while (queue_.size() >= queue_size_) {
+    queue_not_full_.wait(&queue_lock_);
+  }
+
+  queue_.enqueue(job);
+  queue_not_empty_.wakeOne();
+
+  Metrics::Add(Metrics::kFrameWritesQueued, 1);
+
+  queue_lock_.unlock();
+}
+
+void VideoRenderFrameWriter::ProcessQueue()
+{
+  forever {
+    queue_lock_.lock();
+
+    while (queue_.isEmpty() && !stopping_) {
+      queue_not_empty_.wait(&queue_lock_);
+    }
+
+    if (queue_.isEmpty()) {
+      // Stopping and nothing left to write
+      queue_lock_.unlock();
+      return;
+    }
+
+    Job job = queue_.dequeue();
+    queue_not_full_.wakeOne();
+
+    Metrics::Add(Metrics::kFrameWritesQueued, -1);
+
+    queue_lock_.unlock();
+
+    if (!job.filename.isEmpty()) {
+      emit ImageWritten(job.filename, WriteImageJob(job));
+    } else if (WriteJob(job)) {
+      emit FrameWritten(job.dep, job.hash);
+
+      QueueUpload(job);
+    }
+  }
+}
+
+void VideoRenderFrameWriter::QueueUpload(const Job &job)
+{
+  if (job.destination.shared_filename.isEmpty()) {
+    return;
+  }
+
+  queue_lock_.lock();
+
+  if (upload_queue_.size() < kMaximumQueuedUploads) {
+    Upload upload = {job.destination.store, job.destination.key, job.destination.shared_filename};
+
+    upload_queue_.enqueue(upload);
+    upload_not_empty_.wakeOne();
+  }
+
+  queue_lock_.unlock();
+}
+
+void VideoRenderFrameWriter::ProcessUploads()
+{
+  forever {
+    queue_lock_.lock();
+
+    while (upload_queue_.isEmpty() && !stopping_) {
+      upload_not_empty_.wait(&queue_lock_);
+    }
+
+    if (upload_queue_.isEmpty()) {
+      queue_lock_.unlock();
+      return;
+    }
+
+    Upload upload = upload_queue_.dequeue();
+
+    queue_lock_.unlock();
+
+    UploadFrame(upload);
+  }
+}
+
+void VideoRenderFrameWriter::UploadFrame(const VideoRenderFrameWriter::Upload &upload)
+{
+  Tracer::Scope trace("disk", "UploadFrame");
+
+  if (QFileInfo::exists(upload.shared_filename)) {
+    // Another workstation rendered the same frame
+    return;
+  }
+
+  QByteArray data = upload.store->Read(upload.key);
+
+  if (data.isEmpty() || !WriteFileAtomically(upload.shared_filename, data)) {
+    qWarning() << "Failed to copy" << upload.shared_filename << "to the shared cache";
+  }
+}
+
+bool VideoRenderFrameWriter::WriteJob(const VideoRenderFrameWriter::Job &job)
+{
+  // Includes compressing the EXR
+  Tracer::Scope trace("disk", "WriteJob");
+
+  if (job.destination.store == nullptr) {
+    return false;
+  }
+
+  if (job.codec == VideoRenderFrameCache::kCodecRaw) {
+    // Raw frames are stored as-is so they're copied straight back out
+    return job.destination.store->Append(job.destination.key, job.buffer);
+  }
+
+  PixelFormatInfo format_info = PixelService::GetPixelFormatInfo(job.params.format());
+
+  // Set up OIIO::ImageSpec for compressing cached images on disk
+  OIIO::ImageSpec spec(job.params.effective_width(), job.params.effective_height(), kRGBAChannels, format_info.oiio_desc);
+
+  switch (job.codec) {
+  case VideoRenderFrameCache::kCodecDWAA:
+    spec.attribute("compression", "dwaa:200");
+    break;
+  case VideoRenderFrameCache::kCodecPIZ:
+    spec.attribute("compression", "piz");
+    break;
+  case VideoRenderFrameCache::kCodecUncompressed:
+  case VideoRenderFrameCache::kCodecRaw:
+    spec.attribute("compression", "none");
+    break;
+  }
+
+  // Encoded into memory, the filename only tells OIIO which format to write
+  std::vector<unsigned char> encoded;
+  OIIO::Filesystem::IOVecOutput writer(encoded);
+  OIIO::Filesystem::IOProxy* proxy = &writer;
+
+  spec.attribute("oiio:ioproxy", OIIO::TypeDesc::PTR, &proxy);
+
+  std::unique_ptr<OIIO::ImageOutput> out = OIIO::ImageOutput::create("exr");
+
+  if (!out || !out->open("frame.exr", spec)) {
+    qWarning() << "Failed to encode cached frame:" << OIIO::geterror().c_str();
+    return false;
+  }
+
+  bool success = out->write_image(format_info.oiio_desc, job.buffer.constData());
+
+  out->close();
+
+  if (!success) {
+    return false;
+  }
+
+  return job.destination.store->Append(job.destination.key,
+                                       QByteArray(reinterpret_cast<const char*>(encoded.data()),
+                                                  static_cast<int>(encoded.size())));
+}
+
+bool VideoRenderFrameWriter::WriteImageJob(const VideoRenderFrameWriter::Job &job)
+{
+  Tracer::Scope trace("disk", "WriteImageJob");
+
+  FramePtr frame = Frame::Create();
+  frame->set_width(job.params.effective_width());
+  frame->set_height(job.params.effective_height());
+  frame->set_format(job.params.format());
+  frame->allocate();
+
+  QByteArray pixels = job.buffer;
+
+  if (pixels.isEmpty() && !job.hash.isEmpty()) {
+    pixels = VideoRenderFrameLoader::LoadFrame(job.cache, job.hash, job.params, job.codec);
+
+    if (pixels.isEmpty()) {
+      qWarning() << "Failed to read a rendered frame from the disk cache for" << job.filename;
+      return false;
+    }
+  }
+
+  if (pixels.size() == frame->allocated_size()) {
+    memcpy(frame->data(), pixels.constData(), static_cast<size_t>(pixels.size()));
+  } else {
+    // Nothing at this time (e.g. a gap)
+    memset(frame->data(), 0, static_cast<size_t>(frame->allocated_size()));
+  }
+
+  QString suffix = QFileInfo(job.filename).suffix().toLower();
+
+  std::unique_ptr<OIIO::ImageOutput> out = OIIO::ImageOutput::create(job.filename.toStdString());
+
+  if (!out) {
+    qWarning() << "Failed to find an image format for" << job.filename << ":" << OIIO::geterror().c_str();
+    return false;
+  }
+
+  bool success;
+
+  if (suffix == "exr") {
+    // Left in the reference space for compositing, losslessly compressed
+    PixelFormatInfo format_info = PixelService::GetPixelFormatInfo(job.params.format());
+
+    OIIO::ImageSpec spec(frame->width(), frame->height(), kRGBAChannels, format_info.oiio_desc);
+    spec.attribute("compression", "zip");
+
+    success = out->open(job.filename.toStdString(), spec)
+        && out->write_image(format_info.oiio_desc, frame->data());
+  } else {
+    FramePtr display_frame = PixelService::ConvertPixelFormat(frame, olive::PIX_FMT_RGBA32F);
+    job.color_processor->ConvertFrame(display_frame);
+
+    OIIO::ImageSpec spec(display_frame->width(), display_frame->height(), kRGBAChannels, OIIO::TypeDesc::UINT16);
+
+    if (suffix == "dpx") {
+      spec.attribute("oiio:BitsPerSample", 10);
+    }
+
+    success = out->open(job.filename.toStdString(), spec)
+        && out->write_image(OIIO::TypeDesc::FLOAT, display_frame->data());
+  }
+
+  if (!success) {
+    qWarning() << "Failed to write" << job.filename << ":" << out->geterror().c_str();
+  }
+
+  out->close();
+
+  return success;
+}
+
+VideoRenderFrameWriter::WriterThread::WriterThread(VideoRenderFrameWriter *writer) :
+  writer_(writer)
+{
+}
+
+void VideoRenderFrameWriter::WriterThread::run()
+{
+  writer_->ProcessQueue();
+}
+
+VideoRenderFrameWriter::UploadThread::UploadThread(VideoRenderFrameWriter *writer) :
+  writer_(writer)
+{
+}
+
+void VideoRenderFrameWriter::UploadThread::run()
+{
+  writer_->ProcessUploads();
+}
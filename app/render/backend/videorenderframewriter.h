@@ -0,0 +1,226 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef VIDEORENDERFRAMEWRITER_H
+#define VIDEORENDERFRAMEWRITER_H
+
+#include <QMutex>
+#include <QQueue>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "common/constructors.h"
+#include "node/dependency.h"
+#include "render/colorprocessor.h"
+#include "render/videoparams.h"
+#include "videorenderframecache.h"
+
+/**
+ * @brief A pool of threads that encode and write rendered frames to the disk cache
+ *
+ * Encoding an EXR (especially with DWAA compression) is slow, so render workers hand their downloaded frames to this
+ * pool and go straight back to rendering. The queue is bounded, so if the writers fall behind, Write() blocks the
+ * calling worker rather than letting frames pile up in memory.
+ *
+ * Frames that should also go to a shared cache are copied there by a thread of their own once they've been written,
+ * so a slow network never holds up the writers.
+ *
+ * The same threads also write image sequences for export (see WriteImage()), each frame being a file of its own.
+ */
+class VideoRenderFrameWriter : public QObject
+{
+  Q_OBJECT
+public:
+  VideoRenderFrameWriter(QObject* parent = nullptr);
+
+  virtual ~VideoRenderFrameWriter() override;
+
+  DISABLE_COPY_MOVE(VideoRenderFrameWriter)
+
+  /**
+   * @brief Start the writer threads (and the thread that copies frames to the shared cache)
+   *
+   * @param thread_count
+   *
+   * Number of frames that can be encoded at the same time.
+   *
+   * @param queue_size
+   *
+   * Maximum number of frames waiting to be encoded before Write() blocks.
+   */
+  void Start(int thread_count, int queue_size);
+
+  /**
+   * @brief Finish writing any queued frames and stop the writer threads
+   *
+   * Frames that haven't been copied to the shared cache yet are left out, someone else can render them.
+   */
+  void Stop();
+
+  /**
+   * @brief Queue a frame to be encoded and written to `destination` (see VideoRenderFrameCache::DestinationOf())
+   *
+   * This function is thread-safe. It blocks only if the queue is full.
+   */
+  void Write(const NodeDependency& dep,
+             const QByteArray& hash,
+             const VideoRenderFrameCache::Destination& destination,
+             const QByteArray& buffer,
+             const VideoRenderingParams& params,
+             const VideoRenderFrameCache::Codec& codec);
+
+  /**
+   * @brief Queue a frame to be written to an image file of its own (e.g. one frame of an EXR or DPX sequence)
+   *
+   * The file format is chosen from the filename's extension. OpenEXR files are written in the scene linear reference
+   * space the frame was rendered in, anything else is converted with `color_processor` first.
+   *
+   * @param buffer
+   *
+   * The frame's pixel data, or empty to read it from `cache` with `hash`. The image is blank if both are empty.
+   *
+   * This function is thread-safe. It blocks only if the queue is full. ImageWritten() is emitted once it's done.
+   */
+  void WriteImage(const QString& filename,
+                  const QByteArray& buffer,
+                  const QByteArray& hash,
+                  VideoRenderFrameCache* cache,
+                  const VideoRenderingParams& params,
+                  ColorProcessorPtr color_processor);
+
+signals:
+  /**
+   * @brief Emitted from a writer thread when a frame has been written successfully
+   */
+  void FrameWritten(NodeDependency dep, QByteArray hash);
+
+  /**
+   * @brief Emitted from a writer thread when a file queued with WriteImage() has been written or failed to be
+   */
+  void ImageWritten(QString filename, bool success);
+
+private:
+  struct Job {
+    NodeDependency dep;
+    QByteArray hash;
+    VideoRenderFrameCache::Destination destination;
+    QByteArray buffer;
+    VideoRenderingParams params;
+    VideoRenderFrameCache::Codec codec;
+
+    /**
+     * @brief Set for WriteImage() jobs, which go to this file rather than to `destination`
+     */
+    QString filename;
+    VideoRenderFrameCache* cache;
+    ColorProcessorPtr color_processor;
+  };
+
+  class WriterThread : public QThread
+  {
+  public:
+    WriterThread(VideoRenderFrameWriter* writer);
+
+  protected:
+    virtual void run() override;
+
+  private:
+    VideoRenderFrameWriter* writer_;
+  };
+
+  class UploadThread : public QThread
+  {
+  public:
+    UploadThread(VideoRenderFrameWriter* writer);
+
+  protected:
+    virtual void run() override;
+
+  private:
+    VideoRenderFrameWriter* writer_;
+  };
+
+  /**
+   * @brief A written frame waiting to be copied to the shared cache
+   */
+  struct Upload {
+    FrameSegmentStorePtr store;
+    QByteArray key;
+    QString shared_filename;
+  };
+
+  /**
+   * @brief Add a job to the queue, blocking while it's full
+   */
+  void Enqueue(const Job& job);
+
+  /**
+   * @brief Main loop of each writer thread, runs until Stop() is called and the queue is empty
+   */
+  void ProcessQueue();
+
+  /**
+   * @brief Main loop of the upload thread, runs until Stop() is called
+   */
+  void ProcessUploads();
+
+  /**
+   * @brief Queue a written frame to be copied to the shared cache
+   */
+  void QueueUpload(const Job& job);
+
+  /**
+   * @brief Copy a frame to the shared cache, unless it's already there
+   */
+  static void UploadFrame(const Upload& upload);
+
+  /**
+   * @brief Maximum number of frames waiting to be copied to the shared cache, any more are dropped
+   *
+   * Sharing is opportunistic, so if the shared cache can't keep up we'd rather skip frames than hold the local ones up.
+   */
+  static const int kMaximumQueuedUploads = 256;
+
+  /**
+   * @brief Encode a single frame and append it to its store
+   */
+  static bool WriteJob(const Job& job);
+
+  /**
+   * @brief Write a WriteImage() job to its file
+   */
+  static bool WriteImageJob(const Job& job);
+
+  QVector<WriterThread*> threads_;
+
+  UploadThread* upload_thread_;
+
+  QWaitCondition upload_not_empty_;
+  QQueue<Upload> upload_queue_;
+
+  QMutex queue_lock_;
+  QWaitCondition queue_not_empty_;
+  QWaitCondition queue_not_full_;
+  QQueue<Job> queue_;
+  int queue_size_;
+  bool stopping_;
+};
+
+#endif // VIDEORENDERFRAMEWRITER_H
@@ -1,65 +1,442 @@
 #include "videorenderworker.h"
 
+#include <QElapsedTimer>
+
 #include "common/define.h"
+#include "common/timerange.h"
+#include "common/tracer.h"
 #include "node/node.h"
 #include "render/pixelservice.h"
+#include "videorenderframeloader.h"
 
-VideoRenderWorker::VideoRenderWorker(DecoderCache *decoder_cache, VideoRenderFrameCache *frame_cache, QObject *parent) :
+VideoRenderWorker::VideoRenderWorker(DecoderCache *decoder_cache,
+                                     VideoRenderFrameCache *frame_cache,
+                                     VideoRenderFrameWriter *frame_writer,
+                                     QObject *parent) :
   RenderWorker(decoder_cache, parent),
-  frame_cache_(frame_cache)
+  frame_cache_(frame_cache),
+  frame_writer_(frame_writer),
+  tile_size_(0),
+  decode_usecs_(0),
+  decode_frames_(0),
+  decode_paths_(0)
 {
 
 }
 
+void VideoRenderWorker::TakeDecodeTime(qint64 *usecs, int *frames, int *paths)
+{
+  *usecs = decode_usecs_.fetchAndStoreRelaxed(0);
+  *frames = decode_frames_.fetchAndStoreRelaxed(0);
+  *paths = decode_paths_.fetchAndStoreRelaxed(0);
+}
+
 const VideoRenderingParams &VideoRenderWorker::video_params()
 {
   return video_params_;
 }
 
-NodeValueTable VideoRenderWorker::RenderInternal(const NodeDependency& path)
+const QRect &VideoRenderWorker::tile() const
 {
-  // Get hash of node graph
-  // We use SHA-1 for speed (benchmarks show it's the fastest hash available to us)
-  QCryptographicHash hasher(QCryptographicHash::Sha1);
-  HashNodeRecursively(&hasher, path.node(), path.in());
-  QByteArray hash = hasher.result();
+  return tile_;
+}
 
-  NodeValueTable value;
+int VideoRenderWorker::MaximumTextureSize() const
+{
+  return 0;
+}
+
+bool VideoRenderWorker::CanForkSiblings() const
+{
+  return tile_.width() == video_params_.effective_width() && tile_.height() == video_params_.effective_height();
+}
+
+void VideoRenderWorker::SetTileSize(int size)
+{
+  tile_size_ = size;
+}
+
+int VideoRenderWorker::TileSize() const
+{
+  int maximum = MaximumTextureSize();
+
+  if (maximum <= 0) {
+    return 0;
+  }
+
+  if (tile_size_ > 0) {
+    // Tiles smaller than their own halo would never get anywhere
+    return qBound(4 * kTileHalo, tile_size_, maximum);
+  }
+
+  return maximum;
+}
+
+void VideoRenderWorker::RenderJob(const NodeDependency& path)
+{
+  // Get hash of node graph
+  QByteArray hash = HashFrame(path.node(), path.in());
 
-  if (frame_cache_->HasHash(hash)) {
+  if (JobIsStale()) {
+    // The graph changed while this was waiting in the queue (or while we were hashing it)
+    PushResult(RenderResult::kCancelled, path);
+  } else if (frame_cache_->HasHash(hash)) {
     // We've already cached this hash, no need to continue
-    emit HashAlreadyExists(path, hash);
+    PushResult(RenderResult::kHashAlreadyExists, path, hash);
   } else if (frame_cache_->TryCache(hash)) {
+    int tile_size = TileSize();
+
+    if (tile_size > 0
+        && (video_params().effective_width() > tile_size || video_params().effective_height() > tile_size)) {
+      // Too big to render in one go
+      RenderTiles(path, hash, tile_size);
+      return;
+    }
+
     // This hash is available for us to cache, start traversing graph
-    value = RenderAsSibling(path);
+    NodeValueTable value = RenderInternal(path);
+
+    // Constants don't need a texture while rendering, but the finished frame does
+    QVector4D constant;
+
+    if (NodeValue::IsConstantTexture(value.Get(NodeParam::kTexture), &constant)) {
+      value.Push(NodeParam::kTexture, CreateConstantTexture(constant));
+    }
+
+    if (JobIsStale()) {
+      // The graph changed partway through, so whatever was rendered doesn't match the hash and isn't worth finishing
+      frame_cache_->RemoveHashFromCurrentlyCaching(hash);
+
+      PushResult(RenderResult::kCancelled, path, hash);
+    } else {
+      FrameFinishedEvent();
 
-    emit CompletedFrame(path, hash, value);
+      PushResult(RenderResult::kCompletedFrame, path, hash, value);
+    }
   } else {
-    // Another thread must be caching this already, nothing to be done
-    emit HashAlreadyBeingCached();
+    // Another thread must be caching this already, the backend fills this frame in once it has
+    PushResult(RenderResult::kHashAlreadyBeingCached, path, hash);
   }
+}
+
+void VideoRenderWorker::RenderTiles(const NodeDependency &path, const QByteArray &hash, int tile_size)
+{
+  Tracer::Scope trace("render", "RenderTiles");
+
+  const QRect frame(0, 0, video_params().effective_width(), video_params().effective_height());
+  int bytes_per_pixel = PixelService::BytesPerPixel(video_params().format());
+  int frame_line = frame.width() * bytes_per_pixel;
+
+  // The halo on either side comes out of each tile's size
+  int step = tile_size - 2 * kTileHalo;
+
+  bool has_texture = false;
+  bool cancelled = false;
+
+  for (int y=0;y<frame.height() && !cancelled;y+=step) {
+    for (int x=0;x<frame.width() && !cancelled;x+=step) {
+      QRect inner = QRect(x, y, step, step) & frame;
+
+      tile_ = inner.adjusted(-kTileHalo, -kTileHalo, kTileHalo, kTileHalo) & frame;
+      ParametersChangedEvent();
+
+      // Anything kept from another tile covers the wrong part of the frame
+      ClearStaticValues();
+
+      NodeValueTable value = RenderInternal(path);
+      QVariant texture = value.Get(NodeParam::kTexture);
+      QVector4D constant;
+
+      if (NodeValue::IsConstantTexture(texture, &constant)) {
+        texture = CreateConstantTexture(constant);
+      }
+
+      if (JobIsStale()) {
+        cancelled = true;
+        break;
+      }
 
-  return value;
+      int tile_line = tile_.width() * bytes_per_pixel;
+      int inner_line = inner.width() * bytes_per_pixel;
+      int tile_offset = (inner.y() - tile_.y()) * tile_line + (inner.x() - tile_.x()) * bytes_per_pixel;
+      char* frame_data = download_buffer_.data() + inner.y() * frame_line + inner.x() * bytes_per_pixel;
+
+      if (texture.isNull()) {
+        for (int i=0;i<inner.height();i++) {
+          memset(frame_data + i * frame_line, 0, static_cast<size_t>(inner_line));
+        }
+      } else {
+        tile_buffer_.resize(PixelService::GetBufferSize(video_params().format(), tile_.width(), tile_.height()));
+
+        TextureToBuffer(texture, tile_buffer_);
+
+        for (int i=0;i<inner.height();i++) {
+          memcpy(frame_data + i * frame_line,
+                 tile_buffer_.constData() + tile_offset + i * tile_line,
+                 static_cast<size_t>(inner_line));
+        }
+
+        has_texture = true;
+      }
+    }
+  }
+
+  // Back to whole frames for the next job
+  tile_ = frame;
+  ParametersChangedEvent();
+  ClearStaticValues();
+
+  if (cancelled) {
+    frame_cache_->RemoveHashFromCurrentlyCaching(hash);
+
+    PushResult(RenderResult::kCancelled, path, hash);
+  } else if (!has_texture) {
+    // Same as a frame rendered in one go with nothing in it
+    PushResult(RenderResult::kCompletedFrame, path, hash, NodeValueTable());
+  } else {
+    SaveFrameToCache(path, hash, download_buffer_);
+
+    PushResult(RenderResult::kCompletedTiles, path, hash);
+  }
+}
+
+NodeValueTable VideoRenderWorker::ProcessCachedInput(Node *connected, const TimeRange &range)
+{
+  int width = video_params().effective_width();
+  int height = video_params().effective_height();
+
+  if (tile_.width() != width || tile_.height() != height) {
+    // Cached frames are whole frames
+    return RenderWorker::ProcessCachedInput(connected, range);
+  }
+
+  QByteArray hash = HashFrame(connected, range.in());
+
+  if (JobIsStale()) {
+    return NodeValueTable();
+  }
+
+  QByteArray buffer = frame_cache_->GetFromMemory(hash);
+
+  if (buffer.isEmpty() && frame_cache_->HasHash(hash)) {
+    buffer = VideoRenderFrameLoader::LoadFrame(frame_cache_, hash, video_params(), frame_cache_->codec());
+  }
+
+  if (!buffer.isEmpty()) {
+    Tracer::Scope trace("render", "CachedSequenceFrame");
+
+    // The frame holds on to a copy of the buffer rather than the pixel data being copied again
+    std::shared_ptr<QByteArray> owner = std::make_shared<QByteArray>(buffer);
+
+    FramePtr frame = Frame::Create();
+    frame->set_width(width);
+    frame->set_height(height);
+    frame->set_format(video_params().format());
+    frame->set_external_data(owner->constData(), owner->size(), owner);
+
+    // Cached frames are already in the reference space
+    NodeValueTable table;
+    FrameToValue(nullptr, frame, &table);
+    return table;
+  }
+
+  NodeValueTable table = RenderWorker::ProcessCachedInput(connected, range);
+
+  QVariant texture = table.Get(NodeParam::kTexture);
+  QVector4D constant;
+
+  if (!JobIsStale()
+      && !texture.isNull()
+      && !NodeValue::IsConstantTexture(texture, &constant)
+      && frame_cache_->TryCache(hash)) {
+    // Keep the frame so the next time this sequence is shown (nested or not) it doesn't need rendering again
+    QByteArray rendered(PixelService::GetBufferSize(video_params().format(), width, height), Qt::Uninitialized);
+
+    TextureToBuffer(texture, rendered);
+
+    frame_cache_->AddToMemory(hash, rendered);
+    frame_cache_->RemoveHashFromCurrentlyCaching(hash);
+  }
+
+  return table;
+}
+
+StreamPtr VideoRenderWorker::ResolveDecodeStream(StreamPtr stream)
+{
+  if (video_params().mode() == olive::kOffline && stream->type() == Stream::kVideo) {
+    StreamPtr proxy = stream->footage()->proxy(stream->index());
+
+    if (proxy != nullptr) {
+      return proxy;
+    }
+  }
+
+  return stream;
+}
+
+int VideoRenderWorker::DecodeDivider(StreamPtr stream)
+{
+  int divider = video_params().divider();
+
+  // A proxy has already been reduced, so only the rest of the divider needs to be applied when decoding it
+  if (stream->type() == Stream::kVideo) {
+    divider = qMax(1, divider / std::static_pointer_cast<ImageStream>(stream)->proxy_divider());
+  }
+
+  return divider;
+}
+
+int VideoRenderWorker::PrefetchFrameCount(StreamPtr stream, rational *interval, int *divider)
+{
+  *divider = DecodeDivider(stream);
+
+  if (stream->type() != Stream::kVideo) {
+    // Stills are decoded once anyway
+    return 0;
+  }
+
+  rational frame_rate = std::static_pointer_cast<VideoStream>(stream)->frame_rate();
+
+  if (frame_rate.numerator() <= 0) {
+    return 0;
+  }
+
+  *interval = frame_rate.flipped();
+
+  return qMin(kPrefetchFrames, QueuedJobCount());
 }
 
 FramePtr VideoRenderWorker::RetrieveFromDecoder(DecoderPtr decoder, const TimeRange &range)
 {
-  return decoder->RetrieveVideo(range.in());
+  int divider = DecodeDivider(decoder->stream());
+
+  decoder->set_render_mode(video_params().mode());
+
+  QElapsedTimer timer;
+  timer.start();
+
+  FramePtr frame = decoder->RetrieveVideo(range.in(), divider);
+
+  decode_usecs_.fetchAndAddRelaxed(timer.nsecsElapsed() / 1000);
+  decode_frames_.fetchAndAddRelaxed(1);
+  decode_paths_.fetchAndOrRelaxed(decoder->ActiveDecodePath());
+
+  return frame;
+}
+
+QByteArray VideoRenderWorker::HashFrame(Node *n, const rational &time)
+{
+  QMap<rational, ConstantSpan>& spans = constant_spans_[n];
+  QMap<rational, ConstantSpan>::const_iterator span = spans.upperBound(time);
+
+  if (span != spans.constBegin()) {
+    span--;
+
+    if (time < span.value().out) {
+      return span.value().hash;
+    }
+  }
+
+  FrameHasher hasher;
+  TimeRange constant;
+  HashNodeRecursively(&hasher, n, time, &constant);
+  QByteArray hash = hasher.Result();
+
+  // A stale job may have hashed the graph while it was being changed
+  if (constant.in() < constant.out() && !JobIsStale()) {
+    spans.insert(constant.in(), {constant.out(), hash});
+  }
+
+  return hash;
+}
+
+namespace {
+/**
+ * @brief Narrow a constant span to the part that's also in `other`, keeping it around `time` (see HashNodeRecursively())
+ */
+void IntersectConstantSpan(TimeRange* span, const TimeRange& other, const rational& time)
+{
+  rational in = qMax(span->in(), other.in());
+  rational out = qMin(span->out(), other.out());
+
+  if (in < out) {
+    span->set_range(in, out);
+  } else {
+    span->set_range(time, time);
+  }
+}
+
+/**
+ * @brief Move a span from an input's time back to its node's time, adjustments are offsets (see InputTimeAdjustment())
+ */
+TimeRange OffsetConstantSpan(const TimeRange& span, const rational& offset)
+{
+  return TimeRange((span.in() == RATIONAL_MIN) ? RATIONAL_MIN : span.in() + offset,
+                   (span.out() == RATIONAL_MAX) ? RATIONAL_MAX : span.out() + offset);
+}
 }
 
-void VideoRenderWorker::HashNodeRecursively(QCryptographicHash *hash, Node* n, const rational& time)
+bool VideoRenderWorker::HashNodeRecursively(FrameHasher *hash, Node* n, const rational& time, TimeRange* constant)
 {
+  // Which Block we get depends on the time, so nothing above a track can be static
+  bool is_track = n->IsTrack();
+
+  constant->set_range(RATIONAL_MIN, RATIONAL_MAX);
+
   // Resolve BlockList
-  if (n->IsTrack()) {
-    n = static_cast<TrackOutput*>(n)->BlockAtTime(time);
+  if (is_track) {
+    TrackOutput* track = static_cast<TrackOutput*>(n);
 
-    if (!n) {
-      return;
+    // Rendered as if there was nothing on it (see RenderBlock())
+    if (TrackOutput::IsSkipped(track->TrackChain(), track, time)) {
+      constant->set_range(time, time);
+      return false;
+    }
+
+    Block* block = track->BlockAtTime(time);
+
+    if (!block) {
+      constant->set_range(time, time);
+      return false;
+    }
+
+    // Whatever is under the Block, the track only shows it while the Block lasts
+    constant->set_range(block->in(), block->out());
+
+    n = block;
+  }
+
+  // A bypassed node gives the same frame as its main input (see RenderWorker::ProcessNodeNormally())
+  if (n->IsBypassed()) {
+    NodeInput* main_input = n->MainInput();
+
+    if (main_input == nullptr || !main_input->IsConnected()) {
+      return !is_track;
     }
+
+    rational input_time = n->InputTimeAdjustment(main_input, TimeRange(time, time)).in();
+    TimeRange input_constant;
+
+    bool input_static = HashNodeRecursively(hash, main_input->get_connected_node(), input_time, &input_constant);
+
+    IntersectConstantSpan(constant, OffsetConstantSpan(input_constant, time - input_time), time);
+
+    return input_static && !is_track;
+  }
+
+  // If we've already hashed this Node and it doesn't change over time, we can just reuse that
+  QHash<Node*, QByteArray>::const_iterator memoized = static_hashes_.constFind(n);
+
+  if (memoized != static_hashes_.constEnd()) {
+    hash->AddData(memoized.value());
+    return !is_track;
   }
 
+  FrameHasher node_hash;
+  bool is_static = true;
+
   // Add this Node's ID
-  hash->addData(n->id().toUtf8());
+  node_hash.AddData(n->id());
 
   foreach (NodeParam* param, n->parameters()) {
     // For each input, try to hash its value
@@ -75,48 +452,93 @@ void VideoRenderWorker::HashNodeRecursively(QCryptographicHash *hash, Node* n, c
 
         if (input->IsConnected()) {
           // Traverse down this edge
-          HashNodeRecursively(hash, input->get_connected_node(), input_time);
+          TimeRange input_constant;
+
+          if (!HashNodeRecursively(&node_hash, input->get_connected_node(), input_time, &input_constant)) {
+            is_static = false;
+          }
+
+          IntersectConstantSpan(constant, OffsetConstantSpan(input_constant, time - input_time), time);
         } else {
           // Grab the value at this time
           QVariant value = input->get_value_at_time(input_time);
-          hash->addData(NodeParam::ValueToBytes(input->data_type(), value));
+          node_hash.AddData(NodeParam::ValueToBytes(input->data_type(), value));
+
+          if (input->is_keyframing()) {
+            is_static = false;
+
+            IntersectConstantSpan(constant,
+                                  OffsetConstantSpan(input->get_constant_range_at_time(input_time), time - input_time),
+                                  time);
+          }
         }
 
         // We have one exception for FOOTAGE types, since we resolve the footage into a frame in the renderer
         if (input->data_type() == NodeParam::kFootage) {
           StreamPtr stream = ResolveStreamFromInput(input);
-          DecoderPtr decoder = ResolveDecoderFromInput(input);
+          DecoderPtr decoder = AcquireDecoderFromInput(input, time);
 
           if (decoder != nullptr) {
             // Add footage details to hash
 
-            // Footage filename
-            hash->addData(stream->footage()->filename().toUtf8());
+            // Footage file, as it was when it was last probed
+            node_hash.AddValue(stream->footage()->content_id());
 
-            // Footage last modified date
-            hash->addData(stream->footage()->timestamp().toString().toUtf8());
+            // File the frame is actually decoded from, which differs if a proxy is being used
+            node_hash.AddValue(decoder->stream()->footage()->content_id());
 
             // Footage stream
-            hash->addData(QString::number(stream->index()).toUtf8());
+            node_hash.AddValue(stream->index());
 
             // Footage timestamp
-            hash->addData(QString::number(decoder->GetTimestampFromTime(time)).toUtf8());
+            node_hash.AddValue(decoder->GetTimestampFromTime(time));
+
+            // Any other time gives another frame, unless it's a still
+            if (!decoder->IsStill()) {
+              constant->set_range(time, time);
+            }
+
+            ReleaseDecoder(decoder);
 
             // FIXME: Add colorspace and alpha assoc
+          } else {
+            constant->set_range(time, time);
           }
+
+          is_static = false;
         }
       }
     }
   }
+
+  QByteArray node_result = node_hash.Result();
+
+  if (is_static) {
+    static_hashes_.insert(n, node_result);
+  }
+
+  hash->AddData(node_result);
+
+  return is_static && !is_track;
 }
 
 void VideoRenderWorker::SetParameters(const VideoRenderingParams &video_params)
 {
   video_params_ = video_params;
+  tile_ = QRect(0, 0, video_params_.effective_width(), video_params_.effective_height());
+
+  // Anything already rendered is the wrong size or format now
+  ClearStaticValues();
 
   ParametersChangedEvent();
 }
 
+void VideoRenderWorker::GraphChangedEvent()
+{
+  static_hashes_.clear();
+  constant_spans_.clear();
+}
+
 bool VideoRenderWorker::InitInternal()
 {
   download_buffer_.resize(PixelService::GetBufferSize(video_params().format(), video_params().effective_width(), video_params().effective_height()));
@@ -126,45 +548,57 @@ bool VideoRenderWorker::InitInternal()
 void VideoRenderWorker::CloseInternal()
 {
   download_buffer_.clear();
+  tile_buffer_.clear();
 }
 
-void VideoRenderWorker::Download(NodeDependency dep, QByteArray hash, QVariant texture, QString filename)
+void VideoRenderWorker::Download(NodeDependency dep, QByteArray hash, QVariant texture)
 {
-  working_++;
-
-  PixelFormatInfo format_info = PixelService::GetPixelFormatInfo(video_params().format());
+  Tracer::Scope trace("download", "Download");
 
-  // Set up OIIO::ImageSpec for compressing cached images on disk
-  OIIO::ImageSpec spec(video_params().effective_width(), video_params().effective_height(), kRGBAChannels, format_info.oiio_desc);
-  spec.attribute("compression", "dwaa:200");
+  working_++;
 
   TextureToBuffer(texture, download_buffer_);
 
-  std::string working_fn_std = filename.toStdString();
-
-  std::unique_ptr<OIIO::ImageOutput> out = OIIO::ImageOutput::create(working_fn_std);
+  SaveFrameToCache(dep, hash, download_buffer_);
 
-  if (out) {
-    out->open(working_fn_std, spec);
-    out->write_image(format_info.oiio_desc, download_buffer_.data());
-    out->close();
+  working_--;
+}
 
-    emit CompletedDownload(dep, hash);
+void VideoRenderWorker::SaveFrameToCache(const NodeDependency &dep,
+                                         const QByteArray &hash,
+                                         const QByteArray &buffer,
+                                         const QByteArray &compressed)
+{
+  // Keep the frame in memory so the viewer doesn't have to read it back from disk. This is a shallow copy, the
+  // download buffer will detach the next time it's written to.
+  if (compressed.isEmpty()) {
+    frame_cache_->AddToMemory(hash, buffer);
   } else {
-    qWarning() << "Failed to open output file:" << filename;
+    frame_cache_->AddToMemory(hash, compressed, true);
   }
 
-  working_--;
+  frame_writer_->Write(dep, hash, frame_cache_->DestinationOf(hash), buffer, video_params(), frame_cache_->codec());
+}
+
+bool VideoRenderWorker::CompressesMemoryFrames() const
+{
+  return frame_cache_->memory_compression();
 }
 
 NodeValueTable VideoRenderWorker::RenderBlock(TrackOutput *track, const TimeRange &range)
 {
+  NodeValueTable table;
+
+  // A muted track is transparent, nothing on it is evaluated
+  if (TrackOutput::IsSkipped(track->TrackChain(), track, range.in())) {
+    return table;
+  }
+
   // A frame can only have one active block so we just validate the in point of the range
   Block* active_block = track->BlockAtTime(range.in());
 
-  NodeValueTable table;
-
-  if (active_block) {
+  // Gaps are transparent, which is an empty table, so there's nothing to evaluate
+  if (active_block && active_block->type() != Block::kGap) {
     table = RenderAsSibling(NodeDependency(active_block,
                                            range));
   }
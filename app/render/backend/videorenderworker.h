@@ -1,31 +1,51 @@
 #ifndef VIDEORENDERWORKER_H
 #define VIDEORENDERWORKER_H
 
-#include <QCryptographicHash>
+#include <QHash>
+#include <QMap>
+#include <QRect>
 
+#include "framehasher.h"
 #include "node/dependency.h"
 #include "render/videoparams.h"
 #include "renderworker.h"
 #include "videorenderframecache.h"
+#include "videorenderframewriter.h"
 
 class VideoRenderWorker : public RenderWorker {
   Q_OBJECT
 public:
-  VideoRenderWorker(DecoderCache* decoder_cache, VideoRenderFrameCache* frame_cache, QObject* parent = nullptr);
+  VideoRenderWorker(DecoderCache* decoder_cache,
+                    VideoRenderFrameCache* frame_cache,
+                    VideoRenderFrameWriter* frame_writer,
+                    QObject* parent = nullptr);
 
   void SetParameters(const VideoRenderingParams& video_params);
 
-public slots:
-  void Download(NodeDependency dep, QByteArray hash, QVariant texture, QString filename);
-
-signals:
-  void CompletedFrame(NodeDependency path, QByteArray hash, NodeValueTable value);
-
-  void CompletedDownload(NodeDependency path, QByteArray hash);
+  /**
+   * @brief Set the largest tile (in pixels along either side) that frames are split into when rendering
+   *
+   * 0 (the default) only splits frames bigger than MaximumTextureSize(). Smaller tiles need less GPU memory for the
+   * textures in between nodes, at the cost of running the graph more times per frame.
+   */
+  void SetTileSize(int size);
+
+  /**
+   * @brief Get the time spent decoding, the number of frames decoded and the Decoder::DecodePath flags they were
+   * decoded with since this was last called
+   *
+   * Safe to call from any thread.
+   */
+  void TakeDecodeTime(qint64* usecs, int* frames, int* paths);
 
-  void HashAlreadyBeingCached();
-
-  void HashAlreadyExists(NodeDependency path, QByteArray hash);
+public slots:
+  /**
+   * @brief Download a rendered texture and save it to the disk cache
+   *
+   * The default implementation downloads synchronously with TextureToBuffer(). Derivatives may override this to
+   * download asynchronously, as long as they eventually call SaveFrameToCache().
+   */
+  virtual void Download(NodeDependency dep, QByteArray hash, QVariant texture);
 
 protected:
   virtual bool InitInternal() override;
@@ -34,27 +54,186 @@ protected:
 
   const VideoRenderingParams& video_params();
 
+  /**
+   * @brief The part of the frame being rendered in pixels, which is the whole frame unless it's rendered in tiles
+   *
+   * Textures rendered into are the size of the tile and their texture coordinates only cover the tile.
+   * ParametersChangedEvent() is called whenever it changes.
+   */
+  const QRect& tile() const;
+
+  /**
+   * @brief The largest texture this worker can render into along either side, or 0 if it can't render in tiles
+   *
+   * Frames bigger than this (or than SetTileSize()) are rendered in tiles. The default implementation returns 0.
+   */
+  virtual int MaximumTextureSize() const;
+
+  /**
+   * @brief Other workers render whole frames, so branches aren't forked while rendering a tile
+   */
+  virtual bool CanForkSiblings() const override;
+
   virtual void ParametersChangedEvent(){}
 
+  /**
+   * @brief Called after RenderInternal() has finished issuing all the work for a frame, before its result is pushed
+   */
+  virtual void FrameFinishedEvent(){}
+
+  /**
+   * @brief Queue a downloaded frame to be written to the disk cache
+   *
+   * The frame is encoded on one of the VideoRenderFrameWriter's threads, so this returns as soon as it's queued.
+   * `buffer` must contain a frame of video_params() effective size and format. If `compressed` isn't empty, it's the
+   * same frame block-compressed and it's kept in memory in place of `buffer` (see CompressesMemoryFrames()).
+   */
+  void SaveFrameToCache(const NodeDependency& dep,
+                        const QByteArray& hash,
+                        const QByteArray& buffer,
+                        const QByteArray& compressed = QByteArray());
+
+  /**
+   * @brief Returns whether frames should be block-compressed for the memory cache when they're downloaded
+   */
+  bool CompressesMemoryFrames() const;
+
   virtual void TextureToBuffer(const QVariant& texture, QByteArray& buffer) = 0;
 
-  virtual NodeValueTable RenderInternal(const NodeDependency& path) override;
+  /**
+   * @brief Draw a constant (see NodeValue::ConstantTexture()) into a texture of the render's size
+   *
+   * Only used where a real texture is required, e.g. when a frame is nothing but a constant.
+   */
+  virtual QVariant CreateConstantTexture(const QVector4D& color) = 0;
+
+  /**
+   * @brief Render the frame unless one with the same hash is already cached or being cached
+   *
+   * Pushes a RenderResult::kCompletedFrame, kCompletedTiles, kHashAlreadyExists or kHashAlreadyBeingCached.
+   */
+  virtual void RenderJob(const NodeDependency& path) override;
+
+  /**
+   * @brief Decode the footage's proxy instead of the original for preview (olive::kOffline) renders
+   *
+   * Online renders (e.g. exports) always decode the original.
+   */
+  virtual StreamPtr ResolveDecodeStream(StreamPtr stream) override;
 
   virtual FramePtr RetrieveFromDecoder(DecoderPtr decoder, const TimeRange& range) override;
 
+  /**
+   * @brief Decode the next frames of video footage while this one renders, one for each job queued behind it (up to
+   * kPrefetchFrames)
+   *
+   * Jobs that follow on from each other go to the same worker, so they usually need the footage's next frames.
+   */
+  virtual int PrefetchFrameCount(StreamPtr stream, rational* interval, int* divider) override;
+
   virtual NodeValueTable RenderBlock(TrackOutput *track, const TimeRange& range) override;
 
+  /**
+   * @brief Use the nested sequence's frame from the frame cache if it's there, otherwise render it and keep it
+   *
+   * Frames are looked up by the same hash the nested sequence's own viewer caches them with, in memory first and then
+   * on disk. Frames rendered here are only kept in the memory cache, since the disk cache's time map belongs to the
+   * sequence this worker is rendering. Tiles are always rendered as normal.
+   */
+  virtual NodeValueTable ProcessCachedInput(Node* connected, const TimeRange& range) override;
+
+  virtual void GraphChangedEvent() override;
+
 private:
   void ProcessNode();
 
-  void HashNodeRecursively(QCryptographicHash* hash, Node *n, const rational &time);
+  /**
+   * @brief Add the hash of a Node and everything it depends on at a given time
+   *
+   * @param constant
+   *
+   * Set to the times around `time` (in `n`'s time) that the hash is known to be the same at, e.g. because everything
+   * under it is held or a still image. The out point is exclusive, a range that starts and ends at `time` only covers
+   * `time`.
+   *
+   * @return True if the hash would be the same at any time (i.e. nothing it depends on is keyframed or comes from
+   * footage), in which case it's memoized in static_hashes_ and won't be traversed again.
+   */
+  bool HashNodeRecursively(FrameHasher* hash, Node *n, const rational &time, TimeRange* constant);
+
+  /**
+   * @brief Get the hash of the frame `n` renders at `time`, reusing the hash of a constant span it falls in
+   */
+  QByteArray HashFrame(Node* n, const rational& time);
+
+  /**
+   * @brief The size frames are split into tiles of, or 0 if they aren't
+   */
+  int TileSize() const;
+
+  /**
+   * @brief Render a frame tile by tile and stitch the tiles into download_buffer_ before queueing it for the cache
+   *
+   * Tiles are rendered kTileHalo pixels bigger on each side they meet another, so nodes that sample around each pixel
+   * see the same pixels they would in the whole frame. Only the inside of each tile is kept.
+   *
+   * Pushes a RenderResult::kCompletedTiles, or kCompletedFrame with no value if the frame is empty.
+   */
+  void RenderTiles(const NodeDependency& path, const QByteArray& hash, int tile_size);
+
+  /**
+   * @brief Divider to decode a frame of `stream` at for the current parameters
+   */
+  int DecodeDivider(StreamPtr stream);
+
+  static const int kPrefetchFrames = 2;
+
+  /**
+   * @brief Pixels each tile overlaps its neighbors by
+   */
+  static const int kTileHalo = 8;
 
   VideoRenderingParams video_params_;
 
+  QRect tile_;
+
+  int tile_size_;
+
+  /**
+   * @brief Each tile is read back into this before being copied into its place in download_buffer_
+   */
+  QByteArray tile_buffer_;
+
   VideoRenderFrameCache* frame_cache_;
 
+  VideoRenderFrameWriter* frame_writer_;
+
   QByteArray download_buffer_;
 
+  /**
+   * @brief Hashes of Nodes that don't change over time, cleared whenever the graph changes
+   */
+  QHash<Node*, QByteArray> static_hashes_;
+
+  struct ConstantSpan {
+    rational out;
+    QByteArray hash;
+  };
+
+  /**
+   * @brief Spans of time each output node renders the same frame over, mapped by their in point
+   *
+   * Every frame in a span (e.g. a title, a still or a freeze frame) has the hash of the first one hashed, without
+   * traversing the graph again. Cleared whenever the graph changes.
+   */
+  QHash<Node*, QMap<rational, ConstantSpan> > constant_spans_;
+
+  QAtomicInteger<qint64> decode_usecs_;
+
+  QAtomicInt decode_frames_;
+
+  QAtomicInt decode_paths_;
+
 private slots:
 
 };
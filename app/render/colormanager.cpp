@@ -1,11 +1,43 @@
 #include "colormanager.h"
 
 #include <QFloat16>
+#include <QRunnable>
+#include <QThreadPool>
 
 #include "common/define.h"
+#include "common/tracer.h"
 #include "config/config.h"
+#include "pixelkernels.h"
+
+namespace {
+
+/**
+ * @brief Parses the current OCIO config so whoever first needs it doesn't have to wait for the whole parse
+ *
+ * OCIO guards the current config with a lock of its own, anything that asks for it in the meantime waits for this
+ * parse rather than starting another.
+ */
+class LoadConfigTask : public QRunnable
+{
+public:
+  virtual void run() override
+  {
+    Tracer::Scope trace("startup", "OCIO::GetCurrentConfig");
+
+    try {
+      OCIO::GetCurrentConfig();
+    } catch (OCIO::Exception& e) {
+      // Whatever asks for it next will get the same error
+      qWarning() << "Failed to load OCIO config -" << e.what();
+    }
+  }
+};
+
+}
 
 ColorManager* ColorManager::instance_ = nullptr;
+QHash<QString, ColorProcessorPtr> ColorManager::processor_cache_;
+QMutex ColorManager::processor_lock_;
 
 void ColorManager::SetConfig(const QString &filename)
 {
@@ -16,6 +48,11 @@ void ColorManager::SetConfig(OCIO::ConstConfigRcPtr config)
 {
   OCIO::SetCurrentConfig(config);
 
+  // Keys include the config, so these would never be used again
+  processor_lock_.lock();
+  processor_cache_.clear();
+  processor_lock_.unlock();
+
   emit ConfigChanged();
 }
 
@@ -23,6 +60,9 @@ void ColorManager::CreateInstance()
 {
   if (instance_ == nullptr) {
     instance_ = new ColorManager();
+
+    // Nothing needs the config until the first viewer is shown, parse it while the rest of the application starts
+    QThreadPool::globalInstance()->start(new LoadConfigTask());
   }
 }
 
@@ -120,13 +160,75 @@ QStringList ColorManager::ListAvailableInputColorspaces(OpenColorIO::v1::ConstCo
   return spaces;
 }
 
+ColorProcessorPtr ColorManager::GetProcessor(const QString &source_space, const QString &dest_space)
+{
+  QString key = ProcessorKey(QStringList() << source_space << dest_space);
+  ColorProcessorPtr processor = FindProcessor(key);
+
+  if (!processor) {
+    // Created outside the lock so a slow config doesn't hold up every other lookup
+    processor = AddProcessor(key, ColorProcessor::Create(source_space, dest_space));
+  }
+
+  return processor;
+}
+
+ColorProcessorPtr ColorManager::GetProcessor(const QString &source_space,
+                                             const QString &display,
+                                             const QString &view,
+                                             const QString &look)
+{
+  QString key = ProcessorKey(QStringList() << source_space << display << view << look);
+  ColorProcessorPtr processor = FindProcessor(key);
+
+  if (!processor) {
+    processor = AddProcessor(key, ColorProcessor::Create(source_space, display, view, look));
+  }
+
+  return processor;
+}
+
 ColorManager::ColorManager()
 {
 }
 
+ColorProcessorPtr ColorManager::FindProcessor(const QString &key)
+{
+  processor_lock_.lock();
+
+  ColorProcessorPtr processor = processor_cache_.value(key);
+
+  processor_lock_.unlock();
+
+  return processor;
+}
+
+ColorProcessorPtr ColorManager::AddProcessor(const QString &key, ColorProcessorPtr processor)
+{
+  processor_lock_.lock();
+
+  QHash<QString, ColorProcessorPtr>::const_iterator existing = processor_cache_.constFind(key);
+
+  if (existing == processor_cache_.constEnd()) {
+    processor_cache_.insert(key, processor);
+  } else {
+    processor = existing.value();
+  }
+
+  processor_lock_.unlock();
+
+  return processor;
+}
+
+QString ColorManager::ProcessorKey(const QStringList &args)
+{
+  // Conversions to a display have more arguments than ones between two spaces, so the two can't collide
+  return (QStringList() << QString(OCIO::GetCurrentConfig()->getCacheID()) << args).join('\n');
+}
+
 void ColorManager::AssociateAlphaPixFmtFilter(ColorManager::AlphaAction action, FramePtr f)
 {
-  int pixel_count = f->width() * f->height() * kRGBAChannels;
+  int pixel_count = f->width() * f->height();
 
   switch (static_cast<olive::PixelFormat>(f->format())) {
   case olive::PIX_FMT_INVALID:
@@ -151,19 +253,17 @@ void ColorManager::AssociateAlphaPixFmtFilter(ColorManager::AlphaAction action,
 }
 
 template<typename T>
-void ColorManager::AssociateAlphaInternal(ColorManager::AlphaAction action, T *data, int pix_count)
-{
-  for (int i=0;i<pix_count;i+=kRGBAChannels) {
-    T alpha = data[i+kRGBChannels];
-
-    if (action == kAssociate || alpha > 0) {
-      for (int j=0;j<kRGBChannels;j++) {
-        if (action == kDisassociate) {
-          data[i+j] /= alpha;
-        } else {
-          data[i+j] *= alpha;
-        }
-      }
-    }
+void ColorManager::AssociateAlphaInternal(ColorManager::AlphaAction action, T *data, int pixel_count)
+{
+  switch (action) {
+  case kAssociate:
+    olive::kernels::AssociateAlpha(data, pixel_count);
+    break;
+  case kDisassociate:
+    olive::kernels::DisassociateAlpha(data, pixel_count);
+    break;
+  case kReassociate:
+    olive::kernels::ReassociateAlpha(data, pixel_count);
+    break;
   }
 }
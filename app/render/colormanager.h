@@ -2,6 +2,8 @@
 #define COLORSERVICE_H
 
 #include <memory>
+#include <QHash>
+#include <QMutex>
 
 #include "colorprocessor.h"
 #include "decoder/frame.h"
@@ -38,6 +40,24 @@ public:
 
   static QStringList ListAvailableInputColorspaces(OCIO::ConstConfigRcPtr config);
 
+  /**
+   * @brief Get a processor for converting between two color spaces of the current config
+   *
+   * Processors are cached for the whole process, keyed by the config and the arguments, so everything that converts
+   * the same way shares one processor along with the GPU data it bakes (see ColorProcessor::GetGpuData()).
+   *
+   * Thread-safe. Throws OCIO::Exception if the processor can't be created, failures aren't cached.
+   */
+  static ColorProcessorPtr GetProcessor(const QString& source_space, const QString& dest_space);
+
+  /**
+   * @brief Same as GetProcessor() for converting to a display (empty display and view are the config's defaults)
+   */
+  static ColorProcessorPtr GetProcessor(const QString& source_space,
+                                        const QString& display,
+                                        const QString& view,
+                                        const QString& look);
+
 signals:
   void ConfigChanged();
 
@@ -46,6 +66,22 @@ private:
 
   static ColorManager* instance_;
 
+  /**
+   * @brief Returns the cached processor for this key (prefixed with the current config's cache ID), or nullptr
+   */
+  static ColorProcessorPtr FindProcessor(const QString& key);
+
+  /**
+   * @brief Cache a processor, unless another thread cached one for this key first (returns whichever is cached)
+   */
+  static ColorProcessorPtr AddProcessor(const QString& key, ColorProcessorPtr processor);
+
+  static QString ProcessorKey(const QStringList& args);
+
+  static QHash<QString, ColorProcessorPtr> processor_cache_;
+
+  static QMutex processor_lock_;
+
   enum AlphaAction {
     kAssociate,
     kDisassociate,
@@ -55,7 +91,7 @@ private:
   static void AssociateAlphaPixFmtFilter(AlphaAction action, FramePtr f);
 
   template<typename T>
-  static void AssociateAlphaInternal(AlphaAction action, T* data, int pix_count);
+  static void AssociateAlphaInternal(AlphaAction action, T* data, int pixel_count);
 };
 
 #endif // COLORSERVICE_H
@@ -1,8 +1,63 @@
 #include "colorprocessor.h"
 
+#include <QRunnable>
+#include <QSemaphore>
+
 #include "common/define.h"
+#include "common/slicepool.h"
+
+namespace {
+
+/**
+ * @brief Bands smaller than this aren't worth the overhead of handing to another thread
+ */
+const int kMinimumBandHeight = 16;
+
+/**
+ * @brief Applies an OCIO processor to a band of rows
+ *
+ * OCIO processors are immutable once created, so any number of these can apply the same one at once.
+ */
+class ConvertBandTask : public QRunnable
+{
+public:
+  ConvertBandTask(OCIO::ConstProcessorRcPtr processor, float* data, int width, int height, QSemaphore* finished) :
+    processor_(processor),
+    data_(data),
+    width_(width),
+    height_(height),
+    finished_(finished)
+  {
+  }
+
+  virtual void run() override
+  {
+    OCIO::PackedImageDesc img(data_, width_, height_, kRGBAChannels);
+
+    processor_->apply(img);
+
+    if (finished_ != nullptr) {
+      finished_->release();
+    }
+  }
+
+private:
+  OCIO::ConstProcessorRcPtr processor_;
+
+  float* data_;
+
+  int width_;
+
+  int height_;
+
+  QSemaphore* finished_;
+
+};
+
+}
 
-ColorProcessor::ColorProcessor(const QString& source_space, const QString& dest_space)
+ColorProcessor::ColorProcessor(const QString& source_space, const QString& dest_space) :
+  gpu_data_baked_(false)
 {
   OCIO::ConstConfigRcPtr config = OCIO::GetCurrentConfig();
 
@@ -13,7 +68,8 @@ ColorProcessor::ColorProcessor(const QString& source_space, const QString& dest_
 ColorProcessor::ColorProcessor(const QString& source_space,
                                QString display,
                                QString view,
-                               const QString& look)
+                               const QString& look) :
+  gpu_data_baked_(false)
 {
   OCIO::ConstConfigRcPtr config = OCIO::GetCurrentConfig();
 
@@ -41,9 +97,64 @@ ColorProcessor::ColorProcessor(const QString& source_space,
 
 void ColorProcessor::ConvertFrame(FramePtr f)
 {
-  OCIO::PackedImageDesc img(reinterpret_cast<float*>(f->data()), f->width(), f->height(), kRGBAChannels);
+  float* data = reinterpret_cast<float*>(f->data());
+  int row_size = f->width() * kRGBAChannels;
+
+  int band_count = qMax(1, qMin(SlicePool::instance()->maxThreadCount(), f->height() / kMinimumBandHeight));
+  int band_height = (f->height() + band_count - 1) / band_count;
+
+  QSemaphore finished;
+  int started = 0;
+
+  // Hand every band except the first to the slice pool, the calling thread converts the first while it waits
+  for (int y=band_height;y<f->height();y+=band_height) {
+    ConvertBandTask* task = new ConvertBandTask(processor,
+                                                data + y * row_size,
+                                                f->width(),
+                                                qMin(band_height, f->height() - y),
+                                                &finished);
+
+    SlicePool::instance()->start(task);
+    started++;
+  }
+
+  ConvertBandTask first_band(processor, data, f->width(), qMin(band_height, f->height()), nullptr);
+  first_band.run();
+
+  finished.acquire(started);
+}
+
+const ColorProcessor::GpuData &ColorProcessor::GetGpuData()
+{
+  gpu_data_lock_.lock();
+
+  if (!gpu_data_baked_) {
+    OCIO::GpuShaderDesc shader_desc;
+    shader_desc.setLanguage(OCIO::GPU_LANGUAGE_GLSL_1_0);
+    shader_desc.setFunctionName("OCIODisplay");
+    shader_desc.setLut3DEdgeLen(kGpuLut3DEdgeSize);
+
+    gpu_data_.function_name = QStringLiteral("OCIODisplay");
+
+    gpu_data_.lut.resize(3 * kGpuLut3DEdgeSize * kGpuLut3DEdgeSize * kGpuLut3DEdgeSize);
+
+    try {
+      processor->getGpuLut3D(gpu_data_.lut.data(), shader_desc);
+
+      gpu_data_.shader_text = processor->getGpuShaderText(shader_desc);
+    } catch (OCIO::Exception&) {
+      // Leave it to the caller, it can be tried again
+      gpu_data_lock_.unlock();
+      throw;
+    }
+
+    gpu_data_baked_ = true;
+  }
+
+  gpu_data_lock_.unlock();
 
-  processor->apply(img);
+  // Never changes once baked
+  return gpu_data_;
 }
 
 ColorProcessorPtr ColorProcessor::Create(const QString& source_space, const QString& dest_space)
@@ -4,6 +4,9 @@
 #include <OpenColorIO/OpenColorIO.h>
 namespace OCIO = OCIO_NAMESPACE::v1;
 
+#include <QMutex>
+#include <QVector>
+
 #include "decoder/frame.h"
 
 class ColorProcessor;
@@ -28,11 +31,45 @@ public:
 
   OCIO::ConstProcessorRcPtr GetProcessor();
 
+  /**
+   * @brief Convert a 32-bit float RGBA frame in place
+   *
+   * The frame is split into bands of rows that are converted in parallel on the global thread pool.
+   */
   void ConvertFrame(FramePtr f);
 
+  /**
+   * @brief What a GPU needs to apply this processor: a 3D LUT and the GLSL that samples it
+   */
+  struct GpuData {
+    /// kGpuLut3DEdgeSize^3 RGB entries, ready to upload to a 3D texture
+    QVector<float> lut;
+
+    /// Defines `vec4 function_name(vec4 col, sampler3D lut)`
+    QString shader_text;
+
+    QString function_name;
+  };
+
+  static const int kGpuLut3DEdgeSize = 32;
+
+  /**
+   * @brief Get the GPU data for this processor, baking it the first time (thread-safe)
+   *
+   * Baking the LUT evaluates the whole transform at every entry, so it's only done once per processor. Every context
+   * that uses the processor then only has to upload the LUT to a texture of its own (see OpenGLShader::CreateOCIO()).
+   */
+  const GpuData& GetGpuData();
+
 private:
   OCIO::ConstProcessorRcPtr processor;
 
+  GpuData gpu_data_;
+
+  bool gpu_data_baked_;
+
+  QMutex gpu_data_lock_;
+
 };
 
 #endif // COLORPROCESSOR_H
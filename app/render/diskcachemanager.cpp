@@ -0,0 +1,572 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "diskcachemanager.h"
+
+#include <algorithm>
+#include <cstring>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QSet>
+#include <QVector>
+
+#include "common/filefunctions.h"
+
+DiskCacheManager* DiskCacheManager::instance_ = nullptr;
+
+const char DiskCacheManager::kJournalMagic[4] = {'O', 'D', 'C', 'J'};
+const quint32 DiskCacheManager::kJournalVersion = 1;
+const double DiskCacheManager::kEvictionTarget = 0.9;
+const double DiskCacheManager::kMaximumPinnedShare = 0.5;
+
+class DiskCacheManager::ScanTask : public QRunnable
+{
+public:
+  ScanTask(DiskCacheManager* parent) :
+    parent_(parent)
+  {
+  }
+
+  virtual void run() override
+  {
+    parent_->Scan();
+  }
+
+private:
+  DiskCacheManager* parent_;
+};
+
+class DiskCacheManager::EvictTask : public QRunnable
+{
+public:
+  EvictTask(DiskCacheManager* parent) :
+    parent_(parent)
+  {
+  }
+
+  virtual void run() override
+  {
+    parent_->Evict();
+  }
+
+private:
+  DiskCacheManager* parent_;
+};
+
+void DiskCacheManager::CreateInstance()
+{
+  if (instance_ == nullptr) {
+    instance_ = new DiskCacheManager();
+  }
+}
+
+DiskCacheManager *DiskCacheManager::instance()
+{
+  return instance_;
+}
+
+void DiskCacheManager::DestroyInstance()
+{
+  delete instance_;
+  instance_ = nullptr;
+}
+
+DiskCacheManager::DiskCacheManager() :
+  cache_location_(QDir::cleanPath(GetMediaCacheLocation())),
+  index_location_(QDir::cleanPath(GetMediaIndexLocation())),
+  total_size_(0),
+  quota_(0),
+  conform_size_(0),
+  conform_quota_(0),
+  eviction_queued_(false),
+  eviction_blocked_(false)
+{
+  // One thread, so scanning and evicting never run at the same time
+  pool_.setMaxThreadCount(1);
+
+  pool_.start(new ScanTask(this));
+}
+
+DiskCacheManager::~DiskCacheManager()
+{
+  // The journal would be missing everything a scan hasn't added yet
+  pool_.waitForDone();
+
+  SaveJournal();
+}
+
+void DiskCacheManager::SetQuota(qint64 bytes)
+{
+  lock_.lock();
+
+  quota_ = bytes;
+
+  eviction_blocked_ = false;
+  EvictIfNecessary();
+
+  lock_.unlock();
+}
+
+void DiskCacheManager::SetConformQuota(qint64 bytes)
+{
+  lock_.lock();
+
+  conform_quota_ = bytes;
+
+  eviction_blocked_ = false;
+  EvictIfNecessary();
+
+  lock_.unlock();
+}
+
+void DiskCacheManager::FileWritten(const QString &filename)
+{
+  QString key = QDir::cleanPath(filename);
+
+  if (!IsManaged(key)) {
+    return;
+  }
+
+  QFileInfo info(key);
+
+  if (!info.exists()) {
+    return;
+  }
+
+  Entry entry;
+  entry.size = info.size();
+  entry.last_access = QDateTime::currentMSecsSinceEpoch();
+  entry.conformed = IsConformedAudioFilename(key);
+
+  lock_.lock();
+
+  // A rewritten file replaces its old size
+  InsertEntry(key, entry);
+
+  EvictIfNecessary();
+
+  lock_.unlock();
+}
+
+void DiskCacheManager::FileAccessed(const QString &filename)
+{
+  QString key = QDir::cleanPath(filename);
+
+  lock_.lock();
+
+  QHash<QString, Entry>::iterator i = entries_.find(key);
+
+  // Files we don't know about yet will be picked up by the scan
+  if (i != entries_.end()) {
+    i->last_access = QDateTime::currentMSecsSinceEpoch();
+  }
+
+  lock_.unlock();
+}
+
+void DiskCacheManager::SetPinnedFiles(QObject *owner, const QStringList &filenames)
+{
+  // Many frames share a segment, so the same file is usually in the list many times
+  QStringList keys;
+  QSet<QString> listed;
+
+  foreach (const QString& filename, filenames) {
+    QString key = QDir::cleanPath(filename);
+
+    if (!listed.contains(key)) {
+      listed.insert(key);
+      keys.append(key);
+    }
+  }
+
+  lock_.lock();
+
+  ReleasePins(owner);
+
+  // Everyone else's pins count towards the limit too
+  qint64 pinned_size = 0;
+
+  for (QHash<QString, int>::const_iterator i=pinned_.constBegin();i!=pinned_.constEnd();i++) {
+    pinned_size += entries_.value(i.key()).size;
+  }
+
+  qint64 pin_limit = static_cast<qint64>(static_cast<double>(quota_) * kMaximumPinnedShare);
+
+  QStringList pinned_keys;
+
+  foreach (const QString& key, keys) {
+    QHash<QString, Entry>::const_iterator entry = entries_.constFind(key);
+
+    // Files we don't know about were never written, so there's nothing to keep
+    if (entry == entries_.constEnd()) {
+      continue;
+    }
+
+    if (quota_ > 0 && !pinned_.contains(key) && pinned_size + entry->size > pin_limit) {
+      break;
+    }
+
+    if (!pinned_.contains(key)) {
+      pinned_size += entry->size;
+    }
+
+    pinned_[key]++;
+    pinned_keys.append(key);
+  }
+
+  if (!pinned_keys.isEmpty()) {
+    pins_.insert(owner, pinned_keys);
+  }
+
+  lock_.unlock();
+
+  if (!pinned_keys.isEmpty()) {
+    connect(owner, SIGNAL(destroyed(QObject*)), this, SLOT(PinOwnerDestroyed(QObject*)),
+            static_cast<Qt::ConnectionType>(Qt::DirectConnection | Qt::UniqueConnection));
+  }
+}
+
+void DiskCacheManager::PinOwnerDestroyed(QObject *owner)
+{
+  lock_.lock();
+
+  ReleasePins(owner);
+
+  lock_.unlock();
+}
+
+void DiskCacheManager::ReleasePins(QObject *owner)
+{
+  QHash<QObject*, QStringList>::iterator pins = pins_.find(owner);
+
+  if (pins == pins_.end()) {
+    return;
+  }
+
+  foreach (const QString& key, pins.value()) {
+    QHash<QString, int>::iterator i = pinned_.find(key);
+
+    if (i != pinned_.end() && --i.value() == 0) {
+      pinned_.erase(i);
+    }
+  }
+
+  pins_.erase(pins);
+
+  // Those files can be evicted now
+  eviction_blocked_ = false;
+  EvictIfNecessary();
+}
+
+DiskCacheManager::FileUse::~FileUse()
+{
+  Release();
+}
+
+void DiskCacheManager::FileUse::Acquire(const QString &filename)
+{
+  Release();
+
+  DiskCacheManager* manager = DiskCacheManager::instance();
+
+  if (manager == nullptr) {
+    return;
+  }
+
+  filename_ = QDir::cleanPath(filename);
+
+  manager->lock_.lock();
+  manager->in_use_[filename_]++;
+  manager->lock_.unlock();
+}
+
+void DiskCacheManager::FileUse::Release()
+{
+  DiskCacheManager* manager = DiskCacheManager::instance();
+
+  if (filename_.isEmpty() || manager == nullptr) {
+    filename_.clear();
+    return;
+  }
+
+  manager->lock_.lock();
+
+  QHash<QString, int>::iterator i = manager->in_use_.find(filename_);
+
+  if (i != manager->in_use_.end() && --i.value() == 0) {
+    manager->in_use_.erase(i);
+
+    manager->eviction_blocked_ = false;
+  }
+
+  manager->lock_.unlock();
+
+  filename_.clear();
+}
+
+void DiskCacheManager::Scan()
+{
+  QHash<QString, qint64> access_times;
+  LoadJournal(&access_times);
+
+  QHash<QString, Entry> found;
+
+  QStringList locations = {cache_location_, index_location_};
+
+  foreach (const QString& location, locations) {
+    QDirIterator iterator(location, QDir::Files, QDirIterator::Subdirectories);
+
+    while (iterator.hasNext()) {
+      QString key = QDir::cleanPath(iterator.next());
+
+      if (!IsManaged(key)) {
+        continue;
+      }
+
+      Entry entry;
+      entry.size = iterator.fileInfo().size();
+
+      // Files from before the journal existed are ranked by when they were written
+      entry.last_access = access_times.value(key, iterator.fileInfo().lastModified().toMSecsSinceEpoch());
+      entry.conformed = IsConformedAudioFilename(key);
+
+      found.insert(key, entry);
+    }
+  }
+
+  lock_.lock();
+
+  // Anything reported while we were scanning is more up to date than what we found
+  for (QHash<QString, Entry>::const_iterator i=found.constBegin();i!=found.constEnd();i++) {
+    if (!entries_.contains(i.key())) {
+      InsertEntry(i.key(), i.value());
+    }
+  }
+
+  EvictIfNecessary();
+
+  lock_.unlock();
+}
+
+void DiskCacheManager::Evict()
+{
+  lock_.lock();
+
+  eviction_queued_ = false;
+
+  if (!IsOverQuota()) {
+    lock_.unlock();
+    return;
+  }
+
+  QStringList evicted;
+
+  // Conformed audio over its own quota goes first, which may be enough to bring everything under the main one too
+  if (conform_quota_ > 0 && conform_size_ > conform_quota_) {
+    EvictEntries(true,
+                 &conform_size_,
+                 static_cast<qint64>(static_cast<double>(conform_quota_) * kEvictionTarget),
+                 &evicted);
+  }
+
+  if (quota_ > 0 && total_size_ > quota_) {
+    EvictEntries(false,
+                 &total_size_,
+                 static_cast<qint64>(static_cast<double>(quota_) * kEvictionTarget),
+                 &evicted);
+  }
+
+  // Everything left is pinned or in use
+  if (evicted.isEmpty()) {
+    eviction_blocked_ = true;
+  }
+
+  lock_.unlock();
+
+  // Each cache regenerates whatever it finds missing. Files another process has open may not be removable on some
+  // platforms, those will be found again by the next session's scan.
+  foreach (const QString& filename, evicted) {
+    QFile::remove(filename);
+  }
+}
+
+void DiskCacheManager::InsertEntry(const QString &key, const Entry &entry)
+{
+  RemoveEntry(key);
+
+  entries_.insert(key, entry);
+  total_size_ += entry.size;
+
+  if (entry.conformed) {
+    conform_size_ += entry.size;
+  }
+}
+
+void DiskCacheManager::RemoveEntry(const QString &key)
+{
+  QHash<QString, Entry>::iterator i = entries_.find(key);
+
+  if (i == entries_.end()) {
+    return;
+  }
+
+  total_size_ -= i->size;
+
+  if (i->conformed) {
+    conform_size_ -= i->size;
+  }
+
+  entries_.erase(i);
+}
+
+void DiskCacheManager::EvictEntries(bool conformed_only, qint64 *size, qint64 target, QStringList *evicted)
+{
+  QVector< QPair<qint64, QString> > by_last_access;
+  by_last_access.reserve(entries_.size());
+
+  for (QHash<QString, Entry>::const_iterator i=entries_.constBegin();i!=entries_.constEnd();i++) {
+    if ((!conformed_only || i.value().conformed) && !pinned_.contains(i.key()) && !in_use_.contains(i.key())) {
+      by_last_access.append(qMakePair(i.value().last_access, i.key()));
+    }
+  }
+
+  std::sort(by_last_access.begin(), by_last_access.end());
+
+  // `size` is one of the totals, which RemoveEntry() keeps up to date
+  for (int i=0;i<by_last_access.size() && *size > target;i++) {
+    const QString& filename = by_last_access.at(i).second;
+
+    RemoveEntry(filename);
+    evicted->append(filename);
+  }
+}
+
+bool DiskCacheManager::IsOverQuota() const
+{
+  return (quota_ > 0 && total_size_ > quota_) || (conform_quota_ > 0 && conform_size_ > conform_quota_);
+}
+
+void DiskCacheManager::EvictIfNecessary()
+{
+  if (!eviction_queued_ && !eviction_blocked_ && IsOverQuota()) {
+    eviction_queued_ = true;
+
+    pool_.start(new EvictTask(this));
+  }
+}
+
+bool DiskCacheManager::IsManaged(const QString &filename) const
+{
+  // Frame segments' indexes and locks go with their segments (see FrameSegmentStore)
+  if (filename.endsWith(QStringLiteral(".idx")) || filename.endsWith(QStringLiteral(".lock"))) {
+    return false;
+  }
+
+  if (filename.startsWith(cache_location_ + QLatin1Char('/'))) {
+    return true;
+  }
+
+  if (!filename.startsWith(index_location_ + QLatin1Char('/'))) {
+    return false;
+  }
+
+  QString relative = filename.mid(index_location_.size() + 1);
+
+  return !relative.startsWith(QStringLiteral("proxies/"))
+      && relative != QStringLiteral("probecache")
+      && relative != QStringLiteral("diskcache");
+}
+
+QString DiskCacheManager::GetJournalFilename() const
+{
+  return QDir(index_location_).filePath(QStringLiteral("diskcache"));
+}
+
+void DiskCacheManager::LoadJournal(QHash<QString, qint64> *access_times)
+{
+  QFile file(GetJournalFilename());
+
+  if (!file.open(QFile::ReadOnly)) {
+    return;
+  }
+
+  QDataStream ds(&file);
+  ds.setVersion(QDataStream::Qt_5_0);
+
+  char magic[4];
+  quint32 version;
+
+  if (ds.readRawData(magic, sizeof(magic)) != sizeof(magic)
+      || memcmp(magic, kJournalMagic, sizeof(magic)) != 0) {
+    qWarning() << "Ignoring invalid disk cache journal";
+    return;
+  }
+
+  ds >> version;
+
+  if (version != kJournalVersion) {
+    return;
+  }
+
+  ds >> *access_times;
+
+  if (ds.status() != QDataStream::Ok) {
+    qWarning() << "Ignoring unreadable disk cache journal";
+    access_times->clear();
+  }
+}
+
+void DiskCacheManager::SaveJournal()
+{
+  QHash<QString, qint64> access_times;
+
+  lock_.lock();
+
+  for (QHash<QString, Entry>::const_iterator i=entries_.constBegin();i!=entries_.constEnd();i++) {
+    access_times.insert(i.key(), i.value().last_access);
+  }
+
+  lock_.unlock();
+
+  QSaveFile file(GetJournalFilename());
+
+  if (!file.open(QFile::WriteOnly)) {
+    qWarning() << "Failed to open disk cache journal" << file.fileName() << "for writing";
+    return;
+  }
+
+  QDataStream ds(&file);
+  ds.setVersion(QDataStream::Qt_5_0);
+
+  ds.writeRawData(kJournalMagic, sizeof(kJournalMagic));
+  ds << kJournalVersion;
+  ds << access_times;
+
+  if (!file.commit()) {
+    qWarning() << "Failed to save disk cache journal" << file.fileName();
+  }
+}
@@ -0,0 +1,272 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef DISKCACHEMANAGER_H
+#define DISKCACHEMANAGER_H
+
+#include <QHash>
+#include <QMutex>
+#include <QStringList>
+#include <QThreadPool>
+
+#include "common/constructors.h"
+
+/**
+ * @brief Keeps the media cache and media index folders within a disk quota
+ *
+ * Rendered frames, indexes, conformed audio, waveform summaries and thumbnails are all kept between sessions so they
+ * never need generating twice, which means without limits they'd grow forever. This singleton tracks the size and
+ * last use of every file in those folders, and once they add up to more than the quota, deletes the least recently
+ * used files until they're comfortably under it again. Anything deleted is simply regenerated next time it's needed.
+ *
+ * Code that writes or reads these files reports it with FileWritten() and FileAccessed(). Last use times are kept in
+ * a journal in the media index folder rather than in file timestamps, since some caches use their files' modified
+ * time to detect changes and access times often aren't updated by the filesystem.
+ *
+ * Proxies (see ProxyTask) and the probe cache are never evicted, they're expensive to regenerate and the user asked
+ * for the former explicitly.
+ *
+ * Conformed audio (see GetConformedAudioFilename()) also has a quota of its own, so footage conformed to many sample
+ * rates can't push rendered frames out of the cache.
+ */
+class DiskCacheManager : public QObject
+{
+  Q_OBJECT
+public:
+  static void CreateInstance();
+
+  static DiskCacheManager* instance();
+
+  static void DestroyInstance();
+
+  /**
+   * @brief Set the most bytes the cache folders may use (0 for unlimited), evicting files straight away if necessary
+   */
+  void SetQuota(qint64 bytes);
+
+  /**
+   * @brief Set the most bytes conformed audio may use out of the quota (0 for no limit of its own)
+   */
+  void SetConformQuota(qint64 bytes);
+
+  /**
+   * @brief Let the manager know a cache file has been written (or rewritten)
+   *
+   * Thread-safe.
+   */
+  void FileWritten(const QString& filename);
+
+  /**
+   * @brief Let the manager know a cache file has been used, making it the last to be evicted
+   *
+   * Thread-safe and cheap, so it can be called on every read.
+   */
+  void FileAccessed(const QString& filename);
+
+  /**
+   * @brief Keep these files from being evicted, replacing whatever was pinned for `owner` before
+   *
+   * For rendered frames that must stay available (e.g. a range pre-rendered for realtime playback, see PreRenderTask).
+   * Pins last until they're replaced, released with an empty list or `owner` is destroyed (e.g. the sequence is
+   * closed). Pinned files still count towards the quota and other files are evicted to make room, so at most
+   * kMaximumPinnedShare of it is pinned. Files are pinned in the order they're listed until that's reached, the rest
+   * can be evicted as normal. Thread-safe.
+   */
+  void SetPinnedFiles(QObject* owner, const QStringList& filenames);
+
+  /**
+   * @brief Keeps one cache file from being evicted for as long as it's held, e.g. while it's open or mapped
+   *
+   * Deleting a file that's still mapped loses anything written to it afterwards, and fails on some platforms.
+   * Releases the file when destroyed, which is safe after DestroyInstance().
+   */
+  class FileUse
+  {
+  public:
+    FileUse() = default;
+
+    ~FileUse();
+
+    DISABLE_COPY_MOVE(FileUse)
+
+    /**
+     * @brief Start holding `filename`, releasing whatever file was held before
+     */
+    void Acquire(const QString& filename);
+
+    void Release();
+
+  private:
+    QString filename_;
+
+  };
+
+private:
+  DiskCacheManager();
+
+  virtual ~DiskCacheManager() override;
+
+  struct Entry {
+    qint64 size;
+    qint64 last_access;
+    bool conformed;
+  };
+
+  /**
+   * @brief Add an entry for `key` (replacing any there was), keeping the totals up to date (lock_ must be held)
+   */
+  void InsertEntry(const QString& key, const Entry& entry);
+
+  /**
+   * @brief Remove the entry for `key`, keeping the totals up to date (lock_ must be held)
+   */
+  void RemoveEntry(const QString& key);
+
+  /**
+   * @brief Stop pinning what `owner` pinned (lock_ must be held)
+   */
+  void ReleasePins(QObject* owner);
+
+  /**
+   * @brief Remove the least recently used entries (only conformed audio ones if `conformed_only`) until `size` is at
+   * most `target`, adding their filenames to `evicted` (lock_ must be held)
+   */
+  void EvictEntries(bool conformed_only, qint64* size, qint64 target, QStringList* evicted);
+
+  /**
+   * @brief Builds the initial list of files on the pool, so startup isn't held up by walking the cache folders
+   */
+  class ScanTask;
+
+  /**
+   * @brief Runs Evict() on the pool
+   */
+  class EvictTask;
+
+  /**
+   * @brief Walk the cache folders and add every file that hasn't been reported since we started
+   */
+  void Scan();
+
+  /**
+   * @brief Delete the least recently used files until we're under kEvictionTarget of the quota
+   */
+  void Evict();
+
+  /**
+   * @brief Returns whether either quota is exceeded (lock_ must be held)
+   */
+  bool IsOverQuota() const;
+
+  /**
+   * @brief Queue an EvictTask if we're over a quota and one isn't already queued (lock_ must be held)
+   */
+  void EvictIfNecessary();
+
+  /**
+   * @brief Returns whether a file is one of the cache files we're responsible for
+   */
+  bool IsManaged(const QString& filename) const;
+
+  QString GetJournalFilename() const;
+
+  /**
+   * @brief Read last use times saved by a previous session
+   */
+  void LoadJournal(QHash<QString, qint64>* access_times);
+
+  void SaveJournal();
+
+  static DiskCacheManager* instance_;
+
+  static const char kJournalMagic[4];
+
+  static const quint32 kJournalVersion;
+
+  /**
+   * @brief Fraction of the quota eviction brings usage down to, so we don't evict again on the very next write
+   */
+  static const double kEvictionTarget;
+
+  /**
+   * @brief Most of the quota that can be pinned (see SetPinnedFiles()), so there's always something left to evict
+   */
+  static const double kMaximumPinnedShare;
+
+  /**
+   * @brief The folders we manage, kept here since looking them up creates them every time
+   */
+  QString cache_location_;
+  QString index_location_;
+
+  QThreadPool pool_;
+
+  QMutex lock_;
+
+  /**
+   * @brief Every managed file by absolute filename (protected by lock_)
+   */
+  QHash<QString, Entry> entries_;
+
+  /**
+   * @brief Files pinned by each owner with SetPinnedFiles() (protected by lock_)
+   */
+  QHash<QObject*, QStringList> pins_;
+
+  /**
+   * @brief Number of owners that have pinned each file (protected by lock_)
+   */
+  QHash<QString, int> pinned_;
+
+  /**
+   * @brief Number of FileUses holding each file (protected by lock_)
+   */
+  QHash<QString, int> in_use_;
+
+  qint64 total_size_;
+
+  qint64 quota_;
+
+  /**
+   * @brief Bytes of conformed audio, which are included in total_size_ too
+   */
+  qint64 conform_size_;
+
+  qint64 conform_quota_;
+
+  bool eviction_queued_;
+
+  /**
+   * @brief Set when an eviction couldn't free anything because every file was pinned or in use
+   *
+   * Eviction isn't queued again until a pin or use is released or a quota changes, otherwise every write would sort
+   * every entry again for nothing.
+   */
+  bool eviction_blocked_;
+
+private slots:
+  /**
+   * @brief Release an owner's pins once it's destroyed
+   */
+  void PinOwnerDestroyed(QObject* owner);
+
+};
+
+#endif // DISKCACHEMANAGER_H
@@ -0,0 +1,545 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "encoder.h"
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+#include <QCoreApplication>
+
+#include "render/pixelservice.h"
+
+Encoder::Encoder() :
+  fmt_ctx_(nullptr),
+  video_codec_ctx_(nullptr),
+  video_stream_(nullptr),
+  video_frame_(nullptr),
+  scale_ctx_(nullptr),
+  video_pts_(0),
+  passthrough_time_base_({0, 1}),
+  audio_codec_ctx_(nullptr),
+  audio_stream_(nullptr),
+  audio_frame_(nullptr),
+  resample_ctx_(nullptr),
+  audio_fifo_(nullptr),
+  audio_frame_size_(0),
+  audio_pts_(0),
+  pkt_(nullptr)
+{
+}
+
+Encoder::~Encoder()
+{
+  Close();
+}
+
+bool Encoder::Open(const QString &filename,
+                   const VideoParams &video,
+                   const AudioRenderingParams &audio,
+                   const AVStream *copy_video_from)
+{
+  // Guesses the container from the extension
+  int error_code = avformat_alloc_output_context2(&fmt_ctx_, nullptr, nullptr, filename.toUtf8());
+
+  if (error_code < 0) {
+    FFmpegError(QCoreApplication::translate("Encoder", "Failed to find a format for this file"), error_code);
+    return false;
+  }
+
+  pkt_ = av_packet_alloc();
+
+  if (pkt_ == nullptr) {
+    error_ = QCoreApplication::translate("Encoder", "Failed to allocate resources for encoding");
+    return false;
+  }
+
+  if (copy_video_from != nullptr) {
+    if (!OpenVideoPassthrough(copy_video_from)) {
+      return false;
+    }
+  } else if (!OpenVideo(video)) {
+    return false;
+  }
+
+  // Formats without audio (e.g. image sequences) just get the video
+  if (audio.is_valid()
+      && fmt_ctx_->oformat->audio_codec != AV_CODEC_ID_NONE
+      && !OpenAudio(audio)) {
+    return false;
+  }
+
+  if (!(fmt_ctx_->oformat->flags & AVFMT_NOFILE)) {
+    error_code = avio_open(&fmt_ctx_->pb, filename.toUtf8(), AVIO_FLAG_WRITE);
+
+    if (error_code < 0) {
+      FFmpegError(QCoreApplication::translate("Encoder", "Failed to create file"), error_code);
+      return false;
+    }
+  }
+
+  // The muxer may change the streams' timebases here, packets are rescaled to them in WriteFrame()
+  error_code = avformat_write_header(fmt_ctx_, nullptr);
+
+  if (error_code < 0) {
+    FFmpegError(QCoreApplication::translate("Encoder", "Failed to write header"), error_code);
+    return false;
+  }
+
+  return true;
+}
+
+bool Encoder::WriteVideo(FramePtr frame)
+{
+  // swscale doesn't take float formats
+  if (frame->format() != olive::PIX_FMT_RGBA8 && frame->format() != olive::PIX_FMT_RGBA16U) {
+    frame = PixelService::ConvertPixelFormat(frame, olive::PIX_FMT_RGBA16U);
+  }
+
+  scale_ctx_ = sws_getCachedContext(scale_ctx_,
+                                    frame->width(),
+                                    frame->height(),
+                                    (frame->format() == olive::PIX_FMT_RGBA8) ? AV_PIX_FMT_RGBA : AV_PIX_FMT_RGBA64,
+                                    video_frame_->width,
+                                    video_frame_->height,
+                                    video_codec_ctx_->pix_fmt,
+                                    SWS_BICUBIC,
+                                    nullptr,
+                                    nullptr,
+                                    nullptr);
+
+  if (scale_ctx_ == nullptr) {
+    error_ = QCoreApplication::translate("Encoder", "Failed to create pixel format conversion context");
+    return false;
+  }
+
+  // The encoder may still be holding on to the last frame's buffer
+  int error_code = av_frame_make_writable(video_frame_);
+
+  if (error_code < 0) {
+    FFmpegError(QCoreApplication::translate("Encoder", "Failed to allocate resources for encoding"), error_code);
+    return false;
+  }
+
+  const uint8_t* src_data = reinterpret_cast<const uint8_t*>(frame->const_data());
+  int src_linesize = frame->width() * PixelService::BytesPerPixel(frame->format());
+
+  sws_scale(scale_ctx_,
+            &src_data,
+            &src_linesize,
+            0,
+            frame->height(),
+            video_frame_->data,
+            video_frame_->linesize);
+
+  video_frame_->pts = video_pts_;
+  video_pts_++;
+
+  return WriteFrame(video_codec_ctx_, video_stream_, video_frame_);
+}
+
+bool Encoder::WriteVideoPacket(AVPacket *pkt)
+{
+  av_packet_rescale_ts(pkt, passthrough_time_base_, video_stream_->time_base);
+  pkt->stream_index = video_stream_->index;
+
+  // Position in the source file means nothing in this one
+  pkt->pos = -1;
+
+  // Takes ownership of the packet's data
+  int error_code = av_interleaved_write_frame(fmt_ctx_, pkt);
+
+  if (error_code < 0) {
+    FFmpegError(QCoreApplication::translate("Encoder", "Failed to write frame"), error_code);
+    return false;
+  }
+
+  return true;
+}
+
+bool Encoder::WriteAudio(const char *samples, int sample_count)
+{
+  if (audio_codec_ctx_ == nullptr || sample_count <= 0) {
+    return true;
+  }
+
+  uint8_t** converted = nullptr;
+
+  int error_code = av_samples_alloc_array_and_samples(&converted,
+                                                      nullptr,
+                                                      audio_codec_ctx_->channels,
+                                                      sample_count,
+                                                      audio_codec_ctx_->sample_fmt,
+                                                      0);
+
+  if (error_code < 0) {
+    FFmpegError(QCoreApplication::translate("Encoder", "Failed to allocate resources for encoding"), error_code);
+    return false;
+  }
+
+  const uint8_t* in = reinterpret_cast<const uint8_t*>(samples);
+
+  // Only the sample format changes, so there are never more samples out than in
+  int converted_count = swr_convert(resample_ctx_, converted, sample_count, &in, sample_count);
+
+  if (converted_count < 0) {
+    FFmpegError(QCoreApplication::translate("Encoder", "Failed to convert audio"), converted_count);
+  } else {
+    av_audio_fifo_write(audio_fifo_, reinterpret_cast<void**>(converted), converted_count);
+  }
+
+  av_freep(&converted[0]);
+  av_freep(&converted);
+
+  return (converted_count >= 0 && EncodeAudioFifo(false));
+}
+
+bool Encoder::Finish()
+{
+  // Copied video has no encoder to flush
+  if (video_codec_ctx_ != nullptr && !WriteFrame(video_codec_ctx_, video_stream_, nullptr)) {
+    return false;
+  }
+
+  if (audio_codec_ctx_ != nullptr
+      && (!EncodeAudioFifo(true) || !WriteFrame(audio_codec_ctx_, audio_stream_, nullptr))) {
+    return false;
+  }
+
+  int error_code = av_write_trailer(fmt_ctx_);
+
+  if (error_code < 0) {
+    FFmpegError(QCoreApplication::translate("Encoder", "Failed to finish file"), error_code);
+    return false;
+  }
+
+  return true;
+}
+
+void Encoder::Close()
+{
+  sws_freeContext(scale_ctx_);
+  scale_ctx_ = nullptr;
+
+  swr_free(&resample_ctx_);
+
+  if (audio_fifo_ != nullptr) {
+    av_audio_fifo_free(audio_fifo_);
+    audio_fifo_ = nullptr;
+  }
+
+  av_frame_free(&video_frame_);
+  av_frame_free(&audio_frame_);
+  av_packet_free(&pkt_);
+  avcodec_free_context(&video_codec_ctx_);
+  avcodec_free_context(&audio_codec_ctx_);
+
+  if (fmt_ctx_ != nullptr) {
+    if (!(fmt_ctx_->oformat->flags & AVFMT_NOFILE)) {
+      avio_closep(&fmt_ctx_->pb);
+    }
+
+    avformat_free_context(fmt_ctx_);
+    fmt_ctx_ = nullptr;
+  }
+
+  // Freed along with the format context
+  video_stream_ = nullptr;
+  audio_stream_ = nullptr;
+
+  video_pts_ = 0;
+  audio_pts_ = 0;
+
+  passthrough_time_base_ = {0, 1};
+}
+
+bool Encoder::HasAudio() const
+{
+  return (audio_codec_ctx_ != nullptr);
+}
+
+const QString &Encoder::GetError() const
+{
+  return error_;
+}
+
+bool Encoder::AddStream(AVCodecID codec_id, AVCodec **codec, AVCodecContext **codec_ctx, AVStream **stream)
+{
+  *codec = avcodec_find_encoder(codec_id);
+
+  if (*codec == nullptr) {
+    error_ = QCoreApplication::translate("Encoder", "This build of FFmpeg doesn't have a %1 encoder").arg(avcodec_get_name(codec_id));
+    return false;
+  }
+
+  *stream = avformat_new_stream(fmt_ctx_, nullptr);
+  *codec_ctx = avcodec_alloc_context3(*codec);
+
+  if (*stream == nullptr || *codec_ctx == nullptr) {
+    error_ = QCoreApplication::translate("Encoder", "Failed to allocate resources for encoding");
+    return false;
+  }
+
+  if (fmt_ctx_->oformat->flags & AVFMT_GLOBALHEADER) {
+    (*codec_ctx)->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+  }
+
+  return true;
+}
+
+bool Encoder::OpenVideo(const VideoParams &params)
+{
+  if (fmt_ctx_->oformat->video_codec == AV_CODEC_ID_NONE) {
+    error_ = QCoreApplication::translate("Encoder", "This format doesn't support video");
+    return false;
+  }
+
+  AVCodec* codec;
+
+  if (!AddStream(fmt_ctx_->oformat->video_codec, &codec, &video_codec_ctx_, &video_stream_)) {
+    return false;
+  }
+
+  // Most players only handle 4:2:0, so it's used whenever the codec supports it
+  AVPixelFormat pix_fmt = AV_PIX_FMT_YUV420P;
+
+  if (codec->pix_fmts != nullptr) {
+    const AVPixelFormat* i = codec->pix_fmts;
+
+    while (*i != AV_PIX_FMT_NONE && *i != AV_PIX_FMT_YUV420P) {
+      i++;
+    }
+
+    if (*i == AV_PIX_FMT_NONE) {
+      pix_fmt = avcodec_find_best_pix_fmt_of_list(codec->pix_fmts, AV_PIX_FMT_RGBA64, 0, nullptr);
+    }
+  }
+
+  // Subsampled chroma needs sizes that are a multiple of the subsampling
+  const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pix_fmt);
+  int width_mask = ~((1 << desc->log2_chroma_w) - 1);
+  int height_mask = ~((1 << desc->log2_chroma_h) - 1);
+
+  video_codec_ctx_->width = qMax(2, params.width() & width_mask);
+  video_codec_ctx_->height = qMax(2, params.height() & height_mask);
+  video_codec_ctx_->sample_aspect_ratio = {1, 1};
+  video_codec_ctx_->pix_fmt = pix_fmt;
+  video_codec_ctx_->time_base = params.time_base().toAVRational();
+  video_codec_ctx_->framerate = params.time_base().flipped().toAVRational();
+
+  // swscale converts with BT.601 unless told otherwise
+  video_codec_ctx_->colorspace = AVCOL_SPC_SMPTE170M;
+  video_codec_ctx_->color_range = AVCOL_RANGE_MPEG;
+
+  int error_code = avcodec_open2(video_codec_ctx_, codec, nullptr);
+
+  if (error_code < 0) {
+    FFmpegError(QCoreApplication::translate("Encoder", "Failed to open video encoder"), error_code);
+    return false;
+  }
+
+  avcodec_parameters_from_context(video_stream_->codecpar, video_codec_ctx_);
+  video_stream_->time_base = video_codec_ctx_->time_base;
+
+  video_frame_ = av_frame_alloc();
+
+  if (video_frame_ == nullptr) {
+    error_ = QCoreApplication::translate("Encoder", "Failed to allocate resources for encoding");
+    return false;
+  }
+
+  video_frame_->format = pix_fmt;
+  video_frame_->width = video_codec_ctx_->width;
+  video_frame_->height = video_codec_ctx_->height;
+
+  error_code = av_frame_get_buffer(video_frame_, 0);
+
+  if (error_code < 0) {
+    FFmpegError(QCoreApplication::translate("Encoder", "Failed to allocate resources for encoding"), error_code);
+    return false;
+  }
+
+  return true;
+}
+
+bool Encoder::OpenVideoPassthrough(const AVStream *source)
+{
+  if (avformat_query_codec(fmt_ctx_->oformat, source->codecpar->codec_id, FF_COMPLIANCE_NORMAL) != 1) {
+    error_ = QCoreApplication::translate("Encoder", "This format doesn't support %1 video").arg(avcodec_get_name(source->codecpar->codec_id));
+    return false;
+  }
+
+  video_stream_ = avformat_new_stream(fmt_ctx_, nullptr);
+
+  if (video_stream_ == nullptr) {
+    error_ = QCoreApplication::translate("Encoder", "Failed to allocate resources for encoding");
+    return false;
+  }
+
+  int error_code = avcodec_parameters_copy(video_stream_->codecpar, source->codecpar);
+
+  if (error_code < 0) {
+    FFmpegError(QCoreApplication::translate("Encoder", "Failed to allocate resources for encoding"), error_code);
+    return false;
+  }
+
+  // The source container's tag for this codec may not mean the same thing in this one, the muxer picks its own
+  video_stream_->codecpar->codec_tag = 0;
+
+  video_stream_->time_base = source->time_base;
+  video_stream_->avg_frame_rate = source->avg_frame_rate;
+  video_stream_->sample_aspect_ratio = source->sample_aspect_ratio;
+
+  passthrough_time_base_ = source->time_base;
+
+  return true;
+}
+
+bool Encoder::OpenAudio(const AudioRenderingParams &params)
+{
+  AVCodec* codec;
+
+  if (!AddStream(fmt_ctx_->oformat->audio_codec, &codec, &audio_codec_ctx_, &audio_stream_)) {
+    return false;
+  }
+
+  AVSampleFormat sample_fmt = (codec->sample_fmts != nullptr) ? codec->sample_fmts[0] : AV_SAMPLE_FMT_FLTP;
+
+  audio_codec_ctx_->sample_fmt = sample_fmt;
+  audio_codec_ctx_->sample_rate = params.sample_rate();
+  audio_codec_ctx_->channel_layout = params.channel_layout();
+  audio_codec_ctx_->channels = params.channel_count();
+  audio_codec_ctx_->time_base = {1, params.sample_rate()};
+
+  int error_code = avcodec_open2(audio_codec_ctx_, codec, nullptr);
+
+  if (error_code < 0) {
+    FFmpegError(QCoreApplication::translate("Encoder", "Failed to open audio encoder"), error_code);
+    return false;
+  }
+
+  avcodec_parameters_from_context(audio_stream_->codecpar, audio_codec_ctx_);
+  audio_stream_->time_base = audio_codec_ctx_->time_base;
+
+  // Codecs that take any number of samples per frame (e.g. PCM) report a frame size of 0
+  audio_frame_size_ = (audio_codec_ctx_->frame_size > 0) ? audio_codec_ctx_->frame_size : 1024;
+
+  audio_frame_ = av_frame_alloc();
+
+  resample_ctx_ = swr_alloc_set_opts(nullptr,
+                                     static_cast<int64_t>(params.channel_layout()),
+                                     sample_fmt,
+                                     params.sample_rate(),
+                                     static_cast<int64_t>(params.channel_layout()),
+                                     AV_SAMPLE_FMT_FLT,
+                                     params.sample_rate(),
+                                     0,
+                                     nullptr);
+
+  audio_fifo_ = av_audio_fifo_alloc(sample_fmt, params.channel_count(), audio_frame_size_);
+
+  if (audio_frame_ == nullptr || resample_ctx_ == nullptr || audio_fifo_ == nullptr || swr_init(resample_ctx_) < 0) {
+    error_ = QCoreApplication::translate("Encoder", "Failed to allocate resources for encoding");
+    return false;
+  }
+
+  audio_frame_->format = sample_fmt;
+  audio_frame_->channel_layout = params.channel_layout();
+  audio_frame_->channels = params.channel_count();
+  audio_frame_->sample_rate = params.sample_rate();
+  audio_frame_->nb_samples = audio_frame_size_;
+
+  error_code = av_frame_get_buffer(audio_frame_, 0);
+
+  if (error_code < 0) {
+    FFmpegError(QCoreApplication::translate("Encoder", "Failed to allocate resources for encoding"), error_code);
+    return false;
+  }
+
+  return true;
+}
+
+bool Encoder::EncodeAudioFifo(bool flush)
+{
+  int available;
+
+  while ((available = av_audio_fifo_size(audio_fifo_)) >= audio_frame_size_ || (flush && available > 0)) {
+    int error_code = av_frame_make_writable(audio_frame_);
+
+    if (error_code < 0) {
+      FFmpegError(QCoreApplication::translate("Encoder", "Failed to allocate resources for encoding"), error_code);
+      return false;
+    }
+
+    // Only the very last frame may be shorter than the codec's frame size
+    audio_frame_->nb_samples = qMin(available, audio_frame_size_);
+
+    av_audio_fifo_read(audio_fifo_, reinterpret_cast<void**>(audio_frame_->data), audio_frame_->nb_samples);
+
+    audio_frame_->pts = audio_pts_;
+    audio_pts_ += audio_frame_->nb_samples;
+
+    if (!WriteFrame(audio_codec_ctx_, audio_stream_, audio_frame_)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool Encoder::WriteFrame(AVCodecContext *codec_ctx, AVStream *stream, AVFrame *frame)
+{
+  int error_code = avcodec_send_frame(codec_ctx, frame);
+
+  if (error_code < 0) {
+    FFmpegError(QCoreApplication::translate("Encoder", "Failed to encode frame"), error_code);
+    return false;
+  }
+
+  while ((error_code = avcodec_receive_packet(codec_ctx, pkt_)) >= 0) {
+    av_packet_rescale_ts(pkt_, codec_ctx->time_base, stream->time_base);
+    pkt_->stream_index = stream->index;
+
+    // Takes ownership of the packet's data
+    error_code = av_interleaved_write_frame(fmt_ctx_, pkt_);
+
+    if (error_code < 0) {
+      FFmpegError(QCoreApplication::translate("Encoder", "Failed to write frame"), error_code);
+      return false;
+    }
+  }
+
+  // The encoder wanting more frames (or having been flushed completely) isn't an error
+  if (error_code != AVERROR(EAGAIN) && error_code != AVERROR_EOF) {
+    FFmpegError(QCoreApplication::translate("Encoder", "Failed to encode frame"), error_code);
+    return false;
+  }
+
+  return true;
+}
+
+void Encoder::FFmpegError(const QString &message, int error_code)
+{
+  char err[1024];
+  av_strerror(error_code, err, 1024);
+
+  error_ = QStringLiteral("%1: %2").arg(message, err);
+}
@@ -0,0 +1,155 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef ENCODER_H
+#define ENCODER_H
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/audio_fifo.h>
+#include <libswresample/swresample.h>
+#include <libswscale/swscale.h>
+}
+
+#include "common/constructors.h"
+#include "decoder/frame.h"
+#include "render/audioparams.h"
+#include "render/videoparams.h"
+
+/**
+ * @brief Encodes rendered frames and samples into a media file with FFmpeg
+ *
+ * The container is picked from the filename's extension and each stream uses that container's default codec (e.g.
+ * H.264 and AAC for .mp4). The video can also be copied from another file's stream without being encoded again.
+ */
+class Encoder
+{
+public:
+  Encoder();
+
+  ~Encoder();
+
+  DISABLE_COPY_MOVE(Encoder)
+
+  /**
+   * @brief Set up the muxer and encoders to write to `filename`
+   *
+   * @param audio
+   *
+   * Format of the samples passed to WriteAudio(), which must be SAMPLE_FMT_FLT. If invalid, the file has no audio.
+   *
+   * @param copy_video_from
+   *
+   * If set, the video isn't encoded. The video stream takes this stream's codec parameters instead and its packets are
+   * passed straight to WriteVideoPacket().
+   *
+   * Close() must be called afterwards, whether this succeeded or not.
+   */
+  bool Open(const QString& filename,
+            const VideoParams& video,
+            const AudioRenderingParams& audio,
+            const AVStream* copy_video_from = nullptr);
+
+  /**
+   * @brief Encode the next frame of video
+   *
+   * `frame` is converted to the encoder's size and pixel format, it may be in any RGBA format.
+   */
+  bool WriteVideo(FramePtr frame);
+
+  /**
+   * @brief Write the next packet of the stream given to Open() as `copy_video_from`
+   *
+   * The packet's timestamps must be in that stream's timebase. Takes ownership of its data.
+   */
+  bool WriteVideoPacket(AVPacket* pkt);
+
+  /**
+   * @brief Encode the next `sample_count` samples of interleaved audio in the format given to Open()
+   */
+  bool WriteAudio(const char* samples, int sample_count);
+
+  /**
+   * @brief Flush the encoders and finish the file
+   */
+  bool Finish();
+
+  void Close();
+
+  /**
+   * @brief Returns whether the file has an audio stream
+   */
+  bool HasAudio() const;
+
+  const QString& GetError() const;
+
+private:
+  /**
+   * @brief Allocate a codec context and stream for the default codec of this type in the container
+   */
+  bool AddStream(AVCodecID codec_id, AVCodec** codec, AVCodecContext** codec_ctx, AVStream** stream);
+
+  bool OpenVideo(const VideoParams& params);
+
+  bool OpenVideoPassthrough(const AVStream* source);
+
+  bool OpenAudio(const AudioRenderingParams& params);
+
+  /**
+   * @brief Encode whole frames of audio from audio_fifo_, or everything left in it if `flush` is TRUE
+   */
+  bool EncodeAudioFifo(bool flush);
+
+  /**
+   * @brief Encode a frame (or flush the encoder if `frame` is nullptr) and write any packets it produces
+   */
+  bool WriteFrame(AVCodecContext* codec_ctx, AVStream* stream, AVFrame* frame);
+
+  void FFmpegError(const QString& message, int error_code);
+
+  AVFormatContext* fmt_ctx_;
+
+  AVCodecContext* video_codec_ctx_;
+  AVStream* video_stream_;
+  AVFrame* video_frame_;
+  SwsContext* scale_ctx_;
+  int64_t video_pts_;
+
+  /**
+   * @brief Timebase of the packets passed to WriteVideoPacket()
+   */
+  AVRational passthrough_time_base_;
+
+  AVCodecContext* audio_codec_ctx_;
+  AVStream* audio_stream_;
+  AVFrame* audio_frame_;
+  SwrContext* resample_ctx_;
+  AVAudioFifo* audio_fifo_;
+  int audio_frame_size_;
+  int64_t audio_pts_;
+
+  AVPacket* pkt_;
+
+  QString error_;
+
+};
+
+#endif // ENCODER_H
@@ -0,0 +1,239 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "encodethread.h"
+
+#include <QCoreApplication>
+
+#include "common/tracer.h"
+#include "render/backend/videorenderframeloader.h"
+#include "render/pixelservice.h"
+
+EncodeThread::EncodeThread(Encoder *encoder,
+                           ColorProcessorPtr color_processor,
+                           const VideoRenderingParams &params,
+                           VideoRenderFrameCache *cache,
+                           const AudioRenderingParams &audio_params,
+                           QObject *parent) :
+  QThread(parent),
+  encoder_(encoder),
+  color_processor_(color_processor),
+  params_(params),
+  cache_(cache),
+  codec_(cache->codec()),
+  audio_params_(audio_params),
+  queued_frames_(0),
+  cancelled_(false)
+{
+}
+
+EncodeThread::~EncodeThread()
+{
+  Cancel();
+  wait();
+}
+
+void EncodeThread::QueueVideo(const QByteArray &pixels, const QByteArray &hash)
+{
+  Job job;
+  job.type = Job::kVideo;
+  job.data = pixels;
+  job.hash = hash;
+  job.packet = nullptr;
+
+  Queue(job);
+}
+
+void EncodeThread::QueueVideoPacket(AVPacket *pkt)
+{
+  Job job;
+  job.type = Job::kVideoPacket;
+  job.packet = pkt;
+
+  Queue(job);
+}
+
+void EncodeThread::QueueAudio(const QByteArray &samples)
+{
+  Job job;
+  job.type = Job::kAudio;
+  job.data = samples;
+  job.packet = nullptr;
+
+  Queue(job);
+}
+
+void EncodeThread::QueueFinish()
+{
+  Job job;
+  job.type = Job::kFinish;
+  job.packet = nullptr;
+
+  Queue(job);
+}
+
+void EncodeThread::Cancel()
+{
+  queue_lock_.lock();
+  cancelled_ = true;
+  ClearQueue();
+  queue_not_empty_.wakeAll();
+  queue_lock_.unlock();
+}
+
+int EncodeThread::QueuedFrames()
+{
+  queue_lock_.lock();
+  int count = queued_frames_;
+  queue_lock_.unlock();
+
+  return count;
+}
+
+const QString &EncodeThread::GetError() const
+{
+  return error_;
+}
+
+void EncodeThread::run()
+{
+  forever {
+    queue_lock_.lock();
+
+    while (queue_.isEmpty() && !cancelled_) {
+      queue_not_empty_.wait(&queue_lock_);
+    }
+
+    if (cancelled_) {
+      queue_lock_.unlock();
+      return;
+    }
+
+    Job job = queue_.dequeue();
+
+    queue_lock_.unlock();
+
+    switch (job.type) {
+    case Job::kVideo:
+      if (!EncodeVideo(job)) {
+        return;
+      }
+
+      queue_lock_.lock();
+      queued_frames_--;
+      queue_lock_.unlock();
+
+      emit FrameEncoded();
+      break;
+    case Job::kVideoPacket:
+    {
+      bool written = encoder_->WriteVideoPacket(job.packet);
+      av_packet_free(&job.packet);
+
+      if (!written) {
+        error_ = encoder_->GetError();
+        return;
+      }
+
+      queue_lock_.lock();
+      queued_frames_--;
+      queue_lock_.unlock();
+
+      emit FrameEncoded();
+      break;
+    }
+    case Job::kAudio:
+      if (!encoder_->WriteAudio(job.data.constData(), audio_params_.bytes_to_samples(job.data.size()))) {
+        error_ = encoder_->GetError();
+        return;
+      }
+      break;
+    case Job::kFinish:
+      if (!encoder_->Finish()) {
+        error_ = encoder_->GetError();
+      }
+      return;
+    }
+  }
+}
+
+void EncodeThread::Queue(const EncodeThread::Job &job)
+{
+  queue_lock_.lock();
+
+  queue_.enqueue(job);
+
+  if (job.type == Job::kVideo || job.type == Job::kVideoPacket) {
+    queued_frames_++;
+  }
+
+  queue_not_empty_.wakeOne();
+
+  queue_lock_.unlock();
+}
+
+void EncodeThread::ClearQueue()
+{
+  while (!queue_.isEmpty()) {
+    Job job = queue_.dequeue();
+    av_packet_free(&job.packet);
+  }
+
+  queued_frames_ = 0;
+}
+
+bool EncodeThread::EncodeVideo(const EncodeThread::Job &job)
+{
+  Tracer::Scope trace("encode", "EncodeVideo");
+
+  FramePtr frame = Frame::Create();
+  frame->set_width(params_.effective_width());
+  frame->set_height(params_.effective_height());
+  frame->set_format(params_.format());
+  frame->allocate();
+
+  QByteArray pixels = job.data;
+
+  if (pixels.isEmpty() && !job.hash.isEmpty()) {
+    pixels = VideoRenderFrameLoader::LoadFrame(cache_, job.hash, params_, codec_);
+
+    if (pixels.isEmpty()) {
+      error_ = QCoreApplication::translate("EncodeThread", "Failed to read a rendered frame from the disk cache");
+      return false;
+    }
+  }
+
+  if (pixels.size() == frame->allocated_size()) {
+    memcpy(frame->data(), pixels.constData(), static_cast<size_t>(pixels.size()));
+  } else {
+    // Nothing at this time (e.g. a gap)
+    memset(frame->data(), 0, static_cast<size_t>(frame->allocated_size()));
+  }
+
+  FramePtr display_frame = PixelService::ConvertPixelFormat(frame, olive::PIX_FMT_RGBA32F);
+  color_processor_->ConvertFrame(display_frame);
+
+  if (!encoder_->WriteVideo(display_frame)) {
+    error_ = encoder_->GetError();
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,168 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef ENCODETHREAD_H
+#define ENCODETHREAD_H
+
+#include <QMutex>
+#include <QQueue>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "encoder.h"
+#include "render/backend/videorenderframecache.h"
+#include "render/colorprocessor.h"
+
+/**
+ * @brief Feeds an Encoder from its own thread so rendering never waits on encoding
+ *
+ * Frames and audio are queued in the order they should be encoded. Reading frames back from the disk cache, color
+ * management, pixel format conversion and encoding all happen on this thread. The thread exits once QueueFinish()
+ * has been processed, or as soon as anything fails (see GetError()).
+ */
+class EncodeThread : public QThread
+{
+  Q_OBJECT
+public:
+  /**
+   * @brief EncodeThread Constructor
+   *
+   * @param params
+   *
+   * Size and format of the frames passed to QueueVideo().
+   *
+   * @param audio_params
+   *
+   * Format of the samples passed to QueueAudio().
+   */
+  EncodeThread(Encoder* encoder,
+               ColorProcessorPtr color_processor,
+               const VideoRenderingParams& params,
+               VideoRenderFrameCache* cache,
+               const AudioRenderingParams& audio_params,
+               QObject* parent = nullptr);
+
+  virtual ~EncodeThread() override;
+
+  /**
+   * @brief Queue the next frame
+   *
+   * @param pixels
+   *
+   * The frame's pixel data if it's in memory already.
+   *
+   * @param hash
+   *
+   * If `pixels` is empty, the hash to read the frame from the disk cache with. If both are empty, the frame is blank.
+   */
+  void QueueVideo(const QByteArray& pixels, const QByteArray& hash);
+
+  /**
+   * @brief Queue the next packet of copied video (see Encoder::WriteVideoPacket()), taking ownership of it
+   *
+   * Counts as a frame for QueuedFrames() and FrameEncoded().
+   */
+  void QueueVideoPacket(AVPacket* pkt);
+
+  /**
+   * @brief Queue interleaved samples to encode after the frames queued so far
+   */
+  void QueueAudio(const QByteArray& samples);
+
+  /**
+   * @brief Finish the file once everything queued has been encoded
+   */
+  void QueueFinish();
+
+  /**
+   * @brief Drop everything queued and exit once the current job is done
+   */
+  void Cancel();
+
+  /**
+   * @brief Number of frames queued that haven't been encoded yet (thread-safe)
+   */
+  int QueuedFrames();
+
+  /**
+   * @brief Why the thread stopped early, only valid once it's finished
+   */
+  const QString& GetError() const;
+
+signals:
+  /**
+   * @brief Emitted from this thread each time a frame has been encoded
+   */
+  void FrameEncoded();
+
+protected:
+  virtual void run() override;
+
+private:
+  struct Job {
+    enum Type {
+      kVideo,
+      kVideoPacket,
+      kAudio,
+      kFinish
+    };
+
+    Type type;
+    QByteArray data;
+    QByteArray hash;
+    AVPacket* packet;
+  };
+
+  void Queue(const Job& job);
+
+  /**
+   * @brief Drop everything queued, must be called with queue_lock_ held
+   */
+  void ClearQueue();
+
+  bool EncodeVideo(const Job& job);
+
+  Encoder* encoder_;
+
+  ColorProcessorPtr color_processor_;
+
+  VideoRenderingParams params_;
+
+  VideoRenderFrameCache* cache_;
+
+  VideoRenderFrameCache::Codec codec_;
+
+  AudioRenderingParams audio_params_;
+
+  QMutex queue_lock_;
+
+  QWaitCondition queue_not_empty_;
+
+  QQueue<Job> queue_;
+
+  int queued_frames_;
+
+  bool cancelled_;
+
+  QString error_;
+
+};
+
+#endif // ENCODETHREAD_H
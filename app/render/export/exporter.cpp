@@ -0,0 +1,947 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "exporter.h"
+
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+
+#include "config/config.h"
+#include "render/colormanager.h"
+
+/**
+ * @brief Most audio read from the cache and encoded at once
+ */
+static const qint64 kAudioChunkSize = 1048576;
+
+ExportVideoBackend::ExportVideoBackend(QObject *parent) :
+  OpenGLBackend(parent),
+  frame_count_(0),
+  next_frame_(0),
+  first_frame_(0),
+  range_in_(0),
+  range_out_(RATIONAL_MAX),
+  rendered_count_(0),
+  tracks_rendered_frames_(false),
+  pending_writes_(0)
+{
+}
+
+bool ExportVideoBackend::StartRender()
+{
+  return StartRender(0, RATIONAL_MAX);
+}
+
+bool ExportVideoBackend::StartRender(const rational &in, const rational &out)
+{
+  if (!Init()) {
+    return false;
+  }
+
+  connect(frame_writer(), SIGNAL(FrameWritten(NodeDependency, QByteArray)), this, SLOT(WriterWroteFrame()), Qt::UniqueConnection);
+
+  // Playing means frames are rendered straight away in order, rather than waiting for edits to settle
+  SetPlaybackSpeed(1);
+
+  // Every frame that starts in the range and before the end of the sequence
+  range_in_ = qMax(rational(0), in);
+  range_out_ = qMin(SequenceLength(), out);
+
+  first_frame_ = TimeToFrame(range_in_);
+
+  if (FrameToTime(first_frame_) < range_in_) {
+    first_frame_++;
+  }
+
+  int64_t end_frame = TimeToFrame(range_out_);
+
+  if (FrameToTime(end_frame) < range_out_) {
+    end_frame++;
+  }
+
+  frame_count_ = qMax(static_cast<int64_t>(0), end_frame - first_frame_);
+
+  next_frame_ = 0;
+  pending_writes_ = 0;
+  rendered_count_ = 0;
+
+  frame_hashes_.fill(QByteArray(), static_cast<int>(frame_count_));
+  frame_rendered_.fill(false, static_cast<int>(frame_count_));
+  rendered_frames_.clear();
+
+  if (frame_count_ > 0) {
+    InvalidateCache(FrameToTime(first_frame_), FrameToTime(first_frame_ + frame_count_ - 1));
+  }
+
+  return true;
+}
+
+int64_t ExportVideoBackend::frame_count() const
+{
+  return frame_count_;
+}
+
+int64_t ExportVideoBackend::rendered_count() const
+{
+  return rendered_count_;
+}
+
+bool ExportVideoBackend::IsFinished() const
+{
+  return rendered_count_ == frame_count_ && pending_writes_ == 0;
+}
+
+QByteArray ExportVideoBackend::FrameHash(int64_t index) const
+{
+  return frame_hashes_.at(static_cast<int>(index));
+}
+
+void ExportVideoBackend::InvalidateCache(const rational &start_range, const rational &end_range)
+{
+  rational start = qMax(start_range, range_in_);
+  rational end = qMin(end_range, range_out_);
+
+  if (end >= start) {
+    OpenGLBackend::InvalidateCache(start, end);
+  }
+}
+
+bool ExportVideoBackend::TakeNextFrame(QByteArray *pixels, QByteArray *hash)
+{
+  if (next_frame_ >= frame_count_
+      || !frame_rendered_.at(static_cast<int>(next_frame_))
+      || !GetRenderedFrame(static_cast<int>(next_frame_), pixels, hash)) {
+    return false;
+  }
+
+  next_frame_++;
+
+  return true;
+}
+
+void ExportVideoBackend::SetTracksRenderedFrames(bool e)
+{
+  tracks_rendered_frames_ = e;
+}
+
+bool ExportVideoBackend::TakeRenderedFrame(int64_t *frame, QByteArray *pixels, QByteArray *hash)
+{
+  for (int i=0;i<rendered_frames_.size();i++) {
+    int index = rendered_frames_.at(i);
+
+    if (GetRenderedFrame(index, pixels, hash)) {
+      rendered_frames_.removeAt(i);
+      *frame = index;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool ExportVideoBackend::GetRenderedFrame(int index, QByteArray *pixels, QByteArray *hash_out)
+{
+  const QByteArray& hash = frame_hashes_.at(index);
+
+  pixels->clear();
+  hash_out->clear();
+
+  if (!hash.isEmpty()) {
+    // Frames are put in memory as soon as they're downloaded, so there's usually no need to wait for them to be
+    // written to the disk cache
+    *pixels = frame_cache()->GetFromMemory(hash);
+
+    if (pixels->isEmpty()) {
+      if (!frame_cache()->HasHash(hash)) {
+        // Still being downloaded or written
+        return false;
+      }
+
+      *hash_out = hash;
+    }
+  }
+
+  return true;
+}
+
+const VideoRenderingParams &ExportVideoBackend::frame_params() const
+{
+  return params();
+}
+
+void ExportVideoBackend::JobFinishedEvent(const RenderResult &result)
+{
+  // OpenGLBackend goes first so the frame cache is already up to date
+  OpenGLBackend::JobFinishedEvent(result);
+
+  switch (result.type) {
+  case RenderResult::kCompletedFrame:
+    WorkerCompletedFrame(result.dep, result.hash, ValueHasTexture(result.value.Get(NodeParam::kTexture)));
+    break;
+  case RenderResult::kCompletedTiles:
+    WorkerCompletedFrame(result.dep, result.hash, true);
+    break;
+  case RenderResult::kHashAlreadyExists:
+    WorkerHashAlreadyExists(result.dep, result.hash);
+    break;
+  case RenderResult::kHashAlreadyBeingCached:
+    RequeueSkippedFrames();
+    break;
+  case RenderResult::kCompletedCache:
+  case RenderResult::kCancelled:
+    break;
+  }
+}
+
+bool ExportVideoBackend::CancelsStaleJobs() const
+{
+  return false;
+}
+
+void ExportVideoBackend::RequeueSkippedFrames()
+{
+  // A worker that finds another one already rendering the same hash (e.g. on a still image) skips its frame without
+  // saying which one it was. Once nothing else is left, those frames are queued again and will be found in the cache.
+  if (JobsInFlight() == 0 && pending_writes_ == 0 && GetStatistics().queued_frames == 0) {
+    for (int64_t i=next_frame_;i<frame_count_;i++) {
+      if (!frame_rendered_.at(static_cast<int>(i))) {
+        InvalidateCache(FrameToTime(first_frame_ + i), FrameToTime(first_frame_ + i));
+      }
+    }
+  }
+}
+
+int ExportVideoBackend::FrameIndex(const rational &time) const
+{
+  int64_t frame = TimeToFrame(time) - first_frame_;
+
+  if (frame < 0 || frame >= frame_count_) {
+    return -1;
+  }
+
+  return static_cast<int>(frame);
+}
+
+void ExportVideoBackend::FrameRendered(int index)
+{
+  if (frame_rendered_.at(index)) {
+    return;
+  }
+
+  frame_rendered_[index] = true;
+  rendered_count_++;
+
+  if (tracks_rendered_frames_) {
+    rendered_frames_.append(index);
+  }
+}
+
+void ExportVideoBackend::WorkerCompletedFrame(const NodeDependency &path, const QByteArray &hash, bool will_be_written)
+{
+  int index = FrameIndex(path.in());
+
+  if (index >= 0) {
+    FrameRendered(index);
+
+    // Frames with nothing in them (e.g. past the end of a clip) aren't written
+    if (will_be_written) {
+      frame_hashes_[index] = hash;
+      pending_writes_++;
+    } else {
+      frame_hashes_[index].clear();
+    }
+  }
+
+  RequeueSkippedFrames();
+
+  emit FramesRendered();
+}
+
+void ExportVideoBackend::WorkerHashAlreadyExists(const NodeDependency &path, const QByteArray &hash)
+{
+  int index = FrameIndex(path.in());
+
+  if (index >= 0) {
+    FrameRendered(index);
+    frame_hashes_[index] = hash;
+  }
+
+  RequeueSkippedFrames();
+
+  emit FramesRendered();
+}
+
+void ExportVideoBackend::WriterWroteFrame()
+{
+  if (pending_writes_ > 0) {
+    pending_writes_--;
+  }
+
+  RequeueSkippedFrames();
+
+  emit FramesRendered();
+}
+
+ExportAudioBackend::ExportAudioBackend(QObject *parent) :
+  AudioBackend(parent)
+{
+}
+
+bool ExportAudioBackend::StartCache()
+{
+  if (!Init()) {
+    return false;
+  }
+
+  InvalidateCache(0, SequenceLength());
+
+  return true;
+}
+
+qint64 ExportAudioBackend::Read(qint64 offset, char *buffer, qint64 length)
+{
+  return audio_cache()->Read(offset, buffer, length);
+}
+
+qint64 ExportAudioBackend::ValidBytesAt(qint64 offset)
+{
+  return audio_cache()->ValidBytesAt(offset);
+}
+
+qint64 ExportAudioBackend::size()
+{
+  return audio_cache()->size();
+}
+
+void ExportAudioBackend::JobFinishedEvent(const RenderResult &result)
+{
+  AudioBackend::JobFinishedEvent(result);
+
+  emit SegmentCached();
+}
+
+bool ExportAudioBackend::ReservesInteractiveWorker() const
+{
+  return false;
+}
+
+int ExportAudioBackend::SegmentsPerJob() const
+{
+  return kMixdownSegments;
+}
+
+Exporter::Exporter(ViewerOutput *viewer, const QStringList &filenames, QObject *parent) :
+  QObject(parent),
+  viewer_(viewer),
+  filenames_(filenames),
+  video_backend_(nullptr),
+  audio_backend_(nullptr),
+  passthrough_(nullptr),
+  image_start_frame_(0),
+  images_in_flight_(0),
+  images_written_(0),
+  running_(false),
+  audio_queued_(0),
+  frames_queued_(0),
+  frames_encoded_(0),
+  finish_queued_(false),
+  stop_queued_(false),
+  progress_(0)
+{
+}
+
+Exporter::~Exporter()
+{
+  Cancel();
+}
+
+bool Exporter::Run()
+{
+  if (!Start()) {
+    return false;
+  }
+
+  // Runs until the encoders have finished every file, or something failed
+  QEventLoop loop;
+  connect(this, SIGNAL(Finished()), &loop, SLOT(quit()));
+  loop.exec();
+
+  return error_.isEmpty();
+}
+
+bool Exporter::Start()
+{
+  if (running_) {
+    return false;
+  }
+
+  error_.clear();
+  audio_queued_ = 0;
+  frames_queued_ = 0;
+  frames_encoded_ = 0;
+  finish_queued_ = false;
+  stop_queued_ = false;
+  progress_ = 0;
+  images_in_flight_ = 0;
+  images_written_ = 0;
+
+  if (filenames_.isEmpty()) {
+    error_ = tr("No file to export to");
+    return false;
+  }
+
+  running_ = true;
+
+  // Same transform the viewer shows by default
+  QString display = ColorManager::GetDefaultDisplay();
+  color_processor_ = ColorManager::GetProcessor(OCIO::ROLE_SCENE_LINEAR,
+                                                display,
+                                                ColorManager::GetDefaultView(display),
+                                                QString());
+
+  QStringList encoded_filenames;
+  image_sequences_.clear();
+
+  foreach (const QString& filename, filenames_) {
+    if (IsImageSequence(filename)) {
+      image_sequences_.append(filename);
+    } else {
+      encoded_filenames.append(filename);
+    }
+  }
+
+  image_start_frame_ = Config::Current()["ImageSequenceStartFrame"].toLongLong();
+
+  audio_backend_ = new ExportAudioBackend();
+  audio_backend_->SetViewerNode(viewer_);
+
+  video_backend_ = new ExportVideoBackend();
+  video_backend_->SetViewerNode(viewer_);
+
+  // Full resolution, and from the original media rather than any proxies
+  video_backend_->SetParameters(VideoRenderingParams(viewer_->video_params(), olive::PIX_FMT_RGBA16F, olive::kOffline));
+
+  // Every frame of an image sequence is written as it's rendered, in any order
+  video_backend_->SetTracksRenderedFrames(!image_sequences_.isEmpty());
+
+  // Untouched video can be copied as it is, as long as there's only one file to copy it into
+  passthrough_ = new VideoPassthrough();
+
+  if (encoded_filenames.size() != 1
+      || !image_sequences_.isEmpty()
+      || !passthrough_->Open(viewer_, encoded_filenames.first())) {
+    delete passthrough_;
+    passthrough_ = nullptr;
+  }
+
+  foreach (const QString& filename, encoded_filenames) {
+    Output output;
+    output.filename = filename;
+    output.encoder = new Encoder();
+    output.thread = nullptr;
+    outputs_.append(output);
+
+    if (!output.encoder->Open(filename,
+                              viewer_->video_params(),
+                              audio_backend_->params(),
+                              (passthrough_ != nullptr) ? passthrough_->stream() : nullptr)) {
+      error_ = output.encoder->GetError();
+      break;
+    }
+  }
+
+  if (error_.isEmpty()) {
+    if (HasAudio() && !audio_backend_->StartCache()) {
+      error_ = tr("Failed to render audio: %1").arg(audio_backend_->GetError());
+    } else if (passthrough_ == nullptr && !video_backend_->StartRender()) {
+      error_ = tr("Failed to render video: %1").arg(video_backend_->GetError());
+    }
+  }
+
+  images_queued_.fill(false, static_cast<int>(video_backend_->frame_count()));
+
+  if (!error_.isEmpty()) {
+    Teardown();
+    return false;
+  }
+
+  for (int i=0;i<outputs_.size();i++) {
+    EncodeThread* thread = new EncodeThread(outputs_.at(i).encoder,
+                                            color_processor_,
+                                            video_backend_->frame_params(),
+                                            video_backend_->frame_cache(),
+                                            audio_backend_->params());
+
+    connect(thread, SIGNAL(FrameEncoded()), this, SLOT(FrameEncoded()));
+    connect(thread, SIGNAL(finished()), this, SLOT(EncodeThreadFinished()));
+
+    outputs_[i].thread = thread;
+    thread->start();
+  }
+
+  connect(video_backend_, SIGNAL(FramesRendered()), this, SLOT(FeedEncoder()));
+  connect(audio_backend_, SIGNAL(SegmentCached()), this, SLOT(FeedEncoder()));
+  connect(video_backend_->frame_writer(), SIGNAL(ImageWritten(QString, bool)), this, SLOT(ImageWritten(QString, bool)));
+
+  // Anything that's cached from an earlier render can go straight away
+  FeedEncoder();
+
+  // An empty sequence has nothing to write to an image sequence
+  StopIfFinished();
+
+  return true;
+}
+
+void Exporter::Cancel()
+{
+  if (running_) {
+    error_ = tr("Export was cancelled");
+    Stop();
+  }
+}
+
+bool Exporter::IsRunning() const
+{
+  return running_;
+}
+
+const QString &Exporter::GetError() const
+{
+  return error_;
+}
+
+const QStringList &Exporter::filenames() const
+{
+  return filenames_;
+}
+
+void Exporter::Teardown()
+{
+  foreach (const Output& output, outputs_) {
+    if (output.thread != nullptr) {
+      output.thread->Cancel();
+    }
+  }
+
+  foreach (const Output& output, outputs_) {
+    if (output.thread != nullptr) {
+      output.thread->wait();
+
+      if (error_.isEmpty()) {
+        error_ = output.thread->GetError();
+      }
+
+      delete output.thread;
+    }
+  }
+
+  foreach (const Output& output, outputs_) {
+    output.encoder->Close();
+    delete output.encoder;
+
+    // Don't leave a file behind that looks finished but isn't
+    if (!error_.isEmpty()) {
+      QFile::remove(output.filename);
+    }
+  }
+
+  outputs_.clear();
+
+  if (passthrough_ != nullptr) {
+    passthrough_->Close();
+    delete passthrough_;
+    passthrough_ = nullptr;
+  }
+
+  video_backend_->SetViewerNode(nullptr);
+  audio_backend_->SetViewerNode(nullptr);
+
+  delete video_backend_;
+  video_backend_ = nullptr;
+
+  delete audio_backend_;
+  audio_backend_ = nullptr;
+
+  // Deleting the backend waits for its writers, so every image that was queued has been written by now
+  if (!error_.isEmpty()) {
+    for (int i=0;i<images_queued_.size();i++) {
+      if (images_queued_.at(i)) {
+        foreach (const QString& pattern, image_sequences_) {
+          QFile::remove(ImageSequenceFilename(pattern, i + image_start_frame_));
+        }
+      }
+    }
+  }
+
+  images_queued_.clear();
+  color_processor_ = nullptr;
+
+  running_ = false;
+}
+
+void Exporter::Stop()
+{
+  stop_queued_ = false;
+
+  if (!running_) {
+    return;
+  }
+
+  Teardown();
+
+  emit Finished();
+}
+
+bool Exporter::HasAudio() const
+{
+  foreach (const Output& output, outputs_) {
+    if (output.encoder->HasAudio()) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+int Exporter::QueuedFrames()
+{
+  int queued = 0;
+
+  foreach (const Output& output, outputs_) {
+    queued = qMax(queued, output.thread->QueuedFrames());
+  }
+
+  return queued;
+}
+
+bool Exporter::QueueAudioUntil(qint64 bytes)
+{
+  if (!HasAudio()) {
+    return true;
+  }
+
+  const AudioRenderingParams& params = audio_backend_->params();
+  int bytes_per_sample = params.channel_count() * params.bytes_per_sample_per_channel();
+
+  bytes = qMin(bytes, audio_backend_->size());
+
+  while (audio_queued_ < bytes) {
+    // Also makes this the next segment to be cached if it hasn't been
+    qint64 available = audio_backend_->ValidBytesAt(audio_queued_);
+
+    qint64 length = qMin(qMin(bytes - audio_queued_, available), kAudioChunkSize);
+    length -= length % bytes_per_sample;
+
+    if (length <= 0) {
+      return false;
+    }
+
+    QByteArray samples;
+    samples.resize(static_cast<int>(length));
+
+    if (audio_backend_->Read(audio_queued_, samples.data(), length) != length) {
+      Fail(tr("Failed to read rendered audio"));
+      return false;
+    }
+
+    foreach (const Output& output, outputs_) {
+      if (output.encoder->HasAudio()) {
+        output.thread->QueueAudio(samples);
+      }
+    }
+
+    audio_queued_ += length;
+  }
+
+  return true;
+}
+
+qint64 Exporter::AudioBytesBeforeFrame(int64_t frame)
+{
+  return AudioBytesBeforeTime(rational(frame) * viewer_->video_params().time_base());
+}
+
+qint64 Exporter::AudioBytesBeforeTime(const rational &time)
+{
+  const AudioRenderingParams& params = audio_backend_->params();
+
+  return static_cast<qint64>(params.time_to_samples(time)) * params.channel_count() * params.bytes_per_sample_per_channel();
+}
+
+void Exporter::Fail(const QString &error)
+{
+  if (error_.isEmpty()) {
+    error_ = error;
+  }
+
+  QueueStop();
+}
+
+void Exporter::QueueStop()
+{
+  // Whatever called this may still be on the stack, so the threads and backends are only deleted once it's returned
+  if (running_ && !stop_queued_) {
+    stop_queued_ = true;
+    QMetaObject::invokeMethod(this, "Stop", Qt::QueuedConnection);
+  }
+}
+
+void Exporter::FeedEncoder()
+{
+  if (!running_ || !error_.isEmpty()) {
+    return;
+  }
+
+  FeedImages();
+
+  if (finish_queued_ || outputs_.isEmpty()) {
+    return;
+  }
+
+  if (passthrough_ != nullptr) {
+    FeedPassthrough();
+    return;
+  }
+
+  // Frames are only taken from the backend as the slowest encoder keeps up, the rest wait in the cache
+  while (frames_queued_ < video_backend_->frame_count() && QueuedFrames() < kMaxQueuedFrames) {
+    // The audio that plays before this frame goes first, so the muxer never has to hold on to much of either
+    if (!QueueAudioUntil(AudioBytesBeforeFrame(frames_queued_))) {
+      return;
+    }
+
+    QByteArray pixels;
+    QByteArray hash;
+
+    if (!video_backend_->TakeNextFrame(&pixels, &hash)) {
+      return;
+    }
+
+    foreach (const Output& output, outputs_) {
+      output.thread->QueueVideo(pixels, hash);
+    }
+
+    frames_queued_++;
+  }
+
+  if (frames_queued_ == video_backend_->frame_count() && QueueAudioUntil(audio_backend_->size())) {
+    foreach (const Output& output, outputs_) {
+      output.thread->QueueFinish();
+    }
+    finish_queued_ = true;
+  }
+}
+
+void Exporter::FeedImages()
+{
+  if (image_sequences_.isEmpty()) {
+    return;
+  }
+
+  int64_t frame;
+  QByteArray pixels;
+  QByteArray hash;
+
+  // There's no order to keep, so a frame can be written as soon as it's rendered
+  while (images_in_flight_ < kMaxQueuedImages && video_backend_->TakeRenderedFrame(&frame, &pixels, &hash)) {
+    images_queued_[static_cast<int>(frame)] = true;
+
+    foreach (const QString& pattern, image_sequences_) {
+      video_backend_->frame_writer()->WriteImage(ImageSequenceFilename(pattern, frame + image_start_frame_),
+                                                 pixels,
+                                                 hash,
+                                                 video_backend_->frame_cache(),
+                                                 video_backend_->frame_params(),
+                                                 color_processor_);
+
+      images_in_flight_++;
+    }
+  }
+}
+
+void Exporter::FeedPassthrough()
+{
+  // There's only ever one file when copying
+  EncodeThread* thread = outputs_.first().thread;
+
+  while (thread->QueuedFrames() < kMaxQueuedFrames) {
+    const AVPacket* pkt = passthrough_->PeekPacket();
+
+    if (pkt == nullptr) {
+      break;
+    }
+
+    // Audio is interleaved by decode time, the same way it is with rendered frames
+    if (!QueueAudioUntil(AudioBytesBeforeTime(passthrough_->PacketTime(pkt)))) {
+      return;
+    }
+
+    AVPacket* copied = passthrough_->TakePacket();
+
+    if (copied == nullptr) {
+      break;
+    }
+
+    thread->QueueVideoPacket(copied);
+
+    frames_queued_++;
+  }
+
+  if (!passthrough_->GetError().isEmpty()) {
+    Fail(passthrough_->GetError());
+    return;
+  }
+
+  if (passthrough_->PeekPacket() == nullptr && QueueAudioUntil(audio_backend_->size())) {
+    thread->QueueFinish();
+    finish_queued_ = true;
+  }
+}
+
+int64_t Exporter::TotalFrames() const
+{
+  if (passthrough_ != nullptr) {
+    return passthrough_->packet_count();
+  }
+
+  return video_backend_->frame_count();
+}
+
+void Exporter::FrameEncoded()
+{
+  // May still arrive after the export has stopped
+  if (!running_) {
+    return;
+  }
+
+  frames_encoded_++;
+
+  UpdateProgress();
+
+  FeedEncoder();
+}
+
+void Exporter::ImageWritten(const QString &filename, bool success)
+{
+  if (!running_) {
+    return;
+  }
+
+  images_in_flight_--;
+
+  if (!success) {
+    Fail(tr("Failed to write \"%1\"").arg(filename));
+    return;
+  }
+
+  images_written_++;
+  frames_encoded_++;
+
+  UpdateProgress();
+
+  FeedEncoder();
+
+  StopIfFinished();
+}
+
+void Exporter::UpdateProgress()
+{
+  int64_t total = TotalFrames() * (outputs_.size() + image_sequences_.size());
+
+  if (total > 0) {
+    int progress = static_cast<int>(100 * frames_encoded_ / total);
+
+    if (progress != progress_) {
+      progress_ = progress;
+      emit ProgressChanged(progress_);
+    }
+  }
+}
+
+void Exporter::StopIfFinished()
+{
+  if (images_written_ < TotalFrames() * image_sequences_.size()) {
+    return;
+  }
+
+  foreach (const Output& output, outputs_) {
+    if (!output.thread->isFinished()) {
+      return;
+    }
+  }
+
+  QueueStop();
+}
+
+bool Exporter::IsImageSequence(const QString &filename)
+{
+  QString suffix = QFileInfo(filename).suffix();
+
+  return suffix.compare(QStringLiteral("exr"), Qt::CaseInsensitive) == 0
+      || suffix.compare(QStringLiteral("dpx"), Qt::CaseInsensitive) == 0;
+}
+
+QString Exporter::ImageSequenceFilename(const QString &pattern, int64_t frame)
+{
+  int name_start = pattern.lastIndexOf('/') + 1;
+  int end = pattern.lastIndexOf('#');
+
+  QString filename = pattern;
+
+  if (end >= name_start) {
+    int start = end;
+
+    while (start > name_start && pattern.at(start - 1) == '#') {
+      start--;
+    }
+
+    int digits = end - start + 1;
+
+    filename.replace(start, digits, QStringLiteral("%1").arg(frame, digits, 10, QChar('0')));
+  } else {
+    int dot = pattern.lastIndexOf('.');
+
+    if (dot < name_start) {
+      dot = pattern.size();
+    }
+
+    filename.insert(dot, QStringLiteral(".%1").arg(frame, 4, 10, QChar('0')));
+  }
+
+  return filename;
+}
+
+void Exporter::EncodeThreadFinished()
+{
+  if (!running_) {
+    return;
+  }
+
+  foreach (const Output& output, outputs_) {
+    if (output.thread->isFinished() && !output.thread->GetError().isEmpty()) {
+      // One file failing stops the others too
+      Fail(output.thread->GetError());
+      return;
+    }
+  }
+
+  StopIfFinished();
+}
@@ -0,0 +1,540 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include <QStringList>
+#include <QVector>
+
+#include "encodethread.h"
+#include "render/backend/audio/audiobackend.h"
+#include "render/backend/opengl/openglbackend.h"
+#include "render/colorprocessor.h"
+#include "videopassthrough.h"
+
+/**
+ * @brief An OpenGLBackend that renders a whole sequence (or a range of it) and hands its frames over in order as they
+ * become available
+ *
+ * Frames are rendered by all the workers at once in whatever order they finish, exactly like the viewer's cache fill,
+ * and frames already in the cache aren't rendered again. TakeNextFrame() puts them back in order.
+ */
+class ExportVideoBackend : public OpenGLBackend
+{
+  Q_OBJECT
+public:
+  ExportVideoBackend(QObject* parent = nullptr);
+
+  /**
+   * @brief Start rendering every frame of the connected viewer
+   */
+  bool StartRender();
+
+  /**
+   * @brief Start rendering every frame that starts from `in` up to (but not including) `out`
+   *
+   * Frame indices (e.g. from TakeRenderedFrame()) count from the frame at `in`. Edits outside of the range don't queue
+   * anything.
+   */
+  bool StartRender(const rational& in, const rational& out);
+
+  /**
+   * @brief Number of frames in the sequence (or the range passed to StartRender())
+   */
+  int64_t frame_count() const;
+
+  /**
+   * @brief Number of frames that have been rendered or found in the cache so far
+   */
+  int64_t rendered_count() const;
+
+  /**
+   * @brief Returns whether every frame has been rendered and everything rendered has been written to the disk cache
+   */
+  bool IsFinished() const;
+
+  /**
+   * @brief Hash of a rendered frame, empty if it hasn't been rendered yet or rendered to nothing
+   */
+  QByteArray FrameHash(int64_t index) const;
+
+  /**
+   * @brief Take the next frame in order if it's been rendered
+   *
+   * @param pixels
+   *
+   * Set to the frame's pixel data if it's in the memory cache.
+   *
+   * @param hash
+   *
+   * Otherwise set to the hash to read it from the disk cache with. Both are left empty if the frame is blank (e.g. a
+   * gap).
+   *
+   * @return
+   *
+   * FALSE if the next frame isn't ready yet or every frame has been taken.
+   */
+  bool TakeNextFrame(QByteArray* pixels, QByteArray* hash);
+
+  /**
+   * @brief Set whether frames can be taken in the order they're rendered with TakeRenderedFrame() (FALSE by default)
+   *
+   * Must be set before StartRender().
+   */
+  void SetTracksRenderedFrames(bool e);
+
+  /**
+   * @brief Take any frame that's been rendered and not taken with this function yet, regardless of order
+   *
+   * Independent of TakeNextFrame(), every frame is taken once by each.
+   *
+   * @param frame
+   *
+   * Set to the index of the frame taken.
+   *
+   * @return
+   *
+   * FALSE if no such frame is ready.
+   */
+  bool TakeRenderedFrame(int64_t* frame, QByteArray* pixels, QByteArray* hash);
+
+  /**
+   * @brief Size and format of the frames from TakeNextFrame()
+   */
+  const VideoRenderingParams& frame_params() const;
+
+  /**
+   * @brief The cache that frames from TakeNextFrame() are read from
+   */
+  using VideoRenderBackend::frame_cache;
+
+  /**
+   * @brief The pool that writes frames to the disk cache, which also writes image sequences
+   */
+  using VideoRenderBackend::frame_writer;
+
+public slots:
+  /**
+   * @brief Only the part of the invalidated range inside the range being rendered is queued
+   */
+  virtual void InvalidateCache(const rational &start_range, const rational &end_range) override;
+
+protected:
+  virtual void JobFinishedEvent(const RenderResult& result) override;
+
+  /**
+   * @brief Every frame is needed exactly once, so jobs are never abandoned
+   */
+  virtual bool CancelsStaleJobs() const override;
+
+signals:
+  /**
+   * @brief Emitted whenever a worker finishes with a frame, after which TakeNextFrame() may have another one
+   */
+  void FramesRendered();
+
+private:
+  /**
+   * @brief Queue any frames that were skipped without being announced once nothing else is left to do
+   */
+  void RequeueSkippedFrames();
+
+  /**
+   * @brief Convert a time to an index in frame_hashes_, or -1 if it's outside of the sequence
+   */
+  int FrameIndex(const rational& time) const;
+
+  /**
+   * @brief Set the data of a rendered frame for TakeNextFrame() and TakeRenderedFrame()
+   *
+   * @return
+   *
+   * FALSE if the frame is still being downloaded or written.
+   */
+  bool GetRenderedFrame(int index, QByteArray* pixels, QByteArray* hash);
+
+  /**
+   * @brief Called once for each frame as it's first rendered or found in the cache
+   */
+  void FrameRendered(int index);
+
+  int64_t frame_count_;
+
+  int64_t next_frame_;
+
+  /**
+   * @brief Index (in the sequence) of the first frame rendered
+   */
+  int64_t first_frame_;
+
+  /**
+   * @brief Times the frames rendered start from and up to, as passed to StartRender()
+   */
+  rational range_in_;
+  rational range_out_;
+
+  int64_t rendered_count_;
+
+  /**
+   * @brief Hash of each frame once a worker has rendered it, empty if it rendered to nothing
+   */
+  QVector<QByteArray> frame_hashes_;
+
+  QVector<bool> frame_rendered_;
+
+  bool tracks_rendered_frames_;
+
+  /**
+   * @brief Frames that have been rendered but not taken by TakeRenderedFrame() yet, in the order they were rendered
+   */
+  QList<int> rendered_frames_;
+
+  /**
+   * @brief Frames that were rendered but not written to the disk cache yet
+   */
+  int pending_writes_;
+
+  void WorkerCompletedFrame(const NodeDependency& path, const QByteArray& hash, bool will_be_written);
+
+  void WorkerHashAlreadyExists(const NodeDependency& path, const QByteArray& hash);
+
+private slots:
+  void WriterWroteFrame();
+
+};
+
+/**
+ * @brief An AudioBackend that caches a whole sequence's audio and reads it back
+ */
+class ExportAudioBackend : public AudioBackend
+{
+  Q_OBJECT
+public:
+  ExportAudioBackend(QObject* parent = nullptr);
+
+  /**
+   * @brief Start caching the connected viewer's audio
+   */
+  bool StartCache();
+
+  /**
+   * @brief Copy up to `length` bytes of cached audio starting `offset` bytes in to `buffer`
+   *
+   * @return
+   *
+   * Number of bytes copied.
+   */
+  qint64 Read(qint64 offset, char* buffer, qint64 length);
+
+  /**
+   * @brief Number of bytes from `offset` that have been cached, segments from here on are cached first
+   */
+  qint64 ValidBytesAt(qint64 offset);
+
+  /**
+   * @brief Size in bytes of the sequence's audio
+   */
+  qint64 size();
+
+protected:
+  virtual void JobFinishedEvent(const RenderResult& result) override;
+
+  /**
+   * @brief Nothing plays the audio back live, so every worker renders mixdown chunks
+   */
+  virtual bool ReservesInteractiveWorker() const override;
+
+  /**
+   * @brief Renders in chunks of kMixdownSegments
+   */
+  virtual int SegmentsPerJob() const override;
+
+signals:
+  void SegmentCached();
+
+private:
+  /**
+   * @brief Segments each job renders, about 10 seconds at 48 kHz
+   *
+   * The chunks render in parallel across the workers and are read back in order as they become valid. Stateful nodes
+   * pre-roll at the start of each chunk (see Node::SamplePreRoll()), so the boundaries don't show in the mixdown.
+   */
+  static const int kMixdownSegments = 64;
+
+};
+
+/**
+ * @brief Renders a sequence and encodes it to one or more files without any of the UI
+ *
+ * Export is a pipeline: the video workers render frames out of order while the audio workers mix the audio
+ * alongside them, frames are put back in order as they're rendered (ExportVideoBackend::TakeNextFrame()), and an
+ * EncodeThread for each file converts and encodes them with the matching audio. Frames are converted from the scene
+ * linear reference space to the default OCIO display and view.
+ *
+ * Every file is encoded from the same render, so exporting several deliverables of a sequence (e.g. a mezzanine and a
+ * review copy) only renders its frames once. Frames wait in the frame cache until the slowest encoder is ready for
+ * them.
+ *
+ * Image sequences (see IsImageSequence()) don't go through an encoder. Every frame is a file of its own, so they're
+ * written by the frame cache's writer pool in whatever order they finish rendering.
+ *
+ * If there's only one file and the video is a single clip that's been left as it is, it's copied from the source file
+ * without being rendered or encoded again (see VideoPassthrough), only the audio goes through the pipeline.
+ *
+ * Needs an OpenGL context to be current when starting, which the render workers share with.
+ */
+class Exporter : public QObject
+{
+  Q_OBJECT
+public:
+  Exporter(ViewerOutput* viewer, const QStringList& filenames, QObject* parent = nullptr);
+
+  /**
+   * @brief Cancels the export if it's still running
+   */
+  virtual ~Exporter() override;
+
+  /**
+   * @brief Render and encode the whole sequence, returning once it's done
+   *
+   * @return
+   *
+   * FALSE if anything failed, see GetError().
+   */
+  bool Run();
+
+  /**
+   * @brief Start rendering and encoding, Finished() is emitted once it's done
+   *
+   * The work is done on other threads and driven from this object's thread's event loop, so any number of exports can
+   * run at once (they share RenderBudget like every other backend).
+   *
+   * @return
+   *
+   * FALSE if it couldn't start, see GetError(). Finished() isn't emitted in that case.
+   */
+  bool Start();
+
+  /**
+   * @brief Stop a running export and delete the files it was writing, Finished() is emitted before this returns
+   */
+  void Cancel();
+
+  bool IsRunning() const;
+
+  const QString& GetError() const;
+
+  const QStringList& filenames() const;
+
+  /**
+   * @brief Most frames waiting to be encoded at once, rendering carries on but frames stay in the cache until then
+   */
+  static const int kMaxQueuedFrames = 8;
+
+  /**
+   * @brief Most image sequence frames waiting to be written at once
+   *
+   * Enough to keep the writers busy, few enough that queueing another rarely has to wait for room (see
+   * VideoRenderFrameWriter::WriteImage()).
+   */
+  static const int kMaxQueuedImages = 16;
+
+  /**
+   * @brief Returns whether a file is written as an image sequence (OpenEXR or DPX) rather than encoded
+   */
+  static bool IsImageSequence(const QString& filename);
+
+  /**
+   * @brief Filename of one frame of an image sequence
+   *
+   * The frame number replaces the last run of #s in the filename, padded to as many digits as there are #s.
+   * Filenames without any get a four digit frame number before their extension.
+   */
+  static QString ImageSequenceFilename(const QString& pattern, int64_t frame);
+
+signals:
+  /**
+   * @brief Emitted whenever another percent of the frames have been encoded (into every file)
+   */
+  void ProgressChanged(int percent);
+
+  /**
+   * @brief Emitted when an export started with Start() has finished, it succeeded if GetError() is empty
+   */
+  void Finished();
+
+private:
+  /**
+   * @brief Queue cached audio up to `bytes` bytes in
+   *
+   * @return
+   *
+   * FALSE if some of it hasn't been cached yet.
+   */
+  bool QueueAudioUntil(qint64 bytes);
+
+  /**
+   * @brief Bytes of audio that start before this frame
+   */
+  qint64 AudioBytesBeforeFrame(int64_t frame);
+
+  /**
+   * @brief Bytes of audio that start before this time
+   */
+  qint64 AudioBytesBeforeTime(const rational& time);
+
+  /**
+   * @brief Number of frames (or packets when copying) that will be encoded into each file
+   */
+  int64_t TotalFrames() const;
+
+  /**
+   * @brief The most frames any one file has waiting to be encoded
+   */
+  int QueuedFrames();
+
+  /**
+   * @brief Returns whether any file has an audio stream
+   */
+  bool HasAudio() const;
+
+  /**
+   * @brief FeedEncoder() for when the video is copied from passthrough_
+   */
+  void FeedPassthrough();
+
+  /**
+   * @brief Queue rendered frames to be written to every image sequence
+   */
+  void FeedImages();
+
+  void UpdateProgress();
+
+  /**
+   * @brief Stop once every file has been finished
+   */
+  void StopIfFinished();
+
+  /**
+   * @brief Set the error and stop once control returns to the event loop
+   */
+  void Fail(const QString& error);
+
+  /**
+   * @brief Stop once control returns to the event loop
+   */
+  void QueueStop();
+
+  /**
+   * @brief Stop every thread and backend and close the files, deleting them if there was an error
+   */
+  void Teardown();
+
+  /**
+   * @brief Encoder and thread encoding one of filenames_
+   */
+  struct Output {
+    QString filename;
+    Encoder* encoder;
+    EncodeThread* thread;
+  };
+
+  ViewerOutput* viewer_;
+
+  QStringList filenames_;
+
+  QString error_;
+
+  QVector<Output> outputs_;
+
+  /**
+   * @brief The files in filenames_ that are image sequences
+   */
+  QStringList image_sequences_;
+
+  /**
+   * @brief Frame number the first frame of an image sequence gets
+   */
+  int64_t image_start_frame_;
+
+  /**
+   * @brief Frames that have been queued to be written to the image sequences, so they can be removed on failure
+   */
+  QVector<bool> images_queued_;
+
+  int images_in_flight_;
+
+  int64_t images_written_;
+
+  ColorProcessorPtr color_processor_;
+
+  ExportVideoBackend* video_backend_;
+
+  ExportAudioBackend* audio_backend_;
+
+  /**
+   * @brief Source of the video packets if it's being copied, nullptr if it's being rendered
+   */
+  VideoPassthrough* passthrough_;
+
+  bool running_;
+
+  qint64 audio_queued_;
+
+  int64_t frames_queued_;
+
+  /**
+   * @brief Frames encoded or written into any of the files
+   */
+  int64_t frames_encoded_;
+
+  bool finish_queued_;
+
+  bool stop_queued_;
+
+  /**
+   * @brief Last percentage sent through ProgressChanged()
+   */
+  int progress_;
+
+private slots:
+  /**
+   * @brief Pass everything that's ready on to the EncodeThreads, in order
+   */
+  void FeedEncoder();
+
+  void FrameEncoded();
+
+  void ImageWritten(const QString& filename, bool success);
+
+  /**
+   * @brief Stop once every file has been finished, or as soon as any of them failed
+   */
+  void EncodeThreadFinished();
+
+  /**
+   * @brief Teardown() and emit Finished(), if still running
+   */
+  void Stop();
+
+};
+
+#endif // EXPORTER_H
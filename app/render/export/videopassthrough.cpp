@@ -0,0 +1,296 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "videopassthrough.h"
+
+#include <QCoreApplication>
+
+#include "decoder/ffmpeg/ffmpegdecoder.h"
+#include "node/block/clip/clip.h"
+#include "node/distort/transform/transform.h"
+#include "node/input/media/video/video.h"
+#include "node/output/track/track.h"
+#include "project/item/footage/videostream.h"
+
+VideoPassthrough::VideoPassthrough() :
+  fmt_ctx_(nullptr),
+  avstream_(nullptr),
+  pkt_(nullptr),
+  pkt_ready_(false),
+  at_end_(false),
+  start_ts_(0),
+  end_ts_(0),
+  packet_count_(0)
+{
+}
+
+VideoPassthrough::~VideoPassthrough()
+{
+  Close();
+}
+
+bool VideoPassthrough::Open(ViewerOutput *viewer, const QString &output_filename)
+{
+  Close();
+
+  rational media_in, media_out;
+  StreamPtr stream = FindUntouchedClip(viewer, &media_in, &media_out);
+
+  if (stream == nullptr) {
+    return false;
+  }
+
+  // The packet index is only kept by the FFmpeg decoder
+  FFmpegDecoder decoder;
+
+  if (stream->footage()->decoder() != decoder.id()) {
+    return false;
+  }
+
+  decoder.set_stream(stream);
+
+  bool found_range = decoder.GetStreamCopyRange(media_in, media_out, &start_ts_, &end_ts_, &packet_count_);
+
+  decoder.Close();
+
+  if (!found_range || packet_count_ == 0) {
+    return false;
+  }
+
+  QByteArray filename = stream->footage()->filename().toUtf8();
+
+  if (avformat_open_input(&fmt_ctx_, filename, nullptr, nullptr) != 0
+      || avformat_find_stream_info(fmt_ctx_, nullptr) < 0
+      || stream->index() >= static_cast<int>(fmt_ctx_->nb_streams)) {
+    Close();
+    return false;
+  }
+
+  avstream_ = fmt_ctx_->streams[stream->index()];
+
+  // Only worth it if the export would have been encoded to this codec anyway
+  AVOutputFormat* output_format = av_guess_format(nullptr, output_filename.toUtf8(), nullptr);
+
+  if (output_format == nullptr || output_format->video_codec != avstream_->codecpar->codec_id) {
+    Close();
+    return false;
+  }
+
+  // There's a keyframe at start_ts_, so this is where reading starts
+  if (av_seek_frame(fmt_ctx_, avstream_->index, start_ts_, AVSEEK_FLAG_BACKWARD) < 0) {
+    Close();
+    return false;
+  }
+
+  pkt_ = av_packet_alloc();
+
+  if (pkt_ == nullptr) {
+    Close();
+    return false;
+  }
+
+  return true;
+}
+
+void VideoPassthrough::Close()
+{
+  av_packet_free(&pkt_);
+
+  if (fmt_ctx_ != nullptr) {
+    avformat_close_input(&fmt_ctx_);
+  }
+
+  // Freed along with the format context
+  avstream_ = nullptr;
+
+  pkt_ready_ = false;
+  at_end_ = false;
+  packet_count_ = 0;
+  error_.clear();
+}
+
+const AVStream *VideoPassthrough::stream() const
+{
+  return avstream_;
+}
+
+int VideoPassthrough::packet_count() const
+{
+  return packet_count_;
+}
+
+const AVPacket *VideoPassthrough::PeekPacket()
+{
+  if (!pkt_ready_ && !at_end_) {
+    pkt_ready_ = ReadPacket();
+    at_end_ = !pkt_ready_;
+  }
+
+  return pkt_ready_ ? pkt_ : nullptr;
+}
+
+AVPacket *VideoPassthrough::TakePacket()
+{
+  if (PeekPacket() == nullptr) {
+    return nullptr;
+  }
+
+  AVPacket* pkt = av_packet_alloc();
+
+  if (pkt == nullptr) {
+    error_ = QCoreApplication::translate("VideoPassthrough", "Failed to allocate resources for copying video");
+    at_end_ = true;
+    return nullptr;
+  }
+
+  av_packet_move_ref(pkt, pkt_);
+  pkt_ready_ = false;
+
+  return pkt;
+}
+
+rational VideoPassthrough::PacketTime(const AVPacket *pkt) const
+{
+  int64_t ts = (pkt->dts == AV_NOPTS_VALUE) ? pkt->pts : pkt->dts;
+
+  return rational(ts) * rational(avstream_->time_base);
+}
+
+const QString &VideoPassthrough::GetError() const
+{
+  return error_;
+}
+
+StreamPtr VideoPassthrough::FindUntouchedClip(ViewerOutput *viewer, rational *media_in, rational *media_out)
+{
+  // Extra video tracks are blended in before the viewer, so there's only one if it's connected straight to a track
+  Node* connected = viewer->texture_input()->get_connected_node();
+
+  if (connected == nullptr || !connected->IsBlock() || static_cast<Block*>(connected)->type() != Block::kTrack) {
+    return nullptr;
+  }
+
+  TrackOutput* track = static_cast<TrackOutput*>(connected);
+
+  if (track->track_input()->IsConnected() || track->muted_input()->is_keyframing() || track->IsMuted(0)) {
+    return nullptr;
+  }
+
+  ClipBlock* clip = nullptr;
+
+  foreach (Block* block, track->Blocks()) {
+    if (block->type() == Block::kClip) {
+      if (clip != nullptr) {
+        return nullptr;
+      }
+
+      clip = static_cast<ClipBlock*>(block);
+    }
+  }
+
+  // Anything before or after the clip would be blank frames that aren't in the source
+  if (clip == nullptr || clip->in() != rational(0) || clip->out() != viewer->Length()) {
+    return nullptr;
+  }
+
+  VideoInput* video_input = dynamic_cast<VideoInput*>(clip->texture_input()->get_connected_node());
+
+  if (video_input == nullptr || clip->IsBypassed() || video_input->IsBypassed()) {
+    return nullptr;
+  }
+
+  // Clips get a transform when they're added, it just has to be left alone
+  Node* transform_node = video_input->matrix_input()->get_connected_node();
+
+  if (transform_node != nullptr) {
+    TransformDistort* transform = dynamic_cast<TransformDistort*>(transform_node);
+
+    // A bypassed transform outputs no matrix, which is the same as an identity one
+    if (transform == nullptr || !(transform->IsBypassed() || transform->IsIdentity())) {
+      return nullptr;
+    }
+  }
+
+  StreamPtr stream = video_input->footage();
+
+  if (stream == nullptr || stream->type() != Stream::kVideo) {
+    return nullptr;
+  }
+
+  VideoStreamPtr video_stream = std::static_pointer_cast<VideoStream>(stream);
+  const VideoParams& params = viewer->video_params();
+
+  if (video_stream->width() != params.width()
+      || video_stream->height() != params.height()
+      || video_stream->frame_rate() != params.time_base().flipped()) {
+    return nullptr;
+  }
+
+  *media_in = clip->media_in();
+  *media_out = clip->media_in() + clip->length();
+
+  return stream;
+}
+
+bool VideoPassthrough::ReadPacket()
+{
+  forever {
+    int error_code = av_read_frame(fmt_ctx_, pkt_);
+
+    if (error_code < 0) {
+      if (error_code != AVERROR_EOF) {
+        char err[1024];
+        av_strerror(error_code, err, 1024);
+
+        error_ = QCoreApplication::translate("VideoPassthrough", "Failed to read video to copy: %1").arg(err);
+      }
+
+      return false;
+    }
+
+    if (pkt_->stream_index == avstream_->index) {
+      // Same timestamp the packet index uses
+      int64_t ts = (pkt_->pts == AV_NOPTS_VALUE) ? pkt_->dts : pkt_->pts;
+
+      if (ts != AV_NOPTS_VALUE) {
+        if (ts >= end_ts_ && (pkt_->flags & AV_PKT_FLAG_KEY)) {
+          // Start of the first group of pictures that isn't copied
+          av_packet_unref(pkt_);
+          return false;
+        }
+
+        // Frames around the ends that reference frames outside of the range are dropped
+        if (ts >= start_ts_ && ts < end_ts_) {
+          if (pkt_->pts != AV_NOPTS_VALUE) {
+            pkt_->pts -= start_ts_;
+          }
+
+          if (pkt_->dts != AV_NOPTS_VALUE) {
+            pkt_->dts -= start_ts_;
+          }
+
+          return true;
+        }
+      }
+    }
+
+    av_packet_unref(pkt_);
+  }
+}
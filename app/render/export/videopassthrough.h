@@ -0,0 +1,119 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef VIDEOPASSTHROUGH_H
+#define VIDEOPASSTHROUGH_H
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include "common/constructors.h"
+#include "node/output/viewer/viewer.h"
+#include "project/item/footage/stream.h"
+
+/**
+ * @brief Reads the packets of a sequence's video straight from its source file so they can be copied without decoding
+ *
+ * Only possible if the sequence's video is a single untouched clip: one video track with one clip covering the whole
+ * sequence, no effects or transform, the same size and frame rate as the sequence, the same codec as the export
+ * would encode to, and cut on keyframes (found through the decoder's packet index).
+ */
+class VideoPassthrough
+{
+public:
+  VideoPassthrough();
+
+  ~VideoPassthrough();
+
+  DISABLE_COPY_MOVE(VideoPassthrough)
+
+  /**
+   * @brief Open the source of `viewer`'s video for copying into `output_filename`
+   *
+   * @return
+   *
+   * FALSE if it can't be copied and has to be rendered and encoded instead.
+   */
+  bool Open(ViewerOutput* viewer, const QString& output_filename);
+
+  void Close();
+
+  /**
+   * @brief The stream the packets are copied from, for Encoder::Open()
+   */
+  const AVStream* stream() const;
+
+  /**
+   * @brief Number of packets ReadPacket() returns in total
+   */
+  int packet_count() const;
+
+  /**
+   * @brief The next packet to copy without taking it, or nullptr once every packet has been read
+   *
+   * Timestamps are in the stream's timebase and start from the beginning of the sequence.
+   */
+  const AVPacket* PeekPacket();
+
+  /**
+   * @brief Take the packet from PeekPacket(), the caller is responsible for freeing it
+   */
+  AVPacket* TakePacket();
+
+  /**
+   * @brief Sequence time a packet from PeekPacket() needs to be decoded at
+   */
+  rational PacketTime(const AVPacket* pkt) const;
+
+  /**
+   * @brief Why PeekPacket() ran out early, empty if it didn't
+   */
+  const QString& GetError() const;
+
+private:
+  /**
+   * @brief Find the footage stream and range of it the viewer's video plays if it's a single untouched clip
+   */
+  static StreamPtr FindUntouchedClip(ViewerOutput* viewer, rational* media_in, rational* media_out);
+
+  bool ReadPacket();
+
+  AVFormatContext* fmt_ctx_;
+
+  AVStream* avstream_;
+
+  AVPacket* pkt_;
+
+  bool pkt_ready_;
+
+  bool at_end_;
+
+  int64_t start_ts_;
+
+  int64_t end_ts_;
+
+  int packet_count_;
+
+  QString error_;
+
+};
+
+#endif // VIDEOPASSTHROUGH_H
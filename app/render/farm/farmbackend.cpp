@@ -0,0 +1,157 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "farmbackend.h"
+
+#include <QDebug>
+#include <QEventLoop>
+
+FarmVideoBackend::FarmVideoBackend(QObject *parent) :
+  OpenGLBackend(parent),
+  frames_(0),
+  rendered_(0),
+  to_write_(0),
+  written_(0)
+{
+  stall_timer_.setInterval(kStallTimeout);
+  stall_timer_.setSingleShot(true);
+}
+
+bool FarmVideoBackend::RenderRange(const TimeRange &range)
+{
+  if (!Init()) {
+    return false;
+  }
+
+  connect(frame_writer(), SIGNAL(FrameWritten(NodeDependency, QByteArray)), this, SLOT(WriterWroteFrame()), Qt::UniqueConnection);
+
+  int64_t first = TimeToFrame(range.in());
+  int64_t end = TimeToFrame(range.out());
+
+  if (end <= first) {
+    return true;
+  }
+
+  hashes_.clear();
+
+  // Playing means frames are rendered straight away in order, rather than waiting for edits to settle
+  SetPlaybackSpeed(1);
+
+  // The range ends where the next chunk starts, so its last frame is the one before
+  InvalidateCache(FrameToTime(first), FrameToTime(end - 1));
+
+  // Nothing is dispatched until control returns to the event loop, so this is every frame that will be rendered
+  frames_ = static_cast<int>(GetStatistics().queued_frames);
+  rendered_ = 0;
+  to_write_ = frames_;
+  written_ = 0;
+
+  if (frames_ > 0) {
+    QEventLoop loop;
+    connect(this, SIGNAL(Finished()), &loop, SLOT(quit()));
+    connect(&stall_timer_, SIGNAL(timeout()), &loop, SLOT(quit()));
+    stall_timer_.start();
+    loop.exec();
+    stall_timer_.stop();
+  }
+
+  SetPlaybackSpeed(0);
+
+  if (rendered_ < frames_ || written_ < to_write_) {
+    qWarning() << "Rendering stalled after" << rendered_ << "of" << frames_ << "frames";
+    return false;
+  }
+
+  // The writers upload in the background, but the job isn't done until everything's in the shared cache
+  foreach (const QByteArray& hash, hashes_) {
+    if (!frame_cache()->ShareFrame(hash)) {
+      qWarning() << "Failed to copy frame" << hash.toHex() << "to the shared cache";
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void FarmVideoBackend::JobFinishedEvent(const RenderResult &result)
+{
+  OpenGLBackend::JobFinishedEvent(result);
+
+  switch (result.type) {
+  case RenderResult::kCompletedFrame:
+    // Frames with nothing in them (e.g. past the end of the clip) aren't written
+    if (ValueHasTexture(result.value.Get(NodeParam::kTexture))) {
+      FrameRendered(result.hash, true);
+    } else {
+      FrameRendered(QByteArray(), false);
+    }
+    break;
+  case RenderResult::kCompletedTiles:
+    FrameRendered(result.hash, true);
+    break;
+  case RenderResult::kHashAlreadyExists:
+    // Already in the local cache, though possibly not the shared one yet
+    FrameRendered(result.hash, false);
+    break;
+  case RenderResult::kHashAlreadyBeingCached:
+    // Another worker is rendering an identical frame, which is shared when it's counted
+    FrameRendered(QByteArray(), false);
+    break;
+  case RenderResult::kCompletedCache:
+  case RenderResult::kCancelled:
+    break;
+  }
+}
+
+bool FarmVideoBackend::CancelsStaleJobs() const
+{
+  return false;
+}
+
+void FarmVideoBackend::FrameRendered(const QByteArray &hash, bool will_be_written)
+{
+  if (!hash.isEmpty()) {
+    hashes_.insert(hash);
+  }
+
+  if (!will_be_written) {
+    to_write_--;
+  }
+
+  rendered_++;
+
+  CheckFinished();
+}
+
+void FarmVideoBackend::CheckFinished()
+{
+  stall_timer_.start();
+
+  if (rendered_ == frames_ && written_ >= to_write_) {
+    emit Finished();
+  }
+}
+
+void FarmVideoBackend::WriterWroteFrame()
+{
+  written_++;
+
+  CheckFinished();
+}
@@ -0,0 +1,94 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FARMBACKEND_H
+#define FARMBACKEND_H
+
+#include <QSet>
+#include <QTimer>
+
+#include "render/backend/opengl/openglbackend.h"
+
+/**
+ * @brief An OpenGLBackend that renders a range of the connected viewer into the shared cache and waits until it's done
+ */
+class FarmVideoBackend : public OpenGLBackend
+{
+  Q_OBJECT
+public:
+  FarmVideoBackend(QObject* parent = nullptr);
+
+  /**
+   * @brief Render every frame in `range` and wait until they're all in the shared cache
+   *
+   * Frames that are already in the local or shared cache aren't rendered again.
+   *
+   * @return
+   *
+   * FALSE if rendering stopped making progress for kStallTimeout or a frame couldn't be copied to the shared cache.
+   */
+  bool RenderRange(const TimeRange& range);
+
+  /**
+   * @brief Milliseconds without a frame being rendered or written before RenderRange() gives up
+   */
+  static const int kStallTimeout = 300000;
+
+protected:
+  virtual void JobFinishedEvent(const RenderResult& result) override;
+
+  /**
+   * @brief Nothing edits the graph while rendering, and every frame is counted once it's rendered
+   */
+  virtual bool CancelsStaleJobs() const override;
+
+signals:
+  void Finished();
+
+private:
+  /**
+   * @brief Count a frame that a worker has finished with
+   *
+   * @param hash
+   *
+   * The frame's hash if it's going to be in the local cache once written, or empty if there's nothing to share.
+   */
+  void FrameRendered(const QByteArray& hash, bool will_be_written);
+
+  void CheckFinished();
+
+  int frames_;
+
+  int rendered_;
+
+  int to_write_;
+
+  int written_;
+
+  QSet<QByteArray> hashes_;
+
+  QTimer stall_timer_;
+
+private slots:
+  void WriterWroteFrame();
+
+};
+
+#endif // FARMBACKEND_H
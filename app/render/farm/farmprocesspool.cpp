@@ -0,0 +1,154 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "farmprocesspool.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+
+#include "renderfarm.h"
+
+FarmProcessPool::FarmProcessPool(QObject *parent) :
+  QObject(parent),
+  stopping_(false)
+{
+}
+
+FarmProcessPool::~FarmProcessPool()
+{
+  Stop();
+}
+
+void FarmProcessPool::Start(int count, bool software)
+{
+  Stop();
+
+  stopping_ = false;
+
+  arguments_ = QStringList({"--worker"});
+
+  if (software) {
+    arguments_.append("--software");
+  }
+
+  // A folder other than the shared cache's has to be passed on, the workers wouldn't find it otherwise
+  arguments_.append({"--jobs", RenderFarm::JobFolder()});
+
+  workers_.resize(count);
+
+  for (int i=0;i<workers_.size();i++) {
+    Worker& worker = workers_[i];
+
+    worker.process = new QProcess(this);
+    worker.process->setProcessChannelMode(QProcess::ForwardedChannels);
+    worker.pid = 0;
+    worker.restarts = 0;
+
+    connect(worker.process, SIGNAL(started()), this, SLOT(ProcessStarted()));
+    connect(worker.process, SIGNAL(finished(int, QProcess::ExitStatus)), this, SLOT(ProcessFinished(int, QProcess::ExitStatus)));
+
+    StartProcess(worker);
+  }
+}
+
+void FarmProcessPool::Stop()
+{
+  stopping_ = true;
+
+  for (int i=0;i<workers_.size();i++) {
+    QProcess* process = workers_.at(i).process;
+
+    if (process->state() != QProcess::NotRunning) {
+      process->terminate();
+
+      if (!process->waitForFinished(kStopTimeout)) {
+        process->kill();
+        process->waitForFinished(kStopTimeout);
+      }
+    }
+
+    delete process;
+  }
+
+  workers_.clear();
+}
+
+bool FarmProcessPool::IsRunning() const
+{
+  for (int i=0;i<workers_.size();i++) {
+    if (workers_.at(i).process->state() != QProcess::NotRunning) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void FarmProcessPool::StartProcess(Worker &worker)
+{
+  worker.process->start(QCoreApplication::applicationFilePath(), arguments_);
+}
+
+int FarmProcessPool::IndexOfProcess(QObject *process) const
+{
+  for (int i=0;i<workers_.size();i++) {
+    if (workers_.at(i).process == process) {
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+void FarmProcessPool::ProcessStarted()
+{
+  int index = IndexOfProcess(sender());
+
+  if (index > -1) {
+    workers_[index].pid = workers_.at(index).process->processId();
+  }
+}
+
+void FarmProcessPool::ProcessFinished(int exit_code, QProcess::ExitStatus status)
+{
+  int index = IndexOfProcess(sender());
+
+  if (index == -1 || stopping_) {
+    return;
+  }
+
+  Worker& worker = workers_[index];
+
+  if (status == QProcess::CrashExit) {
+    qWarning() << "Render worker process" << worker.pid << "crashed";
+  } else {
+    qWarning() << "Render worker process" << worker.pid << "exited with code" << exit_code;
+  }
+
+  // Whatever it was rendering is left for the others rather than waiting for its claim to go stale
+  RenderFarm::ReleaseJobsOfProcess(worker.pid);
+
+  if (worker.restarts < kMaxRestarts) {
+    worker.restarts++;
+    StartProcess(worker);
+  } else {
+    qWarning() << "Render worker process" << worker.pid << "exited too many times, giving up on it";
+  }
+}
@@ -0,0 +1,98 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FARMPROCESSPOOL_H
+#define FARMPROCESSPOOL_H
+
+#include <QProcess>
+#include <QVector>
+
+/**
+ * @brief Runs render farm workers (see FarmWorker) as child processes of this one
+ *
+ * A crash in a decoder, an OCIO processor or a driver only takes down the worker process it happened in, whose jobs
+ * go straight back in the queue for the others and which is started again. Each process also has a heap, an event
+ * loop and a GPU context of its own, so they don't contend on them the way worker threads in one process do.
+ *
+ * Workers render into the frame cache as usual, so frames are handed back through the cache's hash-named files
+ * rather than being sent to this process.
+ */
+class FarmProcessPool : public QObject
+{
+  Q_OBJECT
+public:
+  FarmProcessPool(QObject* parent = nullptr);
+
+  virtual ~FarmProcessPool() override;
+
+  /**
+   * @brief Start `count` worker processes taking jobs from RenderFarm::JobFolder()
+   *
+   * @param software
+   *
+   * Render on the CPU rather than the GPU (see --software).
+   */
+  void Start(int count, bool software);
+
+  /**
+   * @brief Stop every worker process, waiting up to kStopTimeout for each before killing it
+   */
+  void Stop();
+
+  /**
+   * @brief Returns FALSE once every worker process has exited more than kMaxRestarts times
+   */
+  bool IsRunning() const;
+
+  /**
+   * @brief Times a worker process is started again after exiting before it's given up on
+   */
+  static const int kMaxRestarts = 3;
+
+  static const int kStopTimeout = 5000;
+
+private:
+  struct Worker {
+    QProcess* process;
+
+    /// Kept from when it started, QProcess forgets it once the process has exited
+    qint64 pid;
+
+    int restarts;
+  };
+
+  void StartProcess(Worker& worker);
+
+  int IndexOfProcess(QObject* process) const;
+
+  QVector<Worker> workers_;
+
+  QStringList arguments_;
+
+  bool stopping_;
+
+private slots:
+  void ProcessStarted();
+
+  void ProcessFinished(int exit_code, QProcess::ExitStatus status);
+
+};
+
+#endif // FARMPROCESSPOOL_H
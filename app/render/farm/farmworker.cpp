@@ -0,0 +1,200 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "farmworker.h"
+
+#include <QDebug>
+#include <QEventLoop>
+#include <QFileInfo>
+#include <QTimer>
+
+#include "project/projectserializer.h"
+
+/**
+ * @brief Find the sequence with this UUID under `item`, or failing that, the first one called `name`
+ */
+static Sequence* FindSequence(Item* item, const QUuid& uuid, const QString& name, Sequence** named)
+{
+  for (int i=0;i<item->child_count();i++) {
+    Item* child = item->child(i);
+
+    if (child->type() == Item::kSequence) {
+      Sequence* sequence = static_cast<Sequence*>(child);
+
+      if (sequence->uuid() == uuid) {
+        return sequence;
+      }
+
+      if (*named == nullptr && sequence->name() == name) {
+        *named = sequence;
+      }
+    }
+
+    Sequence* sequence = FindSequence(child, uuid, name, named);
+
+    if (sequence != nullptr) {
+      return sequence;
+    }
+  }
+
+  return nullptr;
+}
+
+FarmWorker::FarmWorker(QObject *parent) :
+  QObject(parent),
+  viewer_(nullptr)
+{
+  refresh_timer_.setInterval(RenderFarm::kClaimTimeout / 4);
+  connect(&refresh_timer_, SIGNAL(timeout()), this, SLOT(RefreshClaim()));
+}
+
+FarmWorker::~FarmWorker()
+{
+  CloseProject();
+}
+
+bool FarmWorker::Run()
+{
+  if (RenderFarm::JobFolder().isEmpty()) {
+    qCritical() << "There's no shared cache to take jobs from (set one in the preferences)";
+    return false;
+  }
+
+  qInfo() << "Waiting for jobs in" << RenderFarm::JobFolder();
+
+  forever {
+    RenderFarm::Job job;
+
+    if (!RenderFarm::ClaimJob(&job, &claim_)) {
+      Wait(kPollInterval);
+      continue;
+    }
+
+    refresh_timer_.start();
+
+    bool rendered = RenderJob(job);
+
+    refresh_timer_.stop();
+
+    if (rendered) {
+      RenderFarm::FinishJob(claim_);
+    } else {
+      // Another worker may have better luck, don't claim it straight back
+      RenderFarm::ReleaseJob(claim_);
+      Wait(kPollInterval);
+    }
+
+    claim_.clear();
+  }
+}
+
+bool FarmWorker::RenderJob(const RenderFarm::Job &job)
+{
+  Sequence* sequence = OpenSequence(job.project, job.sequence, job.sequence_name);
+
+  if (sequence == nullptr) {
+    return false;
+  }
+
+  qInfo() << "Rendering" << sequence->name() << "from" << job.range.in().toDouble() << "to" << job.range.out().toDouble();
+
+  SetViewer(sequence->viewer_output());
+
+  bool result = backend_.RenderRange(job.range);
+
+  if (!result) {
+    qWarning() << "Failed to render" << sequence->name() << "-" << backend_.GetError();
+  }
+
+  return result;
+}
+
+Sequence *FarmWorker::OpenSequence(const QString &project, const QUuid &uuid, const QString &name)
+{
+  QDateTime modified = QFileInfo(project).lastModified();
+
+  if (project_ == nullptr || project != project_filename_ || modified != project_modified_) {
+    CloseProject();
+
+    project_ = ProjectSerializer::Load(project);
+
+    if (project_ == nullptr) {
+      qWarning() << "Failed to open" << project;
+      return nullptr;
+    }
+
+    project_filename_ = project;
+    project_modified_ = modified;
+  }
+
+  Sequence* named = nullptr;
+  Sequence* sequence = FindSequence(project_->root(), uuid, name, &named);
+
+  if (sequence == nullptr) {
+    sequence = named;
+  }
+
+  if (sequence == nullptr) {
+    qWarning() << project << "has no sequence called" << name;
+    return nullptr;
+  }
+
+  sequence->Materialize();
+
+  return sequence;
+}
+
+void FarmWorker::SetViewer(ViewerOutput *viewer)
+{
+  if (viewer == viewer_) {
+    return;
+  }
+
+  backend_.Close();
+  backend_.SetViewerNode(viewer);
+
+  if (viewer != nullptr) {
+    // Full resolution, the same as exports, so an export on any machine can use the frames
+    backend_.SetParameters(VideoRenderingParams(viewer->video_params(), olive::PIX_FMT_RGBA16F, olive::kOffline));
+  }
+
+  viewer_ = viewer;
+}
+
+void FarmWorker::CloseProject()
+{
+  // The backend mustn't be left pointing at a viewer that's about to be deleted
+  SetViewer(nullptr);
+
+  project_ = nullptr;
+  project_filename_.clear();
+}
+
+void FarmWorker::Wait(int msecs)
+{
+  QEventLoop loop;
+  QTimer::singleShot(msecs, &loop, SLOT(quit()));
+  loop.exec();
+}
+
+void FarmWorker::RefreshClaim()
+{
+  RenderFarm::RefreshClaim(claim_);
+}
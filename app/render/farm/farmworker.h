@@ -0,0 +1,100 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FARMWORKER_H
+#define FARMWORKER_H
+
+#include <QDateTime>
+#include <QTimer>
+
+#include "farmbackend.h"
+#include "project/item/sequence/sequence.h"
+#include "project/project.h"
+#include "renderfarm.h"
+
+/**
+ * @brief Claims jobs from the RenderFarm queue and renders them into the shared cache, one after another
+ *
+ * The last project opened is kept open between jobs, since a coordinator usually queues many chunks of the same
+ * sequence. It's opened again if the file has changed since.
+ */
+class FarmWorker : public QObject
+{
+  Q_OBJECT
+public:
+  FarmWorker(QObject* parent = nullptr);
+
+  virtual ~FarmWorker() override;
+
+  /**
+   * @brief Render jobs as they're queued, never returns unless there's no shared cache to take jobs from
+   *
+   * Needs an OpenGL context to be current, which the render workers share with.
+   */
+  bool Run();
+
+  /**
+   * @brief Milliseconds to wait before looking for jobs again when there weren't any
+   */
+  static const int kPollInterval = 2000;
+
+private:
+  bool RenderJob(const RenderFarm::Job& job);
+
+  /**
+   * @brief Find the sequence with this UUID (or name) in `project`, opening the project if it isn't the one already open
+   */
+  Sequence* OpenSequence(const QString& project, const QUuid& uuid, const QString& name);
+
+  /**
+   * @brief Point the backend at `viewer`, closing it first if it was rendering another one
+   */
+  void SetViewer(ViewerOutput* viewer);
+
+  void CloseProject();
+
+  static void Wait(int msecs);
+
+  ProjectPtr project_;
+
+  QString project_filename_;
+
+  QDateTime project_modified_;
+
+  ViewerOutput* viewer_;
+
+  FarmVideoBackend backend_;
+
+  /**
+   * @brief The job file of the job being rendered
+   */
+  QString claim_;
+
+  QTimer refresh_timer_;
+
+private slots:
+  /**
+   * @brief Keep the coordinator from handing the job being rendered to another worker
+   */
+  void RefreshClaim();
+
+};
+
+#endif // FARMWORKER_H
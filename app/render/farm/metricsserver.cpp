@@ -0,0 +1,430 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "metricsserver.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTcpSocket>
+#include <QTimer>
+
+#include "common/memorybudget.h"
+#include "common/metrics.h"
+#include "common/tracer.h"
+#include "render/backend/opengl/openglmemorybudget.h"
+#include "render/renderbudget.h"
+#include "task/taskmanager.h"
+
+MetricsServer* MetricsServer::instance_ = nullptr;
+
+namespace {
+
+typedef QList< QPair<QString, QString> > Labels;
+
+struct Sample {
+  /// Appended to the family's name, e.g. "_bucket" for histograms
+  QString suffix;
+
+  Labels labels;
+
+  double value;
+};
+
+struct Family {
+  QString name;
+  QString type;
+  QString help;
+  QList<Sample> samples;
+};
+
+Family MakeFamily(const QString& name, const QString& type, const QString& help)
+{
+  Family f;
+  f.name = name;
+  f.type = type;
+  f.help = help;
+  return f;
+}
+
+void AddSample(Family* family, const Labels& labels, double value, const QString& suffix = QString())
+{
+  Sample s;
+  s.suffix = suffix;
+  s.labels = labels;
+  s.value = value;
+  family->samples.append(s);
+}
+
+Labels Label(const QString& name, const QString& value)
+{
+  Labels labels;
+  labels.append(qMakePair(name, value));
+  return labels;
+}
+
+/**
+ * @brief Names MemoryBudget's categories without translating them, since they're label values
+ */
+QString MemoryCategoryLabel(MemoryBudget::Category category)
+{
+  switch (category) {
+  case MemoryBudget::kFrames:
+    return QStringLiteral("frames");
+  case MemoryBudget::kFileBuffers:
+    return QStringLiteral("file_buffers");
+  case MemoryBudget::kReverseFrames:
+    return QStringLiteral("reverse_frames");
+  case MemoryBudget::kFrameCache:
+    return QStringLiteral("frame_cache");
+  case MemoryBudget::kUndo:
+    return QStringLiteral("undo");
+  case MemoryBudget::kCategoryCount:
+    break;
+  }
+
+  return QString();
+}
+
+QList<Family> CollectMetrics()
+{
+  QList<Family> families;
+
+  Family frames = MakeFamily("olive_frames_rendered_total", "counter",
+                             "Frames rendered rather than found already cached");
+  AddSample(&frames, Labels(), static_cast<double>(Metrics::Value(Metrics::kFramesRendered)));
+  families.append(frames);
+
+  Family memory_cache = MakeFamily("olive_frame_memory_cache_lookups_total", "counter",
+                                   "Frames looked up in the in-memory frame cache");
+  AddSample(&memory_cache, Label("result", "hit"),
+            static_cast<double>(Metrics::Value(Metrics::kFrameCacheMemoryHits)));
+  AddSample(&memory_cache, Label("result", "miss"),
+            static_cast<double>(Metrics::Value(Metrics::kFrameCacheMemoryMisses)));
+  families.append(memory_cache);
+
+  Family frame_cache = MakeFamily("olive_frame_cache_lookups_total", "counter",
+                                  "Frames looked up in the disk cache, by where they were found");
+  AddSample(&frame_cache, Label("result", "disk"), static_cast<double>(Metrics::Value(Metrics::kFrameCacheDiskHits)));
+  AddSample(&frame_cache, Label("result", "shared"),
+            static_cast<double>(Metrics::Value(Metrics::kFrameCacheSharedHits)));
+  AddSample(&frame_cache, Label("result", "miss"), static_cast<double>(Metrics::Value(Metrics::kFrameCacheMisses)));
+  families.append(frame_cache);
+
+  Family decoders = MakeFamily("olive_decoder_cache_lookups_total", "counter",
+                               "Decoders taken from the decoder cache (hit) or opened because none was free (miss)");
+  AddSample(&decoders, Label("result", "hit"), static_cast<double>(Metrics::Value(Metrics::kDecoderCacheHits)));
+  AddSample(&decoders, Label("result", "miss"), static_cast<double>(Metrics::Value(Metrics::kDecoderCacheMisses)));
+  families.append(decoders);
+
+  Family writes = MakeFamily("olive_frame_writes_queued", "gauge", "Rendered frames waiting to be written to disk");
+  AddSample(&writes, Labels(), static_cast<double>(Metrics::Value(Metrics::kFrameWritesQueued)));
+  families.append(writes);
+
+  Family slots_total = MakeFamily("olive_render_slots", "gauge", "Jobs the render budget lets run at once");
+  Family slots_used = MakeFamily("olive_render_slots_in_use", "gauge", "Render budget slots taken right now");
+  Family slots_waiting = MakeFamily("olive_render_slots_waiting", "gauge", "Jobs waiting for a render budget slot");
+
+  AddSample(&slots_total, Label("resource", "cpu"), RenderBudget::ThreadCount());
+  AddSample(&slots_total, Label("resource", "gpu"), RenderBudget::GPUContextCount());
+  AddSample(&slots_used, Label("resource", "cpu"), RenderBudget::InUse(RenderBudget::kCPU));
+  AddSample(&slots_used, Label("resource", "gpu"), RenderBudget::InUse(RenderBudget::kGPU));
+  AddSample(&slots_waiting, Label("resource", "cpu"), RenderBudget::Waiting(RenderBudget::kCPU));
+  AddSample(&slots_waiting, Label("resource", "gpu"), RenderBudget::Waiting(RenderBudget::kGPU));
+
+  families.append(slots_total);
+  families.append(slots_used);
+  families.append(slots_waiting);
+
+  Family memory = MakeFamily("olive_memory_used_bytes", "gauge", "Memory held by caches and pools");
+
+  for (int i=0;i<MemoryBudget::kCategoryCount;i++) {
+    MemoryBudget::Category category = static_cast<MemoryBudget::Category>(i);
+
+    AddSample(&memory, Label("category", MemoryCategoryLabel(category)),
+              static_cast<double>(MemoryBudget::Used(category)));
+  }
+
+  families.append(memory);
+
+  Family memory_limit = MakeFamily("olive_memory_limit_bytes", "gauge",
+                                   "Memory caches and pools are asked to stay under");
+  AddSample(&memory_limit, Labels(), static_cast<double>(MemoryBudget::Limit()));
+  families.append(memory_limit);
+
+  Family gpu = MakeFamily("olive_gpu_memory_allocated_bytes", "gauge", "GPU memory allocated by the renderers");
+  AddSample(&gpu, Labels(), static_cast<double>(OpenGLMemoryBudget::TotalAllocatedBytes()));
+  families.append(gpu);
+
+  Family gpu_budget = MakeFamily("olive_gpu_memory_budget_bytes", "gauge", "GPU memory the renderers stay under");
+  AddSample(&gpu_budget, Labels(), static_cast<double>(OpenGLMemoryBudget::Budget()));
+  families.append(gpu_budget);
+
+  Family tasks = MakeFamily("olive_tasks", "gauge", "Tasks in the task queue, by status");
+  AddSample(&tasks, Label("status", "waiting"), olive::task_manager.TaskCount(Task::kWaiting));
+  AddSample(&tasks, Label("status", "working"), olive::task_manager.TaskCount(Task::kWorking));
+  AddSample(&tasks, Label("status", "finished"), olive::task_manager.TaskCount(Task::kFinished));
+  AddSample(&tasks, Label("status", "error"), olive::task_manager.TaskCount(Task::kError));
+  families.append(tasks);
+
+  Family stages = MakeFamily("olive_stage_duration_seconds", "histogram", "How long each traced stage took");
+
+  foreach (const Tracer::Histogram& h, Tracer::Histograms()) {
+    Labels labels;
+    labels.append(qMakePair(QStringLiteral("category"), h.category));
+
+    // Stages timed with a name that changes are counted together
+    labels.append(qMakePair(QStringLiteral("stage"), h.name.isEmpty() ? QStringLiteral("other") : h.name));
+
+    // Prometheus buckets are cumulative
+    quint64 cumulative = 0;
+
+    for (int i=0;i<h.counts.size();i++) {
+      cumulative += h.counts.at(i);
+
+      QString le = (i < Tracer::kHistogramBucketCount)
+          ? QString::number(static_cast<double>(Tracer::kHistogramBounds[i]) / 1000000.0)
+          : QStringLiteral("+Inf");
+
+      Labels bucket_labels = labels;
+      bucket_labels.append(qMakePair(QStringLiteral("le"), le));
+
+      AddSample(&stages, bucket_labels, static_cast<double>(cumulative), "_bucket");
+    }
+
+    AddSample(&stages, labels, static_cast<double>(h.total) / 1000000.0, "_sum");
+    AddSample(&stages, labels, static_cast<double>(h.count), "_count");
+  }
+
+  families.append(stages);
+
+  return families;
+}
+
+QString EscapeLabelValue(QString value)
+{
+  value.replace('\\', QStringLiteral("\\\\"));
+  value.replace('"', QStringLiteral("\\\""));
+  value.replace('\n', QStringLiteral("\\n"));
+  return value;
+}
+
+}
+
+void MetricsServer::CreateInstance()
+{
+  if (instance_ == nullptr) {
+    instance_ = new MetricsServer();
+  }
+}
+
+MetricsServer *MetricsServer::instance()
+{
+  return instance_;
+}
+
+void MetricsServer::DestroyInstance()
+{
+  delete instance_;
+  instance_ = nullptr;
+}
+
+bool MetricsServer::Listen(const QHostAddress &address, quint16 port)
+{
+  if (!server_.listen(address, port)) {
+    return false;
+  }
+
+  Tracer::SetHistogramsEnabled(true);
+
+  return true;
+}
+
+QString MetricsServer::GetError() const
+{
+  return server_.errorString();
+}
+
+MetricsServer::MetricsServer()
+{
+  connect(&server_, SIGNAL(newConnection()), this, SLOT(NewConnection()));
+}
+
+QByteArray MetricsServer::PrometheusText()
+{
+  QString text;
+
+  foreach (const Family& f, CollectMetrics()) {
+    text.append(QStringLiteral("# HELP %1 %2\n").arg(f.name, f.help));
+    text.append(QStringLiteral("# TYPE %1 %2\n").arg(f.name, f.type));
+
+    foreach (const Sample& s, f.samples) {
+      text.append(f.name);
+      text.append(s.suffix);
+
+      if (!s.labels.isEmpty()) {
+        QStringList labels;
+
+        for (int i=0;i<s.labels.size();i++) {
+          labels.append(QStringLiteral("%1=\"%2\"").arg(s.labels.at(i).first,
+                                                        EscapeLabelValue(s.labels.at(i).second)));
+        }
+
+        text.append('{');
+        text.append(labels.join(','));
+        text.append('}');
+      }
+
+      text.append(' ');
+      text.append(QString::number(s.value, 'g', 15));
+      text.append('\n');
+    }
+  }
+
+  return text.toUtf8();
+}
+
+QByteArray MetricsServer::Json()
+{
+  QJsonArray metrics;
+
+  foreach (const Family& f, CollectMetrics()) {
+    QJsonArray samples;
+
+    foreach (const Sample& s, f.samples) {
+      QJsonObject labels;
+
+      for (int i=0;i<s.labels.size();i++) {
+        labels.insert(s.labels.at(i).first, s.labels.at(i).second);
+      }
+
+      QJsonObject sample;
+      sample.insert("name", f.name + s.suffix);
+      sample.insert("labels", labels);
+      sample.insert("value", s.value);
+      samples.append(sample);
+    }
+
+    QJsonObject family;
+    family.insert("name", f.name);
+    family.insert("type", f.type);
+    family.insert("help", f.help);
+    family.insert("samples", samples);
+    metrics.append(family);
+  }
+
+  QJsonObject root;
+  root.insert("metrics", metrics);
+
+  return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+void MetricsServer::Respond(QTcpSocket *socket, const QByteArray &status, const QByteArray &content_type,
+                            const QByteArray &body)
+{
+  QByteArray response = "HTTP/1.1 " + status + "\r\n";
+  response += "Content-Type: " + content_type + "\r\n";
+  response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+  response += "Connection: close\r\n\r\n";
+  response += body;
+
+  socket->write(response);
+
+  // Waits for everything to be written before closing
+  socket->disconnectFromHost();
+}
+
+void MetricsServer::NewConnection()
+{
+  while (server_.hasPendingConnections()) {
+    QTcpSocket* socket = server_.nextPendingConnection();
+
+    connect(socket, SIGNAL(readyRead()), this, SLOT(ReadRequest()));
+    connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+
+    // Owned by the socket so it goes away with it
+    QTimer* timeout = new QTimer(socket);
+    timeout->setSingleShot(true);
+    timeout->setInterval(kRequestTimeout);
+    connect(timeout, SIGNAL(timeout()), this, SLOT(RequestTimedOut()));
+    timeout->start();
+  }
+}
+
+void MetricsServer::ReadRequest()
+{
+  QTcpSocket* socket = static_cast<QTcpSocket*>(sender());
+
+  // Leave the request in the socket's buffer until all of its headers have arrived
+  QByteArray request = socket->peek(kMaxRequestSize);
+
+  int header_end = request.indexOf("\r\n\r\n");
+
+  if (header_end < 0) {
+    if (request.size() >= kMaxRequestSize) {
+      socket->abort();
+    }
+
+    return;
+  }
+
+  socket->readAll();
+
+  // Don't answer anything else that arrives on this connection
+  disconnect(socket, SIGNAL(readyRead()), this, SLOT(ReadRequest()));
+
+  // The request made it in time, don't cut off the response
+  QTimer* timeout = socket->findChild<QTimer*>();
+  if (timeout) {
+    timeout->stop();
+  }
+
+  // e.g. "GET /metrics HTTP/1.1"
+  QList<QByteArray> request_line = request.left(request.indexOf("\r\n")).split(' ');
+
+  if (request_line.size() < 2 || request_line.at(0) != "GET") {
+    Respond(socket, "405 Method Not Allowed", "text/plain", "Only GET is supported\n");
+    return;
+  }
+
+  QByteArray path = request_line.at(1);
+
+  // Ignore any query string
+  int query = path.indexOf('?');
+  if (query >= 0) {
+    path.truncate(query);
+  }
+
+  if (path == "/metrics") {
+    Respond(socket, "200 OK", "text/plain; version=0.0.4; charset=utf-8", PrometheusText());
+  } else if (path == "/metrics.json") {
+    Respond(socket, "200 OK", "application/json", Json());
+  } else {
+    Respond(socket, "404 Not Found", "text/plain", "Not found\n");
+  }
+}
+
+void MetricsServer::RequestTimedOut()
+{
+  QTcpSocket* socket = static_cast<QTcpSocket*>(sender()->parent());
+
+  // Disconnects, which deletes the socket
+  socket->abort();
+}
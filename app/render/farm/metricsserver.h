@@ -0,0 +1,96 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QHostAddress>
+#include <QTcpServer>
+
+/**
+ * @brief Serves the render node's metrics over HTTP for monitoring (e.g. Prometheus) to scrape
+ *
+ * GET /metrics returns the Prometheus text format and GET /metrics.json returns the same metrics as JSON. They cover
+ * the counters in Metrics, how busy RenderBudget is, memory and GPU memory use, the TaskManager queue and the
+ * Tracer's stage histograms (which are enabled once the server is listening).
+ *
+ * Requests are answered in the main thread, which headless renders keep servicing while they wait on the workers.
+ * Connections that haven't sent a whole request within kRequestTimeout are closed so idle clients can't pile up.
+ */
+class MetricsServer : public QObject
+{
+  Q_OBJECT
+public:
+  static void CreateInstance();
+
+  static MetricsServer* instance();
+
+  static void DestroyInstance();
+
+  /**
+   * @brief Start accepting requests on `port` on `address`
+   *
+   * Core only binds to localhost unless it's explicitly given another address, since the metrics aren't authenticated.
+   *
+   * @return
+   *
+   * FALSE if the port couldn't be bound.
+   */
+  bool Listen(const QHostAddress& address, quint16 port);
+
+  QString GetError() const;
+
+  /**
+   * @brief Requests with headers longer than this are dropped
+   */
+  static const int kMaxRequestSize = 8192;
+
+  /**
+   * @brief Milliseconds a connection has to send its request headers before it's closed
+   */
+  static const int kRequestTimeout = 5000;
+
+private:
+  MetricsServer();
+
+  /**
+   * @brief Every metric in the Prometheus text exposition format (version 0.0.4)
+   */
+  static QByteArray PrometheusText();
+
+  static QByteArray Json();
+
+  static void Respond(QTcpSocket* socket, const QByteArray& status, const QByteArray& content_type,
+                      const QByteArray& body);
+
+  static MetricsServer* instance_;
+
+  QTcpServer server_;
+
+private slots:
+  void NewConnection();
+
+  void ReadRequest();
+
+  void RequestTimedOut();
+
+};
+
+#endif // METRICSSERVER_H
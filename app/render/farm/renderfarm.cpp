@@ -0,0 +1,299 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "renderfarm.h"
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSysInfo>
+
+#include "common/filefunctions.h"
+#include "common/timecodefunctions.h"
+#include "config/config.h"
+
+QString RenderFarm::job_folder_;
+
+QString RenderFarm::JobFolder()
+{
+  if (!job_folder_.isEmpty()) {
+    return job_folder_;
+  }
+
+  QString shared = Config::Current()["SharedCachePath"].toString();
+
+  if (shared.isEmpty()) {
+    return QString();
+  }
+
+  return QDir(shared).filePath("farm");
+}
+
+void RenderFarm::SetJobFolder(const QString &folder)
+{
+  job_folder_ = folder;
+}
+
+QString RenderFarm::LocalJobFolder()
+{
+  return QDir(GetMediaCacheLocation()).filePath("farm");
+}
+
+QList<TimeRange> RenderFarm::SplitIntoChunks(const TimeRangeList &ranges,
+                                             const rational &chunk_length,
+                                             const rational &timebase)
+{
+  QList<TimeRange> chunks;
+
+  int64_t chunk_frames = qMax(static_cast<int64_t>(1), olive::time_to_timestamp(chunk_length, timebase));
+
+  foreach (const TimeRange& range, ranges.ranges()) {
+    int64_t first = olive::time_to_timestamp(range.in(), timebase);
+    int64_t end = olive::time_to_timestamp(range.out(), timebase);
+
+    // Include a frame the range only covers part of
+    if (olive::timestamp_to_time(end, timebase) < range.out()) {
+      end++;
+    }
+
+    for (int64_t i=first;i<end;i+=chunk_frames) {
+      chunks.append(TimeRange(olive::timestamp_to_time(i, timebase),
+                              olive::timestamp_to_time(qMin(i + chunk_frames, end), timebase)));
+    }
+  }
+
+  return chunks;
+}
+
+bool RenderFarm::QueueJobs(const QString &project,
+                           Sequence *sequence,
+                           const QList<TimeRange> &chunks,
+                           QStringList *job_names,
+                           QString *error)
+{
+  QDir folder(JobFolder());
+
+  if (folder.path().isEmpty() || !folder.mkpath(".")) {
+    *error = QCoreApplication::translate("RenderFarm", "There's no shared cache folder to queue jobs in");
+    return false;
+  }
+
+  // Names sort in the order jobs were queued, so workers take the oldest first and a sequence's chunks in order
+  QString prefix = QStringLiteral("%1-%2").arg(QDateTime::currentMSecsSinceEpoch(), 13, 10, QChar('0'))
+                                          .arg(sequence->uuid().toString().mid(1, 36));
+
+  Job job;
+  job.project = QFileInfo(project).absoluteFilePath();
+  job.sequence = sequence->uuid();
+  job.sequence_name = sequence->name();
+
+  job_names->clear();
+
+  for (int i=0;i<chunks.size();i++) {
+    QString name = QStringLiteral("%1-%2.job").arg(prefix).arg(i, 6, 10, QChar('0'));
+
+    job.range = chunks.at(i);
+
+    if (!WriteJob(folder.filePath(name), job)) {
+      *error = QCoreApplication::translate("RenderFarm", "Failed to write job file %1").arg(folder.filePath(name));
+
+      // Take back what's been queued so far, unless a worker has already claimed it
+      foreach (const QString& queued, *job_names) {
+        QFile::remove(folder.filePath(queued));
+      }
+
+      job_names->clear();
+      return false;
+    }
+
+    job_names->append(name);
+  }
+
+  return true;
+}
+
+int RenderFarm::JobsRemaining(const QStringList &job_names)
+{
+  QDir folder(JobFolder());
+
+  int remaining = 0;
+
+  foreach (const QString& name, job_names) {
+    // Queued, or claimed by a worker under the same name with its suffix
+    if (folder.exists(name) || !folder.entryList({name + ".*"}, QDir::Files).isEmpty()) {
+      remaining++;
+    }
+  }
+
+  return remaining;
+}
+
+void RenderFarm::ReclaimStaleJobs(const QStringList &job_names)
+{
+  QDir folder(JobFolder());
+
+  QDateTime stale_before = QDateTime::currentDateTime().addMSecs(-kClaimTimeout);
+
+  foreach (const QString& name, job_names) {
+    QFileInfoList claims = folder.entryInfoList({name + ".*"}, QDir::Files);
+
+    foreach (const QFileInfo& claim, claims) {
+      if (claim.lastModified() < stale_before && QFile::rename(claim.filePath(), folder.filePath(name))) {
+        qWarning() << "Putting" << name << "back in the queue, the worker that claimed it has stopped responding";
+      }
+    }
+  }
+}
+
+bool RenderFarm::ClaimJob(RenderFarm::Job *job, QString *claim)
+{
+  QString folder_path = JobFolder();
+
+  if (folder_path.isEmpty()) {
+    return false;
+  }
+
+  QDir folder(folder_path);
+
+  QStringList jobs = folder.entryList({"*.job"}, QDir::Files, QDir::Name);
+
+  foreach (const QString& name, jobs) {
+    QString claimed = folder.filePath(name + ClaimSuffix());
+
+    // Renaming only succeeds for one worker, the others move on to the next job
+    if (!QFile::rename(folder.filePath(name), claimed)) {
+      continue;
+    }
+
+    if (!ReadJob(claimed, job)) {
+      qWarning() << "Removing unreadable job file" << name;
+      QFile::remove(claimed);
+      continue;
+    }
+
+    *claim = claimed;
+    return true;
+  }
+
+  return false;
+}
+
+void RenderFarm::RefreshClaim(const QString &claim)
+{
+  QFile file(claim);
+
+  if (!file.open(QFile::ReadWrite)) {
+    return;
+  }
+
+  // Writing the contents back updates the modification time, which is what ReclaimStaleJobs() checks
+  QByteArray contents = file.readAll();
+  file.seek(0);
+  file.write(contents);
+}
+
+void RenderFarm::FinishJob(const QString &claim)
+{
+  QFile::remove(claim);
+}
+
+void RenderFarm::ReleaseJob(const QString &claim)
+{
+  QString name = claim;
+  name.chop(ClaimSuffix().size());
+
+  QFile::rename(claim, name);
+}
+
+void RenderFarm::ReleaseJobsOfProcess(qint64 pid)
+{
+  QDir folder(JobFolder());
+
+  QString suffix = ClaimSuffix(pid);
+
+  foreach (const QString& claim, folder.entryList({"*.job" + suffix}, QDir::Files)) {
+    if (QFile::rename(folder.filePath(claim), folder.filePath(claim.left(claim.size() - suffix.size())))) {
+      qWarning() << "Putting" << claim << "back in the queue, the worker that claimed it has exited";
+    }
+  }
+}
+
+QString RenderFarm::ClaimSuffix()
+{
+  return ClaimSuffix(QCoreApplication::applicationPid());
+}
+
+QString RenderFarm::ClaimSuffix(qint64 pid)
+{
+  return QStringLiteral(".%1-%2").arg(QSysInfo::machineHostName(), QString::number(pid));
+}
+
+bool RenderFarm::WriteJob(const QString &filename, const RenderFarm::Job &job)
+{
+  // Written in one go so a worker never claims a half-written job
+  QSaveFile file(filename);
+
+  if (!file.open(QFile::WriteOnly)) {
+    return false;
+  }
+
+  QDataStream ds(&file);
+
+  ds << kJobMagic << kJobVersion << job.project << job.sequence << job.sequence_name
+     << static_cast<qint64>(job.range.in().numerator()) << static_cast<qint64>(job.range.in().denominator())
+     << static_cast<qint64>(job.range.out().numerator()) << static_cast<qint64>(job.range.out().denominator());
+
+  return ds.status() == QDataStream::Ok && file.commit();
+}
+
+bool RenderFarm::ReadJob(const QString &filename, RenderFarm::Job *job)
+{
+  QFile file(filename);
+
+  if (!file.open(QFile::ReadOnly)) {
+    return false;
+  }
+
+  QDataStream ds(&file);
+
+  quint32 magic, version;
+  qint64 in_num, in_den, out_num, out_den;
+
+  ds >> magic >> version;
+
+  if (ds.status() != QDataStream::Ok || magic != kJobMagic || version != kJobVersion) {
+    return false;
+  }
+
+  ds >> job->project >> job->sequence >> job->sequence_name >> in_num >> in_den >> out_num >> out_den;
+
+  if (ds.status() != QDataStream::Ok || in_den == 0 || out_den == 0) {
+    return false;
+  }
+
+  job->range = TimeRange(rational(in_num, in_den), rational(out_num, out_den));
+
+  return true;
+}
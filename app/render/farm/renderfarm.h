@@ -0,0 +1,171 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef RENDERFARM_H
+#define RENDERFARM_H
+
+#include <QStringList>
+
+#include "common/timerange.h"
+#include "project/item/sequence/sequence.h"
+
+/**
+ * @brief A queue of sequence chunks to render, shared by every machine that can see the shared cache
+ *
+ * There's no server. A coordinator (started with --distribute) writes a job file for each chunk into JobFolder(),
+ * and any number of workers (started with --worker) claim them by renaming them, which only one of them can do. A
+ * worker renders its chunk into the shared cache and deletes the job file, so once every job file is gone the
+ * whole sequence can be played or exported from the shared cache on any machine.
+ *
+ * Workers open the project from the path the coordinator saw it at, so it has to be on a share mounted at the same
+ * path everywhere.
+ */
+class RenderFarm
+{
+public:
+  struct Job {
+    /// Absolute path of the project file
+    QString project;
+
+    /// Sequence::uuid() of the sequence to render
+    QUuid sequence;
+
+    /// Name of the sequence to render, for projects saved before sequences had a UUID (which get a new one whenever
+    /// they're opened)
+    QString sequence_name;
+
+    TimeRange range;
+  };
+
+  /**
+   * @brief Folder the job files are kept in, or an empty string if there's no shared cache to render into
+   */
+  static QString JobFolder();
+
+  /**
+   * @brief Keep job files in this folder rather than next to the shared cache (an empty string goes back to that)
+   *
+   * For worker processes started on this machine (see FarmProcessPool), which can take jobs from a local folder and
+   * render into the local cache when there's no shared one.
+   */
+  static void SetJobFolder(const QString& folder);
+
+  /**
+   * @brief Folder worker processes on this machine take jobs from when there's no shared cache
+   */
+  static QString LocalJobFolder();
+
+  /**
+   * @brief Split `ranges` into chunks of about `chunk_length` for workers to render one at a time
+   *
+   * Chunks start and end on frame boundaries of `timebase`, so neighbouring chunks never render the same frame.
+   * Chunks follow on from each other in the same order as `ranges`.
+   */
+  static QList<TimeRange> SplitIntoChunks(const TimeRangeList& ranges,
+                                          const rational& chunk_length,
+                                          const rational& timebase);
+
+  /**
+   * @brief Write a job file for each chunk
+   *
+   * @param job_names
+   *
+   * Filled with the names of the job files, to check on them with JobsRemaining().
+   *
+   * @return
+   *
+   * FALSE if a job file couldn't be written, in which case `error` is set and none of the jobs are queued.
+   */
+  static bool QueueJobs(const QString& project,
+                        Sequence* sequence,
+                        const QList<TimeRange>& chunks,
+                        QStringList* job_names,
+                        QString* error);
+
+  /**
+   * @brief Returns how many of these jobs haven't been finished yet (whether or not they've been claimed)
+   */
+  static int JobsRemaining(const QStringList& job_names);
+
+  /**
+   * @brief Put any of these jobs back in the queue if the worker that claimed them hasn't been heard from in
+   * kClaimTimeout (e.g. because it crashed)
+   */
+  static void ReclaimStaleJobs(const QStringList& job_names);
+
+  /**
+   * @brief Claim the oldest job in the queue
+   *
+   * @param claim
+   *
+   * Set to the claimed job file, which must be passed to FinishJob() or ReleaseJob() afterwards.
+   *
+   * @return
+   *
+   * FALSE if there's nothing to claim.
+   */
+  static bool ClaimJob(Job* job, QString* claim);
+
+  /**
+   * @brief Tell the coordinator the worker that claimed this job is still working on it
+   *
+   * Has to be called more often than kClaimTimeout.
+   */
+  static void RefreshClaim(const QString& claim);
+
+  /**
+   * @brief Remove a job that's been rendered from the queue
+   */
+  static void FinishJob(const QString& claim);
+
+  /**
+   * @brief Put a job that couldn't be rendered back in the queue for another worker
+   */
+  static void ReleaseJob(const QString& claim);
+
+  /**
+   * @brief Put every job claimed by the worker process with this ID on this machine back in the queue
+   *
+   * For when it's known to have exited without finishing them, so they don't wait for kClaimTimeout.
+   */
+  static void ReleaseJobsOfProcess(qint64 pid);
+
+  /**
+   * @brief Milliseconds after a claim was last refreshed before its job is put back in the queue
+   */
+  static const int kClaimTimeout = 600000;
+
+private:
+  static QString ClaimSuffix();
+
+  static QString ClaimSuffix(qint64 pid);
+
+  static QString job_folder_;
+
+  static bool WriteJob(const QString& filename, const Job& job);
+
+  static bool ReadJob(const QString& filename, Job* job);
+
+  static const quint32 kJobMagic = 0x4F464A42; // "OFJB"
+  static const quint32 kJobVersion = 1;
+
+};
+
+#endif // RENDERFARM_H
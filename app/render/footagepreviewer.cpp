@@ -0,0 +1,454 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "footagepreviewer.h"
+
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
+#include <QtMath>
+
+#include "decoder/decoder.h"
+#include "project/item/footage/footage.h"
+#include "render/pixelservice.h"
+
+namespace {
+
+/**
+ * @brief Decodes one angle of a multicam grid, run on the global thread pool so the angles decode side by side
+ */
+class DecodeAngleTask : public QRunnable
+{
+public:
+  DecodeAngleTask(DecoderPtr decoder, const rational& time, int divider, FramePtr* frame, QSemaphore* finished) :
+    decoder_(decoder),
+    time_(time),
+    divider_(divider),
+    frame_(frame),
+    finished_(finished)
+  {
+  }
+
+  virtual void run() override
+  {
+    *frame_ = decoder_->RetrieveVideo(time_, divider_);
+
+    if (finished_ != nullptr) {
+      finished_->release();
+    }
+  }
+
+private:
+  DecoderPtr decoder_;
+
+  rational time_;
+
+  int divider_;
+
+  FramePtr* frame_;
+
+  QSemaphore* finished_;
+
+};
+
+DecoderPtr OpenDecoder(StreamPtr stream)
+{
+  DecoderPtr decoder = Decoder::CreateFromID(stream->footage()->decoder());
+
+  if (decoder != nullptr) {
+    decoder->set_stream(stream);
+  }
+
+  return decoder;
+}
+
+void CloseDecoder(DecoderPtr decoder)
+{
+  if (decoder != nullptr) {
+    decoder->Close();
+  }
+}
+
+/**
+ * @brief Copy `src` into a cell of `dest`, fitted to it with nearest-neighbour sampling and centred
+ */
+void BlitToCell(FramePtr src, FramePtr dest, int x, int y, int width, int height)
+{
+  int bpp = PixelService::BytesPerPixel(dest->format());
+
+  double scale = qMin(static_cast<double>(width) / src->width(), static_cast<double>(height) / src->height());
+  int fit_width = qBound(1, qRound(src->width() * scale), width);
+  int fit_height = qBound(1, qRound(src->height() * scale), height);
+
+  x += (width - fit_width) / 2;
+  y += (height - fit_height) / 2;
+
+  const char* src_data = src->const_data();
+  char* dest_data = dest->data();
+
+  for (int i=0;i<fit_height;i++) {
+    const char* src_row = src_data + (i * src->height() / fit_height) * src->width() * bpp;
+    char* dest_row = dest_data + ((y + i) * dest->width() + x) * bpp;
+
+    for (int j=0;j<fit_width;j++) {
+      memcpy(dest_row + j * bpp, src_row + (j * src->width() / fit_width) * bpp, static_cast<size_t>(bpp));
+    }
+  }
+}
+
+/**
+ * @brief Decode every angle at this time, composited into a grid `width` by `height` if there's more than one
+ *
+ * @return
+ *
+ * nullptr if none of the angles have a frame at this time.
+ */
+FramePtr DecodeAngles(const QVector<DecoderPtr>& decoders, const rational& time, int width, int height)
+{
+  if (decoders.size() == 1) {
+    return (decoders.first() != nullptr) ? decoders.first()->RetrieveVideo(time, 1) : nullptr;
+  }
+
+  int columns = FootagePreviewer::GridColumns(decoders.size());
+  int rows = (decoders.size() + columns - 1) / columns;
+
+  QVector<FramePtr> frames(decoders.size());
+
+  QSemaphore finished;
+  int started = 0;
+
+  // Hand every angle except the first to the thread pool, this thread decodes the first while it waits
+  for (int i=1;i<decoders.size();i++) {
+    if (decoders.at(i) != nullptr) {
+      QThreadPool::globalInstance()->start(new DecodeAngleTask(decoders.at(i), time, columns, &frames[i], &finished));
+      started++;
+    }
+  }
+
+  if (decoders.first() != nullptr) {
+    DecodeAngleTask first_angle(decoders.first(), time, columns, &frames[0], nullptr);
+    first_angle.run();
+  }
+
+  finished.acquire(started);
+
+  FramePtr grid;
+
+  for (int i=0;i<frames.size();i++) {
+    if (frames.at(i) == nullptr) {
+      continue;
+    }
+
+    if (grid == nullptr) {
+      grid = Frame::Create();
+      grid->set_width(width);
+      grid->set_height(height);
+      grid->set_format(frames.at(i)->format());
+      grid->set_timestamp(time);
+      grid->allocate();
+
+      memset(grid->data(), 0, static_cast<size_t>(grid->allocated_size()));
+    }
+
+    FramePtr angle = frames.at(i);
+
+    if (angle->format() != grid->format()) {
+      angle = PixelService::ConvertPixelFormat(angle, grid->format());
+    }
+
+    BlitToCell(angle,
+               grid,
+               (i % columns) * width / columns,
+               (i / columns) * height / rows,
+               width / columns,
+               height / rows);
+  }
+
+  return grid;
+}
+
+}
+
+FootagePreviewer::FootagePreviewer(QObject *parent) :
+  QObject(parent),
+  thread_(nullptr),
+  active_angle_(-1),
+  angles_changed_(false),
+  request_direction_(0),
+  has_request_(false),
+  stopping_(false)
+{
+}
+
+FootagePreviewer::~FootagePreviewer()
+{
+  Stop();
+}
+
+void FootagePreviewer::SetStreams(const QList<StreamPtr> &streams)
+{
+  if (streams.isEmpty()) {
+    Stop();
+    return;
+  }
+
+  request_lock_.lock();
+  streams_ = streams;
+  active_angle_ = -1;
+  angles_changed_ = true;
+  has_request_ = false;
+  request_lock_.unlock();
+
+  if (thread_ == nullptr) {
+    stopping_ = false;
+
+    thread_ = new DecoderThread(this);
+
+    // The viewer is waiting on this, so it runs at a normal priority like VideoRenderFrameLoader
+    thread_->start();
+  }
+}
+
+void FootagePreviewer::SetActiveAngle(int angle)
+{
+  request_lock_.lock();
+  active_angle_ = angle;
+  angles_changed_ = true;
+  request_available_.wakeOne();
+  request_lock_.unlock();
+}
+
+int FootagePreviewer::GridColumns(int angle_count)
+{
+  return qMax(1, qCeil(qSqrt(angle_count)));
+}
+
+void FootagePreviewer::Request(const rational &time, int direction)
+{
+  if (thread_ == nullptr) {
+    return;
+  }
+
+  request_lock_.lock();
+
+  request_time_ = time;
+  request_direction_ = direction;
+  has_request_ = true;
+  request_available_.wakeOne();
+
+  request_lock_.unlock();
+}
+
+void FootagePreviewer::Stop()
+{
+  if (thread_ == nullptr) {
+    return;
+  }
+
+  request_lock_.lock();
+  stopping_ = true;
+  has_request_ = false;
+  streams_.clear();
+  active_angle_ = -1;
+  angles_changed_ = false;
+  request_available_.wakeAll();
+  request_lock_.unlock();
+
+  thread_->wait();
+  delete thread_;
+  thread_ = nullptr;
+}
+
+void FootagePreviewer::ProcessRequests()
+{
+  QList<StreamPtr> streams;
+  int active_angle = -1;
+
+  // One reduced decoder per angle for the grid, opened the first time the grid is shown
+  QVector<DecoderPtr> grid_decoders;
+
+  // Switched to whichever angle is shown on its own
+  StreamPtr full_stream;
+  DecoderPtr full_decoder;
+
+  // The decoders frames are currently made from, either grid_decoders or just full_decoder
+  QVector<DecoderPtr> shown_decoders;
+  int grid_width = 0;
+  int grid_height = 0;
+
+  QMap<rational, FramePtr> read_ahead;
+  rational next_read_ahead;
+  rational frame_duration;
+  int read_ahead_direction = 0;
+
+  forever {
+    request_lock_.lock();
+
+    while (!has_request_
+           && !stopping_
+           && !angles_changed_
+           && (read_ahead_direction == 0 || read_ahead.size() >= kReadAheadFrames)) {
+      request_available_.wait(&request_lock_);
+    }
+
+    if (stopping_ || streams_ != streams) {
+      // Either way, the decoders we have are no use any more
+      foreach (DecoderPtr decoder, grid_decoders) {
+        CloseDecoder(decoder);
+      }
+      grid_decoders.clear();
+
+      CloseDecoder(full_decoder);
+      full_decoder = nullptr;
+      full_stream = nullptr;
+
+      foreach (StreamPtr stream, streams) {
+        stream->footage()->UnlockDeletes();
+      }
+
+      streams = streams_;
+
+      // Footage deleted while it's being previewed isn't freed until we're done with it
+      foreach (StreamPtr stream, streams) {
+        stream->footage()->LockDeletes();
+      }
+
+      if (stopping_) {
+        request_lock_.unlock();
+        return;
+      }
+
+      ImageStreamPtr first_stream = std::static_pointer_cast<ImageStream>(streams.first());
+      grid_width = first_stream->width();
+      grid_height = first_stream->height();
+
+      // Stills are the same at every time, so there's nothing to read ahead
+      frame_duration = 0;
+
+      if (first_stream->type() == Stream::kVideo) {
+        const rational& frame_rate = std::static_pointer_cast<VideoStream>(first_stream)->frame_rate();
+
+        if (frame_rate.numerator() > 0) {
+          frame_duration = frame_rate.flipped();
+        }
+      }
+    }
+
+    if (angles_changed_) {
+      angles_changed_ = false;
+      active_angle = active_angle_;
+
+      if (streams.size() > 1 && (active_angle < 0 || active_angle >= streams.size())) {
+        if (grid_decoders.isEmpty()) {
+          foreach (StreamPtr stream, streams) {
+            grid_decoders.append(OpenDecoder(stream));
+          }
+        }
+
+        shown_decoders = grid_decoders;
+      } else {
+        StreamPtr angle_stream = streams.at(qMax(0, active_angle));
+
+        if (full_stream != angle_stream) {
+          CloseDecoder(full_decoder);
+
+          full_stream = angle_stream;
+          full_decoder = OpenDecoder(full_stream);
+        }
+
+        shown_decoders = {full_decoder};
+      }
+
+      // Frames already read ahead are of whatever was shown before
+      read_ahead.clear();
+      read_ahead_direction = 0;
+    }
+
+    bool serve_request = has_request_;
+    rational time = request_time_;
+    int direction = request_direction_;
+    has_request_ = false;
+
+    request_lock_.unlock();
+
+    if (serve_request) {
+      FramePtr frame = read_ahead.take(time);
+
+      if (frame == nullptr) {
+        frame = DecodeAngles(shown_decoders, time, grid_width, grid_height);
+      }
+
+      emit FrameReady(time, frame);
+
+      // Paused viewers don't need the next frame
+      if (frame == nullptr || frame_duration == 0 || direction == 0) {
+        read_ahead.clear();
+        read_ahead_direction = 0;
+        continue;
+      }
+
+      // Drop whatever the playhead has already passed
+      if (direction != read_ahead_direction) {
+        read_ahead.clear();
+      } else if (direction > 0) {
+        while (!read_ahead.isEmpty() && read_ahead.firstKey() < time) {
+          read_ahead.erase(read_ahead.begin());
+        }
+      } else {
+        while (!read_ahead.isEmpty() && read_ahead.lastKey() > time) {
+          read_ahead.erase(--read_ahead.end());
+        }
+      }
+
+      read_ahead_direction = direction;
+
+      // Carry on from the furthest frame we already have
+      if (read_ahead.isEmpty()) {
+        next_read_ahead = time + frame_duration * direction;
+      } else if (direction > 0) {
+        next_read_ahead = read_ahead.lastKey() + frame_duration;
+      } else {
+        next_read_ahead = read_ahead.firstKey() - frame_duration;
+      }
+    } else if (next_read_ahead < 0) {
+      read_ahead_direction = 0;
+    } else {
+      FramePtr frame = DecodeAngles(shown_decoders, next_read_ahead, grid_width, grid_height);
+
+      if (frame == nullptr) {
+        // Reached the end of the stream
+        read_ahead_direction = 0;
+      } else {
+        read_ahead.insert(next_read_ahead, frame);
+        next_read_ahead += frame_duration * read_ahead_direction;
+      }
+    }
+  }
+}
+
+FootagePreviewer::DecoderThread::DecoderThread(FootagePreviewer *previewer) :
+  previewer_(previewer)
+{
+}
+
+void FootagePreviewer::DecoderThread::run()
+{
+  previewer_->ProcessRequests();
+}
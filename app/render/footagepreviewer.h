@@ -0,0 +1,140 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FOOTAGEPREVIEWER_H
+#define FOOTAGEPREVIEWER_H
+
+#include <QMap>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "common/constructors.h"
+#include "common/rational.h"
+#include "decoder/frame.h"
+#include "project/item/footage/stream.h"
+
+/**
+ * @brief Decodes a single stream straight to frames for a viewer, without compiling a node graph or caching to disk
+ *
+ * Previewing footage doesn't need anything the render backends provide, so this keeps one decoder open on a thread of
+ * its own and hands decoded frames back with FrameReady(). Like VideoRenderFrameLoader, a new request replaces one
+ * that hasn't been started yet. While playing, the next few frames in the direction of playback are decoded in
+ * advance so they're ready by the time they're asked for.
+ *
+ * Several streams can be previewed as the angles of a multicam shoot. They're decoded in lockstep, every angle at the
+ * same time side by side on the global thread pool, and composited into one grid frame, so read-ahead covers them all
+ * at once. Grid cells are decoded at a divider rather than full size. Showing a single angle switches to one full size
+ * decoder on that angle.
+ */
+class FootagePreviewer : public QObject
+{
+  Q_OBJECT
+public:
+  FootagePreviewer(QObject* parent = nullptr);
+
+  virtual ~FootagePreviewer() override;
+
+  DISABLE_COPY_MOVE(FootagePreviewer)
+
+  /**
+   * @brief Set the video or image streams to decode, starting the decoder thread if it isn't running yet
+   *
+   * More than one stream is a multicam, shown as a grid until SetActiveAngle() picks one. The first angle sets the
+   * grid's size and frame rate. An empty list closes the decoders and stops the thread.
+   */
+  void SetStreams(const QList<StreamPtr>& streams);
+
+  /**
+   * @brief Show only this angle of a multicam at full size, or the grid of every angle if it's -1 (the default)
+   */
+  void SetActiveAngle(int angle);
+
+  /**
+   * @brief Number of columns (and at most rows) in the grid of this many angles
+   */
+  static int GridColumns(int angle_count);
+
+  /**
+   * @brief Request the frame at this time, replacing any request that hasn't been started yet
+   *
+   * @param direction
+   *
+   * The direction of playback (1 forwards, -1 backwards) to read ahead in, or 0 while paused.
+   */
+  void Request(const rational& time, int direction);
+
+signals:
+  /**
+   * @brief Emitted from the decoder thread when a request has been decoded
+   *
+   * `frame` is nullptr if there's no frame at this time (e.g. it's past the end of the stream).
+   */
+  void FrameReady(const rational& time, FramePtr frame);
+
+private:
+  class DecoderThread : public QThread
+  {
+  public:
+    DecoderThread(FootagePreviewer* previewer);
+
+  protected:
+    virtual void run() override;
+
+  private:
+    FootagePreviewer* previewer_;
+  };
+
+  /**
+   * @brief Main loop of the decoder thread, runs until the stream is set to nullptr
+   */
+  void ProcessRequests();
+
+  /**
+   * @brief Stop the decoder thread, dropping any request that hasn't been started yet
+   */
+  void Stop();
+
+  /**
+   * @brief Frames decoded ahead of the playhead while playing
+   */
+  static const int kReadAheadFrames = 8;
+
+  DecoderThread* thread_;
+
+  QMutex request_lock_;
+  QWaitCondition request_available_;
+
+  QList<StreamPtr> streams_;
+
+  int active_angle_;
+
+  /**
+   * @brief Set when streams_ or active_angle_ change, so the decoder thread switches decoders and drops read-ahead
+   */
+  bool angles_changed_;
+
+  rational request_time_;
+  int request_direction_;
+  bool has_request_;
+  bool stopping_;
+};
+
+#endif // FOOTAGEPREVIEWER_H
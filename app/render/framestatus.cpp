@@ -0,0 +1,133 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "framestatus.h"
+
+#include <limits>
+
+const int64_t FrameStatusMap::kLastFrame = std::numeric_limits<int64_t>::max() - 1;
+
+void FrameStatusMap::Set(int64_t in, int64_t out, olive::FrameStatus status)
+{
+  in = qMax(in, static_cast<int64_t>(0));
+  out = qMin(out, kLastFrame);
+
+  if (out < in) {
+    return;
+  }
+
+  QMap<int64_t, Run>::iterator i = runs_.lowerBound(in);
+
+  // Cut the run that starts before this one short, keeping whatever of it carries on past `out`
+  if (i != runs_.begin()) {
+    QMap<int64_t, Run>::iterator prev = i - 1;
+
+    if (prev.value().out >= in) {
+      Run tail = prev.value();
+
+      prev.value().out = in - 1;
+
+      if (tail.out > out) {
+        runs_.insert(out + 1, tail);
+      }
+    }
+  }
+
+  // Remove the runs that start inside this one, keeping whatever of the last carries on past `out`
+  i = runs_.lowerBound(in);
+
+  while (i != runs_.end() && i.key() <= out) {
+    Run run = i.value();
+
+    i = runs_.erase(i);
+
+    if (run.out > out) {
+      runs_.insert(out + 1, run);
+      break;
+    }
+  }
+
+  if (status == olive::kFrameEmpty) {
+    return;
+  }
+
+  // Merge with the runs either side if they're in the same state
+  i = runs_.lowerBound(in);
+
+  if (i != runs_.end() && i.key() == out + 1 && i.value().status == status) {
+    out = i.value().out;
+    i = runs_.erase(i);
+  }
+
+  if (i != runs_.begin()) {
+    QMap<int64_t, Run>::iterator prev = i - 1;
+
+    if (prev.value().out == in - 1 && prev.value().status == status) {
+      prev.value().out = out;
+      return;
+    }
+  }
+
+  Run run;
+  run.out = out;
+  run.status = status;
+
+  runs_.insert(in, run);
+}
+
+void FrameStatusMap::Apply(const FrameStatusSpans &spans)
+{
+  foreach (const FrameStatusSpan& span, spans) {
+    Set(span.in, span.out, span.status);
+  }
+}
+
+void FrameStatusMap::Clear()
+{
+  runs_.clear();
+}
+
+bool FrameStatusMap::isEmpty() const
+{
+  return runs_.isEmpty();
+}
+
+FrameStatusSpans FrameStatusMap::Spans(int64_t in, int64_t out) const
+{
+  FrameStatusSpans spans;
+
+  QMap<int64_t, Run>::const_iterator i = runs_.upperBound(in);
+
+  // The run before may reach into the range
+  if (i != runs_.constBegin() && (i - 1).value().out >= in) {
+    i--;
+  }
+
+  for (;i!=runs_.constEnd() && i.key() <= out;i++) {
+    FrameStatusSpan span;
+    span.in = qMax(in, i.key());
+    span.out = qMin(out, i.value().out);
+    span.status = i.value().status;
+
+    spans.append(span);
+  }
+
+  return spans;
+}
@@ -0,0 +1,107 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FRAMESTATUS_H
+#define FRAMESTATUS_H
+
+#include <QMap>
+#include <QVector>
+
+namespace olive {
+
+/**
+ * @brief Where a frame of a viewer is in the render and cache pipeline
+ */
+enum FrameStatus {
+  /// Not cached and not going to be (e.g. past the end of the sequence, or blank)
+  kFrameEmpty,
+
+  /// Invalidated and waiting to be rendered
+  kFrameQueued,
+
+  /// Taken out of the queue by a worker and not cached yet
+  kFrameRendering,
+
+  /// Cached and ready to be shown without rendering
+  kFrameCached
+};
+
+}
+
+/**
+ * @brief A run of consecutive frames (from `in` to `out` inclusive) that are all in the same state
+ */
+struct FrameStatusSpan {
+  int64_t in;
+  int64_t out;
+  olive::FrameStatus status;
+};
+
+/**
+ * @brief Spans are applied in order, so a later span overrides the frames it shares with an earlier one
+ */
+using FrameStatusSpans = QVector<FrameStatusSpan>;
+
+/**
+ * @brief Run-length encoded status of every frame of a viewer, built up from FrameStatusSpans
+ *
+ * Settling or invalidating a range is a few map operations however many frames it covers, so a whole sequence's
+ * status can be kept up to date frame by frame as it renders.
+ */
+class FrameStatusMap
+{
+public:
+  FrameStatusMap() = default;
+
+  /**
+   * @brief Set every frame from `in` to `out` (inclusive) to `status`, merging with neighboring runs of the same
+   */
+  void Set(int64_t in, int64_t out, olive::FrameStatus status);
+
+  void Apply(const FrameStatusSpans& spans);
+
+  void Clear();
+
+  bool isEmpty() const;
+
+  /**
+   * @brief Runs overlapping `in` to `out` (clipped to it), in order, leaving out empty frames
+   */
+  FrameStatusSpans Spans(int64_t in, int64_t out) const;
+
+  /**
+   * @brief The last frame a span can reach, later frames are never set
+   */
+  static const int64_t kLastFrame;
+
+private:
+  struct Run {
+    int64_t out;
+    olive::FrameStatus status;
+  };
+
+  /**
+   * @brief Non-overlapping runs mapped by their first frame, frames in no run are empty
+   */
+  QMap<int64_t, Run> runs_;
+
+};
+
+#endif // FRAMESTATUS_H
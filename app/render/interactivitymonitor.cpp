@@ -0,0 +1,185 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "interactivitymonitor.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QMouseEvent>
+
+#ifdef Q_OS_WINDOWS
+#include <windows.h>
+#endif
+
+#include "config/config.h"
+#include "render/renderbudget.h"
+
+InteractivityMonitor* InteractivityMonitor::instance_ = nullptr;
+
+void InteractivityMonitor::CreateInstance()
+{
+  if (instance_ == nullptr) {
+    instance_ = new InteractivityMonitor();
+  }
+}
+
+InteractivityMonitor *InteractivityMonitor::instance()
+{
+  return instance_;
+}
+
+void InteractivityMonitor::DestroyInstance()
+{
+  delete instance_;
+  instance_ = nullptr;
+}
+
+void InteractivityMonitor::UpdateFromConfig()
+{
+  interactive_fraction_ = qBound(0, Config::Current()["InteractiveRenderPercent"].toInt(), 100) / 100.0;
+  pause_on_battery_ = Config::Current()["PauseRenderOnBattery"].toBool();
+
+  if (pause_on_battery_) {
+    CheckBattery();
+    battery_timer_.start();
+  } else {
+    battery_timer_.stop();
+    on_battery_ = false;
+  }
+
+  ApplyFraction();
+}
+
+bool InteractivityMonitor::eventFilter(QObject *watched, QEvent *event)
+{
+  bool interacting;
+
+  switch (event->type()) {
+  case QEvent::MouseButtonPress:
+  case QEvent::MouseButtonDblClick:
+  case QEvent::Wheel:
+  case QEvent::KeyPress:
+    interacting = true;
+    break;
+  case QEvent::MouseMove:
+    // Only drags, just moving the pointer over the window isn't work
+    interacting = (static_cast<QMouseEvent*>(event)->buttons() != Qt::NoButton);
+    break;
+  default:
+    interacting = false;
+  }
+
+  if (interacting) {
+    idle_timer_.start();
+
+    if (fraction_ > interactive_fraction_) {
+      fraction_ = interactive_fraction_;
+      ApplyFraction();
+    }
+
+    if (!ramp_timer_.isActive()) {
+      ramp_timer_.start();
+    }
+  }
+
+  return QObject::eventFilter(watched, event);
+}
+
+InteractivityMonitor::InteractivityMonitor() :
+  fraction_(1.0),
+  interactive_fraction_(1.0),
+  pause_on_battery_(false),
+  on_battery_(false)
+{
+  ramp_timer_.setInterval(kRampInterval);
+  connect(&ramp_timer_, SIGNAL(timeout()), this, SLOT(Ramp()));
+
+  battery_timer_.setInterval(kBatteryInterval);
+  connect(&battery_timer_, SIGNAL(timeout()), this, SLOT(CheckBattery()));
+
+  QCoreApplication::instance()->installEventFilter(this);
+}
+
+InteractivityMonitor::~InteractivityMonitor()
+{
+  QCoreApplication::instance()->removeEventFilter(this);
+
+  RenderBudget::SetBackgroundFraction(1.0);
+}
+
+void InteractivityMonitor::ApplyFraction()
+{
+  RenderBudget::SetBackgroundFraction(on_battery_ ? 0.0 : fraction_);
+}
+
+bool InteractivityMonitor::IsOnBattery()
+{
+#if defined(Q_OS_WINDOWS)
+  SYSTEM_POWER_STATUS status;
+
+  return GetSystemPowerStatus(&status) && status.ACLineStatus == 0;
+#elif defined(Q_OS_LINUX)
+  // Mains adapters report "Online", but a battery that's discharging says so whatever else is plugged in
+  QDir supplies("/sys/class/power_supply");
+
+  foreach (const QString& supply, supplies.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+    QFile type_file(supplies.filePath(supply + "/type"));
+
+    if (!type_file.open(QFile::ReadOnly) || type_file.readAll().trimmed() != "Battery") {
+      continue;
+    }
+
+    QFile status_file(supplies.filePath(supply + "/status"));
+
+    if (status_file.open(QFile::ReadOnly) && status_file.readAll().trimmed() == "Discharging") {
+      return true;
+    }
+  }
+
+  return false;
+#else
+  return false;
+#endif
+}
+
+void InteractivityMonitor::Ramp()
+{
+  if (idle_timer_.elapsed() < kIdleInterval) {
+    return;
+  }
+
+  fraction_ = qMin(1.0, fraction_ + 1.0 / kRampSteps);
+  ApplyFraction();
+
+  if (fraction_ >= 1.0) {
+    ramp_timer_.stop();
+  }
+}
+
+void InteractivityMonitor::CheckBattery()
+{
+  bool on_battery = IsOnBattery();
+
+  if (on_battery != on_battery_) {
+    on_battery_ = on_battery;
+    ApplyFraction();
+  }
+}
@@ -0,0 +1,111 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef INTERACTIVITYMONITOR_H
+#define INTERACTIVITYMONITOR_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+
+/**
+ * @brief Throttles background rendering (see RenderBudget::SetBackgroundFraction()) while the user is working
+ *
+ * Any mouse press, drag, wheel or key press in the application drops background jobs to the configured fraction of the
+ * render slots straight away, so dragging clips or parameters isn't competing with caching. Once nothing has happened
+ * for kIdleInterval, the fraction ramps back up a step at a time rather than all at once.
+ *
+ * Background rendering can also be paused entirely while running on battery power. The battery is only detected on
+ * Linux and Windows, elsewhere the computer is always assumed to be plugged in.
+ */
+class InteractivityMonitor : public QObject
+{
+  Q_OBJECT
+public:
+  static void CreateInstance();
+
+  static InteractivityMonitor* instance();
+
+  static void DestroyInstance();
+
+  /**
+   * @brief Read the throttled fraction and whether to pause on battery from the config
+   */
+  void UpdateFromConfig();
+
+protected:
+  virtual bool eventFilter(QObject* watched, QEvent* event) override;
+
+private:
+  InteractivityMonitor();
+
+  virtual ~InteractivityMonitor() override;
+
+  /**
+   * @brief Pass the current fraction to RenderBudget, unless it's paused for running on battery
+   */
+  void ApplyFraction();
+
+  static bool IsOnBattery();
+
+  /**
+   * @brief Milliseconds without user input before background rendering starts ramping back up
+   */
+  static const int kIdleInterval = 500;
+
+  /**
+   * @brief Milliseconds between each step of the ramp
+   */
+  static const int kRampInterval = 250;
+
+  /**
+   * @brief Number of steps the ramp takes from no background rendering to all of it
+   */
+  static const int kRampSteps = 4;
+
+  /**
+   * @brief Milliseconds between checking whether the computer is on battery
+   */
+  static const int kBatteryInterval = 10000;
+
+  static InteractivityMonitor* instance_;
+
+  double fraction_;
+
+  double interactive_fraction_;
+
+  bool pause_on_battery_;
+
+  bool on_battery_;
+
+  QElapsedTimer idle_timer_;
+
+  QTimer ramp_timer_;
+
+  QTimer battery_timer_;
+
+private slots:
+  void Ramp();
+
+  void CheckBattery();
+
+};
+
+#endif // INTERACTIVITYMONITOR_H
@@ -0,0 +1,378 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#include "pixelkernels.h"
+
+#include "common/define.h"
+
+// SSE2 is part of the x86-64 baseline and NEON is part of the AArch64 baseline, so neither needs a runtime check
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OLIVE_KERNELS_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define OLIVE_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+/**
+ * @brief Number of channels converted at a time when going through a temporary float buffer
+ */
+const int kChunkSize = 1024;
+
+const float kUInt8Scale = 1.0f / 255.0f;
+const float kUInt16Scale = 1.0f / 65535.0f;
+
+enum AlphaOperation {
+  kMultiply,
+  kMultiplyIfPositive,
+  kDivideIfPositive
+};
+
+void ApplyAlphaOperation(AlphaOperation op, float* data, int pixel_count)
+{
+  int i = 0;
+
+#if defined(OLIVE_KERNELS_SSE2)
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 alpha_mask = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+
+  for (;i<pixel_count;i++) {
+    float* px = data + i * kRGBAChannels;
+
+    __m128 color = _mm_loadu_ps(px);
+    __m128 alpha = _mm_shuffle_ps(color, color, _MM_SHUFFLE(3, 3, 3, 3));
+    __m128 result = (op == kDivideIfPositive) ? _mm_div_ps(color, alpha) : _mm_mul_ps(color, alpha);
+
+    // Keep the original values where the operation doesn't apply, and never touch alpha itself
+    __m128 keep = alpha_mask;
+
+    if (op != kMultiply) {
+      keep = _mm_or_ps(keep, _mm_cmpngt_ps(alpha, zero));
+    }
+
+    _mm_storeu_ps(px, _mm_or_ps(_mm_and_ps(keep, color), _mm_andnot_ps(keep, result)));
+  }
+#elif defined(OLIVE_KERNELS_NEON)
+  const uint32x4_t alpha_mask = {0, 0, 0, 0xFFFFFFFF};
+
+  for (;i<pixel_count;i++) {
+    float* px = data + i * kRGBAChannels;
+
+    float32x4_t color = vld1q_f32(px);
+    float32x4_t alpha = vdupq_laneq_f32(color, 3);
+    float32x4_t result = (op == kDivideIfPositive) ? vdivq_f32(color, alpha) : vmulq_f32(color, alpha);
+
+    uint32x4_t keep = alpha_mask;
+
+    if (op != kMultiply) {
+      keep = vorrq_u32(keep, vmvnq_u32(vcgtq_f32(alpha, vdupq_n_f32(0.0f))));
+    }
+
+    vst1q_f32(px, vbslq_f32(keep, color, result));
+  }
+#endif
+
+  for (;i<pixel_count;i++) {
+    float* px = data + i * kRGBAChannels;
+    float alpha = px[kRGBChannels];
+
+    if (op == kMultiply || alpha > 0) {
+      for (int j=0;j<kRGBChannels;j++) {
+        if (op == kDivideIfPositive) {
+          px[j] /= alpha;
+        } else {
+          px[j] *= alpha;
+        }
+      }
+    }
+  }
+}
+
+void ApplyAlphaOperation(AlphaOperation op, qfloat16* data, int pixel_count)
+{
+  // Run the float kernel over chunks of whole pixels
+  float buffer[kChunkSize];
+  const int chunk_pixels = kChunkSize / kRGBAChannels;
+
+  for (int i=0;i<pixel_count;i+=chunk_pixels) {
+    int pixels = qMin(chunk_pixels, pixel_count - i);
+    qfloat16* chunk = data + i * kRGBAChannels;
+
+    olive::kernels::HalfToFloat(chunk, buffer, pixels * kRGBAChannels);
+    ApplyAlphaOperation(op, buffer, pixels);
+    olive::kernels::FloatToHalf(buffer, chunk, pixels * kRGBAChannels);
+  }
+}
+
+}
+
+void olive::kernels::UInt8ToFloat(const uint8_t *source, float *destination, int count)
+{
+  int i = 0;
+
+#if defined(OLIVE_KERNELS_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128 scale = _mm_set1_ps(kUInt8Scale);
+
+  for (;i+16<=count;i+=16) {
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+    __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+    __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+
+    _mm_storeu_ps(destination + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), scale));
+    _mm_storeu_ps(destination + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), scale));
+    _mm_storeu_ps(destination + i + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), scale));
+    _mm_storeu_ps(destination + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), scale));
+  }
+#elif defined(OLIVE_KERNELS_NEON)
+  for (;i+16<=count;i+=16) {
+    uint8x16_t bytes = vld1q_u8(source + i);
+    uint16x8_t lo = vmovl_u8(vget_low_u8(bytes));
+    uint16x8_t hi = vmovl_u8(vget_high_u8(bytes));
+
+    vst1q_f32(destination + i, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo))), kUInt8Scale));
+    vst1q_f32(destination + i + 4, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo))), kUInt8Scale));
+    vst1q_f32(destination + i + 8, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi))), kUInt8Scale));
+    vst1q_f32(destination + i + 12, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi))), kUInt8Scale));
+  }
+#endif
+
+  for (;i<count;i++) {
+    destination[i] = source[i] * kUInt8Scale;
+  }
+}
+
+void olive::kernels::UInt16ToFloat(const uint16_t *source, float *destination, int count)
+{
+  int i = 0;
+
+#if defined(OLIVE_KERNELS_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128 scale = _mm_set1_ps(kUInt16Scale);
+
+  for (;i+8<=count;i+=8) {
+    __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+
+    _mm_storeu_ps(destination + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero)), scale));
+    _mm_storeu_ps(destination + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(words, zero)), scale));
+  }
+#elif defined(OLIVE_KERNELS_NEON)
+  for (;i+8<=count;i+=8) {
+    uint16x8_t words = vld1q_u16(source + i);
+
+    vst1q_f32(destination + i, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(words))), kUInt16Scale));
+    vst1q_f32(destination + i + 4, vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(words))), kUInt16Scale));
+  }
+#endif
+
+  for (;i<count;i++) {
+    destination[i] = source[i] * kUInt16Scale;
+  }
+}
+
+void olive::kernels::UInt8ToHalf(const uint8_t *source, qfloat16 *destination, int count)
+{
+  float buffer[kChunkSize];
+
+  for (int i=0;i<count;i+=kChunkSize) {
+    int chunk = qMin(kChunkSize, count - i);
+
+    UInt8ToFloat(source + i, buffer, chunk);
+    FloatToHalf(buffer, destination + i, chunk);
+  }
+}
+
+void olive::kernels::UInt16ToHalf(const uint16_t *source, qfloat16 *destination, int count)
+{
+  float buffer[kChunkSize];
+
+  for (int i=0;i<count;i+=kChunkSize) {
+    int chunk = qMin(kChunkSize, count - i);
+
+    UInt16ToFloat(source + i, buffer, chunk);
+    FloatToHalf(buffer, destination + i, chunk);
+  }
+}
+
+void olive::kernels::HalfToFloat(const qfloat16 *source, float *destination, int count)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+  // Qt picks an F16C implementation at runtime if the CPU has one
+  qFloatFromFloat16(destination, source, count);
+#else
+  for (int i=0;i<count;i++) {
+    destination[i] = source[i];
+  }
+#endif
+}
+
+void olive::kernels::FloatToHalf(const float *source, qfloat16 *destination, int count)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+  qFloatToFloat16(destination, source, count);
+#else
+  for (int i=0;i<count;i++) {
+    destination[i] = source[i];
+  }
+#endif
+}
+
+template<typename T>
+void olive::kernels::ExpandRGBToRGBA(T *data, int pixel_count, T alpha)
+{
+  // Work backwards so nothing is overwritten before it's read. Each pixel is read in full before it's written since
+  // the first few pixels' RGBA positions overlap their RGB ones.
+  for (int i=pixel_count-1;i>=0;i--) {
+    const T* rgb = data + i * kRGBChannels;
+    T r = rgb[0];
+    T g = rgb[1];
+    T b = rgb[2];
+
+    T* rgba = data + i * kRGBAChannels;
+    rgba[0] = r;
+    rgba[1] = g;
+    rgba[2] = b;
+    rgba[3] = alpha;
+  }
+}
+
+template void olive::kernels::ExpandRGBToRGBA<uint8_t>(uint8_t* data, int pixel_count, uint8_t alpha);
+template void olive::kernels::ExpandRGBToRGBA<uint16_t>(uint16_t* data, int pixel_count, uint16_t alpha);
+template void olive::kernels::ExpandRGBToRGBA<qfloat16>(qfloat16* data, int pixel_count, qfloat16 alpha);
+template void olive::kernels::ExpandRGBToRGBA<float>(float* data, int pixel_count, float alpha);
+
+void olive::kernels::AssociateAlpha(float *data, int pixel_count)
+{
+  ApplyAlphaOperation(kMultiply, data, pixel_count);
+}
+
+void olive::kernels::AssociateAlpha(qfloat16 *data, int pixel_count)
+{
+  ApplyAlphaOperation(kMultiply, data, pixel_count);
+}
+
+void olive::kernels::DisassociateAlpha(float *data, int pixel_count)
+{
+  ApplyAlphaOperation(kDivideIfPositive, data, pixel_count);
+}
+
+void olive::kernels::DisassociateAlpha(qfloat16 *data, int pixel_count)
+{
+  ApplyAlphaOperation(kDivideIfPositive, data, pixel_count);
+}
+
+void olive::kernels::ReassociateAlpha(float *data, int pixel_count)
+{
+  ApplyAlphaOperation(kMultiplyIfPositive, data, pixel_count);
+}
+
+void olive::kernels::ReassociateAlpha(qfloat16 *data, int pixel_count)
+{
+  ApplyAlphaOperation(kMultiplyIfPositive, data, pixel_count);
+}
+
+void olive::kernels::FillRGBA(float *destination, const float *color, int pixel_count)
+{
+  int i = 0;
+
+#if defined(OLIVE_KERNELS_SSE2)
+  const __m128 value = _mm_loadu_ps(color);
+
+  for (;i<pixel_count;i++) {
+    _mm_storeu_ps(destination + i * kRGBAChannels, value);
+  }
+#elif defined(OLIVE_KERNELS_NEON)
+  const float32x4_t value = vld1q_f32(color);
+
+  for (;i<pixel_count;i++) {
+    vst1q_f32(destination + i * kRGBAChannels, value);
+  }
+#endif
+
+  for (;i<pixel_count;i++) {
+    for (int j=0;j<kRGBAChannels;j++) {
+      destination[i * kRGBAChannels + j] = color[j];
+    }
+  }
+}
+
+void olive::kernels::Multiply(const float *source, float *destination, float factor, int count)
+{
+  int i = 0;
+
+#if defined(OLIVE_KERNELS_SSE2)
+  const __m128 scale = _mm_set1_ps(factor);
+
+  for (;i+4<=count;i+=4) {
+    _mm_storeu_ps(destination + i, _mm_mul_ps(_mm_loadu_ps(source + i), scale));
+  }
+#elif defined(OLIVE_KERNELS_NEON)
+  for (;i+4<=count;i+=4) {
+    vst1q_f32(destination + i, vmulq_n_f32(vld1q_f32(source + i), factor));
+  }
+#endif
+
+  for (;i<count;i++) {
+    destination[i] = source[i] * factor;
+  }
+}
+
+void olive::kernels::AlphaOver(const float *base, const float *blend, float *destination, int pixel_count)
+{
+  int i = 0;
+
+#if defined(OLIVE_KERNELS_SSE2)
+  for (;i<pixel_count;i++) {
+    int offset = i * kRGBAChannels;
+
+    __m128 blend_px = _mm_loadu_ps(blend + offset);
+    __m128 alpha = _mm_shuffle_ps(blend_px, blend_px, _MM_SHUFFLE(3, 3, 3, 3));
+    __m128 base_px = (base != nullptr) ? _mm_loadu_ps(base + offset) : _mm_setzero_ps();
+    __m128 remaining = _mm_sub_ps(_mm_set1_ps(1.0f), alpha);
+
+    _mm_storeu_ps(destination + offset, _mm_add_ps(_mm_mul_ps(base_px, remaining), blend_px));
+  }
+#elif defined(OLIVE_KERNELS_NEON)
+  for (;i<pixel_count;i++) {
+    int offset = i * kRGBAChannels;
+
+    float32x4_t blend_px = vld1q_f32(blend + offset);
+    float32x4_t alpha = vdupq_laneq_f32(blend_px, 3);
+    float32x4_t base_px = (base != nullptr) ? vld1q_f32(base + offset) : vdupq_n_f32(0.0f);
+    float32x4_t remaining = vsubq_f32(vdupq_n_f32(1.0f), alpha);
+
+    vst1q_f32(destination + offset, vaddq_f32(vmulq_f32(base_px, remaining), blend_px));
+  }
+#endif
+
+  for (;i<pixel_count;i++) {
+    int offset = i * kRGBAChannels;
+    float remaining = 1.0f - blend[offset + kRGBChannels];
+
+    for (int j=0;j<kRGBAChannels;j++) {
+      float base_value = (base != nullptr) ? base[offset + j] : 0.0f;
+
+      destination[offset + j] = base_value * remaining + blend[offset + j];
+    }
+  }
+}
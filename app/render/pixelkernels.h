@@ -0,0 +1,97 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#ifndef PIXELKERNELS_H
+#define PIXELKERNELS_H
+
+#include <QFloat16>
+#include <stdint.h>
+
+namespace olive {
+namespace kernels {
+
+/**
+ * @brief Convert `count` channels of 8-bit integer to normalized float
+ */
+void UInt8ToFloat(const uint8_t* source, float* destination, int count);
+
+/**
+ * @brief Convert `count` channels of 16-bit integer to normalized float
+ */
+void UInt16ToFloat(const uint16_t* source, float* destination, int count);
+
+void UInt8ToHalf(const uint8_t* source, qfloat16* destination, int count);
+
+void UInt16ToHalf(const uint16_t* source, qfloat16* destination, int count);
+
+void HalfToFloat(const qfloat16* source, float* destination, int count);
+
+void FloatToHalf(const float* source, qfloat16* destination, int count);
+
+/**
+ * @brief Expand tightly packed RGB pixels into RGBA in place, setting alpha to `alpha`
+ *
+ * `data` must be large enough to hold `pixel_count` RGBA pixels.
+ */
+template<typename T>
+void ExpandRGBToRGBA(T* data, int pixel_count, T alpha);
+
+/**
+ * @brief Multiply the color channels of `pixel_count` RGBA pixels by their alpha
+ */
+void AssociateAlpha(float* data, int pixel_count);
+void AssociateAlpha(qfloat16* data, int pixel_count);
+
+/**
+ * @brief Divide the color channels of `pixel_count` RGBA pixels by their alpha (pixels with no alpha are untouched)
+ */
+void DisassociateAlpha(float* data, int pixel_count);
+void DisassociateAlpha(qfloat16* data, int pixel_count);
+
+/**
+ * @brief Multiply by alpha again after DisassociateAlpha() (pixels with no alpha are untouched)
+ */
+void ReassociateAlpha(float* data, int pixel_count);
+void ReassociateAlpha(qfloat16* data, int pixel_count);
+
+/**
+ * @brief Set `pixel_count` RGBA pixels to `color` (four floats)
+ */
+void FillRGBA(float* destination, const float* color, int pixel_count);
+
+/**
+ * @brief Multiply `count` channels by `factor`
+ *
+ * `source` and `destination` may be the same buffer.
+ */
+void Multiply(const float* source, float* destination, float factor, int count);
+
+/**
+ * @brief Composite `pixel_count` RGBA pixels of `blend` over `base` as AlphaOverBlend does (base * (1 - blend.a) + blend)
+ *
+ * `base` may be nullptr for a transparent base. Any of the buffers may be the same.
+ */
+void AlphaOver(const float* base, const float* blend, float* destination, int pixel_count);
+
+}
+}
+
+#endif // PIXELKERNELS_H
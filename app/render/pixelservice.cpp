@@ -25,6 +25,7 @@
 #include <QFloat16>
 
 #include "common/define.h"
+#include "pixelkernels.h"
 
 PixelService::PixelService()
 {
@@ -38,24 +39,28 @@ PixelFormatInfo PixelService::GetPixelFormatInfo(const olive::PixelFormat &forma
   case olive::PIX_FMT_RGBA8:
     info.name = tr("8-bit");
     info.internal_format = GL_RGBA8;
+    info.compressed_format = GL_COMPRESSED_RGBA_BPTC_UNORM;
     info.gl_pixel_type = GL_UNSIGNED_BYTE;
     info.oiio_desc = OIIO::TypeDesc::UINT8;
     break;
   case olive::PIX_FMT_RGBA16U:
     info.name = tr("16-bit Integer");
     info.internal_format = GL_RGBA16;
+    info.compressed_format = 0;
     info.gl_pixel_type = GL_UNSIGNED_SHORT;
     info.oiio_desc = OIIO::TypeDesc::UINT16;
     break;
   case olive::PIX_FMT_RGBA16F:
     info.name = tr("Half-Float (16-bit)");
     info.internal_format = GL_RGBA16F;
+    info.compressed_format = GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT;
     info.gl_pixel_type = GL_HALF_FLOAT;
     info.oiio_desc = OIIO::TypeDesc::HALF;
     break;
   case olive::PIX_FMT_RGBA32F:
     info.name = tr("Full-Float (32-bit)");
     info.internal_format = GL_RGBA32F;
+    info.compressed_format = GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT;
     info.gl_pixel_type = GL_FLOAT;
     info.oiio_desc = OIIO::TypeDesc::FLOAT;
     break;
@@ -75,6 +80,11 @@ int PixelService::GetBufferSize(const olive::PixelFormat &format, const int &wid
   return BytesPerPixel(format) * width * height;
 }
 
+int PixelService::GetCompressedBufferSize(const int &width, const int &height)
+{
+  return ((width + 3) / 4) * ((height + 3) / 4) * 16;
+}
+
 int PixelService::BytesPerPixel(const olive::PixelFormat &format)
 {
   return BytesPerChannel(format) * kRGBAChannels;
@@ -135,18 +145,12 @@ FramePtr PixelService::ConvertPixelFormat(FramePtr frame, const olive::PixelForm
     }
     case olive::PIX_FMT_RGBA16F: // 8-bit Integer -> 16-bit Float
     {
-      qfloat16* destination = reinterpret_cast<qfloat16*>(converted->data());
-      for (int i=0;i<pix_count;i++) {
-        destination[i] = source[i] / 255.0f;
-      }
+      olive::kernels::UInt8ToHalf(source, reinterpret_cast<qfloat16*>(converted->data()), pix_count);
       break;
     }
     case olive::PIX_FMT_RGBA32F: // 8-bit Integer -> 32-bit Float
     {
-      float* destination = reinterpret_cast<float*>(converted->data());
-      for (int i=0;i<pix_count;i++) {
-        destination[i] = source[i] / 255.0f;
-      }
+      olive::kernels::UInt8ToFloat(source, reinterpret_cast<float*>(converted->data()), pix_count);
       break;
     }
     case olive::PIX_FMT_INVALID:
@@ -171,18 +175,12 @@ FramePtr PixelService::ConvertPixelFormat(FramePtr frame, const olive::PixelForm
     }
     case olive::PIX_FMT_RGBA16F: // 16-bit Integer -> 16-bit Float
     {
-      qfloat16* destination = reinterpret_cast<qfloat16*>(converted->data());
-      for (int i=0;i<pix_count;i++) {
-        destination[i] = source[i] / 65535.0f;
-      }
+      olive::kernels::UInt16ToHalf(source, reinterpret_cast<qfloat16*>(converted->data()), pix_count);
       break;
     }
     case olive::PIX_FMT_RGBA32F: // 16-bit Integer -> 32-bit Float
     {
-      float* destination = reinterpret_cast<float*>(converted->data());
-      for (int i=0;i<pix_count;i++) {
-        destination[i] = source[i] / 65535.0f;
-      }
+      olive::kernels::UInt16ToFloat(source, reinterpret_cast<float*>(converted->data()), pix_count);
       break;
     }
     case olive::PIX_FMT_INVALID:
@@ -215,10 +213,7 @@ FramePtr PixelService::ConvertPixelFormat(FramePtr frame, const olive::PixelForm
     }
     case olive::PIX_FMT_RGBA32F: // 16-bit Float -> 32-bit Float
     {
-      float* destination = reinterpret_cast<float*>(converted->data());
-      for (int i=0;i<pix_count;i++) {
-        destination[i] = source[i];
-      }
+      olive::kernels::HalfToFloat(source, reinterpret_cast<float*>(converted->data()), pix_count);
       break;
     }
     case olive::PIX_FMT_INVALID:
@@ -251,10 +246,7 @@ FramePtr PixelService::ConvertPixelFormat(FramePtr frame, const olive::PixelForm
     }
     case olive::PIX_FMT_RGBA16F: // 32-bit Float -> 16-bit Float
     {
-      qfloat16* destination = reinterpret_cast<qfloat16*>(converted->data());
-      for (int i=0;i<pix_count;i++) {
-        destination[i] = source[i];
-      }
+      olive::kernels::FloatToHalf(source, reinterpret_cast<qfloat16*>(converted->data()), pix_count);
       break;
     }
     case olive::PIX_FMT_INVALID:
@@ -279,42 +271,24 @@ FramePtr PixelService::ConvertPixelFormat(FramePtr frame, const olive::PixelForm
 
 void PixelService::ConvertRGBtoRGBA(FramePtr frame)
 {
-  olive::PixelFormat dest_format = static_cast<olive::PixelFormat>(frame->format());
-
-  int rgb_pixel_size = BytesPerChannel(dest_format) * kRGBChannels;
-  int rgb_frame_size = frame->width() * frame->height() * rgb_pixel_size;
-  int rgb_iter = rgb_frame_size - rgb_pixel_size;
-
-  int rgba_pixel_size = BytesPerChannel(dest_format) * kRGBAChannels;
-  int rgba_frame_size = frame->width() * frame->height() * rgba_pixel_size;
-  int rgba_iter = rgba_frame_size - rgba_pixel_size;
-
-  // Work backwards to save time
-  while (rgb_iter >= 0) {
-    memcpy(&frame->data()[rgba_iter], &frame->data()[rgb_iter], static_cast<size_t>(rgb_pixel_size));
-
-    uint8_t* alpha_ptr = reinterpret_cast<uint8_t*>(frame->data()) + rgba_iter + rgb_pixel_size;
-
-    // Write a full alpha value according to the format
-    switch (dest_format) {
-    case olive::PIX_FMT_RGBA8:
-      *alpha_ptr = UINT8_MAX;
-      break;
-    case olive::PIX_FMT_RGBA16U:
-      *reinterpret_cast<uint16_t*>(alpha_ptr) = UINT16_MAX;
-      break;
-    case olive::PIX_FMT_RGBA16F:
-      *reinterpret_cast<qfloat16*>(alpha_ptr) = 1.0f;
-      break;
-    case olive::PIX_FMT_RGBA32F:
-      *reinterpret_cast<float*>(alpha_ptr) = 1.0f;
-      break;
-    case olive::PIX_FMT_INVALID:
-    case olive::PIX_FMT_COUNT:
-      qFatal("Invalid pixel format requested");
-    }
+  int pixel_count = frame->width() * frame->height();
 
-    rgb_iter -= rgb_pixel_size;
-    rgba_iter -= rgba_pixel_size;
+  // Expand with a full alpha value according to the format
+  switch (static_cast<olive::PixelFormat>(frame->format())) {
+  case olive::PIX_FMT_RGBA8:
+    olive::kernels::ExpandRGBToRGBA<uint8_t>(reinterpret_cast<uint8_t*>(frame->data()), pixel_count, UINT8_MAX);
+    break;
+  case olive::PIX_FMT_RGBA16U:
+    olive::kernels::ExpandRGBToRGBA<uint16_t>(reinterpret_cast<uint16_t*>(frame->data()), pixel_count, UINT16_MAX);
+    break;
+  case olive::PIX_FMT_RGBA16F:
+    olive::kernels::ExpandRGBToRGBA<qfloat16>(reinterpret_cast<qfloat16*>(frame->data()), pixel_count, qfloat16(1.0f));
+    break;
+  case olive::PIX_FMT_RGBA32F:
+    olive::kernels::ExpandRGBToRGBA<float>(reinterpret_cast<float*>(frame->data()), pixel_count, 1.0f);
+    break;
+  case olive::PIX_FMT_INVALID:
+  case olive::PIX_FMT_COUNT:
+    qFatal("Invalid pixel format requested");
   }
 }
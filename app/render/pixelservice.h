@@ -28,6 +28,15 @@
 #include "decoder/frame.h"
 #include "pixelformat.h"
 
+// BPTC (BC6H and BC7) is core since OpenGL 4.2, so older headers may not have these
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+#ifndef GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT
+#define GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT 0x8E8E
+#endif
+
 /**
  * @brief A struct of information pertaining to each enum PixelFormat.
  *
@@ -41,6 +50,10 @@
 struct PixelFormatInfo {
   QString name;
   GLint internal_format;
+
+  /// Block-compressed format frames in this format can be kept in (BC7 or BC6H), 0 if there isn't one
+  GLenum compressed_format;
+
   GLenum pixel_format;
   GLenum gl_pixel_type;
   int bytes_per_pixel;
@@ -76,6 +89,11 @@ public:
    */
   static int GetBufferSize(const olive::PixelFormat &format, const int& width, const int& height);
 
+  /**
+   * @brief Returns the size of a frame in its PixelFormatInfo::compressed_format (16 bytes per 4x4 block)
+   */
+  static int GetCompressedBufferSize(const int& width, const int& height);
+
   /**
    * @brief Returns the number of bytes per pixel for a certain format
    *
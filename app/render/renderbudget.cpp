@@ -0,0 +1,245 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "renderbudget.h"
+
+#include <QThread>
+#include <QtMath>
+
+RenderBudget::State::State() :
+  background_fraction(1.0)
+{
+  for (int i=0;i<2;i++) {
+    pools[i].count = 0;
+    pools[i].in_use = 0;
+    pools[i].next_ticket = 0;
+    pools[i].now_serving = 0;
+    pools[i].next_background_ticket = 0;
+    pools[i].now_serving_background = 0;
+  }
+}
+
+void RenderBudget::SetThreadCount(int count)
+{
+  State& s = state();
+
+  s.lock.lock();
+  s.pools[kCPU].count = qMax(0, count);
+  s.lock.unlock();
+
+  // A bigger budget may let waiting jobs start
+  s.released.wakeAll();
+}
+
+int RenderBudget::ThreadCount()
+{
+  State& s = state();
+
+  s.lock.lock();
+  int count = PoolCount(s, kCPU);
+  s.lock.unlock();
+
+  return count;
+}
+
+void RenderBudget::SetGPUContextCount(int count)
+{
+  State& s = state();
+
+  s.lock.lock();
+  s.pools[kGPU].count = qMax(0, count);
+  s.lock.unlock();
+
+  s.released.wakeAll();
+}
+
+int RenderBudget::GPUContextCount()
+{
+  State& s = state();
+
+  s.lock.lock();
+  int count = PoolCount(s, kGPU);
+  s.lock.unlock();
+
+  return count;
+}
+
+void RenderBudget::SetBackgroundFraction(double fraction)
+{
+  State& s = state();
+
+  s.lock.lock();
+  s.background_fraction = qBound(0.0, fraction, 1.0);
+  s.lock.unlock();
+
+  s.released.wakeAll();
+}
+
+void RenderBudget::Acquire(RenderBudget::Resource resource, bool background)
+{
+  State& s = state();
+  Pool& pool = s.pools[resource];
+
+  s.lock.lock();
+
+  if (background) {
+    quint64 ticket = pool.next_background_ticket++;
+
+    while (ticket != pool.now_serving_background || !BackgroundCanStart(s, resource)) {
+      s.released.wait(&s.lock);
+    }
+
+    pool.in_use++;
+    pool.now_serving_background++;
+
+    s.lock.unlock();
+
+    s.released.wakeAll();
+
+    return;
+  }
+
+  quint64 ticket = pool.next_ticket++;
+
+  while (ticket != pool.now_serving || pool.in_use >= PoolCount(s, resource)) {
+    s.released.wait(&s.lock);
+  }
+
+  pool.in_use++;
+  pool.now_serving++;
+
+  s.lock.unlock();
+
+  // The next ticket may be able to go too
+  s.released.wakeAll();
+}
+
+bool RenderBudget::TryAcquire(RenderBudget::Resource resource, bool background)
+{
+  State& s = state();
+  Pool& pool = s.pools[resource];
+
+  s.lock.lock();
+
+  // Nobody's waiting, so this doesn't jump the queue
+  bool acquired;
+
+  if (background) {
+    acquired = (pool.next_background_ticket == pool.now_serving_background && BackgroundCanStart(s, resource));
+  } else {
+    acquired = (pool.next_ticket == pool.now_serving && pool.in_use < PoolCount(s, resource));
+  }
+
+  if (acquired) {
+    pool.in_use++;
+  }
+
+  s.lock.unlock();
+
+  return acquired;
+}
+
+void RenderBudget::Release(RenderBudget::Resource resource)
+{
+  State& s = state();
+
+  s.lock.lock();
+  s.pools[resource].in_use--;
+  s.lock.unlock();
+
+  s.released.wakeAll();
+}
+
+int RenderBudget::InUse(RenderBudget::Resource resource)
+{
+  State& s = state();
+
+  s.lock.lock();
+  int in_use = s.pools[resource].in_use;
+  s.lock.unlock();
+
+  return in_use;
+}
+
+int RenderBudget::Waiting(RenderBudget::Resource resource)
+{
+  State& s = state();
+
+  s.lock.lock();
+  const Pool& pool = s.pools[resource];
+  quint64 waiting = (pool.next_ticket - pool.now_serving) + (pool.next_background_ticket - pool.now_serving_background);
+  s.lock.unlock();
+
+  return static_cast<int>(waiting);
+}
+
+RenderBudget::State &RenderBudget::state()
+{
+  static State s;
+  return s;
+}
+
+int RenderBudget::PoolCount(const RenderBudget::State &s, RenderBudget::Resource resource)
+{
+  int count = s.pools[resource].count;
+
+  if (count == 0) {
+    count = (resource == kGPU) ? PoolCount(s, kCPU) : QThread::idealThreadCount();
+  }
+
+  return count;
+}
+
+int RenderBudget::BackgroundCount(const RenderBudget::State &s, RenderBudget::Resource resource)
+{
+  if (s.background_fraction <= 0) {
+    return 0;
+  }
+
+  return qMax(1, qCeil(PoolCount(s, resource) * s.background_fraction));
+}
+
+bool RenderBudget::BackgroundCanStart(const RenderBudget::State &s, RenderBudget::Resource resource)
+{
+  const Pool& pool = s.pools[resource];
+
+  // Other jobs that are waiting go first
+  return pool.next_ticket == pool.now_serving && pool.in_use < BackgroundCount(s, resource);
+}
+
+RenderBudget::Slot::Slot(bool gpu, bool background) :
+  gpu_(gpu)
+{
+  // Always CPU first, so a job holding a GPU slot never waits for a CPU one
+  Acquire(kCPU, background);
+
+  if (gpu_) {
+    Acquire(kGPU, background);
+  }
+}
+
+RenderBudget::Slot::~Slot()
+{
+  if (gpu_) {
+    Release(kGPU);
+  }
+
+  Release(kCPU);
+}
@@ -0,0 +1,170 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef RENDERBUDGET_H
+#define RENDERBUDGET_H
+
+#include <QMutex>
+#include <QWaitCondition>
+
+/**
+ * @brief Process-wide limits on how much rendering happens at once
+ *
+ * Every render backend starts its own worker threads, and every viewer has its own backends, so with a few viewers
+ * open there can be several times more workers than CPU cores. Rather than each backend sizing itself for the whole
+ * machine, workers (and CPU-bound Tasks) take a slot for each job they run, so no matter how many backends there
+ * are, only ThreadCount() jobs run at once. Slots are handed out in the order they were asked for, so a backend with a
+ * long queue can't starve the others.
+ *
+ * Jobs that render on the GPU also take one of GPUContextCount() GPU slots, and no backend creates more GPU contexts
+ * than that.
+ *
+ * Background jobs (e.g. filling a viewer's cache) can be held to a fraction of the slots while the user is working
+ * (see SetBackgroundFraction()). They only start when no other job is waiting, so they never hold anything else up.
+ *
+ * A job must never wait on another job while holding a slot, or every slot could end up held by jobs waiting on jobs
+ * that can't start.
+ */
+class RenderBudget
+{
+public:
+  enum Resource {
+    kCPU,
+    kGPU
+  };
+
+  /**
+   * @brief Set how many jobs can run at once (0 means one per CPU core)
+   */
+  static void SetThreadCount(int count);
+
+  static int ThreadCount();
+
+  /**
+   * @brief Set how many GPU jobs can run at once and how many GPU contexts each backend creates (0 means the same as
+   * ThreadCount())
+   */
+  static void SetGPUContextCount(int count);
+
+  static int GPUContextCount();
+
+  /**
+   * @brief Limit background jobs to this fraction of each resource's slots (1, all of them, by default)
+   *
+   * They always get at least one slot, unless `fraction` is 0, which holds every background job back until it's raised
+   * again. Jobs that are already running carry on.
+   */
+  static void SetBackgroundFraction(double fraction);
+
+  /**
+   * @brief Wait for a slot to run a job on `resource`
+   *
+   * Must be matched with a call to Release().
+   *
+   * @param background
+   *
+   * Whether the job is background work (see SetBackgroundFraction()).
+   */
+  static void Acquire(Resource resource, bool background = false);
+
+  /**
+   * @brief Take a slot on `resource` only if one is free right away
+   *
+   * @return
+   *
+   * FALSE if every slot is taken, in which case Release() mustn't be called.
+   */
+  static bool TryAcquire(Resource resource, bool background = false);
+
+  static void Release(Resource resource);
+
+  /**
+   * @brief Number of slots on `resource` that are taken right now
+   */
+  static int InUse(Resource resource);
+
+  /**
+   * @brief Number of jobs waiting for a slot on `resource` right now, background or not
+   */
+  static int Waiting(Resource resource);
+
+  /**
+   * @brief Holds a CPU slot (and a GPU slot if `gpu` is TRUE) for as long as it exists
+   */
+  class Slot
+  {
+  public:
+    Slot(bool gpu, bool background = false);
+
+    ~Slot();
+
+  private:
+    bool gpu_;
+  };
+
+private:
+  struct Pool {
+    int count;
+
+    int in_use;
+
+    /// Ticket given to the next job to ask for a slot
+    quint64 next_ticket;
+
+    /// Ticket of the job waiting longest, which gets the next free slot
+    quint64 now_serving;
+
+    /// The same for background jobs, which queue separately so they never hold up other jobs
+    quint64 next_background_ticket;
+    quint64 now_serving_background;
+  };
+
+  struct State {
+    State();
+
+    QMutex lock;
+
+    QWaitCondition released;
+
+    Pool pools[2];
+
+    double background_fraction;
+  };
+
+  /**
+   * @brief Created on first use, since backends (and TaskManager) may be set up before main()
+   */
+  static State& state();
+
+  static int PoolCount(const State& s, Resource resource);
+
+  /**
+   * @brief Number of slots background jobs can use at the moment
+   */
+  static int BackgroundCount(const State& s, Resource resource);
+
+  /**
+   * @brief Returns whether a background job can take a slot right now
+   */
+  static bool BackgroundCanStart(const State& s, Resource resource);
+
+};
+
+#endif // RENDERBUDGET_H
@@ -0,0 +1,303 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#include "thumbnailservice.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QSaveFile>
+
+#include "common/filefunctions.h"
+#include "decoder/decoder.h"
+#include "project/item/footage/footage.h"
+#include "project/item/footage/imagestream.h"
+#include "render/diskcachemanager.h"
+#include "render/pixelservice.h"
+
+ThumbnailService* ThumbnailService::instance_ = nullptr;
+
+class ThumbnailService::WorkerTask : public QRunnable
+{
+public:
+  WorkerTask(ThumbnailService* parent) :
+    parent_(parent)
+  {
+  }
+
+  virtual void run() override
+  {
+    Request request;
+
+    // The request this was started for may have been served already or dropped, in which case there's nothing to do
+    if (!parent_->TakeRequest(&request)) {
+      return;
+    }
+
+    QImage image = Generate(request);
+
+    QMetaObject::invokeMethod(parent_,
+                              "ThumbnailLoaded",
+                              Qt::QueuedConnection,
+                              Q_ARG(QString, request.key),
+                              Q_ARG(QImage, image));
+  }
+
+private:
+  ThumbnailService* parent_;
+};
+
+void ThumbnailService::CreateInstance()
+{
+  if (instance_ == nullptr) {
+    instance_ = new ThumbnailService();
+  }
+}
+
+ThumbnailService *ThumbnailService::instance()
+{
+  return instance_;
+}
+
+void ThumbnailService::DestroyInstance()
+{
+  delete instance_;
+  instance_ = nullptr;
+}
+
+ThumbnailService::ThumbnailService() :
+  memory_cache_(kMemoryCacheSize)
+{
+  pool_.setMaxThreadCount(kWorkerCount);
+}
+
+ThumbnailService::~ThumbnailService()
+{
+  // Workers that haven't started yet don't need to, and the ones that have need to finish before we're gone
+  pool_.clear();
+  pool_.waitForDone();
+}
+
+QImage ThumbnailService::Get(StreamPtr stream, const rational &time, int size, const void *requester)
+{
+  if (stream == nullptr
+      || (stream->type() != Stream::kVideo && stream->type() != Stream::kImage)
+      || stream->footage()->status() != Footage::kReady
+      || size <= 0) {
+    return QImage();
+  }
+
+  QString key = GetKey(stream.get(), time, size);
+
+  if (key.isEmpty() || failed_.contains(key)) {
+    return QImage();
+  }
+
+  QImage* cached = memory_cache_.object(key);
+
+  if (cached) {
+    return *cached;
+  }
+
+  queue_lock_.lock();
+
+  if (pending_.contains(key)) {
+    // Still wanted, so move it to the front of the queue (if a worker hasn't already picked it up)
+    for (int i=0;i<queue_.size();i++) {
+      if (queue_.at(i).key == key) {
+        queue_[i].requester = requester;
+        queue_.move(i, queue_.size() - 1);
+        break;
+      }
+    }
+
+    queue_lock_.unlock();
+
+    return QImage();
+  }
+
+  queue_.append({stream, time, size, key, requester});
+  pending_.insert(key);
+
+  // Forget the oldest requests, whatever asked for them has most likely scrolled out of view by now
+  while (queue_.size() > kMaximumQueuedRequests) {
+    pending_.remove(queue_.takeFirst().key);
+  }
+
+  queue_lock_.unlock();
+
+  pool_.start(new WorkerTask(this));
+
+  return QImage();
+}
+
+void ThumbnailService::CancelRequests(const void *requester)
+{
+  queue_lock_.lock();
+
+  for (int i=queue_.size()-1;i>=0;i--) {
+    if (queue_.at(i).requester == requester) {
+      pending_.remove(queue_.takeAt(i).key);
+    }
+  }
+
+  queue_lock_.unlock();
+}
+
+QString ThumbnailService::GetKey(Stream *stream, const rational &time, int size)
+{
+  const QString& filename = stream->footage()->filename();
+
+  QHash<QString, QString>::const_iterator identifier = file_identifiers_.constFind(filename);
+
+  if (identifier == file_identifiers_.constEnd()) {
+    identifier = file_identifiers_.insert(filename, GetUniqueFileIdentifier(filename));
+  }
+
+  if (identifier.value().isEmpty()) {
+    return QString();
+  }
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+
+  hash.addData(identifier.value().toUtf8());
+  hash.addData(QByteArray::number(stream->index()));
+  hash.addData(QByteArray::number(qRound64(time.toDouble() * 1000)));
+  hash.addData(QByteArray::number(size));
+
+  return QString(hash.result().toHex());
+}
+
+QString ThumbnailService::GetFilename(const QString &key)
+{
+  QString filename = GetShardedFilename(QDir(GetMediaIndexLocation()).filePath(QStringLiteral("thumbnails")), key);
+
+  // Only called from the workers, so it doesn't matter that this touches the disk
+  QFileInfo(filename).dir().mkpath(".");
+
+  return filename;
+}
+
+QImage ThumbnailService::Generate(const Request &request)
+{
+  QString filename = GetFilename(request.key);
+
+  QImage image;
+
+  if (image.load(filename)) {
+    DiskCacheManager::instance()->FileAccessed(filename);
+    return image;
+  }
+
+  image = Decode(request);
+
+  if (image.isNull()) {
+    return image;
+  }
+
+  // Video frames are opaque so they can be stored much smaller, stills may have transparency
+  QSaveFile file(filename);
+
+  if (file.open(QFile::WriteOnly)
+      && image.save(&file, (request.stream->type() == Stream::kVideo) ? "JPG" : "PNG")
+      && file.commit()) {
+    DiskCacheManager::instance()->FileWritten(filename);
+  } else {
+    file.cancelWriting();
+    qWarning() << "Failed to save thumbnail" << filename;
+  }
+
+  return image;
+}
+
+QImage ThumbnailService::Decode(const Request &request)
+{
+  Footage* footage = request.stream->footage();
+
+  footage->LockDeletes();
+
+  QImage image;
+
+  DecoderPtr decoder = Decoder::CreateFromID(footage->decoder());
+
+  if (decoder != nullptr) {
+    int height = std::static_pointer_cast<ImageStream>(request.stream)->height();
+
+    decoder->set_stream(request.stream);
+
+    // Let the decoder shrink the frame as much as it can before we scale it to the exact size
+    FramePtr frame = decoder->RetrieveThumbnail(request.time, qMax(1, height / request.size));
+
+    decoder->Close();
+
+    if (frame != nullptr) {
+      frame = PixelService::ConvertPixelFormat(frame, olive::PIX_FMT_RGBA8);
+
+      image = QImage(reinterpret_cast<const uchar*>(frame->const_data()),
+                     frame->width(),
+                     frame->height(),
+                     frame->width() * PixelService::BytesPerPixel(olive::PIX_FMT_RGBA8),
+                     QImage::Format_RGBA8888);
+
+      if (image.height() > request.size) {
+        image = image.scaledToHeight(request.size, Qt::SmoothTransformation);
+      }
+
+      // Detaches from the frame's memory and puts it in the format that's fastest to paint
+      image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+  }
+
+  footage->UnlockDeletes();
+
+  return image;
+}
+
+bool ThumbnailService::TakeRequest(Request *request)
+{
+  queue_lock_.lock();
+
+  bool found = !queue_.isEmpty();
+
+  if (found) {
+    *request = queue_.takeLast();
+  }
+
+  queue_lock_.unlock();
+
+  return found;
+}
+
+void ThumbnailService::ThumbnailLoaded(const QString &key, const QImage &image)
+{
+  pending_.remove(key);
+
+  if (image.isNull()) {
+    failed_.insert(key);
+    return;
+  }
+
+  memory_cache_.insert(key, new QImage(image), qMax(1, image.bytesPerLine() * image.height() / 1024));
+
+  emit ThumbnailReady();
+}
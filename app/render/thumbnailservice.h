@@ -0,0 +1,184 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#ifndef THUMBNAILSERVICE_H
+#define THUMBNAILSERVICE_H
+
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QSet>
+#include <QThreadPool>
+
+#include "common/rational.h"
+#include "project/item/footage/stream.h"
+
+/**
+ * @brief Background generator and cache of small preview images of video and image streams
+ *
+ * Thumbnails are decoded with Decoder::RetrieveThumbnail() (keyframes only, at reduced resolution) on a small pool of
+ * worker threads, so neither the UI nor the renderer ever waits on them. Each one is cached twice: on disk in the media
+ * index location, keyed by the file's identity, stream, time and size, so they survive between sessions, and in a
+ * RAM LRU so repainting doesn't read them back from disk.
+ *
+ * Requests are driven by painting: views call Get() for what they're drawing and repaint when ThumbnailReady() is
+ * emitted. Pending requests are served newest-first, so whatever was painted most recently (i.e. what's visible now)
+ * is delivered first, and anything that has long since scrolled out of view is dropped from the queue. Views that
+ * know their visible area has changed can also drop their own queued requests with CancelRequests().
+ *
+ * Get() must only be called from the main thread.
+ */
+class ThumbnailService : public QObject
+{
+  Q_OBJECT
+public:
+  static void CreateInstance();
+
+  static ThumbnailService* instance();
+
+  static void DestroyInstance();
+
+  /**
+   * @brief Retrieve a thumbnail of `stream` at `time`, `size` pixels high
+   *
+   * @return
+   *
+   * The thumbnail if it's already in memory. Otherwise a null QImage is returned, the thumbnail is queued (or moved to
+   * the front of the queue if it's already queued) and ThumbnailReady() is emitted once it's available.
+   *
+   * @param requester
+   *
+   * Optional tag identifying who asked for this thumbnail, so their requests can be cancelled together with
+   * CancelRequests()
+   */
+  QImage Get(StreamPtr stream, const rational& time, int size, const void* requester = nullptr);
+
+  /**
+   * @brief Drop every queued request made by `requester` that hasn't started generating yet
+   *
+   * Intended for when a view scrolls or zooms, after which it should repaint so that whatever is still visible gets
+   * requested again.
+   */
+  void CancelRequests(const void* requester);
+
+signals:
+  /**
+   * @brief Emitted whenever a thumbnail that was requested becomes available in memory
+   */
+  void ThumbnailReady();
+
+private:
+  ThumbnailService();
+
+  virtual ~ThumbnailService() override;
+
+  struct Request {
+    StreamPtr stream;
+    rational time;
+    int size;
+    QString key;
+    const void* requester;
+  };
+
+  /**
+   * @brief Pops the most recent request and generates it, run on the worker pool (one per request)
+   */
+  class WorkerTask;
+
+  /**
+   * @brief Retrieve the cache key for a thumbnail, or an empty string if the file doesn't exist
+   */
+  QString GetKey(Stream* stream, const rational& time, int size);
+
+  /**
+   * @brief Disk cache filename for a key
+   */
+  static QString GetFilename(const QString& key);
+
+  /**
+   * @brief Load a thumbnail from the disk cache, or decode and save it there if it isn't cached yet
+   */
+  static QImage Generate(const Request& request);
+
+  /**
+   * @brief Decode a thumbnail from the source file
+   */
+  static QImage Decode(const Request& request);
+
+  /**
+   * @brief Take the most recent request off the queue (thread-safe)
+   */
+  bool TakeRequest(Request* request);
+
+  static ThumbnailService* instance_;
+
+  /**
+   * @brief Most requests that can be queued, anything older than this is assumed to be out of view
+   */
+  static const int kMaximumQueuedRequests = 256;
+
+  /**
+   * @brief How many thumbnails are generated at once
+   */
+  static const int kWorkerCount = 2;
+
+  /**
+   * @brief Size of the RAM cache in KiB
+   */
+  static const int kMemoryCacheSize = 64 * 1024;
+
+  QThreadPool pool_;
+
+  QMutex queue_lock_;
+
+  /**
+   * @brief Requests waiting for a worker, oldest first (protected by queue_lock_)
+   */
+  QList<Request> queue_;
+
+  /**
+   * @brief Keys that are queued or being generated (main thread only)
+   */
+  QSet<QString> pending_;
+
+  /**
+   * @brief Keys that couldn't be generated, so they aren't requested again every repaint (main thread only)
+   */
+  QSet<QString> failed_;
+
+  QCache<QString, QImage> memory_cache_;
+
+  /**
+   * @brief GetUniqueFileIdentifier() results per filename so painting doesn't stat files over and over
+   */
+  QHash<QString, QString> file_identifiers_;
+
+private slots:
+  /**
+   * @brief Receives a generated thumbnail (or a null image on failure) from a worker in the main thread
+   */
+  void ThumbnailLoaded(const QString& key, const QImage& image);
+
+};
+
+#endif // THUMBNAILSERVICE_H
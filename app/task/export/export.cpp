@@ -0,0 +1,280 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "export.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QTemporaryDir>
+
+#include "project/projectserializer.h"
+#include "render/backend/opengl/openglbackend.h"
+#include "task/taskmanager.h"
+
+QList<ExportTask*> ExportTask::waiting_tasks_;
+
+namespace {
+
+Sequence* FindSequenceByUuid(Item* item, const QUuid& uuid)
+{
+  for (int i=0;i<item->child_count();i++) {
+    Item* child = item->child(i);
+
+    if (child->type() == Item::kSequence && static_cast<Sequence*>(child)->uuid() == uuid) {
+      return static_cast<Sequence*>(child);
+    }
+
+    Sequence* sequence = FindSequenceByUuid(child, uuid);
+
+    if (sequence != nullptr) {
+      return sequence;
+    }
+  }
+
+  return nullptr;
+}
+
+}
+
+ExportTask::ExportTask(Project *project, Sequence *sequence, const QString &filename) :
+  project_(project),
+  sequence_(sequence),
+  sequence_name_(sequence->name()),
+  sequence_uuid_(sequence->uuid()),
+  snapshot_sequence_(nullptr),
+  surface_(nullptr),
+  context_(nullptr),
+  exporter_(nullptr),
+  export_pending_(false),
+  result_(false)
+{
+  // The user started this and is waiting for the file
+  set_priority(kInteractive);
+
+  AddFilename(filename);
+
+  waiting_tasks_.append(this);
+}
+
+ExportTask::~ExportTask()
+{
+  waiting_tasks_.removeAll(this);
+
+  delete exporter_;
+  delete context_;
+  delete surface_;
+}
+
+bool ExportTask::Prologue()
+{
+  // No more files can be added once the export has started
+  waiting_tasks_.removeAll(this);
+
+  if (!sequence_ || !project_) {
+    set_error(tr("The sequence no longer exists"));
+    return false;
+  }
+
+  if (!TakeSnapshot()) {
+    set_error(tr("Failed to copy the sequence for exporting"));
+    return false;
+  }
+
+  // Render workers share with whichever context is current when they start. The surface has to be made here in the
+  // main thread, StartExport() makes the context once there's one to make current on it.
+  surface_ = new QOffscreenSurface();
+  surface_->create();
+
+  export_pending_ = true;
+
+  QMetaObject::invokeMethod(this, "StartExport", Qt::QueuedConnection);
+
+  return true;
+}
+
+bool ExportTask::Action()
+{
+  finished_.acquire();
+
+  return result_;
+}
+
+ExportTask *ExportTask::QueueDeliverable(Project *project, Sequence *sequence, const QString &filename)
+{
+  foreach (ExportTask* t, waiting_tasks_) {
+    if (t->status() == kWaiting && t->sequence_ == sequence) {
+      if (!t->filenames_.contains(filename)) {
+        t->AddFilename(filename);
+      }
+
+      return nullptr;
+    }
+  }
+
+  std::shared_ptr<ExportTask> task = std::make_shared<ExportTask>(project, sequence, filename);
+
+  olive::task_manager.AddTask(task);
+
+  return task.get();
+}
+
+void ExportTask::Cancel()
+{
+  // Action() is waiting on an export that runs in the main thread, it has to be stopped here or Task::Cancel() would
+  // wait for Action() forever
+  if (exporter_ != nullptr && exporter_->IsRunning()) {
+    // Finishes through ExporterFinished()
+    exporter_->Cancel();
+  } else if (export_pending_) {
+    Release(false);
+  }
+
+  Task::Cancel();
+}
+
+void ExportTask::AddFilename(const QString &filename)
+{
+  filenames_.append(filename);
+
+  QStringList names;
+
+  foreach (const QString& f, filenames_) {
+    names.append(QFileInfo(f).fileName());
+  }
+
+  set_text(tr("Exporting \"%1\" to %2").arg(sequence_name_, names.join(", ")));
+}
+
+bool ExportTask::TakeSnapshot()
+{
+  QTemporaryDir dir;
+
+  if (!dir.isValid()) {
+    return false;
+  }
+
+  QString snapshot_filename = QDir(dir.path()).filePath("snapshot.ove");
+
+  // Saving sets the project's filename, which has to stay pointing at the user's file
+  QString project_filename = project_->filename();
+  bool saved = ProjectSerializer::Save(project_, snapshot_filename);
+  project_->set_filename(project_filename);
+
+  if (!saved) {
+    return false;
+  }
+
+  snapshot_ = ProjectSerializer::Load(snapshot_filename);
+
+  if (snapshot_ == nullptr) {
+    return false;
+  }
+
+  // The copy keeps the sequence's UUID, so it shares the original's cache name and any frame the viewer has already
+  // rendered isn't rendered again
+  Sequence* sequence = FindSequenceByUuid(snapshot_->root(), sequence_uuid_);
+
+  if (sequence == nullptr) {
+    snapshot_ = nullptr;
+    return false;
+  }
+
+  sequence->Materialize();
+
+  snapshot_sequence_ = sequence;
+
+  return true;
+}
+
+void ExportTask::Release(bool ok)
+{
+  export_pending_ = false;
+
+  result_ = ok;
+  finished_.release();
+}
+
+void ExportTask::StartExport()
+{
+  if (!export_pending_) {
+    // Cancelled before it got the chance to start
+    return;
+  }
+
+  // The workers copy whichever context is current as they start, so it's only current for as long as Start() takes
+  QOpenGLContext* previous_context = QOpenGLContext::currentContext();
+  QSurface* previous_surface = previous_context ? previous_context->surface() : nullptr;
+
+  if (!OpenGLBackend::SoftwareRendering()) {
+    context_ = new QOpenGLContext();
+    context_->setShareContext(QOpenGLContext::globalShareContext());
+
+    if (!context_->create() || !context_->makeCurrent(surface_)) {
+      set_error(tr("Failed to create an OpenGL context"));
+
+      if (previous_context != nullptr) {
+        previous_context->makeCurrent(previous_surface);
+      }
+
+      Release(false);
+      return;
+    }
+  }
+
+  exporter_ = new Exporter(snapshot_sequence_->viewer_output(), filenames_);
+  connect(exporter_, SIGNAL(ProgressChanged(int)), this, SLOT(ExporterProgress(int)));
+  connect(exporter_, SIGNAL(Finished()), this, SLOT(ExporterFinished()));
+
+  bool started = exporter_->Start();
+
+  if (previous_context != nullptr) {
+    previous_context->makeCurrent(previous_surface);
+  } else if (context_ != nullptr) {
+    context_->doneCurrent();
+  }
+
+  if (!started) {
+    set_error(exporter_->GetError());
+    delete exporter_;
+    exporter_ = nullptr;
+
+    Release(false);
+  }
+}
+
+void ExportTask::ExporterProgress(int progress)
+{
+  set_progress(progress);
+}
+
+void ExportTask::ExporterFinished()
+{
+  bool ok = exporter_->GetError().isEmpty();
+
+  if (!ok) {
+    set_error(exporter_->GetError());
+  }
+
+  // This is called from inside the Exporter, so it can only be deleted once it's returned
+  exporter_->deleteLater();
+  exporter_ = nullptr;
+
+  Release(ok);
+}
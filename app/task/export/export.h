@@ -0,0 +1,137 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef EXPORTTASK_H
+#define EXPORTTASK_H
+
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QPointer>
+#include <QSemaphore>
+#include <QStringList>
+#include <QUuid>
+
+#include "project/item/sequence/sequence.h"
+#include "project/project.h"
+#include "render/export/exporter.h"
+#include "task/task.h"
+
+/**
+ * @brief The ExportTask class
+ *
+ * Exports a sequence to one or more files through an Exporter. Every file queued for the same sequence before the Task
+ * starts (see QueueDeliverable()) is exported by the same Exporter, so the sequence is rendered once and encoded as
+ * many times as there are files.
+ *
+ * The sequence is copied when the Task starts, so edits made while it's exporting don't end up half way through the
+ * file. The Exporter runs in the main thread's event loop like the viewer's renders do, so any number of ExportTasks
+ * can run at once and still only render as much at a time as RenderBudget allows. Action() only waits for it to
+ * finish.
+ */
+class ExportTask : public Task
+{
+  Q_OBJECT
+public:
+  ExportTask(Project* project, Sequence* sequence, const QString& filename);
+
+  virtual ~ExportTask() override;
+
+  virtual bool Prologue() override;
+
+  virtual bool Action() override;
+
+  /**
+   * @brief Queue `sequence` to be exported to `filename`
+   *
+   * Must be called from the main thread.
+   *
+   * @return
+   *
+   * The new ExportTask, or nullptr if the file was added to an ExportTask for the same sequence that hasn't started
+   * yet.
+   */
+  static ExportTask* QueueDeliverable(Project* project, Sequence* sequence, const QString& filename);
+
+public slots:
+  /**
+   * @brief Cancel the Task, stopping the Exporter as well since Action() waits for it
+   */
+  virtual void Cancel() override;
+
+private:
+  void AddFilename(const QString& filename);
+
+  /**
+   * @brief Copy the project and find this Task's sequence in the copy
+   */
+  bool TakeSnapshot();
+
+  /**
+   * @brief Let Action() return with `ok` (main thread only)
+   */
+  void Release(bool ok);
+
+  QPointer<Project> project_;
+
+  QPointer<NodeGraph> sequence_;
+
+  QString sequence_name_;
+
+  QUuid sequence_uuid_;
+
+  QStringList filenames_;
+
+  ProjectPtr snapshot_;
+
+  Sequence* snapshot_sequence_;
+
+  QOffscreenSurface* surface_;
+
+  QOpenGLContext* context_;
+
+  Exporter* exporter_;
+
+  /**
+   * @brief Set once StartExport() has been queued, until the export finishes or fails (main thread only)
+   */
+  bool export_pending_;
+
+  bool result_;
+
+  /**
+   * @brief Released once Action() can return
+   */
+  QSemaphore finished_;
+
+  /**
+   * @brief ExportTasks that haven't started yet, for QueueDeliverable() to add files to (main thread only)
+   */
+  static QList<ExportTask*> waiting_tasks_;
+
+private slots:
+  void StartExport();
+
+  void ExporterProgress(int progress);
+
+  void ExporterFinished();
+
+};
+
+#endif // EXPORTTASK_H
@@ -31,8 +31,8 @@
 #include "panel/project/project.h"
 // End test code
 
+#include "decoder/decoder.h"
 #include "project/item/footage/footage.h"
-#include "task/probe/probe.h"
 #include "task/taskmanager.h"
 #include "undo/undostack.h"
 
@@ -40,42 +40,59 @@ ImportTask::ImportTask(ProjectViewModel *model, Folder *parent, const QStringLis
   model_(model),
   urls_(urls),
   parent_(parent),
-  command_(nullptr)
+  command_(new QUndoCommand()),
+  deletes_locked_(false),
+  add_queued_(false)
 {
   set_text(tr("Importing %1 files").arg(urls.size()));
+
+  // Walking directories and probing files is mostly waiting on the disk
+  set_resource(kIOBound);
+
+  // The user is watching the project fill up
+  set_priority(kInteractive);
+
+  connect(this, SIGNAL(Finished()), this, SLOT(FinishImport()));
+}
+
+ImportTask::~ImportTask()
+{
+  delete command_;
 }
 
 bool ImportTask::Action()
 {
   parent_->LockDeletes();
+  deletes_locked_ = true;
 
-  command_ = new QUndoCommand();
+  footage_.clear();
 
-  Import(urls_, parent_, command_);
+  Import(urls_, parent_);
 
-  // If this task was cancelled, we won't bother pushing an undo command (we don't end up with anything undoable since
-  // the undo command executes the final import anyway)
-  if (cancelled()) {
-    delete command_;
-    command_ = nullptr;
-    parent_->UnlockDeletes();
-  }
+  // Show the folder structure straight away, Footage follows as it's probed
+  QueueReadyItem(PendingItem(), true);
 
-  return true;
-}
+  next_footage_ = 0;
+  probed_count_ = 0;
 
-bool ImportTask::Epilogue()
-{
-  if (command_ != nullptr) {
-    olive::undo_stack.push(command_);
+  int thread_count = qMin(olive::task_manager.GetMaximumTaskCount(kIOBound), footage_.size());
+  QVector<ProbeThread*> threads(thread_count);
+
+  for (int i=0;i<threads.size();i++) {
+    threads[i] = new ProbeThread(this);
+    threads[i]->start();
   }
 
-  parent_->UnlockDeletes();
+  for (int i=0;i<threads.size();i++) {
+    threads.at(i)->wait();
+    delete threads.at(i);
+  }
 
+  // If this task was cancelled, only the Footage that was probed gets imported (see FinishImport())
   return true;
 }
 
-void ImportTask::Import(const QStringList &files, Folder *folder, QUndoCommand *parent_command)
+void ImportTask::Import(const QStringList &files, Folder *folder)
 {
   for (int i=0;i<files.size();i++) {
 
@@ -105,11 +122,11 @@ void ImportTask::Import(const QStringList &files, Folder *folder, QUndoCommand *
 
         f->set_name(file_info.fileName());
 
-        // Create undoable command that adds the items to the model
-        new ProjectViewModel::AddItemCommand(model_,
-                                             folder,
-                                             f,
-                                             parent_command);
+        // Folders are added to the model before any Footage, so their contents always have somewhere to go
+        PendingItem pending;
+        pending.folder = folder;
+        pending.item = f;
+        QueueReadyItem(pending, false);
 
         // Convert QFileInfoList into QStringList
         QStringList full_urls;
@@ -121,7 +138,7 @@ void ImportTask::Import(const QStringList &files, Folder *folder, QUndoCommand *
         }
 
         // Recursively follow this path
-        Import(full_urls, static_cast<Folder*>(f.get()), parent_command);
+        Import(full_urls, static_cast<Folder*>(f.get()));
       }
 
     } else {
@@ -135,26 +152,115 @@ void ImportTask::Import(const QStringList &files, Folder *folder, QUndoCommand *
       f->set_name(file_info.fileName());
       f->set_timestamp(file_info.lastModified());
 
-      // Create undoable command that adds the items to the model
-      new ProjectViewModel::AddItemCommand(model_,
-                                           folder,
-                                           f,
-                                           parent_command);
+      // Queue this media to be analyzed by the probe threads
+      PendingItem pending;
+      pending.folder = folder;
+      pending.item = f;
+      footage_.append(pending);
 
-      // Create ProbeTask to analyze this media
-      TaskPtr pt = std::make_shared<ProbeTask>(f);
+    }
 
-      // The task won't work unless it's in the main thread and we're definitely not
-      // FIXME: Should Tasks check what thread they're in and move themselves to the main thread?
-      pt->moveToThread(qApp->thread());
+  }
+}
 
-      // Queue task in task manager
-      new TaskManager::AddTaskCommand(pt, parent_command);
-      //olive::task_manager.AddTask(pt);
+void ImportTask::ProbeFootage()
+{
+  while (!cancelled()) {
+    int index = next_footage_.fetchAndAddOrdered(1);
 
+    if (index >= footage_.size()) {
+      break;
     }
 
-    emit ProgressChanged(i * 100 / files.size());
+    const PendingItem& pending = footage_.at(index);
+    Footage* footage = static_cast<Footage*>(pending.item.get());
+
+    footage->LockDeletes();
+
+    Decoder::ProbeMedia(footage);
+
+    footage->UnlockDeletes();
+
+    int probed = probed_count_.fetchAndAddOrdered(1) + 1;
+
+    QueueReadyItem(pending, probed == footage_.size());
+
+    set_progress(probed * 100 / footage_.size());
+  }
+}
+
+void ImportTask::QueueReadyItem(const PendingItem &item, bool flush)
+{
+  ready_lock_.lock();
+
+  if (item.item) {
+    ready_.append(item);
+  }
+
+  // Only one AddReadyItems() is queued at a time, it takes every item that's ready by the time it runs
+  bool queue_add = !add_queued_ && (flush || ready_.size() >= kBatchSize);
+
+  if (queue_add) {
+    add_queued_ = true;
+  }
+
+  ready_lock_.unlock();
+
+  if (queue_add) {
+    QMetaObject::invokeMethod(this, "AddReadyItems", Qt::QueuedConnection);
+  }
+}
+
+void ImportTask::AddReadyItems()
+{
+  ready_lock_.lock();
+
+  QVector<PendingItem> items = ready_;
+  ready_.clear();
+  add_queued_ = false;
+
+  ready_lock_.unlock();
+
+  if (command_ == nullptr) {
+    return;
+  }
+
+  // Run each command now so the items show up, pushing command_ later won't run them again
+  foreach (const PendingItem& pending, items) {
+    QUndoCommand* add_command = new ProjectViewModel::AddItemCommand(model_, pending.folder, pending.item, command_);
+    add_command->redo();
+  }
+}
+
+void ImportTask::FinishImport()
+{
+  if (command_ == nullptr) {
+    return;
+  }
+
+  // Probing has finished, so anything left over can be added here
+  AddReadyItems();
+
+  if (command_->childCount() > 0) {
+    olive::undo_stack.push(command_);
+  } else {
+    delete command_;
+  }
+
+  command_ = nullptr;
 
+  if (deletes_locked_) {
+    parent_->UnlockDeletes();
+    deletes_locked_ = false;
   }
 }
+
+ImportTask::ProbeThread::ProbeThread(ImportTask *task) :
+  task_(task)
+{
+}
+
+void ImportTask::ProbeThread::run()
+{
+  task_->ProbeFootage();
+}
@@ -21,6 +21,11 @@
 #ifndef IMPORT_H
 #define IMPORT_H
 
+#include <QMutex>
+#include <QThread>
+#include <QUndoCommand>
+#include <QVector>
+
 #include "project/projectviewmodel.h"
 #include "project/item/folder/folder.h"
 #include "task/task.h"
@@ -28,10 +33,15 @@
 /**
  * @brief The ImportTask class
  *
- * A background task to create Footage objects from a list of URLs, and then create ProbeTasks for each of them.
+ * A background task to create Footage objects from a list of URLs and probe them.
  *
  * Using this Task is the best way to import media into a project since it will run in the background/multithreaded
  * without pausing the main thread.
+ *
+ * Rather than queueing a ProbeTask per file, every file is probed by a small pool of threads inside this Task (sized
+ * by TaskManager's I/O-bound limit), so importing thousands of files doesn't create thousands of Tasks up front.
+ * Probed Footage is added to the ProjectViewModel in batches as it's ready, and the whole import is pushed as one undo
+ * command when the Task finishes (or is cancelled, in which case only what was probed so far is imported).
  */
 class ImportTask : public Task
 {
@@ -39,18 +49,78 @@ class ImportTask : public Task
 public:
   ImportTask(ProjectViewModel* model, Folder *parent, const QStringList& urls);
 
-  virtual bool Action() override;
+  virtual ~ImportTask() override;
 
-  virtual bool Epilogue() override;
+  virtual bool Action() override;
 
 private:
-  void Import(const QStringList& files, Folder* folder, QUndoCommand* parent_command);
+  /**
+   * @brief An item waiting to be added to the model and the folder it goes in
+   */
+  struct PendingItem {
+    Item* folder;
+    ItemPtr item;
+  };
+
+  class ProbeThread : public QThread
+  {
+  public:
+    ProbeThread(ImportTask* task);
+
+  protected:
+    virtual void run() override;
+
+  private:
+    ImportTask* task_;
+  };
+
+  /**
+   * @brief Walk the file list recursively, creating folders straight away and collecting Footage for probing
+   */
+  void Import(const QStringList& files, Folder* folder);
+
+  /**
+   * @brief Main loop of each ProbeThread, probes Footage until there's none left or the Task is cancelled
+   */
+  void ProbeFootage();
+
+  /**
+   * @brief Queue an item to be added to the model, scheduling AddReadyItems() if a batch is due
+   */
+  void QueueReadyItem(const PendingItem& item, bool flush);
+
+  /**
+   * @brief Number of probed items that are added to the model at once
+   */
+  static const int kBatchSize = 64;
 
   ProjectViewModel* model_;
   QStringList urls_;
   Folder* parent_;
 
   QUndoCommand* command_;
+
+  bool deletes_locked_;
+
+  QVector<PendingItem> footage_;
+  QAtomicInt next_footage_;
+  QAtomicInt probed_count_;
+
+  QMutex ready_lock_;
+  QVector<PendingItem> ready_;
+  bool add_queued_;
+
+private slots:
+  /**
+   * @brief Add every item that's ready to the model (main thread only)
+   */
+  void AddReadyItems();
+
+  /**
+   * @brief Add any remaining items and push the undo command once the Task is done
+   */
+  void FinishImport();
+
 };
 
 #endif // IMPORT_H
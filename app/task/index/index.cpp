@@ -0,0 +1,128 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#include "index.h"
+
+#include <QFileInfo>
+#include <QThread>
+
+#include "decoder/decoder.h"
+#include "project/item/footage/footage.h"
+#include "task/taskmanager.h"
+
+QSet<QString> IndexTask::queued_files_;
+
+IndexTask::IndexTask(StreamPtr stream) :
+  stream_(stream),
+  filename_(stream->footage()->filename())
+{
+  set_text(tr("Indexing \"%1\"").arg(QFileInfo(filename_).fileName()));
+
+  // Indexing reads the entire file
+  set_resource(kIOBound);
+
+  // Nothing is waiting on a background index, and cancelling one only means it starts again from scratch later
+  set_priority(kBackground);
+  set_preemptible(true);
+
+  queued_files_.insert(filename_);
+}
+
+IndexTask::~IndexTask()
+{
+  queued_files_.remove(filename_);
+}
+
+bool IndexTask::Action()
+{
+  // Indexing ahead of time is never more important than anything the user is waiting on
+  QThread::currentThread()->setPriority(QThread::LowPriority);
+
+  index_cancelled_.storeRelease(0);
+
+  Footage* footage = stream_->footage();
+
+  footage->LockDeletes();
+
+  bool result = true;
+
+  // Usually the first stream indexes every other one in the same pass and the rest find they're indexed already, but
+  // a file that's grown since it was last indexed has its video and audio indexed in separate passes
+  foreach (StreamPtr stream, footage->streams()) {
+    if (stream->type() != Stream::kVideo && stream->type() != Stream::kAudio) {
+      continue;
+    }
+
+    if (index_cancelled_.loadAcquire()) {
+      break;
+    }
+
+    DecoderPtr decoder = Decoder::CreateFromID(footage->decoder());
+
+    if (decoder == nullptr) {
+      set_error(tr("Failed to find a decoder for this file"));
+      result = false;
+      break;
+    }
+
+    decoder->set_stream(stream);
+
+    if (!decoder->Open()) {
+      set_error(tr("Failed to open this file"));
+      result = false;
+      break;
+    }
+
+    decoder->Index(&index_cancelled_);
+
+    // A file that's still being written is longer than it was when it was probed
+    int64_t duration = decoder->IndexedDuration();
+
+    if (duration > stream->duration()) {
+      stream->set_duration(duration);
+    }
+
+    decoder->Close();
+  }
+
+  footage->UnlockDeletes();
+
+  return result;
+}
+
+void IndexTask::IndexInBackground(StreamPtr stream)
+{
+  if (stream == nullptr
+      || (stream->type() != Stream::kVideo && stream->type() != Stream::kAudio)
+      || stream->footage()->status() != Footage::kReady
+      || queued_files_.contains(stream->footage()->filename())) {
+    return;
+  }
+
+  olive::task_manager.AddTask(std::make_shared<IndexTask>(stream));
+}
+
+void IndexTask::Cancel()
+{
+  index_cancelled_.storeRelease(1);
+
+  Task::Cancel();
+}
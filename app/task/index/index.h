@@ -0,0 +1,81 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#ifndef INDEXTASK_H
+#define INDEXTASK_H
+
+#include <QAtomicInt>
+#include <QSet>
+
+#include "project/item/footage/stream.h"
+#include "task/task.h"
+
+/**
+ * @brief The IndexTask class
+ *
+ * A low priority background task that indexes a media file ahead of it being played, so the first render that needs
+ * it doesn't have to wait for the whole file to be read.
+ *
+ * Import only probes the file's headers. Indexing is deferred to this Task, which is queued through
+ * IndexInBackground() once a stream of the file is actually used (e.g. placed in a sequence). Every stream of the
+ * file is indexed in the same pass where possible (see FFmpegIndexer), so one IndexTask is queued per file.
+ *
+ * Queueing one again once the file has grown (see FootageWatcher) indexes what's been added and lengthens its streams
+ * to match.
+ */
+class IndexTask : public Task
+{
+  Q_OBJECT
+public:
+  IndexTask(StreamPtr stream);
+
+  virtual ~IndexTask() override;
+
+  virtual bool Action() override;
+
+  /**
+   * @brief Queue an IndexTask for the file `stream` belongs to, unless one is already queued
+   *
+   * Must be called from the main thread.
+   */
+  static void IndexInBackground(StreamPtr stream);
+
+public slots:
+  /**
+   * @brief Cancel the Task, stopping the decoder part way through the file rather than after it
+   */
+  virtual void Cancel() override;
+
+private:
+  StreamPtr stream_;
+
+  QString filename_;
+
+  QAtomicInt index_cancelled_;
+
+  /**
+   * @brief Filenames that currently have an IndexTask (main thread only)
+   */
+  static QSet<QString> queued_files_;
+
+};
+
+#endif // INDEXTASK_H
@@ -0,0 +1,248 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "prerender.h"
+
+#include "common/timecodefunctions.h"
+#include "render/backend/opengl/openglbackend.h"
+#include "render/diskcachemanager.h"
+#include "task/taskmanager.h"
+
+PreRenderTask::PreRenderTask(Sequence *sequence, const rational &in, const rational &out) :
+  viewer_(sequence->viewer_output()),
+  in_(in),
+  out_(out),
+  surface_(nullptr),
+  context_(nullptr),
+  backend_(nullptr),
+  render_pending_(false),
+  result_(false),
+  rendered_count_(0)
+{
+  // The user is about to play this range and is waiting for it
+  set_priority(kInteractive);
+
+  const rational& timebase = sequence->video_params().time_base();
+  olive::TimecodeDisplay display = olive::CurrentTimecodeDisplay();
+
+  set_text(tr("Pre-rendering \"%1\" from %2 to %3").arg(sequence->name(),
+                                                        olive::timestamp_to_timecode(olive::time_to_timestamp(in, timebase),
+                                                                                     timebase,
+                                                                                     display),
+                                                        olive::timestamp_to_timecode(olive::time_to_timestamp(out, timebase),
+                                                                                     timebase,
+                                                                                     display)));
+}
+
+PreRenderTask::~PreRenderTask()
+{
+  CloseBackend();
+
+  delete context_;
+  delete surface_;
+}
+
+bool PreRenderTask::Prologue()
+{
+  if (!viewer_) {
+    set_error(tr("The sequence no longer exists"));
+    return false;
+  }
+
+  // Render workers share with whichever context is current when they start. The surface has to be made here in the
+  // main thread, StartRender() makes the context once there's one to make current on it.
+  surface_ = new QOffscreenSurface();
+  surface_->create();
+
+  rendered_count_ = 0;
+  render_timer_.invalidate();
+
+  render_pending_ = true;
+
+  QMetaObject::invokeMethod(this, "StartRender", Qt::QueuedConnection);
+
+  return true;
+}
+
+bool PreRenderTask::Action()
+{
+  finished_.acquire();
+
+  return result_;
+}
+
+QString PreRenderTask::detail()
+{
+  if (!render_timer_.isValid() || rendered_count_ == 0) {
+    return QString();
+  }
+
+  qint64 elapsed = qMax(static_cast<qint64>(1), render_timer_.elapsed());
+
+  return tr("%1 fps").arg(static_cast<double>(rendered_count_) * 1000.0 / static_cast<double>(elapsed), 0, 'f', 1);
+}
+
+PreRenderTask *PreRenderTask::Queue(Sequence *sequence, const rational &in, const rational &out)
+{
+  std::shared_ptr<PreRenderTask> task = std::make_shared<PreRenderTask>(sequence, in, out);
+
+  olive::task_manager.AddTask(task);
+
+  return task.get();
+}
+
+void PreRenderTask::Cancel()
+{
+  // Action() is waiting on rendering that happens in the main thread, it has to be stopped here or Task::Cancel()
+  // would wait for Action() forever
+  if (render_pending_) {
+    CloseBackend();
+    Release(false);
+  }
+
+  Task::Cancel();
+}
+
+void PreRenderTask::Release(bool ok)
+{
+  render_pending_ = false;
+
+  result_ = ok;
+  finished_.release();
+}
+
+void PreRenderTask::PinRenderedFrames()
+{
+  // Pins are released with the viewer, so there's nothing to pin if it's already gone
+  if (!viewer_) {
+    return;
+  }
+
+  QStringList filenames;
+
+  for (int64_t i=0;i<backend_->frame_count();i++) {
+    QByteArray hash = backend_->FrameHash(i);
+
+    // Frames with nothing in them (e.g. gaps) aren't in the cache at all
+    if (!hash.isEmpty()) {
+      QString filename = backend_->frame_cache()->LocalFilename(hash);
+
+      if (!filename.isEmpty()) {
+        filenames.append(filename);
+      }
+    }
+  }
+
+  DiskCacheManager::instance()->SetPinnedFiles(viewer_, filenames);
+}
+
+void PreRenderTask::CloseBackend()
+{
+  if (backend_ != nullptr) {
+    disconnect(backend_, SIGNAL(FramesRendered()), this, SLOT(FramesRendered()));
+
+    backend_->SetViewerNode(nullptr);
+    backend_->deleteLater();
+    backend_ = nullptr;
+  }
+}
+
+void PreRenderTask::StartRender()
+{
+  if (!render_pending_) {
+    // Cancelled before it got the chance to start
+    return;
+  }
+
+  if (!viewer_) {
+    set_error(tr("The sequence no longer exists"));
+    Release(false);
+    return;
+  }
+
+  // The workers copy whichever context is current as they start, so it's only current for as long as this takes
+  QOpenGLContext* previous_context = QOpenGLContext::currentContext();
+  QSurface* previous_surface = previous_context ? previous_context->surface() : nullptr;
+
+  if (!OpenGLBackend::SoftwareRendering()) {
+    context_ = new QOpenGLContext();
+    context_->setShareContext(QOpenGLContext::globalShareContext());
+
+    if (!context_->create() || !context_->makeCurrent(surface_)) {
+      set_error(tr("Failed to create an OpenGL context"));
+
+      if (previous_context != nullptr) {
+        previous_context->makeCurrent(previous_surface);
+      }
+
+      Release(false);
+      return;
+    }
+  }
+
+  // Connecting the viewer sets the parameters and cache name the viewer itself renders with, so the frames end up
+  // exactly where it'll look for them
+  backend_ = new ExportVideoBackend();
+  backend_->SetViewerNode(viewer_);
+  connect(backend_, SIGNAL(FramesRendered()), this, SLOT(FramesRendered()));
+
+  bool started = backend_->StartRender(in_, out_);
+
+  if (previous_context != nullptr) {
+    previous_context->makeCurrent(previous_surface);
+  } else if (context_ != nullptr) {
+    context_->doneCurrent();
+  }
+
+  if (!started) {
+    set_error(backend_->GetError());
+    CloseBackend();
+
+    Release(false);
+    return;
+  }
+
+  render_timer_.start();
+
+  // There may be nothing to render at all
+  FramesRendered();
+}
+
+void PreRenderTask::FramesRendered()
+{
+  if (backend_ == nullptr) {
+    return;
+  }
+
+  rendered_count_ = backend_->rendered_count();
+
+  int64_t frame_count = backend_->frame_count();
+
+  set_progress(frame_count > 0 ? static_cast<int>(rendered_count_ * 100 / frame_count) : 100);
+
+  if (backend_->IsFinished()) {
+    PinRenderedFrames();
+
+    // This is called from inside the backend, so it can only be deleted once it's returned
+    CloseBackend();
+
+    Release(true);
+  }
+}
@@ -0,0 +1,136 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PRERENDERTASK_H
+#define PRERENDERTASK_H
+
+#include <QElapsedTimer>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QPointer>
+#include <QSemaphore>
+
+#include "project/item/sequence/sequence.h"
+#include "render/export/exporter.h"
+#include "task/task.h"
+
+/**
+ * @brief Renders a range of a sequence into the viewer's cache ahead of playing it, e.g. before a client session
+ *
+ * The frames are rendered at the parameters the viewer plays at when it isn't lowering its quality to keep up (see
+ * VideoRenderBackend::SetPreviewQuality()), and to the same cache, so once the Task has finished the whole range plays
+ * from the disk cache. Unlike the viewer's own cache fill, this isn't background work, so it's scheduled ahead of it
+ * and isn't throttled while the user is working.
+ *
+ * Once every frame has been written, the files they're in are pinned in DiskCacheManager so they aren't evicted to make
+ * room for other frames. The pins belong to the sequence's viewer, so pre-rendering the same sequence again replaces
+ * them and closing the sequence releases them.
+ *
+ * Like ExportTask, the rendering happens in the main thread's event loop and Action() only waits for it to finish.
+ * Unlike ExportTask, the live sequence is rendered rather than a copy, so edits made in the range while it's running
+ * are rendered too.
+ */
+class PreRenderTask : public Task
+{
+  Q_OBJECT
+public:
+  PreRenderTask(Sequence* sequence, const rational& in, const rational& out);
+
+  virtual ~PreRenderTask() override;
+
+  virtual bool Prologue() override;
+
+  virtual bool Action() override;
+
+  /**
+   * @brief How many frames a second have been rendered (or found already cached) so far
+   */
+  virtual QString detail() override;
+
+  /**
+   * @brief Queue the frames of `sequence` from `in` up to (but not including) `out` to be pre-rendered
+   *
+   * Must be called from the main thread.
+   */
+  static PreRenderTask* Queue(Sequence* sequence, const rational& in, const rational& out);
+
+public slots:
+  /**
+   * @brief Cancel the Task, which stops the rendering as well since Action() waits for it
+   *
+   * Frames that were already rendered stay in the cache, but aren't pinned.
+   */
+  virtual void Cancel() override;
+
+private:
+  /**
+   * @brief Let Action() return with `ok` (main thread only)
+   */
+  void Release(bool ok);
+
+  /**
+   * @brief Pin the files every rendered frame is in (see DiskCacheManager::SetPinnedFiles())
+   */
+  void PinRenderedFrames();
+
+  /**
+   * @brief Disconnect and delete the backend (it may be in the middle of signalling, so it's deleted later)
+   */
+  void CloseBackend();
+
+  QPointer<ViewerOutput> viewer_;
+
+  rational in_;
+
+  rational out_;
+
+  QOffscreenSurface* surface_;
+
+  QOpenGLContext* context_;
+
+  ExportVideoBackend* backend_;
+
+  /**
+   * @brief Set once StartRender() has been queued, until the render finishes or fails (main thread only)
+   */
+  bool render_pending_;
+
+  bool result_;
+
+  /**
+   * @brief Released once Action() can return
+   */
+  QSemaphore finished_;
+
+  /**
+   * @brief Started when the backend starts rendering, for detail()
+   */
+  QElapsedTimer render_timer_;
+
+  int64_t rendered_count_;
+
+private slots:
+  void StartRender();
+
+  void FramesRendered();
+
+};
+
+#endif // PRERENDERTASK_H
@@ -30,6 +30,9 @@ ProbeTask::ProbeTask(FootagePtr footage) :
   QString base_filename = QFileInfo(footage_->filename()).fileName();
 
   set_text(tr("Probing \"%1\"").arg(base_filename));
+
+  // Probing mostly waits on reading the file's headers
+  set_resource(kIOBound);
 }
 
 bool ProbeTask::Action()
@@ -0,0 +1,431 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "proxy.h"
+
+extern "C" {
+#include <libavutil/opt.h>
+}
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+#include <QtMath>
+
+#include "common/filefunctions.h"
+#include "common/timecodefunctions.h"
+#include "decoder/decoder.h"
+#include "project/item/footage/footage.h"
+#include "render/pixelservice.h"
+#include "task/taskmanager.h"
+
+// Intra-frame, cheap to decode, and 4:2:2 10-bit so high bit depth footage doesn't band in the preview
+const char* const kProxyEncoder = "prores_ks";
+const char* const kProxyProfile = "0";
+const AVPixelFormat kProxyPixelFormat = AV_PIX_FMT_YUV422P10LE;
+
+QSet<QString> ProxyTask::queued_proxies_;
+
+ProxyTask::ProxyTask(VideoStreamPtr stream, int divider) :
+  stream_(stream),
+  divider_(divider),
+  queue_key_(GetQueueKey(stream.get(), divider)),
+  fmt_ctx_(nullptr),
+  codec_ctx_(nullptr),
+  avstream_(nullptr),
+  pkt_(nullptr),
+  frame_(nullptr),
+  scale_ctx_(nullptr)
+{
+  set_text(tr("Creating 1/%1 proxy of \"%2\"").arg(QString::number(divider_),
+                                                   QFileInfo(stream_->footage()->filename()).fileName()));
+
+  // Decoding, scaling and encoding every frame
+  set_resource(kCPUBound);
+
+  // Nobody is waiting on a proxy, but restarting one from scratch would throw away a lot of work
+  set_priority(kBackground);
+
+  queued_proxies_.insert(queue_key_);
+}
+
+ProxyTask::~ProxyTask()
+{
+  queued_proxies_.remove(queue_key_);
+}
+
+bool ProxyTask::Action()
+{
+  // Making proxies ahead of time is never more important than anything the user is waiting on
+  QThread::currentThread()->setPriority(QThread::LowPriority);
+
+  Footage* footage = stream_->footage();
+
+  footage->LockDeletes();
+
+  QString filename = GetProxyFilename();
+
+  bool result = false;
+
+  // Proxies made earlier (e.g. in a previous session) are re-used
+  if (QFileInfo::exists(filename) || Transcode(filename)) {
+    result = AttachProxy(filename);
+  }
+
+  footage->UnlockDeletes();
+
+  return result;
+}
+
+void ProxyTask::CreateProxies(Footage *footage, int divider)
+{
+  if (footage->status() != Footage::kReady) {
+    return;
+  }
+
+  foreach (StreamPtr stream, footage->streams()) {
+    if (stream->type() == Stream::kVideo && !queued_proxies_.contains(GetQueueKey(stream.get(), divider))) {
+      olive::task_manager.AddTask(std::make_shared<ProxyTask>(std::static_pointer_cast<VideoStream>(stream), divider));
+    }
+  }
+}
+
+QString ProxyTask::GetProxyFilename()
+{
+  QDir proxy_dir(QDir(GetMediaIndexLocation()).filePath(QStringLiteral("proxies")));
+
+  proxy_dir.mkpath(".");
+
+  return proxy_dir.filePath(QStringLiteral("%1%2_%3.mov").arg(GetUniqueFileIdentifier(stream_->footage()->filename()),
+                                                              QString::number(stream_->index()),
+                                                              QString::number(divider_)));
+}
+
+bool ProxyTask::Transcode(const QString &filename)
+{
+  rational frame_rate = stream_->frame_rate();
+
+  if (frame_rate.isNull() || frame_rate.numerator() <= 0) {
+    set_error(tr("This stream doesn't have a frame rate"));
+    return false;
+  }
+
+  DecoderPtr decoder = Decoder::CreateFromID(stream_->footage()->decoder());
+
+  if (decoder == nullptr) {
+    set_error(tr("Failed to find a decoder for this file"));
+    return false;
+  }
+
+  decoder->set_stream(stream_);
+
+  if (!decoder->Open()) {
+    set_error(tr("Failed to open this file"));
+    return false;
+  }
+
+  // The proxy is written somewhere else first so an unfinished proxy is never mistaken for a finished one
+  QString partial_filename = filename;
+  partial_filename.append(QStringLiteral(".part"));
+
+  bool result = false;
+
+  if (OpenEncoder(partial_filename, frame_rate)) {
+    int64_t frame_count = qCeil((rational(stream_->duration()) * stream_->timebase() * frame_rate).toDouble());
+
+    // Decoder times are the stream's own timestamps, so the first frame isn't necessarily at 0. The proxy starts at
+    // the same time (rounded down to a proxy frame) so the same times can decode either.
+    rational start_time = rational(stream_->start_time()) * stream_->timebase();
+    int64_t start_pts = qFloor((start_time * frame_rate).toDouble());
+
+    int64_t i;
+
+    for (i=0;i<frame_count && !cancelled();i++) {
+      // Decoding at the proxy's size means lowres decoding can do most of the scaling
+      FramePtr frame = decoder->RetrieveVideo(start_time + olive::timestamp_to_time(i, codec_ctx_->time_base),
+                                              divider_);
+
+      if (frame == nullptr) {
+        set_error(tr("Failed to decode frame %1").arg(i));
+        break;
+      }
+
+      if (!EncodeFrame(frame, start_pts + i)) {
+        break;
+      }
+
+      set_progress(static_cast<int>(100 * (i + 1) / frame_count));
+    }
+
+    // A proxy that's missing frames is no use to anyone
+    if (i == frame_count && WriteFrame(nullptr)) {
+      int error_code = av_write_trailer(fmt_ctx_);
+
+      if (error_code < 0) {
+        FFmpegError(tr("Failed to finish proxy file"), error_code);
+      } else {
+        result = true;
+      }
+    }
+  }
+
+  CloseEncoder();
+
+  decoder->Close();
+
+  if (result) {
+    result = QFile::rename(partial_filename, filename);
+
+    if (!result) {
+      set_error(tr("Failed to save proxy file"));
+    }
+  }
+
+  if (!result) {
+    QFile::remove(partial_filename);
+  }
+
+  return result;
+}
+
+bool ProxyTask::OpenEncoder(const QString &filename, const rational &frame_rate)
+{
+  AVCodec* codec = avcodec_find_encoder_by_name(kProxyEncoder);
+
+  if (codec == nullptr) {
+    set_error(tr("This build of FFmpeg doesn't have a ProRes encoder"));
+    return false;
+  }
+
+  int error_code = avformat_alloc_output_context2(&fmt_ctx_, nullptr, "mov", nullptr);
+
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to create proxy container"), error_code);
+    return false;
+  }
+
+  avstream_ = avformat_new_stream(fmt_ctx_, nullptr);
+  codec_ctx_ = avcodec_alloc_context3(codec);
+  pkt_ = av_packet_alloc();
+  frame_ = av_frame_alloc();
+
+  if (avstream_ == nullptr || codec_ctx_ == nullptr || pkt_ == nullptr || frame_ == nullptr) {
+    set_error(tr("Failed to allocate resources for encoding"));
+    return false;
+  }
+
+  // 4:2:2 chroma needs an even width, and ProRes needs an even height
+  codec_ctx_->width = qMax(2, (stream_->width() / divider_) & ~1);
+  codec_ctx_->height = qMax(2, (stream_->height() / divider_) & ~1);
+  codec_ctx_->sample_aspect_ratio = {1, 1};
+  codec_ctx_->pix_fmt = kProxyPixelFormat;
+  codec_ctx_->time_base = frame_rate.flipped().toAVRational();
+  codec_ctx_->framerate = frame_rate.toAVRational();
+
+  // swscale converts with BT.601 unless told otherwise, both here and when the proxy is decoded
+  codec_ctx_->colorspace = AVCOL_SPC_SMPTE170M;
+  codec_ctx_->color_range = AVCOL_RANGE_MPEG;
+
+  if (fmt_ctx_->oformat->flags & AVFMT_GLOBALHEADER) {
+    codec_ctx_->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+  }
+
+  av_opt_set(codec_ctx_->priv_data, "profile", kProxyProfile, 0);
+
+  error_code = avcodec_open2(codec_ctx_, codec, nullptr);
+
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to open proxy encoder"), error_code);
+    return false;
+  }
+
+  avcodec_parameters_from_context(avstream_->codecpar, codec_ctx_);
+  avstream_->time_base = codec_ctx_->time_base;
+
+  error_code = avio_open(&fmt_ctx_->pb, filename.toUtf8(), AVIO_FLAG_WRITE);
+
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to create proxy file"), error_code);
+    return false;
+  }
+
+  // The muxer may change the stream's timebase here, packets are rescaled to it in WriteFrame()
+  error_code = avformat_write_header(fmt_ctx_, nullptr);
+
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to write proxy header"), error_code);
+    return false;
+  }
+
+  frame_->format = kProxyPixelFormat;
+  frame_->width = codec_ctx_->width;
+  frame_->height = codec_ctx_->height;
+
+  error_code = av_frame_get_buffer(frame_, 0);
+
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to allocate resources for encoding"), error_code);
+    return false;
+  }
+
+  return true;
+}
+
+void ProxyTask::CloseEncoder()
+{
+  sws_freeContext(scale_ctx_);
+  scale_ctx_ = nullptr;
+
+  av_frame_free(&frame_);
+  av_packet_free(&pkt_);
+  avcodec_free_context(&codec_ctx_);
+
+  if (fmt_ctx_ != nullptr) {
+    avio_closep(&fmt_ctx_->pb);
+    avformat_free_context(fmt_ctx_);
+    fmt_ctx_ = nullptr;
+  }
+
+  // Freed along with the format context
+  avstream_ = nullptr;
+}
+
+bool ProxyTask::EncodeFrame(FramePtr frame, int64_t pts)
+{
+  // swscale doesn't take float formats
+  if (frame->format() != olive::PIX_FMT_RGBA8 && frame->format() != olive::PIX_FMT_RGBA16U) {
+    frame = PixelService::ConvertPixelFormat(frame, olive::PIX_FMT_RGBA16U);
+  }
+
+  scale_ctx_ = sws_getCachedContext(scale_ctx_,
+                                    frame->width(),
+                                    frame->height(),
+                                    (frame->format() == olive::PIX_FMT_RGBA8) ? AV_PIX_FMT_RGBA : AV_PIX_FMT_RGBA64,
+                                    frame_->width,
+                                    frame_->height,
+                                    kProxyPixelFormat,
+                                    SWS_BILINEAR,
+                                    nullptr,
+                                    nullptr,
+                                    nullptr);
+
+  if (scale_ctx_ == nullptr) {
+    set_error(tr("Failed to create pixel format conversion context"));
+    return false;
+  }
+
+  // The encoder may still be holding on to the last frame's buffer
+  int error_code = av_frame_make_writable(frame_);
+
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to allocate resources for encoding"), error_code);
+    return false;
+  }
+
+  const uint8_t* src_data = reinterpret_cast<const uint8_t*>(frame->const_data());
+  int src_linesize = frame->width() * PixelService::BytesPerPixel(frame->format());
+
+  sws_scale(scale_ctx_,
+            &src_data,
+            &src_linesize,
+            0,
+            frame->height(),
+            frame_->data,
+            frame_->linesize);
+
+  frame_->pts = pts;
+
+  return WriteFrame(frame_);
+}
+
+bool ProxyTask::WriteFrame(AVFrame *frame)
+{
+  int error_code = avcodec_send_frame(codec_ctx_, frame);
+
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to encode proxy frame"), error_code);
+    return false;
+  }
+
+  while ((error_code = avcodec_receive_packet(codec_ctx_, pkt_)) >= 0) {
+    av_packet_rescale_ts(pkt_, codec_ctx_->time_base, avstream_->time_base);
+    pkt_->stream_index = avstream_->index;
+
+    // Takes ownership of the packet's data
+    error_code = av_interleaved_write_frame(fmt_ctx_, pkt_);
+
+    if (error_code < 0) {
+      FFmpegError(tr("Failed to write proxy frame"), error_code);
+      return false;
+    }
+  }
+
+  // The encoder wanting more frames (or having been flushed completely) isn't an error
+  if (error_code != AVERROR(EAGAIN) && error_code != AVERROR_EOF) {
+    FFmpegError(tr("Failed to encode proxy frame"), error_code);
+    return false;
+  }
+
+  return true;
+}
+
+bool ProxyTask::AttachProxy(const QString &filename)
+{
+  FootagePtr proxy = std::make_shared<Footage>();
+
+  proxy->set_filename(filename);
+  proxy->set_timestamp(QFileInfo(filename).lastModified());
+
+  if (!Decoder::ProbeMedia(proxy.get())
+      || proxy->stream_count() == 0
+      || proxy->stream(0)->type() != Stream::kVideo) {
+    set_error(tr("Failed to read proxy file"));
+    return false;
+  }
+
+  ImageStreamPtr proxy_stream = std::static_pointer_cast<ImageStream>(proxy->stream(0));
+
+  // The proxy's pixels still mean what the original's do
+  proxy_stream->set_colorspace(stream_->colorspace());
+  proxy_stream->set_premultiplied_alpha(stream_->premultiplied_alpha());
+
+  proxy_stream->set_proxy_divider(divider_);
+
+  // Render threads pick this up straight away, Footage::set_proxy() is thread-safe
+  stream_->footage()->set_proxy(stream_->index(), proxy);
+
+  return true;
+}
+
+void ProxyTask::FFmpegError(const QString &message, int error_code)
+{
+  char err[1024];
+  av_strerror(error_code, err, 1024);
+
+  set_error(QStringLiteral("%1: %2").arg(message, err));
+}
+
+QString ProxyTask::GetQueueKey(Stream *stream, int divider)
+{
+  return QStringLiteral("%1:%2:%3").arg(stream->footage()->filename(),
+                                       QString::number(stream->index()),
+                                       QString::number(divider));
+}
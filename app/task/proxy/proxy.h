@@ -0,0 +1,142 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PROXYTASK_H
+#define PROXYTASK_H
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
+}
+
+#include <QSet>
+
+#include "decoder/frame.h"
+#include "project/item/footage/videostream.h"
+#include "task/task.h"
+
+/**
+ * @brief The ProxyTask class
+ *
+ * A background task that transcodes a video stream into an edit-friendly proxy: an intra-frame codec (ProRes Proxy)
+ * at a fraction of the original resolution, so every frame can be decoded cheaply without seeking from a keyframe.
+ *
+ * Once the proxy is made, it's attached to the original Footage with Footage::set_proxy(). Preview renders decode the
+ * proxy from then on, exports still decode the original (see VideoRenderWorker::ResolveDecodeStream()).
+ *
+ * Proxies are stored in the media index folder, keyed by the original file's identifier, so making a proxy of a file
+ * that already has one at the same size only attaches it.
+ */
+class ProxyTask : public Task
+{
+  Q_OBJECT
+public:
+  /**
+   * @brief ProxyTask Constructor
+   *
+   * @param divider
+   *
+   * How many times smaller than the original the proxy should be (e.g. 2 for half resolution).
+   */
+  ProxyTask(VideoStreamPtr stream, int divider);
+
+  virtual ~ProxyTask() override;
+
+  virtual bool Action() override;
+
+  /**
+   * @brief Queue a ProxyTask for every video stream in `footage` that doesn't already have one queued
+   *
+   * Must be called from the main thread.
+   */
+  static void CreateProxies(Footage* footage, int divider);
+
+private:
+  /**
+   * @brief Returns the filename in the media index folder that this proxy is stored at
+   */
+  QString GetProxyFilename();
+
+  /**
+   * @brief Decode the whole original stream and encode it into `filename`
+   */
+  bool Transcode(const QString& filename);
+
+  /**
+   * @brief Set up the encoder and muxer to write the proxy to `filename`
+   *
+   * CloseEncoder() must be called afterwards, whether this succeeded or not.
+   */
+  bool OpenEncoder(const QString& filename, const rational& frame_rate);
+
+  void CloseEncoder();
+
+  /**
+   * @brief Convert a decoded frame to the proxy's size and pixel format and encode it
+   */
+  bool EncodeFrame(FramePtr frame, int64_t pts);
+
+  /**
+   * @brief Encode a frame (or flush the encoder if `frame` is nullptr) and write any packets it produces
+   */
+  bool WriteFrame(AVFrame* frame);
+
+  /**
+   * @brief Probe the finished proxy and attach it to the original Footage
+   */
+  bool AttachProxy(const QString& filename);
+
+  /**
+   * @brief Signal an FFmpeg error to the user through set_error()
+   */
+  void FFmpegError(const QString& message, int error_code);
+
+  /**
+   * @brief Returns a key identifying this stream and divider in queued_proxies_
+   */
+  static QString GetQueueKey(Stream* stream, int divider);
+
+  VideoStreamPtr stream_;
+
+  int divider_;
+
+  QString queue_key_;
+
+  AVFormatContext* fmt_ctx_;
+
+  AVCodecContext* codec_ctx_;
+
+  AVStream* avstream_;
+
+  AVPacket* pkt_;
+
+  AVFrame* frame_;
+
+  SwsContext* scale_ctx_;
+
+  /**
+   * @brief Streams that currently have a ProxyTask, see GetQueueKey() (main thread only)
+   */
+  static QSet<QString> queued_proxies_;
+
+};
+
+#endif // PROXYTASK_H
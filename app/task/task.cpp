@@ -20,13 +20,27 @@
 
 #include "task.h"
 
+#include "task/taskmanager.h"
+
 Task::Task() :
   status_(kWaiting),
-  thread_(this),
+  resource_(kCPUBound),
+  priority_(kVisible),
+  preemptible_(false),
+  runnable_(nullptr),
   text_(tr("Task")),
+  progress_(0),
   cancelled_(false)
 {
-  connect(&thread_, SIGNAL(finished()), this, SLOT(ThreadComplete()));
+}
+
+Task::~Task()
+{
+  if (runnable_ != nullptr) {
+    cancelled_ = true;
+    runnable_->wait();
+    delete runnable_;
+  }
 }
 
 bool Task::Start()
@@ -39,7 +53,7 @@ bool Task::Start()
   // Check if this task has any dependencies (tasks that should complete before this one starts)
 
   for (int i=0;i<dependencies_.size();i++) {
-    Task* dependency = dependencies_.at(i);
+    const TaskPtr& dependency = dependencies_.at(i);
 
     if (dependency->status() == kWaiting || dependency->status() == kWorking) {
 
@@ -64,9 +78,16 @@ bool Task::Start()
     return false;
   }
 
+  // Preempted Tasks start Action() over
+  set_progress(0);
+
+  working_timer_.start();
+
   set_status(kWorking);
 
-  thread_.start();
+  runnable_ = new TaskRunnable(this);
+  connect(runnable_, SIGNAL(Finished()), this, SLOT(ThreadComplete()), Qt::QueuedConnection);
+  olive::task_manager.GetThreadPool(resource_)->start(runnable_);
 
   return true;
 }
@@ -91,6 +112,32 @@ const Task::Status &Task::status()
   return status_;
 }
 
+const Task::Resource &Task::resource()
+{
+  return resource_;
+}
+
+const Task::Priority &Task::priority()
+{
+  return priority_;
+}
+
+void Task::set_priority(const Task::Priority &p)
+{
+  if (priority_ == p) {
+    return;
+  }
+
+  priority_ = p;
+
+  emit PriorityChanged();
+}
+
+bool Task::preemptible()
+{
+  return preemptible_;
+}
+
 const QString &Task::text()
 {
   return text_;
@@ -101,7 +148,7 @@ const QString &Task::error()
   return error_;
 }
 
-void Task::AddDependency(Task *dependency)
+void Task::AddDependency(TaskPtr dependency)
 {
   // Dependencies cannot be added if the Task is working or complete
   Q_ASSERT(status_ == kWaiting);
@@ -109,6 +156,11 @@ void Task::AddDependency(Task *dependency)
   dependencies_.append(dependency);
 }
 
+const QList<TaskPtr> &Task::dependencies()
+{
+  return dependencies_;
+}
+
 void Task::ResetState()
 {
   if (status_ == kWaiting) {
@@ -122,6 +174,7 @@ void Task::ResetState()
   cancelled_ = false;
 
   set_error(QString());
+  set_progress(0);
 
   set_status(kWaiting);
 }
@@ -139,7 +192,7 @@ void Task::Cancel()
   cancelled_ = true;
 
   // FIXME: Should we limit the wait time?
-  thread_.wait();
+  runnable_->wait();
 }
 
 void Task::set_error(const QString &s)
@@ -147,11 +200,47 @@ void Task::set_error(const QString &s)
   error_ = s;
 }
 
+int Task::progress() const
+{
+  return progress_.loadAcquire();
+}
+
+qint64 Task::remaining_time()
+{
+  int p = progress();
+
+  if (status_ != kWorking || p <= 0 || p >= 100) {
+    return -1;
+  }
+
+  return working_timer_.elapsed() * (100 - p) / p;
+}
+
+QString Task::detail()
+{
+  return QString();
+}
+
+void Task::set_progress(int p)
+{
+  progress_.storeRelease(p);
+}
+
 void Task::set_text(const QString &s)
 {
   text_ = s;
 }
 
+void Task::set_resource(const Task::Resource &r)
+{
+  resource_ = r;
+}
+
+void Task::set_preemptible(bool e)
+{
+  preemptible_ = e;
+}
+
 bool Task::cancelled()
 {
   return cancelled_;
@@ -170,8 +259,21 @@ void Task::set_status(const Task::Status &status)
 
 void Task::ThreadComplete()
 {
-  // thread_.result() will be set to the return value of Action()
-  bool succeeded = thread_.result();
+  TaskRunnable* runnable = static_cast<TaskRunnable*>(sender());
+
+  // runnable->result() will be set to the return value of Action()
+  bool succeeded = runnable->result();
+
+  // The runnable has already emitted Finished(), so this returns almost immediately
+  runnable->wait();
+  delete runnable;
+
+  if (runnable != runnable_) {
+    // This is a run that was cancelled and reset before it got here, the Task has moved on since
+    return;
+  }
+
+  runnable_ = nullptr;
 
   // Run the Prologue() function for any final tasks
   // User cancelling is not considered an error, so we need to check it too
@@ -22,15 +22,20 @@
 #define TASK_H
 
 #include <memory>
+#include <QAtomicInt>
+#include <QElapsedTimer>
 #include <QObject>
 
-#include "task/taskthread.h"
+#include "task/taskrunnable.h"
+
+class Task;
+using TaskPtr = std::shared_ptr<Task>;
 
 /**
  * @brief A base class for background tasks running in Olive.
  *
- * Tasks are multithreaded by design (i.e. they will always spawn
- * a new thread and run in it).
+ * Tasks are multithreaded by design (i.e. Action() always runs on a thread from one of TaskManager's shared thread
+ * pools, chosen by the Task's resource()).
  *
  * To subclass your own Task, override Action() and return TRUE on success or FALSE on failure. Note that a Task can
  * provide a "negative" output and still have succeeded. For example, the ProbeTask's role is to determine whether a
@@ -42,6 +47,10 @@
  * many Tasks as there are threads on the system as to not overload them.
  *
  * Tasks support "dependency tasks", i.e. a Task that should be complete before another Task begins.
+ *
+ * Tasks also have a priority class which decides the order TaskManager starts them in. Tasks that only prepare work
+ * ahead of time can allow themselves to be preempted, in which case TaskManager cancels them (through the same
+ * cancelled() checks as a user cancel) to make room for a more urgent Task and restarts them later.
  */
 class Task : public QObject
 {
@@ -67,16 +76,54 @@ public:
     kError
   };
 
+  /**
+   * @brief The system resource a Task spends most of its time on
+   *
+   * TaskManager limits how many Tasks of each kind run at once, since Tasks waiting on the disk don't compete with
+   * Tasks that are busy on the CPU.
+   */
+  enum Resource {
+    /// This Task is limited by processing power (the default)
+    kCPUBound,
+
+    /// This Task is limited by reading or writing files
+    kIOBound
+  };
+
+  /**
+   * @brief How urgently the user needs the result of a Task
+   *
+   * TaskManager always starts the most urgent waiting Tasks first. Tasks in the same class start in the order they
+   * were added.
+   */
+  enum Priority {
+    /// The user is actively waiting for this Task (e.g. an import they just started)
+    kInteractive,
+
+    /// This Task produces something currently on screen (the default)
+    kVisible,
+
+    /// This Task only prepares something ahead of time
+    kBackground
+  };
+
   /**
    * @brief Task Constructor
    */
   Task();
 
+  /**
+   * @brief Task Destructor
+   *
+   * Cancels the Task if it's still running.
+   */
+  virtual ~Task() override;
+
   /**
    * @brief Try to start this Task
    *
-   * The main function for starting this Task. If this task is currently waiting, this function will start a new thread
-   * and set the status to kWorking.
+   * The main function for starting this Task. If this task is currently waiting, this function will queue Action() on
+   * TaskManager's thread pool for this Task's resource() and set the status to kWorking.
    *
    * This function also checks its dependency Tasks and will only start if all of them are complete. If they are still
    * working, this function will return FALSE and the status will continue to be kWaiting. If any of them failed, this
@@ -110,8 +157,8 @@ public:
    * Action() is the function that gets called once the separate thread has been created. This function should be
    * overridden in subclasses.
    *
-   * It's also recommended to emit ProgressChanged() throughout your Action() so that any attached ProgressBars can
-   * show accurate progress information.
+   * It's also recommended to call set_progress() throughout your Action() so that any attached views can show
+   * accurate progress information.
    *
    * @return
    *
@@ -148,6 +195,57 @@ public:
    */
   const Status& status();
 
+  /**
+   * @brief Which resource limit this Task counts towards in TaskManager
+   */
+  const Resource& resource();
+
+  /**
+   * @brief This Task's own priority class
+   *
+   * TaskManager may still treat this Task as more urgent if a more urgent Task depends on it.
+   */
+  const Priority& priority();
+
+  /**
+   * @brief Change this Task's priority class
+   *
+   * Can be called at any time from the main thread, e.g. to bring forward a background Task that the user has started
+   * waiting on. Emits PriorityChanged() so TaskManager can reschedule.
+   */
+  void set_priority(const Priority& p);
+
+  /**
+   * @brief Whether TaskManager may cancel this Task while it's working to make room for a more urgent one
+   *
+   * A preempted Task goes back to kWaiting and runs Action() again from the start once there's room, so only Tasks
+   * that are safe to restart should allow this.
+   */
+  bool preemptible();
+
+  /**
+   * @brief How far through Action() this Task is, as a percentage between 0 and 100
+   *
+   * Thread-safe. There's no signal for progress, since a Task may make progress thousands of times a second. Views
+   * read this on a timer instead (see TaskView).
+   */
+  int progress() const;
+
+  /**
+   * @brief Estimated milliseconds until Action() finishes, from how long it's taken to make the progress so far
+   *
+   * Main thread only. Returns -1 if there's nothing to estimate from yet (e.g. the Task isn't working or hasn't made
+   * any progress).
+   */
+  qint64 remaining_time();
+
+  /**
+   * @brief Anything else worth showing about how a working Task is getting on, e.g. how fast it's rendering
+   *
+   * Read from the main thread by views on the same timer as progress(). Empty by default.
+   */
+  virtual QString detail();
+
   /**
    * @brief Retrieve the current title of this Task
    */
@@ -170,9 +268,20 @@ public:
    * Naturally Tasks should never be dependent on each other. Circular dependencies will result in Tasks that never
    * begin.
    *
+   * While this Task is waiting, TaskManager treats its dependencies as being at least as urgent as this Task so that a
+   * background dependency doesn't hold up a Task the user is waiting on.
+   *
    * @param dependency
+   *
+   * The Task to depend on. This Task keeps a reference to it so its status is still available after TaskManager has
+   * removed it.
    */
-  void AddDependency(Task* dependency);
+  void AddDependency(TaskPtr dependency);
+
+  /**
+   * @brief Returns the list of dependency Tasks added with AddDependency()
+   */
+  const QList<TaskPtr>& dependencies();
 
   /**
    * @brief Reset this Task back to the waiting state
@@ -187,9 +296,10 @@ public slots:
    * cancelling so that the main thread doesn't halt for too long.
    *
    * Cancel()'s function is fairly simple, it sets cancelled_ to TRUE and waits for the thread to return. It's the
-   * responsibility of the code in Action() to be able to respond quickly to cancelled_ changing.
+   * responsibility of the code in Action() to be able to respond quickly to cancelled_ changing. Subclasses that
+   * need to signal something other than cancelled() can override this, as long as they call the base implementation.
    */
-  void Cancel();
+  virtual void Cancel();
 
 protected:
   /**
@@ -200,6 +310,13 @@ protected:
    */
   void set_error(const QString& s);
 
+  /**
+   * @brief Set how far through Action() this Task is, as a percentage between 0 and 100 (see progress())
+   *
+   * Cheap enough to call as often as there's progress to report, e.g. for every frame.
+   */
+  void set_progress(int p);
+
   /**
    * @brief Set the Task title
    *
@@ -209,6 +326,20 @@ protected:
    */
   void set_text(const QString& s);
 
+  /**
+   * @brief Set which resource limit this Task counts towards
+   *
+   * Should be set in the constructor, before the Task is added to TaskManager.
+   */
+  void set_resource(const Resource& r);
+
+  /**
+   * @brief Set whether this Task can be preempted (see preemptible())
+   *
+   * Should be set in the constructor. Tasks are not preemptible by default.
+   */
+  void set_preemptible(bool e);
+
   /**
    * @brief Returns whether the thread has been explicitly cancelled or not
    */
@@ -220,17 +351,6 @@ signals:
    */
   void StatusChanged(Task::Status s);
 
-  /**
-   * @brief Signal emitted whenever progress is made
-   *
-   * Emit this throughout Action() to update any attached ProgressBars on the progress of this Task.
-   *
-   * @param p
-   *
-   * A value (percentage) between 0 and 100.
-   */
-  void ProgressChanged(int p);
-
   /**
    * @brief Signal emitted when the Task finishes whether it succeeded or failed
    */
@@ -241,6 +361,11 @@ signals:
    */
   void Removed();
 
+  /**
+   * @brief Signal emitted when set_priority() changes this Task's priority class
+   */
+  void PriorityChanged();
+
 private:
   /**
    * @brief Set the status of this Task (also emits StatusChanged())
@@ -249,23 +374,37 @@ private:
 
   Status status_;
 
-  TaskThread thread_;
+  Resource resource_;
+
+  Priority priority_;
+
+  bool preemptible_;
+
+  /**
+   * @brief Runnable running Action(), only exists while the Task is working
+   */
+  TaskRunnable* runnable_;
 
   QString text_;
 
   QString error_;
 
-  QList<Task*> dependencies_;
+  QAtomicInt progress_;
+
+  /**
+   * @brief Started whenever the Task starts working (see remaining_time())
+   */
+  QElapsedTimer working_timer_;
+
+  QList<TaskPtr> dependencies_;
 
   bool cancelled_;
 
 private slots:
   /**
-   * @brief A slot when the inner thread completes either successfully or unsuccessfully
+   * @brief A slot when the runnable completes either successfully or unsuccessfully
    */
   void ThreadComplete();
 };
 
-using TaskPtr = std::shared_ptr<Task>;
-
 #endif // TASK_H
@@ -21,13 +21,18 @@
 #include "taskmanager.h"
 
 #include <QDebug>
-#include <QThread>
+
+#include "render/renderbudget.h"
 
 TaskManager olive::task_manager;
 
 TaskManager::TaskManager()
 {
-  maximum_task_count_ = QThread::idealThreadCount();
+  maximum_cpu_task_count_ = RenderBudget::ThreadCount();
+  maximum_io_task_count_ = kDefaultIOTaskCount;
+
+  cpu_pool_.setMaxThreadCount(maximum_cpu_task_count_);
+  io_pool_.setMaxThreadCount(maximum_io_task_count_);
 }
 
 TaskManager::~TaskManager()
@@ -39,13 +44,11 @@ void TaskManager::AddTask(TaskPtr t)
 {  
   // Connect Task's status signal to the Callback
   connect(t.get(), SIGNAL(StatusChanged(Task::Status)), this, SLOT(TaskCallback(Task::Status)));
+  connect(t.get(), SIGNAL(PriorityChanged()), this, SLOT(TaskPriorityCallback()));
 
   // Add the Task to the queue
   tasks_.append(t);
 
-  // Emit signal that a Task was added
-  emit TaskAdded(t.get());
-
   // Scan through queue and start any Tasks that can (including this one)
   StartNextWaiting();
 }
@@ -57,38 +60,171 @@ void TaskManager::Clear()
     tasks_.at(i)->Cancel();
   }
   tasks_.clear();
+  announced_tasks_.clear();
+}
+
+int TaskManager::GetMaximumTaskCount(Task::Resource resource) const
+{
+  return (resource == Task::kIOBound) ? maximum_io_task_count_ : maximum_cpu_task_count_;
+}
+
+int TaskManager::TaskCount(Task::Status status) const
+{
+  int count = 0;
+
+  foreach (TaskPtr t, tasks_) {
+    if (t->status() == status) {
+      count++;
+    }
+  }
+
+  return count;
+}
+
+void TaskManager::SetMaximumTaskCount(Task::Resource resource, int count)
+{
+  count = qMax(1, count);
+
+  if (resource == Task::kIOBound) {
+    maximum_io_task_count_ = count;
+  } else {
+    maximum_cpu_task_count_ = count;
+  }
+
+  GetThreadPool(resource)->setMaxThreadCount(count);
+
+  StartNextWaiting();
+}
+
+QThreadPool *TaskManager::GetThreadPool(Task::Resource resource)
+{
+  return (resource == Task::kIOBound) ? &io_pool_ : &cpu_pool_;
 }
 
 void TaskManager::StartNextWaiting()
 {
-  // Count the tasks that are currently active
-  int working_count = 0;
+  // Work out how urgent each unfinished Task really is, since a Task is as urgent as anything waiting on it
+  QHash<Task*, int> priorities;
+
+  for (int i=0;i<tasks_.size();i++) {
+    Task* t = tasks_.at(i).get();
+
+    if (t->status() == Task::kWaiting || t->status() == Task::kWorking) {
+      RaisePriority(t, t->priority(), priorities);
+    }
+  }
+
+  // Count the tasks of each resource type that are currently active
+  int working_cpu_count = 0;
+  int working_io_count = 0;
 
   for (int i=0;i<tasks_.size();i++) {
     TaskPtr t = tasks_.at(i);
 
     if (t->status() == Task::kWorking) {
+      if (t->resource() == Task::kIOBound) {
+        working_io_count++;
+      } else {
+        working_cpu_count++;
+      }
+    }
+  }
 
-      // Task is active, add it to the count
-      working_count++;
+  // Start waiting Tasks from most to least urgent, within a priority class they start in the order they were added
+  for (int priority=Task::kInteractive;priority<=Task::kBackground;priority++) {
+    for (int i=0;i<tasks_.size();i++) {
+      TaskPtr t = tasks_.at(i);
+
+      if (t->status() != Task::kWaiting || priorities.value(t.get()) != priority) {
+        continue;
+      }
 
-    } else if (t->status() == Task::kWaiting) {
+      int& working_count = (t->resource() == Task::kIOBound) ? working_io_count : working_cpu_count;
+
+      if (working_count >= GetMaximumTaskCount(t->resource())) {
+        // Only preempt for a Task that's definitely able to start, otherwise we'd lose the other Task's progress for
+        // nothing
+        if (!DependenciesFinished(t.get()) || !PreemptTask(t->resource(), priority, priorities)) {
+          continue;
+        }
+
+        working_count--;
+      }
 
       // Task is waiting and we have available threads, try to start it
       if (t->Start()) {
         // If it started, add it to the working count
         working_count++;
+      } else if (t->status() != Task::kError) {
+        continue;
       }
 
+      // Show the Task when it starts, or when it fails to start so the user sees why
+      if (!announced_tasks_.contains(t.get())) {
+        announced_tasks_.insert(t.get());
+        emit TaskAdded(t.get());
+      }
     }
+  }
+}
 
-    // Check if the count exceeds our maximum threads, if so stop here
-    if (working_count == maximum_task_count_) {
-      break;
+bool TaskManager::PreemptTask(Task::Resource resource, int priority, const QHash<Task*, int> &priorities)
+{
+  Task* preempt = nullptr;
+  int preempt_priority = priority;
+
+  for (int i=0;i<tasks_.size();i++) {
+    Task* t = tasks_.at(i).get();
+
+    if (t->status() == Task::kWorking
+        && t->resource() == resource
+        && t->preemptible()
+        && priorities.value(t) >= preempt_priority
+        && priorities.value(t) > priority) {
+      preempt = t;
+      preempt_priority = priorities.value(t);
+    }
+  }
+
+  if (preempt == nullptr) {
+    return false;
+  }
+
+  // Cancels the Task and waits for it to notice, then puts it back in the queue
+  preempt->ResetState();
+
+  return true;
+}
+
+void TaskManager::RaisePriority(Task *t, int priority, QHash<Task *, int> &priorities)
+{
+  QHash<Task*, int>::const_iterator existing = priorities.constFind(t);
+
+  // Stop if this Task is already at least this urgent, this also stops circular dependencies from recursing forever
+  if (existing != priorities.constEnd() && existing.value() <= priority) {
+    return;
+  }
+
+  priorities.insert(t, priority);
+
+  foreach (const TaskPtr& dependency, t->dependencies()) {
+    if (dependency->status() == Task::kWaiting || dependency->status() == Task::kWorking) {
+      RaisePriority(dependency.get(), priority, priorities);
     }
   }
 }
 
+bool TaskManager::DependenciesFinished(Task *t)
+{
+  foreach (const TaskPtr& dependency, t->dependencies()) {
+    if (dependency->status() != Task::kFinished) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
 void TaskManager::DeleteTask(Task *t)
 {
   // Cancel the task
@@ -98,6 +234,7 @@ void TaskManager::DeleteTask(Task *t)
   for (int i=0;i<tasks_.size();i++) {
     if (tasks_.at(i).get() == t) {
       emit t->Removed();
+      announced_tasks_.remove(t);
       tasks_.removeAt(i);
       break;
     }
@@ -117,6 +254,12 @@ void TaskManager::TaskCallback(Task::Status status)
   }
 }
 
+void TaskManager::TaskPriorityCallback()
+{
+  // The Task may now be able to jump the queue (or make way for others)
+  StartNextWaiting();
+}
+
 TaskManager::AddTaskCommand::AddTaskCommand(TaskPtr t, QUndoCommand *parent) :
   QUndoCommand(parent),
   task_(t)
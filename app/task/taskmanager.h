@@ -21,6 +21,9 @@
 #ifndef TASKMANAGER_H
 #define TASKMANAGER_H
 
+#include <QHash>
+#include <QSet>
+#include <QThreadPool>
 #include <QVector>
 #include <QUndoCommand>
 
@@ -31,8 +34,13 @@
  *
  * TaskManager handles the life of a Task object. After a new Task is created, it should be sent to TaskManager through
  * AddTask(). TaskManager will take ownership of the task and add it to a queue until it system resources are available
- * for it to run. Currently, TaskManager will run no more Tasks than there are threads on the system (one task per
- * thread). As Tasks finished, TaskManager will start the next in the queue.
+ * for it to run. CPU-bound Tasks are limited to as many as there are threads on the system (one task per thread) and
+ * I/O-bound Tasks to a small fixed number, separately so that Tasks waiting on the disk don't hold up Tasks that could
+ * be using the CPU (and vice versa). As Tasks finished, TaskManager will start the next in the queue.
+ *
+ * The queue is ordered by Task::Priority so what the user is waiting on starts first, and a Task inherits the priority
+ * of any more urgent Task waiting on it. If a more urgent Task can't start because its limit has been reached,
+ * TaskManager preempts a less urgent preemptible Task to make room for it.
  */
 class TaskManager : public QObject
 {
@@ -92,6 +100,32 @@ public:
    */
   void Clear();
 
+  /**
+   * @brief Returns how many Tasks of a certain resource type can run at once
+   */
+  int GetMaximumTaskCount(Task::Resource resource) const;
+
+  /**
+   * @brief Returns how many of the Tasks in the queue have a certain status
+   */
+  int TaskCount(Task::Status status) const;
+
+  /**
+   * @brief Set how many Tasks of a certain resource type can run at once
+   *
+   * Also resizes that resource's thread pool to match. Tasks already running are allowed to finish if the limit is
+   * lowered, and waiting Tasks start immediately if it's raised.
+   */
+  void SetMaximumTaskCount(Task::Resource resource, int count);
+
+  /**
+   * @brief Returns the shared thread pool that Tasks of a certain resource type run their Action() on
+   *
+   * Each resource type gets its own pool, separate from QThreadPool::globalInstance(), so Tasks never compete for
+   * threads with the short-lived work the renderer and decoders put on the global pool (and vice versa).
+   */
+  QThreadPool* GetThreadPool(Task::Resource resource);
+
   /**
    * @brief Undoable command for adding a Task to the TaskManager
    */
@@ -120,7 +154,10 @@ public:
 
 signals:
   /**
-   * @brief Signal emitted when a Task is added by AddTask()
+   * @brief Signal emitted when a Task added by AddTask() leaves the queue
+   *
+   * This is when the Task starts, or fails to (e.g. because a dependency failed). Tasks still waiting in the queue
+   * aren't announced so that queueing thousands of them doesn't create thousands of UI rows up front.
    *
    * @param t
    *
@@ -135,8 +172,8 @@ private:
    * This function is run whenever a Task is added and whenever a Task finishes. It determines how many Tasks are
    * currently running and therefore how many Tasks can be started (if any). It will then start ones that can.
    *
-   * This function is aware of "dependency Tasks" and if a Task is waiting but has a dependency that hasn't finished,
-   * it will skip to the next one.
+   * Waiting Tasks are started from most to least urgent. This function is aware of "dependency Tasks" and if a Task
+   * is waiting but has a dependency that hasn't finished, it will skip to the next one.
    *
    * Like AddTask, this function is NOT thread-safe and currently only intended to be run from the main thread.
    */
@@ -153,17 +190,70 @@ private:
    */
   void DeleteTask(Task* t);
 
+  /**
+   * @brief Cancel a working Task that's less urgent than `priority` to free up a slot for `resource`
+   *
+   * Picks the least urgent preemptible Task using this resource, preferring the most recently added, and resets it
+   * back to the waiting state so it runs again later.
+   *
+   * @return
+   *
+   * TRUE if a Task was preempted, FALSE if every working Task is at least as urgent or can't be preempted.
+   */
+  bool PreemptTask(Task::Resource resource, int priority, const QHash<Task*, int>& priorities);
+
+  /**
+   * @brief Record `priority` as the urgency of `t` and its unfinished dependencies unless they're already more urgent
+   */
+  static void RaisePriority(Task* t, int priority, QHash<Task*, int>& priorities);
+
+  /**
+   * @brief Returns TRUE if all of a Task's dependencies have finished successfully
+   */
+  static bool DependenciesFinished(Task* t);
+
   /**
    * @brief Internal task array
    */
   QVector<TaskPtr> tasks_;
 
   /**
-   * @brief Constant set at run-time of how many Tasks can run concurrently
+   * @brief Tasks that TaskAdded() has already been emitted for
+   *
+   * A preempted Task starts again later, but should only show up in the UI once.
+   */
+  QSet<Task*> announced_tasks_;
+
+  /**
+   * @brief How many CPU-bound Tasks can run concurrently
+   *
+   * Defaults to RenderBudget::ThreadCount()
+   */
+  int maximum_cpu_task_count_;
+
+  /**
+   * @brief How many I/O-bound Tasks can run concurrently
+   *
+   * Defaults to kDefaultIOTaskCount
+   */
+  int maximum_io_task_count_;
+
+  /**
+   * @brief Default number of I/O-bound Tasks that can run concurrently
    *
-   * Currently set in the Constructor to QThread::idealThreadCount()
+   * Enough to hide the latency of each file, but few enough that a single disk isn't thrashed by seeking between them.
+   */
+  static const int kDefaultIOTaskCount = 4;
+
+  /**
+   * @brief Threads that CPU-bound Tasks run on
    */
-  int maximum_task_count_;
+  QThreadPool cpu_pool_;
+
+  /**
+   * @brief Threads that I/O-bound Tasks run on
+   */
+  QThreadPool io_pool_;
 
 private slots:
   /**
@@ -178,6 +268,11 @@ private slots:
    */
   void TaskCallback(Task::Status status);
 
+  /**
+   * @brief Callback when a Task's priority changes so it can be rescheduled
+   */
+  void TaskPriorityCallback();
+
 };
 
 namespace olive {
@@ -0,0 +1,80 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#include "taskrunnable.h"
+
+#include <QThread>
+
+#include "render/renderbudget.h"
+#include "task/task.h"
+
+TaskRunnable::TaskRunnable(Task *parent) :
+  parent_(parent),
+  result_(false),
+  done_(false)
+{
+  setAutoDelete(false);
+}
+
+void TaskRunnable::run()
+{
+  // Tasks may change their thread's priority, but this thread will go on to run other Tasks
+  QThread::Priority priority = QThread::currentThread()->priority();
+
+  // CPU-bound Tasks share the CPU with rendering, so they take their turn with the render workers
+  bool cpu_bound = (parent_->resource() == Task::kCPUBound);
+
+  if (cpu_bound) {
+    RenderBudget::Acquire(RenderBudget::kCPU);
+  }
+
+  result_ = parent_->Action();
+
+  if (cpu_bound) {
+    RenderBudget::Release(RenderBudget::kCPU);
+  }
+
+  QThread::currentThread()->setPriority((priority == QThread::InheritPriority) ? QThread::NormalPriority : priority);
+
+  emit Finished();
+
+  // Signal the owner last, it may delete us as soon as wait() returns
+  done_lock_.lock();
+  done_ = true;
+  done_cond_.wakeAll();
+  done_lock_.unlock();
+}
+
+bool TaskRunnable::result()
+{
+  return result_;
+}
+
+void TaskRunnable::wait()
+{
+  done_lock_.lock();
+
+  while (!done_) {
+    done_cond_.wait(&done_lock_);
+  }
+
+  done_lock_.unlock();
+}
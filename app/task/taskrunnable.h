@@ -0,0 +1,74 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+
+#ifndef TASKRUNNABLE_H
+#define TASKRUNNABLE_H
+
+#include <QMutex>
+#include <QObject>
+#include <QRunnable>
+#include <QWaitCondition>
+
+class Task;
+
+/**
+ * @brief An internal class only used by Task.
+ *
+ * TaskRunnable runs the Task's Action() function on one of TaskManager's shared thread pools, so Tasks reuse
+ * threads rather than each creating and destroying their own. It also stores the result of Action() which can be read
+ * using result() when it signals that it has Finished().
+ *
+ * TaskRunnable is not auto-deleted by the pool. Its owner should wait() for it and then delete it.
+ */
+class TaskRunnable : public QObject, public QRunnable
+{
+  Q_OBJECT
+public:
+  TaskRunnable(Task* parent);
+
+  virtual void run() override;
+
+  bool result();
+
+  /**
+   * @brief Block until run() has returned (or return immediately if it has)
+   */
+  void wait();
+
+signals:
+  /**
+   * @brief Emitted from the pool thread once Action() has returned
+   */
+  void Finished();
+
+private:
+  Task* parent_;
+
+  bool result_;
+
+  QMutex done_lock_;
+
+  QWaitCondition done_cond_;
+
+  bool done_;
+};
+
+#endif // TASKRUNNABLE_H
@@ -20,8 +20,61 @@
 
 #include "undostack.h"
 
+#include "common/memorybudget.h"
+
 OliveUndoStack olive::undo_stack;
 
+const qint64 OliveUndoStack::kCommandOverhead = 256;
+
+OliveUndoStack::OliveUndoStack() :
+  index_(0),
+  memory_usage_(0),
+  memory_limit_(0),
+  reported_memory_(0)
+{
+}
+
+OliveUndoStack::~OliveUndoStack()
+{
+  qDeleteAll(commands_);
+}
+
+void OliveUndoStack::push(QUndoCommand *command)
+{
+  command->redo();
+
+  // Anything that was undone can't be redone anymore
+  while (commands_.size() > index_) {
+    DeleteCommand(commands_.size() - 1);
+  }
+
+  QUndoCommand* last = (index_ > 0) ? commands_.at(index_ - 1) : nullptr;
+
+  if (last != nullptr
+      && command->id() != -1
+      && command->id() == last->id()
+      && last->mergeWith(command)) {
+    // Continuous edits (e.g. dragging a slider) become one command rather than one per change
+    delete command;
+
+    qint64 last_memory = EstimateMemoryUsage(last);
+    memory_usage_ += last_memory - command_memory_.at(index_ - 1);
+    command_memory_.replace(index_ - 1, last_memory);
+  } else {
+    qint64 command_memory = EstimateMemoryUsage(command);
+
+    commands_.append(command);
+    command_memory_.append(command_memory);
+    memory_usage_ += command_memory;
+
+    index_++;
+  }
+
+  EnforceMemoryLimit();
+
+  SignalStateChanged();
+}
+
 void OliveUndoStack::pushIfHasChildren(QUndoCommand *command)
 {
   if (command->childCount() > 0) {
@@ -30,3 +83,170 @@ void OliveUndoStack::pushIfHasChildren(QUndoCommand *command)
     delete command;
   }
 }
+
+bool OliveUndoStack::canUndo() const
+{
+  return index_ > 0;
+}
+
+bool OliveUndoStack::canRedo() const
+{
+  return index_ < commands_.size();
+}
+
+QString OliveUndoStack::undoText() const
+{
+  return canUndo() ? commands_.at(index_ - 1)->text() : QString();
+}
+
+QString OliveUndoStack::redoText() const
+{
+  return canRedo() ? commands_.at(index_)->text() : QString();
+}
+
+QAction *OliveUndoStack::createUndoAction(QObject *parent)
+{
+  QAction* action = new QAction(UndoActionText(), parent);
+  action->setEnabled(canUndo());
+
+  connect(this, SIGNAL(canUndoChanged(bool)), action, SLOT(setEnabled(bool)));
+  connect(this, SIGNAL(UndoActionTextChanged(const QString&)), action, SLOT(setText(const QString&)));
+  connect(action, SIGNAL(triggered()), this, SLOT(undo()));
+
+  return action;
+}
+
+QAction *OliveUndoStack::createRedoAction(QObject *parent)
+{
+  QAction* action = new QAction(RedoActionText(), parent);
+  action->setEnabled(canRedo());
+
+  connect(this, SIGNAL(canRedoChanged(bool)), action, SLOT(setEnabled(bool)));
+  connect(this, SIGNAL(RedoActionTextChanged(const QString&)), action, SLOT(setText(const QString&)));
+  connect(action, SIGNAL(triggered()), this, SLOT(redo()));
+
+  return action;
+}
+
+void OliveUndoStack::clear()
+{
+  qDeleteAll(commands_);
+  commands_.clear();
+  command_memory_.clear();
+
+  index_ = 0;
+  memory_usage_ = 0;
+
+  SignalStateChanged();
+}
+
+void OliveUndoStack::SetMemoryLimit(qint64 bytes)
+{
+  memory_limit_ = bytes;
+
+  EnforceMemoryLimit();
+
+  SignalStateChanged();
+}
+
+qint64 OliveUndoStack::memory_usage() const
+{
+  return memory_usage_;
+}
+
+qint64 OliveUndoStack::EstimateMemoryUsage(const QUndoCommand *command)
+{
+  qint64 usage = kCommandOverhead + command->text().size() * static_cast<qint64>(sizeof(QChar));
+
+  const UndoCommandMemory* command_memory = dynamic_cast<const UndoCommandMemory*>(command);
+
+  if (command_memory != nullptr) {
+    usage += command_memory->memory_usage();
+  }
+
+  for (int i=0;i<command->childCount();i++) {
+    usage += EstimateMemoryUsage(command->child(i));
+  }
+
+  return usage;
+}
+
+void OliveUndoStack::undo()
+{
+  if (!canUndo()) {
+    return;
+  }
+
+  index_--;
+
+  commands_.at(index_)->undo();
+
+  SignalStateChanged();
+}
+
+void OliveUndoStack::redo()
+{
+  if (!canRedo()) {
+    return;
+  }
+
+  commands_.at(index_)->redo();
+
+  index_++;
+
+  SignalStateChanged();
+}
+
+void OliveUndoStack::DeleteCommand(int index)
+{
+  memory_usage_ -= command_memory_.takeAt(index);
+
+  delete commands_.takeAt(index);
+
+  if (index < index_) {
+    index_--;
+  }
+}
+
+void OliveUndoStack::EnforceMemoryLimit()
+{
+  if (memory_limit_ <= 0) {
+    return;
+  }
+
+  // Commands that were undone go first since they're the least likely to be wanted again
+  while (memory_usage_ > memory_limit_ && commands_.size() > index_) {
+    DeleteCommand(commands_.size() - 1);
+  }
+
+  // Then the oldest, always keeping the most recent one
+  while (memory_usage_ > memory_limit_ && commands_.size() > 1) {
+    DeleteCommand(0);
+  }
+}
+
+void OliveUndoStack::SignalStateChanged()
+{
+  // Every change to the history ends up here, so it's reported once per change rather than per command
+  MemoryBudget::Add(MemoryBudget::kUndo, memory_usage_ - reported_memory_);
+  reported_memory_ = memory_usage_;
+
+  emit canUndoChanged(canUndo());
+  emit canRedoChanged(canRedo());
+  emit UndoActionTextChanged(UndoActionText());
+  emit RedoActionTextChanged(RedoActionText());
+}
+
+QString OliveUndoStack::UndoActionText() const
+{
+  QString text = undoText();
+
+  return text.isEmpty() ? tr("Undo") : tr("Undo %1").arg(text);
+}
+
+QString OliveUndoStack::RedoActionText() const
+{
+  QString text = redoText();
+
+  return text.isEmpty() ? tr("Redo") : tr("Redo %1").arg(text);
+}
@@ -21,22 +21,156 @@
 #ifndef UNDOSTACK_H
 #define UNDOSTACK_H
 
-#include <QUndoStack>
+#include <QAction>
+#include <QList>
+#include <QObject>
+#include <QUndoCommand>
 
-class OliveUndoStack : public QUndoStack {
+/**
+ * @brief Implemented by undo commands that keep more memory alive than the command object itself
+ *
+ * For example, a command that removes a node from the graph keeps it around so undoing can put it back. OliveUndoStack
+ * uses this to work out how much memory its history is keeping.
+ */
+class UndoCommandMemory {
 public:
+  virtual ~UndoCommandMemory() = default;
+
+  /**
+   * @brief Approximate number of bytes kept alive by this command (not including its children)
+   */
+  virtual qint64 memory_usage() const = 0;
+};
+
+/**
+ * @brief An undo stack with a memory limit
+ *
+ * Works like QUndoStack (including merging consecutive commands with QUndoCommand::mergeWith()), but rather than
+ * keeping every command forever, the oldest commands are deleted once the history is using more than the memory limit
+ * (see SetMemoryLimit()). The most recent command is always kept so it can be undone.
+ */
+class OliveUndoStack : public QObject {
+  Q_OBJECT
+public:
+  OliveUndoStack();
+
+  virtual ~OliveUndoStack() override;
+
+  /**
+   * @brief Run a command and add it to the history, or merge it into the last command if they can be merged
+   *
+   * This function takes ownership of `command`, and may delete it so it should never be accessed after this call.
+   */
+  void push(QUndoCommand* command);
+
   /**
    * @brief A wrapper for push() that either pushes if the command has children or deletes if not
    *
    * This function takes ownership of `command`, and may delete it so it should never be accessed after this call.
    */
   void pushIfHasChildren(QUndoCommand* command);
+
+  bool canUndo() const;
+
+  bool canRedo() const;
+
+  QString undoText() const;
+
+  QString redoText() const;
+
+  /**
+   * @brief Create an action that undoes and follows this stack's state
+   */
+  QAction* createUndoAction(QObject* parent);
+
+  /**
+   * @brief Create an action that redoes and follows this stack's state
+   */
+  QAction* createRedoAction(QObject* parent);
+
+  /**
+   * @brief Delete every command in the history
+   */
+  void clear();
+
+  /**
+   * @brief Set the most memory in bytes the history should keep alive (0 for unlimited)
+   */
+  void SetMemoryLimit(qint64 bytes);
+
+  /**
+   * @brief Approximate memory the history is keeping alive in bytes
+   */
+  qint64 memory_usage() const;
+
+  /**
+   * @brief Approximate memory `command` and its children keep alive in bytes (see UndoCommandMemory)
+   */
+  static qint64 EstimateMemoryUsage(const QUndoCommand* command);
+
+public slots:
+  void undo();
+
+  void redo();
+
+signals:
+  void canUndoChanged(bool can_undo);
+
+  void canRedoChanged(bool can_redo);
+
+  void UndoActionTextChanged(const QString& text);
+
+  void RedoActionTextChanged(const QString& text);
+
+private:
+  /**
+   * @brief Delete the command at `index` in commands_
+   */
+  void DeleteCommand(int index);
+
+  /**
+   * @brief Delete the oldest commands until we're under memory_limit_
+   */
+  void EnforceMemoryLimit();
+
+  void SignalStateChanged();
+
+  QString UndoActionText() const;
+
+  QString RedoActionText() const;
+
+  /**
+   * @brief Rough size of a command object with no UndoCommandMemory of its own
+   */
+  static const qint64 kCommandOverhead;
+
+  /**
+   * @brief Every command in the history, oldest first
+   */
+  QList<QUndoCommand*> commands_;
+
+  /**
+   * @brief EstimateMemoryUsage() of every command in commands_ (same indices), worked out once when pushed
+   */
+  QList<qint64> command_memory_;
+
+  /**
+   * @brief Number of commands in commands_ that are currently done, the rest have been undone
+   */
+  int index_;
+
+  qint64 memory_usage_;
+
+  qint64 memory_limit_;
+
+  /**
+   * @brief memory_usage_ as last reported to MemoryBudget
+   */
+  qint64 reported_memory_;
+
 };
 
 namespace olive {
-/**
- * @brief A static undo stack for undoable commands throughout Olive
- */
 extern OliveUndoStack undo_stack;
 }
 
@@ -10,20 +10,25 @@
 const int kDecibelStep = 6;
 const int kDecibelMinimum = -200;
 const int kClearTimerInterval = 500;
+const int kRefreshTimerInterval = 33;
 
 AudioMonitor::AudioMonitor(QWidget *parent) :
   QWidget(parent)
 {
   clear_timer_.setInterval(kClearTimerInterval);
 
-  connect(AudioManager::instance(), SIGNAL(SentSamples(QVector<double>)), this, SLOT(SetValues(QVector<double>)));
   connect(&clear_timer_, SIGNAL(timeout()), this, SLOT(Clear()));
   connect(&clear_timer_, SIGNAL(timeout()), &clear_timer_, SLOT(stop()));
+
+  refresh_timer_.setInterval(kRefreshTimerInterval);
+  connect(&refresh_timer_, SIGNAL(timeout()), this, SLOT(RefreshFromTap()));
+  refresh_timer_.start();
 }
 
-void AudioMonitor::SetValues(QVector<double> values)
+void AudioMonitor::SetValues(QVector<double> values, QVector<double> rms)
 {
   values_ = values;
+  rms_ = rms;
 
   if (values_.size() != peaked_.size()) {
     peaked_.resize(values_.size());
@@ -39,9 +44,33 @@ void AudioMonitor::SetValues(QVector<double> values)
 void AudioMonitor::Clear()
 {
   values_.fill(0);
+  rms_.fill(0);
   update();
 }
 
+void AudioMonitor::RefreshFromTap()
+{
+  float peaks[AudioMeterTap::kMaxChannels];
+  float rms[AudioMeterTap::kMaxChannels];
+
+  int channels = AudioManager::instance()->meter_tap()->Take(peaks, rms);
+
+  // Nothing was output since we last looked, leave the clear timer to drop the meters
+  if (channels == 0) {
+    return;
+  }
+
+  QVector<double> peak_values(channels);
+  QVector<double> rms_values(channels);
+
+  for (int i=0;i<channels;i++) {
+    peak_values[i] = static_cast<double>(peaks[i]);
+    rms_values[i] = static_cast<double>(rms[i]);
+  }
+
+  SetValues(peak_values, rms_values);
+}
+
 void AudioMonitor::paintEvent(QPaintEvent *)
 {
   int channels = values_.size();
@@ -132,9 +161,19 @@ void AudioMonitor::paintEvent(QPaintEvent *)
 
     p.setBrush(QColor(0, 0, 0, 128));
 
+    QRect full_channel_rect = meter_rect;
+
     meter_rect.adjust(0, 0, 0, -qRound(meter_rect.height() * vol));
     p.drawRect(meter_rect);
 
+    // Mark the RMS level with a line across the meter
+    double rms = QAudio::convertVolume(rms_.value(i), QAudio::LinearVolumeScale, QAudio::LogarithmicVolumeScale);
+    int rms_y = full_channel_rect.bottom() - qRound(full_channel_rect.height() * rms);
+
+    p.setPen(Qt::white);
+    p.drawLine(full_channel_rect.left(), rms_y, full_channel_rect.right(), rms_y);
+    p.setPen(Qt::NoPen);
+
     if (!peaked_.at(i))
       p.drawRect(peaks_rect);
   }
@@ -11,7 +11,7 @@ public:
   AudioMonitor(QWidget* parent = nullptr);
 
 public slots:
-  void SetValues(QVector<double> values);
+  void SetValues(QVector<double> values, QVector<double> rms);
   void Clear();
 
 protected:
@@ -20,9 +20,18 @@ protected:
 
 private:
   QVector<double> values_;
+  QVector<double> rms_;
   QVector<bool> peaked_;
 
   QTimer clear_timer_;
+
+  /**
+   * @brief Polls AudioManager's meter tap, so nothing on the audio thread has to wait on the GUI
+   */
+  QTimer refresh_timer_;
+
+private slots:
+  void RefreshFromTap();
 };
 
 #endif // AUDIOMONITORWIDGET_H
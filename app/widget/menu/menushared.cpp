@@ -39,20 +39,21 @@ void MenuShared::Initialize()
 
   // "Edit" menu shared items
   edit_cut_item_ = Menu::CreateItem(this, "cut", nullptr, nullptr, "Ctrl+X");
-  edit_copy_item_ = Menu::CreateItem(this, "copy", nullptr, nullptr, "Ctrl+C");
-  edit_paste_item_ = Menu::CreateItem(this, "paste", nullptr, nullptr, "Ctrl+V");
+  edit_copy_item_ = Menu::CreateItem(this, "copy", this, SLOT(Copy()), "Ctrl+C");
+  edit_paste_item_ = Menu::CreateItem(this, "paste", this, SLOT(Paste()), "Ctrl+V");
   edit_paste_insert_item_ = Menu::CreateItem(this, "pasteinsert", nullptr, nullptr, "Ctrl+Shift+V");
-  edit_duplicate_item_ = Menu::CreateItem(this, "duplicate", nullptr, nullptr, "Ctrl+D");
+  edit_duplicate_item_ = Menu::CreateItem(this, "duplicate", this, SLOT(Duplicate()), "Ctrl+D");
   edit_delete_item_ = Menu::CreateItem(this, "delete", nullptr, nullptr, "Del");
   edit_ripple_delete_item_ = Menu::CreateItem(this, "rippledelete", nullptr, nullptr, "Shift+Del");
   edit_split_item_ = Menu::CreateItem(this, "split", this, SLOT(SplitAtPlayhead()), "Ctrl+K");
 
   // "In/Out" menu shared items
-  inout_set_in_item_ = Menu::CreateItem(this, "setinpoint", nullptr, nullptr, "I");
-  inout_set_out_item_ = Menu::CreateItem(this, "setoutpoint", nullptr, nullptr, "O");
-  inout_reset_in_item_ = Menu::CreateItem(this, "resetin", nullptr, nullptr);
-  inout_reset_out_item_ = Menu::CreateItem(this, "resetout", nullptr, nullptr);
-  inout_clear_inout_item_ = Menu::CreateItem(this, "clearinout", nullptr, nullptr, "G");
+  inout_set_in_item_ = Menu::CreateItem(this, "setinpoint", this, SLOT(SetInPoint()), "I");
+  inout_set_out_item_ = Menu::CreateItem(this, "setoutpoint", this, SLOT(SetOutPoint()), "O");
+  inout_reset_in_item_ = Menu::CreateItem(this, "resetin", this, SLOT(ResetInPoint()));
+  inout_reset_out_item_ = Menu::CreateItem(this, "resetout", this, SLOT(ResetOutPoint()));
+  inout_clear_inout_item_ = Menu::CreateItem(this, "clearinout", this, SLOT(ClearInOutPoints()), "G");
+  inout_prerender_item_ = Menu::CreateItem(this, "prerenderinout", this, SLOT(PreRenderInOut()), "Ctrl+Shift+R");
 
   // "Clip Edit" menu shared items
   clip_add_default_transition_item_ = Menu::CreateItem(this, "deftransition", nullptr, nullptr, "Ctrl+Shift+D");
@@ -91,6 +92,10 @@ void MenuShared::AddItemsForInOutMenu(Menu *m)
   m->addAction(inout_reset_in_item_);
   m->addAction(inout_reset_out_item_);
   m->addAction(inout_clear_inout_item_);
+
+  m->addSeparator();
+
+  m->addAction(inout_prerender_item_);
 }
 
 void MenuShared::AddItemsForClipEditMenu(Menu *m)
@@ -110,6 +115,87 @@ void MenuShared::SplitAtPlayhead()
   }
 }
 
+void MenuShared::Copy()
+{
+  TimelinePanel* timeline = olive::panel_manager->MostRecentlyFocused<TimelinePanel>();
+
+  if (timeline != nullptr) {
+    timeline->CopySelected();
+  }
+}
+
+void MenuShared::Paste()
+{
+  TimelinePanel* timeline = olive::panel_manager->MostRecentlyFocused<TimelinePanel>();
+
+  if (timeline != nullptr) {
+    timeline->Paste();
+  }
+}
+
+void MenuShared::Duplicate()
+{
+  TimelinePanel* timeline = olive::panel_manager->MostRecentlyFocused<TimelinePanel>();
+
+  if (timeline != nullptr) {
+    timeline->DuplicateSelected();
+  }
+}
+
+void MenuShared::SetInPoint()
+{
+  TimelinePanel* timeline = olive::panel_manager->MostRecentlyFocused<TimelinePanel>();
+
+  if (timeline != nullptr) {
+    timeline->SetInPoint();
+  }
+}
+
+void MenuShared::SetOutPoint()
+{
+  TimelinePanel* timeline = olive::panel_manager->MostRecentlyFocused<TimelinePanel>();
+
+  if (timeline != nullptr) {
+    timeline->SetOutPoint();
+  }
+}
+
+void MenuShared::ResetInPoint()
+{
+  TimelinePanel* timeline = olive::panel_manager->MostRecentlyFocused<TimelinePanel>();
+
+  if (timeline != nullptr) {
+    timeline->ResetInPoint();
+  }
+}
+
+void MenuShared::ResetOutPoint()
+{
+  TimelinePanel* timeline = olive::panel_manager->MostRecentlyFocused<TimelinePanel>();
+
+  if (timeline != nullptr) {
+    timeline->ResetOutPoint();
+  }
+}
+
+void MenuShared::ClearInOutPoints()
+{
+  TimelinePanel* timeline = olive::panel_manager->MostRecentlyFocused<TimelinePanel>();
+
+  if (timeline != nullptr) {
+    timeline->ClearInOutPoints();
+  }
+}
+
+void MenuShared::PreRenderInOut()
+{
+  TimelinePanel* timeline = olive::panel_manager->MostRecentlyFocused<TimelinePanel>();
+
+  if (timeline != nullptr) {
+    timeline->PreRenderInOut();
+  }
+}
+
 void MenuShared::Retranslate()
 {
   // "New" menu shared items
@@ -133,6 +219,7 @@ void MenuShared::Retranslate()
   inout_reset_in_item_->setText(tr("Reset In Point"));
   inout_reset_out_item_->setText(tr("Reset Out Point"));
   inout_clear_inout_item_->setText(tr("Clear In/Out Point"));
+  inout_prerender_item_->setText(tr("Pre-render In/Out"));
 
   // "Clip Edit" menu shared items
   clip_add_default_transition_item_->setText(tr("Add Default Transition"));
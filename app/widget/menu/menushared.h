@@ -61,6 +61,7 @@ private:
   QAction* inout_reset_in_item_;
   QAction* inout_reset_out_item_;
   QAction* inout_clear_inout_item_;
+  QAction* inout_prerender_item_;
 
   // "Clip Edit" menu shared items
   QAction* clip_add_default_transition_item_;
@@ -71,6 +72,24 @@ private:
 private slots:
   void SplitAtPlayhead();
 
+  void Copy();
+
+  void Paste();
+
+  void Duplicate();
+
+  void SetInPoint();
+
+  void SetOutPoint();
+
+  void ResetInPoint();
+
+  void ResetOutPoint();
+
+  void ClearInOutPoints();
+
+  void PreRenderInOut();
+
 };
 
 namespace olive {
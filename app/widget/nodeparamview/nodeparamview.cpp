@@ -20,10 +20,11 @@
 
 #include "nodeparamview.h"
 
-#include <QScrollArea>
+#include <QScrollBar>
 
 NodeParamView::NodeParamView(QWidget *parent) :
-  QWidget(parent)
+  QWidget(parent),
+  visible_items_update_queued_(false)
 {
   // Create horizontal layout to place scroll area in (and keyframe editing eventually)
   QHBoxLayout* widget_layout = new QHBoxLayout(this);
@@ -31,13 +32,17 @@ NodeParamView::NodeParamView(QWidget *parent) :
   widget_layout->setMargin(0);
 
   // Set up scroll area for params
-  QScrollArea* scroll_area = new QScrollArea();
-  scroll_area->setWidgetResizable(true);
-  widget_layout->addWidget(scroll_area);
+  scroll_area_ = new QScrollArea();
+  scroll_area_->setWidgetResizable(true);
+  widget_layout->addWidget(scroll_area_);
+
+  // Items only build their widgets once they're scrolled into view
+  connect(scroll_area_->verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(QueueVisibleItemsUpdate()));
+  connect(scroll_area_->verticalScrollBar(), SIGNAL(rangeChanged(int, int)), this, SLOT(QueueVisibleItemsUpdate()));
 
   // Param widget
   QWidget* param_widget_area = new QWidget();
-  scroll_area->setWidget(param_widget_area);
+  scroll_area_->setWidget(param_widget_area);
 
   // Set up scroll area layout
   param_layout_ = new QVBoxLayout(param_widget_area);
@@ -48,6 +53,12 @@ NodeParamView::NodeParamView(QWidget *parent) :
   param_layout_->addStretch();
 }
 
+NodeParamView::~NodeParamView()
+{
+  // Items return their widgets to widget_pool_ when deleted, so make sure that happens while the pool still exists
+  qDeleteAll(items_);
+}
+
 void NodeParamView::SetNodes(QList<Node *> nodes)
 {
   // If we already have item widgets, delete them all now
@@ -76,7 +87,8 @@ void NodeParamView::SetNodes(QList<Node *> nodes)
 
     // If we couldn't merge this node into the existing item, create a new one
     if (!merged_node) {
-      NodeParamViewItem* item = new NodeParamViewItem(this);
+      NodeParamViewItem* item = new NodeParamViewItem(&widget_pool_, this);
+      connect(item, SIGNAL(ExpandedChanged(bool)), this, SLOT(QueueVisibleItemsUpdate()));
 
       item->AttachNode(node);
 
@@ -86,9 +98,46 @@ void NodeParamView::SetNodes(QList<Node *> nodes)
       items_.append(item);
     }
   }
+
+  // The new items won't have a geometry until the layout has run, so create their contents afterwards
+  QueueVisibleItemsUpdate();
 }
 
 const QList<Node *> &NodeParamView::nodes()
 {
   return nodes_;
 }
+
+void NodeParamView::resizeEvent(QResizeEvent *event)
+{
+  QWidget::resizeEvent(event);
+
+  QueueVisibleItemsUpdate();
+}
+
+void NodeParamView::UpdateVisibleItems()
+{
+  visible_items_update_queued_ = false;
+
+  QWidget* viewport = scroll_area_->viewport();
+  QWidget* param_widget_area = scroll_area_->widget();
+
+  // The area of param_widget_area currently visible through the scroll area
+  QRect visible_rect(param_widget_area->mapFrom(viewport, QPoint(0, 0)), viewport->size());
+
+  foreach (NodeParamViewItem* item, items_) {
+    if (item->geometry().intersects(visible_rect)) {
+      item->CreateContents();
+    }
+  }
+}
+
+void NodeParamView::QueueVisibleItemsUpdate()
+{
+  if (visible_items_update_queued_) {
+    return;
+  }
+
+  visible_items_update_queued_ = true;
+  QMetaObject::invokeMethod(this, "UpdateVisibleItems", Qt::QueuedConnection);
+}
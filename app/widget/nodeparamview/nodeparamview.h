@@ -21,26 +21,54 @@
 #ifndef NODEPARAMVIEW_H
 #define NODEPARAMVIEW_H
 
+#include <QScrollArea>
 #include <QVBoxLayout>
 #include <QWidget>
 
 #include "node/node.h"
 #include "nodeparamviewitem.h"
+#include "nodeparamviewwidgetpool.h"
 
 class NodeParamView : public QWidget
 {
+  Q_OBJECT
 public:
   NodeParamView(QWidget* parent);
 
+  virtual ~NodeParamView() override;
+
   void SetNodes(QList<Node*> nodes);
   const QList<Node*>& nodes();
 
+protected:
+  virtual void resizeEvent(QResizeEvent *event) override;
+
 private:
+  QScrollArea* scroll_area_;
+
   QVBoxLayout* param_layout_;
 
   QList<Node*> nodes_;
 
   QList<NodeParamViewItem*> items_;
+
+  /**
+   * @brief Sliders recycled between items every time SetNodes() rebuilds them
+   */
+  NodeParamViewWidgetPool widget_pool_;
+
+  bool visible_items_update_queued_;
+
+private slots:
+  /**
+   * @brief Create the contents of any expanded item that is currently scrolled into view
+   */
+  void UpdateVisibleItems();
+
+  /**
+   * @brief Coalesce several requests for UpdateVisibleItems() into one call once control returns to the event loop
+   */
+  void QueueVisibleItemsUpdate();
 };
 
 #endif // NODEPARAMVIEW_H
@@ -28,8 +28,10 @@
 #include "project/item/sequence/sequence.h"
 #include "ui/icons/icons.h"
 
-NodeParamViewItem::NodeParamViewItem(QWidget *parent) :
-  QWidget(parent)
+NodeParamViewItem::NodeParamViewItem(NodeParamViewWidgetPool *pool, QWidget *parent) :
+  QWidget(parent),
+  pool_(pool),
+  contents_created_(false)
 {
   QVBoxLayout* main_layout = new QVBoxLayout(this);
   main_layout->setSpacing(0);
@@ -68,6 +70,14 @@ NodeParamViewItem::NodeParamViewItem(QWidget *parent) :
   SetExpanded(title_bar_collapse_btn_->isChecked());
 }
 
+NodeParamViewItem::~NodeParamViewItem()
+{
+  // Hand our widgets back to the pool before Qt deletes them along with contents_
+  foreach (NodeParamViewWidgetBridge* bridge, bridges_) {
+    bridge->ReleaseWidgets();
+  }
+}
+
 void NodeParamViewItem::AttachNode(Node *n)
 {
   // Make sure we can attach this node (CanAddNode() should be run by the caller to make sure this node is valid)
@@ -105,33 +115,56 @@ void NodeParamViewItem::SetupUI()
 
   Node* first_node = nodes_.first();
 
-  int row_count = 0;
-
   foreach (NodeParam* param, first_node->parameters()) {
     // This widget only needs to show input parameters
     if (param->type() == NodeParam::kInput) {
+      // Create a widget/input bridge for this input, its widgets are created later in CreateContents()
+      NodeParamViewWidgetBridge* bridge = new NodeParamViewWidgetBridge(pool_, this);
+      bridge->AddInput(static_cast<NodeInput*>(param));
+      bridges_.append(bridge);
+    }
+  }
 
-      // Add descriptor label
-      QLabel* param_label = new QLabel();
-      param_lbls_.append(param_label);
+  // Until the real widgets exist, reserve roughly the height they'll need so the scroll area's extents stay close
+  QMargins margins = content_layout_->contentsMargins();
+  int row_height = fontMetrics().height() * 3 / 2 + qMax(0, content_layout_->verticalSpacing());
+  contents_->setMinimumHeight(margins.top() + margins.bottom() + bridges_.size() * row_height);
 
-      content_layout_->addWidget(param_label, row_count, 0);
+  Retranslate();
+}
 
-      // Create a widget/input bridge for this input
-      NodeParamViewWidgetBridge* bridge = new NodeParamViewWidgetBridge(this);
-      bridge->AddInput(static_cast<NodeInput*>(param));
-      bridges_.append(bridge);
+void NodeParamViewItem::CreateContents()
+{
+  // Only build the contents if they'd actually be seen
+  if (contents_created_ || !expanded_ || nodes_.isEmpty() || !isVisible()) {
+    return;
+  }
 
-      // Add widgets for this parameter ot the layout
-      const QList<QWidget*>& widgets_for_param = bridge->widgets();
-      for (int i=0;i<widgets_for_param.size();i++) {
-        content_layout_->addWidget(widgets_for_param.at(i), row_count, i + 1);
-      }
+  contents_created_ = true;
 
-      row_count++;
+  for (int row=0;row<bridges_.size();row++) {
+    NodeParamViewWidgetBridge* bridge = bridges_.at(row);
+
+    // Add descriptor label
+    QLabel* param_label = new QLabel();
+    param_lbls_.append(param_label);
+
+    content_layout_->addWidget(param_label, row, 0);
+
+    bridge->CreateWidgets();
+
+    // Add widgets for this parameter to the layout
+    const QList<QWidget*>& widgets_for_param = bridge->widgets();
+    for (int i=0;i<widgets_for_param.size();i++) {
+      content_layout_->addWidget(widgets_for_param.at(i), row, i + 1);
+
+      // Widgets recycled from the pool were explicitly hidden when they were released
+      widgets_for_param.at(i)->show();
     }
   }
 
+  contents_->setMinimumHeight(0);
+
   Retranslate();
 }
 
@@ -156,6 +189,10 @@ void NodeParamViewItem::Retranslate()
 
   title_bar_lbl_->setText(first_node->Name());
 
+  if (!contents_created_) {
+    return;
+  }
+
   int row_count = 0;
 
   foreach (NodeParam* param, first_node->parameters()) {
@@ -179,6 +216,10 @@ void NodeParamViewItem::SetExpanded(bool e)
   } else {
     title_bar_collapse_btn_->setIcon(olive::icon::TriRight);
   }
+
+  CreateContents();
+
+  emit ExpandedChanged(expanded_);
 }
 
 NodeParamViewItemTitleBar::NodeParamViewItemTitleBar(QWidget *parent) :
@@ -42,12 +42,25 @@ class NodeParamViewItem : public QWidget
 {
   Q_OBJECT
 public:
-  NodeParamViewItem(QWidget* parent);
+  NodeParamViewItem(NodeParamViewWidgetPool* pool, QWidget* parent);
+
+  virtual ~NodeParamViewItem() override;
 
   void AttachNode(Node* n);
 
   bool CanAddNode(Node *n);
 
+  /**
+   * @brief Create the parameter labels and widgets if they haven't been created yet
+   *
+   * Contents are only built for expanded items that are actually scrolled into view, so this does nothing while the
+   * item is collapsed.
+   */
+  void CreateContents();
+
+signals:
+  void ExpandedChanged(bool e);
+
 protected:
   void changeEvent(QEvent *e) override;
 
@@ -58,8 +71,12 @@ private:
 
   void Retranslate();
 
+  NodeParamViewWidgetPool* pool_;
+
   bool expanded_;
 
+  bool contents_created_;
+
   NodeParamViewItemTitleBar* title_bar_;
 
   QLabel* title_bar_lbl_;
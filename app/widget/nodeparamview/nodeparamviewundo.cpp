@@ -0,0 +1,127 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "nodeparamviewundo.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+
+const qint64 NodeParamSetValueCommand::kMergeInterval = 1000;
+
+NodeParamSetValueCommand::NodeParamSetValueCommand(const rational &time, QUndoCommand *parent) :
+  QUndoCommand(parent),
+  time_(time),
+  last_change_time_(QDateTime::currentMSecsSinceEpoch())
+{
+}
+
+void NodeParamSetValueCommand::AddChange(NodeInput *input, const QVariant &value)
+{
+  Change c;
+
+  c.input = input;
+  c.old_value = input->get_value_at_time(time_);
+  c.new_value = value;
+
+  if (input->is_keyframing()) {
+    bool has_key_at_time = false;
+
+    foreach (const NodeKeyframe& key, input->keyframes()) {
+      if (key.time() == time_) {
+        has_key_at_time = true;
+        break;
+      }
+    }
+
+    if (!has_key_at_time) {
+      c.old_keyframes = input->keyframes();
+    }
+  }
+
+  changes_.append(c);
+
+  setText(QCoreApplication::translate("NodeParamSetValueCommand", "Change %1").arg(input->name()));
+}
+
+bool NodeParamSetValueCommand::HasChanges() const
+{
+  return !changes_.isEmpty();
+}
+
+void NodeParamSetValueCommand::redo()
+{
+  foreach (const Change& c, changes_) {
+    c.input->set_value_at_time(time_, c.new_value);
+  }
+}
+
+void NodeParamSetValueCommand::undo()
+{
+  foreach (const Change& c, changes_) {
+    if (c.old_keyframes.isEmpty()) {
+      c.input->set_value_at_time(time_, c.old_value);
+    } else {
+      c.input->set_keyframes(c.old_keyframes);
+    }
+  }
+}
+
+int NodeParamSetValueCommand::id() const
+{
+  // Arbitrary number unique among the commands that merge
+  return 0x4E505356;
+}
+
+bool NodeParamSetValueCommand::mergeWith(const QUndoCommand *other)
+{
+  const NodeParamSetValueCommand* o = static_cast<const NodeParamSetValueCommand*>(other);
+
+  if (o->time_ != time_
+      || o->changes_.size() != changes_.size()
+      || o->last_change_time_ - last_change_time_ > kMergeInterval) {
+    return false;
+  }
+
+  for (int i=0;i<changes_.size();i++) {
+    if (changes_.at(i).input != o->changes_.at(i).input) {
+      return false;
+    }
+  }
+
+  // Keep our old values and take the other command's new values
+  for (int i=0;i<changes_.size();i++) {
+    changes_[i].new_value = o->changes_.at(i).new_value;
+  }
+
+  last_change_time_ = o->last_change_time_;
+
+  return true;
+}
+
+qint64 NodeParamSetValueCommand::memory_usage() const
+{
+  qint64 usage = changes_.size() * static_cast<qint64>(sizeof(Change));
+
+  foreach (const Change& c, changes_) {
+    usage += c.old_keyframes.size() * static_cast<qint64>(sizeof(NodeKeyframe));
+  }
+
+  return usage;
+}
@@ -0,0 +1,87 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef NODEPARAMVIEWUNDO_H
+#define NODEPARAMVIEWUNDO_H
+
+#include <QUndoCommand>
+
+#include "node/input.h"
+#include "undo/undostack.h"
+
+/**
+ * @brief An undoable command for setting the value of one or more inputs at a certain time
+ *
+ * Only the change is stored (the old and new values), not a copy of the input. Commands pushed in quick succession
+ * that change the same inputs at the same time are merged, so dragging a slider is undone in one step rather than one
+ * per mouse movement.
+ */
+class NodeParamSetValueCommand : public QUndoCommand, public UndoCommandMemory {
+public:
+  NodeParamSetValueCommand(const rational& time, QUndoCommand* parent = nullptr);
+
+  /**
+   * @brief Set `input` to `value` when this command is done
+   *
+   * Must be called before the command is pushed, the input's current value is stored for undoing.
+   */
+  void AddChange(NodeInput* input, const QVariant& value);
+
+  /**
+   * @brief Returns whether AddChange() has been called
+   */
+  bool HasChanges() const;
+
+  virtual void redo() override;
+  virtual void undo() override;
+
+  virtual int id() const override;
+
+  virtual bool mergeWith(const QUndoCommand* other) override;
+
+  virtual qint64 memory_usage() const override;
+
+private:
+  struct Change {
+    NodeInput* input;
+
+    QVariant old_value;
+    QVariant new_value;
+
+    /**
+     * @brief Only set if setting the value adds a keyframe, since undoing has to remove it again
+     */
+    QVector<NodeKeyframe> old_keyframes;
+  };
+
+  /**
+   * @brief Commands later than this many milliseconds after the last one are never merged into it
+   */
+  static const qint64 kMergeInterval;
+
+  rational time_;
+
+  QVector<Change> changes_;
+
+  qint64 last_change_time_;
+
+};
+
+#endif // NODEPARAMVIEWUNDO_H
@@ -5,6 +5,9 @@
 #include <QCheckBox>
 
 #include "node/node.h"
+#include "nodeparamviewundo.h"
+#include "task/index/index.h"
+#include "undo/undostack.h"
 #include "widget/footagecombobox/footagecombobox.h"
 #include "widget/slider/floatslider.h"
 #include "widget/slider/integerslider.h"
@@ -14,19 +17,16 @@
 #include "panel/project/project.h"
 // End test code
 
-NodeParamViewWidgetBridge::NodeParamViewWidgetBridge(QObject* parent) :
-  QObject(parent)
+NodeParamViewWidgetBridge::NodeParamViewWidgetBridge(NodeParamViewWidgetPool *pool, QObject* parent) :
+  QObject(parent),
+  pool_(pool),
+  widgets_created_(false)
 {
 }
 
 void NodeParamViewWidgetBridge::AddInput(NodeInput *input)
 {
   inputs_.append(input);
-
-  // If this was the first input, create the widgets
-  if (inputs_.size() == 1) {
-    CreateWidgets();
-  }
 }
 
 const QList<QWidget *> &NodeParamViewWidgetBridge::widgets()
@@ -34,8 +34,27 @@ const QList<QWidget *> &NodeParamViewWidgetBridge::widgets()
   return widgets_;
 }
 
+void NodeParamViewWidgetBridge::ReleaseWidgets()
+{
+  foreach (QWidget* w, widgets_) {
+    // Make sure a recycled widget doesn't keep writing to our inputs
+    w->disconnect(this);
+
+    pool_->Release(w);
+  }
+
+  widgets_.clear();
+  widgets_created_ = false;
+}
+
 void NodeParamViewWidgetBridge::CreateWidgets()
 {
+  if (widgets_created_ || inputs_.isEmpty()) {
+    return;
+  }
+
+  widgets_created_ = true;
+
   NodeInput* base_input = inputs_.first();
 
   // We assume the first data type is the "primary" type
@@ -56,14 +75,15 @@ void NodeParamViewWidgetBridge::CreateWidgets()
     break;
   case NodeParam::kInt:
   {
-    IntegerSlider* slider = new IntegerSlider();
+    IntegerSlider* slider = pool_->TakeIntegerSlider();
+    slider->SetValue(base_input->get_value_at_time(0).toInt());
     widgets_.append(slider);
     connect(slider, SIGNAL(ValueChanged(int)), this, SLOT(WidgetCallback()));
     break;
   }
   case NodeParam::kFloat:
   {
-    FloatSlider* slider = new FloatSlider();
+    FloatSlider* slider = pool_->TakeFloatSlider();
 
     slider->SetValue(base_input->get_value_at_time(0).toDouble());
 
@@ -84,12 +104,12 @@ void NodeParamViewWidgetBridge::CreateWidgets()
   {
     QVector2D vec2 = base_input->get_value_at_time(0).value<QVector2D>();
 
-    FloatSlider* x_slider = new FloatSlider();
+    FloatSlider* x_slider = pool_->TakeFloatSlider();
     x_slider->SetValue(static_cast<double>(vec2.x()));
     widgets_.append(x_slider);
     connect(x_slider, SIGNAL(ValueChanged(double)), this, SLOT(WidgetCallback()));
 
-    FloatSlider* y_slider = new FloatSlider();
+    FloatSlider* y_slider = pool_->TakeFloatSlider();
     y_slider->SetValue(static_cast<double>(vec2.y()));
     widgets_.append(y_slider);
     connect(y_slider, SIGNAL(ValueChanged(double)), this, SLOT(WidgetCallback()));
@@ -99,17 +119,17 @@ void NodeParamViewWidgetBridge::CreateWidgets()
   {
     QVector3D vec3 = base_input->get_value_at_time(0).value<QVector3D>();
 
-    FloatSlider* x_slider = new FloatSlider();
+    FloatSlider* x_slider = pool_->TakeFloatSlider();
     x_slider->SetValue(static_cast<double>(vec3.x()));
     widgets_.append(x_slider);
     connect(x_slider, SIGNAL(ValueChanged(double)), this, SLOT(WidgetCallback()));
 
-    FloatSlider* y_slider = new FloatSlider();
+    FloatSlider* y_slider = pool_->TakeFloatSlider();
     y_slider->SetValue(static_cast<double>(vec3.y()));
     widgets_.append(y_slider);
     connect(y_slider, SIGNAL(ValueChanged(double)), this, SLOT(WidgetCallback()));
 
-    FloatSlider* z_slider = new FloatSlider();
+    FloatSlider* z_slider = pool_->TakeFloatSlider();
     z_slider->SetValue(static_cast<double>(vec3.z()));
     widgets_.append(z_slider);
     connect(z_slider, SIGNAL(ValueChanged(double)), this, SLOT(WidgetCallback()));
@@ -119,22 +139,22 @@ void NodeParamViewWidgetBridge::CreateWidgets()
   {
     QVector4D vec4 = base_input->get_value_at_time(0).value<QVector4D>();
 
-    FloatSlider* x_slider = new FloatSlider();
+    FloatSlider* x_slider = pool_->TakeFloatSlider();
     x_slider->SetValue(static_cast<double>(vec4.x()));
     widgets_.append(x_slider);
     connect(x_slider, SIGNAL(ValueChanged(double)), this, SLOT(WidgetCallback()));
 
-    FloatSlider* y_slider = new FloatSlider();
+    FloatSlider* y_slider = pool_->TakeFloatSlider();
     y_slider->SetValue(static_cast<double>(vec4.y()));
     widgets_.append(y_slider);
     connect(y_slider, SIGNAL(ValueChanged(double)), this, SLOT(WidgetCallback()));
 
-    FloatSlider* z_slider = new FloatSlider();
+    FloatSlider* z_slider = pool_->TakeFloatSlider();
     z_slider->SetValue(static_cast<double>(vec4.z()));
     widgets_.append(z_slider);
     connect(z_slider, SIGNAL(ValueChanged(double)), this, SLOT(WidgetCallback()));
 
-    FloatSlider* w_slider = new FloatSlider();
+    FloatSlider* w_slider = pool_->TakeFloatSlider();
     w_slider->SetValue(static_cast<double>(vec4.w()));
     widgets_.append(w_slider);
     connect(w_slider, SIGNAL(ValueChanged(double)), this, SLOT(WidgetCallback()));
@@ -189,6 +209,9 @@ void NodeParamViewWidgetBridge::CreateWidgets()
 
 void NodeParamViewWidgetBridge::WidgetCallback()
 {
+  // One command for every input, so consecutive changes (e.g. dragging a slider) merge into one undo step
+  NodeParamSetValueCommand* command = new NodeParamSetValueCommand(0);
+
   foreach (NodeInput* input, inputs_) {
     switch (input->data_type()) {
     // None of these inputs have applicable UI widgets
@@ -209,14 +232,14 @@ void NodeParamViewWidgetBridge::WidgetCallback()
     {
       // Widget is a IntegerSlider
       IntegerSlider* int_slider = static_cast<IntegerSlider*>(sender());
-      input->set_value_at_time(0, int_slider->GetValue());
+      command->AddChange(input, int_slider->GetValue());
       break;
     }
     case NodeParam::kFloat:
     {
       // Widget is a FloatSlider
       FloatSlider* float_slider = static_cast<FloatSlider*>(sender());
-      input->set_value_at_time(0, float_slider->GetValue());
+      command->AddChange(input, float_slider->GetValue());
       break;
     }
     case NodeParam::kVec2:
@@ -234,7 +257,7 @@ void NodeParamViewWidgetBridge::WidgetCallback()
         val.setY(static_cast<float>(slider->GetValue()));
       }
 
-      input->set_value_at_time(0, val);
+      command->AddChange(input, val);
       break;
     }
     case NodeParam::kVec3:
@@ -255,7 +278,7 @@ void NodeParamViewWidgetBridge::WidgetCallback()
         val.setZ(static_cast<float>(slider->GetValue()));
       }
 
-      input->set_value_at_time(0, val);
+      command->AddChange(input, val);
       break;
     }
     case NodeParam::kVec4:
@@ -279,7 +302,7 @@ void NodeParamViewWidgetBridge::WidgetCallback()
         val.setW(static_cast<float>(slider->GetValue()));
       }
 
-      input->set_value_at_time(0, val);
+      command->AddChange(input, val);
       break;
     }
     case NodeParam::kFile:
@@ -292,30 +315,39 @@ void NodeParamViewWidgetBridge::WidgetCallback()
     {
       // Sender is a QLineEdit
       QLineEdit* line_edit = static_cast<QLineEdit*>(sender());
-      input->set_value_at_time(0, line_edit->text());
+      command->AddChange(input, line_edit->text());
       break;
     }
     case NodeParam::kBoolean:
     {
       // Widget is a QCheckBox
       QCheckBox* check_box = static_cast<QCheckBox*>(sender());
-      input->set_value_at_time(0, check_box->isChecked());
+      command->AddChange(input, check_box->isChecked());
       break;
     }
     case NodeParam::kFont:
     {
       // Widget is a QFontComboBox
       QFontComboBox* font_combobox = static_cast<QFontComboBox*>(sender());
-      input->set_value_at_time(0, font_combobox->currentFont());
+      command->AddChange(input, font_combobox->currentFont());
       break;
     }
     case NodeParam::kFootage:
     {
       // Widget is a FootageComboBox
       FootageComboBox* footage_combobox = static_cast<FootageComboBox*>(sender());
-      input->set_value_at_time(0, QVariant::fromValue(footage_combobox->SelectedFootage()));
+      command->AddChange(input, QVariant::fromValue(footage_combobox->SelectedFootage()));
+
+      // Now that it's being used, index the file before anything tries to play it
+      IndexTask::IndexInBackground(footage_combobox->SelectedFootage());
       break;
     }
     }
   }
+
+  if (command->HasChanges()) {
+    olive::undo_stack.push(command);
+  } else {
+    delete command;
+  }
 }
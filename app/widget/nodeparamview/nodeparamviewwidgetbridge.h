@@ -4,23 +4,39 @@
 #include <QObject>
 
 #include "node/input.h"
+#include "nodeparamviewwidgetpool.h"
 
 class NodeParamViewWidgetBridge : public QObject
 {
   Q_OBJECT
 public:
-  NodeParamViewWidgetBridge(QObject* parent);
+  NodeParamViewWidgetBridge(NodeParamViewWidgetPool* pool, QObject* parent);
 
   void AddInput(NodeInput* input);
 
+  /**
+   * @brief Create the widgets for the inputs added with AddInput()
+   *
+   * Widgets are only created on demand so that collapsed or off-screen items don't pay for them. Calling this when
+   * the widgets already exist does nothing.
+   */
+  void CreateWidgets();
+
+  /**
+   * @brief Return this bridge's widgets to the pool so another bridge can reuse them
+   */
+  void ReleaseWidgets();
+
   const QList<QWidget*>& widgets();
 
 private:
+  NodeParamViewWidgetPool* pool_;
+
   QList<NodeInput*> inputs_;
 
   QList<QWidget*> widgets_;
 
-  void CreateWidgets();
+  bool widgets_created_;
 
 private slots:
   void WidgetCallback();
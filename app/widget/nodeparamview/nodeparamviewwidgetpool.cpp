@@ -0,0 +1,75 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "nodeparamviewwidgetpool.h"
+
+NodeParamViewWidgetPool::~NodeParamViewWidgetPool()
+{
+  qDeleteAll(float_sliders_);
+  qDeleteAll(integer_sliders_);
+}
+
+FloatSlider *NodeParamViewWidgetPool::TakeFloatSlider()
+{
+  if (float_sliders_.isEmpty()) {
+    return new FloatSlider();
+  }
+
+  FloatSlider* slider = float_sliders_.takeLast();
+
+  slider->ClearMinimum();
+  slider->ClearMaximum();
+
+  return slider;
+}
+
+IntegerSlider *NodeParamViewWidgetPool::TakeIntegerSlider()
+{
+  if (integer_sliders_.isEmpty()) {
+    return new IntegerSlider();
+  }
+
+  IntegerSlider* slider = integer_sliders_.takeLast();
+
+  slider->ClearMinimum();
+  slider->ClearMaximum();
+
+  return slider;
+}
+
+void NodeParamViewWidgetPool::Release(QWidget *w)
+{
+  FloatSlider* float_slider = qobject_cast<FloatSlider*>(w);
+  IntegerSlider* integer_slider = qobject_cast<IntegerSlider*>(w);
+
+  if (!float_slider && !integer_slider) {
+    delete w;
+    return;
+  }
+
+  w->hide();
+  w->setParent(nullptr);
+
+  if (float_slider) {
+    float_sliders_.append(float_slider);
+  } else {
+    integer_sliders_.append(integer_slider);
+  }
+}
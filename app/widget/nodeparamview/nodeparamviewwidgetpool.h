@@ -0,0 +1,72 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef NODEPARAMVIEWWIDGETPOOL_H
+#define NODEPARAMVIEWWIDGETPOOL_H
+
+#include <QList>
+#include <QWidget>
+
+#include "widget/slider/floatslider.h"
+#include "widget/slider/integerslider.h"
+
+/**
+ * @brief A pool of slider widgets recycled between NodeParamViewWidgetBridges
+ *
+ * NodeParamView rebuilds all of its items whenever the node selection changes. Rather than destroying and
+ * reconstructing every slider each time, bridges return their widgets here with Release() and take sliders back out
+ * the next time they need one.
+ */
+class NodeParamViewWidgetPool
+{
+public:
+  NodeParamViewWidgetPool() = default;
+
+  ~NodeParamViewWidgetPool();
+
+  /**
+   * @brief Take a FloatSlider from the pool (or create one if the pool is empty)
+   *
+   * The returned slider is parentless and hidden, with no minimum or maximum set.
+   */
+  FloatSlider* TakeFloatSlider();
+
+  /**
+   * @brief Take an IntegerSlider from the pool (or create one if the pool is empty)
+   *
+   * The returned slider is parentless and hidden, with no minimum or maximum set.
+   */
+  IntegerSlider* TakeIntegerSlider();
+
+  /**
+   * @brief Return a widget to the pool
+   *
+   * Sliders are detached from their parent and kept for reuse, any other widget is deleted. The caller is responsible
+   * for disconnecting any signals it connected to the widget.
+   */
+  void Release(QWidget* w);
+
+private:
+  QList<FloatSlider*> float_sliders_;
+
+  QList<IntegerSlider*> integer_sliders_;
+};
+
+#endif // NODEPARAMVIEWWIDGETPOOL_H
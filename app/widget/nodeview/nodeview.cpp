@@ -28,7 +28,6 @@ NodeView::NodeView(QWidget *parent) :
 
   setDragMode(RubberBandDrag);
 
-  connect(&scene_, SIGNAL(changed(const QList<QRectF>&)), this, SLOT(ItemsChanged()));
   connect(&scene_, SIGNAL(selectionChanged()), this, SLOT(SceneSelectionChangedSlot()));
 }
 
@@ -55,6 +54,8 @@ void NodeView::SetGraph(NodeGraph *graph)
 
   // Clear the scene of all UI objects
   scene_.clear();
+  node_items_.clear();
+  edge_items_.clear();
 
   // Set reference to the graph
   graph_ = graph;
@@ -76,56 +77,59 @@ void NodeView::SetGraph(NodeGraph *graph)
 
 NodeViewItem *NodeView::NodeToUIObject(QGraphicsScene *scene, Node *n)
 {
-  QList<QGraphicsItem*> graphics_items = scene->items();
+  NodeView* view = SceneToView(scene);
 
-  for (int i=0;i<graphics_items.size();i++) {
-    NodeViewItem* item = dynamic_cast<NodeViewItem*>(graphics_items.at(i));
-
-    if (item != nullptr) {
-      if (item->node() == n) {
-        return item;
-      }
-    }
+  if (view == nullptr) {
+    return nullptr;
   }
 
-  return nullptr;
+  return view->NodeToUIObject(n);
 }
 
 NodeViewEdge *NodeView::EdgeToUIObject(QGraphicsScene *scene, NodeEdgePtr n)
 {
-  QList<QGraphicsItem*> graphics_items = scene->items();
+  NodeView* view = SceneToView(scene);
 
-  for (int i=0;i<graphics_items.size();i++) {
-    NodeViewEdge* edge = dynamic_cast<NodeViewEdge*>(graphics_items.at(i));
-
-    if (edge != nullptr) {
-      if (edge->edge() == n) {
-        return edge;
-      }
-    }
+  if (view == nullptr) {
+    return nullptr;
   }
 
-  return nullptr;
+  return view->EdgeToUIObject(n);
 }
 
 NodeViewItem *NodeView::NodeToUIObject(Node *n)
 {
-  return NodeToUIObject(&scene_, n);
+  return node_items_.value(n);
 }
 
 NodeViewEdge *NodeView::EdgeToUIObject(NodeEdgePtr n)
 {
-  return EdgeToUIObject(&scene_, n);
+  return edge_items_.value(n.get());
+}
+
+NodeView *NodeView::SceneToView(QGraphicsScene *scene)
+{
+  if (scene == nullptr || scene->views().isEmpty()) {
+    return nullptr;
+  }
+
+  return dynamic_cast<NodeView*>(scene->views().first());
 }
 
 void NodeView::AddNode(Node* node)
 {
+  if (node_items_.contains(node)) {
+    return;
+  }
+
   NodeViewItem* item = new NodeViewItem();
 
   item->SetNode(node);
 
   scene_.addItem(item);
 
+  node_items_.insert(node, item);
+
   // Add a NodeViewEdge for each connection
   foreach (NodeParam* param, node->parameters()) {
 
@@ -139,42 +143,35 @@ void NodeView::AddNode(Node* node)
       }
     }
   }
+
+  // Edges from nodes added earlier couldn't be placed until this node had a UI object
+  item->AdjustEdges();
 }
 
 void NodeView::RemoveNode(Node *node)
 {
-  NodeViewItem* item = NodeToUIObject(scene(), node);
-
-  delete item;
+  delete node_items_.take(node);
 }
 
 void NodeView::AddEdge(NodeEdgePtr edge)
 {
-  NodeViewEdge* edge_ui = new NodeViewEdge();
+  // Edges may be announced by both the graph and AddNode()
+  if (edge_items_.contains(edge.get())) {
+    return;
+  }
 
-  edge_ui->SetEdge(edge);
+  NodeViewEdge* edge_ui = new NodeViewEdge();
 
   scene_.addItem(edge_ui);
-}
 
-void NodeView::RemoveEdge(NodeEdgePtr edge)
-{
-  NodeViewEdge* edge_ui = EdgeToUIObject(scene(), edge);
+  edge_ui->SetEdge(edge);
 
-  delete edge_ui;
+  edge_items_.insert(edge.get(), edge_ui);
 }
 
-void NodeView::ItemsChanged()
+void NodeView::RemoveEdge(NodeEdgePtr edge)
 {
-  QList<QGraphicsItem*> items = scene_.items();
-
-  foreach (QGraphicsItem* item, items) {
-    NodeViewEdge* edge = dynamic_cast<NodeViewEdge*>(item);
-
-    if (edge != nullptr) {
-      edge->Adjust();
-    }
-  }
+  delete edge_items_.take(edge.get());
 }
 
 void NodeView::SceneSelectionChangedSlot()
@@ -22,6 +22,7 @@
 #define NODEVIEW_H
 
 #include <QGraphicsView>
+#include <QHash>
 
 #include "node/graph.h"
 #include "widget/nodeview/nodeviewedge.h"
@@ -56,6 +57,8 @@ public:
    *
    * If the scene does not contain a widget for this node (usually meaning the node's graph is not the active graph
    * in this view/scene), this function returns nullptr.
+   *
+   * Looked up through the NodeView showing the scene, so this doesn't depend on how many items the scene has.
    */
   static NodeViewItem* NodeToUIObject(QGraphicsScene* scene, Node* n);
 
@@ -83,10 +86,25 @@ signals:
   void SelectionChanged(QList<Node*> selected_nodes);
 
 private:
+  /**
+   * @brief Get the NodeView showing a scene, or nullptr if it isn't one
+   */
+  static NodeView* SceneToView(QGraphicsScene* scene);
+
   NodeGraph* graph_;
 
   QGraphicsScene scene_;
 
+  /**
+   * @brief UI object of every Node in the current graph
+   */
+  QHash<Node*, NodeViewItem*> node_items_;
+
+  /**
+   * @brief UI object of every NodeEdge in the current graph
+   */
+  QHash<NodeEdge*, NodeViewEdge*> edge_items_;
+
 private slots:
   /**
    * @brief Slot when a Node is added to a graph (SetGraph() connects this)
@@ -120,13 +138,6 @@ private slots:
    */
   void RemoveEdge(NodeEdgePtr edge);
 
-  /**
-   * @brief Internal function triggered when any change is signalled from the QGraphicsScene
-   *
-   * Current primary function is to inform all NodeViewEdges to re-adjust in case any Nodes have moved
-   */
-  void ItemsChanged();
-
   /**
    * @brief Receiver for when the scene's selected items change
    */
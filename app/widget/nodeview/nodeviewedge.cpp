@@ -83,6 +83,10 @@ void NodeViewEdge::Adjust()
   NodeViewItem* output = NodeView::NodeToUIObject(scene(), edge_->output()->parentNode());
   NodeViewItem* input = NodeView::NodeToUIObject(scene(), edge_->input()->parentNode());
 
+  if (output == nullptr || input == nullptr) {
+    return;
+  }
+
   // Create initial values
   QPointF output_point = QPointF(output->pos().x() + output->rect().width(), 0);
   QPointF input_point = QPointF(input->pos().x(), 0);
@@ -51,8 +51,10 @@ public:
    * that this edge connects. It uses their positions to determine where the line should visually connect and sets
    * it accordingly.
    *
-   * This should be set any time the NodeEdge changes (see SetEdge()), and any time the nodes move in the NodeGraph
-   * (see NodeView::ItemsChanged()). This will keep the nodes visually connected at all times.
+   * This should be set any time the NodeEdge changes (see SetEdge()), and any time either node moves or resizes
+   * (see NodeViewItem::AdjustEdges()). This will keep the nodes visually connected at all times.
+   *
+   * Does nothing while either node has no UI object yet.
    */
   void Adjust();
 
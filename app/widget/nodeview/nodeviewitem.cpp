@@ -48,6 +48,9 @@ NodeViewItem::NodeViewItem(QGraphicsItem *parent) :
   setFlag(QGraphicsItem::ItemIsMovable);
   setFlag(QGraphicsItem::ItemIsSelectable);
 
+  // Required to be notified of moves in itemChange() so connected edges can follow
+  setFlag(QGraphicsItem::ItemSendsGeometryChanges);
+
   //
   // We use font metrics to set all the UI measurements for DPI-awareness
   //
@@ -119,6 +122,35 @@ void NodeViewItem::SetExpanded(bool e)
   update();
 
   setRect(new_rect);
+
+  // Edges attach to different points when expanded
+  AdjustEdges();
+}
+
+void NodeViewItem::AdjustEdges()
+{
+  if (node_ == nullptr || scene() == nullptr) {
+    return;
+  }
+
+  foreach (NodeParam* param, node_->parameters()) {
+    foreach (NodeEdgePtr edge, param->edges()) {
+      NodeViewEdge* edge_ui = NodeView::EdgeToUIObject(scene(), edge);
+
+      if (edge_ui != nullptr) {
+        edge_ui->Adjust();
+      }
+    }
+  }
+}
+
+QVariant NodeViewItem::itemChange(QGraphicsItem::GraphicsItemChange change, const QVariant &value)
+{
+  if (change == ItemPositionHasChanged) {
+    AdjustEdges();
+  }
+
+  return QGraphicsRectItem::itemChange(change, value);
 }
 
 QRectF NodeViewItem::GetParameterConnectorRect(int index)
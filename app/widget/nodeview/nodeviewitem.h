@@ -75,7 +75,16 @@ public:
    */
   QRectF GetParameterConnectorRect(int index);
 
+  /**
+   * @brief Re-adjust the NodeViewEdges connected to this node
+   *
+   * Called whenever this item moves or changes size, so only the edges that could have changed are recalculated.
+   */
+  void AdjustEdges();
+
 protected:
+  virtual QVariant itemChange(GraphicsItemChange change, const QVariant &value) override;
+
   virtual void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = nullptr) override;
 
   virtual void mousePressEvent(QGraphicsSceneMouseEvent *event) override;
@@ -21,11 +21,13 @@
 #include "projectexplorer.h"
 
 #include <QDebug>
+#include <QLineEdit>
 #include <QMenu>
 #include <QVBoxLayout>
 
 #include "dialog/footageproperties/footageproperties.h"
 #include "projectexplorerdefines.h"
+#include "task/proxy/proxy.h"
 
 ProjectExplorer::ProjectExplorer(QWidget *parent) :
   QWidget(parent),
@@ -43,6 +45,13 @@ ProjectExplorer::ProjectExplorer(QWidget *parent) :
   connect(nav_bar_, SIGNAL(DirectoryUpClicked()), this, SLOT(DirUpSlot()));
   layout->addWidget(nav_bar_);
 
+  // Set up search box
+  QLineEdit* search_edit = new QLineEdit(this);
+  search_edit->setPlaceholderText(tr("Search..."));
+  search_edit->setClearButtonEnabled(true);
+  connect(search_edit, SIGNAL(textChanged(const QString&)), this, SLOT(SearchChangedSlot(const QString&)));
+  layout->addWidget(search_edit);
+
   // Set up stacked widget
   stacked_widget_ = new QStackedWidget(this);
   layout->addWidget(stacked_widget_);
@@ -51,6 +60,8 @@ ProjectExplorer::ProjectExplorer(QWidget *parent) :
   tree_view_ = new ProjectExplorerTreeView(stacked_widget_);
   tree_view_->setContextMenuPolicy(Qt::CustomContextMenu);
   AddView(tree_view_);
+  tree_view_->setSortingEnabled(true);
+  tree_view_->sortByColumn(0, Qt::AscendingOrder);
 
   // Add list view to stacked widget
   list_view_ = new ProjectExplorerListView(stacked_widget_);
@@ -243,6 +254,18 @@ void ProjectExplorer::ShowContextMenu()
 
     if (selected_items.first()->type() == Item::kFootage) {
       connect(properties_action, SIGNAL(triggered(bool)), this, SLOT(ShowFootagePropertiesDialog()));
+
+      menu.addSeparator();
+
+      QMenu* proxy_menu = menu.addMenu(tr("Create &Proxy"));
+
+      QAction* half_proxy_action = proxy_menu->addAction(tr("&Half Resolution"));
+      half_proxy_action->setData(2);
+      connect(half_proxy_action, SIGNAL(triggered(bool)), this, SLOT(CreateProxySlot()));
+
+      QAction* quarter_proxy_action = proxy_menu->addAction(tr("&Quarter Resolution"));
+      quarter_proxy_action->setData(4);
+      connect(quarter_proxy_action, SIGNAL(triggered(bool)), this, SLOT(CreateProxySlot()));
     }
   }
 
@@ -256,6 +279,20 @@ void ProjectExplorer::ShowFootagePropertiesDialog()
   fpd.exec();
 }
 
+void ProjectExplorer::CreateProxySlot()
+{
+  int divider = static_cast<QAction*>(sender())->data().toInt();
+
+  QList<Item*> selected_items = SelectedItems();
+
+  foreach (Item* item, selected_items) {
+    if (item->type() == Item::kFootage) {
+      // Footage without any video streams is skipped
+      ProxyTask::CreateProxies(static_cast<Footage*>(item), divider);
+    }
+  }
+}
+
 Project *ProjectExplorer::project()
 {
   return model_.project();
@@ -336,3 +373,11 @@ ProjectViewModel *ProjectExplorer::model()
 {
   return &model_;
 }
+
+void ProjectExplorer::SearchChangedSlot(const QString &s)
+{
+  model_.SetFilter(s);
+
+  // Filtering resets the model, so the folder the list and icon views were in is gone
+  BrowseToFolder(QModelIndex());
+}
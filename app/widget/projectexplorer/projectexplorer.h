@@ -146,6 +146,16 @@ private slots:
   void ShowContextMenu();
 
   void ShowFootagePropertiesDialog();
+
+  /**
+   * @brief Queue proxies of the selected Footage at the divider stored in the triggering QAction's data
+   */
+  void CreateProxySlot();
+
+  /**
+   * @brief Only show items matching the search box's text
+   */
+  void SearchChangedSlot(const QString& s);
 };
 
 #endif // PROJECTEXPLORER_H
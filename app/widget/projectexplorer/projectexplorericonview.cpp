@@ -20,10 +20,25 @@
 
 #include "projectexplorericonview.h"
 
+#include "render/thumbnailservice.h"
+
 ProjectExplorerIconView::ProjectExplorerIconView(QWidget *parent) :
   ProjectExplorerListViewBase(parent)
 {
   setViewMode(QListView::IconMode);
 
   setItemDelegate(&delegate_);
+
+  // Footage draws thumbnails as they arrive
+  connect(ThumbnailService::instance(), SIGNAL(ThumbnailReady()), viewport(), SLOT(update()));
+}
+
+void ProjectExplorerIconView::scrollContentsBy(int dx, int dy)
+{
+  // Thumbnails are requested by the model as items are drawn (see ProjectViewModel::kThumbnailRole)
+  if (ThumbnailService::instance() != nullptr && model() != nullptr) {
+    ThumbnailService::instance()->CancelRequests(model());
+  }
+
+  ProjectExplorerListViewBase::scrollContentsBy(dx, dy);
 }
@@ -33,6 +33,12 @@ class ProjectExplorerIconView : public ProjectExplorerListViewBase
 public:
   ProjectExplorerIconView(QWidget* parent);
 
+protected:
+  /**
+   * @brief Drops queued thumbnails of items that scrolled out of view, those still visible are requested again
+   */
+  virtual void scrollContentsBy(int dx, int dy) override;
+
 private:
   ProjectExplorerIconViewItemDelegate delegate_;
 };
@@ -21,8 +21,10 @@
 #include "projectexplorericonviewitemdelegate.h"
 
 #include <QPainter>
+#include <QPixmapCache>
 
 #include "common/qtversionabstraction.h"
+#include "project/projectviewmodel.h"
 
 ProjectExplorerIconViewItemDelegate::ProjectExplorerIconViewItemDelegate(QObject *parent) :
   QStyledItemDelegate (parent)
@@ -79,14 +81,25 @@ void ProjectExplorerIconViewItemDelegate::paint(QPainter *painter, const QStyleO
 
   }
 
-  // Draw image
-  QIcon ico = index.data(Qt::DecorationRole).value<QIcon>();
-  QSize icon_size = ico.actualSize(img_rect.size());
-  img_rect = QRect(img_rect.x() + (img_rect.width() / 2 - icon_size.width() / 2),
-                   img_rect.y() + (img_rect.height() / 2 - icon_size.height() / 2),
-                   icon_size.width(),
-                   icon_size.height());
-  painter->drawPixmap(img_rect, ico.pixmap(icon_size));
+  // Draw image, using a thumbnail of the footage if there is one
+  QImage thumbnail = index.data(ProjectViewModel::kThumbnailRole).value<QImage>();
+
+  if (thumbnail.isNull()) {
+    QIcon ico = index.data(Qt::DecorationRole).value<QIcon>();
+    QSize icon_size = ico.actualSize(img_rect.size());
+    img_rect = QRect(img_rect.x() + (img_rect.width() / 2 - icon_size.width() / 2),
+                     img_rect.y() + (img_rect.height() / 2 - icon_size.height() / 2),
+                     icon_size.width(),
+                     icon_size.height());
+    painter->drawPixmap(img_rect, ico.pixmap(icon_size));
+  } else {
+    QSize thumbnail_size = thumbnail.size().scaled(img_rect.size(), Qt::KeepAspectRatio);
+    img_rect = QRect(img_rect.x() + (img_rect.width() / 2 - thumbnail_size.width() / 2),
+                     img_rect.y() + (img_rect.height() / 2 - thumbnail_size.height() / 2),
+                     thumbnail_size.width(),
+                     thumbnail_size.height());
+    painter->drawPixmap(img_rect, GetScaledPixmap(thumbnail, thumbnail_size));
+  }
 
   if (option.state & QStyle::State_Selected) {
     QColor highlight_color = option.palette.highlight().color();
@@ -97,3 +110,20 @@ void ProjectExplorerIconViewItemDelegate::paint(QPainter *painter, const QStyleO
   }
 }
 
+
+QPixmap ProjectExplorerIconViewItemDelegate::GetScaledPixmap(const QImage &thumbnail, const QSize &size)
+{
+  // Copies of a thumbnail share its data and so its cache key, whoever returned them
+  QString key = QStringLiteral("ProjectExplorerThumbnail:%1:%2x%3").arg(QString::number(thumbnail.cacheKey()),
+                                                                       QString::number(size.width()),
+                                                                       QString::number(size.height()));
+
+  QPixmap pixmap;
+
+  if (!QPixmapCache::find(key, &pixmap)) {
+    pixmap = QPixmap::fromImage(thumbnail.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+    QPixmapCache::insert(key, pixmap);
+  }
+
+  return pixmap;
+}
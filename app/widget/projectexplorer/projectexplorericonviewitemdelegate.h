@@ -32,6 +32,12 @@ public:
 
   virtual QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override;
   virtual void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+
+private:
+  /**
+   * @brief Returns `thumbnail` scaled to `size`, scaling it only the first time it's drawn at that size
+   */
+  static QPixmap GetScaledPixmap(const QImage& thumbnail, const QSize& size);
 };
 
 #endif // PROJECTEXPLORERICONVIEWITEMDELEGATE_H
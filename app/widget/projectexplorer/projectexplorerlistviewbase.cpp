@@ -25,8 +25,15 @@
 ProjectExplorerListViewBase::ProjectExplorerListViewBase(QWidget *parent) :
   QListView(parent)
 {
-  // FIXME Is this necessary?
-  setMovement(QListView::Free);
+  // Lay items out in a fixed grid rather than keeping a position for every one of them, so only one size hint is
+  // needed and layout is done in batches between events rather than all at once, however big the folder is
+  setMovement(QListView::Static);
+  setUniformItemSizes(true);
+  setLayoutMode(QListView::Batched);
+
+  // Static movement turns dragging off, but items are still dragged into folders (etc.) through the model
+  setDragDropMode(QAbstractItemView::DragDrop);
+  setDragEnabled(true);
 
   // Set selection mode (allows multiple item selection)
   setSelectionMode(QAbstractItemView::ExtendedSelection);
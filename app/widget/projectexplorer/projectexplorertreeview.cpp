@@ -34,6 +34,9 @@ ProjectExplorerTreeView::ProjectExplorerTreeView(QWidget *parent) :
   // Enable dragging
   setDragEnabled(true);
 
+  // Every row is the same height, so rows are placed without asking each one for its size
+  setUniformRowHeights(true);
+
   // Allow dropping from external sources
   setAcceptDrops(true);
 
@@ -0,0 +1,431 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "scopeglwidget.h"
+
+#include <QDebug>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QPainter>
+#include <QtMath>
+
+namespace {
+
+/**
+ * @brief How bright a texel of the waveform, parade or vectorscope is with an average number of samples in it
+ *
+ * Brightness is 1 - exp(-count * gain), so texels with a few times the average are already close to white.
+ */
+const float kBrightness = 2.0f;
+
+/**
+ * @brief Share of the vectorscope most frames cover, which "average" is taken over for kBrightness
+ */
+const float kVectorscopeCoverage = 0.05f;
+
+/**
+ * @brief Height of a histogram bin holding the average number of samples, as a share of the scope's height
+ */
+const float kHistogramAverageHeight = 0.25f;
+
+}
+
+ScopeGLWidget::ScopeGLWidget(QWidget *parent) :
+  QOpenGLWidget(parent),
+  type_(kWaveform),
+  accumulation_fbo_(0),
+  accumulation_texture_(0),
+  accumulation_width_(0),
+  accumulation_height_(0)
+{
+}
+
+ScopeGLWidget::~ScopeGLWidget()
+{
+  ContextCleanup();
+}
+
+const ScopeGLWidget::Type &ScopeGLWidget::type() const
+{
+  return type_;
+}
+
+void ScopeGLWidget::SetTexture(OpenGLTexturePtr texture)
+{
+  texture_ = texture;
+
+  // Hidden scopes (e.g. a tab in the background) don't draw anything, so this costs nothing until they're shown
+  update();
+}
+
+void ScopeGLWidget::SetType(int type)
+{
+  type_ = static_cast<Type>(type);
+
+  update();
+}
+
+void ScopeGLWidget::initializeGL()
+{
+  vao_.create();
+
+  QString header = ShaderHeader();
+
+  scatter_shader_ = std::make_shared<OpenGLShader>();
+  scatter_shader_->LinkCached(QVector<OpenGLShader::ShaderSource>()
+                              << OpenGLShader::ShaderSource(QOpenGLShader::Vertex, header + QStringLiteral(
+    "uniform sampler2D source;\n"
+    "uniform ivec2 grid;\n"
+    "uniform int type;\n"
+    "uniform int channel;\n"
+    "uniform float levels;\n"
+    "\n"
+    "out vec4 v_color;\n"
+    "\n"
+    // Center of the texel a value falls in when split into this many levels
+    "float level(float value, float count) {\n"
+    "  return (floor(value * (count - 1.0) + 0.5) + 0.5) / count;\n"
+    "}\n"
+    "\n"
+    "void main() {\n"
+    "  ivec2 sample_pos = ivec2(gl_VertexID % grid.x, gl_VertexID / grid.x);\n"
+    "  vec4 texel = texelFetch(source, (sample_pos * textureSize(source, 0)) / grid, 0);\n"
+    "\n"
+    "  vec3 rgb = clamp(texel.rgb, 0.0, 1.0);\n"
+    "  float luma = dot(rgb, vec3(0.2126, 0.7152, 0.0722));\n"
+    "  float column = (float(sample_pos.x) + 0.5) / float(grid.x);\n"
+    "  vec3 mask = vec3(float(channel == 0), float(channel == 1), float(channel == 2));\n"
+    "\n"
+    "  vec2 pos;\n"
+    "\n"
+    "  if (type == 0) {\n"
+    "    pos = vec2(column, level(luma, levels));\n"
+    "    v_color = vec4(1.0);\n"
+    "  } else if (type == 1) {\n"
+    "    pos = vec2((column + float(channel)) / 3.0, level(dot(rgb, mask), levels));\n"
+    "    v_color = vec4(mask, 1.0);\n"
+    "  } else if (type == 2) {\n"
+    // BT.709 Cb and Cr, each -0.5 to 0.5
+    "    pos = vec2((rgb.b - luma) / 1.8556, (rgb.r - luma) / 1.5748) + 0.5;\n"
+    "    v_color = vec4(1.0);\n"
+    "  } else {\n"
+    "    pos = vec2(level(dot(rgb, mask), levels), 0.5);\n"
+    "    v_color = vec4(mask, 1.0);\n"
+    "  }\n"
+    "\n"
+    "  gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);\n"
+    "  gl_PointSize = 1.0;\n"
+    "}\n"))
+                              << OpenGLShader::ShaderSource(QOpenGLShader::Fragment, header + QStringLiteral(
+    "in vec4 v_color;\n"
+    "out vec4 frag_color;\n"
+    "\n"
+    "void main() {\n"
+    "  frag_color = v_color;\n"
+    "}\n")));
+
+  display_shader_ = std::make_shared<OpenGLShader>();
+  display_shader_->LinkCached(QVector<OpenGLShader::ShaderSource>()
+                              << OpenGLShader::ShaderSource(QOpenGLShader::Vertex, header + QStringLiteral(
+    "out vec2 v_texcoord;\n"
+    "\n"
+    // One triangle that covers the viewport
+    "void main() {\n"
+    "  vec2 pos = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));\n"
+    "  v_texcoord = pos;\n"
+    "  gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);\n"
+    "}\n"))
+                              << OpenGLShader::ShaderSource(QOpenGLShader::Fragment, header + QStringLiteral(
+    "uniform sampler2D accumulation;\n"
+    "uniform int type;\n"
+    "uniform float gain;\n"
+    "\n"
+    "in vec2 v_texcoord;\n"
+    "out vec4 frag_color;\n"
+    "\n"
+    "void main() {\n"
+    "  if (type == 3) {\n"
+    "    vec3 bins = texture(accumulation, vec2(v_texcoord.x, 0.5)).rgb * gain;\n"
+    "    frag_color = vec4(step(vec3(v_texcoord.y), bins) * 0.75, 1.0);\n"
+    "  } else {\n"
+    "    vec3 counts = texture(accumulation, v_texcoord).rgb;\n"
+    "    frag_color = vec4(1.0 - exp(-counts * gain), 1.0);\n"
+    "  }\n"
+    "}\n")));
+
+  if (!scatter_shader_->isLinked() || !display_shader_->isLinked()) {
+    qWarning() << "Failed to create scope shaders";
+    scatter_shader_ = nullptr;
+    display_shader_ = nullptr;
+  }
+
+  connect(context(), SIGNAL(aboutToBeDestroyed()), this, SLOT(ContextCleanup()), Qt::DirectConnection);
+}
+
+void ScopeGLWidget::paintGL()
+{
+  QOpenGLExtraFunctions* f = context()->extraFunctions();
+
+  f->glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+  f->glClear(GL_COLOR_BUFFER_BIT);
+
+  if (texture_ != nullptr && texture_->IsCreated() && scatter_shader_ != nullptr) {
+    int grid_width = qMin(texture_->width(), kMaximumSamples);
+    int grid_height = qMax(1, qRound(static_cast<double>(grid_width) * texture_->height() / texture_->width()));
+    float sample_count = static_cast<float>(grid_width) * grid_height;
+    float gain = 0;
+
+    switch (type_) {
+    case kWaveform:
+      SetupAccumulation(grid_width, kLevels);
+      gain = kBrightness * kLevels / grid_height;
+      break;
+    case kParade:
+      SetupAccumulation(grid_width * 3, kLevels);
+      gain = kBrightness * kLevels / grid_height;
+      break;
+    case kVectorscope:
+      SetupAccumulation(kLevels, kLevels);
+      gain = kBrightness * kLevels * kLevels * kVectorscopeCoverage / sample_count;
+      break;
+    case kHistogram:
+      SetupAccumulation(kHistogramBins, 1);
+      gain = kHistogramAverageHeight * kHistogramBins / sample_count;
+      break;
+    }
+
+    Accumulate(grid_width, grid_height);
+
+    // Back to the widget's framebuffer to draw the accumulation
+    f->glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
+
+    QRect plot = PlotRect();
+    qreal ratio = devicePixelRatioF();
+
+    f->glViewport(qRound(plot.x() * ratio),
+                  qRound((height() - plot.bottom() - 1) * ratio),
+                  qRound(plot.width() * ratio),
+                  qRound(plot.height() * ratio));
+
+    f->glBindTexture(GL_TEXTURE_2D, accumulation_texture_);
+
+    display_shader_->bind();
+    display_shader_->setUniformValue("accumulation", 0);
+    display_shader_->setUniformValue("type", static_cast<int>(type_));
+    display_shader_->setUniformValue("gain", gain);
+
+    vao_.bind();
+    f->glDrawArrays(GL_TRIANGLES, 0, 3);
+    vao_.release();
+
+    display_shader_->release();
+
+    f->glBindTexture(GL_TEXTURE_2D, 0);
+  }
+
+  DrawGraticule();
+}
+
+void ScopeGLWidget::SetupAccumulation(int width, int height)
+{
+  QOpenGLExtraFunctions* f = context()->extraFunctions();
+
+  if (accumulation_texture_ != 0 && accumulation_width_ == width && accumulation_height_ == height) {
+    return;
+  }
+
+  if (accumulation_texture_ == 0) {
+    f->glGenTextures(1, &accumulation_texture_);
+    f->glGenFramebuffers(1, &accumulation_fbo_);
+  }
+
+  accumulation_width_ = width;
+  accumulation_height_ = height;
+
+  // Counts can go well past what half floats hold exactly (e.g. a histogram bin of a flat frame)
+  f->glBindTexture(GL_TEXTURE_2D, accumulation_texture_);
+  f->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  f->glBindTexture(GL_TEXTURE_2D, 0);
+
+  f->glBindFramebuffer(GL_FRAMEBUFFER, accumulation_fbo_);
+  f->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accumulation_texture_, 0);
+  f->glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
+}
+
+void ScopeGLWidget::Accumulate(int grid_width, int grid_height)
+{
+  QOpenGLExtraFunctions* f = context()->extraFunctions();
+
+  f->glBindFramebuffer(GL_FRAMEBUFFER, accumulation_fbo_);
+  f->glViewport(0, 0, accumulation_width_, accumulation_height_);
+
+  f->glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+  f->glClear(GL_COLOR_BUFFER_BIT);
+
+  // Every sample adds one to the texel it lands on
+  f->glEnable(GL_BLEND);
+  f->glBlendFunc(GL_ONE, GL_ONE);
+
+  f->glBindTexture(GL_TEXTURE_2D, texture_->texture());
+
+  scatter_shader_->bind();
+  scatter_shader_->setUniformValue("source", 0);
+  scatter_shader_->setUniformValue("type", static_cast<int>(type_));
+  scatter_shader_->setUniformValue("levels", static_cast<GLfloat>((type_ == kHistogram) ? kHistogramBins : kLevels));
+  f->glUniform2i(scatter_shader_->uniformLocation("grid"), grid_width, grid_height);
+
+  // The parade and histogram are drawn once per channel
+  int passes = (type_ == kParade || type_ == kHistogram) ? 3 : 1;
+
+  vao_.bind();
+
+  for (int i=0;i<passes;i++) {
+    scatter_shader_->setUniformValue("channel", i);
+    f->glDrawArrays(GL_POINTS, 0, grid_width * grid_height);
+  }
+
+  vao_.release();
+
+  scatter_shader_->release();
+
+  f->glBindTexture(GL_TEXTURE_2D, 0);
+
+  f->glDisable(GL_BLEND);
+}
+
+void ScopeGLWidget::DrawGraticule()
+{
+  QPainter p(this);
+
+  QRect plot = PlotRect();
+  QColor line_color(255, 255, 255, 64);
+  QColor label_color(255, 255, 255, 160);
+
+  p.setPen(line_color);
+
+  if (type_ == kVectorscope) {
+    QPointF center = QRectF(plot).center();
+    qreal radius = plot.width() * 0.5;
+
+    p.setRenderHint(QPainter::Antialiasing);
+    p.drawEllipse(center, radius, radius);
+    p.drawLine(QPointF(center.x() - radius, center.y()), QPointF(center.x() + radius, center.y()));
+    p.drawLine(QPointF(center.x(), center.y() - radius), QPointF(center.x(), center.y() + radius));
+
+    // Targets for 75% color bars
+    static const char* names[] = {"R", "Mg", "B", "Cy", "G", "Yl"};
+    static const float colors[][3] = {{1, 0, 0}, {1, 0, 1}, {0, 0, 1}, {0, 1, 1}, {0, 1, 0}, {1, 1, 0}};
+
+    for (int i=0;i<6;i++) {
+      float r = colors[i][0] * 0.75f;
+      float g = colors[i][1] * 0.75f;
+      float b = colors[i][2] * 0.75f;
+      float luma = 0.2126f * r + 0.7152f * g + 0.0722f * b;
+
+      QPointF target(center.x() + (b - luma) / 1.8556f * 2.0f * radius,
+                     center.y() - (r - luma) / 1.5748f * 2.0f * radius);
+
+      p.setPen(line_color);
+      p.drawRect(QRectF(target.x() - 4, target.y() - 4, 8, 8));
+
+      p.setPen(label_color);
+      p.drawText(target + QPointF(6, -6), QString::fromLatin1(names[i]));
+    }
+  } else if (type_ == kHistogram) {
+    for (int i=1;i<4;i++) {
+      qreal x = plot.left() + plot.width() * i / 4.0;
+      p.drawLine(QPointF(x, plot.top()), QPointF(x, plot.bottom()));
+    }
+  } else {
+    for (int i=0;i<=4;i++) {
+      qreal y = plot.bottom() - plot.height() * i / 4.0;
+      p.setPen(line_color);
+      p.drawLine(QPointF(plot.left(), y), QPointF(plot.right(), y));
+
+      // The top label goes under its line so it isn't cut off
+      qreal label_y = (i == 4) ? y + p.fontMetrics().ascent() + 2 : y - 2;
+
+      p.setPen(label_color);
+      p.drawText(QPointF(plot.left() + 2, label_y), QString::number(i * 25));
+    }
+
+    if (type_ == kParade) {
+      p.setPen(line_color);
+
+      for (int i=1;i<3;i++) {
+        qreal x = plot.left() + plot.width() * i / 3.0;
+        p.drawLine(QPointF(x, plot.top()), QPointF(x, plot.bottom()));
+      }
+    }
+  }
+}
+
+QRect ScopeGLWidget::PlotRect() const
+{
+  if (type_ == kVectorscope) {
+    int size = qMin(width(), height());
+    return QRect((width() - size) / 2, (height() - size) / 2, size, size);
+  }
+
+  return rect();
+}
+
+QString ScopeGLWidget::ShaderHeader() const
+{
+  // Samples are read with texelFetch() and positioned from gl_VertexID, neither of which GLSL 1.10 has
+  if (context()->isOpenGLES()) {
+    return QStringLiteral("#version 300 es\n"
+                          "precision highp int;\n"
+                          "precision highp float;\n"
+                          "\n");
+  }
+
+  return QStringLiteral("#version 150\n"
+                        "\n");
+}
+
+void ScopeGLWidget::ContextCleanup()
+{
+  if (context() == nullptr) {
+    return;
+  }
+
+  makeCurrent();
+
+  QOpenGLExtraFunctions* f = context()->extraFunctions();
+
+  if (accumulation_texture_ != 0) {
+    f->glDeleteTextures(1, &accumulation_texture_);
+    f->glDeleteFramebuffers(1, &accumulation_fbo_);
+    accumulation_texture_ = 0;
+    accumulation_fbo_ = 0;
+  }
+
+  vao_.destroy();
+
+  scatter_shader_ = nullptr;
+  display_shader_ = nullptr;
+
+  doneCurrent();
+}
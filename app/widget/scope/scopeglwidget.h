@@ -0,0 +1,144 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef SCOPEGLWIDGET_H
+#define SCOPEGLWIDGET_H
+
+#include <QOpenGLVertexArrayObject>
+#include <QOpenGLWidget>
+
+#include "render/backend/opengl/openglshader.h"
+#include "render/backend/opengl/opengltexture.h"
+
+/**
+ * @brief Draws a waveform, RGB parade, vectorscope or histogram of the texture a viewer is showing
+ *
+ * Everything happens on the GPU, straight from the viewer's texture (contexts are shared), so scopes keep up with
+ * playback at any resolution. The frame is sampled on a grid of at most kMaximumSamples across and every sample is
+ * drawn as a point with additive blending into a float accumulation texture at the spot the scope puts it (e.g. its
+ * column and luma for the waveform). The accumulation is then drawn to the widget with the counts mapped to
+ * brightness, or to bar heights for the histogram.
+ *
+ * Samples are of the texture's values as rendered (scene linear, before the display transform) clipped to 0-1.
+ */
+class ScopeGLWidget : public QOpenGLWidget
+{
+  Q_OBJECT
+public:
+  enum Type {
+    kWaveform,
+    kParade,
+    kVectorscope,
+    kHistogram
+  };
+
+  ScopeGLWidget(QWidget* parent = nullptr);
+
+  virtual ~ScopeGLWidget() override;
+
+  DISABLE_COPY_MOVE(ScopeGLWidget)
+
+  const Type& type() const;
+
+public slots:
+  /**
+   * @brief Set the texture to measure and redraw (nullptr to clear the scope)
+   *
+   * A reference is held so the renderer doesn't recycle it while the scope still needs it.
+   */
+  void SetTexture(OpenGLTexturePtr texture);
+
+  void SetType(int type);
+
+protected:
+  virtual void initializeGL() override;
+
+  virtual void paintGL() override;
+
+private:
+  /**
+   * @brief Make sure the accumulation texture is the size this type of scope needs
+   */
+  void SetupAccumulation(int width, int height);
+
+  /**
+   * @brief Scatter the texture's samples into the accumulation texture
+   */
+  void Accumulate(int grid_width, int grid_height);
+
+  /**
+   * @brief Draw lines and labels the scope is read against (e.g. 0-100% for the waveform)
+   */
+  void DrawGraticule();
+
+  /**
+   * @brief Where in the widget the scope is drawn, the vectorscope is kept square so its circle stays round
+   */
+  QRect PlotRect() const;
+
+  /**
+   * @brief Code that goes at the top of every shader for this context's GLSL version
+   */
+  QString ShaderHeader() const;
+
+  /**
+   * @brief Most samples taken across a frame, fewer for frames that are smaller
+   *
+   * Scopes are only a few hundred pixels wide, so more wouldn't show any more detail.
+   */
+  static const int kMaximumSamples = 512;
+
+  /**
+   * @brief Levels the waveform and parade sort samples into (their accumulation texture's height)
+   */
+  static const int kLevels = 256;
+
+  /**
+   * @brief Bins in the histogram
+   */
+  static const int kHistogramBins = 256;
+
+  OpenGLTexturePtr texture_;
+
+  Type type_;
+
+  OpenGLShaderPtr scatter_shader_;
+
+  OpenGLShaderPtr display_shader_;
+
+  /**
+   * @brief Every draw is attribute-less (positions come from gl_VertexID), but core profiles still need a VAO bound
+   */
+  QOpenGLVertexArrayObject vao_;
+
+  GLuint accumulation_fbo_;
+
+  GLuint accumulation_texture_;
+
+  int accumulation_width_;
+
+  int accumulation_height_;
+
+private slots:
+  void ContextCleanup();
+
+};
+
+#endif // SCOPEGLWIDGET_H
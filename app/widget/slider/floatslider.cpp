@@ -46,6 +46,16 @@ void FloatSlider::SetMaximum(const double &d)
   SetMaximumInternal(d);
 }
 
+void FloatSlider::ClearMinimum()
+{
+  ClearMinimumInternal();
+}
+
+void FloatSlider::ClearMaximum()
+{
+  ClearMaximumInternal();
+}
+
 void FloatSlider::SetDecimalPlaces(int i)
 {
   decimal_places_ = i;
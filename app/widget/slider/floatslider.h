@@ -37,6 +37,10 @@ public:
 
   void SetMaximum(const double& d);
 
+  void ClearMinimum();
+
+  void ClearMaximum();
+
   void SetDecimalPlaces(int i);
 
 signals:
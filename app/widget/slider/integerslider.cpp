@@ -46,6 +46,16 @@ void IntegerSlider::SetMaximum(const int &d)
   SetMaximumInternal(d);
 }
 
+void IntegerSlider::ClearMinimum()
+{
+  ClearMinimumInternal();
+}
+
+void IntegerSlider::ClearMaximum()
+{
+  ClearMaximumInternal();
+}
+
 void IntegerSlider::ConvertValue(QVariant v)
 {
   emit ValueChanged(v.toInt());
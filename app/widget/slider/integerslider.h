@@ -37,6 +37,10 @@ public:
 
   void SetMaximum(const int& d);
 
+  void ClearMinimum();
+
+  void ClearMaximum();
+
 signals:
   void ValueChanged(int);
 
@@ -104,6 +104,16 @@ void SliderBase::SetMaximumInternal(const QVariant &v)
   }
 }
 
+void SliderBase::ClearMinimumInternal()
+{
+  has_min_ = false;
+}
+
+void SliderBase::ClearMaximumInternal()
+{
+  has_max_ = false;
+}
+
 void SliderBase::changeEvent(QEvent *e)
 {
   if (e->type() == QEvent::LanguageChange) {
@@ -52,6 +52,10 @@ protected:
 
   void SetMaximumInternal(const QVariant& v);
 
+  void ClearMinimumInternal();
+
+  void ClearMaximumInternal();
+
   void UpdateLabel(const QVariant& v);
 
   virtual void changeEvent(QEvent* e) override;
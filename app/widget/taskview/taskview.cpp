@@ -20,33 +20,37 @@
 
 #include "taskview.h"
 
-#include <QPushButton>
-
 TaskView::TaskView(QWidget* parent) :
-  QScrollArea(parent)
+  QListView(parent)
 {
-  // Allow scroll area to resize widget to fit
-  setWidgetResizable(true);
-
-  // Create central widget
-  central_widget_ = new QWidget(this);
-  setWidget(central_widget_);
+  setModel(&model_);
+  setItemDelegate(&delegate_);
 
-  // Create layout for central widget
-  layout_ = new QVBoxLayout(central_widget_);
-  layout_->setSpacing(0);
-  layout_->setMargin(0);
+  // Rows are all the same height, which saves measuring every one of them to lay them out
+  setUniformItemSizes(true);
+  setSelectionMode(QAbstractItemView::NoSelection);
+  setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
 
-  // Add a "stretch" so that TaskViewItems don't try to expand all the way to the bottom
-  layout_->addStretch();
+  refresh_timer_.setInterval(kRefreshInterval);
+  connect(&refresh_timer_, SIGNAL(timeout()), &model_, SLOT(RefreshProgress()));
 }
 
 void TaskView::AddTask(Task *t)
 {
-  // Create TaskViewItem (UI representation of a Task) and connect it
-  TaskViewItem* item = new TaskViewItem(central_widget_);
+  model_.AddTask(t);
+}
+
+void TaskView::showEvent(QShowEvent *e)
+{
+  model_.RefreshProgress();
+  refresh_timer_.start();
+
+  QListView::showEvent(e);
+}
 
-  item->SetTask(t);
+void TaskView::hideEvent(QHideEvent *e)
+{
+  refresh_timer_.stop();
 
-  layout_->insertWidget(0, item);
+  QListView::hideEvent(e);
 }
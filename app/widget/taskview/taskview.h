@@ -21,25 +21,33 @@
 #ifndef TASKVIEW_H
 #define TASKVIEW_H
 
-#include <QScrollArea>
-#include <QVBoxLayout>
+#include <QListView>
+#include <QTimer>
 
-#include "widget/taskview/taskviewitem.h"
+#include "widget/taskview/taskviewitemdelegate.h"
+#include "widget/taskview/taskviewmodel.h"
 
 /**
  * @brief A widget that shows a list of Tasks
  *
- * TaskView is a fairly simple widget for showing TaskViewItem widgets that each represent a Task object. The main
- * entry point is the slot AddTask() which should be connected to a TaskManager's TaskAdded() signal. No more connecting
- * is necessary since TaskViewItem will automatically delete itself (thus removing itself from the TaskView) when the
- * Task finishes.
+ * The main entry point is the slot AddTask() which should be connected to a TaskManager's TaskAdded() signal. No more
+ * connecting is necessary since Tasks are removed from the list by themselves when they're removed from TaskManager.
+ *
+ * Each Task is a row of a TaskViewModel drawn by TaskViewItemDelegate rather than a widget, so only the visible rows
+ * cost anything however many Tasks are queued. Progress is read every kRefreshInterval while the view is shown,
+ * however often Tasks report it.
  */
-class TaskView : public QScrollArea
+class TaskView : public QListView
 {
   Q_OBJECT
 public:
   TaskView(QWidget* parent);
 
+  /**
+   * @brief Milliseconds between progress updates
+   */
+  static const int kRefreshInterval = 33;
+
 public slots:
   /**
    * @brief Creates a TaskViewItem, connects it to a Task, and adds it to this widget
@@ -48,9 +56,18 @@ public slots:
    */
   void AddTask(Task* t);
 
+protected:
+  virtual void showEvent(QShowEvent* e) override;
+
+  virtual void hideEvent(QHideEvent* e) override;
+
 private:
-  QWidget* central_widget_;
-  QVBoxLayout* layout_;
+  TaskViewModel model_;
+
+  TaskViewItemDelegate delegate_;
+
+  QTimer refresh_timer_;
+
 };
 
 #endif // TASKVIEW_H
@@ -22,6 +22,8 @@
 
 #include <QVBoxLayout>
 
+#include "taskview.h"
+#include "taskviewmodel.h"
 #include "ui/icons/icons.h"
 
 TaskViewItem::TaskViewItem(QWidget *parent) :
@@ -55,6 +57,9 @@ TaskViewItem::TaskViewItem(QWidget *parent) :
   // Create status label
   task_status_lbl_ = new QLabel(this);
   layout->addWidget(task_status_lbl_);
+
+  refresh_timer_.setInterval(TaskView::kRefreshInterval);
+  connect(&refresh_timer_, SIGNAL(timeout()), this, SLOT(RefreshProgress()));
 }
 
 void TaskViewItem::SetTask(Task *t)
@@ -62,8 +67,8 @@ void TaskViewItem::SetTask(Task *t)
   // Check if we already have a task and disconnect from it if so
   if (task_ != nullptr) {
     disconnect(task_, SIGNAL(StatusChanged(Task::Status)), this, SLOT(TaskStatusChange(Task::Status)));
-    disconnect(task_, SIGNAL(ProgressChanged(int)), progress_bar_, SLOT(setValue(int)));
-    disconnect(task_, SIGNAL(destroyed()), this, SLOT(deleteLater()));
+    disconnect(task_, SIGNAL(Removed()), this, SLOT(deleteLater()));
+    disconnect(cancel_btn_, SIGNAL(clicked(bool)), task_, SLOT(Cancel()));
   }
 
   // Set task
@@ -74,35 +79,37 @@ void TaskViewItem::SetTask(Task *t)
 
   // Connect to the task
   connect(task_, SIGNAL(StatusChanged(Task::Status)), this, SLOT(TaskStatusChange(Task::Status)));
-  connect(task_, SIGNAL(ProgressChanged(int)), progress_bar_, SLOT(setValue(int)));
   connect(task_, SIGNAL(Removed()), this, SLOT(deleteLater()));
   connect(cancel_btn_, SIGNAL(clicked(bool)), task_, SLOT(Cancel()));
+
+  refresh_timer_.start();
 }
 
 void TaskViewItem::TaskStatusChange(Task::Status status)
 {
+  task_status_lbl_->setText(TaskViewModel::StatusText(task_));
+
   switch (status) {
   case Task::kWaiting:
-    task_status_lbl_->setText(tr("Waiting..."));
-    progress_bar_->setValue(0);
-    cancel_btn_->setEnabled(true);
-    break;
   case Task::kWorking:
-    task_status_lbl_->setText(tr("Working..."));
     progress_bar_->setValue(0);
     cancel_btn_->setEnabled(true);
     break;
   case Task::kFinished:
-    task_status_lbl_->setText(tr("Done"));
     progress_bar_->setValue(100);
     cancel_btn_->setEnabled(false);
     break;
   case Task::kError:
-    task_status_lbl_->setText(
-        tr("Error: %1").arg(static_cast<Task*>(sender())->error())
-    );
     progress_bar_->setValue(0);
     cancel_btn_->setEnabled(false);
     break;
   }
 }
+
+void TaskViewItem::RefreshProgress()
+{
+  if (task_ != nullptr && task_->status() == Task::kWorking) {
+    progress_bar_->setValue(task_->progress());
+    task_status_lbl_->setText(TaskViewModel::StatusText(task_));
+  }
+}
@@ -24,6 +24,7 @@
 #include <QLabel>
 #include <QProgressBar>
 #include <QPushButton>
+#include <QTimer>
 #include <QWidget>
 
 #include "task/task.h"
@@ -31,10 +32,12 @@
 /**
  * @brief A widget that visually represents the status of a Task
  *
- * The TaskViewItem widget shows a description of the Task (Task::text(), a progress bar (updated by
- * Task::ProgressChanged), the Task's status (text generated from Task::status() or Task::error()), and provides
+ * The TaskViewItem widget shows a description of the Task (Task::text(), a progress bar (Task::progress(), read every
+ * TaskView::kRefreshInterval), the Task's status (text generated from Task::status() or Task::error()), and provides
  * a cancel button (triggering Task::Cancel()) for cancelling a Task before it finishes.
  *
+ * Meant for showing a single Task (e.g. in a dialog), TaskView shows lists of them without a widget for each.
+ *
  * The main entry point is SetTask() after a Task and TaskViewItem objects are created.
  */
 class TaskViewItem : public QFrame
@@ -60,9 +63,13 @@ private:
 
   Task* task_;
 
+  QTimer refresh_timer_;
+
 private slots:
   void TaskStatusChange(Task::Status status);
 
+  void RefreshProgress();
+
 };
 
 #endif // TASKVIEWITEM_H
@@ -0,0 +1,133 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "taskviewitemdelegate.h"
+
+#include <QApplication>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QStyleOption>
+
+#include "taskviewmodel.h"
+#include "ui/icons/icons.h"
+
+TaskViewItemDelegate::TaskViewItemDelegate(QObject *parent) :
+  QStyledItemDelegate(parent)
+{
+}
+
+QSize TaskViewItemDelegate::sizeHint(const QStyleOptionViewItem &option, const QModelIndex &) const
+{
+  // Every row is the same height, so views can lay out thousands of them without measuring each
+  return QSize(option.rect.width(), kPadding * 4 + option.fontMetrics.height() * 2 + kButtonSize);
+}
+
+void TaskViewItemDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+  QStyle* style = option.widget ? option.widget->style() : QApplication::style();
+
+  QRect title_rect, progress_rect, cancel_rect, status_rect;
+  Layout(option.rect, option.fontMetrics, &title_rect, &progress_rect, &cancel_rect, &status_rect);
+
+  painter->save();
+
+  // Separate each row from the next like the frame around a TaskViewItem
+  painter->setPen(option.palette.mid().color());
+  painter->drawLine(option.rect.bottomLeft(), option.rect.bottomRight());
+
+  QFont bold = option.font;
+  bold.setBold(true);
+
+  painter->setPen(option.palette.text().color());
+  painter->setFont(bold);
+  painter->drawText(title_rect, Qt::AlignLeft | Qt::AlignVCenter,
+                    QFontMetrics(bold).elidedText(index.data(Qt::DisplayRole).toString(),
+                                                  Qt::ElideRight,
+                                                  title_rect.width()));
+
+  painter->setFont(option.font);
+  painter->drawText(status_rect, Qt::AlignLeft | Qt::AlignVCenter,
+                    option.fontMetrics.elidedText(index.data(TaskViewModel::kStatusRole).toString(),
+                                                  Qt::ElideRight,
+                                                  status_rect.width()));
+
+  painter->restore();
+
+  QStyleOptionProgressBar progress;
+  progress.rect = progress_rect;
+  progress.palette = option.palette;
+  progress.state = option.state | QStyle::State_Horizontal;
+  progress.minimum = 0;
+  progress.maximum = 100;
+  progress.progress = index.data(TaskViewModel::kProgressRole).toInt();
+  progress.textVisible = true;
+  progress.text = QStringLiteral("%1%").arg(progress.progress);
+  style->drawControl(QStyle::CE_ProgressBar, &progress, painter, option.widget);
+
+  QStyleOptionButton cancel;
+  cancel.rect = cancel_rect;
+  cancel.palette = option.palette;
+  cancel.icon = olive::icon::Error;
+  cancel.iconSize = QSize(kButtonSize / 2, kButtonSize / 2);
+  cancel.state = QStyle::State_Raised;
+
+  if (index.data(TaskViewModel::kCancellableRole).toBool()) {
+    cancel.state |= QStyle::State_Enabled;
+  }
+
+  style->drawControl(QStyle::CE_PushButton, &cancel, painter, option.widget);
+}
+
+bool TaskViewItemDelegate::editorEvent(QEvent *event, QAbstractItemModel *model, const QStyleOptionViewItem &option,
+                                       const QModelIndex &index)
+{
+  if (event->type() == QEvent::MouseButtonRelease) {
+    QMouseEvent* mouse_event = static_cast<QMouseEvent*>(event);
+    TaskViewModel* task_model = qobject_cast<TaskViewModel*>(model);
+
+    QRect title_rect, progress_rect, cancel_rect, status_rect;
+    Layout(option.rect, option.fontMetrics, &title_rect, &progress_rect, &cancel_rect, &status_rect);
+
+    if (task_model
+        && mouse_event->button() == Qt::LeftButton
+        && cancel_rect.contains(mouse_event->pos())
+        && index.data(TaskViewModel::kCancellableRole).toBool()) {
+      task_model->CancelTask(index);
+      return true;
+    }
+  }
+
+  return QStyledItemDelegate::editorEvent(event, model, option, index);
+}
+
+void TaskViewItemDelegate::Layout(const QRect &rect, const QFontMetrics &fm, QRect *title, QRect *progress,
+                                  QRect *cancel, QRect *status) const
+{
+  QRect inner = rect.adjusted(kPadding, kPadding, -kPadding, -kPadding);
+
+  *title = QRect(inner.left(), inner.top(), inner.width(), fm.height());
+
+  int middle = title->bottom() + 1 + kPadding;
+
+  *cancel = QRect(inner.right() + 1 - kButtonSize, middle, kButtonSize, kButtonSize);
+  *progress = QRect(inner.left(), middle, inner.width() - kButtonSize - kPadding, kButtonSize);
+
+  *status = QRect(inner.left(), cancel->bottom() + 1 + kPadding, inner.width(), fm.height());
+}
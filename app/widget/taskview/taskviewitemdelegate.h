@@ -0,0 +1,61 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef TASKVIEWITEMDELEGATE_H
+#define TASKVIEWITEMDELEGATE_H
+
+#include <QStyledItemDelegate>
+
+/**
+ * @brief Draws a row of TaskViewModel the way TaskViewItem lays out a Task, with a working cancel button
+ *
+ * Nothing is created per Task, so a view can list any number of them and only pays for the rows that are visible.
+ */
+class TaskViewItemDelegate : public QStyledItemDelegate
+{
+  Q_OBJECT
+public:
+  TaskViewItemDelegate(QObject* parent = nullptr);
+
+  virtual QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+
+  virtual void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+
+protected:
+  /**
+   * @brief Cancels the row's Task when its cancel button is clicked
+   */
+  virtual bool editorEvent(QEvent *event, QAbstractItemModel *model, const QStyleOptionViewItem &option,
+                           const QModelIndex &index) override;
+
+private:
+  /**
+   * @brief Where each part of a row goes within `rect`
+   */
+  void Layout(const QRect& rect, const QFontMetrics& fm, QRect* title, QRect* progress, QRect* cancel,
+              QRect* status) const;
+
+  static const int kPadding = 6;
+
+  static const int kButtonSize = 24;
+
+};
+
+#endif // TASKVIEWITEMDELEGATE_H
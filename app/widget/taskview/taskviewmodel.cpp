@@ -0,0 +1,200 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "taskviewmodel.h"
+
+#include <QStringList>
+
+TaskViewModel::TaskViewModel(QObject *parent) :
+  QAbstractListModel(parent)
+{
+}
+
+int TaskViewModel::rowCount(const QModelIndex &parent) const
+{
+  if (parent.isValid()) {
+    return 0;
+  }
+
+  return tasks_.size();
+}
+
+QVariant TaskViewModel::data(const QModelIndex &index, int role) const
+{
+  if (!index.isValid() || index.row() >= tasks_.size()) {
+    return QVariant();
+  }
+
+  Task* t = TaskAt(index.row());
+
+  switch (role) {
+  case Qt::DisplayRole:
+    return t->text();
+  case kProgressRole:
+    switch (t->status()) {
+    case Task::kWorking:
+      return progress_.at(tasks_.size() - 1 - index.row());
+    case Task::kFinished:
+      return 100;
+    case Task::kWaiting:
+    case Task::kError:
+      break;
+    }
+    return 0;
+  case kStatusRole:
+    return StatusText(t);
+  case kCancellableRole:
+    return (t->status() == Task::kWaiting || t->status() == Task::kWorking);
+  }
+
+  return QVariant();
+}
+
+void TaskViewModel::AddTask(Task *t)
+{
+  beginInsertRows(QModelIndex(), 0, 0);
+
+  tasks_.append(t);
+  progress_.append(t->progress());
+
+  endInsertRows();
+
+  connect(t, SIGNAL(StatusChanged(Task::Status)), this, SLOT(TaskStatusChanged()));
+  connect(t, SIGNAL(Removed()), this, SLOT(TaskRemoved()));
+  connect(t, SIGNAL(destroyed()), this, SLOT(TaskRemoved()));
+}
+
+void TaskViewModel::CancelTask(const QModelIndex &index)
+{
+  if (index.isValid() && index.row() < tasks_.size()) {
+    TaskAt(index.row())->Cancel();
+  }
+}
+
+QString TaskViewModel::StatusText(Task *t)
+{
+  switch (t->status()) {
+  case Task::kWaiting:
+    return tr("Waiting...");
+  case Task::kWorking:
+  {
+    QStringList parts;
+
+    qint64 remaining = t->remaining_time();
+
+    if (remaining >= 0) {
+      qint64 seconds = remaining / 1000;
+
+      parts.append(tr("%1:%2 remaining").arg(seconds / 60).arg(seconds % 60, 2, 10, QChar('0')));
+    }
+
+    QString detail = t->detail();
+
+    if (!detail.isEmpty()) {
+      parts.append(detail);
+    }
+
+    if (parts.isEmpty()) {
+      return tr("Working...");
+    }
+
+    return tr("Working... (%1)").arg(parts.join(QStringLiteral(", ")));
+  }
+  case Task::kFinished:
+    return tr("Done");
+  case Task::kError:
+    return tr("Error: %1").arg(t->error());
+  }
+
+  return QString();
+}
+
+void TaskViewModel::RefreshProgress()
+{
+  int oldest_changed = -1;
+  int newest_changed = -1;
+
+  for (int i=0;i<tasks_.size();i++) {
+    int p = tasks_.at(i)->progress();
+
+    if (p != progress_.at(i)) {
+      progress_[i] = p;
+
+      if (oldest_changed == -1) {
+        oldest_changed = i;
+      }
+
+      newest_changed = i;
+    }
+  }
+
+  // One signal for the lot, so the view repaints once however many Tasks made progress. The newest is the top row.
+  // The status goes with it since the time remaining is worked out from the progress.
+  if (oldest_changed >= 0) {
+    emit dataChanged(index(tasks_.size() - 1 - newest_changed),
+                     index(tasks_.size() - 1 - oldest_changed),
+                     {kProgressRole, kStatusRole});
+  }
+}
+
+Task *TaskViewModel::TaskAt(int row) const
+{
+  return tasks_.at(tasks_.size() - 1 - row);
+}
+
+int TaskViewModel::RowOf(Task *t) const
+{
+  int i = tasks_.lastIndexOf(t);
+
+  if (i == -1) {
+    return -1;
+  }
+
+  return tasks_.size() - 1 - i;
+}
+
+void TaskViewModel::TaskStatusChanged()
+{
+  int row = RowOf(static_cast<Task*>(sender()));
+
+  if (row >= 0) {
+    emit dataChanged(index(row), index(row));
+  }
+}
+
+void TaskViewModel::TaskRemoved()
+{
+  // Only compared, since this is also called while the Task is being destroyed
+  int row = RowOf(static_cast<Task*>(sender()));
+
+  if (row == -1) {
+    return;
+  }
+
+  beginRemoveRows(QModelIndex(), row, row);
+
+  int i = tasks_.size() - 1 - row;
+  tasks_.remove(i);
+  progress_.remove(i);
+
+  endRemoveRows();
+
+  disconnect(sender(), nullptr, this, nullptr);
+}
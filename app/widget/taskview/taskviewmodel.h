@@ -0,0 +1,93 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef TASKVIEWMODEL_H
+#define TASKVIEWMODEL_H
+
+#include <QAbstractListModel>
+#include <QVector>
+
+#include "task/task.h"
+
+/**
+ * @brief A list of Tasks for TaskView, newest first
+ *
+ * Rows are removed by themselves when their Task is removed from TaskManager. Progress isn't signalled by Tasks (see
+ * Task::progress()), so the view calls RefreshProgress() on a timer, which only signals the rows that changed.
+ */
+class TaskViewModel : public QAbstractListModel
+{
+  Q_OBJECT
+public:
+  enum Role {
+    /// Task::progress()
+    kProgressRole = Qt::UserRole,
+
+    /// Text describing Task::status() (see StatusText())
+    kStatusRole,
+
+    /// Whether the Task can still be cancelled
+    kCancellableRole
+  };
+
+  TaskViewModel(QObject* parent = nullptr);
+
+  virtual int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+
+  virtual QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+  void AddTask(Task* t);
+
+  void CancelTask(const QModelIndex& index);
+
+  /**
+   * @brief Text describing what a Task is doing, e.g. "Working..." with the time remaining, or its error
+   */
+  static QString StatusText(Task* t);
+
+public slots:
+  /**
+   * @brief Read every Task's progress and signal the rows whose progress has changed since the last time
+   */
+  void RefreshProgress();
+
+private:
+  Task* TaskAt(int row) const;
+
+  int RowOf(Task* t) const;
+
+  /**
+   * @brief Tasks in the order they were added, so rows are in reverse and adding a Task doesn't move the others
+   */
+  QVector<Task*> tasks_;
+
+  /**
+   * @brief The progress of each Task (same indices as tasks_) last time it was read
+   */
+  QVector<int> progress_;
+
+private slots:
+  void TaskStatusChanged();
+
+  void TaskRemoved();
+
+};
+
+#endif // TASKVIEWMODEL_H
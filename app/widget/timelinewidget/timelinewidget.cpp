@@ -1,19 +1,31 @@
 #include "timelinewidget.h"
 
+#include <float.h>
+#include <QClipboard>
+#include <QDataStream>
+#include <QDebug>
+#include <QGuiApplication>
+#include <QMimeData>
 #include <QSplitter>
 #include <QVBoxLayout>
 #include <QtMath>
 
 #include "core.h"
 #include "common/timecodefunctions.h"
+#include "project/item/sequence/sequence.h"
+#include "project/projectserializer.h"
+#include "task/prerender/prerender.h"
 #include "tool/tool.h"
 
 TimelineWidget::TimelineWidget(QWidget *parent) :
   QWidget(parent),
   rubberband_(QRubberBand::Rectangle, this),
   hand_drag_view_(nullptr),
+  visible_blocks_update_queued_(false),
   timeline_node_(nullptr),
-  playhead_(0)
+  playhead_(0),
+  in_point_(0),
+  out_point_(RATIONAL_MAX)
 {
   QVBoxLayout* layout = new QVBoxLayout(this);
   layout->setSpacing(0);
@@ -68,6 +80,7 @@ TimelineWidget::TimelineWidget(QWidget *parent) :
     view_splitter->addWidget(view);
 
     connect(view->horizontalScrollBar(), SIGNAL(valueChanged(int)), ruler_, SLOT(SetScroll(int)));
+    connect(view->horizontalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(QueueVisibleBlocksUpdate()));
     connect(view, SIGNAL(ScaleChanged(double)), this, SLOT(SetScale(double)));
     connect(ruler_, SIGNAL(TimeChanged(const int64_t&)), view, SLOT(SetTime(const int64_t&)));
     connect(view, SIGNAL(TimeChanged(const int64_t&)), ruler_, SLOT(SetTime(const int64_t&)));
@@ -99,21 +112,35 @@ TimelineWidget::TimelineWidget(QWidget *parent) :
   SetScale(90.0);
 }
 
+TimelineWidget::~TimelineWidget()
+{
+  // Items in a scene are deleted with it, but recycled ones aren't in any
+  qDeleteAll(free_block_items_);
+}
+
 void TimelineWidget::Clear()
 {
   SetTimebase(0);
 
-  QMapIterator<Block*, TimelineViewBlockItem*> iterator(block_items_);
+  foreach (TimelineViewBlockItem* item, block_items_) {
+    ReleaseBlockItem(item);
+  }
 
-  while (iterator.hasNext()) {
-    iterator.next();
+  block_items_.clear();
+  block_tracks_.clear();
+  selected_blocks_.clear();
+  changed_blocks_.clear();
+  rubberband_now_selected_.clear();
 
-    if (iterator.value() != nullptr) {
-      delete iterator.value();
-    }
+  foreach (TimelineView* view, views_) {
+    view->SetTrackCount(0);
   }
 
-  block_items_.clear();
+  ruler_->ClearFrameStatus();
+
+  in_point_ = 0;
+  out_point_ = RATIONAL_MAX;
+  ruler_->ClearInOut();
 }
 
 void TimelineWidget::SetTimebase(const rational &timebase)
@@ -125,6 +152,8 @@ void TimelineWidget::SetTimebase(const rational &timebase)
   foreach (TimelineView* view, views_) {
     view->SetTimebase(timebase);
   }
+
+  UpdateInOut();
 }
 
 void TimelineWidget::resizeEvent(QResizeEvent *event)
@@ -132,6 +161,8 @@ void TimelineWidget::resizeEvent(QResizeEvent *event)
   QWidget::resizeEvent(event);
 
   horizontal_scroll_->setPageStep(horizontal_scroll_->width());
+
+  QueueVisibleBlocksUpdate();
 }
 
 void TimelineWidget::SetTime(const int64_t &timestamp)
@@ -145,6 +176,11 @@ void TimelineWidget::SetTime(const int64_t &timestamp)
   UpdateInternalTime(timestamp);
 }
 
+void TimelineWidget::SetFrameStatus(const FrameStatusSpans &spans)
+{
+  ruler_->SetFrameStatus(spans);
+}
+
 void TimelineWidget::ConnectTimelineNode(TimelineOutput *node)
 {
   if (timeline_node_ != nullptr) {
@@ -155,6 +191,12 @@ void TimelineWidget::ConnectTimelineNode(TimelineOutput *node)
     disconnect(timeline_node_, SIGNAL(TrackRemoved(TrackOutput*)), this, SLOT(RemoveTrack(TrackOutput*)));
     disconnect(timeline_node_, SIGNAL(TimebaseChanged(const rational&)), this, SLOT(SetTimebase(const rational&)));
 
+    for (int i=0;i<views_.size();i++) {
+      foreach (TrackOutput* track, timeline_node_->track_list(static_cast<TrackType>(i))->Tracks()) {
+        disconnect(track, SIGNAL(BlocksMoved(const rational&)), this, SLOT(TrackBlocksMoved(const rational&)));
+      }
+    }
+
     SetTimebase(0);
 
     Clear();
@@ -184,6 +226,8 @@ void TimelineWidget::ConnectTimelineNode(TimelineOutput *node)
         AddTrack(track, track_type);
       }
     }
+
+    QueueVisibleBlocksUpdate();
   }
 }
 
@@ -204,15 +248,30 @@ void TimelineWidget::ZoomOut()
 
 void TimelineWidget::SelectAll()
 {
-  foreach (TimelineView* view, views_) {
-    view->SelectAll();
+  QHash<Block*, TrackReference>::const_iterator iterator;
+
+  selected_blocks_.reserve(block_tracks_.size());
+
+  for (iterator=block_tracks_.constBegin();iterator!=block_tracks_.constEnd();iterator++) {
+    if (iterator.key()->type() == Block::kClip) {
+      selected_blocks_.insert(iterator.key());
+    }
+  }
+
+  // Only the blocks that have an item need to show it
+  foreach (TimelineViewBlockItem* item, block_items_) {
+    if (item->block()->type() == Block::kClip) {
+      item->setSelected(true);
+    }
   }
 }
 
 void TimelineWidget::DeselectAll()
 {
-  foreach (TimelineView* view, views_) {
-    view->DeselectAll();
+  selected_blocks_.clear();
+
+  foreach (TimelineViewBlockItem* item, block_items_) {
+    item->setSelected(false);
   }
 }
 
@@ -303,8 +362,6 @@ void TimelineWidget::SplitAtPlayhead()
 {
   rational playhead_time = olive::timestamp_to_time(playhead_, timebase());
 
-  QList<TimelineViewBlockItem *> selected_blocks = GetSelectedBlocks();
-
   // Prioritize blocks that are selected and overlap the playhead
   QVector<Block*> blocks_to_split;
   QVector<bool> block_is_selected;
@@ -316,15 +373,11 @@ void TimelineWidget::SplitAtPlayhead()
     Block* b = track->BlockContainingTime(playhead_time);
 
     if (b) {
-      bool selected = false;
-
       // See if this block is selected
-      foreach (TimelineViewBlockItem* item, selected_blocks) {
-        if (item->block() == b) {
-          some_blocks_are_selected = true;
-          selected = true;
-          break;
-        }
+      bool selected = IsBlockSelected(b);
+
+      if (selected) {
+        some_blocks_are_selected = true;
       }
 
       blocks_to_split.append(b);
@@ -348,23 +401,266 @@ void TimelineWidget::SplitAtPlayhead()
   }
 }
 
-QList<TimelineViewBlockItem *> TimelineWidget::GetSelectedBlocks()
+QList<Block *> TimelineWidget::GetSelectedBlocks()
 {
-  QList<TimelineViewBlockItem *> list;
+  return selected_blocks_.toList();
+}
 
-  QMapIterator<Block*, TimelineViewBlockItem*> iterator(block_items_);
+void TimelineWidget::CopySelected()
+{
+  QByteArray data = SerializeSelectedClips(nullptr);
 
-  while (iterator.hasNext()) {
-    iterator.next();
+  if (data.isEmpty()) {
+    return;
+  }
+
+  QMimeData* mime_data = new QMimeData();
+  mime_data->setData("application/x-olivetimelinedata", data);
+
+  QGuiApplication::clipboard()->setMimeData(mime_data);
+}
+
+void TimelineWidget::Paste()
+{
+  const QMimeData* mime_data = QGuiApplication::clipboard()->mimeData();
+
+  if (mime_data == nullptr || !mime_data->hasFormat("application/x-olivetimelinedata")) {
+    return;
+  }
+
+  PasteClips(mime_data->data("application/x-olivetimelinedata"), olive::timestamp_to_time(playhead_, timebase()));
+}
+
+void TimelineWidget::DuplicateSelected()
+{
+  rational selection_out;
+  QByteArray data = SerializeSelectedClips(&selection_out);
+
+  if (!data.isEmpty()) {
+    PasteClips(data, selection_out);
+  }
+}
+
+void TimelineWidget::SetInPoint()
+{
+  if (timeline_node_ == nullptr) {
+    return;
+  }
+
+  in_point_ = olive::timestamp_to_time(playhead_, timebase());
+
+  if (out_point_ <= in_point_) {
+    out_point_ = RATIONAL_MAX;
+  }
+
+  UpdateInOut();
+}
+
+void TimelineWidget::SetOutPoint()
+{
+  if (timeline_node_ == nullptr) {
+    return;
+  }
+
+  // The frame under the playhead is included
+  out_point_ = olive::timestamp_to_time(playhead_ + 1, timebase());
+
+  if (in_point_ >= out_point_) {
+    in_point_ = 0;
+  }
 
-    TimelineViewBlockItem* item = iterator.value();
+  UpdateInOut();
+}
+
+void TimelineWidget::ResetInPoint()
+{
+  in_point_ = 0;
+
+  UpdateInOut();
+}
+
+void TimelineWidget::ResetOutPoint()
+{
+  out_point_ = RATIONAL_MAX;
+
+  UpdateInOut();
+}
+
+void TimelineWidget::ClearInOutPoints()
+{
+  in_point_ = 0;
+  out_point_ = RATIONAL_MAX;
+
+  UpdateInOut();
+}
+
+void TimelineWidget::PreRenderInOut()
+{
+  if (timeline_node_ == nullptr) {
+    return;
+  }
+
+  // Sequences don't have a meta-object of their own, so they're found through the graph the timeline belongs to
+  Sequence* sequence = dynamic_cast<Sequence*>(timeline_node_->parent());
+
+  rational out = qMin(out_point_, timeline_node_->timeline_length());
 
-    if (item != nullptr && item->isSelected()) {
-      list.append(item);
+  if (sequence == nullptr || out <= in_point_) {
+    return;
+  }
+
+  PreRenderTask::Queue(sequence, in_point_, out);
+}
+
+void TimelineWidget::UpdateInOut()
+{
+  if (timebase().isNull() || (in_point_ == 0 && out_point_ == RATIONAL_MAX)) {
+    ruler_->ClearInOut();
+  } else {
+    ruler_->SetInOut(olive::time_to_timestamp(in_point_, timebase()), olive::time_to_timestamp(out_point_, timebase()));
+  }
+}
+
+QByteArray TimelineWidget::SerializeSelectedClips(rational *selection_out)
+{
+  if (timeline_node_ == nullptr) {
+    return QByteArray();
+  }
+
+  QList<Block*> clips;
+  rational selection_in = RATIONAL_MAX;
+  rational latest_out = 0;
+
+  foreach (Block* block, selected_blocks_) {
+    if (block->type() == Block::kClip) {
+      clips.append(block);
+
+      selection_in = qMin(selection_in, block->in());
+      latest_out = qMax(latest_out, block->out());
     }
   }
 
-  return list;
+  if (clips.isEmpty()) {
+    return QByteArray();
+  }
+
+  // Clips come first so the record's first nodes line up with the placements written before it
+  QList<Node*> nodes;
+  QSet<Node*> added;
+
+  foreach (Block* clip, clips) {
+    nodes.append(clip);
+    added.insert(clip);
+  }
+
+  QObject* graph = timeline_node_->parent();
+
+  foreach (Block* clip, clips) {
+    QList<Node*> dependencies = clip->GetDependencies();
+
+    foreach (Node* dep, dependencies) {
+      // Nodes of another graph (e.g. a nested sequence's) aren't copied, so whatever connects to them pastes unconnected
+      if (dep->parent() == graph && !added.contains(dep)) {
+        nodes.append(dep);
+        added.insert(dep);
+      }
+    }
+  }
+
+  QByteArray data;
+
+  QDataStream ds(&data, QIODevice::WriteOnly);
+  ds.setVersion(QDataStream::Qt_5_0);
+
+  ds << static_cast<quint32>(clips.size());
+
+  foreach (Block* clip, clips) {
+    TrackReference track = block_tracks_.value(clip);
+    rational offset = clip->in() - selection_in;
+
+    ds << static_cast<qint32>(track.type())
+       << static_cast<qint32>(track.index())
+       << static_cast<qint64>(offset.numerator())
+       << static_cast<qint64>(offset.denominator());
+  }
+
+  ds << ProjectSerializer::SerializeNodes(nodes);
+
+  if (selection_out != nullptr) {
+    *selection_out = latest_out;
+  }
+
+  return data;
+}
+
+void TimelineWidget::PasteClips(const QByteArray &data, const rational &time)
+{
+  if (timeline_node_ == nullptr) {
+    return;
+  }
+
+  QDataStream ds(data);
+  ds.setVersion(QDataStream::Qt_5_0);
+
+  quint32 clip_count;
+  ds >> clip_count;
+
+  QVector<TrackReference> tracks;
+  QVector<rational> offsets;
+
+  for (quint32 i=0;i<clip_count && ds.status() == QDataStream::Ok;i++) {
+    qint32 type, index;
+    qint64 offset_num, offset_den;
+
+    ds >> type >> index >> offset_num >> offset_den;
+
+    if (type < 0 || type >= kTrackTypeCount || index < 0 || offset_den == 0) {
+      qWarning() << "Invalid clip placement in pasted data";
+      return;
+    }
+
+    tracks.append(TrackReference(static_cast<TrackType>(type), index));
+    offsets.append(rational(offset_num, offset_den));
+  }
+
+  QByteArray node_data;
+  ds >> node_data;
+
+  Project* project = olive::core.GetActiveProject();
+  QVector<Node*> nodes;
+
+  if (ds.status() != QDataStream::Ok
+      || !ProjectSerializer::DeserializeNodes(node_data, project ? project->root() : nullptr, &nodes)) {
+    qWarning() << "Failed to read pasted clips";
+    return;
+  }
+
+  // Every placement must have its clip
+  bool valid = (nodes.size() >= tracks.size());
+
+  for (int i=0;i<tracks.size() && valid;i++) {
+    valid = (nodes.at(i)->IsBlock() && static_cast<Block*>(nodes.at(i))->type() == Block::kClip);
+  }
+
+  if (!valid) {
+    qWarning() << "Failed to read pasted clips";
+    qDeleteAll(nodes);
+    return;
+  }
+
+  // The nodes aren't in any graph yet, placing each clip adds it and its dependencies to the sequence's graph and
+  // the views update once the whole command has been done
+  QUndoCommand* command = new QUndoCommand();
+
+  for (int i=0;i<tracks.size();i++) {
+    new TrackPlaceBlockCommand(timeline_node_->track_list(tracks.at(i).type()),
+                               tracks.at(i).index(),
+                               static_cast<Block*>(nodes.at(i)),
+                               time + offsets.at(i),
+                               command);
+  }
+
+  olive::undo_stack.pushIfHasChildren(command);
 }
 
 void TimelineWidget::RippleEditTo(olive::timeline::MovementMode mode, bool insert_gaps)
@@ -459,14 +755,8 @@ void TimelineWidget::SetScale(double scale)
 
   ruler_->SetScale(scale_);
 
-  QMapIterator<Block*, TimelineViewBlockItem*> iterator(block_items_);
-
-  while (iterator.hasNext()) {
-    iterator.next();
-
-    if (iterator.value() != nullptr) {
-      iterator.value()->SetScale(scale_);
-    }
+  foreach (TimelineViewBlockItem* item, block_items_) {
+    item->SetScale(scale_);
   }
 
   foreach (TimelineViewGhostItem* ghost, ghost_items_) {
@@ -476,6 +766,9 @@ void TimelineWidget::SetScale(double scale)
   foreach (TimelineView* view, views_) {
     view->SetScale(scale_);
   }
+
+  // The visible range of time has changed with the scale
+  QueueVisibleBlocksUpdate();
 }
 
 void TimelineWidget::ClearGhosts()
@@ -574,24 +867,13 @@ void TimelineWidget::AddBlock(Block *block, TrackReference track)
   switch (block->type()) {
   case Block::kClip:
   case Block::kGap:
-  {
-    TimelineViewBlockItem* item = new TimelineViewBlockItem();
-
-    // Set up clip with view parameters (clip item will automatically size its rect accordingly)
-    item->SetBlock(block);
-    item->SetYCoords(GetTrackY(track), GetTrackHeight(track));
-    item->SetScale(scale_);
-    item->SetTrack(track);
-
-    // Add to list of clip items that can be iterated through
-    block_items_.insert(block, item);
-
-    // Add item to graphics scene
-    views_.at(track.type())->scene()->addItem(item);
+    // The item itself is only created if the block turns out to be visible
+    block_tracks_.insert(block, track);
 
     connect(block, SIGNAL(Refreshed()), this, SLOT(BlockChanged()));
+
+    QueueVisibleBlocksUpdate();
     break;
-  }
   case Block::kTrack:
     // Do nothing
     break;
@@ -600,9 +882,14 @@ void TimelineWidget::AddBlock(Block *block, TrackReference track)
 
 void TimelineWidget::RemoveBlock(Block *block)
 {
-  delete block_items_[block];
+  if (block_items_.contains(block)) {
+    ReleaseBlockItem(block_items_.take(block));
+  }
 
-  block_items_.remove(block);
+  block_tracks_.remove(block);
+  selected_blocks_.remove(block);
+  changed_blocks_.remove(block);
+  rubberband_now_selected_.removeAll(block);
 }
 
 void TimelineWidget::AddTrack(TrackOutput *track, TrackType type)
@@ -610,6 +897,8 @@ void TimelineWidget::AddTrack(TrackOutput *track, TrackType type)
   foreach (Block* b, track->Blocks()) {
     AddBlock(b, TrackReference(type, track->Index()));
   }
+
+  connect(track, SIGNAL(BlocksMoved(const rational&)), this, SLOT(TrackBlocksMoved(const rational&)));
 }
 
 void TimelineWidget::RemoveTrack(TrackOutput *track)
@@ -617,14 +906,163 @@ void TimelineWidget::RemoveTrack(TrackOutput *track)
   foreach (Block* b, track->Blocks()) {
     RemoveBlock(b);
   }
+
+  disconnect(track, SIGNAL(BlocksMoved(const rational&)), this, SLOT(TrackBlocksMoved(const rational&)));
 }
 
 void TimelineWidget::BlockChanged()
 {
-  TimelineViewRect* rect = block_items_[static_cast<Block*>(sender())];
+  Block* block = static_cast<Block*>(sender());
+
+  if (block_items_.contains(block)) {
+    changed_blocks_.insert(block);
+  }
+
+  // The block may have moved into or out of view
+  QueueVisibleBlocksUpdate();
+}
+
+void TimelineWidget::TrackBlocksMoved(const rational &from)
+{
+  TrackOutput* track = static_cast<TrackOutput*>(sender());
+  TrackReference ref(track->track_type(), track->Index());
+
+  // Blocks after an edit point aren't refreshed individually, only the ones that have items need updating
+  QMapIterator<Block*, TimelineViewBlockItem*> iterator(block_items_);
+
+  while (iterator.hasNext()) {
+    iterator.next();
+
+    if (block_tracks_.value(iterator.key()) == ref && iterator.key()->out() >= from) {
+      changed_blocks_.insert(iterator.key());
+    }
+  }
+
+  // Blocks may also have moved into or out of view
+  QueueVisibleBlocksUpdate();
+}
+
+TimeRange TimelineWidget::GetVisibleTimeRange()
+{
+  // Views share their horizontal scroll, but not necessarily their width
+  double visible_left = DBL_MAX;
+  double visible_right = 0;
+
+  foreach (TimelineView* view, views_) {
+    QRectF visible_rect = view->mapToScene(view->viewport()->rect()).boundingRect();
+
+    visible_left = qMin(visible_left, visible_rect.left());
+    visible_right = qMax(visible_right, visible_rect.right());
+  }
+
+  double margin = visible_right - visible_left;
+
+  visible_left = qMax(0.0, visible_left - margin);
+  visible_right += margin;
+
+  return TimeRange(rational(qFloor(visible_left / scale_ * 1000), 1000),
+                   rational(qCeil(visible_right / scale_ * 1000), 1000));
+}
+
+TimelineViewBlockItem *TimelineWidget::CreateBlockItem(Block *block)
+{
+  TrackReference track = block_tracks_.value(block);
+
+  TimelineViewBlockItem* item;
+
+  if (free_block_items_.isEmpty()) {
+    item = new TimelineViewBlockItem();
+  } else {
+    item = free_block_items_.takeLast();
+  }
+
+  // Set up clip with view parameters (clip item will automatically size its rect accordingly)
+  item->SetBlock(block);
+  item->SetYCoords(GetTrackY(track), GetTrackHeight(track));
+  item->SetScale(scale_);
+  item->SetTrack(track);
+  item->setSelected(IsBlockSelected(block));
+
+  // Add item to graphics scene
+  views_.at(track.type())->scene()->addItem(item);
+
+  return item;
+}
+
+void TimelineWidget::ReleaseBlockItem(TimelineViewBlockItem *item)
+{
+  // Hidden items would still count towards the scene's bounding rect, so recycled items are taken out of it instead
+  item->scene()->removeItem(item);
+
+  item->setSelected(false);
+  item->SetBlock(nullptr);
+
+  free_block_items_.append(item);
+}
+
+void TimelineWidget::UpdateVisibleBlocks()
+{
+  visible_blocks_update_queued_ = false;
+
+  if (timeline_node_ == nullptr) {
+    return;
+  }
+
+  TimeRange visible_range = GetVisibleTimeRange();
+
+  QSet<Block*> visible_blocks;
+
+  for (int i=0;i<views_.size();i++) {
+    const QVector<TrackOutput*>& tracks = timeline_node_->track_list(static_cast<TrackType>(i))->Tracks();
+
+    // Tracks with nothing visible on them still need room in the scene
+    views_.at(i)->SetTrackCount(tracks.size());
+
+    foreach (TrackOutput* track, tracks) {
+      foreach (Block* b, track->BlocksAtTimeRange(visible_range)) {
+        if (block_tracks_.contains(b)) {
+          visible_blocks.insert(b);
+        }
+      }
+    }
+  }
+
+  // Recycle the items of blocks that are no longer in range
+  QMutableMapIterator<Block*, TimelineViewBlockItem*> iterator(block_items_);
+
+  while (iterator.hasNext()) {
+    iterator.next();
+
+    if (!visible_blocks.contains(iterator.key())) {
+      ReleaseBlockItem(iterator.value());
+      iterator.remove();
+    }
+  }
+
+  foreach (Block* b, visible_blocks) {
+    if (!block_items_.contains(b)) {
+      block_items_.insert(b, CreateBlockItem(b));
+    }
+  }
+
+  // New items are already up to date, but any older ones whose blocks changed need their geometry updating
+  foreach (Block* b, changed_blocks_) {
+    TimelineViewBlockItem* item = block_items_.value(b);
+
+    if (item != nullptr) {
+      item->UpdateRect();
+    }
+  }
+
+  changed_blocks_.clear();
+}
+
+void TimelineWidget::QueueVisibleBlocksUpdate()
+{
+  if (!visible_blocks_update_queued_) {
+    visible_blocks_update_queued_ = true;
 
-  if (rect != nullptr) {
-    rect->UpdateRect();
+    QMetaObject::invokeMethod(this, "UpdateVisibleBlocks", Qt::QueuedConnection);
   }
 }
 
@@ -635,14 +1073,35 @@ void TimelineWidget::AddGhost(TimelineViewGhostItem *ghost)
   views_.at(ghost->Track().type())->scene()->addItem(ghost);
 }
 
-void TimelineWidget::SetBlockLinksSelected(Block* block, bool selected)
+bool TimelineWidget::IsBlockSelected(Block *block)
 {
-  TimelineViewBlockItem* link_item;
+  return selected_blocks_.contains(block);
+}
 
+void TimelineWidget::SetBlockSelected(Block *block, bool selected)
+{
+  // Only clips can be selected, and only blocks on this timeline
+  if (block->type() != Block::kClip || !block_tracks_.contains(block)) {
+    return;
+  }
+
+  if (selected) {
+    selected_blocks_.insert(block);
+  } else {
+    selected_blocks_.remove(block);
+  }
+
+  TimelineViewBlockItem* item = block_items_.value(block);
+
+  if (item != nullptr) {
+    item->setSelected(selected);
+  }
+}
+
+void TimelineWidget::SetBlockLinksSelected(Block* block, bool selected)
+{
   foreach (Block* link, block->linked_clips()) {
-    if ((link_item = block_items_[link]) != nullptr) {
-      link_item->setSelected(selected);
-    }
+    SetBlockSelected(link, selected);
   }
 }
 
@@ -660,45 +1119,96 @@ void TimelineWidget::MoveRubberBandSelect(bool select_links)
 
   rubberband_.setGeometry(QRect(mapFromGlobal(drag_origin_), mapFromGlobal(rubberband_now)).normalized());
 
-  QList<QGraphicsItem*> new_selected_list;
+  if (timeline_node_ == nullptr) {
+    return;
+  }
+
+  QSet<Block*> new_selected;
 
   foreach (TimelineView* view, views_) {
-    // Map global mouse coordinates to viewport
-
+    // Map global mouse coordinates to the scene
     QRect mapped_rect(view->viewport()->mapFromGlobal(drag_origin_),
                       view->viewport()->mapFromGlobal(rubberband_now));
 
-    // Normalize and get items in rect
-    QList<QGraphicsItem*> rubberband_items = view->items(mapped_rect.normalized());
+    QRectF scene_rect = view->mapToScene(mapped_rect.normalized()).boundingRect();
 
-    new_selected_list.append(rubberband_items);
+    new_selected.unite(ClipsInRubberBand(view, scene_rect));
   }
 
-  foreach (QGraphicsItem* item, rubberband_now_selected_) {
-    item->setSelected(false);
+  if (select_links) {
+    QSet<Block*> links;
+
+    foreach (Block* b, new_selected) {
+      foreach (Block* link, b->linked_clips()) {
+        if (block_tracks_.contains(link)) {
+          links.insert(link);
+        }
+      }
+    }
+
+    new_selected.unite(links);
   }
 
-  foreach (QGraphicsItem* item, new_selected_list) {
-    item->setSelected(true);
+  // Only touch the blocks whose state has changed since the last move, a block the rubberband still covers stays as it
+  // is rather than being deselected and selected again
+  QSet<Block*> changed;
 
-    if (select_links) {
-      // Select the block's links
-      Block* b = static_cast<TimelineViewBlockItem*>(item)->block();
-      SetBlockLinksSelected(b, true);
+  foreach (Block* b, rubberband_now_selected_) {
+    if (!new_selected.contains(b)) {
+      selected_blocks_.remove(b);
+      changed.insert(b);
+    }
+  }
 
-      // Add its links to the list
-      TimelineViewBlockItem* link_item;
-      foreach (Block* link, b->linked_clips()) {
-        if ((link_item = block_items_[link]) != nullptr) {
-          if (!new_selected_list.contains(link_item)) {
-            new_selected_list.append(link_item);
-          }
-        }
+  foreach (Block* b, new_selected) {
+    if (!rubberband_now_selected_.contains(b)) {
+      selected_blocks_.insert(b);
+      changed.insert(b);
+    }
+  }
+
+  UpdateSelectedItems(changed);
+
+  rubberband_now_selected_ = new_selected;
+}
+
+QSet<Block *> TimelineWidget::ClipsInRubberBand(TimelineView *view, const QRectF &scene_rect)
+{
+  QSet<Block*> clips;
+
+  TrackType type = static_cast<TrackType>(views_.indexOf(view));
+  const QVector<TrackOutput*>& tracks = timeline_node_->track_list(type)->Tracks();
+
+  TimeRange range(SceneToTime(scene_rect.left()), SceneToTime(scene_rect.right()));
+
+  for (int i=0;i<tracks.size();i++) {
+    TrackReference ref(type, i);
+
+    int track_top = GetTrackY(ref);
+
+    if (track_top >= scene_rect.bottom() || track_top + GetTrackHeight(ref) <= scene_rect.top()) {
+      continue;
+    }
+
+    foreach (Block* b, tracks.at(i)->BlocksAtTimeRange(range)) {
+      if (b->type() == Block::kClip && block_tracks_.contains(b)) {
+        clips.insert(b);
       }
     }
   }
 
-  rubberband_now_selected_ = new_selected_list;
+  return clips;
+}
+
+void TimelineWidget::UpdateSelectedItems(const QSet<Block *> &blocks)
+{
+  foreach (Block* b, blocks) {
+    TimelineViewBlockItem* item = block_items_.value(b);
+
+    if (item != nullptr) {
+      item->setSelected(selected_blocks_.contains(b));
+    }
+  }
 }
 
 void TimelineWidget::EndRubberBandSelect(bool select_links)
@@ -1,10 +1,13 @@
 #ifndef TIMELINEWIDGET_H
 #define TIMELINEWIDGET_H
 
+#include <QHash>
 #include <QScrollBar>
 #include <QRubberBand>
+#include <QSet>
 #include <QWidget>
 
+#include "common/timerange.h"
 #include "widget/timelinewidget/timelinescaledobject.h"
 #include "widget/timelinewidget/view/timelineview.h"
 #include "widget/timeruler/timeruler.h"
@@ -20,10 +23,17 @@ class TimelineWidget : public QWidget, public TimelineScaledObject
 public:
   TimelineWidget(QWidget* parent = nullptr);
 
+  virtual ~TimelineWidget() override;
+
   void Clear();
 
   void SetTime(const int64_t& timestamp);
 
+  /**
+   * @brief Update the render status shown along the ruler (see TimeRuler::SetFrameStatus())
+   */
+  void SetFrameStatus(const FrameStatusSpans& spans);
+
   void ConnectTimelineNode(TimelineOutput* node);
 
   void DisconnectTimelineNode();
@@ -50,7 +60,44 @@ public:
 
   void SplitAtPlayhead();
 
-  QList<TimelineViewBlockItem*> GetSelectedBlocks();
+  QList<Block*> GetSelectedBlocks();
+
+  /**
+   * @brief Copy the selected clips, and the nodes they depend on, to the clipboard
+   */
+  void CopySelected();
+
+  /**
+   * @brief Place clips copied with CopySelected() at the playhead, on the tracks they were copied from
+   */
+  void Paste();
+
+  /**
+   * @brief Place copies of the selected clips straight after the selection, on the same tracks
+   */
+  void DuplicateSelected();
+
+  /**
+   * @brief Set the in point to the playhead (moving the out point back to the end if it's before it)
+   */
+  void SetInPoint();
+
+  /**
+   * @brief Set the out point to the end of the frame at the playhead (moving the in point back to the start if it's
+   * after it)
+   */
+  void SetOutPoint();
+
+  void ResetInPoint();
+
+  void ResetOutPoint();
+
+  void ClearInOutPoints();
+
+  /**
+   * @brief Queue a PreRenderTask for the range between the in and out points (the whole sequence if neither is set)
+   */
+  void PreRenderInOut();
 
 public slots:
   void SetTimebase(const rational& timebase);
@@ -117,6 +164,29 @@ private:
      */
     bool SnapPoint(QList<rational> start_times, rational *movement, int snap_points = kSnapAll);
 
+    /**
+     * @brief Sorted in and out points of one track's blocks, for looking them up with a binary search
+     *
+     * Nothing on the timeline changes until a drag is released, so each track's index is built the first time a drag
+     * needs it and kept until the drag ends (see ClearTrackIndexes()). Snapping and overwrite checks then cost the
+     * same on every mouse move however many blocks the tracks have.
+     */
+    struct TrackIndex {
+      /// In and out points of every block (what's snapped to)
+      QVector<rational> edges;
+
+      /// In and out points of every clip (not gaps, which can be overwritten), both in timeline order
+      QVector<rational> clip_ins;
+      QVector<rational> clip_outs;
+    };
+
+    const TrackIndex& GetTrackIndex(TrackOutput* track);
+
+    /**
+     * @brief Discard the track indexes, called whenever a drag starts or ends
+     */
+    void ClearTrackIndexes();
+
     QList<rational> snap_points_;
 
     bool dragging_;
@@ -126,6 +196,8 @@ private:
   private:
     TimelineWidget* parent_;
 
+    QHash<TrackOutput*, TrackIndex> track_indexes_;
+
   };
 
   class PointerTool : public Tool
@@ -174,8 +246,15 @@ private:
 
     void AddGhostInternal(TimelineViewGhostItem* ghost, olive::timeline::MovementMode mode);
 
-    bool IsClipTrimmable(TimelineViewBlockItem* clip,
-                         const QList<TimelineViewBlockItem*>& items,
+    /**
+     * @brief Returns whether `clip` is the earliest (trimming in) or latest (trimming out) selected block on its track
+     *
+     * @param extents
+     *
+     * Earliest in point and latest out point of the selected blocks on each track.
+     */
+    bool IsClipTrimmable(Block* clip,
+                         const QHash<TrackOutput*, TimeRange>& extents,
                          const olive::timeline::MovementMode& mode);
 
     TrackReference track_start_;
@@ -286,6 +365,10 @@ private:
     virtual void MouseRelease(TimelineViewMouseEvent *event);
   };
 
+  bool IsBlockSelected(Block* block);
+
+  void SetBlockSelected(Block* block, bool selected);
+
   void SetBlockLinksSelected(Block *block, bool selected);
 
   QPoint drag_origin_;
@@ -294,7 +377,20 @@ private:
   void MoveRubberBandSelect(bool select_links);
   void EndRubberBandSelect(bool select_links);
   QRubberBand rubberband_;
-  QList<QGraphicsItem*> rubberband_now_selected_;
+  QSet<Block*> rubberband_now_selected_;
+
+  /**
+   * @brief Returns every clip on this timeline that the rubberband covers in `view`
+   *
+   * Found through each covered track's block positions (see TrackOutput::BlocksAtTimeRange()) rather than the scene's
+   * items, so it costs the same however long the timeline is and covers blocks that don't have an item.
+   */
+  QSet<Block*> ClipsInRubberBand(TimelineView* view, const QRectF& scene_rect);
+
+  /**
+   * @brief Make the items of `blocks` (those that have one) show whether they're selected now
+   */
+  void UpdateSelectedItems(const QSet<Block*>& blocks);
 
   void StartHandDrag();
   void MoveHandDrag();
@@ -316,10 +412,77 @@ private:
 
   QVector<TimelineViewGhostItem*> ghost_items_;
 
+  /**
+   * @brief Every Block shown on this timeline and the track it's on, whether or not it currently has an item
+   */
+  QHash<Block*, TrackReference> block_tracks_;
+
+  /**
+   * @brief Blocks the user has selected
+   *
+   * Kept here rather than in the items since most blocks don't have an item at any given time.
+   */
+  QSet<Block*> selected_blocks_;
+
+  /**
+   * @brief Items for the Blocks in or near the visible area of the views
+   *
+   * Maintained by UpdateVisibleBlocks(). Blocks anywhere else have no item at all so zooming, scrolling and selecting
+   * cost the same however long the sequence is.
+   */
   QMap<Block*, TimelineViewBlockItem*> block_items_;
 
+  /**
+   * @brief Items that have scrolled out of view, kept out of any scene to be reused for the next blocks that scroll in
+   */
+  QList<TimelineViewBlockItem*> free_block_items_;
+
+  /**
+   * @brief Range of time block items are kept for
+   *
+   * The visible area of the views with a viewport's width either side of it, so scrolling a little doesn't need any
+   * items created.
+   */
+  TimeRange GetVisibleTimeRange();
+
+  TimelineViewBlockItem* CreateBlockItem(Block* block);
+
+  void ReleaseBlockItem(TimelineViewBlockItem* item);
+
+  /**
+   * @brief Blocks with items that have changed since the last UpdateVisibleBlocks()
+   *
+   * Tracks can refresh the same block several times during one edit, so its item is only updated once afterwards.
+   */
+  QSet<Block*> changed_blocks_;
+
+  bool visible_blocks_update_queued_;
+
   void RippleEditTo(olive::timeline::MovementMode mode, bool insert_gaps);
 
+  /**
+   * @brief Pack the selected clips and the nodes they depend on into one record
+   *
+   * The nodes are packed with ProjectSerializer::SerializeNodes() rather than copied one by one, so however many
+   * clips there are, nothing is created until they're pasted and nothing signals until they're placed.
+   *
+   * @param selection_out
+   *
+   * If not nullptr, set to the latest out point of the selected clips.
+   *
+   * @return
+   *
+   * The record, or an empty array if no clips are selected.
+   */
+  QByteArray SerializeSelectedClips(rational* selection_out);
+
+  /**
+   * @brief Place the clips of a record made by SerializeSelectedClips() in one undoable command
+   *
+   * The earliest clip is placed at `time`, the rest keep their position relative to it.
+   */
+  void PasteClips(const QByteArray& data, const rational& time);
+
   void SetTimeAndSignal(const int64_t& t);
 
   TrackOutput* GetTrackFromReference(const TrackReference& ref);
@@ -332,6 +495,19 @@ private:
 
   int64_t playhead_;
 
+  /**
+   * @brief In and out points, 0 and RATIONAL_MAX when they aren't set
+   *
+   * Only kept while the same timeline is connected.
+   */
+  rational in_point_;
+  rational out_point_;
+
+  /**
+   * @brief Show the in and out points on the ruler
+   */
+  void UpdateInOut();
+
   QScrollBar* horizontal_scroll_;
 
   int GetTrackY(const TrackReference& ref);
@@ -344,6 +520,18 @@ private:
 private slots:
   void SetScale(double scale);
 
+  /**
+   * @brief Give every Block within GetVisibleTimeRange() an item and recycle the items of any that have left it
+   *
+   * Also updates the geometry of any items whose blocks have changed since the last call.
+   */
+  void UpdateVisibleBlocks();
+
+  /**
+   * @brief Queue an UpdateVisibleBlocks() call, coalescing the many changes one edit, scroll or zoom causes into one
+   */
+  void QueueVisibleBlocksUpdate();
+
   void UpdateInternalTime(const int64_t& timestamp);
 
   void UpdateTimelineLength(const rational& length);
@@ -372,6 +560,13 @@ private slots:
    */
   void BlockChanged();
 
+  /**
+   * @brief Slot for when Blocks on a track have moved after an edit (see TrackOutput::BlocksMoved())
+   *
+   * This slot does a static_cast on sender() to TrackOutput*.
+   */
+  void TrackBlocksMoved(const rational& from);
+
 };
 
 #endif // TIMELINEWIDGET_H
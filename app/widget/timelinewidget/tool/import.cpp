@@ -30,6 +30,9 @@
 #include "node/color/opacity/opacity.h"
 #include "node/input/media/audio/audio.h"
 #include "node/input/media/video/video.h"
+#include "node/input/sequence/sequence.h"
+#include "project/item/sequence/sequence.h"
+#include "task/index/index.h"
 
 TrackType TrackTypeFromStreamType(Stream::Type stream_type)
 {
@@ -50,6 +53,33 @@ TrackType TrackTypeFromStreamType(Stream::Type stream_type)
   return kTrackTypeNone;
 }
 
+/**
+ * @brief Returns whether `sequence` shows anything in `graph`, so nesting it there would make it show itself
+ */
+bool SequenceDependsOnGraph(Sequence* sequence, NodeGraph* graph)
+{
+  if (sequence == graph) {
+    return true;
+  }
+
+  Node* inner = sequence->viewer_output()->texture_input()->get_connected_node();
+
+  if (!inner) {
+    return false;
+  }
+
+  QList<Node*> nodes = inner->GetDependencies();
+  nodes.append(inner);
+
+  foreach (Node* n, nodes) {
+    if (n->parent() == graph) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 TimelineWidget::ImportTool::ImportTool(TimelineWidget *parent) :
   Tool(parent)
 {
@@ -83,6 +113,7 @@ void TimelineWidget::ImportTool::DragEnter(TimelineViewMouseEvent *event)
     rational ghost_start = drag_start_.GetFrame() - parent()->SceneToTime(import_pre_buffer_);
 
     snap_points_.clear();
+    ClearTrackIndexes();
 
     while (!stream.atEnd()) {
       stream >> r >> item_ptr;
@@ -139,6 +170,35 @@ void TimelineWidget::ImportTool::DragEnter(TimelineViewMouseEvent *event)
 
         // Stack each ghost one after the other
         ghost_start += footage_duration;
+      } else if (item->type() == Item::kSequence) {
+        // Sequences are nested as a single video clip showing them
+        Sequence* sequence = static_cast<Sequence*>(item);
+
+        sequence->Materialize();
+
+        // Nothing to show, or it would end up showing itself
+        if (!sequence->viewer_output()->texture_input()->IsConnected()
+            || SequenceDependsOnGraph(sequence, qobject_cast<NodeGraph*>(parent()->timeline_node_->parent()))) {
+          continue;
+        }
+
+        rational sequence_duration = sequence->length();
+
+        TimelineViewGhostItem* ghost = new TimelineViewGhostItem();
+
+        ghost->SetIn(ghost_start);
+        ghost->SetOut(ghost_start + sequence_duration);
+        ghost->SetTrack(TrackReference(kTrackTypeVideo, drag_start_.GetTrack().index()));
+
+        snap_points_.append(ghost->In());
+        snap_points_.append(ghost->Out());
+
+        ghost->setData(TimelineViewGhostItem::kAttachedSequence, QVariant::fromValue(reinterpret_cast<quintptr>(sequence)));
+        ghost->SetMode(olive::timeline::kMove);
+
+        parent()->AddGhost(ghost);
+
+        ghost_start += sequence_duration;
       }
     }
 
@@ -213,10 +273,38 @@ void TimelineWidget::ImportTool::DragDrop(TimelineViewMouseEvent *event)
     for (int i=0;i<parent()->ghost_items_.size();i++) {
       TimelineViewGhostItem* ghost = parent()->ghost_items_.at(i);
 
-      StreamPtr footage_stream = ghost->data(TimelineViewGhostItem::kAttachedFootage).value<StreamPtr>();
-
       ClipBlock* clip = new ClipBlock();
       clip->set_length(ghost->Length());
+
+      if (ghost->data(TimelineViewGhostItem::kAttachedSequence).isValid()) {
+        Sequence* sequence = reinterpret_cast<Sequence*>(ghost->data(TimelineViewGhostItem::kAttachedSequence).value<quintptr>());
+
+        clip->set_block_name(sequence->name());
+
+        // Connected straight to what the nested sequence's viewer shows, so both look its frames up by the same hash
+        SequenceInput* sequence_input = new SequenceInput();
+        NodeParam::ConnectEdge(sequence->viewer_output()->texture_input()->get_connected_node()->output(),
+                               sequence_input->sequence_input());
+        NodeParam::ConnectEdge(sequence_input->output(), clip->texture_input());
+
+        if (!(event->GetModifiers() & Qt::ControlModifier)) {
+          new TrackPlaceBlockCommand(parent()->timeline_node_->track_list(ghost->GetAdjustedTrack().type()),
+                                     ghost->GetAdjustedTrack().index(),
+                                     clip,
+                                     ghost->GetAdjustedIn(),
+                                     command);
+        }
+
+        block_items.replace(i, clip);
+
+        continue;
+      }
+
+      StreamPtr footage_stream = ghost->data(TimelineViewGhostItem::kAttachedFootage).value<StreamPtr>();
+
+      // Now that it's being used, index the file before anything tries to play it
+      IndexTask::IndexInBackground(footage_stream);
+
       clip->set_block_name(footage_stream->footage()->name());
 
       switch (footage_stream->type()) {
@@ -262,7 +350,7 @@ void TimelineWidget::ImportTool::DragDrop(TimelineViewMouseEvent *event)
       for (int j=0;j<i;j++) {
         StreamPtr footage_compare = parent()->ghost_items_.at(j)->data(TimelineViewGhostItem::kAttachedFootage).value<StreamPtr>();
 
-        if (footage_compare->footage() == footage_stream->footage()) {
+        if (footage_compare && footage_compare->footage() == footage_stream->footage()) {
           Block::Link(block_items.at(j), clip);
         }
       }
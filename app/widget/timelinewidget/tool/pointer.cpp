@@ -20,6 +20,7 @@
 
 #include "widget/timelinewidget/timelinewidget.h"
 
+#include <algorithm>
 #include <QDebug>
 #include <QToolTip>
 
@@ -55,11 +56,11 @@ void TimelineWidget::PointerTool::MousePress(TimelineViewMouseEvent *event)
 
   // If this item is already selected
   if (selectable_item
-      && item->isSelected()) {
+      && parent()->IsBlockSelected(item->block())) {
 
     // If shift is held, deselect it
     if (event->GetModifiers() & Qt::ShiftModifier) {
-      item->setSelected(false);
+      parent()->SetBlockSelected(item->block(), false);
 
       // If not holding alt, deselect all links as well
       if (!(event->GetModifiers() & Qt::AltModifier)) {
@@ -78,7 +79,7 @@ void TimelineWidget::PointerTool::MousePress(TimelineViewMouseEvent *event)
 
   if (selectable_item) {
     // Select this item
-    item->setSelected(true);
+    parent()->SetBlockSelected(item->block(), true);
 
     // If not holding alt, select all links as well
     if (!(event->GetModifiers() & Qt::AltModifier)) {
@@ -132,6 +133,7 @@ void TimelineWidget::PointerTool::MouseRelease(TimelineViewMouseEvent *event)
   if (dragging_) {
     parent()->ClearGhosts();
     snap_points_.clear();
+    ClearTrackIndexes();
   }
 
   dragging_ = false;
@@ -231,6 +233,7 @@ void TimelineWidget::PointerTool::InitiateDrag(const TimelineCoordinate &mouse_p
 
     // Clear snap points
     snap_points_.clear();
+    ClearTrackIndexes();
 
     // Record where the drag started in timeline coordinates
     track_start_ = mouse_pos.GetTrack();
@@ -332,20 +335,34 @@ void TimelineWidget::PointerTool::InitiateGhosts(TimelineViewBlockItem* clicked_
                                                bool allow_gap_trimming)
 {
   // Convert selected items list to clips list
-  QList<TimelineViewBlockItem*> clips = parent()->GetSelectedBlocks();
+  QList<Block*> clips = parent()->GetSelectedBlocks();
 
   // If trimming multiple clips, we only trim the earliest in each track (trimming in) or the latest in each track
   // (trimming out). If the current clip is NOT one of these, we only trim it.
   bool multitrim_enabled = true;
 
+  QHash<TrackOutput*, TimeRange> extents;
+
   // Determine if the clicked item is the earliest/latest in the track for in/out trimming respectively
   if (trim_mode == olive::timeline::kTrimIn
       || trim_mode == olive::timeline::kTrimOut) {
-    multitrim_enabled = IsClipTrimmable(clicked_item, clips, trim_mode);
+    // Found in one pass so each clip is only compared to its track's extent, rather than every other clip
+    foreach (Block* clip, clips) {
+      TrackOutput* track = parent()->GetTrackFromReference(parent()->block_tracks_.value(clip));
+      QHash<TrackOutput*, TimeRange>::iterator extent = extents.find(track);
+
+      if (extent == extents.end()) {
+        extents.insert(track, TimeRange(clip->in(), clip->out()));
+      } else {
+        extent.value() = TimeRange(qMin(extent->in(), clip->in()), qMax(extent->out(), clip->out()));
+      }
+    }
+
+    multitrim_enabled = IsClipTrimmable(clicked_item->block(), extents, trim_mode);
   }
 
   // For each selected item, create a "ghost", a visual representation of the action before it gets performed
-  foreach (TimelineViewBlockItem* clip_item, clips) {
+  foreach (Block* clip, clips) {
     // Determine correct mode for ghost
     //
     // Movement is indiscriminate, all the ghosts can be set to do this, however trimming is limited to one block
@@ -353,13 +370,13 @@ void TimelineWidget::PointerTool::InitiateGhosts(TimelineViewBlockItem* clicked_
 
     bool include_this_clip = true;
 
-    if (clip_item != clicked_item
+    if (clip != clicked_item->block()
         && (trim_mode == olive::timeline::kTrimIn || trim_mode == olive::timeline::kTrimOut)) {
-      include_this_clip = multitrim_enabled ? IsClipTrimmable(clip_item, clips, trim_mode) : false;
+      include_this_clip = multitrim_enabled ? IsClipTrimmable(clip, extents, trim_mode) : false;
     }
 
     if (include_this_clip) {
-      Block* block = clip_item->block();
+      Block* block = clip;
       olive::timeline::MovementMode block_mode = trim_mode;
 
       if (block->type() == Block::kGap && !allow_gap_trimming) {
@@ -374,7 +391,7 @@ void TimelineWidget::PointerTool::InitiateGhosts(TimelineViewBlockItem* clicked_
       }
 
       if (block != nullptr) {
-        AddGhostFromBlock(block, clip_item->Track(), block_mode);
+        AddGhostFromBlock(block, parent()->block_tracks_.value(clip), block_mode);
       }
     }
   }
@@ -429,20 +446,20 @@ void TimelineWidget::PointerTool::AddGhostInternal(TimelineViewGhostItem* ghost,
   parent()->AddGhost(ghost);
 }
 
-bool TimelineWidget::PointerTool::IsClipTrimmable(TimelineViewBlockItem* clip,
-                                                const QList<TimelineViewBlockItem*>& items,
+bool TimelineWidget::PointerTool::IsClipTrimmable(Block* clip,
+                                                const QHash<TrackOutput*, TimeRange>& extents,
                                                 const olive::timeline::MovementMode& mode)
 {
-  foreach (TimelineViewBlockItem* compare, items) {
-    if (clip->Track() == compare->Track()
-        && clip != compare
-        && ((compare->block()->in() < clip->block()->in() && mode == olive::timeline::kTrimIn)
-            || (compare->block()->out() > clip->block()->out() && mode == olive::timeline::kTrimOut))) {
-      return false;
-    }
+  TrackOutput* track = parent()->GetTrackFromReference(parent()->block_tracks_.value(clip));
+
+  QHash<TrackOutput*, TimeRange>::const_iterator extent = extents.constFind(track);
+
+  if (extent == extents.constEnd()) {
+    return true;
   }
 
-  return true;
+  return !((extent->in() < clip->in() && mode == olive::timeline::kTrimIn)
+           || (extent->out() > clip->out() && mode == olive::timeline::kTrimOut));
 }
 
 rational TimelineWidget::PointerTool::ValidateInTrimming(rational movement,
@@ -460,14 +477,12 @@ rational TimelineWidget::PointerTool::ValidateInTrimming(rational movement,
     rational earliest_in = qMax(rational(0), block->in() - block->media_in());
 
     if (prevent_overwriting) {
-      // Look for a Block in the way
-      Block* prev = block->previous();
-      while (prev != nullptr) {
-        if (prev->type() == Block::kClip) {
-          earliest_in = qMax(earliest_in, prev->out());
-          break;
-        }
-        prev = prev->previous();
+      // The last clip ending before this block is in the way
+      const QVector<rational>& outs = GetTrackIndex(parent()->GetTrackFromReference(ghost->Track())).clip_outs;
+      QVector<rational>::const_iterator prev = std::upper_bound(outs.constBegin(), outs.constEnd(), block->in());
+
+      if (prev != outs.constBegin()) {
+        earliest_in = qMax(earliest_in, *(prev - 1));
       }
     }
 
@@ -511,14 +526,12 @@ rational TimelineWidget::PointerTool::ValidateOutTrimming(rational movement,
     rational latest_out = RATIONAL_MAX;
 
     if (prevent_overwriting) {
-      // Determine if there's a block in the way
-      Block* next = block->next();
-      while (next != nullptr) {
-        if (next->type() == Block::kClip) {
-          latest_out = qMin(latest_out, next->in());
-          break;
-        }
-        next = next->next();
+      // The first clip starting after this block is in the way
+      const QVector<rational>& ins = GetTrackIndex(parent()->GetTrackFromReference(ghost->Track())).clip_ins;
+      QVector<rational>::const_iterator next = std::lower_bound(ins.constBegin(), ins.constEnd(), block->out());
+
+      if (next != ins.constEnd()) {
+        latest_out = qMin(latest_out, *next);
       }
     }
 
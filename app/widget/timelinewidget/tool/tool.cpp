@@ -20,7 +20,9 @@
 
 #include "widget/timelinewidget/timelinewidget.h"
 
+#include <algorithm>
 #include <float.h>
+#include <QtMath>
 
 #include "common/range.h"
 
@@ -72,24 +74,21 @@ TimelineViewBlockItem *TimelineWidget::Tool::GetItemAtScenePos(const TimelineCoo
   return nullptr;
 }
 
-void AttemptSnap(const QList<double>& proposed_pts,
+const qreal kSnapRange = 10; // FIXME: Hardcoded number
+
+void AttemptSnap(double proposed_pt,
+                 const rational& start_time,
                  double compare_point,
-                 const QList<rational>& start_times,
-                 rational compare_time,
+                 const rational& compare_time,
                  rational* movement,
                  double* diff) {
-  const qreal kSnapRange = 10; // FIXME: Hardcoded number
-
-  for (int i=0;i<proposed_pts.size();i++) {
-    // Attempt snapping to clip out point
-    if (InRange(proposed_pts.at(i), compare_point, kSnapRange)) {
-      double this_diff = qAbs(compare_point - proposed_pts.at(i));
+  if (InRange(proposed_pt, compare_point, kSnapRange)) {
+    double this_diff = qAbs(compare_point - proposed_pt);
 
-      if (this_diff < *diff
-          && start_times.at(i) + *movement >= 0) {
-        *movement = compare_time - start_times.at(i);
-        *diff = this_diff;
-      }
+    if (this_diff < *diff
+        && start_time + *movement >= 0) {
+      *movement = compare_time - start_time;
+      *diff = this_diff;
     }
   }
 }
@@ -136,38 +135,85 @@ bool TimelineWidget::Tool::SnapPoint(QList<rational> start_times, rational* move
     proposed_pts.append((s + *movement).toDouble() * parent()->scale_);
   }
 
-  if (snap_points & kSnapToPlayhead) {
-
+  // AttemptSnap() changes the movement, but every point is proposed with the original
+  rational original_movement = *movement;
 
+  if (snap_points & kSnapToPlayhead) {
     rational playhead_abs_time = rational(parent()->playhead_ * parent()->timebase().numerator(),
                                           parent()->timebase().denominator());
 
     qreal playhead_pos = playhead_abs_time.toDouble() * parent()->scale_;
 
-    AttemptSnap(proposed_pts, playhead_pos, start_times, playhead_abs_time, movement, &diff);
+    for (int i=0;i<proposed_pts.size();i++) {
+      AttemptSnap(proposed_pts.at(i), start_times.at(i), playhead_pos, playhead_abs_time, movement, &diff);
+    }
   }
 
   if (snap_points & kSnapToClips) {
-    QMapIterator<Block*, TimelineViewBlockItem*> iterator(parent()->block_items_);
+    // Only the blocks within snapping range of each proposed point are visited. The range is rounded up to the
+    // millisecond, AttemptSnap() does the exact check.
+    double snap_range_time = kSnapRange / parent()->scale_;
+    rational snap_range(qCeil(snap_range_time * 1000), 1000);
+
+    for (int i=0;i<proposed_pts.size();i++) {
+      rational proposed_time = start_times.at(i) + original_movement;
+      rational window_in = proposed_time - snap_range;
+      rational window_out = proposed_time + snap_range;
+
+      for (int j=0;j<parent()->views_.size();j++) {
+        foreach (TrackOutput* track, parent()->timeline_node_->track_list(static_cast<TrackType>(j))->Tracks()) {
+          const QVector<rational>& edges = GetTrackIndex(track).edges;
+
+          for (QVector<rational>::const_iterator k=std::lower_bound(edges.constBegin(), edges.constEnd(), window_in);
+               k!=edges.constEnd() && *k<=window_out;
+               k++) {
+            AttemptSnap(proposed_pts.at(i),
+                        start_times.at(i),
+                        k->toDouble() * parent()->scale_,
+                        *k,
+                        movement,
+                        &diff);
+          }
+        }
+      }
+    }
+  }
+
+  return (diff < DBL_MAX);
+}
 
-    while (iterator.hasNext()) {
-      iterator.next();
+const TimelineWidget::Tool::TrackIndex &TimelineWidget::Tool::GetTrackIndex(TrackOutput *track)
+{
+  QHash<TrackOutput*, TrackIndex>::iterator existing = track_indexes_.find(track);
 
-      TimelineViewBlockItem* item = iterator.value();
+  if (existing != track_indexes_.end()) {
+    return existing.value();
+  }
 
-      if (item != nullptr) {
-        qreal rect_left = item->x();
-        qreal rect_right = rect_left + item->rect().width();
+  TrackIndex index;
 
-        // Attempt snapping to clip in point
-        AttemptSnap(proposed_pts, rect_left, start_times, item->block()->in(), movement, &diff);
+  foreach (Block* b, track->Blocks()) {
+    if (b == nullptr) {
+      continue;
+    }
 
-        // Attempt snapping to clip out point
-        AttemptSnap(proposed_pts, rect_right, start_times, item->block()->out(), movement, &diff);
-      }
+    // Blocks are contiguous, so each in point is the previous block's out point
+    if (index.edges.isEmpty()) {
+      index.edges.append(b->in());
+    }
+
+    index.edges.append(b->out());
+
+    if (b->type() == Block::kClip) {
+      index.clip_ins.append(b->in());
+      index.clip_outs.append(b->out());
     }
   }
 
+  return track_indexes_.insert(track, index).value();
+}
 
-  return (diff < DBL_MAX);
+void TimelineWidget::Tool::ClearTrackIndexes()
+{
+  track_indexes_.clear();
 }
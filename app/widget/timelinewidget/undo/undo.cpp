@@ -38,6 +38,35 @@ Node* TakeNodeFromParentGraph(Node* n, QObject* new_parent = nullptr)
   return n;
 }
 
+/**
+ * @brief Approximate memory used by the nodes parented to `memory_manager` (i.e. kept alive only for undoing/redoing)
+ */
+qint64 NodeMemoryUsage(const QObject* memory_manager)
+{
+  qint64 usage = 0;
+
+  foreach (QObject* child, memory_manager->children()) {
+    Node* n = qobject_cast<Node*>(child);
+
+    if (n == nullptr) {
+      continue;
+    }
+
+    // A node's parameters are small, other than keyframes
+    usage += static_cast<qint64>(sizeof(Node));
+
+    foreach (NodeParam* param, n->parameters()) {
+      usage += static_cast<qint64>(sizeof(NodeInput));
+
+      if (param->type() == NodeParam::kInput) {
+        usage += static_cast<NodeInput*>(param)->keyframes().size() * static_cast<qint64>(sizeof(NodeKeyframe));
+      }
+    }
+  }
+
+  return usage;
+}
+
 BlockResizeCommand::BlockResizeCommand(Block *block, rational new_length, QUndoCommand* parent) :
   QUndoCommand(parent),
   block_(block),
@@ -141,7 +170,8 @@ TrackRippleRemoveAreaCommand::TrackRippleRemoveAreaCommand(TrackOutput *track, r
   splice_(nullptr),
   trim_out_(nullptr),
   trim_in_(nullptr),
-  insert_(nullptr)
+  insert_(nullptr),
+  initialized_(false)
 {
 }
 
@@ -152,57 +182,70 @@ void TrackRippleRemoveAreaCommand::SetInsert(Block *insert)
 
 void TrackRippleRemoveAreaCommand::redo()
 {
-  // Iterate through blocks determining which need trimming/removing/splitting
-  foreach (Block* block, track_->Blocks()) {
-    if (block->in() < in_ && block->out() > out_) {
-      // The area entirely within this Block
-      splice_ = block;
-
-      // We don't need to do anything else here
-      break;
-    } else if (block->in() >= in_ && block->out() <= out_) {
-      // This Block's is entirely within the area
-      removed_blocks_.append(block);
-    } else if (block->in() < in_ && block->out() >= in_) {
-      // This Block's out point exceeds `in`
-      trim_out_ = block;
-    } else if (block->in() <= out_ && block->out() > out_) {
-      // This Block's in point exceeds `out`
-      trim_in_ = block;
+  // Redoing after an undo starts from the same state, so the blocks affected (and the copy made of a spliced block)
+  // are only worked out the first time rather than piling up a new copy every time this is redone
+  if (!initialized_) {
+    // Iterate through blocks determining which need trimming/removing/splitting
+    foreach (Block* block, track_->Blocks()) {
+      if (block->in() < in_ && block->out() > out_) {
+        // The area entirely within this Block
+        splice_ = block;
+
+        // We don't need to do anything else here
+        break;
+      } else if (block->in() >= in_ && block->out() <= out_) {
+        // This Block's is entirely within the area
+        removed_blocks_.append(block);
+      } else if (block->in() < in_ && block->out() >= in_) {
+        // This Block's out point exceeds `in`
+        trim_out_ = block;
+      } else if (block->in() <= out_ && block->out() > out_) {
+        // This Block's in point exceeds `out`
+        trim_in_ = block;
+      }
     }
+
+    if (splice_ != nullptr) {
+      splice_original_length_ = splice_->length();
+
+      // Perform all further actions as if we were just trimming these clips, the copy starts exactly at `out` so it
+      // never needs trimming itself
+      trim_out_ = splice_;
+      trim_in_ = CreateSplitBlock(splice_, out_, &memory_manager_);
+
+      trim_in_old_length_ = trim_in_->length();
+      trim_in_new_length_ = trim_in_old_length_;
+
+      trim_out_old_length_ = out_ - splice_->in();
+      trim_out_new_length_ = in_ - splice_->in();
+    } else {
+      // If we picked up a block to trim the in point of
+      if (trim_in_ != nullptr) {
+        trim_in_old_length_ = trim_in_->length();
+        trim_in_new_length_ = trim_in_->out() - out_;
+      }
+
+      // If we picked up a block to trim the out point of
+      if (trim_out_ != nullptr) {
+        trim_out_old_length_ = trim_out_->length();
+        trim_out_new_length_ = in_ - trim_out_->in();
+      }
+    }
+
+    initialized_ = true;
   }
 
   track_->BlockInvalidateCache();
 
   // If we picked up a block to splice
   if (splice_ != nullptr) {
-
     // Split the block here
-    Block* copy = CreateSplitBlock(splice_, out_);
-
-    splice_original_length_ = splice_->length();
     splice_->set_length(out_ - splice_->in());
 
-    track_->AddBlockToGraph(copy);
-    Node::CopyInputs(splice_, copy);
-
-    track_->InsertBlockAfter(copy, splice_);
+    track_->AddBlockToGraph(trim_in_);
+    Node::CopyInputs(splice_, trim_in_);
 
-    // Perform all further actions as if we were just trimming these clips
-    trim_out_ = splice_;
-    trim_in_ = copy;
-  }
-
-  // If we picked up a block to trim the in point of
-  if (trim_in_ != nullptr) {
-    trim_in_old_length_ = trim_in_->length();
-    trim_in_new_length_ = trim_in_->out() - out_;
-  }
-
-  // If we picked up a block to trim the out point of
-  if (trim_out_ != nullptr) {
-    trim_out_old_length_ = trim_out_->length();
-    trim_out_new_length_ = in_ - trim_out_->in();
+    track_->InsertBlockAfter(trim_in_, splice_);
   }
 
   // If we picked up a block to trim the in point of
@@ -294,6 +337,11 @@ TrackPlaceBlockCommand::TrackPlaceBlockCommand(TrackList *timeline, int track, B
   insert_->setParent(&memory_manager_);
 }
 
+qint64 TrackRippleRemoveAreaCommand::memory_usage() const
+{
+  return NodeMemoryUsage(&memory_manager_);
+}
+
 void TrackPlaceBlockCommand::redo()
 {
   added_track_count_ = 0;
@@ -386,6 +434,11 @@ void BlockSplitCommand::undo()
   track_->UnblockInvalidateCache();
 }
 
+qint64 BlockSplitCommand::memory_usage() const
+{
+  return NodeMemoryUsage(&memory_manager_);
+}
+
 Block *BlockSplitCommand::new_block()
 {
   return new_block_;
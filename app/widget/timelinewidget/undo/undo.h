@@ -27,6 +27,7 @@
 #include "node/block/gap/gap.h"
 #include "node/output/timeline/timeline.h"
 #include "node/output/track/track.h"
+#include "undo/undostack.h"
 
 class BlockResizeCommand : public QUndoCommand {
 public:
@@ -117,7 +118,7 @@ private:
  * By default, nothing takes this area meaning all subsequent clips are pushed backward, however you can specify
  * a block to insert at the `in` point. No checking is done to ensure `insert` is the same length as `in` to `out`.
  */
-class TrackRippleRemoveAreaCommand : public QUndoCommand {
+class TrackRippleRemoveAreaCommand : public QUndoCommand, public UndoCommandMemory {
 public:
   TrackRippleRemoveAreaCommand(TrackOutput* track, rational in, rational out, QUndoCommand* parent = nullptr);
 
@@ -126,6 +127,8 @@ public:
   virtual void redo() override;
   virtual void undo() override;
 
+  virtual qint64 memory_usage() const override;
+
 protected:
   TrackOutput* track_;
   rational in_;
@@ -147,6 +150,12 @@ protected:
   Block* insert_;
 
   QObject memory_manager_;
+
+private:
+  /**
+   * @brief Whether the blocks this command affects have been worked out yet (see redo())
+   */
+  bool initialized_;
 };
 
 /**
@@ -171,13 +180,15 @@ private:
   int added_track_count_;
 };
 
-class BlockSplitCommand : public QUndoCommand {
+class BlockSplitCommand : public QUndoCommand, public UndoCommandMemory {
 public:
   BlockSplitCommand(TrackOutput* track, Block* block, rational point, QUndoCommand* parent = nullptr);
 
   virtual void redo() override;
   virtual void undo() override;
 
+  virtual qint64 memory_usage() const override;
+
   Block* new_block();
 
 private:
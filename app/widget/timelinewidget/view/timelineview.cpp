@@ -23,19 +23,24 @@
 #include <QDebug>
 #include <QMimeData>
 #include <QMouseEvent>
+#include <QOpenGLWidget>
 #include <QScrollBar>
+#include <QToolTip>
 #include <QtMath>
 #include <QPen>
 
 #include "common/flipmodifiers.h"
 #include "common/timecodefunctions.h"
+#include "config/config.h"
 #include "core.h"
 #include "node/input/media/media.h"
 #include "project/item/footage/footage.h"
+#include "render/thumbnailservice.h"
 
 TimelineView::TimelineView(const TrackType &type, Qt::Alignment vertical_alignment, QWidget *parent) :
   QGraphicsView(parent),
   playhead_(0),
+  track_count_(0),
   type_(type)
 {
   Q_ASSERT(vertical_alignment == Qt::AlignTop || vertical_alignment == Qt::AlignBottom);
@@ -46,8 +51,14 @@ TimelineView::TimelineView(const TrackType &type, Qt::Alignment vertical_alignme
   setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
   setBackgroundRole(QPalette::Window);
 
+  SetUseOpenGL(Config::Current()["TimelineOpenGL"].toBool());
+  connect(&olive::core, SIGNAL(TimelineOpenGLChanged(const bool&)), this, SLOT(SetUseOpenGL(const bool&)));
+
   connect(&scene_, SIGNAL(changed(const QList<QRectF>&)), this, SLOT(UpdateSceneRect()));
 
+  // Clips draw thumbnails as they arrive
+  connect(ThumbnailService::instance(), SIGNAL(ThumbnailReady()), this, SLOT(ThumbnailReady()));
+
   // Create end item
   end_item_ = new TimelineViewEndItem();
   scene_.addItem(end_item_);
@@ -60,6 +71,9 @@ void TimelineView::SetScale(const double &scale)
 {
   scale_ = scale;
 
+  // Every filmstrip changes with the scale, so anything still waiting to be generated is no longer needed
+  CancelThumbnails();
+
   // Force redraw for playhead
   viewport()->update();
 
@@ -74,30 +88,16 @@ void TimelineView::SetTimebase(const rational &timebase)
   viewport()->update();
 }
 
-void TimelineView::SelectAll()
-{
-  QList<QGraphicsItem*> all_items = items();
-
-  foreach (QGraphicsItem* i, all_items) {
-    i->setSelected(true);
-  }
-}
-
-void TimelineView::DeselectAll()
-{
-  QList<QGraphicsItem*> all_items = items();
-
-  foreach (QGraphicsItem* i, all_items) {
-    i->setSelected(false);
-  }
-}
-
 void TimelineView::SetTime(const int64_t time)
 {
   playhead_ = time;
 
-  // Force redraw for playhead
-  viewport()->update();
+  // Only the strips the playhead is leaving and moving to need redrawing
+  viewport()->update(playhead_rect_);
+
+  UpdatePlayheadRect();
+
+  viewport()->update(playhead_rect_);
 }
 
 void TimelineView::mousePressEvent(QMouseEvent *event)
@@ -179,6 +179,45 @@ void TimelineView::resizeEvent(QResizeEvent *event)
   UpdateSceneRect();
 }
 
+void TimelineView::scrollContentsBy(int dx, int dy)
+{
+  QGraphicsView::scrollContentsBy(dx, dy);
+
+  if (dx != 0) {
+    CancelThumbnails();
+
+    // Scrolling only repaints the newly exposed strip, so repaint everything to request what's still visible again
+    viewport()->update();
+  }
+}
+
+bool TimelineView::viewportEvent(QEvent *event)
+{
+  if (event->type() == QEvent::ToolTip) {
+    // Block tooltips are only built when they're shown rather than every time a block changes
+    QHelpEvent* help_event = static_cast<QHelpEvent*>(event);
+
+    TimelineViewBlockItem* item = dynamic_cast<TimelineViewBlockItem*>(itemAt(help_event->pos()));
+
+    if (item != nullptr) {
+      QToolTip::showText(help_event->globalPos(), item->GetToolTip(), viewport());
+    } else {
+      QToolTip::hideText();
+    }
+
+    return true;
+  }
+
+  return QGraphicsView::viewportEvent(event);
+}
+
+void TimelineView::CancelThumbnails()
+{
+  if (ThumbnailService::instance() != nullptr) {
+    ThumbnailService::instance()->CancelRequests(&scene_);
+  }
+}
+
 void TimelineView::drawForeground(QPainter *painter, const QRectF &rect)
 {
   QGraphicsView::drawForeground(painter, rect);
@@ -197,6 +236,9 @@ void TimelineView::drawForeground(QPainter *painter, const QRectF &rect)
     painter->setBrush(Qt::NoBrush);
     painter->drawLine(QLineF(playhead_rect.topLeft(), playhead_rect.bottomLeft()));
   }
+
+  // Scrolling and zooming repaint everything, so the playhead may have moved on screen since it was last worked out
+  UpdatePlayheadRect();
 }
 
 Stream::Type TimelineView::TrackTypeToStreamType(TrackType track_type)
@@ -288,10 +330,66 @@ rational TimelineView::GetPlayheadTime()
   return rational(playhead_ * timebase().numerator(), timebase().denominator());
 }
 
+void TimelineView::UpdatePlayheadRect()
+{
+  if (timebase().isNull()) {
+    playhead_rect_ = QRect();
+    return;
+  }
+
+  int left = mapFromScene(QPointF(TimeToScene(GetPlayheadTime()), 0)).x();
+  int width = qCeil(TimeToScene(timebase()));
+
+  // Pad by a pixel either side to cover the line's antialiasing
+  playhead_rect_ = QRect(left - 1, 0, width + 2, viewport()->height());
+}
+
+void TimelineView::SetUseOpenGL(const bool &b)
+{
+  if (b == (qobject_cast<QOpenGLWidget*>(viewport()) != nullptr)) {
+    return;
+  }
+
+  if (b) {
+    // Dense thumbnails and waveforms at high resolutions can outpace the raster engine, so optionally draw through
+    // OpenGL instead. Items paint the same either way, and thumbnails are kept as textures by QImage cache key.
+    QOpenGLWidget* gl_viewport = new QOpenGLWidget();
+
+    // Smooths waveform lines and the playhead as the raster engine would
+    QSurfaceFormat format = gl_viewport->format();
+    format.setSamples(4);
+    gl_viewport->setFormat(format);
+
+    // Usually only part of the viewport is redrawn (e.g. the playhead's strip), so the rest must be kept
+    gl_viewport->setUpdateBehavior(QOpenGLWidget::PartialUpdate);
+
+    setViewport(gl_viewport);
+  } else {
+    // Replaces (and deletes) the OpenGL viewport with a plain widget
+    setViewport(nullptr);
+  }
+}
+
+void TimelineView::ThumbnailReady()
+{
+  viewport()->update();
+}
+
 void TimelineView::UpdateSceneRect()
 {
   QRectF bounding_rect = scene_.itemsBoundingRect();
 
+  // Only blocks near the visible area have items, so make room for every track whether it has any or not
+  if (track_count_ > 0) {
+    int first_track_y = GetTrackY(0);
+    int last_track_y = GetTrackY(track_count_ - 1);
+
+    int tracks_top = qMin(first_track_y, last_track_y);
+    int tracks_bottom = qMax(first_track_y + GetTrackHeight(0), last_track_y + GetTrackHeight(track_count_ - 1));
+
+    bounding_rect |= QRectF(0, tracks_top, 1, tracks_bottom - tracks_top);
+  }
+
   // Ensure the scene height is always AT LEAST the height of the view
   // The scrollbar appears to have a 1px margin on the top and bottom, hence the -2
   int minimum_height = height() - horizontalScrollBar()->height() - 2;
@@ -327,3 +425,12 @@ void TimelineView::SetEndTime(const rational &length)
 {
   end_item_->SetEndTime(length);
 }
+
+void TimelineView::SetTrackCount(int count)
+{
+  if (track_count_ != count) {
+    track_count_ = count;
+
+    UpdateSceneRect();
+  }
+}
@@ -52,12 +52,15 @@ public:
 
   void SetScale(const double& scale);
 
-  void SelectAll();
-
-  void DeselectAll();
-
   void SetEndTime(const rational& length);
 
+  /**
+   * @brief Set how many tracks of this view's type exist
+   *
+   * The scene is always tall enough to show them all, even when no item is currently on some of them.
+   */
+  void SetTrackCount(int count);
+
   int GetTrackY(int track_index);
   int GetTrackHeight(int track_index);
 
@@ -69,6 +72,11 @@ public slots:
 
   void SetTime(const int64_t time);
 
+  /**
+   * @brief Draw through an OpenGL viewport rather than the raster engine (see the "TimelineOpenGL" preference)
+   */
+  void SetUseOpenGL(const bool& b);
+
 signals:
   void ScaleChanged(double scale);
 
@@ -97,12 +105,23 @@ protected:
 
   virtual void resizeEvent(QResizeEvent *event) override;
 
+  virtual void scrollContentsBy(int dx, int dy) override;
+
+  virtual bool viewportEvent(QEvent *event) override;
+
   virtual void drawForeground(QPainter *painter, const QRectF &rect) override;
 
 private:
   TrackType ConnectedTrackType();
   Stream::Type TrackTypeToStreamType(TrackType track_type);
 
+  /**
+   * @brief Drop any thumbnails this view asked for but that haven't been generated yet
+   *
+   * Called when the visible area changes, after which the view repaints so only what's still visible is requested again.
+   */
+  void CancelThumbnails();
+
   TimelineCoordinate ScreenToCoordinate(const QPoint& pt);
   TimelineCoordinate SceneToCoordinate(const QPointF& pt);
 
@@ -116,14 +135,24 @@ private:
 
   QVector<int> track_heights_;
 
+  int track_count_;
+
   TimelineViewEndItem* end_item_;
 
   TimelinePlayhead playhead_style_;
 
   rational GetPlayheadTime();
 
+  /**
+   * @brief Work out the strip of the viewport the playhead currently covers
+   */
   void UpdatePlayheadRect();
 
+  /**
+   * @brief Strip of the viewport the playhead was last drawn in
+   *
+   * Moving the playhead only repaints this and the strip it moves to rather than the whole viewport.
+   */
   QRect playhead_rect_;
 
   TrackType type_;
@@ -134,6 +163,11 @@ private slots:
    */
   void UpdateSceneRect();
 
+  /**
+   * @brief Repaints the viewport when a thumbnail arrives, whichever viewport is current
+   */
+  void ThumbnailReady();
+
 };
 
 #endif // TIMELINEVIEW_H
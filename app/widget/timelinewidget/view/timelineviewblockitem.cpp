@@ -20,19 +20,28 @@
 
 #include "timelineviewblockitem.h"
 
+#include <cmath>
 #include <QBrush>
 #include <QGraphicsScene>
 #include <QGraphicsSceneMouseEvent>
 #include <QPainter>
 #include <QStyleOptionGraphicsItem>
+#include <QtMath>
 
 #include "common/qtversionabstraction.h"
+#include "config/config.h"
+#include "node/input/media/media.h"
+#include "project/item/footage/imagestream.h"
+#include "render/thumbnailservice.h"
 
 TimelineViewBlockItem::TimelineViewBlockItem(QGraphicsItem* parent) :
   TimelineViewRect(parent),
   block_(nullptr)
 {
   setBrush(Qt::white);
+
+  // Waveforms and thumbnails are only drawn across the exposed part of the clip
+  setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
 }
 
 Block *TimelineViewBlockItem::block()
@@ -44,7 +53,8 @@ void TimelineViewBlockItem::SetBlock(Block *block)
 {
   block_ = block;
 
-  setFlag(QGraphicsItem::ItemIsSelectable, block_->type() == Block::kClip);
+  // Items are recycled between blocks, and can be left without one while they wait to be reused
+  setFlag(QGraphicsItem::ItemIsSelectable, block_ != nullptr && block_->type() == Block::kClip);
 
   UpdateRect();
 }
@@ -61,12 +71,19 @@ void TimelineViewBlockItem::UpdateRect()
   // -1 on width and height so we don't overlap any adjacent clips
   setRect(0, y_, item_width - 1, height_ - 1);
   setPos(item_left, 0.0);
+}
+
+QString TimelineViewBlockItem::GetToolTip()
+{
+  if (block_ == nullptr) {
+    return QString();
+  }
 
   // FIXME: Untranslated
-  setToolTip(QString("%1\n\nIn: %2\nOut: %3\nMedia In: %4").arg(block_->Name(),
-                                                                QString::number(block_->in().toDouble()),
-                                                                QString::number(block_->out().toDouble()),
-                                                                QString::number(block_->media_in().toDouble())));
+  return QString("%1\n\nIn: %2\nOut: %3\nMedia In: %4").arg(block_->Name(),
+                                                           QString::number(block_->in().toDouble()),
+                                                           QString::number(block_->out().toDouble()),
+                                                           QString::number(block_->media_in().toDouble()));
 }
 
 void TimelineViewBlockItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
@@ -87,6 +104,20 @@ void TimelineViewBlockItem::paint(QPainter *painter, const QStyleOptionGraphicsI
     painter->fillRect(rect(), grad);*/
     painter->fillRect(rect(), QColor(128, 128, 192));
 
+    {
+      StreamPtr stream = GetStream();
+
+      if (stream && (stream->type() == Stream::kVideo || stream->type() == Stream::kImage)) {
+        PaintThumbnails(painter, stream, option->exposedRect);
+      }
+
+      WaveformSummary* waveform = GetWaveform();
+
+      if (waveform) {
+        PaintWaveform(painter, waveform, option->exposedRect);
+      }
+    }
+
     if (option->state & QStyle::State_Selected) {
       painter->fillRect(rect(), QColor(0, 0, 0, 64));
     }
@@ -122,3 +153,141 @@ void TimelineViewBlockItem::paint(QPainter *painter, const QStyleOptionGraphicsI
     break;
   }
 }
+
+StreamPtr TimelineViewBlockItem::GetStream()
+{
+  MediaInput* media = dynamic_cast<MediaInput*>(static_cast<ClipBlock*>(block_)->texture_input()->get_connected_node());
+
+  if (!media) {
+    return nullptr;
+  }
+
+  return media->footage();
+}
+
+WaveformSummary *TimelineViewBlockItem::GetWaveform()
+{
+  StreamPtr stream = GetStream();
+
+  if (!stream || stream->type() != Stream::kAudio) {
+    return nullptr;
+  }
+
+  QString filename = WaveformSummary::GetFilename(stream.get());
+
+  if (!waveform_ || waveform_->filename() != filename) {
+    waveform_ = std::unique_ptr<WaveformSummary>(new WaveformSummary(filename));
+  }
+
+  // The summary is written when the stream is indexed, so keep trying until it exists
+  if (!waveform_->is_open() && !waveform_->open()) {
+    return nullptr;
+  }
+
+  return waveform_.get();
+}
+
+void TimelineViewBlockItem::PaintWaveform(QPainter *painter, WaveformSummary *waveform, const QRectF &exposed)
+{
+  int channels = waveform->channel_count();
+  QRectF area = rect().intersected(exposed);
+
+  if (channels == 0 || area.isEmpty()) {
+    return;
+  }
+
+  double channel_height = rect().height() / channels;
+  double samples_per_pixel = waveform->sample_rate() / scale_;
+  double media_in = block_->media_in().toDouble() * waveform->sample_rate();
+
+  int first_x = qFloor(area.left());
+  int last_x = qCeil(area.right());
+
+  QVector<QLineF> peak_lines;
+  QVector<QLineF> rms_lines;
+  peak_lines.reserve((last_x - first_x) * channels);
+  rms_lines.reserve((last_x - first_x) * channels);
+
+  for (int i=0;i<channels;i++) {
+    double center = rect().top() + channel_height * (i + 0.5);
+    double half_height = channel_height * 0.5;
+
+    for (int x=first_x;x<last_x;x++) {
+      qint64 start = qFloor(media_in + x * samples_per_pixel);
+      qint64 end = qMax(start + 1, static_cast<qint64>(qFloor(media_in + (x + 1) * samples_per_pixel)));
+
+      float min, max, rms;
+
+      if (!waveform->Summarize(start, end, i, &min, &max, &rms)) {
+        continue;
+      }
+
+      peak_lines.append(QLineF(x, center - max * half_height, x, center - min * half_height));
+
+      // RMS can't exceed the peaks, but clamp it so rounding doesn't draw it outside them
+      rms_lines.append(QLineF(x, center - qMin(rms, max) * half_height, x, center - qMax(-rms, min) * half_height));
+    }
+  }
+
+  painter->setPen(QColor(64, 64, 128));
+  painter->drawLines(peak_lines);
+
+  painter->setPen(QColor(96, 96, 160));
+  painter->drawLines(rms_lines);
+}
+
+void TimelineViewBlockItem::PaintThumbnails(QPainter *painter, StreamPtr stream, const QRectF &exposed)
+{
+  QRectF area = rect().intersected(exposed);
+  ImageStream* image_stream = static_cast<ImageStream*>(stream.get());
+
+  if (area.isEmpty() || ThumbnailService::instance() == nullptr || image_stream->height() <= 0) {
+    return;
+  }
+
+  // Thumbnails fill the height of the clip at the footage's aspect ratio
+  double tile_height = rect().height();
+  double tile_width = tile_height * image_stream->width() / image_stream->height();
+
+  if (tile_width < 1.0) {
+    return;
+  }
+
+  // Snap each tile's time to a power-of-two number of seconds around how much time a tile covers at this scale. This
+  // keeps the number of different thumbnails proportional to the number of tiles, and lets nearby zoom levels (and
+  // every scroll position) share the same ones.
+  int quantum_exponent = qBound(kMinimumThumbnailExponent,
+                                qCeil(std::log2(tile_width / scale_)),
+                                kMaximumThumbnailExponent);
+
+  rational quantum = (quantum_exponent >= 0) ? rational(1LL << quantum_exponent)
+                                             : rational(1, 1LL << -quantum_exponent);
+  double quantum_dbl = quantum.toDouble();
+
+  int size = Config::Current()["ThumbnailResolution"].toInt();
+
+  painter->save();
+  painter->setClipRect(area);
+
+  // Only tiles overlapping the exposed area are requested, so nothing is decoded for parts of clips that are off-screen
+  for (int i=qFloor((area.left() - rect().left()) / tile_width);rect().left() + i * tile_width < area.right();i++) {
+    QRectF tile(rect().left() + i * tile_width, rect().top(), tile_width, tile_height);
+
+    rational time = 0;
+
+    if (stream->type() == Stream::kVideo) {
+      double tile_time = block_->media_in().toDouble() + (tile.left() - rect().left()) / scale_;
+
+      time = quantum * rational(qFloor(tile_time / quantum_dbl));
+    }
+
+    // Tagged with the scene so the view can cancel everything it asked for when it scrolls or zooms
+    QImage thumbnail = ThumbnailService::instance()->Get(stream, time, size, scene());
+
+    if (!thumbnail.isNull()) {
+      painter->drawImage(tile, thumbnail);
+    }
+  }
+
+  painter->restore();
+}
@@ -21,7 +21,10 @@
 #ifndef TIMELINEVIEWCLIPITEM_H
 #define TIMELINEVIEWCLIPITEM_H
 
+#include <memory>
+
 #include "timelineviewrect.h"
+#include "decoder/waveformsummary.h"
 #include "node/block/clip/clip.h"
 
 /**
@@ -37,12 +40,54 @@ public:
 
   virtual void UpdateRect() override;
 
+  /**
+   * @brief Describe the block for a tooltip
+   *
+   * Built whenever a tooltip is actually shown rather than stored with setToolTip(), since blocks change far more
+   * often than anyone hovers over one.
+   */
+  QString GetToolTip();
+
 protected:
   virtual void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = nullptr) override;
 
 private:
+  /**
+   * @brief Returns the footage stream this clip plays, or nullptr if it isn't connected to any
+   */
+  StreamPtr GetStream();
+
+  /**
+   * @brief Returns the waveform summary of the audio this clip plays, or nullptr if it has none (yet)
+   */
+  WaveformSummary* GetWaveform();
+
+  /**
+   * @brief Draw the waveform of every channel across the part of the clip that's exposed
+   */
+  void PaintWaveform(QPainter* painter, WaveformSummary* waveform, const QRectF& exposed);
+
+  /**
+   * @brief Draw a filmstrip of thumbnails across the part of the clip that's exposed
+   *
+   * Tiles are as wide as a thumbnail at the clip's height, and each shows a time snapped to the amount of media a tile
+   * covers at the current scale, so the same thumbnails are reused as the timeline is scrolled and zoomed rather than
+   * a new one being needed for every pixel.
+   */
+  void PaintThumbnails(QPainter* painter, StreamPtr stream, const QRectF& exposed);
+
+  /**
+   * @brief Range of the power-of-two number of seconds a filmstrip tile's time is snapped to
+   *
+   * 2^-5 is around a frame at common frame rates, and 2^20 seconds is far longer than any clip.
+   */
+  static const int kMinimumThumbnailExponent = -5;
+  static const int kMaximumThumbnailExponent = 20;
+
   Block* block_;
 
+  std::unique_ptr<WaveformSummary> waveform_;
+
 };
 
 #endif // TIMELINEVIEWCLIPITEM_H
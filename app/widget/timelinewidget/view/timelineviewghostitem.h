@@ -37,7 +37,8 @@ public:
   enum DataType {
     kAttachedBlock,
     kReferenceBlock,
-    kAttachedFootage
+    kAttachedFootage,
+    kAttachedSequence
   };
 
   TimelineViewGhostItem(QGraphicsItem* parent = nullptr);
@@ -30,13 +30,37 @@
 #include "config/config.h"
 #include "core.h"
 
+namespace {
+
+QColor FrameStatusColor(olive::FrameStatus status)
+{
+  switch (status) {
+  case olive::kFrameQueued:
+    return QColor(192, 64, 64);
+  case olive::kFrameRendering:
+    return QColor(224, 160, 32);
+  case olive::kFrameCached:
+    return QColor(64, 160, 64);
+  case olive::kFrameEmpty:
+    break;
+  }
+
+  return QColor();
+}
+
+}
+
 TimeRuler::TimeRuler(bool text_visible, QWidget* parent) :
   QWidget(parent),
+  in_out_set_(false),
+  in_point_(0),
+  out_point_(0),
   scroll_(0),
   centered_text_(true),
   scale_(1.0),
   time_(0),
-  snapping_(false)
+  snapping_(false),
+  tile_timecode_display_(olive::CurrentTimecodeDisplay())
 {
   QFontMetrics fm = fontMetrics();
 
@@ -52,6 +76,9 @@ TimeRuler::TimeRuler(bool text_visible, QWidget* parent) :
   // Set width of playhead marker
   playhead_width_ = minimum_gap_between_lines_;
 
+  // Thin enough to stay out of the way of the frame lines
+  frame_status_height_ = qMax(2, text_height_ / 6);
+
   // Text visibility affects height, so we set that here
   SetTextVisible(text_visible);
 }
@@ -60,6 +87,8 @@ void TimeRuler::SetTextVisible(bool e)
 {
   text_visible_ = e;
 
+  InvalidateTiles();
+
   // Text visibility affects height, if text is visible the widget doubles in height with the top half for text and
   // the bottom half for ruler markings
   if (text_visible_) {
@@ -80,6 +109,8 @@ void TimeRuler::SetScale(const double &d)
 {
   scale_ = d;
 
+  InvalidateTiles();
+
   update();
 }
 
@@ -91,6 +122,8 @@ void TimeRuler::SetTimebase(const rational &r)
 
   timebase_flipped_dbl_ = timebase_.flipped().toDouble();
 
+  InvalidateTiles();
+
   update();
 }
 
@@ -106,9 +139,11 @@ const int64_t &TimeRuler::GetTime()
 
 void TimeRuler::SetTime(const int64_t &r)
 {
+  update(GetPlayheadRect());
+
   time_ = r;
 
-  update();
+  update(GetPlayheadRect());
 }
 
 void TimeRuler::SetScroll(int s)
@@ -118,15 +153,93 @@ void TimeRuler::SetScroll(int s)
   update();
 }
 
-void TimeRuler::paintEvent(QPaintEvent *)
+void TimeRuler::SetFrameStatus(const FrameStatusSpans &spans)
+{
+  frame_status_.Apply(spans);
+
+  foreach (const FrameStatusSpan& span, spans) {
+    update(GetFrameStatusRect(span.in, span.out));
+  }
+}
+
+void TimeRuler::ClearFrameStatus()
+{
+  frame_status_.Clear();
+
+  update();
+}
+
+void TimeRuler::SetInOut(int64_t in, int64_t out)
+{
+  in_out_set_ = true;
+  in_point_ = in;
+  out_point_ = out;
+
+  update();
+}
+
+void TimeRuler::ClearInOut()
+{
+  in_out_set_ = false;
+
+  update();
+}
+
+void TimeRuler::paintEvent(QPaintEvent *e)
 {
   // Nothing to paint if the timebase is invalid
   if (timebase_.isNull()) {
     return;
   }
 
+  if (tile_timecode_display_ != olive::CurrentTimecodeDisplay()) {
+    InvalidateTiles();
+    tile_timecode_display_ = olive::CurrentTimecodeDisplay();
+  }
+
   QPainter p(this);
 
+  // Copy the tiles of lines and timecodes that the exposed area covers
+  int first_tile = TileAt(e->rect().left() + scroll_);
+  int last_tile = TileAt(e->rect().right() + scroll_);
+
+  for (int i=first_tile;i<=last_tile;i++) {
+    p.drawPixmap(i * kTileWidth - scroll_, 0, GetTile(i, first_tile, last_tile));
+  }
+
+  // Shade the in/out range over the whole height of the ruler
+  if (in_out_set_ && out_point_ > in_point_) {
+    QRect in_out_rect = GetFrameStatusRect(in_point_, out_point_ - 1);
+
+    if (!in_out_rect.isNull()) {
+      QColor in_out_color = palette().highlight().color();
+      in_out_color.setAlpha(64);
+
+      p.fillRect(QRect(in_out_rect.x(), 0, in_out_rect.width(), height()), in_out_color);
+    }
+  }
+
+  // Draw the frame status strip under the lines
+  if (!frame_status_.isEmpty()) {
+    FrameStatusSpans spans = frame_status_.Spans(qMax(static_cast<int64_t>(0), ScreenToUnit(e->rect().left())),
+                                                 ScreenToUnit(e->rect().right() + 1));
+
+    foreach (const FrameStatusSpan& span, spans) {
+      p.fillRect(GetFrameStatusRect(span.in, span.out), FrameStatusColor(span.status));
+    }
+  }
+
+  // Draw the playhead if it's on screen at the moment
+  int playhead_pos = qFloor(static_cast<double>(time_) * scale_ * timebase_dbl_) - scroll_;
+  if (playhead_pos + playhead_width_ >= 0 && playhead_pos - playhead_width_ < width()) {
+    p.setPen(Qt::NoPen);
+    p.setBrush(style_.PlayheadColor());
+    DrawPlayhead(&p, playhead_pos, height());
+  }
+}
+
+void TimeRuler::DrawTicks(QPainter *p, int left, int right)
+{
   int64_t last_unit = -1;
   int last_sec = -1;
 
@@ -145,36 +258,36 @@ void TimeRuler::paintEvent(QPaintEvent *)
   double reverse_divider = double(rough_frames_in_second) / double(test_divider);
   qreal real_divider = qMax(1.0, timebase_flipped_dbl_ / reverse_divider);
 
-  // Set where the loop ends (affected by text)
-  int loop_start = - playhead_width_;
-  int loop_end = width() + playhead_width_;
+  int loop_start = left;
+  int loop_end = right;
 
   // Determine where it can draw text
   int text_skip = 1;
   int half_average_text_width = 0;
   int text_y = 0;
   if (text_visible_) {
-    QFontMetrics fm = p.fontMetrics();
+    QFontMetrics fm = p->fontMetrics();
     double width_of_second = scale_;
-    int average_text_width = QFontMetricsWidth(fm, olive::timestamp_to_timecode(0, timebase_, olive::CurrentTimecodeDisplay()));
+    int average_text_width = QFontMetricsWidth(fm, olive::timestamp_to_timecode(0, timebase_, tile_timecode_display_));
     half_average_text_width = average_text_width/2;
     while (width_of_second * text_skip < average_text_width) {
       text_skip++;
     }
 
+    // Start far enough to the left that the text of any second just outside the area is still drawn, and that the
+    // first line drawn (always treated as a new second, wherever it is) can't put text inside it
+    loop_start -= average_text_width + half_average_text_width;
+
     if (centered_text_) {
-      loop_start = -half_average_text_width;
       loop_end += half_average_text_width;
-    } else {
-      loop_start = -average_text_width;
     }
 
     text_y = fm.ascent();
   }
 
   // Set line color to main text color
-  p.setBrush(Qt::NoBrush);
-  p.setPen(palette().text().color());
+  p->setBrush(Qt::NoBrush);
+  p->setPen(palette().text().color());
 
   // Calculate where each line starts
   int line_top = text_visible_ ? text_height_ : 0;
@@ -186,7 +299,7 @@ void TimeRuler::paintEvent(QPaintEvent *)
   int line_frame_bottom = line_top + line_length / 3;
 
   for (int i=loop_start;i<loop_end;i++) {
-    int64_t unit = ScreenToUnit(i);
+    int64_t unit = qFloor(i / scale_ / timebase_dbl_);
 
     // Check if enough space has passed since the last line drawn
     if (qFloor(double(unit)/real_divider) > qFloor(double(last_unit)/real_divider)) {
@@ -196,13 +309,13 @@ void TimeRuler::paintEvent(QPaintEvent *)
 
       if (sec > last_sec) {
         // This line marks a second so we make it long
-        p.drawLine(i, line_top, i, line_sec_bottom);
+        p->drawLine(i, line_top, i, line_sec_bottom);
 
         last_sec = sec;
 
         // Try to draw text here
         if (text_visible_ && sec%text_skip == 0) {
-          QString timecode_string = olive::timestamp_to_timecode(sec, timebase_, olive::CurrentTimecodeDisplay());
+          QString timecode_string = olive::timestamp_to_timecode(sec, timebase_, tile_timecode_display_);
 
           int text_x = i;
 
@@ -210,33 +323,93 @@ void TimeRuler::paintEvent(QPaintEvent *)
             text_x -= half_average_text_width;
           } else {
             timecode_string.prepend(" ");
-            p.drawLine(i, 0, i, line_top);
+            p->drawLine(i, 0, i, line_top);
           }
 
-          p.drawText(text_x, text_y, timecode_string);
+          p->drawText(text_x, text_y, timecode_string);
         }
       } else if (unit%rough_frames_in_second == rough_frames_in_second/2) {
 
         // This line marks the half second point so we make it somewhere in between
-        p.drawLine(i, line_top, i, line_halfsec_bottom);
+        p->drawLine(i, line_top, i, line_halfsec_bottom);
 
       } else {
 
         // This line just marks a frame so we make it short
-        p.drawLine(i, line_top, i, line_frame_bottom);
+        p->drawLine(i, line_top, i, line_frame_bottom);
 
       }
 
       last_unit = unit;
     }
   }
+}
 
-  // Draw the playhead if it's on screen at the moment
-  int playhead_pos = qFloor(static_cast<double>(time_) * scale_ * timebase_dbl_) - scroll_;
-  if (playhead_pos + playhead_width_ >= 0 && playhead_pos - playhead_width_ < width()) {
-    p.setPen(Qt::NoPen);
-    p.setBrush(style_.PlayheadColor());
-    DrawPlayhead(&p, playhead_pos, height());
+const QPixmap &TimeRuler::GetTile(int index, int first_visible, int last_visible)
+{
+  QHash<int, QPixmap>::const_iterator existing = tiles_.constFind(index);
+  if (existing != tiles_.constEnd()) {
+    return existing.value();
+  }
+
+  // Keep the cache from growing while scrolling along a long sequence
+  if (tiles_.size() >= kMaximumTileCount) {
+    QHash<int, QPixmap>::iterator i = tiles_.begin();
+    while (i != tiles_.end()) {
+      if (i.key() < first_visible || i.key() > last_visible) {
+        i = tiles_.erase(i);
+      } else {
+        i++;
+      }
+    }
+  }
+
+  qreal dpr = devicePixelRatioF();
+
+  QPixmap tile(qCeil(kTileWidth * dpr), qCeil(height() * dpr));
+  tile.setDevicePixelRatio(dpr);
+  tile.fill(Qt::transparent);
+
+  QPainter tile_painter(&tile);
+  tile_painter.setFont(font());
+
+  int left = index * kTileWidth;
+  tile_painter.translate(-left, 0);
+  DrawTicks(&tile_painter, left, left + kTileWidth);
+  tile_painter.end();
+
+  return *tiles_.insert(index, tile);
+}
+
+void TimeRuler::InvalidateTiles()
+{
+  tiles_.clear();
+}
+
+int TimeRuler::TileAt(int x)
+{
+  return qFloor(static_cast<double>(x) / kTileWidth);
+}
+
+void TimeRuler::resizeEvent(QResizeEvent *event)
+{
+  QWidget::resizeEvent(event);
+
+  // Tiles are as high as the ruler
+  if (event->size().height() != event->oldSize().height()) {
+    InvalidateTiles();
+  }
+}
+
+void TimeRuler::changeEvent(QEvent *event)
+{
+  QWidget::changeEvent(event);
+
+  if (event->type() == QEvent::FontChange
+      || event->type() == QEvent::PaletteChange
+      || event->type() == QEvent::StyleChange) {
+    InvalidateTiles();
+    update();
   }
 }
 
@@ -252,6 +425,37 @@ void TimeRuler::mouseMoveEvent(QMouseEvent *event)
   }
 }
 
+QRect TimeRuler::GetPlayheadRect()
+{
+  int playhead_pos = qFloor(static_cast<double>(time_) * scale_ * timebase_dbl_) - scroll_;
+  int half_width = playhead_width_ / 2;
+
+  // Pad by a pixel either side to cover antialiasing
+  return QRect(playhead_pos - half_width - 1, 0, playhead_width_ + 3, height());
+}
+
+QRect TimeRuler::GetFrameStatusRect(int64_t in, int64_t out)
+{
+  if (timebase_.isNull()) {
+    return QRect();
+  }
+
+  double frame_width = scale_ * timebase_dbl_;
+
+  // Spans can reach far past the end of the sequence, so they're clipped before converting back to ints
+  double left = qMax(-1.0, static_cast<double>(in) * frame_width - scroll_);
+  double right = qMin(static_cast<double>(width()), (static_cast<double>(out) + 1.0) * frame_width - scroll_);
+
+  if (right < left) {
+    return QRect();
+  }
+
+  int x = qFloor(left);
+
+  // Always at least a pixel wide so a frame is visible however far out the ruler's zoomed
+  return QRect(x, height() - frame_status_height_, qMax(1, qCeil(right) - x), frame_status_height_);
+}
+
 void TimeRuler::DrawPlayhead(QPainter *p, int x, int y)
 {
   p->setRenderHint(QPainter::Antialiasing);
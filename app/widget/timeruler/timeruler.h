@@ -21,10 +21,14 @@
 #ifndef TIMERULER_H
 #define TIMERULER_H
 
+#include <QHash>
+#include <QPixmap>
 #include <QTimer>
 #include <QWidget>
 
 #include "common/rational.h"
+#include "common/timecodefunctions.h"
+#include "render/framestatus.h"
 #include "widget/timelinewidget/view/timelineplayhead.h"
 
 class TimeRuler : public QWidget
@@ -51,12 +55,33 @@ public slots:
 
   void SetScroll(int s);
 
+  /**
+   * @brief Update the strip along the bottom that shows which frames are cached, rendering or queued
+   *
+   * Spans are in frames of the ruler's timebase (see VideoRenderBackend::FrameStatusChanged()). Only the parts of the
+   * strip they cover are repainted.
+   */
+  void SetFrameStatus(const FrameStatusSpans& spans);
+
+  void ClearFrameStatus();
+
+  /**
+   * @brief Highlight the range from `in` up to (but not including) `out`, in frames of the ruler's timebase
+   */
+  void SetInOut(int64_t in, int64_t out);
+
+  void ClearInOut();
+
 protected:
   virtual void paintEvent(QPaintEvent* e) override;
 
   virtual void mousePressEvent(QMouseEvent *event) override;
   virtual void mouseMoveEvent(QMouseEvent *event) override;
 
+  virtual void resizeEvent(QResizeEvent *event) override;
+
+  virtual void changeEvent(QEvent *event) override;
+
 signals:
   /**
    * @brief Signal emitted whenever the time changes on this ruler, either by user or programatically
@@ -66,6 +91,42 @@ signals:
 private:
   void DrawPlayhead(QPainter* p, int x, int y);
 
+  /**
+   * @brief Draw the lines and timecodes between `left` and `right`, which are in unscrolled widget coordinates
+   */
+  void DrawTicks(QPainter* p, int left, int right);
+
+  /**
+   * @brief Retrieve the lines and timecodes from kTileWidth * `index` onwards, drawing them if they aren't cached
+   *
+   * Lines and timecodes only change with the scale, timebase, timecode display and look of the ruler, so they're drawn
+   * once into tiles in unscrolled coordinates. Painting (e.g. every time the playhead moves) only copies the tiles the
+   * exposed area covers, and scrolling reuses the tiles that are still in view.
+   */
+  const QPixmap& GetTile(int index, int first_visible, int last_visible);
+
+  /**
+   * @brief Discard every cached tile so they're drawn again with current settings
+   */
+  void InvalidateTiles();
+
+  /**
+   * @brief Index of the tile that unscrolled widget coordinate `x` is in
+   */
+  static int TileAt(int x);
+
+  /**
+   * @brief Area of the ruler the playhead covers at the current time and scroll
+   *
+   * Moving the playhead only repaints this before and after the move rather than the whole ruler.
+   */
+  QRect GetPlayheadRect();
+
+  /**
+   * @brief Area of the frame status strip covering these frames, clipped to the widget
+   */
+  QRect GetFrameStatusRect(int64_t in, int64_t out);
+
   double ScreenToUnitFloat(int screen);
 
   int64_t ScreenToUnit(int screen);
@@ -78,6 +139,16 @@ private:
 
   int playhead_width_;
 
+  int frame_status_height_;
+
+  FrameStatusMap frame_status_;
+
+  bool in_out_set_;
+
+  int64_t in_point_;
+
+  int64_t out_point_;
+
   int scroll_;
 
   bool text_visible_;
@@ -98,6 +169,20 @@ private:
 
   bool snapping_;
 
+  static const int kTileWidth = 512;
+
+  /**
+   * @brief Most tiles cached before ones out of view are discarded
+   */
+  static const int kMaximumTileCount = 16;
+
+  QHash<int, QPixmap> tiles_;
+
+  /**
+   * @brief Timecode display tiles_ were drawn with, it's a global setting so it's checked before painting
+   */
+  olive::TimecodeDisplay tile_timecode_display_;
+
 };
 
 #endif // TIMERULER_H
@@ -20,19 +20,28 @@
 
 #include "viewer.h"
 
-#include <QDateTime>
 #include <QLabel>
 #include <QResizeEvent>
 #include <QtMath>
 #include <QVBoxLayout>
 
 #include "audio/audiomanager.h"
+#include "common/memorybudget.h"
 #include "common/timecodefunctions.h"
 #include "config/config.h"
+#include "decoder/decoder.h"
+#include "project/item/footage/videostream.h"
+#include "render/backend/opengl/openglmemorybudget.h"
 
 ViewerWidget::ViewerWidget(QWidget *parent) :
   QWidget(parent),
+  dropped_frames_(0),
+  cache_lead_(-1),
+  cache_lead_trend_(0),
+  quality_settle_frames_(0),
+  adaptive_playback_(false),
   viewer_node_(nullptr),
+  multicam_angle_(-1),
   playback_speed_(0)
 {
   // Set up main layout
@@ -45,6 +54,7 @@ ViewerWidget::ViewerWidget(QWidget *parent) :
 
   gl_widget_ = new ViewerGLWidget();
   sizer_->SetWidget(gl_widget_);
+  connect(gl_widget_, SIGNAL(StatisticsVisibleChanged(bool)), this, SLOT(StatisticsVisibleChanged(bool)));
 
   // Create time ruler
   ruler_ = new TimeRuler(false);
@@ -70,16 +80,27 @@ ViewerWidget::ViewerWidget(QWidget *parent) :
   layout->addWidget(controls_);
 
   // Connect timer
+  playback_timer_.setTimerType(Qt::PreciseTimer);
   connect(&playback_timer_, SIGNAL(timeout()), this, SLOT(PlaybackTimerUpdate()));
 
+  statistics_timer_.setInterval(500);
+  connect(&statistics_timer_, SIGNAL(timeout()), this, SLOT(UpdateStatistics()));
+
   // FIXME: Magic number
   ruler_->SetScale(48.0);
 
   // Start background renderers
   video_renderer_ = new OpenGLBackend(this);
+  video_renderer_->SetMemoryCompression(true);
+  video_renderer_->SetBackground(true);
   connect(video_renderer_, SIGNAL(CachedFrameReady(const rational&, QVariant)), this, SLOT(RendererCachedFrame(const rational&, QVariant)));
   connect(video_renderer_, SIGNAL(CachedTimeReady(const rational&)), this, SLOT(RendererCachedTime(const rational&)));
+  connect(video_renderer_, SIGNAL(FrameStatusChanged(const FrameStatusSpans&)), this, SIGNAL(FrameStatusChanged(const FrameStatusSpans&)));
   audio_renderer_ = new AudioBackend(this);
+  audio_renderer_->SetBackground(true);
+
+  footage_previewer_ = new FootagePreviewer(this);
+  connect(footage_previewer_, SIGNAL(FrameReady(const rational&, FramePtr)), this, SLOT(FootageFrameReady(const rational&, FramePtr)));
 }
 
 void ViewerWidget::SetTimebase(const rational &r)
@@ -90,7 +111,8 @@ void ViewerWidget::SetTimebase(const rational &r)
   ruler_->SetTimebase(r);
   controls_->SetTimebase(r);
 
-  playback_timer_.setInterval(qFloor(r.toDouble()));
+  // Check the clock twice per frame so frame changes are never more than half a frame late
+  playback_timer_.setInterval(qMax(1, qFloor(r.toDouble() * 1000 / 2)));
 }
 
 const double &ViewerWidget::scale()
@@ -128,8 +150,15 @@ bool ViewerWidget::IsPlaying()
   return playback_timer_.isActive();
 }
 
+int ViewerWidget::dropped_frames() const
+{
+  return dropped_frames_;
+}
+
 void ViewerWidget::ConnectViewerNode(ViewerOutput *node)
 {
+  CloseFootage();
+
   if (viewer_node_ != nullptr) {
     SetTimebase(0);
 
@@ -166,13 +195,122 @@ void ViewerWidget::DisconnectViewerNode()
   ConnectViewerNode(nullptr);
 }
 
+void ViewerWidget::ConnectFootage(const QList<StreamPtr> &angles)
+{
+  if (viewer_node_ != nullptr) {
+    ConnectViewerNode(nullptr);
+  }
+
+  CloseFootage();
+
+  foreach (StreamPtr stream, angles) {
+    if (stream != nullptr && (stream->type() == Stream::kVideo || stream->type() == Stream::kImage)) {
+      footage_streams_.append(stream);
+    }
+  }
+
+  if (footage_streams_.isEmpty()) {
+    return;
+  }
+
+  // The first angle sets the frame rate, the multicam runs for as long as its longest angle
+  StreamPtr first_stream = footage_streams_.first();
+
+  if (first_stream->type() == Stream::kVideo) {
+    SetTimebase(std::static_pointer_cast<VideoStream>(first_stream)->frame_rate().flipped());
+  } else {
+    SetTimebase(Config::Current()["DefaultSequenceFrameRate"].value<rational>().flipped());
+  }
+
+  footage_length_ = 0;
+
+  foreach (StreamPtr stream, footage_streams_) {
+    rational length;
+
+    if (stream->type() == Stream::kVideo) {
+      length = rational(stream->timebase().numerator() * stream->duration(), stream->timebase().denominator());
+    } else {
+      // Stills are length-less, show them for as long as they'd be on a timeline
+      length = Config::Current()["DefaultStillLength"].value<rational>();
+    }
+
+    footage_length_ = qMax(footage_length_, length);
+  }
+
+  LengthChangedSlot(footage_length_);
+
+  footage_previewer_->SetStreams(footage_streams_);
+
+  SetMulticamAngle(-1);
+}
+
+void ViewerWidget::SetMulticamAngle(int angle)
+{
+  if (footage_streams_.isEmpty()) {
+    return;
+  }
+
+  if (angle >= footage_streams_.size() || footage_streams_.size() == 1) {
+    angle = -1;
+  }
+
+  multicam_angle_ = angle;
+
+  // The grid is the size of the first angle
+  ImageStreamPtr shown_stream = std::static_pointer_cast<ImageStream>(footage_streams_.at(qMax(0, angle)));
+  SizeChangedSlot(shown_stream->width(), shown_stream->height());
+
+  footage_previewer_->SetActiveAngle(angle);
+
+  UpdateTextureFromNode(GetTime());
+}
+
+int ViewerWidget::multicam_angle() const
+{
+  return multicam_angle_;
+}
+
+int ViewerWidget::multicam_angle_count() const
+{
+  return footage_streams_.size();
+}
+
+void ViewerWidget::CloseFootage()
+{
+  if (footage_streams_.isEmpty()) {
+    return;
+  }
+
+  footage_previewer_->SetStreams(QList<StreamPtr>());
+  footage_streams_.clear();
+  multicam_angle_ = -1;
+
+  SetTimebase(0);
+  SizeChangedSlot(0, 0);
+  SetTexture(nullptr);
+
+  if (footage_texture_ != nullptr) {
+    // Textures can only be deleted in the context they were made in
+    gl_widget_->makeCurrent();
+    footage_texture_->Destroy();
+    gl_widget_->doneCurrent();
+
+    footage_texture_ = nullptr;
+  }
+}
+
 void ViewerWidget::SetTexture(OpenGLTexturePtr tex)
 {
+  // Hold a reference so the texture isn't freed or recycled by the renderer while it's on screen
+  texture_ = tex;
+
   if (tex == nullptr) {
     gl_widget_->SetTexture(0);
   } else {
     gl_widget_->SetTexture(tex->texture());
   }
+
+  emit TextureChanged(tex);
 }
 
 void ViewerWidget::UpdateTimeInternal(int64_t i)
@@ -185,6 +323,8 @@ void ViewerWidget::UpdateTimeInternal(int64_t i)
     UpdateTextureFromNode(time_set);
 
     PushScrubbedAudio();
+  } else if (!footage_streams_.isEmpty()) {
+    UpdateTextureFromNode(time_set);
   }
 
   emit TimeChanged(i);
@@ -192,10 +332,14 @@ void ViewerWidget::UpdateTimeInternal(int64_t i)
 
 void ViewerWidget::UpdateTextureFromNode(const rational& time)
 {
-  if (viewer_node_ == nullptr) {
+  if (!footage_streams_.isEmpty()) {
+    // Read ahead in the direction we're playing in, if we are
+    footage_previewer_->Request(time, qBound(-1, playback_speed_, 1));
+  } else if (viewer_node_ == nullptr) {
     SetTexture(nullptr);
   } else {
-    SetTexture(video_renderer_->GetCachedFrameAsTexture(time));
+    // The current frame stays up until the new one arrives in RendererCachedFrame()
+    video_renderer_->RequestCachedFrame(time);
   }
 }
 
@@ -215,9 +359,19 @@ void ViewerWidget::PlayInternal(int speed)
     AudioManager::instance()->StartOutput(audio_src);
   }
 
-  start_msec_ = QDateTime::currentMSecsSinceEpoch();
+  playback_clock_.start();
+  audio_clock_synced_ = false;
+  last_clock_usecs_ = 0;
   start_timestamp_ = ruler_->GetTime();
+  dropped_frames_ = 0;
   playback_speed_ = speed;
+  cache_lead_ = -1;
+  cache_lead_trend_ = 0;
+  quality_settle_frames_ = kAdaptiveSettleFrames;
+  adaptive_playback_ = Config::Current()["AdaptivePlayback"].toBool();
+
+  // Let the renderer prioritize the frames we're about to show
+  video_renderer_->SetPlaybackSpeed(speed);
 
   playback_timer_.start();
 
@@ -262,6 +416,11 @@ void ViewerWidget::Pause()
   if (IsPlaying()) {
     AudioManager::instance()->StopOutput();
     playback_speed_ = 0;
+    video_renderer_->SetPlaybackSpeed(0);
+
+    // Refine whatever was rendered at a lower quality to keep up
+    video_renderer_->SetPreviewQuality(0);
+
     controls_->ShowPlayButton();
     playback_timer_.stop();
   }
@@ -294,6 +453,10 @@ void ViewerWidget::GoToEnd()
     Pause();
 
     SetTime(olive::time_to_timestamp(viewer_node_->Length(), time_base_));
+  } else if (!footage_streams_.isEmpty()) {
+    Pause();
+
+    SetTime(olive::time_to_timestamp(footage_length_, time_base_));
   }
 }
 
@@ -332,11 +495,31 @@ void ViewerWidget::ShuttleRight()
   }
 }
 
-void ViewerWidget::PlaybackTimerUpdate()
+qint64 ViewerWidget::GetPlaybackClock()
 {
-  int64_t real_time = QDateTime::currentMSecsSinceEpoch() - start_msec_;
+  qint64 clock = playback_clock_.nsecsElapsed() / 1000;
+  qint64 audio_clock = AudioManager::instance()->GetOutputPlayedUSecs();
+
+  if (audio_clock >= 0) {
+    // The audio device doesn't start at exactly the same time we did, so we measure its offset from our clock the
+    // first time we see it (or if it restarts and jumps back) and follow it from there
+    if (!audio_clock_synced_ || audio_clock - audio_clock_offset_ < last_clock_usecs_ - time_base_dbl_ * 1000000) {
+      audio_clock_offset_ = audio_clock - clock;
+      audio_clock_synced_ = true;
+    }
 
-  int64_t frames_since_start = qRound(static_cast<double>(real_time) / (time_base_dbl_ * 1000));
+    clock = audio_clock - audio_clock_offset_;
+  }
+
+  // Never go backwards, even if we switch between clocks
+  last_clock_usecs_ = qMax(last_clock_usecs_, clock);
+
+  return last_clock_usecs_;
+}
+
+void ViewerWidget::PlaybackTimerUpdate()
+{
+  int64_t frames_since_start = GetPlaybackClock() * time_base_.denominator() / (time_base_.numerator() * 1000000);
 
   int64_t current_time = start_timestamp_ + frames_since_start * playback_speed_;
 
@@ -345,7 +528,59 @@ void ViewerWidget::PlaybackTimerUpdate()
     Pause();
   }
 
+  int64_t last_time = ruler_->GetTime();
+
+  if (current_time == last_time) {
+    // Not time for the next frame yet, keep showing this one
+    return;
+  }
+
+  // Any frames we should have shown between the last one and this one were dropped
+  int64_t frames_advanced = qAbs(current_time - last_time) / qAbs(playback_speed_);
+
+  if (frames_advanced > 1) {
+    dropped_frames_ += static_cast<int>(frames_advanced - 1);
+  }
+
   SetTime(current_time);
+
+  AdaptPlaybackQuality();
+}
+
+void ViewerWidget::AdaptPlaybackQuality()
+{
+  // Footage is decoded as it's shown, so there's no cache to judge
+  if (!adaptive_playback_ || !IsPlaying() || viewer_node_ == nullptr) {
+    return;
+  }
+
+  int lead = video_renderer_->CachedFramesAhead(GetTime(), playback_speed_, kAdaptiveLookAhead);
+
+  if (cache_lead_ >= 0) {
+    // Frames tend to finish in bursts, so this is smoothed over the last several
+    cache_lead_trend_ = cache_lead_trend_ * 0.9 + (lead - cache_lead_) * 0.1;
+  }
+
+  cache_lead_ = lead;
+
+  if (quality_settle_frames_ > 0) {
+    // Give the renderer a chance to get ahead at this quality first
+    quality_settle_frames_--;
+    return;
+  }
+
+  int quality = video_renderer_->preview_quality();
+
+  // Either we've caught up with the cache or we're using it up faster than it's filled and will soon. Smaller frames
+  // also get textures back under the GPU memory budget before allocations start failing.
+  if (quality < VideoRenderBackend::kPreviewQualityLevels - 1
+      && (lead == 0 || (lead < kAdaptiveLowWater && cache_lead_trend_ < 0) || OpenGLMemoryBudget::UnderPressure())) {
+    video_renderer_->SetPreviewQuality(quality + 1);
+
+    cache_lead_ = -1;
+    cache_lead_trend_ = 0;
+    quality_settle_frames_ = kAdaptiveSettleFrames;
+  }
 }
 
 void ViewerWidget::RendererCachedFrame(const rational &time, QVariant value)
@@ -362,6 +597,44 @@ void ViewerWidget::RendererCachedTime(const rational &time)
   }
 }
 
+void ViewerWidget::FootageFrameReady(const rational &time, FramePtr frame)
+{
+  if (footage_streams_.isEmpty() || GetTime() != time) {
+    return;
+  }
+
+  if (frame == nullptr) {
+    // Nothing at this time, e.g. we're past the end of the stream
+    SetTexture(nullptr);
+    return;
+  }
+
+  if (gl_widget_->context() == nullptr) {
+    // Not shown yet, so there's nowhere to upload to
+    return;
+  }
+
+  gl_widget_->makeCurrent();
+
+  if (footage_texture_ == nullptr
+      || footage_texture_->width() != frame->width()
+      || footage_texture_->height() != frame->height()
+      || footage_texture_->format() != frame->format()) {
+    if (footage_texture_ != nullptr) {
+      footage_texture_->Destroy();
+    }
+
+    footage_texture_ = std::make_shared<OpenGLTexture>();
+    footage_texture_->Create(gl_widget_->context(), frame);
+  } else {
+    footage_texture_->Upload(frame->data());
+  }
+
+  gl_widget_->doneCurrent();
+
+  SetTexture(footage_texture_);
+}
+
 void ViewerWidget::SizeChangedSlot(int width, int height)
 {
   sizer_->SetChildSize(width, height);
@@ -377,3 +650,97 @@ void ViewerWidget::resizeEvent(QResizeEvent *event)
   // Set scrollbar page step to the width
   scrollbar_->setPageStep(event->size().width());
 }
+
+void ViewerWidget::StatisticsVisibleChanged(bool visible)
+{
+  if (visible) {
+    UpdateStatistics();
+    statistics_timer_.start();
+  } else {
+    statistics_timer_.stop();
+  }
+}
+
+void ViewerWidget::UpdateStatistics()
+{
+  VideoRenderBackend::Statistics stats = video_renderer_->GetStatistics();
+
+  QStringList lines;
+
+  int requests = stats.memory_hits + stats.disk_hits + stats.misses;
+
+  if (requests > 0) {
+    lines.append(tr("Cache: %1% memory, %2% disk, %3% miss").arg(QString::number(100 * stats.memory_hits / requests),
+                                                                  QString::number(100 * stats.disk_hits / requests),
+                                                                  QString::number(100 * stats.misses / requests)));
+  } else {
+    lines.append(tr("Cache: no frames requested"));
+  }
+
+  QStringList worker_jobs;
+
+  foreach (int jobs, stats.worker_jobs) {
+    worker_jobs.append(QString::number(jobs));
+  }
+
+  lines.append(tr("Jobs per worker: %1").arg(worker_jobs.join(' ')));
+  lines.append(tr("Queued: %1 frames").arg(stats.queued_frames));
+
+  if (stats.decode_ms >= 0) {
+    QString path;
+
+    switch (stats.decode_paths) {
+    case Decoder::kDecodePathSoftware:
+      path = tr("software");
+      break;
+    case Decoder::kDecodePathHardwareTransfer:
+      path = tr("hardware, copied to system memory");
+      break;
+    case Decoder::kDecodePathSoftware | Decoder::kDecodePathHardwareTransfer:
+      path = tr("hardware and software");
+      break;
+    }
+
+    if (path.isEmpty()) {
+      lines.append(tr("Decode: %1 ms/frame").arg(QString::number(stats.decode_ms, 'f', 1)));
+    } else {
+      lines.append(tr("Decode: %1 ms/frame (%2)").arg(QString::number(stats.decode_ms, 'f', 1), path));
+    }
+  } else {
+    lines.append(tr("Decode: idle"));
+  }
+
+  lines.append(tr("Dropped: %1 frames").arg(dropped_frames_));
+
+  if (video_renderer_->preview_quality() > 0) {
+    lines.append(tr("Preview quality: 1/%1").arg(1 << video_renderer_->preview_quality()));
+  }
+  QStringList memory_categories;
+
+  for (int i=0;i<MemoryBudget::kCategoryCount;i++) {
+    MemoryBudget::Category category = static_cast<MemoryBudget::Category>(i);
+
+    memory_categories.append(tr("%1 %2").arg(MemoryBudget::CategoryName(category),
+                                             QString::number(MemoryBudget::Used(category) / 1024 / 1024)));
+  }
+
+  if (MemoryBudget::Limit() > 0) {
+    lines.append(tr("Memory: %1 of %2 MB (%3)").arg(QString::number(MemoryBudget::TotalUsed() / 1024 / 1024),
+                                                    QString::number(MemoryBudget::Limit() / 1024 / 1024),
+                                                    memory_categories.join(", ")));
+  } else {
+    lines.append(tr("Memory: %1 MB (%2)").arg(QString::number(MemoryBudget::TotalUsed() / 1024 / 1024),
+                                              memory_categories.join(", ")));
+  }
+
+  qint64 gpu_budget = OpenGLMemoryBudget::Budget();
+
+  if (gpu_budget > 0) {
+    lines.append(tr("GPU textures: %1 of %2 MB").arg(QString::number(OpenGLMemoryBudget::TotalAllocatedBytes() / 1024 / 1024),
+                                                     QString::number(gpu_budget / 1024 / 1024)));
+  } else {
+    lines.append(tr("GPU textures: %1 MB").arg(OpenGLMemoryBudget::TotalAllocatedBytes() / 1024 / 1024));
+  }
+
+  gl_widget_->SetStatistics(lines);
+}
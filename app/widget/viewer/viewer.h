@@ -21,6 +21,7 @@
 #ifndef VIEWER_WIDGET_H
 #define VIEWER_WIDGET_H
 
+#include <QElapsedTimer>
 #include <QFile>
 #include <QLabel>
 #include <QPushButton>
@@ -33,6 +34,7 @@
 #include "render/backend/opengl/openglbackend.h"
 #include "render/backend/opengl/opengltexture.h"
 #include "render/backend/audio/audiobackend.h"
+#include "render/footagepreviewer.h"
 #include "viewerglwidget.h"
 #include "viewersizer.h"
 #include "widget/playbackcontrols/playbackcontrols.h"
@@ -63,10 +65,34 @@ public:
 
   bool IsPlaying();
 
+  /**
+   * @brief Number of frames that were skipped because they weren't shown in time during the current (or last)
+   * playback
+   */
+  int dropped_frames() const;
+
   void ConnectViewerNode(ViewerOutput* node);
 
   void DisconnectViewerNode();
 
+  /**
+   * @brief Show video or image streams straight from their decoders rather than a viewer node
+   *
+   * Frames come from a FootagePreviewer and are uploaded as they are, so there's no graph to compile and nothing is
+   * cached. More than one stream is shown as a multicam grid (see SetMulticamAngle()). Replaces any viewer node that
+   * was connected (and vice versa). An empty list disconnects the streams.
+   */
+  void ConnectFootage(const QList<StreamPtr>& angles);
+
+  /**
+   * @brief Show only this angle of the multicam set with ConnectFootage() at full size, or the grid if it's -1
+   */
+  void SetMulticamAngle(int angle);
+
+  int multicam_angle() const;
+
+  int multicam_angle_count() const;
+
 public slots:
   /**
    * @brief Set the texture to draw and draw it
@@ -100,6 +126,16 @@ public slots:
 signals:
   void TimeChanged(const int64_t&);
 
+  /**
+   * @brief Emitted whenever a different frame is shown, e.g. for scopes to measure (nullptr when there's none)
+   */
+  void TextureChanged(OpenGLTexturePtr texture);
+
+  /**
+   * @brief Forwarded from the renderer's VideoRenderBackend::FrameStatusChanged()
+   */
+  void FrameStatusChanged(const FrameStatusSpans& spans);
+
 protected:
   virtual void resizeEvent(QResizeEvent *event) override;
 
@@ -108,10 +144,46 @@ private:
 
   void UpdateTextureFromNode(const rational &time);
 
+  /**
+   * @brief Disconnect the stream set with ConnectFootage() and free its texture
+   */
+  void CloseFootage();
+
   void PlayInternal(int speed);
 
   void PushScrubbedAudio();
 
+  /**
+   * @brief Returns the time since playback started in microseconds
+   *
+   * If audio is playing, this follows the audio device so video stays in sync with it. Otherwise a monotonic clock is
+   * used.
+   */
+  qint64 GetPlaybackClock();
+
+  /**
+   * @brief Lower the renderer's preview quality if the cache is about to run out during playback
+   *
+   * Called for every frame shown. The quality only ever goes down while playing, it goes back to full when playback
+   * stops (see Pause()).
+   */
+  void AdaptPlaybackQuality();
+
+  /**
+   * @brief Frames ahead of the playhead that AdaptPlaybackQuality() looks at
+   */
+  static const int kAdaptiveLookAhead = 48;
+
+  /**
+   * @brief The quality is lowered when fewer frames than this are cached ahead and the cache is being used up
+   */
+  static const int kAdaptiveLowWater = 8;
+
+  /**
+   * @brief Frames shown after playback starts or the quality changes before the cache is judged
+   */
+  static const int kAdaptiveSettleFrames = 24;
+
   OpenGLBackend* video_renderer_;
   AudioBackend* audio_renderer_;
 
@@ -119,6 +191,8 @@ private:
 
   ViewerGLWidget* gl_widget_;
 
+  OpenGLTexturePtr texture_;
+
   PlaybackControls* controls_;
 
   TimeRuler* ruler_;
@@ -131,11 +205,48 @@ private:
 
   QTimer playback_timer_;
 
-  qint64 start_msec_;
+  /**
+   * @brief Refreshes the statistics overlay while it's visible
+   */
+  QTimer statistics_timer_;
+
+  QElapsedTimer playback_clock_;
+  bool audio_clock_synced_;
+  qint64 audio_clock_offset_;
+  qint64 last_clock_usecs_;
   int64_t start_timestamp_;
 
+  int dropped_frames_;
+
+  /**
+   * @brief Frames cached ahead of the playhead when the last frame was shown, or -1 if not measured yet
+   */
+  int cache_lead_;
+
+  /**
+   * @brief Moving average of how much cache_lead_ changes per frame shown, negative while the cache is being used up
+   */
+  double cache_lead_trend_;
+
+  int quality_settle_frames_;
+
+  bool adaptive_playback_;
+
   ViewerOutput* viewer_node_;
 
+  FootagePreviewer* footage_previewer_;
+
+  QList<StreamPtr> footage_streams_;
+
+  int multicam_angle_;
+
+  rational footage_length_;
+
+  /**
+   * @brief Texture in gl_widget_'s context that frames from footage_previewer_ are uploaded to
+   */
+  OpenGLTexturePtr footage_texture_;
+
   int playback_speed_;
 
 private slots:
@@ -146,10 +257,19 @@ private slots:
   void RendererCachedFrame(const rational& time, QVariant value);
   void RendererCachedTime(const rational& time);
 
+  void FootageFrameReady(const rational& time, FramePtr frame);
+
   void SizeChangedSlot(int width, int height);
 
   void LengthChangedSlot(const rational& length);
 
+  void StatisticsVisibleChanged(bool visible);
+
+  /**
+   * @brief Gather the renderer's statistics and show them in the overlay
+   */
+  void UpdateStatistics();
+
 };
 
 #endif // VIEWER_WIDGET_H
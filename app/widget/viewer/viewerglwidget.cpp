@@ -24,6 +24,7 @@
 #include <QOpenGLContext>
 #include <QOpenGLFunctions>
 #include <QOpenGLTexture>
+#include <QPainter>
 
 #include "render/backend/opengl/functions.h"
 #include "render/backend/opengl/openglshader.h"
@@ -31,12 +32,12 @@
 ViewerGLWidget::ViewerGLWidget(QWidget *parent) :
   QOpenGLWidget(parent),
   texture_(0),
-  ocio_lut_(0)
+  ocio_lut_(0),
+  statistics_visible_(false)
 {
+  // Color settings are set up in initializeGL(), so a viewer that's never shown never waits for the OCIO config
   connect(ColorManager::instance(), SIGNAL(ConfigChanged()), this, SLOT(ColorConfigChangedSlot()));
 
-  RefreshColorSettings();
-
   setContextMenuPolicy(Qt::CustomContextMenu);
   connect(this, SIGNAL(customContextMenuRequested(const QPoint&)), this, SLOT(ShowContextMenu(const QPoint&)));
 }
@@ -55,8 +56,34 @@ void ViewerGLWidget::SetTexture(GLuint tex)
   update();
 }
 
+void ViewerGLWidget::SetStatistics(const QStringList &lines)
+{
+  statistics_ = lines;
+
+  if (statistics_visible_) {
+    update();
+  }
+}
+
+void ViewerGLWidget::SetStatisticsVisible(bool e)
+{
+  if (statistics_visible_ == e) {
+    return;
+  }
+
+  statistics_visible_ = e;
+
+  update();
+
+  emit StatisticsVisibleChanged(statistics_visible_);
+}
+
 void ViewerGLWidget::initializeGL()
 {
+  if (!color_service_) {
+    RefreshColorSettings();
+  }
+
   SetupPipeline();
 
   connect(context(), SIGNAL(aboutToBeDestroyed()), this, SLOT(ContextCleanup()), Qt::DirectConnection);
@@ -82,6 +109,22 @@ void ViewerGLWidget::paintGL()
     // Release retrieved texture
     f->glBindTexture(GL_TEXTURE_2D, 0);
   }
+
+  if (statistics_visible_ && !statistics_.isEmpty()) {
+    QPainter p(this);
+
+    QString text = statistics_.join('\n');
+
+    // Draw the text over a dark box so it's readable over any frame
+    QRect text_rect = p.fontMetrics().boundingRect(QRect(0, 0, width(), height()), Qt::AlignLeft | Qt::AlignTop, text);
+    int margin = p.fontMetrics().height() / 2;
+    text_rect.translate(margin, margin);
+
+    p.fillRect(text_rect.adjusted(-margin / 2, -margin / 2, margin / 2, margin / 2), QColor(0, 0, 0, 160));
+
+    p.setPen(Qt::white);
+    p.drawText(text_rect, Qt::AlignLeft | Qt::AlignTop, text);
+  }
 }
 
 void ViewerGLWidget::SetupPipeline()
@@ -89,7 +132,7 @@ void ViewerGLWidget::SetupPipeline()
   // Re-retrieve pipeline pertaining to this context
   pipeline_ = OpenGLShader::CreateOCIO(context(),
                                        ocio_lut_,
-                                       color_service_->GetProcessor(),
+                                       color_service_,
                                        true);
 }
 
@@ -106,7 +149,8 @@ void ViewerGLWidget::RefreshColorSettings()
 
 void ViewerGLWidget::SetupColorProcessor()
 {
-  color_service_ = ColorProcessor::Create(OCIO::ROLE_SCENE_LINEAR, ocio_display_, ocio_view_, ocio_look_);
+  // Shared with every other viewer showing the same view, so its LUT is only baked once
+  color_service_ = ColorManager::GetProcessor(OCIO::ROLE_SCENE_LINEAR, ocio_display_, ocio_view_, ocio_look_);
 }
 
 void ViewerGLWidget::ContextCleanup()
@@ -148,6 +192,13 @@ void ViewerGLWidget::ShowContextMenu(const QPoint &pos)
     action->setChecked(ocio_look_ == l);
   }
 
+  menu.addSeparator();
+
+  QAction* statistics_action = menu.addAction(tr("Show Render Statistics"));
+  statistics_action->setCheckable(true);
+  statistics_action->setChecked(statistics_visible_);
+  connect(statistics_action, SIGNAL(triggered(bool)), this, SLOT(SetStatisticsVisible(bool)));
+
   menu.exec(mapToGlobal(pos));
 }
 
@@ -156,6 +207,14 @@ void ViewerGLWidget::ColorConfigChangedSlot()
   RefreshColorSettings();
 
   if (pipeline_ != nullptr) {
+    makeCurrent();
+
+    // The new pipeline comes with a LUT texture of its own
+    context()->functions()->glDeleteTextures(1, &ocio_lut_);
+    ocio_lut_ = 0;
+
     SetupPipeline();
+
+    doneCurrent();
   }
 }
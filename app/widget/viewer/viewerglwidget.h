@@ -22,6 +22,7 @@
 #define VIEWERGLWIDGET_H
 
 #include <QOpenGLWidget>
+#include <QStringList>
 
 #include "render/colormanager.h"
 #include "render/backend/opengl/openglshader.h"
@@ -86,6 +87,22 @@ public slots:
    */
   void SetTexture(GLuint tex);
 
+  /**
+   * @brief Set the lines of text shown in the statistics overlay (see SetStatisticsVisible())
+   */
+  void SetStatistics(const QStringList& lines);
+
+  /**
+   * @brief Show or hide the statistics overlay
+   *
+   * The widget only draws the text it's given, it's up to whoever's listening to StatisticsVisibleChanged() to keep it
+   * up to date.
+   */
+  void SetStatisticsVisible(bool e);
+
+signals:
+  void StatisticsVisibleChanged(bool visible);
+
 protected:
   /**
    * @brief Initialize function to set up the OpenGL context upon its construction
@@ -156,6 +173,10 @@ private:
    */
   ColorProcessorPtr color_service_;
 
+  bool statistics_visible_;
+
+  QStringList statistics_;
+
 private slots:
   /**
    * @brief Slot to connect just before the OpenGL context is destroyed to clean up resources
@@ -21,8 +21,10 @@
 #include "mainmenu.h"
 
 #include <QEvent>
+#include <QFileDialog>
 
 #include "core.h"
+#include "common/tracer.h"
 #include "dialog/actionsearch/actionsearch.h"
 #include "panel/panelmanager.h"
 #include "tool/tool.h"
@@ -39,15 +41,15 @@ MainMenu::MainMenu(QMainWindow *parent) :
   file_menu_ = new Menu(this, this, SLOT(FileMenuAboutToShow()));
   file_new_menu_ = new Menu(file_menu_);
   olive::menu_shared.AddItemsForNewMenu(file_new_menu_);
-  file_open_item_ = file_menu_->AddItem("openproj", nullptr, nullptr, "Ctrl+O");
+  file_open_item_ = file_menu_->AddItem("openproj", &olive::core, SLOT(DialogOpenProjectShow()), "Ctrl+O");
   file_open_recent_menu_ = new Menu(file_menu_);
   file_open_recent_clear_item_ = file_open_recent_menu_->AddItem("clearopenrecent", nullptr, nullptr);
-  file_save_item_ = file_menu_->AddItem("saveproj", nullptr, nullptr, "Ctrl+S");
-  file_save_as_item_ = file_menu_->AddItem("saveprojas", nullptr, nullptr, "Ctrl+Shift+S");
+  file_save_item_ = file_menu_->AddItem("saveproj", &olive::core, SLOT(SaveActiveProject()), "Ctrl+S");
+  file_save_as_item_ = file_menu_->AddItem("saveprojas", &olive::core, SLOT(SaveActiveProjectAs()), "Ctrl+Shift+S");
   file_menu_->addSeparator();
   file_import_item_ = file_menu_->AddItem("import", &olive::core, SLOT(DialogImportShow()), "Ctrl+I");
   file_menu_->addSeparator();
-  file_export_item_ = file_menu_->AddItem("export", nullptr, nullptr, "Ctrl+M");
+  file_export_item_ = file_menu_->AddItem("export", &olive::core, SLOT(DialogExportShow()), "Ctrl+M");
   file_menu_->addSeparator();
   file_project_properties_item_ = file_menu_->AddItem("projectproperties", &olive::core, SLOT(DialogProjectPropertiesShow()));
   file_menu_->addSeparator();
@@ -301,10 +303,15 @@ MainMenu::MainMenu(QMainWindow *parent) :
   help_action_search_item_ = help_menu_->AddItem("actionsearch", this, SLOT(ActionSearchTriggered()), "/");
   help_menu_->addSeparator();
   help_debug_log_item_ = help_menu_->AddItem("debuglog", nullptr, nullptr);
+  help_record_trace_item_ = help_menu_->AddItem("recordrendertrace", this, SLOT(RecordRenderTraceTriggered(bool)));
+  help_record_trace_item_->setCheckable(true);
+  help_save_trace_item_ = help_menu_->AddItem("saverendertrace", this, SLOT(SaveRenderTraceTriggered()));
   help_menu_->addSeparator();
   help_about_item_ = help_menu_->AddItem("about", &olive::core, SLOT(DialogAboutShow()));
 
   Retranslate();
+
+  action_search_index_.SetMenuBar(this);
 }
 
 void MainMenu::changeEvent(QEvent *e)
@@ -446,10 +453,38 @@ void MainMenu::EditToOutTriggered()
 void MainMenu::ActionSearchTriggered()
 {
   ActionSearch as(parentWidget());
-  as.SetMenuBar(this);
+  as.SetIndex(&action_search_index_);
   as.exec();
 }
 
+void MainMenu::RecordRenderTraceTriggered(bool e)
+{
+  if (e) {
+    // Start a new recording rather than adding to the last one
+    Tracer::Clear();
+  }
+
+  Tracer::SetEnabled(e);
+}
+
+void MainMenu::SaveRenderTraceTriggered()
+{
+  QString filename = QFileDialog::getSaveFileName(parentWidget(),
+                                                  tr("Save Render Trace"),
+                                                  QString(),
+                                                  tr("Chrome Trace (*.json)"));
+
+  if (filename.isEmpty()) {
+    return;
+  }
+
+  if (!filename.endsWith(".json", Qt::CaseInsensitive)) {
+    filename.append(".json");
+  }
+
+  Tracer::ExportChromeTrace(filename);
+}
+
 void MainMenu::ShuttleLeftTriggered()
 {
   olive::panel_manager->CurrentlyFocused()->ShuttleLeft();
@@ -578,5 +613,7 @@ void MainMenu::Retranslate()
   help_menu_->setTitle(tr("&Help"));
   help_action_search_item_->setText(tr("A&ction Search"));
   help_debug_log_item_->setText(tr("Debug Log"));
+  help_record_trace_item_->setText(tr("Record Render Trace"));
+  help_save_trace_item_->setText(tr("Save Render Trace..."));
   help_about_item_->setText(tr("&About..."));
 }
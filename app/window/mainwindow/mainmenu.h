@@ -126,6 +126,13 @@ private slots:
   void GoToPrevCutTriggered();
   void GoToNextCutTriggered();
 
+  /**
+   * @brief Start or stop recording how long each render stage takes (see Tracer)
+   */
+  void RecordRenderTraceTriggered(bool e);
+
+  void SaveRenderTraceTriggered();
+
 private:
   /**
    * @brief Set strings based on the current application language.
@@ -221,8 +228,15 @@ private:
   Menu* help_menu_;
   QAction* help_action_search_item_;
   QAction* help_debug_log_item_;
+  QAction* help_record_trace_item_;
+  QAction* help_save_trace_item_;
   QAction* help_about_item_;
 
+  /**
+   * @brief Index of this menu bar's actions, kept between action searches so the menus aren't walked every time
+   */
+  ActionSearchIndex action_search_index_;
+
 };
 
 #endif // MAINMENU_H
@@ -27,9 +27,12 @@
 // Panel objects
 #include "panel/panelmanager.h"
 #include "panel/audiomonitor/audiomonitor.h"
+#include "panel/footageviewer/footageviewer.h"
 #include "panel/node/node.h"
 #include "panel/param/param.h"
 #include "panel/project/project.h"
+#include "panel/renderqueue/renderqueue.h"
+#include "panel/scope/scope.h"
 #include "panel/taskmanager/taskmanager.h"
 #include "panel/timeline/timeline.h"
 #include "panel/tool/tool.h"
@@ -116,6 +119,11 @@ void olive::MainWindow::ProjectOpen(Project* p)
   ParamPanel* param_panel = olive::panel_manager->CreatePanel<ParamPanel>(this);
   addDockWidget(Qt::TopDockWidgetArea, param_panel);
 
+  // Starts tabbed behind the parameters, footage is brought to the front when it's opened from the project
+  FootageViewerPanel* footage_viewer_panel = olive::panel_manager->CreatePanel<FootageViewerPanel>(this);
+  tabifyDockWidget(param_panel, footage_viewer_panel);
+  param_panel->raise();
+
   ViewerPanel* viewer_panel2 = olive::panel_manager->CreatePanel<ViewerPanel>(this);
   addDockWidget(Qt::TopDockWidgetArea, viewer_panel2);
 
@@ -132,28 +140,28 @@ void olive::MainWindow::ProjectOpen(Project* p)
   AudioMonitorPanel* audio_monitor_panel = olive::panel_manager->CreatePanel<AudioMonitorPanel>(this);
   addDockWidget(Qt::BottomDockWidgetArea, audio_monitor_panel);
 
+  // Starts tabbed behind the viewer, so it only draws once it's brought to the front
+  ScopePanel* scope_panel = olive::panel_manager->CreatePanel<ScopePanel>(this);
+  tabifyDockWidget(viewer_panel2, scope_panel);
+  viewer_panel2->raise();
+
   TaskManagerPanel* task_man_panel = olive::panel_manager->CreatePanel<TaskManagerPanel>(this);
   addDockWidget(Qt::BottomDockWidgetArea, task_man_panel);
   task_man_panel->setFloating(true);
   task_man_panel->setVisible(false);
 
+  RenderQueuePanel* render_queue_panel = olive::panel_manager->CreatePanel<RenderQueuePanel>(this);
+  addDockWidget(Qt::BottomDockWidgetArea, render_queue_panel);
+  render_queue_panel->setFloating(true);
+  render_queue_panel->setVisible(false);
+
   connect(node_panel, SIGNAL(SelectionChanged(QList<Node*>)), param_panel, SLOT(SetNodes(QList<Node*>)));
+  connect(viewer_panel2, SIGNAL(TextureChanged(OpenGLTexturePtr)), scope_panel, SLOT(SetTexture(OpenGLTexturePtr)));
 }
 
-// FIXME: Test code
-#include <QDir>
-#include "common/filefunctions.h"
-// End test code
-
 void olive::MainWindow::closeEvent(QCloseEvent *e)
 {
   olive::panel_manager->DeleteAllPanels();
 
-  // FIXME: Test code - We have no cache management and the cache is very much testing only, so we delete it on close
-  //                    as to not clog up HDD space
-  QDir(GetMediaCacheLocation()).removeRecursively();
-  //QDir(GetMediaIndexLocation()).removeRecursively();
-  // End test code
-
   QMainWindow::closeEvent(e);
 }
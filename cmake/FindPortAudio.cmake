@@ -0,0 +1,62 @@
+# - Find PortAudio library
+# Find the native PortAudio includes and library
+# This module defines
+#  PORTAUDIO_INCLUDE_DIRS, where to find portaudio.h, Set when
+#                          PORTAUDIO_INCLUDE_DIR is found.
+#  PORTAUDIO_LIBRARIES, libraries to link against to use PortAudio.
+#  PORTAUDIO_ROOT_DIR, The base directory to search for PortAudio.
+#                      This can also be an environment variable.
+#  PORTAUDIO_FOUND, If false, do not try to use PortAudio.
+#
+# also defined, but not for general use are
+#  PORTAUDIO_LIBRARY, where to find the PortAudio library.
+
+# If PORTAUDIO_ROOT_DIR was defined in the environment, use it.
+IF(NOT PORTAUDIO_ROOT_DIR AND NOT $ENV{PORTAUDIO_ROOT_DIR} STREQUAL "")
+  SET(PORTAUDIO_ROOT_DIR $ENV{PORTAUDIO_ROOT_DIR})
+ENDIF()
+
+SET(_portaudio_SEARCH_DIRS
+  ${PORTAUDIO_ROOT_DIR}
+  /usr/local
+  /sw # Fink
+  /opt/local # DarwinPorts
+)
+
+FIND_PATH(PORTAUDIO_INCLUDE_DIR
+  NAMES
+    portaudio.h
+  HINTS
+    ${_portaudio_SEARCH_DIRS}
+  PATH_SUFFIXES
+    include
+)
+
+FIND_LIBRARY(PORTAUDIO_LIBRARY
+  NAMES
+    portaudio
+    portaudio_x64
+    portaudio_static_x64
+  HINTS
+    ${_portaudio_SEARCH_DIRS}
+  PATH_SUFFIXES
+    lib64 lib
+)
+
+# handle the QUIETLY and REQUIRED arguments and set PORTAUDIO_FOUND to TRUE if
+# all listed variables are TRUE
+INCLUDE(FindPackageHandleStandardArgs)
+FIND_PACKAGE_HANDLE_STANDARD_ARGS(PortAudio DEFAULT_MSG
+    PORTAUDIO_LIBRARY PORTAUDIO_INCLUDE_DIR)
+
+IF(PORTAUDIO_FOUND)
+  SET(PORTAUDIO_LIBRARIES ${PORTAUDIO_LIBRARY})
+  SET(PORTAUDIO_INCLUDE_DIRS ${PORTAUDIO_INCLUDE_DIR})
+ENDIF(PORTAUDIO_FOUND)
+
+MARK_AS_ADVANCED(
+  PORTAUDIO_INCLUDE_DIR
+  PORTAUDIO_LIBRARY
+)
+
+UNSET(_portaudio_SEARCH_DIRS)